@@ -0,0 +1,26 @@
+find_path(FFMPEG_INCLUDE_DIR
+  NAMES libavcodec/avcodec.h
+)
+
+find_library(FFMPEG_AVCODEC_LIBRARY
+  NAMES avcodec
+)
+
+find_library(FFMPEG_AVUTIL_LIBRARY
+  NAMES avutil
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(FFmpeg
+  FOUND_VAR FFMPEG_FOUND
+  REQUIRED_VARS
+    FFMPEG_AVCODEC_LIBRARY
+    FFMPEG_AVUTIL_LIBRARY
+    FFMPEG_INCLUDE_DIR
+)
+
+if(FFMPEG_FOUND)
+  set(FFMPEG_LIBRARIES ${FFMPEG_AVCODEC_LIBRARY} ${FFMPEG_AVUTIL_LIBRARY})
+endif()
+
+mark_as_advanced(FFMPEG_INCLUDE_DIR FFMPEG_AVCODEC_LIBRARY FFMPEG_AVUTIL_LIBRARY)
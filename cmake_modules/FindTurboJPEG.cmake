@@ -0,0 +1,23 @@
+find_path(TURBOJPEG_INCLUDE_DIR
+  NAMES turbojpeg.h
+)
+
+find_library(TURBOJPEG_LIBRARY
+  NAMES turbojpeg
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(TurboJPEG
+  FOUND_VAR TurboJPEG_FOUND
+  REQUIRED_VARS
+    TURBOJPEG_LIBRARY
+    TURBOJPEG_INCLUDE_DIR
+)
+
+if(TurboJPEG_FOUND AND NOT TARGET TurboJPEG::TurboJPEG)
+  add_library(TurboJPEG::TurboJPEG UNKNOWN IMPORTED)
+  set_target_properties(TurboJPEG::TurboJPEG PROPERTIES
+    IMPORTED_LOCATION "${TURBOJPEG_LIBRARY}"
+    INTERFACE_INCLUDE_DIRECTORIES "${TURBOJPEG_INCLUDE_DIR}"
+  )
+endif()
@@ -168,11 +168,38 @@ void Imager::abortBatch()
 
 void Imager::batchDone()
 {
+    // done once every image is on disk, ready to download
+    imageWriter.flush();
     ProgressNP.setState(IPS_OK);
     LOG_INFO("Batch done");
     ProgressNP.apply();
 }
 
+void Imager::imageDone()
+{
+    if (image == maxImage)
+    {
+        if (group == maxGroup)
+        {
+            batchDone();
+        }
+        else
+        {
+            maxImage           = nextGroup()->count();
+            ProgressNP[GROUP].setValue(group = group + 1);
+            ProgressNP[IMAGE].setValue(image = 1);
+            ProgressNP.apply();
+            initiateNextFilter();
+        }
+    }
+    else
+    {
+        ProgressNP[IMAGE].setValue(image = image + 1);
+        ProgressNP.apply();
+        initiateNextFilter();
+    }
+}
+
 void Imager::initiateDownload()
 {
     int group = (int)DownloadNP[GROUP].getValue();
@@ -183,6 +210,8 @@ void Imager::initiateDownload()
     if (group == 0 || image == 0)
         return;
 
+    imageWriter.flush();
+
     sprintf(name, IMAGE_NAME, ImageNameTP[IMAGE_FOLDER].getText(), ImageNameTP[IMAGE_NAME_PREFIX].getText(), group, image, format);
     file.open(name, std::ios::in | std::ios::binary | std::ios::ate);
     DownloadNP[GROUP].setValue(0);
@@ -450,6 +479,8 @@ bool Imager::Connect()
     BaseClient::watchDevice(controlledFilterWheel);
     connectServer();
     setBLOBMode(B_ALSO, controlledCCD, nullptr);
+    // images of a local server come in shared memory, without base64 encoding
+    enableDirectBlobAccess(controlledCCD, nullptr);
 
     return true;
 }
@@ -531,36 +562,14 @@ void Imager::updateProperty(INDI::Property property)
             if (ProgressNP.getState() == IPS_BUSY)
             {
                 char name[128] = {0};
-                std::ofstream file;
 
                 strncpy(format, bp.getFormat(), 16);
                 sprintf(name, IMAGE_NAME, ImageNameTP[IMAGE_FOLDER].getText(), ImageNameTP[IMAGE_NAME_PREFIX].getText(), group, image, format);
-                file.open(name, std::ios::out | std::ios::binary | std::ios::trunc);
-                file.write(static_cast<char *>(bp.getBlob()), bp.getBlobLen());
-                file.close();
-                LOGF_DEBUG("Group %d of %d, image %d of %d, saved to %s", group, maxGroup, image, maxImage,
+                // the next exposure or filter change starts while the image is written
+                imageWriter.write(name, bp.getBlob(), bp.getBlobLen());
+                LOGF_DEBUG("Group %d of %d, image %d of %d, saving to %s", group, maxGroup, image, maxImage,
                            name);
-                if (image == maxImage)
-                {
-                    if (group == maxGroup)
-                    {
-                        batchDone();
-                    }
-                    else
-                    {
-                        maxImage           = nextGroup()->count();
-                        ProgressNP[GROUP].setValue(group = group + 1);
-                        ProgressNP[IMAGE].setValue(image = 1);
-                        ProgressNP.apply();
-                        initiateNextFilter();
-                    }
-                }
-                else
-                {
-                    ProgressNP[IMAGE].setValue(image = image + 1);
-                    ProgressNP.apply();
-                    initiateNextFilter();
-                }
+                imageDone();
             }
         }
         return;
@@ -611,27 +620,7 @@ void Imager::updateProperty(INDI::Property property)
         rename(propertyText[0].getText(), name);
         LOGF_DEBUG("Group %d of %d, image %d of %d, saved to %s", group, maxGroup, image,
                    maxImage, name);
-        if (image == maxImage)
-        {
-            if (group == maxGroup)
-            {
-                batchDone();
-            }
-            else
-            {
-                maxImage           = nextGroup()->count();
-                ProgressNP[GROUP].setValue(group = group + 1);
-                ProgressNP[IMAGE].setValue(image = 1);
-                ProgressNP.apply();
-                initiateNextFilter();
-            }
-        }
-        else
-        {
-            ProgressNP[IMAGE].setValue(image = image + 1);
-            ProgressNP.apply();
-            initiateNextFilter();
-        }
+        imageDone();
         return;
     }
 }
@@ -21,6 +21,7 @@
 
 #include "baseclient.h"
 #include "defaultdevice.h"
+#include "imagewriter.h"
 #define MAX_GROUP_COUNT 16
 
 class Group;
@@ -68,6 +69,7 @@ private:
     void startBatch();
     void abortBatch();
     void batchDone();
+    void imageDone();
     void initiateDownload();
 
     char format[16];
@@ -138,6 +140,9 @@ private:
 
     INDI::PropertyNumber FilterSlotNP {1};
 
+    // saves the images received as BLOBs while the next one is exposed
+    ImageWriter imageWriter;
+
     std::vector<std::shared_ptr<Group>> groups;
     std::shared_ptr<Group> currentGroup() const;
     std::shared_ptr<Group> nextGroup() const;
@@ -0,0 +1,160 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+ *******************************************************************************/
+
+#include "imagewriter.h"
+
+#include "indidevapi.h"
+#include "sharedblob.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+ImageWriter::~ImageWriter()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    queued.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void ImageWriter::write(const std::string &fileName, const void *data, size_t size)
+{
+    Image image;
+    image.fileName = fileName;
+    image.size     = size;
+
+    // the sealed memfd of a shared BLOB outlives the BLOB with its own descriptor
+    int fd = IDSharedBlobGetFd(const_cast<void *>(data));
+    if (fd != -1)
+        image.fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (image.fd == -1)
+    {
+        image.data.resize(size);
+        memcpy(image.data.data(), data, size);
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        images.push_back(std::move(image));
+        // started by the first image, the agent may never run a batch
+        if (!thread.joinable())
+            thread = std::thread(&ImageWriter::run, this);
+    }
+    queued.notify_one();
+}
+
+void ImageWriter::flush()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    written.wait(guard, [this] { return images.empty() && !writing; });
+}
+
+void ImageWriter::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;)
+    {
+        queued.wait(guard, [this] { return !images.empty() || stopping; });
+        if (images.empty())
+            break;
+
+        Image image = std::move(images.front());
+        images.pop_front();
+        writing = true;
+        guard.unlock();
+
+        bool ok;
+        if (image.fd != -1)
+        {
+            ok = writeFd(image);
+            close(image.fd);
+        }
+        else
+        {
+            std::ofstream file(image.fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+            file.write(image.data.data(), image.data.size());
+            file.close();
+            ok = !file.fail();
+        }
+        if (!ok)
+            IDLog("Imager Agent: cannot write %s\n", image.fileName.c_str());
+
+        guard.lock();
+        writing = false;
+        written.notify_all();
+    }
+}
+
+bool ImageWriter::writeFd(const Image &image)
+{
+    int out = open(image.fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out == -1)
+        return false;
+
+    // let the kernel move the pages, fall back to plain reads on older kernels or filesystems
+    size_t done = 0;
+#ifdef __linux__
+    bool copyRange = true;
+    bool sendFile  = true;
+    while (done < image.size && (copyRange || sendFile))
+    {
+        ssize_t n;
+        if (copyRange)
+        {
+            loff_t offset = done;
+            n = copy_file_range(image.fd, &offset, out, nullptr, image.size - done, 0);
+        }
+        else
+        {
+            off_t offset = done;
+            n = sendfile(out, image.fd, &offset, image.size - done);
+        }
+
+        if (n > 0)
+            done += n;
+        else if (n == -1 && errno == EINTR)
+            continue;
+        else if (copyRange && done == 0)
+            copyRange = false;
+        else
+            sendFile = copyRange = false;
+    }
+#endif
+
+    char buffer[64 * 1024];
+    while (done < image.size)
+    {
+        ssize_t n = pread(image.fd, buffer, std::min(sizeof(buffer), image.size - done), done);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0 || ::write(out, buffer, n) != n)
+            break;
+        done += n;
+    }
+
+    return close(out) == 0 && done == image.size;
+}
@@ -0,0 +1,60 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+ *******************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/** @brief Writes the images of a batch to disk in the background, so the next exposure does not wait for them */
+class ImageWriter
+{
+public:
+    ImageWriter() = default;
+    ~ImageWriter();
+
+    /** @brief Queue the image to write under fileName.
+     *  A shared BLOB is written straight from its memfd, any other image is copied first.
+     */
+    void write(const std::string &fileName, const void *data, size_t size);
+
+    /** @brief Wait until every queued image is on disk */
+    void flush();
+
+private:
+    struct Image
+    {
+        std::string fileName;
+        std::vector<char> data;
+        int fd { -1 };
+        size_t size { 0 };
+    };
+
+    void run();
+    static bool writeFd(const Image &image);
+
+    std::thread thread;
+    std::mutex lock;
+    std::condition_variable queued;
+    std::condition_variable written;
+    std::deque<Image> images;
+    bool writing { false };
+    bool stopping { false };
+};
@@ -58,6 +58,7 @@ bool GPUSBDriver::Disconnect()
 
 bool GPUSBDriver::startPulse(int direction)
 {
+    std::lock_guard<std::mutex> guard(lock);
     int rc = 0;
 
     switch (direction)
@@ -98,6 +99,7 @@ bool GPUSBDriver::startPulse(int direction)
 
 bool GPUSBDriver::stopPulse(int direction)
 {
+    std::lock_guard<std::mutex> guard(lock);
     int rc = 0;
 
     switch (direction)
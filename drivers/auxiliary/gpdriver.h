@@ -24,6 +24,8 @@
 
 #include "indiusbdevice.h"
 
+#include <mutex>
+
 enum
 {
     GPUSB_NORTH     = 0x08,
@@ -57,4 +59,6 @@ class GPUSBDriver : public INDI::USBDevice
     private:
         char guideCMD[1];
         bool debug;
+        // The pulses end on the thread of the guide pulser, the lines of both axes share guideCMD
+        std::mutex lock;
 };
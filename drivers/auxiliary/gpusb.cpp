@@ -144,99 +144,53 @@ void GPUSB::debugTriggered(bool enable)
 
 IPState GPUSB::GuideNorth(uint32_t ms)
 {
-    RemoveTimer(NSTimerID);
-
-    driver->startPulse(GPUSB_NORTH);
-
-    NSDirection = GPUSB_NORTH;
-
     LOG_DEBUG("Starting NORTH guide");
 
-    NSPulseRequest = ms;
-
-    NSGuideTS = std::chrono::system_clock::now();
-
-    NSTimerID = IEAddTimer(ms, &GPUSB::NSTimerHelper, this);
-
-    return IPS_BUSY;
+    return timeGuidePulse(AXIS_DE, ms, [this]()
+    {
+        return driver->startPulse(GPUSB_NORTH);
+    }, [this]()
+    {
+        driver->stopPulse(GPUSB_NORTH);
+    });
 }
 
 IPState GPUSB::GuideSouth(uint32_t ms)
 {
-    RemoveTimer(NSTimerID);
-
-    driver->startPulse(GPUSB_SOUTH);
-
-    NSDirection = GPUSB_SOUTH;
-
     LOG_DEBUG("Starting SOUTH guide");
 
-    NSPulseRequest = ms;
-
-    NSGuideTS = std::chrono::system_clock::now();
-
-    NSTimerID = IEAddTimer(ms, &GPUSB::NSTimerHelper, this);
-
-    return IPS_BUSY;
+    return timeGuidePulse(AXIS_DE, ms, [this]()
+    {
+        return driver->startPulse(GPUSB_SOUTH);
+    }, [this]()
+    {
+        driver->stopPulse(GPUSB_SOUTH);
+    });
 }
 
 IPState GPUSB::GuideEast(uint32_t ms)
 {
-    RemoveTimer(WETimerID);
-
-    driver->startPulse(GPUSB_EAST);
-
-    WEDirection = GPUSB_EAST;
-
     LOG_DEBUG("Starting EAST guide");
 
-    WEPulseRequest = ms;
-
-    WEGuideTS = std::chrono::system_clock::now();
-
-    WETimerID = IEAddTimer(ms, &GPUSB::WETimerHelper, this);
-
-    return IPS_BUSY;
+    return timeGuidePulse(AXIS_RA, ms, [this]()
+    {
+        return driver->startPulse(GPUSB_EAST);
+    }, [this]()
+    {
+        driver->stopPulse(GPUSB_EAST);
+    });
 }
 
 IPState GPUSB::GuideWest(uint32_t ms)
 {
-    RemoveTimer(WETimerID);
-
-    driver->startPulse(GPUSB_WEST);
-
-    WEDirection = GPUSB_WEST;
-
     LOG_DEBUG("Starting WEST guide");
 
-    WEPulseRequest = ms;
-
-    WEGuideTS = std::chrono::system_clock::now();
-
-    WETimerID = IEAddTimer(ms, &GPUSB::WETimerHelper, this);
-
-    return IPS_BUSY;
-}
-
-void GPUSB::NSTimerHelper(void *context)
-{
-    static_cast<GPUSB*>(context)->NSTimerCallback();
-}
-
-void GPUSB::WETimerHelper(void *context)
-{
-    static_cast<GPUSB*>(context)->WETimerCallback();
-}
-
-void GPUSB::NSTimerCallback()
-{
-    driver->stopPulse(NSDirection);
-    GuideComplete(AXIS_DE);
-}
-
-void GPUSB::WETimerCallback()
-{
-    driver->stopPulse(WEDirection);
-    GuideComplete(AXIS_RA);
+    return timeGuidePulse(AXIS_RA, ms, [this]()
+    {
+        return driver->startPulse(GPUSB_WEST);
+    }, [this]()
+    {
+        driver->stopPulse(GPUSB_WEST);
+    });
 }
 
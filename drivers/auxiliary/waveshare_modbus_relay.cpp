@@ -27,6 +27,9 @@ static std::unique_ptr<WaveshareRelay> sesto(new WaveshareRelay());
 WaveshareRelay::WaveshareRelay() : OutputInterface(this)
 {
     setVersion(1, 0);
+
+    // The 8 relays, read at every poll
+    m_Registers.add(Modbus::COILS, 0, 8);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -74,6 +77,7 @@ bool WaveshareRelay::updateProperties()
     }
     else
     {
+        m_Scheduler.stop();
         deleteProperty(FirmwareVersionTP);
     }
 
@@ -113,6 +117,7 @@ bool WaveshareRelay::Handshake()
         ss << std::fixed << std::setprecision(2) << output / 100.0;
         FirmwareVersionTP[0].setText(ss.str().c_str());
         FirmwareVersionTP.setState(IPS_OK);
+        m_Scheduler.start(&nmbs);
         return true;
     }
 
@@ -169,7 +174,14 @@ void WaveshareRelay::TimerHit()
     if (!isConnected())
         return;
 
-    UpdateDigitalOutputs();
+    // Still running if the device is slower than the polling period
+    m_Scheduler.refresh(m_Registers, [this](nmbs_error err)
+    {
+        if (err != NMBS_ERROR_NONE)
+            LOGF_ERROR("Error reading coils at address 0: %s", nmbs_strerror(err));
+        else if (isConnected())
+            UpdateDigitalOutputs();
+    });
 
     SetTimer(getCurrentPollingPeriod());
 }
@@ -179,29 +191,23 @@ void WaveshareRelay::TimerHit()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool WaveshareRelay::UpdateDigitalOutputs()
 {
-    nmbs_bitfield coils = {0};
-    auto err = nmbs_read_coils(&nmbs, 0, 8, coils);
-    if (err != NMBS_ERROR_NONE)
-    {
-        LOGF_ERROR("Error reading coils at address 0: %s", nmbs_strerror(err));
-        return false;
-    }
-    else
+    // From the coils read by the last refresh
+    for (size_t i = 0; i < DigitalOutputsSP.size(); i++)
     {
-        for (size_t i = 0; i < DigitalOutputsSP.size(); i++)
+        uint16_t newState;
+        if (!m_Registers.value(Modbus::COILS, i, newState))
+            return false;
+
+        auto oldState = DigitalOutputsSP[i].findOnSwitchIndex();
+        if (oldState != newState)
         {
-            auto oldState = DigitalOutputsSP[i].findOnSwitchIndex();
-            auto newState = nmbs_bitfield_read(coils, i);
-            if (oldState != newState)
-            {
-                DigitalOutputsSP[i].reset();
-                DigitalOutputsSP[i][newState].setState(ISS_ON);
-                DigitalOutputsSP[i].setState(IPS_OK);
-                DigitalOutputsSP[i].apply();
-            }
+            DigitalOutputsSP[i].reset();
+            DigitalOutputsSP[i][newState].setState(ISS_ON);
+            DigitalOutputsSP[i].setState(IPS_OK);
+            DigitalOutputsSP[i].apply();
         }
-        return true;
     }
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -211,12 +217,17 @@ bool WaveshareRelay::CommandOutput(uint32_t index, OutputState command)
 {
     uint16_t value = (command == On) ? 0xFF00 : 0;
 
-    auto err = nmbs_write_single_coil(&nmbs, index, value);
+    // Ahead of the reads of a refresh
+    auto err = m_Scheduler.execute([index, value](nmbs_t *client)
+    {
+        return nmbs_write_single_coil(client, index, value);
+    });
     if (err != NMBS_ERROR_NONE)
     {
-        LOGF_ERROR("Error reading coils at address 0: %s", nmbs_strerror(err));
+        LOGF_ERROR("Error writing coil at address %u: %s", index, nmbs_strerror(err));
         return false;
     }
 
+    m_Registers.invalidate(Modbus::COILS, index, 1);
     return true;
 }
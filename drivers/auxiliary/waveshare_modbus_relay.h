@@ -19,6 +19,7 @@
 #include "indioutputinterface.h"
 #include "defaultdevice.h"
 #include "../../libs/modbus/nanomodbus.h"
+#include "../../libs/modbus/modbusregisters.h"
 
 class WaveshareRelay : public INDI::DefaultDevice, public INDI::OutputInterface
 {
@@ -62,4 +63,8 @@ class WaveshareRelay : public INDI::DefaultDevice, public INDI::OutputInterface
         INDI::PropertyText FirmwareVersionTP {1};
         int PortFD{-1};
         nmbs_t nmbs;
+
+        // Once connected, requests run from the scheduler thread and the outputs are read from the register image
+        Modbus::RegisterMap m_Registers;
+        Modbus::Scheduler m_Scheduler;
 };
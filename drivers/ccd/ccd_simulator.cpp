@@ -19,6 +19,7 @@
 #include "ccd_simulator.h"
 #include "indicom.h"
 #include "stream/streammanager.h"
+#include "indithreadpool.h"
 
 #include "locale_compat.h"
 
@@ -30,6 +31,10 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
 #include <algorithm>
 #include <chrono>
 #include <random>
@@ -156,6 +161,19 @@ bool CCDSim::initProperties()
     CrashSP.fill(getDeviceName(), "CCD_SIMULATE_CRASH", "Crash", SIMULATOR_TAB, IP_WO,
                  ISR_ATMOST1, 0, IPS_IDLE);
 
+    // Benchmark streaming
+    StreamBenchmarkSP[INDI_ENABLED].fill("INDI_ENABLED", "Enabled", ISS_OFF);
+    StreamBenchmarkSP[INDI_DISABLED].fill("INDI_DISABLED", "Disabled", ISS_ON);
+    StreamBenchmarkSP.fill(getDeviceName(), "SIM_STREAM_BENCHMARK", "Stream Benchmark", SIMULATOR_TAB, IP_RW,
+                           ISR_1OFMANY, 60, IPS_IDLE);
+
+    // A frame rate of 0 pushes frames as fast as the stream takes them
+    StreamBenchmarkNP[BENCHMARK_FRAMES].fill("BENCHMARK_FRAMES", "Frames", "%.f", 1, 256, 1, 16);
+    StreamBenchmarkNP[BENCHMARK_FPS].fill("BENCHMARK_FPS", "Frame rate", "%.f", 0, 1000, 10, 100);
+    StreamBenchmarkNP[BENCHMARK_JITTER].fill("BENCHMARK_JITTER", "Jitter (pixels)", "%.f", 0, 50, 1, 0);
+    StreamBenchmarkNP.fill(getDeviceName(), "SIM_STREAM_BENCHMARK_SETTINGS", "Benchmark Settings", SIMULATOR_TAB, IP_RW,
+                           60, IPS_IDLE);
+
     // Periodic Error
     EqPENP[AXIS_RA].fill("RA_PE", "RA (hh:mm:ss)", "%010.6m", 0, 24, 0, 0);
     EqPENP[AXIS_DE].fill("DEC_PE", "DEC (dd:mm:ss)", "%010.6m", -90, 90, 0, 0);
@@ -236,6 +254,9 @@ bool CCDSim::initProperties()
     // as it modifies the capabilities.
     setBayerEnabled(m_SimulateBayer);
 
+    // Frames are drawn into the frame buffer at each StartExposure
+    setUploadPipeline(true);
+
     INDI::FilterInterface::initProperties(FILTER_TAB);
 
     FilterSlotN[0].min = 1;
@@ -272,6 +293,9 @@ void CCDSim::ISGetProperties(const char * dev)
     defineProperty(FocusSimulationNP);
     defineProperty(SimulateBayerSP);
     defineProperty(CrashSP);
+    defineProperty(StreamBenchmarkSP);
+    defineProperty(StreamBenchmarkNP);
+    StreamBenchmarkNP.load();
 }
 
 bool CCDSim::updateProperties()
@@ -716,6 +740,8 @@ int CCDSim::DrawCcdFrame(INDI::CCDChip * targetChip)
 
         std::unique_lock<std::mutex> guard(ccdBufferLock);
 
+        std::vector<ImageStar> stars;
+
         //  Start by clearing the frame buffer
         memset(targetChip->getFrameBuffer(), 0, targetChip->getFrameBufferSize());
 
@@ -726,6 +752,8 @@ int CCDSim::DrawCcdFrame(INDI::CCDChip * targetChip)
             FILE * pp;
             int drawn = 0;
 
+            stars.reserve(3000);
+
             sprintf(gsccmd, "gsc -c %8.6f %+8.6f -r %4.1f -m 0 %4.2f -n 3000",
                     range360(rad),
                     rangeDec(cameradec),
@@ -785,15 +813,16 @@ int CCDSim::DrawCcdFrame(INDI::CCDChip * targetChip)
                         // Invert horizontally
                         ccdx = ccdW - ccdx;
 
-                        rc = DrawImageStar(targetChip, mag, ccdx, ccdy, exposure_time);
-                        drawn += rc;
-#ifdef __DEV__
-                        if (rc == 1)
+                        // Stars are drawn below, in bands of rows, together with the sky glow and noise
+                        if (isOnFrame(targetChip, ccdx, ccdy))
                         {
-                            LOGF_DEBUG("star %s scope %6.4f %6.4f star %6.4f %6.4f ccd %6.2f %6.2f", id, rad, decPE, ra, dec, ccdx, ccdy);
-                            LOGF_DEBUG("star %s ccd %6.2f %6.2f", id, ccdx, ccdy);
+                            //  calculate flux from our zero point and gain values
+                            //  flux represents one second, scale up linearly for exposure time
+                            float starFlux = flux(mag);
+                            starFlux = starFlux * exposure_time;
+                            stars.push_back({static_cast<float>(ccdx), static_cast<float>(ccdy), starFlux});
+                            drawn++;
                         }
-#endif
                     }
                 }
                 pclose(pp);
@@ -811,82 +840,129 @@ int CCDSim::DrawCcdFrame(INDI::CCDChip * targetChip)
         //  now we need to add background sky glow, with vignetting
         //  this is essentially the same math as drawing a dim star with
         //  fwhm equivalent to the full field of view
+        bool const drawGlow = ftype == INDI::CCDChip::LIGHT_FRAME || ftype == INDI::CCDChip::FLAT_FRAME;
+
+        //  calculate flux from our zero point and gain values
+        float glow = m_SkyGlow * 1.3;
 
-        if (ftype == INDI::CCDChip::LIGHT_FRAME || ftype == INDI::CCDChip::FLAT_FRAME)
+        if (ftype == INDI::CCDChip::FLAT_FRAME)
         {
-            //  calculate flux from our zero point and gain values
-            float glow = m_SkyGlow * 1.3;
+            //  Assume flats are done with a diffuser
+            //  in broad daylight, so, the sky magnitude
+            //  is much brighter than at night
+            glow = m_SkyGlow / 10;
+        }
 
-            if (ftype == INDI::CCDChip::FLAT_FRAME)
-            {
-                //  Assume flats are done with a diffuser
-                //  in broad daylight, so, the sky magnitude
-                //  is much brighter than at night
-                glow = m_SkyGlow / 10;
-            }
+        // Flux represents one second, scale up linearly for exposure time
+        float const skyflux = flux(glow) * exposure_time;
 
-            // Flux represents one second, scale up linearly for exposure time
-            float const skyflux = flux(glow) * exposure_time;
+        uint16_t * const frame = reinterpret_cast<uint16_t *>(targetChip->getFrameBuffer());
 
-            uint16_t * pt = reinterpret_cast<uint16_t *>(targetChip->getFrameBuffer());
+        nheight = targetChip->getSubH();
+        nwidth  = targetChip->getSubW();
 
-            nheight = targetChip->getSubH();
-            nwidth  = targetChip->getSubW();
+        int psfBox = 0;
+        const std::vector<float> &kernel = psfKernel(psfBox);
 
-            for (int y = 0; y < nheight; y++)
+        // Each band of rows is drawn by one task: stars clipped to the band, then sky glow and noise,
+        // so that pixels get the same operations in the same order as when drawn one star at a time.
+        size_t const bands = std::max<size_t>(1, std::min<size_t>(INDI::ThreadPool::global().size() * 4,
+                                              static_cast<size_t>(nheight) / 16));
+        int const bandRows = static_cast<int>((nheight + bands - 1) / bands);
+        std::vector<int> bandMin(bands, minpix), bandMax(bands, maxpix);
+        uint32_t const noiseSeed = static_cast<uint32_t>(random());
+
+        INDI::ThreadPool::global().parallelFor(0, bands, [&](size_t band)
+        {
+            int const firstRow = static_cast<int>(band) * bandRows;
+            int const lastRow = std::min(nheight, firstRow + bandRows);
+            int &minValue = bandMin[band];
+            int &maxValue = bandMax[band];
+
+            for (const auto &star : stars)
+                DrawImageStar(targetChip, star, kernel, psfBox, firstRow, lastRow, minValue, maxValue);
+
+            if (drawGlow)
             {
-                float const sy = nheight / 2 - y;
+                // Vignetting parameter in arcsec
+                float const vig = std::min(nwidth, nheight) * ImageScalex;
 
-                for (int x = 0; x < nwidth; x++)
+                for (int y = firstRow; y < lastRow; y++)
                 {
-                    float const sx = nwidth / 2 - x;
+                    float const sy = nheight / 2 - y;
+                    uint16_t * pt = frame + static_cast<size_t>(y) * nwidth;
 
-                    // Vignetting parameter in arcsec
-                    float const vig = std::min(nwidth, nheight) * ImageScalex;
+                    for (int x = 0; x < nwidth; x++)
+                    {
+                        float const sx = nwidth / 2 - x;
 
-                    // Squared distance to center in arcsec (need to make this account for actual pixel size)
-                    float const dc2 = sx * sx * ImageScalex * ImageScalex + sy * sy * ImageScaley * ImageScaley;
+                        // Squared distance to center in arcsec (need to make this account for actual pixel size)
+                        float const dc2 = sx * sx * ImageScalex * ImageScalex + sy * sy * ImageScaley * ImageScaley;
 
-                    // Gaussian falloff to the edges of the frame
-                    float const fa = exp(-2.0 * 0.7 * dc2 / (vig * vig));
+                        // Gaussian falloff to the edges of the frame
+                        float const fa = exp(-2.0 * 0.7 * dc2 / (vig * vig));
 
-                    // Get the current value of the pixel, add the sky glow and scale for vignetting
-                    float fp = (pt[0] + skyflux) * fa;
+                        // Get the current value of the pixel, add the sky glow and scale for vignetting
+                        float fp = (pt[0] + skyflux) * fa;
 
-                    // Clamp to limits, store minmax
-                    if (fp > m_MaxVal) fp = m_MaxVal;
-                    if (fp < pt[0]) fp = pt[0];
-                    if (fp > maxpix) maxpix = fp;
-                    if (fp < minpix) minpix = fp;
+                        // Clamp to limits, store minmax
+                        if (fp > m_MaxVal) fp = m_MaxVal;
+                        if (fp < pt[0]) fp = pt[0];
+                        if (fp > maxValue) maxValue = fp;
+                        if (fp < minValue) minValue = fp;
 
-                    // And put it back
-                    pt[0] = fp;
-                    pt++;
+                        // And put it back
+                        pt[0] = fp;
+                        pt++;
+                    }
                 }
             }
-        }
 
-        //  Now we add some bias and read noise
-        int subX = targetChip->getSubX();
-        int subY = targetChip->getSubY();
-        int subW = targetChip->getSubW() + subX;
-        int subH = targetChip->getSubH() + subY;
-
-        if (m_MaxNoise > 0)
-        {
-            for (int x = subX; x < subW; x++)
+            //  Now we add some bias and read noise
+            if (m_MaxNoise > 0)
             {
-                for (int y = subY; y < subH; y++)
-                {
-                    int noise;
+                // Interleaved xorshift generators, one per lane, seeded for the band, so that the
+                // noise of a row is generated a vector at a time.
+                constexpr int LANES = 8;
+                uint32_t state[LANES];
+                for (int lane = 0; lane < LANES; lane++)
+                    state[lane] = (noiseSeed ^ static_cast<uint32_t>(band * LANES + lane + 1)) * 2654435761u | 1;
+
+                std::vector<uint16_t> noise(nwidth + LANES);
+                uint32_t const maxNoise = m_MaxNoise;
 
-                    noise = random();
-                    noise = noise % m_MaxNoise; //
+                for (int y = firstRow; y < lastRow; y++)
+                {
+                    for (int x = 0; x < nwidth; x += LANES)
+                    {
+                        for (int lane = 0; lane < LANES; lane++)
+                        {
+                            uint32_t r = state[lane];
+                            r ^= r << 13;
+                            r ^= r >> 17;
+                            r ^= r << 5;
+                            state[lane] = r;
+                            noise[x + lane] = ((r >> 16) * maxNoise) >> 16;
+                        }
+                    }
 
-                    AddToPixel(targetChip, x, y, m_Bias + noise);
+                    uint16_t * pt = frame + static_cast<size_t>(y) * nwidth;
+                    int rowMin = minValue, rowMax = maxValue;
+                    for (int x = 0; x < nwidth; x++)
+                    {
+                        int const newval = std::min(pt[x] + m_Bias + noise[x], m_MaxVal);
+                        rowMax = std::max(rowMax, newval);
+                        rowMin = std::min(rowMin, newval);
+                        pt[x] = newval;
+                    }
+                    minValue = rowMin;
+                    maxValue = rowMax;
                 }
             }
-        }
+        });
+
+        minpix = *std::min_element(bandMin.begin(), bandMin.end());
+        maxpix = *std::max_element(bandMax.begin(), bandMax.end());
     }
     else
     {
@@ -906,32 +982,19 @@ int CCDSim::DrawCcdFrame(INDI::CCDChip * targetChip)
     return 0;
 }
 
-int CCDSim::DrawImageStar(INDI::CCDChip * targetChip, float mag, float x, float y, float exposure_time)
+bool CCDSim::isOnFrame(INDI::CCDChip * targetChip, float x, float y)
 {
-    int sx, sy;
-    int drew     = 0;
-    //int boxsizex = 5;
-    int boxsizey = 5;
-    float flux;
-
     int subX = targetChip->getSubX();
     int subY = targetChip->getSubY();
     int subW = targetChip->getSubW() + subX;
     int subH = targetChip->getSubH() + subY;
 
-    if ((x < subX) || (x > subW || (y < subY) || (y > subH)))
-    {
-        //  this star is not on the ccd frame anyways
-        return 0;
-    }
-
-    //  calculate flux from our zero point and gain values
-    flux = this->flux(mag);
-
-    //  ok, flux represents one second now
-    //  scale up linearly for exposure time
-    flux = flux * exposure_time;
+    //  a star there draws at least its center pixel
+    return !((x < subX) || (x > subW || (y < subY) || (y > subH)));
+}
 
+const std::vector<float> &CCDSim::psfKernel(int &boxSize)
+{
     //  we need a box size that gives a radius at least 3 times fwhm
     //qx       = seeing / ImageScalex;
     //qx       = qx * 3;
@@ -939,79 +1002,85 @@ int CCDSim::DrawImageStar(INDI::CCDChip * targetChip, float mag, float x, float
     //boxsizex++;
     auto qx = seeing / ImageScaley;
     qx = qx * 3;
-    boxsizey = static_cast<int>(qx);
-    boxsizey++;
-
-    //IDLog("BoxSize %d %d\n",boxsizex,boxsizey);
+    boxSize = static_cast<int>(qx);
+    boxSize++;
 
-    for (sy = -boxsizey; sy <= boxsizey; sy++)
+    if (m_PSFKernel.empty() || m_PSFSeeing != seeing || m_PSFScaleX != ImageScalex || m_PSFScaleY != ImageScaley)
     {
-        for (sx = -boxsizey; sx <= boxsizey; sx++)
-        {
-            int rc;
-
-            // Squared distance to center in arcsec (need to make this account for actual pixel size)
-            float const dc2 = sx * sx * ImageScalex * ImageScalex + sy * sy * ImageScaley * ImageScaley;
-
-            // Use a gaussian of unitary integral, scale it with the source flux
-            // f(x) = 1/(sqrt(2*pi)*sigma) * exp( -x² / (2*sigma²) )
-            // FWHM = 2*sqrt(2*log(2))*sigma => sigma = seeing/(2*sqrt(2*log(2)))
-            float const sigma = seeing / ( 2 * sqrt(2 * log(2)));
-            float const fa = 1 / (sigma * sqrt(2 * 3.1416)) * exp( -dc2 / (2 * sigma * sigma));
+        int const side = 2 * boxSize + 1;
+        m_PSFKernel.resize(static_cast<size_t>(side) * side);
 
-            // The source contribution is the gaussian value, stretched by seeing/FWHM
-            float fp = fa * flux;
+        for (int sy = -boxSize; sy <= boxSize; sy++)
+        {
+            for (int sx = -boxSize; sx <= boxSize; sx++)
+            {
+                // Squared distance to center in arcsec (need to make this account for actual pixel size)
+                float const dc2 = sx * sx * ImageScalex * ImageScalex + sy * sy * ImageScaley * ImageScaley;
 
-            if (fp < 0)
-                fp = 0;
+                // Use a gaussian of unitary integral, scale it with the source flux
+                // f(x) = 1/(sqrt(2*pi)*sigma) * exp( -x² / (2*sigma²) )
+                // FWHM = 2*sqrt(2*log(2))*sigma => sigma = seeing/(2*sqrt(2*log(2)))
+                float const sigma = seeing / ( 2 * sqrt(2 * log(2)));
+                float const fa = 1 / (sigma * sqrt(2 * 3.1416)) * exp( -dc2 / (2 * sigma * sigma));
 
-            rc = AddToPixel(targetChip, x + sx, y + sy, fp);
-            if (rc != 0)
-                drew = 1;
+                m_PSFKernel[(sy + boxSize) * side + sx + boxSize] = fa;
+            }
         }
+
+        m_PSFSeeing = seeing;
+        m_PSFScaleX = ImageScalex;
+        m_PSFScaleY = ImageScaley;
     }
-    return drew;
+
+    return m_PSFKernel;
 }
 
-int CCDSim::AddToPixel(INDI::CCDChip * targetChip, int x, int y, int val)
+void CCDSim::DrawImageStar(INDI::CCDChip * targetChip, const ImageStar &star, const std::vector<float> &kernel, int boxSize,
+                           int firstRow, int lastRow, int &minValue, int &maxValue)
 {
     int nwidth  = targetChip->getSubW();
-    int nheight = targetChip->getSubH();
+    int subX = targetChip->getSubX();
+    int subY = targetChip->getSubY();
+
+    //  quick reject of the stars out of the rows
+    if (star.y + boxSize < subY + firstRow - 1 || star.y - boxSize > subY + lastRow + 1)
+        return;
 
-    x -= targetChip->getSubX();
-    y -= targetChip->getSubY();
+    uint16_t * frame = reinterpret_cast<uint16_t *>(targetChip->getFrameBuffer());
+    int const side = 2 * boxSize + 1;
 
-    int drew = 0;
-    if (x >= 0)
+    for (int sy = -boxSize; sy <= boxSize; sy++)
     {
-        if (x < nwidth)
+        int const y = static_cast<int>(star.y + sy) - subY;
+        if (y < firstRow || y >= lastRow)
+            continue;
+
+        const float * fa = &kernel[(sy + boxSize) * side];
+        uint16_t * row = frame + static_cast<size_t>(y) * nwidth;
+
+        for (int sx = -boxSize; sx <= boxSize; sx++)
         {
-            if (y >= 0)
-            {
-                if (y < nheight)
-                {
-                    unsigned short * pt;
-                    int newval;
-                    drew++;
-
-                    pt = reinterpret_cast<uint16_t *>(targetChip->getFrameBuffer());
-
-                    pt += (y * nwidth);
-                    pt += x;
-                    newval = pt[0];
-                    newval += val;
-                    if (newval > m_MaxVal)
-                        newval = m_MaxVal;
-                    if (newval > maxpix)
-                        maxpix = newval;
-                    if (newval < minpix)
-                        minpix = newval;
-                    pt[0] = newval;
-                }
-            }
+            int const x = static_cast<int>(star.x + sx) - subX;
+            if (x < 0 || x >= nwidth)
+                continue;
+
+            // The source contribution is the gaussian value, stretched by seeing/FWHM
+            float fp = fa[sx + boxSize] * star.flux;
+
+            if (fp < 0)
+                fp = 0;
+
+            int newval = row[x];
+            newval += static_cast<int>(fp);
+            if (newval > m_MaxVal)
+                newval = m_MaxVal;
+            if (newval > maxValue)
+                maxValue = newval;
+            if (newval < minValue)
+                minValue = newval;
+            row[x] = newval;
         }
     }
-    return drew;
 }
 
 IPState CCDSim::GuideNorth(uint32_t v)
@@ -1141,6 +1210,15 @@ bool CCDSim::ISNewNumber(const char * dev, const char * name, double values[], c
             FocusSimulationNP.setState(IPS_OK);
             FocusSimulationNP.apply();
         }
+        else if (StreamBenchmarkNP.isNameMatch(name))
+        {
+            StreamBenchmarkNP.update(values, names, n);
+            StreamBenchmarkNP.setState(IPS_OK);
+            StreamBenchmarkNP.apply();
+            m_BenchmarkStale = true;
+            saveConfig(StreamBenchmarkNP);
+            return true;
+        }
     }
 
     return INDI::CCD::ISNewNumber(dev, name, values, names, n);
@@ -1197,6 +1275,8 @@ bool CCDSim::ISNewSwitch(const char * dev, const char * name, ISState * states,
             DirectorySP.update(states, names, n);
             m_AllFiles.clear();
             m_RemainingFiles.clear();
+            m_PlaybackCache.clear();
+            m_PlaybackCacheBytes = 0;
             if (DirectorySP[INDI_ENABLED].getState() == ISS_ON)
             {
                 if (watchDirectory() == false)
@@ -1244,6 +1324,15 @@ bool CCDSim::ISNewSwitch(const char * dev, const char * name, ISState * states,
         {
             abort();
         }
+        else if (StreamBenchmarkSP.isNameMatch(name))
+        {
+            StreamBenchmarkSP.update(states, names, n);
+            m_BenchmarkStale = true;
+            m_StreamBenchmark = StreamBenchmarkSP[INDI_ENABLED].getState() == ISS_ON;
+            StreamBenchmarkSP.setState(IPS_OK);
+            StreamBenchmarkSP.apply();
+            return true;
+        }
     }
 
     //  Nobody has claimed this, so, ignore it
@@ -1259,6 +1348,7 @@ bool CCDSim::watchDirectory()
         return false;
     }
 
+    m_AllFiles.clear();
     struct dirent * dp;
     std::string d_dir = std::string(DirectoryTP[0].getText());
     auto directory = DirectoryTP[0].getText();
@@ -1272,6 +1362,10 @@ bool CCDSim::watchDirectory()
     }
     closedir(dirp);
 
+    // The files of the previous directory are of no use anymore.
+    m_PlaybackCache.clear();
+    m_PlaybackCacheBytes = 0;
+
     if (m_AllFiles.empty())
     {
         LOGF_ERROR("No FITS files found in directory %s", directory);
@@ -1402,6 +1496,9 @@ bool CCDSim::saveConfigItems(FILE * fp)
     // Bayer
     SimulateBayerSP.save(fp);
 
+    // Benchmark streaming
+    StreamBenchmarkNP.save(fp);
+
     // Focus simulation
     FocusSimulationNP.save(fp);
 
@@ -1494,6 +1591,7 @@ void * CCDSim::streamVideoHelper(void * context)
 void * CCDSim::streamVideo()
 {
     auto start = std::chrono::high_resolution_clock::now();
+    auto due = std::chrono::steady_clock::now();
 
     while (true)
     {
@@ -1511,6 +1609,12 @@ void * CCDSim::streamVideo()
         // release condMutex
         pthread_mutex_unlock(&condMutex);
 
+        if (m_StreamBenchmark)
+        {
+            streamBenchmarkFrame(due);
+            continue;
+        }
+        due = std::chrono::steady_clock::now();
 
         // 16 bit
         DrawCcdFrame(&PrimaryCCD);
@@ -1533,6 +1637,81 @@ void * CCDSim::streamVideo()
     return nullptr;
 }
 
+void CCDSim::streamBenchmarkFrame(std::chrono::steady_clock::time_point &due)
+{
+    uint32_t size = PrimaryCCD.getFrameBufferSize() / (PrimaryCCD.getBinX() * PrimaryCCD.getBinY());
+    size_t frames = StreamBenchmarkNP[BENCHMARK_FRAMES].getValue();
+
+    // Keep the ring under 1 GiB
+    frames = std::max<size_t>(1, std::min<size_t>(frames, (1ULL << 30) / std::max<uint32_t>(size, 1)));
+
+    if (m_BenchmarkStale || m_BenchmarkFrames.size() != frames || m_BenchmarkFrames[0].size() != size)
+    {
+        m_BenchmarkStale = false;
+
+        int const bpp    = PrimaryCCD.getBPP() / 8;
+        int const width  = PrimaryCCD.getSubW() / PrimaryCCD.getBinX();
+        int const height = std::min<int>(PrimaryCCD.getSubH() / PrimaryCCD.getBinY(), size / std::max(1, width * bpp));
+        int const jitter = StreamBenchmarkNP[BENCHMARK_JITTER].getValue();
+        size_t const rowBytes = static_cast<size_t>(width) * bpp;
+
+        m_BenchmarkFrames.resize(frames);
+        for (auto &frame : m_BenchmarkFrames)
+        {
+            // Each frame gets noise of its own
+            DrawCcdFrame(&PrimaryCCD);
+            PrimaryCCD.binFrame();
+
+            const uint8_t * source = PrimaryCCD.getFrameBuffer();
+            frame.assign(source, source + size);
+
+            if (jitter <= 0 || width <= 2 * jitter || height <= 2 * jitter)
+                continue;
+
+            // Move the field by up to jitter pixels, repeating the edge pixels where it uncovers the frame
+            int const dx = static_cast<int>(random() % (2 * jitter + 1)) - jitter;
+            int const dy = static_cast<int>(random() % (2 * jitter + 1)) - jitter;
+            for (int y = 0; y < height; y++)
+            {
+                const uint8_t * from = source + std::min(std::max(y - dy, 0), height - 1) * rowBytes;
+                uint8_t * to = frame.data() + y * rowBytes;
+
+                if (dx >= 0)
+                {
+                    memcpy(to + dx * bpp, from, rowBytes - dx * bpp);
+                    for (int x = 0; x < dx; x++)
+                        memcpy(to + x * bpp, from, bpp);
+                }
+                else
+                {
+                    memcpy(to, from - dx * bpp, rowBytes + dx * bpp);
+                    for (int x = width + dx; x < width; x++)
+                        memcpy(to + x * bpp, from + (width - 1) * bpp, bpp);
+                }
+            }
+        }
+
+        LOGF_INFO("Rendered %zu benchmark frames of %dx%d pixels.", frames, width, height);
+        m_BenchmarkIndex = 0;
+        due = std::chrono::steady_clock::now();
+    }
+
+    double const fps = StreamBenchmarkNP[BENCHMARK_FPS].getValue();
+    if (fps > 0)
+    {
+        // Keep the pace over many frames, but don't catch up more than a second of delays
+        due += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1 / fps));
+        auto const now = std::chrono::steady_clock::now();
+        if (due < now - std::chrono::seconds(1))
+            due = now;
+        else
+            std::this_thread::sleep_until(due);
+    }
+
+    Streamer->newFrame(m_BenchmarkFrames[m_BenchmarkIndex].data(), size);
+    m_BenchmarkIndex = (m_BenchmarkIndex + 1) % m_BenchmarkFrames.size();
+}
+
 void CCDSim::addFITSKeywords(INDI::CCDChip *targetChip, std::vector<INDI::FITSRecord> &fitsKeyword)
 {
     INDI::CCD::addFITSKeywords(targetChip, fitsKeyword);
@@ -1540,77 +1719,134 @@ void CCDSim::addFITSKeywords(INDI::CCDChip *targetChip, std::vector<INDI::FITSRe
     fitsKeyword.push_back({"GAIN", GainNP[0].getValue(), 3, "Gain"});
 }
 
-bool CCDSim::loadNextImage()
+bool CCDSim::decodePlaybackFrame(const std::string &filename, PlaybackFrame &frame)
 {
-    if (m_RemainingFiles.empty())
-        m_RemainingFiles = m_AllFiles;
-    const std::string filename = m_RemainingFiles[0];
-    m_RemainingFiles.pop_front();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        LOGF_WARN("Error opening file %s due to error %s", filename.c_str(), strerror(errno));
+        return false;
+    }
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        LOGF_WARN("Error mapping file %s due to error %s", filename.c_str(), strerror(errno));
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
     char comment[512] = {0}, bayer_pattern[16] = {0};
     int status = 0, anynull = 0;
-    double pixel_size = 5.2;
-    int ndim {2}, bitpix {8};
-    long naxes[3];
+    int ndim {2};
+    long naxes[3] = {0, 0, 1};
+    void *buffer = map;
+    size_t buffer_size = st.st_size;
     fitsfile *fptr = nullptr;
 
-    if (fits_open_diskfile(&fptr, filename.c_str(), READONLY, &status))
+    // cfitsio only reads from a READONLY memory file, so the mapping can be handed over as is.
+    if (fits_open_memfile(&fptr, filename.c_str(), READONLY, &buffer, &buffer_size, 0, nullptr, &status))
     {
         char error_status[512] = {0};
         fits_get_errstatus(status, error_status);
         LOGF_WARN("Error opening file %s due to error %s", filename.c_str(), error_status);
+        munmap(map, st.st_size);
         return false;
     }
 
-    fits_get_img_param(fptr, 3, &bitpix, &ndim, naxes, &status);
-
+    bool rc = false;
+    fits_get_img_param(fptr, 3, &frame.bitpix, &ndim, naxes, &status);
     if (ndim < 3)
         naxes[2] = 1;
-    else
-        PrimaryCCD.setNAxis(3);
-    int samples_per_channel = naxes[0] * naxes[1];
-    int channels = naxes[2];
-    int elements = samples_per_channel * channels;
-    int size =  elements * bitpix / 8;
-    PrimaryCCD.setFrameBufferSize(size);
+    frame.width = naxes[0];
+    frame.height = naxes[1];
+    frame.channels = naxes[2];
+
+    long elements = frame.width * frame.height * frame.channels;
+    frame.pixels.resize(elements * frame.bitpix / 8);
 
-    if (fits_read_img(fptr, bitpix == 8 ? TBYTE : TUSHORT, 1, elements, 0, PrimaryCCD.getFrameBuffer(), &anynull, &status))
+    if (fits_read_img(fptr, frame.bitpix == 8 ? TBYTE : TUSHORT, 1, elements, 0, frame.pixels.data(), &anynull, &status))
     {
         char error_status[512] = {0};
         fits_get_errstatus(status, error_status);
         LOGF_WARN("Error reading file %s due to error %s", filename.c_str(), error_status);
-        return false;
     }
-
-    if (fits_read_key_dbl(fptr, "PIXSIZE1", &pixel_size, comment, &status))
+    else if (fits_read_key_dbl(fptr, "PIXSIZE1", &frame.pixelSize, comment, &status))
     {
         char error_status[512] = {0};
         fits_get_errstatus(status, error_status);
         LOGF_WARN("Error reading file %s due to error %s", filename.c_str(), error_status);
-        return false;
+    }
+    else
+    {
+        if (fits_read_key_str(fptr, "BAYERPAT", bayer_pattern, comment, &status))
+        {
+            char error_status[512] = {0};
+            fits_get_errstatus(status, error_status);
+            LOGF_DEBUG("No BAYERPAT keyword found in %s (%s)", filename.c_str(), error_status);
+        }
+        frame.bayerPattern = bayer_pattern;
+        rc = true;
     }
 
-    if (fits_read_key_str(fptr, "BAYERPAT", bayer_pattern, comment, &status))
+    status = 0;
+    fits_close_file(fptr, &status);
+    munmap(map, st.st_size);
+    return rc;
+}
+
+bool CCDSim::loadNextImage()
+{
+    if (m_RemainingFiles.empty())
+        m_RemainingFiles = m_AllFiles;
+    const std::string filename = m_RemainingFiles[0];
+    m_RemainingFiles.pop_front();
+
+    // Each file is decoded once, later passes over the directory only copy the decoded frame. Once the cache is
+    // full, the files that did not fit are decoded again on every pass.
+    PlaybackFrame decoded;
+    const PlaybackFrame *frame = nullptr;
+    auto cached = m_PlaybackCache.find(filename);
+    if (cached != m_PlaybackCache.end())
+        frame = &cached->second;
+    else
     {
-        char error_status[512] = {0};
-        fits_get_errstatus(status, error_status);
-        LOGF_DEBUG("No BAYERPAT keyword found in %s (%s)", filename.c_str(), error_status);
+        if (decodePlaybackFrame(filename, decoded) == false)
+            return false;
+
+        if (m_PlaybackCacheBytes + decoded.pixels.size() <= MAX_PLAYBACK_CACHE_BYTES)
+        {
+            m_PlaybackCacheBytes += decoded.pixels.size();
+            frame = &m_PlaybackCache.emplace(filename, std::move(decoded)).first->second;
+        }
+        else
+            frame = &decoded;
     }
-    SetCCDParams(naxes[0], naxes[1], bitpix, pixel_size, pixel_size);
+
+    if (frame->channels > 1)
+        PrimaryCCD.setNAxis(3);
+    PrimaryCCD.setFrameBufferSize(frame->pixels.size());
+    memcpy(PrimaryCCD.getFrameBuffer(), frame->pixels.data(), frame->pixels.size());
+
+    SetCCDParams(frame->width, frame->height, frame->bitpix, frame->pixelSize, frame->pixelSize);
 
     // Check if MONO or Bayer
-    if (channels == 1 && strlen(bayer_pattern)  == 4)
+    if (frame->channels == 1 && frame->bayerPattern.length() == 4)
     {
         SetCCDCapability(GetCCDCapability() | CCD_HAS_BAYER);
         BayerTP[CFA_OFFSET_X].setText("0");
         BayerTP[CFA_OFFSET_Y].setText("0");
-        BayerTP[CFA_TYPE].setText(bayer_pattern);
+        BayerTP[CFA_TYPE].setText(frame->bayerPattern.c_str());
     }
     else
     {
         SetCCDCapability(GetCCDCapability() & ~CCD_HAS_BAYER);
     }
 
-    fits_close_file(fptr, &status);
     return true;
 }
 
@@ -18,7 +18,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <deque>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "indiccd.h"
 #include "indifilterinterface.h"
@@ -81,6 +86,8 @@ public:
 
     static void *streamVideoHelper(void *context);
     void *streamVideo();
+    // Pushes the next frame of the benchmark ring, due at due, rendering the ring first if needed
+    void streamBenchmarkFrame(std::chrono::steady_clock::time_point &due);
 
 protected:
 
@@ -97,8 +104,18 @@ protected:
 
     int DrawCcdFrame(INDI::CCDChip *targetChip);
 
-    int DrawImageStar(INDI::CCDChip *targetChip, float, float, float, float ExposureTime);
-    int AddToPixel(INDI::CCDChip *targetChip, int, int, int);
+    // Star projected on the frame, with its flux for the exposure
+    struct ImageStar
+    {
+        float x, y, flux;
+    };
+
+    bool isOnFrame(INDI::CCDChip *targetChip, float x, float y);
+    // Gaussian profile of a star of unit flux over (2 * boxSize + 1)² pixels, cached for the seeing and scale
+    const std::vector<float> &psfKernel(int &boxSize);
+    // Adds the pixels of star within rows [firstRow, lastRow) of the subframe
+    void DrawImageStar(INDI::CCDChip *targetChip, const ImageStar &star, const std::vector<float> &kernel, int boxSize,
+                       int firstRow, int lastRow, int &minValue, int &maxValue);
 
     virtual IPState GuideNorth(uint32_t) override;
     virtual IPState GuideSouth(uint32_t) override;
@@ -127,6 +144,18 @@ protected:
     float CalcTimeLeft(timeval, float);
     bool watchDirectory();
     bool loadNextImage();
+
+    // A directory frame decoded to native-endian pixels, with the header keywords playback needs.
+    struct PlaybackFrame
+    {
+        std::vector<uint8_t> pixels;
+        long width {0}, height {0};
+        int channels {1};
+        int bitpix {8};
+        double pixelSize {5.2};
+        std::string bayerPattern;
+    };
+    bool decodePlaybackFrame(const std::string &filename, PlaybackFrame &frame);
     bool setupParameters();
 
     // Turns on/off Bayer RGB simulation.
@@ -161,6 +190,10 @@ protected:
     float seeing { 3.5 };
     float ImageScalex { 1.0 };
     float ImageScaley { 1.0 };
+    std::vector<float> m_PSFKernel;
+    float m_PSFSeeing { 0 };
+    float m_PSFScaleX { 0 };
+    float m_PSFScaleY { 0 };
     //  An oag is offset this much from center of scope position (arcminutes)
     float m_OAGOffset { 0 };
     float m_RotationCW { 0 };
@@ -201,6 +234,10 @@ protected:
     bool terminateThread;
 
     std::deque<std::string> m_AllFiles, m_RemainingFiles;
+    // Frames of the directory decoded so far, each file is read only once until the directory changes.
+    std::map<std::string, PlaybackFrame> m_PlaybackCache;
+    size_t m_PlaybackCacheBytes {0};
+    static constexpr size_t MAX_PLAYBACK_CACHE_BYTES {size_t(2) << 30};
 
     //  And this lives in our simulator settings page
     INDI::PropertyNumber SimulatorSettingsNP {16};
@@ -242,6 +279,20 @@ protected:
 
     INDI::PropertySwitch CrashSP {1};
 
+    // Benchmark streaming: a ring of frames rendered once, then pushed at a fixed rate
+    INDI::PropertySwitch StreamBenchmarkSP {2};
+    INDI::PropertyNumber StreamBenchmarkNP {3};
+    enum
+    {
+        BENCHMARK_FRAMES,
+        BENCHMARK_FPS,
+        BENCHMARK_JITTER
+    };
+    std::atomic_bool m_StreamBenchmark { false };
+    std::atomic_bool m_BenchmarkStale { true };
+    std::vector<std::vector<uint8_t>> m_BenchmarkFrames;
+    size_t m_BenchmarkIndex { 0 };
+
     INDI::PropertySwitch ResolutionSP {3};
     inline static const std::vector<std::pair<uint32_t, uint32_t>> Resolutions =
         {
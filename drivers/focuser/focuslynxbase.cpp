@@ -95,7 +95,8 @@ FocusLynxBase::FocusLynxBase()
                       FOCUSER_CAN_REL_MOVE |
                       FOCUSER_CAN_SYNC     |
                       FOCUSER_CAN_REVERSE  |
-                      FOCUSER_HAS_BACKLASH);
+                      FOCUSER_HAS_BACKLASH |
+                      FOCUSER_HAS_MOTION_MODEL);
 
     canHome = false;
     isHoming   = false;
@@ -3237,6 +3238,8 @@ void FocusLynxBase::TimerHit()
         return;
     }
 
+    FI::updateMotionModel(FocusAbsPosN[0].value);
+
     if (FocusAbsPosNP.s == IPS_BUSY || FocusRelPosNP.s == IPS_BUSY)
     {
         if (isSimulation())
@@ -3312,7 +3315,8 @@ void FocusLynxBase::TimerHit()
         IDSetSwitch(&GotoSP, nullptr);
     }
 
-    SetTimer(getCurrentPollingPeriod());
+    // Sparse status reads while moving, the motion model predicts the position in between
+    SetTimer(FI::getMotionPollingPeriod(getCurrentPollingPeriod()));
 }
 
 /************************************************************************************
@@ -39,7 +39,8 @@ MyFocuserPro2::MyFocuserPro2()
     // Can move in Absolute & Relative motions, can AbortFocuser motion, and has variable speed.
     FI::SetCapability(FOCUSER_CAN_ABS_MOVE | FOCUSER_CAN_REL_MOVE | FOCUSER_CAN_ABORT | FOCUSER_CAN_REVERSE |
                       FOCUSER_HAS_VARIABLE_SPEED |
-                      FOCUSER_CAN_SYNC);
+                      FOCUSER_CAN_SYNC |
+                      FOCUSER_HAS_MOTION_MODEL);
 
     setSupportedConnections(CONNECTION_SERIAL | CONNECTION_TCP);
 
@@ -1311,6 +1312,7 @@ void MyFocuserPro2::TimerHit()
         bool rc = readPosition();
         if (rc)
         {
+            FI::updateMotionModel(FocusAbsPosN[0].value);
             if (fabs(lastPos - FocusAbsPosN[0].value) > 5)
             {
                 IDSetNumber(&FocusAbsPosNP, nullptr);
@@ -1359,7 +1361,8 @@ void MyFocuserPro2::TimerHit()
             }
         }
     }
-    SetTimer(getCurrentPollingPeriod());
+    // Sparse reads while moving, the motion model predicts the position in between
+    SetTimer(FI::getMotionPollingPeriod(getCurrentPollingPeriod()));
 }
 
 bool MyFocuserPro2::AbortFocuser()
@@ -0,0 +1,77 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+/* Runs several drivers built as modules in one process, with one event loop and one connection to indiserver.
+ *
+ * The modules are named by INDIHOST_DRIVERS, separated by spaces, colons or commas. A name without a slash is looked
+ * up in the module directory, with a .so suffix:
+ *
+ *   INDIHOST_DRIVERS="indi_simulator_telescope indi_simulator_ccd" indiserver indi_driver_host
+ *
+ * Their devices register with the driver framework when the modules are loaded, so the main() of the driver library
+ * serves them all. Snooping from a device on another one of the host does not go through indiserver, see
+ * IDLocalDevice(). Only drivers made of INDI::DefaultDevice can be modules.
+ */
+
+#include "defaultdevice_p.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <dlfcn.h>
+
+namespace
+{
+
+void loadModules()
+{
+    const char *drivers = getenv("INDIHOST_DRIVERS");
+    if (drivers == nullptr || drivers[0] == '\0')
+    {
+        fprintf(stderr, "indi_driver_host: INDIHOST_DRIVERS names no driver modules\n");
+        exit(1);
+    }
+
+    std::string names = drivers;
+    size_t start = 0;
+    while ((start = names.find_first_not_of(" :,", start)) != std::string::npos)
+    {
+        size_t end = names.find_first_of(" :,", start);
+        std::string name = names.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        start = end;
+
+        std::string path = name.find('/') == std::string::npos ? INDI_MODULE_DIR "/" + name + ".so" : name;
+        if (dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL) == nullptr)
+        {
+            fprintf(stderr, "indi_driver_host: %s\n", dlerror());
+            exit(1);
+        }
+    }
+
+    INDI::DefaultDevicePrivate::hostDevices();
+}
+
+// Before main(), which starts the event loop of all the devices
+struct ModuleLoader
+{
+    ModuleLoader()
+    {
+        loadModules();
+    }
+} moduleLoader;
+
+}
@@ -28,6 +28,7 @@
 #include <unistd.h>
 #include <termios.h>
 #include <indilogger.h>
+#include <chrono>
 #include <memory>
 #include <deque>
 #include <indicom.h>
@@ -43,21 +44,25 @@
 #define MIN_FRAME_SIZE (512)
 #define MAX_FRAME_SIZE (SUBFRAME_SIZE * 16)
 #define SPECTRUM_SIZE  (256)
+#define TRANSFER_COUNT (16)
+#define TRANSFER_SIZE  (MAX_FRAME_SIZE)
 
 static pthread_cond_t cv         = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t condMutex = PTHREAD_MUTEX_INITIALIZER;
 
 void RTLSDR::Callback()
 {
+    // Let the integration this one replaces leave its loop first
+    std::lock_guard<std::mutex> integrationLock(integrationMutex);
     LOG_INFO("Integration started...");
     b_read = 0;
     n_read = 0;
     setBufferSize(getSampleRate() * IntegrationRequest * getBPS() / 8);
     setBufferSize(getBufferSize() + MAX_FRAME_SIZE - (getBufferSize() % MAX_FRAME_SIZE));
     to_read = getBufferSize();
-    buffer = (unsigned char *)realloc(buffer, min(MAX_FRAME_SIZE, getBufferSize()));
-    if((getSensorConnection() & CONNECTION_TCP) == 0)
-        rtlsdr_reset_buffer(rtl_dev);
+    bool usb = (getSensorConnection() & CONNECTION_TCP) == 0;
+    if(usb)
+        startCapture(getBufferSize());
     else
         tcflush(PortFD, TCIFLUSH);
     setIntegrationTime(IntegrationRequest);
@@ -66,18 +71,25 @@ void RTLSDR::Callback()
     gettimeofday(&IntStart, nullptr);
     while (InIntegration)
     {
-        if (to_read > 0)
+        if(usb)
         {
-            if((getSensorConnection() & CONNECTION_TCP) == 0)
-                rtlsdr_read_sync(rtl_dev, continuum + b_read, min(MAX_FRAME_SIZE, to_read), &n_read);
-            else
-                n_read = read(PortFD, continuum + b_read, min(MAX_FRAME_SIZE, to_read));
+            if (!waitFrame())
+                continue;
+            takeFrame();
+            to_read = 0;
+        }
+        else if (to_read > 0)
+        {
+            n_read = read(PortFD, continuum + b_read, min(MAX_FRAME_SIZE, to_read));
 
             if (n_read > 0) {
                 b_read += n_read;
                 to_read -= n_read;
             }
-        } else {
+        }
+        if (to_read <= 0)
+        {
+            addSpectrometerSamples(getBuffer(), getBufferSize());
             if(!streamPredicate)
             {
                 InIntegration = false;
@@ -93,6 +105,112 @@ void RTLSDR::Callback()
             LOG_INFO("Download complete.");
         }
     }
+    if(usb)
+        captureRunning = false;
+}
+
+void RTLSDR::transferCallback(unsigned char *buf, uint32_t len, void *ctx)
+{
+    static_cast<RTLSDR *>(ctx)->storeTransfer(buf, len);
+}
+
+void RTLSDR::storeTransfer(const uint8_t *buf, uint32_t len)
+{
+    // Never wait in the USB thread: the ring is only resized while no integration runs
+    std::unique_lock<std::mutex> lock(captureMutex, std::try_to_lock);
+    if (!lock.owns_lock() || !captureRunning)
+        return;
+
+    while (len > 0)
+    {
+        uint32_t filled = framesFilled.load(std::memory_order_relaxed);
+        if (filled - framesTaken.load(std::memory_order_acquire) >= FRAME_COUNT)
+        {
+            // The integration thread is late, drop the transfer rather than holding up the USB ones
+            droppedTransfers++;
+            return;
+        }
+        uint32_t n = min(len, static_cast<uint32_t>(frameSize - frameOffset));
+        memcpy(frames[filled % FRAME_COUNT] + frameOffset, buf, n);
+        frameOffset += n;
+        buf += n;
+        len -= n;
+        if (frameOffset == frameSize)
+        {
+            frameOffset = 0;
+            framesFilled.store(filled + 1, std::memory_order_release);
+            frameReady.notify_one();
+        }
+    }
+}
+
+void RTLSDR::startCapture(int size)
+{
+    {
+        std::lock_guard<std::mutex> lock(captureMutex);
+        captureRunning = false;
+        for (int i = 0; i < FRAME_COUNT; i++)
+            frames[i] = static_cast<uint8_t *>(realloc(frames[i], size));
+        frameSize   = size;
+        frameOffset = 0;
+        framesFilled = 0;
+        framesTaken  = 0;
+        droppedTransfers = 0;
+        captureRunning = true;
+    }
+
+    // The transfers keep flowing between integrations, so that streamed frames follow each other without gaps
+    if (!captureThread.joinable())
+    {
+        rtlsdr_reset_buffer(rtl_dev);
+        captureThread = std::thread([this]()
+        {
+            rtlsdr_read_async(rtl_dev, &RTLSDR::transferCallback, this, TRANSFER_COUNT, TRANSFER_SIZE);
+        });
+    }
+}
+
+void RTLSDR::stopCapture()
+{
+    std::lock_guard<std::mutex> integrationLock(integrationMutex);
+    captureRunning = false;
+    if (captureThread.joinable())
+    {
+        rtlsdr_cancel_async(rtl_dev);
+        captureThread.join();
+    }
+    std::lock_guard<std::mutex> lock(captureMutex);
+    for (int i = 0; i < FRAME_COUNT; i++)
+    {
+        free(frames[i]);
+        frames[i] = nullptr;
+    }
+    frameSize = 0;
+}
+
+bool RTLSDR::waitFrame()
+{
+    // The USB thread notifies without the mutex, the timeout covers a missed notification
+    std::unique_lock<std::mutex> lock(frameMutex);
+    return frameReady.wait_for(lock, std::chrono::milliseconds(100), [this]()
+    {
+        return framesFilled.load(std::memory_order_acquire) != framesTaken.load(std::memory_order_relaxed);
+    });
+}
+
+void RTLSDR::takeFrame()
+{
+    // Hand the full frame to the sensor and give its previous buffer back to the ring, no samples are copied
+    uint32_t taken = framesTaken.load(std::memory_order_relaxed);
+    uint8_t *full = frames[taken % FRAME_COUNT];
+    frames[taken % FRAME_COUNT] = getBuffer();
+    setBuffer(full);
+    continuum = full;
+    framesTaken.store(taken + 1, std::memory_order_release);
+
+    uint32_t dropped = droppedTransfers.exchange(0);
+    if (dropped > 0)
+        LOGF_WARN("%u USB transfers dropped, the integrations are not processed fast enough.", dropped);
 }
 
 static class Loader
@@ -136,7 +254,6 @@ RTLSDR::RTLSDR(int32_t index)
     // We set the Receiver capabilities
     uint32_t cap = SENSOR_CAN_ABORT | SENSOR_HAS_STREAMING | SENSOR_HAS_DSP;
     SetReceiverCapability(cap);
-    buffer = (unsigned char*)malloc(1);
 }
 
 bool RTLSDR::Connect()
@@ -161,6 +278,7 @@ bool RTLSDR::Disconnect()
     InIntegration = false;
     if((getSensorConnection() & CONNECTION_TCP) == 0)
     {
+        stopCapture();
         rtlsdr_close(rtl_dev);
     }
     PortFD = -1;
@@ -27,6 +27,11 @@
 #include "indireceiver.h"
 #include "stream/streammanager.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 enum Settings
 {
     FREQUENCY_N = 0,
@@ -44,7 +49,6 @@ class RTLSDR : public INDI::Receiver
         int to_read;
         // Are we integrating?
         bool InIntegration;
-        uint8_t *buffer;
         int b_read, n_read;
         bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
 
@@ -71,6 +75,30 @@ class RTLSDR : public INDI::Receiver
     private:
         void Callback();
 
+        // Asynchronous USB capture: the transfers of librtlsdr are copied into a ring of frames as they arrive,
+        // and each full frame is swapped with the buffer of the sensor
+        static void transferCallback(unsigned char *buf, uint32_t len, void *ctx);
+        void storeTransfer(const uint8_t *buf, uint32_t len);
+        void startCapture(int size);
+        void stopCapture();
+        bool waitFrame();
+        void takeFrame();
+
+        static constexpr int FRAME_COUNT = 3;
+        uint8_t *frames[FRAME_COUNT] = { nullptr };
+        int frameSize { 0 };
+        int frameOffset { 0 };
+        // Frames filled by the USB thread and taken by the integration thread, only ever increasing
+        std::atomic<uint32_t> framesFilled { 0 };
+        std::atomic<uint32_t> framesTaken { 0 };
+        std::atomic<bool> captureRunning { false };
+        std::atomic<uint32_t> droppedTransfers { 0 };
+        std::thread captureThread;
+        std::mutex captureMutex;
+        std::mutex integrationMutex;
+        std::mutex frameMutex;
+        std::condition_variable frameReady;
+
         // Utility functions
         float CalcTimeLeft();
 
@@ -94,7 +94,7 @@ const char *RadioSim::getDefaultName()
 bool RadioSim::initProperties()
 {
     // We set the Receiver capabilities
-    uint32_t cap = SENSOR_CAN_ABORT | SENSOR_HAS_STREAMING | SENSOR_HAS_DSP;
+    uint32_t cap = SENSOR_CAN_ABORT | SENSOR_HAS_STREAMING | SENSOR_HAS_DSP | SENSOR_HAS_CONTINUOUS;
     SetCapability(cap);
 
     // Must init parent properties first!
@@ -53,7 +53,7 @@ LX200_OnStep::LX200_OnStep() : LX200Generic(), WI(this), RotatorInterface(this)
     setVersion(1, 23);   // don't forget to update libindi/drivers.xml
 
     setLX200Capability(LX200_HAS_TRACKING_FREQ | LX200_HAS_SITES | LX200_HAS_ALIGNMENT_TYPE | LX200_HAS_PULSE_GUIDING |
-                       LX200_HAS_PRECISE_TRACKING_FREQ);
+                       LX200_HAS_PRECISE_TRACKING_FREQ | LX200_HAS_PIPELINING);
 
     SetTelescopeCapability(GetTelescopeCapability() |
                            TELESCOPE_CAN_CONTROL_TRACK |
@@ -640,11 +640,11 @@ bool LX200_OnStep::updateProperties()
         defineProperty(&VersionTP);
 
         //PEC
-        //TODO: Define later when it might be supported
-        defineProperty(&OSPECStatusSP);
-        defineProperty(&OSPECIndexSP);
-        defineProperty(&OSPECRecordSP);
-        defineProperty(&OSPECReadSP);
+        //Defined once the controller reports it, or a client asks for it
+        defineLazyProperty(&OSPECStatusSP);
+        defineLazyProperty(&OSPECIndexSP);
+        defineLazyProperty(&OSPECRecordSP);
+        defineLazyProperty(&OSPECReadSP);
         //defineProperty(&OSPECCurrentIndexNP);
         //defineProperty(&OSPECRWValuesNP);
 
@@ -2171,7 +2171,7 @@ bool LX200_OnStep::ReadScopeStatus()
                 flushIO(PortFD);
                 return true; //COMMUNICATION ERROR, BUT DON'T PUT TELESCOPE IN ERROR STATE
             }
-            if (getLX200RA(PortFD, &currentRA) < 0 || getLX200DEC(PortFD, &currentDEC) < 0) // Update actual position
+            if (getLX200RADEC(PortFD, &currentRA, &currentDEC) < 0) // Update actual position
             {
                 EqNP.setState(IPS_ALERT);
                 LOG_ERROR("Error reading RA/DEC.");
@@ -2536,10 +2536,14 @@ bool LX200_OnStep::ReadScopeStatus()
                         SetTelescopeCapability(capabilities, 10 );
                         LX200_OnStep::updateProperties();
                     }
+                    defineLazyGroup(PEC_TAB);
+                }
+                if (!isLazyProperty(OSPECStatusSP.name))
+                {
+                    IDSetSwitch(&OSPECStatusSP, nullptr);
+                    IDSetSwitch(&OSPECRecordSP, nullptr);
+                    IDSetSwitch(&OSPECIndexSP, nullptr);
                 }
-                IDSetSwitch(&OSPECStatusSP, nullptr);
-                IDSetSwitch(&OSPECRecordSP, nullptr);
-                IDSetSwitch(&OSPECIndexSP, nullptr);
             }
 
 
@@ -249,7 +249,7 @@ bool LX200_TeenAstro::ReadScopeStatus()
     if (!isConnected())
         return false;
 
-    if (getLX200RA(PortFD, &currentRA) < 0 || getLX200DEC(PortFD, &currentDEC) < 0)
+    if (getLX200RADEC(PortFD, &currentRA, &currentDEC) < 0)
     {
         EqNP.setState(IPS_ALERT);
         return false;
@@ -28,6 +28,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include "indilogger.h"
 
 #include <cstring>
+#include <string>
+#include <vector>
 #include <unistd.h>
 
 #ifndef _WIN32
@@ -249,6 +251,85 @@ int getCommandString(int fd, char *data, const char *cmd)
     return 0;
 }
 
+int getCommandStringPipelined(int fd, char **data, const char *const *cmds, int count)
+{
+    std::string batch;
+    int error_type;
+    int nbytes_write = 0, nbytes_read = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        DEBUGFDEVICE(lx200Name, DBG_SCOPE, "CMD <%s>", cmds[i]);
+        batch += cmds[i];
+    }
+
+    /* Add mutex */
+    std::unique_lock<std::mutex> guard(lx200CommsLock);
+
+    tcflush(fd, TCIFLUSH);
+
+    /* All commands go out at once, the mount answers them in order */
+    if ((error_type = tty_write(fd, batch.c_str(), static_cast<int>(batch.size()), &nbytes_write)) != TTY_OK)
+        return error_type;
+
+    for (int i = 0; i < count; i++)
+    {
+        error_type = tty_nread_section(fd, data[i], RB_MAX_LEN, '#', LX200_TIMEOUT, &nbytes_read);
+        if (error_type != TTY_OK)
+        {
+            tcflush(fd, TCIFLUSH);
+            return error_type;
+        }
+
+        data[i][nbytes_read - 1] = '\0';
+
+        DEBUGFDEVICE(lx200Name, DBG_SCOPE, "RES <%s>", data[i]);
+    }
+
+    tcflush(fd, TCIFLUSH);
+    return 0;
+}
+
+int getCommandSexaPipelined(int fd, double *values, const char *const *cmds, int count)
+{
+    std::vector<char> buffers(count * RB_MAX_LEN, 0);
+    std::vector<char *> data(count);
+    int error_type;
+
+    for (int i = 0; i < count; i++)
+        data[i] = buffers.data() + i * RB_MAX_LEN;
+
+    if ((error_type = getCommandStringPipelined(fd, data.data(), cmds, count)) != 0)
+        return error_type;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (f_scansexa(data[i], &values[i]))
+        {
+            DEBUGDEVICE(lx200Name, DBG_SCOPE, "Unable to parse response");
+            return -1;
+        }
+
+        DEBUGFDEVICE(lx200Name, DBG_SCOPE, "VAL [%g]", values[i]);
+    }
+
+    return 0;
+}
+
+int getLX200RADEC(int fd, double *ra, double *dec)
+{
+    const char *const cmds[2] = { ":GR#", ":GD#" };
+    double values[2];
+    int error_type;
+
+    if ((error_type = getCommandSexaPipelined(fd, values, cmds, 2)) != 0)
+        return error_type;
+
+    *ra  = values[0];
+    *dec = values[1];
+    return 0;
+}
+
 int isSlewComplete(int fd)
 {
     DEBUGFDEVICE(lx200Name, DBG_SCOPE, "<%s>", __FUNCTION__);
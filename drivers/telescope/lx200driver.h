@@ -202,6 +202,12 @@ int getCommandSexa(int fd, double *value, const char *cmd);
 int getCommandString(int fd, char *data, const char *cmd);
 /* Get Int */
 int getCommandInt(int fd, int *value, const char *cmd);
+/* Get Strings of count commands written back to back, each data entry holding at least 64 bytes */
+int getCommandStringPipelined(int fd, char **data, const char *const *cmds, int count);
+/* Get Doubles from Sexagisemal of count commands written back to back */
+int getCommandSexaPipelined(int fd, double *values, const char *const *cmds, int count);
+/* Get RA and DEC in a single round trip, for mounts that take back to back commands */
+int getLX200RADEC(int fd, double *ra, double *dec);
 /* Get tracking frequency */
 int getTrackFreq(int fd, double *value);
 /* Get site Latitude */
@@ -312,7 +312,8 @@ bool LX200Telescope::ReadScopeStatus()
         }
     }
 
-    if (getLX200RA(PortFD, &currentRA) < 0 || getLX200DEC(PortFD, &currentDEC) < 0)
+    if ((genericCapability & LX200_HAS_PIPELINING) ? getLX200RADEC(PortFD, &currentRA, &currentDEC) < 0 :
+            (getLX200RA(PortFD, &currentRA) < 0 || getLX200DEC(PortFD, &currentDEC) < 0))
     {
         EqNP.setState(IPS_ALERT);
         LOG_ERROR("Error reading RA/DEC.");
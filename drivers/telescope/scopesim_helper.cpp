@@ -25,8 +25,45 @@
 
 #include "indilogger.h"
 
+#include <libnova/sidereal_time.h>
+
 /////////////////////////////////////////////////////////////////////
 
+// SimClock implementation
+
+bool SimClock::simulated = false;
+double SimClock::simulatedTime = 0;
+uint32_t SimClock::switches = 0;
+
+double SimClock::now()
+{
+    if (simulated)
+        return simulatedTime;
+
+    struct timeval currentTime;
+    gettimeofday(&currentTime, nullptr);
+    return currentTime.tv_sec + currentTime.tv_usec / 1e6;
+}
+
+void SimClock::setSimulated(bool enabled)
+{
+    if (enabled == simulated)
+        return;
+
+    if (enabled)
+        simulatedTime = now();
+    simulated = enabled;
+    switches++;
+}
+
+void SimClock::advance(double seconds)
+{
+    if (simulated && seconds > 0)
+        simulatedTime += seconds;
+}
+
+/////////////////////////////////////////////////////////////////////////
+
 // Angle implementation
 
 Angle::Angle(double value, ANGLE_UNITS type)
@@ -126,19 +163,18 @@ void Axis::StartGuide(double rate, uint32_t durationMs)
 
 void Axis::update()         // called about once a second to update the position and mode
 {
-    struct timeval currentTime
-    {
-        0, 0
-    };
-
     /* update elapsed time since last poll, don't presume exactly POLLMS */
-    gettimeofday(&currentTime, nullptr);
+    double currentTime = SimClock::now();
 
-    if (lastTime.tv_sec == 0 && lastTime.tv_usec == 0)
+    // restart from now after the clock switched
+    if (lastTime == 0 || lastGeneration != SimClock::generation())
+    {
         lastTime = currentTime;
+        lastGeneration = SimClock::generation();
+    }
 
     // Time diff in seconds
-    double interval  = currentTime.tv_sec - lastTime.tv_sec + (currentTime.tv_usec - lastTime.tv_usec) / 1e6;
+    double interval  = currentTime - lastTime;
     lastTime = currentTime;
     double change = 0;
 
@@ -220,7 +256,7 @@ void Axis::update()         // called about once a second to update the position
 
 Angle Alignment::lst()
 {
-    return Angle(get_local_sidereal_time(longitude.Degrees360()) * 15.0);
+    return Angle(range24(ln_get_apparent_sidereal_time(SimClock::julianDate()) + longitude.Degrees360() / 15.0) * 15.0);
 }
 
 void Alignment::mountToApparentHaDec(Angle primary, Angle secondary, Angle * apparentHa, Angle* apparentDec)
@@ -8,6 +8,9 @@
  * The Angle structure defines an angle class that manages the wrap round
  * 0 to 360 and handles arithmetic and logic across this boundary.
  *
+ * The SimClock class provides the time used by the Axis and Alignment classes, either the system time
+ * or a simulated time that advances in fixed steps.
+ *
  * The Axis class manages a simulated mount axis and handles moving, tracking, and guiding.
  *
  * The Alignment class handles the alignment, converting between the observed and instrument
@@ -251,6 +254,64 @@ class Angle
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
+///
+/// \brief The SimClock class
+/// Holds the time the Axis and Alignment classes work with.
+/// By default it follows the system clock. Once simulated it starts from the system time and then only
+/// moves when advanced, so a simulation run in fixed steps integrates the same way however fast it runs.
+///
+class SimClock
+{
+    public:
+        ///
+        /// \brief now
+        /// \return the current time in seconds since the Unix epoch
+        ///
+        static double now();
+
+        ///
+        /// \brief julianDate
+        /// \return the current time as a Julian date
+        ///
+        static double julianDate()
+        {
+            return now() / 86400.0 + 2440587.5;
+        }
+
+        ///
+        /// \brief setSimulated switches between the simulated and the system clock
+        /// \param enabled true to use the simulated clock, which starts at the system time
+        ///
+        static void setSimulated(bool enabled);
+
+        static bool isSimulated()
+        {
+            return simulated;
+        }
+
+        ///
+        /// \brief advance moves the simulated clock forward
+        /// \param seconds
+        ///
+        static void advance(double seconds);
+
+        ///
+        /// \brief generation
+        /// \return a count of the clock switches, times of different generations can't be compared
+        ///
+        static uint32_t generation()
+        {
+            return switches;
+        }
+
+    private:
+        static bool simulated;
+        static double simulatedTime;    // seconds since the Unix epoch
+        static uint32_t switches;
+};
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
 ///
 /// \brief The Axis class
 /// Implements a generic Axis which can be used for equatorial or AltAz mounts for both axes.
@@ -341,10 +402,8 @@ class Axis
     private:
         Angle target;           // target axis position
 
-        struct timeval lastTime
-        {
-            0, 0
-        };
+        double lastTime { 0 };              // SimClock time of the last update, 0 before the first one
+        uint32_t lastGeneration { 0 };      // SimClock generation of lastTime
 
         bool tracking;      // this allows the tracking state and rate to be set independently
 
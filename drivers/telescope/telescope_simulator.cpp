@@ -21,6 +21,8 @@
 
 #include "indicom.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <memory>
@@ -89,6 +91,16 @@ bool ScopeSim::initProperties()
     flipHourAngleNP.fill(getDeviceName(), "FLIP_HA", "Flip Posn.",
                          "Simulation", IP_WO, 0, IPS_IDLE);
 
+    simClockSP[CLOCK_SYSTEM].fill("CLOCK_SYSTEM", "System", ISS_ON);
+    simClockSP[CLOCK_SIMULATED].fill("CLOCK_SIMULATED", "Simulated", ISS_OFF);
+    simClockSP.fill(getDeviceName(), "SIM_CLOCK", "Clock", "Simulation", IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+    // With the simulated clock each poll advances the time by the step, at speed times the real time,
+    // or as fast as possible for a speed of 0
+    simClockNP[CLOCK_STEP].fill("CLOCK_STEP", "Step (s)", "%g", 0.001, 60, 0.05, 0.25);
+    simClockNP[CLOCK_SPEED].fill("CLOCK_SPEED", "Speed (x)", "%g", 0, 10000, 10, 100);
+    simClockNP.fill(getDeviceName(), "SIM_CLOCK_STEP", "Clock Step", "Simulation", IP_RW, 60, IPS_IDLE);
+
     mountAxisNP[PRIMARY].fill("PRIMARY", "Primary (Ha)", "%g", -180, 180, 0.01, 0);
     mountAxisNP[SECONDARY].fill("SECONDARY", "Secondary (Dec)", "%g", -180, 180, 0.01, 0);
     mountAxisNP.fill(getDeviceName(), "MOUNT_AXES", "Mount Axes",
@@ -144,6 +156,9 @@ void ScopeSim::ISGetProperties(const char *dev)
     defineProperty(mountAxisNP);
     defineProperty(flipHourAngleNP);
     flipHourAngleNP.load();
+    defineProperty(simClockSP);
+    defineProperty(simClockNP);
+    simClockNP.load();
 #endif
 }
 
@@ -213,6 +228,37 @@ bool ScopeSim::Disconnect()
     return true;
 }
 
+void ScopeSim::TimerHit()
+{
+#ifdef USE_SIM_TAB
+    if (isConnected() && SimClock::isSimulated())
+    {
+        SimClock::advance(simClockNP[CLOCK_STEP].getValue());
+        ReadScopeStatus();
+        SetTimer(nextSimulatedStep());
+        return;
+    }
+#endif
+
+    INDI::Telescope::TimerHit();
+}
+
+#ifdef USE_SIM_TAB
+uint32_t ScopeSim::nextSimulatedStep()
+{
+    double speed = simClockNP[CLOCK_SPEED].getValue();
+    if (speed <= 0)
+        return 0;
+
+    double now = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    // Keep the pace over many steps, but don't catch up more than a second of delays
+    m_SimClockDue = std::max(m_SimClockDue + simClockNP[CLOCK_STEP].getValue() / speed, now - 1);
+
+    return m_SimClockDue > now ? static_cast<uint32_t>(std::lround((m_SimClockDue - now) * 1000)) : 0;
+}
+#endif
+
 bool ScopeSim::ReadScopeStatus()
 {
     // new axis control
@@ -427,6 +473,15 @@ bool ScopeSim::ISNewNumber(const char *dev, const char *name, double values[], c
             alignment.setFlipHourAngle(flipHourAngleNP[0].getValue());
             return true;
         }
+
+        if (simClockNP.isNameMatch(name))
+        {
+            simClockNP.update(values, names, n);
+            simClockNP.setState(IPS_OK);
+            simClockNP.apply();
+            saveConfig(simClockNP);
+            return true;
+        }
 #endif
     }
 
@@ -460,6 +515,23 @@ bool ScopeSim::ISNewSwitch(const char *dev, const char *name, ISState *states, c
             updateMountAndPierSide();
             return true;
         }
+        if (simClockSP.isNameMatch(name))
+        {
+            if (!simClockSP.update(states, names, n))
+                return false;
+
+            bool simulated = simClockSP[CLOCK_SIMULATED].getState() == ISS_ON;
+            SimClock::setSimulated(simulated);
+            m_SimClockDue = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            simClockSP.setState(simulated ? IPS_BUSY : IPS_IDLE);
+            simClockSP.apply();
+            if (simulated)
+                LOGF_INFO("Simulated clock started, %g s per step at %gx real time.",
+                          simClockNP[CLOCK_STEP].getValue(), simClockNP[CLOCK_SPEED].getValue());
+            else
+                LOG_INFO("Back to the system clock.");
+            return true;
+        }
 #endif \
     // Slew mode
         if (SlewRateSP.isNameMatch(name))
@@ -616,6 +688,7 @@ bool ScopeSim::saveConfigItems(FILE *fp)
     simPierSideSP.save(fp);
     mountModelNP.save(fp);
     flipHourAngleNP.save(fp);
+    simClockNP.save(fp);
 
 #endif
     return true;
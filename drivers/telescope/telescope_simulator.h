@@ -49,6 +49,7 @@ class ScopeSim : public INDI::Telescope, public INDI::GuiderInterface
         virtual bool Connect() override;
         virtual bool Disconnect() override;
         virtual bool ReadScopeStatus() override;
+        virtual void TimerHit() override;
         virtual bool initProperties() override;
         virtual void ISGetProperties(const char *dev) override;
         virtual bool updateProperties() override;
@@ -162,6 +163,25 @@ class ScopeSim : public INDI::Telescope, public INDI::GuiderInterface
 
         INDI::PropertyNumber flipHourAngleNP {1};
 
+        // Simulated clock, advanced by a fixed step on each poll
+        INDI::PropertySwitch simClockSP {2};
+        enum
+        {
+            CLOCK_SYSTEM,
+            CLOCK_SIMULATED
+        };
+
+        INDI::PropertyNumber simClockNP {2};
+        enum
+        {
+            CLOCK_STEP,
+            CLOCK_SPEED
+        };
+
+        // Steady clock time the next simulated step is due
+        double m_SimClockDue { 0 };
+        uint32_t nextSimulatedStep();
+
 #endif
 
 };
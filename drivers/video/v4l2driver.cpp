@@ -173,6 +173,33 @@ bool V4L2_Driver::initProperties()
     IUFillTextVector(&PortTP, PortT, NARRAY(PortT), getDeviceName(), INDI::SP::DEVICE_PORT, "Ports", OPTIONS_TAB, IP_RW, 0,
                      IPS_IDLE);
 
+    /* Capture buffers and thread, used from the next connection */
+    CaptureBuffersNP[0].fill("COUNT", "Count", "%.f", 2, 32, 1, 4);
+    CaptureBuffersNP.fill(getDeviceName(), "V4L2_BUFFERS", "Buffers", OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+    CaptureBuffersNP.load();
+
+    CapturePrioritySP[CAPTURE_PRIORITY_NORMAL].fill("NORMAL", "Normal", ISS_ON);
+    CapturePrioritySP[CAPTURE_PRIORITY_REALTIME].fill("REALTIME", "Real-time", ISS_OFF);
+    CapturePrioritySP.fill(getDeviceName(), "V4L2_CAPTURE_PRIORITY", "Capture Priority", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0,
+                           IPS_IDLE);
+    CapturePrioritySP.load();
+
+    /* MJPEG decompression, the backends built in the decoder */
+    INDI::WidgetView<ISwitch> automatic;
+    automatic.fill("AUTO", "Auto", ISS_ON);
+    MJPEGDecoderSP.push(std::move(automatic));
+    for (const char *backend : v4l_base->decoder->getMJPEGBackends())
+    {
+        std::string element = backend;
+        std::replace(element.begin(), element.end(), ' ', '_');
+        INDI::WidgetView<ISwitch> one;
+        one.fill(element.c_str(), backend, ISS_OFF);
+        MJPEGDecoderSP.push(std::move(one));
+    }
+    MJPEGDecoderSP.fill(getDeviceName(), "V4L2_MJPEG_DECODER", "MJPEG Decoder", OPTIONS_TAB, IP_RW, ISR_1OFMANY, 0,
+                        IPS_IDLE);
+    MJPEGDecoderSP.load();
+    setMJPEGBackend();
 
     // Capture format.
     CaptureFormat mono = {"INDI_MONO", "Mono", 8};
@@ -263,6 +290,14 @@ void V4L2_Driver::initCamBase()
     v4l_base = new INDI::V4L2_Base();
 }
 
+bool V4L2_Driver::setMJPEGBackend()
+{
+    int const index = MJPEGDecoderSP.findOnSwitchIndex();
+    if (index <= 0)
+        return v4l_base->decoder->setMJPEGBackend("Auto");
+    return v4l_base->decoder->setMJPEGBackend(MJPEGDecoderSP[index].getLabel());
+}
+
 void V4L2_Driver::ISGetProperties(const char * dev)
 {
     if (dev != nullptr && strcmp(getDeviceName(), dev) != 0)
@@ -271,6 +306,10 @@ void V4L2_Driver::ISGetProperties(const char * dev)
     INDI::CCD::ISGetProperties(dev);
 
     defineProperty(&PortTP);
+    defineProperty(CaptureBuffersNP);
+    defineProperty(CapturePrioritySP);
+    if (MJPEGDecoderSP.size() > 1)
+        defineProperty(MJPEGDecoderSP);
 
     if (isConnected())
     {
@@ -415,6 +454,26 @@ bool V4L2_Driver::ISNewSwitch(const char * dev, const char * name, ISState * sta
     if (dev != nullptr && strcmp(getDeviceName(), dev) != 0)
         return true;
 
+    /* Capture thread priority, from the next stream */
+    if (CapturePrioritySP.isNameMatch(name))
+    {
+        CapturePrioritySP.update(states, names, n);
+        CapturePrioritySP.setState(IPS_OK);
+        CapturePrioritySP.apply();
+        saveConfig(true, CapturePrioritySP.getName());
+        return true;
+    }
+
+    /* MJPEG decoder, from the next frame */
+    if (MJPEGDecoderSP.isNameMatch(name))
+    {
+        MJPEGDecoderSP.update(states, names, n);
+        MJPEGDecoderSP.setState(setMJPEGBackend() ? IPS_OK : IPS_ALERT);
+        MJPEGDecoderSP.apply();
+        saveConfig(true, MJPEGDecoderSP.getName());
+        return true;
+    }
+
     /* Input */
     if (strcmp(name, InputsSP.name) == 0)
     {
@@ -762,6 +821,19 @@ bool V4L2_Driver::ISNewNumber(const char * dev, const char * name, double values
     if (dev != nullptr && strcmp(getDeviceName(), dev) != 0)
         return true;
 
+    /* Buffer count, from the next time buffers are allocated */
+    if (CaptureBuffersNP.isNameMatch(name))
+    {
+        CaptureBuffersNP.update(values, names, n);
+        CaptureBuffersNP.setState(IPS_OK);
+        CaptureBuffersNP.apply();
+        v4l_base->setBufferCount(static_cast<unsigned int>(CaptureBuffersNP[0].getValue()));
+        if (isConnected())
+            LOG_INFO("The buffer count applies from the next connection or capture format change.");
+        saveConfig(true, CaptureBuffersNP.getName());
+        return true;
+    }
+
     /* Capture Size (Step/Continuous) */
     if (strcmp(name, CaptureSizesNP.name) == 0)
     {
@@ -1460,6 +1532,19 @@ void V4L2_Driver::newFrame()
         int dbpp              = 8;
         int totalBytes        = 0;
         unsigned char * buffer = nullptr;
+        // Capture time from the device, rather than the time the frame reaches the recorder
+        uint64_t const timestamp = v4l_base->getTimestamp();
+
+        // Raw 8 bit frames lent by the device are streamed as captured, the buffer is requeued once streamed
+        if (PrimaryCCD.getBinX() == 1)
+        {
+            auto frame = v4l_base->takeFrame();
+            if (!frame.empty())
+            {
+                Streamer->newFrame(std::move(frame), timestamp);
+                return;
+            }
+        }
 
         std::unique_lock<std::mutex> guard(ccdBufferLock);
 
@@ -1474,7 +1559,7 @@ void V4L2_Driver::newFrame()
             }
             guard.unlock();
 
-            Streamer->newFrame(buffer, totalBytes);
+            Streamer->newFrame(buffer, totalBytes, timestamp);
             return;
         }
 
@@ -1531,12 +1616,12 @@ void V4L2_Driver::newFrame()
             memcpy(PrimaryCCD.getFrameBuffer(), buffer, totalBytes);
             PrimaryCCD.binFrame();
             guard.unlock();
-            Streamer->newFrame(PrimaryCCD.getFrameBuffer(), frameBytes / PrimaryCCD.getBinX());
+            Streamer->newFrame(PrimaryCCD.getFrameBuffer(), frameBytes / PrimaryCCD.getBinX(), timestamp);
         }
         else
         {
             guard.unlock();
-            Streamer->newFrame(buffer, frameBytes);
+            Streamer->newFrame(buffer, frameBytes, timestamp);
         }
         return;
     }
@@ -1823,6 +1908,7 @@ bool V4L2_Driver::Connect()
     char errmsg[ERRMSGSIZ];
     if (!isConnected())
     {
+        v4l_base->setBufferCount(static_cast<unsigned int>(CaptureBuffersNP[0].getValue()));
         if (v4l_base->connectCam(PortT[0].text, errmsg) < 0)
         {
             LOGF_ERROR("Error: unable to open device %s: %s", PortT[0].text, errmsg);
@@ -2059,6 +2145,11 @@ bool V4L2_Driver::StartStreaming()
     auto onSwitch = IUFindOnSwitch(&CaptureFormatsSP);
     if (onSwitch && strstr(onSwitch->label, "JPEG"))
         v4l_base->setNative(true);
+    // Mono streams of NV12 cameras take the luma plane as it is captured
+    v4l_base->setZeroCopy(true, CaptureFormatSP[IMAGE_MONO].getState() == ISS_ON);
+    // Frames are read on a thread of their own while streaming. Exposures stay on the event loop, their
+    // completion drives timers, and iGuider/iPolar capture on after streaming stops.
+    v4l_base->setCaptureThread(!isIOptron(), CapturePrioritySP[CAPTURE_PRIORITY_REALTIME].getState() == ISS_ON);
     /* Callee will take care of checking states */
     return start_capturing(true);
 }
@@ -2074,6 +2165,8 @@ bool V4L2_Driver::StopStreaming()
     }
 
     v4l_base->setNative(EncodeFormatSP[FORMAT_NATIVE].getState() == ISS_ON);
+    v4l_base->setZeroCopy(false);
+    v4l_base->setCaptureThread(false);
     return stop_capturing();
 }
 
@@ -2082,6 +2175,10 @@ bool V4L2_Driver::saveConfigItems(FILE * fp)
     INDI::CCD::saveConfigItems(fp);
 
     IUSaveConfigText(fp, &PortTP);
+    CaptureBuffersNP.save(fp);
+    CapturePrioritySP.save(fp);
+    if (MJPEGDecoderSP.size() > 1)
+        MJPEGDecoderSP.save(fp);
     StackModeSP.save(fp);
 
     if (ImageAdjustNP.nnp > 0)
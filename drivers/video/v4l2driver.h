@@ -95,6 +95,8 @@ public:
         virtual bool StopStreaming() override;
 
         bool updateCaptureSize(uint32_t width, uint32_t height);
+        /* Applies the MJPEG decoder switch to the decoder */
+        bool setMJPEGBackend();
 
         /* Structs */
         typedef struct
@@ -119,6 +121,12 @@ public:
             IMAGE_RGB
         };
 
+        enum
+        {
+            CAPTURE_PRIORITY_NORMAL,
+            CAPTURE_PRIORITY_REALTIME
+        };
+
         enum stackmodes
         {
             STACK_NONE       = 0,
@@ -152,6 +160,8 @@ public:
         ISwitchVectorProperty FrameRatesSP;     /* Select Frame rate (Discrete) */
         ISwitchVectorProperty *Options;
         ISwitchVectorProperty ColorProcessingSP;
+        INDI::PropertySwitch  CapturePrioritySP {2}; /* Priority of the capture thread */
+        INDI::PropertySwitch  MJPEGDecoderSP {0};    /* Auto, then the MJPEG backends of the decoder */
 
         unsigned int v4loptions;
         unsigned int v4ladjustments;
@@ -162,6 +172,7 @@ public:
         INumberVectorProperty CaptureSizesNP; /* Select Capture size switch (Step/Continuous)*/
         INumberVectorProperty FrameRateNP;    /* Frame rate (Step/Continuous) */
         INumberVectorProperty ImageAdjustNP;  /* Image controls */
+        INDI::PropertyNumber  CaptureBuffersNP {1}; /* Number of device buffers */
 
         /* Text vectors */
         ITextVectorProperty PortTP;
@@ -33,6 +33,12 @@
  * 2017-01-29 JM: Added option to drop stream blobs if client blob queue is
  * higher than maxstreamsiz bytes
  *
+ * Clients may choose another stream BLOB policy with the policy attribute of
+ * enableBLOB: "drop" (default, as above), "latest" (only the latest unsent
+ * frame of each property is kept) or "block" (nothing dropped, the producing
+ * driver is not read while the client is more than maxqsiz bytes behind).
+ * The fps attribute limits the frames sent per property and second.
+ *
  * Implementation notes:
  *
  * We fork each driver and open a server socket listening for INDI clients.
@@ -42,29 +48,39 @@
  * one client or device, they are queued and only removed after the last
  * consumer is finished. XMLEle are converted to linear strings before being
  * sent to optimize write system calls and avoid blocking to slow clients.
- * Clients that get more than maxqsiz bytes behind are shut down.
+ * Clients that get more than maxqsiz bytes behind are shut down, except those
+ * of the "latest" stream BLOB policy.
  */
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE // needed for siginfo_t and sigaction
 #endif
 
 #include "config.h"
+#include <algorithm>
 #include <set>
 #include <string>
 #include <list>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
+#include <new>
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 
 #include <assert.h>
+#include <math.h>
 
 #include "indiapi.h"
 #include "indidevapi.h"
+#include "indicom.h"
+#include "indiframe.h"
+#include "indistreamcompression.h"
 #include "sharedblob.h"
 #include "lilxml.h"
 #include "base64.h"
+#include "userio.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -74,8 +90,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
 #include <poll.h>
 #include <unistd.h>
@@ -90,6 +108,7 @@
 #include <sys/mman.h>
 #include <unistd.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #ifdef MSG_ERRQUEUE
 #include <linux/errqueue.h>
 #endif
@@ -100,7 +119,15 @@
 #define INDIUNIXSOCK "/tmp/indiserver" /* default unix socket path (local connections) */
 #define MAXSBUF       512
 #define MAXRBUF       49152 /* max read buffering here */
+#define DRVCHANNELBUF (1 << 20) /* kernel buffering asked for the pipes to local drivers */
 #define MAXWSIZ       49152 /* max bytes/write */
+#define MAXWIOV       64    /* max chunks gathered per write */
+#define B64BLOCK      (3 * 16384) /* binary bytes per base64 chunk */
+#define MAXB64THREADS 4     /* max threads encoding one blob */
+#define PARSEOFFLOAD  (MAXRBUF / 2) /* reads at least this large are parsed off the loop */
+#define MAXPARSEBACKLOG (16 * MAXRBUF) /* stop reading a queue with this many bytes not parsed yet */
+#define DEFPARSETHREADS 0   /* default xml parsing threads, all parsed on the io threads */
+#define STALEDELAY    10    /* secs a restarted driver has to define again its cached properties */
 #define SHORTMSGSIZ   2048  /* buf size for most messages */
 #define DEFMAXQSIZ    128   /* default max q behind, MB */
 #define DEFMAXSSIZ    5     /* default max stream behind, MB */
@@ -114,7 +141,76 @@
 #define STRINGIFY_TOK(x) #x
 #define TO_STRING(x) STRINGIFY_TOK(x)
 
-static ev::default_loop loop;
+static struct ev_loop * loop = nullptr; /* the default loop, created by IoWorker::start */
+
+class ParseStrand;
+
+/* An event loop polling a share of the client and driver queues.
+ * The first worker is the default loop, run by the main thread. With -j N, N-1 more loops
+ * are run by their own threads.
+ * All loops run while holding serverLock, which is released only while a loop is
+ * waiting for events, and around read/write syscalls. Only the polling and the syscalls
+ * overlap: parsing, routing, serialization and Msg ownership run one loop at a time, so
+ * their CPU cost stays on one core whatever N. Only the ParseWorkers (-x) parse without the lock.
+ */
+class IoWorker
+{
+        struct ev_loop * evloop;
+        ev::async wake;
+        std::thread::id threadId;
+
+        static std::vector<IoWorker*> workers;
+        static unsigned int nextWorker;
+
+        /* Strands with parsed messages to deliver on this loop */
+        std::mutex parsedLock;
+        std::vector<std::shared_ptr<ParseStrand>> parsed;
+
+        IoWorker(struct ev_loop * evloop);
+
+        void wakeCb(ev::async &, int);
+
+        static void releaseCb(struct ev_loop *) noexcept;
+        static void acquireCb(struct ev_loop *) noexcept;
+
+        void run();
+    public:
+        struct ev_loop * getLoop() const
+        {
+            return evloop;
+        }
+
+        /* Make the loop notice watchers that were changed from another thread */
+        void wakeup();
+
+        /* Have the owner of strand handle its parsed messages on this loop. From any thread */
+        void post(const std::shared_ptr<ParseStrand> &strand);
+
+        /* Create the workers, with loops using the given libev backend flags.
+         * Must be called before any MsgQueue, or libev watcher, is created */
+        static void start(int count, unsigned int flags = EVFLAG_AUTO);
+
+        /* Select a worker for a new queue (round robin) */
+        static IoWorker * pick();
+
+        /* The worker running the default loop */
+        static IoWorker * main();
+
+        static bool threaded()
+        {
+            return workers.size() > 1;
+        }
+
+        /* Set flags to the libev flags for a backend name given to -b. False if unknown or not supported */
+        static bool parseBackend(const char * name, unsigned int &flags);
+        static const char * backendName(unsigned int backend);
+
+        static std::mutex serverLock;
+};
+
+std::vector<IoWorker*> IoWorker::workers;
+unsigned int IoWorker::nextWorker = 0;
+std::mutex IoWorker::serverLock;
 
 template<class M>
 class ConcurrentSet
@@ -251,6 +347,13 @@ class Collectable
         {
             return HeartBeat(id, current);
         }
+
+    public:
+        /* Identifier within the current ConcurrentSet. 0 if not in a set */
+        unsigned long getId() const
+        {
+            return id;
+        }
 };
 
 /**
@@ -271,9 +374,54 @@ class MsgChunck
         char * content;
         unsigned long contentLength;
 
+        /* BLOB payload of a format already compressed, sent as is by compressed streams */
+        bool incompressible;
+
         std::vector<int> sharedBufferIdsToAttach;
 };
 
+/* Recycles the small blocks allocated and released for every routed message: XML trees
+ * (installed in lilxml with indi_xmlMalloc), Msg and SerializedMsg.
+ * Free blocks are cached per thread, by power of two size class. Larger blocks go to malloc.
+ */
+class BlockPool
+{
+        static constexpr int classCount = 7;        /* 32 to 2048 bytes */
+        static constexpr size_t maxCached = 4096;   /* free blocks kept per class and thread */
+
+        /* Before every block. Keeps malloc alignment */
+        union Header
+        {
+            size_t size;        /* usable size */
+            max_align_t align;
+        };
+
+        struct Cache
+        {
+            std::vector<Header *> blocks[classCount];
+            ~Cache();
+        };
+        static thread_local Cache cache;
+
+        static int sizeClass(size_t size);
+    public:
+        static void * allocate(size_t size);
+        static void * reallocate(void * ptr, size_t size);
+        static void release(void * ptr);
+
+        /* allocate, throwing std::bad_alloc on failure, for operator new */
+        static void * allocateObject(size_t size)
+        {
+            void * ptr = allocate(size);
+            if (ptr == nullptr)
+                throw std::bad_alloc();
+            return ptr;
+        }
+
+        /* Route lilxml allocations to the pool. Before any XML is parsed */
+        static void install();
+};
+
 class Msg;
 class MsgQueue;
 class MsgChunckIterator;
@@ -374,14 +522,29 @@ class SerializedMsg
         SerializedMsg(Msg * parent);
         virtual ~SerializedMsg();
 
+        static void * operator new(size_t size)
+        {
+            return BlockPool::allocateObject(size);
+        }
+        static void operator delete(void * ptr)
+        {
+            BlockPool::release(ptr);
+        }
+
         // Calling requestContent will start production
         // Return true if some content is available
         bool requestContent(const MsgChunckIterator &position);
 
+        // Start production now, rather than when a queue gets to the message
+        void prepare();
+
         // Return true if some content is available
         // It is possible to have 0 to send, meaning end was actually reached
         bool getContent(MsgChunckIterator &position, void * &data, ssize_t &nsend, std::vector<int> &sharedBuffers);
 
+        // True if the content at position, available, is not worth compressing
+        bool isIncompressible(const MsgChunckIterator &position);
+
         void advance(MsgChunckIterator &position, ssize_t s);
 
         // When a queue is done with sending this message
@@ -390,6 +553,11 @@ class SerializedMsg
         void addAwaiter(MsgQueue * awaiter);
 
         ssize_t queueSize();
+
+        const Msg * getOwner() const
+        {
+            return owner;
+        }
 };
 
 class SerializedMsgWithSharedBuffer: public SerializedMsg
@@ -417,6 +585,40 @@ class SerializedMsgWithoutSharedBuffer: public SerializedMsg
         virtual void generateContent();
 };
 
+/* Base64 encode a binary buffer in B64BLOCK chunks, on several threads.
+ * Encoded chunks are collected in order with waitChunck, as soon as they are ready.
+ */
+class ParallelBase64Encoder
+{
+        const unsigned char * src;
+        unsigned long size;
+
+        std::vector<char *> buffers;
+        std::vector<int> lengths;
+        std::vector<bool> ready;
+        std::size_t nextChunck = 0;
+
+        std::mutex lock;
+        std::condition_variable cond;
+        std::vector<std::thread> threads;
+
+        void work();
+    public:
+        ParallelBase64Encoder(const unsigned char * src, unsigned long size, int threadCount);
+        ~ParallelBase64Encoder();
+
+        std::size_t chunckCount() const
+        {
+            return buffers.size();
+        }
+
+        /* Block until chunck id is encoded. The caller owns the returned buffer */
+        char * waitChunck(std::size_t id, int &len);
+
+        /* How many threads worth encoding this size */
+        static int threadsFor(unsigned long size);
+};
+
 class MsgChunckIterator
 {
         friend class SerializedMsg;
@@ -461,6 +663,15 @@ class Msg
         bool hasInlineBlobs;
         bool hasSharedBufferBlobs;
 
+        // Classification made once, when the message is built
+        bool hasStreamBlobs;    /* at least one blob has a stream format */
+        bool dropEligible;      /* setBLOBVector with stream blobs: may be dropped for lagging clients */
+        ssize_t blobBytes;      /* total size of the blobs, from their size attribute */
+        bool coalescable;       /* non BLOB set message: a newer one for the same property supersedes it */
+        bool setMessage;        /* set message, BLOB or not */
+        std::string device;
+        std::string name;
+
         std::vector<int> sharedBuffers; /* fds of shared buffer */
 
         // Convertion task and resultat of the task
@@ -489,8 +700,50 @@ class Msg
 
         Msg(MsgQueue * from, XMLEle * root);
 
+        static void * operator new(size_t size)
+        {
+            return BlockPool::allocateObject(size);
+        }
+        static void operator delete(void * ptr)
+        {
+            BlockPool::release(ptr);
+        }
+
         static Msg * fromXml(MsgQueue * from, XMLEle * root, std::list<int> &incomingSharedBuffers);
 
+        /* True if the message can be dropped for clients behind more than maxstreamsiz */
+        bool isDropEligible() const
+        {
+            return dropEligible;
+        }
+
+        /* Total size of the blobs carried by the message */
+        ssize_t getBlobBytes() const
+        {
+            return blobBytes;
+        }
+
+        /* True for set messages that only carry the latest value of a non BLOB property */
+        bool isCoalescable() const
+        {
+            return coalescable;
+        }
+
+        bool isSetMessage() const
+        {
+            return setMessage;
+        }
+
+        const std::string &getDevice() const
+        {
+            return device;
+        }
+
+        const std::string &getName() const
+        {
+            return name;
+        }
+
         /**
          * Handle multiple cases:
          *
@@ -514,26 +767,93 @@ class Msg
 
 class MsgQueue: public Collectable
 {
+        friend class UnlockedIo;
+        friend class Metrics;
+
         int rFd, wFd;
-        LilXML * lp;         /* XML parsing context */
+        LilXML * lp;         /* XML parsing context. Owned by parser once it exists */
+        std::shared_ptr<ParseStrand> parser; /* Parsing of large chunks by the ParseWorkers */
+        bool parseHeld = false;   /* reading held for the parser backlog */
+        bool closeAfterParse = false; /* EOF read while the parser was busy */
+        IoWorker * worker;   /* Loop handling the io events of this queue */
         ev::io   rio, wio;   /* Event loop io events */
         void ioCb(ev::io &watcher, int revents);
 
+        // Set while the worker performs a syscall for this queue without holding serverLock
+        bool ioInProgress = false;
+        // Deletion was requested while ioInProgress. The worker will do it when the syscall returns
+        bool deletePending = false;
+
         // Update the status of FD read/write ability
         void updateIos();
 
         std::set<SerializedMsg*> readBlocker;     /* The message that block this queue */
+        unsigned int readHolds = 0;               /* Reading is paused while positive (see holdReading) */
 
         std::list<SerializedMsg*> msgq;           /* To send msg queue */
+        unsigned long msgqBytes = 0;              /* storage size of msgq, kept as it changes */
+        unsigned long msgqSentBytes = 0;          /* part of it already written from the head message */
         std::list<int> incomingSharedBuffers; /* During reception, fds accumulate here */
 
         // Position in the head message
         MsgChunckIterator nsent;
+        bool wroteAny = false;                    /* something was written already */
+
+        /* Compression of what is written, once negotiated by startCompression */
+        std::unique_ptr<INDI::StreamCompression::Compressor> compressor;
+        std::vector<char> zout;                   /* compressed frames of messages already taken from msgq */
+        size_t zoutSent = 0;                      /* part of it already written */
+
+        /* Account for n bytes of the queued messages as sent. Consumes the completed ones */
+        void advanceSent(ssize_t n);
+
+        /* Write what is left of zout. False if this was closed or deleted meanwhile */
+        bool writeCompressed();
+
+        // Queued set messages that a newer one for the same device/property may still replace
+        std::map<std::pair<std::string, std::string>, std::list<SerializedMsg*>::iterator> pendingSets;
+
+        /* true if mp may replace, and be replaced by, a message for the same property */
+        bool canCoalesce(const Msg * mp) const;
+
+        /* replace a pending set message for the same property by serialized. Return true if done */
+        bool coalesce(const Msg * mp, SerializedMsg * serialized);
+
+        /* pending set messages of dev (all devices if empty) can no more be replaced */
+        void forgetPendingSets(const std::string &dev);
 
         // Handle fifo or socket case
         size_t doRead(char * buff, size_t len);
         void readFromFd();
 
+        /* True while chunks given to the parser are not all delivered. Inline parsing must wait */
+        bool parserBusy() const;
+
+        /* Hand a chunk to the ParseWorkers */
+        void parseLater(const char * buf, size_t nr);
+
+        /* Handle the messages of a parseXMLChunk result, then free it. False if this was deleted meanwhile */
+        bool dispatchNodes(XMLEle ** nodes);
+
+        /* Parse and handle XML read. False if this was closed or deleted meanwhile */
+        bool parseBytes(char * buf, size_t nr);
+
+        /* Members of the ids defined by INDI_FRAME_DEFNUMBER */
+        struct FrameNumber
+        {
+            std::string device, name;
+            std::vector<std::string> members;
+        };
+        bool framed = false;                    /* the peer may send frames in between XML, see indiframe.h */
+        std::vector<char> frame;                /* frame being read, header included */
+        std::vector<FrameNumber> frameNumbers;  /* index is id - 1 */
+
+        /* Split what was read into XML and frames */
+        void readFrames(char * buf, size_t nr);
+
+        /* Handle the complete frame. False if the peer broke the protocol, or this was closed or deleted */
+        bool onFrame();
+
         /* write the next chunk of the current message in the queue to the given
          * client. pop message from queue when complete and free the message if we are
          * the last one to use it. shut down this client if trouble.
@@ -542,10 +862,18 @@ class MsgQueue: public Collectable
 
     protected:
         bool useSharedBuffer;
+        // Keep only the latest unsent value of set messages for each property
+        bool coalesceSets = false;
+        // Same for stream BLOBs
+        bool coalesceBlobs = false;
         int getRFd() const
         {
             return rFd;
         }
+        IoWorker * getWorker() const
+        {
+            return worker;
+        }
         int getWFd() const
         {
             return wFd;
@@ -560,9 +888,27 @@ class MsgQueue: public Collectable
         /* Close the writing part of the connection. By default, shutdown the write part, but keep on reading. May delete this */
         virtual void closeWritePart();
 
+        /* Delete this. Deferred to the owning worker if it is currently blocked in a syscall for this queue */
+        void dispose();
+
+        /* True if a deferred deletion is pending. The queue must not be closed again */
+        bool isDisposing() const
+        {
+            return deletePending;
+        }
+
         /* Handle a message. root will be freed by caller. fds of buffers will be closed, unless set to -1 */
         virtual void onMessage(XMLEle *root, std::list<int> &sharedBuffers) = 0;
 
+        /* Called once the head message was fully sent and removed */
+        virtual void onHeadConsumed() {}
+
+        /* Compress all that is written from now on with the first codec offered that we have,
+         * after the acknowledgement for the peer. Only possible before anything is written, see indistreamcompression.h.
+         * Return true if done.
+         */
+        bool startCompression(const char *offered);
+
         /* convert the string value of enableBLOB to our B_ state value.
          * no change if unrecognized
          */
@@ -574,9 +920,15 @@ class MsgQueue: public Collectable
 
         void pushMsg(Msg * msg);
 
-        /* return storage size of all Msqs on the given q */
+        /* return storage size of all Msqs on the given q not written yet. O(1) */
         unsigned long msgQSize() const;
 
+        /* return number of Msgs on the given q */
+        unsigned long msgQCount() const
+        {
+            return msgq.size();
+        }
+
         SerializedMsg * headMsg() const;
         void consumeHeadMsg();
 
@@ -587,14 +939,107 @@ class MsgQueue: public Collectable
 
         void setFds(int rFd, int wFd);
 
+        /* Accept frames from the peer from now on, or not. Forgets the ids it defined */
+        void setFramed(bool framed);
+
+        /* Stop reading from this queue until the matching releaseReading. Calls nest */
+        void holdReading();
+        void releaseReading();
+
         virtual bool acceptSharedBuffers() const
         {
             return useSharedBuffer;
         }
 
         virtual void log(const std::string &log) const;
+
+        /* Handle the messages the ParseWorkers parsed. Called by the worker of the queue */
+        void onParsed();
 };
 
+/* Release serverLock while a queue performs a blocking syscall, when running with several io threads.
+ * Deletions of the queue requested meanwhile are deferred (see MsgQueue::dispose).
+ * errno is preserved.
+ */
+class UnlockedIo
+{
+        MsgQueue * q;
+        bool unlocked;
+    public:
+        UnlockedIo(MsgQueue * q): q(q), unlocked(IoWorker::threaded())
+        {
+            if (unlocked)
+            {
+                q->ioInProgress = true;
+                IoWorker::serverLock.unlock();
+            }
+        }
+
+        ~UnlockedIo()
+        {
+            if (unlocked)
+            {
+                int savedErrno = errno;
+                IoWorker::serverLock.lock();
+                q->ioInProgress = false;
+                errno = savedErrno;
+            }
+        }
+};
+
+/* The chunks read by one queue, parsed in order by the ParseWorkers, one at a time.
+ * Shared by the queue, the ParseWorkers and the loop delivering the result. Members are protected by lock
+ */
+class ParseStrand
+{
+    public:
+        std::mutex lock;
+        MsgQueue * owner;       /* nullptr once the queue is deleted */
+        IoWorker * worker;      /* loop of the owner */
+        LilXML * lp;            /* parsing context of the owner. Used here only while busy */
+
+        std::list<std::vector<char>> chunks;    /* read, not parsed yet */
+        unsigned long pendingBytes = 0;         /* size of chunks */
+        bool scheduled = false;                 /* queued to, or parsed by, a ParseWorkers thread */
+        std::list<XMLEle **> parsed;            /* parseXMLChunk results, not delivered yet */
+        std::string error;                      /* parse error, after parsed */
+
+        ParseStrand(MsgQueue * owner, IoWorker * worker, LilXML * lp): owner(owner), worker(worker), lp(lp) {}
+        ~ParseStrand();
+
+        bool busy() const
+        {
+            return scheduled || !chunks.empty() || !parsed.empty() || !error.empty();
+        }
+};
+
+/* Threads parsing large chunks (-x), so that a driver sending a large inline BLOB does not stall the loops.
+ * Never deleted: its threads run until exit
+ */
+class ParseWorkers
+{
+        std::mutex lock;
+        std::condition_variable cond;
+        std::list<std::shared_ptr<ParseStrand>> strands;   /* with chunks to parse */
+
+        void work();
+    public:
+        ParseWorkers(int threadCount);
+
+        /* Parse the chunks of strand. strand->scheduled must have been set */
+        void schedule(const std::shared_ptr<ParseStrand> &strand);
+};
+
+static ParseWorkers * parseWorkers = nullptr;
+
+/* What a client wants done with stream BLOBs when it falls behind */
+typedef enum
+{
+    BP_DROP = 0, /* drop frames beyond maxstreamsiz, shut down beyond maxqsiz */
+    BP_LATEST,   /* keep only the latest unsent frame of each property, never shut down */
+    BP_BLOCK     /* never drop: stop reading the producing driver beyond maxqsiz */
+} BLOBPolicy;
+
 /* device + property name */
 class Property
 {
@@ -603,7 +1048,36 @@ class Property
         std::string name;
         BLOBHandling blob = B_NEVER; /* when to snoop BLOBs */
 
+        bool latest = false;         /* snooped in latest-value mode (see LatestSnoops) */
+        double threshold = 0;        /* change of a number worth sending in latest-value mode */
+        /* state and values last sent in latest-value mode, by property name. The state is under an empty name */
+        std::map<std::string, std::map<std::string, std::string>> sent;
+
         Property(const std::string &dev, const std::string &name): dev(dev), name(name) {}
+
+        /* True if the state or a value of root differs from what was last sent of property prop.
+         * Record root as sent if so */
+        bool changed(const std::string &prop, XMLEle * root);
+
+        /* Record root as sent */
+        void remember(const std::string &prop, XMLEle * root);
+};
+
+/* Properties of interest, indexed by device and property name, for each queue id.
+ * An empty name registers the whole device.
+ * Routing a message costs O(subscribers) instead of a scan of every queue's property list.
+ */
+class SubscriptionIndex
+{
+        std::map<std::pair<std::string, std::string>, std::map<unsigned long, Property*>> entries;
+    public:
+        void add(unsigned long queueId, Property * prop);
+        void remove(unsigned long queueId, const Property * prop);
+
+        /* add the queues interested in dev/name to result.
+         * For queues that registered both, the Property for dev/name takes precedence over the one for the whole device
+         */
+        void collect(const std::string &dev, const std::string &name, std::map<unsigned long, Property*> &result) const;
 };
 
 
@@ -633,6 +1107,66 @@ class Fifo
 
 static Fifo * fifo = nullptr;
 
+/* Counters exported by the "metrics" fifo command, in Prometheus text format */
+class Metrics
+{
+        static constexpr int latencyBuckets = 6;
+        static const double latencyBounds[latencyBuckets];
+
+        ev::prepare prepareEv;
+        ev::check checkEv;
+        struct timespec wakeup;
+        bool awake = false;
+
+        void prepareCb(ev::prepare &watcher, int revents);
+        void checkCb(ev::check &watcher, int revents);
+    public:
+        std::map<std::string, unsigned long> routedByTag; /* messages read from queues, by root tag */
+        unsigned long blobBytesIn = 0;      /* BLOB bytes received from drivers and clients */
+        unsigned long blobBytesOut = 0;     /* BLOB bytes queued to clients and snooping drivers */
+        unsigned long streamBlobsDropped = 0; /* dropped for clients behind maxstreamsiz */
+        unsigned long clientsKilled = 0;    /* shut down for being behind maxqsiz */
+        unsigned long setsThrottled = 0;    /* driver set messages replaced by a newer one (-q) */
+        unsigned long snoopsDeferred = 0;   /* sets not sent to drivers snooping in latest-value mode */
+
+        unsigned long latencyCount[latencyBuckets + 1] = {}; /* loop iterations by duration, last is +Inf */
+        double latencySum = 0;
+
+        Metrics();
+
+        /* Measure main loop iterations */
+        void watch();
+
+        /* Write all metrics to path. Written to a temporary file, then renamed */
+        void dump(const std::string &path) const;
+};
+
+static Metrics * metrics = nullptr;
+
+/* Capture of the inbound traffic (-t), replayed by indi_replay.
+ * Each message is a header line "<us since start> <c|d> <queue id> <length>"
+ * followed by length bytes of xml and a newline. Attached BLOB payloads are not captured.
+ */
+class TrafficRecorder
+{
+        FILE *fp;
+        struct timespec start;
+        std::string buffer;
+        /* Flush once per loop iteration, not per message */
+        ev::prepare flushEv;
+
+        void flushCb(ev::prepare &watcher, int revents);
+    public:
+        TrafficRecorder(FILE *fp);
+
+        static TrafficRecorder * open(const char * path);
+
+        /* Record a message read from a client (c) or a driver (d) */
+        void record(char source, unsigned long id, XMLEle * root);
+};
+
+static TrafficRecorder * recorder = nullptr;
+
 
 class DvrInfo;
 
@@ -648,13 +1182,25 @@ class ClInfo: public MsgQueue
         /* Update the client property BLOB handling policy */
         void crackBLOBHandling(const std::string &dev, const std::string &name, const char *enableBLOB);
 
+        /* Update the client stream BLOB policy from the policy and fps attributes of enableBLOB */
+        void crackBLOBPolicy(XMLEle *root);
+
         /* close down the given client */
         virtual void close();
 
+        /* resume the drivers held while this client was too far behind */
+        virtual void onHeadConsumed();
+        void releaseDrivers();
+
+        std::map<std::pair<std::string, std::string>, ev_tstamp> lastStreamBlob; /* when the last frame was queued */
+        std::set<unsigned long> heldDrivers;    /* drivers not read until we catch up (BP_BLOCK) */
+
     public:
         std::list<Property*> props;     /* props we want */
         int allprops = 0;               /* saw getProperties w/o device */
         BLOBHandling blob = B_NEVER;    /* when to send setBLOBs */
+        BLOBPolicy blobPolicy = BP_DROP; /* what to do with stream BLOBs when behind */
+        double blobMaxFps = 0;          /* max stream BLOBs per second and property. 0 for no limit */
 
         ClInfo(bool useSharedBuffer);
         virtual ~ClInfo();
@@ -676,20 +1222,45 @@ class ClInfo: public MsgQueue
         /* put Msg mp on queue of each client interested in dev/name, except notme.
          * if BLOB always honor current mode.
          */
-        static void q2Clients(ClInfo *notme, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root);
+        static void q2Clients(ClInfo *notme, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root,
+                              DvrInfo *producer);
 
         /* Reference to all active clients */
         static ConcurrentSet<ClInfo> clients;
+
+        /* props of all clients */
+        static SubscriptionIndex subscriptions;
+
+        /* ids of clients with allprops set */
+        static std::set<unsigned long> allPropsClients;
 };
 
 /* info for each connected driver */
+class ThrottledProperty;
+
 class DvrInfo: public MsgQueue
 {
+        friend class ThrottledProperty;
+
         /* add dev/name to this device's snooping list.
          * init with blob mode set to B_NEVER.
          */
         void addSDevice(const std::string &dev, const std::string &name);
 
+        /* rate limited properties of this driver, by device and name (see RateLimits) */
+        std::map<std::pair<std::string, std::string>, ThrottledProperty*> throttled;
+
+        /* Keep root for later if its property is over its rate limit. Return true if kept */
+        bool throttle(XMLEle *root, const char *dev, const char *name);
+
+        /* send a set message to interested clients and snooping drivers */
+        void forwardSet(XMLEle *root, const char *dev, const char *name);
+
+        /* before a message other than a set of dev/name goes out: drop the held sets it makes stale, a
+         * definition or deletion, or send them first otherwise. an empty dev or name matches them all.
+         */
+        void releaseHeldSets(const char *roottag, const char *dev, const char *name);
+
     public:
         /* return Property if dp is this driver is snooping dev/name, else NULL.
          */
@@ -720,6 +1291,31 @@ class DvrInfo: public MsgQueue
 
         bool isHandlingDevice(const std::string &dev) const;
 
+        /* True if this was started as driver n (see the fifo stop command) */
+        virtual bool hasName(const std::string &n) const
+        {
+            return name == n;
+        }
+
+        /* Stop only the device started as driver n, if others keep the driver running. Return false if the whole
+         * driver has to stop for it.
+         */
+        virtual bool stopDevice(const std::string &n)
+        {
+            (void)n;
+            return false;
+        }
+
+        /* True if messages of dev are to be dropped, it was stopped while the driver runs on */
+        virtual bool ignoresDevice(const char *dev) const
+        {
+            (void)dev;
+            return false;
+        }
+
+        /* Tell the clients dev is gone */
+        void announceDeviceGone(const std::string &dev);
+
         /* start the INDI driver process or connection.
          * exit if trouble.
          */
@@ -748,6 +1344,9 @@ class DvrInfo: public MsgQueue
         /* Reference to all active drivers */
         static ConcurrentSet<DvrInfo> drivers;
 
+        /* sprops of all drivers */
+        static SubscriptionIndex snoopers;
+
         // decoding of attached blobs from driver is not supported ATM. Be conservative here
         virtual bool acceptSharedBuffers() const
         {
@@ -798,7 +1397,19 @@ class RemoteDvrInfo: public DvrInfo
          */
         int openINDIServer();
 
-        void extractRemoteId(const std::string &name, std::string &o_host, int &o_port, std::string &o_dev) const;
+        static void extractRemoteId(const std::string &name, std::string &o_host, int &o_port, std::string &o_dev);
+
+        /* more devices asked on this connection, with the names they were started with */
+        std::map<std::string, std::string> sharedDevices;
+
+        /* devices stopped while the connection stays up for others, the remote server still sends them */
+        std::set<std::string> stoppedDevices;
+
+        /* ask the remote server for dev */
+        void requestDevice(const std::string &dev);
+
+        /* connections limited to some devices, by remoteServerUid. Can be shared */
+        static std::map<std::string, RemoteDvrInfo*> connections;
 
     protected:
         RemoteDvrInfo(const RemoteDvrInfo &model);
@@ -812,6 +1423,18 @@ class RemoteDvrInfo: public DvrInfo
 
         virtual void start();
 
+        /* Start the remote driver name (dev@host:port). Several devices of the same server share one connection */
+        static void startShared(const std::string &name);
+
+        virtual bool hasName(const std::string &n) const;
+
+        virtual bool stopDevice(const std::string &n);
+
+        virtual bool ignoresDevice(const char *dev) const
+        {
+            return !stoppedDevices.empty() && stoppedDevices.count(dev);
+        }
+
         virtual RemoteDvrInfo * clone() const;
 
         virtual const std::string remoteServerUid() const
@@ -820,38 +1443,180 @@ class RemoteDvrInfo: public DvrInfo
         }
 };
 
-class TcpServer
+/* Local drivers started only on the first getProperties for one of their devices (-z).
+ * Their devices are read from a manifest in the drivers.xml format.
+ */
+class LazyDrivers
 {
-        int port;
-        int sfd = -1;
-        ev::io sfdev;
-
-        /* prepare for new client arriving on socket.
-         * exit if trouble.
-         */
-        void accept();
-        void ioCb(ev::io &watcher, int revents);
+        /* device names of each driver executable, from the manifest */
+        static std::map<std::string, std::set<std::string>> manifest;
+        /* drivers not started yet, with their devices */
+        static std::list<std::pair<std::string, std::set<std::string>>> pending;
     public:
-        TcpServer(int port);
+        static void loadManifest(const char * path);
 
-        /* create the public INDI Driver endpoint lsocket on port.
-         * return server socket else exit.
-         */
-        void listen();
-};
+        /* Keep the driver for later if the manifest knows its devices. Return true if kept */
+        static bool defer(const std::string &driver);
 
-#ifdef ENABLE_INDI_SHARED_MEMORY
+        /* Start the pending drivers handling dev. All of them if dev is empty */
+        static void wake(const std::string &dev);
+};
 
-class UnixServer
+/* Maximum rates of set messages from drivers, per device or property (-q).
+ * Messages coming faster are replaced by the latest one, sent when the interval expires.
+ * Changes of state to Ok or Alert always pass
+ */
+class RateLimits
 {
-        std::string path;
-        int sfd = -1;
-        ev::io sfdev;
+        /* minimal interval in seconds, by device and property. Empty property for the whole device */
+        static std::map<std::pair<std::string, std::string>, double> intervals;
+    public:
+        /* Parse device[.property]=hz. Return false if invalid */
+        static bool add(const char * spec);
 
-        void accept();
-        void ioCb(ev::io &watcher, int revents);
+        /* Minimal interval between set messages of dev/name. 0 if not limited */
+        static double interval(const std::string &dev, const std::string &name);
 
-        virtual void log(const std::string &log) const;
+        static bool empty()
+        {
+            return intervals.empty();
+        }
+};
+
+/* Last def and set state of each device (-k). Kept across driver restarts, so that clients get it
+ * on getProperties without waiting for the driver, and only see what a restarted driver changed.
+ * Once a client asks for them with a generation attribute in its getProperties, every change is stamped
+ * with a generation='epoch:counter' attribute. A reconnecting client gives back the last generation it saw,
+ * and is only sent what changed or was deleted since.
+ */
+class PropertyCache
+{
+        /* cached def, with the values of the later sets */
+        struct Entry
+        {
+            XMLEle * def = nullptr;     /* nullptr once deleted, kept for the clients that did not see it */
+            bool stale = false;         /* not defined again since its driver restarted */
+            unsigned long long generation = 0;
+        };
+        /* by device, then property name */
+        static std::map<std::string, std::map<std::string, Entry>> devices;
+        static ev::timer * staleTimer;
+        static std::string epoch;
+        static unsigned long long generation;
+        static bool stamping;       /* a client uses the generations */
+
+        static void staleCb(ev::timer &watcher, int revents);
+
+        /* Same content, except for the timestamp and formatting of values */
+        static bool sameDef(XMLEle * a, XMLEle * b);
+
+        /* Give entry a new generation, and write it in root */
+        static void stamp(Entry &entry, XMLEle * root);
+
+        /* Entry is deleted */
+        static void bury(Entry &entry);
+
+        /* The generation of a getProperties, 0 if none or given by a previous run of the server */
+        static unsigned long long since(const char * generation);
+    public:
+        static bool enabled;
+
+        /* Record a def, set or delProperty read from a driver.
+         * Return false for a def identical to the cached one, that clients need not see again */
+        static bool update(XMLEle * root);
+
+        /* Queue the cached defs of dev/name changed after generation to client, and the deletions since.
+         * All devices or properties if empty */
+        static void replay(ClInfo * client, const std::string &dev, const std::string &name, const char * generation);
+
+        /* The driver of devs restarts. Properties it does not define again within STALEDELAY are deleted */
+        static void restarting(const std::set<std::string> &devs);
+
+        /* The driver of dev is gone for good */
+        static void forget(const std::string &dev);
+};
+
+/* Latest def or set of the properties that some driver snoops in latest-value mode, with
+ * <getProperties device='dev' name='name' snoop='latest' threshold='x'/>.
+ * Such a driver is only sent the sets that change the state, a text or a switch, or a number by more than x since
+ * the last one it got, and asks for the latest value when it needs it with
+ * <getProperties device='dev' name='name' snoop='pull'/>, which is not a registration.
+ */
+class LatestSnoops
+{
+        /* by device and property name */
+        static std::map<std::pair<std::string, std::string>, XMLEle*> latest;
+    public:
+        /* Keep a copy of the def or set root of dev/name */
+        static void update(XMLEle * root, const std::string &dev, const std::string &name);
+
+        /* Forget dev/name, or all properties of dev if name is empty */
+        static void remove(const std::string &dev, const std::string &name);
+
+        /* Queue to dp the latest value of dev/name, or of all properties of dev if name is empty,
+         * that dp snoops in latest-value mode */
+        static void pull(DvrInfo * dp, const std::string &dev, const std::string &name);
+};
+
+/* One rate limited property of a driver, with the latest message held back */
+class ThrottledProperty
+{
+        DvrInfo * driver;
+        ev::timer timer;
+
+        void timerCb(ev::timer &watcher, int revents);
+    public:
+        std::string dev, name;
+        double interval;
+        ev_tstamp lastSent = 0;
+        std::string lastState;
+        XMLEle * held = nullptr;
+
+        ThrottledProperty(DvrInfo * driver, const std::string &dev, const std::string &name, double interval);
+        ~ThrottledProperty();
+
+        /* Send held when the interval since lastSent expires */
+        void schedule(ev_tstamp now);
+
+        /* Forget about held */
+        void drop();
+
+        /* Send held now */
+        void flush();
+};
+
+class TcpServer
+{
+        int port;
+        int sfd = -1;
+        ev::io sfdev;
+
+        /* prepare for new client arriving on socket.
+         * exit if trouble.
+         */
+        void accept();
+        void ioCb(ev::io &watcher, int revents);
+    public:
+        TcpServer(int port);
+
+        /* create the public INDI Driver endpoint lsocket on port.
+         * return server socket else exit.
+         */
+        void listen();
+};
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+
+class UnixServer
+{
+        std::string path;
+        int sfd = -1;
+        ev::io sfdev;
+
+        void accept();
+        void ioCb(ev::io &watcher, int revents);
+
+        virtual void log(const std::string &log) const;
     public:
         UnixServer(const std::string &path);
 
@@ -880,6 +1645,15 @@ static char *ldir;                                     /* where to log driver me
 static unsigned int maxqsiz  = (DEFMAXQSIZ * 1024 * 1024); /* kill if these bytes behind */
 static unsigned int maxstreamsiz  = (DEFMAXSSIZ * 1024 * 1024); /* drop blobs if these bytes behind while streaming*/
 static int maxrestarts   = DEFMAXRESTART;
+static bool coalesceClients = false;                   /* replace unsent set messages of clients by newer ones */
+
+/* lilxml atoms of the attributes read from every message, found by address */
+static const char *atomDevice = internXMLName("device");
+
+/* Property ids a driver may define with frames */
+#define MAXFRAMEIDS 65536
+static const char *atomName   = internXMLName("name");
+static const char *atomState  = internXMLName("state");
 
 static std::vector<XMLEle *> findBlobElements(XMLEle * root);
 
@@ -904,6 +1678,13 @@ int main(int ac, char *av[])
     /* save our name */
     me = av[0];
 
+    int ioThreads = 1;
+    int parseThreads = DEFPARSETHREADS;
+    unsigned int ioBackend = EVFLAG_AUTO;
+    const char * fifoPath = nullptr;
+    const char * lazyManifest = nullptr;
+    const char * recordPath = nullptr;
+
 #ifdef OSX_EMBEDED_MODE
 
     char logname[128];
@@ -911,8 +1692,7 @@ int main(int ac, char *av[])
     fprintf(stderr, "switching stderr to %s", logname);
     freopen(logname, "w", stderr);
 
-    fifo = new Fifo();
-    fifo->name = FIFONAME;
+    fifoPath  = FIFONAME;
     verbose   = 1;
     ac        = 0;
 
@@ -978,7 +1758,7 @@ int main(int ac, char *av[])
                         fprintf(stderr, "-f requires fifo node\n");
                         usage();
                     }
-                    fifo = new Fifo(*++av);
+                    fifoPath = *++av;
                     ac--;
                     break;
                 case 'r':
@@ -992,6 +1772,75 @@ int main(int ac, char *av[])
                         maxrestarts = 0;
                     ac--;
                     break;
+                case 'j':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-j requires number of polling threads\n");
+                        usage();
+                    }
+                    ioThreads = atoi(*++av);
+                    if (ioThreads < 1)
+                        ioThreads = 1;
+                    ac--;
+                    break;
+                case 'x':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-x requires number of xml parsing threads\n");
+                        usage();
+                    }
+                    parseThreads = atoi(*++av);
+                    if (parseThreads < 0)
+                        parseThreads = 0;
+                    ac--;
+                    break;
+                case 'b':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-b requires a libev backend name\n");
+                        usage();
+                    }
+                    if (!IoWorker::parseBackend(*++av, ioBackend))
+                        usage();
+                    ac--;
+                    break;
+                case 'c':
+                    coalesceClients = true;
+                    break;
+                case 'k':
+                    PropertyCache::enabled = true;
+                    break;
+                case 'q':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-q requires a rate limit\n");
+                        usage();
+                    }
+                    if (!RateLimits::add(*++av))
+                    {
+                        fprintf(stderr, "-q expects device[.property]=hz, got %s\n", *av);
+                        usage();
+                    }
+                    ac--;
+                    break;
+                case 'z':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-z requires a driver manifest\n");
+                        usage();
+                    }
+                    lazyManifest = *++av;
+                    ac--;
+                    break;
+                case 't':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-t requires a capture file\n");
+                        usage();
+                    }
+                    recordPath = *++av;
+                    ac--;
+                    break;
                 case 'v':
                     verbose++;
                     break;
@@ -1002,36 +1851,62 @@ int main(int ac, char *av[])
 #endif
 
     /* at this point there are ac args in av[] to name our drivers */
-    if (ac == 0 && !fifo)
+    if (ac == 0 && !fifoPath)
         usage();
 
     /* take care of some unixisms */
     noSIGPIPE();
 
-    /* start each driver */
+    /* recycle XML and message blocks */
+    BlockPool::install();
+
+    /* create the event loops before any queue */
+    IoWorker::start(ioThreads, ioBackend);
+    if (verbose > 0)
+        log(fmt("using libev backend %s\n", IoWorker::backendName(ev_backend(loop))));
+
+    if (parseThreads > 0)
+        parseWorkers = new ParseWorkers(parseThreads);
+
+    metrics = new Metrics();
+    metrics->watch();
+
+    if (recordPath)
+        recorder = TrafficRecorder::open(recordPath);
+
+    if (fifoPath)
+        fifo = new Fifo(fifoPath);
+
+    /* announce we are online. Clients connecting before the drivers reply get their definitions as they come */
+    (new TcpServer(port))->listen();
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    /* create a new unix server */
+    (new UnixServer(UnixServer::unixSocketPath))->listen();
+#endif
+
+    if (lazyManifest)
+        LazyDrivers::loadManifest(lazyManifest);
+
+    /* start each driver. Local ones are not waited for */
     while (ac-- > 0)
     {
         std::string dvrName = *av++;
         DvrInfo * dr;
         if (dvrName.find('@') != std::string::npos)
         {
-            dr = new RemoteDvrInfo();
+            RemoteDvrInfo::startShared(dvrName);
+            continue;
         }
         else
         {
+            if (lazyManifest && LazyDrivers::defer(dvrName))
+                continue;
             dr = new LocalDvrInfo();
         }
         dr->name = dvrName;
         dr->start();
     }
-
-    /* announce we are online */
-    (new TcpServer(port))->listen();
-
-#ifdef ENABLE_INDI_SHARED_MEMORY
-    /* create a new unix server */
-    (new UnixServer(UnixServer::unixSocketPath))->listen();
-#endif
     /* Load up FIFO, if available */
     if (fifo)
     {
@@ -1043,7 +1918,7 @@ int main(int ac, char *av[])
     }
 
     /* handle new clients and all io */
-    loop.loop();
+    ev_run(loop, 0);
 
     /* will not happen unless no more listener left ! */
     log("unexpected return from event loop\n");
@@ -1083,6 +1958,19 @@ static void usage(void)
     fprintf(stderr, " -p p     : alternate IP port, default %d\n", INDIPORT);
     fprintf(stderr, " -r r     : maximum driver restarts on error, default %d\n", DEFMAXRESTART);
     fprintf(stderr, " -f path  : Path to fifo for dynamic startup and shutdown of drivers.\n");
+    fprintf(stderr, "            \"metrics <file>\" written to the fifo dumps server metrics to <file>.\n");
+    fprintf(stderr, " -c       : for lagging clients, replace unsent set messages by newer values of the same property\n");
+    fprintf(stderr, " -k       : keep the properties of restarting drivers. Clients get them on getProperties, then only changes\n");
+    fprintf(stderr, "            Reconnecting clients giving their last generation only get what changed since\n");
+    fprintf(stderr, " -j n     : number of threads polling the clients and drivers, default 1\n");
+    fprintf(stderr, "            Only the polling and the socket reads and writes overlap, parsing and routing run one at a time\n");
+    fprintf(stderr, " -x n     : number of threads parsing large inputs off the io threads, default %d (parsed on the io threads)\n",
+            DEFPARSETHREADS);
+    fprintf(stderr, " -q d=hz  : at most hz set messages per second for each property of device d, or d.property.\n");
+    fprintf(stderr, "            Newer values replace the ones held back. Repeat for more devices\n");
+    fprintf(stderr, " -z file  : start the drivers listed in the drivers.xml style <file> on the first getProperties for their devices\n");
+    fprintf(stderr, " -b name  : libev backend: auto, select, poll, epoll, linuxaio, iouring or kqueue. default auto\n");
+    fprintf(stderr, " -t file  : record all messages read from clients and drivers to <file>, for indi_replay\n");
     fprintf(stderr, " -v       : show key events, no traffic\n");
     fprintf(stderr, " -vv      : -v + key message content\n");
     fprintf(stderr, " -vvv     : -vv + complete xml\n");
@@ -1101,6 +1989,23 @@ static void noSIGPIPE()
     (void)sigaction(SIGPIPE, &sa, NULL);
 }
 
+/* Grow the kernel buffering of a pipe to a local driver, so that a large inline BLOB crosses it in few handoffs.
+ * Best effort: the system may refuse or lower the size.
+ */
+static void enlargeDriverPipe(int fd)
+{
+#ifdef F_SETPIPE_SZ
+    /* Unprivileged processes are limited by /proc/sys/fs/pipe-max-size */
+    for (int size = DRVCHANNELBUF; size > 65536; size /= 2)
+    {
+        if (fcntl(fd, F_SETPIPE_SZ, size) >= 0)
+            break;
+    }
+#else
+    (void)fd;
+#endif
+}
+
 /* start the given local INDI driver process.
  * exit if trouble.
  */
@@ -1138,6 +2043,8 @@ void LocalDvrInfo::start()
             log(fmt("write pipe: %s\n", strerror(errno)));
             Bye();
         }
+        enlargeDriverPipe(rp[0]);
+        enlargeDriverPipe(wp[1]);
     }
     if (pipe(ep) < 0)
     {
@@ -1188,6 +2095,11 @@ void LocalDvrInfo::start()
             setenv("INDISKEL", envSkel.c_str(), 1);
         else if (fifo)
             unsetenv("INDISKEL");
+        /* Binary number updates, only over our own unix socket */
+        if (useSharedBuffer)
+            setenv(INDI_FRAME_ENV, "1", 1);
+        else
+            unsetenv(INDI_FRAME_ENV);
         std::string executable;
         if (!envPrefix.empty())
         {
@@ -1232,6 +2144,7 @@ void LocalDvrInfo::start()
 
         /* record pid, io channels, init lp and snoop list */
         setFds(ux[1], ux[1]);
+        setFramed(true);
         rp[0] = ux[1];
         wp[1] = ux[1];
     }
@@ -1243,6 +2156,7 @@ void LocalDvrInfo::start()
 
         /* record pid, io channels, init lp and snoop list */
         setFds(rp[0], wp[1]);
+        setFramed(false);
     }
 
     ::close(ep[1]);
@@ -1257,6 +2171,9 @@ void LocalDvrInfo::start()
     fcntl(this->efd, F_SETFL, fcntl(this->efd, F_GETFL, 0) | O_NONBLOCK);
     this->eio.start(this->efd, ev::READ);
 
+    // pid and stderr watchers live in the default loop. We may be restarting from another worker
+    IoWorker::main()->wakeup();
+
     /* first message primes driver to report its properties -- dev known
      * if restarting
      */
@@ -1271,7 +2188,7 @@ void LocalDvrInfo::start()
     pushMsg(mp);
 }
 
-void RemoteDvrInfo::extractRemoteId(const std::string &name, std::string &o_host, int &o_port, std::string &o_dev) const
+void RemoteDvrInfo::extractRemoteId(const std::string &name, std::string &o_host, int &o_port, std::string &o_dev)
 {
     char dev[MAXINDIDEVICE] = {0};
     char host[MAXSBUF] = {0};
@@ -1283,7 +2200,7 @@ void RemoteDvrInfo::extractRemoteId(const std::string &name, std::string &o_host
         // Device missing? Try a different syntax for all devices
         if (sscanf(name.c_str(), "@%[^:]:%d", host, &indi_port) < 1)
         {
-            log(fmt("Bad remote device syntax: %s\n", name.c_str()));
+            ::log(fmt("Bad remote device syntax: %s\n", name.c_str()));
             Bye();
         }
     }
@@ -1312,35 +2229,123 @@ void RemoteDvrInfo::start()
     if (verbose > 0)
         log(fmt("socket=%d\n", sockfd));
 
+    if (!dev.empty())
+    {
+        connections[remoteServerUid()] = this;
+
+        requestDevice(dev);
+        for (auto &shared : sharedDevices)
+            requestDevice(shared.first);
+        return;
+    }
+
+    XMLEle *root = addXMLEle(NULL, "getProperties");
+
+    // This informs downstream server that it is connecting to an upstream server
+    // and not a regular client. The difference is in how it treats snooping properties
+    // among properties.
+    addXMLAtt(root, "device", "*");
+    addXMLAtt(root, "version", TO_STRING(INDIV));
+
+    Msg *mp = new Msg(nullptr, root);
+
+    // pushmsg can kill this. do at end
+    pushMsg(mp);
+}
+
+void RemoteDvrInfo::requestDevice(const std::string &dev)
+{
     /* N.B. storing name now is key to limiting outbound traffic to this
      * dev.
      */
-    if (!dev.empty())
-        this->dev.insert(dev);
+    this->dev.insert(dev);
 
     /* Sending getProperties with device lets remote server limit its
      * outbound (and our inbound) traffic on this socket to this device.
      */
     XMLEle *root = addXMLEle(NULL, "getProperties");
+    addXMLAtt(root, "device", dev.c_str());
+    addXMLAtt(root, "version", TO_STRING(INDIV));
 
-    if (!dev.empty())
+    Msg *mp = new Msg(nullptr, root);
+
+    // pushmsg can kill this. do at end
+    pushMsg(mp);
+}
+
+void RemoteDvrInfo::startShared(const std::string &name)
+{
+    std::string host, dev;
+    int port;
+    extractRemoteId(name, host, port, dev);
+
+    // A connection for all devices is a chained server one: not shared
+    auto existing = connections.find(host + ":" + std::to_string(port));
+    if (dev.empty() || existing == connections.end() || existing->second->isDisposing())
+    {
+        DvrInfo * dp = new RemoteDvrInfo();
+        dp->name = name;
+        dp->start();
+        return;
+    }
+
+    RemoteDvrInfo * dp = existing->second;
+    if (dp->isHandlingDevice(dev) || dp->sharedDevices.count(dev))
+        return;
+    dp->stoppedDevices.erase(dev);
+
+    if (verbose > 0)
+        dp->log(fmt("sharing connection with %s\n", name.c_str()));
+    dp->sharedDevices[dev] = name;
+    dp->requestDevice(dev);
+}
+
+bool RemoteDvrInfo::hasName(const std::string &n) const
+{
+    if (name == n)
+        return true;
+    for (auto &shared : sharedDevices)
+    {
+        if (shared.second == n)
+            return true;
+    }
+    return false;
+}
+
+bool RemoteDvrInfo::stopDevice(const std::string &n)
+{
+    std::string device;
+    if (name == n)
     {
-        addXMLAtt(root, "device", dev.c_str());
-        addXMLAtt(root, "version", TO_STRING(INDIV));
+        if (sharedDevices.empty())
+            return false;
+
+        // Another device names the connection from now on, also for restarts
+        std::string remoteHost;
+        int remotePort;
+        extractRemoteId(name, remoteHost, remotePort, device);
+        name = sharedDevices.begin()->second;
+        sharedDevices.erase(sharedDevices.begin());
     }
     else
     {
-        // This informs downstream server that it is connecting to an upstream server
-        // and not a regular client. The difference is in how it treats snooping properties
-        // among properties.
-        addXMLAtt(root, "device", "*");
-        addXMLAtt(root, "version", TO_STRING(INDIV));
+        auto shared = std::find_if(sharedDevices.begin(), sharedDevices.end(), [&n](const std::pair<const std::string, std::string> &it)
+        {
+            return it.second == n;
+        });
+        if (shared == sharedDevices.end())
+            return false;
+        device = shared->first;
+        sharedDevices.erase(shared);
     }
 
-    Msg *mp = new Msg(nullptr, root);
+    if (verbose > 0)
+        log(fmt("stopping device %s, the connection stays up for the others\n", device.c_str()));
 
-    // pushmsg can kill this. do at end
-    pushMsg(mp);
+    dev.erase(device);
+    stoppedDevices.insert(device);
+    announceDeviceGone(device);
+    return true;
 }
 
 int RemoteDvrInfo::openINDIServer()
@@ -1527,39 +2532,450 @@ void UnixServer::accept()
 
 #endif // ENABLE_INDI_SHARED_MEMORY
 
-TcpServer::TcpServer(int port): port(port)
+std::map<std::string, std::set<std::string>> LazyDrivers::manifest;
+std::list<std::pair<std::string, std::set<std::string>>> LazyDrivers::pending;
+
+std::map<std::pair<std::string, std::string>, double> RateLimits::intervals;
+
+bool RateLimits::add(const char * spec)
 {
-    sfdev.set<TcpServer, &TcpServer::ioCb>(this);
+    const char * eq = strrchr(spec, '=');
+    if (eq == nullptr || eq == spec)
+        return false;
+
+    char * end;
+    double hz = strtod(eq + 1, &end);
+    if (*end != '\0' || !(hz > 0))
+        return false;
+
+    std::string target(spec, eq - spec);
+    std::string dev = target, name;
+    auto dot = target.find('.');
+    if (dot != std::string::npos)
+    {
+        dev = target.substr(0, dot);
+        name = target.substr(dot + 1);
+    }
+    intervals[std::make_pair(dev, name)] = 1 / hz;
+    return true;
 }
 
-void TcpServer::ioCb(ev::io &, int revents)
+double RateLimits::interval(const std::string &dev, const std::string &name)
 {
-    if (revents & EV_ERROR)
+    // The property limit takes precedence over the device one
+    auto it = intervals.find(std::make_pair(dev, name));
+    if (it == intervals.end())
+        it = intervals.find(std::make_pair(dev, std::string()));
+    return it == intervals.end() ? 0 : it->second;
+}
+
+std::map<std::string, std::map<std::string, PropertyCache::Entry>> PropertyCache::devices;
+ev::timer * PropertyCache::staleTimer = nullptr;
+std::string PropertyCache::epoch = std::to_string(time(nullptr));
+unsigned long long PropertyCache::generation = 0;
+bool PropertyCache::stamping = false;
+bool PropertyCache::enabled = false;
+
+static std::string trimmed(const char * str)
+{
+    std::string result(str);
+    auto first = result.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+        return std::string();
+    return result.substr(first, result.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+bool PropertyCache::sameDef(XMLEle * a, XMLEle * b)
+{
+    if (strcmp(tagXMLEle(a), tagXMLEle(b)) || nXMLEle(a) != nXMLEle(b))
+        return false;
+
+    int attCount = 0;
+    for (XMLAtt * ap = nextXMLAtt(a, 1); ap; ap = nextXMLAtt(a, 0))
     {
-        int sockErrno = readFdError(this->sfd);
-        if (sockErrno)
-        {
-            log(fmt("Error on tcp server socket: %s\n", strerror(sockErrno)));
-            Bye();
-        }
+        if (!strcmp(nameXMLAtt(ap), "timestamp") || !strcmp(nameXMLAtt(ap), "generation"))
+            continue;
+        XMLAtt * bp = findXMLAtt(b, nameXMLAtt(ap));
+        if (bp == nullptr || strcmp(valuXMLAtt(ap), valuXMLAtt(bp)))
+            return false;
+        attCount++;
     }
-    if (revents & EV_READ)
+    if (attCount != nXMLAtt(b) - (findXMLAtt(b, "timestamp") ? 1 : 0) - (findXMLAtt(b, "generation") ? 1 : 0))
+        return false;
+
+    if (trimmed(pcdataXMLEle(a)) != trimmed(pcdataXMLEle(b)))
+        return false;
+
+    for (XMLEle * ac = nextXMLEle(a, 1), * bc = nextXMLEle(b, 1); ac; ac = nextXMLEle(a, 0), bc = nextXMLEle(b, 0))
     {
-        accept();
+        if (!sameDef(ac, bc))
+            return false;
     }
+    return true;
 }
 
-void TcpServer::listen()
+void PropertyCache::stamp(Entry &entry, XMLEle * root)
 {
-    struct sockaddr_in serv_socket;
-    int reuse = 1;
+    entry.generation = ++generation;
+    if (!stamping)
+        return;
 
-    /* make socket endpoint */
-    if ((sfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
-    {
-        log(fmt("socket: %s\n", strerror(errno)));
-        Bye();
-    }
+    std::string value = epoch + ":" + std::to_string(generation);
+    XMLAtt * ap = findXMLAtt(root, "generation");
+    if (ap)
+        editXMLAtt(ap, value.c_str());
+    else
+        addXMLAtt(root, "generation", value.c_str());
+}
+
+void PropertyCache::bury(Entry &entry)
+{
+    delXMLEle(entry.def);
+    entry.def = nullptr;
+    entry.stale = false;
+    entry.generation = ++generation;
+}
+
+unsigned long long PropertyCache::since(const char * generation)
+{
+    const char * counter = strchr(generation, ':');
+    if (counter == nullptr || epoch.compare(0, std::string::npos, generation, counter - generation))
+        return 0;
+    return strtoull(counter + 1, nullptr, 10);
+}
+
+bool PropertyCache::update(XMLEle * root)
+{
+    const char * tag = tagXMLEle(root);
+    const char * dev = findXMLAttValu(root, atomDevice);
+    const char * name = findXMLAttValu(root, atomName);
+    if (!dev[0])
+        return true;
+
+    if (!strcmp(tag, "delProperty"))
+    {
+        if (!name[0])
+        {
+            forget(dev);
+            if (stamping)
+                addXMLAtt(root, "generation", (epoch + ":" + std::to_string(generation)).c_str());
+            return true;
+        }
+        auto it = devices.find(dev);
+        if (it != devices.end() && it->second.count(name))
+        {
+            Entry &entry = it->second[name];
+            bury(entry);
+            stamp(entry, root);
+        }
+        return true;
+    }
+
+    if (!strncmp(tag, "def", 3))
+    {
+        Entry &entry = devices[dev][name];
+        entry.stale = false;
+        if (entry.def && sameDef(entry.def, root))
+            return false;
+        if (entry.def)
+            delXMLEle(entry.def);
+        stamp(entry, root);
+        entry.def = cloneXMLEle(root, nullptr, nullptr);
+        return true;
+    }
+
+    // BLOB values are not kept
+    if (strncmp(tag, "set", 3) || !strcmp(tag, "setBLOBVector"))
+        return true;
+
+    auto dp = devices.find(dev);
+    if (dp == devices.end())
+        return true;
+    auto pp = dp->second.find(name);
+    if (pp == dp->second.end() || pp->second.def == nullptr)
+        return true;
+    XMLEle * def = pp->second.def;
+    stamp(pp->second, root);
+
+    for (const char * att : { "state", "timeout", "timestamp", "generation" })
+    {
+        XMLAtt * ap = findXMLAtt(root, att);
+        if (ap == nullptr)
+            continue;
+        XMLAtt * cached = findXMLAtt(def, att);
+        if (cached)
+            editXMLAtt(cached, valuXMLAtt(ap));
+        else
+            addXMLAtt(def, att, valuXMLAtt(ap));
+    }
+
+    for (XMLEle * one = nextXMLEle(root, 1); one; one = nextXMLEle(root, 0))
+    {
+        const char * elemName = findXMLAttValu(one, "name");
+        for (XMLEle * element = nextXMLEle(def, 1); element; element = nextXMLEle(def, 0))
+        {
+            if (!strcmp(findXMLAttValu(element, "name"), elemName))
+            {
+                editXMLEle(element, pcdataXMLEle(one));
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+void PropertyCache::replay(ClInfo * client, const std::string &dev, const std::string &name, const char * generation)
+{
+    unsigned long long known = since(generation);
+    stamping |= generation[0] != '\0';
+    bool allDevices = dev.empty() || dev == "*";
+    for (auto &device : devices)
+    {
+        if (!allDevices && device.first != dev)
+            continue;
+        for (auto &property : device.second)
+        {
+            const Entry &entry = property.second;
+            if ((known && entry.generation <= known) || (!name.empty() && property.first != name))
+                continue;
+
+            XMLEle * root;
+            if (entry.def)
+            {
+                root = cloneXMLEle(entry.def, nullptr, nullptr);
+                // cached before stamping started
+                if (stamping && entry.generation && findXMLAtt(root, "generation") == nullptr)
+                    addXMLAtt(root, "generation", (epoch + ":" + std::to_string(entry.generation)).c_str());
+            }
+            else if (known)
+            {
+                // deleted after the client last saw it
+                root = addXMLEle(NULL, "delProperty");
+                addXMLAtt(root, "device", device.first.c_str());
+                addXMLAtt(root, "name", property.first.c_str());
+                addXMLAtt(root, "generation", (epoch + ":" + std::to_string(entry.generation)).c_str());
+            }
+            else
+                continue;
+
+            Msg * mp = new Msg(nullptr, root);
+            client->pushMsg(mp);
+            mp->queuingDone();
+        }
+    }
+}
+
+void PropertyCache::restarting(const std::set<std::string> &devs)
+{
+    for (auto &dev : devs)
+    {
+        auto it = devices.find(dev);
+        if (it == devices.end())
+            continue;
+        for (auto &property : it->second)
+            property.second.stale = true;
+    }
+
+    if (staleTimer == nullptr)
+    {
+        staleTimer = new ev::timer(loop);
+        staleTimer->set<&PropertyCache::staleCb>();
+    }
+    staleTimer->stop();
+    staleTimer->start(STALEDELAY, 0);
+    IoWorker::main()->wakeup();
+}
+
+void PropertyCache::staleCb(ev::timer &, int)
+{
+    for (auto &device : devices)
+    {
+        for (auto &property : device.second)
+        {
+            Entry &entry = property.second;
+            if (!entry.stale || entry.def == nullptr)
+                continue;
+
+            XMLEle *root = addXMLEle(NULL, "delProperty");
+            addXMLAtt(root, "device", device.first.c_str());
+            addXMLAtt(root, "name", property.first.c_str());
+            bury(entry);
+            stamp(entry, root);
+            Msg *mp = new Msg(nullptr, root);
+            ClInfo::q2Clients(NULL, 0, device.first, property.first, mp, root, nullptr);
+            mp->queuingDone();
+        }
+    }
+}
+
+void PropertyCache::forget(const std::string &dev)
+{
+    auto it = devices.find(dev);
+    if (it == devices.end())
+        return;
+    for (auto &property : it->second)
+    {
+        if (property.second.def)
+            bury(property.second);
+    }
+}
+
+ThrottledProperty::ThrottledProperty(DvrInfo * driver, const std::string &dev, const std::string &name,
+                                     double interval):
+    driver(driver), timer(driver->getWorker()->getLoop()), dev(dev), name(name), interval(interval)
+{
+    timer.set<ThrottledProperty, &ThrottledProperty::timerCb>(this);
+}
+
+ThrottledProperty::~ThrottledProperty()
+{
+    drop();
+}
+
+void ThrottledProperty::schedule(ev_tstamp now)
+{
+    if (timer.is_active())
+        return;
+    timer.start(lastSent + interval - now, 0);
+    driver->getWorker()->wakeup();
+}
+
+void ThrottledProperty::drop()
+{
+    timer.stop();
+    if (held)
+    {
+        delXMLEle(held);
+        held = nullptr;
+    }
+}
+
+void ThrottledProperty::timerCb(ev::timer &, int)
+{
+    flush();
+}
+
+void ThrottledProperty::flush()
+{
+    timer.stop();
+    XMLEle * root = held;
+    held = nullptr;
+    if (root == nullptr)
+        return;
+
+    lastSent = ev_now(driver->getWorker()->getLoop());
+    lastState = findXMLAttValu(root, atomState);
+    driver->forwardSet(root, dev.c_str(), name.c_str());
+}
+
+void LazyDrivers::loadManifest(const char * path)
+{
+    FILE *fp = fopen(path, "r");
+    if (fp == nullptr)
+    {
+        log(fmt("Can't open driver manifest %s: %s\n", path, strerror(errno)));
+        Bye();
+    }
+
+    char errmsg[MAXRBUF];
+    LilXML *lp = newLilXML();
+    XMLEle *root = readXMLFile(fp, lp, errmsg);
+    delLilXML(lp);
+    fclose(fp);
+    if (root == nullptr)
+    {
+        log(fmt("Can't parse driver manifest %s: %s\n", path, errmsg));
+        Bye();
+    }
+
+    // <driversList><devGroup><device label='...'><driver name='...'>executable</driver>
+    for (XMLEle *group = nextXMLEle(root, 1); group != nullptr; group = nextXMLEle(root, 0))
+    {
+        for (XMLEle *device = nextXMLEle(group, 1); device != nullptr; device = nextXMLEle(group, 0))
+        {
+            XMLEle *driver = findXMLEle(device, "driver");
+            if (strcmp(tagXMLEle(device), "device") || driver == nullptr)
+                continue;
+
+            auto &devices = manifest[pcdataXMLEle(driver)];
+            const char *label = findXMLAttValu(device, "label");
+            const char *defaultName = findXMLAttValu(driver, "name");
+            if (label[0])
+                devices.insert(label);
+            if (defaultName[0])
+                devices.insert(defaultName);
+        }
+    }
+    delXMLEle(root);
+}
+
+bool LazyDrivers::defer(const std::string &driver)
+{
+    // The manifest gives executable names, the driver may be given by path
+    auto entry = manifest.find(driver);
+    if (entry == manifest.end())
+        entry = manifest.find(driver.substr(driver.rfind('/') + 1));
+    if (entry == manifest.end())
+        return false;
+
+    if (verbose > 0)
+        log(fmt("%s will start on demand\n", driver.c_str()));
+    pending.push_back(std::make_pair(driver, entry->second));
+    return true;
+}
+
+void LazyDrivers::wake(const std::string &dev)
+{
+    for (auto it = pending.begin(); it != pending.end(); )
+    {
+        if (!dev.empty() && it->second.count(dev) == 0)
+        {
+            ++it;
+            continue;
+        }
+
+        if (verbose > 0)
+            log(fmt("starting %s on demand\n", it->first.c_str()));
+        DvrInfo * dp = new LocalDvrInfo();
+        dp->name = it->first;
+        it = pending.erase(it);
+        dp->start();
+    }
+}
+
+TcpServer::TcpServer(int port): port(port)
+{
+    sfdev.set<TcpServer, &TcpServer::ioCb>(this);
+}
+
+void TcpServer::ioCb(ev::io &, int revents)
+{
+    if (revents & EV_ERROR)
+    {
+        int sockErrno = readFdError(this->sfd);
+        if (sockErrno)
+        {
+            log(fmt("Error on tcp server socket: %s\n", strerror(sockErrno)));
+            Bye();
+        }
+    }
+    if (revents & EV_READ)
+    {
+        accept();
+    }
+}
+
+void TcpServer::listen()
+{
+    struct sockaddr_in serv_socket;
+    int reuse = 1;
+
+    /* make socket endpoint */
+    if ((sfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        log(fmt("socket: %s\n", strerror(errno)));
+        Bye();
+    }
 
     /* bind to given port for any IP address */
     memset(&serv_socket, 0, sizeof(serv_socket));
@@ -1741,6 +3157,12 @@ void Fifo::processLine(const char * line)
         }
     }
 
+    if (!strcmp(cmd, "metrics"))
+    {
+        metrics->dump(tDriver);
+        return;
+    }
+
     bool startCmd;
     if (!strcmp(cmd, "start"))
         startCmd = 1;
@@ -1765,7 +3187,8 @@ void Fifo::processLine(const char * line)
         }
         else
         {
-            dp = new RemoteDvrInfo();
+            RemoteDvrInfo::startShared(tDriver);
+            return;
         }
         dp->name = tDriver;
         dp->start();
@@ -1776,11 +3199,20 @@ void Fifo::processLine(const char * line)
         {
             if (dp == nullptr) continue;
 
-            if (dp->name == tDriver)
+            if (dp->hasName(tDriver))
             {
                 /* If device name is given, check against it before shutting down */
                 if (tName[0] && !dp->isHandlingDevice(tName))
                     continue;
+
+                /* A connection shared by several remote devices stays up for the others */
+                if (dp->stopDevice(tDriver))
+                {
+                    if (verbose)
+                        log(fmt("FIFO: Stopping device of driver: %s\n", tDriver));
+                    break;
+                }
+
                 if (verbose)
                     log(fmt("FIFO: Shutting down driver: %s\n", tDriver));
 
@@ -1858,15 +3290,163 @@ void Fifo::ioCb(ev::io &, int revents)
     }
 }
 
+const double Metrics::latencyBounds[Metrics::latencyBuckets] = { 0.0001, 0.001, 0.01, 0.1, 1, 10 };
+
+Metrics::Metrics()
+{
+    prepareEv.set<Metrics, &Metrics::prepareCb>(this);
+    checkEv.set<Metrics, &Metrics::checkCb>(this);
+}
+
+void Metrics::watch()
+{
+    prepareEv.start();
+    checkEv.start();
+}
+
+void Metrics::checkCb(ev::check &, int)
+{
+    clock_gettime(CLOCK_MONOTONIC, &wakeup);
+    awake = true;
+}
+
+void Metrics::prepareCb(ev::prepare &, int)
+{
+    // An iteration runs from the wake up of the loop to the next wait
+    if (!awake)
+        return;
+    awake = false;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed = (now.tv_sec - wakeup.tv_sec) + (now.tv_nsec - wakeup.tv_nsec) / 1e9;
+
+    int bucket = 0;
+    while (bucket < latencyBuckets && elapsed > latencyBounds[bucket])
+        bucket++;
+    latencyCount[bucket]++;
+    latencySum += elapsed;
+}
+
+void Metrics::dump(const std::string &path) const
+{
+    std::string tmpPath = path + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "w");
+    if (fp == nullptr)
+    {
+        log(fmt("Can't write metrics to %s: %s\n", tmpPath.c_str(), strerror(errno)));
+        return;
+    }
+
+    fprintf(fp, "# TYPE indiserver_client_queue_bytes gauge\n");
+    for (auto cp : ClInfo::clients)
+        fprintf(fp, "indiserver_client_queue_bytes{client=\"%d\"} %lu\n", cp->getRFd(), cp->msgQSize());
+
+    fprintf(fp, "# TYPE indiserver_driver_queue_bytes gauge\n");
+    for (auto dp : DvrInfo::drivers)
+        fprintf(fp, "indiserver_driver_queue_bytes{driver=\"%s\"} %lu\n", dp->name.c_str(), dp->msgQSize());
+
+    fprintf(fp, "# TYPE indiserver_client_queue_messages gauge\n");
+    for (auto cp : ClInfo::clients)
+        fprintf(fp, "indiserver_client_queue_messages{client=\"%d\"} %lu\n", cp->getRFd(), cp->msgQCount());
+
+    fprintf(fp, "# TYPE indiserver_driver_queue_messages gauge\n");
+    for (auto dp : DvrInfo::drivers)
+        fprintf(fp, "indiserver_driver_queue_messages{driver=\"%s\"} %lu\n", dp->name.c_str(), dp->msgQCount());
+
+    fprintf(fp, "# TYPE indiserver_messages_routed_total counter\n");
+    for (auto &entry : routedByTag)
+        fprintf(fp, "indiserver_messages_routed_total{tag=\"%s\"} %lu\n", entry.first.c_str(), entry.second);
+
+    fprintf(fp, "# TYPE indiserver_blob_bytes_in_total counter\n");
+    fprintf(fp, "indiserver_blob_bytes_in_total %lu\n", blobBytesIn);
+    fprintf(fp, "# TYPE indiserver_blob_bytes_out_total counter\n");
+    fprintf(fp, "indiserver_blob_bytes_out_total %lu\n", blobBytesOut);
+    fprintf(fp, "# TYPE indiserver_stream_blobs_dropped_total counter\n");
+    fprintf(fp, "indiserver_stream_blobs_dropped_total %lu\n", streamBlobsDropped);
+    fprintf(fp, "# TYPE indiserver_clients_killed_total counter\n");
+    fprintf(fp, "indiserver_clients_killed_total %lu\n", clientsKilled);
+    fprintf(fp, "# TYPE indiserver_sets_throttled_total counter\n");
+    fprintf(fp, "indiserver_sets_throttled_total %lu\n", setsThrottled);
+    fprintf(fp, "# TYPE indiserver_snoops_deferred_total counter\n");
+    fprintf(fp, "indiserver_snoops_deferred_total %lu\n", snoopsDeferred);
+
+    fprintf(fp, "# TYPE indiserver_loop_iteration_seconds histogram\n");
+    unsigned long cumulated = 0;
+    for (int i = 0; i < latencyBuckets; ++i)
+    {
+        cumulated += latencyCount[i];
+        fprintf(fp, "indiserver_loop_iteration_seconds_bucket{le=\"%g\"} %lu\n", latencyBounds[i], cumulated);
+    }
+    cumulated += latencyCount[latencyBuckets];
+    fprintf(fp, "indiserver_loop_iteration_seconds_bucket{le=\"+Inf\"} %lu\n", cumulated);
+    fprintf(fp, "indiserver_loop_iteration_seconds_sum %g\n", latencySum);
+    fprintf(fp, "indiserver_loop_iteration_seconds_count %lu\n", cumulated);
+
+    if (fclose(fp) != 0 || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        log(fmt("Can't write metrics to %s: %s\n", path.c_str(), strerror(errno)));
+        unlink(tmpPath.c_str());
+    }
+}
+
+TrafficRecorder::TrafficRecorder(FILE *fp): fp(fp)
+{
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    flushEv.set<TrafficRecorder, &TrafficRecorder::flushCb>(this);
+    flushEv.start();
+}
+
+TrafficRecorder * TrafficRecorder::open(const char * path)
+{
+    FILE *fp = fopen(path, "w");
+    if (fp == nullptr)
+    {
+        log(fmt("Can't record traffic to %s: %s\n", path, strerror(errno)));
+        Bye();
+    }
+    return new TrafficRecorder(fp);
+}
+
+void TrafficRecorder::record(char source, unsigned long id, XMLEle * root)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long us = (now.tv_sec - start.tv_sec) * 1000000LL + (now.tv_nsec - start.tv_nsec) / 1000;
+
+    size_t len = sprlXMLEle(root, 0);
+    buffer.resize(len + 1);
+    sprXMLEle(&buffer[0], root, 0);
+
+    fprintf(fp, "%lld %c %lu %zu\n", us, source, id, len);
+    fwrite(buffer.data(), 1, len, fp);
+    fputc('\n', fp);
+}
+
+void TrafficRecorder::flushCb(ev::prepare &, int)
+{
+    if (fflush(fp) != 0)
+    {
+        log(fmt("Traffic recording stopped: %s\n", strerror(errno)));
+        flushEv.stop();
+        // Io threads may still be recording into the buffer. Just stop
+        recorder = nullptr;
+    }
+}
+
 // root will be released
 void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
 {
     char *roottag    = tagXMLEle(root);
 
-    const char *dev  = findXMLAttValu(root, "device");
-    const char *name = findXMLAttValu(root, "name");
+    const char *dev  = findXMLAttValu(root, atomDevice);
+    const char *name = findXMLAttValu(root, atomName);
     int isblob       = !strcmp(tagXMLEle(root), "setBLOBVector");
 
+    metrics->routedByTag[roottag]++;
+    if (recorder)
+        recorder->record('c', getId(), root);
+
     /* snag interested properties.
      * N.B. don't open to alldevs if seen specific dev already, else
      *   remote client connections start returning too much.
@@ -1876,16 +3456,25 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         // Signature for CHAINED SERVER
         // Not a regular client.
         if (dev[0] == '*' && !this->props.size())
+        {
             this->allprops = 2;
+            allPropsClients.insert(getId());
+        }
         else
             addDevice(dev, name, isblob);
     }
     else if (!strcmp(roottag, "getProperties") && !this->props.size() && this->allprops != 2)
+    {
         this->allprops = 1;
+        allPropsClients.insert(getId());
+    }
 
     /* snag enableBLOB -- send to remote drivers too */
     if (!strcmp(roottag, "enableBLOB"))
+    {
         crackBLOBHandling(dev, name, pcdataXMLEle(root));
+        crackBLOBPolicy(root);
+    }
 
     if (!strcmp(roottag, "pingRequest"))
     {
@@ -1897,6 +3486,13 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         return;
     }
 
+    /* the offer to compress is for this server only */
+    if (!strcmp(roottag, "getProperties") && findXMLAtt(root, "compress"))
+    {
+        startCompression(findXMLAttValu(root, "compress"));
+        rmXMLAtt(root, "compress");
+    }
+
     /* build a new message -- set content iff anyone cares */
     Msg* mp = Msg::fromXml(this, root, sharedBuffers);
     if (!mp)
@@ -1905,10 +3501,21 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         close();
         return;
     }
+    metrics->blobBytesIn += mp->getBlobBytes();
 
     /* send message to driver(s) responsible for dev */
     DvrInfo::q2RDrivers(dev, mp, root);
 
+    /* then start the drivers waiting for it. Their own getProperties will report to us */
+    if (!strcmp(roottag, "getProperties"))
+    {
+        LazyDrivers::wake(dev[0] == '*' ? "" : dev);
+
+        /* what the drivers already defined needs no round trip */
+        if (PropertyCache::enabled)
+            PropertyCache::replay(this, dev, name, findXMLAttValu(root, "generation"));
+    }
+
     /* JM 2016-05-18: Upstream client can be a chained INDI server. If any driver locally is snooping
     * on any remote drivers, we should catch it and forward it to the responsible snooping driver. */
     /* send to snooping drivers. */
@@ -1919,7 +3526,7 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
     /* echo new* commands back to other clients */
     if (!strncmp(roottag, "new", 3))
     {
-        q2Clients(this, isblob, dev, name, mp, root);
+        q2Clients(this, isblob, dev, name, mp, root, nullptr);
     }
 
     mp->queuingDone();
@@ -1928,10 +3535,14 @@ void ClInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
 void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
 {
     char *roottag    = tagXMLEle(root);
-    const char *dev  = findXMLAttValu(root, "device");
-    const char *name = findXMLAttValu(root, "name");
+    const char *dev  = findXMLAttValu(root, atomDevice);
+    const char *name = findXMLAttValu(root, atomName);
     int isblob       = !strcmp(tagXMLEle(root), "setBLOBVector");
 
+    metrics->routedByTag[roottag]++;
+    if (recorder)
+        recorder->record('d', getId(), root);
+
     if (verbose > 2)
         traceMsg("read ", root);
     else if (verbose > 1)
@@ -1940,11 +3551,36 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
                 tagXMLEle(root), findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
     }
 
+    if (dev[0] && ignoresDevice(dev))
+    {
+        delXMLEle(root);
+        return;
+    }
+
     /* that's all if driver is just registering a snoop */
     /* JM 2016-05-18: Send getProperties to upstream chained servers as well.*/
     if (!strcmp(roottag, "getProperties"))
     {
+        const char *snoop = findXMLAttValu(root, "snoop");
+
+        /* a pull is answered with what we have, it is not a new registration */
+        if (!strcmp(snoop, "pull"))
+        {
+            LatestSnoops::pull(this, dev, name);
+            delXMLEle(root);
+            return;
+        }
+
         this->addSDevice(dev, name);
+        if (!strcmp(snoop, "latest"))
+        {
+            Property *sp = findSDevice(dev, name);
+            if (sp && sp->name == name)
+            {
+                sp->latest = true;
+                sp->threshold = atof(findXMLAttValu(root, "threshold"));
+            }
+        }
         Msg *mp = new Msg(this, root);
         /* send to interested chained servers upstream */
         // FIXME: no use of root here
@@ -1953,6 +3589,10 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         // FIXME: no use of root here
         q2RDrivers(dev, mp, root);
 
+        /* Snooping on a device of a lazy driver starts it */
+        if (dev[0])
+            LazyDrivers::wake(dev);
+
         mp->queuingDone();
 
         return;
@@ -1979,35 +3619,122 @@ void DvrInfo::onMessage(XMLEle * root, std::list<int> &sharedBuffers)
         this->dev.insert(dev);
     }
 
-    /* log messages if any and wanted */
-    if (ldir)
-        logDMsg(root, dev);
+    /* log messages if any and wanted */
+    if (ldir)
+        logDMsg(root, dev);
+
+    if (!strcmp(roottag, "pingRequest"))
+    {
+        setXMLEleTag(root, "pingReply");
+
+        Msg * mp = new Msg(this, root);
+        pushMsg(mp);
+        mp->queuingDone();
+        return;
+    }
+
+    /* Definitions clients already have from the cache only go to snooping drivers */
+    bool unchanged = PropertyCache::enabled && !PropertyCache::update(root);
+
+    /* hold sets coming faster than their rate limit, and keep them behind what came before */
+    if (!throttled.empty() && strncmp(roottag, "set", 3))
+        releaseHeldSets(roottag, dev, name);
+    if (!isblob && !RateLimits::empty() && !strncmp(roottag, "set", 3) && throttle(root, dev, name))
+        return;
+
+    /* build a new message -- set content iff anyone cares */
+    Msg * mp = Msg::fromXml(this, root, sharedBuffers);
+    if (!mp)
+    {
+        close();
+        return;
+    }
+    metrics->blobBytesIn += mp->getBlobBytes();
+
+    /* send to interested clients */
+    if (!unchanged)
+        ClInfo::q2Clients(NULL, isblob, dev, name, mp, root, this);
+
+    /* send to snooping drivers */
+    DvrInfo::q2SDrivers(this, isblob, dev, name, mp, root);
+
+    /* set message content if anyone cares else forget it */
+    mp->queuingDone();
+}
+
+bool DvrInfo::throttle(XMLEle *root, const char *dev, const char *name)
+{
+    auto key = std::make_pair(std::string(dev), std::string(name));
+    auto it = throttled.find(key);
+    if (it == throttled.end())
+    {
+        double interval = RateLimits::interval(dev, name);
+        if (interval == 0)
+            return false;
+        it = throttled.insert(std::make_pair(key, new ThrottledProperty(this, dev, name, interval))).first;
+    }
+    ThrottledProperty * tp = it->second;
+
+    ev_tstamp now = ev_now(getWorker()->getLoop());
+    std::string state = findXMLAttValu(root, atomState);
 
-    if (!strcmp(roottag, "pingRequest"))
+    // Reaching a final state is never delayed. What was held is older
+    bool final = state != tp->lastState && (state == "Ok" || state == "Alert");
+    if (final || (tp->held == nullptr && now - tp->lastSent >= tp->interval))
     {
-        setXMLEleTag(root, "pingReply");
+        tp->drop();
+        tp->lastSent = now;
+        tp->lastState = state;
+        return false;
+    }
 
-        Msg * mp = new Msg(this, root);
-        pushMsg(mp);
-        mp->queuingDone();
-        return;
+    if (tp->held && *findXMLAttValu(tp->held, "message"))
+    {
+        // its message would be lost with it
+        XMLEle * held = tp->held;
+        tp->held = nullptr;
+        tp->lastSent = now;
+        tp->lastState = findXMLAttValu(held, atomState);
+        forwardSet(held, dev, name);
+    }
+    else if (tp->held)
+    {
+        delXMLEle(tp->held);
+        metrics->setsThrottled++;
+    }
+    tp->held = root;
+    tp->schedule(now);
+    return true;
+}
+
+void DvrInfo::releaseHeldSets(const char *roottag, const char *dev, const char *name)
+{
+    bool stale = !strncmp(roottag, "def", 3) || !strcmp(roottag, "delProperty");
+    for (auto &entry : throttled)
+    {
+        ThrottledProperty * tp = entry.second;
+        if (tp->held == nullptr || (dev[0] && tp->dev != dev) || (name[0] && tp->name != name))
+            continue;
+
+        if (stale)
+            tp->drop();
+        else
+            tp->flush();
     }
+}
 
-    /* build a new message -- set content iff anyone cares */
-    Msg * mp = Msg::fromXml(this, root, sharedBuffers);
+void DvrInfo::forwardSet(XMLEle *root, const char *dev, const char *name)
+{
+    std::list<int> noSharedBuffers;
+    Msg * mp = Msg::fromXml(this, root, noSharedBuffers);
     if (!mp)
     {
         close();
         return;
     }
 
-    /* send to interested clients */
-    ClInfo::q2Clients(NULL, isblob, dev, name, mp, root);
-
-    /* send to snooping drivers */
-    DvrInfo::q2SDrivers(this, isblob, dev, name, mp, root);
-
-    /* set message content if anyone cares else forget it */
+    ClInfo::q2Clients(NULL, 0, dev, name, mp, root, this);
+    DvrInfo::q2SDrivers(this, 0, dev, name, mp, root);
     mp->queuingDone();
 }
 
@@ -2019,10 +3746,13 @@ void DvrInfo::closeWritePart()
 
 void ClInfo::close()
 {
+    if (isDisposing())
+        return;
+
     if (verbose > 0)
         log("shut down complete - bye!\n");
 
-    delete(this);
+    dispose();
 
 #ifdef OSX_EMBEDED_MODE
     fprintf(stderr, "CLIENTS %d\n", clients.size());
@@ -2032,19 +3762,8 @@ void ClInfo::close()
 
 void DvrInfo::close()
 {
-    // Tell client driver is dead.
-    for (auto dev : dev)
-    {
-        /* Inform clients that this driver is dead */
-        XMLEle *root = addXMLEle(NULL, "delProperty");
-        addXMLAtt(root, "device", dev.c_str());
-
-        prXMLEle(stderr, root, 0);
-        Msg *mp = new Msg(this, root);
-
-        ClInfo::q2Clients(NULL, 0, dev.c_str(), "", mp, root);
-        mp->queuingDone();
-    }
+    if (isDisposing())
+        return;
 
     bool terminate;
     if (!restart)
@@ -2066,6 +3785,18 @@ void DvrInfo::close()
         }
     }
 
+    if (PropertyCache::enabled && !terminate)
+    {
+        // Clients keep the cached properties, unless the driver does not define them again
+        PropertyCache::restarting(dev);
+    }
+    else
+    {
+        // Tell client driver is dead.
+        for (auto dev : dev)
+            announceDeviceGone(dev);
+    }
+
 #ifdef OSX_EMBEDED_MODE
     fprintf(stderr, "STOPPED \"%s\"\n", name.c_str());
     fflush(stderr);
@@ -2074,7 +3805,7 @@ void DvrInfo::close()
     // FIXME: we loose stderr from dying driver
     if (terminate)
     {
-        delete(this);
+        dispose();
         if ((!fifo) && (drivers.ids().empty()))
             Bye();
         return;
@@ -2082,11 +3813,26 @@ void DvrInfo::close()
     else
     {
         DvrInfo * restarted = this->clone();
-        delete(this);
+        dispose();
         restarted->start();
     }
 }
 
+void DvrInfo::announceDeviceGone(const std::string &dev)
+{
+    /* Inform clients that this device is dead */
+    XMLEle *root = addXMLEle(NULL, "delProperty");
+    addXMLAtt(root, "device", dev.c_str());
+
+    prXMLEle(stderr, root, 0);
+    Msg *mp = new Msg(this, root);
+
+    ClInfo::q2Clients(NULL, 0, dev.c_str(), "", mp, root, this);
+    mp->queuingDone();
+
+    PropertyCache::forget(dev);
+}
+
 void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root)
 {
     char *roottag = tagXMLEle(root);
@@ -2139,16 +3885,26 @@ void DvrInfo::q2RDrivers(const std::string &dev, Msg *mp, XMLEle *root)
 void DvrInfo::q2SDrivers(DvrInfo *me, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root)
 {
     std::string meRemoteServerUid = me ? me->remoteServerUid() : "";
-    for (auto dpId : drivers.ids())
+    const char *roottag = tagXMLEle(root);
+    bool isSet = !strncmp(roottag, "set", 3);
+    bool isDef = !strncmp(roottag, "def", 3);
+    bool kept = false;
+
+    if (!strcmp(roottag, "delProperty"))
+        LatestSnoops::remove(dev, name);
+
+    /* drivers snooping for dev/name */
+    std::map<unsigned long, Property*> snooping;
+    snoopers.collect(dev, name, snooping);
+
+    for (auto entry : snooping)
     {
-        auto dp = drivers[dpId];
+        auto dp = drivers[entry.first];
         if (dp == nullptr) continue;
 
-        Property *sp = dp->findSDevice(dev, name);
+        Property *sp = entry.second;
 
-        /* nothing for dp if not snooping for dev/name or wrong BLOB mode */
-        if (!sp)
-            continue;
+        /* nothing for dp if wrong BLOB mode */
         if ((isblob && sp->blob == B_NEVER) || (!isblob && sp->blob == B_ONLY))
             continue;
 
@@ -2157,6 +3913,23 @@ void DvrInfo::q2SDrivers(DvrInfo *me, int isblob, const std::string &dev, const
         if ((!meRemoteServerUid.empty()) && dp->remoteServerUid() == meRemoteServerUid)
             continue;
 
+        /* in latest-value mode, sets that change too little wait for a pull */
+        if (sp->latest && !isblob && (isSet || isDef))
+        {
+            if (!kept)
+            {
+                LatestSnoops::update(root, dev, name);
+                kept = true;
+            }
+            if (isDef)
+                sp->remember(name, root);
+            else if (!sp->changed(name, root))
+            {
+                metrics->snoopsDeferred++;
+                continue;
+            }
+        }
+
         /* ok: queue message to this device */
         if (verbose > 1)
         {
@@ -2164,11 +3937,91 @@ void DvrInfo::q2SDrivers(DvrInfo *me, int isblob, const std::string &dev, const
                         tagXMLEle(root), findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
         }
 
+        metrics->blobBytesOut += mp->getBlobBytes();
+
         // pushmsg can kill dp. do at end
         dp->pushMsg(mp);
     }
 }
 
+bool Property::changed(const std::string &prop, XMLEle * root)
+{
+    auto last = sent.find(prop);
+    bool differs = last == sent.end();
+    bool isNumber = !strcmp(tagXMLEle(root), "setNumberVector");
+
+    XMLAtt * state = findXMLAtt(root, "state");
+    if (!differs && state && last->second[""] != valuXMLAtt(state))
+        differs = true;
+
+    for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr && !differs; ep = nextXMLEle(root, 0))
+    {
+        auto value = last->second.find(findXMLAttValu(ep, "name"));
+        if (value == last->second.end())
+        {
+            differs = true;
+            break;
+        }
+
+        double before, now;
+        if (isNumber && f_scansexa(value->second.c_str(), &before) == 0 && f_scansexa(pcdataXMLEle(ep), &now) == 0)
+            differs = fabs(now - before) > threshold;
+        else
+            differs = value->second != pcdataXMLEle(ep);
+    }
+
+    if (differs)
+        remember(prop, root);
+    return differs;
+}
+
+void Property::remember(const std::string &prop, XMLEle * root)
+{
+    auto &values = sent[prop];
+    XMLAtt * state = findXMLAtt(root, "state");
+    if (state)
+        values[""] = valuXMLAtt(state);
+    for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+        values[findXMLAttValu(ep, "name")] = pcdataXMLEle(ep);
+}
+
+std::map<std::pair<std::string, std::string>, XMLEle*> LatestSnoops::latest;
+
+void LatestSnoops::update(XMLEle * root, const std::string &dev, const std::string &name)
+{
+    XMLEle * &entry = latest[std::make_pair(dev, name)];
+    if (entry)
+        delXMLEle(entry);
+    entry = cloneXMLEle(root, nullptr, nullptr);
+}
+
+void LatestSnoops::remove(const std::string &dev, const std::string &name)
+{
+    auto it = latest.lower_bound(std::make_pair(dev, name));
+    while (it != latest.end() && it->first.first == dev && (name.empty() || it->first.second == name))
+    {
+        delXMLEle(it->second);
+        it = latest.erase(it);
+    }
+}
+
+void LatestSnoops::pull(DvrInfo * dp, const std::string &dev, const std::string &name)
+{
+    for (auto it = latest.lower_bound(std::make_pair(dev, name));
+            it != latest.end() && it->first.first == dev && (name.empty() || it->first.second == name); ++it)
+    {
+        Property *sp = dp->findSDevice(dev, it->first.second);
+        if (sp == nullptr || !sp->latest)
+            continue;
+
+        sp->remember(it->first.second, it->second);
+
+        Msg * mp = new Msg(nullptr, cloneXMLEle(it->second, nullptr, nullptr));
+        dp->pushMsg(mp);
+        mp->queuingDone();
+    }
+}
+
 void DvrInfo::addSDevice(const std::string &dev, const std::string &name)
 {
     Property *sp;
@@ -2182,6 +4035,7 @@ void DvrInfo::addSDevice(const std::string &dev, const std::string &name)
     sp = new Property(dev, name);
     sp->blob = B_NEVER;
     sprops.push_back(sp);
+    snoopers.add(getId(), sp);
 
     if (verbose)
         log(fmt("snooping on %s.%s\n", dev.c_str(), name.c_str()));
@@ -2198,19 +4052,32 @@ Property * DvrInfo::findSDevice(const std::string &dev, const std::string &name)
     return nullptr;
 }
 
-void ClInfo::q2Clients(ClInfo *notme, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root)
+void ClInfo::q2Clients(ClInfo *notme, int isblob, const std::string &dev, const std::string &name, Msg *mp, XMLEle *root,
+                       DvrInfo *producer)
 {
+    /* clients that want this dev/name, with their registration for it, if any */
+    std::map<unsigned long, Property*> interested;
+    if (dev.empty())
+    {
+        for (auto cpId : clients.ids())
+            interested[cpId] = nullptr;
+    }
+    else
+    {
+        for (auto cpId : allPropsClients)
+            interested[cpId] = nullptr;
+        subscriptions.collect(dev, name, interested);
+    }
+
     /* queue message to each interested client */
-    for (auto cpId : clients.ids())
+    for (auto entry : interested)
     {
-        auto cp = clients[cpId];
+        auto cp = clients[entry.first];
         if (cp == nullptr) continue;
 
-        /* cp in use? notme? want this dev/name? blob? */
+        /* cp in use? notme? blob? */
         if (cp == notme)
             continue;
-        if (cp->findDevice(dev, name) < 0)
-            continue;
 
         //if ((isblob && cp->blob==B_NEVER) || (!isblob && cp->blob==B_ONLY))
         if (!isblob && cp->blob == B_ONLY)
@@ -2220,15 +4087,10 @@ void ClInfo::q2Clients(ClInfo *notme, int isblob, const std::string &dev, const
         {
             if (cp->props.size() > 0)
             {
-                Property *blobp = nullptr;
-                for (auto pp : cp->props)
-                {
-                    if (pp->dev == dev && pp->name == name)
-                    {
-                        blobp = pp;
-                        break;
-                    }
-                }
+                /* registration for this exact property */
+                Property *blobp = entry.second;
+                if (blobp && blobp->name != name)
+                    blobp = nullptr;
 
                 if ((blobp && blobp->blob == B_NEVER) || (!blobp && cp->blob == B_NEVER))
                     continue;
@@ -2239,44 +4101,55 @@ void ClInfo::q2Clients(ClInfo *notme, int isblob, const std::string &dev, const
 
         /* shut down this client if its q is already too large */
         unsigned long ql = cp->msgQSize();
-        if (isblob && maxstreamsiz > 0 && ql > maxstreamsiz)
+        if (isblob && maxstreamsiz > 0 && ql > maxstreamsiz && mp->isDropEligible() && cp->blobPolicy == BP_DROP)
         {
             // Drop frames for streaming blobs
-            /* pull out each name/BLOB pair, decode */
-            XMLEle *ep      = NULL;
-            int streamFound = 0;
-            for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
-            {
-                if (strcmp(tagXMLEle(ep), "oneBLOB") == 0)
-                {
-                    XMLAtt *fa = findXMLAtt(ep, "format");
-
-                    if (fa && strstr(valuXMLAtt(fa), "stream"))
-                    {
-                        streamFound = 1;
-                        break;
-                    }
-                }
-            }
-            if (streamFound)
+            if (verbose > 1)
+                cp->log(fmt("%ld bytes behind. Dropping stream BLOB of %ld bytes...\n", ql, (long)mp->getBlobBytes()));
+            metrics->streamBlobsDropped++;
+            continue;
+        }
+        if (ql > maxqsiz && cp->blobPolicy == BP_BLOCK)
+        {
+            // Keep everything, but stop reading the driver until the client catches up
+            if (producer && cp->heldDrivers.insert(producer->getId()).second)
             {
-                if (verbose > 1)
-                    cp->log(fmt("%ld bytes behind. Dropping stream BLOB...\n", ql));
-                continue;
+                if (verbose)
+                    cp->log(fmt("%ld bytes behind, holding driver %s\n", ql, producer->name.c_str()));
+                producer->holdReading();
             }
         }
-        if (ql > maxqsiz)
+        else if (ql > maxqsiz && cp->blobPolicy != BP_LATEST)
         {
+            // Latest frames replace the queued ones, the backlog of those clients stays bounded
             if (verbose)
                 cp->log(fmt("%ld bytes behind, shutting down\n", ql));
+            metrics->clientsKilled++;
             cp->close();
             continue;
         }
 
+        if (isblob && cp->blobMaxFps > 0 && mp->isDropEligible())
+        {
+            // Throttle the frames of each property
+            ev_tstamp now = ev_time();
+            ev_tstamp &last = cp->lastStreamBlob[std::make_pair(dev, name)];
+            if (now - last < 1.0 / cp->blobMaxFps)
+            {
+                if (verbose > 1)
+                    cp->log(fmt("Dropping stream BLOB above %g fps\n", cp->blobMaxFps));
+                metrics->streamBlobsDropped++;
+                continue;
+            }
+            last = now;
+        }
+
         if (verbose > 1)
             cp->log(fmt("queuing <%s device='%s' name='%s'>\n",
                         tagXMLEle(root), findXMLAttValu(root, "device"), findXMLAttValu(root, "name")));
 
+        metrics->blobBytesOut += mp->getBlobBytes();
+
         // pushmsg can kill cp. do at end
         cp->pushMsg(mp);
     }
@@ -2328,6 +4201,7 @@ void ClInfo::q2Servers(DvrInfo *me, Msg *mp, XMLEle *root)
         {
             if (verbose)
                 cp->log(fmt("%ld bytes behind, shutting down\n", ql));
+            metrics->clientsKilled++;
             cp->close();
             continue;
         }
@@ -2348,52 +4222,125 @@ void MsgQueue::writeToFd()
     void * data;
     ssize_t nsend;
     std::vector<int> sharedBuffers;
+    std::vector<int> attachedBuffers;
+
+    /* what was compressed goes first */
+    if (zoutSent < zout.size())
+    {
+        writeCompressed();
+        return;
+    }
 
     /* get current message */
-    auto mp = headMsg();
-    if (mp == nullptr)
+    if (headMsg() == nullptr)
     {
         log("Unexpected write notification");
         return;
     }
 
+    /* gather the ready chunks of the queued messages, never more than MAXWSIZ bytes to reduce blocking.
+     * buffers to attach must be sent with the first byte of their chunk, so such chunk starts a new write.
+     */
+    struct iovec iov[MAXWIOV];
+    bool incompressible[MAXWIOV];
+    int iovCount = 0;
+    ssize_t total = 0;
 
-    do
+    MsgChunckIterator pos = nsent;
+    for (auto it = msgq.begin(); it != msgq.end() && iovCount < MAXWIOV && total < MAXWSIZ; )
     {
-        if (!mp->getContent(nsent, data, nsend, sharedBuffers))
+        SerializedMsg * mp = *it;
+        if (!mp->getContent(pos, data, nsend, sharedBuffers))
         {
-            wio.stop();
-            return;
+            // Not produced yet
+            break;
         }
 
         if (nsend == 0)
         {
-            consumeHeadMsg();
-            mp = headMsg();
-            if (mp == nullptr)
+            // End of this message
+            ++it;
+            pos.reset();
+            continue;
+        }
+
+        if (!sharedBuffers.empty())
+        {
+            if (iovCount > 0)
+                break;
+            attachedBuffers = sharedBuffers;
+        }
+
+        if (nsend > MAXWSIZ - total)
+            nsend = MAXWSIZ - total;
+
+        iov[iovCount].iov_base = data;
+        iov[iovCount].iov_len = nsend;
+        incompressible[iovCount] = compressor && mp->isIncompressible(pos);
+        iovCount++;
+        total += nsend;
+
+        mp->advance(pos, nsend);
+    }
+
+    if (iovCount == 0)
+    {
+        // Only completed messages before one not produced yet: consume them, then wait for content
+        while (headMsg() != nullptr)
+        {
+            if (!headMsg()->getContent(nsent, data, nsend, sharedBuffers))
             {
+                wio.stop();
                 return;
             }
+            if (nsend != 0)
+                return;
+            consumeHeadMsg();
         }
+        return;
     }
-    while(nsend == 0);
 
-    /* send next chunk, never more than MAXWSIZ to reduce blocking */
-    if (nsend > MAXWSIZ)
-        nsend = MAXWSIZ;
+    wroteAny = true;
+
+    if (compressor)
+    {
+        /* the gathered chunks become the next frames, the messages are done with once compressed */
+        for (int i = 0; i < iovCount; ++i)
+        {
+            if (!compressor->add(iov[i].iov_base, iov[i].iov_len, incompressible[i], zout))
+            {
+                log("compression failed\n");
+                close();
+                return;
+            }
+        }
+        if (!compressor->flush(zout))
+        {
+            log("compression failed\n");
+            close();
+            return;
+        }
+
+        if (verbose > 1)
+            log(fmt("sending %zd bytes compressed to %zu\n", total, zout.size()));
+
+        advanceSent(total);
+        writeCompressed();
+        return;
+    }
 
     if (!useSharedBuffer)
     {
-        nw = write(wFd, data, nsend);
+        UnlockedIo io(this);
+        nw = writev(wFd, iov, iovCount);
     }
     else
     {
         struct msghdr msgh;
-        struct iovec iov[1];
         int cmsghdrlength;
         struct cmsghdr * cmsgh;
 
-        int fdCount = sharedBuffers.size();
+        int fdCount = attachedBuffers.size();
         if (fdCount > 0)
         {
             if (fdCount > MAXFD_PER_MESSAGE)
@@ -2416,7 +4363,7 @@ void MsgQueue::writeToFd()
             msgh.msg_controllen = cmsghdrlength;
             for(int i = 0; i < fdCount; ++i)
             {
-                ((int *) CMSG_DATA(CMSG_FIRSTHDR(&msgh)))[i] = sharedBuffers[i];
+                ((int *) CMSG_DATA(CMSG_FIRSTHDR(&msgh)))[i] = attachedBuffers[i];
             }
         }
         else
@@ -2427,20 +4374,26 @@ void MsgQueue::writeToFd()
             msgh.msg_controllen = cmsghdrlength;
         }
 
-        iov[0].iov_base = data;
-        iov[0].iov_len = nsend;
-
         msgh.msg_flags = 0;
         msgh.msg_name = NULL;
         msgh.msg_namelen = 0;
         msgh.msg_iov = iov;
-        msgh.msg_iovlen = 1;
+        msgh.msg_iovlen = iovCount;
 
-        nw = sendmsg(wFd, &msgh,  MSG_NOSIGNAL);
+        {
+            UnlockedIo io(this);
+            nw = sendmsg(wFd, &msgh,  MSG_NOSIGNAL);
+        }
 
         free(cmsgh);
     }
 
+    if (deletePending)
+    {
+        delete(this);
+        return;
+    }
+
     /* shut down if trouble */
     if (nw <= 0)
     {
@@ -2455,22 +4408,118 @@ void MsgQueue::writeToFd()
     }
 
     /* trace */
-    if (verbose > 2)
+    if (verbose > 1)
     {
-        log(fmt("sending msg nq %ld:\n%.*s\n",
-                msgq.size(), (int)nw, data));
+        ssize_t remaining = nw;
+        for (int i = 0; i < iovCount && remaining > 0; ++i)
+        {
+            int len = (ssize_t)iov[i].iov_len < remaining ? (int)iov[i].iov_len : (int)remaining;
+            if (verbose > 2)
+                log(fmt("sending msg nq %ld:\n%.*s\n", msgq.size(), len, (const char *)iov[i].iov_base));
+            else
+                log(fmt("sending %.*s\n", len, (const char *)iov[i].iov_base));
+            remaining -= len;
+        }
     }
-    else if (verbose > 1)
+
+    advanceSent(nw);
+}
+
+void MsgQueue::advanceSent(ssize_t n)
+{
+    void * data;
+    ssize_t nsend;
+    std::vector<int> sharedBuffers;
+
+    /* update amount sent. when complete: free message if we are the last
+     * to use it and pop from our queue.
+     */
+    ssize_t remaining = n;
+    while (remaining > 0)
+    {
+        auto mp = headMsg();
+        mp->getContent(nsent, data, nsend, sharedBuffers);
+        if (nsend == 0)
+        {
+            consumeHeadMsg();
+            continue;
+        }
+
+        ssize_t done = nsend < remaining ? nsend : remaining;
+        mp->advance(nsent, done);
+        remaining -= done;
+        if (nsent.done())
+            consumeHeadMsg();
+        else
+        {
+            // Written content may be larger than the storage size, with base64 BLOBs
+            msgqSentBytes = std::min<unsigned long>(msgqSentBytes + done, mp->queueSize());
+        }
+    }
+}
+
+bool MsgQueue::writeCompressed()
+{
+    ssize_t nw;
+    {
+        UnlockedIo io(this);
+        nw = write(wFd, zout.data() + zoutSent, zout.size() - zoutSent);
+    }
+
+    if (deletePending)
+    {
+        delete(this);
+        return false;
+    }
+
+    if (nw <= 0)
+    {
+        if (nw == 0)
+            log("write returned 0\n");
+        else
+            log(fmt("write: %s\n", strerror(errno)));
+
+        // Keep the read part open
+        closeWritePart();
+        return false;
+    }
+
+    zoutSent += nw;
+    if (zoutSent == zout.size())
+    {
+        zout.clear();
+        zoutSent = 0;
+        updateIos();
+    }
+    return true;
+}
+
+bool MsgQueue::startCompression(const char *offered)
+{
+    INDI::StreamCompression::Codec codec;
+
+    // The peer reads the stream plain until the acknowledgement
+    if (useSharedBuffer || compressor || wroteAny || !msgq.empty() || wFd == -1 ||
+            !INDI::StreamCompression::findCodec(offered, codec))
+        return false;
+
+    compressor.reset(new INDI::StreamCompression::Compressor(codec));
+    if (!compressor->isValid())
     {
-        log(fmt("sending %.*s\n", (int)nw, data));
+        compressor.reset();
+        return false;
     }
 
-    /* update amount sent. when complete: free message if we are the last
-     * to use it and pop from our queue.
-     */
-    mp->advance(nsent, nw);
-    if (nsent.done())
-        consumeHeadMsg();
+    std::string const ack = INDI::StreamCompression::acknowledgement(codec);
+    zout.assign(ack.begin(), ack.end());
+    zoutSent = 0;
+    wroteAny = true;
+
+    if (verbose)
+        log(fmt("compressing with %s\n", INDI::StreamCompression::codecName(codec)));
+
+    updateIos();
+    return true;
 }
 
 void MsgQueue::log(const std::string &str) const
@@ -2511,6 +4560,7 @@ void ClInfo::addDevice(const std::string &dev, const std::string &name, int isbl
     /* add */
     Property *pp = new Property(dev, name);
     props.push_back(pp);
+    subscriptions.add(getId(), pp);
 }
 
 void MsgQueue::crackBLOB(const char *enableBLOB, BLOBHandling *bp)
@@ -2546,6 +4596,46 @@ void ClInfo::crackBLOBHandling(const std::string &dev, const std::string &name,
     }
 }
 
+void ClInfo::crackBLOBPolicy(XMLEle *root)
+{
+    const char *policy = findXMLAttValu(root, "policy");
+    if (!strcmp(policy, "drop"))
+        blobPolicy = BP_DROP;
+    else if (!strcmp(policy, "latest"))
+        blobPolicy = BP_LATEST;
+    else if (!strcmp(policy, "block"))
+        blobPolicy = BP_BLOCK;
+
+    coalesceBlobs = (blobPolicy == BP_LATEST);
+    if (blobPolicy != BP_BLOCK)
+        releaseDrivers();
+
+    const char *fps = findXMLAttValu(root, "fps");
+    if (fps[0])
+        blobMaxFps = atof(fps) > 0 ? atof(fps) : 0;
+}
+
+void ClInfo::onHeadConsumed()
+{
+    // Resume with some margin, to not toggle at every message
+    if (!heldDrivers.empty() && msgQSize() < maxqsiz / 2)
+        releaseDrivers();
+}
+
+void ClInfo::releaseDrivers()
+{
+    for (auto dpId : heldDrivers)
+    {
+        auto dp = DvrInfo::drivers[dpId];
+        if (dp == nullptr) continue;
+
+        if (verbose)
+            log(fmt("releasing driver %s\n", dp->name.c_str()));
+        dp->releaseReading();
+    }
+    heldDrivers.clear();
+}
+
 void MsgQueue::traceMsg(const std::string &logMsg, XMLEle *root)
 {
     log(logMsg);
@@ -2637,6 +4727,279 @@ static void Bye()
     exit(1);
 }
 
+thread_local BlockPool::Cache BlockPool::cache;
+
+BlockPool::Cache::~Cache()
+{
+    for (auto &list : blocks)
+    {
+        for (auto block : list)
+            free(block);
+    }
+}
+
+int BlockPool::sizeClass(size_t size)
+{
+    int id = 0;
+    size_t classSize = 32;
+    while (classSize < size)
+    {
+        if (++id == classCount)
+            return -1;
+        classSize *= 2;
+    }
+    return id;
+}
+
+void * BlockPool::allocate(size_t size)
+{
+    int id = sizeClass(size);
+    Header * block;
+    if (id != -1 && !cache.blocks[id].empty())
+    {
+        block = cache.blocks[id].back();
+        cache.blocks[id].pop_back();
+        return block + 1;
+    }
+
+    size_t usable = id == -1 ? size : ((size_t)32) << id;
+    block = (Header *)malloc(sizeof(Header) + usable);
+    if (block == nullptr)
+        return nullptr;
+    block->size = usable;
+    return block + 1;
+}
+
+void * BlockPool::reallocate(void * ptr, size_t size)
+{
+    if (ptr == nullptr)
+        return allocate(size);
+
+    Header * block = ((Header *)ptr) - 1;
+    if (size <= block->size)
+        return ptr;
+
+    if (sizeClass(block->size) == -1)
+    {
+        // Already out of the pool: let realloc grow it in place if possible
+        block = (Header *)realloc(block, sizeof(Header) + size);
+        if (block == nullptr)
+            return nullptr;
+        block->size = size;
+        return block + 1;
+    }
+
+    void * result = allocate(size);
+    if (result == nullptr)
+        return nullptr;
+    memcpy(result, ptr, block->size);
+    release(ptr);
+    return result;
+}
+
+void BlockPool::release(void * ptr)
+{
+    if (ptr == nullptr)
+        return;
+
+    Header * block = ((Header *)ptr) - 1;
+    int id = sizeClass(block->size);
+    if (id == -1 || cache.blocks[id].size() >= maxCached)
+    {
+        free(block);
+        return;
+    }
+    cache.blocks[id].push_back(block);
+}
+
+void BlockPool::install()
+{
+    indi_xmlMalloc(&BlockPool::allocate, &BlockPool::reallocate, &BlockPool::release);
+}
+
+IoWorker::IoWorker(struct ev_loop * evloop): evloop(evloop), wake(evloop)
+{
+    wake.set<IoWorker, &IoWorker::wakeCb>(this);
+    wake.start();
+}
+
+void IoWorker::wakeup()
+{
+    if (threaded() && std::this_thread::get_id() != threadId)
+        wake.send();
+}
+
+void IoWorker::post(const std::shared_ptr<ParseStrand> &strand)
+{
+    {
+        std::lock_guard<std::mutex> guard(parsedLock);
+        parsed.push_back(strand);
+    }
+    wake.send();
+}
+
+void IoWorker::wakeCb(ev::async &, int)
+{
+    std::vector<std::shared_ptr<ParseStrand>> ready;
+    {
+        std::lock_guard<std::mutex> guard(parsedLock);
+        ready.swap(parsed);
+    }
+
+    for (auto &strand : ready)
+    {
+        // Previous deliveries may have deleted the owner
+        MsgQueue * owner;
+        {
+            std::lock_guard<std::mutex> guard(strand->lock);
+            owner = strand->owner;
+        }
+        if (owner)
+            owner->onParsed();
+    }
+}
+
+void IoWorker::releaseCb(struct ev_loop *) noexcept
+{
+    serverLock.unlock();
+}
+
+void IoWorker::acquireCb(struct ev_loop *) noexcept
+{
+    serverLock.lock();
+}
+
+void IoWorker::run()
+{
+    serverLock.lock();
+    ev_run(evloop, 0);
+    serverLock.unlock();
+}
+
+void IoWorker::start(int count, unsigned int flags)
+{
+    if (!workers.empty())
+        return;
+
+    const char * backend = (flags & EVBACKEND_MASK) ? backendName(flags & EVBACKEND_MASK) : "auto";
+
+    loop = ev_default_loop(flags);
+    if (!loop)
+    {
+        log(fmt("Could not create the event loop with libev backend %s\n", backend));
+        Bye();
+    }
+
+    workers.push_back(new IoWorker(loop));
+    workers[0]->threadId = std::this_thread::get_id();
+
+    if (count <= 1)
+        return;
+
+    // From now on, the main thread runs holding serverLock, like every worker
+    serverLock.lock();
+    ev_set_loop_release_cb(loop, &IoWorker::releaseCb, &IoWorker::acquireCb);
+
+    for (int i = 1; i < count; ++i)
+    {
+        struct ev_loop * evloop = ev_loop_new(flags);
+        if (!evloop)
+        {
+            log(fmt("Could not create the event loop of io thread %d with libev backend %s\n", i, backend));
+            Bye();
+        }
+        IoWorker * worker = new IoWorker(evloop);
+        ev_set_loop_release_cb(worker->evloop, &IoWorker::releaseCb, &IoWorker::acquireCb);
+        workers.push_back(worker);
+
+        std::thread t([worker]()
+        {
+            worker->run();
+        });
+        worker->threadId = t.get_id();
+        t.detach();
+    }
+
+    if (verbose > 0)
+        log(fmt("running %d io threads\n", count));
+}
+
+bool IoWorker::parseBackend(const char * name, unsigned int &flags)
+{
+    static const struct
+    {
+        const char * name;
+        unsigned int flags;
+    } backends[] =
+    {
+        { "auto", EVFLAG_AUTO },
+        { "select", EVBACKEND_SELECT },
+        { "poll", EVBACKEND_POLL },
+        { "epoll", EVBACKEND_EPOLL },
+#if EV_VERSION_MAJOR > 4 || (EV_VERSION_MAJOR == 4 && EV_VERSION_MINOR >= 31)
+        { "linuxaio", EVBACKEND_LINUXAIO },
+        { "iouring", EVBACKEND_IOURING },
+#endif
+        { "kqueue", EVBACKEND_KQUEUE },
+    };
+
+    for (auto &backend : backends)
+    {
+        if (!strcmp(name, backend.name))
+        {
+            if (backend.flags != EVFLAG_AUTO && !(ev_supported_backends() & backend.flags))
+            {
+                fprintf(stderr, "libev backend %s is not supported here\n", name);
+                return false;
+            }
+            // Never fall back silently to another backend
+            flags = backend.flags;
+            if (flags != EVFLAG_AUTO)
+                flags |= EVFLAG_NOENV;
+            return true;
+        }
+    }
+    fprintf(stderr, "unknown libev backend %s\n", name);
+    return false;
+}
+
+const char * IoWorker::backendName(unsigned int backend)
+{
+    switch (backend)
+    {
+        case EVBACKEND_SELECT:
+            return "select";
+        case EVBACKEND_POLL:
+            return "poll";
+        case EVBACKEND_EPOLL:
+            return "epoll";
+#if EV_VERSION_MAJOR > 4 || (EV_VERSION_MAJOR == 4 && EV_VERSION_MINOR >= 31)
+        case EVBACKEND_LINUXAIO:
+            return "linuxaio";
+        case EVBACKEND_IOURING:
+            return "iouring";
+#endif
+        case EVBACKEND_KQUEUE:
+            return "kqueue";
+        default:
+            return "other";
+    }
+}
+
+IoWorker * IoWorker::pick()
+{
+    if (workers.empty())
+        start(1);
+    return workers[(nextWorker++) % workers.size()];
+}
+
+IoWorker * IoWorker::main()
+{
+    if (workers.empty())
+        start(1);
+    return workers[0];
+}
+
 DvrInfo::DvrInfo(bool useSharedBuffer) :
     MsgQueue(useSharedBuffer),
     restarts(0)
@@ -2654,11 +5017,15 @@ DvrInfo::DvrInfo(const DvrInfo &model):
 
 DvrInfo::~DvrInfo()
 {
-    drivers.erase(this);
+    for (auto entry : throttled)
+        delete entry.second;
+
     for(auto prop : sprops)
     {
+        snoopers.remove(getId(), prop);
         delete prop;
     }
+    drivers.erase(this);
 }
 
 bool DvrInfo::isHandlingDevice(const std::string &dev) const
@@ -2676,6 +5043,7 @@ void DvrInfo::log(const std::string &str) const
 }
 
 ConcurrentSet<DvrInfo> DvrInfo::drivers;
+SubscriptionIndex DvrInfo::snoopers;
 
 LocalDvrInfo::LocalDvrInfo(): DvrInfo(true)
 {
@@ -2794,12 +5162,19 @@ RemoteDvrInfo::RemoteDvrInfo(): DvrInfo(false)
 
 RemoteDvrInfo::RemoteDvrInfo(const RemoteDvrInfo &model):
     DvrInfo(model),
+    sharedDevices(model.sharedDevices),
     host(model.host),
     port(model.port)
 {}
 
 RemoteDvrInfo::~RemoteDvrInfo()
-{}
+{
+    auto connection = connections.find(remoteServerUid());
+    if (connection != connections.end() && connection->second == this)
+        connections.erase(connection);
+}
+
+std::map<std::string, RemoteDvrInfo*> RemoteDvrInfo::connections;
 
 RemoteDvrInfo * RemoteDvrInfo::clone() const
 {
@@ -2808,15 +5183,20 @@ RemoteDvrInfo * RemoteDvrInfo::clone() const
 
 ClInfo::ClInfo(bool useSharedBuffer) : MsgQueue(useSharedBuffer)
 {
+    coalesceSets = coalesceClients;
     clients.insert(this);
 }
 
 ClInfo::~ClInfo()
 {
+    releaseDrivers();
+
     for(auto prop : props)
     {
+        subscriptions.remove(getId(), prop);
         delete prop;
     }
+    allPropsClients.erase(getId());
 
     clients.erase(this);
 }
@@ -2829,6 +5209,53 @@ void ClInfo::log(const std::string &str) const
 }
 
 ConcurrentSet<ClInfo> ClInfo::clients;
+SubscriptionIndex ClInfo::subscriptions;
+std::set<unsigned long> ClInfo::allPropsClients;
+
+void SubscriptionIndex::add(unsigned long queueId, Property * prop)
+{
+    entries[std::make_pair(prop->dev, prop->name)][queueId] = prop;
+}
+
+void SubscriptionIndex::remove(unsigned long queueId, const Property * prop)
+{
+    auto entry = entries.find(std::make_pair(prop->dev, prop->name));
+    if (entry == entries.end())
+        return;
+
+    auto queue = entry->second.find(queueId);
+    if (queue != entry->second.end() && queue->second == prop)
+        entry->second.erase(queue);
+
+    if (entry->second.empty())
+        entries.erase(entry);
+}
+
+void SubscriptionIndex::collect(const std::string &dev, const std::string &name,
+                                std::map<unsigned long, Property*> &result) const
+{
+    // Whole device first, so that an exact registration can override it
+    auto entry = entries.find(std::make_pair(dev, std::string()));
+    if (entry != entries.end())
+    {
+        for (auto queue : entry->second)
+        {
+            auto &current = result[queue.first];
+            if (current == nullptr)
+                current = queue.second;
+        }
+    }
+
+    if (name.empty())
+        return;
+
+    entry = entries.find(std::make_pair(dev, name));
+    if (entry != entries.end())
+    {
+        for (auto queue : entry->second)
+            result[queue.first] = queue.second;
+    }
+}
 
 SerializedMsg::SerializedMsg(Msg * parent) : asyncProgress(), owner(parent), awaiters(), chuncks(), ownBuffers()
 {
@@ -2963,6 +5390,16 @@ bool SerializedMsg::requestContent(const MsgChunckIterator &position)
     return false;
 }
 
+void SerializedMsg::prepare()
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+
+    if (asyncStatus == PENDING)
+    {
+        async_start();
+    }
+}
+
 bool SerializedMsg::getContent(MsgChunckIterator &from, void* &data, ssize_t &size,
                                std::vector<int, std::allocator<int> > &sharedBuffers)
 {
@@ -2999,6 +5436,13 @@ bool SerializedMsg::getContent(MsgChunckIterator &from, void* &data, ssize_t &si
     return true;
 }
 
+bool SerializedMsg::isIncompressible(const MsgChunckIterator &position)
+{
+    std::lock_guard<std::recursive_mutex> guard(lock);
+
+    return position.chunckId < chuncks.size() && chuncks[position.chunckId].incompressible;
+}
+
 void SerializedMsg::advance(MsgChunckIterator &iter, ssize_t s)
 {
     std::lock_guard<std::recursive_mutex> guard(lock);
@@ -3072,12 +5516,14 @@ MsgChunck::MsgChunck() : sharedBufferIdsToAttach()
 {
     content = nullptr;
     contentLength = 0;
+    incompressible = false;
 }
 
 MsgChunck::MsgChunck(char * content, unsigned long length) : sharedBufferIdsToAttach()
 {
     this->content = content;
     this->contentLength = length;
+    this->incompressible = false;
 }
 
 Msg::Msg(MsgQueue * from, XMLEle * ele): sharedBuffers()
@@ -3086,6 +5532,8 @@ Msg::Msg(MsgQueue * from, XMLEle * ele): sharedBuffers()
     xmlContent = ele;
     hasInlineBlobs = false;
     hasSharedBufferBlobs = false;
+    hasStreamBlobs = false;
+    blobBytes = 0;
 
     convertionToSharedBuffer = nullptr;
     convertionToInline = nullptr;
@@ -3102,7 +5550,21 @@ Msg::Msg(MsgQueue * from, XMLEle * ele): sharedBuffers()
         {
             hasInlineBlobs = true;
         }
+
+        XMLAtt *fa = findXMLAtt(blobContent, "format");
+        if (fa && strstr(valuXMLAtt(fa), "stream"))
+        {
+            hasStreamBlobs = true;
+        }
     }
+
+    const char * tag = tagXMLEle(xmlContent);
+    dropEligible = hasStreamBlobs && !strcmp(tag, "setBLOBVector");
+
+    device = findXMLAttValu(xmlContent, "device");
+    name = findXMLAttValu(xmlContent, "name");
+    setMessage = !strncmp(tag, "set", 3);
+    coalescable = setMessage && strcmp(tag, "setBLOBVector") && !device.empty() && !name.empty();
 }
 
 Msg::~Msg()
@@ -3223,6 +5685,7 @@ bool Msg::fetchBlobs(std::list<int> &incomingSharedBuffers)
             }
 
             queueSize += blobSize;
+            blobBytes += blobSize;
             //log("Found one fd !\n");
             int fd = *incomingSharedBuffers.begin();
             incomingSharedBuffers.pop_front();
@@ -3232,6 +5695,7 @@ bool Msg::fetchBlobs(std::list<int> &incomingSharedBuffers)
         else
         {
             // Check cdata length vs blobSize ?
+            blobBytes += blobSize;
         }
     }
     return true;
@@ -3261,9 +5725,15 @@ SerializedMsg * Msg::buildConvertionToSharedBuffer()
     }
 
     convertionToSharedBuffer = new SerializedMsgWithSharedBuffer(this);
-    if (hasInlineBlobs && from)
+    if (hasInlineBlobs)
     {
-        convertionToSharedBuffer->blockReceiver(from);
+        if (from)
+        {
+            convertionToSharedBuffer->blockReceiver(from);
+        }
+        // Decode the inline blobs once, as the message arrives, while the receivers send what they queued before.
+        // The local receivers share the result, the others send the base64 text as it came
+        convertionToSharedBuffer->prepare();
     }
     return convertionToSharedBuffer;
 }
@@ -3334,6 +5804,22 @@ bool SerializedMsgWithoutSharedBuffer::generateContentAsync() const
     return owner->hasInlineBlobs || owner->hasSharedBufferBlobs;
 }
 
+/* True for BLOB formats already compressed, as .fits.fz, .z (zlib compressed by the driver), .stream_jpg */
+static bool isCompressedFormat(const char * format)
+{
+    static const char * const extensions[] = { "z", "gz", "fz", "zst", "xz", "bz2", "lz4", "jpg", "jpeg", "png", "webp" };
+
+    const char * ext = std::max(strrchr(format, '.'), strrchr(format, '_'));
+    if (ext == nullptr)
+        return false;
+    for (auto known : extensions)
+    {
+        if (!strcasecmp(ext + 1, known))
+            return true;
+    }
+    return false;
+}
+
 void SerializedMsgWithoutSharedBuffer::generateContent()
 {
     // Convert every shared buffer into an inline base64
@@ -3344,6 +5830,7 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
     std::vector<int> sharedBuffers;
     std::vector<ssize_t> xmlSizes;
     std::vector<XMLEle *> sharedCData;
+    std::vector<bool> compressed;
 
     std::unordered_map<XMLEle*, XMLEle*> replacement;
 
@@ -3366,6 +5853,7 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
 
         replacement[blobContent] = clone;
         cdata.push_back(clone);
+        compressed.push_back(isCompressedFormat(findXMLAttValu(clone, "format")));
 
         if (attached == "true")
         {
@@ -3394,8 +5882,8 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
     {
         // Just print the content as is...
 
-        char * model = (char*)malloc(sprlXMLEle(xmlContent, 0) + 1);
-        int modelSize = sprXMLEle(model, xmlContent, 0);
+        char * model;
+        int modelSize = sprXMLEleAlloc(&model, xmlContent, 0, nullptr, nullptr, 0);
 
         ownBuffers.push_back(model);
 
@@ -3413,16 +5901,11 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
 
         std::vector<size_t> modelCdataOffset(cdata.size());
 
-        char * model = (char*)malloc(sprlXMLEle(xmlContent, 0) + 1);
-        int modelSize = sprXMLEle(model, xmlContent, 0);
+        // Print and get the element offsets
+        char * model;
+        int modelSize = sprXMLEleAlloc(&model, xmlContent, 0, cdata.data(), modelCdataOffset.data(), cdata.size());
 
         ownBuffers.push_back(model);
-
-        // Get the element offset
-        for(std::size_t i = 0; i < cdata.size(); ++i)
-        {
-            modelCdataOffset[i] = sprXMLCDataOffset(xmlContent, cdata[i], 0);
-        }
         delXMLEle(xmlContent);
 
         std::vector<int> fds(cdata.size());
@@ -3479,16 +5962,35 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
 
                 // split here in smaller chunks for faster startup
                 // This allow starting write before the whole blob is converted
+                int threadCount = ParallelBase64Encoder::threadsFor(buffSze);
+                if (threadCount > 1)
+                {
+                    // Large blob: chunks are encoded ahead on other threads, and pushed in order
+                    ParallelBase64Encoder encoder(src, buffSze, threadCount);
+                    for(std::size_t c = 0; c < encoder.chunckCount(); ++c)
+                    {
+                        int base64Count;
+                        char * buffer = encoder.waitChunck(c, base64Count);
+                        ownBuffers.push_back(buffer);
+                        MsgChunck chunck(buffer, base64Count);
+                        chunck.incompressible = compressed[i];
+                        async_pushChunck(chunck);
+                    }
+                    buffSze = 0;
+                }
+
                 while(buffSze > 0)
                 {
                     // We need a block size multiple of 24 bits (3 bytes)
-                    unsigned long sze = buffSze > 3 * 16384 ? 3 * 16384 : buffSze;
+                    unsigned long sze = buffSze > B64BLOCK ? B64BLOCK : buffSze;
 
                     char* buffer = (char*) malloc(4 * sze / 3 + 4);
                     ownBuffers.push_back(buffer);
                     int base64Count = to64frombits_s((unsigned char*)buffer, src, sze, (4 * sze / 3 + 4));
 
-                    async_pushChunck(MsgChunck(buffer, base64Count));
+                    MsgChunck chunck(buffer, base64Count);
+                    chunck.incompressible = compressed[i];
+                    async_pushChunck(chunck);
 
                     buffSze -= sze;
                     src += sze;
@@ -3506,7 +6008,9 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
 
                 auto len = pcdatalenXMLEle(sharedCData[i]);
                 auto data = pcdataXMLEle(sharedCData[i]);
-                async_pushChunck(MsgChunck(data, len));
+                MsgChunck chunck(data, len);
+                chunck.incompressible = compressed[i];
+                async_pushChunck(chunck);
             }
         }
 
@@ -3516,7 +6020,103 @@ void SerializedMsgWithoutSharedBuffer::generateContent()
             modelOffset = modelSize;
         }
     }
-    async_done();
+    async_done();
+}
+
+ParallelBase64Encoder::ParallelBase64Encoder(const unsigned char * src, unsigned long size, int threadCount):
+    src(src), size(size)
+{
+    std::size_t count = (size + B64BLOCK - 1) / B64BLOCK;
+    buffers.resize(count, nullptr);
+    lengths.resize(count, 0);
+    ready.resize(count, false);
+
+    for(int i = 0; i < threadCount; ++i)
+    {
+        threads.push_back(std::thread([this]()
+        {
+            work();
+        }));
+    }
+}
+
+ParallelBase64Encoder::~ParallelBase64Encoder()
+{
+    for(auto &t : threads)
+    {
+        t.join();
+    }
+    // Release what was not collected
+    for(std::size_t i = 0; i < buffers.size(); ++i)
+    {
+        if (buffers[i] != nullptr)
+        {
+            free(buffers[i]);
+        }
+    }
+}
+
+void ParallelBase64Encoder::work()
+{
+    while(true)
+    {
+        std::size_t id;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (nextChunck >= buffers.size())
+            {
+                return;
+            }
+            id = nextChunck++;
+        }
+
+        unsigned long offset = id * B64BLOCK;
+        unsigned long sze = size - offset > B64BLOCK ? B64BLOCK : size - offset;
+
+        char * buffer = (char*) malloc(4 * sze / 3 + 4);
+        int base64Count = to64frombits_s((unsigned char*)buffer, src + offset, sze, (4 * sze / 3 + 4));
+
+        std::lock_guard<std::mutex> guard(lock);
+        buffers[id] = buffer;
+        lengths[id] = base64Count;
+        ready[id] = true;
+        cond.notify_all();
+    }
+}
+
+char * ParallelBase64Encoder::waitChunck(std::size_t id, int &len)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    cond.wait(guard, [this, id]()
+    {
+        return ready[id];
+    });
+
+    char * buffer = buffers[id];
+    buffers[id] = nullptr;
+    len = lengths[id];
+    return buffer;
+}
+
+int ParallelBase64Encoder::threadsFor(unsigned long size)
+{
+    // Below 4 chuncks, thread startup dominates
+    unsigned long chuncks = (size + B64BLOCK - 1) / B64BLOCK;
+    if (chuncks < 4)
+    {
+        return 1;
+    }
+
+    int count = std::thread::hardware_concurrency();
+    if (count > MAXB64THREADS)
+    {
+        count = MAXB64THREADS;
+    }
+    if ((unsigned long)count > chuncks)
+    {
+        count = chuncks;
+    }
+    return count < 1 ? 1 : count;
 }
 
 bool SerializedMsgWithSharedBuffer::generateContentAsync() const
@@ -3532,6 +6132,19 @@ void SerializedMsgWithSharedBuffer::generateContent()
     std::vector<int> sharedBuffers = owner->sharedBuffers;
 
     std::unordered_map<XMLEle*, XMLEle*> replacement;
+
+    // The inline blobs to decode, and where their buffer goes among the attached ones
+    struct InlineBlob
+    {
+        int position;
+        char * base64data;
+        int base64datalen;
+        void * blob;
+        ssize_t size;
+        int actualLen;
+    };
+    std::vector<InlineBlob> inlineBlobs;
+
     int blobPos = 0;
     for(auto blobContent : findBlobElements(owner->xmlContent))
     {
@@ -3561,7 +6174,10 @@ void SerializedMsgWithSharedBuffer::generateContent()
                 size = 1;
             }
 
-            void * blob = IDSharedBlobAlloc(size);
+            // Decode straight into the memfd that will be sealed and handed to the receivers.
+            // Leave room for the whole decoded payload, a wrong size attribute must not overflow it
+            ssize_t room = std::max(size, (ssize_t)(3 * (base64datalen / 4)));
+            void * blob = IDSharedBlobAlloc(room);
             if (blob == nullptr)
             {
                 log(fmt("Unable to allocate shared buffer of size %d : %s\n", size, strerror(errno)));
@@ -3569,22 +6185,46 @@ void SerializedMsgWithSharedBuffer::generateContent()
             }
             log(fmt("Blob allocated at %p\n", blob));
 
-            int actualLen = from64tobits_fast((char*)blob, base64data, base64datalen);
+            inlineBlobs.push_back({blobPos, base64data, base64datalen, blob, size, 0});
+        }
+        blobPos++;
+    }
 
-            if (actualLen != size)
-            {
-                // FIXME: WTF ? at least prevent overflow ???
-                log(fmt("Blob size mismatch after base64dec: %lld vs %lld\n", (long long int)actualLen, (long long int)size));
-            }
+    // Each blob of the message is decoded on a thread of its own, large ones are split further by from64tobits_mt
+    std::vector<std::thread> decoders;
+    for(std::size_t i = 1; i < inlineBlobs.size(); ++i)
+    {
+        InlineBlob * inlineBlob = &inlineBlobs[i];
+        decoders.push_back(std::thread([inlineBlob]()
+        {
+            inlineBlob->actualLen = from64tobits_mt((char*)inlineBlob->blob, inlineBlob->base64data, inlineBlob->base64datalen);
+        }));
+    }
+    if (!inlineBlobs.empty())
+    {
+        InlineBlob &inlineBlob = inlineBlobs.front();
+        inlineBlob.actualLen = from64tobits_mt((char*)inlineBlob.blob, inlineBlob.base64data, inlineBlob.base64datalen);
+    }
+    for(auto &decoder : decoders)
+    {
+        decoder.join();
+    }
+
+    for(auto &inlineBlob : inlineBlobs)
+    {
+        if (inlineBlob.actualLen != inlineBlob.size)
+        {
+            log(fmt("Blob size mismatch after base64dec: %lld vs %lld\n", (long long int)inlineBlob.actualLen,
+                    (long long int)inlineBlob.size));
+        }
 
-            int newFd = IDSharedBlobGetFd(blob);
-            ownSharedBuffers.insert(newFd);
+        // Sealed as it gets its fd, every local receiver then shares the same buffer
+        int newFd = IDSharedBlobGetFd(inlineBlob.blob);
+        ownSharedBuffers.insert(newFd);
 
-            IDSharedBlobDettach(blob);
+        IDSharedBlobDettach(inlineBlob.blob);
 
-            sharedBuffers.insert(sharedBuffers.begin() + blobPos, newFd);
-        }
-        blobPos++;
+        sharedBuffers.insert(sharedBuffers.begin() + inlineBlob.position, newFd);
     }
 
     if (!replacement.empty())
@@ -3596,9 +6236,8 @@ void SerializedMsgWithSharedBuffer::generateContent()
     // Now create a Chunk from xmlContent
     MsgChunck chunck;
 
-    chunck.content = (char*)malloc(sprlXMLEle(xmlContent, 0) + 1);
+    chunck.contentLength = sprXMLEleAlloc(&chunck.content, xmlContent, 0, nullptr, nullptr, 0);
     ownBuffers.push_back(chunck.content);
-    chunck.contentLength = sprXMLEle(chunck.content, xmlContent, 0);
     chunck.sharedBufferIdsToAttach = sharedBuffers;
 
     async_pushChunck(chunck);
@@ -3613,6 +6252,9 @@ void SerializedMsgWithSharedBuffer::generateContent()
 MsgQueue::MsgQueue(bool useSharedBuffer): useSharedBuffer(useSharedBuffer)
 {
     lp = newLilXML();
+    worker = IoWorker::pick();
+    rio.set(worker->getLoop());
+    wio.set(worker->getLoop());
     rio.set<MsgQueue, &MsgQueue::ioCb>(this);
     wio.set<MsgQueue, &MsgQueue::ioCb>(this);
     rFd = -1;
@@ -3625,7 +6267,16 @@ MsgQueue::~MsgQueue()
     wio.stop();
 
     clearMsgQueue();
-    delLilXML(lp);
+    if (parser)
+    {
+        // A ParseWorkers thread may still use lp. The strand releases it
+        std::lock_guard<std::mutex> guard(parser->lock);
+        parser->owner = nullptr;
+    }
+    else
+    {
+        delLilXML(lp);
+    }
     lp = nullptr;
 
     setFds(-1, -1);
@@ -3633,12 +6284,25 @@ MsgQueue::~MsgQueue()
     /* unreference messages queue for this client */
     auto msgqcp = msgq;
     msgq.clear();
+    msgqBytes = 0;
+    msgqSentBytes = 0;
     for(auto mp : msgqcp)
     {
         mp->release(this);
     }
 }
 
+void MsgQueue::dispose()
+{
+    if (ioInProgress)
+    {
+        // The worker is blocked in a syscall that uses our fds. It will delete us
+        deletePending = true;
+        return;
+    }
+    delete(this);
+}
+
 void MsgQueue::closeWritePart()
 {
     if (wFd == -1)
@@ -3695,6 +6359,7 @@ void MsgQueue::setFds(int rFd, int wFd)
     this->rFd = rFd;
     this->wFd = wFd;
     this->nsent.reset();
+    msgqSentBytes = 0;
 
     if (rFd != -1)
     {
@@ -3710,6 +6375,13 @@ void MsgQueue::setFds(int rFd, int wFd)
     }
 }
 
+void MsgQueue::setFramed(bool framed)
+{
+    this->framed = framed;
+    frame.clear();
+    frameNumbers.clear();
+}
+
 SerializedMsg * MsgQueue::headMsg() const
 {
     if (msgq.empty()) return nullptr;
@@ -3719,11 +6391,20 @@ SerializedMsg * MsgQueue::headMsg() const
 void MsgQueue::consumeHeadMsg()
 {
     auto msg = headMsg();
+    if (!pendingSets.empty())
+    {
+        auto pending = pendingSets.find(std::make_pair(msg->getOwner()->getDevice(), msg->getOwner()->getName()));
+        if (pending != pendingSets.end() && pending->second == msgq.begin())
+            pendingSets.erase(pending);
+    }
     msgq.pop_front();
+    msgqBytes -= sizeof(Msg) + msg->queueSize();
+    msgqSentBytes = 0;
     msg->release(this);
     nsent.reset();
 
     updateIos();
+    onHeadConsumed();
 }
 
 void MsgQueue::pushMsg(Msg * mp)
@@ -3736,18 +6417,94 @@ void MsgQueue::pushMsg(Msg * mp)
 
     auto serialized = mp->serialize(this);
 
+    if ((coalesceSets || coalesceBlobs) && coalesce(mp, serialized))
+    {
+        return;
+    }
+
     msgq.push_back(serialized);
+    msgqBytes += sizeof(Msg) + serialized->queueSize();
     serialized->addAwaiter(this);
 
+    if (canCoalesce(mp))
+    {
+        pendingSets[std::make_pair(mp->getDevice(), mp->getName())] = std::prev(msgq.end());
+    }
+
     // Register for client write
     updateIos();
 }
 
+bool MsgQueue::canCoalesce(const Msg * mp) const
+{
+    return (coalesceSets && mp->isCoalescable()) || (coalesceBlobs && mp->isDropEligible());
+}
+
+bool MsgQueue::coalesce(const Msg * mp, SerializedMsg * serialized)
+{
+    if (!canCoalesce(mp))
+    {
+        if (mp->isSetMessage())
+        {
+            // Sets of other properties may pass it, the later ones of its own property must not
+            pendingSets.erase(std::make_pair(mp->getDevice(), mp->getName()));
+            return false;
+        }
+        // def/new/del/message... keep strict ordering: later set messages must not pass them
+        forgetPendingSets(mp->getDevice());
+        return false;
+    }
+
+    auto pending = pendingSets.find(std::make_pair(mp->getDevice(), mp->getName()));
+    if (pending == pendingSets.end())
+    {
+        return false;
+    }
+
+    auto pos = pending->second;
+    if (pos == msgq.begin())
+    {
+        // Head message may be partially sent already. The new one will queue behind
+        pendingSets.erase(pending);
+        return false;
+    }
+
+    auto previous = *pos;
+    *pos = serialized;
+    msgqBytes += serialized->queueSize() - previous->queueSize();
+    serialized->addAwaiter(this);
+    previous->release(this);
+
+    if (verbose > 1)
+        log(fmt("replacing pending set message for %s.%s\n", mp->getDevice().c_str(), mp->getName().c_str()));
+
+    return true;
+}
+
+void MsgQueue::forgetPendingSets(const std::string &dev)
+{
+    if (dev.empty())
+    {
+        pendingSets.clear();
+        return;
+    }
+
+    auto it = pendingSets.lower_bound(std::make_pair(dev, std::string()));
+    while (it != pendingSets.end() && it->first.first == dev)
+    {
+        it = pendingSets.erase(it);
+    }
+}
+
 void MsgQueue::updateIos()
 {
     if (wFd != -1)
     {
-        if (msgq.empty() || !msgq.front()->requestContent(nsent))
+        if (zoutSent < zout.size())
+        {
+            wio.start();
+        }
+        else if (msgq.empty() || !msgq.front()->requestContent(nsent))
         {
             wio.stop();
         }
@@ -3758,8 +6515,25 @@ void MsgQueue::updateIos()
     }
     if (rFd != -1)
     {
-        rio.start();
+        if (readHolds)
+            rio.stop();
+        else
+            rio.start();
     }
+
+    worker->wakeup();
+}
+
+void MsgQueue::holdReading()
+{
+    readHolds++;
+    updateIos();
+}
+
+void MsgQueue::releaseReading()
+{
+    if (readHolds > 0 && --readHolds == 0)
+        updateIos();
 }
 
 void MsgQueue::messageMayHaveProgressed(const SerializedMsg * msg)
@@ -3773,6 +6547,7 @@ void MsgQueue::messageMayHaveProgressed(const SerializedMsg * msg)
 void MsgQueue::clearMsgQueue()
 {
     nsent.reset();
+    pendingSets.clear();
 
     auto queueCopy = msgq;
     for(auto mp : queueCopy)
@@ -3780,6 +6555,7 @@ void MsgQueue::clearMsgQueue()
         mp->release(this);
     }
     msgq.clear();
+    msgqBytes = 0;
 
     // Cancel io write events
     updateIos();
@@ -3788,15 +6564,7 @@ void MsgQueue::clearMsgQueue()
 
 unsigned long MsgQueue::msgQSize() const
 {
-    unsigned long l = 0;
-
-    for (auto mp : msgq)
-    {
-        l += sizeof(Msg);
-        l += mp->queueSize();
-    }
-
-    return (l);
+    return msgqBytes - msgqSentBytes + (zout.size() - zoutSent);
 }
 
 void MsgQueue::ioCb(ev::io &, int revents)
@@ -3829,7 +6597,7 @@ size_t MsgQueue::doRead(char * buf, size_t nr)
     if (!useSharedBuffer)
     {
         /* read client - works for all kinds of fds incl pipe*/
-        return read(rFd, buf, sizeof(buf));
+        return read(rFd, buf, nr);
     }
     else
     {
@@ -3901,7 +6669,15 @@ void MsgQueue::readFromFd()
     ssize_t nr;
 
     /* read client */
-    nr = doRead(buf, sizeof(buf));
+    {
+        UnlockedIo io(this);
+        nr = doRead(buf, sizeof(buf));
+    }
+    if (deletePending)
+    {
+        delete(this);
+        return;
+    }
     if (nr <= 0)
     {
         if (errno == EAGAIN || errno == EWOULDBLOCK) return;
@@ -3910,10 +6686,33 @@ void MsgQueue::readFromFd()
             log(fmt("read: %s\n", strerror(errno)));
         else if (verbose > 0)
             log(fmt("read EOF\n"));
+
+        // Messages still being parsed come first
+        if (parserBusy())
+        {
+            closeAfterParse = true;
+            holdReading();
+            return;
+        }
         close();
         return;
     }
 
+    if (framed)
+        readFrames(buf, nr);
+    else
+        parseBytes(buf, nr);
+}
+
+bool MsgQueue::parseBytes(char * buf, size_t nr)
+{
+    /* large chunks, and everything behind them, are parsed off the loop */
+    if (parseWorkers && (nr >= PARSEOFFLOAD || parserBusy()))
+    {
+        parseLater(buf, nr);
+        return true;
+    }
+
     /* process XML chunk */
     char err[1024];
     XMLEle **nodes = parseXMLChunk(lp, buf, nr, err);
@@ -3922,9 +6721,180 @@ void MsgQueue::readFromFd()
         log(fmt("XML error: %s\n", err));
         log(fmt("XML read: %.*s\n", (int)nr, buf));
         close();
-        return;
+        return false;
+    }
+
+    return dispatchNodes(nodes);
+}
+
+void MsgQueue::readFrames(char * buf, size_t nr)
+{
+    size_t pos = 0;
+
+    while (pos < nr)
+    {
+        if (frame.empty())
+        {
+            /* XML up to the next frame */
+            char * mark = (char *)memchr(buf + pos, INDI_FRAME_MARK, nr - pos);
+            size_t xml = (mark ? mark - buf : nr) - pos;
+            if (xml > 0 && !parseBytes(buf + pos, xml))
+                return;
+            pos += xml;
+            if (!mark)
+                return;
+        }
+
+        size_t want = INDI_FRAME_HEADER;
+        if (frame.size() >= INDI_FRAME_HEADER)
+        {
+            uint32_t payload;
+            memcpy(&payload, frame.data() + 1, sizeof payload);
+            want += payload;
+        }
+
+        size_t take = std::min(want - frame.size(), nr - pos);
+        frame.insert(frame.end(), buf + pos, buf + pos + take);
+        pos += take;
+
+        if (frame.size() == INDI_FRAME_HEADER)
+        {
+            uint32_t payload;
+            memcpy(&payload, frame.data() + 1, sizeof payload);
+            if (payload == 0 || payload > INDI_FRAME_MAXPAYLOAD)
+            {
+                log(fmt("Frame of %u bytes refused\n", payload));
+                close();
+                return;
+            }
+        }
+        else if (frame.size() == want)
+        {
+            bool alive = onFrame();
+            frame.clear();
+            if (!alive)
+                return;
+        }
+    }
+}
+
+/* read a NUL terminated string at p, NULL if there is none before end */
+static const char * frameString(const char * &p, const char * end)
+{
+    const char * s = p;
+    const char * nul = (const char *)memchr(p, 0, end - p);
+    if (nul == NULL)
+        return NULL;
+    p = nul + 1;
+    return s;
+}
+
+bool MsgQueue::onFrame()
+{
+    const char * p = frame.data() + INDI_FRAME_HEADER;
+    const char * end = frame.data() + frame.size();
+    uint8_t kind = *p++;
+    uint32_t id;
+
+    if (end - p < (ptrdiff_t)sizeof id)
+        goto bad;
+    memcpy(&id, p, sizeof id);
+    p += sizeof id;
+    if (id == 0 || id > MAXFRAMEIDS)
+        goto bad;
+
+    if (kind == INDI_FRAME_DEFNUMBER)
+    {
+        uint32_t count;
+        if (end - p < (ptrdiff_t)sizeof count)
+            goto bad;
+        memcpy(&count, p, sizeof count);
+        p += sizeof count;
+
+        FrameNumber fn;
+        const char * device = frameString(p, end);
+        const char * name = frameString(p, end);
+        if (!device || !name)
+            goto bad;
+        fn.device = device;
+        fn.name = name;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const char * member = frameString(p, end);
+            if (!member)
+                goto bad;
+            fn.members.push_back(member);
+        }
+
+        if (frameNumbers.size() < id)
+            frameNumbers.resize(id);
+        frameNumbers[id - 1] = std::move(fn);
+        return true;
     }
 
+    if (kind == INDI_FRAME_SETNUMBER)
+    {
+        if (id > frameNumbers.size() || frameNumbers[id - 1].device.empty())
+            goto bad;
+        const FrameNumber &fn = frameNumbers[id - 1];
+
+        uint8_t state;
+        double timeout;
+        if (end - p < (ptrdiff_t)(sizeof state + sizeof timeout))
+            goto bad;
+        memcpy(&state, p, sizeof state);
+        p += sizeof state;
+        memcpy(&timeout, p, sizeof timeout);
+        p += sizeof timeout;
+        const char * timestamp = frameString(p, end);
+        if (!timestamp || state > IPS_ALERT || (size_t)(end - p) != fn.members.size() * sizeof(double))
+            goto bad;
+
+        /* The same element the XML of IUUserIOSetNumberVA parses to */
+        char value[64];
+        XMLEle * root = addXMLEle(NULL, "setNumberVector");
+        addXMLAtt(root, atomDevice, fn.device.c_str());
+        addXMLAtt(root, atomName, fn.name.c_str());
+        addXMLAtt(root, "state", pstateStr((IPState)state));
+        snprintf(value, sizeof(value), "%g", timeout);
+        addXMLAtt(root, "timeout", value);
+        addXMLAtt(root, "timestamp", timestamp);
+        for (const auto &member : fn.members)
+        {
+            double v;
+            memcpy(&v, p, sizeof v);
+            p += sizeof v;
+            userio_format_number(value, v);
+            XMLEle * one = addXMLEle(root, "oneNumber");
+            addXMLAtt(one, atomName, member.c_str());
+            editXMLEle(one, value);
+        }
+
+        /* XML read earlier may still be with the parser: queue behind it */
+        if (parserBusy())
+        {
+            char * xml = nullptr;
+            size_t len = sprXMLEleAlloc(&xml, root, 0, nullptr, nullptr, 0);
+            delXMLEle(root);
+            parseLater(xml, len);
+            free(xml);
+            return true;
+        }
+
+        XMLEle ** nodes = (XMLEle **)malloc(2 * sizeof(XMLEle *));
+        nodes[0] = root;
+        nodes[1] = nullptr;
+        return dispatchNodes(nodes);
+    }
+
+bad:
+    log(fmt("Bad frame of kind %d\n", kind));
+    close();
+    return false;
+}
+
+bool MsgQueue::dispatchNodes(XMLEle ** nodes)
+{
     int inode = 0;
 
     XMLEle *root = nodes[inode];
@@ -3954,6 +6924,179 @@ void MsgQueue::readFromFd()
     }
 
     free(nodes);
+    return hb.alive();
+}
+
+bool MsgQueue::parserBusy() const
+{
+    if (!parser)
+        return false;
+    std::lock_guard<std::mutex> guard(parser->lock);
+    return parser->busy();
+}
+
+void MsgQueue::parseLater(const char * buf, size_t nr)
+{
+    if (!parser)
+        parser = std::make_shared<ParseStrand>(this, worker, lp);
+
+    bool hold;
+    {
+        std::lock_guard<std::mutex> guard(parser->lock);
+        parser->chunks.emplace_back(buf, buf + nr);
+        parser->pendingBytes += nr;
+        hold = parser->pendingBytes >= MAXPARSEBACKLOG;
+        if (!parser->scheduled)
+        {
+            parser->scheduled = true;
+            parseWorkers->schedule(parser);
+        }
+    }
+
+    if (hold && !parseHeld)
+    {
+        parseHeld = true;
+        holdReading();
+    }
+}
+
+void MsgQueue::onParsed()
+{
+    std::list<XMLEle **> parsed;
+    std::string error;
+    bool backlogLow;
+    {
+        std::lock_guard<std::mutex> guard(parser->lock);
+        parsed.swap(parser->parsed);
+        error.swap(parser->error);
+        backlogLow = parser->pendingBytes < MAXPARSEBACKLOG / 2;
+    }
+
+    while (!parsed.empty())
+    {
+        XMLEle ** nodes = parsed.front();
+        parsed.pop_front();
+        if (!dispatchNodes(nodes))
+        {
+            // Deleted. Just release the remaining messages
+            for (auto other : parsed)
+            {
+                for (int i = 0; other[i]; ++i)
+                    delXMLEle(other[i]);
+                free(other);
+            }
+            return;
+        }
+    }
+
+    if (!error.empty())
+    {
+        log(fmt("XML error: %s\n", error.c_str()));
+        close();
+        return;
+    }
+
+    if (parseHeld && backlogLow)
+    {
+        parseHeld = false;
+        releaseReading();
+    }
+
+    if (closeAfterParse && !parserBusy())
+        close();
+}
+
+ParseStrand::~ParseStrand()
+{
+    for (auto nodes : parsed)
+    {
+        for (int i = 0; nodes[i]; ++i)
+            delXMLEle(nodes[i]);
+        free(nodes);
+    }
+    delLilXML(lp);
+}
+
+ParseWorkers::ParseWorkers(int threadCount)
+{
+    for (int i = 0; i < threadCount; ++i)
+    {
+        std::thread([this]()
+        {
+            work();
+        }).detach();
+    }
+
+    if (verbose > 0)
+        log(fmt("parsing large chunks on %d threads\n", threadCount));
+}
+
+void ParseWorkers::schedule(const std::shared_ptr<ParseStrand> &strand)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    strands.push_back(strand);
+    cond.notify_one();
+}
+
+/* lilxml is done with a chunk given to parseXMLChunkShared */
+static void releaseChunk(char *, void * arg)
+{
+    delete static_cast<std::vector<char> *>(arg);
+}
+
+void ParseWorkers::work()
+{
+    while (true)
+    {
+        std::shared_ptr<ParseStrand> strand;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            cond.wait(guard, [this]()
+            {
+                return !strands.empty();
+            });
+            strand = strands.front();
+            strands.pop_front();
+        }
+
+        // Chunks of a strand are parsed in order, by this thread only
+        while (true)
+        {
+            // Handed over to lilxml, so large blob contents can stay in place
+            auto chunk = new std::vector<char>();
+            {
+                std::lock_guard<std::mutex> guard(strand->lock);
+                if (strand->chunks.empty() || strand->owner == nullptr)
+                {
+                    strand->scheduled = false;
+                    delete chunk;
+                    break;
+                }
+                chunk->swap(strand->chunks.front());
+                strand->chunks.pop_front();
+            }
+
+            char err[1024];
+            size_t size = chunk->size();
+            XMLEle ** nodes = parseXMLChunkShared(strand->lp, chunk->data(), size, err, releaseChunk, chunk);
+
+            std::lock_guard<std::mutex> guard(strand->lock);
+            strand->pendingBytes -= size;
+            if (nodes)
+            {
+                strand->parsed.push_back(nodes);
+            }
+            else
+            {
+                // The parsing context is lost. The owner closes
+                strand->error = err;
+                strand->pendingBytes = 0;
+                strand->chunks.clear();
+            }
+            if (strand->owner)
+                strand->worker->post(strand);
+        }
+    }
 }
 
 static std::vector<XMLEle *> findBlobElements(XMLEle * root)
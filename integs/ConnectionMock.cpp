@@ -16,6 +16,7 @@
  Boston, MA 02110-1301, USA.
 *******************************************************************************/
 
+#include <algorithm>
 #include <system_error>
 #include <unistd.h>
 #include <string.h>
@@ -91,6 +92,13 @@ ssize_t ConnectionMock::read(void * vbuffer, size_t len)
         baseLength = 1;
     }
 
+    if (!pendingInput.empty()) {
+        size_t l = std::min(len, pendingInput.size());
+        memcpy(buffer, pendingInput.data(), l);
+        pendingInput.erase(0, l);
+        return l + baseLength;
+    }
+
     struct msghdr msgh;
     struct iovec iov;
 
@@ -268,6 +276,59 @@ std::string ConnectionMock::receiveMore()
     return pendingData;
 }
 
+void ConnectionMock::skipUntil(const std::string &marker, int count)
+{
+    std::string window;
+    char buff[65536];
+
+    while(count > 0)
+    {
+        ssize_t rd = read(buff, sizeof(buff));
+        if (rd == 0)
+        {
+            throw std::runtime_error("Input closed while expecting " + marker);
+        }
+        if (rd == -1)
+        {
+            int e = errno;
+            throw std::system_error(e, std::generic_category(), "Read failed while expecting " + marker);
+        }
+
+        // Keep the tail of the previous read, for a marker split between reads
+        window.append(buff, rd);
+        size_t pos = 0;
+        while(count > 0 && (pos = window.find(marker, pos)) != std::string::npos)
+        {
+            pos += marker.size();
+            count--;
+        }
+        if (count == 0)
+        {
+            pendingInput = window.substr(pos) + pendingInput;
+            return;
+        }
+        size_t keep = std::min(window.size(), marker.size() - 1);
+        window.erase(0, window.size() - keep);
+    }
+}
+
+std::string ConnectionMock::readSome(size_t count)
+{
+    std::string result(count, '\0');
+    ssize_t rd = read(&result[0], count);
+    if (rd == -1)
+    {
+        int e = errno;
+        if (e == ECONNRESET)
+        {
+            return std::string();
+        }
+        throw std::system_error(e, std::generic_category(), "Read failed");
+    }
+    result.resize(rd);
+    return result;
+}
+
 std::string ConnectionMock::expectBase64() {
     std::string result;
 
@@ -309,6 +370,45 @@ void ConnectionMock::expectXml(const std::string &expected)
     }
 }
 
+std::string ConnectionMock::expectXmlWithAttribute(const std::string &expected, const std::string &name)
+{
+    std::string expectedCanonical = parseXmlFragmentFromString(expected);
+
+    std::string received;
+    auto readchar = [this, expected, &received]()->char
+    {
+        char c = readChar(expected);
+        received += c;
+        return c;
+    };
+    try
+    {
+        auto fragment = parseXmlFragment(readchar);
+
+        std::string value;
+        std::string::size_type start = fragment.find(" " + name + "='");
+        std::string::size_type end = start == std::string::npos ? start : fragment.find('\'', start + name.size() + 3);
+        if (end == std::string::npos)
+        {
+            throw std::runtime_error("xml fragment has no " + name);
+        }
+        value = fragment.substr(start + name.size() + 3, end - start - name.size() - 3);
+        fragment.erase(start, end + 1 - start);
+
+        if (fragment != expectedCanonical)
+        {
+            fprintf(stderr, "canonicalized as %s\n", fragment.c_str());
+            throw std::runtime_error("xml fragment does not match");
+        }
+        return value;
+    }
+    catch(std::runtime_error &e)
+    {
+        received += receiveMore();
+        throw std::runtime_error(std::string(e.what()) + "\nexpected: " + expected + "\nReceived: " + received);
+    }
+}
+
 void ConnectionMock::send(const std::string &str)
 {
     ssize_t l = str.size();
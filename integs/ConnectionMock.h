@@ -43,6 +43,8 @@ class ConnectionMock
 
         // On error, contains data that were not returned
         std::string pendingData;
+        // Read past the end of skipUntil, returned by the next reads
+        std::string pendingInput;
     public:
         ConnectionMock();
         ~ConnectionMock();
@@ -52,7 +54,13 @@ class ConnectionMock
 
         void expect(const std::string &content);
         void expectXml(const std::string &xml);
+        // Like expectXml, for a fragment that also has the attribute name, of any value. Returns that value
+        std::string expectXmlWithAttribute(const std::string &xml, const std::string &name);
         std::string expectBase64();
+        // Read in bulk and drop everything up to the count-th occurrence of marker, for throughput tests
+        void skipUntil(const std::string &marker, int count = 1);
+        // Whatever is available, at most count bytes. Empty once the input is closed
+        std::string readSome(size_t count);
         void send(const std::string &content);
         void send(const std::string &content, const SharedBuffer &buff);
         void send(const std::string &content, const SharedBuffer ** buffers);
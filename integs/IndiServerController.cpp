@@ -34,6 +34,7 @@
 
 IndiServerController::IndiServerController() {
     fifo = false;
+    verbose = true;
 }
 
 IndiServerController::~IndiServerController() {
@@ -47,12 +48,23 @@ void IndiServerController::setFifo(bool fifo) {
     this->fifo = fifo;
 }
 
+void IndiServerController::setVerbose(bool verbose) {
+    this->verbose = verbose;
+}
+
+void IndiServerController::setExtraArgs(const std::vector<std::string> & args) {
+    this->extraArgs = args;
+}
+
 void IndiServerController::start(const std::vector<std::string> & args) {
     ProcessController::start("../indiserver/indiserver", args);
 }
 
 void IndiServerController::startDriver(const std::string & path) {
-    std::vector<std::string> args = { "-p", TO_STRING(TEST_TCP_PORT), "-r", "0", "-vvv" };
+    std::vector<std::string> args = { "-p", TO_STRING(TEST_TCP_PORT), "-r", "0" };
+    if (verbose) {
+        args.push_back("-vvv");
+    }
 #ifdef ENABLE_INDI_SHARED_MEMORY
     args.push_back("-u");
     args.push_back(TEST_UNIX_SOCKET);
@@ -66,14 +78,15 @@ void IndiServerController::startDriver(const std::string & path) {
         args.push_back("-f");
         args.push_back(TEST_INDI_FIFO);
     }
+    args.insert(args.end(), extraArgs.begin(), extraArgs.end());
     args.push_back(path);
 
     start(args);
 }
 
-void IndiServerController::addDriver(const std::string & driver) {
+void IndiServerController::sendFifoCommand(const std::string & cmd) {
     if (!fifo) {
-        throw new std::runtime_error("Fifo is not enabled - cannot add driver");
+        throw new std::runtime_error("Fifo is not enabled - cannot send " + cmd);
     }
 
     int fifoFd = open(TEST_INDI_FIFO, O_WRONLY);
@@ -81,8 +94,8 @@ void IndiServerController::addDriver(const std::string & driver) {
         throw std::system_error(errno, std::generic_category(), "opening fifo");
     }
 
-    std::string cmd = "start " + driver +"\n";
-    int wr = write(fifoFd, cmd.data(), cmd.length());
+    std::string line = cmd + "\n";
+    int wr = write(fifoFd, line.data(), line.length());
     if (wr == -1) {
         auto e = errno;
         close(fifoFd);
@@ -92,6 +105,18 @@ void IndiServerController::addDriver(const std::string & driver) {
     close(fifoFd);
 }
 
+void IndiServerController::addDriver(const std::string & driver) {
+    sendFifoCommand("start " + driver);
+}
+
+void IndiServerController::stopDriver(const std::string & driver) {
+    sendFifoCommand("stop " + driver);
+}
+
+void IndiServerController::dumpMetrics(const std::string & path) {
+    sendFifoCommand("metrics " + path);
+}
+
 std::string IndiServerController::getUnixSocketPath() const {
     return TEST_UNIX_SOCKET;
 }
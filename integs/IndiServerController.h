@@ -32,15 +32,27 @@
 class IndiServerController : public ProcessController
 {
         bool fifo;
+        bool verbose;
+        std::vector<std::string> extraArgs;
+
+        void sendFifoCommand(const std::string & cmd);
     public:
         IndiServerController();
         ~IndiServerController();
         void setFifo(bool enable);
+        // Log every message (-vvv), on by default. Throughput tests turn it off
+        void setVerbose(bool enable);
+        // Additional indiserver options, inserted before the driver by startDriver
+        void setExtraArgs(const std::vector<std::string> & args);
         void start(const std::vector<std::string> & args);
 
         void startDriver(const std::string & driver);
 
         void addDriver(const std::string & path);
+        void stopDriver(const std::string & path);
+
+        // Ask the server to write its metrics to path (asynchronous)
+        void dumpMetrics(const std::string & path);
 
         std::string getUnixSocketPath() const;
         int getTcpPort() const;
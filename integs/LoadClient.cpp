@@ -0,0 +1,147 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "LoadClient.h"
+#include "LoadDriver.h"
+#include "IndiServerController.h"
+
+// As the server prints them
+#define SENT_MARKER "<oneNumber name=\"sent\">"
+#define BLOB_MARKER "</setBLOBVector>"
+
+LoadClient::LoadClient(const Options &options) : options(options)
+{
+}
+
+LoadClient::~LoadClient()
+{
+    if (reader.joinable())
+    {
+        stop();
+        join();
+    }
+}
+
+void LoadClient::connect(const IndiServerController &server)
+{
+    client.connectTcp(server);
+    client.cnx.send("<getProperties version='1.7'/>\n");
+
+    std::string policy = options.policy.empty() ? "" : " policy='" + options.policy + "'";
+    client.cnx.send("<enableBLOB device='" LOAD_DEVICE "'" + policy + ">" + options.blobMode + "</enableBLOB>\n");
+    client.ping();
+}
+
+void LoadClient::start(int expectedNumbers, int expectedBlobs)
+{
+    reader = std::thread([this, expectedNumbers, expectedBlobs]
+    {
+        read(expectedNumbers, expectedBlobs);
+    });
+}
+
+void LoadClient::stop()
+{
+    stopping = true;
+    client.cnx.shutdown(true, false);
+}
+
+void LoadClient::join()
+{
+    if (reader.joinable())
+    {
+        reader.join();
+    }
+}
+
+void LoadClient::read(int expectedNumbers, int expectedBlobs)
+{
+    const size_t sentLength = sizeof(SENT_MARKER) - 1;
+    const size_t blobLength = sizeof(BLOB_MARKER) - 1;
+
+    std::string window;
+    size_t blobFrom = 0;
+    while (int(latencies.size()) < expectedNumbers || blobs < expectedBlobs)
+    {
+        std::string chunk;
+        try
+        {
+            chunk = client.cnx.readSome(options.readSize);
+        }
+        catch (const std::exception &)
+        {
+            chunk.clear();
+        }
+        if (chunk.empty())
+        {
+            closed = !stopping;
+            return;
+        }
+
+        int64_t now = LoadDriver::now();
+        window += chunk;
+
+        size_t cut = window.size();
+        for (size_t pos = window.find(SENT_MARKER); pos != std::string::npos; pos = window.find(SENT_MARKER, pos))
+        {
+            size_t end = window.find('<', pos + sentLength);
+            if (end == std::string::npos)
+            {
+                cut = pos;
+                break;
+            }
+            latencies.push_back(now - strtoll(window.c_str() + pos + sentLength, nullptr, 10));
+            pos = end;
+        }
+        for (size_t pos = window.find(BLOB_MARKER, blobFrom); pos != std::string::npos; pos = window.find(BLOB_MARKER, blobFrom))
+        {
+            blobs++;
+            blobFrom = pos + blobLength;
+        }
+
+        // Keep an incomplete number, and the end that may be the start of a marker
+        blobFrom = std::max(blobFrom, window.size() - std::min(window.size(), blobLength - 1));
+        cut = std::min({cut, window.size() - std::min(window.size(), sentLength - 1), blobFrom});
+        window.erase(0, cut);
+        blobFrom -= cut;
+
+        if (options.readDelayUs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(options.readDelayUs));
+        }
+    }
+}
+
+LatencySummary summarize(std::vector<int64_t> latencies)
+{
+    LatencySummary summary;
+    if (latencies.empty())
+    {
+        return summary;
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    summary.count = latencies.size();
+    summary.p50Us = latencies[latencies.size() / 2] / 1e3;
+    summary.p99Us = latencies[latencies.size() * 99 / 100] / 1e3;
+    summary.maxUs = latencies.back() / 1e3;
+    return summary;
+}
@@ -0,0 +1,101 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#ifndef LOAD_CLIENT_H_
+#define LOAD_CLIENT_H_ 1
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "IndiClientMock.h"
+
+class IndiServerController;
+
+/**
+ * Client of a load test, reading on a thread of its own.
+ *
+ * Measures the latency of the numbers sent by a LoadDriver and counts the BLOBs.
+ * A slow reader sleeps between small reads, the server may then shut it down.
+ */
+class LoadClient
+{
+    public:
+        struct Options
+        {
+            std::string blobMode = "Never"; // enableBLOB value: Never, Also or Only
+            std::string policy;             // policy attribute of enableBLOB: drop, latest or block, server default if empty
+            int readSize = 65536;
+            int readDelayUs = 0;            // between reads
+        };
+
+        LoadClient(const Options &options);
+        ~LoadClient();
+
+        // Connect, ask all properties and set the BLOB mode
+        void connect(const IndiServerController &server);
+
+        // Read until the expected counts of numbers and BLOBs arrived, or the input is closed
+        void start(int expectedNumbers, int expectedBlobs = 0);
+
+        // Stop reading now
+        void stop();
+
+        // Wait for the end of the reads
+        void join();
+
+        // Latencies of the numbers received, in nanoseconds
+        const std::vector<int64_t> &getLatencies() const
+        {
+            return latencies;
+        }
+        int getBlobCount() const
+        {
+            return blobs;
+        }
+        // True if the server closed the connection before the end
+        bool wasClosed() const
+        {
+            return closed;
+        }
+
+    private:
+        void read(int expectedNumbers, int expectedBlobs);
+
+        Options options;
+        IndiClientMock client;
+        std::thread reader;
+        std::atomic<bool> stopping {false};
+
+        std::vector<int64_t> latencies;
+        int blobs = 0;
+        bool closed = false;
+};
+
+struct LatencySummary
+{
+    int64_t count = 0;
+    double p50Us = 0;
+    double p99Us = 0;
+    double maxUs = 0;
+};
+
+LatencySummary summarize(std::vector<int64_t> latencies);
+
+
+#endif // LOAD_CLIENT_H_
@@ -0,0 +1,113 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "LoadDriver.h"
+
+LoadDriver::LoadDriver()
+{
+    blobSize = 0;
+}
+
+int64_t LoadDriver::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LoadDriver::defineProperties(int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        cnx.expectXml("<getProperties version='1.7'/>");
+    }
+
+    cnx.send("<defNumberVector device='" LOAD_DEVICE "' name='load' label='load' group='test' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n"
+             "<defNumber name='sent' label='sent' format='%.f' min='0' max='0' step='0'>0</defNumber>\n"
+             "</defNumberVector>\n");
+    cnx.send("<defBLOBVector device='" LOAD_DEVICE "' name='frame' label='frame' group='test' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n"
+             "<defBLOB name='content' label='content'/>\n"
+             "</defBLOBVector>\n");
+}
+
+static std::string numberMessage()
+{
+    return "<setNumberVector device='" LOAD_DEVICE "' name='load' state='Ok' timestamp='2018-01-01T00:01:00'>\n"
+           "<oneNumber name='sent'>" + std::to_string(LoadDriver::now()) + "</oneNumber>\n"
+           "</setNumberVector>\n";
+}
+
+void LoadDriver::run(const Traffic &traffic)
+{
+    // The frames are all the same, only built once
+    std::string inlineBlob;
+    if (traffic.blobEvery > 0 && blobSize != traffic.blobSize)
+    {
+        std::vector<char> content(traffic.blobSize);
+        for (size_t i = 0; i < content.size(); ++i)
+        {
+            content[i] = char('0' + i % 10);
+        }
+        if (blobSize)
+        {
+            blob.release();
+        }
+        blob.allocate(traffic.blobSize);
+        blob.write(content.data(), 0, content.size());
+        blobSize = traffic.blobSize;
+    }
+    if (traffic.blobEvery > 0 && !traffic.attached)
+    {
+        // Same content as the shared buffer: the digits repeat every 30 bytes, 10 groups of 3 bytes in base64
+        inlineBlob.reserve(traffic.blobSize / 3 * 4 + 4);
+        for (int i = 0; i < traffic.blobSize / 3; ++i)
+        {
+            static const char * const digits[] = { "MDEy", "MzQ1", "Njc4", "OTAx", "MjM0", "NTY3", "ODkw", "MTIz", "NDU2", "Nzg5" };
+            inlineBlob += digits[i % 10];
+        }
+    }
+
+    std::string blobHeader = "<setBLOBVector device='" LOAD_DEVICE "' name='frame' timestamp='2018-01-01T00:01:00'>\n";
+    for (int sent = 0; sent < traffic.numbers;)
+    {
+        std::string burst;
+        for (int i = 0; i < traffic.burst && sent < traffic.numbers; ++i, ++sent)
+        {
+            burst += numberMessage();
+            if (traffic.blobEvery > 0 && (sent + 1) % traffic.blobEvery == 0 && !traffic.attached)
+            {
+                int size = traffic.blobSize / 3 * 3;
+                burst += blobHeader + "<oneBLOB name='content' size='" + std::to_string(size) + "' format='" + traffic.format + "' enclen='" +
+                         std::to_string(inlineBlob.size()) + "'>\n" + inlineBlob + "\n</oneBLOB>\n</setBLOBVector>\n";
+            }
+            else if (traffic.blobEvery > 0 && (sent + 1) % traffic.blobEvery == 0)
+            {
+                cnx.send(burst);
+                burst.clear();
+                cnx.send(blobHeader);
+                cnx.send("<oneBLOB name='content' size='" + std::to_string(traffic.blobSize) + "' format='" + traffic.format + "' attached='true'/>\n", blob);
+                cnx.send("</setBLOBVector>\n");
+            }
+        }
+        cnx.send(burst);
+        if (traffic.intervalUs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(traffic.intervalUs));
+        }
+    }
+}
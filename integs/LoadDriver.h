@@ -0,0 +1,63 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#ifndef LOAD_DRIVER_H_
+#define LOAD_DRIVER_H_ 1
+
+#include <cstdint>
+#include <string>
+
+#include "DriverMock.h"
+#include "SharedBuffer.h"
+
+#define LOAD_DEVICE "loaddev"
+
+/**
+ * Fake driver emitting synthetic traffic, for load tests.
+ *
+ * Defines a number vector and a BLOB vector, then sends numbers carrying their send time,
+ * for the LoadClient to measure the latency of each, mixed with BLOBs.
+ */
+class LoadDriver : public DriverMock
+{
+        SharedBuffer blob;
+        int blobSize;
+    public:
+        struct Traffic
+        {
+            int numbers = 1000;        // setNumberVector messages to send
+            int blobEvery = 0;         // one BLOB after every that many numbers, none if 0
+            int blobSize = 1 << 20;
+            bool attached = false;     // in a shared buffer rather than base64
+            std::string format = ".fits"; // the server may drop the ones of a format with "stream" in it
+            int burst = 10;            // numbers sent at once
+            int intervalUs = 1000;     // between bursts
+        };
+
+        LoadDriver();
+
+        // Answer the getProperties of count clients, then define the properties
+        void defineProperties(int count);
+
+        // Send the traffic, returns once all of it is written to the server
+        void run(const Traffic &traffic);
+
+        // Clock of the send times, shared with the clients
+        static int64_t now();
+};
+
+
+#endif // LOAD_DRIVER_H_
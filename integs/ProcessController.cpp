@@ -1,3 +1,4 @@
+#include <fstream>
 #include <system_error>
 #include <unistd.h>
 #include <string.h>
@@ -61,6 +62,29 @@ void ProcessController::checkOpenFdCount(int expected, const std::string & msg)
 #endif
 }
 
+long ProcessController::getPeakRssKb() {
+    if (pid == -1) {
+        throw std::runtime_error(cmd + " is done - cannot check its memory");
+    }
+#ifdef __linux__
+    std::string path = "/proc/" + std::to_string(pid) + "/status";
+    std::ifstream status(path);
+    if (!status) {
+        throw std::runtime_error("Cannot read " + path);
+    }
+
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+    return 0;
+#else
+    return 0;
+#endif
+}
+
 void ProcessController::start(const std::string & path, const std::vector<std::string>  & args)
 {
     if (pid != -1) {
@@ -51,6 +51,9 @@ public:
     int getOpenFdCount();
 
     void checkOpenFdCount(int expected, const std::string & msg);
+
+    // Peak resident memory of the process, in kB. Returns 0 on some system
+    long getPeakRssKb();
 };
 
 
@@ -0,0 +1,275 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Load tests of indiserver with many clients, run with ctest -L load.
+// The scale is set by INDI_LOAD_CLIENTS and INDI_LOAD_NUMBERS. Latencies, peak memory and the drop and kill counts
+// of the server are recorded as properties of each test, in the JSON report of the run.
+
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "utils.h"
+
+#include "LoadDriver.h"
+#include "LoadClient.h"
+#include "IndiServerController.h"
+
+static int loadParameter(const char *name, int defaultValue)
+{
+    const char *value = getenv(name);
+    return value ? atoi(value) : defaultValue;
+}
+
+static void startLoadDriver(IndiServerController &indiServer, LoadDriver &driver, const std::vector<std::string> &args)
+{
+    setupSigPipe();
+
+    driver.setup();
+
+    indiServer.setVerbose(false);
+    indiServer.setFifo(true);
+    indiServer.setExtraArgs(args);
+    indiServer.startDriver(getTestExePath("fakedriver"));
+    fprintf(stderr, "indiserver started\n");
+
+    driver.waitEstablish();
+    fprintf(stderr, "load driver started\n");
+
+    driver.cnx.expectXml("<getProperties version='1.7'/>");
+}
+
+// Start clients of alike options, to be connected before the driver defines its properties
+static void addClients(std::vector<std::unique_ptr<LoadClient>> &clients, int count, const LoadClient::Options &options,
+                       IndiServerController &indiServer)
+{
+    for (int i = 0; i < count; i++)
+    {
+        clients.emplace_back(new LoadClient(options));
+        clients.back()->connect(indiServer);
+    }
+}
+
+static double readMetric(IndiServerController &indiServer, const std::string &name)
+{
+    const std::string metricsPath = "/tmp/indi-test-load-metrics.prom";
+    unlink(metricsPath.c_str());
+    indiServer.dumpMetrics(metricsPath);
+
+    // The fifo is processed asynchronously
+    std::string metrics;
+    for(int i = 0; i < 200 && metrics.empty(); ++i)
+    {
+        usleep(10000);
+        std::ifstream file(metricsPath);
+        std::stringstream content;
+        content << file.rdbuf();
+        metrics = content.str();
+    }
+    unlink(metricsPath.c_str());
+
+    size_t pos = metrics.find("\n" + name + " ");
+    return pos == std::string::npos ? -1 : atof(metrics.c_str() + pos + name.size() + 2);
+}
+
+static void recordLatencies(const std::string &prefix, const std::vector<std::unique_ptr<LoadClient>> &clients,
+                            size_t first, size_t last)
+{
+    std::vector<int64_t> latencies;
+    for (size_t i = first; i < last; i++)
+    {
+        auto &received = clients[i]->getLatencies();
+        latencies.insert(latencies.end(), received.begin(), received.end());
+    }
+
+    LatencySummary summary = summarize(latencies);
+    fprintf(stderr, "%s: %ld numbers, latency p50 %.0f us, p99 %.0f us, max %.0f us\n", prefix.c_str(), long(summary.count),
+            summary.p50Us, summary.p99Us, summary.maxUs);
+    ::testing::Test::RecordProperty(prefix + "_p50_us", int(summary.p50Us));
+    ::testing::Test::RecordProperty(prefix + "_p99_us", int(summary.p99Us));
+    ::testing::Test::RecordProperty(prefix + "_max_us", int(summary.maxUs));
+}
+
+static void recordServer(IndiServerController &indiServer, double &killed, double &dropped)
+{
+    long rss = indiServer.getPeakRssKb();
+    killed = readMetric(indiServer, "indiserver_clients_killed_total");
+    dropped = readMetric(indiServer, "indiserver_stream_blobs_dropped_total");
+    fprintf(stderr, "indiserver peak RSS %ld kB, %.0f clients killed, %.0f stream BLOBs dropped\n", rss, killed, dropped);
+    ::testing::Test::RecordProperty("peak_rss_kb", int(rss));
+    ::testing::Test::RecordProperty("clients_killed", int(killed));
+    ::testing::Test::RecordProperty("stream_blobs_dropped", int(dropped));
+}
+
+// Numbers only, every client gets all of them
+TEST(IndiserverLoad, ManyClients)
+{
+    LoadDriver driver;
+    IndiServerController indiServer;
+
+    startLoadDriver(indiServer, driver, {});
+
+    int count = loadParameter("INDI_LOAD_CLIENTS", 200);
+    std::vector<std::unique_ptr<LoadClient>> clients;
+    addClients(clients, count, LoadClient::Options(), indiServer);
+    driver.defineProperties(count);
+
+    LoadDriver::Traffic traffic;
+    traffic.numbers = loadParameter("INDI_LOAD_NUMBERS", 500);
+    for (auto &client : clients)
+        client->start(traffic.numbers);
+    driver.run(traffic);
+
+    for (auto &client : clients)
+    {
+        client->join();
+        EXPECT_FALSE(client->wasClosed());
+        EXPECT_EQ(int(client->getLatencies().size()), traffic.numbers);
+    }
+    recordLatencies("numbers", clients, 0, clients.size());
+
+    double killed, dropped;
+    recordServer(indiServer, killed, dropped);
+    EXPECT_EQ(killed, 0);
+
+    // With a fifo, the server keeps running without drivers
+    driver.terminateDriver();
+    indiServer.kill();
+    indiServer.join();
+}
+
+// A few clients that cannot keep up with the BLOBs are shut down, the others do not notice
+TEST(IndiserverLoad, SlowReadersShutDown)
+{
+    LoadDriver driver;
+    IndiServerController indiServer;
+
+    startLoadDriver(indiServer, driver, { "-m", "2" });
+
+    int count = loadParameter("INDI_LOAD_CLIENTS", 200);
+    int slow = std::max(1, count / 20), blobbing = std::max(1, count / 10);
+
+    LoadClient::Options fastBlobs;
+    fastBlobs.blobMode = "Also";
+    LoadClient::Options slowBlobs;
+    slowBlobs.blobMode = "Only";
+    slowBlobs.readSize = 4096;
+    slowBlobs.readDelayUs = 10000;
+
+    std::vector<std::unique_ptr<LoadClient>> clients;
+    addClients(clients, count - slow - blobbing, LoadClient::Options(), indiServer);
+    addClients(clients, blobbing, fastBlobs, indiServer);
+    addClients(clients, slow, slowBlobs, indiServer);
+    driver.defineProperties(count);
+
+    LoadDriver::Traffic traffic;
+    traffic.numbers = loadParameter("INDI_LOAD_NUMBERS", 500);
+    traffic.blobEvery = 25;
+    traffic.blobSize = 512 << 10;
+    int blobs = traffic.numbers / traffic.blobEvery;
+    for (int i = 0; i < count - slow; i++)
+        clients[i]->start(traffic.numbers, i < count - slow - blobbing ? 0 : blobs);
+    for (int i = count - slow; i < count; i++)
+        clients[i]->start(0, blobs);
+    driver.run(traffic);
+
+    for (int i = 0; i < count - slow; i++)
+    {
+        clients[i]->join();
+        EXPECT_FALSE(clients[i]->wasClosed());
+        EXPECT_EQ(int(clients[i]->getLatencies().size()), traffic.numbers);
+    }
+    for (int i = count - slow; i < count; i++)
+    {
+        clients[i]->join();
+        EXPECT_TRUE(clients[i]->wasClosed());
+    }
+    recordLatencies("numbers", clients, 0, count - slow - blobbing);
+    recordLatencies("numbers_with_blobs", clients, count - slow - blobbing, count - slow);
+
+    double killed, dropped;
+    recordServer(indiServer, killed, dropped);
+    EXPECT_EQ(killed, slow);
+
+    // With a fifo, the server keeps running without drivers
+    driver.terminateDriver();
+    indiServer.kill();
+    indiServer.join();
+}
+
+// Slow clients of a stream that keep only the latest frame are not shut down
+TEST(IndiserverLoad, SlowReadersOfStream)
+{
+    LoadDriver driver;
+    IndiServerController indiServer;
+
+    startLoadDriver(indiServer, driver, { "-m", "2" });
+
+    int count = loadParameter("INDI_LOAD_CLIENTS", 200);
+    int slow = std::max(1, count / 20);
+
+    LoadClient::Options slowStream;
+    slowStream.blobMode = "Only";
+    slowStream.policy = "latest";
+    slowStream.readSize = 4096;
+    slowStream.readDelayUs = 10000;
+
+    std::vector<std::unique_ptr<LoadClient>> clients;
+    addClients(clients, count - slow, LoadClient::Options(), indiServer);
+    addClients(clients, slow, slowStream, indiServer);
+    driver.defineProperties(count);
+
+    LoadDriver::Traffic traffic;
+    traffic.numbers = loadParameter("INDI_LOAD_NUMBERS", 500);
+    traffic.blobEvery = 25;
+    traffic.blobSize = 512 << 10;
+    traffic.format = ".stream";
+    int blobs = traffic.numbers / traffic.blobEvery;
+    for (int i = 0; i < count - slow; i++)
+        clients[i]->start(traffic.numbers);
+    for (int i = count - slow; i < count; i++)
+        clients[i]->start(0, blobs);
+    driver.run(traffic);
+
+    for (int i = 0; i < count - slow; i++)
+    {
+        clients[i]->join();
+        EXPECT_EQ(int(clients[i]->getLatencies().size()), traffic.numbers);
+    }
+    recordLatencies("numbers", clients, 0, count - slow);
+
+    double killed, dropped;
+    recordServer(indiServer, killed, dropped);
+    EXPECT_EQ(killed, 0);
+
+    // They get the latest frame whenever they catch up, not all of them
+    for (int i = count - slow; i < count; i++)
+    {
+        clients[i]->stop();
+        clients[i]->join();
+        EXPECT_FALSE(clients[i]->wasClosed());
+    }
+
+    // With a fifo, the server keeps running without drivers
+    driver.terminateDriver();
+    indiServer.kill();
+    indiServer.join();
+}
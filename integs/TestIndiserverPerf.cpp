@@ -0,0 +1,197 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Throughput of indiserver, run with ctest -L perf.
+// Each result is recorded as a property of its test, in the JSON report of the run, and checked against a floor
+// well below what a debug build does on a laptop: the floors catch a collapse, the report is for trends.
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "utils.h"
+
+#include "SharedBuffer.h"
+#include "DriverMock.h"
+#include "IndiServerController.h"
+#include "IndiClientMock.h"
+
+#define FANOUT_CLIENTS  8
+#define FANOUT_MESSAGES 5000
+#define FANOUT_FLOOR    20000  // messages per second, all clients together
+
+#define BLOB_COUNT      16
+#define BLOB_SIZE       (4 << 20)
+#define BLOB_FLOOR      20     // MB per second
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    // Passing shared buffers takes next to nothing, keep the rates finite
+    return std::max(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), 1e-6);
+}
+
+static void startQuietFakeDev1(IndiServerController &indiServer, DriverMock &fakeDriver)
+{
+    setupSigPipe();
+
+    fakeDriver.setup();
+
+    // Logging every message would be most of what is measured
+    indiServer.setVerbose(false);
+    indiServer.startDriver(getTestExePath("fakedriver"));
+    fprintf(stderr, "indiserver started\n");
+
+    fakeDriver.waitEstablish();
+    fprintf(stderr, "fake driver started\n");
+
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+}
+
+// Connect the clients, each asking all properties, then define vector once for all of them
+static void connectClients(IndiServerController &indiServer, DriverMock &fakeDriver,
+                           std::vector<std::unique_ptr<IndiClientMock>> &clients, bool overUnix,
+                           const std::string &vector, const std::string &end)
+{
+    for (auto &client : clients)
+    {
+        client.reset(new IndiClientMock());
+        if (overUnix)
+            client->connectUnix(indiServer);
+        else
+            client->connectTcp(indiServer);
+        client->cnx.send("<getProperties version='1.7'/>\n");
+        fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+    }
+
+    fakeDriver.cnx.send(vector);
+    for (auto &client : clients)
+        client->cnx.skipUntil(end);
+}
+
+static std::string numberMessage(int i)
+{
+    return "<setNumberVector device='fakedev1' name='testnumber' state='Ok' timestamp='2018-01-01T00:01:00'>\n"
+           "<oneNumber name='value'>" + std::to_string(i) + "</oneNumber>\n"
+           "</setNumberVector>\n";
+}
+
+TEST(IndiserverPerf, FanOutNumbers)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startQuietFakeDev1(indiServer, fakeDriver);
+
+    std::vector<std::unique_ptr<IndiClientMock>> clients(FANOUT_CLIENTS);
+    connectClients(indiServer, fakeDriver, clients, false,
+                   "<defNumberVector device='fakedev1' name='testnumber' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n"
+                   "<defNumber name='value' label='value' format='%g' min='0' max='0' step='0'>0</defNumber>\n"
+                   "</defNumberVector>\n", "</defNumberVector>");
+
+    std::string burst;
+    for (int i = 0; i < FANOUT_MESSAGES; i++)
+        burst += numberMessage(i);
+
+    // The server queues what the clients do not read yet, so they can be drained one after the other
+    auto start = std::chrono::steady_clock::now();
+    fakeDriver.cnx.send(burst);
+    for (auto &client : clients)
+        client->cnx.skipUntil("</setNumberVector>", FANOUT_MESSAGES);
+    double seconds = secondsSince(start);
+
+    int rate = int(FANOUT_CLIENTS * FANOUT_MESSAGES / seconds);
+    fprintf(stderr, "%d clients x %d messages in %.3f s, %d messages/s\n", FANOUT_CLIENTS, FANOUT_MESSAGES, seconds, rate);
+    RecordProperty("messages_per_second", rate);
+    EXPECT_GT(rate, FANOUT_FLOOR);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+// The driver sends the same attached buffer again and again, the server encodes or passes it on each time
+static int blobThroughput(bool overUnix)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startQuietFakeDev1(indiServer, fakeDriver);
+
+    std::vector<std::unique_ptr<IndiClientMock>> clients(1);
+    connectClients(indiServer, fakeDriver, clients, overUnix,
+                   "<defBLOBVector device='fakedev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n"
+                   "<defBLOB name='content' label='content'/>\n"
+                   "</defBLOBVector>\n", "</defBLOBVector>");
+    IndiClientMock &client = *clients[0];
+
+    client.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    client.ping();
+
+    SharedBuffer buffer;
+    buffer.allocate(BLOB_SIZE);
+    std::vector<char> content(BLOB_SIZE);
+    for (size_t i = 0; i < content.size(); ++i)
+        content[i] = char('0' + i % 10);
+    buffer.write(content.data(), 0, content.size());
+
+    client.cnx.allowBufferReceive(overUnix);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BLOB_COUNT; ++i)
+    {
+        fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+        fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(BLOB_SIZE) + "' format='.fits' attached='true'/>\n",
+                            buffer);
+        fakeDriver.cnx.send("</setBLOBVector>\n");
+    }
+    client.cnx.skipUntil("</setBLOBVector>", BLOB_COUNT);
+    for (int i = 0; overUnix && i < BLOB_COUNT; ++i)
+    {
+        SharedBuffer received;
+        client.cnx.expectBuffer(received);
+        EXPECT_GE(received.getSize(), BLOB_SIZE);
+    }
+    double seconds = secondsSince(start);
+    client.cnx.allowBufferReceive(false);
+
+    int rate = int(double(BLOB_COUNT) * BLOB_SIZE / (1 << 20) / seconds);
+    fprintf(stderr, "%d BLOBs of %d bytes to a %s client in %.3f s, %d MB/s\n", BLOB_COUNT, BLOB_SIZE,
+            overUnix ? "unix" : "tcp", seconds, rate);
+
+    buffer.release();
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+    return rate;
+}
+
+TEST(IndiserverPerf, InlineBlobs)
+{
+    int rate = blobThroughput(false);
+    RecordProperty("megabytes_per_second", rate);
+    EXPECT_GT(rate, BLOB_FLOOR);
+}
+
+TEST(IndiserverPerf, SharedBlobs)
+{
+    int rate = blobThroughput(true);
+    RecordProperty("megabytes_per_second", rate);
+    EXPECT_GT(rate, BLOB_FLOOR);
+}
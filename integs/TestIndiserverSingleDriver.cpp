@@ -16,20 +16,28 @@
  Boston, MA 02110-1301, USA.
 *******************************************************************************/
 
+#include <algorithm>
+#include <fstream>
+#include <sstream>
 #include <stdexcept>
 #include <stdio.h>
 #include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <system_error>
 
 #include "gtest/gtest.h"
 
+#include "indistreamcompression.h"
+
 #include "utils.h"
 
 #include "SharedBuffer.h"
 #include "DriverMock.h"
 #include "IndiServerController.h"
 #include "IndiClientMock.h"
+#include "ServerMock.h"
 
 // Repeat blob operation for more stress
 #define BLOB_REPEAT_COUNT 5
@@ -158,6 +166,122 @@ void connectFakeDev1Client(IndiServerController &, DriverMock &fakeDriver, IndiC
     indiClient.cnx.expectXml("</defBLOBVector>");
 }
 
+TEST(IndiserverSingleDriver, StartLazyDriverOnDemand)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    setupSigPipe();
+
+    const std::string manifestPath = "/tmp/indi-test-manifest.xml";
+    FILE * manifest = fopen(manifestPath.c_str(), "w");
+    ASSERT_NE(manifest, nullptr);
+    fprintf(manifest, "<driversList><devGroup group='Test'><device label='fakedev1'>"
+            "<driver name='fakedev1'>fakedriver</driver></device></devGroup></driversList>\n");
+    fclose(manifest);
+
+    fakeDriver.setup();
+    indiServer.setExtraArgs({ "-z", manifestPath });
+    startFakeDev(indiServer);
+
+    // The server listens without its driver
+    int fd = -1;
+    for(int i = 0; i < 500 && fd < 0; ++i)
+    {
+        fd = tcpSocketConnect("127.0.0.1", indiServer.getTcpPort(), true);
+        if (fd < 0)
+            usleep(10000);
+    }
+    ASSERT_GE(fd, 0);
+    unlink(manifestPath.c_str());
+
+    IndiClientMock indiClient;
+    indiClient.associate(fd);
+    indiClient.ping();
+
+    fprintf(stderr, "Client asks properties of fakedev1\n");
+    indiClient.cnx.send("<getProperties version='1.7' device='fakedev1'/>\n");
+
+    establishDriver(indiServer, fakeDriver, "fakedev1");
+
+    indiClient.cnx.expectXml("<defBLOBVector device='fakedev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>");
+    indiClient.cnx.expectXml("<defBLOB name='content' label='content'/>");
+    indiClient.cnx.expectXml("</defBLOBVector>");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverSingleDriver, ShareConnectionToRemoteServer)
+{
+    ServerMock remoteServer;
+    IndiServerController indiServer;
+
+    setupSigPipe();
+
+    remoteServer.listen(17625);
+
+    // Two devices of the same remote server
+    indiServer.start({ "-p", std::to_string(indiServer.getTcpPort()), "-r", "0", "-vvv",
+#ifdef ENABLE_INDI_SHARED_MEMORY
+                       "-u", indiServer.getUnixSocketPath(),
+#endif
+                       "fakedev1@127.0.0.1:17625", "fakedev2@127.0.0.1:17625" });
+
+    IndiClientMock remoteCnx;
+    remoteServer.accept(remoteCnx);
+
+    fprintf(stderr, "Both devices are asked on the first connection\n");
+    remoteCnx.cnx.expectXml("<getProperties device='fakedev1' version='1.7'/>");
+    remoteCnx.cnx.expectXml("<getProperties device='fakedev2' version='1.7'/>");
+
+    remoteCnx.cnx.send("<pingRequest uid='1'/>\n");
+    remoteCnx.cnx.expectXml("<pingReply uid='1'/>");
+
+    remoteServer.close();
+    indiServer.kill();
+    indiServer.join();
+}
+
+TEST(IndiserverSingleDriver, StopOneDeviceOfSharedConnection)
+{
+    ServerMock remoteServer;
+    IndiServerController indiServer;
+
+    setupSigPipe();
+
+    remoteServer.listen(17626);
+
+    indiServer.setFifo(true);
+    indiServer.startDriver("fakedev1@127.0.0.1:17626");
+
+    IndiClientMock remoteCnx;
+    remoteServer.accept(remoteCnx);
+    remoteCnx.cnx.expectXml("<getProperties device='fakedev1' version='1.7'/>");
+
+    indiServer.addDriver("fakedev2@127.0.0.1:17626");
+    remoteCnx.cnx.expectXml("<getProperties device='fakedev2' version='1.7'/>");
+
+    IndiClientMock indiClient;
+    indiClient.connectTcp(indiServer);
+    indiClient.cnx.send("<getProperties version='1.7'/>\n");
+    remoteCnx.cnx.expectXml("<getProperties version='1.7'/>");
+
+    fprintf(stderr, "Stopping fakedev2 keeps the connection up for fakedev1\n");
+    indiServer.stopDriver("fakedev2@127.0.0.1:17626");
+    indiClient.cnx.expectXml("<delProperty device='fakedev2'/>");
+
+    // What the remote server still sends for fakedev2 is dropped
+    remoteCnx.cnx.send("<message device='fakedev2' message='gone'/>\n");
+    remoteCnx.cnx.send("<message device='fakedev1' message='here'/>\n");
+    indiClient.cnx.expectXml("<message device='fakedev1' message='here'/>");
+
+    remoteServer.close();
+    indiServer.kill();
+    indiServer.join();
+}
+
 TEST(IndiserverSingleDriver, DontLeakFds)
 {
     DriverMock fakeDriver;
@@ -335,66 +459,208 @@ TEST(IndiserverSingleDriver, ForwardBase64BlobToIPClient)
 }
 
 
-TEST(IndiserverSingleDriver, SnoopDriverPropertie)
+// The frames a client of a compressed stream receives, decoded for the checks of decoded
+struct CompressedStreamReader
+{
+    INDI::StreamCompression::Decompressor decompressor {INDI::StreamCompression::CODEC_DEFLATE};
+    ConnectionMock decoded;
+    int fds[2];
+    std::string input;      // received, not a whole frame yet
+    std::string rawFrames;  // content of the 'R' frames
+    std::string text;       // all decoded so far
+
+    CompressedStreamReader()
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1)
+        {
+            throw std::system_error(errno, std::generic_category(), "socketpair");
+        }
+        decoded.setFds(fds[0], fds[0]);
+    }
+
+    ~CompressedStreamReader()
+    {
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    // Read whole frames from cnx until what they decode to contains marker
+    void readUntil(ConnectionMock &cnx, const std::string &marker)
+    {
+        while (text.find(marker) == std::string::npos)
+        {
+            std::string more = cnx.readSome(65536);
+            if (more.empty())
+            {
+                throw std::runtime_error("Input closed while expecting " + marker);
+            }
+            input += more;
+
+            while (input.size() >= INDI::StreamCompression::FRAME_HEADER)
+            {
+                uint32_t length = 0;
+                for (int i = 0; i < 4; i++)
+                {
+                    length |= static_cast<uint32_t>(static_cast<uint8_t>(input[1 + i])) << (8 * i);
+                }
+                size_t frameSize = INDI::StreamCompression::FRAME_HEADER + length;
+                if (input.size() < frameSize)
+                {
+                    break;
+                }
+                ASSERT_TRUE(input[0] == 'Z' || input[0] == 'R') << "frame kind " << int(input[0]);
+                if (input[0] == 'R')
+                {
+                    rawFrames += input.substr(INDI::StreamCompression::FRAME_HEADER, length);
+                }
+
+                std::vector<char> out;
+                ASSERT_TRUE(decompressor.read(input.data(), frameSize, out));
+                input.erase(0, frameSize);
+
+                std::string chunk(out.begin(), out.end());
+                text += chunk;
+                ASSERT_EQ(::write(fds[1], chunk.data(), chunk.size()), ssize_t(chunk.size()));
+            }
+        }
+    }
+};
+
+TEST(IndiserverSingleDriver, CompressStreamToClientAskingForIt)
 {
-    // This tests snooping simple property from driver to driver
     DriverMock fakeDriver;
     IndiServerController indiServer;
-    indiServer.setFifo(true);
+
     startFakeDev1(indiServer, fakeDriver);
 
-    DriverMock snoopDriver;
-    addDriver(indiServer, snoopDriver, "snoopDriver");
+    IndiClientMock indiClient;
+    indiClient.connectTcp(indiServer);
 
+    fprintf(stderr, "Client offers to compress\n");
+    indiClient.cnx.send("<getProperties version='1.7' compress='deflate'/>\n");
+    // The offer is for the server, the driver does not see it
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+    indiClient.cnx.expect("<compressStream codec='deflate'/>\n");
+
+    fprintf(stderr, "Another client stays plain\n");
+    IndiClientMock plainClient;
+    plainClient.connectTcp(indiServer);
+    plainClient.cnx.send("<getProperties version='1.7'/>\n");
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    fprintf(stderr, "Driver sends properties\n");
+    fakeDriver.cnx.send("<defBLOBVector device='fakedev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defBLOB name='content' label='content'/>\n");
+    fakeDriver.cnx.send("</defBLOBVector>\n");
+
+    CompressedStreamReader reader;
+    reader.readUntil(indiClient.cnx, "</defBLOBVector>");
+    reader.decoded.expectXml("<defBLOBVector device=\"fakedev1\" name=\"testblob\" label=\"test label\" group=\"test_group\" state=\"Idle\" perm=\"ro\" timeout=\"100\" timestamp=\"2018-01-01T00:00:00\">");
+    reader.decoded.expectXml("<defBLOB name=\"content\" label=\"content\"/>");
+    reader.decoded.expectXml("</defBLOBVector>");
+    EXPECT_TRUE(reader.rawFrames.empty());
+
+    plainClient.cnx.expectXml("<defBLOBVector device=\"fakedev1\" name=\"testblob\" label=\"test label\" group=\"test_group\" state=\"Idle\" perm=\"ro\" timeout=\"100\" timestamp=\"2018-01-01T00:00:00\">");
+    plainClient.cnx.expectXml("<defBLOB name=\"content\" label=\"content\"/>");
+    plainClient.cnx.expectXml("</defBLOBVector>");
+
+    fprintf(stderr, "Clients ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    plainClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    plainClient.ping();
+
+    fprintf(stderr, "Driver sends an fpack compressed blob\n");
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='20' format='.fits.fz' enclen='29'>\n");
+    fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK\n");
+    fakeDriver.cnx.send("</oneBLOB>\n");
+    fakeDriver.cnx.send("</setBLOBVector>\n");
     fakeDriver.ping();
-    snoopDriver.ping();
 
-    snoopDriver.cnx.send("<getProperties version='1.7' device='fakedev1' name='testnumber1'/>\n");
+    // Already compressed, the payload goes as it is
+    reader.readUntil(indiClient.cnx, "</setBLOBVector>");
+    EXPECT_NE(reader.rawFrames.find("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK"), std::string::npos);
+    reader.decoded.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    reader.decoded.expectXml("<oneBLOB name='content' size='20' format='.fits.fz' enclen='29'>");
+    reader.decoded.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkK");
+    reader.decoded.expectXml("</oneBLOB>\n");
+    reader.decoded.expectXml("</setBLOBVector>");
+
+    plainClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    plainClient.cnx.expectXml("<oneBLOB name='content' size='20' format='.fits.fz' enclen='29'>");
+    plainClient.cnx.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkK");
+    plainClient.cnx.expectXml("</oneBLOB>\n");
+    plainClient.cnx.expectXml("</setBLOBVector>");
 
-    snoopDriver.ping();
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+
+TEST(IndiserverSingleDriver, ForwardBase64BlobWithIoThreads)
+{
+    // Same as ForwardBase64BlobToIPClient, with client and driver queues spread on several loops
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    indiServer.setExtraArgs({ "-j", "4" });
+    startFakeDev1(indiServer, fakeDriver);
+    // Ordering is only guaranteed per queue: make sure the initial definition is processed
     fakeDriver.ping();
 
-    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber1' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
-    fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>50</defNumber>\n");
-    fakeDriver.cnx.send("</defNumberVector>\n");
+    IndiClientMock indiClient;
 
-    snoopDriver.cnx.expectXml("<defNumberVector device='fakedev1' name='testnumber1' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>");
-    snoopDriver.cnx.expectXml("<defNumber name='content' label='content' min='0' max='100' step='1'>");
-    snoopDriver.cnx.expect("\n50");
-    snoopDriver.cnx.expectXml("</defNumber>");
-    snoopDriver.cnx.expectXml("</defNumberVector>");
+    indiClient.connectTcp(indiServer);
 
-    fakeDriver.terminateDriver();
-    snoopDriver.terminateDriver();
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
 
-    indiServer.kill();
-    indiServer.join();
-}
+    fprintf(stderr, "Client ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
 
+    for(int i = 0; i < BLOB_REPEAT_COUNT; ++i)
+    {
+        fprintf(stderr, "Driver send new blob value\n");
+        fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+        fakeDriver.cnx.send("<oneBLOB name='content' size='20' format='.fits' enclen='29'>\n");
+        fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK\n");
+        fakeDriver.cnx.send("</oneBLOB>\n");
+        fakeDriver.cnx.send("</setBLOBVector>\n");
+        fakeDriver.ping();
 
-#define DUMMY_BLOB_SIZE 64
+        fprintf(stderr, "Client receive blob\n");
+        indiClient.cnx.allowBufferReceive(true);
+        indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+        indiClient.cnx.expectXml("<oneBLOB name='content' size='20' format='.fits' enclen='29'>");
+        indiClient.cnx.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkK");
+        indiClient.cnx.expectXml("</oneBLOB>\n");
+        indiClient.cnx.expectXml("</setBLOBVector>");
+    }
 
-#ifdef ENABLE_INDI_SHARED_MEMORY
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
 
-TEST(IndiserverSingleDriver, ForwardBase64BlobToUnixClient)
+TEST(IndiserverSingleDriver, ForwardBase64BlobWithPollBackend)
 {
-    // This tests decoding of base64 by driver
+    // Same as ForwardBase64BlobToIPClient, with an explicit libev backend
     DriverMock fakeDriver;
     IndiServerController indiServer;
 
+    indiServer.setExtraArgs({ "-b", "poll" });
     startFakeDev1(indiServer, fakeDriver);
 
     IndiClientMock indiClient;
 
-    indiClient.connectUnix(indiServer);
+    indiClient.connectTcp(indiServer);
 
     connectFakeDev1Client(indiServer, fakeDriver, indiClient);
 
-    fprintf(stderr, "Client ask blobs\n");
     indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
     indiClient.ping();
 
-    fprintf(stderr, "Driver send new blob value\n");
     fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
     fakeDriver.cnx.send("<oneBLOB name='content' size='20' format='.fits' enclen='29'>\n");
     fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK\n");
@@ -402,66 +668,72 @@ TEST(IndiserverSingleDriver, ForwardBase64BlobToUnixClient)
     fakeDriver.cnx.send("</setBLOBVector>\n");
     fakeDriver.ping();
 
-    fprintf(stderr, "Client receive blob\n");
-    indiClient.cnx.allowBufferReceive(true);
     indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
-    indiClient.cnx.expectXml("<oneBLOB name='content' size='20' format='.fits' attached='true'/>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='20' format='.fits' enclen='29'>");
+    indiClient.cnx.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkK");
+    indiClient.cnx.expectXml("</oneBLOB>\n");
     indiClient.cnx.expectXml("</setBLOBVector>");
 
-    SharedBuffer receivedFd;
-    indiClient.cnx.expectBuffer(receivedFd);
-    indiClient.cnx.allowBufferReceive(false);
-
-    EXPECT_GE( receivedFd.getSize(), 20);
-
     fakeDriver.terminateDriver();
     // Exit code 1 is expected when driver stopped
     indiServer.waitProcessEnd(1);
 }
 
-void driverSendAttachedBlob(DriverMock &fakeDriver, ssize_t size)
+TEST(IndiserverSingleDriver, ForwardLargeBase64BlobToIPClient)
 {
-    fprintf(stderr, "Driver send new blob value as attachment\n");
+    // This tests the parsing of large reads by the xml parsing threads
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
 
-    // Allocate more memory than asked (simulate kernel BSD kernel rounding up)
-    ssize_t physical_size=0x10000;
-    if (physical_size < size) {
-        physical_size = size;
-    }
+    indiServer.setExtraArgs({ "-x", "1" });
+    startFakeDev1(indiServer, fakeDriver);
 
-    // The attachment must be done before EOF
-    SharedBuffer fd;
-    fd.allocate(physical_size);
+    IndiClientMock indiClient;
 
-    char * buffer = (char*)malloc(physical_size);
-    for(auto i = 0; i < physical_size; ++i)
-    {
-        buffer[i] = {(char)('0' + (i % 10))};
-    }
-    fd.write(buffer, 0, physical_size);
-    free(buffer);
+    indiClient.connectTcp(indiServer);
 
-    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
-    fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits' attached='true'/>\n", fd);
-    fakeDriver.cnx.send("</setBLOBVector>");
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
 
-    fd.release();
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    // A multiple of the 30 bytes pattern, spanning many reads
+    ssize_t size = 30 * 20000;
+    std::string base64;
+    for(int i = 0; i < size / 30; ++i)
+    {
+        base64 += "MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5";
+    }
+    // In 72 columns lines, like drivers
+    std::string lines;
+    for(std::size_t i = 0; i < base64.size(); i += 72)
+    {
+        lines += base64.substr(i, 72) + "\n";
+    }
 
-/*#else
     fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
-    fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits'>\n");
-    fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDE=\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits' enclen='" + std::to_string(base64.size()) + "'>\n");
+    fakeDriver.cnx.send(lines);
     fakeDriver.cnx.send("</oneBLOB>\n");
-    fakeDriver.cnx.send("</setBLOBVector>");
-#endif
-*/
-
+    fakeDriver.cnx.send("</setBLOBVector>\n");
+    // Replied once everything before was handled
     fakeDriver.ping();
+
+    indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits' enclen='" + std::to_string(base64.size()) + "'>");
+    std::string received = indiClient.cnx.expectBase64();
+    received.erase(std::remove_if(received.begin(), received.end(), isspace), received.end());
+    EXPECT_EQ(received, base64);
+    indiClient.cnx.expectXml("</oneBLOB>\n");
+    indiClient.cnx.expectXml("</setBLOBVector>");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
 }
 
-TEST(IndiserverSingleDriver, ForwardAttachedBlobToUnixClient)
+TEST(IndiserverSingleDriver, ThrottleStreamBlobPerClient)
 {
-    // This tests attached blob pass through
     DriverMock fakeDriver;
     IndiServerController indiServer;
 
@@ -469,33 +741,33 @@ TEST(IndiserverSingleDriver, ForwardAttachedBlobToUnixClient)
 
     IndiClientMock indiClient;
 
-    indiClient.connectUnix(indiServer);
+    indiClient.connectTcp(indiServer);
 
     connectFakeDev1Client(indiServer, fakeDriver, indiClient);
 
-    fprintf(stderr, "Client ask blobs\n");
-    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
-    // This ping ensures enableBLOB is handled before the blob is received
-
-    for(int i = 0; i < BLOB_REPEAT_COUNT; ++i) {
-        indiClient.ping();
-
+    fprintf(stderr, "Client ask blobs at most once per 10s\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob' fps='0.1'>Also</enableBLOB>\n");
+    indiClient.ping();
 
-        ssize_t size = 32;
-        driverSendAttachedBlob(fakeDriver, size);
+    fprintf(stderr, "Driver send stream frames, then a regular blob\n");
+    for(auto format : { ".stream", ".stream", ".stream", ".fits" })
+    {
+        fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+        fakeDriver.cnx.send(std::string("<oneBLOB name='content' size='20' format='") + format + "' enclen='29'>\n");
+        fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK\n");
+        fakeDriver.cnx.send("</oneBLOB>\n");
+        fakeDriver.cnx.send("</setBLOBVector>\n");
+    }
+    fakeDriver.ping();
 
-        // Now receive on client side
-        fprintf(stderr, "Client receive blob\n");
-        indiClient.cnx.allowBufferReceive(true);
+    fprintf(stderr, "Client receive first frame and regular blob only\n");
+    for(auto format : { ".stream", ".fits" })
+    {
         indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
-        indiClient.cnx.expectXml("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits' attached='true'/>");
+        indiClient.cnx.expectXml(std::string("<oneBLOB name='content' size='20' format='") + format + "' enclen='29'>");
+        indiClient.cnx.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkK");
+        indiClient.cnx.expectXml("</oneBLOB>\n");
         indiClient.cnx.expectXml("</setBLOBVector>");
-
-        SharedBuffer receivedFd;
-        indiClient.cnx.expectBuffer(receivedFd);
-        indiClient.cnx.allowBufferReceive(false);
-
-        EXPECT_GE( receivedFd.getSize(), size);
     }
 
     fakeDriver.terminateDriver();
@@ -503,12 +775,12 @@ TEST(IndiserverSingleDriver, ForwardAttachedBlobToUnixClient)
     indiServer.waitProcessEnd(1);
 }
 
-TEST(IndiserverSingleDriver, ForwardAttachedBlobToIPClient)
+TEST(IndiserverSingleDriver, RateLimitDriverSets)
 {
-    // This tests base64 encoding by server
     DriverMock fakeDriver;
     IndiServerController indiServer;
 
+    indiServer.setExtraArgs({ "-q", "fakedev1.num=2" });
     startFakeDev1(indiServer, fakeDriver);
 
     IndiClientMock indiClient;
@@ -517,18 +789,873 @@ TEST(IndiserverSingleDriver, ForwardAttachedBlobToIPClient)
 
     connectFakeDev1Client(indiServer, fakeDriver, indiClient);
 
-    fprintf(stderr, "Client ask blobs\n");
-    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    // Within 0.5s, only the first and the latest pass
+    for (int i = 1; i <= 3; ++i)
+    {
+        fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='num' state='Busy'>\n");
+        fakeDriver.cnx.send("<oneNumber name='value'>" + std::to_string(i) + "</oneNumber>\n");
+        fakeDriver.cnx.send("</setNumberVector>\n");
+    }
+    fakeDriver.ping();
 
-    for(int i = 0; i < BLOB_REPEAT_COUNT; ++i) {
-        indiClient.ping();
+    indiClient.cnx.expectXml("<setNumberVector device=\"fakedev1\" name=\"num\" state=\"Busy\">");
+    indiClient.cnx.expectXml("<oneNumber name=\"value\">");
+    indiClient.cnx.expect("\n1");
+    indiClient.cnx.expectXml("</oneNumber>");
+    indiClient.cnx.expectXml("</setNumberVector>");
+
+    indiClient.cnx.expectXml("<setNumberVector device=\"fakedev1\" name=\"num\" state=\"Busy\">");
+    indiClient.cnx.expectXml("<oneNumber name=\"value\">");
+    indiClient.cnx.expect("\n3");
+    indiClient.cnx.expectXml("</oneNumber>");
+    indiClient.cnx.expectXml("</setNumberVector>");
+
+    // Reaching Ok is not delayed
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='num' state='Ok'>\n");
+    fakeDriver.cnx.send("<oneNumber name='value'>4</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+
+    indiClient.cnx.expectXml("<setNumberVector device=\"fakedev1\" name=\"num\" state=\"Ok\">");
+    indiClient.cnx.expectXml("<oneNumber name=\"value\">");
+    indiClient.cnx.expect("\n4");
+    indiClient.cnx.expectXml("</oneNumber>");
+    indiClient.cnx.expectXml("</setNumberVector>");
 
-        ssize_t size = 32;
-        driverSendAttachedBlob(fakeDriver, size);
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
 
-        // Now receive on client side
-        fprintf(stderr, "Client receive blob\n");
-        indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+static void driverDefineNum(DriverMock &fakeDriver, const std::string &value, const std::string &timestamp)
+{
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='num' label='num' group='g' state='Idle' perm='ro' timeout='0' timestamp='" + timestamp + "'>\n");
+    fakeDriver.cnx.send("<defNumber name='value' label='value' format='%g' min='0' max='10' step='1'>" + value + "</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+}
+
+static void expectNum(IndiClientMock &indiClient, const std::string &value)
+{
+    indiClient.cnx.expectXml("<defNumberVector device='fakedev1' name='num' label='num' group='g' state='Idle' perm='ro' timeout='0' timestamp='2018-01-01T00:00:00'>");
+    indiClient.cnx.expectXml("<defNumber name='value' label='value' format='%g' min='0' max='10' step='1'>");
+    indiClient.cnx.expect("\n" + value);
+    indiClient.cnx.expectXml("</defNumber>");
+    indiClient.cnx.expectXml("</defNumberVector>");
+}
+
+static void driverSetNum(DriverMock &fakeDriver, const std::string &value, const std::string &extra = "")
+{
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='num' state='Busy'" + extra + ">\n");
+    fakeDriver.cnx.send("<oneNumber name='value'>" + value + "</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+}
+
+static void expectSetNum(IndiClientMock &indiClient, const std::string &value, const std::string &extra = "")
+{
+    indiClient.cnx.expectXml("<setNumberVector device=\"fakedev1\" name=\"num\" state=\"Busy\"" + extra + ">");
+    indiClient.cnx.expectXml("<oneNumber name=\"value\">");
+    indiClient.cnx.expect("\n" + value);
+    indiClient.cnx.expectXml("</oneNumber>");
+    indiClient.cnx.expectXml("</setNumberVector>");
+}
+
+TEST(IndiserverSingleDriver, RateLimitKeepsHeldSetsInOrder)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    indiServer.setExtraArgs({ "-q", "fakedev1.num=2" });
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectTcp(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    // A set held when its property goes away is dropped
+    driverSetNum(fakeDriver, "1");
+    driverSetNum(fakeDriver, "2");
+    fakeDriver.cnx.send("<delProperty device='fakedev1' name='num'/>\n");
+
+    expectSetNum(indiClient, "1");
+    indiClient.cnx.expectXml("<delProperty device=\"fakedev1\" name=\"num\"/>");
+
+    // A set held when a message of the device comes is sent before it
+    driverDefineNum(fakeDriver, "7", "2018-01-01T00:00:00");
+    expectNum(indiClient, "7");
+    driverSetNum(fakeDriver, "8");
+    fakeDriver.cnx.send("<message device='fakedev1' message='hello'/>\n");
+
+    expectSetNum(indiClient, "8");
+    indiClient.cnx.expectXml("<message device=\"fakedev1\" message=\"hello\"/>");
+
+    // A held set that carries a message is not replaced, it goes out at once
+    driverSetNum(fakeDriver, "9", " message='first'");
+    driverSetNum(fakeDriver, "10");
+    fakeDriver.ping();
+
+    expectSetNum(indiClient, "9", " message=\"first\"");
+    expectSetNum(indiClient, "10");
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+static void driverDefineText(DriverMock &fakeDriver, const std::string &name)
+{
+    fakeDriver.cnx.send("<defTextVector device='fakedev1' name='" + name + "' label='text' group='g' state='Idle' perm='ro' timeout='0' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defText name='value' label='value'>text</defText>\n");
+    fakeDriver.cnx.send("</defTextVector>\n");
+}
+
+static void expectText(IndiClientMock &indiClient, const std::string &name)
+{
+    indiClient.cnx.expectXml("<defTextVector device='fakedev1' name='" + name + "' label='text' group='g' state='Idle' perm='ro' timeout='0' timestamp='2018-01-01T00:00:00'>");
+    indiClient.cnx.expectXml("<defText name='value' label='value'>");
+    indiClient.cnx.expect("\ntext");
+    indiClient.cnx.expectXml("</defText>");
+    indiClient.cnx.expectXml("</defTextVector>");
+}
+
+// Returns the generation of the def
+static std::string expectTextWithGeneration(IndiClientMock &indiClient, const std::string &name)
+{
+    std::string generation = indiClient.cnx.expectXmlWithAttribute("<defTextVector device='fakedev1' name='" + name + "' label='text' group='g' state='Idle' perm='ro' timeout='0' timestamp='2018-01-01T00:00:00'>", "generation");
+    indiClient.cnx.expectXml("<defText name='value' label='value'>");
+    indiClient.cnx.expect("\ntext");
+    indiClient.cnx.expectXml("</defText>");
+    indiClient.cnx.expectXml("</defTextVector>");
+    return generation;
+}
+
+// With a small receive buffer, for the server to get behind quickly
+static void connectLaggingClient(IndiServerController &indiServer, IndiClientMock &indiClient)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1)
+    {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    int rcvbuf = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr = {};
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(indiServer.getTcpPort());
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        throw std::system_error(errno, std::generic_category(), "connect");
+    }
+    indiClient.associate(fd);
+}
+
+// A blob of size base64 bytes, received by the lagging client once it reads again
+static void driverSendLargeBlob(DriverMock &fakeDriver, size_t size, const std::string &format)
+{
+    std::string lines;
+    for (size_t i = 0; i < size / 40; ++i)
+    {
+        lines += "MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5\n";
+    }
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(size / 4 * 3) + "' format='" + format + "' enclen='" + std::to_string(size) + "'>\n");
+    fakeDriver.cnx.send(lines);
+    fakeDriver.cnx.send("</oneBLOB>\n");
+    fakeDriver.cnx.send("</setBLOBVector>\n");
+}
+
+TEST(IndiserverSingleDriver, CoalesceSetsForLaggingClient)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    indiServer.setExtraArgs({ "-c" });
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+    connectLaggingClient(indiServer, indiClient);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+    driverDefineNum(fakeDriver, "0", "2018-01-01T00:00:00");
+    expectNum(indiClient, "0");
+    driverDefineText(fakeDriver, "gone");
+    expectText(indiClient, "gone");
+
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    fprintf(stderr, "Client stops reading behind a large blob\n");
+    driverSendLargeBlob(fakeDriver, 8000000, ".fits");
+
+    // Only the last of each burst is still queued, and no set passes a del or a def
+    for (int i = 1; i <= 10; ++i)
+    {
+        driverSetNum(fakeDriver, std::to_string(i));
+    }
+    fakeDriver.cnx.send("<delProperty device='fakedev1' name='gone'/>\n");
+    driverSetNum(fakeDriver, "11");
+    driverSetNum(fakeDriver, "12");
+    driverDefineText(fakeDriver, "added");
+    for (int i = 13; i <= 20; ++i)
+    {
+        driverSetNum(fakeDriver, std::to_string(i));
+    }
+    fakeDriver.ping();
+
+    fprintf(stderr, "Client catches up\n");
+    indiClient.cnx.skipUntil("</setBLOBVector>");
+    expectSetNum(indiClient, "10");
+    indiClient.cnx.expectXml("<delProperty device='fakedev1' name='gone'/>");
+    expectSetNum(indiClient, "12");
+    expectText(indiClient, "added");
+    expectSetNum(indiClient, "20");
+    indiClient.ping();
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+static void driverSendFrame(DriverMock &fakeDriver, const std::string &base64)
+{
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='3' format='.stream_jpg' enclen='4'>" + base64 + "</oneBLOB>\n");
+    fakeDriver.cnx.send("</setBLOBVector>\n");
+}
+
+static void expectFrame(IndiClientMock &indiClient, const std::string &base64)
+{
+    indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='3' format='.stream_jpg' enclen='4'>");
+    indiClient.cnx.expect("\n" + base64);
+    indiClient.cnx.expectXml("</oneBLOB>");
+    indiClient.cnx.expectXml("</setBLOBVector>");
+}
+
+TEST(IndiserverSingleDriver, LatestFrameOnlyForLaggingClient)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    // The client gets far more than 1 MB behind, and is kept
+    indiServer.setExtraArgs({ "-m", "1" });
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+    connectLaggingClient(indiServer, indiClient);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+    driverDefineNum(fakeDriver, "0", "2018-01-01T00:00:00");
+    expectNum(indiClient, "0");
+
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob' policy='latest'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    fprintf(stderr, "Client stops reading behind a large frame\n");
+    driverSendLargeBlob(fakeDriver, 8000000, ".stream_jpg");
+
+    // Sets of other properties, like the stream statistics, do not make the queued frame final
+    driverSendFrame(fakeDriver, "QUFB");
+    driverSetNum(fakeDriver, "1");
+    driverSendFrame(fakeDriver, "QkJC");
+    driverSetNum(fakeDriver, "2");
+    driverSendFrame(fakeDriver, "Q0ND");
+    driverSetNum(fakeDriver, "3");
+    fakeDriver.ping();
+
+    fprintf(stderr, "Client catches up\n");
+    indiClient.cnx.skipUntil("</setBLOBVector>");
+    expectFrame(indiClient, "Q0ND");
+    expectSetNum(indiClient, "1");
+    expectSetNum(indiClient, "2");
+    expectSetNum(indiClient, "3");
+    indiClient.ping();
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverSingleDriver, KeepPropertiesAcrossDriverRestart)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    indiServer.setExtraArgs({ "-k", "-r", "1" });
+    startFakeDev1(indiServer, fakeDriver);
+    fakeDriver.ping();
+
+    IndiClientMock indiClient;
+
+    indiClient.connectTcp(indiServer);
+
+    // What the driver defined at startup is served by the server
+    indiClient.cnx.send("<getProperties version='1.7'/>\n");
+    indiClient.cnx.expectXml("<defBLOBVector device='fakeDev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>");
+    indiClient.cnx.expectXml("<defBLOB name='content' label='content'/>");
+    indiClient.cnx.expectXml("</defBLOBVector>");
+    fakeDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    fakeDriver.cnx.send("<defBLOBVector device='fakedev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defBLOB name='content' label='content'/>\n");
+    fakeDriver.cnx.send("</defBLOBVector>\n");
+    indiClient.cnx.expectXml("<defBLOBVector device='fakedev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>");
+    indiClient.cnx.expectXml("<defBLOB name='content' label='content'/>");
+    indiClient.cnx.expectXml("</defBLOBVector>");
+
+    driverDefineNum(fakeDriver, "1", "2018-01-01T00:00:00");
+    expectNum(indiClient, "1");
+
+    // The cached definition follows the sets
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='num' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<oneNumber name='value'>2</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+    indiClient.cnx.expectXml("<setNumberVector device='fakedev1' name='num' timestamp='2018-01-01T00:00:00'>");
+    indiClient.cnx.expectXml("<oneNumber name='value'>");
+    indiClient.cnx.expect("\n2");
+    indiClient.cnx.expectXml("</oneNumber>");
+    indiClient.cnx.expectXml("</setNumberVector>");
+
+    fprintf(stderr, "Driver crashes\n");
+    fakeDriver.terminateDriver();
+
+    DriverMock restartedDriver;
+    restartedDriver.waitEstablish();
+    restartedDriver.cnx.expectXml("<getProperties version='1.7'/>");
+
+    // Only what changed reaches the client, and nothing got deleted
+    restartedDriver.cnx.send("<defBLOBVector device='fakedev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:10'>\n");
+    restartedDriver.cnx.send("<defBLOB name='content' label='content'/>\n");
+    restartedDriver.cnx.send("</defBLOBVector>\n");
+    driverDefineNum(restartedDriver, "3", "2018-01-01T00:00:00");
+    restartedDriver.ping();
+
+    expectNum(indiClient, "3");
+    indiClient.ping();
+
+    fprintf(stderr, "New client gets the cached properties\n");
+    IndiClientMock otherClient;
+    otherClient.connectTcp(indiServer);
+    otherClient.cnx.send("<getProperties version='1.7' device='fakedev1'/>\n");
+    expectNum(otherClient, "3");
+    otherClient.cnx.expectXml("<defBLOBVector device='fakedev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>");
+    otherClient.cnx.expectXml("<defBLOB name='content' label='content'/>");
+    otherClient.cnx.expectXml("</defBLOBVector>");
+    restartedDriver.cnx.expectXml("<getProperties version='1.7' device='fakedev1'/>");
+
+    restartedDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+static std::string expectBlobDef(IndiClientMock &indiClient)
+{
+    std::string generation = indiClient.cnx.expectXmlWithAttribute("<defBLOBVector device='fakeDev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:00:00'>", "generation");
+    indiClient.cnx.expectXml("<defBLOB name='content' label='content'/>");
+    indiClient.cnx.expectXml("</defBLOBVector>");
+    return generation;
+}
+
+static std::string expectNumWithGeneration(IndiClientMock &indiClient, const std::string &value, const std::string &timestamp)
+{
+    std::string generation = indiClient.cnx.expectXmlWithAttribute("<defNumberVector device='fakedev1' name='num' label='num' group='g' state='Idle' perm='ro' timeout='0' timestamp='" + timestamp + "'>", "generation");
+    indiClient.cnx.expectXml("<defNumber name='value' label='value' format='%g' min='0' max='10' step='1'>");
+    indiClient.cnx.expect("\n" + value);
+    indiClient.cnx.expectXml("</defNumber>");
+    indiClient.cnx.expectXml("</defNumberVector>");
+    return generation;
+}
+
+TEST(IndiserverSingleDriver, ResyncReconnectingClientWithChangesOnly)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    indiServer.setExtraArgs({ "-k" });
+    startFakeDev1(indiServer, fakeDriver);
+
+    driverDefineText(fakeDriver, "gone");
+    driverDefineNum(fakeDriver, "1", "2018-01-01T00:00:00");
+    fakeDriver.ping();
+
+    fprintf(stderr, "Client asks for generations\n");
+    std::string generation;
+    {
+        IndiClientMock indiClient;
+        indiClient.connectTcp(indiServer);
+        indiClient.cnx.send("<getProperties version='1.7' generation='0'/>\n");
+        // Cached properties come by device then name
+        expectBlobDef(indiClient);
+        expectTextWithGeneration(indiClient, "gone");
+        generation = expectNumWithGeneration(indiClient, "1", "2018-01-01T00:00:00");
+        indiClient.ping();
+        fakeDriver.cnx.expectXml("<getProperties version='1.7' generation='0'/>");
+        indiClient.close();
+    }
+
+    fprintf(stderr, "Properties change while the client is away\n");
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='num' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneNumber name='value'>2</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+    fakeDriver.cnx.send("<delProperty device='fakedev1' name='gone'/>\n");
+    driverDefineText(fakeDriver, "added");
+    // Defined again as it was, not a change
+    fakeDriver.cnx.send("<defBLOBVector device='fakeDev1' name='testblob' label='test label' group='test_group' state='Idle' perm='ro' timeout='100' timestamp='2018-01-01T00:02:00'>\n");
+    fakeDriver.cnx.send("<defBLOB name='content' label='content'/>\n");
+    fakeDriver.cnx.send("</defBLOBVector>\n");
+    fakeDriver.ping();
+
+    fprintf(stderr, "Client reconnects with its last generation\n");
+    {
+        IndiClientMock indiClient;
+        indiClient.connectTcp(indiServer);
+        indiClient.cnx.send("<getProperties version='1.7' generation='" + generation + "'/>\n");
+        std::string added = expectTextWithGeneration(indiClient, "added");
+        std::string deleted = indiClient.cnx.expectXmlWithAttribute("<delProperty device='fakedev1' name='gone'/>", "generation");
+        std::string num = expectNumWithGeneration(indiClient, "2", "2018-01-01T00:01:00");
+        // Nothing else, the blob did not change
+        indiClient.ping();
+        fakeDriver.cnx.expectXml("<getProperties version='1.7' generation='" + generation + "'/>");
+
+        for (auto &later : { added, deleted, num })
+        {
+            ASSERT_EQ(later.substr(0, later.find(':')), generation.substr(0, generation.find(':')));
+            ASSERT_GT(std::stoull(later.substr(later.find(':') + 1)), std::stoull(generation.substr(generation.find(':') + 1)));
+        }
+        indiClient.close();
+    }
+
+    fprintf(stderr, "Generation of another server run gets everything\n");
+    {
+        IndiClientMock indiClient;
+        indiClient.connectTcp(indiServer);
+        indiClient.cnx.send("<getProperties version='1.7' generation='1:1'/>\n");
+        expectBlobDef(indiClient);
+        expectTextWithGeneration(indiClient, "added");
+        expectNumWithGeneration(indiClient, "2", "2018-01-01T00:01:00");
+        indiClient.ping();
+        fakeDriver.cnx.expectXml("<getProperties version='1.7' generation='1:1'/>");
+        indiClient.close();
+    }
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverSingleDriver, DumpMetrics)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+    indiServer.setFifo(true);
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectTcp(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='20' format='.fits' enclen='29'>\n");
+    fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK\n");
+    fakeDriver.cnx.send("</oneBLOB>\n");
+    fakeDriver.cnx.send("</setBLOBVector>\n");
+    fakeDriver.ping();
+
+    indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='20' format='.fits' enclen='29'>");
+    indiClient.cnx.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkK");
+    indiClient.cnx.expectXml("</oneBLOB>\n");
+    indiClient.cnx.expectXml("</setBLOBVector>");
+
+    const std::string metricsPath = "/tmp/indi-test-metrics.prom";
+    unlink(metricsPath.c_str());
+    indiServer.dumpMetrics(metricsPath);
+
+    // The fifo is processed asynchronously
+    std::string metrics;
+    for(int i = 0; i < 200 && metrics.empty(); ++i)
+    {
+        usleep(10000);
+        std::ifstream file(metricsPath);
+        std::stringstream content;
+        content << file.rdbuf();
+        metrics = content.str();
+    }
+    unlink(metricsPath.c_str());
+
+    EXPECT_NE(metrics.find("indiserver_messages_routed_total{tag=\"setBLOBVector\"} 1\n"), std::string::npos) << metrics;
+    EXPECT_NE(metrics.find("indiserver_blob_bytes_in_total 20\n"), std::string::npos) << metrics;
+    EXPECT_NE(metrics.find("indiserver_blob_bytes_out_total 20\n"), std::string::npos) << metrics;
+    EXPECT_NE(metrics.find("indiserver_clients_killed_total 0\n"), std::string::npos) << metrics;
+    EXPECT_NE(metrics.find("indiserver_loop_iteration_seconds_bucket{le=\"+Inf\"}"), std::string::npos) << metrics;
+
+    fakeDriver.terminateDriver();
+    indiServer.kill();
+    indiServer.join();
+}
+
+TEST(IndiserverSingleDriver, RecordTraffic)
+{
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    const std::string capturePath = "/tmp/indi-test-capture.txt";
+    unlink(capturePath.c_str());
+    indiServer.setExtraArgs({ "-t", capturePath });
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectTcp(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+    indiClient.ping();
+
+    // The capture is flushed by the event loop
+    std::string capture;
+    for(int i = 0; i < 200 && capture.find("pingRequest") == std::string::npos; ++i)
+    {
+        usleep(10000);
+        std::ifstream file(capturePath);
+        std::stringstream content;
+        content << file.rdbuf();
+        capture = content.str();
+    }
+    unlink(capturePath.c_str());
+
+    std::string clientGetProperties = "<getProperties version=\"1.7\"/>\n";
+    EXPECT_NE(capture.find(" c 1 " + std::to_string(clientGetProperties.size()) + "\n" + clientGetProperties),
+              std::string::npos) << capture;
+    EXPECT_NE(capture.find(" d 1 "), std::string::npos) << capture;
+    EXPECT_NE(capture.find("<defBLOBVector device=\"fakedev1\" name=\"testblob\""), std::string::npos) << capture;
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverSingleDriver, SnoopDriverPropertie)
+{
+    // This tests snooping simple property from driver to driver
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+    indiServer.setFifo(true);
+    startFakeDev1(indiServer, fakeDriver);
+
+    DriverMock snoopDriver;
+    addDriver(indiServer, snoopDriver, "snoopDriver");
+
+    fakeDriver.ping();
+    snoopDriver.ping();
+
+    snoopDriver.cnx.send("<getProperties version='1.7' device='fakedev1' name='testnumber1'/>\n");
+
+    snoopDriver.ping();
+    fakeDriver.ping();
+
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber1' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>50</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+
+    snoopDriver.cnx.expectXml("<defNumberVector device='fakedev1' name='testnumber1' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>");
+    snoopDriver.cnx.expectXml("<defNumber name='content' label='content' min='0' max='100' step='1'>");
+    snoopDriver.cnx.expect("\n50");
+    snoopDriver.cnx.expectXml("</defNumber>");
+    snoopDriver.cnx.expectXml("</defNumberVector>");
+
+    fakeDriver.terminateDriver();
+    snoopDriver.terminateDriver();
+
+    indiServer.kill();
+    indiServer.join();
+}
+
+TEST(IndiserverSingleDriver, SnoopLatestValue)
+{
+    // A driver snooping in latest-value mode gets the changes beyond the threshold, and the latest value on request
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+    indiServer.setFifo(true);
+    startFakeDev1(indiServer, fakeDriver);
+
+    DriverMock snoopDriver;
+    addDriver(indiServer, snoopDriver, "snoopDriver");
+
+    fakeDriver.ping();
+    snoopDriver.ping();
+
+    snoopDriver.cnx.send("<getProperties version='1.7' device='fakedev1' name='testnumber1' snoop='latest' threshold='1'/>\n");
+
+    snoopDriver.ping();
+    fakeDriver.ping();
+
+    fakeDriver.cnx.send("<defNumberVector device='fakedev1' name='testnumber1' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>\n");
+    fakeDriver.cnx.send("<defNumber name='content' label='content' min='0' max='100' step='1'>50</defNumber>\n");
+    fakeDriver.cnx.send("</defNumberVector>\n");
+
+    snoopDriver.cnx.expectXml("<defNumberVector device='fakedev1' name='testnumber1' label='test label' group='test_group' state='Idle' perm='rw' timeout='100' timestamp='2018-01-01T00:00:00'>");
+    snoopDriver.cnx.expectXml("<defNumber name='content' label='content' min='0' max='100' step='1'>");
+    snoopDriver.cnx.expect("\n50");
+    snoopDriver.cnx.expectXml("</defNumber>");
+    snoopDriver.cnx.expectXml("</defNumberVector>");
+
+    // Only the update beyond the threshold from what was last sent passes
+    for (auto value : { "50.5", "51.5", "51.8" })
+    {
+        fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='testnumber1' state='Idle'>\n");
+        fakeDriver.cnx.send(std::string("<oneNumber name='content'>") + value + "</oneNumber>\n");
+        fakeDriver.cnx.send("</setNumberVector>\n");
+    }
+    fakeDriver.ping();
+
+    snoopDriver.cnx.expectXml("<setNumberVector device='fakedev1' name='testnumber1' state='Idle'>");
+    snoopDriver.cnx.expectXml("<oneNumber name='content'>");
+    snoopDriver.cnx.expect("\n51.5");
+    snoopDriver.cnx.expectXml("</oneNumber>");
+    snoopDriver.cnx.expectXml("</setNumberVector>");
+
+    // A pull gets the latest one
+    snoopDriver.cnx.send("<getProperties version='1.7' device='fakedev1' name='testnumber1' snoop='pull'/>\n");
+
+    snoopDriver.cnx.expectXml("<setNumberVector device='fakedev1' name='testnumber1' state='Idle'>");
+    snoopDriver.cnx.expectXml("<oneNumber name='content'>");
+    snoopDriver.cnx.expect("\n51.8");
+    snoopDriver.cnx.expectXml("</oneNumber>");
+    snoopDriver.cnx.expectXml("</setNumberVector>");
+
+    // A change of state always passes
+    fakeDriver.cnx.send("<setNumberVector device='fakedev1' name='testnumber1' state='Busy'>\n");
+    fakeDriver.cnx.send("<oneNumber name='content'>51.8</oneNumber>\n");
+    fakeDriver.cnx.send("</setNumberVector>\n");
+
+    snoopDriver.cnx.expectXml("<setNumberVector device='fakedev1' name='testnumber1' state='Busy'>");
+    snoopDriver.cnx.expectXml("<oneNumber name='content'>");
+    snoopDriver.cnx.expect("\n51.8");
+    snoopDriver.cnx.expectXml("</oneNumber>");
+    snoopDriver.cnx.expectXml("</setNumberVector>");
+
+    fakeDriver.terminateDriver();
+    snoopDriver.terminateDriver();
+
+    indiServer.kill();
+    indiServer.join();
+}
+
+
+#define DUMMY_BLOB_SIZE 64
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+
+TEST(IndiserverSingleDriver, ForwardBase64BlobToUnixClient)
+{
+    // This tests decoding of base64 by driver
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectUnix(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    fprintf(stderr, "Client ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    fprintf(stderr, "Driver send new blob value\n");
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='20' format='.fits' enclen='29'>\n");
+    fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK\n");
+    fakeDriver.cnx.send("</oneBLOB>\n");
+    fakeDriver.cnx.send("</setBLOBVector>\n");
+    fakeDriver.ping();
+
+    fprintf(stderr, "Client receive blob\n");
+    indiClient.cnx.allowBufferReceive(true);
+    indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='20' format='.fits' attached='true'/>");
+    indiClient.cnx.expectXml("</setBLOBVector>");
+
+    SharedBuffer receivedFd;
+    indiClient.cnx.expectBuffer(receivedFd);
+    indiClient.cnx.allowBufferReceive(false);
+
+    EXPECT_GE( receivedFd.getSize(), 20);
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverSingleDriver, ForwardBase64BlobsToUnixClient)
+{
+    // This tests decoding of the base64 blobs of a message, each to a buffer of its own
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectUnix(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    fprintf(stderr, "Client ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient.ping();
+
+    fprintf(stderr, "Driver send new blob values\n");
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='20' format='.fits' enclen='29'>\n");
+    fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkK\n");
+    fakeDriver.cnx.send("</oneBLOB>\n");
+    fakeDriver.cnx.send("<oneBLOB name='preview' size='4' format='.jpg' enclen='9'>\n");
+    fakeDriver.cnx.send("YWJjCg==\n");
+    fakeDriver.cnx.send("</oneBLOB>\n");
+    fakeDriver.cnx.send("</setBLOBVector>\n");
+    fakeDriver.ping();
+
+    fprintf(stderr, "Client receive blobs\n");
+    indiClient.cnx.allowBufferReceive(true);
+    indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+    indiClient.cnx.expectXml("<oneBLOB name='content' size='20' format='.fits' attached='true'/>");
+    indiClient.cnx.expectXml("<oneBLOB name='preview' size='4' format='.jpg' attached='true'/>");
+    indiClient.cnx.expectXml("</setBLOBVector>");
+
+    SharedBuffer content, preview;
+    indiClient.cnx.expectBuffer(content);
+    indiClient.cnx.expectBuffer(preview);
+    indiClient.cnx.allowBufferReceive(false);
+
+    EXPECT_GE( content.getSize(), 20);
+    EXPECT_GE( preview.getSize(), 4);
+    EXPECT_NE( content.getFd(), preview.getFd());
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+void driverSendAttachedBlob(DriverMock &fakeDriver, ssize_t size)
+{
+    fprintf(stderr, "Driver send new blob value as attachment\n");
+
+    // Allocate more memory than asked (simulate kernel BSD kernel rounding up)
+    ssize_t physical_size=0x10000;
+    if (physical_size < size) {
+        physical_size = size;
+    }
+
+    // The attachment must be done before EOF
+    SharedBuffer fd;
+    fd.allocate(physical_size);
+
+    char * buffer = (char*)malloc(physical_size);
+    for(auto i = 0; i < physical_size; ++i)
+    {
+        buffer[i] = {(char)('0' + (i % 10))};
+    }
+    fd.write(buffer, 0, physical_size);
+    free(buffer);
+
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits' attached='true'/>\n", fd);
+    fakeDriver.cnx.send("</setBLOBVector>");
+
+    fd.release();
+
+/*#else
+    fakeDriver.cnx.send("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>\n");
+    fakeDriver.cnx.send("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits'>\n");
+    fakeDriver.cnx.send("MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDE=\n");
+    fakeDriver.cnx.send("</oneBLOB>\n");
+    fakeDriver.cnx.send("</setBLOBVector>");
+#endif
+*/
+
+    fakeDriver.ping();
+}
+
+TEST(IndiserverSingleDriver, ForwardAttachedBlobToUnixClient)
+{
+    // This tests attached blob pass through
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectUnix(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    fprintf(stderr, "Client ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    // This ping ensures enableBLOB is handled before the blob is received
+
+    for(int i = 0; i < BLOB_REPEAT_COUNT; ++i) {
+        indiClient.ping();
+
+
+        ssize_t size = 32;
+        driverSendAttachedBlob(fakeDriver, size);
+
+        // Now receive on client side
+        fprintf(stderr, "Client receive blob\n");
+        indiClient.cnx.allowBufferReceive(true);
+        indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+        indiClient.cnx.expectXml("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits' attached='true'/>");
+        indiClient.cnx.expectXml("</setBLOBVector>");
+
+        SharedBuffer receivedFd;
+        indiClient.cnx.expectBuffer(receivedFd);
+        indiClient.cnx.allowBufferReceive(false);
+
+        EXPECT_GE( receivedFd.getSize(), size);
+    }
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
+TEST(IndiserverSingleDriver, ForwardAttachedBlobToIPClient)
+{
+    // This tests base64 encoding by server
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient;
+
+    indiClient.connectTcp(indiServer);
+
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient);
+
+    fprintf(stderr, "Client ask blobs\n");
+    indiClient.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+
+    for(int i = 0; i < BLOB_REPEAT_COUNT; ++i) {
+        indiClient.ping();
+
+        ssize_t size = 32;
+        driverSendAttachedBlob(fakeDriver, size);
+
+        // Now receive on client side
+        fprintf(stderr, "Client receive blob\n");
+        indiClient.cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
         indiClient.cnx.expectXml("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits'>");
         // FIXME: get this from size
         indiClient.cnx.expect("\nMDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5MDE=");
@@ -540,6 +1667,60 @@ TEST(IndiserverSingleDriver, ForwardAttachedBlobToIPClient)
     indiServer.waitProcessEnd(1);
 }
 
+TEST(IndiserverSingleDriver, ForwardLargeAttachedBlobToIPClients)
+{
+    // This tests the parallel base64 encoding, shared by all clients
+    DriverMock fakeDriver;
+    IndiServerController indiServer;
+
+    startFakeDev1(indiServer, fakeDriver);
+
+    IndiClientMock indiClient1, indiClient2;
+
+    indiClient1.connectTcp(indiServer);
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient1);
+
+    indiClient2.connectTcp(indiServer);
+    connectFakeDev1Client(indiServer, fakeDriver, indiClient2);
+
+    // The first client also receives the properties sent again by the driver
+    indiClient1.cnx.expectXml("<defBLOBVector device=\"fakedev1\" name=\"testblob\" label=\"test label\" group=\"test_group\" state=\"Idle\" perm=\"ro\" timeout=\"100\" timestamp=\"2018-01-01T00:00:00\">");
+    indiClient1.cnx.expectXml("<defBLOB name=\"content\" label=\"content\"/>");
+    indiClient1.cnx.expectXml("</defBLOBVector>");
+
+    fprintf(stderr, "Clients ask blobs\n");
+    indiClient1.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient2.cnx.send("<enableBLOB device='fakedev1' name='testblob'>Also</enableBLOB>\n");
+    indiClient1.ping();
+    indiClient2.ping();
+
+    // A multiple of the 30 bytes pattern, spanning many base64 chunks
+    ssize_t size = 30 * 20000;
+    driverSendAttachedBlob(fakeDriver, size);
+
+    std::string expected;
+    for(int i = 0; i < size / 30; ++i)
+    {
+        expected += "MDEyMzQ1Njc4OTAxMjM0NTY3ODkwMTIzNDU2Nzg5";
+    }
+
+    for(auto client : { &indiClient1, &indiClient2 })
+    {
+        fprintf(stderr, "Client receive blob\n");
+        client->cnx.expectXml("<setBLOBVector device='fakedev1' name='testblob' timestamp='2018-01-01T00:01:00'>");
+        client->cnx.expectXml("<oneBLOB name='content' size='" + std::to_string(size) + "' format='.fits'>");
+        std::string base64 = client->cnx.expectBase64();
+        base64.erase(std::remove_if(base64.begin(), base64.end(), isspace), base64.end());
+        EXPECT_EQ(base64, expected);
+        client->cnx.expectXml("</oneBLOB>");
+        client->cnx.expectXml("</setBLOBVector>");
+    }
+
+    fakeDriver.terminateDriver();
+    // Exit code 1 is expected when driver stopped
+    indiServer.waitProcessEnd(1);
+}
+
 
 TEST(IndiserverSingleDriver, ForwardAttachedBlobToDriver)
 {
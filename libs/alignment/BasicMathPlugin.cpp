@@ -14,28 +14,16 @@
 
 #include "indicom.h"
 
+#include <cmath>
 #include <limits>
 #include <iostream>
 #include <map>
+#include <vector>
 
 namespace INDI
 {
 namespace AlignmentSubsystem
 {
-BasicMathPlugin::BasicMathPlugin()
-{
-    pActualToApparentTransform = gsl_matrix_alloc(3, 3);
-    pApparentToActualTransform = gsl_matrix_alloc(3, 3);
-}
-
-// Destructor
-
-BasicMathPlugin::~BasicMathPlugin()
-{
-    gsl_matrix_free(pActualToApparentTransform);
-    gsl_matrix_free(pApparentToActualTransform);
-}
-
 // Public methods
 
 bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
@@ -52,6 +40,8 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
     /// - If three compute a transform matrix.
     /// - If four or more compute a convex hull, then matrices for each
     /// triangular facet of the hull.
+    if (SyncPoints.size() < 4)
+        HullSyncPoints.clear();
     switch (SyncPoints.size())
     {
         // JM 2021-07-04: No Transformation required.
@@ -123,8 +113,8 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
             DummyApparentDirectionCosine3.Normalise();
             CalculateTransformMatrices(ActualDirectionCosine1, DummyActualDirectionCosine2, DummyActualDirectionCosine3,
                                        Entry1.TelescopeDirection, DummyApparentDirectionCosine2,
-                                       DummyApparentDirectionCosine3, pActualToApparentTransform,
-                                       pApparentToActualTransform);
+                                       DummyApparentDirectionCosine3, &ActualToApparentTransform,
+                                       &ApparentToActualTransform);
             return true;
         }
         case 2:
@@ -169,8 +159,8 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
             // The third direction vectors is generated by taking the cross product of the first two
             CalculateTransformMatrices(ActualDirectionCosine1, ActualDirectionCosine2, DummyActualDirectionCosine3,
                                        Entry1.TelescopeDirection, Entry2.TelescopeDirection,
-                                       DummyApparentDirectionCosine3, pActualToApparentTransform,
-                                       pApparentToActualTransform);
+                                       DummyApparentDirectionCosine3, &ActualToApparentTransform,
+                                       &ApparentToActualTransform);
             return true;
         }
 
@@ -214,7 +204,7 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
 
             CalculateTransformMatrices(ActualDirectionCosine1, ActualDirectionCosine2, ActualDirectionCosine3,
                                        Entry1.TelescopeDirection, Entry2.TelescopeDirection, Entry3.TelescopeDirection,
-                                       pActualToApparentTransform, pApparentToActualTransform);
+                                       &ActualToApparentTransform, &ApparentToActualTransform);
             return true;
         }
 
@@ -224,18 +214,37 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
             if (!pInMemoryDatabase->GetDatabaseReferencePosition(Position))
                 return false;
 
-            // Compute Hulls etc.
-            ActualConvexHull.Reset();
-            ApparentConvexHull.Reset();
-            ActualDirectionCosines.clear();
-
-            // Add a dummy point at the nadir
-            ActualConvexHull.MakeNewVertex(0.0, 0.0, -1.0, 0);
-            ApparentConvexHull.MakeNewVertex(0.0, 0.0, -1.0, 0);
+            // When sync points were only appended since the hulls were built, add the new ones to the hulls
+            // and only compute the matrices of the faces they bring. Otherwise rebuild everything.
+            size_t HullPoints = HullSyncPoints.size();
+            bool Extend = HullPoints != 0 && HullPoints < SyncPoints.size() &&
+                          HullPosition.longitude == Position.longitude && HullPosition.latitude == Position.latitude &&
+                          HullPosition.elevation == Position.elevation && HullAlignment == ApproximateMountAlignment;
+            for (size_t i = 0; Extend && i < HullPoints; i++)
+                Extend = HullSyncPoints[i].ObservationJulianDate == SyncPoints[i].ObservationJulianDate &&
+                         HullSyncPoints[i].RightAscension == SyncPoints[i].RightAscension &&
+                         HullSyncPoints[i].Declination == SyncPoints[i].Declination &&
+                         HullSyncPoints[i].TelescopeDirection.x == SyncPoints[i].TelescopeDirection.x &&
+                         HullSyncPoints[i].TelescopeDirection.y == SyncPoints[i].TelescopeDirection.y &&
+                         HullSyncPoints[i].TelescopeDirection.z == SyncPoints[i].TelescopeDirection.z;
+
+            if (!Extend)
+            {
+                // Compute Hulls etc.
+                HullPoints = 0;
+                HullSyncPoints.clear();
+                ActualConvexHull.Reset();
+                ApparentConvexHull.Reset();
+                ActualDirectionCosines.clear();
+
+                // Add a dummy point at the nadir
+                ActualConvexHull.MakeNewVertex(0.0, 0.0, -1.0, 0);
+                ApparentConvexHull.MakeNewVertex(0.0, 0.0, -1.0, 0);
+            }
 
-            int VertexNumber = 1;
+            int VertexNumber = static_cast<int>(HullPoints) + 1;
             // Add the rest of the vertices
-            for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin();
+            for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin() + HullPoints;
                     Itr != SyncPoints.end(); Itr++)
             {
                 INDI::IEquatorialCoordinates RaDec;
@@ -254,25 +263,44 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
                     ActualDirectionCosine = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec);
                 }
                 ActualDirectionCosines.push_back(ActualDirectionCosine);
-                ActualConvexHull.MakeNewVertex(ActualDirectionCosine.x, ActualDirectionCosine.y,
+                if (Extend)
+                {
+                    ActualConvexHull.AddVertex(ActualDirectionCosine.x, ActualDirectionCosine.y,
                                                ActualDirectionCosine.z, VertexNumber);
-                ApparentConvexHull.MakeNewVertex((*Itr).TelescopeDirection.x, (*Itr).TelescopeDirection.y,
+                    ApparentConvexHull.AddVertex((*Itr).TelescopeDirection.x, (*Itr).TelescopeDirection.y,
                                                  (*Itr).TelescopeDirection.z, VertexNumber);
+                }
+                else
+                {
+                    ActualConvexHull.MakeNewVertex(ActualDirectionCosine.x, ActualDirectionCosine.y,
+                                                   ActualDirectionCosine.z, VertexNumber);
+                    ApparentConvexHull.MakeNewVertex((*Itr).TelescopeDirection.x, (*Itr).TelescopeDirection.y,
+                                                     (*Itr).TelescopeDirection.z, VertexNumber);
+                }
+                HullSyncPoints.push_back({ (*Itr).ObservationJulianDate, (*Itr).RightAscension, (*Itr).Declination,
+                                           (*Itr).TelescopeDirection });
                 VertexNumber++;
             }
-            // I should only need to do this once but it is easier to do it twice
-            if (!ActualConvexHull.DoubleTriangle())
-                return false;
-            ActualConvexHull.ConstructHull();
+            if (!Extend)
+            {
+                // I should only need to do this once but it is easier to do it twice
+                if (!ActualConvexHull.DoubleTriangle() || !ApparentConvexHull.DoubleTriangle())
+                {
+                    HullSyncPoints.clear();
+                    return false;
+                }
+                ActualConvexHull.ConstructHull();
+                ApparentConvexHull.ConstructHull();
+                HullPosition  = Position;
+                HullAlignment = ApproximateMountAlignment;
+            }
             ActualConvexHull.EdgeOrderOnFaces();
-
-            if (!ApparentConvexHull.DoubleTriangle())
-                return false;
-
-            ApparentConvexHull.ConstructHull();
             ApparentConvexHull.EdgeOrderOnFaces();
 
-            // Make the matrices
+            // Make the matrices of the faces with a new vertex, the others are unchanged, and bucket
+            // all the faces by the directions they cover. A hull of V vertices has 2V - 4 faces.
+            ActualFaceIndex.Reset(2 * VertexNumber - 4);
+            ApparentFaceIndex.Reset(2 * VertexNumber - 4);
             ConvexHull::tFace CurrentFace = ActualConvexHull.faces;
 #ifdef CONVEX_HULL_DEBUGGING
             int ActualFaces = 0;
@@ -298,13 +326,17 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
                                   CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
                                   CurrentFace->vertex[2]->vnum);
 #endif
-                        CalculateTransformMatrices(ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
-                                                   ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
-                                                   ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1],
-                                                   SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
-                                                   SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
-                                                   SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection,
-                                                   CurrentFace->pMatrix, nullptr);
+                        if (HasVertexAfter(CurrentFace, static_cast<int>(HullPoints)))
+                            CalculateTransformMatrices(ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
+                                                       ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
+                                                       ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1],
+                                                       SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
+                                                       SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
+                                                       SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection,
+                                                       &CurrentFace->Matrix, nullptr);
+                        ActualFaceIndex.Insert(CurrentFace, ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
+                                               ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
+                                               ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1]);
                     }
                     CurrentFace = CurrentFace->next;
                 }
@@ -337,13 +369,17 @@ bool BasicMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
                                   CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
                                   CurrentFace->vertex[2]->vnum);
 #endif
-                        CalculateTransformMatrices(SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
-                                                   SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
-                                                   SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection,
-                                                   ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
-                                                   ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
-                                                   ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1],
-                                                   CurrentFace->pMatrix, nullptr);
+                        if (HasVertexAfter(CurrentFace, static_cast<int>(HullPoints)))
+                            CalculateTransformMatrices(SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
+                                                       SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
+                                                       SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection,
+                                                       ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
+                                                       ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
+                                                       ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1],
+                                                       &CurrentFace->Matrix, nullptr);
+                        ApparentFaceIndex.Insert(CurrentFace, SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
+                                                 SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
+                                                 SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection);
                     }
                     CurrentFace = CurrentFace->next;
                 }
@@ -418,18 +454,8 @@ bool BasicMathPlugin::TransformCelestialToTelescope(const double RightAscension,
             {
                 ActualVector = TelescopeDirectionVectorFromEquatorialCoordinates(ActualRaDec);
             }
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLActualVector, 0, ActualVector.x);
-            gsl_vector_set(pGSLActualVector, 1, ActualVector.y);
-            gsl_vector_set(pGSLActualVector, 2, ActualVector.z);
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pActualToApparentTransform, pGSLActualVector, pGSLApparentVector);
-            ApparentTelescopeDirectionVector.x = gsl_vector_get(pGSLApparentVector, 0);
-            ApparentTelescopeDirectionVector.y = gsl_vector_get(pGSLApparentVector, 1);
-            ApparentTelescopeDirectionVector.z = gsl_vector_get(pGSLApparentVector, 2);
+            ApparentTelescopeDirectionVector = ActualToApparentTransform * ActualVector;
             ApparentTelescopeDirectionVector.Normalise();
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
             break;
         }
 
@@ -446,140 +472,7 @@ bool BasicMathPlugin::TransformCelestialToTelescope(const double RightAscension,
             {
                 ActualVector = TelescopeDirectionVectorFromEquatorialCoordinates(ActualRaDec);
             }
-
-            gsl_matrix *pTransform;
-            gsl_matrix *pComputedTransform = nullptr;
-            // Scale the actual telescope direction vector to make sure it traverses the unit sphere.
-            TelescopeDirectionVector ScaledActualVector = ActualVector * 2.0;
-            // Shoot the scaled vector in the into the list of actual facets
-            // and use the conversuion matrix from the one it intersects
-            ConvexHull::tFace CurrentFace = ActualConvexHull.faces;
-#ifdef CONVEX_HULL_DEBUGGING
-            int ActualFaces = 0;
-#endif
-            if (nullptr != CurrentFace)
-            {
-                do
-                {
-#ifdef CONVEX_HULL_DEBUGGING
-                    ActualFaces++;
-#endif
-                    // Ignore faces containing vertex 0 (nadir).
-                    if ((0 == CurrentFace->vertex[0]->vnum) || (0 == CurrentFace->vertex[1]->vnum) ||
-                            (0 == CurrentFace->vertex[2]->vnum))
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("Celestial to telescope - Ignoring actual face %d", ActualFaces);
-#endif
-                    }
-                    else
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("Celestial to telescope - Processing actual face %d v1 %d v2 %d v3 %d", ActualFaces,
-                                  CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
-                                  CurrentFace->vertex[2]->vnum);
-#endif
-                        if (RayTriangleIntersection(ScaledActualVector,
-                                                    ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
-                                                    ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
-                                                    ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1]))
-                            break;
-                    }
-                    CurrentFace = CurrentFace->next;
-                }
-                while (CurrentFace != ActualConvexHull.faces);
-                if (CurrentFace == ActualConvexHull.faces)
-                {
-                    // Find the three nearest points and build a transform
-                    std::map<double, const AlignmentDatabaseEntry *> NearestMap;
-                    for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin();
-                            Itr != SyncPoints.end(); Itr++)
-                    {
-                        INDI::IEquatorialCoordinates RaDec;
-                        TelescopeDirectionVector ActualDirectionCosine;
-                        RaDec.rightascension  = (*Itr).RightAscension;
-                        RaDec.declination = (*Itr).Declination;
-                        if (ApproximateMountAlignment == ZENITH)
-                        {
-                            INDI::IHorizontalCoordinates ActualPoint;
-                            EquatorialToHorizontal(&RaDec, &Position, (*Itr).ObservationJulianDate, &ActualPoint);
-                            ActualDirectionCosine = TelescopeDirectionVectorFromAltitudeAzimuth(ActualPoint);
-                        }
-                        else
-                        {
-                            ActualDirectionCosine = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec);
-                        }
-                        NearestMap[(ActualDirectionCosine - ActualVector).Length()] = &(*Itr);
-                    }
-                    // First compute local horizontal coordinates for the three sync points
-                    std::map<double, const AlignmentDatabaseEntry *>::const_iterator Nearest = NearestMap.begin();
-                    const AlignmentDatabaseEntry *pEntry1                                    = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry2 = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry3 = (*Nearest).second;
-                    INDI::IEquatorialCoordinates RaDec1;
-                    INDI::IEquatorialCoordinates RaDec2;
-                    INDI::IEquatorialCoordinates RaDec3;
-                    TelescopeDirectionVector ActualDirectionCosine1;
-                    TelescopeDirectionVector ActualDirectionCosine2;
-                    TelescopeDirectionVector ActualDirectionCosine3;
-                    RaDec1.declination = pEntry1->Declination;
-                    RaDec1.rightascension  = pEntry1->RightAscension;
-                    RaDec2.declination = pEntry2->Declination;
-                    RaDec2.rightascension  = pEntry2->RightAscension;
-                    RaDec3.declination = pEntry3->Declination;
-                    RaDec3.rightascension = pEntry3->RightAscension;
-
-                    if (ApproximateMountAlignment == ZENITH)
-                    {
-                        INDI::IHorizontalCoordinates ActualSyncPoint1;
-                        INDI::IHorizontalCoordinates ActualSyncPoint2;
-                        INDI::IHorizontalCoordinates ActualSyncPoint3;
-                        EquatorialToHorizontal(&RaDec1, &Position, pEntry1->ObservationJulianDate, &ActualSyncPoint1);
-                        EquatorialToHorizontal(&RaDec2, &Position, pEntry2->ObservationJulianDate, &ActualSyncPoint2);
-                        EquatorialToHorizontal(&RaDec3, &Position, pEntry3->ObservationJulianDate, &ActualSyncPoint3);
-
-                        // Now express these coordinates as normalised direction vectors (a.k.a direction cosines)
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint3);
-                    }
-                    else
-                    {
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec3);
-                    }
-
-                    pComputedTransform = gsl_matrix_alloc(3, 3);
-                    CalculateTransformMatrices(ActualDirectionCosine1, ActualDirectionCosine2, ActualDirectionCosine3,
-                                               pEntry1->TelescopeDirection, pEntry2->TelescopeDirection,
-                                               pEntry3->TelescopeDirection, pComputedTransform, nullptr);
-                    pTransform = pComputedTransform;
-                }
-                else
-                    pTransform = CurrentFace->pMatrix;
-            }
-            else
-                return false;
-
-            // OK - got an intersection - CurrentFace is pointing at the face
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLActualVector, 0, ActualVector.x);
-            gsl_vector_set(pGSLActualVector, 1, ActualVector.y);
-            gsl_vector_set(pGSLActualVector, 2, ActualVector.z);
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pTransform, pGSLActualVector, pGSLApparentVector);
-            ApparentTelescopeDirectionVector.x = gsl_vector_get(pGSLApparentVector, 0);
-            ApparentTelescopeDirectionVector.y = gsl_vector_get(pGSLApparentVector, 1);
-            ApparentTelescopeDirectionVector.z = gsl_vector_get(pGSLApparentVector, 2);
-            ApparentTelescopeDirectionVector.Normalise();
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
-            if (nullptr != pComputedTransform)
-                gsl_matrix_free(pComputedTransform);
-            break;
+            return TransformActualThroughHull(ActualVector, Position, ApparentTelescopeDirectionVector);
         }
     }
 
@@ -645,20 +538,12 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
         case 2:
         case 3:
         {
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLApparentVector, 0, ApparentTelescopeDirectionVector.x);
-            gsl_vector_set(pGSLApparentVector, 1, ApparentTelescopeDirectionVector.y);
-            gsl_vector_set(pGSLApparentVector, 2, ApparentTelescopeDirectionVector.z);
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pApparentToActualTransform, pGSLApparentVector, pGSLActualVector);
+            TelescopeDirectionVector ActualTelescopeDirectionVector =
+                ApparentToActualTransform * ApparentTelescopeDirectionVector;
 
-            Dump3("ApparentVector", pGSLApparentVector);
-            Dump3("ActualVector", pGSLActualVector);
+            Dump3("ApparentVector", ApparentTelescopeDirectionVector);
+            Dump3("ActualVector", ActualTelescopeDirectionVector);
 
-            TelescopeDirectionVector ActualTelescopeDirectionVector;
-            ActualTelescopeDirectionVector.x = gsl_vector_get(pGSLActualVector, 0);
-            ActualTelescopeDirectionVector.y = gsl_vector_get(pGSLActualVector, 1);
-            ActualTelescopeDirectionVector.z = gsl_vector_get(pGSLActualVector, 2);
             ActualTelescopeDirectionVector.Normalise();
             if (ApproximateMountAlignment == ZENITH)
             {
@@ -671,128 +556,14 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
             }
             RightAscension = ActualRaDec.rightascension;
             Declination    = ActualRaDec.declination;
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
             break;
         }
 
         default:
         {
-            gsl_matrix *pTransform;
-            gsl_matrix *pComputedTransform = nullptr;
-            // Scale the apparent telescope direction vector to make sure it traverses the unit sphere.
-            TelescopeDirectionVector ScaledApparentVector = ApparentTelescopeDirectionVector * 2.0;
-            // Shoot the scaled vector in the into the list of apparent facets
-            // and use the conversuion matrix from the one it intersects
-            ConvexHull::tFace CurrentFace = ApparentConvexHull.faces;
-#ifdef CONVEX_HULL_DEBUGGING
-            int ApparentFaces = 0;
-#endif
-            if (nullptr != CurrentFace)
-            {
-                do
-                {
-#ifdef CONVEX_HULL_DEBUGGING
-                    ApparentFaces++;
-#endif
-                    // Ignore faces containing vertex 0 (nadir).
-                    if ((0 == CurrentFace->vertex[0]->vnum) || (0 == CurrentFace->vertex[1]->vnum) ||
-                            (0 == CurrentFace->vertex[2]->vnum))
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("Celestial to telescope - Ignoring apparent face %d", ApparentFaces);
-#endif
-                    }
-                    else
-                    {
-#ifdef CONVEX_HULL_DEBUGGING
-                        ASSDEBUGF("TelescopeToCelestial - Processing apparent face %d v1 %d v2 %d v3 %d", ApparentFaces,
-                                  CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
-                                  CurrentFace->vertex[2]->vnum);
-#endif
-                        if (RayTriangleIntersection(ScaledApparentVector,
-                                                    SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
-                                                    SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
-                                                    SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection))
-                            break;
-                    }
-                    CurrentFace = CurrentFace->next;
-                }
-                while (CurrentFace != ApparentConvexHull.faces);
-                if (CurrentFace == ApparentConvexHull.faces)
-                {
-                    // Find the three nearest points and build a transform
-                    std::map<double, const AlignmentDatabaseEntry *> NearestMap;
-                    for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin();
-                            Itr != SyncPoints.end(); Itr++)
-                    {
-                        NearestMap[((*Itr).TelescopeDirection - ApparentTelescopeDirectionVector).Length()] = &(*Itr);
-                    }
-                    // First compute local horizontal coordinates for the three sync points
-                    std::map<double, const AlignmentDatabaseEntry *>::const_iterator Nearest = NearestMap.begin();
-                    const AlignmentDatabaseEntry *pEntry1                                    = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry2 = (*Nearest).second;
-                    Nearest++;
-                    const AlignmentDatabaseEntry *pEntry3 = (*Nearest).second;
-                    INDI::IEquatorialCoordinates RaDec1;
-                    INDI::IEquatorialCoordinates RaDec2;
-                    INDI::IEquatorialCoordinates RaDec3;
-                    TelescopeDirectionVector ActualDirectionCosine1;
-                    TelescopeDirectionVector ActualDirectionCosine2;
-                    TelescopeDirectionVector ActualDirectionCosine3;
-                    RaDec1.declination = pEntry1->Declination;
-                    RaDec1.rightascension  = pEntry1->RightAscension;
-                    RaDec2.declination = pEntry2->Declination;
-                    RaDec2.rightascension  = pEntry2->RightAscension;
-                    RaDec3.declination = pEntry3->Declination;
-                    RaDec3.rightascension = pEntry3->RightAscension;
-
-                    if (ApproximateMountAlignment == ZENITH)
-                    {
-                        INDI::IHorizontalCoordinates ActualSyncPoint1;
-                        INDI::IHorizontalCoordinates ActualSyncPoint2;
-                        INDI::IHorizontalCoordinates ActualSyncPoint3;
-                        EquatorialToHorizontal(&RaDec1, &Position, pEntry1->ObservationJulianDate, &ActualSyncPoint1);
-                        EquatorialToHorizontal(&RaDec2, &Position, pEntry2->ObservationJulianDate, &ActualSyncPoint2);
-                        EquatorialToHorizontal(&RaDec3, &Position, pEntry3->ObservationJulianDate, &ActualSyncPoint3);
-
-                        // Now express these coordinates as normalised direction vectors (a.k.a direction cosines)
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint3);
-                    }
-                    else
-                    {
-                        ActualDirectionCosine1 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec1);
-                        ActualDirectionCosine2 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec2);
-                        ActualDirectionCosine3 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec3);
-                    }
-                    pComputedTransform = gsl_matrix_alloc(3, 3);
-                    CalculateTransformMatrices(pEntry1->TelescopeDirection, pEntry2->TelescopeDirection,
-                                               pEntry3->TelescopeDirection, ActualDirectionCosine1,
-                                               ActualDirectionCosine2, ActualDirectionCosine3, pComputedTransform,
-                                               nullptr);
-                    pTransform = pComputedTransform;
-                }
-                else
-                    pTransform = CurrentFace->pMatrix;
-            }
-            else
-                return false;
-
-            // OK - got an intersection - CurrentFace is pointing at the face
-            gsl_vector *pGSLApparentVector = gsl_vector_alloc(3);
-            gsl_vector_set(pGSLApparentVector, 0, ApparentTelescopeDirectionVector.x);
-            gsl_vector_set(pGSLApparentVector, 1, ApparentTelescopeDirectionVector.y);
-            gsl_vector_set(pGSLApparentVector, 2, ApparentTelescopeDirectionVector.z);
-            gsl_vector *pGSLActualVector = gsl_vector_alloc(3);
-            MatrixVectorMultiply(pTransform, pGSLApparentVector, pGSLActualVector);
             TelescopeDirectionVector ActualTelescopeDirectionVector;
-            ActualTelescopeDirectionVector.x = gsl_vector_get(pGSLActualVector, 0);
-            ActualTelescopeDirectionVector.y = gsl_vector_get(pGSLActualVector, 1);
-            ActualTelescopeDirectionVector.z = gsl_vector_get(pGSLActualVector, 2);
-            ActualTelescopeDirectionVector.Normalise();
+            if (!TransformApparentThroughHull(ApparentTelescopeDirectionVector, Position, ActualTelescopeDirectionVector))
+                return false;
             if (ApproximateMountAlignment == ZENITH)
             {
                 AltitudeAzimuthFromTelescopeDirectionVector(ActualTelescopeDirectionVector, ActualAltAz);
@@ -805,10 +576,6 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
             // libnova works in decimal degrees so conversion is needed here
             RightAscension = ActualRaDec.rightascension;
             Declination    = ActualRaDec.declination;
-            gsl_vector_free(pGSLActualVector);
-            gsl_vector_free(pGSLApparentVector);
-            if (nullptr != pComputedTransform)
-                gsl_matrix_free(pComputedTransform);
             break;
         }
     }
@@ -816,12 +583,351 @@ bool BasicMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVect
     return true;
 }
 
+bool BasicMathPlugin::TransformCelestialToTelescopeBatch(const double *RightAscensions, const double *Declinations,
+        size_t Count, double JulianOffset,
+        TelescopeDirectionVector *ApparentTelescopeDirectionVectors)
+{
+    IGeographicCoordinates Position { 0, 0, 0 };
+
+    // Should check that this the same as the current observing position
+    if ((nullptr == pInMemoryDatabase) || !pInMemoryDatabase->GetDatabaseReferencePosition(Position))
+        return false;
+
+    // The position and the date are the same for every coordinate, so the horizontal coordinates
+    // are computed in one pass sharing the sidereal time
+    std::vector<INDI::IEquatorialCoordinates> ActualRaDecs(Count);
+    for (size_t i = 0; i < Count; i++)
+    {
+        ActualRaDecs[i].rightascension = RightAscensions[i];
+        ActualRaDecs[i].declination    = Declinations[i];
+    }
+    if (ApproximateMountAlignment == ZENITH)
+    {
+        std::vector<INDI::IHorizontalCoordinates> ActualAltAzs(Count);
+        EquatorialToHorizontal(ActualRaDecs.data(), &Position, ln_get_julian_from_sys() + JulianOffset,
+                               ActualAltAzs.data(), Count);
+        for (size_t i = 0; i < Count; i++)
+            ApparentTelescopeDirectionVectors[i] = TelescopeDirectionVectorFromAltitudeAzimuth(ActualAltAzs[i]);
+    }
+    else
+    {
+        for (size_t i = 0; i < Count; i++)
+            ApparentTelescopeDirectionVectors[i] = TelescopeDirectionVectorFromEquatorialCoordinates(ActualRaDecs[i]);
+    }
+
+    InMemoryDatabase::AlignmentDatabaseType &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
+    switch (SyncPoints.size())
+    {
+        case 0:
+            // 0 sync points, the actual vectors are the apparent ones
+            break;
+
+        case 1:
+        case 2:
+        case 3:
+            TransformVectors(ActualToApparentTransform, ApparentTelescopeDirectionVectors, Count);
+            break;
+
+        default:
+            for (size_t i = 0; i < Count; i++)
+            {
+                TelescopeDirectionVector ActualVector = ApparentTelescopeDirectionVectors[i];
+                if (!TransformActualThroughHull(ActualVector, Position, ApparentTelescopeDirectionVectors[i]))
+                    return false;
+            }
+            break;
+    }
+    return true;
+}
+
+bool BasicMathPlugin::TransformTelescopeToCelestialBatch(const TelescopeDirectionVector *ApparentTelescopeDirectionVectors,
+        size_t Count, double *RightAscensions, double *Declinations)
+{
+    IGeographicCoordinates Position;
+
+    if ((nullptr == pInMemoryDatabase) || !pInMemoryDatabase->GetDatabaseReferencePosition(Position))
+    {
+        // Should check that this the same as the current observing position
+        ASSDEBUG("No database or no position in database");
+        return false;
+    }
+
+    std::vector<TelescopeDirectionVector> ActualTelescopeDirectionVectors(ApparentTelescopeDirectionVectors,
+            ApparentTelescopeDirectionVectors + Count);
+    InMemoryDatabase::AlignmentDatabaseType &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
+    switch (SyncPoints.size())
+    {
+        case 0:
+            // 0 sync points, the actual vectors are the apparent ones
+            break;
+
+        case 1:
+        case 2:
+        case 3:
+            TransformVectors(ApparentToActualTransform, ActualTelescopeDirectionVectors.data(), Count);
+            break;
+
+        default:
+            for (size_t i = 0; i < Count; i++)
+            {
+                if (!TransformApparentThroughHull(ApparentTelescopeDirectionVectors[i], Position,
+                                                  ActualTelescopeDirectionVectors[i]))
+                    return false;
+            }
+            break;
+    }
+
+    // libnova has no horizontal to equatorial conversion for a given sidereal time, so only the date is shared
+    const double JulianDate = ln_get_julian_from_sys();
+    for (size_t i = 0; i < Count; i++)
+    {
+        INDI::IEquatorialCoordinates ActualRaDec;
+        if (ApproximateMountAlignment == ZENITH)
+        {
+            INDI::IHorizontalCoordinates ActualAltAz;
+            AltitudeAzimuthFromTelescopeDirectionVector(ActualTelescopeDirectionVectors[i], ActualAltAz);
+            HorizontalToEquatorial(&ActualAltAz, &Position, JulianDate, &ActualRaDec);
+        }
+        else
+        {
+            EquatorialCoordinatesFromTelescopeDirectionVector(ActualTelescopeDirectionVectors[i], ActualRaDec);
+        }
+        RightAscensions[i] = ActualRaDec.rightascension;
+        Declinations[i]    = ActualRaDec.declination;
+    }
+    return true;
+}
+
 // Private methods
 
-void BasicMathPlugin::Dump3(const char *Label, gsl_vector *pVector)
+void BasicMathPlugin::TransformVectors(const Matrix3x3 &Transform, TelescopeDirectionVector *Vectors, size_t Count)
+{
+    // Kept free of calls so that the compiler can vectorise it
+    for (size_t i = 0; i < Count; i++)
+    {
+        TelescopeDirectionVector Transformed = Transform * Vectors[i];
+        double Length = std::sqrt(Transformed.x * Transformed.x + Transformed.y * Transformed.y +
+                                  Transformed.z * Transformed.z);
+        Vectors[i].x = Transformed.x / Length;
+        Vectors[i].y = Transformed.y / Length;
+        Vectors[i].z = Transformed.z / Length;
+    }
+}
+
+bool BasicMathPlugin::TransformActualThroughHull(const TelescopeDirectionVector &ActualVector,
+        IGeographicCoordinates &Position,
+        TelescopeDirectionVector &ApparentTelescopeDirectionVector)
+{
+    InMemoryDatabase::AlignmentDatabaseType &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
+
+    const Matrix3x3 *pTransform;
+    Matrix3x3 ComputedTransform;
+    // Scale the actual telescope direction vector to make sure it traverses the unit sphere.
+    TelescopeDirectionVector ScaledActualVector = ActualVector * 2.0;
+    // Shoot the scaled vector in the into the actual facets around its direction
+    // and use the conversuion matrix from the one it intersects
+    ConvexHull::tFace HitFace = nullptr;
+    if (nullptr != ActualConvexHull.faces)
+    {
+        for (ConvexHull::tFace CurrentFace : ActualFaceIndex.Candidates(ActualVector))
+        {
+#ifdef CONVEX_HULL_DEBUGGING
+            ASSDEBUGF("Celestial to telescope - Processing actual face v1 %d v2 %d v3 %d",
+                      CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
+                      CurrentFace->vertex[2]->vnum);
+#endif
+            if (RayTriangleIntersection(ScaledActualVector,
+                                        ActualDirectionCosines[CurrentFace->vertex[0]->vnum - 1],
+                                        ActualDirectionCosines[CurrentFace->vertex[1]->vnum - 1],
+                                        ActualDirectionCosines[CurrentFace->vertex[2]->vnum - 1]))
+            {
+                HitFace = CurrentFace;
+                break;
+            }
+        }
+        if (nullptr == HitFace)
+        {
+            // Find the three nearest points and build a transform
+            std::map<double, const AlignmentDatabaseEntry *> NearestMap;
+            for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin();
+                    Itr != SyncPoints.end(); Itr++)
+            {
+                INDI::IEquatorialCoordinates RaDec;
+                TelescopeDirectionVector ActualDirectionCosine;
+                RaDec.rightascension  = (*Itr).RightAscension;
+                RaDec.declination = (*Itr).Declination;
+                if (ApproximateMountAlignment == ZENITH)
+                {
+                    INDI::IHorizontalCoordinates ActualPoint;
+                    EquatorialToHorizontal(&RaDec, &Position, (*Itr).ObservationJulianDate, &ActualPoint);
+                    ActualDirectionCosine = TelescopeDirectionVectorFromAltitudeAzimuth(ActualPoint);
+                }
+                else
+                {
+                    ActualDirectionCosine = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec);
+                }
+                NearestMap[(ActualDirectionCosine - ActualVector).Length()] = &(*Itr);
+            }
+            // First compute local horizontal coordinates for the three sync points
+            std::map<double, const AlignmentDatabaseEntry *>::const_iterator Nearest = NearestMap.begin();
+            const AlignmentDatabaseEntry *pEntry1                                    = (*Nearest).second;
+            Nearest++;
+            const AlignmentDatabaseEntry *pEntry2 = (*Nearest).second;
+            Nearest++;
+            const AlignmentDatabaseEntry *pEntry3 = (*Nearest).second;
+            INDI::IEquatorialCoordinates RaDec1;
+            INDI::IEquatorialCoordinates RaDec2;
+            INDI::IEquatorialCoordinates RaDec3;
+            TelescopeDirectionVector ActualDirectionCosine1;
+            TelescopeDirectionVector ActualDirectionCosine2;
+            TelescopeDirectionVector ActualDirectionCosine3;
+            RaDec1.declination = pEntry1->Declination;
+            RaDec1.rightascension  = pEntry1->RightAscension;
+            RaDec2.declination = pEntry2->Declination;
+            RaDec2.rightascension  = pEntry2->RightAscension;
+            RaDec3.declination = pEntry3->Declination;
+            RaDec3.rightascension = pEntry3->RightAscension;
+
+            if (ApproximateMountAlignment == ZENITH)
+            {
+                INDI::IHorizontalCoordinates ActualSyncPoint1;
+                INDI::IHorizontalCoordinates ActualSyncPoint2;
+                INDI::IHorizontalCoordinates ActualSyncPoint3;
+                EquatorialToHorizontal(&RaDec1, &Position, pEntry1->ObservationJulianDate, &ActualSyncPoint1);
+                EquatorialToHorizontal(&RaDec2, &Position, pEntry2->ObservationJulianDate, &ActualSyncPoint2);
+                EquatorialToHorizontal(&RaDec3, &Position, pEntry3->ObservationJulianDate, &ActualSyncPoint3);
+
+                // Now express these coordinates as normalised direction vectors (a.k.a direction cosines)
+                ActualDirectionCosine1 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint1);
+                ActualDirectionCosine2 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint2);
+                ActualDirectionCosine3 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint3);
+            }
+            else
+            {
+                ActualDirectionCosine1 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec1);
+                ActualDirectionCosine2 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec2);
+                ActualDirectionCosine3 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec3);
+            }
+
+            CalculateTransformMatrices(ActualDirectionCosine1, ActualDirectionCosine2, ActualDirectionCosine3,
+                                       pEntry1->TelescopeDirection, pEntry2->TelescopeDirection,
+                                       pEntry3->TelescopeDirection, &ComputedTransform, nullptr);
+            pTransform = &ComputedTransform;
+        }
+        else
+            pTransform = &HitFace->Matrix;
+    }
+    else
+        return false;
+
+    // OK - got an intersection - HitFace is pointing at the face
+    ApparentTelescopeDirectionVector = *pTransform * ActualVector;
+    ApparentTelescopeDirectionVector.Normalise();
+    return true;
+}
+
+bool BasicMathPlugin::TransformApparentThroughHull(const TelescopeDirectionVector &ApparentTelescopeDirectionVector,
+        IGeographicCoordinates &Position,
+        TelescopeDirectionVector &ActualTelescopeDirectionVector)
+{
+    InMemoryDatabase::AlignmentDatabaseType &SyncPoints = pInMemoryDatabase->GetAlignmentDatabase();
+
+    const Matrix3x3 *pTransform;
+    Matrix3x3 ComputedTransform;
+    // Scale the apparent telescope direction vector to make sure it traverses the unit sphere.
+    TelescopeDirectionVector ScaledApparentVector = ApparentTelescopeDirectionVector * 2.0;
+    // Shoot the scaled vector in the into the apparent facets around its direction
+    // and use the conversuion matrix from the one it intersects
+    ConvexHull::tFace HitFace = nullptr;
+    if (nullptr != ApparentConvexHull.faces)
+    {
+        for (ConvexHull::tFace CurrentFace : ApparentFaceIndex.Candidates(ApparentTelescopeDirectionVector))
+        {
+#ifdef CONVEX_HULL_DEBUGGING
+            ASSDEBUGF("TelescopeToCelestial - Processing apparent face v1 %d v2 %d v3 %d",
+                      CurrentFace->vertex[0]->vnum, CurrentFace->vertex[1]->vnum,
+                      CurrentFace->vertex[2]->vnum);
+#endif
+            if (RayTriangleIntersection(ScaledApparentVector,
+                                        SyncPoints[CurrentFace->vertex[0]->vnum - 1].TelescopeDirection,
+                                        SyncPoints[CurrentFace->vertex[1]->vnum - 1].TelescopeDirection,
+                                        SyncPoints[CurrentFace->vertex[2]->vnum - 1].TelescopeDirection))
+            {
+                HitFace = CurrentFace;
+                break;
+            }
+        }
+        if (nullptr == HitFace)
+        {
+            // Find the three nearest points and build a transform
+            std::map<double, const AlignmentDatabaseEntry *> NearestMap;
+            for (InMemoryDatabase::AlignmentDatabaseType::const_iterator Itr = SyncPoints.begin();
+                    Itr != SyncPoints.end(); Itr++)
+            {
+                NearestMap[((*Itr).TelescopeDirection - ApparentTelescopeDirectionVector).Length()] = &(*Itr);
+            }
+            // First compute local horizontal coordinates for the three sync points
+            std::map<double, const AlignmentDatabaseEntry *>::const_iterator Nearest = NearestMap.begin();
+            const AlignmentDatabaseEntry *pEntry1                                    = (*Nearest).second;
+            Nearest++;
+            const AlignmentDatabaseEntry *pEntry2 = (*Nearest).second;
+            Nearest++;
+            const AlignmentDatabaseEntry *pEntry3 = (*Nearest).second;
+            INDI::IEquatorialCoordinates RaDec1;
+            INDI::IEquatorialCoordinates RaDec2;
+            INDI::IEquatorialCoordinates RaDec3;
+            TelescopeDirectionVector ActualDirectionCosine1;
+            TelescopeDirectionVector ActualDirectionCosine2;
+            TelescopeDirectionVector ActualDirectionCosine3;
+            RaDec1.declination = pEntry1->Declination;
+            RaDec1.rightascension  = pEntry1->RightAscension;
+            RaDec2.declination = pEntry2->Declination;
+            RaDec2.rightascension  = pEntry2->RightAscension;
+            RaDec3.declination = pEntry3->Declination;
+            RaDec3.rightascension = pEntry3->RightAscension;
+
+            if (ApproximateMountAlignment == ZENITH)
+            {
+                INDI::IHorizontalCoordinates ActualSyncPoint1;
+                INDI::IHorizontalCoordinates ActualSyncPoint2;
+                INDI::IHorizontalCoordinates ActualSyncPoint3;
+                EquatorialToHorizontal(&RaDec1, &Position, pEntry1->ObservationJulianDate, &ActualSyncPoint1);
+                EquatorialToHorizontal(&RaDec2, &Position, pEntry2->ObservationJulianDate, &ActualSyncPoint2);
+                EquatorialToHorizontal(&RaDec3, &Position, pEntry3->ObservationJulianDate, &ActualSyncPoint3);
+
+                // Now express these coordinates as normalised direction vectors (a.k.a direction cosines)
+                ActualDirectionCosine1 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint1);
+                ActualDirectionCosine2 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint2);
+                ActualDirectionCosine3 = TelescopeDirectionVectorFromAltitudeAzimuth(ActualSyncPoint3);
+            }
+            else
+            {
+                ActualDirectionCosine1 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec1);
+                ActualDirectionCosine2 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec2);
+                ActualDirectionCosine3 = TelescopeDirectionVectorFromEquatorialCoordinates(RaDec3);
+            }
+            CalculateTransformMatrices(pEntry1->TelescopeDirection, pEntry2->TelescopeDirection,
+                                       pEntry3->TelescopeDirection, ActualDirectionCosine1,
+                                       ActualDirectionCosine2, ActualDirectionCosine3, &ComputedTransform,
+                                       nullptr);
+            pTransform = &ComputedTransform;
+        }
+        else
+            pTransform = &HitFace->Matrix;
+    }
+    else
+        return false;
+
+    // OK - got an intersection - HitFace is pointing at the face
+    ActualTelescopeDirectionVector = *pTransform * ApparentTelescopeDirectionVector;
+    ActualTelescopeDirectionVector.Normalise();
+    return true;
+}
+
+void BasicMathPlugin::Dump3(const char *Label, const TelescopeDirectionVector &Vector)
 {
     ASSDEBUGF("Vector dump - %s", Label);
-    ASSDEBUGF("%lf %lf %lf", gsl_vector_get(pVector, 0), gsl_vector_get(pVector, 1), gsl_vector_get(pVector, 2));
+    ASSDEBUGF("%lf %lf %lf", Vector.x, Vector.y, Vector.z);
 }
 
 void BasicMathPlugin::Dump3x3(const char *Label, gsl_matrix *pMatrix)
@@ -835,6 +941,14 @@ void BasicMathPlugin::Dump3x3(const char *Label, gsl_matrix *pMatrix)
               gsl_matrix_get(pMatrix, 2, 2));
 }
 
+void BasicMathPlugin::Dump3x3(const char *Label, const Matrix3x3 &Matrix)
+{
+    ASSDEBUGF("Matrix dump - %s", Label);
+    ASSDEBUGF("Row 0 %lf %lf %lf", Matrix.m[0][0], Matrix.m[0][1], Matrix.m[0][2]);
+    ASSDEBUGF("Row 1 %lf %lf %lf", Matrix.m[1][0], Matrix.m[1][1], Matrix.m[1][2]);
+    ASSDEBUGF("Row 2 %lf %lf %lf", Matrix.m[2][0], Matrix.m[2][1], Matrix.m[2][2]);
+}
+
 /// Use gsl to compute the determinant of a 3x3 matrix
 double BasicMathPlugin::Matrix3x3Determinant(gsl_matrix *pMatrix)
 {
@@ -855,32 +969,6 @@ double BasicMathPlugin::Matrix3x3Determinant(gsl_matrix *pMatrix)
     return Determinant;
 }
 
-/// Use gsl to compute the inverse of a 3x3 matrix
-bool BasicMathPlugin::MatrixInvert3x3(gsl_matrix *pInput, gsl_matrix *pInversion)
-{
-    bool Retcode                  = true;
-    gsl_permutation *pPermutation = gsl_permutation_alloc(3);
-    gsl_matrix *pDecomp           = gsl_matrix_alloc(3, 3);
-    int Signum;
-
-    gsl_matrix_memcpy(pDecomp, pInput);
-
-    gsl_linalg_LU_decomp(pDecomp, pPermutation, &Signum);
-
-    // Test for singularity
-    if (0 == gsl_linalg_LU_det(pDecomp, Signum))
-    {
-        Retcode = false;
-    }
-    else
-        gsl_linalg_LU_invert(pDecomp, pPermutation, pInversion);
-
-    gsl_matrix_free(pDecomp);
-    gsl_permutation_free(pPermutation);
-
-    return Retcode;
-}
-
 /// Use gsl blas support to multiply two matrices together and put the result in a third.
 /// For our purposes all the matrices should be 3 by 3.
 void BasicMathPlugin::MatrixMatrixMultiply(gsl_matrix *pA, gsl_matrix *pB, gsl_matrix *pC)
@@ -891,14 +979,10 @@ void BasicMathPlugin::MatrixMatrixMultiply(gsl_matrix *pA, gsl_matrix *pB, gsl_m
     gsl_blas_dgemm(CblasNoTrans, CblasNoTrans, 1.0, pA, pB, 0.0, pC);
 }
 
-/// Use gsl blas support to multiply a matrix by a vector and put the result in another vector
-/// For our purposes the the matrix should be 3x3 and vector 3.
-void BasicMathPlugin::MatrixVectorMultiply(gsl_matrix *pA, gsl_vector *pB, gsl_vector *pC)
+bool BasicMathPlugin::HasVertexAfter(ConvexHull::tFace Face, int VertexNumber)
 {
-    // Zeroise the output vector
-    gsl_vector_set_zero(pC);
-
-    gsl_blas_dgemv(CblasNoTrans, 1.0, pA, pB, 0.0, pC);
+    return Face->vertex[0]->vnum > VertexNumber || Face->vertex[1]->vnum > VertexNumber ||
+           Face->vertex[2]->vnum > VertexNumber;
 }
 
 bool BasicMathPlugin::RayTriangleIntersection(TelescopeDirectionVector &Ray, TelescopeDirectionVector &TriangleVertex1,
@@ -10,6 +10,7 @@
 
 #include "AlignmentSubsystemForMathPlugins.h"
 #include "ConvexHull.h"
+#include "SphericalFaceIndex.h"
 
 #include <gsl/gsl_matrix.h>
 
@@ -24,10 +25,10 @@ class BasicMathPlugin : public AlignmentSubsystemForMathPlugins
 {
     public:
         /// \brief Default constructor
-        BasicMathPlugin();
+        BasicMathPlugin() = default;
 
         /// \brief Virtual destructor
-        virtual ~BasicMathPlugin();
+        virtual ~BasicMathPlugin() = default;
 
         /// \brief Override for the base class virtual function
         virtual bool Initialise(InMemoryDatabase *pInMemoryDatabase);
@@ -41,6 +42,17 @@ class BasicMathPlugin : public AlignmentSubsystemForMathPlugins
         virtual bool TransformTelescopeToCelestial(const TelescopeDirectionVector &ApparentTelescopeDirectionVector,
                 double &RightAscension, double &Declination);
 
+        /// \brief Override for the base class virtual function
+        /// \note The position, the date and, with fewer than four sync points, the transformation matrix are
+        /// shared by every coordinate
+        virtual bool TransformCelestialToTelescopeBatch(const double *RightAscensions, const double *Declinations,
+                size_t Count, double JulianOffset,
+                TelescopeDirectionVector *ApparentTelescopeDirectionVectors);
+
+        /// \brief Override for the base class virtual function
+        virtual bool TransformTelescopeToCelestialBatch(const TelescopeDirectionVector *ApparentTelescopeDirectionVectors,
+                size_t Count, double *RightAscensions, double *Declinations);
+
     protected:
         /// \brief Calculate transformation matrices from the supplied vectors
         /// \param[in] Alpha1 Pointer to the first coordinate in the alpha reference frame
@@ -55,34 +67,58 @@ class BasicMathPlugin : public AlignmentSubsystemForMathPlugins
         CalculateTransformMatrices(const TelescopeDirectionVector &Alpha1, const TelescopeDirectionVector &Alpha2,
                                    const TelescopeDirectionVector &Alpha3, const TelescopeDirectionVector &Beta1,
                                    const TelescopeDirectionVector &Beta2, const TelescopeDirectionVector &Beta3,
-                                   gsl_matrix *pAlphaToBeta, gsl_matrix *pBetaToAlpha) = 0;
+                                   Matrix3x3 *pAlphaToBeta, Matrix3x3 *pBetaToAlpha) = 0;
 
         /// \brief Print out a 3 vector to debug
         /// \param[in] Label A label to identify the vector
-        /// \param[in] pVector The vector to print
-        void Dump3(const char *Label, gsl_vector *pVector);
+        /// \param[in] Vector The vector to print
+        void Dump3(const char *Label, const TelescopeDirectionVector &Vector);
 
         /// \brief Print out a 3x3 matrix to debug
         /// \param[in] Label A label to identify the matrix
         /// \param[in] pMatrix The matrix to print
         void Dump3x3(const char *Label, gsl_matrix *pMatrix);
 
+        /// \brief Print out a 3x3 matrix to debug
+        /// \param[in] Label A label to identify the matrix
+        /// \param[in] Matrix The matrix to print
+        void Dump3x3(const char *Label, const Matrix3x3 &Matrix);
+
         /// \brief Calculate the determinant of the supplied matrix
         /// \param[in] pMatrix Pointer to the 3x3 matrix
         /// \return The determinant
         double Matrix3x3Determinant(gsl_matrix *pMatrix);
 
-        /// \brief Calculate the inverse of the supplied matrix
-        /// \param[in] pInput Pointer to the input matrix
-        /// \param[in] pInversion Pointer to a matrix to receive the inversion
-        /// \return False if input matrix is singular (not invertable) otherwise true
-        bool MatrixInvert3x3(gsl_matrix *pInput, gsl_matrix *pInversion);
-
         /// \brief Multiply matrix A by matrix B and put the result in C
         void MatrixMatrixMultiply(gsl_matrix *pA, gsl_matrix *pB, gsl_matrix *pC);
 
-        /// \brief Multiply matrix A by vector B and put the result in vector C
-        void MatrixVectorMultiply(gsl_matrix *pA, gsl_vector *pB, gsl_vector *pC);
+        /// \brief Transform an actual direction vector through the face of the actual hull it passes through
+        /// \param[in] ActualVector The actual direction vector
+        /// \param[in] Position The position of the database
+        /// \param[out] ApparentTelescopeDirectionVector Parameter to receive the apparent direction vector
+        /// \return False if there is no hull
+        bool TransformActualThroughHull(const TelescopeDirectionVector &ActualVector, IGeographicCoordinates &Position,
+                                        TelescopeDirectionVector &ApparentTelescopeDirectionVector);
+
+        /// \brief Transform an apparent direction vector through the face of the apparent hull it passes through
+        /// \param[in] ApparentTelescopeDirectionVector The apparent direction vector
+        /// \param[in] Position The position of the database
+        /// \param[out] ActualTelescopeDirectionVector Parameter to receive the normalised actual direction vector
+        /// \return False if there is no hull
+        bool TransformApparentThroughHull(const TelescopeDirectionVector &ApparentTelescopeDirectionVector,
+                                          IGeographicCoordinates &Position,
+                                          TelescopeDirectionVector &ActualTelescopeDirectionVector);
+
+        /// \brief Multiply an array of vectors by a matrix and normalise them in place
+        /// \param[in] Transform The transformation matrix
+        /// \param[in,out] Vectors The vectors to transform
+        /// \param[in] Count The number of vectors
+        static void TransformVectors(const Matrix3x3 &Transform, TelescopeDirectionVector *Vectors, size_t Count);
+
+        /// \brief Test if a hull face has a vertex added after the given one
+        /// \param[in] Face The face to test
+        /// \param[in] VertexNumber The number of the last vertex of the hull before it was extended
+        static bool HasVertexAfter(ConvexHull::tFace Face, int VertexNumber);
 
         /// \brief Test if a ray intersects a triangle in 3d space
         /// \param[in] Ray The ray vector
@@ -95,14 +131,28 @@ class BasicMathPlugin : public AlignmentSubsystemForMathPlugins
                                      TelescopeDirectionVector &TriangleVertex2, TelescopeDirectionVector &TriangleVertex3);
 
         // Transformation matrixes for 1, 2 and 3 sync points case
-        gsl_matrix *pActualToApparentTransform;
-        gsl_matrix *pApparentToActualTransform;
+        Matrix3x3 ActualToApparentTransform;
+        Matrix3x3 ApparentToActualTransform;
 
         // Convex hulls for 4+ sync points case
         ConvexHull ActualConvexHull;
         ConvexHull ApparentConvexHull;
+        // Hull faces bucketed by the directions they cover, to find the one a vector passes through
+        SphericalFaceIndex ActualFaceIndex;
+        SphericalFaceIndex ApparentFaceIndex;
         // Actual direction cosines for the 4+ case
         std::vector<TelescopeDirectionVector> ActualDirectionCosines;
+        // The sync points and settings the hulls were built from, to extend the hulls when points are appended
+        struct HullSyncPoint
+        {
+            double ObservationJulianDate;
+            double RightAscension;
+            double Declination;
+            TelescopeDirectionVector TelescopeDirection;
+        };
+        std::vector<HullSyncPoint> HullSyncPoints;
+        IGeographicCoordinates HullPosition { 0, 0, 0 };
+        MountAlignment_t HullAlignment { ZENITH };
 };
 
 } // namespace AlignmentSubsystem
@@ -68,10 +68,10 @@ enum AlignmentPointSetEnum
 struct TelescopeDirectionVector
 {
     /// \brief Default constructor
-    TelescopeDirectionVector() : x(0), y(0), z(0) {}
+    constexpr TelescopeDirectionVector() : x(0), y(0), z(0) {}
 
     /// \brief Copy constructor
-    TelescopeDirectionVector(double X, double Y, double Z) : x(X), y(Y), z(Z) {}
+    constexpr TelescopeDirectionVector(double X, double Y, double Z) : x(X), y(Y), z(Z) {}
 
     double x;
     double y;
@@ -143,6 +143,77 @@ struct TelescopeDirectionVector
     void RotateAroundY(double Angle);
 };
 
+/*!
+ * \struct Matrix3x3
+ * \brief A 3x3 matrix of doubles held by value, in row major order
+ *
+ * The transforms between the actual and apparent coordinates are 3x3 matrices applied to
+ * direction vectors. Keeping them by value avoids any heap allocation when they are applied.
+ */
+struct Matrix3x3
+{
+    /// \brief Default constructor, the identity matrix
+    constexpr Matrix3x3() : m{ { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } } {}
+
+    /// \brief Construct a matrix whose columns are the given vectors
+    constexpr Matrix3x3(const TelescopeDirectionVector &Column0, const TelescopeDirectionVector &Column1,
+                        const TelescopeDirectionVector &Column2)
+        : m{ { Column0.x, Column1.x, Column2.x }, { Column0.y, Column1.y, Column2.y }, { Column0.z, Column1.z, Column2.z } }
+    {
+    }
+
+    double m[3][3];
+
+    /// \brief Override the * operator to return the product of the matrix and a vector
+    constexpr TelescopeDirectionVector operator*(const TelescopeDirectionVector &RHS) const
+    {
+        return TelescopeDirectionVector(m[0][0] * RHS.x + m[0][1] * RHS.y + m[0][2] * RHS.z,
+                                        m[1][0] * RHS.x + m[1][1] * RHS.y + m[1][2] * RHS.z,
+                                        m[2][0] * RHS.x + m[2][1] * RHS.y + m[2][2] * RHS.z);
+    }
+
+    /// \brief Override the * operator to return the product of two matrices
+    constexpr Matrix3x3 operator*(const Matrix3x3 &RHS) const
+    {
+        Matrix3x3 Result;
+
+        for (int Row = 0; Row < 3; Row++)
+            for (int Column = 0; Column < 3; Column++)
+                Result.m[Row][Column] = m[Row][0] * RHS.m[0][Column] + m[Row][1] * RHS.m[1][Column] +
+                                        m[Row][2] * RHS.m[2][Column];
+        return Result;
+    }
+
+    /// \brief Return the determinant of the matrix
+    constexpr double Determinant() const
+    {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+               m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    /// \brief Invert the matrix from its adjugate
+    /// \param[out] Inversion The inverse of the matrix
+    /// \return False if the matrix is singular, Inversion is then left untouched
+    bool Invert(Matrix3x3 &Inversion) const
+    {
+        double Det = Determinant();
+
+        if (0 == Det)
+            return false;
+
+        Inversion.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / Det;
+        Inversion.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / Det;
+        Inversion.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / Det;
+        Inversion.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / Det;
+        Inversion.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / Det;
+        Inversion.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / Det;
+        Inversion.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / Det;
+        Inversion.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / Det;
+        Inversion.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / Det;
+        return true;
+    }
+};
+
 /*!
  * \struct AlignmentDatabaseEntry
  * \brief Entry in the in memory alignment database
@@ -100,6 +100,19 @@ bool ConvexHull::AddOne(tVertex p)
     return true;
 }
 
+bool ConvexHull::AddVertex(double x, double y, double z, int VertexId)
+{
+    MakeNewVertex(x, y, z, VertexId);
+
+    /* add() links the new vertex at the tail of the list. */
+    tVertex v     = vertices->prev;
+    tVertex vnext = v->next;
+    v->mark       = PROCESSED;
+    bool onhull   = AddOne(v);
+    CleanUp(&vnext);
+    return onhull;
+}
+
 void ConvexHull::CheckEndpts()
 {
     int i;
@@ -41,7 +41,7 @@ not removed.
 --------------------------------------------------------------------
 */
 
-#include <gsl/gsl_matrix.h>
+#include "Common.h"
 
 #include <cmath>
 #include <cstring>
@@ -145,19 +145,11 @@ class ConvexHull
 
         struct tFaceStructure
         {
-            tFaceStructure()
-            {
-                pMatrix = gsl_matrix_alloc(3, 3);
-            }
-            ~tFaceStructure()
-            {
-                gsl_matrix_free(pMatrix);
-            }
             tEdge edge[3];
             tVertex vertex[3];
             bool visible; // True iff face visible from new point.
             tFace next, prev;
-            gsl_matrix *pMatrix;
+            Matrix3x3 Matrix;
         };
 
         /* Define flags */
@@ -179,6 +171,13 @@ class ConvexHull
             */
         bool AddOne(tVertex p);
 
+        /** \brief AddVertex extends a hull already built by DoubleTriangle and ConstructHull with a new
+            vertex. The faces hidden by the vertex are deleted and the new faces all have it as a vertex,
+            the other faces are left untouched. Returns false if the vertex is inside the hull, which
+            is then unchanged.
+            */
+        bool AddVertex(double x, double y, double z, int VertexId);
+
         /** \brief Checks that, for each face, for each i={0,1,2}, the [i]th vertex of
             that face is either the [0]th or [1]st endpoint of the [ith] edge of
             the face.
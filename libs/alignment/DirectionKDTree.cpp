@@ -0,0 +1,89 @@
+/// \file DirectionKDTree.cpp
+
+#include "DirectionKDTree.h"
+
+#include <algorithm>
+
+namespace INDI
+{
+namespace AlignmentSubsystem
+{
+void DirectionKDTree::Build(const std::vector<TelescopeDirectionVector> &Points)
+{
+    Nodes.resize(Points.size());
+    for (size_t i = 0; i < Points.size(); i++)
+        Nodes[i] = { Points[i], i };
+    Build(0, Nodes.size(), 0);
+}
+
+void DirectionKDTree::Build(size_t Begin, size_t End, int Axis)
+{
+    if (End - Begin < 2)
+        return;
+
+    size_t Middle = Begin + (End - Begin) / 2;
+    std::nth_element(Nodes.begin() + Begin, Nodes.begin() + Middle, Nodes.begin() + End,
+                     [Axis](const Node &A, const Node &B)
+    {
+        return Coordinate(A.Point, Axis) < Coordinate(B.Point, Axis);
+    });
+    Build(Begin, Middle, (Axis + 1) % 3);
+    Build(Middle + 1, End, (Axis + 1) % 3);
+}
+
+void DirectionKDTree::Nearest(const TelescopeDirectionVector &Target, size_t Count, std::vector<Neighbour> &Result) const
+{
+    Result.clear();
+    if (Count == 0)
+        return;
+
+    // A max heap of the squared distances of the best points so far
+    Search(0, Nodes.size(), 0, Target, Count, Result);
+    std::sort_heap(Result.begin(), Result.end());
+
+    for (auto &Found : Result)
+        Found.first = 2 * asin(std::min(1.0, sqrt(Found.first) / 2));
+}
+
+void DirectionKDTree::Search(size_t Begin, size_t End, int Axis, const TelescopeDirectionVector &Target, size_t Count,
+                             std::vector<Neighbour> &Heap) const
+{
+    if (Begin >= End)
+        return;
+
+    size_t Middle       = Begin + (End - Begin) / 2;
+    const Node &Current = Nodes[Middle];
+    TelescopeDirectionVector Difference = Current.Point - Target;
+    double Distance = Difference ^ Difference;
+
+    if (Heap.size() < Count)
+    {
+        Heap.push_back({ Distance, Current.Index });
+        std::push_heap(Heap.begin(), Heap.end());
+    }
+    else if (Distance < Heap.front().first)
+    {
+        std::pop_heap(Heap.begin(), Heap.end());
+        Heap.back() = { Distance, Current.Index };
+        std::push_heap(Heap.begin(), Heap.end());
+    }
+
+    // Look first on the side of the split plane holding the target, then on the other side only if
+    // the plane is nearer than the worst point kept
+    double Split = Coordinate(Target, Axis) - Coordinate(Current.Point, Axis);
+    int Next     = (Axis + 1) % 3;
+    if (Split < 0)
+        Search(Begin, Middle, Next, Target, Count, Heap);
+    else
+        Search(Middle + 1, End, Next, Target, Count, Heap);
+    if (Heap.size() < Count || Split * Split < Heap.front().first)
+    {
+        if (Split < 0)
+            Search(Middle + 1, End, Next, Target, Count, Heap);
+        else
+            Search(Begin, Middle, Next, Target, Count, Heap);
+    }
+}
+
+} // namespace AlignmentSubsystem
+} // namespace INDI
@@ -0,0 +1,66 @@
+/// \file DirectionKDTree.h
+///
+/// This file provides a k-d tree of direction vectors for nearest neighbour lookups
+
+#pragma once
+
+#include "Common.h"
+
+#include <utility>
+#include <vector>
+
+namespace INDI
+{
+namespace AlignmentSubsystem
+{
+/*!
+ * \class DirectionKDTree
+ * \brief A balanced k-d tree over unit vectors.
+ *
+ * On the unit sphere the straight line distance between two points grows with the angle between them,
+ * so the nearest points in space are also the nearest on the sphere.
+ */
+class DirectionKDTree
+{
+    public:
+        /// \brief A point found by a lookup: its angular distance in radians and its index in the built points
+        typedef std::pair<double, size_t> Neighbour;
+
+        /// \brief Build the tree, replacing any previous content
+        /// \param[in] Points The unit vectors to index, lookups return positions in this vector
+        void Build(const std::vector<TelescopeDirectionVector> &Points);
+
+        /// \return True if the tree holds no point
+        bool Empty() const
+        {
+            return Nodes.empty();
+        }
+
+        /// \brief Find the points nearest to a direction
+        /// \param[in] Target The unit vector to look around
+        /// \param[in] Count The number of points wanted
+        /// \param[out] Result The nearest points, closest first; fewer than Count if the tree holds fewer
+        void Nearest(const TelescopeDirectionVector &Target, size_t Count, std::vector<Neighbour> &Result) const;
+
+    private:
+        struct Node
+        {
+            TelescopeDirectionVector Point;
+            size_t Index;
+        };
+
+        void Build(size_t Begin, size_t End, int Axis);
+        void Search(size_t Begin, size_t End, int Axis, const TelescopeDirectionVector &Target, size_t Count,
+                    std::vector<Neighbour> &Heap) const;
+
+        static double Coordinate(const TelescopeDirectionVector &Vector, int Axis)
+        {
+            return Axis == 0 ? Vector.x : Axis == 1 ? Vector.y : Vector.z;
+        }
+
+        // The tree is implicit: the node of a range is at its middle, the halves on each side are its subtrees
+        std::vector<Node> Nodes;
+};
+
+} // namespace AlignmentSubsystem
+} // namespace INDI
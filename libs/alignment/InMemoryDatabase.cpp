@@ -11,17 +11,63 @@
 #include "basedevice.h"
 #include "indicom.h"
 
+#include <algorithm>
 #include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 namespace INDI
 {
 namespace AlignmentSubsystem
 {
+// The binary database file is a header followed by one record per sync point, in the byte order of the host.
+// Records are only ever appended, a file whose length is not a whole number of records was cut short while
+// appending and its last partial record is ignored.
+static const char BinaryDatabaseMagic[8] = { 'I', 'N', 'D', 'I', 'A', 'L', 'D', 'B' };
+static const uint32_t BinaryDatabaseVersion = 1;
+
+struct BinaryDatabaseHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ReferencePositionIsValid;
+    double Latitude;
+    double Longitude;
+};
+
+struct BinaryDatabaseRecord
+{
+    double ObservationJulianDate;
+    double RightAscension;
+    double Declination;
+    double TelescopeDirectionX;
+    double TelescopeDirectionY;
+    double TelescopeDirectionZ;
+};
+
+static BinaryDatabaseRecord RecordFromEntry(const AlignmentDatabaseEntry &Entry)
+{
+    return { Entry.ObservationJulianDate, Entry.RightAscension, Entry.Declination, Entry.TelescopeDirection.x,
+             Entry.TelescopeDirection.y, Entry.TelescopeDirection.z };
+}
+
+static bool SameRecord(const AlignmentDatabaseEntry &First, const AlignmentDatabaseEntry &Second)
+{
+    return First.ObservationJulianDate == Second.ObservationJulianDate &&
+           First.RightAscension == Second.RightAscension && First.Declination == Second.Declination &&
+           First.TelescopeDirection.x == Second.TelescopeDirection.x &&
+           First.TelescopeDirection.y == Second.TelescopeDirection.y &&
+           First.TelescopeDirection.z == Second.TelescopeDirection.z;
+}
+
 InMemoryDatabase::InMemoryDatabase() : DatabaseReferencePositionIsValid(false),
-    LoadDatabaseCallback(nullptr), LoadDatabaseCallbackThisPointer(nullptr)
+    LoadDatabaseCallback(nullptr), LoadDatabaseCallbackThisPointer(nullptr),
+    PersistedReferencePosition { 0, 0, 0 }, PersistedReferencePositionIsValid(false)
 {
 }
 
@@ -68,6 +114,86 @@ bool InMemoryDatabase::GetDatabaseReferencePosition(IGeographicCoordinates &Posi
 bool InMemoryDatabase::LoadDatabase(const char *DeviceName)
 {
     char DatabaseFileName[MAXRBUF];
+    char Errmsg[MAXRBUF];
+    struct stat Status;
+
+    snprintf(DatabaseFileName, MAXRBUF, "%s/.indi/%s_alignment_database.bin", getenv("HOME"), DeviceName);
+
+    int fd = open(DatabaseFileName, O_RDONLY);
+    if (fd < 0)
+    {
+        // No binary database yet, import the one saved in XML by earlier versions
+        char XMLFileName[MAXRBUF];
+        snprintf(XMLFileName, MAXRBUF, "%s/.indi/%s_alignment_database.xml", getenv("HOME"), DeviceName);
+        return ImportDatabase(XMLFileName);
+    }
+
+    if (fstat(fd, &Status) != 0 || Status.st_size < static_cast<off_t>(sizeof(BinaryDatabaseHeader)))
+    {
+        snprintf(Errmsg, MAXRBUF, "Alignment database file %s is truncated\n", DatabaseFileName);
+        close(fd);
+        return false;
+    }
+
+    size_t FileSize = Status.st_size;
+    void *Mapping   = mmap(nullptr, FileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (Mapping == MAP_FAILED)
+    {
+        snprintf(Errmsg, MAXRBUF, "Unable to map alignment database file %s: %s\n", DatabaseFileName,
+                 strerror(errno));
+        return false;
+    }
+
+    BinaryDatabaseHeader Header;
+    memcpy(&Header, Mapping, sizeof(Header));
+    if (memcmp(Header.Magic, BinaryDatabaseMagic, sizeof(Header.Magic)) != 0 || Header.Version != BinaryDatabaseVersion)
+    {
+        snprintf(Errmsg, MAXRBUF, "Alignment database file %s has an unknown format\n", DatabaseFileName);
+        munmap(Mapping, FileSize);
+        return false;
+    }
+
+    if (Header.ReferencePositionIsValid)
+    {
+        DatabaseReferencePosition.latitude  = Header.Latitude;
+        DatabaseReferencePosition.longitude = Header.Longitude;
+        DatabaseReferencePositionIsValid    = true;
+    }
+
+    size_t RecordCount = (FileSize - sizeof(Header)) / sizeof(BinaryDatabaseRecord);
+    const unsigned char *Records = static_cast<const unsigned char *>(Mapping) + sizeof(Header);
+    MySyncPoints.clear();
+    MySyncPoints.reserve(RecordCount);
+    for (size_t i = 0; i < RecordCount; i++)
+    {
+        BinaryDatabaseRecord Record;
+        memcpy(&Record, Records + i * sizeof(Record), sizeof(Record));
+        AlignmentDatabaseEntry CurrentValues;
+        CurrentValues.ObservationJulianDate = Record.ObservationJulianDate;
+        CurrentValues.RightAscension        = Record.RightAscension;
+        CurrentValues.Declination           = Record.Declination;
+        CurrentValues.TelescopeDirection    = TelescopeDirectionVector(Record.TelescopeDirectionX,
+                                              Record.TelescopeDirectionY, Record.TelescopeDirectionZ);
+        MySyncPoints.push_back(CurrentValues);
+    }
+    munmap(Mapping, FileSize);
+
+    // A partial record left by an interrupted append is dropped by rewriting the file on the next save
+    bool WholeRecords = (FileSize - sizeof(Header)) % sizeof(BinaryDatabaseRecord) == 0;
+    PersistedFileName                 = WholeRecords ? DatabaseFileName : "";
+    PersistedSyncPoints               = MySyncPoints;
+    PersistedReferencePosition        = DatabaseReferencePosition;
+    PersistedReferencePositionIsValid = DatabaseReferencePositionIsValid;
+
+    if (nullptr != LoadDatabaseCallback)
+        (*LoadDatabaseCallback)(LoadDatabaseCallbackThisPointer);
+
+    return true;
+}
+
+bool InMemoryDatabase::ImportDatabase(const char *FileName)
+{
     char Errmsg[MAXRBUF];
     XMLEle *FileRoot    = nullptr;
     XMLEle *EntriesRoot = nullptr;
@@ -78,13 +204,11 @@ bool InMemoryDatabase::LoadDatabase(const char *DeviceName)
 
     FILE *fp = nullptr;
 
-    snprintf(DatabaseFileName, MAXRBUF, "%s/.indi/%s_alignment_database.xml", getenv("HOME"), DeviceName);
-
-    fp = fopen(DatabaseFileName, "r");
+    fp = fopen(FileName, "r");
     if (fp == nullptr)
     {
         snprintf(Errmsg, MAXRBUF, "Unable to read alignment database file. Error loading file %s: %s\n",
-                 DatabaseFileName, strerror(errno));
+                 FileName, strerror(errno));
         return false;
     }
 
@@ -168,6 +292,9 @@ bool InMemoryDatabase::LoadDatabase(const char *DeviceName)
     delXMLEle(FileRoot);
     delLilXML(Parser);
 
+    // The binary file no longer matches the database, the next save rewrites it
+    PersistedFileName.clear();
+
     if (nullptr != LoadDatabaseCallback)
         (*LoadDatabaseCallback)(LoadDatabaseCallbackThisPointer);
 
@@ -183,7 +310,7 @@ bool InMemoryDatabase::SaveDatabase(const char *DeviceName)
     FILE *fp;
 
     snprintf(ConfigDir, MAXRBUF, "%s/.indi/", getenv("HOME"));
-    snprintf(DatabaseFileName, MAXRBUF, "%s%s_alignment_database.xml", ConfigDir, DeviceName);
+    snprintf(DatabaseFileName, MAXRBUF, "%s%s_alignment_database.bin", ConfigDir, DeviceName);
 
     if (stat(ConfigDir, &Status) != 0)
     {
@@ -194,7 +321,19 @@ bool InMemoryDatabase::SaveDatabase(const char *DeviceName)
         }
     }
 
-    fp = fopen(DatabaseFileName, "w");
+    // Only append the new sync points when the file holds the others under the same reference position
+    bool Append = PersistedFileName == DatabaseFileName && PersistedSyncPoints.size() <= MySyncPoints.size() &&
+                  PersistedReferencePositionIsValid == DatabaseReferencePositionIsValid &&
+                  (!DatabaseReferencePositionIsValid ||
+                   (PersistedReferencePosition.latitude == DatabaseReferencePosition.latitude &&
+                    PersistedReferencePosition.longitude == DatabaseReferencePosition.longitude)) &&
+                  std::equal(PersistedSyncPoints.begin(), PersistedSyncPoints.end(), MySyncPoints.begin(), SameRecord);
+
+    // A rewrite goes through a temporary file so that the previous database survives a failed save
+    char TemporaryFileName[MAXRBUF + 4];
+    snprintf(TemporaryFileName, sizeof(TemporaryFileName), "%s.tmp", DatabaseFileName);
+
+    fp = fopen(Append ? DatabaseFileName : TemporaryFileName, Append ? "ab" : "wb");
     if (fp == nullptr)
     {
         snprintf(Errmsg, MAXRBUF, "Unable to open database file. Error opening file %s: %s\n", DatabaseFileName,
@@ -202,6 +341,64 @@ bool InMemoryDatabase::SaveDatabase(const char *DeviceName)
         return false;
     }
 
+    bool Written = true;
+    size_t FirstRecord = 0;
+    if (Append)
+        FirstRecord = PersistedSyncPoints.size();
+    else
+    {
+        BinaryDatabaseHeader Header;
+        memset(&Header, 0, sizeof(Header));
+        memcpy(Header.Magic, BinaryDatabaseMagic, sizeof(Header.Magic));
+        Header.Version                  = BinaryDatabaseVersion;
+        Header.ReferencePositionIsValid = DatabaseReferencePositionIsValid ? 1 : 0;
+        Header.Latitude                 = DatabaseReferencePosition.latitude;
+        Header.Longitude                = DatabaseReferencePosition.longitude;
+        Written = fwrite(&Header, sizeof(Header), 1, fp) == 1;
+    }
+
+    std::vector<BinaryDatabaseRecord> Records;
+    Records.reserve(MySyncPoints.size() - FirstRecord);
+    for (size_t i = FirstRecord; i < MySyncPoints.size(); i++)
+        Records.push_back(RecordFromEntry(MySyncPoints[i]));
+    if (Written && !Records.empty())
+        Written = fwrite(Records.data(), sizeof(BinaryDatabaseRecord), Records.size(), fp) == Records.size();
+
+    Written = (fclose(fp) == 0) && Written;
+    if (!Append)
+        Written = Written && rename(TemporaryFileName, DatabaseFileName) == 0;
+
+    if (!Written)
+    {
+        snprintf(Errmsg, MAXRBUF, "Unable to write database file %s: %s\n", DatabaseFileName, strerror(errno));
+        if (!Append)
+            unlink(TemporaryFileName);
+        // The file may end with part of the new records, rewrite it on the next save
+        PersistedFileName.clear();
+        return false;
+    }
+
+    PersistedFileName                 = DatabaseFileName;
+    PersistedSyncPoints               = MySyncPoints;
+    PersistedReferencePosition        = DatabaseReferencePosition;
+    PersistedReferencePositionIsValid = DatabaseReferencePositionIsValid;
+
+    return true;
+}
+
+bool InMemoryDatabase::ExportDatabase(const char *FileName)
+{
+    char Errmsg[MAXRBUF];
+    FILE *fp;
+
+    fp = fopen(FileName, "w");
+    if (fp == nullptr)
+    {
+        snprintf(Errmsg, MAXRBUF, "Unable to open database file. Error opening file %s: %s\n", FileName,
+                 strerror(errno));
+        return false;
+    }
+
     fprintf(fp, "<INDIAlignmentDatabase>\n");
 
     if (DatabaseReferencePositionIsValid)
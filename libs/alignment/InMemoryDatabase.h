@@ -12,6 +12,7 @@
 
 #include "libastro.h"
 
+#include <string>
 #include <vector>
 
 namespace INDI
@@ -59,13 +60,26 @@ class InMemoryDatabase
         /// \brief Load the database from persistent storage
         /// \param[in] DeviceName The name of the current device.
         /// \return True if successful
+        /// \note The binary database file is read if it exists, the XML one of earlier versions otherwise.
         bool LoadDatabase(const char *DeviceName);
 
         /// \brief Save the database to persistent storage
         /// \param[in] DeviceName The name of the current device.
         /// \return True if successful
+        /// \note The database is saved in binary form. When sync points have only been added since the last
+        /// load or save, just the new ones are appended to the file.
         bool SaveDatabase(const char *DeviceName);
 
+        /// \brief Load the database from an XML file
+        /// \param[in] FileName The name of the file.
+        /// \return True if successful
+        bool ImportDatabase(const char *FileName);
+
+        /// \brief Save the database to an XML file
+        /// \param[in] FileName The name of the file.
+        /// \return True if successful
+        bool ExportDatabase(const char *FileName);
+
         /// \brief Set the database reference position
         /// \param[in] Latitude
         /// \param[in] Longitude
@@ -84,6 +98,12 @@ class InMemoryDatabase
         bool DatabaseReferencePositionIsValid;
         LoadDatabaseCallbackPointer_t LoadDatabaseCallback;
         void *LoadDatabaseCallbackThisPointer;
+
+        // The state of the database in the binary file named PersistedFileName, empty when unknown
+        std::string PersistedFileName;
+        AlignmentDatabaseType PersistedSyncPoints;
+        IGeographicCoordinates PersistedReferencePosition;
+        bool PersistedReferencePositionIsValid;
 };
 
 } // namespace AlignmentSubsystem
@@ -18,5 +18,26 @@ bool MathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
     return true;
 }
 
+bool MathPlugin::TransformCelestialToTelescopeBatch(const double *RightAscensions, const double *Declinations,
+        size_t Count, double JulianOffset,
+        TelescopeDirectionVector *ApparentTelescopeDirectionVectors)
+{
+    bool AllTransformed = true;
+    for (size_t i = 0; i < Count; i++)
+        AllTransformed &= TransformCelestialToTelescope(RightAscensions[i], Declinations[i], JulianOffset,
+                          ApparentTelescopeDirectionVectors[i]);
+    return AllTransformed;
+}
+
+bool MathPlugin::TransformTelescopeToCelestialBatch(const TelescopeDirectionVector *ApparentTelescopeDirectionVectors,
+        size_t Count, double *RightAscensions, double *Declinations)
+{
+    bool AllTransformed = true;
+    for (size_t i = 0; i < Count; i++)
+        AllTransformed &= TransformTelescopeToCelestial(ApparentTelescopeDirectionVectors[i], RightAscensions[i],
+                          Declinations[i]);
+    return AllTransformed;
+}
+
 } // namespace AlignmentSubsystem
 } // namespace INDI
@@ -75,6 +75,29 @@ class MathPlugin
         virtual bool TransformTelescopeToCelestial(const TelescopeDirectionVector &ApparentTelescopeDirectionVector,
                 double &RightAscension, double &Declination) = 0;
 
+        /// \brief Get the alignment corrected telescope pointing directions for an array of celestial coordinates
+        /// \param[in] RightAscensions Count Right Ascensions (Decimal Hours).
+        /// \param[in] Declinations Count Declinations (Decimal Degrees).
+        /// \param[in] Count The number of coordinates to transform.
+        /// \param[in] JulianOffset to be applied to the current julian date, the same for every coordinate.
+        /// \param[out] ApparentTelescopeDirectionVectors Array of Count vectors to receive the corrected telescope directions
+        /// \return True if every coordinate was transformed
+        /// \note The default implementation calls TransformCelestialToTelescope for each coordinate. Plugins can
+        /// override it to share the work that does not depend on the coordinate.
+        virtual bool TransformCelestialToTelescopeBatch(const double *RightAscensions, const double *Declinations,
+                size_t Count, double JulianOffset,
+                TelescopeDirectionVector *ApparentTelescopeDirectionVectors);
+
+        /// \brief Get the true celestial coordinates for an array of telescope pointing directions
+        /// \param[in] ApparentTelescopeDirectionVectors Count telescope directions
+        /// \param[in] Count The number of directions to transform.
+        /// \param[out] RightAscensions Array of Count values to receive the Right Ascensions (Decimal Hours).
+        /// \param[out] Declinations Array of Count values to receive the Declinations (Decimal Degrees).
+        /// \return True if every direction was transformed
+        /// \note The default implementation calls TransformTelescopeToCelestial for each direction.
+        virtual bool TransformTelescopeToCelestialBatch(const TelescopeDirectionVector *ApparentTelescopeDirectionVectors,
+                size_t Count, double *RightAscensions, double *Declinations);
+
     protected:
         // Protected properties
         /// \brief Describe the approximate alignment of the mount. This information is normally used in a one star alignment
@@ -134,6 +134,29 @@ class MathPluginManagement : private MathPlugin // Derive from MathPluign to for
         bool TransformTelescopeToCelestial(const TelescopeDirectionVector &ApparentTelescopeDirectionVector,
                                            double &RightAscension, double &Declination);
 
+        /**
+         * @brief TransformCelestialToTelescopeBatch Transforms an array of Celestial (Sky) Coords to Mount Coordinates
+         * @param RightAscensions Count Sky Right Ascensions in hours.
+         * @param Declinations Count Sky Declinations in degrees
+         * @param Count Number of coordinates to transform
+         * @param JulianOffset Julian time Offset in days, the same for every coordinate
+         * @param ApparentTelescopeDirectionVectors Output Count Apparent Telescope Direction Vectors
+         * @return True if every transformation is successful, false otherwise.
+         */
+        bool TransformCelestialToTelescopeBatch(const double *RightAscensions, const double *Declinations, size_t Count,
+                                                double JulianOffset, TelescopeDirectionVector *ApparentTelescopeDirectionVectors);
+
+        /**
+         * @brief TransformTelescopeToCelestialBatch Transforms an array of Mount Coords to Celestial (Sky) Coordinates
+         * @param ApparentTelescopeDirectionVectors Input Count Apparent Telescope Direction Vectors
+         * @param Count Number of vectors to transform
+         * @param RightAscensions Output Count Celestial Right Ascensions
+         * @param Declinations Output Count Celestial Declinations
+         * @return True if every transformation is successful, false otherwise.
+         */
+        bool TransformTelescopeToCelestialBatch(const TelescopeDirectionVector *ApparentTelescopeDirectionVectors,
+                                                size_t Count, double *RightAscensions, double *Declinations);
+
     private:
         void EnumeratePlugins();
         void HandlePluginLoading(Telescope *pTelescope, int CurrentPlugin, int NewPlugin);
@@ -163,6 +186,11 @@ class MathPluginManagement : private MathPlugin // Derive from MathPluign to for
                 TelescopeDirectionVector &TelescopeDirectionVector);
         bool (MathPlugin::*pTransformTelescopeToCelestial)(const TelescopeDirectionVector &TelescopeDirectionVector,
                 double &RightAscension, double &Declination);
+        bool (MathPlugin::*pTransformCelestialToTelescopeBatch)(const double *RightAscensions,
+                const double *Declinations, size_t Count, double JulianOffset,
+                TelescopeDirectionVector *TelescopeDirectionVectors);
+        bool (MathPlugin::*pTransformTelescopeToCelestialBatch)(const TelescopeDirectionVector *TelescopeDirectionVectors,
+                size_t Count, double *RightAscensions, double *Declinations);
         MathPlugin *pLoadedMathPlugin;
         void *LoadedMathPluginHandle;
 
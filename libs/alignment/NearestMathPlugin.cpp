@@ -22,6 +22,9 @@
 
 #include <libnova/julian_day.h>
 
+#include <algorithm>
+#include <cstdlib>
+
 namespace INDI
 {
 namespace AlignmentSubsystem
@@ -59,7 +62,9 @@ extern "C" {
 //////////////////////////////////////////////////////////////////////////////////////
 NearestMathPlugin::NearestMathPlugin()
 {
-
+    const char *neighbours = getenv("INDI_NEAREST_MATH_NEIGHBOURS");
+    if (neighbours != nullptr)
+        SetNeighbourCount(std::max(1, atoi(neighbours)));
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
@@ -124,9 +129,27 @@ bool NearestMathPlugin::Initialise(InMemoryDatabase *pInMemoryDatabase)
         ExtendedAlignmentPoints.push_back(oneEntry);
     }
 
+    // Index the points for the nearest point lookups
+    std::vector<TelescopeDirectionVector> CelestialDirections, TelescopeDirections;
+    for (auto &oneEntry : ExtendedAlignmentPoints)
+    {
+        CelestialDirections.push_back(HorizontalDirection(oneEntry.CelestialAzimuth, oneEntry.CelestialAltitude));
+        TelescopeDirections.push_back(HorizontalDirection(oneEntry.TelescopeAzimuth, oneEntry.TelescopeAltitude));
+    }
+    CelestialPoints.Build(CelestialDirections);
+    TelescopePoints.Build(TelescopeDirections);
+
     return true;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////////////
+void NearestMathPlugin::SetNeighbourCount(size_t Count)
+{
+    NeighbourCount = std::max<size_t>(1, Count);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////
 ///
 //////////////////////////////////////////////////////////////////////////////////////
@@ -165,33 +188,42 @@ bool NearestMathPlugin::TransformCelestialToTelescope(const double RightAscensio
         return true;
     }
 
-    // If we have sync points, then get the Nearest Point
-    ExtendedAlignmentDatabaseEntry nearest = GetNearestPoint(CelestialAltAz.azimuth, CelestialAltAz.altitude, true);
+    // If we have sync points, then get the Nearest Points
+    NearestOffsets.clear();
+    for (auto &onePoint : GetNearestPoints(CelestialAltAz.azimuth, CelestialAltAz.altitude, true))
+    {
+        const ExtendedAlignmentDatabaseEntry &nearest = ExtendedAlignmentPoints[onePoint.second];
 
-    INDI::IEquatorialCoordinates TelescopeRADE;
+        INDI::IEquatorialCoordinates TelescopeRADE;
 
-    // Get the nearest point in the telescope reference frame
+        // Get the nearest point in the telescope reference frame
 
-    // Alt-Az? Transform the nearest telescope direction vector to telescope Alt-Az and then to telescope RA/DE
-    if (ApproximateMountAlignment == ZENITH)
-    {
-        INDI::IHorizontalCoordinates TelescopeAltAz;
-        AltitudeAzimuthFromTelescopeDirectionVector(nearest.TelescopeDirection, TelescopeAltAz);
-        HorizontalToEquatorial(&TelescopeAltAz, &Position, nearest.ObservationJulianDate, &TelescopeRADE);
-    }
-    // Equatorial? Transform nearest directly to telescope RA/DE
-    else
-    {
-        EquatorialCoordinatesFromTelescopeDirectionVector(nearest.TelescopeDirection, TelescopeRADE);
+        // Alt-Az? Transform the nearest telescope direction vector to telescope Alt-Az and then to telescope RA/DE
+        if (ApproximateMountAlignment == ZENITH)
+        {
+            INDI::IHorizontalCoordinates TelescopeAltAz;
+            AltitudeAzimuthFromTelescopeDirectionVector(nearest.TelescopeDirection, TelescopeAltAz);
+            HorizontalToEquatorial(&TelescopeAltAz, &Position, nearest.ObservationJulianDate, &TelescopeRADE);
+        }
+        // Equatorial? Transform nearest directly to telescope RA/DE
+        else
+        {
+            EquatorialCoordinatesFromTelescopeDirectionVector(nearest.TelescopeDirection, TelescopeRADE);
+        }
+
+        NearestOffsets.push_back({nearest.RightAscension - TelescopeRADE.rightascension,
+                                  nearest.Declination - TelescopeRADE.declination});
     }
 
     // Adjust the Celestial coordinates to account for the offset between the nearest point and the telescope
     // e.g. Celestial RA = 5. Nearest Point (Sky: 4, Telescope: 3)
     // Means Final Telescope RA = 5 - (4-3) = 4
     // So we can issue GOTO to RA ~4, and it should up near Celestial RA ~5
+    double RightAscensionOffset, DeclinationOffset;
+    WeightedOffset(RightAscensionOffset, DeclinationOffset);
     INDI::IEquatorialCoordinates TransformedTelescopeRADE = CelestialRADE;
-    TransformedTelescopeRADE.rightascension -= (nearest.RightAscension - TelescopeRADE.rightascension);
-    TransformedTelescopeRADE.declination -= (nearest.Declination - TelescopeRADE.declination);
+    TransformedTelescopeRADE.rightascension -= RightAscensionOffset;
+    TransformedTelescopeRADE.declination -= DeclinationOffset;
 
     // Final step is to convert transformed telescope coordinates to a direction vector
     if (ApproximateMountAlignment == ZENITH)
@@ -260,29 +292,38 @@ bool NearestMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVe
         EquatorialToHorizontal(&TelescopeRADE, &Position, JDD, &TelescopeAltAz);
     }
 
-    // Find the nearest point to our telescope now
-    ExtendedAlignmentDatabaseEntry nearest = GetNearestPoint(TelescopeAltAz.azimuth, TelescopeAltAz.altitude, false);
-
-    // Now get the nearest telescope in equatorial coordinates.
-    INDI::IEquatorialCoordinates NearestTelescopeRADE;
-    if (ApproximateMountAlignment == ZENITH)
+    // Find the nearest points to our telescope now
+    NearestOffsets.clear();
+    for (auto &onePoint : GetNearestPoints(TelescopeAltAz.azimuth, TelescopeAltAz.altitude, false))
     {
-        INDI::IHorizontalCoordinates NearestTelescopeAltAz {nearest.TelescopeAzimuth, nearest.TelescopeAltitude};
-        HorizontalToEquatorial(&NearestTelescopeAltAz, &Position, nearest.ObservationJulianDate, &NearestTelescopeRADE);
-    }
-    // Equatorial?
-    else
-    {
-        EquatorialCoordinatesFromTelescopeDirectionVector(nearest.TelescopeDirection, NearestTelescopeRADE);
+        const ExtendedAlignmentDatabaseEntry &nearest = ExtendedAlignmentPoints[onePoint.second];
+
+        // Now get the nearest telescope in equatorial coordinates.
+        INDI::IEquatorialCoordinates NearestTelescopeRADE;
+        if (ApproximateMountAlignment == ZENITH)
+        {
+            INDI::IHorizontalCoordinates NearestTelescopeAltAz {nearest.TelescopeAzimuth, nearest.TelescopeAltitude};
+            HorizontalToEquatorial(&NearestTelescopeAltAz, &Position, nearest.ObservationJulianDate, &NearestTelescopeRADE);
+        }
+        // Equatorial?
+        else
+        {
+            EquatorialCoordinatesFromTelescopeDirectionVector(nearest.TelescopeDirection, NearestTelescopeRADE);
+        }
+
+        NearestOffsets.push_back({nearest.RightAscension - NearestTelescopeRADE.rightascension,
+                                  nearest.Declination - NearestTelescopeRADE.declination});
     }
 
     // Adjust the Telescope coordinates to account for the offset between the nearest point and the telescope
     // e.g. Telescope RA = 5. Nearest Point (Target: 4, Telescope: 3)
     // Means Final Telescope RA = 5 + (4-3) = 6
     // So a telescope reporting ~5 hours should actually be pointing to ~6 hours in the sky.
+    double RightAscensionOffset, DeclinationOffset;
+    WeightedOffset(RightAscensionOffset, DeclinationOffset);
     INDI::IEquatorialCoordinates TransformedCelestialRADE = TelescopeRADE;
-    TransformedCelestialRADE.rightascension += (nearest.RightAscension - NearestTelescopeRADE.rightascension);
-    TransformedCelestialRADE.declination += (nearest.Declination - NearestTelescopeRADE.declination);
+    TransformedCelestialRADE.rightascension += RightAscensionOffset;
+    TransformedCelestialRADE.declination += DeclinationOffset;
 
     RightAscension = TransformedCelestialRADE.rightascension;
     Declination = TransformedCelestialRADE.declination;
@@ -292,29 +333,46 @@ bool NearestMathPlugin::TransformTelescopeToCelestial(const TelescopeDirectionVe
 //////////////////////////////////////////////////////////////////////////////////////
 ///
 //////////////////////////////////////////////////////////////////////////////////////
-ExtendedAlignmentDatabaseEntry NearestMathPlugin::GetNearestPoint(const double Azimuth, const double Altitude,
-        bool isCelestial)
+const std::vector<DirectionKDTree::Neighbour> &NearestMathPlugin::GetNearestPoints(const double Azimuth,
+        const double Altitude, bool isCelestial)
 {
-    ExtendedAlignmentDatabaseEntry nearest;
-    double distance = 1e6;
+    const DirectionKDTree &Points = isCelestial ? CelestialPoints : TelescopePoints;
+    Points.Nearest(HorizontalDirection(Azimuth, Altitude), NeighbourCount, NearestPoints);
+    return NearestPoints;
+}
 
-    for (auto &oneEntry : ExtendedAlignmentPoints)
+//////////////////////////////////////////////////////////////////////////////////////
+/// Inverse distance weighting: a point at the target outweighs all others.
+//////////////////////////////////////////////////////////////////////////////////////
+void NearestMathPlugin::WeightedOffset(double &RightAscensionOffset, double &DeclinationOffset) const
+{
+    RightAscensionOffset = NearestOffsets.front().rightascension;
+    DeclinationOffset    = NearestOffsets.front().declination;
+    if (NearestOffsets.size() == 1)
+        return;
+
+    // Average the RA offsets as differences to the first one, so that a wrap at 24 hours is not averaged in
+    double totalWeight = 0, RightAscensionSum = 0, DeclinationSum = 0;
+    for (size_t i = 0; i < NearestOffsets.size(); i++)
     {
-        double oneDistance = 0;
-
-        if (isCelestial)
-            oneDistance = SphereUnitDistance(Azimuth, oneEntry.CelestialAzimuth, Altitude, oneEntry.CelestialAltitude);
-        else
-            oneDistance = SphereUnitDistance(Azimuth, oneEntry.TelescopeAzimuth, Altitude, oneEntry.TelescopeAltitude);
-
-        if (oneDistance < distance)
-        {
-            nearest = oneEntry;
-            distance = oneDistance;
-        }
+        double weight = 1 / std::max(NearestPoints[i].first * NearestPoints[i].first, 1e-12);
+        double RightAscensionDelta = NearestOffsets[i].rightascension - RightAscensionOffset;
+        RightAscensionDelta -= 24 * floor((RightAscensionDelta + 12) / 24);
+        RightAscensionSum += weight * RightAscensionDelta;
+        DeclinationSum += weight * NearestOffsets[i].declination;
+        totalWeight += weight;
     }
+    RightAscensionOffset += RightAscensionSum / totalWeight;
+    DeclinationOffset = DeclinationSum / totalWeight;
+}
 
-    return nearest;
+//////////////////////////////////////////////////////////////////////////////////////
+/// Same distances as SphereUnitDistance: azimuth is the longitude and altitude the latitude.
+//////////////////////////////////////////////////////////////////////////////////////
+TelescopeDirectionVector NearestMathPlugin::HorizontalDirection(double Azimuth, double Altitude)
+{
+    double azimuth = Azimuth * (M_PI / 180), altitude = Altitude * (M_PI / 180);
+    return TelescopeDirectionVector(cos(altitude) * cos(azimuth), cos(altitude) * sin(azimuth), sin(altitude));
 }
 
 //////////////////////////////////////////////////////////////////////////////////////
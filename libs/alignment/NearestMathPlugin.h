@@ -22,6 +22,7 @@
 
 #include "AlignmentSubsystemForMathPlugins.h"
 #include "ConvexHull.h"
+#include "DirectionKDTree.h"
 
 namespace INDI
 {
@@ -109,10 +110,27 @@ class NearestMathPlugin : public AlignmentSubsystemForMathPlugins
         virtual bool TransformTelescopeToCelestial(const TelescopeDirectionVector &ApparentTelescopeDirectionVector,
                 double &RightAscension, double &Declination);
 
+        /**
+         * @brief SetNeighbourCount Set how many sync points correct a transform.
+         * @param Count With 1, the default, the offsets of the nearest point are applied. With more, the offsets
+         * of the Count nearest points are averaged, weighted by the inverse square of their distance.
+         * @note The INDI_NEAREST_MATH_NEIGHBOURS environment variable sets the initial count.
+         */
+        void SetNeighbourCount(size_t Count);
+
     private:
 
         std::vector<ExtendedAlignmentDatabaseEntry> ExtendedAlignmentPoints;
 
+        /// Sync points by celestial and by telescope horizontal coordinates, positions in ExtendedAlignmentPoints.
+        DirectionKDTree CelestialPoints;
+        DirectionKDTree TelescopePoints;
+
+        /// Sync points weighted in a transform, with the result and the offsets of the last lookup
+        size_t NeighbourCount { 1 };
+        std::vector<DirectionKDTree::Neighbour> NearestPoints;
+        std::vector<INDI::IEquatorialCoordinates> NearestOffsets;
+
         /**
          * @brief SphereUnitDistance Get distance between two points on a sphere.
          * @param theta1 latitudal angle of object 1
@@ -124,14 +142,31 @@ class NearestMathPlugin : public AlignmentSubsystemForMathPlugins
         double SphereUnitDistance(double theta1, double theta2, double phi1, double phi2);
 
         /**
-         * @brief GetNearestPoint Traverses the ExtendedAlignmentPoints to find the closest point in horizontal coordinates on
-         * a sphere.
+         * @brief HorizontalDirection Get the unit vector of horizontal coordinates, for the nearest point lookups.
+         * @param Azimuth Azimuth in degrees.
+         * @param Altitude Altitude in degrees.
+         * @return Unit vector, distances between these vectors order the points like SphereUnitDistance.
+         */
+        static TelescopeDirectionVector HorizontalDirection(double Azimuth, double Altitude);
+
+        /**
+         * @brief GetNearestPoints Look up the closest points in horizontal coordinates on a sphere.
          * @param Azimuth Object azimuth in degrees.
          * @param Altitude Object altitude in degrees.
          * @param isCelestial If true, compute difference between Celestial coords, otherwise compute using Telescope coords.
-         * @return Closest point in data set.
+         * @return The NeighbourCount closest points, nearest first, as distances in radians and positions in
+         * ExtendedAlignmentPoints.
+         */
+        const std::vector<DirectionKDTree::Neighbour> &GetNearestPoints(const double Azimuth, const double Altitude,
+                bool isCelestial);
+
+        /**
+         * @brief WeightedOffset Average the NearestOffsets, RA in hours and DE in degrees, of the NearestPoints.
+         * @param RightAscensionOffset Receives the RA offset.
+         * @param DeclinationOffset Receives the DE offset.
+         * @note With a single point its offsets are returned unchanged.
          */
-        ExtendedAlignmentDatabaseEntry GetNearestPoint(const double Azimuth, const double Altitude, bool isCelestial);
+        void WeightedOffset(double &RightAscensionOffset, double &DeclinationOffset) const;
 };
 
 } // namespace AlignmentSubsystem
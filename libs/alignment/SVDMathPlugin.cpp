@@ -34,8 +34,8 @@ void SVDMathPlugin::CalculateTransformMatrices(const TelescopeDirectionVector &A
         const TelescopeDirectionVector &Alpha3,
         const TelescopeDirectionVector &Beta1,
         const TelescopeDirectionVector &Beta2,
-        const TelescopeDirectionVector &Beta3, gsl_matrix *pAlphaToBeta,
-        gsl_matrix *pBetaToAlpha)
+        const TelescopeDirectionVector &Beta3, Matrix3x3 *pAlphaToBeta,
+        Matrix3x3 *pBetaToAlpha)
 {
     // Set up the column vectors
     gsl_matrix *pAlphaMatrix = gsl_matrix_alloc(3, 3);
@@ -90,25 +90,27 @@ void SVDMathPlugin::CalculateTransformMatrices(const TelescopeDirectionVector &A
     gsl_matrix_transpose(pV);
     gsl_matrix *pIntermediateMatrix2 = gsl_matrix_alloc(3, 3);
     MatrixMatrixMultiply(pIntermediateMatrix1, pDiagonal, pIntermediateMatrix2);
-    MatrixMatrixMultiply(pIntermediateMatrix2, pV, pAlphaToBeta);
+    // The transform is written straight into the caller's matrix, which has the row major layout of gsl
+    gsl_matrix_view AlphaToBeta = gsl_matrix_view_array(&pAlphaToBeta->m[0][0], 3, 3);
+    MatrixMatrixMultiply(pIntermediateMatrix2, pV, &AlphaToBeta.matrix);
 
-    Dump3x3("AlphaToBeta", pAlphaToBeta);
+    Dump3x3("AlphaToBeta", *pAlphaToBeta);
 
     if (nullptr != pBetaToAlpha)
     {
         // Invert the matrix to get the Apparent to Actual transform
-        if (!MatrixInvert3x3(pAlphaToBeta, pBetaToAlpha))
+        if (!pAlphaToBeta->Invert(*pBetaToAlpha))
         {
             // pAlphaToBeta is singular and therefore is not a true transform
             // and cannot be inverted. This probably means it contains at least
             // one row or column that contains only zeroes
-            gsl_matrix_set_identity(pBetaToAlpha);
+            *pBetaToAlpha = Matrix3x3();
             ASSDEBUG("CalculateTransformMatrices - AlphaToBeta matrix is singular!");
             IDMessage(nullptr,
                       "Calculated Celestial to Telescope transformation matrix is singular (not a true transform).");
         }
 
-        Dump3x3("BetaToAlpha", pBetaToAlpha);
+        Dump3x3("BetaToAlpha", *pBetaToAlpha);
     }
 
     // Clean up
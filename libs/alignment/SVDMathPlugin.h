@@ -32,7 +32,7 @@ class SVDMathPlugin : public BasicMathPlugin
         void CalculateTransformMatrices(const TelescopeDirectionVector &Alpha1, const TelescopeDirectionVector &Alpha2,
                                         const TelescopeDirectionVector &Alpha3, const TelescopeDirectionVector &Beta1,
                                         const TelescopeDirectionVector &Beta2, const TelescopeDirectionVector &Beta3,
-                                        gsl_matrix *pAlphaToBeta, gsl_matrix *pBetaToAlpha);
+                                        Matrix3x3 *pAlphaToBeta, Matrix3x3 *pBetaToAlpha);
 };
 
 } // namespace AlignmentSubsystem
@@ -0,0 +1,129 @@
+/// \file SphericalFaceIndex.cpp
+
+#include "SphericalFaceIndex.h"
+
+#include <algorithm>
+
+namespace INDI
+{
+namespace AlignmentSubsystem
+{
+// Angle between two vectors of any length
+static double AngleBetween(const TelescopeDirectionVector &A, const TelescopeDirectionVector &B)
+{
+    double Lengths = A.Length() * B.Length();
+    if (Lengths == 0)
+        return M_PI;
+    return acos(std::max(-1.0, std::min(1.0, (A ^ B) / Lengths)));
+}
+
+void SphericalFaceIndex::Reset(int FaceCount)
+{
+    Resolution = std::max(1, static_cast<int>(ceil(sqrt(FaceCount / 1.5))));
+    Cells.assign(6 * Resolution * Resolution, Cell());
+
+    for (int CubeFace = 0; CubeFace < 6; CubeFace++)
+        for (int i = 0; i < Resolution; i++)
+            for (int j = 0; j < Resolution; j++)
+            {
+                Cell &C    = Cells[(CubeFace * Resolution + i) * Resolution + j];
+                double U0  = 2.0 * i / Resolution - 1.0;
+                double U1  = 2.0 * (i + 1) / Resolution - 1.0;
+                double V0  = 2.0 * j / Resolution - 1.0;
+                double V1  = 2.0 * (j + 1) / Resolution - 1.0;
+                C.Centre   = CubePoint(CubeFace, (U0 + U1) / 2, (V0 + V1) / 2);
+                C.Centre.Normalise();
+                double Radius = std::max(std::max(AngleBetween(C.Centre, CubePoint(CubeFace, U0, V0)),
+                                                  AngleBetween(C.Centre, CubePoint(CubeFace, U0, V1))),
+                                         std::max(AngleBetween(C.Centre, CubePoint(CubeFace, U1, V0)),
+                                                  AngleBetween(C.Centre, CubePoint(CubeFace, U1, V1))));
+                C.CosRadius = cos(Radius);
+                C.SinRadius = sin(Radius);
+            }
+}
+
+void SphericalFaceIndex::Insert(ConvexHull::tFace Face, const TelescopeDirectionVector &Vertex1,
+                                const TelescopeDirectionVector &Vertex2, const TelescopeDirectionVector &Vertex3)
+{
+    // The rays through a triangle stay inside any circular cone holding its three vertices, as long as
+    // the cone is narrower than a half space. Use the one around the mean of the vertex directions.
+    TelescopeDirectionVector Unit1 = Vertex1, Unit2 = Vertex2, Unit3 = Vertex3;
+    Unit1.Normalise();
+    Unit2.Normalise();
+    Unit3.Normalise();
+    TelescopeDirectionVector Axis(Unit1.x + Unit2.x + Unit3.x, Unit1.y + Unit2.y + Unit3.y,
+                                  Unit1.z + Unit2.z + Unit3.z);
+    double Radius = std::max(AngleBetween(Axis, Unit1), std::max(AngleBetween(Axis, Unit2), AngleBetween(Axis, Unit3)));
+    double CosRadius = cos(Radius), SinRadius = sin(Radius);
+    Axis.Normalise();
+
+    for (auto &C : Cells)
+    {
+        // The cones overlap when the angle between their axes is at most the sum of their radii. A wide
+        // face goes everywhere, the slack covers the rounding of the angles.
+        if (Radius >= M_PI / 2 || (Axis ^ C.Centre) >= CosRadius * C.CosRadius - SinRadius * C.SinRadius - 1e-9)
+            C.Faces.push_back(Face);
+    }
+}
+
+const std::vector<ConvexHull::tFace> &SphericalFaceIndex::Candidates(const TelescopeDirectionVector &Direction) const
+{
+    static const std::vector<ConvexHull::tFace> None;
+
+    if (Cells.empty())
+        return None;
+    return Cells[CellOf(Direction)].Faces;
+}
+
+int SphericalFaceIndex::CellOf(const TelescopeDirectionVector &Direction) const
+{
+    double AbsX = fabs(Direction.x), AbsY = fabs(Direction.y), AbsZ = fabs(Direction.z);
+    int CubeFace;
+    double U, V, Major;
+
+    if (AbsX >= AbsY && AbsX >= AbsZ)
+    {
+        CubeFace = Direction.x >= 0 ? 0 : 1;
+        U        = Direction.y;
+        V        = Direction.z;
+        Major    = AbsX;
+    }
+    else if (AbsY >= AbsZ)
+    {
+        CubeFace = Direction.y >= 0 ? 2 : 3;
+        U        = Direction.x;
+        V        = Direction.z;
+        Major    = AbsY;
+    }
+    else
+    {
+        CubeFace = Direction.z >= 0 ? 4 : 5;
+        U        = Direction.x;
+        V        = Direction.y;
+        Major    = AbsZ;
+    }
+    if (Major == 0)
+        return 0;
+
+    int i = std::min(Resolution - 1, std::max(0, static_cast<int>((U / Major + 1) / 2 * Resolution)));
+    int j = std::min(Resolution - 1, std::max(0, static_cast<int>((V / Major + 1) / 2 * Resolution)));
+    return (CubeFace * Resolution + i) * Resolution + j;
+}
+
+TelescopeDirectionVector SphericalFaceIndex::CubePoint(int CubeFace, double U, double V)
+{
+    double Major = (CubeFace & 1) ? -1.0 : 1.0;
+
+    switch (CubeFace / 2)
+    {
+        case 0:
+            return TelescopeDirectionVector(Major, U, V);
+        case 1:
+            return TelescopeDirectionVector(U, Major, V);
+        default:
+            return TelescopeDirectionVector(U, V, Major);
+    }
+}
+
+} // namespace AlignmentSubsystem
+} // namespace INDI
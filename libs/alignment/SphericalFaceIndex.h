@@ -0,0 +1,66 @@
+/// \file SphericalFaceIndex.h
+///
+/// This file provides a bucket grid over the unit sphere, used to find the
+/// convex hull faces a direction vector may pass through
+
+#pragma once
+
+#include "ConvexHull.h"
+
+#include <vector>
+
+namespace INDI
+{
+namespace AlignmentSubsystem
+{
+/*!
+ * \class SphericalFaceIndex
+ * \brief Buckets the faces of a convex hull around the origin by the directions they cover.
+ *
+ * The sphere is split in the cells of a cube projected on it: six faces of Resolution x Resolution cells.
+ * Each cell lists the hull faces whose bounding cone overlaps its own, so a ray from the origin only
+ * needs testing against the faces listed in the cell of its direction.
+ */
+class SphericalFaceIndex
+{
+    public:
+        /// \brief Clear the index and size its grid for the given number of faces
+        /// \param[in] FaceCount The number of faces expected, to keep a couple of them per cell
+        void Reset(int FaceCount);
+
+        /// \brief Add a face to the cells it may cover
+        /// \param[in] Face The face to add
+        /// \param[in] Vertex1 The first vertex of the face
+        /// \param[in] Vertex2 The second vertex of the face
+        /// \param[in] Vertex3 The third vertex of the face
+        /// \note The faces of a cell are kept in the order they were added.
+        void Insert(ConvexHull::tFace Face, const TelescopeDirectionVector &Vertex1,
+                    const TelescopeDirectionVector &Vertex2, const TelescopeDirectionVector &Vertex3);
+
+        /// \brief Get the faces a ray from the origin may intersect
+        /// \param[in] Direction The direction of the ray, it need not be normalised
+        /// \return The faces added to the cell of the direction
+        const std::vector<ConvexHull::tFace> &Candidates(const TelescopeDirectionVector &Direction) const;
+
+    private:
+        struct Cell
+        {
+            TelescopeDirectionVector Centre;
+            // Cosine and sine of the angle from the centre to the farthest corner
+            double CosRadius;
+            double SinRadius;
+            std::vector<ConvexHull::tFace> Faces;
+        };
+
+        /// \brief Map a direction to the cube face and the cell coordinates of its projection
+        int CellOf(const TelescopeDirectionVector &Direction) const;
+
+        /// \brief The point of the cube at the given face and face coordinates, both in the range -1 to 1
+        static TelescopeDirectionVector CubePoint(int CubeFace, double U, double V);
+
+        int Resolution { 0 };
+        std::vector<Cell> Cells;
+};
+
+} // namespace AlignmentSubsystem
+} // namespace INDI
@@ -20,6 +20,20 @@
 #include "dsp.h"
 #include <time.h>
 
+/* Triangles are indexed by their shape, the ratios of their second and third baselines to the longest one, on a grid of
+   cells holding about DSP_ALIGN_HASH_BUCKET triangles, from DSP_ALIGN_HASH_CELL down to DSP_ALIGN_HASH_MIN_CELL wide:
+   each triangle of the frame is only scored against the reference ones of the neighbouring cells */
+#define DSP_ALIGN_HASH_BUCKET 2
+#define DSP_ALIGN_HASH_CELL 0.01
+#define DSP_ALIGN_HASH_MIN_CELL 0.001
+
+typedef struct {
+    double width;
+    int cells;
+    int* first;
+    int* triangles;
+} dsp_align_hash;
+
 typedef struct {
     double delta;
     double *diff;
@@ -177,6 +191,8 @@ dsp_align_info *dsp_align_fill_info(dsp_triangle t1, dsp_triangle t2)
         }
         align_info->factor[d] /= num_baselines;
     }
+    align_info->triangles[0] = t1;
+    align_info->triangles[1] = t2;
     align_info->score = calc_match_score(t1, t2, *align_info);
     return align_info;
 }
@@ -187,7 +203,7 @@ void dsp_align_free_triangle(dsp_triangle *t)
     free(t->sizes);
     free(t->theta);
     free(t->ratios);
-    for(d = 0; d < t->dims; d++) {
+    for(d = 0; d < t->stars_count; d++) {
         free(t->stars[d].center.location);
     }
     free(t->stars);
@@ -214,6 +230,7 @@ dsp_triangle *dsp_align_calc_triangle(dsp_star* stars, int num_stars)
     for(x = 0; x < triangle->stars_count; x++) {
         for(y = x+1; y < triangle->stars_count; y++) {
             deltadiff[idx].diff = (double*)malloc(sizeof(double)*triangle->dims);
+            deltadiff[idx].delta = 0.0;
             for(d = 0; d < triangle->dims; d++) {
                 deltadiff[idx].diff[d] = stars[x].center.location[d]-stars[y].center.location[d];
                 deltadiff[idx].delta += pow(deltadiff[idx].diff[d], 2);
@@ -256,9 +273,81 @@ dsp_triangle *dsp_align_calc_triangle(dsp_star* stars, int num_stars)
     return triangle;
 }
 
+static int dsp_align_hash_cell(dsp_align_hash* hash, dsp_triangle* t, int axis)
+{
+    int num_baselines = t->stars_count*(t->stars_count-1)/2;
+    if(axis + 1 >= num_baselines)
+        return 0;
+    return Max(0, Min(hash->cells - 1, (int)(t->ratios[axis + 1] / hash->width)));
+}
+
+static void dsp_align_hash_build(dsp_align_hash* hash, dsp_stream_p stream)
+{
+    int t, c;
+    // The second baseline is at least half the longest and the third shorter than the second: shapes cover an eighth of the grid
+    hash->width = sqrt(DSP_ALIGN_HASH_BUCKET / (8.0 * Max(1, stream->triangles_count)));
+    hash->width = Max(DSP_ALIGN_HASH_MIN_CELL, Min(DSP_ALIGN_HASH_CELL, hash->width));
+    hash->cells = (int)(1.0 / hash->width) + 1;
+    hash->first = (int*)calloc((size_t)(hash->cells * hash->cells + 1), sizeof(int));
+    hash->triangles = (int*)malloc(sizeof(int) * (size_t)Max(1, stream->triangles_count));
+    for(t = 0; t < stream->triangles_count; t++) {
+        c = dsp_align_hash_cell(hash, &stream->triangles[t], 0) * hash->cells + dsp_align_hash_cell(hash, &stream->triangles[t], 1);
+        hash->first[c + 1]++;
+    }
+    for(c = 0; c < hash->cells * hash->cells; c++)
+        hash->first[c + 1] += hash->first[c];
+    int* next = (int*)malloc(sizeof(int) * (size_t)(hash->cells * hash->cells));
+    memcpy(next, hash->first, sizeof(int) * (size_t)(hash->cells * hash->cells));
+    for(t = 0; t < stream->triangles_count; t++) {
+        c = dsp_align_hash_cell(hash, &stream->triangles[t], 0) * hash->cells + dsp_align_hash_cell(hash, &stream->triangles[t], 1);
+        hash->triangles[next[c]++] = t;
+    }
+    free(next);
+}
+
+static void dsp_align_hash_free(dsp_align_hash* hash)
+{
+    free(hash->first);
+    free(hash->triangles);
+}
+
+static void dsp_align_match(dsp_stream_p stream1, dsp_stream_p stream2, int t1, int t2)
+{
+    // Score first with the factor alone, the rest of the alignment is only worth filling for a better match
+    dsp_triangle *a = &stream1->triangles[t1];
+    dsp_triangle *b = &stream2->triangles[t2];
+    int num_baselines = a->stars_count*(a->stars_count-1)/2;
+    int d, x;
+    double factor[a->dims];
+    dsp_align_info score_info;
+    score_info.dims = a->dims;
+    score_info.factor = factor;
+    for(d = 0; d < a->dims; d++) {
+        factor[d] = 0;
+        for(x = 0; x < num_baselines; x++)
+            factor[d] += b->sizes[x] / a->sizes[x];
+        factor[d] /= num_baselines;
+    }
+    if(calc_match_score(*a, *b, score_info) >= stream2->align_info.score)
+        return;
+    dsp_align_info *align_info = dsp_align_fill_info(*a, *b);
+    if(align_info->score < stream2->align_info.score) {
+        memcpy(stream2->align_info.center, align_info->center, sizeof(double)*stream2->align_info.dims);
+        memcpy(stream2->align_info.factor, align_info->factor, sizeof(double)*stream2->align_info.dims);
+        memcpy(stream2->align_info.offset, align_info->offset, sizeof(double)*stream2->align_info.dims);
+        memcpy(stream2->align_info.radians, align_info->radians, sizeof(double)*(stream2->align_info.dims-1));
+        memcpy(stream2->align_info.triangles, align_info->triangles, sizeof(dsp_triangle)*2);
+        stream2->align_info.score = align_info->score;
+    }
+    free(align_info->center);
+    free(align_info->factor);
+    free(align_info->offset);
+    free(align_info->radians);
+    free(align_info);
+}
+
 int dsp_align_get_offset(dsp_stream_p stream1, dsp_stream_p stream2, double tolerance, double target_score, int num_stars)
 {
-    dsp_align_info *align_info;
     double decimals = pow(10, tolerance);
     double div = 0.0;
     int d, t1, t2, x, y;
@@ -302,25 +391,27 @@ int dsp_align_get_offset(dsp_stream_p stream1, dsp_stream_p stream2, double tole
     stream2->align_info.factor = (double*)malloc(sizeof(double)*stream2->align_info.dims);
     stream2->align_info.offset = (double*)malloc(sizeof(double)*stream2->align_info.dims);
     stream2->align_info.radians = (double*)malloc(sizeof(double)*(stream2->align_info.dims-1));
-    for(t1 = 0; t1 < stream1->triangles_count; t1++) {
-        for(t2 = 0; t2 < stream2->triangles_count; t2++) {
-            align_info = dsp_align_fill_info(stream1->triangles[t1], stream2->triangles[t2]);
-            if(align_info->score < stream2->align_info.score) {
-                memcpy(stream2->align_info.center, align_info->center, sizeof(double)*stream2->align_info.dims);
-                memcpy(stream2->align_info.factor, align_info->factor, sizeof(double)*stream2->align_info.dims);
-                memcpy(stream2->align_info.offset, align_info->offset, sizeof(double)*stream2->align_info.dims);
-                memcpy(stream2->align_info.radians, align_info->radians, sizeof(double)*(stream2->align_info.dims-1));
-                memcpy(stream2->align_info.triangles, align_info->triangles, sizeof(dsp_triangle)*2);
-                stream2->align_info.score = align_info->score;
-                stream2->align_info.decimals = decimals;
+    dsp_align_hash hash;
+    dsp_align_hash_build(&hash, stream1);
+    int matched = 0;
+    for(t2 = 0; t2 < stream2->triangles_count; t2++) {
+        int c0 = dsp_align_hash_cell(&hash, &stream2->triangles[t2], 0);
+        int c1 = dsp_align_hash_cell(&hash, &stream2->triangles[t2], 1);
+        for(x = Max(0, c0 - 1); x <= Min(hash.cells - 1, c0 + 1); x++) {
+            for(y = Max(0, c1 - 1); y <= Min(hash.cells - 1, c1 + 1); y++) {
+                int c = x * hash.cells + y;
+                for(t1 = hash.first[c]; t1 < hash.first[c + 1]; t1++, matched++)
+                    dsp_align_match(stream1, stream2, hash.triangles[t1], t2);
             }
-            free(align_info->center);
-            free(align_info->factor);
-            free(align_info->offset);
-            free(align_info->radians);
-            free(align_info);
         }
     }
+    dsp_align_hash_free(&hash);
+    // No triangle of similar shape, score them all
+    if(!matched) {
+        for(t1 = 0; t1 < stream1->triangles_count; t1++)
+            for(t2 = 0; t2 < stream2->triangles_count; t2++)
+                dsp_align_match(stream1, stream2, t1, t2);
+    }
     double radians = stream2->align_info.radians[0];
     for(d = 0; d < stream1->dims; d++) {
         phi += pow(stream2->align_info.offset[d], 2);
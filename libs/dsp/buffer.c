@@ -18,6 +18,7 @@
 */
 
 #include "dsp.h"
+#include "simd.h"
 #include <setjmp.h>
 #include <signal.h>
 
@@ -27,19 +28,24 @@ void dsp_buffer_shift(dsp_stream_p stream)
         return;
     dsp_t* tmp = (dsp_t*)malloc(sizeof(dsp_t) * stream->len);
     int x, d;
-    for(x = 0; x < stream->len/2; x++) {
-        int* pos = dsp_stream_get_position(stream, x);
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    int* strides = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_get_strides(stream, strides);
+    dsp_stream_position_at(stream, 0, pos);
+    for(x = 0; x < stream->len/2; x++, dsp_stream_position_next(stream, pos)) {
+        int shifted = 0;
         for(d = 0; d < stream->dims; d++) {
             if(pos[d]<stream->sizes[d] / 2) {
-                pos[d] += stream->sizes[d] / 2;
+                shifted += (pos[d] + stream->sizes[d] / 2) * strides[d];
             } else {
-                pos[d] -= stream->sizes[d] / 2;
+                shifted += (pos[d] - stream->sizes[d] / 2) * strides[d];
             }
         }
-        tmp[x] = stream->buf[dsp_stream_set_position(stream, pos)];
-        tmp[dsp_stream_set_position(stream, pos)] = stream->buf[x];
-        free(pos);
+        tmp[x] = stream->buf[shifted];
+        tmp[shifted] = stream->buf[x];
     }
+    free(strides);
+    free(pos);
     memcpy(stream->buf, tmp, stream->len * sizeof(dsp_t));
     free(tmp);
 }
@@ -58,10 +64,12 @@ void dsp_buffer_sub(dsp_stream_p stream, dsp_t* in, int inlen)
 {
     int len = Min(stream->len, inlen);
 
-	int k;
-	for(k = 0; k < len; k++) {
+    int k;
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        dsp_vec_store(&stream->buf[k], dsp_vec_load(&stream->buf[k]) - dsp_vec_load(&in[k]));
+    for(; k < len; k++) {
         stream->buf[k] = stream->buf[k] - in[k];
-	}
+    }
 
 }
 
@@ -70,7 +78,9 @@ void dsp_buffer_sum(dsp_stream_p stream, dsp_t* in, int inlen)
     int len = Min(stream->len, inlen);
 
     int k;
-    for(k = 0; k < len; k++) {
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        dsp_vec_store(&stream->buf[k], dsp_vec_load(&stream->buf[k]) + dsp_vec_load(&in[k]));
+    for(; k < len; k++) {
         stream->buf[k] += in[k];
     }
 
@@ -81,7 +91,9 @@ void dsp_buffer_max(dsp_stream_p stream, dsp_t* in, int inlen)
     int len = Min(stream->len, inlen);
 
     int k;
-    for(k = 0; k < len; k++) {
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        dsp_vec_store(&stream->buf[k], dsp_vec_max(dsp_vec_load(&stream->buf[k]), dsp_vec_load(&in[k])));
+    for(; k < len; k++) {
         stream->buf[k] = Max(stream->buf[k], in[k]);
     }
 
@@ -92,7 +104,9 @@ void dsp_buffer_min(dsp_stream_p stream, dsp_t* in, int inlen)
     int len = Min(stream->len, inlen);
 
     int k;
-    for(k = 0; k < len; k++) {
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        dsp_vec_store(&stream->buf[k], dsp_vec_min(dsp_vec_load(&stream->buf[k]), dsp_vec_load(&in[k])));
+    for(; k < len; k++) {
         stream->buf[k] = Min(stream->buf[k], in[k]);
     }
 
@@ -102,10 +116,12 @@ void dsp_buffer_div(dsp_stream_p stream, dsp_t* in, int inlen)
 {
     int len = Min(stream->len, inlen);
 
-	int k;
-	for(k = 0; k < len; k++) {
+    int k;
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        dsp_vec_store(&stream->buf[k], dsp_vec_load(&stream->buf[k]) / dsp_vec_load(&in[k]));
+    for(; k < len; k++) {
         stream->buf[k] = stream->buf[k] / in[k];
-	}
+    }
 
 }
 
@@ -114,7 +130,9 @@ void dsp_buffer_mul(dsp_stream_p stream, dsp_t* in, int inlen)
     int len = Min(stream->len, inlen);
 
     int k;
-    for(k = 0; k < len; k++) {
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        dsp_vec_store(&stream->buf[k], dsp_vec_load(&stream->buf[k]) * dsp_vec_load(&in[k]));
+    for(; k < len; k++) {
         stream->buf[k] = stream->buf[k] * in[k];
     }
 
@@ -222,166 +240,360 @@ void dsp_buffer_log1(dsp_stream_p stream, double val)
 
 }
 
-static int compare( const void* a, const void* b)
+/* Integer valued streams up to that range get their windows counted in a bin per value, and in coarse bins of 256 */
+#define DSP_FILTER_RANGE 65536
+/* Windows of up to that many elements are sorted by a network, on DSP_VEC_LANES elements at once; larger ones of
+   integer data are filtered from histograms */
+#define DSP_FILTER_NETWORK_LEN 64
+/* Indexes of the tiles of the histogram filters, so that filling the first window of each tile stays negligible */
+#define DSP_FILTER_HISTOGRAM_GRAIN 65536
+
+typedef struct {
+    int size;
+    int median;
+    dsp_stream_p stream;
+    /* Offsets of the runs of the window along the first dimension, from the first element of each */
+    int runs;
+    int* offsets;
+    /* Elements with all of their window within the stream */
+    int first;
+    int last;
+    /* Base and range of the elements, when they are all integers with a range up to DSP_FILTER_RANGE */
+    dsp_t base;
+    int range;
+    /* Compare-exchanges sorting the small windows, in pairs of indexes */
+    int exchanges;
+    int* network;
+} dsp_buffer_filter_args;
+
+typedef struct {
+    int* fine;
+    int* coarse;
+    long long* fine_sum;
+    long long* coarse_sum;
+    int count;
+    long long sum;
+} dsp_buffer_filter_histogram;
+
+static void dsp_buffer_filter_setup(dsp_buffer_filter_args* arguments, dsp_stream_p in, int size)
+{
+    int d, j, k;
+    int* strides = (int*)malloc(sizeof(int) * in->dims);
+    dsp_stream_get_strides(in, strides);
+    arguments->size = size;
+    arguments->runs = 1;
+    for(d = 1; d < in->dims; d++)
+        arguments->runs *= size;
+    arguments->offsets = (int*)malloc(sizeof(int) * arguments->runs);
+    for(j = 0; j < arguments->runs; j++) {
+        int run = j;
+        arguments->offsets[j] = -(size / 2);
+        for(d = 1; d < in->dims; d++) {
+            arguments->offsets[j] += (run % size - size / 2) * strides[d];
+            run /= size;
+        }
+    }
+    int span = 0;
+    for(d = 0; d < in->dims; d++)
+        span += strides[d];
+    arguments->first = (size / 2) * span;
+    arguments->last = in->len - (size - 1 - size / 2) * span;
+    free(strides);
+    /* Batcher's odd-even merge sort of the next power of two, without the exchanges past the window which,
+       padding it with the greatest values, would never move them */
+    int len = arguments->runs * size;
+    arguments->exchanges = 0;
+    arguments->network = NULL;
+    if(len <= DSP_FILTER_NETWORK_LEN) {
+        int n = 1, p, i;
+        while(n < len)
+            n <<= 1;
+        arguments->network = (int*)malloc(sizeof(int) * (size_t)n * (size_t)n);
+        for(p = 1; p < n; p <<= 1) {
+            for(k = p; k >= 1; k >>= 1) {
+                for(j = k % p; j + k < n; j += 2 * k) {
+                    for(i = 0; i < k && i + j + k < n; i++) {
+                        if((i + j) / (p * 2) == (i + j + k) / (p * 2) && i + j + k < len) {
+                            arguments->network[arguments->exchanges * 2] = i + j;
+                            arguments->network[arguments->exchanges * 2 + 1] = i + j + k;
+                            arguments->exchanges++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    arguments->range = 0;
+    arguments->base = 0;
+    if(in->len < 1)
+        return;
+    dsp_t mn = dsp_stats_min(in->buf, in->len);
+    dsp_t mx = dsp_stats_max(in->buf, in->len);
+    if(mx - mn >= DSP_FILTER_RANGE)
+        return;
+    for(k = 0; k < in->len; k++)
+        if(in->buf[k] != floor(in->buf[k]))
+            return;
+    arguments->base = mn;
+    arguments->range = (int)(mx - mn) + 1;
+}
+
+/* Collects the elements of the window of x within the stream, in the order of the positions of the window */
+static int dsp_buffer_filter_window(dsp_buffer_filter_args* arguments, dsp_stream_p in, int x, dsp_t* window)
+{
+    int j, k, count = 0;
+    for(j = 0; j < arguments->runs; j++) {
+        int idx = x + arguments->offsets[j];
+        for(k = 0; k < arguments->size; k++, idx++) {
+            if(idx >= 0 && idx < in->len)
+                window[count++] = in->buf[idx];
+        }
+    }
+    return count;
+}
+
+static void dsp_buffer_filter_histogram_init(dsp_buffer_filter_histogram* h, int range, int sums)
+{
+    h->fine = (int*)calloc((size_t)range, sizeof(int));
+    h->coarse = (int*)calloc((size_t)(range >> 8) + 1, sizeof(int));
+    h->fine_sum = sums ? (long long*)calloc((size_t)range, sizeof(long long)) : NULL;
+    h->coarse_sum = sums ? (long long*)calloc((size_t)(range >> 8) + 1, sizeof(long long)) : NULL;
+    h->count = 0;
+    h->sum = 0;
+}
+
+static void dsp_buffer_filter_histogram_free(dsp_buffer_filter_histogram* h)
+{
+    free(h->fine);
+    free(h->coarse);
+    free(h->fine_sum);
+    free(h->coarse_sum);
+}
+
+static inline void dsp_buffer_filter_histogram_add(dsp_buffer_filter_histogram* h, int v, int n)
+{
+    h->fine[v] += n;
+    h->coarse[v >> 8] += n;
+    h->count += n;
+    h->sum += (long long)v * n;
+    if(h->fine_sum != NULL) {
+        h->fine_sum[v] += (long long)v * n;
+        h->coarse_sum[v >> 8] += (long long)v * n;
+    }
+}
+
+/* Fills the histogram with the window of x, or slides it from the window of x - 1 */
+static void dsp_buffer_filter_histogram_update(dsp_buffer_filter_args* arguments, dsp_buffer_filter_histogram* h,
+                                               dsp_stream_p in, int x, int slide)
+{
+    int j, k;
+    int size = arguments->size;
+    for(j = 0; j < arguments->runs; j++) {
+        dsp_t* run = &in->buf[x + arguments->offsets[j]];
+        if(slide) {
+            dsp_buffer_filter_histogram_add(h, (int)(run[-1] - arguments->base), -1);
+            dsp_buffer_filter_histogram_add(h, (int)(run[size - 1] - arguments->base), 1);
+        } else {
+            for(k = 0; k < size; k++)
+                dsp_buffer_filter_histogram_add(h, (int)(run[k] - arguments->base), 1);
+        }
+    }
+}
+
+/* Value of the given rank, the elements below the rank as in a sorted window */
+static int dsp_buffer_filter_histogram_rank(dsp_buffer_filter_histogram* h, int rank)
+{
+    int c = 0, v;
+    while(rank >= h->coarse[c])
+        rank -= h->coarse[c++];
+    for(v = c << 8; rank >= h->fine[v]; v++)
+        rank -= h->fine[v];
+    return v;
+}
+
+/* Count and sum of the elements below value */
+static void dsp_buffer_filter_histogram_below(dsp_buffer_filter_histogram* h, int value, int* count, long long* sum)
 {
-     dsp_t int_a = * ( (dsp_t*) a );
-     dsp_t int_b = * ( (dsp_t*) b );
+    int c, v;
+    *count = 0;
+    *sum = 0;
+    for(c = 0; c < value >> 8; c++) {
+        *count += h->coarse[c];
+        *sum += h->coarse_sum[c];
+    }
+    for(v = c << 8; v < value; v++) {
+        *count += h->fine[v];
+        *sum += h->fine_sum[v];
+    }
+}
+
+/* Sorts the windows of x to x + DSP_VEC_LANES - 1, all within the stream, one per lane */
+static void dsp_buffer_filter_network(dsp_buffer_filter_args* arguments, dsp_stream_p in, int x, dsp_vec_t* window)
+{
+    int j, k, e = 0;
+    for(j = 0; j < arguments->runs; j++) {
+        dsp_t* run = &in->buf[x + arguments->offsets[j]];
+        for(k = 0; k < arguments->size; k++)
+            window[e++] = dsp_vec_load(&run[k]);
+    }
+    for(k = 0; k < arguments->exchanges; k++) {
+        dsp_vec_t a = window[arguments->network[k * 2]];
+        dsp_vec_t b = window[arguments->network[k * 2 + 1]];
+        window[arguments->network[k * 2]] = dsp_vec_min(a, b);
+        window[arguments->network[k * 2 + 1]] = dsp_vec_max(a, b);
+    }
+}
 
-     if ( int_a == int_b ) return 0;
-     else if ( int_a < int_b ) return -1;
-     else return 1;
+dsp_t dsp_buffer_select(dsp_t* window, int len, int k)
+{
+    int lo = 0, hi = len - 1;
+    while(lo < hi) {
+        dsp_t pivot = window[(lo + hi) / 2];
+        int i = lo, j = hi;
+        while(i <= j) {
+            while(window[i] < pivot) i++;
+            while(window[j] > pivot) j--;
+            if(i <= j) {
+                dsp_t t = window[i];
+                window[i++] = window[j];
+                window[j--] = t;
+            }
+        }
+        if(k <= j)
+            hi = j;
+        else if(k >= i)
+            lo = i;
+        else
+            break;
+    }
+    return window[k];
 }
 
-static void* dsp_buffer_median_th(void* arg)
+static void dsp_buffer_median_tile(void* arg, int start, int end)
 {
-    struct {
-        int cur_th;
-        int size;
-        int median;
-        dsp_stream_p stream;
-        dsp_stream_p box;
-     } *arguments = arg;
+    dsp_buffer_filter_args *arguments = arg;
     dsp_stream_p stream = arguments->stream;
-    dsp_stream_p box = arguments->box;
     dsp_stream_p in = stream->parent;
-    int cur_th = arguments->cur_th;
     int size = arguments->size;
     int median = arguments->median;
-    int start = cur_th * stream->len / dsp_max_threads(0);
-    int end = start + stream->len / dsp_max_threads(0);
-    end = Min(stream->len, end);
-    int x, y, dim, idx;
-    dsp_t* sorted = (dsp_t*)malloc(pow(size, stream->dims) * sizeof(dsp_t));
-    int len = pow(size, in->dims);
+    int len = arguments->runs * size;
+    int histogram = arguments->range > 0 && len > DSP_FILTER_NETWORK_LEN;
+    int filled = 0;
+    int x;
+    dsp_buffer_filter_histogram h;
+    if(histogram)
+        dsp_buffer_filter_histogram_init(&h, arguments->range, 0);
+    dsp_t* window = (dsp_t*)malloc(sizeof(dsp_t) * len);
+    dsp_vec_t lanes[DSP_FILTER_NETWORK_LEN];
     for(x = start; x < end; x++) {
-        dsp_t* buf = sorted;
-        for(y = 0; y < box->len; y++) {
-            int *pos = dsp_stream_get_position(stream, x);
-            int *mat = dsp_stream_get_position(box, y);
-            for(dim = 0; dim < stream->dims; dim++) {
-                pos[dim] += mat[dim] - size / 2;
-            }
-            idx = dsp_stream_set_position(stream, pos);
-            if(idx >= 0 && idx < in->len) {
-                *buf++ = in->buf[idx];
-            }
-            free(pos);
-            free(mat);
+        int rank = Min(median * len / size, len - 1);
+        if(arguments->network != NULL && x >= arguments->first && x + DSP_VEC_LANES <= Min(arguments->last, end)) {
+            dsp_buffer_filter_network(arguments, in, x, lanes);
+            dsp_vec_store(&stream->buf[x], lanes[rank]);
+            x += DSP_VEC_LANES - 1;
+        } else if(histogram && x >= arguments->first && x < arguments->last) {
+            dsp_buffer_filter_histogram_update(arguments, &h, in, x, filled);
+            filled = 1;
+            stream->buf[x] = arguments->base + dsp_buffer_filter_histogram_rank(&h, rank);
+        } else {
+            int count = dsp_buffer_filter_window(arguments, in, x, window);
+            rank = Min(median * count / size, count - 1);
+            stream->buf[x] = dsp_buffer_select(window, count, rank);
         }
-        qsort(sorted, len, sizeof(dsp_t), compare);
-        stream->buf[x] = sorted[median*box->len/size];
     }
-    dsp_stream_free_buffer(box);
-    dsp_stream_free(box);
-    free(sorted);
-    return NULL;
+    free(window);
+    if(histogram)
+        dsp_buffer_filter_histogram_free(&h);
 }
 
 void dsp_buffer_median(dsp_stream_p in, int size, int median)
 {
-    size_t y;
-    int d;
     dsp_stream_p stream = dsp_stream_copy(in);
     dsp_buffer_set(stream->buf, stream->len, 0);
     stream->parent = in;
-    pthread_t *th = (pthread_t *)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       int size;
-       int median;
-       dsp_stream_p stream;
-       dsp_stream_p box;
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++)
-    {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].size = size;
-        thread_arguments[y].median = median;
-        thread_arguments[y].stream = stream;
-        thread_arguments[y].box = dsp_stream_new();
-        for(d = 0; d < stream->dims; d++)
-            dsp_stream_add_dim(thread_arguments[y].box, size);
-        dsp_stream_alloc_buffer(thread_arguments[y].box, thread_arguments[y].box->len);
-        pthread_create(&th[y], NULL, dsp_buffer_median_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_buffer_filter_args arguments;
+    dsp_buffer_filter_setup(&arguments, in, size);
+    arguments.median = median;
+    arguments.stream = stream;
+    int histogram = arguments.range > 0 && arguments.runs * size > DSP_FILTER_NETWORK_LEN;
+    dsp_parallel_for(stream->len, histogram ? DSP_FILTER_HISTOGRAM_GRAIN : 0, dsp_buffer_median_tile, &arguments);
+    free(arguments.offsets);
+    free(arguments.network);
     stream->parent = NULL;
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
 }
 
-static void* dsp_buffer_sigma_th(void* arg)
+/* Deviations of the windows of x to x + DSP_VEC_LANES - 1, all within the stream, one per lane */
+static void dsp_buffer_sigma_lanes(dsp_buffer_filter_args* arguments, dsp_stream_p in, int x, dsp_t* out)
+{
+    int j, k;
+    dsp_t len = arguments->runs * arguments->size;
+    dsp_vec_t mean = {0}, deviation = {0};
+    for(j = 0; j < arguments->runs; j++)
+        for(k = 0; k < arguments->size; k++)
+            mean += dsp_vec_load(&in->buf[x + arguments->offsets[j] + k]);
+    mean /= len;
+    for(j = 0; j < arguments->runs; j++) {
+        for(k = 0; k < arguments->size; k++) {
+            dsp_vec_t d = dsp_vec_load(&in->buf[x + arguments->offsets[j] + k]) - mean;
+            deviation += dsp_vec_max(d, -d);
+        }
+    }
+    dsp_vec_store(out, deviation / len);
+}
+
+static void dsp_buffer_sigma_tile(void* arg, int start, int end)
 {
-    struct {
-        int cur_th;
-        int size;
-        dsp_stream_p stream;
-        dsp_stream_p box;
-     } *arguments = arg;
+    dsp_buffer_filter_args *arguments = arg;
     dsp_stream_p stream = arguments->stream;
     dsp_stream_p in = stream->parent;
-    dsp_stream_p box = arguments->box;
-    int cur_th = arguments->cur_th;
-    int size = arguments->size;
-    int start = cur_th * stream->len / dsp_max_threads(0);
-    int end = start + stream->len / dsp_max_threads(0);
-    end = Min(stream->len, end);
-    int x, y, dim, idx;
-    dsp_t* sigma = (dsp_t*)malloc(pow(size, stream->dims) * sizeof(dsp_t));
-    int len = pow(size, in->dims);
+    int len = arguments->runs * arguments->size;
+    int histogram = arguments->range > 0 && len > DSP_FILTER_NETWORK_LEN;
+    int filled = 0;
+    int x;
+    dsp_buffer_filter_histogram h;
+    if(histogram)
+        dsp_buffer_filter_histogram_init(&h, arguments->range, 1);
+    dsp_t* window = (dsp_t*)malloc(sizeof(dsp_t) * len);
     for(x = start; x < end; x++) {
-        dsp_t* buf = sigma;
-        for(y = 0; y < box->len; y++) {
-            int *pos = dsp_stream_get_position(stream, x);
-            int *mat = dsp_stream_get_position(box, y);
-            for(dim = 0; dim < stream->dims; dim++) {
-                pos[dim] += mat[dim] - size / 2;
-            }
-            idx = dsp_stream_set_position(stream, pos);
-            if(idx >= 0 && idx < in->len) {
-                buf[y] = in->buf[idx];
-            }
-            free(pos);
-            free(mat);
+        if(len <= DSP_FILTER_NETWORK_LEN && x >= arguments->first && x + DSP_VEC_LANES <= Min(arguments->last, end)) {
+            dsp_buffer_sigma_lanes(arguments, in, x, &stream->buf[x]);
+            x += DSP_VEC_LANES - 1;
+        } else if(histogram && x >= arguments->first && x < arguments->last) {
+            /* Sum of the deviations from the mean m: m * (below - above) - sum below + sum above */
+            dsp_buffer_filter_histogram_update(arguments, &h, in, x, filled);
+            filled = 1;
+            double mean = (double)h.sum / h.count;
+            int below;
+            long long sum_below;
+            dsp_buffer_filter_histogram_below(&h, (int)ceil(mean), &below, &sum_below);
+            double deviation = mean * (2 * below - h.count) - 2.0 * sum_below + h.sum;
+            stream->buf[x] = deviation / h.count;
+        } else {
+            int count = dsp_buffer_filter_window(arguments, in, x, window);
+            stream->buf[x] = dsp_stats_stddev(window, count);
         }
-        stream->buf[x] = dsp_stats_stddev(buf, len);
     }
-    dsp_stream_free_buffer(box);
-    dsp_stream_free(box);
-    free(sigma);
-    return NULL;
+    free(window);
+    if(histogram)
+        dsp_buffer_filter_histogram_free(&h);
 }
 
 void dsp_buffer_sigma(dsp_stream_p in, int size)
 {
-    size_t y;
-    int d;
     dsp_stream_p stream = dsp_stream_copy(in);
     dsp_buffer_set(stream->buf, stream->len, 0);
     stream->parent = in;
-    pthread_t *th = (pthread_t *)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       int size;
-       dsp_stream_p stream;
-       dsp_stream_p box;
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++)
-    {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].size = size;
-        thread_arguments[y].stream = stream;
-        thread_arguments[y].box = dsp_stream_new();
-        for(d = 0; d < stream->dims; d++)
-            dsp_stream_add_dim(thread_arguments[y].box, size);
-        pthread_create(&th[y], NULL, dsp_buffer_sigma_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_buffer_filter_args arguments;
+    dsp_buffer_filter_setup(&arguments, in, size);
+    arguments.median = 0;
+    arguments.stream = stream;
+    int histogram = arguments.range > 0 && arguments.runs * size > DSP_FILTER_NETWORK_LEN;
+    dsp_parallel_for(stream->len, histogram ? DSP_FILTER_HISTOGRAM_GRAIN : 0, dsp_buffer_sigma_tile, &arguments);
+    free(arguments.offsets);
+    free(arguments.network);
     stream->parent = NULL;
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
@@ -397,3 +609,68 @@ void dsp_buffer_deviate(dsp_stream_p stream, dsp_t* deviation, dsp_t mindeviatio
     }
     dsp_stream_free(tmp);
 }
+
+static void dsp_simd_stretch_range(dsp_t* buf, int len, dsp_t in_mn, dsp_t in_mx, dsp_t mn, dsp_t mx)
+{
+    dsp_t oratio = (mx - mn);
+    dsp_t iratio = (in_mx - in_mn);
+    if(iratio == 0) iratio = 1;
+    int k;
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        dsp_vec_store(&buf[k], (dsp_vec_load(&buf[k]) - in_mn) * oratio / iratio + mn);
+    for(; k < len; k++) {
+        buf[k] -= in_mn;
+        buf[k] = buf[k] * oratio / iratio;
+        buf[k] += mn;
+    }
+}
+
+void dsp_simd_stretch(dsp_t* buf, int len, dsp_t mn, dsp_t mx)
+{
+    dsp_simd_stretch_range(buf, len, dsp_simd_min(buf, len), dsp_simd_max(buf, len), mn, mx);
+}
+
+void dsp_buffer_calibrate(dsp_stream_p stream, dsp_t* bias, dsp_t* dark, dsp_t* flat, dsp_t mn, dsp_t mx)
+{
+    dsp_t* buf = stream->buf;
+    int len = stream->len;
+    if(len < 1)
+        return;
+    dsp_vec_t lo = {0}, hi = {0};
+    int k;
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES) {
+        dsp_vec_t v = dsp_vec_load(&buf[k]);
+        if(bias != NULL)
+            v = v - dsp_vec_load(&bias[k]);
+        if(dark != NULL)
+            v = v - dsp_vec_load(&dark[k]);
+        if(flat != NULL)
+            v = v / dsp_vec_load(&flat[k]);
+        dsp_vec_store(&buf[k], v);
+        lo = k > 0 ? dsp_vec_min(v, lo) : v;
+        hi = k > 0 ? dsp_vec_max(v, hi) : v;
+    }
+    int vectors = k;
+    for(; k < len; k++) {
+        if(bias != NULL)
+            buf[k] = buf[k] - bias[k];
+        if(dark != NULL)
+            buf[k] = buf[k] - dark[k];
+        if(flat != NULL)
+            buf[k] = buf[k] / flat[k];
+    }
+    if(mn >= mx)
+        return;
+    dsp_t in_mn = buf[0];
+    dsp_t in_mx = buf[0];
+    int i;
+    for(i = 0; i < DSP_VEC_LANES && vectors > 0; i++) {
+        in_mn = Min(lo[i], in_mn);
+        in_mx = Max(hi[i], in_mx);
+    }
+    for(i = vectors; i < len; i++) {
+        in_mn = Min(buf[i], in_mn);
+        in_mx = Max(buf[i], in_mx);
+    }
+    dsp_simd_stretch_range(buf, len, in_mn, in_mx, mn, mx);
+}
@@ -18,23 +18,28 @@
 */
 
 #include "dsp.h"
+#include "simd.h"
 
 void dsp_convolution_convolution(dsp_stream_p stream, dsp_stream_p matrix) {
     int x, y, d;
     dsp_t mn = dsp_stats_min(stream->buf, stream->len);
     dsp_t mx = dsp_stats_max(stream->buf, stream->len);
-    int* d_pos = (int*)malloc(sizeof(int)*stream->dims);
-    for(y = 0; y < matrix->len; y++) {
-        int* pos = dsp_stream_get_position(matrix, y);
-        for(d = 0; d < stream->dims; d++) {
-            d_pos[d] = stream->sizes[d]/2+pos[d]-matrix->sizes[d]/2;
-        }
-        x = dsp_stream_set_position(stream, d_pos);
-        free(pos);
+    int* pos = (int*)malloc(sizeof(int)*matrix->dims);
+    int* strides = (int*)malloc(sizeof(int)*stream->dims);
+    int offset = 0;
+    dsp_stream_get_strides(stream, strides);
+    for(d = 0; d < stream->dims; d++)
+        offset += (stream->sizes[d]/2-matrix->sizes[d]/2)*strides[d];
+    dsp_stream_position_at(matrix, 0, pos);
+    for(y = 0; y < matrix->len; y++, dsp_stream_position_next(matrix, pos)) {
+        x = offset;
+        for(d = 0; d < stream->dims; d++)
+            x += pos[d]*strides[d];
         if(x >= 0 && x < stream->magnitude->len)
             stream->magnitude->buf[x] *= sqrt(matrix->magnitude->buf[y]);
     }
-    free(d_pos);
+    free(strides);
+    free(pos);
     dsp_fourier_idft(stream);
     dsp_buffer_stretch(stream->buf, stream->len, mn, mx);
 }
@@ -43,19 +48,206 @@ void dsp_convolution_correlation(dsp_stream_p stream, dsp_stream_p matrix) {
     int x, y, d;
     dsp_t mn = dsp_stats_min(stream->buf, stream->len);
     dsp_t mx = dsp_stats_max(stream->buf, stream->len);
-    int* d_pos = (int*)malloc(sizeof(int)*stream->dims);
     dsp_buffer_shift(matrix->magnitude);
-    for(y = 0; y < matrix->len; y++) {
-        int* pos = dsp_stream_get_position(matrix, y);
-        for(d = 0; d < stream->dims; d++) {
-            d_pos[d] = stream->sizes[d]/2+pos[d]-matrix->sizes[d]/2;
-        }
-        x = dsp_stream_set_position(stream, d_pos);
-        free(pos);
-        stream->magnitude->buf[x] *= sqrt(matrix->magnitude->buf[y]);
+    int* pos = (int*)malloc(sizeof(int)*matrix->dims);
+    int* strides = (int*)malloc(sizeof(int)*stream->dims);
+    int offset = 0;
+    dsp_stream_get_strides(stream, strides);
+    for(d = 0; d < stream->dims; d++)
+        offset += (stream->sizes[d]/2-matrix->sizes[d]/2)*strides[d];
+    dsp_stream_position_at(matrix, 0, pos);
+    for(y = 0; y < matrix->len; y++, dsp_stream_position_next(matrix, pos)) {
+        x = offset;
+        for(d = 0; d < stream->dims; d++)
+            x += pos[d]*strides[d];
+        if(x >= 0 && x < stream->magnitude->len)
+            stream->magnitude->buf[x] *= sqrt(matrix->magnitude->buf[y]);
     }
+    free(strides);
+    free(pos);
     dsp_buffer_shift(matrix->magnitude);
-    free(d_pos);
     dsp_fourier_idft(stream);
     dsp_buffer_stretch(stream->buf, stream->len, mn, mx);
 }
+
+/* Spans of the separable passes along the outer dimensions, split among the threads */
+#define DSP_CONVOLUTION_CHUNK 4096
+
+typedef struct {
+    dsp_stream_p stream;
+    dsp_stream_p matrix;
+    dsp_t* in;
+    dsp_t* out;
+    dsp_t* weights;
+    int size;
+    int len;
+    int stride;
+    int chunks;
+} dsp_convolution_args;
+
+static void dsp_convolution_axpy(dsp_t* out, dsp_t* in, int len, dsp_t weight) {
+    int x;
+    for(x = 0; x + DSP_VEC_LANES <= len; x += DSP_VEC_LANES)
+        dsp_vec_store(&out[x], dsp_vec_load(&out[x]) + dsp_vec_load(&in[x]) * weight);
+    for(; x < len; x++)
+        out[x] += in[x] * weight;
+}
+
+/* Each row of the output adds the rows of the input under each element of the matrix, shifted by its offset */
+static void dsp_convolution_direct_rows(void* arg, int start, int end) {
+    dsp_convolution_args* arguments = arg;
+    dsp_stream_p stream = arguments->stream;
+    dsp_stream_p matrix = arguments->matrix;
+    int width = stream->sizes[0];
+    int* strides = (int*)malloc(sizeof(int)*stream->dims);
+    int* row = (int*)malloc(sizeof(int)*stream->dims);
+    int* pos = (int*)malloc(sizeof(int)*matrix->dims);
+    int r, q, d;
+    dsp_stream_get_strides(stream, strides);
+    for(r = start; r < end; r++) {
+        int index = r;
+        for(d = 1; d < stream->dims; d++) {
+            row[d] = index % stream->sizes[d];
+            index /= stream->sizes[d];
+        }
+        dsp_t* out = &arguments->out[r*width];
+        memset(out, 0, sizeof(dsp_t)*width);
+        dsp_stream_position_at(matrix, 0, pos);
+        for(q = 0; q < matrix->len; q++, dsp_stream_position_next(matrix, pos)) {
+            dsp_t weight = matrix->buf[q];
+            int offset = 0, inside = 1;
+            if(weight == 0)
+                continue;
+            for(d = 1; d < stream->dims && inside; d++) {
+                int coord = row[d] + matrix->sizes[d]/2 - pos[d];
+                inside = coord >= 0 && coord < stream->sizes[d];
+                offset += coord*strides[d];
+            }
+            int shift = matrix->sizes[0]/2 - pos[0];
+            int x0 = Max(0, -shift);
+            int x1 = Min(width, width - shift);
+            if(inside && x1 > x0)
+                dsp_convolution_axpy(&out[x0], &stream->buf[offset + x0 + shift], x1 - x0, weight);
+        }
+    }
+    free(pos);
+    free(row);
+    free(strides);
+}
+
+/* One pass of a separable matrix along one dimension: whole lines when it is the innermost one, chunks of the outer spans otherwise */
+static void dsp_convolution_separable_pass(void* arg, int start, int end) {
+    dsp_convolution_args* arguments = arg;
+    int size = arguments->size;
+    int stride = arguments->stride;
+    int chunk = (stride + arguments->chunks - 1) / arguments->chunks;
+    int item, a, i;
+    for(item = start; item < end; item++) {
+        int base = (item / arguments->chunks) * size * stride;
+        int c0 = (item % arguments->chunks) * chunk;
+        int c1 = Min(stride, c0 + chunk);
+        if(stride == 1) {
+            memset(&arguments->out[base], 0, sizeof(dsp_t)*size);
+            for(i = 0; i < arguments->len; i++) {
+                int shift = arguments->len/2 - i;
+                int a0 = Max(0, -shift);
+                int a1 = Min(size, size - shift);
+                if(a1 > a0)
+                    dsp_convolution_axpy(&arguments->out[base + a0], &arguments->in[base + a0 + shift], a1 - a0, arguments->weights[i]);
+            }
+            continue;
+        }
+        for(a = 0; a < size; a++) {
+            dsp_t* out = &arguments->out[base + a*stride + c0];
+            memset(out, 0, sizeof(dsp_t)*(c1 - c0));
+            for(i = 0; i < arguments->len; i++) {
+                int src = a + arguments->len/2 - i;
+                if(src >= 0 && src < size)
+                    dsp_convolution_axpy(out, &arguments->in[base + src*stride + c0], c1 - c0, arguments->weights[i]);
+            }
+        }
+    }
+}
+
+/* A matrix is separable when it is the product of the lines through its largest element, these become the weights of each pass */
+static int dsp_convolution_separate(dsp_stream_p matrix, dsp_t** weights) {
+    int q, d, i, peak = 0;
+    for(q = 1; q < matrix->len; q++)
+        if(fabs(matrix->buf[q]) > fabs(matrix->buf[peak]))
+            peak = q;
+    if(matrix->buf[peak] == 0)
+        return 0;
+    int* strides = (int*)malloc(sizeof(int)*matrix->dims);
+    int* center = (int*)malloc(sizeof(int)*matrix->dims);
+    int* pos = (int*)malloc(sizeof(int)*matrix->dims);
+    dsp_stream_get_strides(matrix, strides);
+    dsp_stream_position_at(matrix, peak, center);
+    for(d = 0; d < matrix->dims; d++)
+        for(i = 0; i < matrix->sizes[d]; i++)
+            weights[d][i] = matrix->buf[peak + (i - center[d])*strides[d]] / (d > 0 ? matrix->buf[peak] : 1);
+    int separable = 1;
+    dsp_stream_position_at(matrix, 0, pos);
+    for(q = 0; q < matrix->len && separable; q++, dsp_stream_position_next(matrix, pos)) {
+        double product = 1;
+        for(d = 0; d < matrix->dims; d++)
+            product *= weights[d][pos[d]];
+        separable = fabs(product - matrix->buf[q]) <= fabs(matrix->buf[peak]) * 1e-5;
+    }
+    free(pos);
+    free(center);
+    free(strides);
+    return separable;
+}
+
+void dsp_convolution_filter(dsp_stream_p stream, dsp_stream_p matrix) {
+    int d;
+    if(stream->dims < 1 || matrix->dims != stream->dims || stream->len < 1)
+        return;
+    dsp_convolution_args arguments;
+    arguments.stream = stream;
+    arguments.matrix = matrix;
+    dsp_t** weights = (dsp_t**)malloc(sizeof(dsp_t*)*matrix->dims);
+    for(d = 0; d < matrix->dims; d++)
+        weights[d] = (dsp_t*)malloc(sizeof(dsp_t)*matrix->sizes[d]);
+    if(matrix->dims > 1 && dsp_convolution_separate(matrix, weights)) {
+        int* strides = (int*)malloc(sizeof(int)*stream->dims);
+        dsp_t* tmp = (dsp_t*)malloc(sizeof(dsp_t)*stream->len);
+        dsp_stream_get_strides(stream, strides);
+        arguments.in = stream->buf;
+        arguments.out = tmp;
+        for(d = 0; d < stream->dims; d++) {
+            arguments.weights = weights[d];
+            arguments.len = matrix->sizes[d];
+            arguments.size = stream->sizes[d];
+            arguments.stride = strides[d];
+            arguments.chunks = (arguments.stride + DSP_CONVOLUTION_CHUNK - 1) / DSP_CONVOLUTION_CHUNK;
+            dsp_parallel_for(stream->len / (arguments.size * arguments.stride) * arguments.chunks, 1, dsp_convolution_separable_pass, &arguments);
+            dsp_t* swap = arguments.in;
+            arguments.in = arguments.out;
+            arguments.out = swap;
+        }
+        if(arguments.in != stream->buf)
+            memcpy(stream->buf, arguments.in, sizeof(dsp_t)*stream->len);
+        free(tmp);
+        free(strides);
+    } else {
+        /* Multiply-adds for each element, directly or with the transforms of the tiles and the spectrum product */
+        double tile = 1, overlap = 1;
+        for(d = 0; d < stream->dims; d++) {
+            int size = dsp_fourier_convolution_tile(stream->sizes[d], matrix->sizes[d]);
+            tile *= size;
+            overlap *= (double)size / (size - matrix->sizes[d] + 1);
+        }
+        if(matrix->len <= overlap * (5 * log2(tile) + 4)) {
+            arguments.out = (dsp_t*)malloc(sizeof(dsp_t)*stream->len);
+            dsp_parallel_for(stream->len / stream->sizes[0], 1, dsp_convolution_direct_rows, &arguments);
+            memcpy(stream->buf, arguments.out, sizeof(dsp_t)*stream->len);
+            free(arguments.out);
+        } else {
+            dsp_fourier_convolution(stream, matrix);
+        }
+    }
+    for(d = 0; d < matrix->dims; d++)
+        free(weights[d]);
+    free(weights);
+}
@@ -0,0 +1,350 @@
+/*
+*   DSP API - a digital signal processing library for astronomy usage
+*   Copyright © 2017-2022  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or
+*   modify it under the terms of the GNU Lesser General Public
+*   License as published by the Free Software Foundation; either
+*   version 3 of the License, or (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*   Lesser General Public License for more details.
+*
+*   You should have received a copy of the GNU Lesser General Public License
+*   along with this program; if not, write to the Free Software Foundation,
+*   Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "dsp.h"
+#include "simd.h"
+
+#include <limits.h>
+
+/*
+ * Each tile of rows converts the source rows it reads to dsp_t, into rows padded by mirroring the two samples
+ * next to each edge, which keeps the colors of the pattern in place. The kernels then run on whole vectors from
+ * the left edge to past the right one, the lanes past the edge read zeroes and their results are dropped.
+ * The edge aware method interpolates the rows of green it needs as the tile goes, from a window of raw rows.
+ */
+
+/* Samples of padding on each side of a row, and vectors of slack past its right edge */
+#define DSP_DEBAYER_PAD 2
+/* Raw and green rows of the window of a tile */
+#define DSP_DEBAYER_RAW_ROWS 7
+#define DSP_DEBAYER_GREEN_ROWS 3
+
+typedef enum {
+    DSP_DEBAYER_DSP_T,
+    DSP_DEBAYER_U8,
+    DSP_DEBAYER_U16,
+} dsp_debayer_type;
+
+typedef struct {
+    const void *src;
+    void *dst;
+    dsp_debayer_type type;
+    int width;
+    int height;
+    int red;
+    dsp_debayer_method method;
+    int planar;
+} dsp_debayer_args;
+
+typedef struct {
+    int stride;
+    dsp_t *raw[DSP_DEBAYER_RAW_ROWS];
+    int raw_y[DSP_DEBAYER_RAW_ROWS];
+    dsp_t *green[DSP_DEBAYER_GREEN_ROWS];
+    int green_y[DSP_DEBAYER_GREEN_ROWS];
+    dsp_t *out[3];
+    dsp_t *memory;
+} dsp_debayer_tile;
+
+/* Index i reflected into 0 to len - 1 without repeating the edge samples, len is at least 2 */
+static int dsp_debayer_mirror(int i, int len)
+{
+    int period = 2 * (len - 1);
+    i = abs(i) % period;
+    return i < len ? i : period - i;
+}
+
+/* Column parity of the red or blue samples of row y, those of red on the rows of red */
+static int dsp_debayer_color_column(int red, int y)
+{
+    return (red & 1) ^ ((y & 1) != ((red >> 1) & 1));
+}
+
+static int dsp_debayer_red_row(int red, int y)
+{
+    return (y & 1) == ((red >> 1) & 1);
+}
+
+static int dsp_debayer_tile_alloc(dsp_debayer_tile *tile, int width)
+{
+    int rows = DSP_DEBAYER_RAW_ROWS + DSP_DEBAYER_GREEN_ROWS + 3;
+    int r;
+    tile->stride = width + 2 * DSP_DEBAYER_PAD + 2 * DSP_VEC_LANES;
+    tile->memory = (dsp_t*)calloc((size_t)tile->stride * rows, sizeof(dsp_t));
+    if(tile->memory == NULL)
+        return -1;
+    for(r = 0; r < DSP_DEBAYER_RAW_ROWS; r++) {
+        tile->raw[r] = &tile->memory[(size_t)tile->stride * r + DSP_DEBAYER_PAD];
+        tile->raw_y[r] = INT_MIN;
+    }
+    for(r = 0; r < DSP_DEBAYER_GREEN_ROWS; r++) {
+        tile->green[r] = &tile->memory[(size_t)tile->stride * (DSP_DEBAYER_RAW_ROWS + r) + DSP_DEBAYER_PAD];
+        tile->green_y[r] = INT_MIN;
+    }
+    for(r = 0; r < 3; r++)
+        tile->out[r] = &tile->memory[(size_t)tile->stride * (DSP_DEBAYER_RAW_ROWS + DSP_DEBAYER_GREEN_ROWS + r) + DSP_DEBAYER_PAD];
+    return 0;
+}
+
+static void dsp_debayer_pad(dsp_t *row, int width)
+{
+    row[-1] = row[1];
+    row[-2] = row[2];
+    row[width] = row[width - 2];
+    row[width + 1] = row[width - 3];
+}
+
+/* Row y of the source, y mirrored into the frame, as dsp_t */
+static dsp_t *dsp_debayer_raw(const dsp_debayer_args *args, dsp_debayer_tile *tile, int y)
+{
+    int slot = (y % DSP_DEBAYER_RAW_ROWS + DSP_DEBAYER_RAW_ROWS) % DSP_DEBAYER_RAW_ROWS;
+    dsp_t *row = tile->raw[slot];
+    int x;
+    if(tile->raw_y[slot] == y)
+        return row;
+    tile->raw_y[slot] = y;
+    size_t offset = (size_t)dsp_debayer_mirror(y, args->height) * (size_t)args->width;
+    switch(args->type) {
+    case DSP_DEBAYER_U8: {
+        const unsigned char *src = (const unsigned char*)args->src + offset;
+        for(x = 0; x < args->width; x++)
+            row[x] = src[x];
+        break;
+    }
+    case DSP_DEBAYER_U16: {
+        const unsigned short *src = (const unsigned short*)args->src + offset;
+        for(x = 0; x < args->width; x++)
+            row[x] = src[x];
+        break;
+    }
+    default:
+        memcpy(row, (const dsp_t*)args->src + offset, sizeof(dsp_t) * (size_t)args->width);
+        break;
+    }
+    dsp_debayer_pad(row, args->width);
+    return row;
+}
+
+static dsp_vec_mask_t dsp_debayer_parity_mask(int parity)
+{
+    dsp_vec_mask_t mask;
+    int i;
+    for(i = 0; i < DSP_VEC_LANES; i++)
+        mask[i] = (i & 1) == parity ? -1 : 0;
+    return mask;
+}
+
+static dsp_vec_t dsp_debayer_abs(dsp_vec_t v)
+{
+    return dsp_vec_max(v, -v);
+}
+
+/*
+ * Green of row y, interpolated at the red and blue samples along the direction of the smaller gradient,
+ * corrected by the laplacian of the color sampled there, the average of both directions when they match.
+ */
+static dsp_t *dsp_debayer_green(const dsp_debayer_args *args, dsp_debayer_tile *tile, int y)
+{
+    int slot = (y % DSP_DEBAYER_GREEN_ROWS + DSP_DEBAYER_GREEN_ROWS) % DSP_DEBAYER_GREEN_ROWS;
+    dsp_t *row = tile->green[slot];
+    int x;
+    if(tile->green_y[slot] == y)
+        return row;
+    tile->green_y[slot] = y;
+    const dsp_t *uu = dsp_debayer_raw(args, tile, y - 2);
+    const dsp_t *u = dsp_debayer_raw(args, tile, y - 1);
+    const dsp_t *c = dsp_debayer_raw(args, tile, y);
+    const dsp_t *d = dsp_debayer_raw(args, tile, y + 1);
+    const dsp_t *dd = dsp_debayer_raw(args, tile, y + 2);
+    dsp_vec_mask_t color = dsp_debayer_parity_mask(dsp_debayer_color_column(args->red, y));
+    for(x = 0; x < args->width; x += DSP_VEC_LANES) {
+        dsp_vec_t center = dsp_vec_load(&c[x]);
+        dsp_vec_t left = dsp_vec_load(&c[x - 1]);
+        dsp_vec_t right = dsp_vec_load(&c[x + 1]);
+        dsp_vec_t up = dsp_vec_load(&u[x]);
+        dsp_vec_t down = dsp_vec_load(&d[x]);
+        dsp_vec_t lh = center * 2 - dsp_vec_load(&c[x - 2]) - dsp_vec_load(&c[x + 2]);
+        dsp_vec_t lv = center * 2 - dsp_vec_load(&uu[x]) - dsp_vec_load(&dd[x]);
+        dsp_vec_t dh = dsp_debayer_abs(left - right) + dsp_debayer_abs(lh);
+        dsp_vec_t dv = dsp_debayer_abs(up - down) + dsp_debayer_abs(lv);
+        dsp_vec_t gh = (left + right) * (dsp_t)0.5 + lh * (dsp_t)0.25;
+        dsp_vec_t gv = (up + down) * (dsp_t)0.5 + lv * (dsp_t)0.25;
+        dsp_vec_t g = dsp_vec_select(dh < dv, gh, dsp_vec_select(dv < dh, gv, (gh + gv) * (dsp_t)0.5));
+        dsp_vec_store(&row[x], dsp_vec_select(color, g, center));
+    }
+    dsp_debayer_pad(row, args->width);
+    return row;
+}
+
+/* Averages of the nearest samples: the color of the row, green and the other color, on each side of the mask */
+static void dsp_debayer_row_bilinear(const dsp_debayer_args *args, dsp_debayer_tile *tile, int y, dsp_t *own, dsp_t *green, dsp_t *other)
+{
+    const dsp_t *u = dsp_debayer_raw(args, tile, y - 1);
+    const dsp_t *c = dsp_debayer_raw(args, tile, y);
+    const dsp_t *d = dsp_debayer_raw(args, tile, y + 1);
+    dsp_vec_mask_t color = dsp_debayer_parity_mask(dsp_debayer_color_column(args->red, y));
+    int x;
+    for(x = 0; x < args->width; x += DSP_VEC_LANES) {
+        dsp_vec_t center = dsp_vec_load(&c[x]);
+        dsp_vec_t h = dsp_vec_load(&c[x - 1]) + dsp_vec_load(&c[x + 1]);
+        dsp_vec_t v = dsp_vec_load(&u[x]) + dsp_vec_load(&d[x]);
+        dsp_vec_t diagonal = dsp_vec_load(&u[x - 1]) + dsp_vec_load(&u[x + 1]) + dsp_vec_load(&d[x - 1]) + dsp_vec_load(&d[x + 1]);
+        dsp_vec_store(&own[x], dsp_vec_select(color, center, h * (dsp_t)0.5));
+        dsp_vec_store(&green[x], dsp_vec_select(color, (h + v) * (dsp_t)0.25, center));
+        dsp_vec_store(&other[x], dsp_vec_select(color, diagonal * (dsp_t)0.25, v * (dsp_t)0.5));
+    }
+}
+
+/* Green interpolated along the edges, red and blue from the averages of their differences to green */
+static void dsp_debayer_row_edge(const dsp_debayer_args *args, dsp_debayer_tile *tile, int y, dsp_t *own, dsp_t *green, dsp_t *other)
+{
+    const dsp_t *gu = dsp_debayer_green(args, tile, y - 1);
+    const dsp_t *gc = dsp_debayer_green(args, tile, y);
+    const dsp_t *gd = dsp_debayer_green(args, tile, y + 1);
+    const dsp_t *u = dsp_debayer_raw(args, tile, y - 1);
+    const dsp_t *c = dsp_debayer_raw(args, tile, y);
+    const dsp_t *d = dsp_debayer_raw(args, tile, y + 1);
+    dsp_vec_mask_t color = dsp_debayer_parity_mask(dsp_debayer_color_column(args->red, y));
+    int x;
+    for(x = 0; x < args->width; x += DSP_VEC_LANES) {
+        dsp_vec_t center = dsp_vec_load(&c[x]);
+        dsp_vec_t g = dsp_vec_load(&gc[x]);
+        dsp_vec_t h = dsp_vec_load(&c[x - 1]) - dsp_vec_load(&gc[x - 1]) + dsp_vec_load(&c[x + 1]) - dsp_vec_load(&gc[x + 1]);
+        dsp_vec_t v = dsp_vec_load(&u[x]) - dsp_vec_load(&gu[x]) + dsp_vec_load(&d[x]) - dsp_vec_load(&gd[x]);
+        dsp_vec_t diagonal = dsp_vec_load(&u[x - 1]) - dsp_vec_load(&gu[x - 1]) + dsp_vec_load(&u[x + 1]) - dsp_vec_load(&gu[x + 1]) +
+                             dsp_vec_load(&d[x - 1]) - dsp_vec_load(&gd[x - 1]) + dsp_vec_load(&d[x + 1]) - dsp_vec_load(&gd[x + 1]);
+        dsp_vec_store(&own[x], dsp_vec_select(color, center, g + h * (dsp_t)0.5));
+        dsp_vec_store(&green[x], g);
+        dsp_vec_store(&other[x], g + dsp_vec_select(color, diagonal * (dsp_t)0.25, v * (dsp_t)0.5));
+    }
+}
+
+/* One pixel from each quad of rows 2y and 2y + 1, the average of its two greens */
+static void dsp_debayer_row_superpixel(const dsp_debayer_args *args, dsp_debayer_tile *tile, int y, dsp_t *r, dsp_t *g, dsp_t *b)
+{
+    int redx = args->red & 1, redy = (args->red >> 1) & 1;
+    const dsp_t *reds = dsp_debayer_raw(args, tile, 2 * y + redy);
+    const dsp_t *blues = dsp_debayer_raw(args, tile, 2 * y + 1 - redy);
+    int x;
+    for(x = 0; x < args->width / 2; x++) {
+        r[x] = reds[2 * x + redx];
+        g[x] = (reds[2 * x + 1 - redx] + blues[2 * x + redx]) * (dsp_t)0.5;
+        b[x] = blues[2 * x + 1 - redx];
+    }
+}
+
+#define DSP_DEBAYER_STORE(type, mx) \
+    do { \
+        type *out = (type*)args->dst; \
+        for(c = 0; c < 3; c++) { \
+            for(x = 0; x < width; x++) { \
+                dsp_t value = Min(mx, Max(0, planes[c][x] + (dsp_t)0.5)); \
+                out[args->planar ? (size_t)c * plane + row + x : (row + x) * 3 + c] = (type)value; \
+            } \
+        } \
+    } while(0)
+
+static void dsp_debayer_store(const dsp_debayer_args *args, dsp_t **planes, int y, int width, int height)
+{
+    size_t plane = (size_t)width * height;
+    size_t row = (size_t)y * width;
+    int c, x;
+    switch(args->type) {
+    case DSP_DEBAYER_U8:
+        DSP_DEBAYER_STORE(unsigned char, 255);
+        break;
+    case DSP_DEBAYER_U16:
+        DSP_DEBAYER_STORE(unsigned short, 65535);
+        break;
+    default: {
+        dsp_t *out = (dsp_t*)args->dst;
+        for(c = 0; c < 3; c++) {
+            if(args->planar) {
+                memcpy(&out[(size_t)c * plane + row], planes[c], sizeof(dsp_t) * (size_t)width);
+                continue;
+            }
+            for(x = 0; x < width; x++)
+                out[(row + x) * 3 + c] = planes[c][x];
+        }
+        break;
+    }
+    }
+}
+
+static void dsp_debayer_rows(void *arg, int start, int end)
+{
+    const dsp_debayer_args *args = (const dsp_debayer_args*)arg;
+    dsp_debayer_tile tile;
+    int y;
+    if(dsp_debayer_tile_alloc(&tile, args->width) < 0)
+        return;
+    for(y = start; y < end; y++) {
+        if(args->method == DSP_DEBAYER_SUPERPIXEL) {
+            dsp_debayer_row_superpixel(args, &tile, y, tile.out[0], tile.out[1], tile.out[2]);
+            dsp_debayer_store(args, tile.out, y, args->width / 2, args->height / 2);
+            continue;
+        }
+        /* The color of the row goes to red or to blue */
+        int red_row = dsp_debayer_red_row(args->red, y);
+        dsp_t *own = tile.out[red_row ? 0 : 2], *other = tile.out[red_row ? 2 : 0];
+        if(args->method == DSP_DEBAYER_EDGE_AWARE)
+            dsp_debayer_row_edge(args, &tile, y, own, tile.out[1], other);
+        else
+            dsp_debayer_row_bilinear(args, &tile, y, own, tile.out[1], other);
+        dsp_debayer_store(args, tile.out, y, args->width, args->height);
+    }
+    free(tile.memory);
+}
+
+static int dsp_debayer_run(const void *src, void *dst, dsp_debayer_type type, int width, int height, int red, dsp_debayer_method method, int planar)
+{
+    if(src == NULL || dst == NULL || red < 0 || red > 3)
+        return -1;
+    if(method == DSP_DEBAYER_SUPERPIXEL ? (width < 2 || height < 2) : (width < 3 || height < 3))
+        return -1;
+    dsp_debayer_args args;
+    args.src = src;
+    args.dst = dst;
+    args.type = type;
+    args.width = width;
+    args.height = height;
+    args.red = red;
+    args.method = method;
+    args.planar = planar;
+    int rows = method == DSP_DEBAYER_SUPERPIXEL ? height / 2 : height;
+    /* Each tile converts the rows around its own again, tiles of a few rows keep that small */
+    int grain = Max(16, DSP_PARALLEL_TILE_SIZE / width);
+    dsp_parallel_for(rows, grain, dsp_debayer_rows, &args);
+    return 0;
+}
+
+int dsp_debayer(const dsp_t *src, dsp_t *dst, int width, int height, int red, dsp_debayer_method method, int planar)
+{
+    return dsp_debayer_run(src, dst, DSP_DEBAYER_DSP_T, width, height, red, method, planar);
+}
+
+int dsp_debayer_u8(const unsigned char *src, unsigned char *dst, int width, int height, int red, dsp_debayer_method method, int planar)
+{
+    return dsp_debayer_run(src, dst, DSP_DEBAYER_U8, width, height, red, method, planar);
+}
+
+int dsp_debayer_u16(const unsigned short *src, unsigned short *dst, int width, int height, int red, dsp_debayer_method method, int planar)
+{
+    return dsp_debayer_run(src, dst, DSP_DEBAYER_U16, width, height, red, method, planar);
+}
@@ -73,7 +73,11 @@ extern "C" {
 */
 /**\{*/
 #define DSP_MAX_STARS 200
+#ifdef DSP_FLOAT
+typedef float dsp_t;
+#else
 typedef double dsp_t;
+#endif
 typedef double complex_t[2];
 #define dsp_t_max 255
 #define dsp_t_min -dsp_t_max
@@ -86,6 +90,29 @@ typedef double complex_t[2];
 */
 DLL_EXPORT unsigned long int dsp_max_threads(unsigned long value);
 
+/**
+* \brief Bytes of dsp_t of the tiles dsp_parallel_for splits its range into by default, which stay in cache
+*/
+#define DSP_PARALLEL_TILE_SIZE 32768
+
+/**
+* \brief function run by dsp_parallel_for on each tile of its range
+* \param arg The argument passed to dsp_parallel_for
+* \param start The first index of the tile
+* \param end The index past the last one of the tile
+*/
+typedef void (*dsp_parallel_func)(void *arg, int start, int end);
+
+/**
+* \brief run func on the tiles of the range from 0 to len, on the persistent worker threads and on the calling thread
+* \param len The number of indexes of the range
+* \param grain The number of indexes of each tile, 0 for tiles of DSP_PARALLEL_TILE_SIZE bytes of dsp_t
+* \param func The function run on each tile, it may call dsp_parallel_for itself
+* \param arg The argument passed to func
+* \note Up to dsp_max_threads threads run the tiles, the call returns once all of them are done
+*/
+DLL_EXPORT void dsp_parallel_for(int len, int grain, dsp_parallel_func func, void *arg);
+
 #ifndef DSP_DEBUG
 #define DSP_DEBUG
 /**
@@ -175,6 +202,12 @@ dsp_print(x, str); \
 #endif
 
 
+///The macros of generic buffers run the vectorized kernels when the buffer is of dsp_t
+#ifdef __cplusplus
+#define DSP_IS_DSP_T(buf) 0
+#else
+#define DSP_IS_DSP_T(buf) __builtin_types_compatible_p(__typeof(buf[0]), dsp_t)
+#endif
 ///if min() is not present you can use this one
 #ifndef Min
 #define Min(a,b) \
@@ -337,6 +370,25 @@ typedef struct dsp_region_t
     int len;
 } dsp_region;
 
+/**
+* \brief Statistics of a buffer, as computed by dsp_stats_summarize
+*/
+typedef struct dsp_stats_summary_t
+{
+    /// Minimum value
+    dsp_t min;
+    /// Maximum value
+    dsp_t max;
+    /// Mean value
+    double mean;
+    /// Standard deviation from the mean
+    double stddev;
+    /// Median value, the lower of the two central ones with even lengths
+    dsp_t median;
+    /// Median of the absolute deviations from the median
+    dsp_t mad;
+} dsp_stats_summary;
+
 /**
 * \brief The location type
 */
@@ -462,6 +514,49 @@ DLL_EXPORT void dsp_fourier_dft(dsp_stream_p stream, int exp);
 */
 DLL_EXPORT void dsp_fourier_idft(dsp_stream_p stream);
 
+/**
+* \brief Convolve a dsp_stream with a matrix by overlap-save, one tile of the stream at a time
+* \param stream the inout stream, the matrix centered on each element, zero outside of the stream.
+* \param matrix the convolution matrix stream, same dimensions of stream.
+* The spectrum of the matrix is kept until a different one is used.
+*/
+DLL_EXPORT void dsp_fourier_convolution(dsp_stream_p stream, dsp_stream_p matrix);
+
+/**
+* \brief Size of the tiles of dsp_fourier_convolution in one dimension
+* \param size the size of the stream in that dimension.
+* \param matrix_size the size of the matrix in that dimension.
+* \return the power of two the tiles are wide
+*/
+DLL_EXPORT int dsp_fourier_convolution_tile(int size, int matrix_size);
+
+/**
+* \brief Add the power spectra of the overlapping windowed transforms of a signal, as in the Welch method
+* \param in the samples.
+* \param len the number of samples.
+* \param size the number of samples of each transform, the spectra have size / 2 + 1 bins.
+* \param step the number of samples between the starts of two transforms, less than size to overlap them.
+* \param window the size weights of the samples of each transform.
+* \param power the size / 2 + 1 bins the power of each transform is added to.
+* \return the number of transforms added, the samples from the start of the next one on are left over
+* The transforms are shared among dsp_max_threads threads and use the cached plans of dsp_fourier_dft.
+*/
+DLL_EXPORT int dsp_fourier_power_spectrum(const double *in, int len, int size, int step, const double *window, double *power);
+
+/**
+* \brief Add the cross spectra of every pair of inputs, the transform and multiply stages of an FX correlator
+* \param inputs count arrays of len samples, taken at the same times.
+* \param count the number of inputs.
+* \param len the number of samples of each input, cut into transforms of size samples.
+* \param size the number of samples of each transform, the spectra have size / 2 + 1 bins.
+* \param crosses count * (count - 1) / 2 arrays of size / 2 + 1 bins, the products of the transforms of the inputs
+* i and j > i, the second one conjugated, are added to crosses[j * (j - 1) / 2 + i].
+* \param powers count arrays of size / 2 + 1 bins the power spectra of the inputs are added to, or NULL.
+* \return the number of transforms of each input added, the samples after the last whole one are left over
+* The transforms and the baselines are shared among dsp_max_threads threads.
+*/
+DLL_EXPORT int dsp_fourier_cross_spectra(const double **inputs, int count, int len, int size, complex_t **crosses, double **powers);
+
 /**
 * \brief Fill the magnitude and phase buffers with the current data in stream->dft
 * \param stream the inout stream.
@@ -482,7 +577,7 @@ DLL_EXPORT void dsp_fourier_2complex_t(dsp_stream_p stream);
 * \param len the input arrays length.
 * \return the array filled with the complex numbers
 */
-DLL_EXPORT void dsp_fourier_phase_mag_array_get_complex(double* mag, double* phi, complex_t *out, int len);
+DLL_EXPORT void dsp_fourier_phase_mag_array_get_complex(dsp_t* mag, dsp_t* phi, complex_t *out, int len);
 
 /**
 * \brief Obtain a complex number's array magnitudes
@@ -490,7 +585,7 @@ DLL_EXPORT void dsp_fourier_phase_mag_array_get_complex(double* mag, double* phi
 * \param len the input array length.
 * \return the array filled with the magnitudes
 */
-DLL_EXPORT double* dsp_fourier_complex_array_get_magnitude(dsp_complex in, int len);
+DLL_EXPORT dsp_t* dsp_fourier_complex_array_get_magnitude(dsp_complex in, int len);
 
 /**
 * \brief Obtain a complex number's array phases
@@ -498,7 +593,7 @@ DLL_EXPORT double* dsp_fourier_complex_array_get_magnitude(dsp_complex in, int l
 * \param len the input array length.
 * \return the array filled with the phases
 */
-DLL_EXPORT double* dsp_fourier_complex_array_get_phase(dsp_complex in, int len);
+DLL_EXPORT dsp_t* dsp_fourier_complex_array_get_phase(dsp_complex in, int len);
 
 /**\}*/
 /**
@@ -562,6 +657,15 @@ DLL_EXPORT void dsp_convolution_convolution(dsp_stream_p stream, dsp_stream_p ma
 */
 DLL_EXPORT void dsp_convolution_correlation(dsp_stream_p stream, dsp_stream_p matrix);
 
+/**
+* \brief Convolve a stream with a matrix in place, without stretching the result
+* \param stream the inout stream, the matrix centered on each element, zero outside of the stream.
+* \param matrix the convolution matrix stream, same dimensions of stream.
+* Separable matrices are applied one dimension at a time, others directly or by dsp_fourier_convolution,
+* whichever costs less for their size.
+*/
+DLL_EXPORT void dsp_convolution_filter(dsp_stream_p stream, dsp_stream_p matrix);
+
 /**\}*/
 /**
  * \defgroup dsp_Stats DSP API Buffer statistics functions
@@ -579,7 +683,9 @@ DLL_EXPORT void dsp_convolution_correlation(dsp_stream_p stream, dsp_stream_p ma
 ({\
     int i;\
     __typeof(buf[0]) min = (__typeof(buf[0]))buf[0];\
-    for(i = 0; i < len; i++) {\
+    if(DSP_IS_DSP_T(buf))\
+        min = (__typeof(buf[0]))dsp_simd_min((dsp_t*)(buf), len);\
+    else for(i = 0; i < len; i++) {\
         min = Min(buf[i], min);\
     }\
     min;\
@@ -597,7 +703,9 @@ DLL_EXPORT void dsp_convolution_correlation(dsp_stream_p stream, dsp_stream_p ma
 ({\
     int i;\
     __typeof(buf[0]) max = (__typeof(buf[0]))buf[0];\
-    for(i = 0; i < len; i++) {\
+    if(DSP_IS_DSP_T(buf))\
+        max = (__typeof(buf[0]))dsp_simd_max((dsp_t*)(buf), len);\
+    else for(i = 0; i < len; i++) {\
         max = Max(buf[i], max);\
     }\
     max;\
@@ -666,10 +774,14 @@ DLL_EXPORT void dsp_convolution_correlation(dsp_stream_p stream, dsp_stream_p ma
 ({\
     int __dsp__i;\
     double __dsp__mean = 0;\
-    for(__dsp__i = 0; __dsp__i < len; __dsp__i++) {\
-        __dsp__mean += buf[__dsp__i];\
+    if(DSP_IS_DSP_T(buf))\
+        __dsp__mean = dsp_simd_mean((dsp_t*)(buf), len);\
+    else {\
+        for(__dsp__i = 0; __dsp__i < len; __dsp__i++) {\
+            __dsp__mean += buf[__dsp__i];\
+        }\
+        __dsp__mean /= len;\
     }\
-    __dsp__mean /= len;\
     __dsp__mean;\
     })
 #endif
@@ -779,6 +891,79 @@ DLL_EXPORT void dsp_convolution_correlation(dsp_stream_p stream, dsp_stream_p ma
 */
 DLL_EXPORT double* dsp_stats_histogram(dsp_stream_p stream, int size);
 
+/**
+* \brief Histogram of an 8 bits unsigned buffer, without converting it to dsp_t
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \param size the number of bins.
+* \return the same histogram of dsp_stats_histogram on a stream of buf. NULL if an
+* error is encountered.
+*/
+DLL_EXPORT double* dsp_stats_histogram_u8(unsigned char* buf, int len, int size);
+
+/**
+* \brief Histogram of a 16 bits unsigned buffer, without converting it to dsp_t
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \param size the number of bins.
+* \return the same histogram of dsp_stats_histogram on a stream of buf. NULL if an
+* error is encountered.
+*/
+DLL_EXPORT double* dsp_stats_histogram_u16(unsigned short* buf, int len, int size);
+
+/**
+* \brief Value at a fraction of a buffer, as if sorted
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \param fraction the fraction from 0 to 1, the value with index fraction * (len - 1) rounded down is returned.
+* \return the percentile, exact and counted in a histogram for integer values, selected from a copy of buf otherwise.
+*/
+DLL_EXPORT dsp_t dsp_stats_percentile(dsp_t* buf, int len, double fraction);
+
+/**
+* \brief Values at some fractions of a 16 bits unsigned buffer, as dsp_stats_percentile, from one histogram
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \param fractions the fractions from 0 to 1.
+* \param count the number of fractions.
+* \param percentiles filled with the value at each fraction.
+*/
+DLL_EXPORT void dsp_stats_percentiles_u16(unsigned short* buf, int len, double* fractions, int count, double* percentiles);
+
+/**
+* \brief Minimum, maximum, mean, standard deviation, median and median absolute deviation of a buffer
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \return the statistics, the median and the deviation being exact as with dsp_stats_percentile.
+* \note The moments are gathered in one parallel pass; integer values in a range of 65536 or less then
+* take one pass more to count them, the others are selected from a copy of buf.
+*/
+DLL_EXPORT dsp_stats_summary dsp_stats_summarize(dsp_t* buf, int len);
+
+/**
+* \brief Minimum of a dsp_t buffer, on vectors of the target instruction set
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \return the minimum value.
+*/
+DLL_EXPORT dsp_t dsp_simd_min(dsp_t* buf, int len);
+
+/**
+* \brief Maximum of a dsp_t buffer, on vectors of the target instruction set
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \return the maximum value.
+*/
+DLL_EXPORT dsp_t dsp_simd_max(dsp_t* buf, int len);
+
+/**
+* \brief Mean of a dsp_t buffer, on vectors of the target instruction set
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \return the mean value.
+*/
+DLL_EXPORT double dsp_simd_mean(dsp_t* buf, int len);
+
 /**\}*/
 /**
  * \defgroup dsp_Buffers DSP API Buffer editing functions
@@ -797,6 +982,26 @@ DLL_EXPORT void dsp_buffer_shift(dsp_stream_p stream);
 */
 DLL_EXPORT void dsp_buffer_removemean(dsp_stream_p stream);
 
+/**
+* \brief Stretch minimum and maximum values of a dsp_t buffer, on vectors of the target instruction set
+* \param buf the input buffer
+* \param len the length in elements of the buffer.
+* \param mn the desired minimum value.
+* \param mx the desired maximum value.
+*/
+DLL_EXPORT void dsp_simd_stretch(dsp_t* buf, int len, dsp_t mn, dsp_t mx);
+
+/**
+* \brief Calibrate a frame in one pass: subtract bias and dark, divide by flat and stretch the result
+* \param stream the stream on which execute
+* \param bias the bias frame, stream->len elements long, or NULL
+* \param dark the dark frame, stream->len elements long, or NULL
+* \param flat the flat frame, stream->len elements long, or NULL
+* \param mn the desired minimum value.
+* \param mx the desired maximum value, the result is not stretched when not greater than mn.
+*/
+DLL_EXPORT void dsp_buffer_calibrate(dsp_stream_p stream, dsp_t* bias, dsp_t* dark, dsp_t* flat, dsp_t mn, dsp_t mx);
+
 #ifndef dsp_buffer_stretch
 /**
 * \brief Stretch minimum and maximum values of the input stream
@@ -808,15 +1013,19 @@ DLL_EXPORT void dsp_buffer_removemean(dsp_stream_p stream);
 #define dsp_buffer_stretch(buf, len, _mn, _mx)\
 ({\
     int k;\
-    __typeof(buf[0]) __mn = dsp_stats_min(buf, len);\
-    __typeof(buf[0]) __mx = dsp_stats_max(buf, len);\
-    double oratio = (_mx - _mn);\
-    double iratio = (__mx - __mn);\
-    if(iratio == 0) iratio = 1;\
-    for(k = 0; k < len; k++) {\
-        buf[k] -= __mn;\
-        buf[k] = (__typeof(buf[0]))((double)buf[k] * oratio / iratio);\
-        buf[k] += _mn;\
+    if(DSP_IS_DSP_T(buf)) {\
+        dsp_simd_stretch((dsp_t*)(buf), len, _mn, _mx);\
+    } else {\
+        __typeof(buf[0]) __mn = dsp_stats_min(buf, len);\
+        __typeof(buf[0]) __mx = dsp_stats_max(buf, len);\
+        double oratio = (_mx - _mn);\
+        double iratio = (__mx - __mn);\
+        if(iratio == 0) iratio = 1;\
+        for(k = 0; k < len; k++) {\
+            buf[k] -= __mn;\
+            buf[k] = (__typeof(buf[0]))((double)buf[k] * oratio / iratio);\
+            buf[k] += _mn;\
+        }\
     }\
 })
 #endif
@@ -974,8 +1183,19 @@ DLL_EXPORT void dsp_buffer_pow1(dsp_stream_p stream, double val);
 */
 DLL_EXPORT void dsp_buffer_log1(dsp_stream_p stream, double val);
 
+/**
+* \brief The k-th smallest element of a buffer, as if sorted, by quickselect
+* \param buf the inout buffer, its elements are moved around.
+* \param len the length of the buffer.
+* \param k the index of the element in the sorted buffer.
+* \return the selected element.
+*/
+DLL_EXPORT dsp_t dsp_buffer_select(dsp_t* buf, int len, int k);
+
 /**
 * \brief Median elements of the input stream
+* Windows of up to 64 elements are sorted by a network, larger windows of integer valued streams are
+* kept in histograms, so that the time per element does not grow with the window.
 * \param stream the stream on which execute
 * \param size the length of the median.
 * \param median the location of the median value.
@@ -984,6 +1204,7 @@ DLL_EXPORT void dsp_buffer_median(dsp_stream_p stream, int size, int median);
 
 /**
 * \brief Standard deviation of each element of the input stream within the given size
+* Large windows of integer valued streams are kept in histograms, as for dsp_buffer_median.
 * \param stream the stream on which execute
 * \param size the reference size.
 */
@@ -1252,6 +1473,33 @@ DLL_EXPORT int dsp_stream_set_position(dsp_stream_p stream, int *pos);
 */
 DLL_EXPORT int* dsp_stream_get_position(dsp_stream_p stream, int index);
 
+/**
+* \brief Fill pos with the multidimensional positional indexes of a linear index, without allocating them
+* \param stream the target DSP stream.
+* \param index the position of the index on a single dimension.
+* \param pos the array of stream->dims indexes to fill.
+* \sa dsp_stream_get_position
+* \sa dsp_stream_position_next
+*/
+DLL_EXPORT void dsp_stream_position_at(dsp_stream_p stream, int index, int *pos);
+
+/**
+* \brief Advance the multidimensional positional indexes to those of the next linear index
+* \param stream the target DSP stream.
+* \param pos the indexes on each dimension, as filled by dsp_stream_position_at.
+* \return the lowest dimension that did not wrap around, -1 when all of them did, past the last index.
+* \sa dsp_stream_position_at
+*/
+DLL_EXPORT int dsp_stream_position_next(dsp_stream_p stream, int *pos);
+
+/**
+* \brief Fill strides with the distance of the linear indexes of consecutive positions on each dimension
+* \param stream the target DSP stream.
+* \param strides the array of stream->dims strides to fill, the linear index of pos is the sum of pos[d] * strides[d].
+* \sa dsp_stream_set_position
+*/
+DLL_EXPORT void dsp_stream_get_strides(dsp_stream_p stream, int *strides);
+
 /**
 * \brief Execute the function callback pointed by the func field of the passed stream
 * \param stream the target DSP stream.
@@ -1541,6 +1789,41 @@ DLL_EXPORT void dsp_file_write_fits_bayer(const char* filename, int components,
 */
 DLL_EXPORT dsp_t* dsp_file_bayer_2_composite(dsp_t *src, int red, int width, int height);
 
+/**
+* \brief Demosaicing methods of dsp_debayer
+*/
+typedef enum {
+    /// Average of the nearest samples of each color
+    DSP_DEBAYER_BILINEAR = 0,
+    /// Green interpolated along the edges, red and blue from their differences to green
+    DSP_DEBAYER_EDGE_AWARE,
+    /// One pixel for each 2x2 quad, the output is half the width and height of the input
+    DSP_DEBAYER_SUPERPIXEL,
+} dsp_debayer_method;
+
+/**
+* \brief Demosaic a bayer pattern dsp_t array into RGB, on vectors of samples and with rows split among the threads
+* \param src the input buffer
+* \param dst the output buffer, of 3 samples for each pixel of the output
+* \param width the picture width
+* \param height the picture height
+* \param red the location of the red pixel within the bayer quad, the column in bit 0 and the row in bit 1
+* \param method the demosaicing method
+* \param planar non zero to write the red, green and blue planes one after the other, RGB triplets otherwise
+* \return 0 on success, -1 if the arguments are not valid
+*/
+DLL_EXPORT int dsp_debayer(const dsp_t *src, dsp_t *dst, int width, int height, int red, dsp_debayer_method method, int planar);
+
+/**
+* \brief Demosaic an 8 bits bayer pattern into RGB as dsp_debayer does, rounding and clamping the output
+*/
+DLL_EXPORT int dsp_debayer_u8(const unsigned char *src, unsigned char *dst, int width, int height, int red, dsp_debayer_method method, int planar);
+
+/**
+* \brief Demosaic a 16 bits bayer pattern into RGB as dsp_debayer does, rounding and clamping the output
+*/
+DLL_EXPORT int dsp_debayer_u16(const unsigned short *src, unsigned short *dst, int width, int height, int red, dsp_debayer_method method, int planar);
+
 /**
 * \brief Fill a dsp_align_info struct by comparing two triangles
 * \param t1 the reference triangle
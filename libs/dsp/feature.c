@@ -28,17 +28,21 @@ void dsp_feature_align(dsp_stream_p stream, dsp_stream_p matrix)
         int x, y, d;
         dsp_t mn = dsp_stats_min(stream->buf, stream->len);
         dsp_t mx = dsp_stats_max(stream->buf, stream->len);
-        int* d_pos = (int*)malloc(sizeof(int)*stream->dims);
-        for(y = z*stream->len; y < z*stream->len+stream->len; y++) {
-            int* pos = dsp_stream_get_position(matrix, y);
-            for(d = 0; d < stream->dims; d++) {
-                d_pos[d] = stream->sizes[d]/2+pos[d]-matrix->sizes[d]/2;
-            }
-            x = dsp_stream_set_position(stream, d_pos);
-            free(pos);
+        int* pos = (int*)malloc(sizeof(int)*matrix->dims);
+        int* strides = (int*)malloc(sizeof(int)*stream->dims);
+        int offset = 0;
+        dsp_stream_get_strides(stream, strides);
+        for(d = 0; d < stream->dims; d++)
+            offset += (stream->sizes[d]/2-matrix->sizes[d]/2)*strides[d];
+        dsp_stream_position_at(matrix, z*stream->len, pos);
+        for(y = z*stream->len; y < z*stream->len+stream->len; y++, dsp_stream_position_next(matrix, pos)) {
+            x = offset;
+            for(d = 0; d < stream->dims; d++)
+                x += pos[d]*strides[d];
             stream->magnitude->buf[x] *= sqrt(matrix->magnitude->buf[y]);
         }
-        free(d_pos);
+        free(strides);
+        free(pos);
         dsp_fourier_idft(stream);
         dsp_buffer_stretch(stream->buf, stream->len, mn, mx);
     }
@@ -20,6 +20,119 @@
 #include "dsp.h"
 #include <fftw3.h>
 
+/*
+ * Plans of the transforms done so far, one for each shape, direction and alignment of the arrays, executed on the
+ * arrays of each call. Plans are measured on scratch arrays once and the wisdom is kept in ~/.indi, so planning
+ * costs nothing after the first transform of a size, even across restarts.
+ */
+#define DSP_FOURIER_MAX_PLANS 64
+#define DSP_FOURIER_MAX_DIMS 8
+/* Room for any offset from the SIMD alignment of fftw_malloc */
+#define DSP_FOURIER_ALIGNMENT_PAD 64
+
+typedef struct {
+    int direction;
+    int dims;
+    int sizes[DSP_FOURIER_MAX_DIMS];
+    int in_alignment;
+    int out_alignment;
+    int threads;
+    fftw_plan plan;
+} dsp_fourier_plan_t;
+
+static dsp_fourier_plan_t dsp_fourier_plans[DSP_FOURIER_MAX_PLANS];
+static int dsp_fourier_plans_count = 0;
+static int dsp_fourier_wisdom_loaded = 0;
+static pthread_mutex_t dsp_fourier_plans_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void dsp_fourier_wisdom_filename(char *filename, size_t len)
+{
+    snprintf(filename, len, "%s/.indi/fftw3.wisdom", getenv("HOME") ? getenv("HOME") : ".");
+}
+
+/*
+ * Returns the plan of the transform of in to out, real to complex when direction is FFTW_FORWARD and complex to
+ * real otherwise. *owned is set when the cache is full, the caller then destroys the plan.
+ */
+static fftw_plan dsp_fourier_get_plan(int direction, int dims, int *sizes, void *in, void *out, int *owned)
+{
+    int i, len = 1;
+    int in_alignment = fftw_alignment_of((double*)in);
+    int out_alignment = fftw_alignment_of((double*)out);
+    int threads = (int)dsp_max_threads(0);
+    fftw_plan plan = NULL;
+    char filename[DSP_NAME_SIZE * 4];
+    *owned = 0;
+    if(dims > DSP_FOURIER_MAX_DIMS)
+        return NULL;
+    pthread_mutex_lock(&dsp_fourier_plans_mutex);
+    for(i = 0; i < dsp_fourier_plans_count; i++) {
+        dsp_fourier_plan_t *cached = &dsp_fourier_plans[i];
+        if(cached->direction == direction && cached->dims == dims && !memcmp(cached->sizes, sizes, sizeof(int) * dims) &&
+                cached->in_alignment == in_alignment && cached->out_alignment == out_alignment && cached->threads == threads) {
+            plan = cached->plan;
+            pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+            return plan;
+        }
+    }
+    dsp_fourier_wisdom_filename(filename, sizeof(filename));
+    if(!dsp_fourier_wisdom_loaded) {
+#ifdef HAVE_FFTW3_THREADS
+        fftw_init_threads();
+#endif
+        fftw_import_wisdom_from_filename(filename);
+        dsp_fourier_wisdom_loaded = 1;
+    }
+#ifdef HAVE_FFTW3_THREADS
+    fftw_plan_with_nthreads(threads);
+#endif
+    /* Measuring overwrites the arrays, the plan is made on scratch arrays of the same alignment */
+    for(i = 0; i < dims; i++)
+        len *= sizes[i];
+    {
+        size_t in_size = direction == FFTW_FORWARD ? sizeof(double) * len : sizeof(fftw_complex) * len;
+        size_t out_size = direction == FFTW_FORWARD ? sizeof(fftw_complex) * len : sizeof(double) * len;
+        char *scratch_in = (char*)fftw_malloc(in_size + DSP_FOURIER_ALIGNMENT_PAD);
+        char *scratch_out = (char*)fftw_malloc(out_size + DSP_FOURIER_ALIGNMENT_PAD);
+        if(scratch_in != NULL && scratch_out != NULL) {
+            void *plan_in = scratch_in + in_alignment;
+            void *plan_out = scratch_out + out_alignment;
+            if(direction == FFTW_FORWARD)
+                plan = fftw_plan_dft_r2c(dims, sizes, (double*)plan_in, (fftw_complex*)plan_out, FFTW_MEASURE);
+            else
+                plan = fftw_plan_dft_c2r(dims, sizes, (fftw_complex*)plan_in, (double*)plan_out, FFTW_MEASURE);
+        }
+        fftw_free(scratch_in);
+        fftw_free(scratch_out);
+    }
+    if(plan != NULL) {
+        fftw_export_wisdom_to_filename(filename);
+        if(dsp_fourier_plans_count < DSP_FOURIER_MAX_PLANS) {
+            dsp_fourier_plan_t *cached = &dsp_fourier_plans[dsp_fourier_plans_count++];
+            cached->direction = direction;
+            cached->dims = dims;
+            memcpy(cached->sizes, sizes, sizeof(int) * dims);
+            cached->in_alignment = in_alignment;
+            cached->out_alignment = out_alignment;
+            cached->threads = threads;
+            cached->plan = plan;
+        } else {
+            *owned = 1;
+        }
+    }
+    pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+    return plan;
+}
+
+static void dsp_fourier_release_plan(fftw_plan plan, int owned)
+{
+    if(!owned)
+        return;
+    pthread_mutex_lock(&dsp_fourier_plans_mutex);
+    fftw_destroy_plan(plan);
+    pthread_mutex_unlock(&dsp_fourier_plans_mutex);
+}
+
 static void dsp_fourier_dft_magnitude(dsp_stream_p stream)
 {
     if(stream->magnitude)
@@ -39,16 +152,15 @@ void dsp_fourier_2dsp(dsp_stream_p stream)
     memcpy(dft, stream->dft.pairs, sizeof(complex_t) * stream->len);
     y = 0;
     for(x = 0; x < stream->len && y < stream->len; x++) {
-        int *pos = dsp_stream_get_position(stream, x);
-        if(pos[0] <= stream->sizes[0] / 2) {
+        if(x % stream->sizes[0] <= stream->sizes[0] / 2) {
             stream->dft.pairs[x][0] = dft[y][0];
             stream->dft.pairs[x][1] = dft[y][1];
             stream->dft.pairs[stream->len-1-x][0] = dft[y][0];
             stream->dft.pairs[stream->len-1-x][1] = dft[y][1];
             y++;
         }
-        free(pos);
     }
+    free(dft);
     dsp_fourier_dft_magnitude(stream);
     dsp_buffer_shift(stream->magnitude);
     dsp_fourier_dft_phase(stream);
@@ -67,21 +179,19 @@ void dsp_fourier_2complex_t(dsp_stream_p stream)
     dsp_buffer_set(stream->dft.buf, stream->len*2, 0);
     y = 0;
     for(x = 0; x < stream->len; x++) {
-        int *pos = dsp_stream_get_position(stream, x);
-        if(pos[0] <= stream->sizes[0] / 2) {
+        if(x % stream->sizes[0] <= stream->sizes[0] / 2) {
             stream->dft.pairs[y][0] = dft[x][0];
             stream->dft.pairs[y][1] = dft[x][1];
             y++;
         }
-        free(pos);
     }
     free(dft);
 }
 
-double* dsp_fourier_complex_array_get_magnitude(dsp_complex in, int len)
+dsp_t* dsp_fourier_complex_array_get_magnitude(dsp_complex in, int len)
 {
     int i;
-    double* out = (double*)malloc(sizeof(double) * len);
+    dsp_t* out = (dsp_t*)malloc(sizeof(dsp_t) * len);
     for(i = 0; i < len; i++) {
         double real = in.complex[i].real;
         double imaginary = in.complex[i].imaginary;
@@ -90,10 +200,10 @@ double* dsp_fourier_complex_array_get_magnitude(dsp_complex in, int len)
     return out;
 }
 
-double* dsp_fourier_complex_array_get_phase(dsp_complex in, int len)
+dsp_t* dsp_fourier_complex_array_get_phase(dsp_complex in, int len)
 {
     int i;
-    double* out = (double*)malloc(sizeof(double) * len);
+    dsp_t* out = (dsp_t*)malloc(sizeof(dsp_t) * len);
     for(i = 0; i < len; i++) {
         out [i] = 0;
         if (in.complex[i].real != 0) {
@@ -112,7 +222,7 @@ double* dsp_fourier_complex_array_get_phase(dsp_complex in, int len)
     return out;
 }
 
-void dsp_fourier_phase_mag_array_get_complex(double* mag, double* phi, complex_t* out, int len)
+void dsp_fourier_phase_mag_array_get_complex(dsp_t* mag, dsp_t* phi, complex_t* out, int len)
 {
     int i;
     for(i = 0; i < len; i++) {
@@ -123,15 +233,17 @@ void dsp_fourier_phase_mag_array_get_complex(double* mag, double* phi, complex_t
     }
 }
 
-static void* dsp_stream_dft_th(void* arg)
+static void dsp_stream_dft_tile(void* arg, int start, int end)
 {
     struct {
         int exp;
-       dsp_stream_p stream;
+        dsp_stream_p stream;
     } *arguments = arg;
-    dsp_fourier_dft(arguments->stream, arguments->exp);
-    return NULL;
+    int x;
+    for(x = start; x < end; x++)
+        dsp_fourier_dft(arguments[x].stream, arguments[x].exp);
 }
+
 void dsp_fourier_dft(dsp_stream_p stream, int exp)
 {
     if(exp < 1)
@@ -146,27 +258,26 @@ void dsp_fourier_dft(dsp_stream_p stream, int exp)
     int *sizes = (int*)malloc(sizeof(int)*stream->dims);
     dsp_buffer_copy(stream->sizes, sizes, stream->dims);
     dsp_buffer_reverse(sizes, stream->dims);
-    fftw_plan plan = fftw_plan_dft_r2c(stream->dims, sizes, buf, stream->dft.pairs, FFTW_ESTIMATE_PATIENT);
-    fftw_execute(plan);
-    fftw_free(plan);
+    int owned;
+    fftw_plan plan = dsp_fourier_get_plan(FFTW_FORWARD, stream->dims, sizes, buf, stream->dft.pairs, &owned);
+    if(plan != NULL) {
+        fftw_execute_dft_r2c(plan, buf, stream->dft.pairs);
+        dsp_fourier_release_plan(plan, owned);
+    }
     free(sizes);
     free(buf);
     dsp_fourier_2dsp(stream);
     if(exp > 1) {
         exp--;
-        pthread_t th[2];
         struct {
            int exp;
            dsp_stream_p stream;
         } thread_arguments[2];
         thread_arguments[0].exp = exp;
         thread_arguments[0].stream = stream->phase;
-        pthread_create(&th[0], NULL, dsp_stream_dft_th, &thread_arguments[0]);
         thread_arguments[1].exp = exp;
         thread_arguments[1].stream = stream->magnitude;
-        pthread_create(&th[1], NULL, dsp_stream_dft_th, &thread_arguments[1]);
-        pthread_join(th[0], NULL);
-        pthread_join(th[1], NULL);
+        dsp_parallel_for(2, 1, dsp_stream_dft_tile, thread_arguments);
     }
 }
 
@@ -180,9 +291,12 @@ void dsp_fourier_idft(dsp_stream_p stream)
     int *sizes = (int*)malloc(sizeof(int)*stream->dims);
     dsp_buffer_copy(stream->sizes, sizes, stream->dims);
     dsp_buffer_reverse(sizes, stream->dims);
-    fftw_plan plan = fftw_plan_dft_c2r(stream->dims, sizes, stream->dft.pairs, buf, FFTW_ESTIMATE_PATIENT);
-    fftw_execute(plan);
-    fftw_free(plan);
+    int owned;
+    fftw_plan plan = dsp_fourier_get_plan(FFTW_BACKWARD, stream->dims, sizes, stream->dft.pairs, buf, &owned);
+    if(plan != NULL) {
+        fftw_execute_dft_c2r(plan, stream->dft.pairs, buf);
+        dsp_fourier_release_plan(plan, owned);
+    }
     free(sizes);
     dsp_buffer_stretch(buf, stream->len, mn, mx);
     dsp_buffer_copy(buf, stream->buf, stream->len);
@@ -190,3 +304,366 @@ void dsp_fourier_idft(dsp_stream_p stream)
     dsp_buffer_shift(stream->phase);
     free(buf);
 }
+
+/*
+ * Fast convolution by overlap-save: the output is split in blocks, each one the valid part of the circular convolution
+ * of a tile of the input, its block and the halo of the matrix around it, so that the blocks are independent and run
+ * in parallel. The spectrum of the matrix is kept for the next call with the same matrix and tiles.
+ */
+typedef struct {
+    int refs;
+    int dims;
+    int tile[DSP_FOURIER_MAX_DIMS];
+    int sizes[DSP_FOURIER_MAX_DIMS];
+    int len;
+    dsp_t *matrix;
+    fftw_complex *spectrum;
+} dsp_fourier_kernel_t;
+
+static dsp_fourier_kernel_t *dsp_fourier_kernel = NULL;
+static pthread_mutex_t dsp_fourier_kernel_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+    dsp_stream_p stream;
+    dsp_stream_p matrix;
+    dsp_t *out;
+    dsp_fourier_kernel_t *kernel;
+    int blocks[DSP_FOURIER_MAX_DIMS];
+    int block[DSP_FOURIER_MAX_DIMS];
+    int fftw_sizes[DSP_FOURIER_MAX_DIMS];
+    int tile_len;
+    int spectrum_len;
+} dsp_fourier_convolution_args;
+
+int dsp_fourier_convolution_tile(int size, int matrix_size)
+{
+    int tile = 16;
+    int whole = 1;
+    while(tile < matrix_size * 4)
+        tile <<= 1;
+    while(whole < size + matrix_size - 1)
+        whole <<= 1;
+    return Max(Min(tile, whole), 2);
+}
+
+static void dsp_fourier_kernel_release(dsp_fourier_kernel_t *kernel)
+{
+    pthread_mutex_lock(&dsp_fourier_kernel_mutex);
+    int refs = --kernel->refs;
+    pthread_mutex_unlock(&dsp_fourier_kernel_mutex);
+    if(refs > 0)
+        return;
+    free(kernel->matrix);
+    fftw_free(kernel->spectrum);
+    free(kernel);
+}
+
+static dsp_fourier_kernel_t *dsp_fourier_kernel_get(dsp_stream_p matrix, int *tile, int *fftw_sizes, int tile_len, int spectrum_len)
+{
+    int d, q;
+    dsp_fourier_kernel_t *kernel;
+    pthread_mutex_lock(&dsp_fourier_kernel_mutex);
+    kernel = dsp_fourier_kernel;
+    if(kernel != NULL && kernel->dims == matrix->dims && kernel->len == matrix->len &&
+            !memcmp(kernel->tile, tile, sizeof(int) * matrix->dims) && !memcmp(kernel->sizes, matrix->sizes, sizeof(int) * matrix->dims) &&
+            !memcmp(kernel->matrix, matrix->buf, sizeof(dsp_t) * matrix->len)) {
+        kernel->refs++;
+        pthread_mutex_unlock(&dsp_fourier_kernel_mutex);
+        return kernel;
+    }
+    pthread_mutex_unlock(&dsp_fourier_kernel_mutex);
+    kernel = (dsp_fourier_kernel_t*)malloc(sizeof(dsp_fourier_kernel_t));
+    kernel->refs = 1;
+    kernel->dims = matrix->dims;
+    kernel->len = matrix->len;
+    memcpy(kernel->tile, tile, sizeof(int) * matrix->dims);
+    memcpy(kernel->sizes, matrix->sizes, sizeof(int) * matrix->dims);
+    kernel->matrix = (dsp_t*)malloc(sizeof(dsp_t) * matrix->len);
+    memcpy(kernel->matrix, matrix->buf, sizeof(dsp_t) * matrix->len);
+    kernel->spectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * spectrum_len);
+    double *padded = (double*)fftw_malloc(sizeof(double) * tile_len);
+    int *pos = (int*)malloc(sizeof(int) * matrix->dims);
+    dsp_buffer_set(padded, tile_len, 0);
+    dsp_stream_position_at(matrix, 0, pos);
+    for(q = 0; q < matrix->len; q++, dsp_stream_position_next(matrix, pos)) {
+        int idx = 0, stride = 1;
+        for(d = 0; d < matrix->dims; d++) {
+            idx += pos[d] * stride;
+            stride *= tile[d];
+        }
+        padded[idx] = matrix->buf[q];
+    }
+    free(pos);
+    int owned;
+    fftw_plan plan = dsp_fourier_get_plan(FFTW_FORWARD, matrix->dims, fftw_sizes, padded, kernel->spectrum, &owned);
+    if(plan != NULL) {
+        fftw_execute_dft_r2c(plan, padded, kernel->spectrum);
+        dsp_fourier_release_plan(plan, owned);
+    } else {
+        memset(kernel->spectrum, 0, sizeof(fftw_complex) * spectrum_len);
+    }
+    fftw_free(padded);
+    pthread_mutex_lock(&dsp_fourier_kernel_mutex);
+    dsp_fourier_kernel_t *old = dsp_fourier_kernel;
+    dsp_fourier_kernel = kernel;
+    kernel->refs++;
+    pthread_mutex_unlock(&dsp_fourier_kernel_mutex);
+    if(old != NULL)
+        dsp_fourier_kernel_release(old);
+    return kernel;
+}
+
+static void dsp_fourier_convolution_tile_run(void *arg, int start, int end)
+{
+    dsp_fourier_convolution_args *arguments = arg;
+    dsp_stream_p stream = arguments->stream;
+    dsp_stream_p matrix = arguments->matrix;
+    int dims = stream->dims;
+    int *tile = arguments->kernel->tile;
+    double *buf = (double*)fftw_malloc(sizeof(double) * arguments->tile_len);
+    fftw_complex *spectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * arguments->spectrum_len);
+    int origin[DSP_FOURIER_MAX_DIMS], pos[DSP_FOURIER_MAX_DIMS], strides[DSP_FOURIER_MAX_DIMS];
+    int b, d, j, k;
+    dsp_stream_get_strides(stream, strides);
+    for(b = start; b < end; b++) {
+        int index = b;
+        for(d = 0; d < dims; d++) {
+            origin[d] = (index % arguments->blocks[d]) * arguments->block[d];
+            index /= arguments->blocks[d];
+        }
+        /* The tile starts matrix size - 1 before the first input element of the block */
+        memset(pos, 0, sizeof(int) * dims);
+        for(j = 0; j < arguments->tile_len; j++) {
+            int src = 0, inside = 1;
+            for(d = 0; d < dims && inside; d++) {
+                int coord = origin[d] + matrix->sizes[d] / 2 - (matrix->sizes[d] - 1) + pos[d];
+                inside = coord >= 0 && coord < stream->sizes[d];
+                src += coord * strides[d];
+            }
+            buf[j] = inside ? stream->buf[src] : 0.0;
+            for(d = 0; d < dims && ++pos[d] == tile[d]; d++)
+                pos[d] = 0;
+        }
+        int owned;
+        fftw_plan plan = dsp_fourier_get_plan(FFTW_FORWARD, dims, arguments->fftw_sizes, buf, spectrum, &owned);
+        if(plan == NULL)
+            continue;
+        fftw_execute_dft_r2c(plan, buf, spectrum);
+        dsp_fourier_release_plan(plan, owned);
+        for(k = 0; k < arguments->spectrum_len; k++) {
+            double real = spectrum[k][0] * arguments->kernel->spectrum[k][0] - spectrum[k][1] * arguments->kernel->spectrum[k][1];
+            double imaginary = spectrum[k][0] * arguments->kernel->spectrum[k][1] + spectrum[k][1] * arguments->kernel->spectrum[k][0];
+            spectrum[k][0] = real / arguments->tile_len;
+            spectrum[k][1] = imaginary / arguments->tile_len;
+        }
+        plan = dsp_fourier_get_plan(FFTW_BACKWARD, dims, arguments->fftw_sizes, spectrum, buf, &owned);
+        if(plan == NULL)
+            continue;
+        fftw_execute_dft_c2r(plan, spectrum, buf);
+        dsp_fourier_release_plan(plan, owned);
+        /* Only the last block elements of each dimension did not wrap around */
+        memset(pos, 0, sizeof(int) * dims);
+        for(j = 0; j < arguments->tile_len; j++) {
+            int dst = 0, inside = 1;
+            for(d = 0; d < dims && inside; d++) {
+                int coord = origin[d] + pos[d] - (matrix->sizes[d] - 1);
+                inside = pos[d] >= matrix->sizes[d] - 1 && coord < stream->sizes[d];
+                dst += coord * strides[d];
+            }
+            if(inside)
+                arguments->out[dst] = buf[j];
+            for(d = 0; d < dims && ++pos[d] == tile[d]; d++)
+                pos[d] = 0;
+        }
+    }
+    fftw_free(spectrum);
+    fftw_free(buf);
+}
+
+void dsp_fourier_convolution(dsp_stream_p stream, dsp_stream_p matrix)
+{
+    int d;
+    int dims = stream->dims;
+    if(dims < 1 || dims > DSP_FOURIER_MAX_DIMS || matrix->dims != dims)
+        return;
+    dsp_fourier_convolution_args arguments;
+    int tile[DSP_FOURIER_MAX_DIMS];
+    int blocks = 1;
+    arguments.tile_len = 1;
+    for(d = 0; d < dims; d++) {
+        tile[d] = dsp_fourier_convolution_tile(stream->sizes[d], matrix->sizes[d]);
+        arguments.block[d] = tile[d] - matrix->sizes[d] + 1;
+        arguments.blocks[d] = (stream->sizes[d] + arguments.block[d] - 1) / arguments.block[d];
+        arguments.fftw_sizes[dims - 1 - d] = tile[d];
+        arguments.tile_len *= tile[d];
+        blocks *= arguments.blocks[d];
+    }
+    arguments.spectrum_len = arguments.tile_len / tile[0] * (tile[0] / 2 + 1);
+    arguments.stream = stream;
+    arguments.matrix = matrix;
+    arguments.kernel = dsp_fourier_kernel_get(matrix, tile, arguments.fftw_sizes, arguments.tile_len, arguments.spectrum_len);
+    arguments.out = (dsp_t*)malloc(sizeof(dsp_t) * stream->len);
+    dsp_parallel_for(blocks, 1, dsp_fourier_convolution_tile_run, &arguments);
+    memcpy(stream->buf, arguments.out, sizeof(dsp_t) * stream->len);
+    free(arguments.out);
+    dsp_fourier_kernel_release(arguments.kernel);
+}
+
+typedef struct {
+    const double *in;
+    int size;
+    int step;
+    const double *window;
+    double *power;
+    pthread_mutex_t mutex;
+} dsp_fourier_power_args;
+
+static void dsp_fourier_power_spectrum_run(void *arg, int start, int end)
+{
+    dsp_fourier_power_args *arguments = arg;
+    int size = arguments->size;
+    int bins = size / 2 + 1;
+    double *buf = (double*)fftw_malloc(sizeof(double) * size);
+    fftw_complex *spectrum = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * bins);
+    /* Each tile sums its transforms apart, the sums are added to the result once */
+    double *power = (double*)calloc(bins, sizeof(double));
+    int f, j, k;
+    for(f = start; f < end; f++) {
+        const double *in = arguments->in + (size_t)f * arguments->step;
+        for(j = 0; j < size; j++)
+            buf[j] = in[j] * arguments->window[j];
+        int owned;
+        fftw_plan plan = dsp_fourier_get_plan(FFTW_FORWARD, 1, &size, buf, spectrum, &owned);
+        if(plan == NULL)
+            continue;
+        fftw_execute_dft_r2c(plan, buf, spectrum);
+        dsp_fourier_release_plan(plan, owned);
+        for(k = 0; k < bins; k++)
+            power[k] += spectrum[k][0] * spectrum[k][0] + spectrum[k][1] * spectrum[k][1];
+    }
+    pthread_mutex_lock(&arguments->mutex);
+    for(k = 0; k < bins; k++)
+        arguments->power[k] += power[k];
+    pthread_mutex_unlock(&arguments->mutex);
+    free(power);
+    fftw_free(spectrum);
+    fftw_free(buf);
+}
+
+int dsp_fourier_power_spectrum(const double *in, int len, int size, int step, const double *window, double *power)
+{
+    if(size < 2 || step < 1 || len < size)
+        return 0;
+    int transforms = (len - size) / step + 1;
+    int threads = (int)dsp_max_threads(0);
+    dsp_fourier_power_args arguments;
+    arguments.in = in;
+    arguments.size = size;
+    arguments.step = step;
+    arguments.window = window;
+    arguments.power = power;
+    pthread_mutex_init(&arguments.mutex, NULL);
+    /* One tile per thread, so that the partial sums are few */
+    dsp_parallel_for(transforms, (transforms + threads - 1) / (threads > 0 ? threads : 1), dsp_fourier_power_spectrum_run, &arguments);
+    pthread_mutex_destroy(&arguments.mutex);
+    return transforms;
+}
+
+/* Transforms of the inputs kept at once by dsp_fourier_cross_spectra, which bounds its memory */
+#define DSP_FOURIER_CROSS_SEGMENTS 64
+
+typedef struct {
+    const double **inputs;
+    int count;
+    int size;
+    int bins;
+    int first;
+    fftw_complex *spectra;
+    int segments;
+    complex_t **crosses;
+    double **powers;
+} dsp_fourier_cross_args;
+
+static void dsp_fourier_cross_transform(void *arg, int start, int end)
+{
+    dsp_fourier_cross_args *arguments = arg;
+    int size = arguments->size;
+    double *buf = (double*)fftw_malloc(sizeof(double) * size);
+    int t;
+    for(t = start; t < end; t++) {
+        int segment = t / arguments->count;
+        int input = t % arguments->count;
+        fftw_complex *spectrum = arguments->spectra + ((size_t)segment * arguments->count + input) * arguments->bins;
+        memcpy(buf, arguments->inputs[input] + (size_t)(arguments->first + segment) * size, sizeof(double) * size);
+        int owned;
+        fftw_plan plan = dsp_fourier_get_plan(FFTW_FORWARD, 1, &size, buf, spectrum, &owned);
+        if(plan == NULL) {
+            memset(spectrum, 0, sizeof(fftw_complex) * arguments->bins);
+            continue;
+        }
+        fftw_execute_dft_r2c(plan, buf, spectrum);
+        dsp_fourier_release_plan(plan, owned);
+    }
+    fftw_free(buf);
+}
+
+/* Items below the number of baselines are the cross products of a pair of inputs, the others the powers of an input */
+static void dsp_fourier_cross_multiply(void *arg, int start, int end)
+{
+    dsp_fourier_cross_args *arguments = arg;
+    int count = arguments->count;
+    int bins = arguments->bins;
+    int baselines = count * (count - 1) / 2;
+    int b, s, k;
+    for(b = start; b < end; b++) {
+        if(b < baselines) {
+            int j = 1;
+            while((j + 1) * j / 2 <= b)
+                j++;
+            int i = b - j * (j - 1) / 2;
+            double *cross = (double*)arguments->crosses[b];
+            for(s = 0; s < arguments->segments; s++) {
+                const double *x = (const double*)(arguments->spectra + ((size_t)s * count + i) * bins);
+                const double *y = (const double*)(arguments->spectra + ((size_t)s * count + j) * bins);
+                /* x times the conjugate of y, on interleaved real and imaginary parts */
+                for(k = 0; k < bins; k++) {
+                    cross[2 * k] += x[2 * k] * y[2 * k] + x[2 * k + 1] * y[2 * k + 1];
+                    cross[2 * k + 1] += x[2 * k + 1] * y[2 * k] - x[2 * k] * y[2 * k + 1];
+                }
+            }
+        } else {
+            int input = b - baselines;
+            double *power = arguments->powers[input];
+            for(s = 0; s < arguments->segments; s++) {
+                const double *x = (const double*)(arguments->spectra + ((size_t)s * count + input) * bins);
+                for(k = 0; k < bins; k++)
+                    power[k] += x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1];
+            }
+        }
+    }
+}
+
+int dsp_fourier_cross_spectra(const double **inputs, int count, int len, int size, complex_t **crosses, double **powers)
+{
+    if(count < 2 || size < 2 || len < size)
+        return 0;
+    int total = len / size;
+    int baselines = count * (count - 1) / 2;
+    dsp_fourier_cross_args arguments;
+    arguments.inputs = inputs;
+    arguments.count = count;
+    arguments.size = size;
+    arguments.bins = size / 2 + 1;
+    arguments.crosses = crosses;
+    arguments.powers = powers;
+    int block = total < DSP_FOURIER_CROSS_SEGMENTS ? total : DSP_FOURIER_CROSS_SEGMENTS;
+    arguments.spectra = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * block * count * arguments.bins);
+    for(arguments.first = 0; arguments.first < total; arguments.first += block) {
+        arguments.segments = total - arguments.first < block ? total - arguments.first : block;
+        /* F stage: the transforms of every input, then X stage: the products of the pairs, one baseline per tile */
+        dsp_parallel_for(arguments.segments * count, 1, dsp_fourier_cross_transform, &arguments);
+        dsp_parallel_for(baselines + (powers != NULL ? count : 0), 1, dsp_fourier_cross_multiply, &arguments);
+    }
+    fftw_free(arguments.spectra);
+    return total;
+}
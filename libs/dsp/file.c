@@ -945,94 +945,10 @@ dsp_t* dsp_file_bayer_2_composite(dsp_t *src, int r, int width, int height)
 
 dsp_t* dsp_file_bayer_2_rgb(dsp_t *src, int red, int width, int height)
 {
-    int i;
-    dsp_t *rawpt, *scanpt;
-    int size;
-
-    dsp_t * dst = (dsp_t*)malloc(sizeof(dsp_t)*(size_t)(width*height*3));
-    rawpt  = src;
-    scanpt = dst;
-    size   = width * height;
-    (void)*scanpt++;
-    for (i = 0; i < size; i++)
-    {
-        if ((i / width) % 2 == ((red&2)>>1))
-        {
-            if ((i % 2) == (red&1))
-            {
-                /* B */
-                if ((i > width) && ((i % width) > 0))
-                {
-                    *scanpt++ =
-                        (*(rawpt - width - 1) + *(rawpt - width + 1) + *(rawpt + width - 1) + *(rawpt + width + 1)) /
-                        4;                                                                               /* R */
-                    *scanpt++ = (*(rawpt - 1) + *(rawpt + 1) + *(rawpt + width) + *(rawpt - width)) / 4; /* G */
-                    *scanpt++ = *rawpt;                                                                  /* B */
-                }
-                else
-                {
-                    *scanpt++ = *(rawpt + width + 1);                  /* R */
-                    *scanpt++ = (*(rawpt + 1) + *(rawpt + width)) / 2; /* G */
-                    *scanpt++ = *rawpt;                                /* B */
-                }
-            }
-            else
-            {
-                /* (B)G */
-                if ((i > width) && ((i % width) < (width - 1)))
-                {
-                    *scanpt++ = (*(rawpt + width) + *(rawpt - width)) / 2; /* R */
-                    *scanpt++ = *rawpt;                                    /* G */
-                    *scanpt++ = (*(rawpt - 1) + *(rawpt + 1)) / 2;         /* B */
-                }
-                else
-                {
-                    *scanpt++ = *(rawpt + width); /* R */
-                    *scanpt++ = *rawpt;           /* G */
-                    *scanpt++ = *(rawpt - 1);     /* B */
-                }
-            }
-        }
-        else
-        {
-            if ((i % 2) == (red&1))
-            {
-                /* G(R) */
-                if ((i < (width * (height - 1))) && ((i % width) > 0))
-                {
-                    *scanpt++ = (*(rawpt - 1) + *(rawpt + 1)) / 2;         /* R */
-                    *scanpt++ = *rawpt;                                    /* G */
-                    *scanpt++ = (*(rawpt + width) + *(rawpt - width)) / 2; /* B */
-                }
-                else
-                {
-                    /* bottom line or left column */
-                    *scanpt++ = *(rawpt + 1);     /* R */
-                    *scanpt++ = *rawpt;           /* G */
-                    *scanpt++ = *(rawpt - width); /* B */
-                }
-            }
-            else
-            {
-                /* R */
-                if (i < (width * (height - 1)) && ((i % width) < (width - 1)))
-                {
-                    *scanpt++ = *rawpt;                                                                  /* R */
-                    *scanpt++ = (*(rawpt - 1) + *(rawpt + 1) + *(rawpt - width) + *(rawpt + width)) / 4; /* G */
-                    *scanpt++ =
-                        (*(rawpt - width - 1) + *(rawpt - width + 1) + *(rawpt + width - 1) + *(rawpt + width + 1)) /
-                        4; /* B */
-                }
-                else
-                {
-                    /* bottom line or right column */
-                    *scanpt++ = *rawpt;                                /* R */
-                    *scanpt++ = (*(rawpt - 1) + *(rawpt - width)) / 2; /* G */
-                    *scanpt++ = *(rawpt - width - 1);                  /* B */
-                }
-            }
-        }
-        rawpt++;
+    dsp_t * dst = (dsp_t*)malloc(sizeof(dsp_t)*(size_t)width*(size_t)height*3);
+    if(dst != NULL && dsp_debayer(src, dst, width, height, red, DSP_DEBAYER_BILINEAR, 0) < 0) {
+        free(dst);
+        return NULL;
     }
     return dst;
 }
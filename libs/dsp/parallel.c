@@ -0,0 +1,127 @@
+/*
+*   DSP API - a digital signal processing library for astronomy usage
+*   Copyright © 2017-2022  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or
+*   modify it under the terms of the GNU Lesser General Public
+*   License as published by the Free Software Foundation; either
+*   version 3 of the License, or (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*   Lesser General Public License for more details.
+*
+*   You should have received a copy of the GNU Lesser General Public License
+*   along with this program; if not, write to the Free Software Foundation,
+*   Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "dsp.h"
+
+/*
+ * The workers are started once and wait for jobs. Each dsp_parallel_for call queues a job, the workers and the
+ * calling thread take its tiles one by one until none is left. A tile that calls dsp_parallel_for queues a job
+ * of its own, the caller always runs tiles of its job, so nested calls never wait on busy workers.
+ */
+typedef struct dsp_parallel_job {
+    dsp_parallel_func func;
+    void *arg;
+    int len;
+    int grain;
+    int next;
+    int running;
+    struct dsp_parallel_job *next_job;
+} dsp_parallel_job;
+
+static pthread_mutex_t dsp_parallel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dsp_parallel_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t dsp_parallel_done = PTHREAD_COND_INITIALIZER;
+static dsp_parallel_job *dsp_parallel_jobs = NULL;
+static unsigned long dsp_parallel_workers = 0;
+
+/* Called locked, takes the next tile of job and unqueues the job when it has no tile left */
+static int dsp_parallel_take(dsp_parallel_job *job, int *start, int *end)
+{
+    dsp_parallel_job **queued;
+    if(job->next >= job->len)
+        return 0;
+    *start = job->next;
+    *end = Min(job->len, job->next + job->grain);
+    job->next = *end;
+    job->running++;
+    if(job->next >= job->len) {
+        for(queued = &dsp_parallel_jobs; *queued != NULL; queued = &(*queued)->next_job) {
+            if(*queued == job) {
+                *queued = job->next_job;
+                break;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Called locked, runs a tile of job unlocked */
+static void dsp_parallel_run(dsp_parallel_job *job, int start, int end)
+{
+    pthread_mutex_unlock(&dsp_parallel_mutex);
+    job->func(job->arg, start, end);
+    pthread_mutex_lock(&dsp_parallel_mutex);
+    job->running--;
+    if(job->running == 0 && job->next >= job->len)
+        pthread_cond_broadcast(&dsp_parallel_done);
+}
+
+static void* dsp_parallel_worker(void* arg)
+{
+    int start, end;
+    (void)arg;
+    pthread_mutex_lock(&dsp_parallel_mutex);
+    while(1) {
+        dsp_parallel_job *job = dsp_parallel_jobs;
+        if(job == NULL) {
+            pthread_cond_wait(&dsp_parallel_work, &dsp_parallel_mutex);
+            continue;
+        }
+        if(dsp_parallel_take(job, &start, &end))
+            dsp_parallel_run(job, start, end);
+    }
+    return NULL;
+}
+
+void dsp_parallel_for(int len, int grain, dsp_parallel_func func, void *arg)
+{
+    int start, end;
+    unsigned long threads = dsp_max_threads(0);
+    dsp_parallel_job job;
+    if(len <= 0)
+        return;
+    if(grain <= 0)
+        grain = DSP_PARALLEL_TILE_SIZE / sizeof(dsp_t);
+    if(threads <= 1 || len <= grain) {
+        func(arg, 0, len);
+        return;
+    }
+    job.func = func;
+    job.arg = arg;
+    job.len = len;
+    job.grain = grain;
+    job.next = 0;
+    job.running = 0;
+    pthread_mutex_lock(&dsp_parallel_mutex);
+    while(dsp_parallel_workers < threads - 1) {
+        pthread_t th;
+        if(pthread_create(&th, NULL, dsp_parallel_worker, NULL))
+            break;
+        pthread_detach(th);
+        dsp_parallel_workers++;
+    }
+    job.next_job = dsp_parallel_jobs;
+    dsp_parallel_jobs = &job;
+    pthread_cond_broadcast(&dsp_parallel_work);
+    while(dsp_parallel_take(&job, &start, &end))
+        dsp_parallel_run(&job, start, end);
+    while(job.running > 0)
+        pthread_cond_wait(&dsp_parallel_done, &dsp_parallel_mutex);
+    pthread_mutex_unlock(&dsp_parallel_mutex);
+}
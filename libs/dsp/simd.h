@@ -0,0 +1,71 @@
+/*
+*   DSP API - a digital signal processing library for astronomy usage
+*   Copyright © 2017-2022  Ilia Platone
+*
+*   This program is free software; you can redistribute it and/or
+*   modify it under the terms of the GNU Lesser General Public
+*   License as published by the Free Software Foundation; either
+*   version 3 of the License, or (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+*   Lesser General Public License for more details.
+*
+*   You should have received a copy of the GNU Lesser General Public License
+*   along with this program; if not, write to the Free Software Foundation,
+*   Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef _DSP_SIMD_H
+#define _DSP_SIMD_H
+
+#include "dsp.h"
+#include <stdint.h>
+
+/*
+ * Vectors of dsp_t as wide as the registers of the target: AVX ones when enabled, SSE2 or NEON ones
+ * otherwise. The compiler lowers the operations to the instructions of the target.
+ */
+#ifdef __AVX__
+#define DSP_VEC_BYTES 32
+#else
+#define DSP_VEC_BYTES 16
+#endif
+typedef dsp_t dsp_vec_t __attribute__((vector_size(DSP_VEC_BYTES)));
+#ifdef DSP_FLOAT
+typedef int32_t dsp_vec_mask_t __attribute__((vector_size(DSP_VEC_BYTES)));
+#else
+typedef int64_t dsp_vec_mask_t __attribute__((vector_size(DSP_VEC_BYTES)));
+#endif
+#define DSP_VEC_LANES ((int)(sizeof(dsp_vec_t) / sizeof(dsp_t)))
+
+static inline dsp_vec_t dsp_vec_load(const dsp_t* p)
+{
+    dsp_vec_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void dsp_vec_store(dsp_t* p, dsp_vec_t v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline dsp_vec_t dsp_vec_select(dsp_vec_mask_t mask, dsp_vec_t a, dsp_vec_t b)
+{
+    return (dsp_vec_t)(((dsp_vec_mask_t)a & mask) | ((dsp_vec_mask_t)b & ~mask));
+}
+
+/* Same results of Min() and Max() on each lane */
+static inline dsp_vec_t dsp_vec_min(dsp_vec_t a, dsp_vec_t b)
+{
+    return dsp_vec_select(a < b, a, b);
+}
+
+static inline dsp_vec_t dsp_vec_max(dsp_vec_t a, dsp_vec_t b)
+{
+    return dsp_vec_select(a > b, a, b);
+}
+
+#endif //_DSP_SIMD_H
@@ -18,27 +18,409 @@
 */
 
 #include "dsp.h"
+#include "simd.h"
+
+/* Buffers are split among the threads in chunks of this many elements at least */
+#define DSP_STATS_CHUNK_LEN 65536
+/* Integer values spanning up to this many values are counted to find their percentiles */
+#define DSP_STATS_COUNTS_RANGE 65536
+
+typedef struct {
+    dsp_t* buf;
+    unsigned short* words;
+    int len;
+    int chunks;
+    int size;
+    long base;
+    dsp_t mn;
+    dsp_t oratio;
+    dsp_t iratio;
+    unsigned int* counts;
+} dsp_stats_counts_args;
+
+typedef struct {
+    int count;
+    int integer;
+    dsp_t min;
+    dsp_t max;
+    double mean;
+    double m2;
+} dsp_stats_moments;
+
+typedef struct {
+    dsp_t* buf;
+    int len;
+    int chunks;
+    dsp_stats_moments* moments;
+} dsp_stats_moments_args;
+
+static int dsp_stats_chunks(int len)
+{
+    return Max(1, Min((int)dsp_max_threads(0), len / DSP_STATS_CHUNK_LEN));
+}
+
+static int dsp_stats_chunk_start(int len, int chunks, int chunk)
+{
+    return (int)((long)len * chunk / chunks);
+}
+
+/* Each chunk counts into its own histogram, the first one gets the totals */
+static void dsp_stats_counts_merge(unsigned int* counts, int chunks, int size)
+{
+    int c, i;
+    for(c = 1; c < chunks; c++)
+        for(i = 0; i < size; i++)
+            counts[i] += counts[(long)c * size + i];
+}
+
+static void dsp_stats_histogram_chunk(void* arg, int start, int end)
+{
+    dsp_stats_counts_args* arguments = arg;
+    int c, k;
+    for(c = start; c < end; c++) {
+        unsigned int* counts = &arguments->counts[(long)c * arguments->size];
+        int last = dsp_stats_chunk_start(arguments->len, arguments->chunks, c + 1);
+        for(k = dsp_stats_chunk_start(arguments->len, arguments->chunks, c); k < last; k++) {
+            /* Same bins of stretching the buffer from 0 to size - 1, as dsp_buffer_stretch does */
+            long i = (long)((arguments->buf[k] - arguments->mn) * arguments->oratio / arguments->iratio);
+            if(i > 0 && i < arguments->size)
+                counts[i] ++;
+        }
+    }
+}
 
 double* dsp_stats_histogram(dsp_stream_p stream, int size)
 {
     if(stream == NULL)
         return NULL;
-    int k;
+    int i;
+    double* out = (double*)malloc(sizeof(double)*size);
+    dsp_stats_counts_args arguments;
+    arguments.buf = stream->buf;
+    arguments.len = stream->len;
+    arguments.chunks = dsp_stats_chunks(stream->len);
+    arguments.size = size;
+    arguments.mn = dsp_simd_min(stream->buf, stream->len);
+    arguments.oratio = size-1;
+    arguments.iratio = dsp_simd_max(stream->buf, stream->len) - arguments.mn;
+    if(arguments.iratio == 0) arguments.iratio = 1;
+    arguments.counts = (unsigned int*)calloc((long)arguments.chunks * size, sizeof(unsigned int));
+    dsp_parallel_for(arguments.chunks, 1, dsp_stats_histogram_chunk, &arguments);
+    dsp_stats_counts_merge(arguments.counts, arguments.chunks, size);
+    for(i = 0; i < size; i++)
+        out[i] = arguments.counts[i];
+    free(arguments.counts);
+    dsp_t mn = dsp_stats_min(out, size);
+    dsp_t mx = dsp_stats_max(out, size);
+    if(mn < mx)
+        dsp_buffer_stretch(out, size, 0, size);
+    return out;
+}
+
+static double* dsp_stats_histogram_counts(unsigned int* counts, int mn, int mx, int size)
+{
+    int v;
     long i = 0;
     double* out = (double*)malloc(sizeof(double)*size);
-    dsp_t* tmp = (dsp_t*)malloc(sizeof(dsp_t)*stream->len);
+    double oratio = size-1;
+    double iratio = mx-mn;
+    if(iratio == 0) iratio = 1;
     dsp_buffer_set(out, size, 0.0);
-    memcpy(tmp, stream->buf, sizeof(dsp_t)*stream->len);
-    dsp_buffer_stretch(tmp, stream->len, 0, size-1);
-    for(k = 0; k < stream->len; k++) {
-        i = (long)tmp[k];
+    for(v = mn; v <= mx; v++) {
+        if(counts[v] == 0)
+            continue;
+        i = (long)((double)(v-mn) * oratio / iratio);
         if(i > 0 && i < size)
-            out[i] ++;
+            out[i] += counts[v];
     }
-    free(tmp);
-    dsp_t mn = dsp_stats_min(out, size);
-    dsp_t mx = dsp_stats_max(out, size);
-    if(mn < mx)
+    dsp_t mn_out = dsp_stats_min(out, size);
+    dsp_t mx_out = dsp_stats_max(out, size);
+    if(mn_out < mx_out)
         dsp_buffer_stretch(out, size, 0, size);
     return out;
 }
+
+double* dsp_stats_histogram_u8(unsigned char* buf, int len, int size)
+{
+    if(buf == NULL || len < 1)
+        return NULL;
+    int k;
+    unsigned int counts[256];
+    dsp_buffer_set(counts, 256, 0);
+    for(k = 0; k < len; k++)
+        counts[buf[k]] ++;
+    return dsp_stats_histogram_counts(counts, dsp_stats_min(buf, len), dsp_stats_max(buf, len), size);
+}
+
+static void dsp_stats_count_u16_chunk(void* arg, int start, int end)
+{
+    dsp_stats_counts_args* arguments = arg;
+    int c, k;
+    for(c = start; c < end; c++) {
+        unsigned int* counts = &arguments->counts[(long)c * arguments->size];
+        int last = dsp_stats_chunk_start(arguments->len, arguments->chunks, c + 1);
+        for(k = dsp_stats_chunk_start(arguments->len, arguments->chunks, c); k < last; k++)
+            counts[arguments->words[k]] ++;
+    }
+}
+
+static void dsp_stats_count_chunk(void* arg, int start, int end)
+{
+    dsp_stats_counts_args* arguments = arg;
+    int c, k;
+    for(c = start; c < end; c++) {
+        unsigned int* counts = &arguments->counts[(long)c * arguments->size];
+        int last = dsp_stats_chunk_start(arguments->len, arguments->chunks, c + 1);
+        for(k = dsp_stats_chunk_start(arguments->len, arguments->chunks, c); k < last; k++)
+            counts[(long)arguments->buf[k] - arguments->base] ++;
+    }
+}
+
+/* Occurrences of each value of a 16 bits buffer */
+static unsigned int* dsp_stats_count_u16(unsigned short* buf, int len)
+{
+    dsp_stats_counts_args arguments;
+    arguments.words = buf;
+    arguments.len = len;
+    arguments.chunks = dsp_stats_chunks(len);
+    arguments.size = 65536;
+    arguments.counts = (unsigned int*)calloc((long)arguments.chunks * arguments.size, sizeof(unsigned int));
+    dsp_parallel_for(arguments.chunks, 1, dsp_stats_count_u16_chunk, &arguments);
+    dsp_stats_counts_merge(arguments.counts, arguments.chunks, arguments.size);
+    return arguments.counts;
+}
+
+/* Occurrences of each integer value of a buffer, from base to base + range - 1 */
+static unsigned int* dsp_stats_count(dsp_t* buf, int len, long base, int range)
+{
+    dsp_stats_counts_args arguments;
+    arguments.buf = buf;
+    arguments.len = len;
+    arguments.chunks = dsp_stats_chunks(len);
+    arguments.size = range;
+    arguments.base = base;
+    arguments.counts = (unsigned int*)calloc((long)arguments.chunks * arguments.size, sizeof(unsigned int));
+    dsp_parallel_for(arguments.chunks, 1, dsp_stats_count_chunk, &arguments);
+    dsp_stats_counts_merge(arguments.counts, arguments.chunks, arguments.size);
+    return arguments.counts;
+}
+
+/* Index of the counted value of rank k */
+static int dsp_stats_counts_rank(unsigned int* counts, int range, long k)
+{
+    long seen = 0;
+    int v;
+    for(v = 0; v < range; v++) {
+        seen += counts[v];
+        if(seen > k)
+            return v;
+    }
+    return range - 1;
+}
+
+/* Absolute deviation of rank k of the counted values from the one at center */
+static int dsp_stats_counts_deviation(unsigned int* counts, int range, int center, long k)
+{
+    long seen = counts[center];
+    int d = 0;
+    while(seen <= k && d < range) {
+        d++;
+        if(center - d >= 0)
+            seen += counts[center - d];
+        if(center + d < range)
+            seen += counts[center + d];
+    }
+    return d;
+}
+
+double* dsp_stats_histogram_u16(unsigned short* buf, int len, int size)
+{
+    if(buf == NULL || len < 1)
+        return NULL;
+    int mn = 0, mx = 65535;
+    unsigned int* counts = dsp_stats_count_u16(buf, len);
+    while(counts[mn] == 0)
+        mn++;
+    while(counts[mx] == 0)
+        mx--;
+    double* out = dsp_stats_histogram_counts(counts, mn, mx, size);
+    free(counts);
+    return out;
+}
+
+void dsp_stats_percentiles_u16(unsigned short* buf, int len, double* fractions, int count, double* percentiles)
+{
+    int i;
+    if(buf == NULL || len < 1)
+        return;
+    unsigned int* counts = dsp_stats_count_u16(buf, len);
+    for(i = 0; i < count; i++)
+        percentiles[i] = dsp_stats_counts_rank(counts, 65536, (long)(Max(0.0, Min(1.0, fractions[i])) * (len - 1)));
+    free(counts);
+}
+
+static void dsp_stats_moments_chunk(void* arg, int start, int end)
+{
+    dsp_stats_moments_args* arguments = arg;
+    int c, k;
+    for(c = start; c < end; c++) {
+        dsp_stats_moments* moments = &arguments->moments[c];
+        int first = dsp_stats_chunk_start(arguments->len, arguments->chunks, c);
+        int last = dsp_stats_chunk_start(arguments->len, arguments->chunks, c + 1);
+        /* Deviations from the first element keep the sums of squares accurate */
+        double shift = arguments->buf[first], sum = 0, squares = 0;
+        dsp_t mn = arguments->buf[first], mx = arguments->buf[first];
+        int integer = 1;
+        for(k = first; k < last; k++) {
+            dsp_t v = arguments->buf[k];
+            double d = v - shift;
+            mn = Min(v, mn);
+            mx = Max(v, mx);
+            sum += d;
+            squares += d * d;
+            integer &= v == floor(v);
+        }
+        moments->count = last - first;
+        moments->integer = integer;
+        moments->min = mn;
+        moments->max = mx;
+        moments->mean = shift + sum / moments->count;
+        moments->m2 = Max(0.0, squares - sum * sum / moments->count);
+    }
+}
+
+/* Moments of the chunks, merged pairwise on the calling thread */
+static dsp_stats_moments dsp_stats_gather(dsp_t* buf, int len)
+{
+    int c;
+    dsp_stats_moments_args arguments;
+    arguments.buf = buf;
+    arguments.len = len;
+    arguments.chunks = dsp_stats_chunks(len);
+    arguments.moments = (dsp_stats_moments*)malloc(sizeof(dsp_stats_moments) * arguments.chunks);
+    dsp_parallel_for(arguments.chunks, 1, dsp_stats_moments_chunk, &arguments);
+    dsp_stats_moments total = arguments.moments[0];
+    for(c = 1; c < arguments.chunks; c++) {
+        dsp_stats_moments* moments = &arguments.moments[c];
+        double count = (double)total.count + moments->count;
+        double delta = moments->mean - total.mean;
+        total.mean += delta * moments->count / count;
+        total.m2 += moments->m2 + delta * delta * total.count * moments->count / count;
+        total.count += moments->count;
+        total.integer &= moments->integer;
+        total.min = Min(moments->min, total.min);
+        total.max = Max(moments->max, total.max);
+    }
+    free(arguments.moments);
+    return total;
+}
+
+static int dsp_stats_countable(dsp_stats_moments* moments)
+{
+    return moments->integer && (double)moments->max - moments->min < DSP_STATS_COUNTS_RANGE;
+}
+
+dsp_t dsp_stats_percentile(dsp_t* buf, int len, double fraction)
+{
+    if(buf == NULL || len < 1)
+        return 0;
+    long k = (long)(Max(0.0, Min(1.0, fraction)) * (len - 1));
+    dsp_stats_moments moments = dsp_stats_gather(buf, len);
+    if(dsp_stats_countable(&moments)) {
+        long base = (long)moments.min;
+        int range = (int)((long)moments.max - base + 1);
+        unsigned int* counts = dsp_stats_count(buf, len, base, range);
+        dsp_t value = (dsp_t)(base + dsp_stats_counts_rank(counts, range, k));
+        free(counts);
+        return value;
+    }
+    dsp_t* tmp = (dsp_t*)malloc(sizeof(dsp_t) * len);
+    memcpy(tmp, buf, sizeof(dsp_t) * len);
+    dsp_t value = dsp_buffer_select(tmp, len, (int)k);
+    free(tmp);
+    return value;
+}
+
+dsp_stats_summary dsp_stats_summarize(dsp_t* buf, int len)
+{
+    dsp_stats_summary summary;
+    memset(&summary, 0, sizeof(summary));
+    if(buf == NULL || len < 1)
+        return summary;
+    int k;
+    long rank = (len - 1) / 2;
+    dsp_stats_moments moments = dsp_stats_gather(buf, len);
+    summary.min = moments.min;
+    summary.max = moments.max;
+    summary.mean = moments.mean;
+    summary.stddev = sqrt(moments.m2 / len);
+    if(dsp_stats_countable(&moments)) {
+        long base = (long)moments.min;
+        int range = (int)((long)moments.max - base + 1);
+        unsigned int* counts = dsp_stats_count(buf, len, base, range);
+        int median = dsp_stats_counts_rank(counts, range, rank);
+        summary.median = (dsp_t)(base + median);
+        summary.mad = (dsp_t)dsp_stats_counts_deviation(counts, range, median, rank);
+        free(counts);
+        return summary;
+    }
+    dsp_t* tmp = (dsp_t*)malloc(sizeof(dsp_t) * len);
+    memcpy(tmp, buf, sizeof(dsp_t) * len);
+    summary.median = dsp_buffer_select(tmp, len, (int)rank);
+    for(k = 0; k < len; k++)
+        tmp[k] = fabs(buf[k] - summary.median);
+    summary.mad = dsp_buffer_select(tmp, len, (int)rank);
+    free(tmp);
+    return summary;
+}
+
+dsp_t dsp_simd_min(dsp_t* buf, int len)
+{
+    int k = 0;
+    dsp_t min = buf[0];
+    if(len >= DSP_VEC_LANES) {
+        dsp_vec_t lanes = dsp_vec_load(buf);
+        for(k = DSP_VEC_LANES; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+            lanes = dsp_vec_min(dsp_vec_load(&buf[k]), lanes);
+        int i;
+        for(i = 0; i < DSP_VEC_LANES; i++)
+            min = Min(lanes[i], min);
+    }
+    for(; k < len; k++)
+        min = Min(buf[k], min);
+    return min;
+}
+
+dsp_t dsp_simd_max(dsp_t* buf, int len)
+{
+    int k = 0;
+    dsp_t max = buf[0];
+    if(len >= DSP_VEC_LANES) {
+        dsp_vec_t lanes = dsp_vec_load(buf);
+        for(k = DSP_VEC_LANES; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+            lanes = dsp_vec_max(dsp_vec_load(&buf[k]), lanes);
+        int i;
+        for(i = 0; i < DSP_VEC_LANES; i++)
+            max = Max(lanes[i], max);
+    }
+    for(; k < len; k++)
+        max = Max(buf[k], max);
+    return max;
+}
+
+double dsp_simd_mean(dsp_t* buf, int len)
+{
+    typedef double dsp_vec_sum_t __attribute__((vector_size(sizeof(double) * DSP_VEC_LANES)));
+    dsp_vec_sum_t lanes = { 0 };
+    double mean = 0;
+    int k;
+    for(k = 0; k + DSP_VEC_LANES <= len; k += DSP_VEC_LANES)
+        lanes += __builtin_convertvector(dsp_vec_load(&buf[k]), dsp_vec_sum_t);
+    int i;
+    for(i = 0; i < DSP_VEC_LANES; i++)
+        mean += lanes[i];
+    for(; k < len; k++)
+        mean += buf[k];
+    mean /= len;
+    return mean;
+}
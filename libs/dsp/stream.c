@@ -449,17 +449,57 @@ void dsp_stream_del_triangle(dsp_stream_p stream, int index)
  * @return
  */
 int* dsp_stream_get_position(dsp_stream_p stream, int index) {
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_position_at(stream, index, pos);
+    return pos;
+}
+
+/**
+ * @brief dsp_stream_position_at
+ * @param stream
+ * @param index
+ * @param pos
+ */
+void dsp_stream_position_at(dsp_stream_p stream, int index, int* pos) {
     int dim = 0;
     int y = 0;
     int m = 1;
-    int* pos = (int*)malloc(sizeof(int) * stream->dims);
     for (dim = 0; dim < stream->dims; dim++) {
         y = index / m;
         y %= stream->sizes[dim];
         m *= stream->sizes[dim];
         pos[dim] = y;
     }
-    return pos;
+}
+
+/**
+ * @brief dsp_stream_position_next
+ * @param stream
+ * @param pos
+ * @return
+ */
+int dsp_stream_position_next(dsp_stream_p stream, int* pos) {
+    int dim = 0;
+    for (dim = 0; dim < stream->dims; dim++) {
+        if(++pos[dim] < stream->sizes[dim])
+            return dim;
+        pos[dim] = 0;
+    }
+    return -1;
+}
+
+/**
+ * @brief dsp_stream_get_strides
+ * @param stream
+ * @param strides
+ */
+void dsp_stream_get_strides(dsp_stream_p stream, int* strides) {
+    int dim = 0;
+    int m = 1;
+    for (dim = 0; dim < stream->dims; dim++) {
+        strides[dim] = m;
+        m *= stream->sizes[dim];
+    }
 }
 
 /**
@@ -479,22 +519,17 @@ int dsp_stream_set_position(dsp_stream_p stream, int* pos) {
     return index;
 }
 
-static void* dsp_stream_align_th(void* arg)
+static void dsp_stream_align_tile(void* arg, int start, int end)
 {
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-    } *arguments = arg;
-    dsp_stream_p stream = arguments->stream;
+    dsp_stream_p stream = arg;
     dsp_stream_p in = stream->parent;
-    int cur_th = arguments->cur_th;
-    int start = cur_th * stream->len / dsp_max_threads(0);
-    int end = start + stream->len / dsp_max_threads(0);
-    end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int* cur = (int*)malloc(sizeof(int) * stream->dims);
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_position_at(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int *pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         int dim;
         for (dim = 1; dim < stream->dims; dim++) {
             pos[dim] -= stream->align_info.center[dim];
@@ -516,11 +551,11 @@ static void* dsp_stream_align_th(void* arg)
             pos[dim-1] += stream->align_info.center[dim-1];
         }
         int x = dsp_stream_set_position(in, pos);
-        free(pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] = in->buf[x];
     }
-    return NULL;
+    free(pos);
+    free(cur);
 }
 
 void dsp_stream_align(dsp_stream_p in)
@@ -528,20 +563,7 @@ void dsp_stream_align(dsp_stream_p in)
     dsp_stream_p stream = dsp_stream_copy(in);
     dsp_buffer_set(stream->buf, stream->len, 0);
     stream->parent = in;
-    size_t y;
-    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++) {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].stream = stream;
-        pthread_create(&th[y], NULL, dsp_stream_align_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_parallel_for(stream->len, 0, dsp_stream_align_tile, stream);
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
@@ -552,22 +574,17 @@ void dsp_stream_align(dsp_stream_p in)
  * @param in
  */
 
-static void* dsp_stream_crop_th(void* arg)
+static void dsp_stream_crop_tile(void* arg, int start, int end)
 {
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-    } *arguments = arg;
-    dsp_stream_p stream = arguments->stream;
+    dsp_stream_p stream = arg;
     dsp_stream_p in = stream->parent;
-    int cur_th = arguments->cur_th;
-    int start = cur_th * stream->len / dsp_max_threads(0);
-    int end = start + stream->len / dsp_max_threads(0);
-    end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int* cur = (int*)malloc(sizeof(int) * stream->dims);
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_position_at(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int *pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         int dim;
         int allow = 1;
         for (dim = 0; dim < stream->dims; dim++) {
@@ -581,9 +598,9 @@ static void* dsp_stream_crop_th(void* arg)
         }
         else
             stream->buf[y] = 0;
-        free(pos);
     }
-    return NULL;
+    free(pos);
+    free(cur);
 }
 
 void dsp_stream_crop(dsp_stream_p in)
@@ -591,20 +608,7 @@ void dsp_stream_crop(dsp_stream_p in)
     dsp_stream_p stream = dsp_stream_copy(in);
     dsp_buffer_set(stream->buf, stream->len, 0);
     stream->parent = in;
-    size_t y;
-    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++) {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].stream = stream;
-        pthread_create(&th[y], NULL, dsp_stream_crop_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_parallel_for(stream->len, 0, dsp_stream_crop_tile, stream);
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
@@ -630,26 +634,22 @@ void dsp_stream_translate(dsp_stream_p in)
 }
 
 /**
- * @brief dsp_stream_scale_th
+ * @brief dsp_stream_scale_tile
  * @param arg
- * @return
+ * @param start
+ * @param end
  */
-static void* dsp_stream_scale_th(void* arg)
+static void dsp_stream_scale_tile(void* arg, int start, int end)
 {
-    struct {
-        int cur_th;
-        dsp_stream_p stream;
-     } *arguments = arg;
-    dsp_stream_p stream = arguments->stream;
+    dsp_stream_p stream = arg;
     dsp_stream_p in = stream->parent;
-    int cur_th = arguments->cur_th;
-    int start = cur_th * stream->len / dsp_max_threads(0);
-    int end = start + stream->len / dsp_max_threads(0);
-    end = Min(stream->len, end);
     int y, d;
-    for(y = start; y < end; y++)
+    int* cur = (int*)malloc(sizeof(int) * stream->dims);
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_position_at(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int* pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         double factor = 0.0;
         for(d = 0; d < stream->dims; d++) {
             pos[d] -= stream->align_info.center[d];
@@ -661,9 +661,9 @@ static void* dsp_stream_scale_th(void* arg)
         int x = dsp_stream_set_position(in, pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] += in->buf[x]/(factor*stream->dims);
-        free(pos);
     }
-    return NULL;
+    free(pos);
+    free(cur);
 }
 
 void dsp_stream_scale(dsp_stream_p in)
@@ -671,41 +671,23 @@ void dsp_stream_scale(dsp_stream_p in)
     dsp_stream_p stream = dsp_stream_copy(in);
     dsp_buffer_set(stream->buf, stream->len, 0);
     stream->parent = in;
-    size_t y;
-    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++) {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].stream = stream;
-        pthread_create(&th[y], NULL, dsp_stream_scale_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_parallel_for(stream->len, 0, dsp_stream_scale_tile, stream);
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
 }
 
-static void* dsp_stream_rotate_th(void* arg)
+static void dsp_stream_rotate_tile(void* arg, int start, int end)
 {
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-    } *arguments = arg;
-    dsp_stream_p stream = arguments->stream;
+    dsp_stream_p stream = arg;
     dsp_stream_p in = stream->parent;
-    int cur_th = arguments->cur_th;
-    int start = cur_th * stream->len / dsp_max_threads(0);
-    int end = start + stream->len / dsp_max_threads(0);
-    end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int* cur = (int*)malloc(sizeof(int) * stream->dims);
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_position_at(stream, start, cur);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, cur))
     {
-        int *pos = dsp_stream_get_position(stream, y);
+        memcpy(pos, cur, sizeof(int) * stream->dims);
         int dim;
         for (dim = 1; dim < stream->dims; dim++) {
             pos[dim] -= stream->align_info.center[dim];
@@ -721,11 +703,11 @@ static void* dsp_stream_rotate_th(void* arg)
             pos[dim-1] += stream->align_info.center[dim-1];
         }
         int x = dsp_stream_set_position(in, pos);
-        free(pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] = in->buf[x];
     }
-    return NULL;
+    free(pos);
+    free(cur);
 }
 
 void dsp_stream_rotate(dsp_stream_p in)
@@ -733,20 +715,7 @@ void dsp_stream_rotate(dsp_stream_p in)
     dsp_stream_p stream = dsp_stream_copy(in);
     dsp_buffer_set(stream->buf, stream->len, 0);
     stream->parent = in;
-    size_t y;
-    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++) {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].stream = stream;
-        pthread_create(&th[y], NULL, dsp_stream_rotate_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_parallel_for(stream->len, 0, dsp_stream_rotate_tile, stream);
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
@@ -767,52 +736,37 @@ static double stack_delegate_subtraction(double x, double y)
     return fmax(0.0, x - y);
 }
 
-static void* dsp_stream_stack_th(void* arg)
+typedef struct {
+    dsp_stream_p stream;
+    double(*delegate)(double, double);
+} dsp_stream_stack_args;
+
+static void dsp_stream_stack_tile(void* arg, int start, int end)
 {
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-       double(*delegate)(double, double);
-    } *arguments = arg;
+    dsp_stream_stack_args *arguments = arg;
     double(*delegate)(double, double) = arguments->delegate;
     dsp_stream_p stream = arguments->stream;
     dsp_stream_p in = stream->parent;
-    int cur_th = arguments->cur_th;
-    int start = cur_th * stream->len / dsp_max_threads(0);
-    int end = start + stream->len / dsp_max_threads(0);
-    end = Min(stream->len, end);
     int y;
-    for(y = start; y < end; y++)
+    int* pos = (int*)malloc(sizeof(int) * stream->dims);
+    dsp_stream_position_at(stream, start, pos);
+    for(y = start; y < end; y++, dsp_stream_position_next(stream, pos))
     {
-        int *pos = dsp_stream_get_position(stream, y);
         int x = dsp_stream_set_position(in, pos);
-        free(pos);
         if(x >= 0 && x < in->len)
             stream->buf[y] = delegate(stream->buf[y], in->buf[x]);
     }
-    return NULL;
+    free(pos);
 }
 
 void dsp_stream_sum(dsp_stream_p in, dsp_stream_p str)
 {
     dsp_stream_p stream = dsp_stream_copy(in);
     stream->parent = str;
-    size_t y;
-    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-       double(*delegate)(double, double);
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++) {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].stream = stream;
-        thread_arguments[y].delegate = stack_delegate_sum;
-        pthread_create(&th[y], NULL, dsp_stream_stack_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_stream_stack_args arguments;
+    arguments.stream = stream;
+    arguments.delegate = stack_delegate_sum;
+    dsp_parallel_for(stream->len, 0, dsp_stream_stack_tile, &arguments);
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
@@ -822,22 +776,10 @@ void dsp_stream_multiply(dsp_stream_p in, dsp_stream_p str)
 {
     dsp_stream_p stream = dsp_stream_copy(in);
     stream->parent = str;
-    size_t y;
-    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-       double(*delegate)(double, double);
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++) {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].stream = stream;
-        thread_arguments[y].delegate = stack_delegate_multiply;
-        pthread_create(&th[y], NULL, dsp_stream_stack_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_stream_stack_args arguments;
+    arguments.stream = stream;
+    arguments.delegate = stack_delegate_multiply;
+    dsp_parallel_for(stream->len, 0, dsp_stream_stack_tile, &arguments);
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
@@ -847,22 +789,10 @@ void dsp_stream_subtract(dsp_stream_p in, dsp_stream_p str)
 {
     dsp_stream_p stream = dsp_stream_copy(in);
     stream->parent = str;
-    size_t y;
-    pthread_t *th = (pthread_t*)malloc(sizeof(pthread_t)*dsp_max_threads(0));
-    struct {
-       int cur_th;
-       dsp_stream_p stream;
-       double(*delegate)(double, double);
-    } thread_arguments[dsp_max_threads(0)];
-    for(y = 0; y < dsp_max_threads(0); y++) {
-        thread_arguments[y].cur_th = y;
-        thread_arguments[y].stream = stream;
-        thread_arguments[y].delegate = stack_delegate_subtraction;
-        pthread_create(&th[y], NULL, dsp_stream_stack_th, &thread_arguments[y]);
-    }
-    for(y = 0; y < dsp_max_threads(0); y++)
-        pthread_join(th[y], NULL);
-    free(th);
+    dsp_stream_stack_args arguments;
+    arguments.stream = stream;
+    arguments.delegate = stack_delegate_subtraction;
+    dsp_parallel_for(stream->len, 0, dsp_stream_stack_tile, &arguments);
     dsp_buffer_copy(stream->buf, in->buf, stream->len);
     dsp_stream_free_buffer(stream);
     dsp_stream_free(stream);
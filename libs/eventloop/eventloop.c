@@ -32,7 +32,11 @@
  #define MAIN_TEST for a stand-alone test program.
  */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,11 +49,22 @@
 #include <sys/select.h>
 #endif
 
+/* descriptors are watched with epoll or kqueue where there is one, select elsewhere */
+#if defined(__linux__)
+#define EVENTLOOP_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define EVENTLOOP_KQUEUE
+#include <sys/event.h>
+#endif
+
 #include "eventloop.h"
 
 /* info about one registered callback.
  * the malloced array cback is never shrunk, entries are reused. new id's are
- * the index of first unused slot in array (and thus reused like unix' open(2)).
+ * the index of the last freed slot in array, or a new one at its end.
  */
 typedef struct
 {
@@ -57,29 +72,45 @@ typedef struct
     int fd;     /* fd descriptor to watch for read */
     void *ud;   /* user's data handle */
     CBF *fp;    /* callback function */
+    int next;   /* next callback on the same fd if in_use, else next free slot. -1 ends */
 } CB;
 static CB *cback;    /* malloced list of callbacks */
 static int ncback;   /* n entries in cback[] */
 static int ncbinuse; /* n entries in cback[] marked in_use */
-static int lastcb;   /* cback index of last cb called */
+static int freecb = -1; /* first free slot of cback[] */
+
+/* callbacks registered on each fd, indexed by fd */
+typedef struct
+{
+    int first;  /* cback index of the first callback on this fd, -1 if none */
+    int always; /* the poller refused fd (regular file): it is always ready, as with select */
+} FW;
+static FW *fdwatch;  /* malloced, grown to the highest fd seen */
+static int nfdwatch; /* n entries in fdwatch[] */
+static int nalways;  /* n entries in fdwatch[] with always set and first >= 0 */
 
 /* info about one registered timer function.
- * the entries are kept sorted by increasing time from epoch, ie,
- *   the next entry to fire is at the begin of the list.
+ * the entries are kept in a binary heap ordered by trigger time, ie,
+ *   the next entry to fire is at the top, and hashed by id.
  */
 typedef struct TF
 {
-    double tgo;       /* trigger time, ms from epoch */
-    int interval;     /* repeat timer if interval > 0, ms */
+    int64_t tgo;      /* trigger time, ns from an arbitrary origin (see nowns) */
+    unsigned long seq;/* insertion order, timers due at the same time fire in that order */
+    int64_t interval; /* repeat timer if interval > 0, ns. the next trigger time is tgo + interval */
     void *ud;         /* user's data handle */
     TCF *fp;          /* timer function */
     int tid;          /* unique id for this timer */
-    struct TF *next;  /* pointer to next item */
+    int pos;          /* index in theap[] */
+    struct TF *next;  /* next item in the same hash bucket */
 } TF;
-static TF  timefunc_null = {0, 0, NULL, NULL, 0, NULL};
-static TF *timefunc = &timefunc_null;  /* list of timer functions */
+static TF **theap;          /* malloced heap of timer functions */
+static int ntimers;         /* n entries in theap[] */
+static int theapsize;       /* n entries allocated in theap[] */
+static TF **tbuckets;       /* malloced hash of timer functions by tid */
+static int ntbuckets;       /* n entries in tbuckets[], a power of 2 */
+static unsigned long tseq;  /* source of TF.seq */
 static int tid = 0;    /* source of unique timer ids */
-#define EPOCHDT(tp) /* ms from epoch to timeval *tp */ (((tp)->tv_usec) / 1000.0 + ((tp)->tv_sec) * 1000.0)
 
 /* info about one registered work procedure.
  * the malloced array wproc is never shrunk, entries are reused. new id's are
@@ -96,12 +127,50 @@ static int nwproc;   /* n entries in wproc[] */
 static int nwpinuse; /* n entries in wproc[] marked in-use */
 static int lastwp;   /* wproc index of last workproc called*/
 
+/* the poller: an epoll or kqueue instance, opened on first use.
+ * neither is usable across fork, so a child opens its own.
+ */
+#if defined(EVENTLOOP_EPOLL) || defined(EVENTLOOP_KQUEUE)
+static int pollfd = -1;
+#endif
+#ifndef _WIN32
+static pid_t pollpid;
+#endif
+
+/* work posted from other threads, see postToEventLoop().
+ * multiple producers, single consumer queue: producers swap themselves in at
+ * postedHead, the loop pops at postedTail.
+ */
+typedef struct Posted
+{
+    TCF *fp;
+    void *ud;
+    struct Posted * _Atomic next;
+} Posted;
+static Posted postedStub;
+static Posted * _Atomic postedHead = &postedStub;
+static Posted *postedTail = &postedStub;
+static atomic_int nposted;          /* n entries pushed and not popped yet */
+static atomic_int wakePending;      /* wakefd was written to since the loop last looked at the queue */
+static int wakefd = -1;             /* the loop watches it, an eventfd or the read end of a pipe */
+static atomic_int wakewfd = -1;     /* posting threads write to it, -1 until the loop opened it */
+#ifdef EVENTLOOP_EPOLL
+static int timerfd = -1;     /* wakes epoll_wait at the next timer, to the ns */
+static int64_t timerarmed;   /* trigger time timerfd is set to, 0 if none */
+#endif
+
+/* fds found ready by the last poll */
+#define MAXREADY 64
+static int readyfds[MAXREADY];
+static int nready;
+
 static void runWorkProc(void);
-static void callCallback(fd_set *rfdp);
+static void callCallbacks(int fd);
 static void checkTimer();
 static void oneLoop(void);
 static void deferTO(void *p);
 static void runImmediates();
+static void runPosted();
 
 /* inf loop to dispatch callbacks, work procs and timers as necessary.
  * never returns.
@@ -159,32 +228,188 @@ int deferLoop0(int maxms, int *flagp)
     return (0);
 }
 
+/* start watching fd with the poller.
+ * return 0 if it refused fd, which is then to be reported ready on every loop.
+ */
+static int pollWatch(int fd)
+{
+#if defined(EVENTLOOP_EPOLL)
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events  = EPOLLIN;
+    ev.data.fd = fd;
+    /* already there is fine: fd may have been closed and reused under its callback */
+    if (epoll_ctl(pollfd, EPOLL_CTL_ADD, fd, &ev) < 0 && errno != EEXIST)
+        return 0;
+#elif defined(EVENTLOOP_KQUEUE)
+    struct kevent ev;
+    EV_SET(&ev, fd, EVFILT_READ, EV_ADD, 0, 0, NULL);
+    if (kevent(pollfd, &ev, 1, NULL, 0, NULL) < 0)
+        return 0;
+#else
+    (void)fd;
+#endif
+    return 1;
+}
+
+/* stop watching fd with the poller. it may be closed already */
+static void pollUnwatch(int fd)
+{
+#if defined(EVENTLOOP_EPOLL)
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(pollfd, EPOLL_CTL_DEL, fd, &ev);
+#elif defined(EVENTLOOP_KQUEUE)
+    struct kevent ev;
+    EV_SET(&ev, fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+    kevent(pollfd, &ev, 1, NULL, 0, NULL);
+#else
+    (void)fd;
+#endif
+}
+
+#ifndef _WIN32
+/* open wakefd. one inherited across fork would wake the parent too */
+static void wakeOpen()
+{
+    int fds[2];
+
+    if (wakefd >= 0)
+    {
+        int wfd = atomic_exchange(&wakewfd, -1);
+        if (wfd != wakefd)
+            close(wfd);
+        close(wakefd);
+    }
+
+#ifdef EVENTLOOP_EPOLL
+    fds[0] = fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fds[0] < 0)
+#else
+    if (pipe(fds) < 0 || fcntl(fds[0], F_SETFL, O_NONBLOCK) < 0 || fcntl(fds[1], F_SETFL, O_NONBLOCK) < 0 ||
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC) < 0 || fcntl(fds[1], F_SETFD, FD_CLOEXEC) < 0)
+#endif
+    {
+        perror("eventloop wakeup");
+        exit(1);
+    }
+
+    wakefd = fds[0];
+    atomic_store(&wakePending, 0);
+    atomic_store(&wakewfd, fds[1]);
+}
+
+/* drain wakefd, the loop looks at the queue next */
+static void wakeDrain()
+{
+    char buf[64];
+    while (read(wakefd, buf, sizeof(buf)) > 0)
+        ;
+}
+#endif
+
+/* open the poller if this process has none yet, and watch every fd with a callback */
+static void pollOpen()
+{
+#ifndef _WIN32
+    if (pollpid == getpid())
+        return;
+    pollpid = getpid();
+    wakeOpen();
+#endif
+
+#if defined(EVENTLOOP_EPOLL) || defined(EVENTLOOP_KQUEUE)
+    int fd;
+
+#if defined(EVENTLOOP_EPOLL)
+    /* a kqueue is not inherited, its number may belong to another file in a child */
+    if (pollfd >= 0)
+        close(pollfd);
+    if (timerfd >= 0)
+        close(timerfd);
+    pollfd = epoll_create1(EPOLL_CLOEXEC);
+    timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    timerarmed = 0;
+    if (pollfd < 0 || timerfd < 0)
+    {
+        perror("epoll");
+        exit(1);
+    }
+    pollWatch(timerfd);
+#else
+    pollfd = kqueue();
+    if (pollfd < 0)
+    {
+        perror("kqueue");
+        exit(1);
+    }
+#endif
+    pollWatch(wakefd);
+
+    for (fd = 0; fd < nfdwatch; fd++)
+        if (fdwatch[fd].first >= 0 && !fdwatch[fd].always && !pollWatch(fd))
+        {
+            fdwatch[fd].always = 1;
+            nalways++;
+        }
+#endif
+}
+
 /* register a new callback, fp, to be called with ud as arg when fd is ready.
  * return a unique callback id for use with rmCallback().
  */
 int addCallback(int fd, CBF *fp, void *ud)
 {
     CB *cp;
+    int cid;
 
-    /* reuse first unused slot or grow */
-    for (cp = cback; cp < &cback[ncback]; cp++)
-        if (!cp->in_use)
-            break;
-    if (cp == &cback[ncback])
+    pollOpen();
+
+    /* reuse last freed slot or grow */
+    if (freecb >= 0)
+    {
+        cid    = freecb;
+        freecb = cback[cid].next;
+    }
+    else
     {
         cback = realloc(cback, (ncback + 1) * sizeof(CB));
-        cp    = &cback[ncback++];
+        cid   = ncback++;
+    }
+
+    if (fd >= nfdwatch)
+    {
+        int n = nfdwatch ? nfdwatch : 16;
+        while (n <= fd)
+            n *= 2;
+        fdwatch = realloc(fdwatch, n * sizeof(FW));
+        for (; nfdwatch < n; nfdwatch++)
+        {
+            fdwatch[nfdwatch].first  = -1;
+            fdwatch[nfdwatch].always = 0;
+        }
     }
 
     /* init new entry */
+    cp         = &cback[cid];
     cp->in_use = 1;
     cp->fp     = fp;
     cp->ud     = ud;
     cp->fd     = fd;
+    cp->next   = fdwatch[fd].first;
     ncbinuse++;
 
+    if (fdwatch[fd].first < 0)
+    {
+        fdwatch[fd].always = !pollWatch(fd);
+        nalways += fdwatch[fd].always;
+    }
+    else if (!fdwatch[fd].always)
+        pollWatch(fd);
+    fdwatch[fd].first = cid;
+
     /* id is index into array */
-    return (cp - cback);
+    return (cid);
 }
 
 /* remove the callback with the given id, as returned from addCallback().
@@ -193,6 +418,7 @@ int addCallback(int fd, CBF *fp, void *ud)
 void rmCallback(int cid)
 {
     CB *cp;
+    int *link;
 
     /* validate id */
     if (cid < 0 || cid >= ncback)
@@ -201,39 +427,168 @@ void rmCallback(int cid)
     if (!cp->in_use)
         return;
 
+    /* unlink from callbacks of its fd */
+    for (link = &fdwatch[cp->fd].first; *link != cid; link = &cback[*link].next)
+        ;
+    *link = cp->next;
+    if (fdwatch[cp->fd].first < 0)
+    {
+        if (fdwatch[cp->fd].always)
+        {
+            fdwatch[cp->fd].always = 0;
+            nalways--;
+        }
+        else
+        {
+            pollOpen();
+            pollUnwatch(cp->fd);
+        }
+    }
+
     /* mark for reuse */
     cp->in_use = 0;
+    cp->next   = freecb;
+    freecb     = cid;
     ncbinuse--;
 }
 
-/* insert maintaining sort */
+/* ns from an arbitrary origin, not affected by changes to the system time where possible */
+static int64_t nowns()
+{
+#if defined(CLOCK_MONOTONIC) && !defined(_WIN32)
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (int64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#else
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return (int64_t)t.tv_sec * 1000000000 + (int64_t)t.tv_usec * 1000;
+#endif
+}
+
+/* whether timer a is to run before timer b */
+static int timerBefore(const TF *a, const TF *b)
+{
+    return a->tgo < b->tgo || (a->tgo == b->tgo && a->seq < b->seq);
+}
+
+static void heapSet(int pos, TF *node)
+{
+    theap[pos] = node;
+    node->pos  = pos;
+}
+
+/* move the timer at pos up or down to its place in the heap */
+static void heapFix(int pos)
+{
+    TF *node = theap[pos];
+
+    while (pos > 0 && timerBefore(node, theap[(pos - 1) / 2]))
+    {
+        heapSet(pos, theap[(pos - 1) / 2]);
+        pos = (pos - 1) / 2;
+    }
+
+    for (;;)
+    {
+        int child = 2 * pos + 1;
+        if (child >= ntimers)
+            break;
+        if (child + 1 < ntimers && timerBefore(theap[child + 1], theap[child]))
+            child++;
+        if (!timerBefore(theap[child], node))
+            break;
+        heapSet(pos, theap[child]);
+        pos = child;
+    }
+
+    heapSet(pos, node);
+}
+
+/* insert maintaining heap order */
 static void insertTimer(TF *node)
 {
-    TF *it = timefunc;
+    if (ntimers == theapsize)
+    {
+        theapsize = theapsize ? 2 * theapsize : 16;
+        theap     = (TF **)realloc(theap, theapsize * sizeof(TF *));
+    }
+    node->seq = tseq++;
+    heapSet(ntimers++, node);
+    heapFix(node->pos);
+}
+
+/* remove from heap */
+static void dettachTimer(TF *node)
+{
+    int pos = node->pos;
 
-    for(; ; it = it->next)
+    if (--ntimers > pos)
     {
-        if (it->next == NULL || node->tgo < it->next->tgo)
+        heapSet(pos, theap[ntimers]);
+        heapFix(pos);
+    }
+}
+
+/* add to hash by id, growing it along the number of timers */
+static void hashTimer(TF *node)
+{
+    if (ntimers >= ntbuckets)
+    {
+        int n = ntbuckets ? 2 * ntbuckets : 16;
+        TF **buckets = (TF **)calloc(n, sizeof(TF *));
+        int i;
+
+        for (i = 0; i < ntbuckets; i++)
         {
-            node->next = it->next;
-            it->next = node;
-            break;
+            TF *it, *next;
+            for (it = tbuckets[i]; it != NULL; it = next)
+            {
+                next = it->next;
+                it->next = buckets[it->tid & (n - 1)];
+                buckets[it->tid & (n - 1)] = it;
+            }
         }
+        free(tbuckets);
+        tbuckets  = buckets;
+        ntbuckets = n;
     }
+
+    node->next = tbuckets[node->tid & (ntbuckets - 1)];
+    tbuckets[node->tid & (ntbuckets - 1)] = node;
 }
 
-/* register a new timer function, fp, to be called with ud as arg after ms
- * milliseconds. add to list in order of increasing time from epoch, ie,
- * first entry runs soonest. return id for use with rmTimer().
+/* find the timer by id, and the link to it in its bucket */
+static TF *findTimerLink(int timer_id, TF ***link)
+{
+    TF **it;
+
+    if (ntbuckets == 0)
+        return NULL;
+    for (it = &tbuckets[timer_id & (ntbuckets - 1)]; *it != NULL; it = &(*it)->next)
+        if ((*it)->tid == timer_id)
+        {
+            if (link)
+                *link = it;
+            return *it;
+        }
+    return NULL;
+}
+
+/* find the timer by id */
+static TF *findTimer(int timer_id)
+{
+    return findTimerLink(timer_id, NULL);
+}
+
+/* register a new timer function, fp, to be called with ud as arg after delay
+ * ns, then every interval ns if not 0. add to heap in order of increasing
+ * trigger time, ie, first entry runs soonest. return id for use with rmTimer().
  */
-static int addTimerImpl(int delay, int interval, TCF *fp, void *ud)
+static int addTimerImpl(int64_t delay, int64_t interval, TCF *fp, void *ud)
 {
-    struct timeval t;
     TF *node;
 
-    /* get time now */
-    gettimeofday(&t, NULL);
-
     /* create entry */
     node = (TF*)malloc(sizeof(TF));
 
@@ -241,47 +596,36 @@ static int addTimerImpl(int delay, int interval, TCF *fp, void *ud)
     node->ud  = ud;
     node->fp  = fp;
     node->tid = ++tid; /* store new unique id */
-    node->tgo = EPOCHDT(&t) + delay;
+    node->tgo = nowns() + delay;
     node->interval = interval;
 
     insertTimer(node);
+    hashTimer(node);
 
     return node->tid;
 }
 
 int addTimer(int ms, TCF *fp, void *ud)
 {
-    return addTimerImpl(ms, 0, fp, ud);
+    return addTimerImpl((int64_t)ms * 1000000, 0, fp, ud);
 }
 
 int addPeriodicTimer(int ms, TCF *fp, void *ud)
 {
-    return addTimerImpl(ms, ms, fp, ud);
+    return addTimerImpl((int64_t)ms * 1000000, (int64_t)ms * 1000000, fp, ud);
 }
 
-/* find the timer and remove from list */
-static TF *dettachTimer(TF *node)
+int addTimerNs(int64_t ns, TCF *fp, void *ud)
 {
-    TF *it = timefunc;
-    for(; it->next != NULL; it = it->next)
-    {
-        if (it->next == node)
-        {
-            it->next = node->next;
-            return node;
-        }
-    }
-    return NULL;
+    return addTimerImpl(ns, 0, fp, ud);
 }
 
-/* find the timer by id */
-static TF *findTimer(int timer_id)
+int addPeriodicTimerUs(int64_t us, TCF *fp, void *ud)
 {
-    TF *it = timefunc->next;
-    for(; it != NULL; it = it->next)
-        if (it->tid == timer_id)
-            return it;
-    return NULL;
+    /* a period of 0 would never let the loop go */
+    if (us <= 0)
+        us = 1;
+    return addTimerImpl(us * 1000, us * 1000, fp, ud);
 }
 
 /* remove the timer with the given id, as returned from addTimer().
@@ -289,24 +633,21 @@ static TF *findTimer(int timer_id)
  */
 void rmTimer(int timer_id)
 {
-    TF *node, *it = timefunc;
-    for(; (node = it->next) != NULL; it = it->next)
-    {
-        if (node->tid == timer_id)
-        {
-            it->next = node->next;
-            free(node);
-            break;
-        }
-    }
+    TF **link;
+    TF *node = findTimerLink(timer_id, &link);
+
+    if (node == NULL)
+        return;
+
+    *link = node->next;
+    dettachTimer(node);
+    free(node);
 }
 
-/* Returns the timer's remaining value in milliseconds left until the timeout. */
-static double remainingTimerNode(TF *node)
+/* Returns the timer's remaining value in nanoseconds left until the timeout. */
+static int64_t remainingTimerNode(TF *node)
 {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    return (node->tgo - EPOCHDT(&now));
+    return (node->tgo - nowns());
 }
 
 /* Returns the timer's remaining value in milliseconds left until the timeout.
@@ -315,7 +656,7 @@ static double remainingTimerNode(TF *node)
 int remainingTimer(int timer_id)
 {
     TF *it = findTimer(timer_id);
-    return it == NULL ? -1 : remainingTimerNode(it);
+    return it == NULL ? -1 : remainingTimerNode(it) / 1000000;
 }
 
 /* Returns the timer's remaining value in nanoseconds left until the timeout.
@@ -324,7 +665,7 @@ int remainingTimer(int timer_id)
 int64_t nsecsRemainingTimer(int timer_id)
 {
     TF *it = findTimer(timer_id);
-    return it == NULL ? -1 : remainingTimerNode(it) * 1000000;
+    return it == NULL ? -1 : remainingTimerNode(it);
 }
 
 /* add a new work procedure, fp, to be called with ud when nothing else to do.
@@ -393,118 +734,232 @@ static void runWorkProc()
     (*wp->fp)(wp->ud);
 }
 
-/* run next callback whose fd is listed as ready to go in rfdp */
-static void callCallback(fd_set *rfdp)
+/* run the callbacks registered on fd, which is ready.
+ * they may add and remove callbacks, those removed on the way are skipped.
+ */
+static void callCallbacks(int fd)
 {
-    CB *cp;
+    int cid, next;
 
-    /* skip if list is empty */
-    if (!ncbinuse)
-        return;
+    for (cid = fd < nfdwatch ? fdwatch[fd].first : -1; cid >= 0; cid = next)
+    {
+        CB *cp = &cback[cid];
+        next = cp->next;
+        if (!cp->in_use || cp->fd != fd)
+            continue;
+        (*cp->fp)(fd, cp->ud);
+        runImmediates();
+    }
+}
 
-    /* find next */
-    do
+/* run the timer callbacks whose time has come, if any. all we have to do
+ * is check the top of the heap, the entry that runs soonest. those that
+ * become due while running wait for the next loop.
+ */
+static void checkTimer()
+{
+    int64_t now = nowns();
+    int n = ntimers;
+
+    while (n-- > 0 && ntimers > 0 && theap[0]->tgo <= now)
     {
-        lastcb = (lastcb + 1) % ncback;
-        cp     = &cback[lastcb];
-    } while (!cp->in_use || !FD_ISSET(cp->fd, rfdp));
+        TF *node = theap[0];
+        TF **link;
+        int timer_id = node->tid;
 
-    /* run */
-    (*cp->fp)(cp->fd, cp->ud);
+        (*node->fp)(node->ud);
+
+        /* it may have removed itself */
+        node = findTimerLink(timer_id, &link);
+        if (node == NULL)
+            continue;
+
+        if (node->interval > 0)
+        {
+            dettachTimer(node);
+            node->tgo += node->interval;
+            insertTimer(node);
+        }
+        else
+        {
+            *link = node->next;
+            dettachTimer(node);
+            free(node);
+        }
+    }
 }
 
-/* run the next timer callback whose time has come, if any. all we have to do
- * is is check the first entry in timefunc because it is sorted in increasing
- * order of time from epoch to run, ie, first entry runs soonest.
+/* wait at most waitns for fds to become ready, forever if waitns < 0.
+ * they are listed in readyfds.
  */
-static void checkTimer()
+static void pollWait(int64_t waitns)
 {
-    TF *node = timefunc->next;
+#if defined(EVENTLOOP_EPOLL)
+    struct epoll_event events[MAXREADY];
+    int timeout = waitns == 0 ? 0 : -1;
+    int i, ns;
 
-    if (node == NULL || remainingTimerNode(node) > 0)
+    /* epoll_wait counts in ms, timerfd wakes it up at the right time */
+    if (waitns > 0 && theap[0]->tgo != timerarmed)
+    {
+        struct itimerspec its;
+        memset(&its, 0, sizeof(its));
+        its.it_value.tv_sec  = (time_t)(theap[0]->tgo / 1000000000);
+        its.it_value.tv_nsec = (long)(theap[0]->tgo % 1000000000);
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0)
+            its.it_value.tv_nsec = 1;
+        if (timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &its, NULL) == 0)
+            timerarmed = theap[0]->tgo;
+        else
+            timeout = (int)((waitns + 999999) / 1000000);
+    }
+
+    ns = epoll_wait(pollfd, events, MAXREADY, timeout);
+    if (ns < 0)
+    {
+        if (errno != EINTR)
+            perror("epoll_wait");
         return;
+    }
 
-    (*node->fp)(node->ud);
+    for (i = 0; i < ns; i++)
+    {
+        if (events[i].data.fd == timerfd)
+        {
+            uint64_t expirations;
+            if (read(timerfd, &expirations, sizeof(expirations)) > 0)
+                timerarmed = 0;
+        }
+        else if (events[i].data.fd == wakefd)
+            wakeDrain();
+        else
+            readyfds[nready++] = events[i].data.fd;
+    }
+#elif defined(EVENTLOOP_KQUEUE)
+    struct kevent events[MAXREADY];
+    struct timespec ts, *tsp = NULL;
+    int i, ns;
 
-    node = dettachTimer(node);
+    if (waitns >= 0)
+    {
+        ts.tv_sec  = (time_t)(waitns / 1000000000);
+        ts.tv_nsec = (long)(waitns % 1000000000);
+        tsp = &ts;
+    }
 
-    if (node == NULL)
+    ns = kevent(pollfd, NULL, 0, events, MAXREADY, tsp);
+    if (ns < 0)
+    {
+        if (errno != EINTR)
+            perror("kevent");
         return;
+    }
 
-    if (node->interval > 0)
+    for (i = 0; i < ns; i++)
     {
-        node->tgo += node->interval;
-        insertTimer(node);
-    } else {
-        free(node);
+        if (events[i].filter != EVFILT_READ)
+            continue;
+        if ((int)events[i].ident == wakefd)
+            wakeDrain();
+        else
+            readyfds[nready++] = (int)events[i].ident;
     }
-}
-
-/* check fd's from each active callback.
- * if any ready, call their callbacks else call each registered work procedure.
- */
-static void oneLoop()
-{
-    struct timeval tv, *tvp;
+#else
+    struct timeval tv, *tvp = NULL;
     fd_set rfd;
-    CB *cp;
-    int maxfd, ns;
+    int fd, maxfd, ns;
 
     /* build list of callback file descriptors to check */
     FD_ZERO(&rfd);
     maxfd = -1;
-    for (cp = cback; cp < &cback[ncback]; cp++)
+    for (fd = 0; fd < nfdwatch; fd++)
     {
-        if (cp->in_use)
+        if (fdwatch[fd].first >= 0)
         {
-            FD_SET(cp->fd, &rfd);
-            if (cp->fd > maxfd)
-                maxfd = cp->fd;
+            FD_SET(fd, &rfd);
+            maxfd = fd;
         }
     }
+#ifndef _WIN32
+    FD_SET(wakefd, &rfd);
+    if (wakefd > maxfd)
+        maxfd = wakefd;
+#endif
+
+    if (waitns >= 0)
+    {
+        tvp          = &tv;
+        tvp->tv_sec  = (long)(waitns / 1000000000);
+        tvp->tv_usec = (long)((waitns % 1000000000 + 999) / 1000);
+    }
+
+    ns = select(maxfd + 1, &rfd, NULL, NULL, tvp);
+    if (ns < 0)
+    {
+        perror("select");
+        return;
+    }
+
+#ifndef _WIN32
+    if (FD_ISSET(wakefd, &rfd))
+    {
+        wakeDrain();
+        FD_CLR(wakefd, &rfd);
+    }
+#endif
+    for (fd = 0; fd <= maxfd && nready < MAXREADY; fd++)
+        if (FD_ISSET(fd, &rfd))
+            readyfds[nready++] = fd;
+#endif
+}
+
+/* check fd's from each active callback.
+ * if any ready, call their callbacks else call each registered work procedure.
+ */
+static void oneLoop()
+{
+    int64_t waitns;
+    int i;
+
+    pollOpen();
 
     /* determine timeout:
-	 * if there are work procs
+	 * if there are work procs, posted work, or fds the poller can't watch
 	 *   set delay = 0
 	 * else if there is at least one timer func
 	 *   set delay = time until soonest timer func expires
 	 * else
 	 *   set delay = forever
 	 */
-    if (nwpinuse > 0)
-    {
-        tvp         = &tv;
-        tvp->tv_sec = tvp->tv_usec = 0;
-    }
-    else if (timefunc->next != NULL)
+    if (nwpinuse > 0 || nalways > 0 || atomic_load(&nposted) > 0)
+        waitns = 0;
+    else if (ntimers > 0)
     {
-        double late = remainingTimerNode(timefunc->next); /* ms late */
-        if (late < 0)
-            late = 0;
-        late /= 1000.0; /* secs late */
-        tvp          = &tv;
-        tvp->tv_sec  = (long)floor(late);
-        tvp->tv_usec = (long)floor((late - tvp->tv_sec) * 1000000.0);
+        waitns = remainingTimerNode(theap[0]); /* ns late */
+        if (waitns < 0)
+            waitns = 0;
     }
     else
-        tvp = NULL;
+        waitns = -1;
 
     /* check file descriptors, timeout depending on pending work */
-    ns = select(maxfd + 1, &rfd, NULL, NULL, tvp);
-    if (ns < 0)
-    {
-        perror("select");
-        return;
-    }
+    nready = 0;
+    pollWait(waitns);
+
+    for (i = 0; nalways > 0 && i < nfdwatch && nready < MAXREADY; i++)
+        if (fdwatch[i].always && fdwatch[i].first >= 0)
+            readyfds[nready++] = i;
 
     /* dispatch */
     checkTimer();
-    if (ns == 0)
+    if (nready == 0)
         runWorkProc();
     else
-        callCallback(&rfd);
+        for (i = 0; i < nready; i++)
+            callCallbacks(readyfds[i]);
 
     runImmediates();
+    runPosted();
 }
 
 /* timer callback used to implement deferLoop().
@@ -567,6 +1022,89 @@ void runImmediates() {
     }
 }
 
+static void pushPosted(Posted *posted)
+{
+    atomic_store_explicit(&posted->next, NULL, memory_order_relaxed);
+    Posted *prev = atomic_exchange_explicit(&postedHead, posted, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, posted, memory_order_release);
+}
+
+/* loop only. NULL when empty, or when a producer is half way through pushPosted */
+static Posted *popPosted()
+{
+    Posted *tail = postedTail;
+    Posted *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &postedStub)
+    {
+        if (next == NULL)
+            return NULL;
+        postedTail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+
+    if (next != NULL)
+    {
+        postedTail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&postedHead, memory_order_acquire))
+        return NULL;
+
+    pushPosted(&postedStub);
+
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next == NULL)
+        return NULL;
+
+    postedTail = next;
+    return tail;
+}
+
+void postToEventLoop(TCF *fp, void *ud)
+{
+    Posted *posted = (Posted *)malloc(sizeof(Posted));
+    posted->fp = fp;
+    posted->ud = ud;
+    pushPosted(posted);
+    atomic_fetch_add(&nposted, 1);
+
+    /* once queued: the loop clears wakePending before it pops */
+    if (atomic_exchange(&wakePending, 1) == 0)
+    {
+        int wfd = atomic_load(&wakewfd);
+#ifdef EVENTLOOP_EPOLL
+        uint64_t one = 1;
+#else
+        char one = 1;
+#endif
+        if (wfd >= 0 && write(wfd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            perror("eventloop wakeup");
+    }
+}
+
+/* run the work posted so far, in the order it was posted */
+static void runPosted()
+{
+    Posted *posted;
+
+    /* before looking: whoever posts from now on writes to wakefd */
+    atomic_store(&wakePending, 0);
+    if (atomic_load(&nposted) == 0)
+        return;
+
+    while ((posted = popPosted()) != NULL)
+    {
+        TCF *fp = posted->fp;
+        void *ud = posted->ud;
+        atomic_fetch_sub(&nposted, 1);
+        free(posted);
+        (*fp)(ud);
+        runImmediates();
+    }
+}
+
 /* "INDI" wrappers to the more generic eventloop facility. */
 
 typedef void(IE_CBF)(int readfiledes, void *userpointer);
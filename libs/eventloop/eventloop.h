@@ -25,6 +25,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 
 #pragma once
 
+#include <stdint.h>
+
 /** \file eventloop.h
     \brief Public interface to INDI's eventloop mechanism.
     \author Elwood C. Downey
@@ -103,6 +105,26 @@ extern int addTimer(int ms, TCF *fp, void *ud);
 */
 extern int addPeriodicTimer(int ms, TCF *fp, void *ud);
 
+/** Register a new single-shot timer function, \e fp, to be called with \e ud as argument after \e ns.
+*
+* \param ns delay in nanoseconds, against the monotonic clock where there is one.
+* \param fp a pointer to the callback function.
+* \param ud a pointer to be passed to the callback function when called.
+* \return a unique id for use with rmTimer().
+*/
+extern int addTimerNs(int64_t ns, TCF *fp, void *ud);
+
+/** Register a new periodic timer function, \e fp, to be called with \e ud as argument every \e us.
+*
+* Each deadline is the previous one plus the period, whenever the callback actually ran: periods don't drift.
+*
+* \param us timer period in microseconds.
+* \param fp a pointer to the callback function.
+* \param ud a pointer to be passed to the callback function when called.
+* \return a unique id for use with rmTimer().
+*/
+extern int addPeriodicTimerUs(int64_t us, TCF *fp, void *ud);
+
 /** Returns the timer's remaining value in milliseconds left until the timeout.
  *
  * \param tid the timer callback ID returned from addTimer() or addPeriodicTimer()
@@ -129,10 +151,33 @@ extern void rmTimer(int tid);
  */
 extern void addImmediateWork(TCF * fp, void *ud);
 
+/** Register a given function to be called from the event loop, from any thread.
+ *
+ * This is how a worker thread hands results back: functions run in the order they were posted,
+ * soon after, even if the loop was waiting. Unlike the other functions here, it is thread safe.
+ *
+ * \param fp a pointer to the callback function.
+ * \param ud a pointer to be passed to the callback function when called.
+ */
+extern void postToEventLoop(TCF * fp, void *ud);
+
 /* utility functions */
 extern int deferLoop(int maxms, int *flagp);
 extern int deferLoop0(int maxms, int *flagp);
 
 #ifdef __cplusplus
 }
+
+#include <functional>
+
+/** Call \e fn from the event loop, from any thread. See postToEventLoop(TCF *, void *). */
+inline void postToEventLoop(const std::function<void()> &fn)
+{
+    postToEventLoop([](void *ud)
+    {
+        std::function<void()> *fn = static_cast<std::function<void()> *>(ud);
+        (*fn)();
+        delete fn;
+    }, new std::function<void()>(fn));
+}
 #endif
@@ -82,6 +82,10 @@ instead to differentiate between interfaces on a composite HID device. */
 #define INVASIVE_GET_USAGE
 #endif
 
+/* Number of input transfers kept in flight by the read thread. With more than one, the host has a transfer
+   queued for every interrupt interval of the device while the previous report is being handled. */
+#define NUM_INPUT_TRANSFERS 4
+
 /* Linked List of input reports received from the device. */
 struct input_report
 {
@@ -117,7 +121,9 @@ struct hid_device_
     pthread_cond_t condition;
     pthread_barrier_t barrier; /* Ensures correct startup sequence */
     int shutdown_thread;
-    struct libusb_transfer *transfer;
+    struct libusb_transfer *transfers[NUM_INPUT_TRANSFERS];
+    int active_transfers; /* Transfers still submitted, protected by mutex */
+    int transfers_done;   /* Set once no transfer is submitted anymore */
 
     /* List of received input reports. */
     struct input_report *input_reports;
@@ -649,6 +655,15 @@ hid_device *hid_open(unsigned short vendor_id, unsigned short product_id, const
     return handle;
 }
 
+/* Called when a transfer of the read thread is not submitted again */
+static void transfer_ended(hid_device *dev)
+{
+    pthread_mutex_lock(&dev->mutex);
+    if (--dev->active_transfers == 0)
+        dev->transfers_done = 1;
+    pthread_mutex_unlock(&dev->mutex);
+}
+
 static void read_callback(struct libusb_transfer *transfer)
 {
     hid_device *dev = transfer->user_data;
@@ -696,11 +711,13 @@ static void read_callback(struct libusb_transfer *transfer)
     else if (transfer->status == LIBUSB_TRANSFER_CANCELLED)
     {
         dev->shutdown_thread = 1;
+        transfer_ended(dev);
         return;
     }
     else if (transfer->status == LIBUSB_TRANSFER_NO_DEVICE)
     {
         dev->shutdown_thread = 1;
+        transfer_ended(dev);
         return;
     }
     else if (transfer->status == LIBUSB_TRANSFER_TIMED_OUT)
@@ -718,24 +735,37 @@ static void read_callback(struct libusb_transfer *transfer)
     {
         LOG("Unable to submit URB. libusb error code: #%d %s\n", res, libusb_error_name(res));
         dev->shutdown_thread = 1;
+        transfer_ended(dev);
     }
 }
 
 static void *read_thread(void *param)
 {
     hid_device *dev = param;
-    unsigned char *buf;
     const size_t length = dev->input_ep_max_packet_size;
+    int i;
 
-    /* Set up the transfer object. */
-    buf           = malloc(length);
-    dev->transfer = libusb_alloc_transfer(0);
-    libusb_fill_interrupt_transfer(dev->transfer, dev->device_handle, dev->input_endpoint, buf, length, read_callback,
-                                   dev, 5000 /*timeout*/);
+    /* Set up the transfer objects. Completed reports are queued in order, interrupt transfers
+       of an endpoint complete in the order they were submitted. */
+    for (i = 0; i < NUM_INPUT_TRANSFERS; i++)
+    {
+        dev->transfers[i] = libusb_alloc_transfer(0);
+        libusb_fill_interrupt_transfer(dev->transfers[i], dev->device_handle, dev->input_endpoint, malloc(length),
+                                       length, read_callback, dev, 5000 /*timeout*/);
+    }
 
-    /* Make the first submission. Further submissions are made
+    /* Make the first submissions. Further submissions are made
        from inside read_callback() */
-    libusb_submit_transfer(dev->transfer);
+    pthread_mutex_lock(&dev->mutex);
+    for (i = 0; i < NUM_INPUT_TRANSFERS; i++)
+    {
+        if (libusb_submit_transfer(dev->transfers[i]) == 0)
+            dev->active_transfers++;
+    }
+    dev->transfers_done = dev->active_transfers == 0;
+    if (dev->transfers_done)
+        dev->shutdown_thread = 1;
+    pthread_mutex_unlock(&dev->mutex);
 
     // Notify the main thread that the read thread is up and running.
     pthread_barrier_wait(&dev->barrier);
@@ -759,12 +789,17 @@ static void *read_thread(void *param)
         }
     }
 
-    /* Cancel any transfer that may be pending. This call will fail
-       if no transfers are pending, but that's OK. */
-    if (libusb_cancel_transfer(dev->transfer) == 0)
+    /* Cancel the transfers that may be pending. This call fails
+       for those which are not pending, but that's OK. */
+    for (i = 0; i < NUM_INPUT_TRANSFERS; i++)
+        libusb_cancel_transfer(dev->transfers[i]);
+
+    /* Wait for the completion of the cancelled transfers, which may be handled by the
+       read thread of another device sharing the context. */
+    while (!dev->transfers_done)
     {
-        /* The transfer was cancelled, so wait for its completion. */
-        libusb_handle_events(usb_context);
+        if (libusb_handle_events_completed(usb_context, &dev->transfers_done) < 0)
+            break;
     }
 
     /* Now that the read thread is stopping, Wake any threads which are
@@ -776,7 +811,7 @@ static void *read_thread(void *param)
     pthread_cond_broadcast(&dev->condition);
     pthread_mutex_unlock(&dev->mutex);
 
-    /* The dev->transfer->buffer and dev->transfer objects are cleaned up
+    /* The buffers and objects of dev->transfers are cleaned up
        in hid_close(). They are not cleaned up here because this thread
        could end either due to a disconnect or due to a user
        call to hid_close(). In both cases the objects can be safely
@@ -1162,19 +1197,25 @@ int HID_API_EXPORT hid_get_feature_report(hid_device *dev, unsigned char *data,
 
 void HID_API_EXPORT hid_close(hid_device *dev)
 {
+    int i;
+
     if (!dev)
         return;
 
     /* Cause read_thread() to stop. */
     dev->shutdown_thread = 1;
-    libusb_cancel_transfer(dev->transfer);
+    for (i = 0; i < NUM_INPUT_TRANSFERS; i++)
+        libusb_cancel_transfer(dev->transfers[i]);
 
     /* Wait for read_thread() to end. */
     pthread_join(dev->thread, NULL);
 
     /* Clean up the Transfer objects allocated in read_thread(). */
-    free(dev->transfer->buffer);
-    libusb_free_transfer(dev->transfer);
+    for (i = 0; i < NUM_INPUT_TRANSFERS; i++)
+    {
+        free(dev->transfers[i]->buffer);
+        libusb_free_transfer(dev->transfers[i]);
+    }
 
     /* release the interface */
     libusb_release_interface(dev->device_handle, dev->interface);
@@ -29,6 +29,8 @@
 #include "locale_compat.h"
 #include "indistandardproperty.h"
 
+#include <algorithm>
+
 #if defined(_MSC_VER)
 #define snprintf _snprintf
 #pragma warning(push)
@@ -41,6 +43,161 @@ namespace INDI
 
 userio AbstractBaseClientPrivate::io;
 
+// ChangeSubscriptions
+
+ChangeSubscriptions::~ChangeSubscriptions()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        changed.notify_all();
+    }
+
+    if (thread.joinable())
+        thread.join();
+}
+
+int ChangeSubscriptions::subscribe(const Callback &callback, std::chrono::milliseconds interval,
+                                   const AbstractBaseClient::Executor &executor)
+{
+    auto subscription = std::make_shared<Subscription>();
+    subscription->callback = callback;
+    subscription->interval = interval;
+    subscription->executor = executor;
+
+    std::lock_guard<std::mutex> guard(lock);
+    subscriptions[++lastId] = subscription;
+    hasSubscriptions = true;
+
+    if (!thread.joinable())
+        thread = std::thread(&ChangeSubscriptions::run, this);
+
+    return lastId;
+}
+
+void ChangeSubscriptions::unsubscribe(int id)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = subscriptions.find(id);
+    if (it == subscriptions.end())
+        return;
+
+    it->second->active = false;
+    subscriptions.erase(it);
+    hasSubscriptions = !subscriptions.empty();
+}
+
+void ChangeSubscriptions::addProperty(const INDI::Property &property)
+{
+    if (!hasSubscriptions && !waiters)
+        return;
+
+    std::lock_guard<std::mutex> guard(lock);
+    propertyChanged.notify_all();
+
+    bool notify = false;
+    for (auto &it : subscriptions)
+    {
+        Subscription &subscription = *it.second;
+        auto inserted = subscription.pendingIndex.emplace(property.getProperty(), subscription.pending.properties.size());
+        if (!inserted.second)
+            continue; // the property is already pending, it is read when delivered
+
+        notify |= subscription.pending.properties.empty() && subscription.pending.messages.empty();
+        subscription.pending.properties.push_back(property);
+    }
+
+    if (notify)
+        changed.notify_one();
+}
+
+void ChangeSubscriptions::addMessage(const INDI::BaseDevice &device, int messageID)
+{
+    if (!hasSubscriptions)
+        return;
+
+    std::lock_guard<std::mutex> guard(lock);
+    bool notify = false;
+    for (auto &it : subscriptions)
+    {
+        Subscription &subscription = *it.second;
+        notify |= subscription.pending.properties.empty() && subscription.pending.messages.empty();
+        subscription.pending.messages.emplace_back(device, messageID);
+    }
+
+    if (notify)
+        changed.notify_one();
+}
+
+bool ChangeSubscriptions::waitFor(const std::function<bool ()> &predicate, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    ++waiters;
+    bool result = propertyChanged.wait_for(guard, timeout, predicate);
+    --waiters;
+    return result;
+}
+
+void ChangeSubscriptions::run()
+{
+    std::vector<std::pair<std::shared_ptr<Subscription>, ChangeSet>> deliveries;
+
+    std::unique_lock<std::mutex> guard(lock);
+    while (!stopping)
+    {
+        // take the sets that are due, find when the next one will be
+        auto now = std::chrono::steady_clock::now();
+        auto wakeup = std::chrono::steady_clock::time_point::max();
+        for (auto &it : subscriptions)
+        {
+            Subscription &subscription = *it.second;
+            if (subscription.pending.properties.empty() && subscription.pending.messages.empty())
+                continue;
+
+            if (subscription.due > now)
+            {
+                wakeup = std::min(wakeup, subscription.due);
+                continue;
+            }
+
+            deliveries.emplace_back(it.second, std::move(subscription.pending));
+            subscription.pending = ChangeSet();
+            subscription.pendingIndex.clear();
+            subscription.due = now + subscription.interval;
+        }
+
+        if (deliveries.empty())
+        {
+            if (wakeup == std::chrono::steady_clock::time_point::max())
+                changed.wait(guard);
+            else
+                changed.wait_until(guard, wakeup);
+            continue;
+        }
+
+        guard.unlock();
+        for (auto &delivery : deliveries)
+        {
+            auto subscription = delivery.first;
+            if (!subscription->executor)
+            {
+                if (subscription->active)
+                    subscription->callback(delivery.second);
+                continue;
+            }
+
+            auto changes = std::make_shared<ChangeSet>(std::move(delivery.second));
+            subscription->executor([subscription, changes]
+            {
+                if (subscription->active)
+                    subscription->callback(*changes);
+            });
+        }
+        deliveries.clear();
+        guard.lock();
+    }
+}
+
 // AbstractBaseClientPrivate
 
 AbstractBaseClientPrivate::AbstractBaseClientPrivate(AbstractBaseClient *parent)
@@ -61,20 +218,74 @@ AbstractBaseClientPrivate::AbstractBaseClientPrivate(AbstractBaseClient *parent)
     };
 }
 
+AbstractBaseClientPrivate::~AbstractBaseClientPrivate()
+{
+    stopBLOBDecoders();
+}
+
+void AbstractBaseClientPrivate::waitBLOBDecoders()
+{
+    for (auto &device : watchDevice.getDevices())
+        if (device.isValid())
+            device.d_ptr->waitBLOBs();
+}
+
+void AbstractBaseClientPrivate::stopBLOBDecoders()
+{
+    for (auto &device : watchDevice.getDevices())
+        if (device.isValid())
+            device.d_ptr->stopBLOBs();
+}
+
+void AbstractBaseClientPrivate::setThreadedBLOBs(bool enable)
+{
+    threadedBLOBs = enable;
+    for (auto &device : watchDevice.getDevices())
+        if (device.isValid())
+            device.d_ptr->threadedBLOBs = enable;
+}
+
 void AbstractBaseClientPrivate::clear()
 {
-    watchDevice.clearDevices();
+    // nothing queued may be delivered to a device dropped or resynchronized below
+    stopBLOBDecoders();
+    // with delta sync, the next connection brings them up to date
+    if (!deltaSync || generation.empty())
+        watchDevice.clearDevices();
     blobModes.clear();
 }
 
 int AbstractBaseClientPrivate::dispatchCommand(const LilXmlElement &root, char *errmsg)
 {
+    // BLOBs decoded meanwhile are delivered first, the callbacks keep coming one at a time and in order
+    if (threadedBLOBs)
+        waitBLOBDecoders();
+
     // Ignore echoed newXXX
     if (root.tagName().find("new") == 0)
     {
         return 0;
     }
 
+    if (deltaSync)
+    {
+        auto stamp = root.getAttribute("generation");
+        if (stamp.isValid())
+            noteGeneration(stamp.toString());
+
+        // a property defined again, e.g. changed while disconnected, replaces the kept one
+        if (root.tagName().find("def") == 0)
+        {
+            BaseDevice dp = watchDevice.getDeviceByName(root.getAttribute("device"));
+            auto property = dp.isValid() ? dp.getProperty(root.getAttribute("name")) : INDI::Property();
+            if (property.isValid())
+            {
+                dp.d_ptr->mediateRemoveProperty(property);
+                dp.removeProperty(root.getAttribute("name"), errmsg);
+            }
+        }
+    }
+
     if (root.tagName() == "pingRequest")
     {
         parent->sendPingReply(root.getAttribute("uid"));
@@ -118,6 +329,19 @@ int AbstractBaseClientPrivate::dispatchCommand(const LilXmlElement &root, char *
     {
         ParentDevice device(ParentDevice::Valid);
         device.setMediator(parent);
+        device.d_ptr->threadedBLOBs = threadedBLOBs;
+
+        std::weak_ptr<ChangeSubscriptions> subscriptions = changeSubscriptions;
+        device.d_ptr->propertyObserver = [subscriptions](const INDI::Property &property)
+        {
+            if (auto self = subscriptions.lock())
+                self->addProperty(property);
+        };
+        device.d_ptr->messageObserver = [subscriptions](const BaseDevice &device, int messageID)
+        {
+            if (auto self = subscriptions.lock())
+                self->addMessage(device, messageID);
+        };
         return device;
     });
 }
@@ -220,32 +444,68 @@ int AbstractBaseClientPrivate::messageCmd(const LilXmlElement &root, char *errms
     return 0;
 }
 
+void AbstractBaseClientPrivate::noteGeneration(const std::string &value)
+{
+    auto colon = value.find(':');
+    if (colon == std::string::npos)
+        return;
+
+    bool sameEpoch = generation.compare(0, generation.find(':'), value, 0, colon) == 0;
+    if (resyncing)
+    {
+        resyncing = false;
+        // a restarted server, it resends everything
+        if (!sameEpoch)
+            watchDevice.clearDevices();
+    }
+
+    // the cached definitions are replayed in any order, keep the latest generation
+    if (sameEpoch && !generation.empty() &&
+            strtoull(value.c_str() + colon + 1, nullptr, 10) <= strtoull(generation.c_str() + generation.find(':') + 1, nullptr, 10))
+        return;
+
+    generation = value;
+}
+
 void AbstractBaseClientPrivate::userIoGetProperties()
 {
+    // only what changed since the kept devices, any generation asks the server to stamp its messages
+    const char *since = !deltaSync ? nullptr : generation.empty() ? "0" : generation.c_str();
+    resyncing = deltaSync && !generation.empty();
+
+    // the offer is made once, with the first getProperties of the connection
+    std::string const compress = std::move(compressOffer);
+    compressOffer.clear();
+
     if (watchDevice.isEmpty())
     {
-        IUUserIOGetProperties(&io, this, nullptr, nullptr);
+        IUUserIOGetPropertiesCompress(&io, this, nullptr, nullptr, since, compress.c_str());
         if (verbose)
-            IUUserIOGetProperties(userio_file(), stderr, nullptr, nullptr);
+            IUUserIOGetPropertiesCompress(userio_file(), stderr, nullptr, nullptr, since, compress.c_str());
     }
     else
     {
+        // the server answers the offer before anything else it sends, make it with the first request
+        const char *offer = compress.c_str();
         for (const auto &deviceInfo : watchDevice /* first: device name, second: device info */)
         {
             // If there are no specific properties to watch, we watch the complete device
             if (deviceInfo.second.properties.size() == 0)
             {
-                IUUserIOGetProperties(&io, this, deviceInfo.first.c_str(), nullptr);
+                IUUserIOGetPropertiesCompress(&io, this, deviceInfo.first.c_str(), nullptr, since, offer);
                 if (verbose)
-                    IUUserIOGetProperties(userio_file(), stderr, deviceInfo.first.c_str(), nullptr);
+                    IUUserIOGetPropertiesCompress(userio_file(), stderr, deviceInfo.first.c_str(), nullptr, since, offer);
+                offer = nullptr;
             }
             else
             {
                 for (const auto &oneProperty : deviceInfo.second.properties)
                 {
-                    IUUserIOGetProperties(&io, this, deviceInfo.first.c_str(), oneProperty.c_str());
+                    IUUserIOGetPropertiesCompress(&io, this, deviceInfo.first.c_str(), oneProperty.c_str(), since, offer);
                     if (verbose)
-                        IUUserIOGetProperties(userio_file(), stderr, deviceInfo.first.c_str(), oneProperty.c_str());
+                        IUUserIOGetPropertiesCompress(userio_file(), stderr, deviceInfo.first.c_str(), oneProperty.c_str(), since,
+                                                      offer);
+                    offer = nullptr;
                 }
             }
         }
@@ -320,6 +580,8 @@ AbstractBaseClient::~AbstractBaseClient()
 void AbstractBaseClient::setServer(const char *hostname, unsigned int port)
 {
     D_PTR(AbstractBaseClient);
+    // the kept devices belong to the previous server
+    d->generation.clear();
     d->cServer = hostname;
     d->cPort   = port;
 }
@@ -355,6 +617,18 @@ void AbstractBaseClient::setVerbose(bool enable)
     d->verbose = enable;
 }
 
+void AbstractBaseClient::setDeltaSync(bool enable)
+{
+    D_PTR(AbstractBaseClient);
+    d->deltaSync = enable;
+}
+
+void AbstractBaseClient::setThreadedBLOBDecoding(bool enable)
+{
+    D_PTR(AbstractBaseClient);
+    d->setThreadedBLOBs(enable);
+}
+
 bool AbstractBaseClient::isVerbose() const
 {
     D_PTR(const AbstractBaseClient);
@@ -379,6 +653,19 @@ void AbstractBaseClient::watchProperty(const char *deviceName, const char *prope
     d->watchDevice.watchProperty(deviceName, propertyName);
 }
 
+int AbstractBaseClient::subscribeChanges(const std::function<void (const ChangeSet &)> &callback,
+                                         std::chrono::milliseconds interval, const Executor &executor)
+{
+    D_PTR(AbstractBaseClient);
+    return d->changeSubscriptions->subscribe(callback, interval, executor);
+}
+
+void AbstractBaseClient::unsubscribeChanges(int id)
+{
+    D_PTR(AbstractBaseClient);
+    d->changeSubscriptions->unsubscribe(id);
+}
+
 void AbstractBaseClient::connectDevice(const char *deviceName)
 {
     D_PTR(AbstractBaseClient);
@@ -485,6 +772,80 @@ void AbstractBaseClient::sendNewProperty(INDI::Property pp)
     }
 }
 
+bool AbstractBaseClient::sendNewProperties(const std::vector<INDI::Property> &properties, std::chrono::milliseconds timeout)
+{
+    D_PTR(AbstractBaseClient);
+
+    // format everything in memory, the messages of the io of the client are written chunk by chunk
+    std::string buffer;
+    userio bufferIo {};
+    bufferIo.write = [](void *user, const void *ptr, size_t count) -> ssize_t
+    {
+        static_cast<std::string *>(user)->append(static_cast<const char *>(ptr), count);
+        return count;
+    };
+    bufferIo.vprintf = [](void *user, const char *format, va_list ap) -> int
+    {
+        char message[MAXRBUF];
+        int n = vsnprintf(message, MAXRBUF, format, ap);
+        static_cast<std::string *>(user)->append(message, std::min(std::max(n, 0), MAXRBUF - 1));
+        return n;
+    };
+
+    {
+        AutoCNumeric locale;
+        for (auto property : properties)
+        {
+            property.setState(IPS_BUSY);
+            switch (property.getType())
+            {
+                case INDI_NUMBER:
+                    IUUserIONewNumber(&bufferIo, &buffer, property.getNumber()->cast());
+                    break;
+                case INDI_SWITCH:
+                    IUUserIONewSwitch(&bufferIo, &buffer, property.getSwitch()->cast());
+                    break;
+                case INDI_TEXT:
+                    IUUserIONewText(&bufferIo, &buffer, property.getText()->cast());
+                    break;
+                case INDI_BLOB:
+                    IUUserIONewBLOB(&bufferIo, &buffer, property.getBLOB()->cast());
+                    break;
+                case INDI_LIGHT:
+                    IDLog("Light type is not supported to send\n");
+                    break;
+                case INDI_UNKNOWN:
+                    IDLog("Unknown type of property to send\n");
+                    break;
+            }
+        }
+    }
+
+    if (!buffer.empty() && d->sendData(buffer.data(), buffer.size()) < 0)
+        return false;
+
+    return timeout.count() == 0 || waitForProperties(properties, timeout);
+}
+
+bool AbstractBaseClient::waitForProperties(const std::vector<INDI::Property> &properties, std::chrono::milliseconds timeout)
+{
+    D_PTR(AbstractBaseClient);
+
+    auto isBusy = [](const INDI::Property &property)
+    {
+        return property.getState() == IPS_BUSY;
+    };
+    auto isOk = [](const INDI::Property &property)
+    {
+        return property.getState() == IPS_OK;
+    };
+
+    return d->changeSubscriptions->waitFor([&]
+    {
+        return std::none_of(properties.begin(), properties.end(), isBusy);
+    }, timeout) && std::all_of(properties.begin(), properties.end(), isOk);
+}
+
 void AbstractBaseClient::sendNewText(INDI::Property pp)
 {
     D_PTR(AbstractBaseClient);
@@ -24,7 +24,9 @@
 #include "indibase.h"
 #include "indimacros.h"
 #include "indiproperty.h"
+#include "basedevice.h"
 
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <functional>
@@ -89,6 +91,28 @@ class AbstractBaseClient : public INDI::BaseMediator
          */
         bool isVerbose() const;
 
+    public:
+        /** @brief setDeltaSync Keep the devices when the connection is lost, and only receive what changed on reconnection.
+         *
+         *  An indiserver started with -k stamps each change with a generation. On reconnection, the client gives back the
+         *  last generation it saw and the server only sends the properties defined, updated or deleted since, instead of
+         *  all definitions of all devices. A property defined again replaces the kept one. If the server restarted in the
+         *  meantime, the kept devices are dropped and everything is received again.
+         *
+         *  @param enable If true, the devices survive disconnections from this server, without removeDevice notifications.
+         */
+        void setDeltaSync(bool enable);
+
+        /** @brief setThreadedBLOBDecoding Decode and decompress the BLOBs of each device on a thread of its own.
+         *
+         *  The client reads and parses the next message from the server while the previous BLOB is decoded. The
+         *  callbacks still come one at a time and in the order of the messages, waiting for the BLOB to be decoded, but
+         *  those of BLOBs come from the thread of the device rather than the one of the connection.
+         *
+         *  @param enable If true, BLOBs are decoded off the thread of the connection. Off by default.
+         */
+        void setThreadedBLOBDecoding(bool enable);
+
     public:
         /** @brief Add a device to the watch list.
          *
@@ -110,6 +134,53 @@ class AbstractBaseClient : public INDI::BaseMediator
          */
         void watchProperty(const char *deviceName, const char *propertyName);
 
+    public:
+        /** @brief Changes received since the previous delivery to a subscriber. */
+        struct ChangeSet
+        {
+            /** @brief Properties defined or updated, once each however often they changed, in the order they first did. */
+            std::vector<INDI::Property> properties;
+            /** @brief Messages received, as the device and the ID to look up in its messageQueue(). */
+            std::vector<std::pair<INDI::BaseDevice, int>> messages;
+        };
+
+        /** @brief Runs a delivery where the application wants it, e.g. posts it to the event loop of its GUI thread. */
+        using Executor = std::function<void (std::function<void ()>)>;
+
+        /** @brief subscribeChanges Receive property changes and messages in batches instead of one callback per message.
+         *
+         *  Unlike the BaseMediator notifications, which run on the thread reading the socket for every XML message,
+         *  the changes are collected and delivered at most once per interval, with only the latest value of each property.
+         *  A slow subscriber therefore never holds up the connection, it just receives larger sets.
+         *
+         *  @code{.cpp}
+         *  client.subscribeChanges([](const INDI::AbstractBaseClient::ChangeSet &changes)
+         *  {
+         *      for (const auto &property : changes.properties)
+         *          redraw(property);
+         *  }, std::chrono::milliseconds(50), [](std::function<void ()> delivery)
+         *  {
+         *      QMetaObject::invokeMethod(qApp, delivery);
+         *  });
+         *  @endcode
+         *
+         *  @param callback Called with the changes of each tick, it is never called with an empty set.
+         *  @param interval Minimum time between two deliveries, zero delivers as soon as the changes arrive.
+         *  @param executor Runs the deliveries. If empty, the callback runs on a delivery thread of the client.
+         *  @return ID of the subscription, to be given to unsubscribeChanges.
+         *  @note The properties are shared with the socket thread, their values are the latest ones at the time they are read.
+         *  @note Without executor, the client must not be destroyed from the callback.
+         */
+        int subscribeChanges(const std::function<void (const ChangeSet &)> &callback,
+                             std::chrono::milliseconds interval = std::chrono::milliseconds(100),
+                             const Executor &executor = Executor());
+
+        /** @brief unsubscribeChanges Stop the deliveries of a subscription.
+         *  @param id ID returned by subscribeChanges.
+         *  @note A delivery already running, or posted to the executor, is not interrupted but a posted one will not call the callback anymore.
+         */
+        void unsubscribeChanges(int id);
+
     public:
         /** @brief Disconnect INDI driver
          *  @param deviceName Name of the device to disconnect.
@@ -174,6 +245,23 @@ class AbstractBaseClient : public INDI::BaseMediator
         /** @brief Send new Property command to server */
         void sendNewProperty(INDI::Property pp);
 
+        /** @brief sendNewProperties Send several properties to the server in a single write.
+         *
+         *  The new values of all properties, e.g. filter, focus, binning and exposure of a sequence, are formatted
+         *  in one buffer and written at once rather than message by message, then optionally waited for.
+         *
+         *  @param properties Properties to send, in order, with their new values already set.
+         *  @param timeout If not zero, wait until none of the properties is Busy anymore, or the timeout elapses.
+         *  @return Without timeout, true once sent. Otherwise true only if all the properties reached the Ok state in time.
+         */
+        bool sendNewProperties(const std::vector<INDI::Property> &properties,
+                               std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+        /** @brief waitForProperties Wait until none of the properties is Busy anymore, e.g. after sending them.
+         *  @return True only if all the properties reached the Ok state before the timeout.
+         */
+        bool waitForProperties(const std::vector<INDI::Property> &properties, std::chrono::milliseconds timeout);
+
         /** @brief Send new Text command to server */
         void sendNewText(INDI::Property pp);
         /** @brief Send new Text command to server */
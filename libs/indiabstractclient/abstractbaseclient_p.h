@@ -21,15 +21,20 @@
 
 #pragma once
 
+#include "abstractbaseclient.h"
 #include "watchdeviceproperty.h"
 #include "indidevapi.h"
 #include "indiuserio.h"
 #include "indililxml.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 #include <map>
 #include <set>
+#include <thread>
+#include <unordered_map>
 
 namespace INDI
 {
@@ -41,12 +46,66 @@ struct BLOBMode
     BLOBHandling blobMode;
 };
 
+/** @brief Coalesces the property changes and messages of the devices for the subscribers of AbstractBaseClient::subscribeChanges,
+ *  and wakes up the threads waiting for a change
+ */
+class ChangeSubscriptions
+{
+    public:
+        using ChangeSet = AbstractBaseClient::ChangeSet;
+        using Callback = std::function<void (const ChangeSet &)>;
+
+    public:
+        ~ChangeSubscriptions();
+
+    public:
+        int subscribe(const Callback &callback, std::chrono::milliseconds interval, const AbstractBaseClient::Executor &executor);
+        void unsubscribe(int id);
+
+    public:
+        /** @brief Record a change for every subscriber, from the thread of the device */
+        void addProperty(const INDI::Property &property);
+        void addMessage(const INDI::BaseDevice &device, int messageID);
+
+        /** @brief Wait until predicate holds, evaluating it again after every property change
+         *  @return false if the timeout elapsed first
+         */
+        bool waitFor(const std::function<bool ()> &predicate, std::chrono::milliseconds timeout);
+
+    protected:
+        struct Subscription
+        {
+            Callback callback;
+            std::chrono::milliseconds interval;
+            AbstractBaseClient::Executor executor;
+            std::atomic_bool active {true};
+
+            ChangeSet pending;
+            /// index of each pending property in pending.properties
+            std::unordered_map<const void *, size_t> pendingIndex;
+            std::chrono::steady_clock::time_point due;
+        };
+
+        void run();
+
+    protected:
+        std::mutex lock;
+        std::condition_variable changed;
+        std::map<int, std::shared_ptr<Subscription>> subscriptions;
+        std::atomic_bool hasSubscriptions {false};
+        std::condition_variable propertyChanged;
+        std::atomic_int waiters {0};
+        int lastId {0};
+        bool stopping {false};
+        std::thread thread;
+};
+
 class AbstractBaseClient;
 class AbstractBaseClientPrivate
 {
     public:
         AbstractBaseClientPrivate(AbstractBaseClient *parent);
-        virtual ~AbstractBaseClientPrivate() = default;
+        virtual ~AbstractBaseClientPrivate();
 
     public:
         virtual ssize_t sendData(const void *data, size_t size) = 0;
@@ -54,6 +113,14 @@ class AbstractBaseClientPrivate
     public:
         void clear();
 
+        /** @brief Wait for the devices to deliver the BLOBs they are decoding */
+        void waitBLOBDecoders();
+
+        /** @brief Drop the BLOBs the devices are decoding, once the ones being delivered are */
+        void stopBLOBDecoders();
+
+        void setThreadedBLOBs(bool enable);
+
     public:
         /** @brief Dispatch command received from INDI server to respective devices handled by the client */
         int dispatchCommand(const INDI::LilXmlElement &root, char *errmsg);
@@ -70,6 +137,11 @@ class AbstractBaseClientPrivate
     public:
         void userIoGetProperties();
 
+        /** @brief Record the generation stamped on a message by the server
+         *  After reconnecting, drop the kept devices if the server does not know their generation.
+         */
+        void noteGeneration(const std::string &value);
+
     public:
         /** @brief Connect/Disconnect to INDI driver
             @param status If true, the client will attempt to turn on CONNECTION property within the driver (i.e. turn on the device).
@@ -93,10 +165,24 @@ class AbstractBaseClientPrivate
 
         bool verbose {false};
 
+        /// devices kept between connections, see AbstractBaseClient::setDeltaSync
+        bool deltaSync {false};
+        std::string generation;
+        bool resyncing {false};
+
+        /// codecs offered by the next getProperties to compress the stream from the server, see BaseClient::setStreamCompression
+        std::string compressOffer;
+
+        /// decode BLOBs on a thread of each device, see AbstractBaseClient::setThreadedBLOBDecoding
+        bool threadedBLOBs {false};
+
         uint32_t timeout_sec {3}, timeout_us {0};
 
         WatchDeviceProperty watchDevice;
 
+        /// shared with the observers installed on the devices, which may outlive the client
+        std::shared_ptr<ChangeSubscriptions> changeSubscriptions {std::make_shared<ChangeSubscriptions>()};
+
         static userio io;
 };
 
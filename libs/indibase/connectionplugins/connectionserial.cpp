@@ -20,13 +20,19 @@
 #include "indistandardproperty.h"
 #include "indicom.h"
 #include "indilogger.h"
+#include "lilxml.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <climits>
 #include <cerrno>
 #include <cstring>
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <map>
 #include <regex>
 #include <random>
 
@@ -183,11 +189,268 @@ bool Serial::ISNewSwitch(const char *dev, const char *name, ISState *states, cha
     return false;
 }
 
+namespace
+{
+// The port and baud rate each device was last found on, shared by the drivers of the user
+struct CachedPort
+{
+    std::string port;
+    uint32_t baud {0};
+};
+
+std::string portCacheFile()
+{
+    const char *home = getenv("HOME");
+    return std::string(home ? home : "") + "/.indi/SerialPorts.xml";
+}
+
+std::map<std::string, CachedPort> readPortCache()
+{
+    std::map<std::string, CachedPort> cache;
+
+    FILE *fp = fopen(portCacheFile().c_str(), "r");
+    if (fp == nullptr)
+        return cache;
+
+    char errmsg[MAXRBUF];
+    LilXML *lp = newLilXML();
+    XMLEle *root = readXMLFile(fp, lp, errmsg);
+    delLilXML(lp);
+    fclose(fp);
+
+    if (root == nullptr)
+        return cache;
+
+    for (XMLEle *ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+    {
+        if (strcmp(tagXMLEle(ep), "device"))
+            continue;
+        CachedPort &entry = cache[findXMLAttValu(ep, "name")];
+        entry.port = findXMLAttValu(ep, "port");
+        entry.baud = atoi(findXMLAttValu(ep, "baud"));
+    }
+    delXMLEle(root);
+    return cache;
+}
+
+// Renamed over the file, so that the drivers starting at the same time read it whole
+void writePortCache(const std::map<std::string, CachedPort> &cache)
+{
+    std::string fileName = portCacheFile();
+    std::string temporary = fileName + ".tmp" + std::to_string(getpid());
+
+    FILE *fp = fopen(temporary.c_str(), "w");
+    if (fp == nullptr)
+        return;
+
+    XMLEle *root = addXMLEle(nullptr, "serialports");
+    for (const auto &entry : cache)
+    {
+        XMLEle *ep = addXMLEle(root, "device");
+        addXMLAtt(ep, "name", entry.first.c_str());
+        addXMLAtt(ep, "port", entry.second.port.c_str());
+        addXMLAtt(ep, "baud", std::to_string(entry.second.baud).c_str());
+    }
+    prXMLEle(fp, root, 0);
+    delXMLEle(root);
+
+    if (fclose(fp) != 0 || rename(temporary.c_str(), fileName.c_str()) != 0)
+        unlink(temporary.c_str());
+}
+
+// The node a port name points to
+std::string resolvePort(const std::string &port)
+{
+    char resolved[PATH_MAX];
+    return realpath(port.c_str(), resolved) ? std::string(resolved) : port;
+}
+
+// The /dev/serial/by-id/ link of a port, which stays the same when adapters are enumerated in another order
+std::string stablePortName(const std::string &port)
+{
+#ifdef __linux__
+    static const std::string byId = "/dev/serial/by-id/";
+    if (port.compare(0, byId.size(), byId) == 0)
+        return port;
+
+    std::string const node = resolvePort(port);
+    std::string stable = port;
+    DIR *dir = opendir(byId.c_str());
+    if (dir == nullptr)
+        return port;
+    for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+    {
+        if (entry->d_name[0] != '.' && resolvePort(byId + entry->d_name) == node)
+        {
+            stable = byId + entry->d_name;
+            break;
+        }
+    }
+    closedir(dir);
+    return stable;
+#else
+    return port;
+#endif
+}
+
+enum
+{
+    PORT_FREE,
+    PORT_BUSY,
+    PORT_ABSENT
+};
+
+// Opening a port held by another driver fails right away with EBUSY, where tty_connect() would retry for seconds
+int probePort(const std::string &port)
+{
+    int fd = open(port.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return errno == EBUSY ? PORT_BUSY : PORT_ABSENT;
+    close(fd);
+    return PORT_FREE;
+}
+}
+
+bool Serial::connectCachedPort()
+{
+    auto cache = readPortCache();
+    auto entry = cache.find(getDeviceName());
+    if (entry == cache.end() || access(entry->second.port.c_str(), F_OK) != 0)
+        return false;
+
+    const CachedPort &cached = entry->second;
+    uint32_t const baudRate = cached.baud > 0 ? cached.baud : baud();
+
+    // Nothing to gain on the configured port, tried next anyway
+    if (resolvePort(cached.port) == resolvePort(PortT[0].text) && baudRate == baud())
+        return false;
+
+    int const baudIndex = IUFindOnSwitchIndex(&BaudRateSP);
+    ISwitch *baudSwitch = IUFindSwitch(&BaudRateSP, std::to_string(baudRate).c_str());
+    if (baudSwitch == nullptr)
+        return false;
+
+    std::string const port = PortT[0].text;
+    IUSaveText(&PortT[0], cached.port.c_str());
+    IUResetSwitch(&BaudRateSP);
+    baudSwitch->s = ISS_ON;
+
+    LOGF_INFO("Trying %s @ %d, where the device was last found...", cached.port.c_str(), baudRate);
+    if (Connect(cached.port.c_str(), baudRate) && processHandshake())
+    {
+        IDSetText(&PortTP, nullptr);
+        IDSetSwitch(&BaudRateSP, nullptr);
+        cachePort();
+        return true;
+    }
+
+    tty_disconnect(PortFD);
+    IUSaveText(&PortT[0], port.c_str());
+    IUResetSwitch(&BaudRateSP);
+    if (baudIndex >= 0)
+        BaudRateS[baudIndex].s = ISS_ON;
+    return false;
+}
+
+void Serial::cachePort()
+{
+    std::string const lockFile = portCacheFile() + ".lock";
+    int lockFd = open(lockFile.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd >= 0)
+        flock(lockFd, LOCK_EX);
+
+    auto cache = readPortCache();
+    CachedPort &entry = cache[getDeviceName()];
+    std::string const port = stablePortName(PortT[0].text);
+    if (entry.port != port || entry.baud != baud())
+    {
+        entry.port = port;
+        entry.baud = baud();
+        writePortCache(cache);
+    }
+
+    if (lockFd >= 0)
+        close(lockFd);
+}
+
+std::vector<std::string> Serial::searchOrder()
+{
+    // Try to connect "randomly" so that competing devices don't all try to connect to the same
+    // ports at the same time.
+    std::vector<std::string> systemPorts;
+    for (int i = 0; i < SystemPortSP.nsp; i++)
+    {
+        // Only try the same port last again.
+        if (!strcmp(m_SystemPorts[i].c_str(), PortT[0].text))
+            continue;
+
+        systemPorts.push_back(m_SystemPorts[i].c_str());
+    }
+
+    std::random_device rd;
+    std::minstd_rand g(rd());
+    std::shuffle(systemPorts.begin(), systemPorts.end(), g);
+
+    // All the ports are probed at once, rather than each in turn with the retries of tty_connect()
+    std::vector<int> states(systemPorts.size(), PORT_ABSENT);
+    std::vector<std::thread> probes;
+    for (size_t i = 0; i < systemPorts.size(); i++)
+        probes.emplace_back([&states, &systemPorts, i] { states[i] = probePort(systemPorts[i]); });
+    for (auto &probe : probes)
+        probe.join();
+
+    // Ports other devices were found on are theirs unless nothing else answers
+    std::vector<std::string> claimed;
+    for (const auto &entry : readPortCache())
+        if (entry.first != getDeviceName())
+            claimed.push_back(resolvePort(entry.second.port));
+
+    std::vector<std::string> free, others, busy;
+    for (size_t i = 0; i < systemPorts.size(); i++)
+    {
+        if (states[i] == PORT_BUSY)
+            busy.push_back(systemPorts[i]);
+        else if (states[i] == PORT_FREE)
+        {
+            bool const isClaimed = std::find(claimed.begin(), claimed.end(), resolvePort(systemPorts[i])) != claimed.end();
+            (isClaimed ? others : free).push_back(systemPorts[i]);
+        }
+        else
+            LOGF_DEBUG("Skipping %s, it can not be opened.", systemPorts[i].c_str());
+    }
+
+    std::vector<std::string> order = free;
+    order.insert(order.end(), others.begin(), others.end());
+
+    std::vector<std::string> doubleSearch = busy;
+    doubleSearch.insert(doubleSearch.end(), order.begin(), order.end());
+
+    // Try the current port as LAST port again
+    order.push_back(PortT[0].text);
+
+    // Double search, busy ports first, in case their drivers released them in the first pass
+    order.insert(order.end(), doubleSearch.begin(), doubleSearch.end());
+    return order;
+}
+
 bool Serial::Connect()
 {
     uint32_t baud = atoi(IUFindOnSwitch(&BaudRateSP)->name);
+
+    // Straight to where the device was last found if its adapter got another node
+    if (!m_Device->isSimulation() && m_Permission != IP_RO && AutoSearchS[0].s == ISS_ON && connectCachedPort())
+    {
+        m_Transactions.start(PortFD);
+        return true;
+    }
+
     if (Connect(PortT[0].text, baud) && processHandshake())
+    {
+        if (!m_Device->isSimulation() && m_Permission != IP_RO)
+            cachePort();
+        m_Transactions.start(PortFD);
         return true;
+    }
 
     // Important, disconnect from port immediately
     // to release the lock, otherwise another driver will find it busy.
@@ -201,37 +464,15 @@ bool Serial::Connect()
 
         std::this_thread::sleep_for(std::chrono::milliseconds(500 + (rand() % 1000)));
 
-        // Try to connect "randomly" so that competing devices don't all try to connect to the same
-        // ports at the same time.
-        std::vector<std::string> systemPorts;
-        for (int i = 0; i < SystemPortSP.nsp; i++)
-        {
-            // Only try the same port last again.
-            if (!strcmp(m_SystemPorts[i].c_str(), PortT[0].text))
-                continue;
-
-            systemPorts.push_back(m_SystemPorts[i].c_str());
-        }
-
-        std::random_device rd;
-        std::minstd_rand g(rd());
-        std::shuffle(systemPorts.begin(), systemPorts.end(), g);
-
-        std::vector<std::string> doubleSearch = systemPorts;
-
-        // Try the current port as LAST port again
-        systemPorts.push_back(PortT[0].text);
-
-        // Double search just in case some items were BUSY in the first pass
-        systemPorts.insert(systemPorts.end(), doubleSearch.begin(), doubleSearch.end());
-
-        for (const auto &port : systemPorts)
+        for (const auto &port : searchOrder())
         {
             LOGF_INFO("Trying connecting to %s @ %d ...", port.c_str(), baud);
             if (Connect(port.c_str(), baud) && processHandshake())
             {
                 IUSaveText(&PortT[0], port.c_str());
                 IDSetText(&PortTP, nullptr);
+                if (!m_Device->isSimulation())
+                    cachePort();
 
 #ifdef __linux__
                 bool saveConfig = false;
@@ -258,6 +499,7 @@ bool Serial::Connect()
                 if (std::find(m_SystemPorts.begin(), m_SystemPorts.end(), PortT[0].text) != m_SystemPorts.end())
                     m_Device->saveConfig(true, PortTP.name);
 #endif
+                m_Transactions.start(PortFD);
                 return true;
             }
 
@@ -320,6 +562,8 @@ bool Serial::Connect(const char *port, uint32_t baud)
 
 bool Serial::Disconnect()
 {
+    m_Transactions.stop();
+
     if (PortFD > 0)
     {
         tty_disconnect(PortFD);
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "connectioninterface.h"
+#include "transactionqueue.h"
 
 #include <string>
 #include <vector>
@@ -103,6 +104,16 @@ class Serial : public Interface
             return PortFD;
         }
 
+        /**
+         * @brief transactions Queue of asynchronous transactions on the port, running while connected.
+         * Drivers submit their commands to it from TimerHit() and property handlers instead of blocking
+         * on tty_write/tty_read, and get the replies on the event loop.
+         */
+        TransactionQueue &transactions()
+        {
+            return m_Transactions;
+        }
+
         virtual bool ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n) override;
         virtual bool ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n) override;
         virtual bool saveConfigItems(FILE *fp) override;
@@ -162,6 +173,18 @@ class Serial : public Interface
 
         virtual bool processHandshake();
 
+        /**
+         * \brief Connects to the port and baud rate the device was last found on, which may be another node by now,
+         * before the configured port fails and the auto search starts.
+         */
+        bool connectCachedPort();
+
+        /** \brief Records the port the device answered on in ~/.indi/SerialPorts.xml, by its stable name if it has one. */
+        void cachePort();
+
+        /** \brief The system ports to search, those found free first, then those other devices were found on. */
+        std::vector<std::string> searchOrder();
+
         enum
         {
             SERIAL_DEV,
@@ -197,5 +220,7 @@ class Serial : public Interface
         std::string m_ConfigPort;
         int m_ConfigBaudRate {-1};
         std::vector<std::string> m_SystemPorts;
+
+        TransactionQueue m_Transactions;
 };
 }
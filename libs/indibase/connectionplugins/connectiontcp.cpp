@@ -27,6 +27,12 @@
 #include <cstring>
 #include <unistd.h>
 #include <regex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
 
 #ifdef __FreeBSD__
 #include <arpa/inet.h>
@@ -194,6 +200,9 @@ bool TCP::establishConnection(const std::string &hostname, const std::string &po
     setsockopt(m_SockFD, SOL_SOCKET, SO_RCVTIMEO, &ts, sizeof(struct timeval));
     setsockopt(m_SockFD, SOL_SOCKET, SO_SNDTIMEO, &ts, sizeof(struct timeval));
 
+    if (m_LowLatency)
+        setSocketOptions(socketType);
+
     // Connect to the device
     if (::connect(m_SockFD, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
     {
@@ -207,6 +216,93 @@ bool TCP::establishConnection(const std::string &hostname, const std::string &po
     return true;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////////////////////////
+void TCP::setSocketOptions(int socketType)
+{
+    int enabled = 1;
+
+#ifdef IPTOS_LOWDELAY
+    int tos = IPTOS_LOWDELAY;
+    setsockopt(m_SockFD, IPPROTO_IP, IP_TOS, &tos, sizeof(tos));
+#endif
+
+    if (socketType != SOCK_STREAM)
+        return;
+
+    // Commands are a few bytes each, don't hold them back waiting for the previous ACK
+    setsockopt(m_SockFD, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+
+    setsockopt(m_SockFD, SOL_SOCKET, SO_KEEPALIVE, &enabled, sizeof(enabled));
+    int idle = KEEPALIVE_IDLE, interval = KEEPALIVE_INTERVAL, count = KEEPALIVE_COUNT;
+#if defined(TCP_KEEPIDLE)
+    setsockopt(m_SockFD, IPPROTO_TCP, TCP_KEEPIDLE, &idle, sizeof(idle));
+#elif defined(TCP_KEEPALIVE)
+    setsockopt(m_SockFD, IPPROTO_TCP, TCP_KEEPALIVE, &idle, sizeof(idle));
+#endif
+#ifdef TCP_KEEPINTVL
+    setsockopt(m_SockFD, IPPROTO_TCP, TCP_KEEPINTVL, &interval, sizeof(interval));
+#endif
+#ifdef TCP_KEEPCNT
+    setsockopt(m_SockFD, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count));
+#endif
+    INDI_UNUSED(idle);
+    INDI_UNUSED(interval);
+    INDI_UNUSED(count);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////////////////////////
+bool TCP::reconnect(int attempts)
+{
+    if (m_Device->isSimulation())
+        return true;
+
+    if (AddressT[0].text == nullptr || AddressT[0].text[0] == '\0' || AddressT[1].text == nullptr ||
+            AddressT[1].text[0] == '\0')
+        return false;
+
+    const std::string hostname = AddressT[0].text;
+    const std::string port = AddressT[1].text;
+    const int previousFD = m_SockFD;
+    int delay = RECONNECT_DELAY;
+
+    for (int i = 0; i < attempts; i++)
+    {
+        if (i > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            delay = std::min(delay * 2, static_cast<int>(RECONNECT_MAX_DELAY));
+        }
+
+        // Keep the previous descriptor open, its number is reused below
+        m_SockFD = -1;
+        if (!establishConnection(hostname, port, 2))
+            continue;
+
+        if (previousFD >= 0)
+        {
+            if (dup2(m_SockFD, previousFD) < 0)
+            {
+                close(m_SockFD);
+                continue;
+            }
+            close(m_SockFD);
+            m_SockFD = previousFD;
+        }
+
+        PortFD = m_SockFD;
+        LOGF_INFO("Reconnected to %s@%s.", hostname.c_str(), port.c_str());
+        return true;
+    }
+
+    m_SockFD = previousFD;
+    LOGF_ERROR("Failed to reconnect to %s@%s after %d attempts.", hostname.c_str(), port.c_str(), attempts);
+    return false;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 ///
 //////////////////////////////////////////////////////////////////////////////////////////////////
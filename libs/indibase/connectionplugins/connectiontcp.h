@@ -90,6 +90,25 @@ class TCP : public Interface
         void setConnectionType(int type);
         void setLANSearchEnabled(bool enabled);
 
+        /**
+         * @brief setLowLatency Send small commands without delay, mark packets for low delay, and probe
+         * idle TCP links so that a dead one fails reads instead of stalling them. Enabled by default.
+         * Applies to connections established afterwards.
+         */
+        void setLowLatency(bool enabled)
+        {
+            m_LowLatency = enabled;
+        }
+
+        /**
+         * @brief reconnect Connect again to the current host after the link dropped, waiting longer after
+         * each failed attempt. The port keeps its file descriptor number, so copies of it held by the driver
+         * stay valid. The device handshake is not repeated.
+         * @param attempts number of connection attempts before giving up.
+         * @return True if the connection is established again, false otherwise.
+         */
+        bool reconnect(int attempts = 5);
+
     protected:
         /**
          * @brief establishConnection Create a socket connection to the host and port. If successful, set the socket variable.
@@ -101,6 +120,11 @@ class TCP : public Interface
          */
         bool establishConnection(const std::string &hostname, const std::string &port, int timeout = -1);
 
+        /**
+         * @brief setSocketOptions Apply the low latency and keepalive options to the socket.
+         */
+        void setSocketOptions(int socketType);
+
         //////////////////////////////////////////////////////////////////////////////////////////////////
         /// Properties
         //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -121,6 +145,14 @@ class TCP : public Interface
         int m_ConfigConnectionType {-1};
         int m_SockFD {-1};
         int PortFD = -1;
+        bool m_LowLatency {true};
         static constexpr uint8_t SOCKET_TIMEOUT {5};
+        // Idle seconds before the first keepalive probe, seconds between probes, and probes lost before the link is dropped
+        static constexpr int KEEPALIVE_IDLE {10};
+        static constexpr int KEEPALIVE_INTERVAL {5};
+        static constexpr int KEEPALIVE_COUNT {3};
+        // Wait before the first reconnection attempt and longest wait between attempts, in milliseconds
+        static constexpr int RECONNECT_DELAY {100};
+        static constexpr int RECONNECT_MAX_DELAY {2000};
 };
 }
@@ -0,0 +1,229 @@
+/*******************************************************************************
+ Asynchronous command/reply transactions on a connection
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "transactionqueue.h"
+
+#include "eventloop.h"
+#include "indicom.h"
+
+#include <chrono>
+#include <vector>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <termios.h>
+#endif
+
+namespace Connection
+{
+
+// Longest wait before checking whether the queue is stopping
+static constexpr int SliceMs = 100;
+
+TransactionQueue::~TransactionQueue()
+{
+    stop();
+}
+
+void TransactionQueue::start(int fd)
+{
+    stop();
+    m_FD = fd;
+    m_Thread = std::thread(&TransactionQueue::run, this);
+}
+
+void TransactionQueue::stop()
+{
+    std::map<Key, Transaction> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Stopping = true;
+        dropped.swap(m_Pending);
+    }
+    m_Wake.notify_all();
+
+    if (m_Thread.joinable())
+        m_Thread.join();
+
+    m_Stopping = false;
+    m_FD = -1;
+
+    for (auto &one : dropped)
+        complete(one.second, TTY_ERRNO, std::string());
+}
+
+uint64_t TransactionQueue::submit(Transaction transaction)
+{
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        id = m_NextId++;
+        m_Pending.emplace(Key(-transaction.priority, id), std::move(transaction));
+    }
+    m_Wake.notify_one();
+    return id;
+}
+
+uint64_t TransactionQueue::submit(const std::string &command, char terminator, Completion completion,
+                                  Priority priority, int timeoutMs)
+{
+    Transaction transaction;
+    transaction.command = command;
+    transaction.matcher = terminatedBy(terminator);
+    transaction.timeoutMs = timeoutMs;
+    transaction.priority = priority;
+    transaction.completion = std::move(completion);
+    return submit(std::move(transaction));
+}
+
+bool TransactionQueue::cancel(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    for (auto it = m_Pending.begin(); it != m_Pending.end(); ++it)
+    {
+        if (it->first.second == id)
+        {
+            m_Pending.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransactionQueue::cancelPending(Priority priority)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_Pending.erase(m_Pending.lower_bound(Key(-priority, 0)), m_Pending.end());
+}
+
+TransactionQueue::Matcher TransactionQueue::terminatedBy(char terminator)
+{
+    return [terminator](const std::string &received)
+    {
+        size_t end = received.find(terminator);
+        return end == std::string::npos ? 0 : static_cast<int>(end + 1);
+    };
+}
+
+TransactionQueue::Matcher TransactionQueue::fixedLength(size_t length)
+{
+    return [length](const std::string &received)
+    {
+        return received.size() < length ? 0 : static_cast<int>(length);
+    };
+}
+
+void TransactionQueue::run()
+{
+    for (;;)
+    {
+        Transaction transaction;
+        {
+            std::unique_lock<std::mutex> lock(m_Lock);
+            m_Wake.wait(lock, [this] { return m_Stopping || !m_Pending.empty(); });
+            if (m_Stopping)
+                return;
+
+            transaction = std::move(m_Pending.begin()->second);
+            m_Pending.erase(m_Pending.begin());
+        }
+        execute(transaction);
+    }
+}
+
+void TransactionQueue::execute(Transaction &transaction)
+{
+    int nbytes = 0, rc;
+
+#ifndef _WIN32
+    // Whatever came in before the command is not its reply
+    tcflush(m_FD, TCIFLUSH);
+#endif
+
+    if ((rc = tty_write(m_FD, transaction.command.data(), static_cast<int>(transaction.command.size()), &nbytes)) != TTY_OK)
+    {
+        complete(transaction, rc, std::string());
+        return;
+    }
+
+    if (!transaction.matcher)
+    {
+        complete(transaction, TTY_OK, std::string());
+        return;
+    }
+
+    std::string received;
+    char buffer[256];
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(transaction.timeoutMs);
+
+    while (!m_Stopping)
+    {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (left <= 0)
+        {
+            complete(transaction, TTY_TIME_OUT, received);
+            return;
+        }
+
+        long waitMs = std::min<long>(left, SliceMs);
+        rc = tty_timeout_microseconds(m_FD, waitMs / 1000, (waitMs % 1000) * 1000);
+        if (rc == TTY_TIME_OUT)
+            continue;
+        if (rc != TTY_OK)
+        {
+            complete(transaction, rc, received);
+            return;
+        }
+
+        ssize_t count = read(m_FD, buffer, sizeof(buffer));
+        if (count <= 0)
+        {
+            complete(transaction, TTY_READ_ERROR, received);
+            return;
+        }
+        received.append(buffer, count);
+
+        int length = transaction.matcher(received);
+        if (length > 0)
+        {
+            complete(transaction, TTY_OK, received.substr(0, length));
+            return;
+        }
+        if (length < 0)
+        {
+            complete(transaction, TTY_READ_ERROR, received);
+            return;
+        }
+    }
+
+    complete(transaction, TTY_ERRNO, received);
+}
+
+void TransactionQueue::complete(const Transaction &transaction, int error, const std::string &reply)
+{
+    if (!transaction.completion)
+        return;
+
+    Completion completion = transaction.completion;
+    postToEventLoop([completion, error, reply]
+    {
+        completion(error, reply);
+    });
+}
+
+}
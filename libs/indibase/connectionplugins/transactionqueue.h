@@ -0,0 +1,126 @@
+/*******************************************************************************
+ Asynchronous command/reply transactions on a connection
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace Connection
+{
+/**
+ * @brief The TransactionQueue class runs command/reply transactions on a file descriptor from a thread of
+ * its own, so that a slow device does not hold the driver's main thread.
+ *
+ * Transactions run one at a time, highest priority first and in submission order within a priority: an
+ * abort or a guide pulse submitted while status polls are queued goes out next. Each transaction writes
+ * its command, reads until its matcher finds a complete reply or its timeout expires, and its completion
+ * is then called on the driver's event loop with a TTY error code and the reply.
+ *
+ * While the queue runs, all I/O on the descriptor should go through it.
+ */
+class TransactionQueue
+{
+    public:
+        typedef enum
+        {
+            PRIORITY_POLL,      /*!< Status polls, run when nothing else is waiting */
+            PRIORITY_NORMAL,    /*!< Commands */
+            PRIORITY_HIGH       /*!< Aborts and guide pulses */
+        } Priority;
+
+        /**
+         * @brief Returns the length of the complete reply at the start of the bytes read so far,
+         * 0 if more bytes are needed, or -1 if they can't be a valid reply.
+         */
+        typedef std::function<int(const std::string &received)> Matcher;
+
+        /**
+         * @brief Called on the event loop with TTY_OK and the reply, or the TTY error code of the failure.
+         */
+        typedef std::function<void(int error, const std::string &reply)> Completion;
+
+        struct Transaction
+        {
+            std::string command;                    /*!< Bytes written to the device */
+            Matcher matcher;                        /*!< Empty if no reply is expected */
+            int timeoutMs = 1000;                   /*!< Time allowed for the reply */
+            Priority priority = PRIORITY_NORMAL;
+            Completion completion;                  /*!< May be empty */
+        };
+
+    public:
+        TransactionQueue() = default;
+        ~TransactionQueue();
+
+        /** @brief Starts running transactions on fd. The queue does not own fd. */
+        void start(int fd);
+
+        /** @brief Waits for the running transaction and fails those not started with TTY_ERRNO. */
+        void stop();
+
+        bool isRunning() const
+        {
+            return m_Thread.joinable();
+        }
+
+        /** @brief Queues a transaction and returns its id. */
+        uint64_t submit(Transaction transaction);
+
+        /** @brief Shortcut to queue command with a reply ending with terminator. */
+        uint64_t submit(const std::string &command, char terminator, Completion completion,
+                        Priority priority = PRIORITY_NORMAL, int timeoutMs = 1000);
+
+        /** @brief Drops a transaction not started yet, whose completion is then not called. */
+        bool cancel(uint64_t id);
+
+        /** @brief Drops all transactions not started yet with a priority up to priority. */
+        void cancelPending(Priority priority = PRIORITY_HIGH);
+
+    public:
+        /** @brief Matches replies ending with terminator. */
+        static Matcher terminatedBy(char terminator);
+
+        /** @brief Matches replies of length bytes. */
+        static Matcher fixedLength(size_t length);
+
+    protected:
+        void run();
+        void execute(Transaction &transaction);
+        static void complete(const Transaction &transaction, int error, const std::string &reply);
+
+    protected:
+        // Highest priority first, then by id, which grows with each submit
+        typedef std::pair<int, uint64_t> Key;
+        std::map<Key, Transaction> m_Pending;
+
+        std::mutex m_Lock;
+        std::condition_variable m_Wake;
+        std::thread m_Thread;
+        std::atomic_bool m_Stopping {false};
+        uint64_t m_NextId {1};
+        int m_FD {-1};
+};
+}
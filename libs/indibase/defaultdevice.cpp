@@ -21,6 +21,9 @@
 
 #include "indicom.h"
 #include "indiapi.h"
+#include "eventloop.h"
+#include "lilxml.h"
+#include "sharedblob.h"
 
 #include "indistandardproperty.h"
 #include "connectionplugins/connectionserial.h"
@@ -30,6 +33,7 @@
 #include "indipropertynumber.h"
 #include "indipropertyblob.h"
 
+#include <cerrno>
 #include <cstdlib>
 #include <cstring>
 #include <assert.h>
@@ -52,14 +56,61 @@ const char *INFO_TAB          = "General Info";
 std::list<INDI::DefaultDevicePrivate*> INDI::DefaultDevicePrivate::devices;
 std::recursive_mutex                   INDI::DefaultDevicePrivate::devicesLock;
 
+namespace
+{
+// Copy of the strings of a call, for a device that takes the call later on its own thread
+struct Strings
+{
+    Strings(char *strings[], int n) : values(strings, strings + n) { }
+
+    char **data()
+    {
+        pointers.clear();
+        for (auto &value : values)
+            pointers.push_back(&value[0]);
+        return pointers.data();
+    }
+
+    std::vector<std::string> values;
+    std::vector<char *> pointers;
+};
+}
+
 extern "C"
 {
 
     void ISGetProperties(const char *dev)
     {
         const std::unique_lock<std::recursive_mutex> lock(INDI::DefaultDevicePrivate::devicesLock);
+        // All the definitions go out in one write
+        const INDI::DefineBatch batch;
         for(auto &it : INDI::DefaultDevicePrivate::devices)
+        {
+            bool const asked = dev == nullptr || strcmp(dev, it->defaultDevice->getDeviceName()) == 0;
+            if (it->isDeferred())
+            {
+                std::string device = dev ? dev : "";
+                bool const all = dev == nullptr;
+                it->executor->post([it, device, all, asked]
+                {
+                    const INDI::DefineBatch batch;
+                    it->defaultDevice->ISGetProperties(all ? nullptr : device.c_str());
+                    if (asked)
+                    {
+                        it->getPropertiesCount++;
+                        it->schedulePolls();
+                    }
+                });
+                continue;
+            }
+
             it->defaultDevice->ISGetProperties(dev);
+            if (asked)
+            {
+                it->getPropertiesCount++;
+                it->schedulePolls();
+            }
+        }
     }
 
     void ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int n)
@@ -67,7 +118,22 @@ extern "C"
         const std::unique_lock<std::recursive_mutex> lock(INDI::DefaultDevicePrivate::devicesLock);
         for(auto &it : INDI::DefaultDevicePrivate::devices)
             if (dev == nullptr || strcmp(dev, it->defaultDevice->getDeviceName()) == 0)
+            {
+                if (it->isDeferred())
+                {
+                    std::string device = it->defaultDevice->getDeviceName(), property = name;
+                    std::vector<ISState> copy(states, states + n);
+                    Strings elements(names, n);
+                    it->executor->post([it, device, property, copy, elements, n]() mutable
+                    {
+                        it->defaultDevice->ISNewSwitch(device.c_str(), property.c_str(), copy.data(), elements.data(), n);
+                        it->schedulePolls();
+                    });
+                    continue;
+                }
                 it->defaultDevice->ISNewSwitch(dev, name, states, names, n);
+                it->schedulePolls();
+            }
     }
 
     void ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n)
@@ -75,7 +141,22 @@ extern "C"
         const std::unique_lock<std::recursive_mutex> lock(INDI::DefaultDevicePrivate::devicesLock);
         for(auto &it : INDI::DefaultDevicePrivate::devices)
             if (dev == nullptr || strcmp(dev, it->defaultDevice->getDeviceName()) == 0)
+            {
+                if (it->isDeferred())
+                {
+                    std::string device = it->defaultDevice->getDeviceName(), property = name;
+                    std::vector<double> copy(values, values + n);
+                    Strings elements(names, n);
+                    it->executor->post([it, device, property, copy, elements, n]() mutable
+                    {
+                        it->defaultDevice->ISNewNumber(device.c_str(), property.c_str(), copy.data(), elements.data(), n);
+                        it->schedulePolls();
+                    });
+                    continue;
+                }
                 it->defaultDevice->ISNewNumber(dev, name, values, names, n);
+                it->schedulePolls();
+            }
     }
 
     void ISNewText(const char *dev, const char *name, char *texts[], char *names[], int n)
@@ -83,7 +164,21 @@ extern "C"
         const std::unique_lock<std::recursive_mutex> lock(INDI::DefaultDevicePrivate::devicesLock);
         for(auto &it : INDI::DefaultDevicePrivate::devices)
             if (dev == nullptr || strcmp(dev, it->defaultDevice->getDeviceName()) == 0)
+            {
+                if (it->isDeferred())
+                {
+                    std::string device = it->defaultDevice->getDeviceName(), property = name;
+                    Strings copy(texts, n), elements(names, n);
+                    it->executor->post([it, device, property, copy, elements, n]() mutable
+                    {
+                        it->defaultDevice->ISNewText(device.c_str(), property.c_str(), copy.data(), elements.data(), n);
+                        it->schedulePolls();
+                    });
+                    continue;
+                }
                 it->defaultDevice->ISNewText(dev, name, texts, names, n);
+                it->schedulePolls();
+            }
     }
 
     void ISNewBLOB(const char *dev, const char *name,
@@ -93,14 +188,53 @@ extern "C"
         const std::unique_lock<std::recursive_mutex> lock(INDI::DefaultDevicePrivate::devicesLock);
         for(auto &it : INDI::DefaultDevicePrivate::devices)
             if (dev == nullptr || strcmp(dev, it->defaultDevice->getDeviceName()) == 0)
+            {
+                if (it->isDeferred())
+                {
+                    // The buffers of the call are freed once it returns, the device gets shared copies of its own
+                    std::shared_ptr<std::vector<char *>> copy(new std::vector<char *>, [](std::vector<char *> *buffers)
+                    {
+                        for (auto buffer : *buffers)
+                            IDSharedBlobFree(buffer);
+                        delete buffers;
+                    });
+                    for (int i = 0; i < n; i++)
+                    {
+                        copy->push_back(static_cast<char *>(IDSharedBlobAlloc(std::max(blobsizes[i], 1))));
+                        if (blobsizes[i] > 0)
+                            memcpy(copy->back(), blobs[i], blobsizes[i]);
+                    }
+                    std::string device = it->defaultDevice->getDeviceName(), property = name;
+                    std::vector<int> copySizes(sizes, sizes + n), copyBlobSizes(blobsizes, blobsizes + n);
+                    Strings copyFormats(formats, n), elements(names, n);
+                    it->executor->post([it, device, property, copySizes, copyBlobSizes, copy, copyFormats, elements,
+                                        n]() mutable
+                    {
+                        it->defaultDevice->ISNewBLOB(device.c_str(), property.c_str(), copySizes.data(),
+                                                     copyBlobSizes.data(), copy->data(), copyFormats.data(),
+                                                     elements.data(), n);
+                        it->schedulePolls();
+                    });
+                    continue;
+                }
                 it->defaultDevice->ISNewBLOB(dev, name, sizes, blobsizes, blobs, formats, names, n);
+                it->schedulePolls();
+            }
     }
 
     void ISSnoopDevice(XMLEle *root)
     {
         const std::unique_lock<std::recursive_mutex> lock(INDI::DefaultDevicePrivate::devicesLock);
         for(auto &it : INDI::DefaultDevicePrivate::devices)
+        {
+            if (it->isDeferred())
+            {
+                std::shared_ptr<XMLEle> copy(cloneXMLEle(root, nullptr, nullptr), delXMLEle);
+                it->executor->post([it, copy] { it->defaultDevice->ISSnoopDevice(copy.get()); });
+                continue;
+            }
             it->defaultDevice->ISSnoopDevice(root);
+        }
     }
 
 } // extern "C"
@@ -175,13 +309,137 @@ DefaultDevicePrivate::~DefaultDevicePrivate()
     devices.remove(this);
 }
 
+void DefaultDevicePrivate::hostDevices()
+{
+    const std::unique_lock<std::recursive_mutex> lock(DefaultDevicePrivate::devicesLock);
+    for (auto &it : DefaultDevicePrivate::devices)
+    {
+        // Named now, as a device may snoop on another one before its first getProperties names it
+        if (*it->defaultDevice->getDeviceName() == '\0')
+            it->defaultDevice->setDeviceName(it->defaultDevice->getDefaultName());
+        IDLocalDevice(it->defaultDevice->getDeviceName());
+    }
+}
+
+void DefaultDevicePrivate::getLazyProperty(const char *dev, const char *name)
+{
+    const std::unique_lock<std::recursive_mutex> lock(DefaultDevicePrivate::devicesLock);
+    // The client looks at the tab of the property, define all of it
+    const DefineBatch batch;
+    for (auto &it : DefaultDevicePrivate::devices)
+    {
+        if (strcmp(dev, it->defaultDevice->getDeviceName()) != 0)
+            continue;
+
+        std::string propertyName = name;
+        it->execute([it, propertyName]
+        {
+            if (it->lazyProperties.count(propertyName) == 0)
+                return;
+
+            const DefineBatch batch;
+            INDI::Property property = it->defaultDevice->getProperty(propertyName.c_str());
+            if (property)
+                it->defaultDevice->defineLazyGroup(property.getGroupName());
+        });
+    }
+}
+
+bool DefaultDevicePrivate::isDeferred() const
+{
+    return executor && !executor->isCurrent();
+}
+
+void DefaultDevicePrivate::execute(const std::function<void()> &function)
+{
+    if (isDeferred())
+        executor->post(function);
+    else
+        function();
+}
+
+void DefaultDevicePrivate::onEventLoop(const std::function<void()> &function)
+{
+    if (executor && executor->isCurrent())
+        postToEventLoop(function);
+    else
+        function();
+}
+
 DefaultDevice::DefaultDevice()
     : ParentDevice(std::shared_ptr<ParentDevicePrivate>(new DefaultDevicePrivate(this)))
 {
     D_PTR(DefaultDevice);
+    IDSetGetPropertyHandler(&DefaultDevicePrivate::getLazyProperty);
     d->m_MainLoopTimer.setSingleShot(true);
     d->m_MainLoopTimer.setInterval(getPollingPeriod());
-    d->m_MainLoopTimer.callOnTimeout(std::bind(&DefaultDevice::TimerHit, this));
+    d->m_MainLoopTimer.callOnTimeout([this, d] { d->execute([this] { TimerHit(); }); });
+    d->m_PollTimer.setSingleShot(true);
+    d->m_PollTimer.callOnTimeout([d] { d->execute([d] { d->runPolls(); }); });
+}
+
+DefaultDevice::~DefaultDevice()
+{
+    D_PTR(DefaultDevice);
+    // Nothing of the device runs on its thread once it is gone
+    d->executor.reset();
+}
+
+bool DefaultDevicePrivate::isBusy(const std::string &property) const
+{
+    for (const auto &oneProperty : defaultDevice->getProperties())
+    {
+        if (!property.empty() && property != oneProperty.getName())
+            continue;
+        if (oneProperty.getState() == IPS_BUSY)
+            return true;
+    }
+    return false;
+}
+
+uint32_t DefaultDevicePrivate::pollPeriod(const Poll &poll) const
+{
+    uint32_t period = isBusy(poll.property) ? poll.activeMs : poll.idleMs;
+    return getPropertiesCount < 2 ? period * pollBackoff : period;
+}
+
+void DefaultDevicePrivate::runPolls()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // Callbacks may add or remove polls, run them from a copy of the due ones
+    std::vector<Poll> due;
+    for (auto &poll : polls)
+    {
+        if (poll.lastRun + std::chrono::milliseconds(pollPeriod(poll)) <= now)
+        {
+            poll.lastRun = now;
+            due.push_back(poll);
+        }
+    }
+
+    for (auto &poll : due)
+        poll.callback();
+
+    schedulePolls();
+}
+
+void DefaultDevicePrivate::schedulePolls()
+{
+    if (polls.empty())
+    {
+        onEventLoop([this] { m_PollTimer.stop(); });
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    auto next = std::chrono::steady_clock::time_point::max();
+    for (auto &poll : polls)
+        next = std::min(next, poll.lastRun + std::chrono::milliseconds(pollPeriod(poll)));
+
+    auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count();
+    int const ms = wait > 0 ? static_cast<int>(wait) : 0;
+    onEventLoop([this, ms] { m_PollTimer.start(ms); });
 }
 
 bool DefaultDevice::loadConfig(INDI::Property &property)
@@ -280,12 +538,15 @@ bool DefaultDevice::saveConfig(bool silent, const char *property)
 
     if (property == nullptr)
     {
-        fp = IUGetConfigFP(nullptr, getDeviceName(), "w", errmsg);
+        // Properties are serialized here, the file itself is written in the background
+        char *content = nullptr;
+        size_t contentSize = 0;
+        fp = open_memstream(&content, &contentSize);
 
         if (fp == nullptr)
         {
             if (!silent)
-                LOGF_WARN("Failed to save configuration. %s", errmsg);
+                LOGF_WARN("Failed to save configuration. %s", strerror(errno));
             return false;
         }
 
@@ -295,9 +556,18 @@ bool DefaultDevice::saveConfig(bool silent, const char *property)
 
         IUSaveConfigTag(fp, 1, getDeviceName(), silent ? 1 : 0);
 
-        fflush(fp);
         fclose(fp);
 
+        int rc = IUSaveConfigDeferred(nullptr, getDeviceName(), content, contentSize, errmsg);
+        free(content);
+
+        if (rc != 0)
+        {
+            if (!silent)
+                LOGF_WARN("Failed to save configuration. %s", errmsg);
+            return false;
+        }
+
         if (d->isDefaultConfigLoaded == false)
         {
             d->isDefaultConfigLoaded = IUSaveDefaultConfig(nullptr, nullptr, getDeviceName()) == 0;
@@ -416,11 +686,16 @@ bool DefaultDevice::saveConfig(bool silent, const char *property)
 
         if (propertySaved)
         {
-            fp = IUGetConfigFP(nullptr, getDeviceName(), "w", errmsg);
-            prXMLEle(fp, root, 0);
-            fflush(fp);
-            fclose(fp);
+            char *content = nullptr;
+            size_t contentSize = sprXMLEleAlloc(&content, root, 0, nullptr, nullptr, 0);
+            int rc = IUSaveConfigDeferred(nullptr, getDeviceName(), content, contentSize, errmsg);
+            free(content);
             delXMLEle(root);
+            if (rc != 0)
+            {
+                LOGF_WARN("Failed to save configuration for %s. %s", property, errmsg);
+                return false;
+            }
             LOGF_DEBUG("Configuration successfully saved for %s.", property);
             return true;
         }
@@ -564,7 +839,50 @@ bool DefaultDevice::ISSnoopDevice(XMLEle *root)
 {
     D_PTR(DefaultDevice);
     char errmsg[MAXRBUF];
-    return d->watchDevice.processXml(INDI::LilXmlElement(root), errmsg) < 0;
+    bool watched = d->watchDevice.processXml(INDI::LilXmlElement(root), errmsg) < 0;
+
+    if (d->snoopHandlers.empty())
+        return watched;
+
+    auto handler = d->snoopHandlers.find(std::make_pair(std::string(findXMLAttValu(root, "device")),
+                                                        std::string(findXMLAttValu(root, "name"))));
+    return handler != d->snoopHandlers.end() ? handler->second(root) : watched;
+}
+
+void DefaultDevice::watchSnoop(const char *deviceName, const char *propertyName,
+                               const std::function<bool (XMLEle *)> &handler)
+{
+    D_PTR(DefaultDevice);
+    if (deviceName == nullptr || deviceName[0] == '\0')
+        return;
+
+    d->snoopHandlers[std::make_pair(std::string(deviceName), std::string(propertyName))] = handler;
+    IDSnoopDevice(deviceName, propertyName);
+}
+
+void DefaultDevice::watchSnoopLatest(const char *deviceName, const char *propertyName, double threshold,
+                                     const std::function<bool (XMLEle *)> &handler)
+{
+    D_PTR(DefaultDevice);
+    if (deviceName == nullptr || deviceName[0] == '\0')
+        return;
+
+    d->snoopHandlers[std::make_pair(std::string(deviceName), std::string(propertyName))] = handler;
+    IDSnoopDeviceLatest(deviceName, propertyName, threshold);
+}
+
+void DefaultDevice::requestSnoop(const char *deviceName, const char *propertyName)
+{
+    IDSnoopRequest(deviceName, propertyName);
+}
+
+void DefaultDevice::unwatchSnoop(const char *deviceName, const char *propertyName)
+{
+    D_PTR(DefaultDevice);
+    if (deviceName == nullptr)
+        return;
+
+    d->snoopHandlers.erase(std::make_pair(std::string(deviceName), std::string(propertyName)));
 }
 
 void DefaultDevice::watchDevice(const char *name, const std::function<void (BaseDevice)> &callback)
@@ -715,6 +1033,9 @@ void DefaultDevice::ISGetProperties(const char *dev)
         if (d->defineDynamicProperties == false && oneProperty.isDynamic())
             continue;
 
+        if (!d->lazyProperties.empty() && d->lazyProperties.count(oneProperty.getName()))
+            continue;
+
         oneProperty.define();
     }
 
@@ -803,7 +1124,7 @@ void DefaultDevice::setConnected(bool status, IPState state, const char *msg)
 int DefaultDevice::SetTimer(uint32_t ms)
 {
     D_PTR(DefaultDevice);
-    d->m_MainLoopTimer.start(ms);
+    d->onEventLoop([d, ms] { d->m_MainLoopTimer.start(ms); });
     return 1;
 }
 
@@ -813,7 +1134,7 @@ void DefaultDevice::RemoveTimer(int id)
 {
     INDI_UNUSED(id);
     D_PTR(DefaultDevice);
-    d->m_MainLoopTimer.stop();
+    d->onEventLoop([d] { d->m_MainLoopTimer.stop(); });
     return;
 }
 
@@ -907,6 +1228,7 @@ bool DefaultDevice::initProperties()
                 {
                     // Connection is successful, set it to OK and updateProperties.
                     setConnected(true);
+                    const DefineBatch batch;
                     updateProperties();
                 }
                 else
@@ -926,6 +1248,7 @@ bool DefaultDevice::initProperties()
                 if (Disconnect())
                 {
                     setConnected(false, IPS_IDLE);
+                    const DefineBatch batch;
                     updateProperties();
                 }
                 else
@@ -1039,6 +1362,10 @@ bool DefaultDevice::deleteProperty(const char *propertyName)
         return true;
     }
 
+    // Clients never saw it
+    if (d->lazyProperties.erase(propertyName))
+        return removeProperty(propertyName, errmsg) == 0;
+
     // Keep dynamic properties in existing property list so they can be reused
     if (d->deleteDynamicProperties == false)
     {
@@ -1095,6 +1422,44 @@ void DefaultDevice::defineProperty(INDI::Property &property)
     property.define();
 }
 
+void DefaultDevice::defineLazyProperty(const INDI::Property &property)
+{
+    D_PTR(DefaultDevice);
+    if (getProperty(property.getName()) && d->lazyProperties.count(property.getName()) == 0)
+    {
+        // Defined already
+        property.define();
+        return;
+    }
+
+    registerProperty(property);
+    d->lazyProperties.insert(property.getName());
+}
+
+void DefaultDevice::defineLazyGroup(const char *groupName)
+{
+    D_PTR(DefaultDevice);
+    for (auto it = d->lazyProperties.begin(); it != d->lazyProperties.end();)
+    {
+        INDI::Property property = getProperty(it->c_str());
+        if (property && strcmp(property.getGroupName(), groupName) != 0)
+        {
+            ++it;
+            continue;
+        }
+
+        it = d->lazyProperties.erase(it);
+        if (property)
+            property.define();
+    }
+}
+
+bool DefaultDevice::isLazyProperty(const char *propertyName) const
+{
+    D_PTR(const DefaultDevice);
+    return d->lazyProperties.count(propertyName) > 0;
+}
+
 void DefaultDevice::defineNumber(INumberVectorProperty *nvp)
 {
     defineProperty(nvp);
@@ -1234,6 +1599,59 @@ void DefaultDevice::setPollingPeriodRange(uint32_t minimum, uint32_t maximum)
     d->PollPeriodNP.updateMinMax();
 }
 
+void DefaultDevice::setNumberUpdatePolicy(const char *name, uint32_t minPeriodMs, bool skipIdentical)
+{
+    IDSetNumberPolicy(getDeviceName(), name, minPeriodMs, skipIdentical ? 1 : 0);
+}
+
+int DefaultDevice::addPoll(uint32_t activeMs, uint32_t idleMs, const std::function<void()> &callback, const char *property)
+{
+    D_PTR(DefaultDevice);
+    DefaultDevicePrivate::Poll poll;
+    poll.id = d->nextPollId++;
+    poll.property = property ? property : "";
+    poll.activeMs = activeMs;
+    poll.idleMs = idleMs;
+    poll.callback = callback;
+    poll.lastRun = std::chrono::steady_clock::now();
+    d->polls.push_back(poll);
+    d->schedulePolls();
+    return poll.id;
+}
+
+void DefaultDevice::removePoll(int id)
+{
+    D_PTR(DefaultDevice);
+    d->polls.erase(std::remove_if(d->polls.begin(), d->polls.end(), [id](const DefaultDevicePrivate::Poll & poll)
+    {
+        return poll.id == id;
+    }), d->polls.end());
+    d->schedulePolls();
+}
+
+void DefaultDevice::setPollBackoff(uint32_t factor)
+{
+    D_PTR(DefaultDevice);
+    d->pollBackoff = factor > 0 ? factor : 1;
+    d->schedulePolls();
+}
+
+void DefaultDevice::updatePolling()
+{
+    D_PTR(DefaultDevice);
+    d->schedulePolls();
+}
+
+void DefaultDevice::setOwnThread(bool enable)
+{
+    D_PTR(DefaultDevice);
+    const std::unique_lock<std::recursive_mutex> lock(DefaultDevicePrivate::devicesLock);
+    if (enable && !d->executor)
+        d->executor.reset(new TaskQueue);
+    else if (!enable)
+        d->executor.reset();
+}
+
 void DefaultDevice::setActiveConnection(Connection::Interface *existingConnection)
 {
     D_PTR(DefaultDevice);
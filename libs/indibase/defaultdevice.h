@@ -23,6 +23,7 @@
 #include "indilogger.h"
 
 #include <stdint.h>
+#include <functional>
 
 namespace Connection
 {
@@ -114,6 +115,27 @@ extern const char *INFO_TAB;
 namespace INDI
 {
 
+/**
+ * @brief The DefineBatch class writes the messages the calling thread sends during its lifetime to the server at
+ * once, as described in IDBatchBegin(). DefaultDevice opens one around ISGetProperties() and updateProperties(), so that
+ * defining hundreds of properties costs the server a single read.
+ */
+class DefineBatch
+{
+    public:
+        DefineBatch()
+        {
+            IDBatchBegin();
+        }
+        ~DefineBatch()
+        {
+            IDBatchEnd();
+        }
+
+        DefineBatch(const DefineBatch &) = delete;
+        DefineBatch &operator=(const DefineBatch &) = delete;
+};
+
 class DefaultDevicePrivate;
 class DefaultDevice : public ParentDevice
 {
@@ -121,7 +143,7 @@ class DefaultDevice : public ParentDevice
 
     public:
         DefaultDevice();
-        virtual ~DefaultDevice() override = default;
+        virtual ~DefaultDevice() override;
 
     public:
         /** \brief Add Debug, Simulation, and Configuration options to the driver */
@@ -194,6 +216,22 @@ class DefaultDevice : public ParentDevice
         void defineProperty(IBLOBVectorProperty *property);
 
         void defineProperty(INDI::Property &property);
+
+        /**
+         * @brief Registers a property without defining it to clients yet. It is defined with the rest of its group by
+         * defineLazyGroup(), once probing confirms the device has the feature, or when a client asks for it by name.
+         * Until then ISGetProperties() leaves it out, so features a device lacks, or that no client looks at, cost
+         * neither connect time nor client memory.
+         * @note deleteProperty() removes it as any other property.
+         */
+        void defineLazyProperty(const INDI::Property &property);
+
+        /** @brief Defines the properties of group registered with defineLazyProperty() and not defined yet. */
+        void defineLazyGroup(const char *groupName);
+
+        /** @returns True if the property was registered with defineLazyProperty() and is not defined yet. */
+        bool isLazyProperty(const char *propertyName) const;
+
         /**
          * \brief Delete a property and unregister it. It will also be deleted from all clients.
          * \param propertyName name of property to be deleted.
@@ -300,7 +338,7 @@ class DefaultDevice : public ParentDevice
 
         /**
          * \brief Process a snoop event from INDI server. This function is called when a snooped property is
-         * updated in a snooped driver.
+         * updated in a snooped driver. The handlers registered with watchSnoop() are called from here.
          * \note This function is called by the INDI framework, do not call it directly.
          * \returns True if any property was successfully processed, false otherwise.
          */
@@ -327,6 +365,30 @@ class DefaultDevice : public ParentDevice
          */
         void watchDevice(const char *deviceName, const std::function<void (INDI::BaseDevice)> &callback);
 
+        /**
+         * @brief Handles the snooped updates of a property of another device, and snoops it.
+         *
+         * Snooped messages are dispatched to their handler by device and property before anything else is parsed,
+         * so a driver snooping many properties does not test each message against all of them. A handler returns
+         * what ISSnoopDevice() returns for the message. A property of a device has a single handler, registering
+         * another one replaces it.
+         * @note Nothing is snooped if deviceName is empty.
+         */
+        void watchSnoop(const char *deviceName, const char *propertyName, const std::function<bool (XMLEle *root)> &handler);
+
+        /**
+         * @brief Like watchSnoop(), but the server only sends the updates that change the state, a text or a switch,
+         * or a number by more than threshold. requestSnoop() gets the latest value when it is needed.
+         */
+        void watchSnoopLatest(const char *deviceName, const char *propertyName, double threshold,
+                              const std::function<bool (XMLEle *root)> &handler);
+
+        /** @brief Asks the server for the latest value of a property watched with watchSnoopLatest(). */
+        void requestSnoop(const char *deviceName, const char *propertyName);
+
+        /** @brief Removes the handler of a snooped property. Messages of the property are then ignored. */
+        void unwatchSnoop(const char *deviceName, const char *propertyName);
+
     protected:
         /**
          * @brief setDynamicPropertiesBehavior controls handling of dynamic properties. Dynamic properties
@@ -537,6 +599,60 @@ class DefaultDevice : public ParentDevice
          */
         uint32_t getCurrentPollingPeriod() const;
 
+        /**
+         * @brief setNumberUpdatePolicy Filter the updates of a number property sent from a polling loop.
+         * Updates that change the property state, or carry a message, are always sent.
+         * @param name name of the number property of this device.
+         * @param minPeriodMs send at most one update every minPeriodMs milliseconds, 0 to disable.
+         * @param skipIdentical drop updates whose values did not change since the last one sent.
+         */
+        void setNumberUpdatePolicy(const char *name, uint32_t minPeriodMs, bool skipIdentical = true);
+
+        /**
+         * @brief addPoll Call callback periodically, every activeMs while the device is busy and every idleMs
+         * otherwise. Polls run from the event loop, independently of TimerHit().
+         * @param activeMs period while busy, e.g. during slews, moves and exposures.
+         * @param idleMs period otherwise.
+         * @param callback function to call.
+         * @param property the device is busy while this property is in the Busy state. If nullptr, while
+         * any property of the device is.
+         * @return id of the poll, for removePoll().
+         * @note Until a client has asked for the properties of the device, periods are multiplied by the
+         * backoff factor, see setPollBackoff(). A driver switching state outside of a client request calls
+         * updatePolling() so that the new period applies right away.
+         */
+        int addPoll(uint32_t activeMs, uint32_t idleMs, const std::function<void()> &callback, const char *property = nullptr);
+
+        /**
+         * @brief removePoll Stop a poll added by addPoll().
+         */
+        void removePoll(int id);
+
+        /**
+         * @brief setPollBackoff Factor applied to poll periods while no client has asked for the device. Default 4.
+         */
+        void setPollBackoff(uint32_t factor);
+
+        /**
+         * @brief updatePolling Apply the periods matching the current device state to the polls.
+         */
+        void updatePolling();
+
+        /**
+         * @brief setOwnThread Handle the client requests of this device on a thread of its own, so that in a driver
+         * hosting several devices, one blocked in a transaction does not stall the others.
+         * With it enabled, ISNewXXX, ISGetProperties, ISSnoopDevice, TimerHit() and the polls of the device are
+         * called, in the order they come, from that thread rather than from the event loop. SetTimer(),
+         * RemoveTimer() and the polls can be used from it, they are handed over to the event loop.
+         * Other timers and callbacks of the driver still run on the event loop, and what they share with the
+         * device has to be locked. What the devices send stays serialized by the driver I/O.
+         * @param enable True to start the thread, best from the constructor of the device. False stops it, the
+         * requests not handled yet are dropped. Not to be called from the thread itself. The destructor of
+         * DefaultDevice stops it too, a driver that frees in its own destructor what the requests use calls
+         * setOwnThread(false) first.
+         */
+        void setOwnThread(bool enable);
+
         /* direct access to POLLMS is deprecated, please use setCurrentPollingPeriod/getCurrentPollingPeriod */
         uint32_t &refCurrentPollingPeriod() __attribute__((deprecated));
         uint32_t  refCurrentPollingPeriod() const __attribute__((deprecated));
@@ -565,6 +681,7 @@ class DefaultDevice : public ParentDevice
 
     private:
         // Connection Plugins
+        friend class DefaultDevicePrivate;
         friend class Connection::Serial;
         friend class Connection::TCP;
         friend class FilterInterface;
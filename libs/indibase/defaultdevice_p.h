@@ -22,14 +22,23 @@
 #include "defaultdevice.h"
 #include "watchdeviceproperty.h"
 
+#include <chrono>
 #include <cstring>
+#include <functional>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "indipropertyswitch.h"
 #include "indipropertynumber.h"
 #include "indipropertytext.h"
 #include "inditimer.h"
+#include "inditaskqueue.h"
 
 namespace INDI
 {
@@ -73,11 +82,62 @@ class DefaultDevicePrivate: public ParentDevicePrivate
         // TimerHit timer
         INDI::Timer m_MainLoopTimer;
 
+        // Adaptive polls, see DefaultDevice::addPoll
+        struct Poll
+        {
+            int id;
+            std::string property;   // empty for any property of the device
+            uint32_t activeMs;
+            uint32_t idleMs;
+            std::function<void()> callback;
+            std::chrono::steady_clock::time_point lastRun;
+        };
+        std::vector<Poll> polls;
+        int nextPollId {1};
+        uint32_t pollBackoff {4};
+        // indiserver asks once for the properties when it starts the driver, clients ask after that
+        int getPropertiesCount {0};
+        INDI::Timer m_PollTimer;
+
+        bool isBusy(const std::string &property) const;
+        uint32_t pollPeriod(const Poll &poll) const;
+        void runPolls();
+        void schedulePolls();
+
+        // Thread of the device, see DefaultDevice::setOwnThread(). Null when the event loop runs the device.
+        std::unique_ptr<TaskQueue> executor;
+
+        // True if what the device is asked to do now has to be handed to its thread
+        bool isDeferred() const;
+        // Runs function on the thread of the device, right away if there already or if the device has none
+        void execute(const std::function<void()> &function);
+        // Runs function on the event loop, which owns the timers, right away unless on the thread of the device
+        void onEventLoop(const std::function<void()> &function);
+
     public:
         static std::list<DefaultDevicePrivate*> devices;
         static std::recursive_mutex             devicesLock;
 
         WatchDeviceProperty watchDevice;
+
+        // Handlers of watchSnoop(), by device and property
+        struct SnoopKeyHash
+        {
+            size_t operator()(const std::pair<std::string, std::string> &key) const
+            {
+                return std::hash<std::string>()(key.first) * 31 + std::hash<std::string>()(key.second);
+            }
+        };
+        std::unordered_map<std::pair<std::string, std::string>, std::function<bool (XMLEle *)>, SnoopKeyHash> snoopHandlers;
+
+        // Properties of defineLazyProperty() not defined yet
+        std::set<std::string> lazyProperties;
+
+        // Called by the driver framework for a getProperties of a property it does not know
+        static void getLazyProperty(const char *dev, const char *name);
+
+        // Called by indi_driver_host once the modules are loaded: names the devices and snoops on them in memory
+        static void hostDevices();
 };
 
 }
@@ -89,14 +89,21 @@ bool Convolution::ISNewBLOB(const char *dev, const char *name, int sizes[], int
 }
 
 bool Convolution::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
+{
+    if(!PluginActive) return false;
+    if(!setStream(buf, dims, sizes, bits_per_sample)) return false;
+    return processStream(stream, bits_per_sample);
+}
+
+bool Convolution::processStream(dsp_stream_p in, int bits_per_sample)
 {
     if(!PluginActive) return false;
     if(!matrix_loaded) return false;
-    setStream(buf, dims, sizes, bits_per_sample);
-    dsp_fourier_dft(stream, 1);
-    dsp_fourier_dft(matrix, 1);
-    dsp_convolution_convolution(stream, matrix);
-    return Interface::processBLOB(getStream(), stream->dims, stream->sizes, bits_per_sample);
+    double min = dsp_stats_min(in->buf, in->len);
+    double max = dsp_stats_max(in->buf, in->len);
+    dsp_convolution_filter(in, matrix);
+    dsp_buffer_stretch(in->buf, in->len, min, max);
+    return sendStream(in, bits_per_sample);
 }
 
 Wavelets::Wavelets(INDI::DefaultDevice *dev) : Interface(dev, DSP_WAVELETS, "WAVELETS", "Wavelets")
@@ -142,14 +149,20 @@ bool Wavelets::ISNewNumber(const char *dev, const char *name, double *values, ch
 bool Wavelets::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
     if(!PluginActive) return false;
-    setStream(buf, dims, sizes, bits_per_sample);
-    double min = dsp_stats_min(stream->buf, stream->len);
-    double max = dsp_stats_max(stream->buf, stream->len);
-    dsp_stream_p out = dsp_stream_copy(stream);
+    if(!setStream(buf, dims, sizes, bits_per_sample)) return false;
+    return processStream(stream, bits_per_sample);
+}
+
+bool Wavelets::processStream(dsp_stream_p in, int bits_per_sample)
+{
+    if(!PluginActive) return false;
+    double min = dsp_stats_min(in->buf, in->len);
+    double max = dsp_stats_max(in->buf, in->len);
+    dsp_stream_p out = dsp_stream_copy(in);
     for (int i = 0; i < WaveletsNP.nnp; i++)
     {
         int size = (i + 1) * 3;
-        dsp_stream_p tmp = dsp_stream_copy(stream);
+        dsp_stream_p tmp = dsp_stream_copy(in);
         dsp_stream_p matrix = dsp_stream_new();
         dsp_stream_add_dim(matrix, size);
         dsp_stream_add_dim(matrix, size);
@@ -162,9 +175,8 @@ bool Wavelets::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per
                                             (y) * M_PI / static_cast<double>(size));
             }
         }
-        dsp_fourier_dft(tmp, 1);
-        dsp_fourier_dft(matrix, 1);
-        dsp_convolution_convolution(tmp, matrix);
+        dsp_convolution_filter(tmp, matrix);
+        dsp_buffer_stretch(tmp->buf, tmp->len, min, max);
         dsp_buffer_sub(tmp, matrix->buf, matrix->len);
         dsp_buffer_mul1(tmp, WaveletsNP.np[i].value / 8.0);
         dsp_buffer_sum(out, tmp->buf, tmp->len);
@@ -174,9 +186,9 @@ bool Wavelets::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per
         dsp_stream_free_buffer(tmp);
         dsp_stream_free(tmp);
     }
-    dsp_stream_free_buffer(stream);
-    dsp_stream_free(stream);
-    stream = dsp_stream_copy(out);
-    return Interface::processBLOB(getStream(), stream->dims, stream->sizes, bits_per_sample);
+    memcpy(in->buf, out->buf, sizeof(dsp_t) * in->len);
+    dsp_stream_free_buffer(out);
+    dsp_stream_free(out);
+    return sendStream(in, bits_per_sample);
 }
 }
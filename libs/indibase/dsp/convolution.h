@@ -35,6 +35,7 @@ class Convolution : public Interface
         bool ISNewBLOB(const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[],
                        char *names[], int n) override;
         virtual bool processBLOB(uint8_t *out, uint32_t dims, int *sizes, int bits_per_sample) override;
+        virtual bool processStream(dsp_stream_p in, int bits_per_sample) override;
 
     protected:
         ~Convolution();
@@ -55,6 +56,7 @@ class Wavelets : public Interface
         Wavelets(INDI::DefaultDevice *dev);
         bool ISNewNumber(const char *dev, const char *name, double values[], char *names[], int n) override;
         virtual bool processBLOB(uint8_t *out, uint32_t dims, int *sizes, int bits_per_sample) override;
+        virtual bool processStream(dsp_stream_p in, int bits_per_sample) override;
 
     protected:
         ~Wavelets();
@@ -69,6 +69,15 @@ Interface::Interface(INDI::DefaultDevice *dev, Type type, const char *name, cons
     IUFillSwitchVector(&ActivateSP, ActivateS, 2, getDeviceName(), activatestrname, activatestrlabel, DSP_TAB, IP_RW,
                        ISR_1OFMANY, 60, IPS_IDLE);
 
+    char uploadstrname[MAXINDINAME];
+    char uploadstrlabel[MAXINDILABEL];
+    sprintf(uploadstrname, "DSP_UPLOAD_%s", m_Name);
+    sprintf(uploadstrlabel, "%s upload", m_Label);
+    IUFillSwitch(&UploadS[0], "DSP_UPLOAD_ON", "On", ISState::ISS_ON);
+    IUFillSwitch(&UploadS[1], "DSP_UPLOAD_OFF", "Off", ISState::ISS_OFF);
+    IUFillSwitchVector(&UploadSP, UploadS, 2, getDeviceName(), uploadstrname, uploadstrlabel, DSP_TAB, IP_RW,
+                       ISR_1OFMANY, 60, IPS_IDLE);
+
     IUFillBLOB(&FitsB, m_Name, m_Label, "");
     IUFillBLOBVector(&FitsBP, &FitsB, 1, getDeviceName(), m_Name, m_Label, DSP_TAB, IP_RO, 60, IPS_IDLE);
     BufferSizes = nullptr;
@@ -144,6 +153,13 @@ bool Interface::ISNewSwitch(const char *dev, const char *name, ISState *states,
         }
         IDSetSwitch(&ActivateSP, nullptr);
     }
+    if(!strcmp(dev, getDeviceName()) && !strcmp(name, UploadSP.name))
+    {
+        IUUpdateSwitch(&UploadSP, states, names, n);
+        UploadSP.s = IPS_OK;
+        IDSetSwitch(&UploadSP, nullptr);
+        return true;
+    }
     return false;
 }
 
@@ -191,6 +207,52 @@ uint8_t* Interface::Callback(uint8_t* buf, uint32_t ndims, int* dims, int bits_p
     return nullptr;
 }
 
+bool Interface::processStream(dsp_stream_p in, int bits_per_sample)
+{
+    INDI_UNUSED(in);
+    INDI_UNUSED(bits_per_sample);
+    DEBUG(INDI::Logger::DBG_WARNING, "Interface::processStream -  Should never get here");
+    return false;
+}
+
+bool Interface::uploadEnabled()
+{
+    return UploadS[0].s == ISS_ON;
+}
+
+bool Interface::sendStream(dsp_stream_p out, int bits_per_sample)
+{
+    if(!PluginActive) return false;
+    // Filters of the pipeline still run for the plugins after them, only their BLOB is skipped
+    if(!uploadEnabled()) return true;
+    setBPS(bits_per_sample);
+    buffer = realloc(buffer, out->len * abs(bits_per_sample) / 8);
+    switch (bits_per_sample)
+    {
+        case 8:
+            dsp_buffer_copy(out->buf, (static_cast<uint8_t *>(buffer)), out->len);
+            break;
+        case 16:
+            dsp_buffer_copy(out->buf, (static_cast<uint16_t *>(buffer)), out->len);
+            break;
+        case 32:
+            dsp_buffer_copy(out->buf, (static_cast<uint32_t *>(buffer)), out->len);
+            break;
+        case 64:
+            dsp_buffer_copy(out->buf, (static_cast<unsigned long *>(buffer)), out->len);
+            break;
+        case -32:
+            dsp_buffer_copy(out->buf, (static_cast<float *>(buffer)), out->len);
+            break;
+        case -64:
+            dsp_buffer_copy(out->buf, (static_cast<double *>(buffer)), out->len);
+            break;
+        default:
+            return false;
+    }
+    return Interface::processBLOB(static_cast<uint8_t *>(buffer), out->dims, out->sizes, bits_per_sample);
+}
+
 bool Interface::processBLOB(uint8_t* buffer, uint32_t ndims, int* dims, int bits_per_sample)
 {
     bool success = false;
@@ -231,16 +293,18 @@ bool Interface::processBLOB(uint8_t* buffer, uint32_t ndims, int* dims, int bits
 void Interface::Activated()
 {
     m_Device->defineProperty(&FitsBP);
+    m_Device->defineProperty(&UploadSP);
 }
 
 void Interface::Deactivated()
 {
     m_Device->deleteProperty(FitsBP.name);
+    m_Device->deleteProperty(UploadSP.name);
 }
 
 bool Interface::saveConfigItems(FILE *fp)
 {
-    INDI_UNUSED(fp);
+    IUSaveConfigSwitch(fp, &UploadSP);
     return true;
 }
 
@@ -634,6 +698,11 @@ bool Interface::setStream(void *buf, uint32_t dims, int *sizes, int bits_per_sam
     for(uint32_t dim = 0; dim < dims; dim++)
         dsp_stream_add_dim(stream, sizes[dim]);
     dsp_stream_alloc_buffer(stream, stream->len);
+    return copyBuffer(buf, stream, bits_per_sample);
+}
+
+bool Interface::copyBuffer(void *buf, dsp_stream_p stream, int bits_per_sample)
+{
     switch (bits_per_sample)
     {
         case 8:
@@ -655,8 +724,6 @@ bool Interface::setStream(void *buf, uint32_t dims, int *sizes, int bits_per_sam
             dsp_buffer_copy((static_cast<double *>(buf)), stream->buf, stream->len);
             break;
         default:
-            dsp_stream_free_buffer(stream);
-            dsp_stream_free(stream);
             return false;
     }
     return true;
@@ -99,6 +99,33 @@ class Interface
          */
         virtual bool processBLOB(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample);
 
+        /**
+         * @brief processStream Process a stream shared with the other plugins of the DSP::Manager pipeline, and generate
+         * the BLOB when its upload is enabled.
+         * @param in The stream, filters change it in place for the plugins after them
+         * @param bits_per_sample bit depth of the generated BLOB
+         * @return True if successful, false otherwise.
+         */
+        virtual bool processStream(dsp_stream_p in, int bits_per_sample);
+
+        /**
+         * @brief isActive Whether the plugin was activated by the client.
+         * @return True if active, false otherwise.
+         */
+        bool isActive() const
+        {
+            return PluginActive;
+        }
+
+        /**
+         * @brief copyBuffer Converts a buffer into the samples of a stream of the same length.
+         * @param buf The input buffer
+         * @param stream The stream to fill
+         * @param bits_per_sample bit depth of the input buffer
+         * @return True if successful, false if the bit depth is not supported.
+         */
+        static bool copyBuffer(void *buf, dsp_stream_p stream, int bits_per_sample);
+
         /**
          * @brief setSizes Set the returned file dimensions and corresponding sizes.
          * @param num Number of dimensions.
@@ -175,8 +202,25 @@ class Interface
          */
         dsp_stream_p loadFITS(char* buf, int len);
 
+        /**
+         * @brief sendStream Generate the BLOB of a stream at the given bit depth, unless its upload was disabled.
+         * @param out The stream to send
+         * @param bits_per_sample bit depth of the BLOB
+         * @return True if successful or not requested, false otherwise.
+         */
+        bool sendStream(dsp_stream_p out, int bits_per_sample);
+
+        /**
+         * @brief uploadEnabled Whether the client wants the BLOB of this plugin.
+         * @return True if the BLOB is sent or saved, false if it is skipped.
+         */
+        bool uploadEnabled();
+
         bool PluginActive;
 
+        ISwitchVectorProperty UploadSP;
+        ISwitch UploadS[2];
+
         IBLOBVectorProperty FitsBP;
         IBLOB FitsB;
 
@@ -17,6 +17,7 @@
 *******************************************************************************/
 
 #include "manager.h"
+#include "defaultdevice.h"
 #include "indistandardproperty.h"
 #include "indicom.h"
 #include "indilogger.h"
@@ -31,8 +32,12 @@
 
 namespace DSP
 {
-Manager::Manager(INDI::DefaultDevice *dev)
+Manager::Manager(INDI::DefaultDevice *dev) : m_Device(dev)
 {
+    IUFillSwitch(&AsyncS[0], "DSP_ASYNC_ON", "On", ISState::ISS_OFF);
+    IUFillSwitch(&AsyncS[1], "DSP_ASYNC_OFF", "Off", ISState::ISS_ON);
+    IUFillSwitchVector(&AsyncSP, AsyncS, 2, dev->getDeviceName(), "DSP_ASYNC", "Background processing", DSP_TAB, IP_RW,
+                       ISR_1OFMANY, 60, IPS_IDLE);
     convolution = new Convolution(dev);
     dft = new FourierTransform(dev);
     idft = new InverseFourierTransform(dev);
@@ -43,20 +48,34 @@ Manager::Manager(INDI::DefaultDevice *dev)
 
 Manager::~Manager()
 {
+    if (worker.joinable())
+        worker.join();
+    if (stream != nullptr)
+    {
+        dsp_stream_free_buffer(stream);
+        dsp_stream_free(stream);
+    }
 }
 
 void Manager::ISGetProperties(const char *dev)
 {
+    // Plugins change their settings only between frames
+    std::lock_guard<std::mutex> lock(pipelineMutex);
     convolution->ISGetProperties(dev);
     dft->ISGetProperties(dev);
     idft->ISGetProperties(dev);
     spectrum->ISGetProperties(dev);
     histogram->ISGetProperties(dev);
     wavelets->ISGetProperties(dev);
+    if (m_Device->isConnected())
+        m_Device->defineProperty(&AsyncSP);
+    else
+        m_Device->deleteProperty(AsyncSP.name);
 }
 
 bool Manager::updateProperties()
 {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
     bool r = false;
     r |= convolution->updateProperties();
     r |= dft->updateProperties();
@@ -64,11 +83,16 @@ bool Manager::updateProperties()
     r |= spectrum->updateProperties();
     r |= histogram->updateProperties();
     r |= wavelets->updateProperties();
+    if (m_Device->isConnected())
+        m_Device->defineProperty(&AsyncSP);
+    else
+        m_Device->deleteProperty(AsyncSP.name);
     return r;
 }
 
 bool Manager::ISNewSwitch(const char *dev, const char *name, ISState *states, char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
     bool r = false;
     r |= convolution->ISNewSwitch(dev, name, states, names, num);
     r |= dft->ISNewSwitch(dev, name, states, names, num);
@@ -76,11 +100,19 @@ bool Manager::ISNewSwitch(const char *dev, const char *name, ISState *states, ch
     r |= spectrum->ISNewSwitch(dev, name, states, names, num);
     r |= histogram->ISNewSwitch(dev, name, states, names, num);
     r |= wavelets->ISNewSwitch(dev, name, states, names, num);
+    if (!strcmp(dev, m_Device->getDeviceName()) && !strcmp(name, AsyncSP.name))
+    {
+        IUUpdateSwitch(&AsyncSP, states, names, num);
+        AsyncSP.s = IPS_OK;
+        IDSetSwitch(&AsyncSP, nullptr);
+        r = true;
+    }
     return r;
 }
 
 bool Manager::ISNewText(const char *dev, const char *name, char *texts[], char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
     bool r = false;
     r |= convolution->ISNewText(dev, name, texts, names, num);
     r |= dft->ISNewText(dev, name, texts, names, num);
@@ -93,6 +125,7 @@ bool Manager::ISNewText(const char *dev, const char *name, char *texts[], char *
 
 bool Manager::ISNewNumber(const char *dev, const char *name, double values[], char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
     bool r = false;
     r |= convolution->ISNewNumber(dev, name, values, names, num);
     r |= dft->ISNewNumber(dev, name, values, names, num);
@@ -106,6 +139,7 @@ bool Manager::ISNewNumber(const char *dev, const char *name, double values[], ch
 bool Manager::ISNewBLOB(const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[],
                         char *names[], int num)
 {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
     bool r = false;
     r |= convolution->ISNewBLOB(dev, name, sizes, blobsizes, blobs, formats, names, num);
     r |= dft->ISNewBLOB(dev, name, sizes, blobsizes, blobs, formats, names, num);
@@ -125,20 +159,67 @@ bool Manager::saveConfigItems(FILE *fp)
     r |= spectrum->saveConfigItems(fp);
     r |= histogram->saveConfigItems(fp);
     r |= wavelets->saveConfigItems(fp);
+    IUSaveConfigSwitch(fp, &AsyncSP);
     return r;
 }
 
-bool Manager::processBLOB(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample)
+bool Manager::isActive()
+{
+    return convolution->isActive() || dft->isActive() || idft->isActive() || spectrum->isActive() || histogram->isActive()
+           || wavelets->isActive();
+}
+
+bool Manager::setStream(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample)
+{
+    bool same = stream != nullptr && stream->dims == static_cast<int>(ndims);
+    for (uint32_t d = 0; same && d < ndims; d++)
+        same = stream->sizes[d] == dims[d];
+    if (!same)
+    {
+        if (stream != nullptr)
+        {
+            dsp_stream_free_buffer(stream);
+            dsp_stream_free(stream);
+        }
+        stream = dsp_stream_new();
+        for (uint32_t d = 0; d < ndims; d++)
+            dsp_stream_add_dim(stream, dims[d]);
+        dsp_stream_alloc_buffer(stream, stream->len);
+    }
+    return Interface::copyBuffer(buf, stream, bits_per_sample);
+}
+
+bool Manager::runPipeline(int bits_per_sample)
 {
+    std::lock_guard<std::mutex> lock(pipelineMutex);
+    // Filters first, each on the output of the one before, then the analyses of the filtered frame
+    Interface *pipeline[] = { convolution, wavelets, idft, dft, spectrum, histogram };
     bool r = false;
-    r |= convolution->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= dft->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= idft->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= spectrum->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= histogram->processBLOB(buf, ndims, dims, bits_per_sample);
-    r |= wavelets->processBLOB(buf, ndims, dims, bits_per_sample);
+    for (Interface *plugin : pipeline)
+        if (plugin->isActive())
+            r |= plugin->processStream(stream, bits_per_sample);
     return r;
 }
+
+bool Manager::processBLOB(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample)
+{
+    if (!isActive())
+        return false;
+    if (worker.joinable())
+        worker.join();
+    if (!setStream(buf, ndims, dims, bits_per_sample))
+        return false;
+    if (AsyncS[0].s == ISS_ON)
+    {
+        worker = std::thread([this, bits_per_sample]()
+        {
+            runPipeline(bits_per_sample);
+        });
+        return true;
+    }
+    return runPipeline(bits_per_sample);
+}
+
 void Manager::setCaptureFileExtension(const char *ext)
 {
     convolution->setCaptureFileExtension(ext);
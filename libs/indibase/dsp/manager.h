@@ -26,7 +26,9 @@
 
 #include <fitsio.h>
 #include <functional>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace INDI
 {
@@ -50,6 +52,17 @@ class Manager
         virtual bool saveConfigItems(FILE *fp);
         virtual bool updateProperties();
 
+        /**
+         * @brief processBLOB Convert the buffer once into a stream shared by the active plugins, and run them in sequence:
+         * the filters (convolution, wavelets, inverse transform) change the stream for the ones after them, the analyses
+         * (transform, spectrum, histogram) read the filtered stream. With DSP_ASYNC enabled the plugins run on a worker
+         * thread, the next frame waits for them to be done.
+         * @param buf The input buffer, it can be released when this returns
+         * @param ndims Number of the dimensions of the input buffer
+         * @param dims Sizes of the dimensions of the input buffer
+         * @param bits_per_sample original bit depth of the input buffer
+         * @return True if successful or started, false otherwise.
+         */
         bool processBLOB(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample);
 
         inline void setSizes(uint32_t num, int* sizes)
@@ -75,6 +88,18 @@ class Manager
         void setCaptureFileExtension(const char *ext);
 
     private:
+        bool isActive();
+        bool setStream(uint8_t* buf, uint32_t ndims, int* dims, int bits_per_sample);
+        bool runPipeline(int bits_per_sample);
+
+        INDI::DefaultDevice *m_Device { nullptr };
+        ISwitchVectorProperty AsyncSP;
+        ISwitch AsyncS[2];
+
+        dsp_stream_p stream { nullptr };
+        std::thread worker;
+        std::mutex pipelineMutex;
+
         Convolution *convolution;
         FourierTransform *dft;
         InverseFourierTransform *idft;
@@ -43,10 +43,16 @@ FourierTransform::~FourierTransform()
 bool FourierTransform::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
     if(!PluginActive) return false;
-    setStream(buf, dims, sizes, bits_per_sample);
+    if(!setStream(buf, dims, sizes, bits_per_sample)) return false;
+    return processStream(stream, bits_per_sample);
+}
 
-    dsp_fourier_dft(stream, 1);
-    return Interface::processBLOB(getMagnitude(), stream->magnitude->dims, stream->magnitude->sizes, bits_per_sample);
+bool FourierTransform::processStream(dsp_stream_p in, int bits_per_sample)
+{
+    if(!PluginActive) return false;
+    if(!uploadEnabled()) return true;
+    dsp_fourier_dft(in, 1);
+    return sendStream(in->magnitude, bits_per_sample);
 }
 
 InverseFourierTransform::InverseFourierTransform(INDI::DefaultDevice *dev) : Interface(dev, DSP_IDFT, "IDFT", "IDFT")
@@ -72,19 +78,31 @@ void InverseFourierTransform::Deactivated()
 }
 
 bool InverseFourierTransform::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
+{
+    if(!PluginActive) return false;
+    if(!setStream(buf, dims, sizes, bits_per_sample)) return false;
+    return processStream(stream, bits_per_sample);
+}
+
+bool InverseFourierTransform::processStream(dsp_stream_p in, int bits_per_sample)
 {
     if(!PluginActive) return false;
     if(!phase_loaded) return false;
-    setStream(buf, dims, sizes, bits_per_sample);
-    if (phase->dims != stream->dims) return false;
-    for (int d = 0; d < stream->dims; d++)
-        if (phase->sizes[d] != stream->sizes[d])
+    if (phase->dims != in->dims) return false;
+    for (int d = 0; d < in->dims; d++)
+        if (phase->sizes[d] != in->sizes[d])
             return false;
-    setMagnitude(buf, dims, sizes, bits_per_sample);
-    stream->phase = phase;
-    dsp_buffer_set(stream->buf, stream->len, 0);
-    dsp_fourier_idft(stream);
-    return Interface::processBLOB(getStream(), stream->dims, stream->sizes, bits_per_sample);
+    // The stream is the magnitude, its phase is the loaded one only for the transform
+    dsp_stream_p magnitude = in->magnitude;
+    dsp_stream_p stream_phase = in->phase;
+    in->magnitude = dsp_stream_copy(in);
+    in->phase = phase;
+    dsp_fourier_idft(in);
+    dsp_stream_free_buffer(in->magnitude);
+    dsp_stream_free(in->magnitude);
+    in->magnitude = magnitude;
+    in->phase = stream_phase;
+    return sendStream(in, bits_per_sample);
 }
 
 bool InverseFourierTransform::ISNewBLOB(const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[],
@@ -124,10 +142,17 @@ Spectrum::~Spectrum()
 bool Spectrum::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
     if(!PluginActive) return false;
-    setStream(buf, dims, sizes, bits_per_sample);
+    if(!setStream(buf, dims, sizes, bits_per_sample)) return false;
+    return processStream(stream, bits_per_sample);
+}
 
-    dsp_fourier_dft(stream, 1);
-    double *histo = dsp_stats_histogram(stream->magnitude, 4096);
+bool Spectrum::processStream(dsp_stream_p in, int bits_per_sample)
+{
+    INDI_UNUSED(bits_per_sample);
+    if(!PluginActive) return false;
+    if(!uploadEnabled()) return true;
+    dsp_fourier_dft(in, 1);
+    double *histo = dsp_stats_histogram(in->magnitude, 4096);
     return Interface::processBLOB(static_cast<uint8_t*>(static_cast<void*>(histo)), 1, new int{4096}, -64);
 }
 
@@ -143,9 +168,33 @@ Histogram::~Histogram()
 bool Histogram::processBLOB(uint8_t *buf, uint32_t dims, int *sizes, int bits_per_sample)
 {
     if(!PluginActive) return false;
-    setStream(buf, dims, sizes, bits_per_sample);
+    if(!uploadEnabled()) return true;
+
+    // 8 and 16 bits frames are binned as they are, without expanding them to dsp_t
+    int len = 1;
+    for(uint32_t dim = 0; dim < dims; dim++)
+        len *= sizes[dim];
+    double *histo = nullptr;
+    if (bits_per_sample == 8)
+        histo = dsp_stats_histogram_u8(buf, len, 4096);
+    else if (bits_per_sample == 16)
+        histo = dsp_stats_histogram_u16(reinterpret_cast<uint16_t*>(buf), len, 4096);
+    else
+    {
+        if(!setStream(buf, dims, sizes, bits_per_sample)) return false;
+        histo = dsp_stats_histogram(stream, 4096);
+    }
+    if (histo == nullptr) return false;
+    return Interface::processBLOB(static_cast<uint8_t*>(static_cast<void*>(histo)), 1, new int{4096}, -64);
+}
 
-    double *histo = dsp_stats_histogram(stream, 4096);
+bool Histogram::processStream(dsp_stream_p in, int bits_per_sample)
+{
+    INDI_UNUSED(bits_per_sample);
+    if(!PluginActive) return false;
+    if(!uploadEnabled()) return true;
+    double *histo = dsp_stats_histogram(in, 4096);
+    if (histo == nullptr) return false;
     return Interface::processBLOB(static_cast<uint8_t*>(static_cast<void*>(histo)), 1, new int{4096}, -64);
 }
 }
@@ -0,0 +1,461 @@
+/**  INDI LIB
+ *   Direct FITS writer
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "fitswriter.h"
+#include "indithreadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+using INDI::FITSRecord;
+
+constexpr size_t CARD_SIZE  = 80;
+constexpr size_t BLOCK_SIZE = 2880;
+
+// Frames with fewer pixels are converted on the calling thread, larger ones in chunks of this many pixels
+constexpr size_t PARALLEL_PIXELS = 1u << 20;
+constexpr size_t CHUNK_PIXELS    = 1u << 16;
+
+// Keys of the header written for the image, that records must not change
+const char *const STRUCTURAL_KEYS[] = {"SIMPLE", "BITPIX", "NAXIS", "NAXIS1", "NAXIS2", "NAXIS3", "EXTEND", "BZERO", "BSCALE", "END"};
+
+size_t padToBlock(size_t size)
+{
+    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+}
+
+// Key of a record as a header holds it, upper case, or an empty string if it is not a valid key
+std::string cardKey(const std::string &key)
+{
+    std::string result;
+    for (char c : key)
+    {
+        c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        if (!((c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_'))
+            return std::string();
+        result += c;
+    }
+    return result;
+}
+
+// One card "KEY     = value / comment", with the value right justified to column 30 unless it is a string
+std::string makeCard(const std::string &key, const std::string &value, bool isString, const std::string &comment)
+{
+    std::string card = key.size() > 8 ? "HIERARCH " + key + " = " : key + std::string(8 - key.size(), ' ') + "= ";
+    if (isString || value.size() >= 20)
+        card += value;
+    else
+        card += std::string(20 - value.size(), ' ') + value;
+
+    if (!comment.empty() && card.size() + 3 < CARD_SIZE)
+        card += " / " + comment;
+
+    card.resize(CARD_SIZE, ' ');
+    return card;
+}
+
+// Value of a string record, quoted with inner quotes doubled and at least 8 characters, as cfitsio writes it
+std::string quoteString(const std::string &value)
+{
+    std::string quoted = "'";
+    for (char c : value)
+    {
+        if (quoted.size() >= 68)
+            break;
+        if (c == '\'')
+            quoted += "''";
+        else
+            quoted += (c >= 32 && c < 127) ? c : ' ';
+    }
+    if (quoted.size() < 9)
+        quoted.resize(9, ' ');
+    return quoted + "'";
+}
+
+// Value of a double record, in exponential notation with its decimals as fits_update_key_dbl writes it
+bool formatDouble(double value, int decimal, std::string &result)
+{
+    if (!std::isfinite(value))
+        return false;
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%.*E", std::min(std::max(decimal, 0), 15), value);
+    result = buffer;
+    // The current locale may use a comma for the decimal point
+    std::replace(result.begin(), result.end(), ',', '.');
+    return true;
+}
+
+void appendComment(std::string &header, const std::string &comment)
+{
+    size_t offset = 0;
+    do
+    {
+        std::string card = "COMMENT ";
+        card += comment.substr(offset, CARD_SIZE - card.size());
+        card.resize(CARD_SIZE, ' ');
+        header += card;
+        offset += CARD_SIZE - 8;
+    }
+    while (offset < comment.size());
+}
+
+void toBigEndian16(uint16_t *dst, const uint16_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    {
+        const __m256i sign = _mm256_set1_epi16(static_cast<short>(0x8000));
+        const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                              1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), sign);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(v, swap));
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        const __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), sign);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    {
+        const uint16x8_t sign = vdupq_n_u16(0x8000);
+        for (; i + 8 <= n; i += 8)
+        {
+            uint16x8_t v = veorq_u16(vld1q_u16(src + i), sign);
+            vst1q_u16(dst + i, vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(v))));
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        uint16_t v = src[i] ^ 0x8000;
+        dst[i] = static_cast<uint16_t>((v << 8) | (v >> 8));
+    }
+}
+
+void toBigEndian32(uint32_t *dst, const uint32_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    {
+        const __m256i sign = _mm256_set1_epi32(static_cast<int>(0x80000000));
+        const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                              3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), sign);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(v, swap));
+        }
+    }
+#endif
+#if defined(__SSE2__)
+    {
+        // Swap the 16 bit halves of each value, then the bytes of each half
+        const __m128i sign = _mm_set1_epi32(static_cast<int>(0x80000000));
+        for (; i + 4 <= n; i += 4)
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), sign);
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    {
+        const uint32x4_t sign = vdupq_n_u32(0x80000000);
+        for (; i + 4 <= n; i += 4)
+        {
+            uint32x4_t v = veorq_u32(vld1q_u32(src + i), sign);
+            vst1q_u32(dst + i, vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(v))));
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t v = src[i] ^ 0x80000000;
+        dst[i] = (v << 24) | ((v << 8) & 0xff0000) | ((v >> 8) & 0xff00) | (v >> 24);
+    }
+}
+
+void toBigEndian(uint8_t *dst, const uint8_t *src, size_t count, int bpp)
+{
+    switch (bpp)
+    {
+        case 8:
+            memcpy(dst, src, count);
+            break;
+        case 16:
+            toBigEndian16(reinterpret_cast<uint16_t *>(dst), reinterpret_cast<const uint16_t *>(src), count);
+            break;
+        case 32:
+            toBigEndian32(reinterpret_cast<uint32_t *>(dst), reinterpret_cast<const uint32_t *>(src), count);
+            break;
+    }
+}
+
+// Card of a key and value record, or false if it can't be written
+bool renderCard(const FITSRecord &record, std::string &key, std::string &card)
+{
+    key = cardKey(record.key());
+    std::string value;
+    bool valid = !key.empty() && key.size() <= 70 &&
+                 std::find_if(std::begin(STRUCTURAL_KEYS), std::end(STRUCTURAL_KEYS), [&](const char *structural)
+    {
+        return key == structural;
+    }) == std::end(STRUCTURAL_KEYS);
+
+    switch (record.type())
+    {
+        case FITSRecord::STRING:
+            value = quoteString(record.valueString());
+            break;
+        case FITSRecord::LONGLONG:
+            value = std::to_string(record.valueInt());
+            break;
+        case FITSRecord::DOUBLE:
+            valid = valid && formatDouble(record.valueDouble(), record.decimal(), value);
+            break;
+        default:
+            valid = false;
+    }
+
+    if (valid)
+        card = makeCard(key, value, record.type() == FITSRecord::STRING, record.comment());
+    return valid;
+}
+
+bool sameRecord(const FITSRecord &a, const FITSRecord &b)
+{
+    if (a.type() != b.type() || a.key() != b.key() || a.comment() != b.comment())
+        return false;
+
+    switch (a.type())
+    {
+        case FITSRecord::LONGLONG:
+            return a.valueInt() == b.valueInt();
+        case FITSRecord::DOUBLE:
+            return a.decimal() == b.decimal() &&
+                   (a.valueDouble() == b.valueDouble() || (std::isnan(a.valueDouble()) && std::isnan(b.valueDouble())));
+        default:
+            return a.valueString() == b.valueString();
+    }
+}
+
+// The header of makeFITSHeader. If offsets is not null, it receives the offset in the header of the card of each
+// record, or npos for a record without a card of its own: void, comment, rejected or updated by a later one
+std::string buildHeader(int bpp, int naxis, const long *naxes, const std::vector<FITSRecord> &records,
+                        std::vector<std::string> *rejected, std::vector<size_t> *offsets)
+{
+    if ((bpp != 8 && bpp != 16 && bpp != 32) || naxis < 1 || naxis > 3)
+        return std::string();
+
+    std::vector<std::string> cards;
+    cards.push_back(makeCard("SIMPLE", "T", false, "file does conform to FITS standard"));
+    cards.push_back(makeCard("BITPIX", std::to_string(bpp), false, "number of bits per data pixel"));
+    cards.push_back(makeCard("NAXIS", std::to_string(naxis), false, "number of data axes"));
+    for (int i = 0; i < naxis; i++)
+        cards.push_back(makeCard("NAXIS" + std::to_string(i + 1), std::to_string(naxes[i]), false,
+                                 "length of data axis " + std::to_string(i + 1)));
+    cards.push_back(makeCard("EXTEND", "T", false, "FITS dataset may contain extensions"));
+
+    std::string header;
+    for (auto &card : cards)
+        header += card;
+    appendComment(header, "  FITS (Flexible Image Transport System) format is defined in 'Astronomy");
+    appendComment(header, "  and Astrophysics', volume 376, page 359; bibcode: 2001A&A...376..359H");
+
+    cards.clear();
+    if (bpp == 16)
+        cards.push_back(makeCard("BZERO", "32768", false, "offset data range to that of unsigned short"));
+    else if (bpp == 32)
+        cards.push_back(makeCard("BZERO", "2147483648", false, "offset data range to that of unsigned long"));
+    if (bpp != 8)
+        cards.push_back(makeCard("BSCALE", "1", false, "default scaling factor"));
+
+    // Cards of the records, in order; a key seen before updates its card, as fits_update_key does
+    std::map<std::string, size_t> keyCards;
+    // Card of each record, npos if none
+    std::vector<size_t> recordCards(records.size(), std::string::npos);
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const FITSRecord &record = records[i];
+        if (record.type() == FITSRecord::VOID)
+            continue;
+
+        if (record.type() == FITSRecord::COMMENT)
+        {
+            std::string comment;
+            appendComment(comment, record.comment());
+            for (size_t offset = 0; offset < comment.size(); offset += CARD_SIZE)
+                cards.push_back(comment.substr(offset, CARD_SIZE));
+            continue;
+        }
+
+        std::string key, card;
+        if (!renderCard(record, key, card))
+        {
+            if (rejected)
+                rejected->push_back(record.key());
+            continue;
+        }
+
+        auto it = keyCards.find(key);
+        if (it != keyCards.end())
+        {
+            cards[it->second] = card;
+            for (auto &recordCard : recordCards)
+            {
+                if (recordCard == it->second)
+                    recordCard = std::string::npos;
+            }
+            recordCards[i] = it->second;
+        }
+        else
+        {
+            keyCards[key] = cards.size();
+            recordCards[i] = cards.size();
+            cards.push_back(card);
+        }
+    }
+
+    if (offsets)
+    {
+        offsets->assign(records.size(), std::string::npos);
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            if (recordCards[i] != std::string::npos)
+                (*offsets)[i] = header.size() + recordCards[i] * CARD_SIZE;
+        }
+    }
+
+    for (auto &card : cards)
+        header += card;
+
+    header += "END";
+    header.resize(header.size() + CARD_SIZE - 3, ' ');
+    header.resize(padToBlock(header.size()), ' ');
+    return header;
+}
+
+}
+
+namespace INDI
+{
+
+std::string makeFITSHeader(int bpp, int naxis, const long *naxes, const std::vector<FITSRecord> &records,
+                           std::vector<std::string> *rejected)
+{
+    return buildHeader(bpp, naxis, naxes, records, rejected, nullptr);
+}
+
+const std::string &FITSHeaderCache::make(int bpp, int naxis, const long *naxes, const std::vector<FITSRecord> &records,
+        std::vector<std::string> *rejected)
+{
+    bool reusable = !m_Header.empty() && bpp == m_BPP && naxis == m_NAxis && records.size() == m_Records.size() &&
+                    std::equal(naxes, naxes + naxis, m_NAxes);
+
+    // Patch the cards of the records that changed, as long as each of them still renders to a single card in place
+    std::vector<std::pair<size_t, std::string>> patches;
+    for (size_t i = 0; reusable && i < records.size(); i++)
+    {
+        const FITSRecord &record = records[i], &previous = m_Records[i];
+        if (sameRecord(record, previous))
+            continue;
+
+        std::string key, card;
+        reusable = record.type() == previous.type() && record.key() == previous.key() &&
+                   m_Offsets[i] != std::string::npos && renderCard(record, key, card);
+        if (reusable)
+            patches.emplace_back(m_Offsets[i], card);
+    }
+
+    if (reusable)
+    {
+        for (auto &patch : patches)
+            m_Header.replace(patch.first, CARD_SIZE, patch.second);
+        if (rejected)
+            rejected->insert(rejected->end(), m_Rejected.begin(), m_Rejected.end());
+    }
+    else
+    {
+        m_Rejected.clear();
+        m_Header = buildHeader(bpp, naxis, naxes, records, &m_Rejected, &m_Offsets);
+        m_BPP = bpp;
+        m_NAxis = naxis;
+        std::copy(naxes, naxes + std::min(naxis, 3), m_NAxes);
+        if (rejected)
+            rejected->insert(rejected->end(), m_Rejected.begin(), m_Rejected.end());
+    }
+
+    m_Records = records;
+    return m_Header;
+}
+
+void FITSHeaderCache::clear()
+{
+    m_Header.clear();
+    m_Records.clear();
+    m_Offsets.clear();
+    m_Rejected.clear();
+}
+
+size_t getFITSDataSize(size_t count, int bpp)
+{
+    return padToBlock(count * (bpp / 8));
+}
+
+void writeFITSData(void *dst, const void *pixels, size_t count, int bpp)
+{
+    auto out = static_cast<uint8_t *>(dst);
+    auto in  = static_cast<const uint8_t *>(pixels);
+    size_t const pixelSize = bpp / 8;
+
+    if (count < PARALLEL_PIXELS)
+        toBigEndian(out, in, count, bpp);
+    else
+    {
+        ThreadPool::global().parallelFor(0, (count + CHUNK_PIXELS - 1) / CHUNK_PIXELS, [&](size_t chunk)
+        {
+            size_t const begin = chunk * CHUNK_PIXELS;
+            toBigEndian(out + begin * pixelSize, in + begin * pixelSize, std::min(CHUNK_PIXELS, count - begin), bpp);
+        }, 4);
+    }
+
+    memset(out + count * pixelSize, 0, getFITSDataSize(count, bpp) - count * pixelSize);
+}
+
+}
@@ -0,0 +1,77 @@
+/**  INDI LIB
+ *   Direct FITS writer
+ *
+ *   This library is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU Lesser General Public
+ *   License as published by the Free Software Foundation; either
+ *   version 2.1 of the License, or (at your option) any later version.
+ *
+ *   This library is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *   Lesser General Public License for more details.
+ *
+ *   You should have received a copy of the GNU Lesser General Public
+ *   License along with this library; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#pragma once
+
+#include "fitskeyword.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @brief Returns the header of a primary HDU holding an image of unsigned pixels of bpp bits, 8, 16 or 32,
+ * padded to a multiple of 2880 bytes. It is the header cfitsio writes for BYTE_IMG, USHORT_IMG and ULONG_IMG,
+ * followed by records, which update an earlier record of the same key as fits_update_key does.
+ * @param rejected If not null, receives the keys of the records that can't be written.
+ * @return An empty string if bpp or naxis is not supported.
+ */
+std::string makeFITSHeader(int bpp, int naxis, const long *naxes, const std::vector<FITSRecord> &records,
+                           std::vector<std::string> *rejected = nullptr);
+
+/**
+ * @brief The FITSHeaderCache class keeps the header of the previous frame of a chip. Most records, as the instrument,
+ * the telescope, the site or the pixel size, do not change from one frame to the next: when the image and the keys of
+ * the records are those of the previous frame, only the cards of the records whose value changed, as DATE-OBS,
+ * EXPTIME, the coordinates or the temperatures, are rendered again and patched in place.
+ */
+class FITSHeaderCache
+{
+    public:
+        /** @brief Returns the header makeFITSHeader would, valid until the next call. */
+        const std::string &make(int bpp, int naxis, const long *naxes, const std::vector<FITSRecord> &records,
+                                std::vector<std::string> *rejected = nullptr);
+
+        /** @brief Renders the next header in full. */
+        void clear();
+
+    private:
+        std::string m_Header;
+        int m_BPP {0};
+        int m_NAxis {0};
+        long m_NAxes[3] {0, 0, 0};
+        std::vector<FITSRecord> m_Records;
+        // Offset of the card of each record in m_Header, npos if it has none of its own
+        std::vector<size_t> m_Offsets;
+        std::vector<std::string> m_Rejected;
+};
+
+/** @brief Returns the size of the data of count pixels of bpp bits, padded to a multiple of 2880 bytes. */
+size_t getFITSDataSize(size_t count, int bpp);
+
+/**
+ * @brief Writes count unsigned pixels of bpp bits as the data of the header made by makeFITSHeader, big endian
+ * and offset by BZERO, followed by the padding. dst must hold getFITSDataSize(count, bpp) bytes.
+ * Large frames are converted in parallel on the global ThreadPool.
+ */
+void writeFITSData(void *dst, const void *pixels, size_t count, int bpp);
+
+}
@@ -0,0 +1,226 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indiblobhttpserver.h"
+
+#include <httplib.h>
+
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace INDI
+{
+
+namespace
+{
+
+bool endsWith(const std::string &text, const char *suffix)
+{
+    size_t const length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+const char *contentType(const std::string &format)
+{
+    if (endsWith(format, ".jpg") || endsWith(format, ".jpeg") || endsWith(format, ".stream_jpg"))
+        return "image/jpeg";
+    if (endsWith(format, ".fits") || endsWith(format, ".fits.zst"))
+        return "image/fits";
+    return "application/octet-stream";
+}
+
+// Chunks written to the socket for each read of a file
+constexpr size_t FILE_CHUNK = 1 << 20;
+
+}
+
+BlobHttpServer::BlobHttpServer() {}
+
+BlobHttpServer::~BlobHttpServer()
+{
+    stop();
+}
+
+bool BlobHttpServer::start(uint16_t port)
+{
+    stop();
+
+    m_Server.reset(new httplib::Server());
+    m_Server->Get(R"(/blob/(\d+).*)", [this](const httplib::Request & req, httplib::Response & res)
+    {
+        Entry entry;
+        if (!find(std::stoull(req.matches[1]), entry))
+        {
+            res.status = 404;
+            return;
+        }
+
+        res.set_header("Accept-Ranges", "bytes");
+        // Zstd is a registered coding, LZ4 frames are served as they are
+        if (endsWith(entry.format, ".zst"))
+            res.set_header("Content-Encoding", "zstd");
+
+        if (entry.data)
+        {
+            auto data = entry.data;
+            res.set_content_provider(data->size(), contentType(entry.format),
+                                     [data](size_t offset, size_t length, httplib::DataSink & sink)
+            {
+                return sink.write(reinterpret_cast<const char *>(data->data()) + offset, length);
+            });
+            return;
+        }
+
+        int fd = open(entry.fileName.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd == -1 || fstat(fd, &st) == -1)
+        {
+            if (fd != -1)
+                close(fd);
+            res.status = 404;
+            return;
+        }
+
+        res.set_content_provider(st.st_size, contentType(entry.format),
+                                 [fd](size_t offset, size_t length, httplib::DataSink & sink)
+        {
+            std::vector<char> chunk(std::min(length, FILE_CHUNK));
+            while (length > 0)
+            {
+                ssize_t const n = pread(fd, chunk.data(), std::min(length, chunk.size()), offset);
+                if (n <= 0 || !sink.write(chunk.data(), n))
+                    return false;
+                offset += n;
+                length -= n;
+            }
+            return true;
+        },
+        [fd](bool)
+        {
+            close(fd);
+        });
+    });
+
+    if (port == 0)
+    {
+        int const bound = m_Server->bind_to_any_port("0.0.0.0");
+        if (bound <= 0)
+        {
+            m_Server.reset();
+            return false;
+        }
+        m_Port = static_cast<uint16_t>(bound);
+    }
+    else
+    {
+        if (!m_Server->bind_to_port("0.0.0.0", port))
+        {
+            m_Server.reset();
+            return false;
+        }
+        m_Port = port;
+    }
+
+    m_Thread = std::thread([this]()
+    {
+        m_Server->listen_after_bind();
+    });
+    return true;
+}
+
+void BlobHttpServer::stop()
+{
+    if (!m_Server)
+        return;
+
+    m_Server->stop();
+    if (m_Thread.joinable())
+        m_Thread.join();
+    m_Server.reset();
+    m_Port = 0;
+}
+
+bool BlobHttpServer::isRunning() const
+{
+    return m_Server != nullptr;
+}
+
+void BlobHttpServer::setCapacity(size_t count)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    m_Capacity = std::max<size_t>(count, 1);
+    while (m_Entries.size() > m_Capacity)
+        m_Entries.pop_front();
+}
+
+std::string BlobHttpServer::publish(const void *data, size_t size, const std::string &format)
+{
+    Entry entry;
+    entry.format = format;
+    entry.data   = std::make_shared<const std::vector<uint8_t>>(static_cast<const uint8_t *>(data),
+                   static_cast<const uint8_t *>(data) + size);
+    return add(std::move(entry));
+}
+
+std::string BlobHttpServer::publishFile(const std::string &fileName, const std::string &format)
+{
+    Entry entry;
+    entry.format   = format;
+    entry.fileName = fileName;
+    return add(std::move(entry));
+}
+
+std::string BlobHttpServer::url(const std::string &path) const
+{
+    char host[256] = "localhost";
+    if (gethostname(host, sizeof(host)) != 0)
+        strcpy(host, "localhost");
+    host[sizeof(host) - 1] = '\0';
+
+    return "http://" + std::string(host) + ":" + std::to_string(m_Port) + path;
+}
+
+std::string BlobHttpServer::add(Entry &&entry)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    entry.id = m_NextId++;
+    std::string path = "/blob/" + std::to_string(entry.id) + entry.format;
+
+    m_Entries.push_back(std::move(entry));
+    while (m_Entries.size() > m_Capacity)
+        m_Entries.pop_front();
+    return path;
+}
+
+bool BlobHttpServer::find(uint64_t id, Entry &entry)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    for (const auto &one : m_Entries)
+    {
+        if (one.id == id)
+        {
+            entry = one;
+            return true;
+        }
+    }
+    return false;
+}
+
+}
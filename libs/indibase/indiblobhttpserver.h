@@ -0,0 +1,104 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace httplib
+{
+class Server;
+}
+
+namespace INDI
+{
+
+/**
+ * @class BlobHttpServer
+ * @brief The BlobHttpServer class serves the last BLOBs of a device over HTTP, for clients to pull them.
+ *
+ * Each published BLOB gets a path of its own, under /blob/. The last ones are kept, copied in memory or
+ * as a file on disk, and older paths answer 404. Clients may request byte ranges, to fetch a BLOB in
+ * parallel or resume its download. Zstd frames are served with their Content-Encoding.
+ *
+ * The server listens on a thread of its own. Publishing is thread safe.
+ */
+class BlobHttpServer
+{
+    public:
+        BlobHttpServer();
+        ~BlobHttpServer();
+
+        /**
+         * @brief Starts listening on all interfaces.
+         * @param port to listen on, 0 for any free one.
+         * @return False if the port could not be bound.
+         */
+        bool start(uint16_t port);
+        void stop();
+        bool isRunning() const;
+
+        /** @return The port listened on, 0 when stopped. */
+        uint16_t port() const
+        {
+            return m_Port;
+        }
+
+        /** @brief Sets how many BLOBs are kept, the older ones are dropped. */
+        void setCapacity(size_t count);
+
+        /**
+         * @brief Publishes a copy of data.
+         * @param format of the BLOB, e.g. ".fits" or ".fits.zst".
+         * @return The path of the BLOB on the server.
+         */
+        std::string publish(const void *data, size_t size, const std::string &format);
+
+        /** @brief Publishes a file, served from disk as long as it is kept. */
+        std::string publishFile(const std::string &fileName, const std::string &format);
+
+        /** @return The URL of a published path, with the host name of this machine. */
+        std::string url(const std::string &path) const;
+
+    private:
+        struct Entry
+        {
+            uint64_t id;
+            std::string format;
+            std::shared_ptr<const std::vector<uint8_t>> data;
+            std::string fileName;
+        };
+
+        std::string add(Entry &&entry);
+        bool find(uint64_t id, Entry &entry);
+
+        std::unique_ptr<httplib::Server> m_Server;
+        std::thread m_Thread;
+        uint16_t m_Port {0};
+
+        std::mutex m_Lock;
+        std::deque<Entry> m_Entries;
+        size_t m_Capacity {4};
+        uint64_t m_NextId {1};
+};
+
+}
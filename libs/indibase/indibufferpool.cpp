@@ -0,0 +1,274 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indibufferpool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+
+#if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/mman.h>
+#include <unistd.h>
+#define INDI_BUFFER_POOL_MMAP
+#endif
+
+namespace INDI
+{
+
+namespace
+{
+
+constexpr size_t HUGE_PAGE_SIZE = 2u << 20;
+
+size_t pageSize()
+{
+#ifdef INDI_BUFFER_POOL_MMAP
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+}
+
+class BufferPoolPrivate
+{
+    public:
+        struct Block
+        {
+            uint8_t *data;
+            size_t capacity;
+        };
+
+    public:
+        explicit BufferPoolPrivate(size_t maxBytes) : maxBytes(maxBytes) { }
+        ~BufferPoolPrivate()
+        {
+            for (auto &block : released)
+                unmap(block);
+        }
+
+    public:
+        Block take(size_t size)
+        {
+            bool huge;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                huge = hugePages && size >= HUGE_PAGE_SIZE;
+
+                // Smallest released block that holds size, without wasting a much larger one
+                auto best = released.end();
+                for (auto it = released.begin(); it != released.end(); ++it)
+                    if (it->capacity >= size && it->capacity / 2 <= size && (best == released.end() || it->capacity < best->capacity))
+                        best = it;
+
+                if (best != released.end())
+                {
+                    Block block = *best;
+                    released.erase(best);
+                    releasedBytes -= block.capacity;
+                    return block;
+                }
+            }
+            return map(size, huge);
+        }
+
+        void give(const Block &block)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            released.push_back(block);
+            releasedBytes += block.capacity;
+
+            while (releasedBytes > maxBytes && !released.empty())
+            {
+                releasedBytes -= released.front().capacity;
+                unmap(released.front());
+                released.pop_front();
+            }
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            for (auto &block : released)
+                unmap(block);
+            released.clear();
+            releasedBytes = 0;
+        }
+
+        static Block map(size_t size, bool huge)
+        {
+            size_t const unit = huge ? HUGE_PAGE_SIZE : pageSize();
+            size_t const capacity = std::max<size_t>(1, (size + unit - 1) / unit) * unit;
+
+#ifdef INDI_BUFFER_POOL_MMAP
+            void *data = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+            if (data == MAP_FAILED)
+                return {nullptr, 0};
+#ifdef MADV_HUGEPAGE
+            if (huge)
+                madvise(data, capacity, MADV_HUGEPAGE);
+#endif
+#else
+            void *data = std::malloc(capacity);
+            if (data == nullptr)
+                return {nullptr, 0};
+#endif
+            // Fault the pages in now, once, rather than on each first write of a frame
+            auto bytes = static_cast<volatile uint8_t *>(data);
+            for (size_t offset = 0; offset < capacity; offset += pageSize())
+                bytes[offset] = 0;
+
+            return {static_cast<uint8_t *>(data), capacity};
+        }
+
+        static void unmap(const Block &block)
+        {
+#ifdef INDI_BUFFER_POOL_MMAP
+            munmap(block.data, block.capacity);
+#else
+            std::free(block.data);
+#endif
+        }
+
+    public:
+        mutable std::mutex lock;
+        std::deque<Block> released;
+        size_t releasedBytes {0};
+        size_t maxBytes;
+        bool hugePages {false};
+};
+
+BufferPool::Buffer::Buffer(Buffer &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+BufferPool::Buffer &BufferPool::Buffer::operator=(Buffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_Pool = std::move(other.m_Pool);
+        m_Done = std::move(other.m_Done);
+        other.m_Done = nullptr;
+        m_Data = other.m_Data;
+        m_Size = other.m_Size;
+        m_Capacity = other.m_Capacity;
+        other.m_Data = nullptr;
+        other.m_Size = other.m_Capacity = 0;
+    }
+    return *this;
+}
+
+BufferPool::Buffer::~Buffer()
+{
+    release();
+}
+
+bool BufferPool::Buffer::resize(size_t size)
+{
+    if (size <= m_Capacity)
+    {
+        m_Size = size;
+        return true;
+    }
+
+    if (!m_Pool)
+        return false;
+
+    auto block = m_Pool->take(size);
+    if (block.data == nullptr)
+        return false;
+
+    if (m_Data)
+        memcpy(block.data, m_Data, m_Size);
+
+    auto pool = m_Pool;
+    release();
+    m_Pool = pool;
+    m_Data = block.data;
+    m_Size = size;
+    m_Capacity = block.capacity;
+    return true;
+}
+
+BufferPool::Buffer BufferPool::Buffer::wrap(uint8_t *data, size_t size, std::function<void()> done)
+{
+    Buffer buffer;
+    buffer.m_Done = std::move(done);
+    buffer.m_Data = data;
+    buffer.m_Size = buffer.m_Capacity = size;
+    return buffer;
+}
+
+void BufferPool::Buffer::release()
+{
+    if (m_Data && m_Pool)
+        m_Pool->give({m_Data, m_Capacity});
+
+    // Cleared before it is called, in case it releases another buffer
+    auto done = std::move(m_Done);
+    m_Done = nullptr;
+
+    m_Pool.reset();
+    m_Data = nullptr;
+    m_Size = m_Capacity = 0;
+
+    if (done)
+        done();
+}
+
+BufferPool::BufferPool(size_t maxBytes)
+    : d_ptr(std::make_shared<BufferPoolPrivate>(maxBytes))
+{ }
+
+BufferPool::Buffer BufferPool::acquire(size_t size)
+{
+    Buffer buffer;
+    auto block = d_ptr->take(size);
+    if (block.data == nullptr)
+        return buffer;
+
+    buffer.m_Pool = d_ptr;
+    buffer.m_Data = block.data;
+    buffer.m_Size = size;
+    buffer.m_Capacity = block.capacity;
+    return buffer;
+}
+
+void BufferPool::clear()
+{
+    d_ptr->clear();
+}
+
+void BufferPool::setHugePages(bool enabled)
+{
+    std::lock_guard<std::mutex> guard(d_ptr->lock);
+    d_ptr->hugePages = enabled;
+}
+
+size_t BufferPool::cachedBytes() const
+{
+    std::lock_guard<std::mutex> guard(d_ptr->lock);
+    return d_ptr->releasedBytes;
+}
+
+}
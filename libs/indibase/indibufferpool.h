@@ -0,0 +1,123 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace INDI
+{
+
+class BufferPoolPrivate;
+/**
+ * @class BufferPool
+ * @brief The BufferPool class recycles the large buffers used for each frame.
+ *
+ * Buffers are page aligned and their pages are touched when they are first allocated, so that a frame
+ * written to a recycled buffer neither allocates nor faults. Released buffers are kept for the next
+ * acquire() up to a total size, the oldest ones are freed beyond it.
+ *
+ * Copies share the same pool. Buffers can outlive the pool they came from, and are then freed.
+ */
+class BufferPool
+{
+    public:
+        /**
+         * @class Buffer
+         * @brief A buffer taken from a BufferPool, given back to it when destroyed.
+         *
+         * A buffer can also lend memory the pool does not own, see wrap().
+         */
+        class Buffer
+        {
+            public:
+                Buffer() = default;
+                Buffer(Buffer &&other) noexcept;
+                Buffer &operator=(Buffer &&other) noexcept;
+                ~Buffer();
+
+                Buffer(const Buffer &) = delete;
+                Buffer &operator=(const Buffer &) = delete;
+
+                /** @brief Lends size bytes at data that belong to someone else, a device buffer for instance.
+                 *  The memory is not copied, and done is called instead of giving it back to a pool when the
+                 *  buffer is released. Such a buffer cannot grow beyond size. */
+                static Buffer wrap(uint8_t *data, size_t size, std::function<void()> done);
+
+            public:
+                uint8_t *data() const
+                {
+                    return m_Data;
+                }
+
+                /** @brief Returns the size requested from acquire() or resize(). */
+                size_t size() const
+                {
+                    return m_Size;
+                }
+
+                /** @brief Returns the size that resize() can grow to without another buffer. */
+                size_t capacity() const
+                {
+                    return m_Capacity;
+                }
+
+                bool empty() const
+                {
+                    return m_Data == nullptr;
+                }
+
+                /** @brief Changes the size, moving the contents to a larger buffer of the pool if needed.
+                 *  @return False if no larger buffer could be allocated, the buffer is then unchanged. */
+                bool resize(size_t size);
+
+                /** @brief Gives the memory back to the pool, or to the owner of a wrapped buffer, now. */
+                void release();
+
+            private:
+                friend class BufferPool;
+                std::shared_ptr<BufferPoolPrivate> m_Pool;
+                std::function<void()> m_Done;
+                uint8_t *m_Data {nullptr};
+                size_t m_Size {0};
+                size_t m_Capacity {0};
+        };
+
+    public:
+        /** @brief Creates a pool keeping up to maxBytes of released buffers. */
+        explicit BufferPool(size_t maxBytes = 512u << 20);
+
+    public:
+        /** @brief Returns a buffer of at least size bytes, empty if it could not be allocated. */
+        Buffer acquire(size_t size);
+
+        /** @brief Frees the released buffers. */
+        void clear();
+
+        /** @brief Asks the system to back buffers of 2 MB or more allocated from now on with huge pages.
+         *  It is a hint that has no effect where transparent huge pages are not available. */
+        void setHugePages(bool enabled);
+
+        /** @brief Returns the total size of the released buffers kept for reuse. */
+        size_t cachedBytes() const;
+
+    protected:
+        std::shared_ptr<BufferPoolPrivate> d_ptr;
+};
+
+}
@@ -0,0 +1,296 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indicalibration.h"
+
+#include "indidevapi.h"
+
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+#include <dirent.h>
+#include <fitsio.h>
+
+namespace INDI
+{
+
+// Sets of masters kept for the frame layouts and exposures last calibrated
+static constexpr size_t MAX_SETS = 4;
+
+size_t CalibrationCache::setDirectory(const std::string &directory)
+{
+    std::vector<Master> masters;
+
+    DIR *dir = opendir(directory.c_str());
+    if (dir != nullptr)
+    {
+        for (struct dirent *entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+        {
+            const char *extension = strrchr(entry->d_name, '.');
+            if (extension == nullptr || (strcasecmp(extension, ".fits") && strcasecmp(extension, ".fit")))
+                continue;
+
+            Master master;
+            if (readHeader(directory + "/" + entry->d_name, master))
+                masters.push_back(std::move(master));
+        }
+        closedir(dir);
+    }
+
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    m_Sets.clear();
+    m_Masters.swap(masters);
+    return m_Masters.size();
+}
+
+void CalibrationCache::setTemperatureTolerance(double tolerance)
+{
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    m_TemperatureTolerance = tolerance;
+    m_Sets.clear();
+}
+
+size_t CalibrationCache::count(MasterType type) const
+{
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    return std::count_if(m_Masters.begin(), m_Masters.end(), [type](const Master & master)
+    {
+        return master.type == type;
+    });
+}
+
+bool CalibrationCache::readHeader(const std::string &file, Master &master)
+{
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    if (fits_open_diskfile(&fptr, file.c_str(), READONLY, &status))
+        return false;
+
+    char type[FLEN_VALUE] = {0};
+    int keyStatus = 0;
+    if (fits_read_key(fptr, TSTRING, "IMAGETYP", type, nullptr, &keyStatus))
+    {
+        keyStatus = 0;
+        fits_read_key(fptr, TSTRING, "FRAME", type, nullptr, &keyStatus);
+    }
+
+    int naxis = 0, bitpix = 0;
+    long naxes[2] = {0, 0};
+    fits_get_img_param(fptr, 2, &bitpix, &naxis, naxes, &status);
+
+    auto readDouble = [fptr](const char *key, double fallback)
+    {
+        double value = fallback;
+        int keyStatus = 0;
+        fits_read_key(fptr, TDOUBLE, key, &value, nullptr, &keyStatus);
+        return keyStatus ? fallback : value;
+    };
+    master.binX        = std::max(1, static_cast<int>(readDouble("XBINNING", 1)));
+    master.binY        = std::max(1, static_cast<int>(readDouble("YBINNING", 1)));
+    master.gain        = readDouble("GAIN", NAN);
+    master.temperature = readDouble("CCD-TEMP", NAN);
+    master.exposure    = readDouble("EXPTIME", 0);
+
+    fits_close_file(fptr, &keyStatus);
+
+    if (status || naxis != 2)
+        return false;
+
+    if (strcasestr(type, "bias"))
+        master.type = MASTER_BIAS;
+    else if (strcasestr(type, "dark"))
+        master.type = MASTER_DARK;
+    else if (strcasestr(type, "flat"))
+        master.type = MASTER_FLAT;
+    else
+        return false;
+
+    master.file   = file;
+    master.width  = naxes[0];
+    master.height = naxes[1];
+    return true;
+}
+
+bool CalibrationCache::load(Master &master)
+{
+    if (!master.data.empty())
+        return true;
+    if (master.failed)
+        return false;
+
+    fitsfile *fptr = nullptr;
+    int status = 0;
+    master.data.resize(static_cast<size_t>(master.width) * master.height);
+    fits_open_diskfile(&fptr, master.file.c_str(), READONLY, &status);
+    fits_read_img(fptr, sizeof(dsp_t) == sizeof(float) ? TFLOAT : TDOUBLE, 1, master.data.size(), nullptr,
+                  master.data.data(), nullptr, &status);
+
+    if (status)
+    {
+        char error[FLEN_STATUS];
+        fits_get_errstatus(status, error);
+        IDLog("CalibrationCache: can not read master %s: %s\n", master.file.c_str(), error);
+        master.data.clear();
+        master.data.shrink_to_fit();
+        master.failed = true;
+    }
+
+    int closeStatus = 0;
+    if (fptr)
+        fits_close_file(fptr, &closeStatus);
+    return !master.failed;
+}
+
+const CalibrationCache::Master *CalibrationCache::match(MasterType type, const Frame &frame)
+{
+    Master *best = nullptr;
+    double bestScore = 0;
+
+    for (Master &master : m_Masters)
+    {
+        if (master.type != type || master.failed || master.binX != frame.binX || master.binY != frame.binY ||
+                master.width < frame.x + frame.width || master.height < frame.y + frame.height)
+            continue;
+
+        // Unknown on either side matches anything
+        if (!std::isnan(master.gain) && !std::isnan(frame.gain) && std::fabs(master.gain - frame.gain) >= 0.5)
+            continue;
+
+        double temperature = 0;
+        if (!std::isnan(master.temperature) && !std::isnan(frame.temperature))
+        {
+            temperature = std::fabs(master.temperature - frame.temperature);
+            if (temperature > m_TemperatureTolerance)
+                continue;
+        }
+
+        // Closest temperature, then for darks the closest exposure
+        double score = temperature;
+        if (type == MASTER_DARK)
+            score = score * 1e6 + std::fabs(master.exposure - frame.exposure);
+
+        if (best == nullptr || score < bestScore)
+        {
+            best = &master;
+            bestScore = score;
+        }
+    }
+
+    if (best != nullptr && !load(*best))
+        return match(type, frame);
+    return best;
+}
+
+const CalibrationCache::Set *CalibrationCache::set(const Frame &frame)
+{
+    const Master *masters[MASTER_TYPES];
+    for (int type = 0; type < MASTER_TYPES; type++)
+        masters[type] = match(static_cast<MasterType>(type), frame);
+
+    if (!masters[MASTER_BIAS] && !masters[MASTER_DARK] && !masters[MASTER_FLAT])
+        return nullptr;
+
+    // The scaled dark depends on the exposure, the rest of it only on the layout
+    double const exposure = masters[MASTER_BIAS] && masters[MASTER_DARK] ? frame.exposure : 0;
+
+    for (auto it = m_Sets.begin(); it != m_Sets.end(); ++it)
+    {
+        if (std::equal(masters, masters + MASTER_TYPES, it->masters) && it->x == frame.x && it->y == frame.y &&
+                it->width == frame.width && it->height == frame.height && it->exposure == exposure)
+        {
+            m_Sets.splice(m_Sets.begin(), m_Sets, it);
+            return &m_Sets.front();
+        }
+    }
+
+    Set set;
+    std::copy(masters, masters + MASTER_TYPES, set.masters);
+    set.x = frame.x;
+    set.y = frame.y;
+    set.width = frame.width;
+    set.height = frame.height;
+    set.exposure = exposure;
+
+    size_t const pixels = static_cast<size_t>(frame.width) * frame.height;
+    auto at = [&frame](const Master * master, size_t i)
+    {
+        size_t const row = i / frame.width, column = i % frame.width;
+        return master->data[(frame.y + row) * master->width + frame.x + column];
+    };
+
+    const Master *bias = masters[MASTER_BIAS], *dark = masters[MASTER_DARK], *flat = masters[MASTER_FLAT];
+    if (bias || dark)
+    {
+        // A dark without a bias holds the bias too, and can not be scaled
+        double const scale = bias && dark && dark->exposure > 0 ? frame.exposure / dark->exposure : 1;
+        set.offset.resize(pixels);
+        for (size_t i = 0; i < pixels; i++)
+        {
+            double offset = bias ? at(bias, i) : 0;
+            if (dark)
+                offset += (at(dark, i) - offset) * (bias ? scale : 1);
+            set.offset[i] = offset;
+        }
+    }
+
+    if (flat)
+    {
+        double mean = 0;
+        for (size_t i = 0; i < pixels; i++)
+            mean += at(flat, i);
+        mean /= pixels;
+
+        // Dead pixels of the flat are left as they are
+        set.flat.resize(pixels);
+        for (size_t i = 0; i < pixels; i++)
+        {
+            double const value = at(flat, i);
+            set.flat[i] = value > 0 && mean > 0 ? value / mean : 1;
+        }
+    }
+
+    m_Sets.push_front(std::move(set));
+    if (m_Sets.size() > MAX_SETS)
+        m_Sets.pop_back();
+    return &m_Sets.front();
+}
+
+bool CalibrationCache::calibrate(dsp_t *pixels, const Frame &frame)
+{
+    if (pixels == nullptr || frame.width == 0 || frame.height == 0)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    const Set *calibration = set(frame);
+    if (calibration == nullptr)
+        return false;
+
+    // The kernel only works on the buffer of the stream, a frame does not need a stream of its own
+    dsp_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.buf = pixels;
+    stream.len = static_cast<int>(static_cast<size_t>(frame.width) * frame.height);
+
+    dsp_buffer_calibrate(&stream,
+                         calibration->offset.empty() ? nullptr : const_cast<dsp_t *>(calibration->offset.data()),
+                         nullptr,
+                         calibration->flat.empty() ? nullptr : const_cast<dsp_t *>(calibration->flat.data()),
+                         0, 0);
+    return true;
+}
+
+}
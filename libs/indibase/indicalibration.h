@@ -0,0 +1,119 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "dsp.h"
+
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @class CalibrationCache
+ * @brief The CalibrationCache class holds the master bias, dark and flat frames of a directory of FITS files, to
+ * calibrate frames in the driver.
+ *
+ * Masters are told apart by their IMAGETYP or FRAME keyword, and matched to a frame by their XBINNING, YBINNING, GAIN
+ * and CCD-TEMP keywords. They are read once, on first use. The dark current of the dark is scaled to the exposure of
+ * the frame when there is a bias. What a set of masters subtracts and divides by is computed once per frame layout
+ * and exposure, so that a frame is calibrated in a single pass of dsp_buffer_calibrate().
+ *
+ * It is safe to use from any thread.
+ */
+class CalibrationCache
+{
+    public:
+        typedef enum
+        {
+            MASTER_BIAS,
+            MASTER_DARK,
+            MASTER_FLAT,
+            MASTER_TYPES
+        } MasterType;
+
+        /** @brief Layout and conditions of a frame to calibrate. Unknown gain and temperature are NAN. */
+        struct Frame
+        {
+            /** @brief Origin and size in binned pixels, as read out of the chip. */
+            uint32_t x {0}, y {0}, width {0}, height {0};
+            int binX {1}, binY {1};
+            double gain {NAN};
+            double temperature {NAN};
+            double exposure {0};
+        };
+
+    public:
+        /** @brief Scans directory for masters, forgetting those of the previous one. @return The masters found. */
+        size_t setDirectory(const std::string &directory);
+
+        /** @brief Masters more than tolerance degrees away from the temperature of the frame are not used, 2 by default. */
+        void setTemperatureTolerance(double tolerance);
+
+        /** @returns How many masters of type were found. */
+        size_t count(MasterType type) const;
+
+        /**
+         * @brief Calibrates width x height pixels of frame, in place.
+         * @return False if no master matches the frame, which is then left as it is.
+         */
+        bool calibrate(dsp_t *pixels, const Frame &frame);
+
+    private:
+        struct Master
+        {
+            MasterType type;
+            std::string file;
+            uint32_t width {0}, height {0};
+            int binX {1}, binY {1};
+            double gain {NAN};
+            double temperature {NAN};
+            double exposure {0};
+
+            std::vector<dsp_t> data;
+            bool failed {false};
+        };
+
+        // What calibrates a frame layout at an exposure
+        struct Set
+        {
+            const Master *masters[MASTER_TYPES] {nullptr, nullptr, nullptr};
+            uint32_t x, y, width, height;
+            double exposure;
+            std::vector<dsp_t> offset;
+            std::vector<dsp_t> flat;
+        };
+
+        // With m_Lock held
+        const Master *match(MasterType type, const Frame &frame);
+        bool load(Master &master);
+        const Set *set(const Frame &frame);
+
+        static bool readHeader(const std::string &file, Master &master);
+
+        std::vector<Master> m_Masters;
+        // Most recently used first
+        std::list<Set> m_Sets;
+        double m_TemperatureTolerance {2};
+        mutable std::mutex m_Lock;
+};
+
+}
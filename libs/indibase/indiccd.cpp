@@ -33,11 +33,26 @@
 #include "indicom.h"
 #include "locale_compat.h"
 #include "indiutility.h"
+#include "indithreadpool.h"
+#include "inditaskqueue.h"
+#include "fitswriter.h"
+#include "indiminmax.h"
+#include "indipreview.h"
+#include "indistaranalysis.h"
+#include "inditrace.h"
 
 #ifdef HAVE_XISF
 #include <libxisf.h>
 #endif
 
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 #include <fitsio.h>
 
 #include <libnova/julian_day.h>
@@ -51,13 +66,19 @@
 #include <cmath>
 #include <regex>
 #include <iterator>
+#include <algorithm>
 #include <variant>
+#include <atomic>
+#include <vector>
+#include <streambuf>
 
 #include <dirent.h>
 #include <cerrno>
 #include <cstdlib>
 #include <zlib.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 const char * IMAGE_SETTINGS_TAB = "Image Settings";
 const char * IMAGE_INFO_TAB     = "Image Info";
@@ -76,6 +97,223 @@ std::string join(std::vector<std::string> const &strings, std::string delim)
     return ss.str();
 }
 
+namespace
+{
+// Row tiles of at least this many bytes are Rice compressed in parallel
+constexpr size_t FPACK_PARALLEL_BYTES = 2 * 1024 * 1024;
+
+// Rice compresses the 16 or 32 bit primary image of a FITS file in row tiles, in parallel, into a tile
+// compressed image, as fp_pack_data_to_data does with its defaults. Returns false without output for
+// images this does not handle, which are then left to fpack.
+bool packFITSTiles(const char *fits, size_t size, uint8_t **packed, size_t *packedSize)
+{
+    fitsfile *infptr = nullptr, *outfptr = nullptr;
+    int status = 0, bitpix = 0, naxis = 0;
+    long naxes[3] = {1, 1, 1};
+    void *inbuffer = const_cast<char *>(fits);
+
+    if (fits_open_memfile(&infptr, "", READONLY, &inbuffer, &size, 2880, nullptr, &status))
+        return false;
+
+    LONGLONG headstart = 0, datastart = 0, dataend = 0;
+    long blank = 0;
+    int blankStatus = 0;
+    fits_get_img_param(infptr, 3, &bitpix, &naxis, naxes, &status);
+    fits_get_hduaddrll(infptr, &headstart, &datastart, &dataend, &status);
+    bool hasBlank = fits_read_key(infptr, TLONG, "BLANK", &blank, nullptr, &blankStatus) == 0;
+
+    const size_t bytepix = bitpix == SHORT_IMG ? 2 : 4;
+    const size_t width = naxes[0];
+    const size_t rows = naxes[1] * naxes[2];
+    if (status || hasBlank || (bitpix != SHORT_IMG && bitpix != LONG_IMG) || naxis < 2 ||
+            width * rows * bytepix < FPACK_PARALLEL_BYTES || static_cast<size_t>(datastart) + width * rows * bytepix > size)
+    {
+        status = 0;
+        fits_close_file(infptr, &status);
+        return false;
+    }
+
+    // Tiles are independent: the same Rice streams fits_img_compress would write, one per row
+    const uint8_t *pixels = reinterpret_cast<const uint8_t *>(fits) + datastart;
+    const int capacity = static_cast<int>(width * bytepix * 2 + 64);
+    std::vector<std::vector<uint8_t>> tiles(rows);
+    std::atomic_bool failed {false};
+
+    INDI::ThreadPool::global().parallelFor(0, rows, [&](size_t row)
+    {
+        const uint8_t *source = pixels + row * width * bytepix;
+        std::vector<uint8_t> &tile = tiles[row];
+        tile.resize(capacity);
+        int length = -1;
+
+        if (bytepix == 2)
+        {
+            std::vector<short> values(width);
+            for (size_t i = 0; i < width; i++)
+                values[i] = static_cast<short>((source[2 * i] << 8) | source[2 * i + 1]);
+            length = fits_rcomp_short(values.data(), width, tile.data(), capacity, 32);
+        }
+        else
+        {
+            std::vector<int> values(width);
+            for (size_t i = 0; i < width; i++)
+                values[i] = static_cast<int>((uint32_t(source[4 * i]) << 24) | (uint32_t(source[4 * i + 1]) << 16) |
+                                             (uint32_t(source[4 * i + 2]) << 8) | source[4 * i + 3]);
+            length = fits_rcomp(values.data(), width, tile.data(), capacity, 32);
+        }
+
+        if (length < 0)
+            failed = true;
+        else
+            tile.resize(length);
+    }, 16);
+
+    if (failed)
+    {
+        fits_close_file(infptr, &status);
+        return false;
+    }
+
+    *packed = nullptr;
+    *packedSize = 0;
+    void **outbuffer = reinterpret_cast<void **>(packed);
+    fits_create_memfile(&outfptr, outbuffer, packedSize, 2880, realloc, &status);
+
+    // Null primary array, then the image in a compressed binary table
+    long tile[3] = {naxes[0], 1, 1};
+    fits_create_img(outfptr, BYTE_IMG, 0, tile, &status);
+    fits_set_compression_type(outfptr, RICE_1, &status);
+    fits_set_tile_dim(outfptr, naxis, tile, &status);
+    fits_create_img(outfptr, bitpix, naxis, naxes, &status);
+
+    // Image keywords, the structure ones are those of the table
+    int nkeys = 0, nmore = 0;
+    char card[FLEN_CARD];
+    fits_get_hdrspace(infptr, &nkeys, &nmore, &status);
+    for (int i = 1; i <= nkeys && status == 0; i++)
+    {
+        fits_read_record(infptr, i, card, &status);
+        int keyclass = fits_get_keyclass(card);
+        if (keyclass != TYP_STRUC_KEY && keyclass != TYP_CMPRS_KEY && keyclass != TYP_CKSUM_KEY)
+            fits_write_record(outfptr, card, &status);
+    }
+
+    int column = 0;
+    char columnName[] = "COMPRESSED_DATA";
+    fits_get_colnum(outfptr, CASEINSEN, columnName, &column, &status);
+    for (size_t row = 0; row < rows && status == 0; row++)
+        fits_write_col(outfptr, TBYTE, column, row + 1, 1, tiles[row].size(), tiles[row].data(), &status);
+
+    fits_write_chksum(outfptr, &status);
+    fits_movabs_hdu(outfptr, 1, nullptr, &status);
+    fits_write_chksum(outfptr, &status);
+
+    int closeStatus = 0;
+    fits_close_file(outfptr, &closeStatus);
+    fits_close_file(infptr, &closeStatus);
+
+    if (status)
+    {
+        free(*packed);
+        *packed = nullptr;
+        *packedSize = 0;
+        return false;
+    }
+    return true;
+}
+
+// Flux weighted centroid of the pixels of [x0, x1) x [y0, y1) standing out of the background by more than threshold
+// times its noise, in pixels of the frame. False if no star stands out of the window.
+template <typename T>
+bool measureCentroid(const T *frame, uint32_t width, uint32_t x0, uint32_t y0, uint32_t x1, uint32_t y1,
+                     double &cx, double &cy, double threshold = 3)
+{
+    double sum = 0, sumSquared = 0, peak = 0;
+    for (uint32_t y = y0; y < y1; y++)
+        for (uint32_t x = x0; x < x1; x++)
+        {
+            double const value = frame[static_cast<size_t>(y) * width + x];
+            sum += value;
+            sumSquared += value * value;
+            peak = std::max(peak, value);
+        }
+
+    double const count = static_cast<double>(x1 - x0) * (y1 - y0);
+    if (count < 4)
+        return false;
+
+    double const background = sum / count;
+    double const noise = std::sqrt(std::max(0.0, sumSquared / count - background * background));
+    double const floor = background + threshold * noise;
+    if (peak <= floor)
+        return false;
+
+    double flux = 0, fluxX = 0, fluxY = 0;
+    for (uint32_t y = y0; y < y1; y++)
+        for (uint32_t x = x0; x < x1; x++)
+        {
+            double const value = frame[static_cast<size_t>(y) * width + x];
+            if (value <= floor)
+                continue;
+            flux += value - background;
+            fluxX += (value - background) * x;
+            fluxY += (value - background) * y;
+        }
+
+    cx = fluxX / flux;
+    cy = fluxY / flux;
+    return true;
+}
+
+#ifdef HAVE_XISF
+// Frames of at least this many bytes are copied into the XISF image in parallel
+constexpr size_t XISF_PARALLEL_BYTES = 1 << 22;
+constexpr size_t CHUNK_BYTES         = 1 << 20;
+
+// Output of XISFWriter, written into a pooled buffer rather than a ByteArray allocated for each frame
+class PooledStreamBuffer : public std::streambuf
+{
+    public:
+        explicit PooledStreamBuffer(INDI::BufferPool::Buffer &buffer) : m_Buffer(buffer) { }
+
+        size_t size() const
+        {
+            return m_Size;
+        }
+
+    protected:
+        std::streamsize xsputn(const char *data, std::streamsize count) override
+        {
+            if (!reserve(count))
+                return 0;
+            std::memcpy(m_Buffer.data() + m_Size, data, count);
+            m_Size += count;
+            return count;
+        }
+
+        int_type overflow(int_type ch) override
+        {
+            if (traits_type::eq_int_type(ch, traits_type::eof()))
+                return traits_type::not_eof(ch);
+            char const c = traits_type::to_char_type(ch);
+            return xsputn(&c, 1) == 1 ? ch : traits_type::eof();
+        }
+
+    private:
+        bool reserve(size_t count)
+        {
+            if (m_Size + count <= m_Buffer.size())
+                return true;
+            return m_Buffer.resize(std::max(m_Size + count, m_Buffer.size() + m_Buffer.size() / 2));
+        }
+
+    private:
+        INDI::BufferPool::Buffer &m_Buffer;
+        size_t m_Size {0};
+};
+#endif
+}
+
 namespace INDI
 {
 
@@ -134,6 +372,9 @@ CCD::~CCD()
     // Only update if index is different.
     if (m_ConfigFastExposureIndex != FastExposureToggleSP.findOnSwitchIndex())
         saveConfig(FastExposureToggleSP);
+
+    if (m_SaveSync.valid())
+        m_SaveSync.wait();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -236,6 +477,77 @@ bool CCD::initProperties()
                                IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
     PrimaryCCD.SendCompressed = false;
 
+    // Compression Codec, zlib and whichever of LZ4 and Zstd the library is built with
+    CompressionCodecSP.resize(1);
+    CompressionCodecSP[0].fill("CODEC_ZLIB", "Zlib", ISS_ON);
+#ifdef HAVE_LZ4
+    CompressionCodecSP.resize(CompressionCodecSP.size() + 1);
+    CompressionCodecSP[CompressionCodecSP.size() - 1].fill("CODEC_LZ4", "LZ4", ISS_OFF);
+#endif
+#ifdef HAVE_ZSTD
+    CompressionCodecSP.resize(CompressionCodecSP.size() + 1);
+    CompressionCodecSP[CompressionCodecSP.size() - 1].fill("CODEC_ZSTD", "Zstd", ISS_OFF);
+#endif
+    CompressionCodecSP.fill(getDeviceName(), "CCD_COMPRESSION_CODEC", "Codec",
+                            IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+    // Compression Level
+    CompressionLevelNP[0].fill("LEVEL", "Level", "%.f", 0, 22, 1, 0);
+    CompressionLevelNP.fill(getDeviceName(), "CCD_COMPRESSION_LEVEL", "Codec Level",
+                            IMAGE_SETTINGS_TAB, IP_RW, 60, IPS_IDLE);
+
+    // Preview, clients enable BLOBs of CCD_PREVIEW_IMAGE only to receive it without the full frames
+    PreviewSP[INDI_ENABLED].fill("INDI_ENABLED", "Enabled", ISS_OFF);
+    PreviewSP[INDI_DISABLED].fill("INDI_DISABLED", "Disabled", ISS_ON);
+    PreviewSP.fill(getDeviceName(), "CCD_PREVIEW", "Preview", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+    PreviewSettingsNP[PREVIEW_WIDTH].fill("PREVIEW_WIDTH", "Max width", "%.f", 64, 4096, 64, 640);
+    PreviewSettingsNP[PREVIEW_QUALITY].fill("PREVIEW_QUALITY", "JPEG quality", "%.f", 1, 100, 5, 80);
+    PreviewSettingsNP.fill(getDeviceName(), "CCD_PREVIEW_SETTINGS", "Preview", IMAGE_SETTINGS_TAB, IP_RW, 60, IPS_IDLE);
+
+    PreviewBP[0].fill("PREVIEW", "Preview", "");
+    PreviewBP.fill(getDeviceName(), "CCD_PREVIEW_IMAGE", "Preview Data", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+
+    // Star analysis, so autofocus and guiding clients can work without downloading frames
+    StarAnalysisSP[INDI_ENABLED].fill("INDI_ENABLED", "Enabled", ISS_OFF);
+    StarAnalysisSP[INDI_DISABLED].fill("INDI_DISABLED", "Disabled", ISS_ON);
+    StarAnalysisSP.fill(getDeviceName(), "CCD_STAR_ANALYSIS", "Star Analysis", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+    StarMetricsNP[STAR_COUNT].fill("STARS", "Stars", "%.f", 0, 1e6, 0, 0);
+    StarMetricsNP[STAR_HFR].fill("HFR", "HFR (px)", "%.2f", 0, 1e3, 0, 0);
+    StarMetricsNP[STAR_FWHM].fill("FWHM", "FWHM (px)", "%.2f", 0, 1e3, 0, 0);
+    StarMetricsNP[STAR_BACKGROUND].fill("BACKGROUND", "Background", "%.1f", 0, 4294967295.0, 0, 0);
+    StarMetricsNP[STAR_NOISE].fill("NOISE", "Noise", "%.2f", 0, 4294967295.0, 0, 0);
+    StarMetricsNP.fill(getDeviceName(), "CCD_STAR_METRICS", "Star Metrics", IMAGE_INFO_TAB, IP_RO, 60, IPS_IDLE);
+
+    // Calibration of the previews in the driver, with masters loaded once
+    CalibrationSP[INDI_ENABLED].fill("INDI_ENABLED", "Enabled", ISS_OFF);
+    CalibrationSP[INDI_DISABLED].fill("INDI_DISABLED", "Disabled", ISS_ON);
+    CalibrationSP.fill(getDeviceName(), "CCD_CALIBRATION", "Calibration", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+    CalibrationTP[0].fill("MASTERS_DIR", "Masters", "");
+    CalibrationTP.fill(getDeviceName(), "CCD_CALIBRATION_DIR", "Calibration", IMAGE_SETTINGS_TAB, IP_RW, 60, IPS_IDLE);
+
+    CalibrationSettingsNP[CALIBRATION_TEMPERATURE_TOLERANCE].fill("TEMPERATURE_TOLERANCE", "Temperature (C)", "%.1f",
+            0, 50, 0.5, 2);
+    CalibrationSettingsNP.fill(getDeviceName(), "CCD_CALIBRATION_SETTINGS", "Calibration", IMAGE_SETTINGS_TAB, IP_RW, 60,
+                               IPS_IDLE);
+
+    // Guide ROI, guiders read out and download only the box around their star
+    GuideROISP[GUIDE_ROI_OFF].fill("GUIDE_ROI_OFF", "Off", ISS_ON);
+    GuideROISP[GUIDE_ROI_FIXED].fill("GUIDE_ROI_FIXED", "Fixed", ISS_OFF);
+    GuideROISP[GUIDE_ROI_TRACK].fill("GUIDE_ROI_TRACK", "Track", ISS_OFF);
+    GuideROISP.fill(getDeviceName(), "CCD_GUIDE_ROI_MODE", "Guide ROI", IMAGE_SETTINGS_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
+    GuideROINP[GUIDE_ROI_X].fill("X", "Center X", "%.1f", 0, 65535, 1, 0);
+    GuideROINP[GUIDE_ROI_Y].fill("Y", "Center Y", "%.1f", 0, 65535, 1, 0);
+    GuideROINP[GUIDE_ROI_SIZE].fill("SIZE", "Size", "%.f", 8, 1024, 8, 64);
+    GuideROINP.fill(getDeviceName(), "CCD_GUIDE_ROI", "Guide Box", IMAGE_SETTINGS_TAB, IP_RW, 60, IPS_IDLE);
+
+    GuideROIFullFrameSP[0].fill("FULL_FRAME", "Full Frame", ISS_OFF);
+    GuideROIFullFrameSP.fill(getDeviceName(), "CCD_GUIDE_ROI_FULL_FRAME", "Guide ROI", IMAGE_SETTINGS_TAB, IP_RW,
+                             ISR_ATMOST1, 60, IPS_IDLE);
+
     // Primary CCD Chip Data Blob
     // @INDI_STANDARD_PROPERTY@
     PrimaryCCD.FitsBP[0].fill("CCD1", "Image", "");
@@ -457,6 +769,11 @@ bool CCD::initProperties()
     FastExposureCountNP.fill(getDeviceName(), "CCD_FAST_COUNT", "Fast Count",
                              OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
 
+    // Frames buffered while the next ones are read out back to back, when the driver pipelines uploads
+    FastExposureBurstNP[0].fill("FRAMES", "Ring frames", "%.f", 0, 256, 1, 0);
+    FastExposureBurstNP.fill(getDeviceName(), "CCD_FAST_BURST", "Fast Burst",
+                             OPTIONS_TAB, IP_RW, 0, IPS_IDLE);
+
     /**********************************************/
     /**************** Web Socket ******************/
     /**********************************************/
@@ -470,6 +787,20 @@ bool CCD::initProperties()
                              OPTIONS_TAB, IP_RW,
                              60, IPS_IDLE);
 
+    /**********************************************/
+    /**************** HTTP BLOBs *******************/
+    /**********************************************/
+    HttpBlobSP[HTTP_BLOB_ENABLED].fill("HTTP_BLOB_ENABLED", "Enabled", ISS_OFF);
+    HttpBlobSP[HTTP_BLOB_DISABLED].fill("HTTP_BLOB_DISABLED", "Disabled", ISS_ON);
+    HttpBlobSP.fill(getDeviceName(), "CCD_HTTP_BLOB", "HTTP BLOBs", OPTIONS_TAB,
+                    IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    // Port 0 listens on any free port, the one chosen is then reported
+    HttpBlobSettingsNP[HTTP_BLOB_PORT].fill("HTTP_BLOB_PORT", "Port", "%.f", 0, 65535, 1, 0);
+    HttpBlobSettingsNP[HTTP_BLOB_KEEP].fill("HTTP_BLOB_KEEP", "Keep", "%.f", 1, 100, 1, 4);
+    HttpBlobSettingsNP.fill(getDeviceName(), "CCD_HTTP_BLOB_SETTINGS", "HTTP Settings",
+                            OPTIONS_TAB, IP_RW, 60, IPS_IDLE);
+
     /**********************************************/
     /**************** Snooping ********************/
     /**********************************************/
@@ -510,29 +841,7 @@ bool CCD::initProperties()
                    60, IPS_IDLE);
 
     // Snoop properties of interest
-
-    // Snoop mount
-    IDSnoopDevice(mount, "EQUATORIAL_EOD_COORD");
-    IDSnoopDevice(mount, "EQUATORIAL_COORD");
-    IDSnoopDevice(mount, "TELESCOPE_INFO");
-    IDSnoopDevice(mount, "GEOGRAPHIC_COORD");
-    IDSnoopDevice(mount, "TELESCOPE_PIER_SIDE");
-
-    // Snoop Rotator
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_ROTATOR].getText(), "ABS_ROTATOR_ANGLE");
-
-    // JJ ed 2019-12-10
-    // Snoop Focuser
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "ABS_FOCUS_POSITION");
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "FOCUS_TEMPERATURE");
-    //
-
-    // Snoop Filter Wheel
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_SLOT");
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_NAME");
-
-    // Snoop Sky Quality Meter
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_SKYQUALITY].getText(), "SKY_QUALITY");
+    watchActiveDevices();
 
     // Guider Interface
     GI::initProperties(GUIDE_CONTROL_TAB);
@@ -610,7 +919,23 @@ bool CCD::updateProperties()
                 defineProperty(GuideCCD.ImageBinNP);
         }
         defineProperty(PrimaryCCD.CompressSP);
+        defineProperty(CompressionCodecSP);
+        defineProperty(CompressionLevelNP);
         defineProperty(PrimaryCCD.FitsBP);
+        defineProperty(PreviewSP);
+        defineProperty(PreviewSettingsNP);
+        defineProperty(PreviewBP);
+        defineProperty(StarAnalysisSP);
+        defineProperty(StarMetricsNP);
+        defineProperty(CalibrationSP);
+        defineProperty(CalibrationTP);
+        defineProperty(CalibrationSettingsNP);
+        if (CanSubFrame() || HasGuideHead())
+        {
+            defineProperty(GuideROISP);
+            defineProperty(GuideROINP);
+            defineProperty(GuideROIFullFrameSP);
+        }
         if (HasGuideHead())
         {
             defineProperty(GuideCCD.CompressSP);
@@ -659,8 +984,13 @@ bool CCD::updateProperties()
             defineProperty(WebSocketSP);
 #endif
 
+        defineProperty(HttpBlobSP);
+        defineProperty(HttpBlobSettingsNP);
+
         defineProperty(FastExposureToggleSP);
         defineProperty(FastExposureCountNP);
+        if (m_UploadPipeline)
+            defineProperty(FastExposureBurstNP);
     }
     else
     {
@@ -681,6 +1011,22 @@ bool CCD::updateProperties()
             deleteProperty(PrimaryCCD.AbortExposureSP);
         deleteProperty(PrimaryCCD.FitsBP);
         deleteProperty(PrimaryCCD.CompressSP);
+        deleteProperty(CompressionCodecSP);
+        deleteProperty(CompressionLevelNP);
+        deleteProperty(PreviewSP);
+        deleteProperty(PreviewSettingsNP);
+        deleteProperty(PreviewBP);
+        deleteProperty(StarAnalysisSP);
+        deleteProperty(StarMetricsNP);
+        deleteProperty(CalibrationSP);
+        deleteProperty(CalibrationTP);
+        deleteProperty(CalibrationSettingsNP);
+        if (CanSubFrame() || HasGuideHead())
+        {
+            deleteProperty(GuideROISP);
+            deleteProperty(GuideROINP);
+            deleteProperty(GuideROIFullFrameSP);
+        }
 
 #if 0
         deleteProperty(PrimaryCCD.RapidGuideSP.name);
@@ -745,8 +1091,18 @@ bool CCD::updateProperties()
             deleteProperty(WebSocketSettingsNP);
         }
 #endif
+
+        m_BlobHttpServer.stop();
+        HttpBlobSP.reset();
+        HttpBlobSP[HTTP_BLOB_DISABLED].setState(ISS_ON);
+        HttpBlobSP.setState(IPS_IDLE);
+        deleteProperty(HttpBlobSP);
+        deleteProperty(HttpBlobSettingsNP);
+
         deleteProperty(FastExposureToggleSP);
         deleteProperty(FastExposureCountNP);
+        if (m_UploadPipeline)
+            deleteProperty(FastExposureBurstNP);
     }
 
     // Streamer
@@ -763,162 +1119,154 @@ bool CCD::updateProperties()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-bool CCD::ISSnoopDevice(XMLEle * root)
+// Value of the element name of a snooped vector, or nullptr
+static const char *snoopedElement(XMLEle * root, const char * name)
+{
+    for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+    {
+        if (!strcmp(findXMLAttValu(ep, "name"), name))
+            return pcdataXMLEle(ep);
+    }
+    return nullptr;
+}
+
+void CCD::watchActiveDevices()
 {
-    XMLEle * ep           = nullptr;
-    auto propName = findXMLAttValu(root, "name");
-    auto deviceName = std::string(findXMLAttValu(root, "device"));
+    for (auto &watched : m_SnoopedProperties)
+        unwatchSnoop(watched.first.c_str(), watched.second.c_str());
+    m_SnoopedProperties.clear();
+    m_LatestSnoopedProperties.clear();
 
-    if ((EqNP.snoop(root)))
+    auto watch = [this](const char * device, const char * property, const std::function<bool (XMLEle *)> &handler)
+    {
+        if (device == nullptr || device[0] == '\0')
+            return;
+        watchSnoop(device, property, handler);
+        m_SnoopedProperties.emplace_back(device, property);
+    };
+
+    // Values only stamped on frames are pulled when an exposure starts, and otherwise sent on significant changes
+    auto watchLatest = [this](const char * device, const char * property, double threshold,
+                              const std::function<bool (XMLEle *)> &handler)
     {
-        double newra, newdec;
-        newra  = EqNP[Ra].getValue();
-        newdec = EqNP[DEC].getValue();
-        if ((newra != RA) || (newdec != Dec))
+        if (device == nullptr || device[0] == '\0')
+            return;
+        watchSnoopLatest(device, property, threshold, handler);
+        m_SnoopedProperties.emplace_back(device, property);
+        m_LatestSnoopedProperties.emplace_back(device, property);
+    };
+
+    // Mount
+    const char * mount = ActiveDeviceTP[ACTIVE_TELESCOPE].getText();
+    watchLatest(mount, "EQUATORIAL_EOD_COORD", 1.0 / 3600, [this](XMLEle * root)
+    {
+        if (EqNP.snoop(root))
         {
-            //IDLog("RA %4.2f  Dec %4.2f Snooped RA %4.2f  Dec %4.2f\n",RA,Dec,newra,newdec);
-            RA  = newra;
-            Dec = newdec;
+            RA  = EqNP[Ra].getValue();
+            Dec = EqNP[DEC].getValue();
         }
-    }
-    else if (J2000EqNP.snoop(root))
+        return true;
+    });
+    watchLatest(mount, "EQUATORIAL_COORD", 1.0 / 3600, [this](XMLEle * root)
     {
-        float newra, newdec;
-        newra  = J2000EqNP[Ra].getValue();
-        newdec = J2000EqNP[DEC].getValue();
-        if ((newra != J2000RA) || (newdec != J2000DE))
+        if (J2000EqNP.snoop(root))
         {
-            //    	    IDLog("J2000 RA %4.2f  Dec %4.2f Snooped RA %4.2f  Dec %4.2f\n",J2000RA,J2000DE,newra,newdec);
-            J2000RA = newra;
-            J2000DE = newdec;
+            J2000RA = J2000EqNP[Ra].getValue();
+            J2000DE = J2000EqNP[DEC].getValue();
+            J2000Valid = true;
         }
-        J2000Valid = true;
-    }
-    else if (!strcmp("TELESCOPE_PIER_SIDE", propName) && deviceName == ActiveDeviceTP[ACTIVE_TELESCOPE].getText())
+        return true;
+    });
+    watch(mount, "TELESCOPE_PIER_SIDE", [this](XMLEle * root)
     {
         // set default to say we have no valid information from mount
         pierSide = -1;
-        //  crack the message
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * elemName = findXMLAttValu(ep, "name");
-
-            if (!strcmp(elemName, "PIER_EAST") && !strcmp(pcdataXMLEle(ep), "On"))
-                pierSide = 1;
-            else if (!strcmp(elemName, "PIER_WEST") && !strcmp(pcdataXMLEle(ep), "On"))
-                pierSide = 0;
-        }
-    }
+        const char * east = snoopedElement(root, "PIER_EAST");
+        const char * west = snoopedElement(root, "PIER_WEST");
+        if (east && !strcmp(east, "On"))
+            pierSide = 1;
+        else if (west && !strcmp(west, "On"))
+            pierSide = 0;
+        return true;
+    });
     // Deprecated
-    else if (!strcmp(propName, "TELESCOPE_INFO") && deviceName == ActiveDeviceTP[ACTIVE_TELESCOPE].getText())
+    watch(mount, "TELESCOPE_INFO", [this](XMLEle * root)
+    {
+        if (const char * aperture = snoopedElement(root, "TELESCOPE_APERTURE"))
+            snoopedAperture = atof(aperture);
+        if (const char * focalLength = snoopedElement(root, "TELESCOPE_FOCAL_LENGTH"))
+            snoopedFocalLength = atof(focalLength);
+        return true;
+    });
+    watchLatest(mount, "GEOGRAPHIC_COORD", 1.0 / 3600, [this](XMLEle * root)
     {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+        if (const char * longitude = snoopedElement(root, "LONG"))
         {
-            const char * name = findXMLAttValu(ep, "name");
-
-            if (!strcmp(name, "TELESCOPE_APERTURE"))
-            {
-                snoopedAperture = atof(pcdataXMLEle(ep));
-            }
-            else if (!strcmp(name, "TELESCOPE_FOCAL_LENGTH"))
-            {
-                snoopedFocalLength = atof(pcdataXMLEle(ep));
-            }
+            Longitude = atof(longitude);
+            if (Longitude > 180)
+                Longitude -= 360;
         }
-    }
-    else if (!strcmp(propName, "FILTER_NAME") && deviceName == ActiveDeviceTP[ACTIVE_FILTER].getText())
+        if (const char * latitude = snoopedElement(root, "LAT"))
+            Latitude = atof(latitude);
+        return true;
+    });
+
+    // Rotator
+    watchLatest(ActiveDeviceTP[ACTIVE_ROTATOR].getText(), "ABS_ROTATOR_ANGLE", 0.01, [this](XMLEle * root)
     {
-        LOG_DEBUG("SNOOP: FILTER_NAME update...");
-        FilterNames.clear();
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-            FilterNames.push_back(pcdataXMLEle(ep));
-        LOGF_DEBUG("SNOOP: FILTER_NAME -> %s", join(FilterNames, ", ").c_str());
+        if (const char * angle = snoopedElement(root, "ANGLE"))
+            RotatorAngle = atof(angle);
+        return true;
+    });
 
-    }
-    else if (!strcmp(propName, "FILTER_SLOT") && deviceName == ActiveDeviceTP[ACTIVE_FILTER].getText())
+    // JJ ed 2019-12-10
+    // Focuser
+    watchLatest(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "ABS_FOCUS_POSITION", 0, [this](XMLEle * root)
+    {
+        if (const char * position = snoopedElement(root, "FOCUS_ABSOLUTE_POSITION"))
+            FocuserPos = atol(position);
+        return true;
+    });
+    watchLatest(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "FOCUS_TEMPERATURE", 0.1, [this](XMLEle * root)
+    {
+        if (const char * temperature = snoopedElement(root, "TEMPERATURE"))
+            FocuserTemp = atof(temperature);
+        return true;
+    });
+
+    // Filter Wheel
+    watch(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_SLOT", [this](XMLEle * root)
     {
         LOG_DEBUG("SNOOP: FILTER_SLOT update...");
         CurrentFilterSlot = -1;
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+        for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
             CurrentFilterSlot = atoi(pcdataXMLEle(ep));
         LOGF_DEBUG("SNOOP: FILTER_SLOT is %d", CurrentFilterSlot);
-    }
-    else if (!strcmp(propName, "SKY_QUALITY") && deviceName == ActiveDeviceTP[ACTIVE_SKYQUALITY].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
-
-            if (!strcmp(name, "SKY_BRIGHTNESS"))
-            {
-                MPSAS = atof(pcdataXMLEle(ep));
-                break;
-            }
-        }
-    }
-    else if (!strcmp(propName, "ABS_ROTATOR_ANGLE") && deviceName == ActiveDeviceTP[ACTIVE_ROTATOR].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
-
-            if (!strcmp(name, "ANGLE"))
-            {
-                RotatorAngle = atof(pcdataXMLEle(ep));
-                break;
-            }
-        }
-    }
-
-    // JJ ed 2019-12-10
-    else if (!strcmp(propName, "ABS_FOCUS_POSITION") && deviceName == ActiveDeviceTP[ACTIVE_FOCUSER].getText())
-    {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
-
-            if (!strcmp(name, "FOCUS_ABSOLUTE_POSITION"))
-            {
-                FocuserPos = atol(pcdataXMLEle(ep));
-                break;
-            }
-        }
-    }
-    else if (!strcmp(propName, "FOCUS_TEMPERATURE") && deviceName == ActiveDeviceTP[ACTIVE_FOCUSER].getText())
+        return true;
+    });
+    watch(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_NAME", [this](XMLEle * root)
     {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
-
-            if (!strcmp(name, "TEMPERATURE"))
-            {
-                FocuserTemp = atof(pcdataXMLEle(ep));
-                break;
-            }
-        }
-    }
-    //
+        LOG_DEBUG("SNOOP: FILTER_NAME update...");
+        FilterNames.clear();
+        for (XMLEle * ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+            FilterNames.push_back(pcdataXMLEle(ep));
+        LOGF_DEBUG("SNOOP: FILTER_NAME -> %s", join(FilterNames, ", ").c_str());
+        return true;
+    });
 
-    else if (!strcmp(propName, "GEOGRAPHIC_COORD") && deviceName == ActiveDeviceTP[ACTIVE_TELESCOPE].getText())
+    // Sky Quality Meter
+    watchLatest(ActiveDeviceTP[ACTIVE_SKYQUALITY].getText(), "SKY_QUALITY", 0.01, [this](XMLEle * root)
     {
-        for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-        {
-            const char * name = findXMLAttValu(ep, "name");
-
-            if (!strcmp(name, "LONG"))
-            {
-                Longitude = atof(pcdataXMLEle(ep));
-                if (Longitude > 180)
-                    Longitude -= 360;
-            }
-            else if (!strcmp(name, "LAT"))
-            {
-                Latitude = atof(pcdataXMLEle(ep));
-            }
-        }
-    }
+        if (const char * brightness = snoopedElement(root, "SKY_BRIGHTNESS"))
+            MPSAS = atof(brightness);
+        return true;
+    });
+}
 
-    return DefaultDevice::ISSnoopDevice(root);
+void CCD::requestActiveDevices()
+{
+    for (auto &watched : m_LatestSnoopedProperties)
+        requestSnoop(watched.first.c_str(), watched.second.c_str());
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -944,10 +1292,6 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             if (strlen(ActiveDeviceTP[ACTIVE_TELESCOPE].getText()) > 0)
             {
                 LOGF_DEBUG("Snopping on Mount %s", ActiveDeviceTP[ACTIVE_TELESCOPE].getText());
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_TELESCOPE].getText(), "EQUATORIAL_EOD_COORD");
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_TELESCOPE].getText(), "EQUATORIAL_COORD");
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_TELESCOPE].getText(), "TELESCOPE_INFO");
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_TELESCOPE].getText(), "GEOGRAPHIC_COORD");
             }
             else
             {
@@ -966,7 +1310,6 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             if (strlen(ActiveDeviceTP[ACTIVE_ROTATOR].getText()) > 0)
             {
                 LOGF_DEBUG("Snopping on Rotator %s", ActiveDeviceTP[ACTIVE_ROTATOR].getText());
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_ROTATOR].getText(), "ABS_ROTATOR_ANGLE");
             }
             else
             {
@@ -978,8 +1321,6 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             if (strlen(ActiveDeviceTP[ACTIVE_FOCUSER].getText()) > 0)
             {
                 LOGF_DEBUG("Snopping on Focuser %s", ActiveDeviceTP[ACTIVE_FOCUSER].getText());
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "ABS_FOCUS_POSITION");
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_FOCUSER].getText(), "FOCUS_TEMPERATURE");
             }
             else
             {
@@ -992,8 +1333,6 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             if (strlen(ActiveDeviceTP[ACTIVE_FILTER].getText()) > 0)
             {
                 LOGF_DEBUG("Snopping on Filter Wheel %s", ActiveDeviceTP[ACTIVE_FILTER].getText());
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_SLOT");
-                IDSnoopDevice(ActiveDeviceTP[ACTIVE_FILTER].getText(), "FILTER_NAME");
             }
             else
             {
@@ -1001,7 +1340,7 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
                 CurrentFilterSlot = -1;
             }
 
-            IDSnoopDevice(ActiveDeviceTP[ACTIVE_SKYQUALITY].getText(), "SKY_QUALITY");
+            watchActiveDevices();
 
             // Tell children active devices was updated.
             activeDevicesUpdated();
@@ -1103,6 +1442,22 @@ bool CCD::ISNewText(const char * dev, const char * name, char * texts[], char *
             UploadSettingsTP.apply();
             return true;
         }
+
+        if (CalibrationTP.isNameMatch(name))
+        {
+            CalibrationTP.update(texts, names, n);
+            size_t const masters = m_Calibration.setDirectory(CalibrationTP[0].getText());
+            if (masters > 0)
+                LOGF_INFO("Calibration masters: %zu bias, %zu dark and %zu flat.",
+                          m_Calibration.count(CalibrationCache::MASTER_BIAS), m_Calibration.count(CalibrationCache::MASTER_DARK),
+                          m_Calibration.count(CalibrationCache::MASTER_FLAT));
+            else
+                LOGF_WARN("No calibration masters found in %s.", CalibrationTP[0].getText());
+            CalibrationTP.setState(masters > 0 ? IPS_OK : IPS_ALERT);
+            CalibrationTP.apply();
+            saveConfig(CalibrationTP);
+            return true;
+        }
     }
 
     // Streamer
@@ -1160,6 +1515,8 @@ bool CCD::ISNewNumber(const char * dev, const char * name, double values[], char
                     DEBUG(Logger::DBG_WARNING, "Warning: Aborting exposure failed.");
             }
 
+            applyGuideROI(&PrimaryCCD);
+            requestActiveDevices();
             if (StartExposure(ExposureTime))
             {
                 PrimaryCCD.ImageExposureNP.setState(IPS_BUSY);
@@ -1196,6 +1553,8 @@ bool CCD::ISNewNumber(const char * dev, const char * name, double values[], char
             }
 
             GuideCCD.ImageExposureNP.setState(IPS_BUSY);
+            applyGuideROI(&GuideCCD);
+            requestActiveDevices();
             if (StartGuideExposure(GuiderExposureTime))
                 GuideCCD.ImageExposureNP.setState(IPS_BUSY);
             else
@@ -1394,6 +1753,72 @@ bool CCD::ISNewNumber(const char * dev, const char * name, double values[], char
             return true;
         }
 
+        // Fast Exposure Burst
+        if (FastExposureBurstNP.isNameMatch(name))
+        {
+            FastExposureBurstNP.update(values, names, n);
+            FastExposureBurstNP.setState(IPS_OK);
+            FastExposureBurstNP.apply();
+            saveConfig(FastExposureBurstNP);
+            return true;
+        }
+
+        // Compression Level
+        if (CompressionLevelNP.isNameMatch(name))
+        {
+            CompressionLevelNP.update(values, names, n);
+            CompressionLevelNP.setState(IPS_OK);
+            CompressionLevelNP.apply();
+            saveConfig(CompressionLevelNP);
+            return true;
+        }
+
+        // HTTP BLOB Settings, a new port applies the next time the server is enabled
+        if (HttpBlobSettingsNP.isNameMatch(name))
+        {
+            HttpBlobSettingsNP.update(values, names, n);
+            m_BlobHttpServer.setCapacity(static_cast<size_t>(HttpBlobSettingsNP[HTTP_BLOB_KEEP].getValue()));
+            if (m_BlobHttpServer.isRunning())
+                HttpBlobSettingsNP[HTTP_BLOB_PORT].setValue(m_BlobHttpServer.port());
+            HttpBlobSettingsNP.setState(IPS_OK);
+            HttpBlobSettingsNP.apply();
+            saveConfig(HttpBlobSettingsNP);
+            return true;
+        }
+
+        // Preview Settings
+        if (CalibrationSettingsNP.isNameMatch(name))
+        {
+            CalibrationSettingsNP.update(values, names, n);
+            m_Calibration.setTemperatureTolerance(CalibrationSettingsNP[CALIBRATION_TEMPERATURE_TOLERANCE].getValue());
+            CalibrationSettingsNP.setState(IPS_OK);
+            CalibrationSettingsNP.apply();
+            saveConfig(CalibrationSettingsNP);
+            return true;
+        }
+
+        if (GuideROINP.isNameMatch(name))
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_GuideROILock);
+                GuideROINP.update(values, names, n);
+                GuideROINP.setState(IPS_OK);
+                GuideROINP.apply();
+            }
+            applyGuideROIStream();
+            saveConfig(GuideROINP);
+            return true;
+        }
+
+        if (PreviewSettingsNP.isNameMatch(name))
+        {
+            PreviewSettingsNP.update(values, names, n);
+            PreviewSettingsNP.setState(IPS_OK);
+            PreviewSettingsNP.apply();
+            saveConfig(PreviewSettingsNP);
+            return true;
+        }
+
         // CCD TEMPERATURE
         if (TemperatureNP.isNameMatch(name))
         {
@@ -1617,6 +2042,37 @@ bool CCD::ISNewSwitch(const char * dev, const char * name, ISState * states, cha
         }
 #endif
 
+        // HTTP BLOB Enable/Disable
+        if (HttpBlobSP.isNameMatch(name))
+        {
+            HttpBlobSP.update(states, names, n);
+            HttpBlobSP.setState(IPS_OK);
+
+            if (HttpBlobSP[HTTP_BLOB_ENABLED].getState() == ISS_ON)
+            {
+                m_BlobHttpServer.setCapacity(static_cast<size_t>(HttpBlobSettingsNP[HTTP_BLOB_KEEP].getValue()));
+                if (m_BlobHttpServer.start(static_cast<uint16_t>(HttpBlobSettingsNP[HTTP_BLOB_PORT].getValue())))
+                {
+                    HttpBlobSettingsNP[HTTP_BLOB_PORT].setValue(m_BlobHttpServer.port());
+                    HttpBlobSettingsNP.setState(IPS_OK);
+                    HttpBlobSettingsNP.apply();
+                    LOGF_INFO("Serving BLOBs on %s", m_BlobHttpServer.url("/blob/").c_str());
+                }
+                else
+                {
+                    LOGF_ERROR("Failed to listen for HTTP BLOBs on port %.f.", HttpBlobSettingsNP[HTTP_BLOB_PORT].getValue());
+                    HttpBlobSP.reset();
+                    HttpBlobSP[HTTP_BLOB_DISABLED].setState(ISS_ON);
+                    HttpBlobSP.setState(IPS_ALERT);
+                }
+            }
+            else
+                m_BlobHttpServer.stop();
+
+            HttpBlobSP.apply();
+            return true;
+        }
+
         // WCS Enable/Disable
         if (WorldCoordSP.isNameMatch(name))
         {
@@ -1729,20 +2185,106 @@ bool CCD::ISNewSwitch(const char * dev, const char * name, ISState * states, cha
             return true;
         }
 
-        // Primary Chip Frame Type
-        if (PrimaryCCD.FrameTypeSP.isNameMatch(name))
+        // Compression Codec
+        if (CompressionCodecSP.isNameMatch(name))
         {
-            PrimaryCCD.FrameTypeSP.update(states, names, n);
-            PrimaryCCD.FrameTypeSP.setState(IPS_OK);
-            if (PrimaryCCD.FrameTypeSP[CCDChip::LIGHT_FRAME].getState() == ISS_ON)
-                PrimaryCCD.setFrameType(CCDChip::LIGHT_FRAME);
-            else if (PrimaryCCD.FrameTypeSP[CCDChip::BIAS_FRAME].getState() == ISS_ON)
-            {
-                PrimaryCCD.setFrameType(CCDChip::BIAS_FRAME);
-                if (HasShutter() == false)
-                    DEBUG(Logger::DBG_WARNING,
-                          "The CCD does not have a shutter. Cover the camera in order to take a bias frame.");
-            }
+            CompressionCodecSP.update(states, names, n);
+            CompressionCodecSP.setState(IPS_OK);
+            CompressionCodecSP.apply();
+            saveConfig(CompressionCodecSP);
+            return true;
+        }
+
+        // Preview
+        if (PreviewSP.isNameMatch(name))
+        {
+            PreviewSP.update(states, names, n);
+            PreviewSP.setState(IPS_OK);
+            PreviewSP.apply();
+            saveConfig(PreviewSP);
+            return true;
+        }
+
+        // Star Analysis
+        if (CalibrationSP.isNameMatch(name))
+        {
+            CalibrationSP.update(states, names, n);
+            CalibrationSP.setState(IPS_OK);
+            CalibrationSP.apply();
+            saveConfig(CalibrationSP);
+            return true;
+        }
+
+        if (GuideROISP.isNameMatch(name))
+        {
+            CCDChip *targetChip = guideROIChip();
+            bool const wasOff = GuideROISP[GUIDE_ROI_OFF].getState() == ISS_ON;
+            GuideROISP.update(states, names, n);
+            bool const isOff = GuideROISP[GUIDE_ROI_OFF].getState() == ISS_ON;
+
+            if (wasOff && !isOff)
+            {
+                // The frame of the client comes back when the mode is turned off
+                m_GuideROIFrame[CCDChip::FRAME_X] = targetChip->getSubX();
+                m_GuideROIFrame[CCDChip::FRAME_Y] = targetChip->getSubY();
+                m_GuideROIFrame[CCDChip::FRAME_W] = targetChip->getSubW();
+                m_GuideROIFrame[CCDChip::FRAME_H] = targetChip->getSubH();
+
+                std::lock_guard<std::mutex> lock(m_GuideROILock);
+                if (GuideROINP[GUIDE_ROI_X].getValue() == 0 && GuideROINP[GUIDE_ROI_Y].getValue() == 0)
+                {
+                    GuideROINP[GUIDE_ROI_X].setValue(targetChip->getXRes() / 2.0);
+                    GuideROINP[GUIDE_ROI_Y].setValue(targetChip->getYRes() / 2.0);
+                    GuideROINP.apply();
+                }
+            }
+
+            GuideROISP.setState(IPS_OK);
+            if (!wasOff && isOff && m_GuideROIFrame[CCDChip::FRAME_W] > 0 &&
+                    !updateChipFrame(targetChip, m_GuideROIFrame[CCDChip::FRAME_X], m_GuideROIFrame[CCDChip::FRAME_Y],
+                                     m_GuideROIFrame[CCDChip::FRAME_W], m_GuideROIFrame[CCDChip::FRAME_H]))
+            {
+                LOG_WARN("Failed to restore the frame used before the guide ROI.");
+                GuideROISP.setState(IPS_ALERT);
+            }
+            GuideROISP.apply();
+            applyGuideROIStream();
+            return true;
+        }
+
+        if (GuideROIFullFrameSP.isNameMatch(name))
+        {
+            GuideROIFullFrameSP.update(states, names, n);
+            std::lock_guard<std::mutex> lock(m_GuideROILock);
+            m_GuideROIFullFrame = GuideROIFullFrameSP[0].getState() == ISS_ON;
+            GuideROIFullFrameSP.setState(m_GuideROIFullFrame ? IPS_BUSY : IPS_IDLE);
+            GuideROIFullFrameSP.apply();
+            return true;
+        }
+
+        if (StarAnalysisSP.isNameMatch(name))
+        {
+            StarAnalysisSP.update(states, names, n);
+            StarAnalysisSP.setState(IPS_OK);
+            StarAnalysisSP.apply();
+            saveConfig(StarAnalysisSP);
+            return true;
+        }
+
+        // Primary Chip Frame Type
+        if (PrimaryCCD.FrameTypeSP.isNameMatch(name))
+        {
+            PrimaryCCD.FrameTypeSP.update(states, names, n);
+            PrimaryCCD.FrameTypeSP.setState(IPS_OK);
+            if (PrimaryCCD.FrameTypeSP[CCDChip::LIGHT_FRAME].getState() == ISS_ON)
+                PrimaryCCD.setFrameType(CCDChip::LIGHT_FRAME);
+            else if (PrimaryCCD.FrameTypeSP[CCDChip::BIAS_FRAME].getState() == ISS_ON)
+            {
+                PrimaryCCD.setFrameType(CCDChip::BIAS_FRAME);
+                if (HasShutter() == false)
+                    DEBUG(Logger::DBG_WARNING,
+                          "The CCD does not have a shutter. Cover the camera in order to take a bias frame.");
+            }
             else if (PrimaryCCD.FrameTypeSP[CCDChip::DARK_FRAME].getState() == ISS_ON)
             {
                 PrimaryCCD.setFrameType(CCDChip::DARK_FRAME);
@@ -2090,10 +2632,10 @@ void CCD::addFITSKeywords(CCDChip * targetChip, std::vector<FITSRecord> &fitsKey
 
     strncpy(dev_name, getDeviceName(), MAXINDINAME);
 
-    fitsKeywords.push_back({"EXPTIME", exposureDuration, 6, "Total Exposure Time (s)"});
+    fitsKeywords.push_back({"EXPTIME", targetChip->UploadFrame.duration, 6, "Total Exposure Time (s)"});
 
     if (targetChip->getFrameType() == CCDChip::DARK_FRAME)
-        fitsKeywords.push_back({"DARKTIME", exposureDuration, 6, "Total Dark Exposure Time (s)"});
+        fitsKeywords.push_back({"DARKTIME", targetChip->UploadFrame.duration, 6, "Total Dark Exposure Time (s)"});
 
     // If the camera has a cooler OR if the temperature permission was explicitly set to Read-Only, then record the temperature
     if (HasCooler() || TemperatureNP.getPermission() == IP_RO)
@@ -2331,7 +2873,7 @@ void CCD::addFITSKeywords(CCDChip * targetChip, std::vector<FITSRecord> &fitsKey
         }
     }
 
-    fitsKeywords.push_back({"DATE-OBS", exposureStartTime, "UTC start date of observation"});
+    fitsKeywords.push_back({"DATE-OBS", targetChip->UploadFrame.startTime.c_str(), "UTC start date of observation"});
     fitsKeywords.push_back(FITSRecord("Generated by INDI"));
 }
 
@@ -2353,40 +2895,137 @@ bool CCD::ExposureComplete(CCDChip * targetChip)
     // Reset POLLMS to default value
     setCurrentPollingPeriod(getPollingPeriod());
 
-    // Run async
-    std::thread(&CCD::ExposureCompletePrivate, this, targetChip).detach();
+    if (m_UploadPipeline)
+    {
+        // In a burst the next exposure starts now, the frame waits in the ring until it is uploaded.
+        // The ring is kept from one burst to the next.
+        bool const burst = isBursting(targetChip);
+        size_t const ringSize = targetChip == &PrimaryCCD ? std::max(1.0, FastExposureBurstNP[0].getValue()) : 1;
+        bool startUpload = false;
+        if (targetChip->queueUploadFrame(ringSize, burst, startUpload))
+        {
+            if (startUpload)
+                queueUpload(targetChip, [this, targetChip] { uploadQueuedFrames(targetChip); });
+            if (burst)
+                ThreadPool::global().submit([this, targetChip] { return processFastExposure(targetChip); });
+            return true;
+        }
+
+        // No free frame for it, upload this one from the raw frame once the others are done
+        targetChip->waitForUploads();
+    }
+
+    // The range binning found and the exposure belong to the frame to upload, which the worker of the chip takes
+    // once the uploads before it are done
+    CCDChip::RingFrame exposure;
+    targetChip->takeExposure(exposure);
+
+    queueUpload(targetChip, [this, targetChip, exposure]
+    {
+        targetChip->UploadFromSpare = false;
+        targetChip->UploadFrame = exposure;
+        targetChip->UploadRangeValid = exposure.rangeValid;
+        targetChip->UploadRangeMin = exposure.rangeMin;
+        targetChip->UploadRangeMax = exposure.rangeMax;
+        ExposureCompletePrivate(targetChip);
+    });
 
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::queueUpload(CCDChip * targetChip, const std::function<void()> &upload)
+{
+    // Each chip uploads on a worker of its own, guide frames never wait behind primary frames.
+    // What the guide chip sends goes out ahead of the messages queued by the other chip.
+    if (!targetChip->Uploader)
+        targetChip->Uploader.reset(new TaskQueue);
+
+    bool const urgent = targetChip == &GuideCCD;
+    targetChip->Uploader->post([upload, urgent]
+    {
+        if (urgent)
+            IDPriorityBegin();
+        upload();
+        if (urgent)
+            IDPriorityEnd();
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::uploadQueuedFrames(CCDChip * targetChip)
+{
+    while (targetChip->nextUploadFrame())
+        ExposureCompletePrivate(targetChip);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool CCD::isBursting(CCDChip * targetChip)
+{
+    return m_UploadPipeline && targetChip == &PrimaryCCD && FastExposureBurstNP[0].getValue() > 0 &&
+           FastExposureToggleSP[INDI_ENABLED].getState() == ISS_ON && FastExposureCountNP[0].getValue() > 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+std::unique_lock<std::mutex> CCD::lockUploadFrame(CCDChip * targetChip)
+{
+    // The driver does not write the spare frame, only the raw frame needs the lock
+    if (targetChip->UploadFromSpare)
+        return std::unique_lock<std::mutex>(ccdBufferLock, std::defer_lock);
+    return std::unique_lock<std::mutex>(ccdBufferLock);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
 {
+    INDI_TRACE_SCOPE("ExposureCompletePrivate");
     LOG_DEBUG("Exposure complete");
 
-    // save information used for the fits header
-    exposureDuration = targetChip->getExposureDuration();
-    strncpy(exposureStartTime, targetChip->getExposureStartTime(), MAXINDINAME);
+    // save information used for the fits header, that of the exposure of the frame when it was read out.
+    // The header itself is written from the frame, the other chip may be uploading at the same time.
+    exposureDuration = targetChip->UploadFrame.duration;
+    strncpy(exposureStartTime, targetChip->UploadFrame.startTime.c_str(), MAXINDINAME);
 
     if(HasDSP())
     {
-        uint8_t* buf = static_cast<uint8_t*>(malloc(targetChip->getFrameBufferSize()));
-        memcpy(buf, targetChip->getFrameBuffer(), targetChip->getFrameBufferSize());
+        uint8_t* buf = static_cast<uint8_t*>(malloc(targetChip->getUploadFrameSize()));
+        memcpy(buf, targetChip->getUploadFrame(), targetChip->getUploadFrameSize());
         DSP->processBLOB(buf, 2, new int[2] { targetChip->getXRes() / targetChip->getBinX(), targetChip->getYRes() / targetChip->getBinY() },
                          targetChip->getBPP());
         free(buf);
     }
 
-    if (processFastExposure(targetChip) == false)
+    // Before the next exposure of a fast exposure loop is set up
+    if (GuideROISP[GUIDE_ROI_TRACK].getState() == ISS_ON && targetChip == guideROIChip() &&
+            targetChip->getUploadFrameSize() > 0)
+        trackGuideROI(targetChip);
+
+    // Bursts started the next exposure already
+    bool const restarted = targetChip->UploadFromSpare && targetChip->UploadFrame.restarted;
+    if (!restarted && processFastExposure(targetChip) == false)
         return false;
 
+    if (targetChip == &PrimaryCCD && PreviewSP[INDI_ENABLED].getState() == ISS_ON && targetChip->getUploadFrameSize() > 0)
+        uploadPreview(targetChip);
+
+    if (targetChip == &PrimaryCCD && StarAnalysisSP[INDI_ENABLED].getState() == ISS_ON && targetChip->getUploadFrameSize() > 0)
+        publishStarMetrics(targetChip);
+
     bool sendImage = (UploadSP[UPLOAD_CLIENT].getState() == ISS_ON || UploadSP[UPLOAD_BOTH].getState() == ISS_ON);
     bool saveImage = (UploadSP[UPLOAD_LOCAL].getState() == ISS_ON || UploadSP[UPLOAD_BOTH].getState() == ISS_ON);
 
     // Do not send or save an empty image.
-    if (targetChip->getFrameBufferSize() == 0)
+    if (targetChip->getUploadFrameSize() == 0)
         sendImage = saveImage = false;
 
     if (sendImage || saveImage)
@@ -2395,39 +3034,13 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
         {
             targetChip->setImageExtension("fits");
 
-            int img_type  = 0;
-            int byte_type = 0;
-            int status    = 0;
             long naxis    = targetChip->getNAxis();
             long naxes[3];
-            int nelements = 0;
-            char error_status[MAXRBUF];
+            size_t nelements = 0;
 
             naxes[0] = targetChip->getSubW() / targetChip->getBinX();
             naxes[1] = targetChip->getSubH() / targetChip->getBinY();
 
-            switch (targetChip->getBPP())
-            {
-                case 8:
-                    byte_type = TBYTE;
-                    img_type  = BYTE_IMG;
-                    break;
-
-                case 16:
-                    byte_type = TUSHORT;
-                    img_type  = USHORT_IMG;
-                    break;
-
-                case 32:
-                    byte_type = TULONG;
-                    img_type  = ULONG_IMG;
-                    break;
-
-                default:
-                    LOGF_ERROR("Unsupported bits per pixel value %d", targetChip->getBPP());
-                    return false;
-            }
-
             nelements = naxes[0] * naxes[1];
             if (naxis == 3)
             {
@@ -2435,34 +3048,7 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
                 naxes[2] = 3;
             }
 
-            /*DEBUGF(Logger::DBG_DEBUG, "Exposure complete. Image Depth: %s. Width: %d Height: %d nelements: %d", bit_depth.c_str(), naxes[0],
-                    naxes[1], nelements);*/
-
-            std::unique_lock<std::mutex> guard(ccdBufferLock);
-
-            // 8640 = 2880 * 3 which is sufficient for most cases.
-            uint32_t size = 8640 + nelements * (targetChip->getBPP() / 8);
-            //  Initialize FITS file.
-            if (targetChip->openFITSFile(size, status) == false)
-            {
-                fits_report_error(stderr, status); /* print out any error messages */
-                fits_get_errstatus(status, error_status);
-                LOGF_ERROR("FITS Error: %s", error_status);
-                return false;
-            }
-
-            auto fptr = *targetChip->fitsFilePointer();
-
-            fits_create_img(fptr, img_type, naxis, naxes, &status);
-
-            if (status)
-            {
-                fits_report_error(stderr, status); /* print out any error messages */
-                fits_get_errstatus(status, error_status);
-                LOGF_ERROR("FITS Error: %s", error_status);
-                targetChip->closeFITSFile();
-                return false;
-            }
+            std::unique_lock<std::mutex> guard = lockUploadFrame(targetChip);
 
             std::vector<FITSRecord> fitsKeywords;
 
@@ -2472,52 +3058,37 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
             for (auto &record : m_CustomFITSKeywords)
                 fitsKeywords.push_back(record.second);
 
-            for (auto &keyword : fitsKeywords)
+            std::vector<std::string> rejected;
+            const std::string &header = targetChip->m_FITSHeader.make(targetChip->getBPP(), naxis, naxes, fitsKeywords,
+                                        &rejected);
+            if (header.empty())
             {
-                int key_status = 0;
-                switch(keyword.type())
-                {
-                    case INDI::FITSRecord::VOID:
-                        break;
-                    case INDI::FITSRecord::COMMENT:
-                        fits_write_comment(fptr, keyword.comment().c_str(), &key_status);
-                        break;
-                    case INDI::FITSRecord::STRING:
-                        fits_update_key_str(fptr, keyword.key().c_str(), keyword.valueString().c_str(), keyword.comment().c_str(), &key_status);
-                        break;
-                    case INDI::FITSRecord::LONGLONG:
-                        fits_update_key_lng(fptr, keyword.key().c_str(), keyword.valueInt(), keyword.comment().c_str(), &key_status);
-                        break;
-                    case INDI::FITSRecord::DOUBLE:
-                        fits_update_key_dbl(fptr, keyword.key().c_str(), keyword.valueDouble(), keyword.decimal(), keyword.comment().c_str(),
-                                            &key_status);
-                        break;
-                }
-                if (key_status)
-                {
-                    fits_get_errstatus(key_status, error_status);
-                    LOGF_ERROR("FITS key %s Error: %s", keyword.key().c_str(), error_status);
-                }
+                LOGF_ERROR("Unsupported bits per pixel value %d", targetChip->getBPP());
+                return false;
             }
 
-            fits_write_img(fptr, byte_type, 1, nelements, targetChip->getFrameBuffer(), &status);
-            targetChip->finishFITSFile(status);
-            if (status)
+            for (auto &key : rejected)
+                LOGF_ERROR("FITS key %s Error: invalid keyword or value", key.c_str());
+
+            // The header and the big endian data are written straight into the BLOB, without a cfitsio memory file
+            size_t size = header.size() + getFITSDataSize(nelements, targetChip->getBPP());
+            if (targetChip->openFITSBlock(size) == false)
             {
-                fits_report_error(stderr, status); /* print out any error messages */
-                fits_get_errstatus(status, error_status);
-                LOGF_ERROR("FITS Error: %s", error_status);
-                targetChip->closeFITSFile();
+                LOG_ERROR("FITS Error: failed to allocate memory for the FITS file.");
                 return false;
             }
 
+            auto block = static_cast<uint8_t *>(*targetChip->fitsMemoryBlockPointer());
+            memcpy(block, header.data(), header.size());
+            writeFITSData(block + header.size(), targetChip->getUploadFrame(), nelements, targetChip->getBPP());
 
             bool rc = uploadFile(targetChip, *(targetChip->fitsMemoryBlockPointer()), *(targetChip->fitsMemorySizePointer()), sendImage,
                                  saveImage);
 
             targetChip->closeFITSFile();
 
-            guard.unlock();
+            if (guard)
+                guard.unlock();
 
             if (rc == false)
             {
@@ -2596,13 +3167,41 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
                     image.setColorSpace(LibXISF::Image::RGB);
                 }
 
-                std::unique_lock<std::mutex> guard(ccdBufferLock);
-                std::memcpy(image.imageData(), targetChip->getFrameBuffer(), image.imageDataSize());
+                // Only the copy of the frame needs the lock, compression works on the copy
+                {
+                    std::unique_lock<std::mutex> guard = lockUploadFrame(targetChip);
+                    auto *dst = static_cast<uint8_t *>(image.imageData());
+                    const uint8_t *src = targetChip->getUploadFrame();
+                    size_t const size = image.imageDataSize();
+                    if (size < XISF_PARALLEL_BYTES)
+                        std::memcpy(dst, src, size);
+                    else
+                        ThreadPool::global().parallelFor(0, (size + CHUNK_BYTES - 1) / CHUNK_BYTES, [&](size_t chunk)
+                        {
+                            size_t const offset = chunk * CHUNK_BYTES;
+                            std::memcpy(dst + offset, src + offset, std::min(CHUNK_BYTES, size - offset));
+                        });
+                }
                 xisfWriter.writeImage(image);
 
-                LibXISF::ByteArray xisfFile;
-                xisfWriter.save(xisfFile);
-                bool rc = uploadFile(targetChip, xisfFile.data(), xisfFile.size(), sendImage, saveImage);
+                // The header and the image, compressed or not, rarely take more than the raw frame and 64 KiB
+                BufferPool::Buffer xisfFile = m_BufferPool.acquire(image.imageDataSize() + (64 << 10));
+                if (xisfFile.empty())
+                {
+                    LOG_ERROR("Error: Ran out of memory encoding XISF image");
+                    targetChip->setExposureFailed();
+                    return false;
+                }
+                PooledStreamBuffer output(xisfFile);
+                std::ostream stream(&output);
+                xisfWriter.save(stream);
+                if (!stream)
+                {
+                    LOG_ERROR("Error: Ran out of memory encoding XISF image");
+                    targetChip->setExposureFailed();
+                    return false;
+                }
+                bool rc = uploadFile(targetChip, xisfFile.data(), output.size(), sendImage, saveImage);
                 if (rc == false)
                 {
                     targetChip->setExposureFailed();
@@ -2621,10 +3220,11 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
             // If image extension was set to fits (default), change if bin if not already set to another format by the driver.
             if (!strcmp(targetChip->getImageExtension(), "fits"))
                 targetChip->setImageExtension("bin");
-            std::unique_lock<std::mutex> guard(ccdBufferLock);
-            bool rc = uploadFile(targetChip, targetChip->getFrameBuffer(), targetChip->getFrameBufferSize(), sendImage,
+            std::unique_lock<std::mutex> guard = lockUploadFrame(targetChip);
+            bool rc = uploadFile(targetChip, targetChip->getUploadFrame(), targetChip->getUploadFrameSize(), sendImage,
                                  saveImage);
-            guard.unlock();
+            if (guard)
+                guard.unlock();
 
             if (rc == false)
             {
@@ -2647,7 +3247,10 @@ bool CCD::ExposureCompletePrivate(CCDChip * targetChip)
 bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBytes, bool sendImage,
                      bool saveImage)
 {
-    uint8_t * compressedData = nullptr;
+    INDI_TRACE_SCOPE("uploadFile");
+    uint8_t * packedData = nullptr;
+    BufferPool::Buffer compressedData;
+    std::string imageFileName;
 
     DEBUGF(Logger::DBG_DEBUG, "Uploading file. Ext: %s, Size: %d, sendImage? %s, saveImage? %s",
            targetChip->getImageExtension(), totalBytes, sendImage ? "Yes" : "No", saveImage ? "Yes" : "No");
@@ -2658,8 +3261,6 @@ bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBy
         targetChip->FitsBP[0].setBlobLen(totalBytes);
         std::string format = "." + std::string(targetChip->getImageExtension());
         targetChip->FitsBP[0].setFormat(format);
-        FILE * fp = nullptr;
-
         std::string prefix = UploadSettingsTP[UPLOAD_PREFIX].getText();
         std::string directory = UploadSettingsTP[UPLOAD_DIR].getText();
 
@@ -2697,23 +3298,11 @@ bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBy
             prefix = std::regex_replace(prefix, std::regex("XXX"), prefixIndex);
         }
 
-        std::string imageFileName = std::string(UploadSettingsTP[UPLOAD_DIR].getText()) + "/" + prefix + "/" + std::string(
-                                        targetChip->FitsBP[0].getFormat());
+        imageFileName = std::string(UploadSettingsTP[UPLOAD_DIR].getText()) + "/" + prefix + std::string(
+                            targetChip->FitsBP[0].getFormat());
 
-        fp = fopen(imageFileName.c_str(), "w");
-        if (fp == nullptr)
-        {
-            LOGF_ERROR("Unable to save image file (%s). %s", imageFileName.c_str(), strerror(errno));
+        if (saveImageFile(imageFileName, targetChip->FitsBP[0].getBlob(), targetChip->FitsBP[0].getBlobLen()) == false)
             return false;
-        }
-
-        int n = 0;
-        auto len = targetChip->FitsBP[0].getBlobLen();
-        auto buffer = static_cast<char *>(targetChip->FitsBP[0].getBlob());
-        for (int nr = 0; nr < len; nr += n)
-            n = fwrite(buffer + nr, 1, len - nr, fp);
-
-        fclose(fp);
 
         // Save image file path
         FileNameTP[0].setText(imageFileName);
@@ -2731,44 +3320,30 @@ bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBy
             fp_init (&fpvar);
             size_t compressedBytes = 0;
             int islossless = 0;
-            if (fp_pack_data_to_data(reinterpret_cast<const char *>(fitsData), totalBytes, &compressedData, &compressedBytes, fpvar,
-                                     &islossless) < 0)
+            if (!packFITSTiles(reinterpret_cast<const char *>(fitsData), totalBytes, &packedData, &compressedBytes) &&
+                    fp_pack_data_to_data(reinterpret_cast<const char *>(fitsData), totalBytes, &packedData, &compressedBytes, fpvar,
+                                         &islossless) < 0)
             {
-                free(compressedData);
+                free(packedData);
                 LOG_ERROR("Error: Ran out of memory compressing image");
                 return false;
             }
 
-            targetChip->FitsBP[0].setBlob(compressedData);
+            targetChip->FitsBP[0].setBlob(packedData);
             targetChip->FitsBP[0].setBlobLen(compressedBytes);
             std::string format = "." + std::string(targetChip->getImageExtension()) + ".fz";
             targetChip->FitsBP[0].setFormat(format);
         }
         else
         {
-            uLong compressedBytes = sizeof(char) * totalBytes + totalBytes / 64 + 16 + 3;
-            compressedData  = new uint8_t[compressedBytes];
-
-            if (fitsData == nullptr || compressedData == nullptr)
-            {
-                if (compressedData)
-                    delete [] compressedData;
-                LOG_ERROR("Error: Ran out of memory compressing image");
+            std::string extension;
+            compressedData = compressFrame(fitsData, totalBytes, extension);
+            if (compressedData.empty())
                 return false;
-            }
 
-            int r = compress2(compressedData, &compressedBytes, (const Bytef *)fitsData, totalBytes, 9);
-            if (r != Z_OK)
-            {
-                /* this should NEVER happen */
-                LOG_ERROR("Error: Failed to compress image");
-                delete [] compressedData;
-                return false;
-            }
-
-            targetChip->FitsBP[0].setBlob(compressedData);
-            targetChip->FitsBP[0].setBlobLen(compressedBytes);
-            std::string format = "." + std::string(targetChip->getImageExtension()) + ".z";
+            targetChip->FitsBP[0].setBlob(compressedData.data());
+            targetChip->FitsBP[0].setBlobLen(compressedData.size());
+            std::string format = "." + std::string(targetChip->getImageExtension()) + extension;
             targetChip->FitsBP[0].setFormat(format);
 
         }
@@ -2784,16 +3359,31 @@ bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBy
     targetChip->FitsBP[0].setSize(totalBytes);
     targetChip->FitsBP.setState(IPS_OK);
 
+    // The BLOB then only carries the URL to fetch the image from, the image saved is served from disk
+    std::string blobURL;
+    if (sendImage && m_BlobHttpServer.isRunning())
+    {
+        std::string format = targetChip->FitsBP[0].getFormat();
+        if (!imageFileName.empty() && targetChip->FitsBP[0].getBlob() == fitsData)
+            blobURL = m_BlobHttpServer.url(m_BlobHttpServer.publishFile(imageFileName, format));
+        else
+            blobURL = m_BlobHttpServer.url(m_BlobHttpServer.publish(targetChip->FitsBP[0].getBlob(),
+                                           targetChip->FitsBP[0].getBlobLen(), format));
+
+        targetChip->FitsBP[0].setBlob(const_cast<char *>(blobURL.c_str()));
+        targetChip->FitsBP[0].setBlobLen(blobURL.size());
+        targetChip->FitsBP[0].setFormat(format + ".url");
+    }
+
     if (sendImage)
     {
 #ifdef HAVE_WEBSOCKET
-        if (HasWebSocket() && WebSocketSP[WEBSOCKET_ENABLED].getState() == ISS_ON)
+        if (blobURL.empty() && HasWebSocket() && WebSocketSP[WEBSOCKET_ENABLED].getState() == ISS_ON)
         {
             auto start = std::chrono::high_resolution_clock::now();
 
-            // Send format/size/..etc first later
-            wsServer.send_text(std::string(targetChip->FitsBP[0].getFormat()));
-            wsServer.send_binary(targetChip->FitsBP[0].getBlob(), targetChip->FitsBP[0].getBlobLen());
+            wsServer.send_frame(targetChip->FitsBP[0].getFormat(), targetChip->FitsBP[0].getBlob(),
+                                targetChip->FitsBP[0].getBlobLen());
 
             auto end = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> diff = end - start;
@@ -2810,14 +3400,380 @@ bool CCD::uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBy
         }
     }
 
-    if (compressedData)
-        delete [] compressedData;
+    free(packedData);
 
     DEBUG(Logger::DBG_DEBUG, "Upload complete");
 
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+BufferPool::Buffer CCD::compressFrame(const void * data, size_t size, std::string &extension)
+{
+    auto codec = CompressionCodecSP.findOnSwitch();
+    int level = static_cast<int>(CompressionLevelNP[0].getValue());
+    BufferPool::Buffer compressedData;
+
+    if (data == nullptr)
+    {
+        LOG_ERROR("Error: Ran out of memory compressing image");
+        return BufferPool::Buffer();
+    }
+
+#ifdef HAVE_LZ4
+    if (codec && codec->isNameMatch("CODEC_LZ4"))
+    {
+        // Levels from 3 use the high compression mode
+        LZ4F_preferences_t preferences;
+        memset(&preferences, 0, sizeof(preferences));
+        preferences.frameInfo.contentSize = size;
+        preferences.compressionLevel = std::min(level, LZ4F_compressionLevel_max());
+
+        compressedData = m_BufferPool.acquire(LZ4F_compressFrameBound(size, &preferences));
+        if (compressedData.empty())
+        {
+            LOG_ERROR("Error: Ran out of memory compressing image");
+            return compressedData;
+        }
+
+        size_t r = LZ4F_compressFrame(compressedData.data(), compressedData.size(), data, size, &preferences);
+        if (LZ4F_isError(r))
+        {
+            LOGF_ERROR("Error: Failed to compress image: %s", LZ4F_getErrorName(r));
+            return BufferPool::Buffer();
+        }
+
+        compressedData.resize(r);
+        extension = ".lz4";
+        return compressedData;
+    }
+#endif
+
+#ifdef HAVE_ZSTD
+    if (codec && codec->isNameMatch("CODEC_ZSTD"))
+    {
+        ZSTD_CCtx * context = ZSTD_createCCtx();
+        if (context == nullptr)
+        {
+            LOG_ERROR("Error: Ran out of memory compressing image");
+            return BufferPool::Buffer();
+        }
+
+        ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel,
+                               level == 0 ? ZSTD_CLEVEL_DEFAULT : std::min(level, ZSTD_maxCLevel()));
+        // Fails silently when libzstd is built without threads, which compresses on this thread then
+        ZSTD_CCtx_setParameter(context, ZSTD_c_nbWorkers, static_cast<int>(std::thread::hardware_concurrency()));
+
+        compressedData = m_BufferPool.acquire(ZSTD_compressBound(size));
+        if (compressedData.empty())
+        {
+            ZSTD_freeCCtx(context);
+            LOG_ERROR("Error: Ran out of memory compressing image");
+            return compressedData;
+        }
+
+        size_t r = ZSTD_compress2(context, compressedData.data(), compressedData.size(), data, size);
+        ZSTD_freeCCtx(context);
+        if (ZSTD_isError(r))
+        {
+            LOGF_ERROR("Error: Failed to compress image: %s", ZSTD_getErrorName(r));
+            return BufferPool::Buffer();
+        }
+
+        compressedData.resize(r);
+        extension = ".zst";
+        return compressedData;
+    }
+#endif
+
+    INDI_UNUSED(codec);
+
+    uLong compressedBytes = compressBound(size);
+    compressedData = m_BufferPool.acquire(compressedBytes);
+    if (compressedData.empty())
+    {
+        LOG_ERROR("Error: Ran out of memory compressing image");
+        return compressedData;
+    }
+
+    int r = compress2(compressedData.data(), &compressedBytes, static_cast<const Bytef *>(data), size,
+                      level == 0 ? Z_BEST_COMPRESSION : std::min(level, Z_BEST_COMPRESSION));
+    if (r != Z_OK)
+    {
+        /* this should NEVER happen */
+        LOG_ERROR("Error: Failed to compress image");
+        return BufferPool::Buffer();
+    }
+
+    compressedData.resize(compressedBytes);
+    extension = ".z";
+    return compressedData;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::uploadPreview(CCDChip * targetChip)
+{
+    std::vector<uint8_t> jpeg;
+    {
+        std::unique_lock<std::mutex> guard = lockUploadFrame(targetChip);
+        const void *pixels = targetChip->getUploadFrame();
+        int bpp = targetChip->getBPP();
+
+        std::vector<uint16_t> calibrated;
+        if (CalibrationSP[INDI_ENABLED].getState() == ISS_ON && calibrateFrame(targetChip, calibrated))
+        {
+            pixels = calibrated.data();
+            bpp = 16;
+        }
+
+        // Unbinned mosaics are previewed in color
+        int bayerRed = -1;
+        if (HasBayer() && targetChip->getNAxis() == 2 && targetChip->getBinX() == 1 && targetChip->getBinY() == 1)
+            bayerRed = bayerRedLocation(BayerTP[CFA_TYPE].getText(), atoi(BayerTP[CFA_OFFSET_X].getText()),
+                                        atoi(BayerTP[CFA_OFFSET_Y].getText()));
+
+        if (!encodePreviewJPEG(pixels, targetChip->getSubW() / targetChip->getBinX(),
+                               targetChip->getSubH() / targetChip->getBinY(), bpp, targetChip->getNAxis() == 3 ? 3 : 1,
+                               static_cast<uint32_t>(PreviewSettingsNP[PREVIEW_WIDTH].getValue()),
+                               static_cast<int>(PreviewSettingsNP[PREVIEW_QUALITY].getValue()), jpeg, bayerRed))
+        {
+            LOGF_DEBUG("No preview of frames of %d bits per pixel.", targetChip->getBPP());
+            return;
+        }
+    }
+
+    PreviewBP[0].setBlob(jpeg.data());
+    PreviewBP[0].setBlobLen(jpeg.size());
+    PreviewBP[0].setSize(jpeg.size());
+    PreviewBP[0].setFormat(".jpg");
+    PreviewBP.setState(IPS_OK);
+    PreviewBP.apply();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool CCD::calibrateFrame(CCDChip * targetChip, std::vector<uint16_t> &calibrated)
+{
+    int const bpp = targetChip->getBPP();
+    if (targetChip->getNAxis() != 2 || (bpp != 8 && bpp != 16))
+        return false;
+
+    CalibrationCache::Frame frame;
+    frame.binX = targetChip->getBinX();
+    frame.binY = targetChip->getBinY();
+    frame.x = targetChip->getSubX() / frame.binX;
+    frame.y = targetChip->getSubY() / frame.binY;
+    frame.width = targetChip->getSubW() / frame.binX;
+    frame.height = targetChip->getSubH() / frame.binY;
+    frame.gain = getCalibrationGain();
+    frame.exposure = targetChip->UploadFrame.duration;
+    if (HasCooler() || TemperatureNP.getPermission() == IP_RO)
+        frame.temperature = TemperatureNP[0].getValue();
+
+    size_t const pixels = static_cast<size_t>(frame.width) * frame.height;
+    std::vector<dsp_t> buffer(pixels);
+    if (bpp == 8)
+        std::copy_n(targetChip->getUploadFrame(), pixels, buffer.begin());
+    else
+        std::copy_n(reinterpret_cast<const uint16_t *>(targetChip->getUploadFrame()), pixels, buffer.begin());
+
+    if (!m_Calibration.calibrate(buffer.data(), frame))
+        return false;
+
+    calibrated.resize(pixels);
+    std::transform(buffer.begin(), buffer.end(), calibrated.begin(), [](dsp_t value)
+    {
+        return static_cast<uint16_t>(std::lround(std::max<dsp_t>(0, std::min<dsp_t>(65535, value))));
+    });
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::publishStarMetrics(CCDChip * targetChip)
+{
+    StarMetrics metrics;
+    {
+        std::unique_lock<std::mutex> guard = lockUploadFrame(targetChip);
+        uint32_t const width = targetChip->getSubW() / targetChip->getBinX();
+        uint32_t const height = targetChip->getSubH() / targetChip->getBinY();
+        const uint8_t *frame = targetChip->getUploadFrame();
+
+        // Stars of color frames are measured on the green plane
+        if (targetChip->getNAxis() == 3)
+            frame += static_cast<size_t>(width) * height * (targetChip->getBPP() / 8);
+
+        if (!measureStars(frame, width, height, targetChip->getBPP(), metrics))
+        {
+            LOGF_DEBUG("No star analysis of frames of %d bits per pixel.", targetChip->getBPP());
+            StarMetricsNP.setState(IPS_ALERT);
+            StarMetricsNP.apply();
+            return;
+        }
+    }
+
+    StarMetricsNP[STAR_COUNT].setValue(metrics.stars);
+    StarMetricsNP[STAR_HFR].setValue(metrics.hfr);
+    StarMetricsNP[STAR_FWHM].setValue(metrics.fwhm);
+    StarMetricsNP[STAR_BACKGROUND].setValue(metrics.background);
+    StarMetricsNP[STAR_NOISE].setValue(metrics.noise);
+    StarMetricsNP.setState(IPS_OK);
+    StarMetricsNP.apply();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+CCDChip *CCD::guideROIChip()
+{
+    return HasGuideHead() ? &GuideCCD : &PrimaryCCD;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool CCD::updateChipFrame(CCDChip * targetChip, int x, int y, int w, int h)
+{
+    if (targetChip == &GuideCCD)
+        return UpdateGuiderFrame(x, y, w, h);
+    return UpdateCCDFrame(x, y, w, h);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::applyGuideROI(CCDChip * targetChip)
+{
+    if (targetChip != guideROIChip() || GuideROISP[GUIDE_ROI_OFF].getState() == ISS_ON)
+        return;
+
+    int const xRes = targetChip->getXRes(), yRes = targetChip->getYRes();
+    int const binX = std::max(1, targetChip->getBinX()), binY = std::max(1, targetChip->getBinY());
+    int x = 0, y = 0, w = xRes, h = yRes;
+
+    std::unique_lock<std::mutex> lock(m_GuideROILock);
+    if (m_GuideROIFullFrame)
+    {
+        m_GuideROIFullFrame = false;
+        GuideROIFullFrameSP[0].setState(ISS_OFF);
+        GuideROIFullFrameSP.setState(IPS_OK);
+        GuideROIFullFrameSP.apply();
+    }
+    else
+    {
+        // Whole binned pixels, inside the chip
+        int const size = GuideROINP[GUIDE_ROI_SIZE].getValue();
+        w = std::max(binX, std::min(size, xRes) / binX * binX);
+        h = std::max(binY, std::min(size, yRes) / binY * binY);
+        x = std::lround(GuideROINP[GUIDE_ROI_X].getValue() - w / 2.0);
+        y = std::lround(GuideROINP[GUIDE_ROI_Y].getValue() - h / 2.0);
+        x = std::max(0, std::min(x, xRes - w)) / binX * binX;
+        y = std::max(0, std::min(y, yRes - h)) / binY * binY;
+    }
+    lock.unlock();
+
+    // Drivers reconfigure their readout in their frame handlers, only done when the box moved
+    if (x == targetChip->getSubX() && y == targetChip->getSubY() && w == targetChip->getSubW() && h == targetChip->getSubH())
+        return;
+
+    if (!updateChipFrame(targetChip, x, y, w, h))
+    {
+        LOGF_WARN("Failed to set the guide ROI to (%d,%d) (%d x %d).", x, y, w, h);
+        GuideROISP.setState(IPS_ALERT);
+        GuideROISP.apply();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::trackGuideROI(CCDChip * targetChip)
+{
+    int const binX = std::max(1, targetChip->getBinX()), binY = std::max(1, targetChip->getBinY());
+    uint32_t const width = targetChip->getSubW() / binX;
+    uint32_t const height = targetChip->getSubH() / binY;
+
+    double centerX, centerY, size;
+    {
+        std::lock_guard<std::mutex> lock(m_GuideROILock);
+        centerX = GuideROINP[GUIDE_ROI_X].getValue();
+        centerY = GuideROINP[GUIDE_ROI_Y].getValue();
+        size = GuideROINP[GUIDE_ROI_SIZE].getValue();
+    }
+
+    // The star is searched in the box, also when the frame read was the full one
+    auto toFrame = [](double position, int origin, int bin, uint32_t limit)
+    {
+        return static_cast<uint32_t>(std::max(0.0, std::min<double>(limit, (position - origin) / bin)));
+    };
+    uint32_t const x0 = toFrame(centerX - size / 2, targetChip->getSubX(), binX, width);
+    uint32_t const x1 = toFrame(centerX + size / 2, targetChip->getSubX(), binX, width);
+    uint32_t const y0 = toFrame(centerY - size / 2, targetChip->getSubY(), binY, height);
+    uint32_t const y1 = toFrame(centerY + size / 2, targetChip->getSubY(), binY, height);
+
+    double cx = 0, cy = 0;
+    bool found = false;
+    {
+        std::unique_lock<std::mutex> guard = lockUploadFrame(targetChip);
+        const uint8_t *frame = targetChip->getUploadFrame();
+
+        // Stars of color frames are measured on the green plane
+        if (targetChip->getNAxis() == 3)
+            frame += static_cast<size_t>(width) * height * (targetChip->getBPP() / 8);
+
+        if (targetChip->getBPP() == 8)
+            found = measureCentroid(frame, width, x0, y0, x1, y1, cx, cy);
+        else if (targetChip->getBPP() == 16)
+            found = measureCentroid(reinterpret_cast<const uint16_t *>(frame), width, x0, y0, x1, y1, cx, cy);
+    }
+
+    std::lock_guard<std::mutex> lock(m_GuideROILock);
+    if (!found)
+    {
+        LOG_DEBUG("No guide star found in the guide ROI.");
+        GuideROINP.setState(IPS_ALERT);
+        GuideROINP.apply();
+        return;
+    }
+
+    GuideROINP[GUIDE_ROI_X].setValue(targetChip->getSubX() + (cx + 0.5) * binX);
+    GuideROINP[GUIDE_ROI_Y].setValue(targetChip->getSubY() + (cy + 0.5) * binY);
+    GuideROINP.setState(IPS_OK);
+    GuideROINP.apply();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void CCD::applyGuideROIStream()
+{
+    if (!HasStreaming() || Streamer.get() == nullptr || guideROIChip() != &PrimaryCCD)
+        return;
+
+    int const binX = std::max(1, PrimaryCCD.getBinX()), binY = std::max(1, PrimaryCCD.getBinY());
+    uint16_t const width = PrimaryCCD.getSubW() / binX, height = PrimaryCCD.getSubH() / binY;
+
+    if (GuideROISP[GUIDE_ROI_OFF].getState() == ISS_ON)
+    {
+        Streamer->setStreamFrame(0, 0, width, height);
+        return;
+    }
+
+    // Streamed frames are cut by the stream, in binned pixels of the frame read
+    std::lock_guard<std::mutex> lock(m_GuideROILock);
+    double const size = GuideROINP[GUIDE_ROI_SIZE].getValue();
+    uint16_t const w = std::max(1.0, size / binX), h = std::max(1.0, size / binY);
+    double const x = (GuideROINP[GUIDE_ROI_X].getValue() - PrimaryCCD.getSubX()) / binX - w / 2.0;
+    double const y = (GuideROINP[GUIDE_ROI_Y].getValue() - PrimaryCCD.getSubY()) / binY - h / 2.0;
+    Streamer->setStreamFrame(std::max(0.0, std::min<double>(x, width - w)), std::max(0.0, std::min<double>(y, height - h)), w, h);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2829,10 +3785,13 @@ bool CCD::processFastExposure(CCDChip * targetChip)
         targetChip->setExposureComplete();
         double duration = targetChip->getExposureDuration();
 
+        // Uploads of a burst do not hold the next exposure
+        bool const burst = isBursting(targetChip);
+
         // Check fast exposure count
         if (FastExposureCountNP[0].getValue() > 1)
         {
-            if (UploadSP[UPLOAD_LOCAL].getState() != ISS_ON)
+            if (UploadSP[UPLOAD_LOCAL].getState() != ISS_ON && !burst)
             {
                 if (FastExposureCountNP.getState() != IPS_BUSY)
                 {
@@ -2854,8 +3813,10 @@ bool CCD::processFastExposure(CCDChip * targetChip)
             FastExposureCountNP[0].setValue(FastExposureCountNP[0].getValue() - 1);
             FastExposureCountNP.apply();
 
-            if (UploadSP[UPLOAD_LOCAL].getState() == ISS_ON || m_UploadTime < duration)
+            if (burst || UploadSP[UPLOAD_LOCAL].getState() == ISS_ON || m_UploadTime < duration)
             {
+                applyGuideROI(&PrimaryCCD);
+                requestActiveDevices();
                 if (StartExposure(duration))
                     PrimaryCCD.ImageExposureNP.setState(IPS_BUSY);
                 else
@@ -2925,8 +3886,21 @@ bool CCD::saveConfigItems(FILE * fp)
     UploadSP.save(fp);
     UploadSettingsTP.save(fp);
     FastExposureToggleSP.save(fp);
+    if (m_UploadPipeline)
+        FastExposureBurstNP.save(fp);
 
     PrimaryCCD.CompressSP.save(fp);
+    CompressionCodecSP.save(fp);
+    CompressionLevelNP.save(fp);
+    PreviewSP.save(fp);
+    PreviewSettingsNP.save(fp);
+    StarAnalysisSP.save(fp);
+    CalibrationSP.save(fp);
+    CalibrationTP.save(fp);
+    CalibrationSettingsNP.save(fp);
+    if (CanSubFrame() || HasGuideHead())
+        GuideROINP.save(fp);
+    HttpBlobSettingsNP.save(fp);
 
     if (PrimaryCCD.getCCDInfo().getPermission() != IP_RO)
         PrimaryCCD.getCCDInfo().save(fp);
@@ -3010,66 +3984,17 @@ IPState CCD::GuideWest(uint32_t ms)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void CCD::getMinMax(double * min, double * max, CCDChip * targetChip)
 {
-    int ind         = 0, i, j;
-    int imageHeight = targetChip->getSubH() / targetChip->getBinY();
-    int imageWidth  = targetChip->getSubW() / targetChip->getBinX();
-    double lmin = 0, lmax = 0;
-
-    switch (targetChip->getBPP())
+    // Binning found the range of the frame as it wrote it
+    if (targetChip->UploadRangeValid)
     {
-        case 8:
-        {
-            uint8_t * imageBuffer = targetChip->getFrameBuffer();
-            lmin = lmax = imageBuffer[0];
-
-            for (i = 0; i < imageHeight; i++)
-                for (j = 0; j < imageWidth; j++)
-                {
-                    ind = (i * imageWidth) + j;
-                    if (imageBuffer[ind] < lmin)
-                        lmin = imageBuffer[ind];
-                    else if (imageBuffer[ind] > lmax)
-                        lmax = imageBuffer[ind];
-                }
-        }
-        break;
-
-        case 16:
-        {
-            uint16_t * imageBuffer = reinterpret_cast<uint16_t*>(targetChip->getFrameBuffer());
-            lmin = lmax = imageBuffer[0];
-
-            for (i = 0; i < imageHeight; i++)
-                for (j = 0; j < imageWidth; j++)
-                {
-                    ind = (i * imageWidth) + j;
-                    if (imageBuffer[ind] < lmin)
-                        lmin = imageBuffer[ind];
-                    else if (imageBuffer[ind] > lmax)
-                        lmax = imageBuffer[ind];
-                }
-        }
-        break;
-
-        case 32:
-        {
-            uint32_t * imageBuffer = reinterpret_cast<uint32_t*>(targetChip->getFrameBuffer());
-            lmin = lmax = imageBuffer[0];
-
-            for (i = 0; i < imageHeight; i++)
-                for (j = 0; j < imageWidth; j++)
-                {
-                    ind = (i * imageWidth) + j;
-                    if (imageBuffer[ind] < lmin)
-                        lmin = imageBuffer[ind];
-                    else if (imageBuffer[ind] > lmax)
-                        lmax = imageBuffer[ind];
-                }
-        }
-        break;
+        *min = targetChip->UploadRangeMin;
+        *max = targetChip->UploadRangeMax;
+        return;
     }
-    *min = lmin;
-    *max = lmax;
+
+    size_t count = static_cast<size_t>(targetChip->getSubW() / targetChip->getBinX()) * (targetChip->getSubH() / targetChip->getBinY());
+    if (!getPixelMinMax(targetChip->getUploadFrame(), count, targetChip->getBPP(), min, max))
+        *min = *max = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -3105,6 +4030,7 @@ int CCD::getFileIndex(const std::string &dir, const std::string &prefix, const s
         if (errno == ENOENT)
         {
             LOGF_INFO("Creating directory %s...", dir.c_str());
+            m_FileIndexKey.clear();
             if (INDI::mkpath(dir, 0755) == -1)
                 LOGF_ERROR("Error creating directory %s (%s)", dir.c_str(), strerror(errno));
         }
@@ -3115,6 +4041,11 @@ int CCD::getFileIndex(const std::string &dir, const std::string &prefix, const s
         }
     }
 
+    // The directory is scanned again only for another directory or prefix, files saved since are counted here
+    std::string key = dir + "/" + prefixIndex;
+    if (key == m_FileIndexKey && m_FileIndex > 0)
+        return ++m_FileIndex;
+
     dpdf = opendir(dir.c_str());
     if (dpdf != nullptr)
     {
@@ -3147,7 +4078,65 @@ int CCD::getFileIndex(const std::string &dir, const std::string &prefix, const s
     }
 
     closedir(dpdf);
-    return (maxIndex + 1);
+
+    m_FileIndexKey = key;
+    m_FileIndex = maxIndex + 1;
+    return m_FileIndex;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool CCD::saveImageFile(const std::string &fileName, const void *data, size_t size)
+{
+    // Large writes, each one a multiple of the page size as the BLOB is page aligned
+    constexpr size_t chunkSize = 8 << 20;
+
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOGF_ERROR("Unable to save image file (%s). %s", fileName.c_str(), strerror(errno));
+        return false;
+    }
+
+#ifdef __linux__
+    // Reserve the whole file at once rather than extending it with each write, filesystems that can't are fine too
+    posix_fallocate(fd, 0, size);
+#endif
+
+    auto buffer = static_cast<const char *>(data);
+    for (size_t offset = 0; offset < size;)
+    {
+        ssize_t n = write(fd, buffer + offset, std::min(size - offset, chunkSize));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            LOGF_ERROR("Unable to save image file (%s). %s", fileName.c_str(), strerror(errno));
+            close(fd);
+            return false;
+        }
+        offset += n;
+    }
+
+    // Syncing to disk takes longer than writing to the page cache and is done in the background,
+    // waiting for the previous image only if the disk is slower than the exposures.
+    if (m_SaveSync.valid())
+        m_SaveSync.wait();
+
+    m_SaveSync = ThreadPool::global().submit([this, fd, fileName]
+    {
+#ifdef __linux__
+        int rc = fdatasync(fd);
+#else
+        int rc = fsync(fd);
+#endif
+        if (rc != 0)
+            LOGF_WARN("Unable to sync image file (%s) to disk. %s", fileName.c_str(), strerror(errno));
+        close(fd);
+    });
+
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -34,6 +34,9 @@
 #include "inditimer.h"
 #include "indielapsedtimer.h"
 #include "fitskeyword.h"
+#include "indibufferpool.h"
+#include "indiblobhttpserver.h"
+#include "indicalibration.h"
 #include "dsp/manager.h"
 #include "stream/streammanager.h"
 
@@ -47,6 +50,8 @@
 #include <cstring>
 #include <chrono>
 #include <stdint.h>
+#include <functional>
+#include <future>
 #include <mutex>
 #include <thread>
 
@@ -104,7 +109,14 @@ class XISFWrapper;
  * \endcode
  *
  * Similarly, before calling Streamer->newFrame, the buffer needs to be protected in a similar fashion using
- * the same ccdBufferLock mutex.
+ * the same ccdBufferLock mutex. Drivers that read stream frames from the camera SDK can skip both the lock
+ * and the copy of the stream by reading each frame into a buffer lent by the stream:
+ *
+ * \code{.cpp}
+ * INDI::BufferPool::Buffer frame = Streamer->acquireFrame(frameBytes);
+ * get_stream_frame(frame.data());
+ * Streamer->newFrame(std::move(frame));
+ * \endcode
  *
  * \example CCD Simulator
  * \version 1.1
@@ -152,7 +164,6 @@ class CCD : public DefaultDevice, GuiderInterface
         virtual bool ISNewText(const char * dev, const char * name, char * texts[], char * names[], int n) override;
         virtual bool ISNewBLOB(const char *dev, const char *name, int sizes[], int blobsizes[], char *blobs[], char *formats[],
                                char *names[], int n) override;
-        virtual bool ISSnoopDevice(XMLEle * root) override;
 
         static void wsThreadHelper(void * context);
 
@@ -178,6 +189,34 @@ class CCD : public DefaultDevice, GuiderInterface
          */
         void SetCCDCapability(uint32_t cap);
 
+        /**
+         * @brief setUploadPipeline Upload each frame from a second frame buffer, so that the next exposure
+         * can be read out while the previous frame is encoded, compressed and sent. ExposureComplete() swaps
+         * the buffers, and only waits when the previous frame of the chip is still uploading.
+         * Pipelined uploads also make fast exposure bursts possible: with CCD_FAST_BURST set to N frames, the next
+         * exposure of a fast exposure series starts as soon as ExposureComplete() is called, and the frames wait
+         * for their upload in a ring of N buffers, each with the start time and duration of its own exposure.
+         * Whether pipelined or not, each chip uploads its frames in order on a worker of its own, so the guide chip
+         * never waits for the primary chip, and the guide frames are sent before what the primary chip queued.
+         * @param enable True to pipeline uploads. The driver must then read each exposure into the buffer
+         * returned by getFrameBuffer() at the time, not keep a pointer to it or set a buffer of its own,
+         * and must not call ExposureComplete() from StartExposure().
+         */
+        void setUploadPipeline(bool enable)
+        {
+            m_UploadPipeline = enable;
+        }
+
+        /**
+         * @brief getBufferPool Returns the pool that compression and streaming take their frame buffers from.
+         * Drivers can take the buffers they use for each frame from it too, so that steady imaging does no
+         * large allocations, and enable huge pages on it for large sensors.
+         */
+        BufferPool &getBufferPool()
+        {
+            return m_BufferPool;
+        }
+
         /**
          * @return True if CCD can abort exposure. False otherwise.
          */
@@ -252,6 +291,7 @@ class CCD : public DefaultDevice, GuiderInterface
                 if(Streamer.get() == nullptr)
                 {
                     Streamer.reset(new StreamManager(this));
+                    Streamer->setBufferPool(m_BufferPool);
                     Streamer->initProperties();
                 }
                 return true;
@@ -509,6 +549,16 @@ class CCD : public DefaultDevice, GuiderInterface
          */
         virtual void addFITSKeywords(CCDChip * targetChip, std::vector<FITSRecord> &fitsKeywords);
 
+        /**
+         * @brief getCalibrationGain Gain of the frames of the camera, to match them with the calibration masters of
+         * CCD_CALIBRATION_DIR. Drivers with a gain control return its value.
+         * @return The gain, or NAN if unknown, in which case masters of any gain match.
+         */
+        virtual double getCalibrationGain()
+        {
+            return NAN;
+        }
+
         /** A function to just remove GCC warnings about deprecated conversion */
         void fits_update_key_s(fitsfile * fptr, int type, std::string name, void * p, std::string explanation, int * status);
 
@@ -618,6 +668,15 @@ class CCD : public DefaultDevice, GuiderInterface
 
         // Threading
         std::mutex ccdBufferLock;
+        bool m_UploadPipeline {false};
+        BufferPool m_BufferPool;
+
+        // Sync to disk of the last saved image, running in the background
+        std::future<void> m_SaveSync;
+
+        // Next index of the saved images for a directory and prefix, so that the directory is only scanned when they change
+        std::string m_FileIndexKey;
+        int m_FileIndex {0};
 
         std::vector<std::string> FilterNames;
         int CurrentFilterSlot {-1};
@@ -715,6 +774,63 @@ class CCD : public DefaultDevice, GuiderInterface
             FORMAT_XISF      /*!< Save Image as XISF format  */
         };
 
+        /// Codec of compressed uploads that are not FITS, which are tile compressed with fpack
+        INDI::PropertySwitch CompressionCodecSP {0};
+
+        /// Compression level of the codec, 0 for its default
+        INDI::PropertyNumber CompressionLevelNP {1};
+
+        /// Send a small stretched JPEG of each primary frame in PreviewBP, for clients that only focus or frame
+        INDI::PropertySwitch PreviewSP {2};
+        INDI::PropertyNumber PreviewSettingsNP {2};
+        enum
+        {
+            PREVIEW_WIDTH,
+            PREVIEW_QUALITY
+        };
+        INDI::PropertyBlob PreviewBP {1};
+
+        /// Detect and measure the stars of each primary frame, publishing the results in StarMetricsNP
+        INDI::PropertySwitch StarAnalysisSP {2};
+        INDI::PropertyNumber StarMetricsNP {5};
+        enum
+        {
+            STAR_COUNT,
+            STAR_HFR,
+            STAR_FWHM,
+            STAR_BACKGROUND,
+            STAR_NOISE
+        };
+
+        /// Calibrate the previews with the masters of CCD_CALIBRATION_DIR, the frames sent and saved stay raw
+        INDI::PropertySwitch CalibrationSP {2};
+        INDI::PropertyText CalibrationTP {1};
+        INDI::PropertyNumber CalibrationSettingsNP {1};
+        enum
+        {
+            CALIBRATION_TEMPERATURE_TOLERANCE
+        };
+
+        /// Guide ROI: only a box around the guide star is read out of the guiding chip, the guide head if there is one,
+        /// and the box follows the star when tracking
+        INDI::PropertySwitch GuideROISP {3};
+        enum
+        {
+            GUIDE_ROI_OFF,
+            GUIDE_ROI_FIXED,
+            GUIDE_ROI_TRACK
+        };
+        /// Center and side of the box, in unbinned pixels of the chip
+        INDI::PropertyNumber GuideROINP {3};
+        enum
+        {
+            GUIDE_ROI_X,
+            GUIDE_ROI_Y,
+            GUIDE_ROI_SIZE
+        };
+        /// Reads the next frame of the guiding chip in full, then goes back to the box
+        INDI::PropertySwitch GuideROIFullFrameSP {1};
+
         INDI::PropertySwitch UploadSP {3};
 
         INDI::PropertyText UploadSettingsTP {2};
@@ -748,6 +864,22 @@ class CCD : public DefaultDevice, GuiderInterface
             WS_SETTINGS_PORT,
         };
 
+        // HTTP BLOB Support
+        INDI::PropertySwitch HttpBlobSP {2};
+        enum
+        {
+            HTTP_BLOB_ENABLED,
+            HTTP_BLOB_DISABLED,
+        };
+
+        // HTTP BLOB Settings
+        INDI::PropertyNumber HttpBlobSettingsNP {2};
+        enum
+        {
+            HTTP_BLOB_PORT,
+            HTTP_BLOB_KEEP,
+        };
+
         // WCS
         INDI::PropertySwitch WorldCoordSP{2};
         enum
@@ -766,6 +898,9 @@ class CCD : public DefaultDevice, GuiderInterface
         double m_UploadTime = { 0 };
         std::chrono::system_clock::time_point FastExposureToggleStartup;
 
+        // Fast Exposure Burst: frames read out back to back into a ring of that many buffers, 0 to wait for each upload
+        INDI::PropertyNumber FastExposureBurstNP {1};
+
         INDI::PropertyText FITSHeaderTP {3};
         enum
         {
@@ -784,13 +919,51 @@ class CCD : public DefaultDevice, GuiderInterface
 
         std::map<std::string, FITSRecord> m_CustomFITSKeywords;
 
+        CalibrationCache m_Calibration;
+
+        // Frame of the guiding chip before the guide ROI took it over, restored when the mode is turned off
+        int m_GuideROIFrame[4] {0, 0, 0, 0};
+        bool m_GuideROIFullFrame {false};
+        // GuideROINP is updated by the upload thread while tracking
+        std::mutex m_GuideROILock;
+
+        // Properties of the active devices watched by watchActiveDevices()
+        std::vector<std::pair<std::string, std::string>> m_SnoopedProperties;
+        // Those of them snooped in latest-value mode, pulled by requestActiveDevices() when an exposure starts
+        std::vector<std::pair<std::string, std::string>> m_LatestSnoopedProperties;
+
         ///////////////////////////////////////////////////////////////////////////////
         /// Utility Functions
         ///////////////////////////////////////////////////////////////////////////////
         bool uploadFile(CCDChip * targetChip, const void * fitsData, size_t totalBytes, bool sendImage, bool saveImage);
         void getMinMax(double * min, double * max, CCDChip * targetChip);
         int getFileIndex(const std::string & dir, const std::string & prefix, const std::string & ext);
+        bool saveImageFile(const std::string & fileName, const void * data, size_t size);
         bool ExposureCompletePrivate(CCDChip * targetChip);
+        /// Upload the frames queued in the ring of targetChip, in order, until none is left
+        void uploadQueuedFrames(CCDChip * targetChip);
+        /// True if the next exposure of targetChip starts without waiting for the upload of the last one
+        bool isBursting(CCDChip * targetChip);
+        /// Run upload on the worker of targetChip, after the uploads queued before it
+        void queueUpload(CCDChip * targetChip, const std::function<void()> &upload);
+        std::unique_lock<std::mutex> lockUploadFrame(CCDChip * targetChip);
+        void watchActiveDevices();
+        void requestActiveDevices();
+        BufferPool::Buffer compressFrame(const void * data, size_t size, std::string &extension);
+        void uploadPreview(CCDChip * targetChip);
+        void publishStarMetrics(CCDChip * targetChip);
+        /// Calibrated copy of the upload frame of targetChip, false if it is not calibrated
+        bool calibrateFrame(CCDChip * targetChip, std::vector<uint16_t> &calibrated);
+
+        /// The chip the guide ROI reads out
+        CCDChip *guideROIChip();
+        bool updateChipFrame(CCDChip * targetChip, int x, int y, int w, int h);
+        /// Sets the frame of targetChip to the box, or to the full frame once if requested, before it exposes
+        void applyGuideROI(CCDChip * targetChip);
+        /// Recenters the box on the star of the frame of targetChip, from the upload thread
+        void trackGuideROI(CCDChip * targetChip);
+        /// Crops streams of the primary chip to the box too
+        void applyGuideROIStream();
 
         // Threading for Websocket
 #ifdef HAVE_WEBSOCKET
@@ -799,6 +972,9 @@ class CCD : public DefaultDevice, GuiderInterface
         INDIWSServer wsServer;
 #endif
 
+        // Serves the images, and stream recordings, of HttpBlobSP
+        BlobHttpServer m_BlobHttpServer;
+
         /////////////////////////////////////////////////////////////////////////////
         /// Misc.
         /////////////////////////////////////////////////////////////////////////////
@@ -17,11 +17,324 @@
 *******************************************************************************/
 #include "indiccdchip.h"
 #include "indidevapi.h"
+#include "indithreadpool.h"
+#include "inditaskqueue.h"
+#include "indiminmax.h"
 #include "sharedblob.h"
 #include "locale_compat.h"
 
+#include <algorithm>
 #include <cstring>
 #include <ctime>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// Binning kernels on rows of n pixels. Sums saturate at UINT16_MAX: as pixels are never negative, summing
+// in any order with saturation gives the saturated total, as the scalar loops do.
+
+// dst[i] += src[i]
+void addRow16(uint16_t *dst, const uint16_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_adds_epu16(d, v));
+    }
+#endif
+#if defined(__SSE2__)
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_adds_epu16(d, v));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 8 <= n; i += 8)
+        vst1q_u16(dst + i, vqaddq_u16(vld1q_u16(dst + i), vld1q_u16(src + i)));
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t val = dst[i] + src[i];
+        dst[i] = val > UINT16_MAX ? UINT16_MAX : val;
+    }
+}
+
+// dst[i] += src[i] >> shift
+void addRow8(uint16_t *dst, const uint8_t *src, size_t n, int shift)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m128i count256 = _mm_cvtsi32_si128(shift);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+        __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_adds_epu16(d, _mm256_srl_epi16(v, count256)));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i zero  = _mm_setzero_si128();
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v  = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i lo = _mm_srl_epi16(_mm_unpacklo_epi8(v, zero), count);
+        __m128i hi = _mm_srl_epi16(_mm_unpackhi_epi8(v, zero), count);
+        __m128i d0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        __m128i d1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_adds_epu16(d0, lo));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 8), _mm_adds_epu16(d1, hi));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const int16x8_t count = vdupq_n_s16(-shift);
+    for (; i + 8 <= n; i += 8)
+        vst1q_u16(dst + i, vqaddq_u16(vld1q_u16(dst + i), vshlq_u16(vmovl_u8(vld1_u8(src + i)), count)));
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t val = dst[i] + (src[i] >> shift);
+        dst[i] = val > UINT16_MAX ? UINT16_MAX : val;
+    }
+}
+
+// dst[i] = src[2i] + src[2i + 1], may be done in place
+void addPairs16(uint16_t *dst, const uint16_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i low256  = _mm256_set1_epi32(0xFFFF);
+    const __m256i bias256 = _mm256_set1_epi32(0x8000);
+    const __m256i sign256 = _mm256_set1_epi16(static_cast<short>(0x8000));
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i + 16));
+        // Sums in the low halves of 32 bit lanes, biased to pack them signed
+        __m256i s0 = _mm256_sub_epi32(_mm256_adds_epu16(_mm256_and_si256(v0, low256), _mm256_srli_epi32(v0, 16)), bias256);
+        __m256i s1 = _mm256_sub_epi32(_mm256_adds_epu16(_mm256_and_si256(v1, low256), _mm256_srli_epi32(v1, 16)), bias256);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(s0, s1), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(packed, sign256));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i low  = _mm_set1_epi32(0xFFFF);
+    const __m128i bias = _mm_set1_epi32(0x8000);
+    const __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 8));
+        __m128i s0 = _mm_sub_epi32(_mm_adds_epu16(_mm_and_si128(v0, low), _mm_srli_epi32(v0, 16)), bias);
+        __m128i s1 = _mm_sub_epi32(_mm_adds_epu16(_mm_and_si128(v1, low), _mm_srli_epi32(v1, 16)), bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(_mm_packs_epi32(s0, s1), sign));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 8 <= n; i += 8)
+    {
+        uint32x4_t s0 = vpaddlq_u16(vld1q_u16(src + 2 * i));
+        uint32x4_t s1 = vpaddlq_u16(vld1q_u16(src + 2 * i + 8));
+        vst1q_u16(dst + i, vcombine_u16(vqmovn_u32(s0), vqmovn_u32(s1)));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t val = src[2 * i] + src[2 * i + 1];
+        dst[i] = val > UINT16_MAX ? UINT16_MAX : val;
+    }
+}
+
+// Same on pairs of Bayer columns: dst[2i + c] = src[4i + c] + src[4i + 2 + c], may be done in place
+void addBayerPairs16(uint16_t *dst, const uint16_t *src, size_t n)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i low256 = _mm256_set1_epi64x(0xFFFFFFFF);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i));
+        __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + 2 * i + 16));
+        // Sums in the low halves of 64 bit lanes, gathered in the low half of each 128 bit lane
+        __m256i s0 = _mm256_adds_epu16(_mm256_and_si256(v0, low256), _mm256_srli_epi64(v0, 32));
+        __m256i s1 = _mm256_adds_epu16(_mm256_and_si256(v1, low256), _mm256_srli_epi64(v1, 32));
+        s0 = _mm256_shuffle_epi32(s0, _MM_SHUFFLE(3, 1, 2, 0));
+        s1 = _mm256_shuffle_epi32(s1, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(s0, s1), 0xD8));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i low = _mm_set_epi32(0, -1, 0, -1);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + 2 * i + 8));
+        __m128i s0 = _mm_adds_epu16(_mm_and_si128(v0, low), _mm_srli_epi64(v0, 32));
+        __m128i s1 = _mm_adds_epu16(_mm_and_si128(v1, low), _mm_srli_epi64(v1, 32));
+        s0 = _mm_shuffle_epi32(s0, _MM_SHUFFLE(3, 1, 2, 0));
+        s1 = _mm_shuffle_epi32(s1, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_unpacklo_epi64(s0, s1));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 8 <= n; i += 8)
+    {
+        uint32x4_t v0 = vreinterpretq_u32_u16(vld1q_u16(src + 2 * i));
+        uint32x4_t v1 = vreinterpretq_u32_u16(vld1q_u16(src + 2 * i + 8));
+        vst1q_u16(dst + i, vqaddq_u16(vreinterpretq_u16_u32(vuzp1q_u32(v0, v1)), vreinterpretq_u16_u32(vuzp2q_u32(v0, v1))));
+    }
+#endif
+    for (; i < n; i += 2)
+    {
+        for (size_t c = 0; c < 2; c++)
+        {
+            uint32_t val = src[2 * i + c] + src[2 * i + 2 + c];
+            dst[i + c] = val > UINT16_MAX ? UINT16_MAX : val;
+        }
+    }
+}
+
+// dst[i] = min(src[i] >> shift, UINT8_MAX)
+void narrowRow8(uint8_t *dst, const uint16_t *src, size_t n, int shift)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m128i count256 = _mm_cvtsi32_si128(shift);
+    const __m256i max256   = _mm256_set1_epi16(UINT8_MAX);
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v0 = _mm256_srl_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), count256);
+        __m256i v1 = _mm256_srl_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 16)), count256);
+        // min(v, 255) without SSE4.1, packus then takes it as it is
+        v0 = _mm256_sub_epi16(v0, _mm256_subs_epu16(v0, max256));
+        v1 = _mm256_sub_epi16(v1, _mm256_subs_epu16(v1, max256));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(v0, v1), 0xD8));
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    const __m128i max   = _mm_set1_epi16(UINT8_MAX);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v0 = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), count);
+        __m128i v1 = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 8)), count);
+        v0 = _mm_sub_epi16(v0, _mm_subs_epu16(v0, max));
+        v1 = _mm_sub_epi16(v1, _mm_subs_epu16(v1, max));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(v0, v1));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const int16x8_t count = vdupq_n_s16(-shift);
+    for (; i + 8 <= n; i += 8)
+        vst1_u8(dst + i, vqmovn_u16(vshlq_u16(vld1q_u16(src + i), count)));
+#endif
+    for (; i < n; i++)
+    {
+        uint32_t val = src[i] >> shift;
+        dst[i] = val > UINT8_MAX ? UINT8_MAX : val;
+    }
+}
+
+int log2Exact(uint32_t value)
+{
+    int log = 0;
+    while ((1u << log) < value)
+        log++;
+    return (1u << log) == value ? log : -1;
+}
+
+#ifdef WITH_MINMAX
+// DATAMIN and DATAMAX are taken from the binned rows, rather than from one more pass over the frame
+constexpr bool BIN_RANGE = true;
+#else
+constexpr bool BIN_RANGE = false;
+#endif
+
+// Bins a frame of width x height pixels of bpp bits whose bin factors are powers of two, rows in parallel.
+// For Bayer frames each color is binned on its own and the pattern kept. Returns false for the other cases,
+// left to the scalar loops, which also define the results: 16 bit pixels are summed with saturation, 8 bit
+// pixels are averaged over half the binned pixels, or over all of them for Bayer frames.
+// If range is not null, range[0] and range[1] are set to the smallest and largest binned pixels.
+bool binPowerOfTwo(const uint8_t *raw, uint8_t *bin, uint32_t width, uint32_t height, uint32_t binX, uint32_t binY,
+                   int bpp, bool bayer, uint32_t *range)
+{
+    int const logX = log2Exact(binX), logY = log2Exact(binY);
+    uint32_t const cells = bayer ? 2 : 1;
+
+    if ((bpp != 8 && bpp != 16) || logX < 1 || logY < 0 || binX > 16 || binX * binY >= 256 ||
+            width % (cells * binX) != 0 || height % (cells * binY) != 0)
+        return false;
+
+    uint32_t const binWidth = width / binX;
+    uint32_t const binHeight = height / binY;
+
+    // 8 bit pixels: divided by half the binned pixels, or by each of them for Bayer frames
+    int const inputShift  = (bpp == 8 && bayer) ? logX + logY : 0;
+    int const outputShift = (bpp == 8 && !bayer) ? logX + logY - 1 : 0;
+
+    std::vector<uint32_t> rowMin(range ? binHeight : 0, UINT32_MAX), rowMax(range ? binHeight : 0, 0);
+
+    auto binRow = [&](size_t row)
+    {
+        static thread_local std::vector<uint16_t> sums;
+        sums.assign(width, 0);
+
+        for (uint32_t k = 0; k < binY; k++)
+        {
+            // Bayer frames sum the rows of the same color within blocks of 2 * binY rows
+            size_t const rawRow = bayer ? (row >> 1) * 2 * binY + (row & 1) + 2 * k : row * binY + k;
+
+            if (bpp == 16)
+                addRow16(sums.data(), reinterpret_cast<const uint16_t *>(raw) + rawRow * width, width);
+            else
+                addRow8(sums.data(), raw + rawRow * width, width, inputShift);
+        }
+
+        for (uint32_t n = width; n > binWidth; n /= 2)
+        {
+            if (bayer)
+                addBayerPairs16(sums.data(), sums.data(), n / 2);
+            else
+                addPairs16(sums.data(), sums.data(), n / 2);
+        }
+
+        if (bpp == 16)
+            memcpy(reinterpret_cast<uint16_t *>(bin) + row * binWidth, sums.data(), binWidth * sizeof(uint16_t));
+        else
+            narrowRow8(bin + row * binWidth, sums.data(), binWidth, outputShift);
+
+        if (range)
+            INDI::mergePixelMinMax(bin + row * binWidth * (bpp / 8), binWidth, bpp, rowMin[row], rowMax[row]);
+    };
+
+    // Small frames are not worth waking workers for
+    if (static_cast<size_t>(width) * height < (1u << 20))
+    {
+        for (size_t row = 0; row < binHeight; row++)
+            binRow(row);
+    }
+    else
+        INDI::ThreadPool::global().parallelFor(0, binHeight, binRow, 16);
+
+    if (range && binHeight > 0)
+    {
+        range[0] = *std::min_element(rowMin.begin(), rowMin.end());
+        range[1] = *std::max_element(rowMax.begin(), rowMax.end());
+    }
+
+    return true;
+}
+
+}
 
 namespace INDI
 {
@@ -33,8 +346,15 @@ CCDChip::CCDChip()
 
 CCDChip::~CCDChip()
 {
+    // The running upload ends before its frames are freed
+    Uploader.reset();
     IDSharedBlobFree(RawFrame);
     IDSharedBlobFree(BinFrame);
+    for (auto &ring : FreeFrames)
+        IDSharedBlobFree(ring.frame);
+    for (auto &ring : QueuedFrames)
+        IDSharedBlobFree(ring.frame);
+    IDSharedBlobFree(UploadFrame.frame);
     IDSharedBlobFree(m_FITSMemoryBlock);
 }
 
@@ -83,6 +403,18 @@ void CCDChip::closeFITSFile()
     m_FITSMemoryBlock = nullptr;
 }
 
+bool CCDChip::openFITSBlock(size_t size)
+{
+    m_FITSMemoryBlock = IDSharedBlobAlloc(size);
+    if (m_FITSMemoryBlock == nullptr)
+    {
+        IDLog("Failed to allocate memory for FITS file.");
+        return false;
+    }
+    m_FITSMemorySize = size;
+    return true;
+}
+
 void CCDChip::setFrameType(CCD_FRAME type)
 {
     FrameType = type;
@@ -207,6 +539,104 @@ void CCDChip::setFrameBufferSize(uint32_t nbuf, bool allocMem)
     }
 }
 
+void CCDChip::takeExposure(RingFrame &ring)
+{
+    ring.rangeValid = RangeValid;
+    ring.rangeMin = RangeMin;
+    ring.rangeMax = RangeMax;
+    ring.duration = ExposureDuration;
+    ring.startTime = getExposureStartTime();
+    RangeValid = false;
+}
+
+bool CCDChip::queueUploadFrame(size_t ringSize, bool restarted, bool &startUpload)
+{
+    if (RawFrame == nullptr || RawFrameSize == 0 || ringSize == 0)
+        return false;
+
+    std::unique_lock<std::mutex> lock(RingMutex);
+
+    // The whole ring is allocated with the first frame, not while a burst runs
+    for (; RingSize < ringSize; RingSize++)
+    {
+        RingFrame ring;
+        ring.frame = static_cast<uint8_t*>(IDSharedBlobAlloc(RawFrameSize));
+        if (ring.frame == nullptr)
+            break;
+        ring.size = RawFrameSize;
+        FreeFrames.push_back(ring);
+    }
+    for (; RingSize > ringSize && !FreeFrames.empty(); RingSize--)
+    {
+        IDSharedBlobFree(FreeFrames.back().frame);
+        FreeFrames.pop_back();
+    }
+    if (RingSize == 0)
+        return false;
+
+    RingChanged.wait(lock, [this] { return !FreeFrames.empty(); });
+
+    RingFrame ring = FreeFrames.back();
+    FreeFrames.pop_back();
+    if (ring.size != RawFrameSize)
+    {
+        uint8_t *frame = static_cast<uint8_t*>(IDSharedBlobRealloc(ring.frame, RawFrameSize));
+        if (frame == nullptr)
+        {
+            IDSharedBlobFree(ring.frame);
+            RingSize--;
+            return false;
+        }
+        ring.frame = frame;
+        ring.size = RawFrameSize;
+    }
+
+    // The driver reads the next exposure into the free frame
+    std::swap(RawFrame, ring.frame);
+
+    takeExposure(ring);
+    ring.restarted = restarted;
+    QueuedFrames.push_back(std::move(ring));
+
+    startUpload = !Uploading;
+    Uploading = true;
+    return true;
+}
+
+bool CCDChip::nextUploadFrame()
+{
+    std::lock_guard<std::mutex> lock(RingMutex);
+
+    if (UploadFrame.frame != nullptr)
+    {
+        FreeFrames.push_back(UploadFrame);
+        UploadFrame = RingFrame();
+    }
+    RingChanged.notify_all();
+
+    if (QueuedFrames.empty())
+    {
+        UploadFromSpare = false;
+        Uploading = false;
+        return false;
+    }
+
+    UploadFrame = std::move(QueuedFrames.front());
+    QueuedFrames.pop_front();
+
+    UploadFromSpare = true;
+    UploadRangeValid = UploadFrame.rangeValid;
+    UploadRangeMin = UploadFrame.rangeMin;
+    UploadRangeMax = UploadFrame.rangeMax;
+    return true;
+}
+
+void CCDChip::waitForUploads()
+{
+    std::unique_lock<std::mutex> lock(RingMutex);
+    RingChanged.wait(lock, [this] { return !Uploading; });
+}
+
 void CCDChip::setExposureLeft(double duration)
 {
     ImageExposureNP.setState(IPS_BUSY);
@@ -223,6 +653,7 @@ void CCDChip::setExposureComplete()
 
 void CCDChip::setExposureDuration(double duration)
 {
+    RangeValid = false;
     ExposureDuration = duration;
     gettimeofday(&StartExposureTime, nullptr);
 }
@@ -282,6 +713,7 @@ void CCDChip::setImageExtension(const char *ext)
 
 void CCDChip::binFrame()
 {
+    RangeValid = false;
     if (BinX == 1)
         return;
 
@@ -295,8 +727,33 @@ void CCDChip::binFrame()
             BinFrame = static_cast<uint8_t*>(IDSharedBlobAlloc(RawFrameSize));
     }
 
-    memset(BinFrame, 0, RawFrameSize);
+    uint32_t range[2] = {UINT32_MAX, 0};
+    if (binPowerOfTwo(RawFrame, BinFrame, SubW, SubH, BinX, BinX, getBPP(), false, BIN_RANGE ? range : nullptr))
+    {
+        uint32_t binnedSize = (SubW / BinX) * (SubH / BinX) * (getBPP() / 8);
+        if (binnedSize < RawFrameSize)
+            memset(BinFrame + binnedSize, 0, RawFrameSize - binnedSize);
+
+        RangeValid = BIN_RANGE;
+        RangeMin = range[0];
+        RangeMax = range[1];
+    }
+    else
+    {
+        memset(BinFrame, 0, RawFrameSize);
+        if (!binFrameScalar())
+            return;
+    }
+
+    // Swap frame pointers
+    uint8_t *rawFramePointer = RawFrame;
+    RawFrame                 = BinFrame;
+    // We just memset it next time we use it
+    BinFrame = rawFramePointer;
+}
 
+bool CCDChip::binFrameScalar()
+{
     switch (getBPP())
     {
         case 8:
@@ -354,14 +811,10 @@ void CCDChip::binFrame()
         break;
 
         default:
-            return;
+            return false;
     }
 
-    // Swap frame pointers
-    uint8_t *rawFramePointer = RawFrame;
-    RawFrame                 = BinFrame;
-    // We just memset it next time we use it
-    BinFrame = rawFramePointer;
+    return true;
 }
 
 
@@ -375,6 +828,7 @@ void CCDChip::binFrame()
 //
 void CCDChip::binBayerFrame()
 {
+    RangeValid = false;
     if (BinX == 1)
         return;
 
@@ -388,8 +842,33 @@ void CCDChip::binBayerFrame()
             BinFrame = static_cast<uint8_t*>(IDSharedBlobAlloc(RawFrameSize));
     }
 
-    memset(BinFrame, 0, RawFrameSize);
+    uint32_t range[2] = {UINT32_MAX, 0};
+    if (binPowerOfTwo(RawFrame, BinFrame, SubW, SubH, BinX, BinY, getBPP(), true, BIN_RANGE ? range : nullptr))
+    {
+        uint32_t binnedSize = (SubW / BinX) * (SubH / BinY) * (getBPP() / 8);
+        if (binnedSize < RawFrameSize)
+            memset(BinFrame + binnedSize, 0, RawFrameSize - binnedSize);
+
+        RangeValid = BIN_RANGE;
+        RangeMin = range[0];
+        RangeMax = range[1];
+    }
+    else
+    {
+        memset(BinFrame, 0, RawFrameSize);
+        if (!binBayerFrameScalar())
+            return;
+    }
+
+    // Swap frame pointers
+    uint8_t *rawFramePointer = RawFrame;
+    RawFrame                 = BinFrame;
+    // We just memset it next time we use it
+    BinFrame = rawFramePointer;
+}
 
+bool CCDChip::binBayerFrameScalar()
+{
     switch (getBPP())
     {
         // 8 bpp frame
@@ -459,14 +938,10 @@ void CCDChip::binBayerFrame()
         break;
 
         default:
-            return;
+            return false;
     }
 
-    // Swap frame pointers
-    uint8_t *rawFramePointer = RawFrame;
-    RawFrame                 = BinFrame;
-    // We just memset it next time we use it
-    BinFrame = rawFramePointer;
+    return true;
 }
 
 }
@@ -24,14 +24,23 @@
 #include "indipropertyblob.h"
 
 #include "indipropertynumber.h"
+#include "fitswriter.h"
 
 #include <sys/time.h>
 #include <stdint.h>
 #include <fitsio.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace INDI
 {
 
+class TaskQueue;
+
 /**
  * @brief The CCDChip class provides functionality of a CCD Chip within a CCD.
  */
@@ -74,6 +83,13 @@ class CCDChip
          */
         void closeFITSFile();
 
+        /**
+         * @brief openFITSBlock Allocate a Shared BLOB of size bytes that a FITS file is written to directly,
+         * without an in-memory FITS file. closeFITSFile frees it.
+         * @return True if successful, false otherwise.
+         */
+        bool openFITSBlock(size_t size);
+
         /**
          * @brief getXRes Get the horizontal resolution in pixels of the CCD Chip.
          * @return the horizontal resolution of the CCD Chip.
@@ -433,6 +449,48 @@ class CCDChip
         }
 
     private:
+        // Binning loops for the frames the SIMD kernels don't handle, false for unsupported depths
+        bool binFrameScalar();
+        bool binBayerFrameScalar();
+
+        // Frame to encode and upload: the frame of the ring taken by nextUploadFrame(), the raw frame otherwise
+        uint8_t *getUploadFrame()
+        {
+            return UploadFromSpare ? UploadFrame.frame : RawFrame;
+        }
+
+        uint32_t getUploadFrameSize() const
+        {
+            return UploadFromSpare ? UploadFrame.size : RawFrameSize;
+        }
+
+        // A frame of the ring of upload buffers, and what the upload needs of the exposure it holds
+        struct RingFrame
+        {
+            uint8_t *frame {nullptr};
+            uint32_t size {0};
+            bool rangeValid {false};
+            uint32_t rangeMin {0};
+            uint32_t rangeMax {0};
+            double duration {0};
+            std::string startTime;
+            bool restarted {false};     // the next exposure was started without waiting for the upload
+        };
+
+        // Moves what the upload needs of the exposure just read out to ring
+        void takeExposure(RingFrame &ring);
+
+        // Queues the frame just read out for upload and swaps the raw frame with a free frame of the ring, which
+        // has ringSize frames. Waits while they are all queued or uploading. False if no frame can be allocated.
+        // startUpload is set when no upload runs, the caller then starts one that calls nextUploadFrame().
+        bool queueUploadFrame(size_t ringSize, bool restarted, bool &startUpload);
+
+        // Releases the frame uploaded and takes the next queued one. False once none is left, the upload ends.
+        bool nextUploadFrame();
+
+        // Waits until all the queued frames are uploaded
+        void waitForUploads();
+
         /////////////////////////////////////////////////////////////////////////////////////////
         /// Chip Variables
         /////////////////////////////////////////////////////////////////////////////////////////
@@ -468,6 +526,25 @@ class CCDChip
         uint32_t RawFrameSize {0};
         // BINNED Frame when software binning is used.
         uint8_t *BinFrame {nullptr};
+        // Ring of frames swapped with the raw frame when uploads are pipelined: free, queued, and uploading.
+        std::vector<RingFrame> FreeFrames;
+        std::deque<RingFrame> QueuedFrames;
+        RingFrame UploadFrame;
+        size_t RingSize {0};
+        bool Uploading {false};
+        std::mutex RingMutex;
+        std::condition_variable RingChanged;
+        // Is the frame of the ring the one being uploaded?
+        bool UploadFromSpare {false};
+        // Worker the frames of this chip are uploaded by, in order, whatever the other chip uploads.
+        std::unique_ptr<TaskQueue> Uploader;
+        // Pixel range of the frame found while binning it, and of the frame being uploaded.
+        bool RangeValid {false};
+        uint32_t RangeMin {0};
+        uint32_t RangeMax {0};
+        bool UploadRangeValid {false};
+        uint32_t UploadRangeMin {0};
+        uint32_t UploadRangeMax {0};
         // Should we compress frame before transmission?
         bool SendCompressed {false};
         // Frame Type
@@ -481,6 +558,8 @@ class CCDChip
         void * m_FITSMemoryBlock {nullptr};
         size_t m_FITSMemorySize {2880};
         fitsfile * m_FITSFilePointer {nullptr};
+        // Header of the previous FITS frame, patched for the next one
+        FITSHeaderCache m_FITSHeader;
 
         /////////////////////////////////////////////////////////////////////////////////////////
         /// Chip Properties
@@ -30,6 +30,8 @@
 #include <libnova/precession.h>
 
 #include <regex>
+#include <algorithm>
+#include <cmath>
 
 #include <dirent.h>
 #include <cerrno>
@@ -38,9 +40,36 @@
 #include <zlib.h>
 #include <sys/stat.h>
 
+#define CORRELATOR_TAB "Correlation"
+
 namespace INDI
 {
 
+// The samples of a FITS integration, whatever their type
+static bool readFITSSamples(void *blob, size_t len, std::vector<double> &samples)
+{
+    fitsfile *fptr = nullptr;
+    int status     = 0;
+    int bitpix     = 0;
+    int naxis      = 0;
+    long naxes[3]  = { 1, 1, 1 };
+
+    if (fits_open_memfile(&fptr, "", READONLY, &blob, &len, 0, nullptr, &status))
+        return false;
+    fits_get_img_param(fptr, 3, &bitpix, &naxis, naxes, &status);
+    if (status == 0)
+    {
+        long count    = naxes[0] * naxes[1] * naxes[2];
+        double nulval = 0;
+        int anynul    = 0;
+        samples.resize(count);
+        fits_read_img(fptr, TDOUBLE, 1, count, &nulval, samples.data(), &anynul, &status);
+    }
+    int closeStatus = 0;
+    fits_close_file(fptr, &closeStatus);
+    return status == 0;
+}
+
 Correlator::Correlator()
 {
     setIntegrationFileExtension("fits");
@@ -66,6 +95,35 @@ bool Correlator::initProperties()
     IUFillNumberVector(&CorrelatorSettingsNP, CorrelatorSettingsN, 5, getDeviceName(), "CORRELATOR_SETTINGS",
                        "Correlator Settings", MAIN_CONTROL_TAB, IP_RW, 60, IPS_IDLE);
 
+    // Correlation engine
+    for (int i = 0; i < CORRELATOR_MAX_INPUTS; i++)
+    {
+        char name[MAXINDINAME], label[MAXINDILABEL];
+        snprintf(name, MAXINDINAME, "INPUT_%d", i + 1);
+        snprintf(label, MAXINDILABEL, "Input %d", i + 1);
+        IUFillText(&CorrelatorInputsT[i], name, label, "");
+        const char *axes[3] = { "X", "Y", "Z" };
+        for (int axis = 0; axis < 3; axis++)
+        {
+            snprintf(name, MAXINDINAME, "INPUT_%d_%s", i + 1, axes[axis]);
+            snprintf(label, MAXINDILABEL, "Input %d %s (m)", i + 1, axes[axis]);
+            IUFillNumber(&CorrelatorPositionsN[i * 3 + axis], name, label, "%16.12f", -1.0e+6, 1.0e+6, 1.0e-12, 0.0);
+        }
+    }
+    IUFillTextVector(&CorrelatorInputsTP, CorrelatorInputsT, CORRELATOR_MAX_INPUTS, getDeviceName(), "CORRELATOR_INPUTS",
+                     "Input devices", CORRELATOR_TAB, IP_RW, 60, IPS_IDLE);
+    IUFillNumberVector(&CorrelatorPositionsNP, CorrelatorPositionsN, CORRELATOR_MAX_INPUTS * 3, getDeviceName(),
+                       "CORRELATOR_INPUT_POSITIONS", "Input positions", CORRELATOR_TAB, IP_RW, 60, IPS_IDLE);
+    IUFillNumber(&CorrelatorEngineN[CORRELATOR_ENGINE_SIZE], "CORRELATOR_ENGINE_SIZE", "Transform size", "%.f", 16, 1048576,
+                 2, 1024);
+    IUFillNumber(&CorrelatorEngineN[CORRELATOR_ENGINE_CADENCE], "CORRELATOR_ENGINE_CADENCE", "Cadence (s)", "%.2f", 0.01,
+                 3600, 0.01, 1);
+    IUFillNumberVector(&CorrelatorEngineNP, CorrelatorEngineN, 2, getDeviceName(), "CORRELATOR_ENGINE", "Correlation engine",
+                       CORRELATOR_TAB, IP_RW, 60, IPS_IDLE);
+    IUFillBLOB(&VisibilitiesB, "VISIBILITIES", "Visibilities", "");
+    IUFillBLOBVector(&VisibilitiesBP, &VisibilitiesB, 1, getDeviceName(), "CORRELATOR_VISIBILITIES", "Visibilities",
+                     CORRELATOR_TAB, IP_RO, 60, IPS_IDLE);
+
     setDriverInterface(SENSOR_INTERFACE);
 
     return SensorInterface::initProperties();
@@ -81,6 +139,10 @@ bool Correlator::updateProperties()
     if (isConnected())
     {
         defineProperty(&CorrelatorSettingsNP);
+        defineProperty(&CorrelatorInputsTP);
+        defineProperty(&CorrelatorPositionsNP);
+        defineProperty(&CorrelatorEngineNP);
+        defineProperty(&VisibilitiesBP);
 
         if (HasCooler())
             defineProperty(&TemperatureNP);
@@ -88,6 +150,10 @@ bool Correlator::updateProperties()
     else
     {
         deleteProperty(CorrelatorSettingsNP.name);
+        deleteProperty(CorrelatorInputsTP.name);
+        deleteProperty(CorrelatorPositionsNP.name);
+        deleteProperty(CorrelatorEngineNP.name);
+        deleteProperty(VisibilitiesBP.name);
 
         if (HasCooler())
             deleteProperty(TemperatureNP.name);
@@ -97,11 +163,32 @@ bool Correlator::updateProperties()
 
 bool Correlator::ISSnoopDevice(XMLEle *root)
 {
+    for (int i = 0; i < CORRELATOR_MAX_INPUTS; i++)
+    {
+        if (CorrelatorInputsT[i].text == nullptr || CorrelatorInputsT[i].text[0] == '\0')
+            continue;
+        if (IUSnoopBLOB(root, &InputBP[i]) != 0)
+            continue;
+        std::vector<double> samples;
+        if (readFITSSamples(InputB[i].blob, InputB[i].bloblen, samples))
+            addInputSamples(i, samples.data(), samples.size());
+        else
+            LOGF_WARN("Unable to read the integration of input %d.", i + 1);
+        return true;
+    }
     return processSnoopDevice(root);
 }
 
 bool Correlator::ISNewText(const char *dev, const char *name, char *values[], char *names[], int n)
 {
+    if (dev && !strcmp(dev, getDeviceName()) && !strcmp(name, CorrelatorInputsTP.name))
+    {
+        IUUpdateText(&CorrelatorInputsTP, values, names, n);
+        snoopInputs();
+        CorrelatorInputsTP.s = IPS_OK;
+        IDSetText(&CorrelatorInputsTP, nullptr);
+        return true;
+    }
     return processText(dev, name, values, names, n);
 }
 
@@ -111,6 +198,19 @@ bool Correlator::ISNewNumber(const char *dev, const char *name, double values[],
     {
         IDSetNumber(&CorrelatorSettingsNP, nullptr);
     }
+    if (dev && !strcmp(dev, getDeviceName()) &&
+            (!strcmp(name, CorrelatorPositionsNP.name) || !strcmp(name, CorrelatorEngineNP.name)))
+    {
+        INumberVectorProperty *nvp = !strcmp(name, CorrelatorPositionsNP.name) ? &CorrelatorPositionsNP :
+                                     &CorrelatorEngineNP;
+        std::lock_guard<std::mutex> lock(EngineLock);
+        IUUpdateNumber(nvp, values, names, n);
+        if (nvp == &CorrelatorEngineNP)
+            resetEngine();
+        nvp->s = IPS_OK;
+        IDSetNumber(nvp, nullptr);
+        return true;
+    }
     return processNumber(dev, name, values, names, n);
 }
 
@@ -231,5 +331,193 @@ void Correlator::setMinMaxStep(const char *property, const char *element, double
             IUUpdateMinMax(nvp);
     }
 }
+
+bool Correlator::saveConfigItems(FILE *fp)
+{
+    SensorInterface::saveConfigItems(fp);
+
+    IUSaveConfigText(fp, &CorrelatorInputsTP);
+    IUSaveConfigNumber(fp, &CorrelatorPositionsNP);
+    IUSaveConfigNumber(fp, &CorrelatorEngineNP);
+
+    return true;
 }
 
+void Correlator::snoopInputs()
+{
+    std::lock_guard<std::mutex> lock(EngineLock);
+    for (int i = 0; i < CORRELATOR_MAX_INPUTS; i++)
+    {
+        free(InputB[i].blob);
+        IUFillBLOB(&InputB[i], "DATA", "Sensor Data Blob", "");
+        IUFillBLOBVector(&InputBP[i], &InputB[i], 1, CorrelatorInputsT[i].text, "SENSOR", "Integration Data", "", IP_RO, 60,
+                         IPS_IDLE);
+        if (CorrelatorInputsT[i].text[0] != '\0')
+        {
+            IDSnoopDevice(CorrelatorInputsT[i].text, "SENSOR");
+            IDSnoopBLOBs(CorrelatorInputsT[i].text, "SENSOR", B_ALSO);
+        }
+        InputActive[i] = false;
+    }
+    resetEngine();
+}
+
+void Correlator::resetEngine()
+{
+    EngineInputs.clear();
+    for (int i = 0; i < CORRELATOR_MAX_INPUTS; i++)
+    {
+        InputSamples[i].clear();
+        if (InputActive[i])
+            EngineInputs.push_back(i);
+    }
+    int bins      = (static_cast<int>(CorrelatorEngineN[CORRELATOR_ENGINE_SIZE].value) & ~1) / 2 + 1;
+    int baselines = EngineInputs.size() * (EngineInputs.size() - 1) / 2;
+    EngineCrosses.assign(baselines, std::vector<double>(bins * 2, 0.0));
+    EnginePowers.assign(EngineInputs.size(), std::vector<double>(bins, 0.0));
+    EngineTransforms = 0;
+    EngineStart      = std::chrono::steady_clock::now();
+}
+
+void Correlator::addInputSamples(int input, const double *samples, int count)
+{
+    if (input < 0 || input >= CORRELATOR_MAX_INPUTS || count <= 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(EngineLock);
+    if (!InputActive[input])
+    {
+        // The baselines change, the samples of the others may not line up with the ones of the new input
+        InputActive[input] = true;
+        resetEngine();
+    }
+    InputSamples[input].insert(InputSamples[input].end(), samples, samples + count);
+    if (EngineInputs.size() < 2)
+        return;
+
+    int size = static_cast<int>(CorrelatorEngineN[CORRELATOR_ENGINE_SIZE].value) & ~1;
+    size_t common = InputSamples[EngineInputs[0]].size();
+    for (int i : EngineInputs)
+        common = std::min(common, InputSamples[i].size());
+    if (common < static_cast<size_t>(size))
+        return;
+
+    std::vector<const double *> inputs;
+    for (int i : EngineInputs)
+        inputs.push_back(InputSamples[i].data());
+    std::vector<complex_t *> crosses;
+    for (auto &cross : EngineCrosses)
+        crosses.push_back(reinterpret_cast<complex_t *>(cross.data()));
+    std::vector<double *> powers;
+    for (auto &power : EnginePowers)
+        powers.push_back(power.data());
+    int transforms = dsp_fourier_cross_spectra(inputs.data(), inputs.size(), common, size, crosses.data(), powers.data());
+    EngineTransforms += transforms;
+    for (int i : EngineInputs)
+        InputSamples[i].erase(InputSamples[i].begin(), InputSamples[i].begin() + static_cast<size_t>(transforms) * size);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - EngineStart;
+    if (EngineTransforms > 0 && elapsed.count() >= CorrelatorEngineN[CORRELATOR_ENGINE_CADENCE].value)
+        publishVisibilities();
+}
+
+void Correlator::publishVisibilities()
+{
+    int count     = EngineInputs.size();
+    int bins      = EnginePowers[0].size();
+    int baselines = EngineCrosses.size();
+
+    // The averaged cross spectra, real and imaginary parts of each bin of each baseline
+    std::vector<double> visibilities(static_cast<size_t>(baselines) * bins * 2);
+    for (int b = 0; b < baselines; b++)
+        for (int k = 0; k < bins * 2; k++)
+            visibilities[static_cast<size_t>(b) * bins * 2 + k] = EngineCrosses[b][k] / EngineTransforms;
+
+    fitsfile *fptr = nullptr;
+    size_t memsize = 5760;
+    void *memptr   = malloc(memsize);
+    int status     = 0;
+    long naxes[3]  = { 2, bins, baselines };
+    char error_status[MAXRBUF];
+
+    fits_create_memfile(&fptr, &memptr, &memsize, 2880, realloc, &status);
+    if (status == 0)
+        fits_create_img(fptr, DOUBLE_IMG, 3, naxes, &status);
+    if (status == 0)
+    {
+        double binWidth = bandwidth / (bins - 1);
+        int averaged    = EngineTransforms;
+        fits_update_key(fptr, TDOUBLE, "CDELT2", &binWidth, const_cast<char *>("Width of the bins (Hz)"), &status);
+        fits_update_key(fptr, TINT, "NAVERAGE", &averaged, const_cast<char *>("Averaged transforms"), &status);
+
+        double lst = get_local_sidereal_time(Longitude);
+        double ha  = get_local_hour_angle(lst, RA);
+        int b      = 0;
+        for (int j = 1; j < count; j++)
+        {
+            for (int i = 0; i < j; i++, b++)
+            {
+                int first = EngineInputs[i], second = EngineInputs[j];
+                Baseline pair;
+                for (int axis = 0; axis < 3; axis++)
+                    pair.values[axis] = CorrelatorPositionsN[second * 3 + axis].value -
+                                        CorrelatorPositionsN[first * 3 + axis].value;
+                UVCoordinate uv;
+                baseline_2d_projection(Dec, ha * 15, pair.values, wavelength, uv.values);
+
+                // Degree of correlation over the band, without the constant term
+                double real = 0, imaginary = 0;
+                for (int k = 1; k < bins; k++)
+                {
+                    real      += EngineCrosses[b][k * 2];
+                    imaginary += EngineCrosses[b][k * 2 + 1];
+                }
+                double firstPower = 0, secondPower = 0;
+                for (int k = 1; k < bins; k++)
+                {
+                    firstPower  += EnginePowers[i][k];
+                    secondPower += EnginePowers[j][k];
+                }
+                double coefficient = (firstPower > 0 && secondPower > 0) ?
+                                     sqrt(real * real + imaginary * imaginary) / sqrt(firstPower * secondPower) : 0.0;
+                if (b == 0)
+                    correlationDegree = coefficient;
+
+                char key[FLEN_KEYWORD];
+                snprintf(key, sizeof(key), "U%d_%d", first + 1, second + 1);
+                fits_update_key(fptr, TDOUBLE, key, &uv.u, const_cast<char *>("Baseline U"), &status);
+                snprintf(key, sizeof(key), "V%d_%d", first + 1, second + 1);
+                fits_update_key(fptr, TDOUBLE, key, &uv.v, const_cast<char *>("Baseline V"), &status);
+                snprintf(key, sizeof(key), "C%d_%d", first + 1, second + 1);
+                fits_update_key(fptr, TDOUBLE, key, &coefficient, const_cast<char *>("Degree of correlation"), &status);
+            }
+        }
+        fits_write_img(fptr, TDOUBLE, 1, visibilities.size(), visibilities.data(), &status);
+    }
+    if (status == 0)
+        fits_close_file(fptr, &status);
+
+    if (status)
+    {
+        fits_get_errstatus(status, error_status);
+        DEBUGF(Logger::DBG_ERROR, "FITS Error: %s", error_status);
+    }
+    else
+    {
+        VisibilitiesB.blob    = memptr;
+        VisibilitiesB.bloblen = VisibilitiesB.size = memsize;
+        strcpy(VisibilitiesB.format, ".fits");
+        VisibilitiesBP.s = IPS_OK;
+        IDSetBLOB(&VisibilitiesBP, nullptr);
+        VisibilitiesB.blob = nullptr;
+    }
+    free(memptr);
+
+    for (auto &cross : EngineCrosses)
+        std::fill(cross.begin(), cross.end(), 0.0);
+    for (auto &power : EnginePowers)
+        std::fill(power.begin(), power.end(), 0.0);
+    EngineTransforms = 0;
+    EngineStart      = std::chrono::steady_clock::now();
+}
+}
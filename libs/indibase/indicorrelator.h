@@ -34,6 +34,7 @@
 #include <stdint.h>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 //JM 2019-01-17: Disabled until further notice
 //#define WITH_EXPOSURE_LOOPING
@@ -121,14 +122,28 @@ class Correlator : public SensorInterface
         bool ISSnoopDevice(XMLEle *root) override;
 
         virtual bool StartIntegration(double duration) override;
+        virtual bool saveConfigItems(FILE *fp) override;
+
+        /**
+         * @brief addInputSamples Feed the samples of one input to the correlation engine.
+         * The engine cuts the samples of the inputs into transforms, multiplies the spectra of each
+         * pair of inputs and publishes the averaged cross spectra on the CORRELATOR_VISIBILITIES BLOB
+         * once per cadence. The inputs are the telescopes that have received samples, which must have
+         * been taken at the same times; the engine starts over when an input joins. The samples of
+         * the inputs named in CORRELATOR_INPUTS are fed from the integrations they upload.
+         * @param input the index of the input, from 0 to CORRELATOR_MAX_INPUTS - 1.
+         * @param samples the samples.
+         * @param count the number of samples.
+         */
+        void addInputSamples(int input, const double *samples, int count);
 
         /**
          * @brief getCorrelationDegree Get current correlation degree.
-         * @return the correlation coefficient.
+         * @return the correlation coefficient of the first baseline of the correlation engine, as last published.
          */
         virtual inline double getCorrelationDegree()
         {
-            return 0.0;
+            return correlationDegree;
         }
 
         /**
@@ -276,10 +291,47 @@ class Correlator : public SensorInterface
         } CORRELATOR_INFO_INDEX;
         INumberVectorProperty CorrelatorSettingsNP;
 
+        enum
+        {
+            CORRELATOR_MAX_INPUTS = 4,
+        };
+        typedef enum
+        {
+            CORRELATOR_ENGINE_SIZE = 0,
+            CORRELATOR_ENGINE_CADENCE,
+        } CORRELATOR_ENGINE_INDEX;
+        ITextVectorProperty CorrelatorInputsTP;
+        IText CorrelatorInputsT[CORRELATOR_MAX_INPUTS];
+        INumberVectorProperty CorrelatorPositionsNP;
+        INumber CorrelatorPositionsN[CORRELATOR_MAX_INPUTS * 3];
+        INumberVectorProperty CorrelatorEngineNP;
+        INumber CorrelatorEngineN[2];
+        IBLOBVectorProperty VisibilitiesBP;
+        IBLOB VisibilitiesB;
+
     private:
         Baseline baseline;
         double wavelength;
         double bandwidth;
         INumber CorrelatorSettingsN[5];
+
+        void snoopInputs();
+        void resetEngine();
+        void publishVisibilities();
+
+        // The integrations uploaded by the inputs
+        IBLOBVectorProperty InputBP[CORRELATOR_MAX_INPUTS] {};
+        IBLOB InputB[CORRELATOR_MAX_INPUTS] {};
+
+        // Correlation engine state, fed from the snooped integrations or from the driver
+        std::mutex EngineLock;
+        std::vector<double> InputSamples[CORRELATOR_MAX_INPUTS];
+        bool InputActive[CORRELATOR_MAX_INPUTS] {};
+        std::vector<int> EngineInputs;
+        std::vector<std::vector<double>> EngineCrosses;
+        std::vector<std::vector<double>> EnginePowers;
+        int EngineTransforms { 0 };
+        std::chrono::steady_clock::time_point EngineStart;
+        double correlationDegree { 0.0 };
 };
 }
@@ -27,6 +27,7 @@
 #include "inditimer.h"
 
 #include <string>
+#include <vector>
 
 // Defines a point in a 3 dimension space
 typedef struct
@@ -500,6 +501,14 @@ class Dome : public DefaultDevice
              */
         bool CheckHorizon(double HA, double dec, double lat);
 
+        /**
+             * @brief setGeometryLookup Let GetTargetAz interpolate where the optical axis meets the dome in grids
+             * precomputed over hour angle and declination, instead of solving it on each mount update.
+             * The grids are computed again once the measurements or the latitude change.
+             * @param enabled True to use the grids, false to solve each position (default).
+             */
+        void setGeometryLookup(bool enabled);
+
         /**
              * @brief saveConfigItems Saves the Device Port and Dome Presets in the configuration file
              * @param fp pointer to configuration file
@@ -626,17 +635,19 @@ class Dome : public DefaultDevice
     private:
         void processButton(const char * button_n, ISState state);
         void triggerSnoop(const char * driverName, const char * propertyName);
+
+        // Handlers of the snooped properties of the active mount, previous is the mount snooped before
+        void watchMount(const char * previous);
+        bool snoopMountTarget(XMLEle * root);
+        bool snoopMountCoords(XMLEle * root);
+        bool snoopMountLocation(XMLEle * root);
+        bool snoopMountPark(XMLEle * root);
+        bool snoopMountPierSide(XMLEle * root);
         /**
          * @brief SyncParkStatus Update the state and switches for parking
          * @param isparked True if parked, false otherwise.
          */
         void SyncParkStatus(bool isparked);
-        /**
-         * @brief LoadParkXML Read and process park XML data.
-         * @return error string if there is problem opening the file
-         */
-        const char * LoadParkXML();
-
         /**
          * @brief Validate a file name
          * @param file_name File name
@@ -644,6 +655,29 @@ class Dome : public DefaultDevice
          */
         std::string GetHomeDirectory() const;
 
+        /**
+         * @brief DomeIntersection Point where the optical axis, pointing at Az and Alt, meets the dome.
+         * @return false if the geometry has no solution.
+         */
+        bool DomeIntersection(point3D MountCenter, double dOpticalAxis, double hourAngle, double Az, double Alt,
+                              point3D &intersect);
+
+        /**
+         * @brief LookupIntersection Interpolates DomeIntersection in the grid of OTASide, computing it first if needed.
+         * @return false if the grid has no solution around hourAngle and dec.
+         */
+        bool LookupIntersection(double hourAngle, double dec, int OTASide, point3D &intersect);
+
+        // Dome intersections of the optical axis over hour angle and declination, for one OTA side
+        struct GeometryGrid
+        {
+            std::vector<float> points;  // x, y, z per node, NaN where the optical axis misses the dome
+            double key[6] {};           // Measurements and latitude the grid was computed for
+        };
+        // Index is OTASide + 1
+        GeometryGrid m_GeometryGrids[3];
+        bool m_GeometryLookup = false;
+
         Controller * controller = nullptr;
 
         bool IsParked = false;
@@ -652,11 +686,9 @@ class Dome : public DefaultDevice
         bool AutoSyncWarning = false;
         bool UseHourAngle = false;
 
-        const char * ParkDeviceName;
         const std::string ParkDataFileName;
         INDI::Timer m_MountUpdateTimer;
         //int m_HorizontalUpdateTimerID { -1 };
-        XMLEle * ParkdataXmlRoot, *ParkdeviceXml, *ParkstatusXml, *ParkpositionXml, *ParkpositionAxis1Xml;
 
         double Axis1ParkPosition;
         double Axis1DefaultParkPosition;
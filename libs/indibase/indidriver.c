@@ -27,14 +27,19 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include "indidriver.h"
 
 #include "base64.h"
+#include "eventloop.h"
 #include "indicom.h"
 #include "indidevapi.h"
 #include "locale_compat.h"
+#include "sharedblob.h"
+#include "indiutility.h"
+#include "inditrace.h"
 
 #include <errno.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
@@ -45,6 +50,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include "userio.h"
 #include "indiuserio.h"
 #include "indidriverio.h"
+#include "indiframe.h"
 
 int verbose;      /* chatty */
 char *me = "";  /* a.out name */
@@ -64,7 +70,9 @@ INDI_UNKNOWN
 
 extern void waitPingReply(const char *);
 
-// TODO use fast map
+/* called for a getProperties of a property not defined yet */
+static IDGetPropertyHandler *getPropertyHandler = NULL;
+
 /* insure RO properties are never modified. RO Sanity Check */
 typedef struct {
     char propName[MAXINDINAME];
@@ -72,6 +80,7 @@ typedef struct {
     IPerm perm;
     const void *ptr;
     int type;
+    int frameId; /* id of the last INDI_FRAME_DEFNUMBER sent, 0 if none */
 } ROSC;
 
 static pthread_mutex_t rosc_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -79,6 +88,32 @@ static pthread_mutex_t rosc_mutex = PTHREAD_MUTEX_INITIALIZER;
 static ROSC *propCache = NULL;
 static int nPropCache = 0; /* # of elements in roCheck */
 
+/* open addressing index of propCache by (device, property), slots hold index + 1 */
+static int *roscIndex = NULL;
+static unsigned roscIndexSize = 0; /* power of 2 */
+
+static unsigned rosc_hash(const char *propName, const char *devName)
+{
+    /* FNV-1a */
+    unsigned h = 2166136261u;
+    for (const char *p = devName; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    h = (h ^ 0xff) * 16777619u;
+    for (const char *p = propName; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    return h;
+}
+
+static void rosc_index_insert(int i)
+{
+    unsigned mask = roscIndexSize - 1;
+    unsigned slot = rosc_hash(propCache[i].propName, propCache[i].devName) & mask;
+
+    while (roscIndex[slot] != 0)
+        slot = (slot + 1) & mask;
+    roscIndex[slot] = i + 1;
+}
+
 static ROSC *rosc_new()
 {
     assert_mem(propCache = (ROSC *)(realloc(propCache, (nPropCache + 1) * sizeof *propCache)));
@@ -93,14 +128,34 @@ static void rosc_add(const char *propName, const char *devName, IPerm perm, cons
     SC->perm = perm;
     SC->ptr  = ptr;
     SC->type = type;
+    SC->frameId = 0;
+
+    /* keep the index at most half full */
+    if ((unsigned)nPropCache * 2 > roscIndexSize)
+    {
+        free(roscIndex);
+        roscIndexSize = roscIndexSize ? roscIndexSize * 2 : 64;
+        assert_mem(roscIndex = (int *)calloc(roscIndexSize, sizeof *roscIndex));
+        for (int i = 0; i < nPropCache; i++)
+            rosc_index_insert(i);
+    }
+    else
+        rosc_index_insert(nPropCache - 1);
 }
 
 /* Return pointer of property if already cached, NULL otherwise */
 static ROSC *rosc_find(const char *propName, const char *devName)
 {
-    for (int i = 0; i < nPropCache; i++)
-        if (!strcmp(propName, propCache[i].propName) && !strcmp(devName, propCache[i].devName))
-            return &propCache[i];
+    if (roscIndexSize == 0)
+        return NULL;
+
+    unsigned mask = roscIndexSize - 1;
+    for (unsigned slot = rosc_hash(propName, devName) & mask; roscIndex[slot] != 0; slot = (slot + 1) & mask)
+    {
+        ROSC *SC = &propCache[roscIndex[slot] - 1];
+        if (!strcmp(propName, SC->propName) && !strcmp(devName, SC->devName))
+            return SC;
+    }
 
     return NULL;
 }
@@ -115,11 +170,419 @@ static void rosc_add_unique(const char *propName, const char *devName, IPerm per
     pthread_mutex_unlock(&rosc_mutex);
 }
 
+/* optional update filters for IDSetNumber, set with IDSetNumberPolicy */
+typedef struct {
+    char propName[MAXINDINAME];
+    char devName[MAXINDIDEVICE];
+    int minPeriodMs;
+    int skipIdentical;
+    int sent;            /* something was sent since the policy was set */
+    IPState state;       /* last sent */
+    double *values;
+    int nvalues;
+    struct timespec when;
+} NumberPolicy;
+
+static pthread_mutex_t policy_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static NumberPolicy *numberPolicies = NULL;
+static int nNumberPolicies = 0;
+
+static NumberPolicy *policy_find(const char *propName, const char *devName)
+{
+    for (int i = 0; i < nNumberPolicies; i++)
+        if (!strcmp(propName, numberPolicies[i].propName) && !strcmp(devName, numberPolicies[i].devName))
+            return &numberPolicies[i];
+
+    return NULL;
+}
+
+void IDSetNumberPolicy(const char *dev, const char *name, int minPeriodMs, int skipIdentical)
+{
+    pthread_mutex_lock(&policy_mutex);
+
+    NumberPolicy *policy = policy_find(name, dev);
+    if (policy == NULL)
+    {
+        assert_mem(numberPolicies = (NumberPolicy *)realloc(numberPolicies, (nNumberPolicies + 1) * sizeof *numberPolicies));
+        policy = &numberPolicies[nNumberPolicies++];
+        memset(policy, 0, sizeof *policy);
+        indi_strlcpy(policy->propName, name, MAXINDINAME);
+        indi_strlcpy(policy->devName, dev, MAXINDIDEVICE);
+    }
+    policy->minPeriodMs   = minPeriodMs;
+    policy->skipIdentical = skipIdentical;
+    policy->sent          = 0;
+
+    pthread_mutex_unlock(&policy_mutex);
+}
+
+/* Return 1 if the update must be sent, and record it as the last one in that case */
+static int policy_accept(const INumberVectorProperty *nvp, const char *fmt)
+{
+    int send = 1;
+    struct timespec now;
+
+    pthread_mutex_lock(&policy_mutex);
+
+    NumberPolicy *policy = policy_find(nvp->name, nvp->device);
+    if (policy == NULL || (policy->minPeriodMs <= 0 && !policy->skipIdentical))
+    {
+        pthread_mutex_unlock(&policy_mutex);
+        return 1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (fmt == NULL && policy->sent && nvp->s == policy->state && nvp->nnp == policy->nvalues)
+    {
+        long elapsed = (now.tv_sec - policy->when.tv_sec) * 1000 + (now.tv_nsec - policy->when.tv_nsec) / 1000000;
+
+        if (policy->minPeriodMs > 0 && elapsed < policy->minPeriodMs)
+            send = 0;
+        else if (policy->skipIdentical)
+        {
+            send = 0;
+            for (int i = 0; i < nvp->nnp && !send; i++)
+                send = nvp->np[i].value != policy->values[i];
+        }
+    }
+
+    if (send)
+    {
+        if (policy->nvalues != nvp->nnp)
+        {
+            assert_mem(policy->values = (double *)realloc(policy->values, (nvp->nnp + 1) * sizeof *policy->values));
+            policy->nvalues = nvp->nnp;
+        }
+        for (int i = 0; i < nvp->nnp; i++)
+            policy->values[i] = nvp->np[i].value;
+        policy->state = nvp->s;
+        policy->when  = now;
+        policy->sent  = 1;
+    }
+
+    pthread_mutex_unlock(&policy_mutex);
+    return send;
+}
+
+/* Snoops on the devices of this process, delivered in memory. See IDLocalDevice */
+typedef struct {
+    char devName[MAXINDIDEVICE];
+    char propName[MAXINDINAME]; /* empty for all the properties of the device */
+    BLOBHandling blobs;
+} LocalSnoop;
+
+static pthread_mutex_t local_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char (*localDevices)[MAXINDIDEVICE] = NULL;
+static int nLocalDevices = 0;
+static LocalSnoop *localSnoops = NULL;
+static int nLocalSnoops = 0;
+
+/* with local_mutex held */
+static int local_device_find(const char *dev)
+{
+    for (int i = 0; i < nLocalDevices; i++)
+        if (!strcmp(localDevices[i], dev))
+            return 1;
+
+    return 0;
+}
+
+void IDLocalDevice(const char *dev)
+{
+    pthread_mutex_lock(&local_mutex);
+
+    if (!local_device_find(dev))
+    {
+        assert_mem(localDevices = realloc(localDevices, (nLocalDevices + 1) * sizeof *localDevices));
+        indi_strlcpy(localDevices[nLocalDevices++], dev, MAXINDIDEVICE);
+    }
+
+    pthread_mutex_unlock(&local_mutex);
+}
+
+/* true if dev is run by this process */
+static int local_device(const char *dev)
+{
+    if (nLocalDevices == 0)
+        return 0;
+
+    pthread_mutex_lock(&local_mutex);
+    int local = local_device_find(dev);
+    pthread_mutex_unlock(&local_mutex);
+    return local;
+}
+
+/* snoop on dev/name in memory if dev is run by this process. 0 if it must be asked to indiserver */
+static int local_snoop(const char *dev, const char *name)
+{
+    if (nLocalDevices == 0)
+        return 0;
+
+    pthread_mutex_lock(&local_mutex);
+
+    int local = local_device_find(dev);
+    if (local)
+    {
+        if (name == NULL)
+            name = "";
+
+        int i = 0;
+        while (i < nLocalSnoops && (strcmp(localSnoops[i].devName, dev) || strcmp(localSnoops[i].propName, name)))
+            i++;
+        if (i == nLocalSnoops)
+        {
+            assert_mem(localSnoops = realloc(localSnoops, (nLocalSnoops + 1) * sizeof *localSnoops));
+            LocalSnoop *snoop = &localSnoops[nLocalSnoops];
+            indi_strlcpy(snoop->devName, dev, MAXINDIDEVICE);
+            indi_strlcpy(snoop->propName, name, MAXINDINAME);
+            snoop->blobs = B_NEVER;
+            nLocalSnoops++;
+        }
+    }
+
+    pthread_mutex_unlock(&local_mutex);
+    return local;
+}
+
+/* as IDSnoopBLOBs, for the local snoops on dev/name. 0 if there are none */
+static int local_snoop_blobs(const char *dev, const char *name, BLOBHandling bh)
+{
+    if (nLocalSnoops == 0)
+        return 0;
+
+    pthread_mutex_lock(&local_mutex);
+
+    int found = 0;
+    for (int i = 0; i < nLocalSnoops; i++)
+    {
+        LocalSnoop *snoop = &localSnoops[i];
+        if (strcmp(snoop->devName, dev) || (name && name[0] && snoop->propName[0] && strcmp(snoop->propName, name)))
+            continue;
+        snoop->blobs = bh;
+        found = 1;
+    }
+
+    pthread_mutex_unlock(&local_mutex);
+    return found;
+}
+
+/* true if a local snoop wants the message of dev/name, all properties of dev if name is NULL */
+static int local_wanted(const char *dev, const char *name, int isBLOB)
+{
+    if (nLocalSnoops == 0)
+        return 0;
+
+    pthread_mutex_lock(&local_mutex);
+
+    int wanted = 0;
+    for (int i = 0; i < nLocalSnoops && !wanted; i++)
+    {
+        const LocalSnoop *snoop = &localSnoops[i];
+        if (strcmp(snoop->devName, dev) || (name && snoop->propName[0] && strcmp(snoop->propName, name)))
+            continue;
+        wanted = isBLOB ? snoop->blobs != B_NEVER : snoop->blobs != B_ONLY;
+    }
+
+    pthread_mutex_unlock(&local_mutex);
+    return wanted;
+}
+
+static void local_deliver_cb(void *root)
+{
+    ISSnoopDevice((XMLEle *)root);
+    delXMLEle((XMLEle *)root);
+}
+
+/* hand root to the devices of this process from the event loop, as if indiserver had sent it */
+static void local_deliver(XMLEle *root)
+{
+    postToEventLoop(local_deliver_cb, root);
+}
+
+static void local_get_properties_cb(void *dev)
+{
+    ISGetProperties((const char *)dev);
+    free(dev);
+}
+
+static XMLEle *local_vector(const char *tag, const char *dev, const char *name, const char *fmt, va_list ap)
+{
+    XMLEle *root = addXMLEle(NULL, tag);
+    addXMLAtt(root, "device", dev);
+    if (name && name[0])
+        addXMLAtt(root, "name", name);
+    addXMLAtt(root, "timestamp", indi_timestamp());
+
+    if (fmt)
+    {
+        char message[MAXINDIMESSAGE];
+        vsnprintf(message, sizeof message, fmt, ap);
+        addXMLAtt(root, "message", message);
+    }
+    return root;
+}
+
+/* the attributes of a defXXXVector, after those of local_vector */
+static void local_def_vector(XMLEle *root, const char *label, const char *group, IPState s, IPerm p, double timeout)
+{
+    char value[32];
+
+    addXMLAtt(root, "label", label);
+    addXMLAtt(root, "group", group);
+    addXMLAtt(root, "state", pstateStr(s));
+    if (p != (IPerm)-1)
+        addXMLAtt(root, "perm", permStr(p));
+    snprintf(value, sizeof value, "%g", timeout);
+    addXMLAtt(root, "timeout", value);
+}
+
+static XMLEle *local_member(XMLEle *root, const char *tag, const char *name, const char *label)
+{
+    XMLEle *ep = addXMLEle(root, tag);
+    addXMLAtt(ep, "name", name);
+    if (label)
+        addXMLAtt(ep, "label", label);
+    return ep;
+}
+
+static void local_text(const ITextVectorProperty *tvp, int def, const char *fmt, va_list ap)
+{
+    XMLEle *root = local_vector(def ? "defTextVector" : "setTextVector", tvp->device, tvp->name, fmt, ap);
+    if (def)
+        local_def_vector(root, tvp->label, tvp->group, tvp->s, tvp->p, tvp->timeout);
+    else
+        addXMLAtt(root, "state", pstateStr(tvp->s));
+
+    for (int i = 0; i < tvp->ntp; i++)
+    {
+        XMLEle *ep = local_member(root, def ? "defText" : "oneText", tvp->tp[i].name, def ? tvp->tp[i].label : NULL);
+        editXMLEle(ep, tvp->tp[i].text ? tvp->tp[i].text : "");
+    }
+
+    local_deliver(root);
+}
+
+static void local_number(const INumberVectorProperty *nvp, int def, const char *fmt, va_list ap)
+{
+    char value[32];
+
+    XMLEle *root = local_vector(def ? "defNumberVector" : "setNumberVector", nvp->device, nvp->name, fmt, ap);
+    if (def)
+        local_def_vector(root, nvp->label, nvp->group, nvp->s, nvp->p, nvp->timeout);
+    else
+        addXMLAtt(root, "state", pstateStr(nvp->s));
+
+    for (int i = 0; i < nvp->nnp; i++)
+    {
+        const INumber *np = &nvp->np[i];
+        XMLEle *ep = local_member(root, def ? "defNumber" : "oneNumber", np->name, def ? np->label : NULL);
+        if (def)
+        {
+            addXMLAtt(ep, "format", np->format);
+            snprintf(value, sizeof value, "%.20g", np->min);
+            addXMLAtt(ep, "min", value);
+            snprintf(value, sizeof value, "%.20g", np->max);
+            addXMLAtt(ep, "max", value);
+            snprintf(value, sizeof value, "%.20g", np->step);
+            addXMLAtt(ep, "step", value);
+        }
+        /* in full, the snooper does not need the format of the driver */
+        snprintf(value, sizeof value, "%.20g", np->value);
+        editXMLEle(ep, value);
+    }
+
+    local_deliver(root);
+}
+
+static void local_switch(const ISwitchVectorProperty *svp, int def, const char *fmt, va_list ap)
+{
+    XMLEle *root = local_vector(def ? "defSwitchVector" : "setSwitchVector", svp->device, svp->name, fmt, ap);
+    if (def)
+    {
+        local_def_vector(root, svp->label, svp->group, svp->s, svp->p, svp->timeout);
+        addXMLAtt(root, "rule", ruleStr(svp->r));
+    }
+    else
+        addXMLAtt(root, "state", pstateStr(svp->s));
+
+    for (int i = 0; i < svp->nsp; i++)
+    {
+        XMLEle *ep = local_member(root, def ? "defSwitch" : "oneSwitch", svp->sp[i].name, def ? svp->sp[i].label : NULL);
+        editXMLEle(ep, sstateStr(svp->sp[i].s));
+    }
+
+    local_deliver(root);
+}
+
+static void local_light(const ILightVectorProperty *lvp, int def, const char *fmt, va_list ap)
+{
+    XMLEle *root = local_vector(def ? "defLightVector" : "setLightVector", lvp->device, lvp->name, fmt, ap);
+    if (def)
+        local_def_vector(root, lvp->label, lvp->group, lvp->s, (IPerm)-1, 0);
+    else
+        addXMLAtt(root, "state", pstateStr(lvp->s));
+
+    for (int i = 0; i < lvp->nlp; i++)
+    {
+        XMLEle *ep = local_member(root, def ? "defLight" : "oneLight", lvp->lp[i].name, def ? lvp->lp[i].label : NULL);
+        editXMLEle(ep, pstateStr(lvp->lp[i].s));
+    }
+
+    local_deliver(root);
+}
+
+static void local_blob(const IBLOBVectorProperty *bvp, int def, const char *fmt, va_list ap)
+{
+    char value[32];
+
+    XMLEle *root = local_vector(def ? "defBLOBVector" : "setBLOBVector", bvp->device, bvp->name, fmt, ap);
+    if (def)
+        local_def_vector(root, bvp->label, bvp->group, bvp->s, bvp->p, bvp->timeout);
+    else
+        addXMLAtt(root, "state", pstateStr(bvp->s));
+
+    for (int i = 0; i < bvp->nbp; i++)
+    {
+        const IBLOB *bp = &bvp->bp[i];
+        XMLEle *ep = local_member(root, def ? "defBLOB" : "oneBLOB", bp->name, def ? bp->label : NULL);
+        if (def)
+            continue;
+
+        /* ISSnoopDevice takes BLOBs as they arrive from indiserver, in base64 */
+        size_t enclen = 4 * ((size_t)bp->bloblen / 3 + 1) + 1;
+        char *encoded;
+        assert_mem(encoded = malloc(enclen));
+        int n = bp->blob ? to64frombits_s((unsigned char *)encoded, bp->blob, bp->bloblen, enclen) : 0;
+        encoded[n] = '\0';
+
+        snprintf(value, sizeof value, "%d", bp->size);
+        addXMLAtt(ep, "size", value);
+        snprintf(value, sizeof value, "%d", n);
+        addXMLAtt(ep, "enclen", value);
+        addXMLAtt(ep, "format", bp->format);
+        editXMLEle(ep, encoded);
+        free(encoded);
+    }
+
+    local_deliver(root);
+}
+
 /* tell Client to delete the property with given name on given device, or
  * entire device if !name
  */
 void IDDeleteVA(const char *dev, const char *name, const char *fmt, va_list ap)
 {
+    if (local_wanted(dev, name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_deliver(local_vector("delProperty", dev, name, fmt, lap));
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -145,6 +608,13 @@ void IDSnoopDevice(const char *snooped_device, const char *snooped_property)
     // Ignore empty snooped device
     if (snooped_device && snooped_device[0])
     {
+        // As indiserver would, ask the device to define its properties again, this time for us too
+        if (local_snoop(snooped_device, snooped_property))
+        {
+            postToEventLoop(local_get_properties_cb, strdup(snooped_device));
+            return;
+        }
+
         driverio io;
         driverio_init(&io);
 
@@ -155,6 +625,51 @@ void IDSnoopDevice(const char *snooped_device, const char *snooped_property)
     }
 }
 
+/* tell indiserver we want the given device/property only when it changes beyond threshold,
+ * or when we ask for it with IDSnoopRequest.
+ */
+void IDSnoopDeviceLatest(const char *snooped_device, const char *snooped_property, double threshold)
+{
+    if (snooped_device && snooped_device[0])
+    {
+        // Every change is passed in memory, there is no latest value to keep
+        if (local_snoop(snooped_device, snooped_property))
+        {
+            postToEventLoop(local_get_properties_cb, strdup(snooped_device));
+            return;
+        }
+
+        driverio io;
+        driverio_init(&io);
+
+        userio_xmlv1(&io.userio, io.user);
+        IUUserIOGetPropertiesSnoop(&io.userio, io.user, snooped_device, snooped_property, "latest", threshold);
+
+        driverio_finish(&io);
+    }
+}
+
+/* ask indiserver for the latest value of the given device/property, snooped with IDSnoopDeviceLatest.
+ * name ignored if NULL or empty.
+ */
+void IDSnoopRequest(const char *snooped_device, const char *snooped_property)
+{
+    if (snooped_device && snooped_device[0])
+    {
+        // Local snoops already have the latest value
+        if (local_device(snooped_device))
+            return;
+
+        driverio io;
+        driverio_init(&io);
+
+        userio_xmlv1(&io.userio, io.user);
+        IUUserIOGetPropertiesSnoop(&io.userio, io.user, snooped_device, snooped_property, "pull", 0);
+
+        driverio_finish(&io);
+    }
+}
+
 /* tell indiserver whether we want BLOBs from the given snooped device.
  * silently ignored if given device is not already registered for snooping.
  */
@@ -162,6 +677,9 @@ void IDSnoopBLOBs(const char *snooped_device, const char *snooped_property, BLOB
 {
     if (snooped_device && snooped_device[0])
     {
+        if (local_snoop_blobs(snooped_device, snooped_property, bh))
+            return;
+
         driverio io;
         driverio_init(&io);
 
@@ -177,16 +695,79 @@ void IDSnoopBLOBs(const char *snooped_device, const char *snooped_property, BLOB
  * return 0 if ok else -1 with reason in msg[].
  * N.B. exit if getProperties does not proclaim a compatible version.
  */
+enum
+{
+    TAG_UNKNOWN,
+    TAG_GET_PROPERTIES,
+    TAG_NEW_NUMBER,
+    TAG_NEW_SWITCH,
+    TAG_NEW_TEXT,
+    TAG_NEW_BLOB,
+    TAG_SNOOPED /* set/def vectors, message and delProperty */
+};
+
+/* classify a root tag, switching on its characters instead of trying every name */
+static int tagKind(const char *tag)
+{
+    switch (tag[0])
+    {
+        case 'n':
+            if (strncmp(tag, "new", 3))
+                break;
+            switch (tag[3])
+            {
+                case 'N':
+                    return !strcmp(tag + 3, "NumberVector") ? TAG_NEW_NUMBER : TAG_UNKNOWN;
+                case 'S':
+                    return !strcmp(tag + 3, "SwitchVector") ? TAG_NEW_SWITCH : TAG_UNKNOWN;
+                case 'T':
+                    return !strcmp(tag + 3, "TextVector") ? TAG_NEW_TEXT : TAG_UNKNOWN;
+                case 'B':
+                    return !strcmp(tag + 3, "BLOBVector") ? TAG_NEW_BLOB : TAG_UNKNOWN;
+            }
+            break;
+
+        case 's':
+        case 'd':
+            if (!strcmp(tag, "delProperty"))
+                return TAG_SNOOPED;
+            if (strncmp(tag, "set", 3) && strncmp(tag, "def", 3))
+                break;
+            switch (tag[3])
+            {
+                case 'N':
+                    return !strcmp(tag + 3, "NumberVector") ? TAG_SNOOPED : TAG_UNKNOWN;
+                case 'S':
+                    return !strcmp(tag + 3, "SwitchVector") ? TAG_SNOOPED : TAG_UNKNOWN;
+                case 'T':
+                    return !strcmp(tag + 3, "TextVector") ? TAG_SNOOPED : TAG_UNKNOWN;
+                case 'L':
+                    return !strcmp(tag + 3, "LightVector") ? TAG_SNOOPED : TAG_UNKNOWN;
+                case 'B':
+                    return !strcmp(tag + 3, "BLOBVector") ? TAG_SNOOPED : TAG_UNKNOWN;
+            }
+            break;
+
+        case 'g':
+            return !strcmp(tag, "getProperties") ? TAG_GET_PROPERTIES : TAG_UNKNOWN;
+
+        case 'm':
+            return !strcmp(tag, "message") ? TAG_SNOOPED : TAG_UNKNOWN;
+    }
+    return TAG_UNKNOWN;
+}
+
 int dispatch(XMLEle *root, char msg[])
 {
     char *rtag = tagXMLEle(root);
+    int kind   = tagKind(rtag);
     XMLEle *ep;
     int n;
 
     if (verbose)
         prXMLEle(stderr, root, 0);
 
-    if (!strcmp(rtag, "getProperties"))
+    if (kind == TAG_GET_PROPERTIES)
     {
         XMLAtt *ap, *name, *dev;
         double v;
@@ -219,7 +800,11 @@ int dispatch(XMLEle *root, char msg[])
             pthread_mutex_unlock(&rosc_mutex);
 
             if (prop == NULL)
+            {
+                if (getPropertyHandler)
+                    getPropertyHandler(valuXMLAtt(dev), valuXMLAtt(name));
                 return 0;
+            }
 
             switch (prop->type)
             {
@@ -256,10 +841,7 @@ int dispatch(XMLEle *root, char msg[])
          * we don't know here which devices are being snooped so we send
          * all remaining valid messages
          */
-    if (!strcmp(rtag, "setNumberVector") || !strcmp(rtag, "setTextVector") || !strcmp(rtag, "setLightVector") ||
-            !strcmp(rtag, "setSwitchVector") || !strcmp(rtag, "setBLOBVector") || !strcmp(rtag, "defNumberVector") ||
-            !strcmp(rtag, "defTextVector") || !strcmp(rtag, "defLightVector") || !strcmp(rtag, "defSwitchVector") ||
-            !strcmp(rtag, "defBLOBVector") || !strcmp(rtag, "message") || !strcmp(rtag, "delProperty"))
+    if (kind == TAG_SNOOPED)
     {
         ISSnoopDevice(root);
         return (0);
@@ -271,32 +853,24 @@ int dispatch(XMLEle *root, char msg[])
         return (-1);
 
     pthread_mutex_lock(&rosc_mutex);
-    if (rosc_find(name, dev) == NULL)
+    ROSC *prop = rosc_find(name, dev);
+    IPerm perm = prop ? prop->perm : IP_RO;
+    pthread_mutex_unlock(&rosc_mutex);
+
+    if (prop == NULL)
     {
-        pthread_mutex_unlock(&rosc_mutex);
         snprintf(msg, MAXRBUF, "Property %s is not defined in %s.", name, dev);
         return -1;
     }
-    pthread_mutex_unlock(&rosc_mutex);
 
     /* ensure property is not RO */
-    for (int i = 0; i < nPropCache; i++)
+    if (perm == IP_RO)
     {
-        if (!strcmp(propCache[i].propName, name) && !strcmp(propCache[i].devName, dev))
-        {
-            if (propCache[i].perm == IP_RO)
-            {
-                snprintf(msg, MAXRBUF, "Cannot set read-only property %s", name);
-                return -1;
-            }
-            else
-                break;
-        }
+        snprintf(msg, MAXRBUF, "Cannot set read-only property %s", name);
+        return -1;
     }
 
-    /* check tag in surmised decreasing order of likelihood */
-
-    if (!strcmp(rtag, "newNumberVector"))
+    if (kind == TAG_NEW_NUMBER)
     {
         static double *doubles = NULL;
         static char **names = NULL;
@@ -333,13 +907,17 @@ int dispatch(XMLEle *root, char msg[])
 
         /* invoke driver if something to do, but not an error if not */
         if (n > 0)
+        {
+            INDI_TRACE_BEGIN("ISNewNumber");
             ISNewNumber(dev, name, doubles, names, n);
+            INDI_TRACE_END("ISNewNumber");
+        }
         else
             IDMessage(dev, "[ERROR] %s: newNumberVector with no valid members", name);
         return (0);
     }
 
-    if (!strcmp(rtag, "newSwitchVector"))
+    if (kind == TAG_NEW_SWITCH)
     {
         static ISState *states = NULL;
         static char **names = NULL;
@@ -380,13 +958,17 @@ int dispatch(XMLEle *root, char msg[])
 
         /* invoke driver if something to do, but not an error if not */
         if (n > 0)
+        {
+            INDI_TRACE_BEGIN("ISNewSwitch");
             ISNewSwitch(dev, name, states, names, n);
+            INDI_TRACE_END("ISNewSwitch");
+        }
         else
             IDMessage(dev, "[ERROR] %s: newSwitchVector with no valid members", name);
         return (0);
     }
 
-    if (!strcmp(rtag, "newTextVector"))
+    if (kind == TAG_NEW_TEXT)
     {
         static char **texts = NULL;
         static char **names = NULL;
@@ -415,13 +997,17 @@ int dispatch(XMLEle *root, char msg[])
 
         /* invoke driver if something to do, but not an error if not */
         if (n > 0)
+        {
+            INDI_TRACE_BEGIN("ISNewText");
             ISNewText(dev, name, texts, names, n);
+            INDI_TRACE_END("ISNewText");
+        }
         else
             IDMessage(dev, "[ERROR] %s: set with no valid members", name);
         return (0);
     }
 
-    if (!strcmp(rtag, "newBLOBVector"))
+    if (kind == TAG_NEW_BLOB)
     {
         static char **blobs = NULL;
         static char **names = NULL;
@@ -430,8 +1016,8 @@ int dispatch(XMLEle *root, char msg[])
         static int *sizes = NULL;
         static int maxn = 0;
 
-        // FIXME: shared blob not supported here
-        /* pull out each name/BLOB pair, decode */
+        /* pull out each name/BLOB pair, decode straight into shared buffers
+         * so a driver publishing what it received hands the fd over without a copy */
         for (n = 0, ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
         {
             if (strcmp(tagXMLEle(ep), "oneBLOB") == 0)
@@ -451,13 +1037,12 @@ int dispatch(XMLEle *root, char msg[])
                         assert_mem(sizes = (int *)realloc(sizes, maxn * sizeof *sizes));
                         assert_mem(blobsizes = (int *)realloc(blobsizes, maxn * sizeof *blobsizes));
                     }
-                    // FIXME : here decode using shared buffer
                     int bloblen = pcdatalenXMLEle(ep);
                     // enclen is optional and not required by INDI protocol
                     if (el)
                         bloblen = atoi(valuXMLAtt(el));
-                    assert_mem(blobs[n] = (char*)malloc(3 * bloblen / 4));
-                    blobsizes[n] = from64tobits_fast(blobs[n], pcdataXMLEle(ep), bloblen);
+                    assert_mem(blobs[n] = (char*)IDSharedBlobAlloc(3 * bloblen / 4));
+                    blobsizes[n] = from64tobits_mt(blobs[n], pcdataXMLEle(ep), bloblen);
                     names[n]     = valuXMLAtt(na);
                     formats[n]   = valuXMLAtt(fa);
                     sizes[n]     = atoi(valuXMLAtt(sa));
@@ -469,9 +1054,11 @@ int dispatch(XMLEle *root, char msg[])
         /* invoke driver if something to do, but not an error if not */
         if (n > 0)
         {
+            INDI_TRACE_BEGIN("ISNewBLOB");
             ISNewBLOB(dev, name, sizes, blobsizes, blobs, formats, names, n);
+            INDI_TRACE_END("ISNewBLOB");
             for (int i = 0; i < n; i++)
-                free(blobs[i]);
+                IDSharedBlobFree(blobs[i]);
         }
         else
             IDMessage(dev, "[ERROR] %s: newBLOBVector with no valid members", name);
@@ -505,88 +1092,371 @@ int IUReadConfig(const char *filename, const char *dev, const char *property, in
         return -1;
     }
 
-    if (nXMLEle(fproot) > 0 && silent != 1)
-        IDMessage(dev, "[INFO] Loading device configuration...");
+    if (nXMLEle(fproot) > 0 && silent != 1)
+        IDMessage(dev, "[INFO] Loading device configuration...");
+
+    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+    {
+        /* pull out device and name */
+        if (crackDN(root, &rdev, &rname, errmsg) < 0)
+        {
+            fclose(fp);
+            delXMLEle(fproot);
+            return -1;
+        }
+
+        // It doesn't belong to our device??
+        if (strcmp(dev, rdev))
+            continue;
+
+        if ((property && !strcmp(property, rname)) || property == NULL)
+        {
+            dispatch(root, errmsg);
+            if (property)
+                break;
+        }
+    }
+
+    if (nXMLEle(fproot) > 0 && silent != 1)
+        IDMessage(dev, "[INFO] Device configuration applied.");
+
+    fclose(fp);
+    delXMLEle(fproot);
+
+    return (0);
+}
+
+int IUSaveDefaultConfig(const char *source_config, const char *dest_config, const char *dev)
+{
+    char configFileName[MAXRBUF], configDefaultFileName[MAXRBUF];
+
+    if (source_config)
+        strncpy(configFileName, source_config, MAXRBUF);
+    else
+    {
+        if (getenv("INDICONFIG"))
+            strncpy(configFileName, getenv("INDICONFIG"), MAXRBUF);
+        else
+            snprintf(configFileName, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
+    }
+
+    if (dest_config)
+        strncpy(configDefaultFileName, dest_config, MAXRBUF);
+    else if (getenv("INDICONFIG"))
+        snprintf(configDefaultFileName, MAXRBUF, "%s.default", getenv("INDICONFIG"));
+    else
+        snprintf(configDefaultFileName, MAXRBUF, "%s/.indi/%s_config.xml.default", getenv("HOME"), dev);
+
+    IUFlushConfig();
+
+    // If the default doesn't exist, create it.
+    if (access(configDefaultFileName, F_OK))
+    {
+        FILE *fpin = fopen(configFileName, "r");
+        if (fpin != NULL)
+        {
+            FILE *fpout = fopen(configDefaultFileName, "w");
+            if (fpout != NULL)
+            {
+                int ch = 0;
+                while ((ch = getc(fpin)) != EOF)
+                    putc(ch, fpout);
+
+                fflush(fpout);
+                fclose(fpout);
+            }
+            fclose(fpin);
+
+            return 0;
+        }
+    }
+    // If default config file exists already, then no need to modify it
+    else
+        return 0;
+
+
+    return -1;
+}
+
+/* Parsed config files, so the IUGetConfig* helpers do not read and parse
+ * the whole file on every call. A file is parsed again once it changes on
+ * disk, or once this driver opens it for writing.
+ */
+typedef struct {
+    char fileName[MAXRBUF];
+    time_t mtime;
+    off_t size;
+    ino_t ino;
+    XMLEle *root;
+} ConfigCache;
+
+static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static ConfigCache *configCache = NULL;
+static int nConfigCache = 0;
+
+static void config_filename(const char *filename, const char *dev, char fileName[MAXRBUF])
+{
+    if (filename)
+        indi_strlcpy(fileName, filename, MAXRBUF);
+    else if (getenv("INDICONFIG"))
+        indi_strlcpy(fileName, getenv("INDICONFIG"), MAXRBUF);
+    else
+        snprintf(fileName, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
+}
+
+static ConfigCache *config_find(const char *fileName)
+{
+    for (int i = 0; i < nConfigCache; i++)
+        if (!strcmp(fileName, configCache[i].fileName))
+            return &configCache[i];
+
+    return NULL;
+}
+
+static void config_invalidate(const char *filename, const char *dev)
+{
+    char fileName[MAXRBUF];
+    config_filename(filename, dev, fileName);
+
+    pthread_mutex_lock(&config_mutex);
+
+    ConfigCache *cache = config_find(fileName);
+    if (cache && cache->root)
+    {
+        delXMLEle(cache->root);
+        cache->root = NULL;
+    }
+
+    pthread_mutex_unlock(&config_mutex);
+}
+
+/* Lock the cache and return the parsed config of dev, NULL if it can not be read.
+ * The tree stays valid until configRootUnlock(), which must be called in any case.
+ */
+static XMLEle *configRootLock(const char *dev)
+{
+    char fileName[MAXRBUF];
+    char errmsg[MAXRBUF];
+    struct stat st;
+
+    config_filename(NULL, dev, fileName);
+
+    IUFlushConfig();
+    pthread_mutex_lock(&config_mutex);
+
+    ConfigCache *cache = config_find(fileName);
+    if (cache == NULL)
+    {
+        assert_mem(configCache = (ConfigCache *)realloc(configCache, (nConfigCache + 1) * sizeof *configCache));
+        cache = &configCache[nConfigCache++];
+        memset(cache, 0, sizeof *cache);
+        indi_strlcpy(cache->fileName, fileName, MAXRBUF);
+    }
+
+    if (stat(fileName, &st) != 0)
+    {
+        if (cache->root)
+            delXMLEle(cache->root);
+        cache->root = NULL;
+        return NULL;
+    }
+
+    if (cache->root && cache->mtime == st.st_mtime && cache->size == st.st_size && cache->ino == st.st_ino)
+        return cache->root;
+
+    if (cache->root)
+        delXMLEle(cache->root);
+    cache->root = NULL;
+
+    // Not IUGetConfigFP, it waits for the writer that may need this lock
+    FILE *fp = fopen(fileName, "r");
+    if (fp == NULL)
+        return NULL;
+
+    LilXML *lp = newLilXML();
+    cache->root = readXMLFile(fp, lp, errmsg);
+    delLilXML(lp);
+    fclose(fp);
+
+    cache->mtime = st.st_mtime;
+    cache->size  = st.st_size;
+    cache->ino   = st.st_ino;
+
+    return cache->root;
+}
+
+static void configRootUnlock(void)
+{
+    pthread_mutex_unlock(&config_mutex);
+}
+
+/* Deferred config writes, see IUSaveConfigDeferred. One background thread
+ * writes the latest content queued for each file, CONFIG_WRITE_DELAY ms after
+ * the first request of a burst.
+ */
+#define CONFIG_WRITE_DELAY 500
+
+typedef struct {
+    char fileName[MAXRBUF];
+    char *data;
+    size_t len;
+} PendingConfig;
+
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wakeup = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t writer_idle = PTHREAD_COND_INITIALIZER;
+
+static PendingConfig *pendingConfigs = NULL;
+static int nPendingConfigs = 0;
+static int writerStarted = 0;
+static int writerBusy = 0;
+static int writerFlush = 0;
+static struct timespec writerDeadline;
+
+/* Replace fileName with data, through a temporary file so readers never see a partial config */
+static void config_write(const char *fileName, const char *data, size_t len)
+{
+    char tmpName[MAXRBUF + 8];
+    char dirName[MAXRBUF];
+    char *slash;
+
+    indi_strlcpy(dirName, fileName, MAXRBUF);
+    slash = strrchr(dirName, '/');
+    if (slash && slash != dirName)
+    {
+        *slash = '\0';
+        mkdir(dirName, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    }
+
+    snprintf(tmpName, sizeof(tmpName), "%s.tmp", fileName);
+
+    FILE *fp = fopen(tmpName, "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Unable to save config file %s: %s\n", tmpName, strerror(errno));
+        return;
+    }
+
+    int ok = fwrite(data, 1, len, fp) == len && fflush(fp) == 0 && fsync(fileno(fp)) == 0;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok || rename(tmpName, fileName) != 0)
+    {
+        fprintf(stderr, "Unable to save config file %s: %s\n", fileName, strerror(errno));
+        unlink(tmpName);
+        return;
+    }
+
+    config_invalidate(fileName, NULL);
+}
 
-    for (root = nextXMLEle(fproot, 1); root != NULL; root = nextXMLEle(fproot, 0))
+static void *config_writer(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&writer_mutex);
+    for (;;)
     {
-        /* pull out device and name */
-        if (crackDN(root, &rdev, &rname, errmsg) < 0)
-        {
-            fclose(fp);
-            delXMLEle(fproot);
-            return -1;
-        }
+        while (nPendingConfigs == 0)
+            pthread_cond_wait(&writer_wakeup, &writer_mutex);
 
-        // It doesn't belong to our device??
-        if (strcmp(dev, rdev))
-            continue;
+        while (!writerFlush && pthread_cond_timedwait(&writer_wakeup, &writer_mutex, &writerDeadline) != ETIMEDOUT)
+            ;
 
-        if ((property && !strcmp(property, rname)) || property == NULL)
+        PendingConfig *batch = pendingConfigs;
+        int count = nPendingConfigs;
+        pendingConfigs  = NULL;
+        nPendingConfigs = 0;
+        writerBusy      = 1;
+        pthread_mutex_unlock(&writer_mutex);
+
+        for (int i = 0; i < count; i++)
         {
-            dispatch(root, errmsg);
-            if (property)
-                break;
+            config_write(batch[i].fileName, batch[i].data, batch[i].len);
+            free(batch[i].data);
         }
-    }
-
-    if (nXMLEle(fproot) > 0 && silent != 1)
-        IDMessage(dev, "[INFO] Device configuration applied.");
+        free(batch);
 
-    fclose(fp);
-    delXMLEle(fproot);
+        pthread_mutex_lock(&writer_mutex);
+        writerBusy = 0;
+        if (nPendingConfigs == 0)
+            pthread_cond_broadcast(&writer_idle);
+    }
+    return NULL;
+}
 
-    return (0);
+void IUFlushConfig(void)
+{
+    pthread_mutex_lock(&writer_mutex);
+    while (nPendingConfigs > 0 || writerBusy)
+    {
+        writerFlush = 1;
+        pthread_cond_signal(&writer_wakeup);
+        pthread_cond_wait(&writer_idle, &writer_mutex);
+    }
+    writerFlush = 0;
+    pthread_mutex_unlock(&writer_mutex);
 }
 
-int IUSaveDefaultConfig(const char *source_config, const char *dest_config, const char *dev)
+int IUSaveConfigDeferred(const char *filename, const char *dev, const char *data, size_t len, char errmsg[])
 {
-    char configFileName[MAXRBUF], configDefaultFileName[MAXRBUF];
+    char fileName[MAXRBUF];
+    PendingConfig *pending = NULL;
+    char *copy = (char *)malloc(len + 1);
 
-    if (source_config)
-        strncpy(configFileName, source_config, MAXRBUF);
-    else
+    if (copy == NULL)
     {
-        if (getenv("INDICONFIG"))
-            strncpy(configFileName, getenv("INDICONFIG"), MAXRBUF);
-        else
-            snprintf(configFileName, MAXRBUF, "%s/.indi/%s_config.xml", getenv("HOME"), dev);
+        snprintf(errmsg, MAXRBUF, "Unable to save config file: out of memory");
+        return -1;
     }
+    memcpy(copy, data, len);
+    copy[len] = '\0';
 
-    if (dest_config)
-        strncpy(configDefaultFileName, dest_config, MAXRBUF);
-    else if (getenv("INDICONFIG"))
-        snprintf(configDefaultFileName, MAXRBUF, "%s.default", getenv("INDICONFIG"));
-    else
-        snprintf(configDefaultFileName, MAXRBUF, "%s/.indi/%s_config.xml.default", getenv("HOME"), dev);
+    config_filename(filename, dev, fileName);
 
-    // If the default doesn't exist, create it.
-    if (access(configDefaultFileName, F_OK))
+    pthread_mutex_lock(&writer_mutex);
+
+    if (!writerStarted)
     {
-        FILE *fpin = fopen(configFileName, "r");
-        if (fpin != NULL)
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, config_writer, NULL) != 0)
         {
-            FILE *fpout = fopen(configDefaultFileName, "w");
-            if (fpout != NULL)
-            {
-                int ch = 0;
-                while ((ch = getc(fpin)) != EOF)
-                    putc(ch, fpout);
+            pthread_mutex_unlock(&writer_mutex);
+            free(copy);
+            snprintf(errmsg, MAXRBUF, "Unable to start config writer: %s", strerror(errno));
+            return -1;
+        }
+        pthread_detach(thread);
+        atexit(IUFlushConfig);
+        writerStarted = 1;
+    }
 
-                fflush(fpout);
-                fclose(fpout);
-            }
-            fclose(fpin);
+    for (int i = 0; i < nPendingConfigs && pending == NULL; i++)
+        if (!strcmp(pendingConfigs[i].fileName, fileName))
+            pending = &pendingConfigs[i];
 
-            return 0;
+    if (pending == NULL)
+    {
+        if (nPendingConfigs == 0)
+        {
+            clock_gettime(CLOCK_REALTIME, &writerDeadline);
+            writerDeadline.tv_nsec += CONFIG_WRITE_DELAY * 1000000L;
+            writerDeadline.tv_sec  += writerDeadline.tv_nsec / 1000000000L;
+            writerDeadline.tv_nsec %= 1000000000L;
         }
+        assert_mem(pendingConfigs = (PendingConfig *)realloc(pendingConfigs, (nPendingConfigs + 1) * sizeof *pendingConfigs));
+        pending = &pendingConfigs[nPendingConfigs++];
+        indi_strlcpy(pending->fileName, fileName, MAXRBUF);
     }
-    // If default config file exists already, then no need to modify it
     else
-        return 0;
+        free(pending->data);
 
+    pending->data = copy;
+    pending->len  = len;
 
-    return -1;
+    pthread_cond_signal(&writer_wakeup);
+    pthread_mutex_unlock(&writer_mutex);
+    return 0;
 }
 
 int IUGetConfigOnSwitch(const ISwitchVectorProperty *property, int *index)
@@ -594,24 +1464,14 @@ int IUGetConfigOnSwitch(const ISwitchVectorProperty *property, int *index)
     char *rname, *rdev;
     XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
     int propertyFound = 0;
     *index = -1;
 
-    FILE *fp = IUGetConfigFP(NULL, property->device, "r", errmsg);
-
-    if (fp == NULL)
-    {
-        delLilXML(lp);
-        return -1;
-    }
-
-    fproot = readXMLFile(fp, lp, errmsg);
+    fproot = configRootLock(property->device);
 
     if (fproot == NULL)
     {
-        delLilXML(lp);
-        fclose(fp);
+        configRootUnlock();
         return -1;
     }
 
@@ -620,8 +1480,7 @@ int IUGetConfigOnSwitch(const ISwitchVectorProperty *property, int *index)
         /* pull out device and name */
         if (crackDN(root, &rdev, &rname, errmsg) < 0)
         {
-            fclose(fp);
-            delXMLEle(fproot);
+            configRootUnlock();
             return -1;
         }
 
@@ -647,9 +1506,7 @@ int IUGetConfigOnSwitch(const ISwitchVectorProperty *property, int *index)
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    configRootUnlock();
 
     return (propertyFound ? 0 : -1);
 }
@@ -659,23 +1516,13 @@ int IUGetConfigSwitch(const char *dev, const char *property, const char *member,
     char *rname, *rdev;
     XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
     int valueFound = 0;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
-
-    if (fp == NULL)
-    {
-        delLilXML(lp);
-        return -1;
-    }
-
-    fproot = readXMLFile(fp, lp, errmsg);
+    fproot = configRootLock(dev);
 
     if (fproot == NULL)
     {
-        fclose(fp);
-        delLilXML(lp);
+        configRootUnlock();
         return -1;
     }
 
@@ -684,8 +1531,7 @@ int IUGetConfigSwitch(const char *dev, const char *property, const char *member,
         /* pull out device and name */
         if (crackDN(root, &rdev, &rname, errmsg) < 0)
         {
-            fclose(fp);
-            delXMLEle(fproot);
+            configRootUnlock();
             return -1;
         }
 
@@ -709,9 +1555,7 @@ int IUGetConfigSwitch(const char *dev, const char *property, const char *member,
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    configRootUnlock();
 
     return (valueFound == 1 ? 0 : -1);
 }
@@ -721,23 +1565,13 @@ int IUGetConfigOnSwitchIndex(const char *dev, const char *property, int *index)
     char *rname, *rdev;
     XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
     int valueFound = 0;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
-
-    if (fp == NULL)
-    {
-        delLilXML(lp);
-        return -1;
-    }
-
-    fproot = readXMLFile(fp, lp, errmsg);
+    fproot = configRootLock(dev);
 
     if (fproot == NULL)
     {
-        delLilXML(lp);
-        fclose(fp);
+        configRootUnlock();
         return -1;
     }
 
@@ -746,8 +1580,7 @@ int IUGetConfigOnSwitchIndex(const char *dev, const char *property, int *index)
         /* pull out device and name */
         if (crackDN(root, &rdev, &rname, errmsg) < 0)
         {
-            fclose(fp);
-            delXMLEle(fproot);
+            configRootUnlock();
             return -1;
         }
 
@@ -773,9 +1606,7 @@ int IUGetConfigOnSwitchIndex(const char *dev, const char *property, int *index)
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    configRootUnlock();
 
     return (valueFound == 1 ? 0 : -1);
 }
@@ -785,23 +1616,13 @@ int IUGetConfigOnSwitchName(const char *dev, const char *property, char *name, s
     char *rname, *rdev;
     XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
     int found = -1;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
-
-    if (fp == NULL)
-    {
-        delLilXML(lp);
-        return -1;
-    }
-
-    fproot = readXMLFile(fp, lp, errmsg);
+    fproot = configRootLock(dev);
 
     if (fproot == NULL)
     {
-        delLilXML(lp);
-        fclose(fp);
+        configRootUnlock();
         return -1;
     }
 
@@ -810,8 +1631,7 @@ int IUGetConfigOnSwitchName(const char *dev, const char *property, char *name, s
         /* pull out device and name */
         if (crackDN(root, &rdev, &rname, errmsg) < 0)
         {
-            fclose(fp);
-            delXMLEle(fproot);
+            configRootUnlock();
             return -1;
         }
 
@@ -837,9 +1657,7 @@ int IUGetConfigOnSwitchName(const char *dev, const char *property, char *name, s
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    configRootUnlock();
 
     return found;
 }
@@ -849,23 +1667,13 @@ int IUGetConfigNumber(const char *dev, const char *property, const char *member,
     char *rname, *rdev;
     XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
     int valueFound = 0;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
-
-    if (fp == NULL)
-    {
-        delLilXML(lp);
-        return -1;
-    }
-
-    fproot = readXMLFile(fp, lp, errmsg);
+    fproot = configRootLock(dev);
 
     if (fproot == NULL)
     {
-        fclose(fp);
-        delLilXML(lp);
+        configRootUnlock();
         return -1;
     }
 
@@ -874,8 +1682,7 @@ int IUGetConfigNumber(const char *dev, const char *property, const char *member,
         /* pull out device and name */
         if (crackDN(root, &rdev, &rname, errmsg) < 0)
         {
-            fclose(fp);
-            delXMLEle(fproot);
+            configRootUnlock();
             return -1;
         }
 
@@ -899,9 +1706,7 @@ int IUGetConfigNumber(const char *dev, const char *property, const char *member,
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    configRootUnlock();
 
     return (valueFound == 1 ? 0 : -1);
 }
@@ -911,23 +1716,13 @@ int IUGetConfigText(const char *dev, const char *property, const char *member, c
     char *rname, *rdev;
     XMLEle *root = NULL, *fproot = NULL;
     char errmsg[MAXRBUF];
-    LilXML *lp = newLilXML();
     int valueFound = 0;
 
-    FILE *fp = IUGetConfigFP(NULL, dev, "r", errmsg);
-
-    if (fp == NULL)
-    {
-        delLilXML(lp);
-        return -1;
-    }
-
-    fproot = readXMLFile(fp, lp, errmsg);
+    fproot = configRootLock(dev);
 
     if (fproot == NULL)
     {
-        delLilXML(lp);
-        fclose(fp);
+        configRootUnlock();
         return -1;
     }
 
@@ -936,8 +1731,7 @@ int IUGetConfigText(const char *dev, const char *property, const char *member, c
         /* pull out device and name */
         if (crackDN(root, &rdev, &rname, errmsg) < 0)
         {
-            fclose(fp);
-            delXMLEle(fproot);
+            configRootUnlock();
             return -1;
         }
 
@@ -961,9 +1755,7 @@ int IUGetConfigText(const char *dev, const char *property, const char *member, c
         }
     }
 
-    fclose(fp);
-    delXMLEle(fproot);
-    delLilXML(lp);
+    configRootUnlock();
 
     return (valueFound == 1 ? 0 : -1);
 }
@@ -1006,6 +1798,9 @@ int IUPurgeConfig(const char *filename, const char *dev, char errmsg[])
             snprintf(configFileName, MAXRBUF, "%s%s_config.xml", configDir, dev);
     }
 
+    IUFlushConfig();
+    config_invalidate(configFileName, dev);
+
     if (remove(configFileName) != 0)
     {
         snprintf(errmsg, MAXRBUF, "Unable to purge configuration file %s. Error %s", configFileName, strerror(errno));
@@ -1022,6 +1817,9 @@ FILE *IUGetConfigFP(const char *filename, const char *dev, const char *mode, cha
     struct stat st;
     FILE *fp = NULL;
 
+    // Deferred writes first, so readers see and writers replace the latest content
+    IUFlushConfig();
+
     snprintf(configDir, MAXRBUF, "%s/.indi/", getenv("HOME"));
 
     if (filename)
@@ -1053,6 +1851,9 @@ FILE *IUGetConfigFP(const char *filename, const char *dev, const char *mode, cha
         return NULL;
     }
 
+    if (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))
+        config_invalidate(configFileName, dev);
+
     fp = fopen(configFileName, mode);
     if (fp == NULL)
     {
@@ -1089,6 +1890,14 @@ void IUSaveConfigTag(FILE *fp, int ctag, const char *dev, int silent)
 /* tell client to create a text vector property */
 void IDDefTextVA(const ITextVectorProperty *tvp, const char *fmt, va_list ap)
 {
+    if (local_wanted(tvp->device, tvp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_text(tvp, 1, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1097,6 +1906,8 @@ void IDDefTextVA(const ITextVectorProperty *tvp, const char *fmt, va_list ap)
 
     driverio_finish(&io);
 
+    IUIndexMembers(tvp->tp, tvp->ntp, sizeof(IText));
+
     /* Add this property to insure proper sanity check */
     rosc_add_unique(tvp->name, tvp->device, tvp->p, tvp, INDI_TEXT);
 
@@ -1113,6 +1924,14 @@ void IDDefText(const ITextVectorProperty *tvp, const char *fmt, ...)
 /* tell client to create a new numeric vector property */
 void IDDefNumberVA(const INumberVectorProperty *nvp, const char *fmt, va_list ap)
 {
+    if (local_wanted(nvp->device, nvp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_number(nvp, 1, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1121,6 +1940,8 @@ void IDDefNumberVA(const INumberVectorProperty *nvp, const char *fmt, va_list ap
 
     driverio_finish(&io);
 
+    IUIndexMembers(nvp->np, nvp->nnp, sizeof(INumber));
+
     /* Add this property to insure proper sanity check */
     rosc_add_unique(nvp->name, nvp->device, nvp->p, nvp, INDI_NUMBER);
 }
@@ -1136,6 +1957,14 @@ void IDDefNumber(const INumberVectorProperty *nvp, const char *fmt, ...)
 /* tell client to create a new switch vector property */
 void IDDefSwitchVA(const ISwitchVectorProperty *svp, const char *fmt, va_list ap)
 {
+    if (local_wanted(svp->device, svp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_switch(svp, 1, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1144,6 +1973,8 @@ void IDDefSwitchVA(const ISwitchVectorProperty *svp, const char *fmt, va_list ap
 
     driverio_finish(&io);
 
+    IUIndexMembers(svp->sp, svp->nsp, sizeof(ISwitch));
+
     /* Add this property to insure proper sanity check */
     rosc_add_unique(svp->name, svp->device, svp->p, svp, INDI_SWITCH);
 }
@@ -1159,6 +1990,14 @@ void IDDefSwitch(const ISwitchVectorProperty *svp, const char *fmt, ...)
 /* tell client to create a new lights vector property */
 void IDDefLightVA(const ILightVectorProperty *lvp, const char *fmt, va_list ap)
 {
+    if (local_wanted(lvp->device, lvp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_light(lvp, 1, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1166,6 +2005,8 @@ void IDDefLightVA(const ILightVectorProperty *lvp, const char *fmt, va_list ap)
     IUUserIODefLightVA(&io.userio, io.user, lvp, fmt, ap);
 
     driverio_finish(&io);
+
+    IUIndexMembers(lvp->lp, lvp->nlp, sizeof(ILight));
 }
 
 void IDDefLight(const ILightVectorProperty *lvp, const char *fmt, ...)
@@ -1179,6 +2020,14 @@ void IDDefLight(const ILightVectorProperty *lvp, const char *fmt, ...)
 /* tell client to create a new BLOB vector property */
 void IDDefBLOBVA(const IBLOBVectorProperty *bvp, const char *fmt, va_list ap)
 {
+    if (local_wanted(bvp->device, bvp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_blob(bvp, 1, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1187,6 +2036,8 @@ void IDDefBLOBVA(const IBLOBVectorProperty *bvp, const char *fmt, va_list ap)
 
     driverio_finish(&io);
 
+    IUIndexMembers(bvp->bp, bvp->nbp, sizeof(IBLOB));
+
     /* Add this property to insure proper sanity check */
     rosc_add_unique(bvp->name, bvp->device, bvp->p, bvp, INDI_BLOB);
 
@@ -1200,9 +2051,45 @@ void IDDefBLOB(const IBLOBVectorProperty *bvp, const char *fmt, ...)
     va_end(ap);
 }
 
+/* set who defines the properties clients ask for before the driver does */
+void IDSetGetPropertyHandler(IDGetPropertyHandler *handler)
+{
+    getPropertyHandler = handler;
+}
+
+/* write the messages of this thread at once until IDBatchEnd */
+void IDBatchBegin(void)
+{
+    driverio_batch_begin();
+}
+
+void IDBatchEnd(void)
+{
+    driverio_batch_end();
+}
+
+/* write the messages of this thread before the others until IDPriorityEnd */
+void IDPriorityBegin(void)
+{
+    driverio_priority_begin();
+}
+
+void IDPriorityEnd(void)
+{
+    driverio_priority_end();
+}
+
 /* tell client to update an existing text vector property */
 void IDSetTextVA(const ITextVectorProperty *tvp, const char *fmt, va_list ap)
 {
+    if (local_wanted(tvp->device, tvp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_text(tvp, 0, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1221,9 +2108,144 @@ void IDSetText(const ITextVectorProperty *tvp, const char *fmt, ...)
 }
 
 /* tell client to update an existing numeric vector property */
+/* Member names of each id sent in an INDI_FRAME_DEFNUMBER, index is id - 1 */
+typedef struct {
+    int nnp;
+    char (*names)[MAXINDINAME];
+} FrameNumber;
+
+static FrameNumber *frameNumbers = NULL;
+static int nFrameNumbers = 0;
+static int framesOffered = 0;
+
+static void frames_detect()
+{
+    const char *env = getenv(INDI_FRAME_ENV);
+    framesOffered = env != NULL && atoi(env) > 0;
+}
+
+/* True if the indiserver that started us takes frames, see indiframe.h */
+static int frames_offered()
+{
+    static pthread_once_t detectOnce = PTHREAD_ONCE_INIT;
+    pthread_once(&detectOnce, &frames_detect);
+    return framesOffered;
+}
+
+static int frame_matches(const FrameNumber *fn, const INumberVectorProperty *nvp)
+{
+    if (fn->nnp != nvp->nnp)
+        return 0;
+    for (int i = 0; i < nvp->nnp; i++)
+        if (strcmp(fn->names[i], nvp->np[i].name))
+            return 0;
+    return 1;
+}
+
+static void frame_header(driverio *io, uint8_t kind, uint32_t payload, uint32_t id)
+{
+    char header[INDI_FRAME_HEADER + 1 + sizeof id];
+
+    header[0] = INDI_FRAME_MARK;
+    memcpy(header + 1, &payload, sizeof payload);
+    header[INDI_FRAME_HEADER] = kind;
+    memcpy(header + INDI_FRAME_HEADER + 1, &id, sizeof id);
+    userio_write(&io->userio, io->user, header, sizeof header);
+}
+
+static void frame_define_number(driverio *io, uint32_t id, const INumberVectorProperty *nvp)
+{
+    uint32_t count = nvp->nnp;
+    size_t payload = 1 + sizeof id + sizeof count + strlen(nvp->device) + 1 + strlen(nvp->name) + 1;
+    for (int i = 0; i < nvp->nnp; i++)
+        payload += strlen(nvp->np[i].name) + 1;
+
+    frame_header(io, INDI_FRAME_DEFNUMBER, payload, id);
+    userio_write(&io->userio, io->user, &count, sizeof count);
+    userio_write(&io->userio, io->user, nvp->device, strlen(nvp->device) + 1);
+    userio_write(&io->userio, io->user, nvp->name, strlen(nvp->name) + 1);
+    for (int i = 0; i < nvp->nnp; i++)
+        userio_write(&io->userio, io->user, nvp->np[i].name, strlen(nvp->np[i].name) + 1);
+}
+
+static void frame_set_number(driverio *io, uint32_t id, const INumberVectorProperty *nvp)
+{
+    uint8_t state = nvp->s;
+    double timeout = nvp->timeout;
+    const char *timestamp = indi_timestamp();
+    size_t payload = 1 + sizeof id + sizeof state + sizeof timeout + strlen(timestamp) + 1 + nvp->nnp * sizeof(double);
+
+    frame_header(io, INDI_FRAME_SETNUMBER, payload, id);
+    userio_write(&io->userio, io->user, &state, sizeof state);
+    userio_write(&io->userio, io->user, &timeout, sizeof timeout);
+    userio_write(&io->userio, io->user, timestamp, strlen(timestamp) + 1);
+    for (int i = 0; i < nvp->nnp; i++)
+        userio_write(&io->userio, io->user, &nvp->np[i].value, sizeof(double));
+}
+
+/* Send nvp as frames, defining its id first when needed. 0 if it must go as XML */
+static int frames_send_number(const INumberVectorProperty *nvp)
+{
+    size_t payload = 3 * MAXINDINAME;
+    for (int i = 0; i < nvp->nnp; i++)
+        payload += sizeof(double) + strlen(nvp->np[i].name) + 1;
+    if (payload > INDI_FRAME_MAXPAYLOAD)
+        return 0;
+
+    /* Held until queued, so no one sends the id before it is defined */
+    pthread_mutex_lock(&rosc_mutex);
+
+    ROSC *SC = rosc_find(nvp->name, nvp->device);
+    if (SC == NULL || SC->type != INDI_NUMBER)
+    {
+        pthread_mutex_unlock(&rosc_mutex);
+        return 0;
+    }
+
+    driverio io;
+    driverio_init(&io);
+
+    if (SC->frameId == 0 || !frame_matches(&frameNumbers[SC->frameId - 1], nvp))
+    {
+        assert_mem(frameNumbers = (FrameNumber *)realloc(frameNumbers, (nFrameNumbers + 1) * sizeof *frameNumbers));
+        FrameNumber *fn = &frameNumbers[nFrameNumbers++];
+        fn->nnp = nvp->nnp;
+        assert_mem(fn->names = calloc(nvp->nnp ? nvp->nnp : 1, sizeof *fn->names));
+        for (int i = 0; i < nvp->nnp; i++)
+            indi_strlcpy(fn->names[i], nvp->np[i].name, MAXINDINAME);
+
+        SC->frameId = nFrameNumbers;
+        frame_define_number(&io, SC->frameId, nvp);
+    }
+
+    frame_set_number(&io, SC->frameId, nvp);
+    driverio_queue(&io);
+
+    pthread_mutex_unlock(&rosc_mutex);
+
+    driverio_flush();
+    return 1;
+}
+
 void IDSetNumberVA(const INumberVectorProperty *nvp, const char *fmt, va_list ap)
 {
     driverio io;
+
+    if (nNumberPolicies > 0 && !policy_accept(nvp, fmt))
+        return;
+
+    if (local_wanted(nvp->device, nvp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_number(nvp, 0, fmt, lap);
+        va_end(lap);
+    }
+
+    /* Messages need the XML */
+    if (fmt == NULL && frames_offered() && frames_send_number(nvp))
+        return;
+
     driverio_init(&io);
 
     userio_xmlv1(&io.userio, io.user);
@@ -1243,6 +2265,14 @@ void IDSetNumber(const INumberVectorProperty *nvp, const char *fmt, ...)
 /* tell client to update an existing switch vector property */
 void IDSetSwitchVA(const ISwitchVectorProperty *svp, const char *fmt, va_list ap)
 {
+    if (local_wanted(svp->device, svp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_switch(svp, 0, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1263,6 +2293,14 @@ void IDSetSwitch(const ISwitchVectorProperty *svp, const char *fmt, ...)
 /* tell client to update an existing lights vector property */
 void IDSetLightVA(const ILightVectorProperty *lvp, const char *fmt, va_list ap)
 {
+    if (local_wanted(lvp->device, lvp->name, 0))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_light(lvp, 0, fmt, lap);
+        va_end(lap);
+    }
+
     driverio io;
     driverio_init(&io);
 
@@ -1288,6 +2326,14 @@ void IDSetBLOBVA(const IBLOBVectorProperty *bvp, const char *fmt, va_list ap)
 {
     char buffer[64];
 
+    if (local_wanted(bvp->device, bvp->name, 1))
+    {
+        va_list lap;
+        va_copy(lap, ap);
+        local_blob(bvp, 0, fmt, lap);
+        va_end(lap);
+    }
+
     // Wait for ack of previous blob if any
     if (lastBlobPingUid) {
         snprintf(buffer, 64, BLOB_PING_PATTERN, lastBlobPingUid);
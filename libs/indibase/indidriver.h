@@ -78,6 +78,22 @@ extern int dispatch(XMLEle *root, char msg[]);
  */
 extern FILE *IUGetConfigFP(const char *filename, const char *dev, const char *mode, char errmsg[]);
 
+/** @brief Queue the whole content of a configuration file, to be written by a background thread.
+ *  Saves made within a short delay are merged, only the latest content gets written. The file is replaced
+ *  atomically through a temporary file, so it never holds a partial configuration.
+ *  Pending content is written before any configuration file is read or opened through this API, and at exit.
+ *  @param filename full path of the configuration file. If NULL, it is generated as described in the <b>Detailed Description</b> introduction.
+ *  @param dev device name. This is used if the filename parameter is NULL, and INDICONFIG environment variable is not set.
+ *  @param data content of the configuration file.
+ *  @param len length of data in bytes.
+ *  @param errmsg In case of errors, store the error message in this buffer. The size of the buffer must be at least MAXRBUF.
+ *  @return 0 if the content was queued, -1 on failure and errmsg is set.
+ */
+extern int IUSaveConfigDeferred(const char *filename, const char *dev, const char *data, size_t len, char errmsg[]);
+
+/** @brief Block until every configuration queued by IUSaveConfigDeferred is written to disk. */
+extern void IUFlushConfig(void);
+
 /**
  *  @param filename full path of the configuration file. If set, it will be deleted from disk.
  *         If set to NULL, it will attempt to generate the filename as described in the <b>Detailed Description</b> introduction and then delete it.
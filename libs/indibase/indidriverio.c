@@ -33,6 +33,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include <sys/un.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sched.h>
 
 #include "indidriver.h"
 #include "sharedblob.h"
@@ -40,86 +43,149 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include "indiuserio.h"
 #include "indidriverio.h"
 
+/* Initial buffer size, doubled as the message grows */
+#define OUTPUTBUFF_ALLOC 1024
 
+/* Producers wait for the writer while more than this is queued */
+#define OUTPUTQUEUE_LIMIT (64 * 1024 * 1024)
 
-/* Buffer size. Must be ^ 2 */
-#define OUTPUTBUFF_ALLOC 32768
+#define MAXFD_PER_MESSAGE 16
 
-/* Dump whole buffer when growing over this */
-#define OUTPUTBUFF_FLUSH_THRESOLD 65536
+/* A batch is written out before it grows past this */
+#define BATCH_LIMIT (1024 * 1024)
 
-#define MAXFD_PER_MESSAGE 16
+/* A finished message, owned by the queue until written */
+typedef struct driverio_msg
+{
+    struct driverio_msg * _Atomic next;
+    char * buff;
+    size_t len;
+    int fds[MAXFD_PER_MESSAGE];
+    int fdCount;
+} driverio_msg;
+
+/* Multiple producers, single consumer queue of finished messages.
+ * Producers swap themselves in at head, the writer pops at tail.
+ * Whoever queues a message while no one writes becomes the writer, so a
+ * thread that has its message out of the way never waits for another one. */
+typedef struct driverio_fifo
+{
+    driverio_msg stub;
+    driverio_msg * _Atomic head;
+    driverio_msg * tail;
+} driverio_fifo;
+
+/* Messages queued between driverio_priority_begin and driverio_priority_end go out before the others */
+static driverio_fifo urgentQueue = { .head = &urgentQueue.stub, .tail = &urgentQueue.stub };
+static driverio_fifo normalQueue = { .head = &normalQueue.stub, .tail = &normalQueue.stub };
+static atomic_int queueWriter = 0;
+static atomic_size_t queueBytes = 0;
 
-static void driverio_flush(driverio * dio, const void * additional, size_t add_size);
+static _Thread_local int priorityDepth = 0;
 
-static pthread_mutex_t stdout_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void queue_push(driverio_fifo * queue, driverio_msg * msg)
+{
+    atomic_store_explicit(&msg->next, NULL, memory_order_relaxed);
+    driverio_msg * prev = atomic_exchange_explicit(&queue->head, msg, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, msg, memory_order_release);
+}
 
-/* Return the buffer size required for storage (rounded to next OUTPUTBUFF_ALLOC) */
-static unsigned int outBuffRequired(unsigned int storage)
+/* Writer only. NULL when empty, or when a producer is half way through queue_push */
+static driverio_msg * queue_pop(driverio_fifo * queue)
 {
-    return (storage + OUTPUTBUFF_ALLOC - 1) & ~(OUTPUTBUFF_ALLOC - 1);
+    driverio_msg * tail = queue->tail;
+    driverio_msg * next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &queue->stub)
+    {
+        if (next == NULL)
+            return NULL;
+        queue->tail = tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+
+    if (next != NULL)
+    {
+        queue->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&queue->head, memory_order_acquire))
+        return NULL;
+
+    queue_push(queue, &queue->stub);
+
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next == NULL)
+        return NULL;
+
+    queue->tail = next;
+    return tail;
 }
 
-static int outBuffAllocated(struct driverio * dio)
+static int queue_pending(driverio_fifo * queue)
 {
-    return outBuffRequired(dio->outPos);
+    return atomic_load_explicit(&queue->head, memory_order_acquire) != &queue->stub;
 }
 
-static void outBuffGrow(struct driverio * dio, int required)
+/* Messages queued by this thread since driverio_batch_begin, written as one message when the batch ends */
+static _Thread_local int batchDepth = 0;
+static _Thread_local char * batchBuff = NULL;
+static _Thread_local size_t batchLen = 0;
+static _Thread_local size_t batchSize = 0;
+
+static void outBuffGrow(struct driverio * dio, size_t required)
 {
-    dio->outBuff = realloc(dio->outBuff, required);
+    if (required <= dio->outSize)
+        return;
+
+    size_t size = dio->outSize ? dio->outSize : OUTPUTBUFF_ALLOC;
+    while (size < required)
+        size *= 2;
+
+    dio->outBuff = realloc(dio->outBuff, size);
     if (dio->outBuff == NULL)
     {
         perror("malloc");
         _exit(1);
     }
+    dio->outSize = size;
 }
 
 static ssize_t driverio_write(void *user, const void * ptr, size_t count)
 {
     struct driverio * dio = (struct driverio*) user;
 
-    if (dio->outPos + count > OUTPUTBUFF_FLUSH_THRESOLD)
-    {
-        driverio_flush(dio, ptr, count);
-    }
-    else
-    {
-        unsigned int allocated = outBuffAllocated(dio);
-        unsigned int required = outBuffRequired(dio->outPos + count);
-        if (required != allocated)
-        {
-            outBuffGrow(dio, required);
-        }
-        memcpy(dio->outBuff + dio->outPos, ptr, count);
+    outBuffGrow(dio, dio->outPos + count);
+    memcpy(dio->outBuff + dio->outPos, ptr, count);
+    dio->outPos += count;
 
-        dio->outPos += count;
-    }
     return count;
 }
 
 static int driverio_vprintf(void *user, const char * fmt, va_list arg)
 {
     struct driverio * dio = (struct driverio*) user;
-    int available;
-    int size = 0;
+    int size;
+    va_list copy;
 
-    unsigned int allocated = outBuffAllocated(dio);
+    outBuffGrow(dio, dio->outPos + 1);
     while(1)
     {
-        available = allocated - dio->outPos;
+        size_t available = dio->outSize - dio->outPos;
         /* Determine required size */
-        size = vsnprintf(dio->outBuff + dio->outPos, available, fmt, arg);
+        va_copy(copy, arg);
+        size = vsnprintf(dio->outBuff + dio->outPos, available, fmt, copy);
+        va_end(copy);
 
         if (size < 0)
             return size;
 
-        if (size < available)
+        if ((size_t)size < available)
         {
             break;
         }
-        allocated = outBuffRequired(available + size + 1);
-        outBuffGrow(dio, allocated);
+        outBuffGrow(dio, dio->outPos + size + 1);
     }
     dio->outPos += size;
     return size;
@@ -138,150 +204,279 @@ static void driverio_join(void * user, const char * xml, void * blob, size_t blo
     driverio_write(user, xml, strlen(xml));
 }
 
-
-static void driverio_flush(driverio * dio, const void * additional, size_t add_size)
+/* Take the joined buffers as fds of our own, the driver may free them once we return */
+static void driverio_attach_fds(driverio * dio, driverio_msg * msg)
 {
-    struct msghdr msgh;
-    struct iovec iov[2];
-    int cmsghdrlength;
-    struct cmsghdr * cmsgh;
-
-    if (dio->outPos + add_size)
+    if (dio->joinCount > MAXFD_PER_MESSAGE)
     {
-        int ret = -1;
-        void ** temporaryBuffers = NULL;
-        int fdCount = dio->joinCount;
-        if (fdCount > 0)
-        {
+        errno = EMSGSIZE;
+        perror("sendmsg");
+        exit(1);
+    }
 
-            if (dio->joinCount > MAXFD_PER_MESSAGE)
-            {
-                errno = EMSGSIZE;
-                perror("sendmsg");
-                exit(1);
-            }
+    for(int i = 0; i < dio->joinCount; ++i)
+    {
+        void * blob = dio->joins[i];
+        size_t size = dio->joinSizes[i];
 
-            cmsghdrlength = CMSG_SPACE((fdCount * sizeof(int)));
-            cmsgh = (struct cmsghdr*)malloc(cmsghdrlength);
-            // FIXME: abort on alloc error here
-            temporaryBuffers = (void**)malloc(sizeof(void*)*fdCount);
-
-            /* Write the fd as ancillary data */
-            cmsgh->cmsg_len = CMSG_LEN(sizeof(int));
-            cmsgh->cmsg_level = SOL_SOCKET;
-            cmsgh->cmsg_type = SCM_RIGHTS;
-            msgh.msg_control = cmsgh;
-            msgh.msg_controllen = cmsghdrlength;
-            for(int i = 0; i < fdCount; ++i)
-            {
-                void * blob = dio->joins[i];
-                size_t size = dio->joinSizes[i];
-
-                int fd = IDSharedBlobGetFd(blob);
-                if (fd == -1)
-                {
-                    // Can't avoid a copy here. Update the driver to change that
-                    temporaryBuffers[i] = IDSharedBlobAlloc(size);
-                    memcpy(temporaryBuffers[i], blob, size);
-                    fd = IDSharedBlobGetFd(temporaryBuffers[i]);
-                }
-                else
-                {
-                    temporaryBuffers[i] = NULL;
-                }
-
-                ((int *) CMSG_DATA(CMSG_FIRSTHDR(&msgh)))[i] = fd;
-            }
+        int fd = IDSharedBlobGetFd(blob);
+        if (fd != -1)
+        {
+            msg->fds[i] = dup(fd);
         }
         else
         {
-            cmsgh = NULL;
-            cmsghdrlength = 0;
-            msgh.msg_control = cmsgh;
-            msgh.msg_controllen = cmsghdrlength;
+            // Can't avoid a copy here. Update the driver to change that
+            msg->fds[i] = IDSharedBlobCopyFd(blob, size);
         }
 
-        iov[0].iov_base = dio->outBuff;
-        iov[0].iov_len = dio->outPos;
-        if (add_size)
+        if (msg->fds[i] == -1)
         {
-            iov[1].iov_base = (void*)additional;
-            iov[1].iov_len = add_size;
+            perror("shared buffer");
+            exit(1);
         }
+    }
+    msg->fdCount = dio->joinCount;
+}
+
+static void driverio_send(driverio_msg * msg)
+{
+    struct msghdr msgh;
+    struct iovec iov;
+    char * cmsgbuf = NULL;
+    size_t done = 0;
 
-        msgh.msg_flags = 0;
-        msgh.msg_name = NULL;
-        msgh.msg_namelen = 0;
-        msgh.msg_iov = iov;
-        msgh.msg_iovlen = add_size ? 2 : 1;
+    memset(&msgh, 0, sizeof(msgh));
 
-        if (!dio->locked)
+    if (msg->fdCount > 0)
+    {
+        size_t cmsghdrlength = CMSG_SPACE((msg->fdCount * sizeof(int)));
+        cmsgbuf = (char*)calloc(1, cmsghdrlength);
+        if (cmsgbuf == NULL)
         {
-            pthread_mutex_lock(&stdout_mutex);
-            dio->locked = 1;
+            perror("malloc");
+            _exit(1);
         }
 
-        ret = sendmsg(1, &msgh, 0);
+        /* Write the fd as ancillary data */
+        msgh.msg_control = cmsgbuf;
+        msgh.msg_controllen = cmsghdrlength;
+
+        struct cmsghdr * cmsgh = CMSG_FIRSTHDR(&msgh);
+        cmsgh->cmsg_len = CMSG_LEN(msg->fdCount * sizeof(int));
+        cmsgh->cmsg_level = SOL_SOCKET;
+        cmsgh->cmsg_type = SCM_RIGHTS;
+        memcpy(CMSG_DATA(cmsgh), msg->fds, msg->fdCount * sizeof(int));
+
+        iov.iov_base = msg->buff;
+        iov.iov_len = msg->len;
+        msgh.msg_iov = &iov;
+        msgh.msg_iovlen = 1;
+
+        ssize_t ret = sendmsg(1, &msgh, 0);
         if (ret == -1)
         {
             perror("sendmsg");
             // FIXME: exiting the driver seems abrupt. Is this the right thing to do ? what about cleanup ?
             exit(1);
         }
-        else if ((unsigned)ret != dio->outPos + add_size)
+        else if ((size_t)ret != msg->len)
         {
             // This is not expected on blocking socket
             fprintf(stderr, "short write\n");
             exit(1);
         }
 
-        if (fdCount > 0)
+        for(int i = 0; i < msg->fdCount; ++i)
+            close(msg->fds[i]);
+        free(cmsgbuf);
+        return;
+    }
+
+    /* No ancillary data, so this also works on pipes */
+    while (done < msg->len)
+    {
+        ssize_t ret = write(1, msg->buff + done, msg->len - done);
+        if (ret == -1)
         {
-            for(int i = 0; i < fdCount; ++i)
-            {
-                if (temporaryBuffers[i] != NULL)
-                {
-                    IDSharedBlobFree(temporaryBuffers[i]);
-                }
-            }
-            free(cmsgh);
-            free(temporaryBuffers);
+            if (errno == EINTR)
+                continue;
+            perror("write");
+            exit(1);
         }
+        done += ret;
     }
+}
 
-    if (dio->joins != NULL)
+/* Write out queued messages unless another thread is on it already */
+static void driverio_drain()
+{
+    while (queue_pending(&urgentQueue) || queue_pending(&normalQueue))
     {
-        free(dio->joins);
+        int idle = 0;
+        if (!atomic_compare_exchange_strong(&queueWriter, &idle, 1))
+            return;
+
+        /* Urgent messages are looked for before each message */
+        driverio_msg * msg;
+        while ((msg = queue_pop(&urgentQueue)) != NULL || (msg = queue_pop(&normalQueue)) != NULL)
+        {
+            driverio_send(msg);
+            atomic_fetch_sub(&queueBytes, msg->len);
+            free(msg->buff);
+            free(msg);
+        }
+
+        atomic_store(&queueWriter, 0);
+
+        /* Someone queued after our last pop, or is still linking a message in: give them a chance */
+        if (queue_pending(&urgentQueue) || queue_pending(&normalQueue))
+            sched_yield();
     }
-    dio->joins = NULL;
+}
 
-    if (dio->joinSizes != NULL)
+static void driverio_atexit_register()
+{
+    atexit(&driverio_drain);
+}
+
+static void driverio_push(char * buff, size_t len, driverio * dio)
+{
+    driverio_msg * msg = (driverio_msg*)malloc(sizeof(driverio_msg));
+    if (msg == NULL)
     {
-        free(dio->joinSizes);
+        perror("malloc");
+        _exit(1);
     }
-    dio->joinSizes = NULL;
+    msg->buff = buff;
+    msg->len = len;
+    msg->fdCount = 0;
+    if (dio)
+        driverio_attach_fds(dio, msg);
+
+    atomic_fetch_add(&queueBytes, msg->len);
+    queue_push(priorityDepth > 0 ? &urgentQueue : &normalQueue, msg);
+}
 
-    if (dio->outBuff != NULL)
+/* Queue the messages of the batch so far as one */
+static void batch_push()
+{
+    if (batchLen > 0)
+        driverio_push(batchBuff, batchLen, NULL);
+    else
+        free(batchBuff);
+    batchBuff = NULL;
+    batchLen = 0;
+    batchSize = 0;
+}
+
+/* Move the message of dio at the end of the batch */
+static void batch_append(driverio * dio)
+{
+    if (batchBuff == NULL)
     {
-        free(dio->outBuff);
+        batchBuff = dio->outBuff;
+        batchLen = dio->outPos;
+        batchSize = dio->outSize;
+        dio->outBuff = NULL;
+        dio->outSize = 0;
+    }
+    else
+    {
+        if (batchLen + dio->outPos > batchSize)
+        {
+            while (batchLen + dio->outPos > batchSize)
+                batchSize *= 2;
+            batchBuff = realloc(batchBuff, batchSize);
+            if (batchBuff == NULL)
+            {
+                perror("malloc");
+                _exit(1);
+            }
+        }
+        memcpy(batchBuff + batchLen, dio->outBuff, dio->outPos);
+        batchLen += dio->outPos;
     }
     dio->outPos = 0;
 
+    if (batchLen >= BATCH_LIMIT)
+        batch_push();
 }
 
+void driverio_queue(driverio * dio)
+{
+    static pthread_once_t atexitOnce = PTHREAD_ONCE_INIT;
+    pthread_once(&atexitOnce, &driverio_atexit_register);
 
-static int driverio_is_unix = -1;
+    /* Attached buffers go out in a message of their own, after what the batch holds */
+    if (batchDepth > 0 && dio->outPos > 0)
+    {
+        if (dio->joinCount == 0)
+            batch_append(dio);
+        else
+            batch_push();
+    }
 
-static int is_unix_io()
+    if (dio->outPos > 0)
+    {
+        driverio_push(dio->outBuff, dio->outPos, dio);
+
+        dio->outBuff = NULL;
+        dio->outPos = 0;
+        dio->outSize = 0;
+    }
+
+    free(dio->outBuff);
+    free(dio->joins);
+    free(dio->joinSizes);
+    dio->outBuff = NULL;
+    dio->joins = NULL;
+    dio->joinSizes = NULL;
+    dio->joinCount = 0;
+}
+
+void driverio_flush()
 {
-#ifndef ENABLE_INDI_SHARED_MEMORY
-    return 0;
-#endif
-    if (driverio_is_unix != -1)
+    driverio_drain();
+
+    /* Don't let a driver outrun its client without bound */
+    while (atomic_load(&queueBytes) > OUTPUTQUEUE_LIMIT)
     {
-        return driverio_is_unix;
+        struct timespec wait = { 0, 1000000 };
+        nanosleep(&wait, NULL);
+        driverio_drain();
     }
+}
 
+void driverio_batch_begin()
+{
+    batchDepth++;
+}
+
+void driverio_batch_end()
+{
+    if (batchDepth == 0 || --batchDepth > 0)
+        return;
+
+    batch_push();
+    driverio_flush();
+}
+
+void driverio_priority_begin()
+{
+    priorityDepth++;
+}
+
+void driverio_priority_end()
+{
+    if (priorityDepth > 0)
+        priorityDepth--;
+}
+
+static int driverio_is_unix = -1;
+
+static void detect_unix_io()
+{
 #ifdef SO_DOMAIN
     int domain;
     socklen_t result = sizeof(domain);
@@ -315,68 +510,36 @@ static int is_unix_io()
         driverio_is_unix = 0;
     }
 #endif
+}
+
+static int is_unix_io()
+{
+#ifndef ENABLE_INDI_SHARED_MEMORY
+    return 0;
+#endif
+    static pthread_once_t detectOnce = PTHREAD_ONCE_INIT;
+    pthread_once(&detectOnce, &detect_unix_io);
     return driverio_is_unix;
 }
 
-/* Unix io allow attaching buffer in ancillary data. */
-static void driverio_init_unix(driverio * dio)
+/* Messages are built in a buffer of their own, so threads don't wait on each other until they are written.
+ * Unix io allow attaching buffer in ancillary data. */
+void driverio_init(driverio * dio)
 {
     dio->userio.vprintf = &driverio_vprintf;
     dio->userio.write = &driverio_write;
-    dio->userio.joinbuff = &driverio_join;
+    dio->userio.joinbuff = is_unix_io() ? &driverio_join : NULL;
     dio->user = (void*)dio;
     dio->joins = NULL;
     dio->joinSizes = NULL;
-    dio->locked = 0;
     dio->joinCount = 0;
     dio->outBuff = NULL;
     dio->outPos = 0;
-}
-
-static void driverio_finish_unix(driverio * dio)
-{
-    driverio_flush(dio, NULL, 0);
-    if (dio->locked)
-    {
-        pthread_mutex_unlock(&stdout_mutex);
-        dio->locked = 0;
-    }
-}
-
-static void driverio_init_stdout(driverio * dio)
-{
-    dio->userio = *userio_file();
-    dio->user = stdout;
-    pthread_mutex_lock(&stdout_mutex);
-}
-
-static void driverio_finish_stdout(driverio * dio)
-{
-    (void)dio;
-    fflush(stdout);
-    pthread_mutex_unlock(&stdout_mutex);
-}
-
-void driverio_init(driverio * dio)
-{
-    if (is_unix_io())
-    {
-        driverio_init_unix(dio);
-    }
-    else
-    {
-        driverio_init_stdout(dio);
-    }
+    dio->outSize = 0;
 }
 
 void driverio_finish(driverio * dio)
 {
-    if (is_unix_io())
-    {
-        driverio_finish_unix(dio);
-    }
-    else
-    {
-        driverio_finish_stdout(dio);
-    }
+    driverio_queue(dio);
+    driverio_flush();
 }
@@ -31,10 +31,24 @@ typedef struct driverio
     void ** joins;
     size_t * joinSizes;
     int joinCount;
-    int locked;
     char * outBuff;
-    unsigned int outPos;
+    size_t outPos;
+    size_t outSize;
 } driverio;
 
 void driverio_init(driverio * dio);
 void driverio_finish(driverio * dio);
+
+/* driverio_finish in two steps: messages go out in the order they are queued */
+void driverio_queue(driverio * dio);
+void driverio_flush(void);
+
+/* Messages this thread queues until driverio_batch_end are written as one, except those with attached buffers.
+ * Batches nest, the outermost one writes them */
+void driverio_batch_begin(void);
+void driverio_batch_end(void);
+
+/* Messages this thread queues until driverio_priority_end are written before those queued by other threads.
+ * They keep their order among themselves */
+void driverio_priority_begin(void);
+void driverio_priority_end(void);
@@ -34,6 +34,7 @@
 #include "eventloop.h"
 #include "indidevapi.h"
 #include "indidriver.h"
+#include "inditrace.h"
 #include "lilxml.h"
 
 #include <errno.h>
@@ -145,8 +146,10 @@ static void flushDeferredMessages(void * arg)
             lastDeferredMessage = NULL;
         }
 
+        INDI_TRACE_BEGIN("dispatch");
         if (dispatch(p->root, msg) < 0)
             fprintf(stderr, "%s dispatch error: %s\n", me, msg);
+        INDI_TRACE_END("dispatch");
 
         delXMLEle(p->root);
         free(p);
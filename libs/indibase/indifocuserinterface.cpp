@@ -22,14 +22,25 @@
 
 #include "indilogger.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cmath>
+#include <functional>
 
 namespace INDI
 {
 
+// Clients get a predicted position this often while the focuser moves
+static constexpr int MOTION_PREDICTION_MS = 100;
+// Positions are read no faster than this near the target
+static constexpr uint32_t MOTION_MIN_POLL_MS = 50;
+// Nor this many times slower than usual far from it
+static constexpr uint32_t MOTION_SPARSE_POLLS = 4;
+
 FocuserInterface::FocuserInterface(DefaultDevice * defaultDevice) : m_defaultDevice(defaultDevice)
 {
+    m_MotionTimer.setInterval(MOTION_PREDICTION_MS);
+    m_MotionTimer.callOnTimeout(std::bind(&FocuserInterface::publishPredictedPosition, this));
 }
 
 void FocuserInterface::initProperties(const char * groupName)
@@ -96,6 +107,12 @@ void FocuserInterface::initProperties(const char * groupName)
     IUFillNumberVector(&FocusBacklashNP, FocusBacklashN, 1, m_defaultDevice->getDeviceName(), "FOCUS_BACKLASH_STEPS",
                        "Backlash",
                        groupName, IP_RW, 60, IPS_OK);
+
+    // Motion model
+    IUFillSwitch(&FocusMotionModelS[DefaultDevice::INDI_ENABLED], "INDI_ENABLED", "Enabled", ISS_ON);
+    IUFillSwitch(&FocusMotionModelS[DefaultDevice::INDI_DISABLED], "INDI_DISABLED", "Disabled", ISS_OFF);
+    IUFillSwitchVector(&FocusMotionModelSP, FocusMotionModelS, 2, m_defaultDevice->getDeviceName(), "FOCUS_MOTION_MODEL",
+                       "Predict Position", groupName, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
 }
 
 bool FocuserInterface::updateProperties()
@@ -131,6 +148,8 @@ bool FocuserInterface::updateProperties()
             m_defaultDevice->defineProperty(&FocusBacklashSP);
             m_defaultDevice->defineProperty(&FocusBacklashNP);
         }
+        if (HasMotionModel() && CanAbsMove())
+            m_defaultDevice->defineProperty(&FocusMotionModelSP);
     }
     else
     {
@@ -160,6 +179,11 @@ bool FocuserInterface::updateProperties()
             m_defaultDevice->deleteProperty(FocusBacklashSP.name);
             m_defaultDevice->deleteProperty(FocusBacklashNP.name);
         }
+        if (HasMotionModel() && CanAbsMove())
+            m_defaultDevice->deleteProperty(FocusMotionModelSP.name);
+
+        m_MotionModel.stop();
+        m_MotionTimer.stop();
     }
 
     return true;
@@ -333,6 +357,7 @@ bool FocuserInterface::processNumber(const char * dev, const char * name, double
                 FocusAbsPosNP.s = IPS_BUSY;
                 DEBUGFDEVICE(dev, Logger::DBG_SESSION, "Focuser is moving to position %d", newPos);
                 IDSetNumber(&FocusAbsPosNP, nullptr);
+                startMotionModel(newPos);
                 return true;
             }
 
@@ -401,6 +426,8 @@ bool FocuserInterface::processNumber(const char * dev, const char * name, double
                 IDSetNumber(&FocusAbsPosNP, "Focuser is moving %d steps %s...", newPos,
                             FocusMotionS[0].s == ISS_ON ? "inward" : "outward");
                 IDSetNumber(&FocusAbsPosNP, nullptr);
+                if (CanAbsMove())
+                    startMotionModel(FocusAbsPosN[0].value + (FocusMotionS[0].s == ISS_ON ? -newPos : newPos));
                 return true;
             }
 
@@ -479,6 +506,7 @@ bool FocuserInterface::processSwitch(const char * dev, const char * name, ISStat
             if (AbortFocuser())
             {
                 FocusAbortSP.s = IPS_OK;
+                m_MotionModel.stop();
                 if (CanAbsMove() && FocusAbsPosNP.s != IPS_IDLE)
                 {
                     FocusAbsPosNP.s = IPS_IDLE;
@@ -497,6 +525,18 @@ bool FocuserInterface::processSwitch(const char * dev, const char * name, ISStat
             return true;
         }
 
+        // Motion Model
+        else if (!strcmp(name, FocusMotionModelSP.name))
+        {
+            IUUpdateSwitch(&FocusMotionModelSP, states, names, n);
+            FocusMotionModelSP.s = IPS_OK;
+            if (!isMotionModelEnabled())
+                m_MotionModel.stop();
+            IDSetSwitch(&FocusMotionModelSP, nullptr);
+            m_defaultDevice->saveConfig(true, FocusMotionModelSP.name);
+            return true;
+        }
+
         // Reverse Motion
         else if (!strcmp(name, FocusReverseSP.name))
         {
@@ -609,8 +649,71 @@ bool FocuserInterface::saveConfigItems(FILE * fp)
         IUSaveConfigSwitch(fp, &FocusBacklashSP);
         IUSaveConfigNumber(fp, &FocusBacklashNP);
     }
+    if (HasMotionModel() && CanAbsMove())
+        IUSaveConfigSwitch(fp, &FocusMotionModelSP);
 
     return true;
 }
 
+bool FocuserInterface::isMotionModelEnabled()
+{
+    return HasMotionModel() && CanAbsMove() && FocusMotionModelS[DefaultDevice::INDI_ENABLED].s == ISS_ON;
+}
+
+void FocuserInterface::startMotionModel(double target)
+{
+    if (!isMotionModelEnabled())
+        return;
+
+    m_MotionModel.start(FocusAbsPosN[0].value, target);
+    m_LastPredicted = FocusAbsPosN[0].value;
+    if (!m_MotionTimer.isActive())
+        m_MotionTimer.start();
+}
+
+void FocuserInterface::updateMotionModel(double position)
+{
+    if (!isMotionModelEnabled())
+        return;
+
+    m_MotionModel.sample(position);
+    m_LastPredicted = position;
+}
+
+uint32_t FocuserInterface::getMotionPollingPeriod(uint32_t period) const
+{
+    if (!m_MotionModel.isMoving() || !m_MotionModel.isTrained())
+        return period;
+
+    double eta = m_MotionModel.timeToTarget() * 1000;
+
+    // Close to the target, read it when it should be there
+    if (eta <= period)
+        return std::max(MOTION_MIN_POLL_MS, static_cast<uint32_t>(eta));
+
+    // Far from it, the model fills in, and the next read still comes a period before the arrival
+    return static_cast<uint32_t>(std::min<double>(period * MOTION_SPARSE_POLLS, std::max<double>(period, eta - period)));
+}
+
+void FocuserInterface::publishPredictedPosition()
+{
+    if (FocusAbsPosNP.s != IPS_BUSY || !m_MotionModel.isMoving())
+    {
+        m_MotionModel.stop();
+        m_MotionTimer.stop();
+        return;
+    }
+
+    double predicted = std::round(m_MotionModel.predict());
+    if (!m_MotionModel.isTrained() || predicted == m_LastPredicted)
+        return;
+    m_LastPredicted = predicted;
+
+    // The driver keeps the position it read, only clients get the prediction
+    double position = FocusAbsPosN[0].value;
+    FocusAbsPosN[0].value = predicted;
+    IDSetNumber(&FocusAbsPosNP, nullptr);
+    FocusAbsPosN[0].value = position;
+}
+
 }
@@ -21,6 +21,8 @@
 #pragma once
 
 #include "indibase.h"
+#include "indifocusermotionmodel.h"
+#include "inditimer.h"
 
 #include <stdint.h>
 
@@ -77,7 +79,8 @@ class FocuserInterface
             FOCUSER_CAN_REVERSE        = 1 << 3, /*!< Is it possible to reverse focuser motion? */
             FOCUSER_CAN_SYNC           = 1 << 4, /*!< Can the focuser sync to a custom position */
             FOCUSER_HAS_VARIABLE_SPEED = 1 << 5, /*!< Can the focuser move in different configurable speeds? */
-            FOCUSER_HAS_BACKLASH       = 1 << 6  /*!< Can the focuser compensate for backlash? */
+            FOCUSER_HAS_BACKLASH       = 1 << 6, /*!< Can the focuser compensate for backlash? */
+            FOCUSER_HAS_MOTION_MODEL   = 1 << 7  /*!< Does the driver report positions to the motion model during moves? */
         } FocuserCapability;
 
         /**
@@ -153,6 +156,14 @@ class FocuserInterface
             return capability & FOCUSER_HAS_BACKLASH;
         }
 
+        /**
+         * @return True if the driver predicts positions between reads with the motion model.
+         */
+        bool HasMotionModel()
+        {
+            return capability & FOCUSER_HAS_MOTION_MODEL;
+        }
+
     protected:
         explicit FocuserInterface(DefaultDevice * defaultDevice);
         virtual ~FocuserInterface() = default;
@@ -257,6 +268,23 @@ class FocuserInterface
          */
         virtual bool AbortFocuser();
 
+        /**
+         * @brief updateMotionModel Drivers with FOCUSER_HAS_MOTION_MODEL call it with each position they read from the
+         * hardware while moving. In between, clients get the positions the model predicts from the step rate and
+         * acceleration it learned, at a high rate and without any serial traffic.
+         * @param position Position just read, also stored in FocusAbsPosN by the driver as usual.
+         */
+        void updateMotionModel(double position);
+
+        /**
+         * @brief getMotionPollingPeriod Drivers with FOCUSER_HAS_MOTION_MODEL poll the position after this period
+         * while moving: longer than usual far from the target, when the model predicts the position, and until the
+         * predicted arrival close to it.
+         * @param period Usual polling period in milliseconds.
+         * @return The period to poll the position after, period if the model does not know the focuser yet.
+         */
+        uint32_t getMotionPollingPeriod(uint32_t period) const;
+
         /**
          * @brief saveConfigItems save focuser properties defined in the interface in config file
          * @param fp pointer to config file
@@ -310,10 +338,23 @@ class FocuserInterface
         INumberVectorProperty FocusBacklashNP;
         INumber FocusBacklashN[1];
 
+        // Predicted positions, with FOCUSER_HAS_MOTION_MODEL
+        ISwitchVectorProperty FocusMotionModelSP;
+        ISwitch FocusMotionModelS[2];
+
         uint32_t capability;
 
         double lastTimerValue = { 0 };
 
         DefaultDevice * m_defaultDevice { nullptr };
+
+    private:
+        bool isMotionModelEnabled();
+        void startMotionModel(double target);
+        void publishPredictedPosition();
+
+        FocuserMotionModel m_MotionModel;
+        INDI::Timer m_MotionTimer;
+        double m_LastPredicted { 0 };
 };
 }
@@ -0,0 +1,129 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indifocusermotionmodel.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace INDI
+{
+
+// Weight of the latest measurement in the averages
+static constexpr double LEARNING_RATE = 0.3;
+// Samples closer than this say more about the serial line than about the focuser
+static constexpr double MIN_SAMPLE_INTERVAL = 0.02;
+
+void FocuserMotionModel::start(double position, double target, Clock::time_point now)
+{
+    m_Target        = target;
+    m_Direction     = target >= position ? 1 : -1;
+    m_StartTime     = now;
+    m_StartPosition = position;
+    m_LastTime      = now;
+    m_LastPosition  = position;
+    m_Samples       = 0;
+    m_Moving        = std::fabs(target - position) >= 1;
+}
+
+void FocuserMotionModel::sample(double position, Clock::time_point now)
+{
+    if (!m_Moving)
+        return;
+
+    double elapsed = seconds(now - m_LastTime);
+    if (elapsed >= MIN_SAMPLE_INTERVAL)
+    {
+        double steps = std::fabs(position - m_LastPosition);
+
+        if (m_Samples == 0)
+        {
+            // From standstill: once the rate is known, the shortfall on it is the acceleration
+            double travelled = std::fabs(position - m_StartPosition);
+            if (m_StepRate <= 0 && travelled > 0)
+                m_StepRate = travelled / elapsed;
+            else if (m_StepRate * elapsed > travelled + 1)
+            {
+                double acceleration = m_StepRate * m_StepRate / (2 * (m_StepRate * elapsed - travelled));
+                m_Acceleration = m_Acceleration > 0 ? m_Acceleration + LEARNING_RATE * (acceleration - m_Acceleration) :
+                                 acceleration;
+            }
+        }
+        else if (steps > 0 && std::fabs(m_Target - position) >= 1)
+        {
+            // Cruising, short of the deceleration at the target
+            double rate = steps / elapsed;
+            m_StepRate = m_StepRate > 0 ? m_StepRate + LEARNING_RATE * (rate - m_StepRate) : rate;
+        }
+
+        m_Samples++;
+    }
+
+    m_LastTime     = now;
+    m_LastPosition = position;
+
+    if (std::fabs(m_Target - position) < 1)
+        m_Moving = false;
+}
+
+void FocuserMotionModel::stop()
+{
+    m_Moving = false;
+}
+
+double FocuserMotionModel::travel(double elapsed) const
+{
+    double rate = m_StepRate;
+    double steps;
+
+    if (m_Acceleration <= 0)
+        steps = rate * elapsed;
+    else
+    {
+        // Accelerating from the speed reached at the last sample, up to the step rate
+        double speed = std::min(rate, m_Acceleration * seconds(m_LastTime - m_StartTime));
+        double ramp  = (rate - speed) / m_Acceleration;
+        if (elapsed < ramp)
+            steps = speed * elapsed + m_Acceleration * elapsed * elapsed / 2;
+        else
+            steps = speed * ramp + m_Acceleration * ramp * ramp / 2 + rate * (elapsed - ramp);
+    }
+
+    return std::min(steps, std::fabs(m_Target - m_LastPosition));
+}
+
+double FocuserMotionModel::predict(Clock::time_point now) const
+{
+    if (!m_Moving || !isTrained())
+        return m_LastPosition;
+
+    return m_LastPosition + m_Direction * travel(std::max(0.0, seconds(now - m_LastTime)));
+}
+
+double FocuserMotionModel::timeToTarget(Clock::time_point now) const
+{
+    if (!m_Moving)
+        return 0;
+    if (!isTrained())
+        return -1;
+
+    double remaining = std::fabs(m_Target - predict(now));
+    // Slowing down at the end takes rate / 2a longer than going through at full speed
+    double braking = m_Acceleration > 0 ? m_StepRate / (2 * m_Acceleration) : 0;
+    return remaining / m_StepRate + (remaining > 0 ? braking : 0);
+}
+
+}
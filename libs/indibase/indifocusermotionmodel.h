@@ -0,0 +1,99 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <chrono>
+
+namespace INDI
+{
+
+/**
+ * @class FocuserMotionModel
+ * @brief The FocuserMotionModel class learns how fast a focuser moves from the positions read during its moves.
+ *
+ * The step rate and the acceleration are averaged over the moves, so that between two reads of the hardware the
+ * position of the focuser can be predicted, and the time it reaches its target estimated. The model knows nothing
+ * until a move was sampled twice.
+ */
+class FocuserMotionModel
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+    public:
+        /** @brief A move from position to target starts. */
+        void start(double position, double target, Clock::time_point now = Clock::now());
+
+        /** @brief The hardware reported position during the move, the move ends once it is at the target. */
+        void sample(double position, Clock::time_point now = Clock::now());
+
+        /** @brief The move ended, on target or not. */
+        void stop();
+
+        bool isMoving() const
+        {
+            return m_Moving;
+        }
+
+        /** @returns True once the step rate is known. */
+        bool isTrained() const
+        {
+            return m_StepRate > 0;
+        }
+
+        /** @returns Steps per second when moving at full speed, 0 if not known yet. */
+        double stepRate() const
+        {
+            return m_StepRate;
+        }
+
+        /** @returns Steps per second squared, 0 if not known yet. */
+        double acceleration() const
+        {
+            return m_Acceleration;
+        }
+
+        /** @returns The predicted position, the last one sampled if the model is not trained. */
+        double predict(Clock::time_point now = Clock::now()) const;
+
+        /** @returns The predicted seconds before the target is reached, or -1 if the model is not trained. */
+        double timeToTarget(Clock::time_point now = Clock::now()) const;
+
+    private:
+        // Steps moved from the last sample after elapsed seconds, before the target
+        double travel(double elapsed) const;
+
+        static double seconds(Clock::duration duration)
+        {
+            return std::chrono::duration<double>(duration).count();
+        }
+
+        bool m_Moving {false};
+        double m_Target {0};
+        double m_Direction {1};
+
+        Clock::time_point m_StartTime;
+        double m_StartPosition {0};
+        Clock::time_point m_LastTime;
+        double m_LastPosition {0};
+        int m_Samples {0};
+
+        double m_StepRate {0};
+        double m_Acceleration {0};
+};
+
+}
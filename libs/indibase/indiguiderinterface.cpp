@@ -19,6 +19,7 @@
 */
 
 #include "indiguiderinterface.h"
+#include "indiguidepulser.h"
 
 #include <cstring>
 
@@ -37,6 +38,9 @@ GuiderInterface::GuiderInterface(DefaultDevice *device) : m_defaultDevice(device
 /////////////////////////////////////////////////////////////////////////////////////////////
 GuiderInterface::~GuiderInterface()
 {
+    for (int id : m_PulseIds)
+        if (id >= 0)
+            GuidePulser::global().cancel(id);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -51,6 +55,10 @@ void GuiderInterface::initProperties(const char *groupName)
     GuideWENP[DIRECTION_WEST].fill("TIMED_GUIDE_W", "West (ms)", "%.f", 0, 60000, 100, 0);
     GuideWENP[DIRECTION_EAST].fill("TIMED_GUIDE_E", "East (ms)", "%.f", 0, 60000, 100, 0);
     GuideWENP.fill(m_defaultDevice->getDeviceName(), "TELESCOPE_TIMED_GUIDE_WE", "Guide E/W", groupName, IP_RW, 60, IPS_IDLE);
+
+    GuidePulseNP[AXIS_RA].fill("GUIDE_PULSE_WE", "W/E (ms)", "%.3f", 0, 60000, 0, 0);
+    GuidePulseNP[AXIS_DE].fill("GUIDE_PULSE_NS", "N/S (ms)", "%.3f", 0, 60000, 0, 0);
+    GuidePulseNP.fill(m_defaultDevice->getDeviceName(), "TELESCOPE_GUIDE_PULSE", "Guide Pulses", groupName, IP_RO, 60, IPS_IDLE);
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////
@@ -62,11 +70,15 @@ bool GuiderInterface::updateProperties()
     {
         m_defaultDevice->defineProperty(GuideNSNP);
         m_defaultDevice->defineProperty(GuideWENP);
+        if (m_PulseDefined)
+            m_defaultDevice->defineProperty(GuidePulseNP);
     }
     else
     {
         m_defaultDevice->deleteProperty(GuideNSNP);
         m_defaultDevice->deleteProperty(GuideWENP);
+        if (m_PulseDefined)
+            m_defaultDevice->deleteProperty(GuidePulseNP);
     }
 
     return true;
@@ -117,6 +129,39 @@ bool GuiderInterface::processNumber(const char *dev, const char *name, double va
     return false;
 }
 
+IPState GuiderInterface::timeGuidePulse(INDI_EQ_AXIS axis, uint32_t ms, const std::function<bool()> &start,
+                                        const std::function<void()> &stop)
+{
+    if (m_PulseIds[axis] >= 0)
+        GuidePulser::global().cancel(m_PulseIds[axis]);
+    m_PulseIds[axis] = -1;
+
+    if (!start())
+        return IPS_ALERT;
+
+    // A pulse that ended as the next one started is not the one the guide properties wait for
+    int const serial = ++m_PulseSerials[axis];
+    m_PulseIds[axis] = GuidePulser::global().start(ms, stop, [this, axis, serial](double measured)
+    {
+        if (serial != m_PulseSerials[axis])
+            return;
+        m_PulseIds[axis] = -1;
+
+        GuidePulseNP[axis].setValue(measured);
+        GuidePulseNP.setState(IPS_OK);
+        if (!m_PulseDefined)
+        {
+            m_PulseDefined = true;
+            m_defaultDevice->defineProperty(GuidePulseNP);
+        }
+        else
+            GuidePulseNP.apply();
+
+        GuideComplete(axis);
+    });
+    return IPS_BUSY;
+}
+
 void GuiderInterface::GuideComplete(INDI_EQ_AXIS axis)
 {
     switch (axis)
@@ -45,6 +45,7 @@
  */
 
 #include <stdint.h>
+#include <functional>
 #include "defaultdevice.h"
 
 // Alias
@@ -120,10 +121,26 @@ class GuiderInterface
          */
         bool processNumber(const char *dev, const char *name, double values[], char *names[], int n);
 
+        /**
+         * @brief Sends a guide pulse on axis: calls start, then stop ms milliseconds later from the thread of
+         * GuidePulser::global(), on time however busy the event loop is. GuideComplete() is then called from the
+         * event loop, and the measured length of the pulse is published in GuidePulseNP. A pulse on axis that did
+         * not end yet is dropped, without calling its stop, before start is called.
+         * @return IPS_BUSY, or IPS_ALERT if start returned false, for GuideNorth() and the others to return.
+         */
+        IPState timeGuidePulse(INDI_EQ_AXIS axis, uint32_t ms, const std::function<bool()> &start,
+                               const std::function<void()> &stop);
+
         INDI::PropertyNumber GuideNSNP {2};
         INDI::PropertyNumber GuideWENP {2};
 
+        // Measured length of the last pulses timed by timeGuidePulse(), defined once there is one
+        INDI::PropertyNumber GuidePulseNP {2};
+
     private:
         DefaultDevice *m_defaultDevice { nullptr };
+        int m_PulseIds[2] {-1, -1};
+        int m_PulseSerials[2] {0, 0};
+        bool m_PulseDefined {false};
 };
 }
@@ -22,14 +22,193 @@
 #include "indiutility.h"
 
 #include <dirent.h>
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <condition_variable>
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <sys/stat.h>
 
 namespace INDI
 {
+
+namespace
+{
+
+/** A line queued for the log file, stamped when it was printed */
+struct LogRecord
+{
+    struct timeval time;
+    unsigned int rank;
+    char device[MAXINDIDEVICE];
+    char message[257];
+};
+
+/** Lines of a single thread: it is the only one pushing, the writer is the only one popping */
+struct LogRing
+{
+    static const size_t capacity = 256;
+
+    LogRecord records[capacity];
+    std::atomic<size_t> head {0};
+    std::atomic<size_t> tail {0};
+    std::atomic<bool> abandoned {false};
+
+    size_t size() const
+    {
+        return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire);
+    }
+
+    bool push(const struct timeval &time, unsigned int rank, const char *device, const char *message)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == capacity)
+            return false;
+
+        LogRecord &record = records[h % capacity];
+        record.time = time;
+        record.rank = rank;
+        strncpy(record.device, device != nullptr ? device : "", MAXINDIDEVICE - 1);
+        record.device[MAXINDIDEVICE - 1] = '\0';
+        strcpy(record.message, message);
+
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(std::vector<LogRecord> &batch)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return false;
+
+        batch.push_back(records[t % capacity]);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/** Rings of all threads that printed in asynchronous mode */
+std::mutex ringsLock;
+std::vector<std::shared_ptr<LogRing>> rings;
+
+/** Ring of the current thread, left to the writer to drain when the thread ends */
+struct LogRingHandle
+{
+    std::shared_ptr<LogRing> ring;
+
+    ~LogRingHandle()
+    {
+        if (ring)
+            ring->abandoned = true;
+    }
+};
+
+LogRing &threadRing()
+{
+    thread_local LogRingHandle handle;
+    if (!handle.ring)
+    {
+        handle.ring = std::make_shared<LogRing>();
+        std::lock_guard<std::mutex> lock(ringsLock);
+        rings.push_back(handle.ring);
+    }
+    return *handle.ring;
+}
+
+}
+
+/** Writes the queued lines to the log file, in batches */
+class Logger::AsyncWriter
+{
+    public:
+        explicit AsyncWriter(Logger *logger)
+            : logger(logger)
+        {
+            thread = std::thread(&AsyncWriter::run, this);
+        }
+
+        ~AsyncWriter()
+        {
+            {
+                std::lock_guard<std::mutex> lock(wakeLock);
+                running = false;
+            }
+            wakeUp.notify_one();
+            thread.join();
+            flush();
+        }
+
+        void wake()
+        {
+            wakeUp.notify_one();
+        }
+
+        /** Write all queued lines from the calling thread */
+        void flush()
+        {
+            std::lock_guard<std::mutex> lock(drainLock);
+
+            {
+                std::lock_guard<std::mutex> lock(ringsLock);
+                for (auto &ring : rings)
+                    while (ring->pop(batch));
+
+                rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<LogRing> &ring)
+                {
+                    return ring->abandoned && ring->size() == 0;
+                }), rings.end());
+            }
+
+            if (batch.empty())
+                return;
+
+            // the rings are in order, merge them by their stamps
+            std::stable_sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b)
+            {
+                return timercmp(&a.time, &b.time, <);
+            });
+
+            std::lock_guard<std::mutex> file(fileLock);
+            for (const auto &record : batch)
+                logger->writeLine(record.rank, record.time, record.device, record.message);
+            logger->out_.flush();
+            batch.clear();
+        }
+
+    public:
+        /** Held while writing to the file, or to reopen it */
+        std::mutex fileLock;
+
+    private:
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(wakeLock);
+            while (running)
+            {
+                wakeUp.wait_for(lock, std::chrono::milliseconds(100));
+                lock.unlock();
+                flush();
+                lock.lock();
+            }
+        }
+
+    private:
+        Logger *logger;
+        std::thread thread;
+
+        std::mutex wakeLock;
+        std::condition_variable wakeUp;
+        bool running {true};
+
+        std::mutex drainLock;
+        std::vector<LogRecord> batch;
+};
 char Logger::Tags[Logger::nlevels][MAXINDINAME] = { "ERROR",       "WARNING",     "INFO",        "DEBUG",
                                                     "DBG_EXTRA_1", "DBG_EXTRA_2", "DBG_EXTRA_3", "DBG_EXTRA_4"
                                                   };
@@ -278,12 +457,72 @@ void Logger::unlock()
 Logger::Logger() : configured_(false)
 {
     gettimeofday(&initialTime_, nullptr);
+
+    if (getenv("INDILOGASYNC"))
+        setAsynchronous(true);
+}
+
+void Logger::setAsynchronous(bool enable)
+{
+    if (enable && !async_)
+    {
+        // the instance is never deleted, write what is left when the driver exits
+        static bool atExit = (std::atexit([]
+        {
+            if (m_ != nullptr)
+                m_->setAsynchronous(false);
+        }) == 0);
+        INDI_UNUSED(atExit);
+
+        async_.reset(new AsyncWriter(this));
+    }
+    else if (!enable)
+    {
+        async_.reset();
+    }
+}
+
+bool Logger::isAsynchronous() const
+{
+    return async_ != nullptr;
+}
+
+void Logger::flush()
+{
+    if (async_)
+        async_->flush();
+}
+
+void Logger::writeLine(unsigned int rank, const struct timeval &time, const char *devicename, const char *message)
+{
+    struct timeval resTime;
+    char usec[7];
+
+    timersub(&time, &initialTime_, &resTime);
+#if defined(__APPLE__)
+    snprintf(usec, 7, "%06d", resTime.tv_usec);
+#else
+    snprintf(usec, 7, "%06ld", resTime.tv_usec);
+#endif
+
+    if (nDevices == 1)
+        out_ << Tags[rank] << "\t" << (resTime.tv_sec) << "." << (usec) << " sec"
+             << "\t: " << message << '\n';
+    else
+        out_ << Tags[rank] << "\t" << (resTime.tv_sec) << "." << (usec) << " sec"
+             << "\t: [" << devicename << "] " << message << '\n';
 }
 
 void Logger::configure(const std::string &outputFile, const loggerConf configuration, const int fileVerbosityLevel,
                        const int screenVerbosityLevel)
 {
+    // lines queued so far belong to the old file
+    flush();
+
     Logger::lock();
+    std::unique_lock<std::mutex> file;
+    if (async_)
+        file = std::unique_lock<std::mutex>(async_->fileLock);
 
     fileVerbosityLevel_   = fileVerbosityLevel;
     screenVerbosityLevel_ = screenVerbosityLevel;
@@ -323,11 +562,15 @@ void Logger::configure(const std::string &outputFile, const loggerConf configura
     configuration_ = configuration;
     configured_    = true;
 
+    if (file)
+        file.unlock();
     Logger::unlock();
 }
 
 Logger::~Logger()
 {
+    async_.reset();
+
     Logger::lock();
     if (configuration_ & file_on)
         out_.close();
@@ -379,12 +622,15 @@ void Logger::print(const char *devicename, const unsigned int verbosityLevel, co
 
     INDI_UNUSED(file);
     INDI_UNUSED(line);
-    bool filelog   = (verbosityLevel & fileVerbosityLevel_) != 0;
-    bool screenlog = (verbosityLevel & screenVerbosityLevel_) != 0;
+    bool filelog   = (configuration_ & file_on) && (verbosityLevel & fileVerbosityLevel_) != 0;
+    bool screenlog = (configuration_ & screen_on) && (verbosityLevel & screenVerbosityLevel_) != 0;
+
+    // nothing to format for disabled levels, debug messages are cheap when they are off
+    if (configured_ && !filelog && !screenlog)
+        return;
 
     va_list ap;
     char msg[257];
-    char usec[7];
 
     msg[256] = '\0';
     va_start(ap, message);
@@ -397,28 +643,28 @@ void Logger::print(const char *devicename, const unsigned int verbosityLevel, co
         std::cerr << msg << std::endl;
         return;
     }
-    struct timeval currentTime, resTime;
-    usec[6] = '\0';
+    struct timeval currentTime;
     gettimeofday(&currentTime, nullptr);
-    timersub(&currentTime, &initialTime_, &resTime);
-#if defined(__APPLE__)
-    snprintf(usec, 7, "%06d", resTime.tv_usec);
-#else
-    snprintf(usec, 7, "%06ld", resTime.tv_usec);
-#endif
+
+    if (filelog && async_)
+    {
+        LogRing &ring = threadRing();
+        while (!ring.push(currentTime, rank(verbosityLevel), devicename, msg))
+            async_->flush();
+        if (ring.size() > LogRing::capacity / 2)
+            async_->wake();
+        filelog = false;
+    }
+
     Logger::lock();
 
-    if ((configuration_ & file_on) && filelog)
+    if (filelog)
     {
-        if (nDevices == 1)
-            out_ << Tags[rank(verbosityLevel)] << "\t" << (resTime.tv_sec) << "." << (usec) << " sec"
-                 << "\t: " << msg << std::endl;
-        else
-            out_ << Tags[rank(verbosityLevel)] << "\t" << (resTime.tv_sec) << "." << (usec) << " sec"
-                 << "\t: [" << devicename << "] " << msg << std::endl;
+        writeLine(rank(verbosityLevel), currentTime, devicename, msg);
+        out_.flush();
     }
 
-    if ((configuration_ & screen_on) && screenlog)
+    if (screenlog)
         IDMessage(devicename, "[%s] %s", Tags[rank(verbosityLevel)], msg);
 
     Logger::unlock();
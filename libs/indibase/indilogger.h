@@ -25,6 +25,7 @@
 
 #include <stdarg.h>
 #include <fstream>
+#include <memory>
 #include <ostream>
 #include <string>
 #include <sstream>
@@ -185,6 +186,13 @@ class Logger
 
         static INDI::DefaultDevice *parentDevice;
 
+        /** Background writer of the log file, when asynchronous */
+        class AsyncWriter;
+        std::unique_ptr<AsyncWriter> async_;
+
+        /** Write one line to the log file */
+        void writeLine(unsigned int rank, const struct timeval &time, const char *devicename, const char *message);
+
     public:
         enum VerbosityLevel
         {
@@ -267,6 +275,24 @@ class Logger
         void configure(const std::string &outputFile, const loggerConf configuration, const int fileVerbosityLevel,
                        const int screenVerbosityLevel);
 
+        /**
+         * @brief Write the log file from a background thread.
+         * The calling thread formats the message and stamps it, then queues it in a ring buffer of its own,
+         * without any lock. The background thread writes the queued lines in batches, sorted by time,
+         * and flushes the file once per batch instead of once per line.
+         * If the ring buffer of a thread is full, its lines are written synchronously until there is room.
+         * Messages to the client are not affected, they are always sent immediately.
+         * The asynchronous mode is also enabled by setting the INDILOGASYNC environment variable.
+         * @param enable true to enable, false to write the pending lines and go back to synchronous writes.
+         */
+        void setAsynchronous(bool enable);
+
+        /** @return true if the log file is written from a background thread. */
+        bool isAsynchronous() const;
+
+        /** @brief Write all the lines queued so far to the log file, in asynchronous mode. */
+        void flush();
+
         static struct switchinit DebugLevelSInit[nlevels];
         static ISwitch DebugLevelS[nlevels];
         static ISwitchVectorProperty DebugLevelSP;
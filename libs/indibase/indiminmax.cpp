@@ -0,0 +1,241 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indiminmax.h"
+#include "indithreadpool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// Frames with fewer pixels are scanned on the calling thread, larger ones in chunks of this many pixels
+constexpr size_t PARALLEL_PIXELS = 1u << 20;
+constexpr size_t CHUNK_PIXELS    = 1u << 16;
+
+#if defined(__AVX2__) || defined(__SSE2__)
+// Range of the lanes of two vectors of extremes, of type T
+template <typename T, typename Vector>
+void mergeLanes(const Vector &lo, const Vector &hi, uint32_t &min, uint32_t &max)
+{
+    T lanes[2][sizeof(Vector) / sizeof(T)];
+    memcpy(lanes[0], &lo, sizeof(Vector));
+    memcpy(lanes[1], &hi, sizeof(Vector));
+    for (size_t i = 0; i < sizeof(Vector) / sizeof(T); i++)
+    {
+        min = std::min<uint32_t>(min, lanes[0][i]);
+        max = std::max<uint32_t>(max, lanes[1][i]);
+    }
+}
+#endif
+
+void minMax8(const uint8_t *p, size_t n, uint32_t &min, uint32_t &max)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    if (n >= 32)
+    {
+        __m256i lo = _mm256_set1_epi8(static_cast<char>(0xff)), hi = _mm256_setzero_si256();
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+            lo = _mm256_min_epu8(lo, v);
+            hi = _mm256_max_epu8(hi, v);
+        }
+        mergeLanes<uint8_t>(lo, hi, min, max);
+    }
+#endif
+#if defined(__SSE2__)
+    if (n - i >= 16)
+    {
+        __m128i lo = _mm_set1_epi8(static_cast<char>(0xff)), hi = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+            lo = _mm_min_epu8(lo, v);
+            hi = _mm_max_epu8(hi, v);
+        }
+        mergeLanes<uint8_t>(lo, hi, min, max);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (n >= 16)
+    {
+        uint8x16_t lo = vdupq_n_u8(0xff), hi = vdupq_n_u8(0);
+        for (; i + 16 <= n; i += 16)
+        {
+            uint8x16_t v = vld1q_u8(p + i);
+            lo = vminq_u8(lo, v);
+            hi = vmaxq_u8(hi, v);
+        }
+        min = std::min<uint32_t>(min, vminvq_u8(lo));
+        max = std::max<uint32_t>(max, vmaxvq_u8(hi));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        min = std::min<uint32_t>(min, p[i]);
+        max = std::max<uint32_t>(max, p[i]);
+    }
+}
+
+void minMax16(const uint16_t *p, size_t n, uint32_t &min, uint32_t &max)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    if (n >= 16)
+    {
+        __m256i lo = _mm256_set1_epi16(static_cast<short>(0xffff)), hi = _mm256_setzero_si256();
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+            lo = _mm256_min_epu16(lo, v);
+            hi = _mm256_max_epu16(hi, v);
+        }
+        mergeLanes<uint16_t>(lo, hi, min, max);
+    }
+#endif
+#if defined(__SSE2__)
+    // SSE2 only compares signed 16 bit values: flipping the sign bit keeps the order of unsigned ones
+    if (n - i >= 8)
+    {
+        const __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+        __m128i lo = _mm_set1_epi16(0x7fff), hi = _mm_set1_epi16(static_cast<short>(0x8000));
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i)), sign);
+            lo = _mm_min_epi16(lo, v);
+            hi = _mm_max_epi16(hi, v);
+        }
+        mergeLanes<uint16_t>(_mm_xor_si128(lo, sign), _mm_xor_si128(hi, sign), min, max);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (n >= 8)
+    {
+        uint16x8_t lo = vdupq_n_u16(0xffff), hi = vdupq_n_u16(0);
+        for (; i + 8 <= n; i += 8)
+        {
+            uint16x8_t v = vld1q_u16(p + i);
+            lo = vminq_u16(lo, v);
+            hi = vmaxq_u16(hi, v);
+        }
+        min = std::min<uint32_t>(min, vminvq_u16(lo));
+        max = std::max<uint32_t>(max, vmaxvq_u16(hi));
+    }
+#endif
+    for (; i < n; i++)
+    {
+        min = std::min<uint32_t>(min, p[i]);
+        max = std::max<uint32_t>(max, p[i]);
+    }
+}
+
+void minMax32(const uint32_t *p, size_t n, uint32_t &min, uint32_t &max)
+{
+    size_t i = 0;
+#if defined(__AVX2__)
+    if (n >= 8)
+    {
+        __m256i lo = _mm256_set1_epi32(-1), hi = _mm256_setzero_si256();
+        for (; i + 8 <= n; i += 8)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+            lo = _mm256_min_epu32(lo, v);
+            hi = _mm256_max_epu32(hi, v);
+        }
+        mergeLanes<uint32_t>(lo, hi, min, max);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    if (n >= 4)
+    {
+        uint32x4_t lo = vdupq_n_u32(0xffffffff), hi = vdupq_n_u32(0);
+        for (; i + 4 <= n; i += 4)
+        {
+            uint32x4_t v = vld1q_u32(p + i);
+            lo = vminq_u32(lo, v);
+            hi = vmaxq_u32(hi, v);
+        }
+        min = std::min(min, vminvq_u32(lo));
+        max = std::max(max, vmaxvq_u32(hi));
+    }
+#endif
+    // SSE2 has no unsigned 32 bit comparisons, the compiler vectorizes this loop as it can
+    for (; i < n; i++)
+    {
+        min = std::min(min, p[i]);
+        max = std::max(max, p[i]);
+    }
+}
+
+}
+
+namespace INDI
+{
+
+void mergePixelMinMax(const void *pixels, size_t count, int bpp, uint32_t &min, uint32_t &max)
+{
+    switch (bpp)
+    {
+        case 8:
+            minMax8(static_cast<const uint8_t *>(pixels), count, min, max);
+            break;
+        case 16:
+            minMax16(static_cast<const uint16_t *>(pixels), count, min, max);
+            break;
+        case 32:
+            minMax32(static_cast<const uint32_t *>(pixels), count, min, max);
+            break;
+    }
+}
+
+bool getPixelMinMax(const void *pixels, size_t count, int bpp, double *min, double *max)
+{
+    if ((bpp != 8 && bpp != 16 && bpp != 32) || count == 0)
+        return false;
+
+    uint32_t lo = UINT32_MAX, hi = 0;
+
+    if (count < PARALLEL_PIXELS)
+        mergePixelMinMax(pixels, count, bpp, lo, hi);
+    else
+    {
+        size_t const chunks = (count + CHUNK_PIXELS - 1) / CHUNK_PIXELS;
+        std::vector<uint32_t> los(chunks, UINT32_MAX), his(chunks, 0);
+
+        ThreadPool::global().parallelFor(0, chunks, [&](size_t chunk)
+        {
+            size_t const begin = chunk * CHUNK_PIXELS;
+            mergePixelMinMax(static_cast<const uint8_t *>(pixels) + begin * (bpp / 8),
+                             std::min(CHUNK_PIXELS, count - begin), bpp, los[chunk], his[chunk]);
+        }, 4);
+
+        lo = *std::min_element(los.begin(), los.end());
+        hi = *std::max_element(his.begin(), his.end());
+    }
+
+    *min = lo;
+    *max = hi;
+    return true;
+}
+
+}
@@ -0,0 +1,37 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace INDI
+{
+
+/**
+ * @brief Finds the smallest and largest of count unsigned pixels of bpp bits, 8, 16 or 32.
+ * Large frames are scanned in parallel on the global ThreadPool.
+ * @return False if bpp is not supported or count is 0, min and max are then left unchanged.
+ */
+bool getPixelMinMax(const void *pixels, size_t count, int bpp, double *min, double *max);
+
+/**
+ * @brief Merges the range of count unsigned pixels of bpp bits, 8, 16 or 32, into min and max, on the calling thread.
+ * Kernels writing a frame row by row can call it on each row they just wrote, while it is still in cache.
+ */
+void mergePixelMinMax(const void *pixels, size_t count, int bpp, uint32_t &min, uint32_t &max);
+
+}
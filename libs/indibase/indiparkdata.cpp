@@ -0,0 +1,308 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indiparkdata.h"
+
+#include "indidevapi.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <wordexp.h>
+
+namespace INDI
+{
+
+static struct timespec modificationTime(const struct stat &st)
+{
+#ifdef __APPLE__
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+}
+
+ParkDataStore &ParkDataStore::instance(const std::string &fileName)
+{
+    static std::mutex lock;
+    static std::map<std::string, std::unique_ptr<ParkDataStore>> stores;
+
+    const std::lock_guard<std::mutex> guard(lock);
+    auto &store = stores[fileName];
+    if (!store)
+        store.reset(new ParkDataStore(fileName));
+    return *store;
+}
+
+ParkDataStore::ParkDataStore(const std::string &fileName) : m_FileName(fileName)
+{
+    wordexp_t wexp;
+    if (wordexp(fileName.c_str(), &wexp, 0) == 0 && wexp.we_wordc > 0)
+        m_FileName = wexp.we_wordv[0];
+    wordfree(&wexp);
+}
+
+ParkDataStore::~ParkDataStore()
+{
+    {
+        const std::lock_guard<std::mutex> lock(m_Lock);
+        m_Stopping = true;
+    }
+    m_Wake.notify_all();
+
+    // The queued writes are done first
+    if (m_Writer.joinable())
+        m_Writer.join();
+
+    delXMLEle(m_Root);
+}
+
+void ParkDataStore::refresh()
+{
+    // What is queued is newer than the file
+    if (m_HasPending || m_Writing)
+        return;
+
+    struct stat st;
+    if (stat(m_FileName.c_str(), &st) != 0)
+    {
+        snprintf(m_Error, sizeof(m_Error), "%s", strerror(errno));
+        return;
+    }
+
+    // Unchanged since the store read or wrote it
+    struct timespec stamp = modificationTime(st);
+    if (st.st_size == m_Size && stamp.tv_sec == m_Stamp.tv_sec && stamp.tv_nsec == m_Stamp.tv_nsec)
+        return;
+
+    delXMLEle(m_Root);
+    m_Root = nullptr;
+    m_Error[0] = '\0';
+
+    FILE *fp = fopen(m_FileName.c_str(), "r");
+    if (fp == nullptr)
+    {
+        snprintf(m_Error, sizeof(m_Error), "%s", strerror(errno));
+        return;
+    }
+
+    LilXML *lp = newLilXML();
+    m_Root = readXMLFile(fp, lp, m_Error);
+    delLilXML(lp);
+    fclose(fp);
+
+    m_Stamp = stamp;
+    m_Size  = st.st_size;
+}
+
+XMLEle *ParkDataStore::findDevice(const char *device)
+{
+    if (m_Root == nullptr)
+        return nullptr;
+
+    for (XMLEle *ep = nextXMLEle(m_Root, 1); ep != nullptr; ep = nextXMLEle(m_Root, 0))
+    {
+        if (strcmp(tagXMLEle(ep), "device") != 0)
+            continue;
+
+        const char *name = findXMLAttValu(ep, "name");
+        if (!strcmp(name, device))
+            return ep;
+    }
+    return nullptr;
+}
+
+const char *ParkDataStore::read(const char *device, Entry &entry)
+{
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    refresh();
+
+    entry = Entry();
+
+    if (m_Root == nullptr)
+        return m_Error;
+
+    if (nextXMLEle(m_Root, 1) == nullptr)
+        return "Empty park file.";
+
+    if (strcmp(tagXMLEle(m_Root), "parkdata") != 0)
+        return "Not a park data file";
+
+    XMLEle *deviceXml = findDevice(device);
+    if (deviceXml == nullptr)
+        return "No park data found for this device";
+
+    XMLEle *statusXml = findXMLEle(deviceXml, "parkstatus");
+    if (statusXml)
+    {
+        entry.hasStatus = true;
+        entry.parked    = !strcmp(pcdataXMLEle(statusXml), "true");
+    }
+
+    XMLEle *positionXml = findXMLEle(deviceXml, "parkposition");
+    for (int axis = 1; positionXml != nullptr; axis++)
+    {
+        char tag[32];
+        snprintf(tag, sizeof(tag), "axis%dposition", axis);
+        XMLEle *axisXml = findXMLEle(positionXml, tag);
+        if (axisXml == nullptr)
+            break;
+        entry.axes.push_back(pcdataXMLEle(axisXml));
+    }
+
+    return nullptr;
+}
+
+void ParkDataStore::write(const char *device, bool parked, const std::vector<double> &axes)
+{
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    refresh();
+
+    if (m_Root == nullptr)
+        m_Root = addXMLEle(nullptr, "parkdata");
+
+    XMLEle *deviceXml = findDevice(device);
+    if (deviceXml == nullptr)
+    {
+        deviceXml = addXMLEle(m_Root, "device");
+        addXMLAtt(deviceXml, "name", device);
+    }
+
+    XMLEle *statusXml = findXMLEle(deviceXml, "parkstatus");
+    if (statusXml == nullptr)
+        statusXml = addXMLEle(deviceXml, "parkstatus");
+    editXMLEle(statusXml, parked ? "true" : "false");
+
+    if (!axes.empty())
+    {
+        XMLEle *positionXml = findXMLEle(deviceXml, "parkposition");
+        if (positionXml == nullptr)
+            positionXml = addXMLEle(deviceXml, "parkposition");
+
+        for (size_t i = 0; i < axes.size(); i++)
+        {
+            char tag[32], pcdata[30];
+            snprintf(tag, sizeof(tag), "axis%zuposition", i + 1);
+            XMLEle *axisXml = findXMLEle(positionXml, tag);
+            if (axisXml == nullptr)
+                axisXml = addXMLEle(positionXml, tag);
+            snprintf(pcdata, sizeof(pcdata), "%lf", axes[i]);
+            editXMLEle(axisXml, pcdata);
+        }
+    }
+
+    queue();
+}
+
+bool ParkDataStore::purge(const char *device)
+{
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    refresh();
+
+    XMLEle *deviceXml = findDevice(device);
+    if (deviceXml == nullptr)
+        return false;
+
+    delXMLEle(deviceXml);
+    queue();
+    return true;
+}
+
+void ParkDataStore::flush()
+{
+    std::unique_lock<std::mutex> lock(m_Lock);
+    m_Wake.wait(lock, [this] { return !m_HasPending && !m_Writing; });
+}
+
+void ParkDataStore::queue()
+{
+    std::string xml(sprlXMLEle(m_Root, 0), '\0');
+    xml.resize(sprXMLEle(&xml[0], m_Root, 0));
+
+    // A write still queued is replaced, only the latest content matters
+    m_Pending.swap(xml);
+    m_HasPending = true;
+
+    if (!m_Writer.joinable())
+        m_Writer = std::thread(&ParkDataStore::run, this);
+    m_Wake.notify_all();
+}
+
+void ParkDataStore::run()
+{
+    std::unique_lock<std::mutex> lock(m_Lock);
+    for (;;)
+    {
+        m_Wake.wait(lock, [this] { return m_HasPending || m_Stopping; });
+        if (!m_HasPending)
+            return;
+
+        std::string xml;
+        xml.swap(m_Pending);
+        m_HasPending = false;
+        m_Writing    = true;
+
+        struct stat st;
+        lock.unlock();
+        bool written = save(xml, st);
+        lock.lock();
+
+        // So that the store does not parse its own write again, but still sees one made by another process since
+        if (written)
+        {
+            m_Stamp = modificationTime(st);
+            m_Size  = st.st_size;
+        }
+
+        m_Writing = false;
+        m_Wake.notify_all();
+    }
+}
+
+bool ParkDataStore::save(const std::string &xml, struct stat &st)
+{
+    // Renamed over the file once complete, readers see either the previous content or this one
+    std::string temporary = m_FileName + ".tmp" + std::to_string(getpid());
+
+    FILE *fp = fopen(temporary.c_str(), "w");
+    if (fp == nullptr)
+    {
+        IDLog("ParkDataStore: can not write file %s: %s\n", temporary.c_str(), strerror(errno));
+        return false;
+    }
+
+    bool ok = fwrite(xml.data(), 1, xml.size(), fp) == xml.size();
+    ok = fflush(fp) == 0 && ok;
+    ok = fsync(fileno(fp)) == 0 && ok;
+    // Of the file written, not of whatever is at the file name once renamed
+    ok = fstat(fileno(fp), &st) == 0 && ok;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok || rename(temporary.c_str(), m_FileName.c_str()) != 0)
+    {
+        IDLog("ParkDataStore: can not write file %s: %s\n", m_FileName.c_str(), strerror(errno));
+        unlink(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,108 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "lilxml.h"
+
+#include <condition_variable>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace INDI
+{
+
+/**
+ * @class ParkDataStore
+ * @brief The ParkDataStore class holds the park data file, ~/.indi/ParkData.xml, for all the devices of a process.
+ *
+ * The file is parsed once, and again only when another process changed it. Writes are done by a thread of the store,
+ * to a temporary file renamed over the park data file, so that a device saving its park status neither waits for the
+ * disk nor leaves a truncated file to readers. Writes that pile up are merged into the latest one.
+ *
+ * Telescope and Dome share the store of their park data file, it is safe to use from any thread.
+ */
+class ParkDataStore
+{
+    public:
+        /** @brief Park data of a device. */
+        struct Entry
+        {
+            bool hasStatus {false};
+            bool parked {false};
+            /** @brief Text of the axis1position, axis2position... elements, as many as found in order. */
+            std::vector<std::string> axes;
+        };
+
+    public:
+        /** @returns The store of the park data file fileName, created on first use. */
+        static ParkDataStore &instance(const std::string &fileName);
+
+        ~ParkDataStore();
+
+        /**
+         * @brief Gets the park data of device.
+         * @return nullptr on success, or why there is no park data for device.
+         */
+        const char *read(const char *device, Entry &entry);
+
+        /**
+         * @brief Sets the park data of device and queues the write of the file. The positions of the file are kept if
+         * axes is empty.
+         */
+        void write(const char *device, bool parked, const std::vector<double> &axes);
+
+        /** @brief Removes the park data of device and queues the write of the file. False if it had none. */
+        bool purge(const char *device);
+
+        /** @brief Waits for the queued writes. */
+        void flush();
+
+    private:
+        explicit ParkDataStore(const std::string &fileName);
+
+        // With m_Lock held
+        void refresh();
+        XMLEle *findDevice(const char *device);
+        void queue();
+
+        void run();
+        // Sets st to the status of the file written
+        bool save(const std::string &xml, struct stat &st);
+
+        std::string m_FileName;
+        XMLEle *m_Root {nullptr};
+        char m_Error[512] {};
+
+        // Of the file when it was last read or written by the store
+        struct timespec m_Stamp {};
+        off_t m_Size {-1};
+
+        std::mutex m_Lock;
+        std::condition_variable m_Wake;
+        std::thread m_Writer;
+        std::string m_Pending;
+        bool m_HasPending {false};
+        bool m_Writing {false};
+        bool m_Stopping {false};
+};
+
+}
@@ -0,0 +1,235 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indipreview.h"
+#include "indithreadpool.h"
+#include "dsp.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <jpeglib.h>
+
+namespace
+{
+
+// Frames with fewer pixels are binned on the calling thread
+constexpr size_t PARALLEL_PIXELS = 1u << 20;
+
+// Fraction of the pixels clipped at each end of the stretch, and the level of the median background
+constexpr double CLIP_FRACTION = 0.001;
+constexpr double BACKGROUND    = 0.25;
+
+// Average of a factor x factor block of pixels of type T, scaled to 16 bits
+template <typename T>
+void binRow(const T *plane, uint32_t width, uint32_t factor, uint32_t y, uint32_t outWidth, int shift, uint16_t *out)
+{
+    uint64_t const count = static_cast<uint64_t>(factor) * factor;
+    for (uint32_t x = 0; x < outWidth; x++)
+    {
+        uint64_t sum = 0;
+        for (uint32_t j = 0; j < factor; j++)
+        {
+            const T *row = plane + static_cast<size_t>(y * factor + j) * width + x * factor;
+            for (uint32_t i = 0; i < factor; i++)
+                sum += row[i];
+        }
+        uint64_t value = sum / count;
+        out[x] = static_cast<uint16_t>(shift >= 0 ? value << shift : value >> -shift);
+    }
+}
+
+void binPlane(const void *plane, uint32_t width, uint32_t height, int bpp, uint32_t factor, uint16_t *out)
+{
+    uint32_t const outWidth = width / factor, outHeight = height / factor;
+    auto row = [&](size_t y)
+    {
+        switch (bpp)
+        {
+            case 8:
+                binRow(static_cast<const uint8_t *>(plane), width, factor, y, outWidth, 8, out + y * outWidth);
+                break;
+            case 16:
+                binRow(static_cast<const uint16_t *>(plane), width, factor, y, outWidth, 0, out + y * outWidth);
+                break;
+            case 32:
+                binRow(static_cast<const uint32_t *>(plane), width, factor, y, outWidth, -16, out + y * outWidth);
+                break;
+        }
+    };
+
+    if (static_cast<size_t>(width) * height < PARALLEL_PIXELS)
+        for (size_t y = 0; y < outHeight; y++)
+            row(y);
+    else
+        INDI::ThreadPool::global().parallelFor(0, outHeight, row, 8);
+}
+
+// Midtones transfer function: maps 0 to 0, 1 to 1 and midtones to 0.5
+double midtones(double m, double x)
+{
+    if (x <= 0)
+        return 0;
+    if (x >= 1)
+        return 1;
+    return (m - 1) * x / ((2 * m - 1) * x - m);
+}
+
+// Maps 16 bit values to 8 bits, stretched from the histogram of the values
+std::vector<uint8_t> stretch(const std::vector<uint16_t> &values)
+{
+    // Clipping levels and median counted in one parallel histogram
+    double fractions[3] = { CLIP_FRACTION, 1 - CLIP_FRACTION, 0.5 };
+    double levels[3];
+    dsp_stats_percentiles_u16(const_cast<uint16_t *>(values.data()), static_cast<int>(values.size()), fractions, 3, levels);
+
+    double const low = levels[0];
+    double const high = std::max(levels[1], low + 1);
+    double const median = (levels[2] - low) / (high - low);
+
+    // Midtones balance taking the median to the background level
+    double balance = 0.5;
+    if (median > 0 && median < 1)
+        balance = median * (1 - BACKGROUND) / (median + BACKGROUND - 2 * BACKGROUND * median);
+
+    std::vector<uint8_t> lut(65536);
+    for (size_t i = 0; i < lut.size(); i++)
+        lut[i] = static_cast<uint8_t>(std::lround(255 * midtones(balance, (i - low) / (high - low))));
+    return lut;
+}
+
+// libjpeg destination growing a vector
+struct VectorDestination
+{
+    jpeg_destination_mgr manager;
+    std::vector<uint8_t> *buffer;
+};
+
+void initDestination(j_compress_ptr cinfo)
+{
+    auto destination = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    destination->manager.next_output_byte = destination->buffer->data();
+    destination->manager.free_in_buffer = destination->buffer->size();
+}
+
+boolean emptyOutputBuffer(j_compress_ptr cinfo)
+{
+    auto destination = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    size_t const used = destination->buffer->size();
+    destination->buffer->resize(used * 2);
+    destination->manager.next_output_byte = destination->buffer->data() + used;
+    destination->manager.free_in_buffer = destination->buffer->size() - used;
+    return TRUE;
+}
+
+void termDestination(j_compress_ptr cinfo)
+{
+    auto destination = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    destination->buffer->resize(destination->buffer->size() - destination->manager.free_in_buffer);
+}
+
+}
+
+namespace INDI
+{
+
+bool encodePreviewJPEG(const void *pixels, uint32_t width, uint32_t height, int bpp, int channels,
+                       uint32_t maxWidth, int quality, std::vector<uint8_t> &jpeg, int bayerRed)
+{
+    if ((bpp != 8 && bpp != 16 && bpp != 32) || (channels != 1 && channels != 3) || width == 0 || height == 0)
+        return false;
+
+    // Mosaics are binned from their superpixels, which are about as large as the preview needs
+    std::vector<uint8_t> color;
+    if (bayerRed >= 0 && channels == 1 && bpp <= 16 && width >= 2 && height >= 2)
+    {
+        color.resize(static_cast<size_t>(width / 2) * (height / 2) * 3 * (bpp / 8));
+        if (bpp == 8)
+            dsp_debayer_u8(static_cast<const uint8_t *>(pixels), color.data(), width, height, bayerRed,
+                           DSP_DEBAYER_SUPERPIXEL, 1);
+        else
+            dsp_debayer_u16(static_cast<const uint16_t *>(pixels), reinterpret_cast<uint16_t *>(color.data()), width,
+                            height, bayerRed, DSP_DEBAYER_SUPERPIXEL, 1);
+        pixels = color.data();
+        width /= 2;
+        height /= 2;
+        channels = 3;
+    }
+
+    uint32_t factor = std::max(1u, (width + std::max(1u, maxWidth) - 1) / std::max(1u, maxWidth));
+    factor = std::min(factor, std::min(width, height));
+    uint32_t const outWidth = width / factor, outHeight = height / factor;
+    size_t const outPixels = static_cast<size_t>(outWidth) * outHeight;
+    size_t const planeBytes = static_cast<size_t>(width) * height * (bpp / 8);
+
+    // Binned planes, one after the other, stretched together so that colors stay balanced
+    std::vector<uint16_t> binned(outPixels * channels);
+    for (int c = 0; c < channels; c++)
+        binPlane(static_cast<const uint8_t *>(pixels) + c * planeBytes, width, height, bpp, factor, binned.data() + c * outPixels);
+
+    std::vector<uint8_t> const lut = stretch(binned);
+
+    // Rows of interleaved samples, as libjpeg reads them
+    std::vector<uint8_t> image(outPixels * channels);
+    for (size_t i = 0; i < outPixels; i++)
+        for (int c = 0; c < channels; c++)
+            image[i * channels + c] = lut[binned[c * outPixels + i]];
+
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+
+    jpeg.resize(std::max<size_t>(image.size() / 4, 4096));
+    VectorDestination destination;
+    destination.manager.init_destination = initDestination;
+    destination.manager.empty_output_buffer = emptyOutputBuffer;
+    destination.manager.term_destination = termDestination;
+    destination.buffer = &jpeg;
+    cinfo.dest = &destination.manager;
+
+    cinfo.image_width = outWidth;
+    cinfo.image_height = outHeight;
+    cinfo.input_components = channels;
+    cinfo.in_color_space = channels == 3 ? JCS_RGB : JCS_GRAYSCALE;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, std::min(std::max(quality, 1), 100), TRUE);
+
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < outHeight)
+    {
+        JSAMPROW row = image.data() + static_cast<size_t>(cinfo.next_scanline) * outWidth * channels;
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
+
+int bayerRedLocation(const char *pattern, int offsetX, int offsetY)
+{
+    if (pattern == nullptr || strlen(pattern) != 4 || strspn(pattern, "RGB") != 4)
+        return -1;
+    const char *red = strchr(pattern, 'R');
+    if (red == nullptr || strchr(red + 1, 'R') != nullptr)
+        return -1;
+    int const location = static_cast<int>(red - pattern);
+    return ((location & 1) ^ (offsetX & 1)) | ((((location >> 1) & 1) ^ (offsetY & 1)) << 1);
+}
+
+}
@@ -0,0 +1,45 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @brief Encodes a small, stretched 8 bit JPEG preview of a frame of unsigned pixels of bpp bits, 8, 16 or 32.
+ * The frame is binned by the smallest integer factor that brings its width down to maxWidth, then stretched
+ * between its darkest and brightest pixels, 0.1% clipped at each end, with its median set to a quarter of the range.
+ * @param channels 1 for mono frames, 3 for RGB frames stored plane after plane.
+ * @param jpeg Receives the JPEG file.
+ * @param bayerRed Location of the red pixel in the 2x2 quads of a mono frame of 8 or 16 bits to preview in color,
+ * from one RGB pixel of each quad, as returned by bayerRedLocation(). -1 for a gray preview.
+ * @return False if the depth or the channels are not supported or the frame is empty.
+ */
+bool encodePreviewJPEG(const void *pixels, uint32_t width, uint32_t height, int bpp, int channels,
+                       uint32_t maxWidth, int quality, std::vector<uint8_t> &jpeg, int bayerRed = -1);
+
+/**
+ * @brief Location of the red pixel in the 2x2 quads of a Bayer pattern such as "RGGB", its column in bit 0 and its
+ * row in bit 1, after the pattern is shifted by the offsets.
+ * @return -1 if the pattern is not made of red, green and blue.
+ */
+int bayerRedLocation(const char *pattern, int offsetX, int offsetY);
+
+}
@@ -31,6 +31,8 @@
 #include <libnova/precession.h>
 
 #include <regex>
+#include <algorithm>
+#include <cmath>
 
 #include <dirent.h>
 #include <cerrno>
@@ -39,6 +41,8 @@
 #include <zlib.h>
 #include <sys/stat.h>
 
+#define SPECTROMETER_TAB "Spectrometer"
+
 namespace INDI
 {
 
@@ -62,6 +66,20 @@ bool Receiver::initProperties()
     IUFillNumberVector(&ReceiverSettingsNP, ReceiverSettingsN, 6, getDeviceName(), "RECEIVER_SETTINGS", "Receiver Settings",
                        MAIN_CONTROL_TAB, IP_RW, 60, IPS_IDLE);
 
+    // Spectrometer
+    IUFillSwitch(&SpectrometerS[0], "SPECTROMETER_ON", "On", ISS_OFF);
+    IUFillSwitch(&SpectrometerS[1], "SPECTROMETER_OFF", "Off", ISS_ON);
+    IUFillSwitchVector(&SpectrometerSP, SpectrometerS, 2, getDeviceName(), "RECEIVER_SPECTROMETER_ENABLE", "Spectrometer",
+                       SPECTROMETER_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+    IUFillNumber(&SpectrometerN[SPECTROMETER_SIZE], "SPECTROMETER_SIZE", "Transform size", "%.f", 16, 1048576, 2, 1024);
+    IUFillNumber(&SpectrometerN[SPECTROMETER_OVERLAP], "SPECTROMETER_OVERLAP", "Overlap (%)", "%.f", 0, 90, 5, 50);
+    IUFillNumber(&SpectrometerN[SPECTROMETER_CADENCE], "SPECTROMETER_CADENCE", "Cadence (s)", "%.2f", 0.01, 3600, 0.01, 1);
+    IUFillNumberVector(&SpectrometerNP, SpectrometerN, 3, getDeviceName(), "RECEIVER_SPECTROMETER", "Spectrometer",
+                       SPECTROMETER_TAB, IP_RW, 60, IPS_IDLE);
+    IUFillBLOB(&SpectrumB, "SPECTRUM", "Spectrum", "");
+    IUFillBLOBVector(&SpectrumBP, &SpectrumB, 1, getDeviceName(), "RECEIVER_SPECTRUM", "Spectrum", SPECTROMETER_TAB,
+                     IP_RO, 60, IPS_IDLE);
+
     setDriverInterface(SPECTROGRAPH_INTERFACE);
 
     return SensorInterface::initProperties();
@@ -77,6 +95,9 @@ bool Receiver::updateProperties()
     if (isConnected())
     {
         defineProperty(&ReceiverSettingsNP);
+        defineProperty(&SpectrometerSP);
+        defineProperty(&SpectrometerNP);
+        defineProperty(&SpectrumBP);
 
         if (HasCooler())
             defineProperty(&TemperatureNP);
@@ -84,6 +105,9 @@ bool Receiver::updateProperties()
     else
     {
         deleteProperty(ReceiverSettingsNP.name);
+        deleteProperty(SpectrometerSP.name);
+        deleteProperty(SpectrometerNP.name);
+        deleteProperty(SpectrumBP.name);
 
         if (HasCooler())
             deleteProperty(TemperatureNP.name);
@@ -107,11 +131,29 @@ bool Receiver::ISNewNumber(const char *dev, const char *name, double values[], c
     {
         IDSetNumber(&ReceiverSettingsNP, nullptr);
     }
+    if (dev && !strcmp(dev, getDeviceName()) && !strcmp(name, SpectrometerNP.name))
+    {
+        std::lock_guard<std::mutex> lock(SpectrometerLock);
+        IUUpdateNumber(&SpectrometerNP, values, names, n);
+        resetSpectrometer();
+        SpectrometerNP.s = IPS_OK;
+        IDSetNumber(&SpectrometerNP, nullptr);
+        return true;
+    }
     return processNumber(dev, name, values, names, n);
 }
 
 bool Receiver::ISNewSwitch(const char *dev, const char *name, ISState *values, char *names[], int n)
 {
+    if (dev && !strcmp(dev, getDeviceName()) && !strcmp(name, SpectrometerSP.name))
+    {
+        std::lock_guard<std::mutex> lock(SpectrometerLock);
+        IUUpdateSwitch(&SpectrometerSP, values, names, n);
+        resetSpectrometer();
+        SpectrometerSP.s = IPS_OK;
+        IDSetSwitch(&SpectrometerSP, nullptr);
+        return true;
+    }
     return processSwitch(dev, name, values, names, n);
 }
 
@@ -227,4 +269,163 @@ void Receiver::addFITSKeywords(fitsfile *fptr, uint8_t* buf, int len)
 
     SensorInterface::addFITSKeywords(fptr, buf, len);
 }
+
+bool Receiver::saveConfigItems(FILE *fp)
+{
+    SensorInterface::saveConfigItems(fp);
+
+    IUSaveConfigSwitch(fp, &SpectrometerSP);
+    IUSaveConfigNumber(fp, &SpectrometerNP);
+
+    return true;
+}
+
+void Receiver::resetSpectrometer()
+{
+    // A periodic Hann window, the overlap of 50% then weighs all the samples alike
+    int size = static_cast<int>(SpectrometerN[SPECTROMETER_SIZE].value) & ~1;
+    SpectrometerWindow.resize(size);
+    for (int j = 0; j < size; j++)
+        SpectrometerWindow[j] = 0.5 - 0.5 * cos(2.0 * M_PI * j / size);
+    SpectrometerPower.assign(size / 2 + 1, 0.0);
+    SpectrometerSamples.clear();
+    SpectrometerTransforms = 0;
+    SpectrometerStart = std::chrono::steady_clock::now();
+}
+
+void Receiver::addSpectrometerSamples(const uint8_t *buf, int len)
+{
+    if (SpectrometerS[0].s != ISS_ON)
+        return;
+
+    std::lock_guard<std::mutex> lock(SpectrometerLock);
+    if (SpectrometerWindow.empty())
+        resetSpectrometer();
+
+    int bytes = abs(getBPS()) / 8;
+    if (bytes == 0)
+        return;
+    size_t first = SpectrometerSamples.size();
+    size_t count = len / bytes;
+    SpectrometerSamples.resize(first + count);
+    double *samples = SpectrometerSamples.data() + first;
+    // The samples have the types of the FITS integrations, read one by one since buf may be unaligned
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint8_t *sample = buf + i * bytes;
+        switch (getBPS())
+        {
+            case 8:
+                samples[i] = *sample;
+                break;
+            case 16:
+            {
+                uint16_t value;
+                memcpy(&value, sample, sizeof(value));
+                samples[i] = value;
+                break;
+            }
+            case 32:
+            {
+                int32_t value;
+                memcpy(&value, sample, sizeof(value));
+                samples[i] = value;
+                break;
+            }
+            case 64:
+            {
+                int64_t value;
+                memcpy(&value, sample, sizeof(value));
+                samples[i] = static_cast<double>(value);
+                break;
+            }
+            case -32:
+            {
+                float value;
+                memcpy(&value, sample, sizeof(value));
+                samples[i] = value;
+                break;
+            }
+            case -64:
+                memcpy(&samples[i], sample, sizeof(double));
+                break;
+            default:
+                samples[i] = 0;
+                break;
+        }
+    }
+
+    int size = SpectrometerWindow.size();
+    int step = std::max(1, static_cast<int>(lround(size * (1.0 - SpectrometerN[SPECTROMETER_OVERLAP].value / 100.0))));
+    int transforms = dsp_fourier_power_spectrum(SpectrometerSamples.data(), SpectrometerSamples.size(), size, step,
+                     SpectrometerWindow.data(), SpectrometerPower.data());
+    SpectrometerTransforms += transforms;
+    // Keep the samples of the transforms still to come
+    SpectrometerSamples.erase(SpectrometerSamples.begin(), SpectrometerSamples.begin() + static_cast<size_t>(transforms) * step);
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - SpectrometerStart;
+    if (SpectrometerTransforms > 0 && elapsed.count() >= SpectrometerN[SPECTROMETER_CADENCE].value)
+        publishSpectrum();
+}
+
+void Receiver::publishSpectrum()
+{
+    // Average of the power of the transforms, independent of the window
+    double windowPower = 0;
+    for (double weight : SpectrometerWindow)
+        windowPower += weight * weight;
+    std::vector<double> spectrum(SpectrometerPower.size());
+    for (size_t k = 0; k < spectrum.size(); k++)
+        spectrum[k] = SpectrometerPower[k] / (SpectrometerTransforms * windowPower);
+
+    fitsfile *fptr = nullptr;
+    size_t memsize = 5760;
+    void *memptr   = malloc(memsize);
+    int status     = 0;
+    long naxes[2]  = { static_cast<long>(spectrum.size()), 1 };
+    char error_status[MAXRBUF];
+    char fitsString[MAXINDILABEL];
+
+    fits_create_memfile(&fptr, &memptr, &memsize, 2880, realloc, &status);
+    if (status == 0)
+        fits_create_img(fptr, DOUBLE_IMG, 2, naxes, &status);
+    if (status == 0)
+    {
+        double firstBin = 0;
+        double binWidth = getSampleRate() / SpectrometerWindow.size();
+        int averaged = SpectrometerTransforms;
+        fits_update_key(fptr, TDOUBLE, "CRVAL1", &firstBin, const_cast<char *>("Frequency offset of the first bin (Hz)"), &status);
+        fits_update_key(fptr, TDOUBLE, "CDELT1", &binWidth, const_cast<char *>("Width of the bins (Hz)"), &status);
+        fits_update_key(fptr, TINT, "NAVERAGE", &averaged, const_cast<char *>("Averaged transforms"), &status);
+        sprintf(fitsString, "%lf", getFrequency());
+        fits_update_key(fptr, TSTRING, "FREQ", fitsString, const_cast<char *>("Center Frequency"), &status);
+        sprintf(fitsString, "%lf", getSampleRate());
+        fits_update_key(fptr, TSTRING, "SRATE", fitsString, const_cast<char *>("Sampling Rate"), &status);
+        sprintf(fitsString, "%lf", getGain());
+        fits_update_key(fptr, TSTRING, "GAIN", fitsString, const_cast<char *>("Gain"), &status);
+        fits_write_img(fptr, TDOUBLE, 1, spectrum.size(), spectrum.data(), &status);
+    }
+    if (status == 0)
+        fits_close_file(fptr, &status);
+
+    if (status)
+    {
+        fits_get_errstatus(status, error_status);
+        DEBUGF(Logger::DBG_ERROR, "FITS Error: %s", error_status);
+    }
+    else
+    {
+        SpectrumB.blob    = memptr;
+        SpectrumB.bloblen = SpectrumB.size = memsize;
+        strcpy(SpectrumB.format, ".fits");
+        SpectrumBP.s = IPS_OK;
+        IDSetBLOB(&SpectrumBP, nullptr);
+        SpectrumB.blob = nullptr;
+    }
+    free(memptr);
+
+    std::fill(SpectrometerPower.begin(), SpectrometerPower.end(), 0.0);
+    SpectrometerTransforms = 0;
+    SpectrometerStart      = std::chrono::steady_clock::now();
+}
 }
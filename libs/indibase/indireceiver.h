@@ -34,6 +34,7 @@
 #include <stdint.h>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 //JM 2019-01-17: Disabled until further notice
 //#define WITH_EXPOSURE_LOOPING
@@ -82,6 +83,18 @@ class Receiver : public virtual SensorInterface
 
         virtual bool StartIntegration(double duration) override;
         virtual void addFITSKeywords(fitsfile *fptr, uint8_t* buf, int len) override;
+        virtual bool saveConfigItems(FILE *fp) override;
+
+        /**
+         * @brief addSpectrometerSamples Feed raw samples to the spectrometer, when it is enabled.
+         * The samples are cut into overlapping windowed transforms, whose power spectra are averaged
+         * and published on the RECEIVER_SPECTRUM BLOB once per cadence. Samples left over at the end
+         * of buf start the first transform of the next call, so consecutive calls must carry
+         * consecutive samples.
+         * @param buf The samples, in the format of the bits per sample of the receiver.
+         * @param len The size of buf in bytes.
+         */
+        void addSpectrometerSamples(const uint8_t *buf, int len);
 
         /**
          * @brief setSampleRate Set depth of Receiver device.
@@ -196,6 +209,19 @@ class Receiver : public virtual SensorInterface
         INumberVectorProperty ReceiverSettingsNP;
         INumber ReceiverSettingsN[7];
 
+        typedef enum
+        {
+            SPECTROMETER_SIZE = 0,
+            SPECTROMETER_OVERLAP,
+            SPECTROMETER_CADENCE,
+        } SPECTROMETER_INDEX;
+        INumberVectorProperty SpectrometerNP;
+        INumber SpectrometerN[3];
+        ISwitchVectorProperty SpectrometerSP;
+        ISwitch SpectrometerS[2];
+        IBLOBVectorProperty SpectrumBP;
+        IBLOB SpectrumB;
+
     private:
         int BitsPerSample;
         double Frequency;
@@ -203,5 +229,15 @@ class Receiver : public virtual SensorInterface
         double Bandwidth;
         double Gain;
 
+        void resetSpectrometer();
+        void publishSpectrum();
+
+        // Spectrometer state, fed from the capture thread of the driver
+        std::mutex SpectrometerLock;
+        std::vector<double> SpectrometerWindow;
+        std::vector<double> SpectrometerPower;
+        std::vector<double> SpectrometerSamples;
+        int SpectrometerTransforms { 0 };
+        std::chrono::steady_clock::time_point SpectrometerStart;
 };
 }
@@ -27,6 +27,9 @@
 #include "stream/streammanager.h"
 #include "locale_compat.h"
 #include "indiutility.h"
+#include "indiminmax.h"
+#include "inditrace.h"
+#include "sdfits.h"
 
 #include <fitsio.h>
 
@@ -35,6 +38,7 @@
 #include <libnova/precession.h>
 
 #include <regex>
+#include <cmath>
 
 #include <dirent.h>
 #include <cerrno>
@@ -78,6 +82,8 @@ SensorInterface::SensorInterface()
 
 SensorInterface::~SensorInterface()
 {
+    stopContinuous();
+    free(ContinuousBuffer);
     free(Buffer);
     BufferSize = 0;
     Buffer = nullptr;
@@ -94,6 +100,9 @@ bool SensorInterface::updateProperties()
         if (CanAbort())
             defineProperty(&AbortIntegrationSP);
 
+        if (HasContinuous())
+            defineProperty(&ContinuousSP);
+
         defineProperty(&FITSHeaderTP);
 
         if (HasCooler())
@@ -114,6 +123,11 @@ bool SensorInterface::updateProperties()
         deleteProperty(FramedIntegrationNP.name);
         if (CanAbort())
             deleteProperty(AbortIntegrationSP.name);
+        if (HasContinuous())
+        {
+            deleteProperty(ContinuousSP.name);
+            stopContinuous();
+        }
         deleteProperty(FitsBP.name);
 
         deleteProperty(FITSHeaderTP.name);
@@ -336,11 +350,48 @@ bool SensorInterface::processSwitch(const char *dev, const char *name, ISState *
             return true;
         }
 
+        if (!strcmp(name, ContinuousSP.name))
+        {
+            IUUpdateSwitch(&ContinuousSP, states, names, n);
+            ContinuousSP.s = IPS_OK;
+
+            if (ContinuousS[0].s == ISS_ON)
+            {
+                DEBUG(Logger::DBG_SESSION, "Continuous integration enabled.");
+                // Integrations requested from now on restart themselves, start one if the time is known
+                if (!isCapturing() && IntegrationTime > 0)
+                {
+                    FramedIntegrationN[0].value = IntegrationTime;
+                    if (StartIntegration(IntegrationTime))
+                        FramedIntegrationNP.s = IPS_BUSY;
+                    else
+                        FramedIntegrationNP.s = ContinuousSP.s = IPS_ALERT;
+                    IDSetNumber(&FramedIntegrationNP, nullptr);
+                }
+            }
+            else
+            {
+                DEBUG(Logger::DBG_SESSION, "Continuous integration disabled.");
+                stopContinuous();
+            }
+            IDSetSwitch(&ContinuousSP, nullptr);
+            return true;
+        }
+
         // Primary Device Abort Expsoure
         if (strcmp(name, AbortIntegrationSP.name) == 0)
         {
             IUResetSwitch(&AbortIntegrationSP);
 
+            if (isContinuous())
+            {
+                IUResetSwitch(&ContinuousSP);
+                ContinuousS[1].s = ISS_ON;
+                ContinuousSP.s   = IPS_IDLE;
+                IDSetSwitch(&ContinuousSP, nullptr);
+                stopContinuous();
+            }
+
             if (AbortIntegration())
             {
                 AbortIntegrationSP.s       = IPS_OK;
@@ -404,6 +455,12 @@ bool SensorInterface::initProperties()
                            "Integration Abort", MAIN_CONTROL_TAB, IP_RW, ISR_ATMOST1, 60, IPS_IDLE);
     }
 
+    // Sensor Continuous Integration
+    IUFillSwitch(&ContinuousS[0], "CONTINUOUS_ON", "On", ISS_OFF);
+    IUFillSwitch(&ContinuousS[1], "CONTINUOUS_OFF", "Off", ISS_ON);
+    IUFillSwitchVector(&ContinuousSP, ContinuousS, 2, getDeviceName(), "SENSOR_CONTINUOUS", "Continuous",
+                       MAIN_CONTROL_TAB, IP_RW, ISR_1OFMANY, 60, IPS_IDLE);
+
 
     /**********************************************/
     /************** Upload Settings ***************/
@@ -755,7 +812,7 @@ void SensorInterface::fits_update_key_s(fitsfile *fptr, int type, std::string na
 
 void* SensorInterface::sendFITS(uint8_t *buf, int len)
 {
-    bool sendIntegration = (UploadS[0].s == ISS_ON || UploadS[2].s == ISS_ON);
+    bool sendIntegration = SendFrames && (UploadS[0].s == ISS_ON || UploadS[2].s == ISS_ON);
     bool saveIntegration = (UploadS[1].s == ISS_ON || UploadS[2].s == ISS_ON);
     fitsfile *fptr = nullptr;
     void *memptr;
@@ -876,6 +933,9 @@ bool SensorInterface::IntegrationComplete()
     // Reset POLLMS to default value
     setCurrentPollingPeriod(getPollingPeriod());
 
+    if (isContinuous())
+        return continueIntegration();
+
     if(HasDSP())
     {
         uint8_t* buf = (uint8_t*)malloc(getBufferSize());
@@ -891,7 +951,7 @@ bool SensorInterface::IntegrationComplete()
 
 bool SensorInterface::IntegrationCompletePrivate()
 {
-    bool sendIntegration = (UploadS[0].s == ISS_ON || UploadS[2].s == ISS_ON);
+    bool sendIntegration = SendFrames && (UploadS[0].s == ISS_ON || UploadS[2].s == ISS_ON);
     bool saveIntegration = (UploadS[1].s == ISS_ON || UploadS[2].s == ISS_ON);
     bool autoLoop   = false;
 
@@ -938,52 +998,245 @@ bool SensorInterface::IntegrationCompletePrivate()
     return true;
 }
 
-bool SensorInterface::uploadFile(const void *fitsData, size_t totalBytes, bool sendIntegration,
-                                 bool saveIntegration)
+bool SensorInterface::continueIntegration()
 {
+    {
+        std::lock_guard<std::mutex> lock(ContinuousLock);
 
-    DEBUGF(Logger::DBG_DEBUG, "Uploading file. Ext: %s, Size: %d, sendIntegration? %s, saveIntegration? %s",
-           getIntegrationFileExtension(), totalBytes, sendIntegration ? "Yes" : "No", saveIntegration ? "Yes" : "No");
+        // The previous integration must be recorded before its buffer is reused
+        if (ContinuousRecorder.joinable())
+            ContinuousRecorder.join();
+
+        if (ContinuousBufferSize != getBufferSize())
+        {
+            ContinuousBuffer     = static_cast<uint8_t *>(realloc(ContinuousBuffer, getBufferSize()));
+            ContinuousBufferSize = getBufferSize();
+        }
+        memcpy(ContinuousBuffer, getBuffer(), ContinuousBufferSize);
+        ContinuousBPS             = getBPS();
+        ContinuousStartTime       = startIntegrationTime;
+        ContinuousIntegrationTime = getIntegrationTime();
+
+        ContinuousRecorder = std::thread(&SensorInterface::ContinuousCompletePrivate, this);
+    }
+
+    // No gap: the next integration fills the buffer while the copy is recorded
+    FramedIntegrationN[0].value = IntegrationTime;
+    if (StartIntegration(IntegrationTime))
+        FramedIntegrationNP.s = IPS_BUSY;
+    else
+    {
+        DEBUG(Logger::DBG_ERROR, "Continuous: Sensor Integration Error!");
+        FramedIntegrationNP.s = IPS_ALERT;
+    }
+    IDSetNumber(&FramedIntegrationNP, nullptr);
+
+    return true;
+}
+
+bool SensorInterface::ContinuousCompletePrivate()
+{
+    bool sendIntegration = SendFrames && (UploadS[0].s == ISS_ON || UploadS[2].s == ISS_ON);
+    bool saveIntegration = (UploadS[1].s == ISS_ON || UploadS[2].s == ISS_ON);
+
+    if (HasDSP())
+    {
+        int dims[1] = { ContinuousBufferSize * 8 / abs(ContinuousBPS) };
+        DSP->processBLOB(ContinuousBuffer, 1, dims, ContinuousBPS);
+    }
 
-    FitsB.blob    = const_cast<void *>(fitsData);
-    FitsB.bloblen = totalBytes;
-    snprintf(FitsB.format, MAXINDIBLOBFMT, ".%s", getIntegrationFileExtension());
     if (saveIntegration)
+        appendContinuousRow();
+
+    // The raw samples, encoding a FITS file for each integration is what the continuous mode avoids
+    if (sendIntegration)
     {
+        FitsB.blob    = ContinuousBuffer;
+        FitsB.bloblen = FitsB.size = ContinuousBufferSize;
+        strncpy(FitsB.format, ".raw", MAXINDIBLOBFMT);
+        FitsBP.s = IPS_OK;
+        IDSetBLOB(&FitsBP, nullptr);
+    }
 
-        FILE *fp = nullptr;
-        char integrationFileName[MAXRBUF];
+    return true;
+}
 
-        std::string prefix = UploadSettingsT[UPLOAD_PREFIX].text;
-        int maxIndex       = getFileIndex(UploadSettingsT[UPLOAD_DIR].text, UploadSettingsT[UPLOAD_PREFIX].text,
-                                          FitsB.format);
+bool SensorInterface::appendContinuousRow()
+{
+    int status = 0;
+    int type   = 0;
+    char code  = 0;
+    char error_status[MAXRBUF];
+    int samples = ContinuousBufferSize * 8 / abs(ContinuousBPS);
 
-        if (maxIndex < 0)
+    switch (ContinuousBPS)
+    {
+        case 8:
+            type = TBYTE;
+            code = 'B';
+            break;
+        case 16:
+            type = TUSHORT;
+            code = 'U';
+            break;
+        case 32:
+            type = TLONG;
+            code = 'J';
+            break;
+        case 64:
+            type = TLONGLONG;
+            code = 'K';
+            break;
+        case -32:
+            type = TFLOAT;
+            code = 'E';
+            break;
+        case -64:
+            type = TDOUBLE;
+            code = 'D';
+            break;
+        default:
+            DEBUGF(Logger::DBG_ERROR, "Unsupported bits per sample value %d", ContinuousBPS);
+            return false;
+    }
+
+    if (ContinuousFile == nullptr)
+    {
+        std::string fileName = getUploadFileName(".fits");
+        if (fileName.empty())
+            return false;
+
+        fits_create_file(&ContinuousFile, fileName.c_str(), &status);
+        if (status)
         {
-            DEBUGF(Logger::DBG_ERROR, "Error iterating directory %s. %s", UploadSettingsT[0].text,
-                   strerror(errno));
+            fits_get_errstatus(status, error_status);
+            DEBUGF(Logger::DBG_ERROR, "Unable to create recording %s. FITS Error: %s", fileName.c_str(), error_status);
+            ContinuousFile = nullptr;
             return false;
         }
 
-        if (maxIndex > 0)
+        IUSaveText(&FileNameT[0], fileName.c_str());
+        DEBUGF(Logger::DBG_SESSION, "Recording integrations to %s", fileName.c_str());
+        FileNameTP.s = IPS_OK;
+        IDSetText(&FileNameTP, nullptr);
+    }
+
+    // A new SDFITS table whenever the integrations change shape, a row for each of them
+    if (samples != ContinuousRowSamples || ContinuousBPS != ContinuousRowBPS)
+    {
+        char dataFormat[16];
+        snprintf(dataFormat, sizeof(dataFormat), "%d%c", samples, code);
+        char *ttype[4] = { const_cast<char *>("DATE-OBS"), const_cast<char *>("TIME"), const_cast<char *>("EXPOSURE"),
+                           const_cast<char *>("DATA")
+                         };
+        char *tform[4] = { const_cast<char *>("24A"), const_cast<char *>("1D"), const_cast<char *>("1D"), dataFormat };
+        char *tunit[4] = { const_cast<char *>(""), const_cast<char *>("s"), const_cast<char *>("s"), const_cast<char *>("") };
+
+        fits_create_tbl(ContinuousFile, BINARY_TBL, 0, 4, ttype, tform, tunit, FITS_TABLE_SDFITS, &status);
+        if (status == 0)
         {
-            char ts[32];
-            struct tm *tp;
-            time_t t;
-            time(&t);
-            tp = localtime(&t);
-            strftime(ts, sizeof(ts), "%Y-%m-%dT%H-%M-%S", tp);
-            std::string filets(ts);
-            prefix = std::regex_replace(prefix, std::regex("ISO8601"), filets);
-
-            char indexString[8];
-            snprintf(indexString, 8, "%03d", maxIndex);
-            std::string prefixIndex = indexString;
-            //prefix.replace(prefix.find("XXX"), std::string::npos, prefixIndex);
-            prefix = std::regex_replace(prefix, std::regex("XXX"), prefixIndex);
+            addFITSKeywords(ContinuousFile, ContinuousBuffer, samples);
+            ContinuousRowSamples = samples;
+            ContinuousRowBPS     = ContinuousBPS;
         }
+    }
 
-        snprintf(integrationFileName, MAXRBUF, "%s/%s%s", UploadSettingsT[0].text, prefix.c_str(), FitsB.format);
+    char dateObs[32];
+    char *dateObsPtr = dateObs;
+    time_t t = static_cast<time_t>(ContinuousStartTime);
+    strftime(dateObs, sizeof(dateObs), "%Y-%m-%dT%H:%M:%S", gmtime(&t));
+    double timeOfDay = fmod(ContinuousStartTime, 86400.0);
+    long row = 0;
+
+    fits_get_num_rows(ContinuousFile, &row, &status);
+    row++;
+    fits_write_col(ContinuousFile, TSTRING, 1, row, 1, 1, &dateObsPtr, &status);
+    fits_write_col(ContinuousFile, TDOUBLE, 2, row, 1, 1, &timeOfDay, &status);
+    fits_write_col(ContinuousFile, TDOUBLE, 3, row, 1, 1, &ContinuousIntegrationTime, &status);
+    fits_write_col(ContinuousFile, type, 4, row, 1, samples, ContinuousBuffer, &status);
+    // Readers of the recording see the row now, the header is rewritten when the file is closed
+    fits_flush_buffer(ContinuousFile, 0, &status);
+
+    if (status)
+    {
+        fits_get_errstatus(status, error_status);
+        DEBUGF(Logger::DBG_ERROR, "FITS Error: %s", error_status);
+        return false;
+    }
+    return true;
+}
+
+void SensorInterface::stopContinuous()
+{
+    std::lock_guard<std::mutex> lock(ContinuousLock);
+
+    if (ContinuousRecorder.joinable())
+        ContinuousRecorder.join();
+
+    if (ContinuousFile != nullptr)
+    {
+        int status = 0;
+        fits_close_file(ContinuousFile, &status);
+        ContinuousFile       = nullptr;
+        ContinuousRowSamples = 0;
+        ContinuousRowBPS     = 0;
+    }
+}
+
+std::string SensorInterface::getUploadFileName(const char *format)
+{
+    std::string prefix = UploadSettingsT[UPLOAD_PREFIX].text;
+    int maxIndex       = getFileIndex(UploadSettingsT[UPLOAD_DIR].text, UploadSettingsT[UPLOAD_PREFIX].text, format);
+
+    if (maxIndex < 0)
+    {
+        DEBUGF(Logger::DBG_ERROR, "Error iterating directory %s. %s", UploadSettingsT[0].text,
+               strerror(errno));
+        return "";
+    }
+
+    if (maxIndex > 0)
+    {
+        char ts[32];
+        struct tm *tp;
+        time_t t;
+        time(&t);
+        tp = localtime(&t);
+        strftime(ts, sizeof(ts), "%Y-%m-%dT%H-%M-%S", tp);
+        std::string filets(ts);
+        prefix = std::regex_replace(prefix, std::regex("ISO8601"), filets);
+
+        char indexString[8];
+        snprintf(indexString, 8, "%03d", maxIndex);
+        std::string prefixIndex = indexString;
+        //prefix.replace(prefix.find("XXX"), std::string::npos, prefixIndex);
+        prefix = std::regex_replace(prefix, std::regex("XXX"), prefixIndex);
+    }
+
+    char fileName[MAXRBUF];
+    snprintf(fileName, MAXRBUF, "%s/%s%s", UploadSettingsT[0].text, prefix.c_str(), format);
+    return fileName;
+}
+
+bool SensorInterface::uploadFile(const void *fitsData, size_t totalBytes, bool sendIntegration,
+                                 bool saveIntegration)
+{
+    INDI_TRACE_SCOPE("uploadFile");
+
+    DEBUGF(Logger::DBG_DEBUG, "Uploading file. Ext: %s, Size: %d, sendIntegration? %s, saveIntegration? %s",
+           getIntegrationFileExtension(), totalBytes, sendIntegration ? "Yes" : "No", saveIntegration ? "Yes" : "No");
+
+    FitsB.blob    = const_cast<void *>(fitsData);
+    FitsB.bloblen = totalBytes;
+    snprintf(FitsB.format, MAXINDIBLOBFMT, ".%s", getIntegrationFileExtension());
+    if (saveIntegration)
+    {
+
+        FILE *fp = nullptr;
+        std::string fileName = getUploadFileName(FitsB.format);
+        if (fileName.empty())
+            return false;
+        const char *integrationFileName = fileName.c_str();
 
         fp = fopen(integrationFileName, "w");
         if (fp == nullptr)
@@ -1053,6 +1306,10 @@ bool SensorInterface::saveConfigItems(FILE *fp)
 
 void SensorInterface::getMinMax(double *min, double *max, uint8_t *buf, int len, int bpp)
 {
+    // Unsigned integer samples
+    if (getPixelMinMax(buf, len, bpp, min, max))
+        return;
+
     int ind         = 0, i, j;
     int integrationHeight = 1;
     int integrationWidth  = len;
@@ -1060,57 +1317,6 @@ void SensorInterface::getMinMax(double *min, double *max, uint8_t *buf, int len,
 
     switch (bpp)
     {
-        case 8:
-        {
-            uint8_t *integrationBuffer = static_cast<uint8_t *>(buf);
-            lmin = lmax = integrationBuffer[0];
-
-            for (i = 0; i < integrationHeight; i++)
-                for (j = 0; j < integrationWidth; j++)
-                {
-                    ind = (i * integrationWidth) + j;
-                    if (integrationBuffer[ind] < lmin)
-                        lmin = integrationBuffer[ind];
-                    else if (integrationBuffer[ind] > lmax)
-                        lmax = integrationBuffer[ind];
-                }
-        }
-        break;
-
-        case 16:
-        {
-            uint16_t *integrationBuffer = reinterpret_cast<uint16_t *>(buf);
-            lmin = lmax = integrationBuffer[0];
-
-            for (i = 0; i < integrationHeight; i++)
-                for (j = 0; j < integrationWidth; j++)
-                {
-                    ind = (i * integrationWidth) + j;
-                    if (integrationBuffer[ind] < lmin)
-                        lmin = integrationBuffer[ind];
-                    else if (integrationBuffer[ind] > lmax)
-                        lmax = integrationBuffer[ind];
-                }
-        }
-        break;
-
-        case 32:
-        {
-            uint32_t *integrationBuffer = reinterpret_cast<uint32_t *>(buf);
-            lmin = lmax = integrationBuffer[0];
-
-            for (i = 0; i < integrationHeight; i++)
-                for (j = 0; j < integrationWidth; j++)
-                {
-                    ind = (i * integrationWidth) + j;
-                    if (integrationBuffer[ind] < lmin)
-                        lmin = integrationBuffer[ind];
-                    else if (integrationBuffer[ind] > lmax)
-                        lmax = integrationBuffer[ind];
-                }
-        }
-        break;
-
         case 64:
         {
             unsigned long *integrationBuffer = reinterpret_cast<unsigned long *>(buf);
@@ -80,7 +80,8 @@ class SensorInterface : public DefaultDevice
             SENSOR_HAS_SHUTTER                = 1 << 2, /*!< Does the Sensor have a mechanical shutter?  */
             SENSOR_HAS_COOLER                 = 1 << 3, /*!< Does the Sensor have a cooler and temperature control?  */
             SENSOR_HAS_DSP                    = 1 << 4,
-            SENSOR_MAX_CAPABILITY             = 1 << 5, /*!< Does the Sensor have a cooler and temperature control?  */
+            SENSOR_HAS_CONTINUOUS             = 1 << 5, /*!< Can the Sensor integrate back to back?  */
+            SENSOR_MAX_CAPABILITY             = 1 << 6, /*!< Does the Sensor have a cooler and temperature control?  */
         } SensorCapability;
 
         SensorInterface();
@@ -254,6 +255,14 @@ class SensorInterface : public DefaultDevice
             return (FramedIntegrationNP.s == IPS_BUSY);
         }
 
+        /**
+         * @return True if the Sensor starts the next integration as soon as one completes, false otherwise.
+         */
+        inline bool isContinuous() const
+        {
+            return HasContinuous() && ContinuousS[0].s == ISS_ON;
+        }
+
         /**
          * @brief Set Sensor temperature
          * @param temperature Sensor temperature in degrees celsius.
@@ -297,6 +306,9 @@ class SensorInterface : public DefaultDevice
          * this function when an Integration is complete.
          * @param targetDevice device that contains upload integration data
          * \note This function is not implemented in Sensor, it must be implemented in the child class
+         * \note In continuous mode the buffer is copied aside and StartIntegration is called again before
+         * this function returns, the copy is then sent as raw samples and appended to the recording
+         * while the next integration runs.
          */
         virtual bool IntegrationComplete();
 
@@ -378,6 +390,14 @@ class SensorInterface : public DefaultDevice
             return capability & SENSOR_HAS_COOLER;
         }
 
+        /**
+         * @return True if Sensor can restart an Integration from IntegrationComplete. False otherwise.
+         */
+        bool HasContinuous() const
+        {
+            return capability & SENSOR_HAS_CONTINUOUS;
+        }
+
         /**
          * @return True if Sensor can abort Integration. False otherwise.
          */
@@ -448,6 +468,9 @@ class SensorInterface : public DefaultDevice
         ISwitchVectorProperty AbortIntegrationSP;
         ISwitch AbortIntegrationS[1];
 
+        ISwitch ContinuousS[2];
+        ISwitchVectorProperty ContinuousSP;
+
         IBLOB FitsB;
         IBLOBVectorProperty FitsBP;
 
@@ -513,6 +536,9 @@ class SensorInterface : public DefaultDevice
         bool SendIntegration;
         bool ShowMarker;
 
+        // False when a subclass sends clients a product of the integrations instead, they are still saved locally
+        bool SendFrames { true };
+
         double IntegrationTime;
 
         // Sky Quality
@@ -552,11 +578,29 @@ class SensorInterface : public DefaultDevice
         double startIntegrationTime;
         char integrationExtention[MAXINDIBLOBFMT];
 
+        /// The integration recorded while the next one runs, in continuous mode
+        uint8_t *ContinuousBuffer { nullptr };
+        int ContinuousBufferSize { 0 };
+        int ContinuousBPS { 0 };
+        double ContinuousStartTime { 0 };
+        double ContinuousIntegrationTime { 0 };
+        std::thread ContinuousRecorder;
+        std::mutex ContinuousLock;
+        /// The SDFITS recording, one row per integration
+        fitsfile *ContinuousFile { nullptr };
+        int ContinuousRowSamples { 0 };
+        int ContinuousRowBPS { 0 };
+
         bool uploadFile(const void *fitsData, size_t totalBytes, bool sendIntegration, bool saveIntegration);
+        std::string getUploadFileName(const char *format);
         void getMinMax(double *min, double *max, uint8_t *buf, int len, int bpp);
         int getFileIndex(const char *dir, const char *prefix, const char *ext);
 
         bool IntegrationCompletePrivate();
+        bool continueIntegration();
+        bool ContinuousCompletePrivate();
+        bool appendContinuousRow();
+        void stopContinuous();
         void* sendFITS(uint8_t* buf, int len);
 };
 }
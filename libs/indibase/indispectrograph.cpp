@@ -23,6 +23,7 @@
 #include "indicom.h"
 #include "stream/streammanager.h"
 #include "locale_compat.h"
+#include "simd.h"
 
 #include <fitsio.h>
 
@@ -30,6 +31,7 @@
 #include <libnova/ln_types.h>
 #include <libnova/precession.h>
 
+#include <algorithm>
 #include <regex>
 
 #include <dirent.h>
@@ -42,6 +44,32 @@
 namespace INDI
 {
 
+static const char *EXTRACTION_TAB = "Extraction";
+
+// Adds the samples of a row to the sums, a vector at a time
+template <typename T>
+static void addRow(const T *row, dsp_t *sums, int width)
+{
+    int x = 0;
+    for (; x + DSP_VEC_LANES <= width; x += DSP_VEC_LANES)
+    {
+        dsp_vec_t samples;
+        for (int i = 0; i < DSP_VEC_LANES; i++)
+            samples[i] = row[x + i];
+        dsp_vec_store(sums + x, dsp_vec_load(sums + x) + samples);
+    }
+    for (; x < width; x++)
+        sums[x] += row[x];
+}
+
+template <typename T>
+static void sumRows(const uint8_t *buf, int width, int start, int rows, dsp_t *sums)
+{
+    const T *frame = reinterpret_cast<const T *>(buf);
+    for (int y = start; y < start + rows; y++)
+        addRow(frame + static_cast<size_t>(y) * width, sums, width);
+}
+
 Spectrograph::Spectrograph()
 {
 }
@@ -64,6 +92,27 @@ bool Spectrograph::initProperties()
     IUFillNumberVector(&SpectrographSettingsNP, SpectrographSettingsN, 6, getDeviceName(), "SPECTROGRAPH_SETTINGS",
                        "Spectrograph Settings", MAIN_CONTROL_TAB, IP_RW, 60, IPS_IDLE);
 
+    ExtractionSP[EXTRACTION_OFF].fill("EXTRACTION_OFF", "Off", ISS_ON);
+    ExtractionSP[EXTRACTION_WITH_FRAMES].fill("EXTRACTION_WITH_FRAMES", "Spectrum and frames", ISS_OFF);
+    ExtractionSP[EXTRACTION_SPECTRUM_ONLY].fill("EXTRACTION_SPECTRUM_ONLY", "Spectrum only", ISS_OFF);
+    ExtractionSP.fill(getDeviceName(), "SPECTROGRAPH_EXTRACTION", "Extraction", EXTRACTION_TAB, IP_RW, ISR_1OFMANY, 60,
+                      IPS_IDLE);
+
+    TraceNP[TRACE_FRAME_WIDTH].fill("FRAME_WIDTH", "Frame width", "%.f", 0, 65536, 1, 0);
+    TraceNP[TRACE_START].fill("TRACE_START", "First row", "%.f", 0, 65536, 1, 0);
+    TraceNP[TRACE_ROWS].fill("TRACE_ROWS", "Rows", "%.f", 1, 65536, 1, 1);
+    TraceNP[TRACE_BIN].fill("TRACE_BIN", "Columns per bin", "%.f", 1, 64, 1, 1);
+    TraceNP.fill(getDeviceName(), "SPECTROGRAPH_TRACE", "Trace", EXTRACTION_TAB, IP_RW, 60, IPS_IDLE);
+
+    DispersionNP[0].fill("DISPERSION_C0", "Constant", "%.6g", -1e9, 1e9, 0, 0);
+    DispersionNP[1].fill("DISPERSION_C1", "Linear", "%.6g", -1e9, 1e9, 0, 1);
+    DispersionNP[2].fill("DISPERSION_C2", "Quadratic", "%.6g", -1e9, 1e9, 0, 0);
+    DispersionNP[3].fill("DISPERSION_C3", "Cubic", "%.6g", -1e9, 1e9, 0, 0);
+    DispersionNP.fill(getDeviceName(), "SPECTROGRAPH_DISPERSION", "Dispersion", EXTRACTION_TAB, IP_RW, 60, IPS_IDLE);
+
+    SpectrumBP[0].fill("SPECTRUM", "Spectrum", ".spectrum");
+    SpectrumBP.fill(getDeviceName(), "SPECTROGRAPH_SPECTRUM", "Spectrum", EXTRACTION_TAB, IP_RO, 60, IPS_IDLE);
+
     setDriverInterface(SPECTROGRAPH_INTERFACE);
 
     return SensorInterface::initProperties();
@@ -79,6 +128,10 @@ bool Spectrograph::updateProperties()
     if (isConnected())
     {
         defineProperty(&SpectrographSettingsNP);
+        defineProperty(ExtractionSP);
+        defineProperty(TraceNP);
+        defineProperty(DispersionNP);
+        defineProperty(SpectrumBP);
 
         if (HasCooler())
             defineProperty(&TemperatureNP);
@@ -86,6 +139,10 @@ bool Spectrograph::updateProperties()
     else
     {
         deleteProperty(SpectrographSettingsNP.name);
+        deleteProperty(ExtractionSP);
+        deleteProperty(TraceNP);
+        deleteProperty(DispersionNP);
+        deleteProperty(SpectrumBP);
 
         if (HasCooler())
             deleteProperty(TemperatureNP.name);
@@ -109,11 +166,42 @@ bool Spectrograph::ISNewNumber(const char *dev, const char *name, double values[
     {
         IDSetNumber(&SpectrographSettingsNP, nullptr);
     }
+
+    if (dev && !strcmp(dev, getDeviceName()))
+    {
+        if (TraceNP.isNameMatch(name))
+        {
+            TraceNP.update(values, names, n);
+            TraceNP.setState(IPS_OK);
+            TraceNP.apply();
+            saveConfig(TraceNP);
+            return true;
+        }
+
+        if (DispersionNP.isNameMatch(name))
+        {
+            DispersionNP.update(values, names, n);
+            DispersionNP.setState(IPS_OK);
+            DispersionNP.apply();
+            saveConfig(DispersionNP);
+            return true;
+        }
+    }
+
     return processNumber(dev, name, values, names, n);
 }
 
 bool Spectrograph::ISNewSwitch(const char *dev, const char *name, ISState *values, char *names[], int n)
 {
+    if (dev && !strcmp(dev, getDeviceName()) && ExtractionSP.isNameMatch(name))
+    {
+        ExtractionSP.update(values, names, n);
+        ExtractionSP.setState(IPS_OK);
+        ExtractionSP.apply();
+        saveConfig(ExtractionSP);
+        return true;
+    }
+
     return processSwitch(dev, name, values, names, n);
 }
 
@@ -163,6 +251,105 @@ bool Spectrograph::StartIntegration(double duration)
     return false;
 }
 
+bool Spectrograph::IntegrationComplete()
+{
+    int const extraction = ExtractionSP.findOnSwitchIndex();
+
+    // Before the next integration, which may start from SensorInterface::IntegrationComplete, reuses the buffer
+    if (extraction != EXTRACTION_OFF && !extractSpectrum(getBuffer(), getBufferSize(), getBPS()))
+    {
+        SpectrumBP.setState(IPS_ALERT);
+        SpectrumBP.apply();
+    }
+
+    SendFrames = extraction != EXTRACTION_SPECTRUM_ONLY;
+    return SensorInterface::IntegrationComplete();
+}
+
+bool Spectrograph::extractSpectrum(const uint8_t *buf, int len, int bps)
+{
+    int const width = static_cast<int>(TraceNP[TRACE_FRAME_WIDTH].getValue());
+    int const start = static_cast<int>(TraceNP[TRACE_START].getValue());
+    int const rows  = static_cast<int>(TraceNP[TRACE_ROWS].getValue());
+    int const bin   = std::max(1, static_cast<int>(TraceNP[TRACE_BIN].getValue()));
+
+    if (buf == nullptr || width < 1 || rows < 1 || (bps != 8 && bps != 16 && bps != 32 && bps != -32))
+    {
+        LOGF_WARN("Unable to extract the spectrum of %d bits samples of frames %d wide.", bps, width);
+        return false;
+    }
+
+    size_t const frameRows = static_cast<size_t>(len) / (abs(bps) / 8) / width;
+    if (start < 0 || static_cast<size_t>(start) + rows > frameRows)
+    {
+        LOGF_WARN("The trace, rows %d to %d, is out of the frame of %zu rows.", start, start + rows - 1, frameRows);
+        return false;
+    }
+
+    TraceSums.assign(width, 0);
+    switch (bps)
+    {
+        case 8:
+            sumRows<uint8_t>(buf, width, start, rows, TraceSums.data());
+            break;
+        case 16:
+            sumRows<uint16_t>(buf, width, start, rows, TraceSums.data());
+            break;
+        case 32:
+            sumRows<uint32_t>(buf, width, start, rows, TraceSums.data());
+            break;
+        case -32:
+            sumRows<float>(buf, width, start, rows, TraceSums.data());
+            break;
+    }
+
+    int const bins = width / bin;
+
+    // The polynomial is only evaluated again when it or the bins change
+    std::vector<double> key = { static_cast<double>(bins), static_cast<double>(bin) };
+    for (const auto &coefficient : DispersionNP)
+        key.push_back(coefficient.getValue());
+    if (key != WavelengthsKey)
+    {
+        Wavelengths.resize(bins);
+        for (int b = 0; b < bins; b++)
+        {
+            double const x = b * bin + (bin - 1) / 2.0;
+            Wavelengths[b] = DispersionNP[0].getValue() + x * (DispersionNP[1].getValue() + x * (DispersionNP[2].getValue() + x *
+                             DispersionNP[3].getValue()));
+        }
+        WavelengthsKey = std::move(key);
+    }
+
+    Spectrum.resize(2 * bins);
+    std::copy(Wavelengths.begin(), Wavelengths.end(), Spectrum.begin());
+    for (int b = 0; b < bins; b++)
+    {
+        double flux = 0;
+        for (int x = b * bin; x < (b + 1) * bin; x++)
+            flux += TraceSums[x];
+        Spectrum[bins + b] = flux;
+    }
+
+    SpectrumBP[0].setBlob(Spectrum.data());
+    SpectrumBP[0].setBlobLen(Spectrum.size() * sizeof(float));
+    SpectrumBP[0].setSize(Spectrum.size() * sizeof(float));
+    SpectrumBP[0].setFormat(".spectrum");
+    SpectrumBP.setState(IPS_OK);
+    SpectrumBP.apply();
+    return true;
+}
+
+bool Spectrograph::saveConfigItems(FILE *fp)
+{
+    SensorInterface::saveConfigItems(fp);
+
+    ExtractionSP.save(fp);
+    TraceNP.save(fp);
+    DispersionNP.save(fp);
+    return true;
+}
+
 void Spectrograph::setMinMaxStep(const char *property, const char *element, double min, double max, double step,
                                  bool sendToClient)
 {
@@ -34,6 +34,7 @@
 #include <stdint.h>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 //JM 2019-01-17: Disabled until further notice
 //#define WITH_EXPOSURE_LOOPING
@@ -50,6 +51,12 @@
  *
  * Developers need to subclass INDI::Spectrograph to implement any driver for Spectrographs within INDI.
  *
+ * Drivers reading out 2D frames set SPECTROGRAPH_TRACE FRAME_WIDTH to the samples of a row. The spectrum of the
+ * trace can then be extracted on completion of each integration: the rows of the trace are summed, the columns
+ * binned and each bin given its wavelength from the SPECTROGRAPH_DISPERSION polynomial of its column. The spectrum
+ * is sent as the SPECTROGRAPH_SPECTRUM BLOB of format .spectrum, the float wavelengths of the bins followed by
+ * their float fluxes, optionally instead of the frames.
+ *
  * \example Spectrograph Simulator
  * \author Jasem Mutlaq, Ilia Platone
  *
@@ -81,6 +88,7 @@ class Spectrograph : public virtual SensorInterface
         virtual bool ISSnoopDevice(XMLEle *root) override;
 
         virtual bool StartIntegration(double duration) override;
+        virtual bool IntegrationComplete() override;
         virtual void addFITSKeywords(fitsfile *fptr, uint8_t* buf, int len) override;
 
         /**
@@ -174,10 +182,50 @@ class Spectrograph : public virtual SensorInterface
         INumberVectorProperty SpectrographSettingsNP;
         INumber SpectrographSettingsN[8];
 
+    protected:
+        virtual bool saveConfigItems(FILE *fp) override;
+
+        /**
+         * @brief extractSpectrum Extract the spectrum of the trace from the frame in buf and send it to the client.
+         * @param buf frame of SPECTROGRAPH_TRACE FRAME_WIDTH samples a row
+         * @param len size of buf in bytes
+         * @param bps bits per sample, as in setBPS()
+         * @return False if the trace does not fit the frame or the samples are not supported.
+         */
+        bool extractSpectrum(const uint8_t *buf, int len, int bps);
+
+        INDI::PropertySwitch ExtractionSP {3};
+        enum
+        {
+            EXTRACTION_OFF,
+            EXTRACTION_WITH_FRAMES,
+            EXTRACTION_SPECTRUM_ONLY
+        };
+
+        INDI::PropertyNumber TraceNP {4};
+        enum
+        {
+            TRACE_FRAME_WIDTH,
+            TRACE_START,
+            TRACE_ROWS,
+            TRACE_BIN
+        };
+
+        // Wavelength of column x, C0 + C1 x + C2 x^2 + C3 x^3
+        INDI::PropertyNumber DispersionNP {4};
+
+        INDI::PropertyBlob SpectrumBP {1};
+
     private:
         double LowCutFrequency;
         double HighCutFrequency;
         double Gain;
 
+        // Wavelengths of the bins, until the dispersion or the binning change
+        std::vector<float> Wavelengths;
+        std::vector<double> WavelengthsKey;
+        std::vector<dsp_t> TraceSums;
+        std::vector<float> Spectrum;
+
 };
 }
@@ -0,0 +1,317 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indistaranalysis.h"
+#include "indithreadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+// Side of the tiles the background is estimated in, and the rows of the bands peaks are searched in
+constexpr uint32_t TILE = 64;
+
+// Largest radius of the disc a star is measured in
+constexpr int MAX_RADIUS = 32;
+
+struct Peak
+{
+    uint32_t x, y;
+    double value;
+};
+
+double median(std::vector<double> &values)
+{
+    if (values.empty())
+        return 0;
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+template <typename T>
+class Analysis
+{
+    public:
+        Analysis(const T *pixels, uint32_t width, uint32_t height)
+            : pixels(pixels), width(width), height(height),
+              tilesX((width + TILE - 1) / TILE), tilesY((height + TILE - 1) / TILE),
+              tileBackground(tilesX * tilesY), tileNoise(tilesX * tilesY) { }
+
+        double at(uint32_t x, uint32_t y) const
+        {
+            return pixels[static_cast<size_t>(y) * width + x];
+        }
+
+        double backgroundAt(uint32_t x, uint32_t y) const
+        {
+            return tileBackground[(y / TILE) * tilesX + x / TILE];
+        }
+
+        // Median and median absolute deviation of each tile, on every other pixel of every other row
+        void estimateBackground()
+        {
+            INDI::ThreadPool::global().parallelFor(0, tileBackground.size(), [&](size_t tile)
+            {
+                uint32_t const x0 = (tile % tilesX) * TILE, y0 = (tile / tilesX) * TILE;
+                uint32_t const x1 = std::min(x0 + TILE, width), y1 = std::min(y0 + TILE, height);
+
+                std::vector<double> values;
+                values.reserve(TILE * TILE / 4);
+                for (uint32_t y = y0; y < y1; y += 2)
+                    for (uint32_t x = x0; x < x1; x += 2)
+                        values.push_back(at(x, y));
+
+                double const level = median(values);
+                for (auto &value : values)
+                    value = std::fabs(value - level);
+                tileBackground[tile] = level;
+                tileNoise[tile] = 1.4826 * median(values);
+            }, 4);
+
+            std::vector<double> levels(tileBackground), deviations(tileNoise);
+            background = median(levels);
+            noise = std::max(median(deviations), 1e-3);
+        }
+
+        // Pixels brighter than their 8 neighbours and above the threshold, with a neighbour above half of it
+        std::vector<Peak> findPeaks(double threshold)
+        {
+            std::vector<Peak> peaks;
+            std::mutex lock;
+            uint32_t const margin = 4;
+            if (width <= 2 * margin || height <= 2 * margin)
+                return peaks;
+
+            uint32_t const bands = (height - 2 * margin + TILE - 1) / TILE;
+            INDI::ThreadPool::global().parallelFor(0, bands, [&](size_t band)
+            {
+                std::vector<Peak> found;
+                uint32_t const y0 = margin + band * TILE, y1 = std::min(y0 + TILE, height - margin);
+                for (uint32_t y = y0; y < y1; y++)
+                {
+                    for (uint32_t x = margin; x < width - margin; x++)
+                    {
+                        double const value = at(x, y);
+                        double const level = backgroundAt(x, y);
+                        if (value < level + threshold * noise)
+                            continue;
+
+                        bool isPeak = true;
+                        int support = 0;
+                        for (int dy = -1; dy <= 1 && isPeak; dy++)
+                            for (int dx = -1; dx <= 1; dx++)
+                            {
+                                if (dx == 0 && dy == 0)
+                                    continue;
+                                double const neighbour = at(x + dx, y + dy);
+                                // Ties go to the first pixel in scan order
+                                if (neighbour > value || (neighbour == value && (dy < 0 || (dy == 0 && dx < 0))))
+                                {
+                                    isPeak = false;
+                                    break;
+                                }
+                                if (neighbour > level + threshold * noise / 2)
+                                    support++;
+                            }
+
+                        // A single bright pixel is a hot pixel or a cosmic ray
+                        if (isPeak && support >= 2)
+                            found.push_back({x, y, value - level});
+                    }
+                }
+
+                std::lock_guard<std::mutex> guard(lock);
+                peaks.insert(peaks.end(), found.begin(), found.end());
+            });
+
+            return peaks;
+        }
+
+        // Centroid, flux, half flux radius and FWHM of the star at a peak, false if it is too close to the border or too faint
+        bool measure(const Peak &peak, INDI::Star &star) const
+        {
+            double const level = backgroundAt(peak.x, peak.y);
+
+            // Extent of the star: distance to the first pixel at the noise level, in the four directions
+            int extent = 1;
+            const int directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+            for (auto &direction : directions)
+            {
+                int r = 1;
+                for (; r < MAX_RADIUS; r++)
+                {
+                    int64_t const x = static_cast<int64_t>(peak.x) + direction[0] * r;
+                    int64_t const y = static_cast<int64_t>(peak.y) + direction[1] * r;
+                    if (x < 0 || y < 0 || x >= width || y >= height)
+                        return false;
+                    if (at(x, y) < level + noise)
+                        break;
+                }
+                extent = std::max(extent, r);
+            }
+
+            int const radius = std::min(extent + 3, MAX_RADIUS);
+            if (peak.x < static_cast<uint32_t>(radius) || peak.y < static_cast<uint32_t>(radius) ||
+                    peak.x + radius >= width || peak.y + radius >= height)
+                return false;
+
+            // Centroid, then the flux weighted mean distance to it and the second moment
+            double flux = 0, cx = 0, cy = 0;
+            for (int dy = -radius; dy <= radius; dy++)
+                for (int dx = -radius; dx <= radius; dx++)
+                {
+                    if (dx * dx + dy * dy > radius * radius)
+                        continue;
+                    double const f = at(peak.x + dx, peak.y + dy) - level;
+                    if (f <= 0)
+                        continue;
+                    flux += f;
+                    cx += f * dx;
+                    cy += f * dy;
+                }
+            if (flux <= 0)
+                return false;
+            cx /= flux;
+            cy /= flux;
+
+            double distance = 0, moment = 0;
+            for (int dy = -radius; dy <= radius; dy++)
+                for (int dx = -radius; dx <= radius; dx++)
+                {
+                    if (dx * dx + dy * dy > radius * radius)
+                        continue;
+                    double const f = at(peak.x + dx, peak.y + dy) - level;
+                    if (f <= 0)
+                        continue;
+                    double const r2 = (dx - cx) * (dx - cx) + (dy - cy) * (dy - cy);
+                    distance += f * std::sqrt(r2);
+                    moment += f * r2;
+                }
+
+            star.x = peak.x + cx;
+            star.y = peak.y + cy;
+            star.flux = flux;
+            star.hfr = distance / flux;
+            // Second moment of a gaussian is 2 sigma^2
+            star.fwhm = 2.35482 * std::sqrt(moment / flux / 2);
+            return true;
+        }
+
+    public:
+        const T *pixels;
+        uint32_t width, height;
+        uint32_t tilesX, tilesY;
+        std::vector<double> tileBackground, tileNoise;
+        double background {0}, noise {0};
+};
+
+template <typename T>
+void analyse(const T *pixels, uint32_t width, uint32_t height, double threshold, size_t maxStars, INDI::StarMetrics &metrics,
+             std::vector<INDI::Star> &measured)
+{
+    Analysis<T> analysis(pixels, width, height);
+    analysis.estimateBackground();
+
+    // Brightest peaks first, dropping the fainter ones close to a brighter one
+    std::vector<Peak> peaks = analysis.findPeaks(threshold);
+    std::sort(peaks.begin(), peaks.end(), [](const Peak & a, const Peak & b)
+    {
+        return a.value > b.value;
+    });
+
+    std::vector<Peak> stars;
+    for (auto &peak : peaks)
+    {
+        if (stars.size() >= maxStars)
+            break;
+        bool isolated = std::none_of(stars.begin(), stars.end(), [&](const Peak & star)
+        {
+            int64_t dx = static_cast<int64_t>(star.x) - peak.x, dy = static_cast<int64_t>(star.y) - peak.y;
+            return dx * dx + dy * dy < 25;
+        });
+        if (isolated)
+            stars.push_back(peak);
+    }
+
+    std::vector<INDI::Star> results(stars.size());
+    INDI::ThreadPool::global().parallelFor(0, stars.size(), [&](size_t i)
+    {
+        if (!analysis.measure(stars[i], results[i]))
+            results[i].hfr = NAN;
+    }, 8);
+
+    results.erase(std::remove_if(results.begin(), results.end(), [](const INDI::Star & star)
+    {
+        return std::isnan(star.hfr);
+    }), results.end());
+
+    std::vector<double> hfrs, fwhms;
+    for (auto &star : results)
+    {
+        hfrs.push_back(star.hfr);
+        fwhms.push_back(star.fwhm);
+    }
+
+    metrics.stars = hfrs.size();
+    metrics.hfr = median(hfrs);
+    metrics.fwhm = median(fwhms);
+    metrics.background = analysis.background;
+    metrics.noise = analysis.noise;
+
+    measured.swap(results);
+}
+
+}
+
+namespace INDI
+{
+
+bool measureStars(const void *pixels, uint32_t width, uint32_t height, int bpp, StarMetrics &metrics,
+                  double threshold, size_t maxStars)
+{
+    std::vector<Star> stars;
+    return measureStars(pixels, width, height, bpp, metrics, stars, threshold, maxStars);
+}
+
+bool measureStars(const void *pixels, uint32_t width, uint32_t height, int bpp, StarMetrics &metrics,
+                  std::vector<Star> &stars, double threshold, size_t maxStars)
+{
+    stars.clear();
+    if (width < 16 || height < 16)
+        return false;
+
+    metrics = StarMetrics();
+    switch (bpp)
+    {
+        case 8:
+            analyse(static_cast<const uint8_t *>(pixels), width, height, threshold, maxStars, metrics, stars);
+            return true;
+        case 16:
+            analyse(static_cast<const uint16_t *>(pixels), width, height, threshold, maxStars, metrics, stars);
+            return true;
+        case 32:
+            analyse(static_cast<const uint32_t *>(pixels), width, height, threshold, maxStars, metrics, stars);
+            return true;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,60 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @brief Statistics of the stars of a frame, as autofocus and guiding clients use them.
+ * HFR and FWHM are medians over the measured stars, in pixels of the frame.
+ */
+struct StarMetrics
+{
+    size_t stars {0};           /*!< Stars detected */
+    double hfr {0};             /*!< Half flux radius */
+    double fwhm {0};            /*!< Full width at half maximum, from the second moments of the stars */
+    double background {0};      /*!< Median background level */
+    double noise {0};           /*!< Standard deviation of the background */
+};
+
+/** @brief A star measured by measureStars(), in pixels of the frame. */
+struct Star
+{
+    double x {0}, y {0};        /*!< Centroid */
+    double flux {0};            /*!< Flux above the background */
+    double hfr {0};             /*!< Half flux radius */
+    double fwhm {0};            /*!< Full width at half maximum */
+};
+
+/**
+ * @brief Detects the stars of a frame of unsigned pixels of bpp bits, 8, 16 or 32, and measures them.
+ * The background is estimated in tiles, stars are the local peaks above it by threshold times the noise,
+ * and the brightest maxStars of them are measured. Large frames are analysed on the global ThreadPool.
+ * @return False if bpp is not supported or the frame is too small.
+ */
+bool measureStars(const void *pixels, uint32_t width, uint32_t height, int bpp, StarMetrics &metrics,
+                  double threshold = 5, size_t maxStars = 500);
+
+/** @brief Same as measureStars() above, also returning the measured stars, the brightest first. */
+bool measureStars(const void *pixels, uint32_t width, uint32_t height, int bpp, StarMetrics &metrics,
+                  std::vector<Star> &stars, double threshold = 5, size_t maxStars = 500);
+
+}
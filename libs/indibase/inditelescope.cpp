@@ -20,6 +20,7 @@
 
 #include "indicom.h"
 #include "indicontroller.h"
+#include "indiparkdata.h"
 #include "connectionplugins/connectionserial.h"
 #include "connectionplugins/connectiontcp.h"
 
@@ -56,9 +57,6 @@ Telescope::Telescope()
 
 Telescope::~Telescope()
 {
-    if (ParkdataXmlRoot)
-        delXMLEle(ParkdataXmlRoot);
-
     delete (controller);
 }
 
@@ -265,11 +263,7 @@ bool Telescope::initProperties()
         registerConnection(tcpConnection);
     }
 
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_GPS].getText(), "GEOGRAPHIC_COORD");
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_GPS].getText(), "TIME_UTC");
-
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_DOME].getText(), "DOME_PARK");
-    IDSnoopDevice(ActiveDeviceTP[ACTIVE_DOME].getText(), "DOME_SHUTTER");
+    watchActiveDevices(nullptr, nullptr);
 
     addPollPeriodControl();
 
@@ -498,99 +492,135 @@ bool Telescope::ISSnoopDevice(XMLEle *root)
 {
     controller->ISSnoopDevice(root);
 
-    XMLEle *ep           = nullptr;
-    const char *propName = findXMLAttValu(root, "name");
-    auto deviceName = std::string(findXMLAttValu(root, "device"));
+    // The properties of the GPS and the dome are handled by the snoop functions
+    return DefaultDevice::ISSnoopDevice(root);
+}
 
-    if (isConnected())
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+void Telescope::watchActiveDevices(const char *previousGPS, const char *previousDome)
+{
+    unwatchSnoop(previousGPS, "GEOGRAPHIC_COORD");
+    unwatchSnoop(previousGPS, "TIME_UTC");
+    unwatchSnoop(previousDome, "DOME_PARK");
+
+    watchSnoop(ActiveDeviceTP[ACTIVE_GPS].getText(), "GEOGRAPHIC_COORD", [this](XMLEle *root)
     {
-        if (HasLocation() && !strcmp(propName, "GEOGRAPHIC_COORD") && deviceName == ActiveDeviceTP[ACTIVE_GPS].getText())
-        {
-            // Only accept IPS_OK state
-            if (strcmp(findXMLAttValu(root, "state"), "Ok"))
-                return false;
+        return isConnected() && HasLocation() && snoopGPSLocation(root);
+    });
+    watchSnoop(ActiveDeviceTP[ACTIVE_GPS].getText(), "TIME_UTC", [this](XMLEle *root)
+    {
+        return isConnected() && HasTime() && snoopGPSTime(root);
+    });
 
-            double longitude = -1, latitude = -1, elevation = -1;
+    watchSnoop(ActiveDeviceTP[ACTIVE_DOME].getText(), "DOME_PARK", [this](XMLEle *root)
+    {
+        return isConnected() && snoopDomePark(root);
+    });
+    IDSnoopDevice(ActiveDeviceTP[ACTIVE_DOME].getText(), "DOME_SHUTTER");
+}
 
-            for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-            {
-                const char *elemName = findXMLAttValu(ep, "name");
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Telescope::snoopGPSLocation(XMLEle *root)
+{
+    XMLEle *ep = nullptr;
 
-                if (!strcmp(elemName, "LAT"))
-                    latitude = atof(pcdataXMLEle(ep));
-                else if (!strcmp(elemName, "LONG"))
-                    longitude = atof(pcdataXMLEle(ep));
-                else if (!strcmp(elemName, "ELEV"))
-                    elevation = atof(pcdataXMLEle(ep));
-            }
+    // Only accept IPS_OK state
+    if (strcmp(findXMLAttValu(root, "state"), "Ok"))
+        return false;
 
-            return processLocationInfo(latitude, longitude, elevation);
-        }
-        else if (HasTime() && !strcmp(propName, "TIME_UTC") && deviceName == ActiveDeviceTP[ACTIVE_GPS].getText())
-        {
-            // Only accept IPS_OK state
-            if (strcmp(findXMLAttValu(root, "state"), "Ok"))
-                return false;
+    double longitude = -1, latitude = -1, elevation = -1;
 
-            char utc[MAXINDITSTAMP], offset[MAXINDITSTAMP];
+    for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+    {
+        const char *elemName = findXMLAttValu(ep, "name");
 
-            for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-            {
-                const char *elemName = findXMLAttValu(ep, "name");
+        if (!strcmp(elemName, "LAT"))
+            latitude = atof(pcdataXMLEle(ep));
+        else if (!strcmp(elemName, "LONG"))
+            longitude = atof(pcdataXMLEle(ep));
+        else if (!strcmp(elemName, "ELEV"))
+            elevation = atof(pcdataXMLEle(ep));
+    }
 
-                if (!strcmp(elemName, "UTC"))
-                    strncpy(utc, pcdataXMLEle(ep), MAXINDITSTAMP);
-                else if (!strcmp(elemName, "OFFSET"))
-                    strncpy(offset, pcdataXMLEle(ep), MAXINDITSTAMP);
-            }
+    return processLocationInfo(latitude, longitude, elevation);
+}
 
-            return processTimeInfo(utc, offset);
-        }
-        else if (!strcmp(propName, "DOME_PARK") && deviceName == ActiveDeviceTP[ACTIVE_DOME].getText())
-        {
-            // This is handled by Watchdog driver.
-            // Mount shouldn't park due to dome closing in INDI::Telescope
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Telescope::snoopGPSTime(XMLEle *root)
+{
+    XMLEle *ep = nullptr;
+
+    // Only accept IPS_OK state
+    if (strcmp(findXMLAttValu(root, "state"), "Ok"))
+        return false;
+
+    char utc[MAXINDITSTAMP], offset[MAXINDITSTAMP];
+
+    for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+    {
+        const char *elemName = findXMLAttValu(ep, "name");
+
+        if (!strcmp(elemName, "UTC"))
+            strncpy(utc, pcdataXMLEle(ep), MAXINDITSTAMP);
+        else if (!strcmp(elemName, "OFFSET"))
+            strncpy(offset, pcdataXMLEle(ep), MAXINDITSTAMP);
+    }
+
+    return processTimeInfo(utc, offset);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+///
+////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Telescope::snoopDomePark(XMLEle *root)
+{
+    XMLEle *ep = nullptr;
+
+    // This is handled by Watchdog driver.
+    // Mount shouldn't park due to dome closing in INDI::Telescope
 #if 0
-            if (strcmp(findXMLAttValu(root, "state"), "Ok"))
+    if (strcmp(findXMLAttValu(root, "state"), "Ok"))
+    {
+        // Dome options is dome parks or both and dome is parking.
+        if ((DomeClosedLockT[2].s == ISS_ON || DomeClosedLockT[3].s == ISS_ON) && !IsLocked && !IsParked)
+        {
+            for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
             {
-                // Dome options is dome parks or both and dome is parking.
-                if ((DomeClosedLockT[2].s == ISS_ON || DomeClosedLockT[3].s == ISS_ON) && !IsLocked && !IsParked)
+                const char * elemName = findXMLAttValu(ep, "name");
+                if (( (!strcmp(elemName, "SHUTTER_CLOSE") || !strcmp(elemName, "PARK"))
+                        && !strcmp(pcdataXMLEle(ep), "On")))
                 {
-                    for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-                    {
-                        const char * elemName = findXMLAttValu(ep, "name");
-                        if (( (!strcmp(elemName, "SHUTTER_CLOSE") || !strcmp(elemName, "PARK"))
-                                && !strcmp(pcdataXMLEle(ep), "On")))
-                        {
-                            RememberTrackState = TrackState;
-                            Park();
-                            LOG_INFO("Dome is closing, parking mount...");
-                        }
-                    }
+                    RememberTrackState = TrackState;
+                    Park();
+                    LOG_INFO("Dome is closing, parking mount...");
                 }
-            } // Dome is changing state and Dome options is lock or both. d
-            else
+            }
+        }
+    } // Dome is changing state and Dome options is lock or both. d
+    else
 #endif
-                if (!strcmp(findXMLAttValu(root, "state"), "Ok"))
-                {
-                    bool prevState = IsLocked;
-                    for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
-                    {
-                        const char *elemName = findXMLAttValu(ep, "name");
+        if (!strcmp(findXMLAttValu(root, "state"), "Ok"))
+        {
+            bool prevState = IsLocked;
+            for (ep = nextXMLEle(root, 1); ep != nullptr; ep = nextXMLEle(root, 0))
+            {
+                const char *elemName = findXMLAttValu(ep, "name");
 
-                        if (!IsLocked && (!strcmp(elemName, "PARK")) && !strcmp(pcdataXMLEle(ep), "On"))
-                            IsLocked = true;
-                        else if (IsLocked && (!strcmp(elemName, "UNPARK")) && !strcmp(pcdataXMLEle(ep), "On"))
-                            IsLocked = false;
-                    }
-                    if (prevState != IsLocked && (DomePolicySP[DOME_LOCKS].getState() == ISS_ON))
-                        LOGF_INFO("Dome status changed. Lock is set to: %s", IsLocked ? "locked" : "unlock");
-                }
-            return true;
+                if (!IsLocked && (!strcmp(elemName, "PARK")) && !strcmp(pcdataXMLEle(ep), "On"))
+                    IsLocked = true;
+                else if (IsLocked && (!strcmp(elemName, "UNPARK")) && !strcmp(pcdataXMLEle(ep), "On"))
+                    IsLocked = false;
+            }
+            if (prevState != IsLocked && (DomePolicySP[DOME_LOCKS].getState() == ISS_ON))
+                LOGF_INFO("Dome status changed. Lock is set to: %s", IsLocked ? "locked" : "unlock");
         }
-    }
-
-    return DefaultDevice::ISSnoopDevice(root);
+    return true;
 }
 
 void Telescope::triggerSnoop(const char *driverName, const char *snoopedProp)
@@ -742,16 +772,14 @@ bool Telescope::ISNewText(const char *dev, const char *name, char *texts[], char
 
         if (ActiveDeviceTP.isNameMatch(name))
         {
+            std::string previousGPS = ActiveDeviceTP[ACTIVE_GPS].getText();
+            std::string previousDome = ActiveDeviceTP[ACTIVE_DOME].getText();
             ActiveDeviceTP.setState(IPS_OK);
             ActiveDeviceTP.update(texts, names, n);
             //  Update client display
             ActiveDeviceTP.apply();
 
-            IDSnoopDevice(ActiveDeviceTP[ACTIVE_GPS].getText(), "GEOGRAPHIC_COORD");
-            IDSnoopDevice(ActiveDeviceTP[ACTIVE_GPS].getText(), "TIME_UTC");
-
-            IDSnoopDevice(ActiveDeviceTP[ACTIVE_DOME].getText(), "DOME_PARK");
-            IDSnoopDevice(ActiveDeviceTP[ACTIVE_DOME].getText(), "DOME_SHUTTER");
+            watchActiveDevices(previousGPS.c_str(), previousDome.c_str());
 
             saveConfig(ActiveDeviceTP);
             return true;
@@ -2022,128 +2050,31 @@ bool Telescope::InitPark()
     return true;
 }
 
-const char *Telescope::LoadParkXML()
-{
-    wordexp_t wexp;
-    FILE *fp = nullptr;
-    LilXML *lp = nullptr;
-    static char errmsg[512];
-
-    XMLEle *parkxml = nullptr;
-    XMLAtt *ap = nullptr;
-    bool devicefound = false;
-
-    ParkDeviceName       = getDeviceName();
-    ParkstatusXml        = nullptr;
-    ParkdeviceXml        = nullptr;
-    ParkpositionXml      = nullptr;
-    ParkpositionAxis1Xml = nullptr;
-    ParkpositionAxis2Xml = nullptr;
-
-    if (wordexp(ParkDataFileName.c_str(), &wexp, 0))
-    {
-        wordfree(&wexp);
-        return "Badly formed filename.";
-    }
-
-    if (!(fp = fopen(wexp.we_wordv[0], "r")))
-    {
-        wordfree(&wexp);
-        return strerror(errno);
-    }
-    wordfree(&wexp);
-
-    lp = newLilXML();
-
-    if (ParkdataXmlRoot)
-        delXMLEle(ParkdataXmlRoot);
-
-    ParkdataXmlRoot = readXMLFile(fp, lp, errmsg);
-    fclose(fp);
-
-    delLilXML(lp);
-    if (!ParkdataXmlRoot)
-        return errmsg;
-
-    parkxml = nextXMLEle(ParkdataXmlRoot, 1);
-
-    if (!parkxml)
-        return "Empty park file.";
-
-    if (!strcmp(tagXMLEle(parkxml), "parkdata"))
-    {
-        delXMLEle(parkxml);
-        return "Not a park data file";
-    }
-
-    while (parkxml)
-    {
-        if (strcmp(tagXMLEle(parkxml), "device"))
-        {
-            parkxml = nextXMLEle(ParkdataXmlRoot, 0);
-            continue;
-        }
-        ap = findXMLAtt(parkxml, "name");
-        if (ap && (!strcmp(valuXMLAtt(ap), ParkDeviceName)))
-        {
-            devicefound = true;
-            break;
-        }
-        parkxml = nextXMLEle(ParkdataXmlRoot, 0);
-    }
-
-    if (!devicefound)
-    {
-        delXMLEle(parkxml);
-        return "No park data found for this device";
-    }
-
-    ParkdeviceXml        = parkxml;
-    ParkstatusXml        = findXMLEle(parkxml, "parkstatus");
-
-    if (parkDataType != PARK_SIMPLE)
-    {
-        ParkpositionXml      = findXMLEle(parkxml, "parkposition");
-        if (ParkpositionXml)
-            ParkpositionAxis1Xml = findXMLEle(ParkpositionXml, "axis1position");
-        if (ParkpositionXml)
-            ParkpositionAxis2Xml = findXMLEle(ParkpositionXml, "axis2position");
-
-        if (ParkstatusXml == nullptr || ParkpositionAxis1Xml == nullptr || ParkpositionAxis2Xml == nullptr)
-        {
-            return "Park data invalid or missing.";
-        }
-    }
-    else if (ParkstatusXml == nullptr)
-    {
-        return "Park data invalid or missing.";
-    }
-
-    return nullptr;
-}
-
 const char *Telescope::LoadParkData()
 {
     IsParked = false;
 
-    const char *result = LoadParkXML();
+    ParkDataStore::Entry entry;
+    const char *result = ParkDataStore::instance(ParkDataFileName).read(getDeviceName(), entry);
     if (result != nullptr)
         return result;
 
-    if (!strcmp(pcdataXMLEle(ParkstatusXml), "true"))
-        IsParked = true;
+    if (!entry.hasStatus || (parkDataType != PARK_SIMPLE && entry.axes.size() < 2))
+        return "Park data invalid or missing.";
+
+    IsParked = entry.parked;
 
     if (parkDataType != PARK_SIMPLE)
     {
         double axis1Pos = std::numeric_limits<double>::quiet_NaN();
         double axis2Pos = std::numeric_limits<double>::quiet_NaN();
 
-        int rc = sscanf(pcdataXMLEle(ParkpositionAxis1Xml), "%lf", &axis1Pos);
+        int rc = sscanf(entry.axes[0].c_str(), "%lf", &axis1Pos);
         if (rc != 1)
         {
             return "Unable to parse Park Position Axis 1.";
         }
-        rc = sscanf(pcdataXMLEle(ParkpositionAxis2Xml), "%lf", &axis2Pos);
+        rc = sscanf(entry.axes[1].c_str(), "%lf", &axis2Pos);
         if (rc != 1)
         {
             return "Unable to parse Park Position Axis 2.";
@@ -2164,160 +2095,23 @@ const char *Telescope::LoadParkData()
 
 bool Telescope::PurgeParkData()
 {
-    // We need to refresh parking data in case other devices parking states were updated since we
-    // read the data the first time.
-    if (LoadParkXML() != nullptr)
-        LOG_DEBUG("Failed to refresh parking data.");
-
-    wordexp_t wexp;
-    FILE *fp = nullptr;
-    LilXML *lp = nullptr;
-    static char errmsg[512];
-
-    XMLEle *parkxml = nullptr;
-    XMLAtt *ap = nullptr;
-    bool devicefound = false;
-
-    ParkDeviceName = getDeviceName();
-
-    if (wordexp(ParkDataFileName.c_str(), &wexp, 0))
-    {
-        wordfree(&wexp);
-        return false;
-    }
-
-    if (!(fp = fopen(wexp.we_wordv[0], "r")))
+    if (!ParkDataStore::instance(ParkDataFileName).purge(getDeviceName()))
     {
-        wordfree(&wexp);
-        LOGF_ERROR("Failed to purge park data: %s", strerror(errno));
+        LOG_DEBUG("No park data to purge.");
         return false;
     }
-    wordfree(&wexp);
-
-    lp = newLilXML();
-
-    if (ParkdataXmlRoot)
-        delXMLEle(ParkdataXmlRoot);
-
-    ParkdataXmlRoot = readXMLFile(fp, lp, errmsg);
-    fclose(fp);
-
-    delLilXML(lp);
-    if (!ParkdataXmlRoot)
-        return false;
-
-    parkxml = nextXMLEle(ParkdataXmlRoot, 1);
-
-    if (!parkxml)
-        return false;
-
-    if (!strcmp(tagXMLEle(parkxml), "parkdata"))
-    {
-        delXMLEle(parkxml);
-        return false;
-    }
-
-    while (parkxml)
-    {
-        if (strcmp(tagXMLEle(parkxml), "device"))
-        {
-            parkxml = nextXMLEle(ParkdataXmlRoot, 0);
-            continue;
-        }
-        ap = findXMLAtt(parkxml, "name");
-        if (ap && (!strcmp(valuXMLAtt(ap), ParkDeviceName)))
-        {
-            devicefound = true;
-            break;
-        }
-        parkxml = nextXMLEle(ParkdataXmlRoot, 0);
-    }
-
-    if (!devicefound)
-        return false;
-
-    delXMLEle(parkxml);
-
-    ParkstatusXml        = nullptr;
-    ParkdeviceXml        = nullptr;
-    ParkpositionXml      = nullptr;
-    ParkpositionAxis1Xml = nullptr;
-    ParkpositionAxis2Xml = nullptr;
-
-    wordexp(ParkDataFileName.c_str(), &wexp, 0);
-    if (!(fp = fopen(wexp.we_wordv[0], "w")))
-    {
-        wordfree(&wexp);
-        LOGF_INFO("WriteParkData: can not write file %s: %s", ParkDataFileName.c_str(), strerror(errno));
-        return false;
-    }
-    prXMLEle(fp, ParkdataXmlRoot, 0);
-    fclose(fp);
-    wordfree(&wexp);
 
     return true;
 }
 
 bool Telescope::WriteParkData()
 {
-    // We need to refresh parking data in case other devices parking states were updated since we
-    // read the data the first time.
-    if (LoadParkXML() != nullptr)
-        LOG_DEBUG("Failed to refresh parking data.");
-
-    wordexp_t wexp;
-    FILE *fp;
-    char pcdata[30];
-    ParkDeviceName = getDeviceName();
-
-    if (wordexp(ParkDataFileName.c_str(), &wexp, 0))
-    {
-        wordfree(&wexp);
-        LOGF_INFO("WriteParkData: can not write file %s: Badly formed filename.",
-                  ParkDataFileName.c_str());
-        return false;
-    }
-
-    if (!(fp = fopen(wexp.we_wordv[0], "w")))
-    {
-        wordfree(&wexp);
-        LOGF_INFO("WriteParkData: can not write file %s: %s", ParkDataFileName.c_str(),
-                  strerror(errno));
-        return false;
-    }
-
-    if (!ParkdataXmlRoot)
-        ParkdataXmlRoot = addXMLEle(nullptr, "parkdata");
-
-    if (!ParkdeviceXml)
-    {
-        ParkdeviceXml = addXMLEle(ParkdataXmlRoot, "device");
-        addXMLAtt(ParkdeviceXml, "name", ParkDeviceName);
-    }
-
-    if (!ParkstatusXml)
-        ParkstatusXml = addXMLEle(ParkdeviceXml, "parkstatus");
-    editXMLEle(ParkstatusXml, (IsParked ? "true" : "false"));
-
+    // Written in the background by the store, which rereads the file first if other processes changed it
+    std::vector<double> axes;
     if (parkDataType != PARK_SIMPLE)
-    {
-        if (!ParkpositionXml)
-            ParkpositionXml = addXMLEle(ParkdeviceXml, "parkposition");
-        if (!ParkpositionAxis1Xml)
-            ParkpositionAxis1Xml = addXMLEle(ParkpositionXml, "axis1position");
-        if (!ParkpositionAxis2Xml)
-            ParkpositionAxis2Xml = addXMLEle(ParkpositionXml, "axis2position");
-
-        snprintf(pcdata, sizeof(pcdata), "%lf", Axis1ParkPosition);
-        editXMLEle(ParkpositionAxis1Xml, pcdata);
-        snprintf(pcdata, sizeof(pcdata), "%lf", Axis2ParkPosition);
-        editXMLEle(ParkpositionAxis2Xml, pcdata);
-    }
-
-    prXMLEle(fp, ParkdataXmlRoot, 0);
-    fclose(fp);
-    wordfree(&wexp);
+        axes = {Axis1ParkPosition, Axis2ParkPosition};
 
+    ParkDataStore::instance(ParkDataFileName).write(getDeviceName(), IsParked, axes);
     return true;
 }
 
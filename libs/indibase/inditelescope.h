@@ -944,22 +944,19 @@ class Telescope : public DefaultDevice
         TelescopeParkData parkDataType {PARK_NONE};
 
     private:
+        // Handlers of the snooped properties of the active GPS and dome, previous are those snooped before
+        void watchActiveDevices(const char *previousGPS, const char *previousDome);
+        bool snoopGPSLocation(XMLEle *root);
+        bool snoopGPSTime(XMLEle *root);
+        bool snoopDomePark(XMLEle *root);
+
         bool processTimeInfo(const char *utc, const char *offset);
         bool processLocationInfo(double latitude, double longitude, double elevation);
         void triggerSnoop(const char *driverName, const char *propertyName);
         void generateCoordSet();
 
-        /**
-         * @brief LoadParkXML Read and process park XML data.
-         * @return error string if there is problem opening the file
-         */
-        const char *LoadParkXML();
-
         bool IsLocked {true};
-        const char *ParkDeviceName {nullptr};
         const std::string ParkDataFileName;
-        XMLEle *ParkdataXmlRoot {nullptr}, *ParkdeviceXml {nullptr}, *ParkstatusXml {nullptr}, *ParkpositionXml {nullptr},
-               *ParkpositionAxis1Xml {nullptr}, *ParkpositionAxis2Xml {nullptr};
 
         double Axis1ParkPosition {0};
         double Axis1DefaultParkPosition {0};
@@ -21,8 +21,15 @@
 
 #include "indiusbdevice.h"
 
+#include "eventloop.h"
+
 #include <config-usb.h>
 
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
 #ifndef USB1_HAS_LIBUSB_ERROR_NAME
 const char *LIBUSB_CALL libusb_error_name(int errcode)
 {
@@ -34,15 +41,82 @@ const char *LIBUSB_CALL libusb_error_name(int errcode)
 
 static libusb_context *ctx = nullptr;
 
+// The libusb event thread, shared by the devices with asynchronous transfers
+static std::mutex eventThreadLock;
+static std::thread eventThread;
+static int eventThreadUsers = 0;
+static std::atomic_bool eventThreadStop {false};
+
+static void acquireEventThread()
+{
+    std::lock_guard<std::mutex> lock(eventThreadLock);
+    if (eventThreadUsers++ > 0)
+        return;
+
+    eventThreadStop = false;
+    eventThread = std::thread([]
+    {
+        // Wakes up regularly to check whether it should stop
+        while (!eventThreadStop)
+        {
+            struct timeval tv = { 0, 100000 };
+            int rc = libusb_handle_events_timeout_completed(ctx, &tv, nullptr);
+            if (rc < 0 && rc != LIBUSB_ERROR_INTERRUPTED)
+                fprintf(stderr, "USBDevice: libusb_handle_events_timeout_completed -> %s\n", libusb_error_name(rc));
+        }
+    });
+}
+
+static void releaseEventThread()
+{
+    std::lock_guard<std::mutex> lock(eventThreadLock);
+    if (--eventThreadUsers > 0)
+        return;
+
+    eventThreadStop = true;
+    eventThread.join();
+}
+
+static int transferError(libusb_transfer_status status)
+{
+    switch (status)
+    {
+        case LIBUSB_TRANSFER_COMPLETED:
+            return 0;
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            return LIBUSB_ERROR_TIMEOUT;
+        case LIBUSB_TRANSFER_CANCELLED:
+            return LIBUSB_ERROR_INTERRUPTED;
+        case LIBUSB_TRANSFER_STALL:
+            return LIBUSB_ERROR_PIPE;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            return LIBUSB_ERROR_NO_DEVICE;
+        case LIBUSB_TRANSFER_OVERFLOW:
+            return LIBUSB_ERROR_OVERFLOW;
+        default:
+            return LIBUSB_ERROR_IO;
+    }
+}
+
 namespace INDI
 {
 
+struct USBDevice::Transfer
+{
+    USBDevice *device;
+    TransferCallback callback;
+    std::shared_ptr<bool> alive;
+    std::vector<unsigned char> buffer;
+    bool repeat;
+};
+
 USBDevice::USBDevice()
 {
     dev            = nullptr;
     usb_handle     = nullptr;
     OutputEndpoint = 0;
     InputEndpoint  = 0;
+    m_Alive        = std::make_shared<bool>(true);
 
     if (ctx == nullptr)
     {
@@ -56,6 +130,7 @@ USBDevice::USBDevice()
 
 USBDevice::~USBDevice()
 {
+    CancelTransfers();
     libusb_exit(ctx);
 }
 
@@ -132,7 +207,9 @@ int USBDevice::Open()
 
 void USBDevice::Close()
 {
+    CancelTransfers();
     libusb_close(usb_handle);
+    usb_handle = nullptr;
 }
 
 int USBDevice::FindEndpoints()
@@ -223,4 +300,171 @@ int USBDevice::ControlMessage(unsigned char request_type, unsigned char request,
     return rc;
 }
 
+int USBDevice::Submit(unsigned char endpoint, int type, const unsigned char *buf, int count, int timeout,
+                      TransferCallback callback, bool repeat)
+{
+    if (usb_handle == nullptr)
+        return LIBUSB_ERROR_NO_DEVICE;
+
+    libusb_transfer *transfer = libusb_alloc_transfer(0);
+    if (transfer == nullptr)
+        return LIBUSB_ERROR_NO_MEM;
+
+    Transfer *data = new Transfer { this, std::move(callback), m_Alive, std::vector<unsigned char>(count), repeat };
+    if (buf != nullptr)
+        memcpy(data->buffer.data(), buf, count);
+
+    if (type == LIBUSB_TRANSFER_TYPE_BULK)
+        libusb_fill_bulk_transfer(transfer, usb_handle, endpoint, data->buffer.data(), count, TransferDone, data, timeout);
+    else
+        libusb_fill_interrupt_transfer(transfer, usb_handle, endpoint, data->buffer.data(), count, TransferDone, data,
+                                       timeout);
+
+    // Held until the transfer is recorded, which TransferDone() may otherwise be called before
+    std::lock_guard<std::mutex> lock(m_TransfersLock);
+    if (!m_UsesEventThread)
+    {
+        acquireEventThread();
+        m_UsesEventThread = true;
+    }
+
+    int rc = libusb_submit_transfer(transfer);
+    if (rc < 0)
+    {
+        fprintf(stderr, "USBDevice: libusb_submit_transfer -> %s\n", libusb_error_name(rc));
+        delete data;
+        libusb_free_transfer(transfer);
+        return rc;
+    }
+    m_Transfers.insert(transfer);
+    return 0;
+}
+
+void LIBUSB_CALL USBDevice::TransferDone(libusb_transfer *transfer)
+{
+    Transfer *data    = static_cast<Transfer *>(transfer->user_data);
+    USBDevice *device = data->device;
+    int rc            = transferError(transfer->status);
+
+    // Copied before the buffer is reused by a resubmission
+    std::vector<unsigned char> bytes(transfer->buffer, transfer->buffer + transfer->actual_length);
+
+    std::lock_guard<std::mutex> lock(device->m_TransfersLock);
+    bool again = data->repeat && device->m_Reading && (rc == 0 || rc == LIBUSB_ERROR_TIMEOUT);
+    if (again)
+    {
+        int submitted = libusb_submit_transfer(transfer);
+        if (submitted < 0)
+        {
+            fprintf(stderr, "USBDevice: libusb_submit_transfer -> %s\n", libusb_error_name(submitted));
+            rc    = submitted;
+            again = false;
+        }
+    }
+
+    // Repeated reads are only reported when they read something, and cancelled transfers never are
+    if (transfer->status != LIBUSB_TRANSFER_CANCELLED && !(data->repeat && rc == LIBUSB_ERROR_TIMEOUT))
+    {
+        TransferCallback callback   = data->callback;
+        std::shared_ptr<bool> alive = data->alive;
+        postToEventLoop([callback, alive, rc, bytes]
+        {
+            if (*alive && callback)
+                callback(rc, bytes.data(), int(bytes.size()));
+        });
+    }
+
+    if (again)
+        return;
+
+    device->m_Transfers.erase(transfer);
+    delete data;
+    libusb_free_transfer(transfer);
+    device->m_TransfersDone.notify_all();
+}
+
+int USBDevice::WriteInterruptAsync(const unsigned char *buf, int count, int timeout, TransferCallback callback)
+{
+    return Submit(OutputEndpoint, LIBUSB_TRANSFER_TYPE_INTERRUPT, buf, count, timeout, std::move(callback), false);
+}
+
+int USBDevice::ReadInterruptAsync(int count, int timeout, TransferCallback callback)
+{
+    return Submit(InputEndpoint, LIBUSB_TRANSFER_TYPE_INTERRUPT, nullptr, count, timeout, std::move(callback), false);
+}
+
+int USBDevice::WriteBulkAsync(const unsigned char *buf, int count, int timeout, TransferCallback callback)
+{
+    return Submit(OutputEndpoint, LIBUSB_TRANSFER_TYPE_BULK, buf, count, timeout, std::move(callback), false);
+}
+
+int USBDevice::ReadBulkAsync(int count, int timeout, TransferCallback callback)
+{
+    return Submit(InputEndpoint, LIBUSB_TRANSFER_TYPE_BULK, nullptr, count, timeout, std::move(callback), false);
+}
+
+int USBDevice::StartReads(int count, int depth, TransferCallback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_TransfersLock);
+        if (m_Reading)
+            return LIBUSB_ERROR_BUSY;
+        m_Reading = true;
+    }
+
+    // Without a timeout, the reads wait for the device as long as needed
+    for (int i = 0; i < depth; i++)
+    {
+        int rc = Submit(InputEndpoint, InputType, nullptr, count, 0, callback, true);
+        if (rc < 0 && i == 0)
+        {
+            std::lock_guard<std::mutex> lock(m_TransfersLock);
+            m_Reading = false;
+            return rc;
+        }
+    }
+    return 0;
+}
+
+void USBDevice::StopReads()
+{
+    std::lock_guard<std::mutex> lock(m_TransfersLock);
+    m_Reading = false;
+    for (auto transfer : m_Transfers)
+    {
+        if (static_cast<Transfer *>(transfer->user_data)->repeat)
+            libusb_cancel_transfer(transfer);
+    }
+}
+
+void USBDevice::CancelTransfers()
+{
+    std::unique_lock<std::mutex> lock(m_TransfersLock);
+    m_Reading = false;
+
+    // Drop the callbacks already posted to the event loop
+    *m_Alive = false;
+    m_Alive  = std::make_shared<bool>(true);
+
+    for (auto transfer : m_Transfers)
+        libusb_cancel_transfer(transfer);
+    m_TransfersDone.wait(lock, [this]
+    {
+        return m_Transfers.empty();
+    });
+
+    bool release      = m_UsesEventThread;
+    m_UsesEventThread = false;
+    lock.unlock();
+
+    if (release)
+        releaseEventThread();
+}
+
+int USBDevice::PendingTransfers()
+{
+    std::lock_guard<std::mutex> lock(m_TransfersLock);
+    return int(m_Transfers.size());
+}
+
 }
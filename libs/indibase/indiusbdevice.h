@@ -25,11 +25,22 @@
 
 #include <libusb.h>
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+
 /**
  * \class USBDevice
    \brief Class to provide general functionality of a generic USB device.
 
    Developers need to subclass USBDevice to implement any driver within INDI that requires direct read/write/control over USB.
+
+   Besides the blocking transfers, interrupt and bulk transfers can be submitted asynchronously. They are handled by a
+   libusb event thread shared by all devices, any number of them can be in flight, and their callbacks are called on
+   the driver's event loop. StartReads() keeps several reads of the input endpoint queued, so that the device is read
+   at every interval instead of every time the driver polls it.
 */
 namespace INDI
 {
@@ -50,6 +61,15 @@ class USBDevice
 
         libusb_device *FindDevice(int, int, int);
 
+    public:
+        /**
+         * @brief Called on the event loop when an asynchronous transfer is done.
+         * @param rc 0, or the libusb error of the transfer, LIBUSB_ERROR_TIMEOUT if it timed out.
+         * @param buf The bytes read, or those written.
+         * @param transferred The number of bytes transferred, which may be short of those requested.
+         */
+        typedef std::function<void(int rc, const unsigned char *buf, int transferred)> TransferCallback;
+
     public:
         int WriteInterrupt(unsigned char *, int, int);
         int ReadInterrupt(unsigned char *, int, int);
@@ -57,11 +77,56 @@ class USBDevice
         int ReadBulk(unsigned char *buf, int nbytes, int timeout);
         int ControlMessage(unsigned char request_type, unsigned char request, unsigned int value, unsigned int index,
                            unsigned char *data, unsigned char len);
+
+        /**
+         * @brief Asynchronous transfers on the input or output endpoint. Written bytes are copied, buf may be
+         * reused when they return. Return 0 once the transfer is submitted, or a libusb error.
+         */
+        int WriteInterruptAsync(const unsigned char *buf, int count, int timeout, TransferCallback callback);
+        int ReadInterruptAsync(int count, int timeout, TransferCallback callback);
+        int WriteBulkAsync(const unsigned char *buf, int count, int timeout, TransferCallback callback);
+        int ReadBulkAsync(int count, int timeout, TransferCallback callback);
+
+        /**
+         * @brief Keeps depth reads of count bytes in flight on the input endpoint, resubmitted as soon as they
+         * complete, with callback called for every one of them that reads bytes, in the order they were read.
+         * Reads that time out are resubmitted silently. It stops on StopReads(), Close(), or an error, which is
+         * passed to callback.
+         * @return 0, or the libusb error of the first submission.
+         */
+        int StartReads(int count, int depth, TransferCallback callback);
+        void StopReads();
+
+        /**
+         * @brief Cancels the transfers in flight and waits for them. Callbacks of cancelled transfers, and those
+         * not called yet, are not called anymore.
+         */
+        void CancelTransfers();
+
+        /** @returns The number of asynchronous transfers in flight */
+        int PendingTransfers();
+
         int FindEndpoints();
         int Open();
         void Close();
         USBDevice();
         USBDevice(libusb_device *dev);
         virtual ~USBDevice();
+
+    private:
+        struct Transfer;
+
+        int Submit(unsigned char endpoint, int type, const unsigned char *buf, int count, int timeout,
+                   TransferCallback callback, bool repeat);
+        static void LIBUSB_CALL TransferDone(libusb_transfer *transfer);
+
+        std::mutex m_TransfersLock;
+        std::condition_variable m_TransfersDone;
+        std::set<libusb_transfer *> m_Transfers;
+        bool m_Reading {false};
+        bool m_UsesEventThread {false};
+
+        // Cleared when the transfers are cancelled, so that posted callbacks are dropped
+        std::shared_ptr<bool> m_Alive;
 };
 }
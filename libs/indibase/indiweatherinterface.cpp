@@ -22,14 +22,165 @@
 
 #include "indilogger.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstring>
+#include <ctime>
 
 namespace INDI
 {
 
 #define getDeviceName m_defaultDevice->getDeviceName
 
-WeatherInterface::WeatherInterface(DefaultDevice *defaultDevice) : m_defaultDevice(defaultDevice)
+////////////////////////////////////////////////////////////////////////////////////
+// Updates of the parameters, and their min, max and mean by minute, hour and day, each kept in a ring of its own.
+// Aggregates are updated with each update, so that sending them costs no more than copying them.
+////////////////////////////////////////////////////////////////////////////////////
+class WeatherInterface::History
+{
+    public:
+        // Rows of HistoryBP, the oldest first
+        void add(double time, const std::vector<double> &values)
+        {
+            if (values.size() != m_Parameters)
+            {
+                // Parameters were added, start over
+                *this = History();
+                m_Parameters = values.size();
+            }
+
+            Row &update = m_Updates.push();
+            update.start = time;
+            update.count = 1;
+            update.min.assign(values.begin(), values.end());
+            update.max.clear();
+            update.sum.clear();
+
+            for (auto &level : m_Levels)
+            {
+                double start = time - std::fmod(time, level.period);
+                if (level.rows.empty() || level.rows.back().start != start)
+                {
+                    Row &row = level.rows.push();
+                    row.start = start;
+                    row.count = 0;
+                    row.min.assign(values.begin(), values.end());
+                    row.max.assign(values.begin(), values.end());
+                    row.sum.assign(values.size(), 0);
+                }
+
+                Row &row = level.rows.back();
+                row.count++;
+                for (size_t i = 0; i < values.size(); i++)
+                {
+                    row.min[i] = std::min(row.min[i], float(values[i]));
+                    row.max[i] = std::max(row.max[i], float(values[i]));
+                    row.sum[i] += values[i];
+                }
+            }
+        }
+
+        std::vector<double> updates() const
+        {
+            std::vector<double> rows;
+            rows.reserve(m_Updates.size() * (1 + m_Parameters));
+            for (size_t i = 0; i < m_Updates.size(); i++)
+            {
+                const Row &update = m_Updates.at(i);
+                rows.push_back(update.start);
+                rows.insert(rows.end(), update.min.begin(), update.min.end());
+            }
+            return rows;
+        }
+
+        std::vector<double> aggregates(size_t level) const
+        {
+            const Ring &ring = m_Levels[level].rows;
+            std::vector<double> rows;
+            rows.reserve(ring.size() * (2 + 3 * m_Parameters));
+            for (size_t i = 0; i < ring.size(); i++)
+            {
+                const Row &row = ring.at(i);
+                rows.push_back(row.start);
+                rows.push_back(row.count);
+                for (size_t j = 0; j < m_Parameters; j++)
+                {
+                    rows.push_back(row.min[j]);
+                    rows.push_back(row.max[j]);
+                    rows.push_back(row.sum[j] / row.count);
+                }
+            }
+            return rows;
+        }
+
+    private:
+        // An update, in min, or the aggregates of a period
+        struct Row
+        {
+            double start {0};
+            uint32_t count {0};
+            std::vector<float> min, max;
+            std::vector<double> sum;
+        };
+
+        // Rows are reused once the ring is full
+        class Ring
+        {
+            public:
+                explicit Ring(size_t capacity) : m_Rows(capacity) {}
+
+                Row &push()
+                {
+                    size_t index = (m_First + m_Size) % m_Rows.size();
+                    if (m_Size < m_Rows.size())
+                        m_Size++;
+                    else
+                        m_First = (m_First + 1) % m_Rows.size();
+                    return m_Rows[index];
+                }
+
+                size_t size() const
+                {
+                    return m_Size;
+                }
+                bool empty() const
+                {
+                    return m_Size == 0;
+                }
+                const Row &at(size_t i) const
+                {
+                    return m_Rows[(m_First + i) % m_Rows.size()];
+                }
+                Row &back()
+                {
+                    return m_Rows[(m_First + m_Size - 1) % m_Rows.size()];
+                }
+                const Row &back() const
+                {
+                    return m_Rows[(m_First + m_Size - 1) % m_Rows.size()];
+                }
+
+            private:
+                std::vector<Row> m_Rows;
+                size_t m_First {0};
+                size_t m_Size {0};
+        };
+
+        struct Level
+        {
+            double period;
+            Ring rows;
+        };
+
+        size_t m_Parameters {0};
+        // A day of updates at the default period
+        Ring m_Updates {1440};
+        // Two hours of minutes, two days of hours, a month of days
+        Level m_Levels[3] { {60, Ring(120)}, {3600, Ring(48)}, {86400, Ring(31)} };
+};
+
+WeatherInterface::WeatherInterface(DefaultDevice *defaultDevice) : m_defaultDevice(defaultDevice),
+    m_History(new History())
 {
     m_UpdateTimer.callOnTimeout(std::bind(&WeatherInterface::checkWeatherUpdate, this));
     m_UpdateTimer.setSingleShot(true);
@@ -64,6 +215,17 @@ void WeatherInterface::initProperties(const char *statusGroup, const char *param
 
     // Weather Status
     critialParametersLP.fill(getDeviceName(), "WEATHER_STATUS", "Status", statusGroup, IPS_IDLE);
+
+    // History
+    HistorySP[0].fill("SEND", "Send", ISS_OFF);
+    HistorySP.fill(getDeviceName(), "WEATHER_HISTORY_REQUEST", "History", statusGroup, IP_RW, ISR_ATMOST1, 0,
+                   IPS_IDLE);
+
+    HistoryBP[HISTORY_UPDATES].fill("UPDATES", "Updates", "");
+    HistoryBP[HISTORY_MINUTES].fill("MINUTES", "Minutes", "");
+    HistoryBP[HISTORY_HOURS].fill("HOURS", "Hours", "");
+    HistoryBP[HISTORY_DAYS].fill("DAYS", "Days", "");
+    HistoryBP.fill(getDeviceName(), "WEATHER_HISTORY", "History", statusGroup, IP_RO, 60, IPS_IDLE);
 }
 
 bool WeatherInterface::updateProperties()
@@ -83,6 +245,12 @@ bool WeatherInterface::updateProperties()
         for (auto &oneProperty : ParametersRangeNP)
             m_defaultDevice->defineProperty(oneProperty);
 
+        if (ParametersNP.count() > 0)
+        {
+            m_defaultDevice->defineProperty(HistorySP);
+            m_defaultDevice->defineProperty(HistoryBP);
+        }
+
         checkWeatherUpdate();
     }
     else
@@ -95,7 +263,11 @@ bool WeatherInterface::updateProperties()
             m_defaultDevice->deleteProperty(critialParametersLP);
 
         if (ParametersNP.count() > 0)
+        {
             m_defaultDevice->deleteProperty(ParametersNP);
+            m_defaultDevice->deleteProperty(HistorySP);
+            m_defaultDevice->deleteProperty(HistoryBP);
+        }
 
         if (ParametersRangeNP.size() > 0)
         {
@@ -131,6 +303,14 @@ void WeatherInterface::checkWeatherUpdate()
             ParametersNP.setState(state);
             ParametersNP.apply();
 
+            if (ParametersNP.count() > 0)
+            {
+                std::vector<double> values;
+                for (auto &oneParameter : ParametersNP)
+                    values.push_back(oneParameter.getValue());
+                m_History->add(time(nullptr), values);
+            }
+
             // If update period is set, then set up the timer
             if (UpdatePeriodNP[0].getValue() > 0)
                 m_UpdateTimer.start(UpdatePeriodNP[0].getValue() * 1000);
@@ -167,6 +347,17 @@ bool WeatherInterface::processSwitch(const char *dev, const char *name, ISState
         return true;
     }
 
+    // History
+    if (HistorySP.isNameMatch(name))
+    {
+        HistorySP[0].setState(ISS_OFF);
+        HistorySP.setState(IPS_OK);
+        HistorySP.apply();
+
+        sendHistory();
+        return true;
+    }
+
     // Override
     if (OverrideSP.isNameMatch(name))
     {
@@ -399,6 +590,23 @@ void WeatherInterface::createParameterRange(std::string name, std::string label,
     ParametersRangeNP.push_back(std::move(oneRange));
 }
 
+////////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////////
+void WeatherInterface::sendHistory()
+{
+    std::vector<double> rows = m_History->updates();
+    HistoryBP.setArray(HISTORY_UPDATES, rows.data(), rows.size());
+    for (size_t level = 0; level < 3; level++)
+    {
+        rows = m_History->aggregates(level);
+        HistoryBP.setArray(HISTORY_MINUTES + level, rows.data(), rows.size());
+    }
+
+    HistoryBP.setState(IPS_OK);
+    HistoryBP.apply();
+}
+
 ////////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////////
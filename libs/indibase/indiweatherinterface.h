@@ -24,8 +24,10 @@
 #include "indipropertynumber.h"
 #include "indipropertyswitch.h"
 #include "indipropertylight.h"
+#include "indipropertyblob.h"
 #include "inditimer.h"
 
+#include <memory>
 #include <stdint.h>
 #include <string>
 #include <vector>
@@ -178,11 +180,29 @@ class WeatherInterface
         // Override
         INDI::PropertySwitch OverrideSP {1};
 
+        // History, sent on request
+        INDI::PropertySwitch HistorySP {1};
+        // Numeric arrays of rows: time, then the values of the parameters in the order of ParametersNP.
+        // The rows of the aggregates are the start of the period, the number of updates, then the min, max and
+        // mean of each parameter.
+        INDI::PropertyBlob HistoryBP {4};
+        enum
+        {
+            HISTORY_UPDATES,
+            HISTORY_MINUTES,
+            HISTORY_HOURS,
+            HISTORY_DAYS
+        };
+
 
     private:
         void createParameterRange(std::string name, std::string label, double numMinOk, double numMaxOk, double percWarning);
+        void sendHistory();
         DefaultDevice *m_defaultDevice { nullptr };
         std::string m_ParametersGroup;
         INDI::Timer m_UpdateTimer;
+
+        class History;
+        std::unique_ptr<History> m_History;
 };
 }
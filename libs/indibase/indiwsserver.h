@@ -18,7 +18,11 @@
 
 #pragma once
 
-#include <set>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 #include <websocketpp/extensions/permessage_deflate/enabled.hpp>
@@ -43,9 +47,19 @@ using websocketpp::lib::placeholders::_1;
 using websocketpp::lib::placeholders::_2;
 using websocketpp::lib::bind;
 
+/**
+ * @brief The INDIWSServer class serves the BLOBs of a device to websocket clients.
+ *
+ * The io_service runs on the thread calling run(). Messages are queued for each connection and written from
+ * that thread, so a slow client delays none but itself. While the queue of a connection is full, the newer
+ * messages are dropped for it.
+ */
 class INDIWSServer
 {
     public:
+        /** Messages queued for a connection beyond the one being written */
+        static constexpr size_t MAX_QUEUED = 4;
+
         INDIWSServer()  {}
 
         uint16_t generatePort()
@@ -57,7 +71,7 @@ class INDIWSServer
 
         void on_open(connection_hdl hdl)
         {
-            m_connections.insert(hdl);
+            m_connections[hdl];
         }
 
         void on_close(connection_hdl hdl)
@@ -73,53 +87,45 @@ class INDIWSServer
         //        }
         //    }
 
-        void send_binary(void const * payload, size_t len)
+        /**
+         * @brief Sends a frame and its metadata in one binary message: the metadata, a NUL, then the payload.
+         * @param metadata is the format of the frame, e.g. ".fits" or ".stream_jpg".
+         */
+        void send_frame(const std::string &metadata, void const * payload, size_t len)
         {
-            for (auto it : m_connections)
-            {
-                try
-                {
-                    m_server->send(it, payload, len, websocketpp::frame::opcode::binary);
-                }
-                catch (websocketpp::exception const &e)
-                {
-                    std::cerr << e.what() << std::endl;
-                }
-                catch (...)
-                {
-                    std::cerr << "other exception" << std::endl;
-                }
+            auto message = std::make_shared<std::string>();
+            message->reserve(metadata.size() + 1 + len);
+            message->append(metadata);
+            message->push_back('\0');
+            message->append(static_cast<const char *>(payload), len);
+            queue(message, websocketpp::frame::opcode::binary);
+        }
 
-            }
+        void send_binary(void const * payload, size_t len)
+        {
+            queue(std::make_shared<std::string>(static_cast<const char *>(payload), len), websocketpp::frame::opcode::binary);
         }
 
         void send_text(const std::string &payload)
         {
-            for (auto it : m_connections)
-            {
-                try
-                {
-                    m_server->send(it, payload, websocketpp::frame::opcode::text);
-                }
-                catch (websocketpp::exception const &e)
-                {
-                    std::cerr << e.what() << std::endl;
-                }
-                catch (...)
-                {
-                    std::cerr << "other exception" << std::endl;
-                }
-
-            }
+            queue(std::make_shared<std::string>(payload), websocketpp::frame::opcode::text);
         }
 
         void stop()
         {
-            for (auto it : m_connections)
-                m_server->close(it, websocketpp::close::status::normal, "Switched off by user.");
+            m_running = false;
+            m_server->get_io_service().post([this]()
+            {
+                for (auto &it : m_connections)
+                {
+                    websocketpp::lib::error_code ec;
+                    m_server->close(it.first, websocketpp::close::status::normal, "Switched off by user.", ec);
+                }
 
-            m_connections.clear();
-            m_server->stop();
+                m_connections.clear();
+                m_flushTimer.reset();
+                m_server->stop();
+            });
         }
 
         bool is_running()
@@ -143,6 +149,7 @@ class INDIWSServer
 
                 m_server->listen(m_port);
                 m_server->start_accept();
+                m_running = true;
                 m_server->run();
 
             }
@@ -154,15 +161,77 @@ class INDIWSServer
             {
                 std::cerr << "other exception" << std::endl;
             }
+            m_running = false;
 
         }
 
     private:
-        typedef std::set<connection_hdl, std::owner_less<connection_hdl>> con_list;
+        struct outgoing
+        {
+            std::shared_ptr<const std::string> payload;
+            websocketpp::frame::opcode::value opcode;
+        };
+
+        typedef std::map<connection_hdl, std::deque<outgoing>, std::owner_less<connection_hdl>> con_list;
+
+        // Hands the message to the io_service thread, the caller only pays for the copy of the payload
+        void queue(std::shared_ptr<const std::string> payload, websocketpp::frame::opcode::value opcode)
+        {
+            if (!m_running)
+                return;
+
+            m_server->get_io_service().post([this, payload, opcode]()
+            {
+                for (auto &it : m_connections)
+                {
+                    if (it.second.size() < MAX_QUEUED)
+                        it.second.push_back({payload, opcode});
+                }
+                flush();
+            });
+        }
+
+        // Writes the next message of each connection done writing, and polls again while some are not
+        void flush()
+        {
+            bool waiting = false;
+
+            for (auto &it : m_connections)
+            {
+                websocketpp::lib::error_code ec;
+                server::connection_ptr con = m_server->get_con_from_hdl(it.first, ec);
+                if (ec)
+                {
+                    it.second.clear();
+                    continue;
+                }
+
+                auto &pending = it.second;
+                while (!pending.empty() && con->get_buffered_amount() == 0)
+                {
+                    ec = con->send(*pending.front().payload, pending.front().opcode);
+                    pending.pop_front();
+                    if (ec)
+                        std::cerr << ec.message() << std::endl;
+                }
+                waiting = waiting || !pending.empty();
+            }
+
+            if (waiting && !m_flushTimer)
+            {
+                m_flushTimer = m_server->set_timer(10, [this](websocketpp::lib::error_code const & ec)
+                {
+                    m_flushTimer.reset();
+                    if (!ec)
+                        flush();
+                });
+            }
+        }
 
         std::unique_ptr<server> m_server;
         con_list m_connections;
+        server::timer_ptr m_flushTimer;
+        std::atomic<bool> m_running {false};
         uint16_t m_port;
         static uint16_t m_global_port;
 };
-
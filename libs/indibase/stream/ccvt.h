@@ -105,6 +105,29 @@ void ccvt_yuyv_rgb24(int width, int height, const void *src, void *dst);
 /** 4:2:2 YUYV interlaced to 4:2:0 YUV planar */
 void ccvt_yuyv_420p(int width, int height, const void *src, void *dsty, void *dstu, void *dstv);
 
+/** 4:2:0 NV12 (planar Y, interleaved UV) with rows of stride bytes to 4:2:0 YUV planar */
+void ccvt_nv12_420p(int width, int height, int stride, const void *src, void *dsty, void *dstu, void *dstv);
+
+/* The functions above use the SSE2/AVX2 or NEON kernels of ccvt_simd.cpp, and split large frames
+   over threads. These are the plain C versions they reproduce, byte for byte. */
+
+/** 4:2:0 YUV planar to RGB/BGR, plain C */
+void ccvt_420p_bgr24_c(int width, int height, const void *src, void *dst);
+/** 4:2:0 YUV planar to RGB/BGR, plain C */
+void ccvt_420p_rgb24_c(int width, int height, const void *src, void *dst);
+/** 4:2:0 YUV planar to RGB/BGR, plain C */
+void ccvt_420p_bgr32_c(int width, int height, const void *src, void *dst);
+/** 4:2:0 YUV planar to RGB/BGR, plain C */
+void ccvt_420p_rgb32_c(int width, int height, const void *src, void *dst);
+/** 4:2:2 YUYV interlaced to RGB/BGR, plain C */
+void ccvt_yuyv_bgr32_c(int width, int height, const void *src, void *dst);
+/** 4:2:2 YUYV interlaced to BGR24, plain C */
+void ccvt_yuyv_bgr24_c(int width, int height, const void *src, void *dst);
+/** 4:2:2 YUYV interlaced to RGB24, plain C */
+void ccvt_yuyv_rgb24_c(int width, int height, const void *src, void *dst);
+/** 4:2:2 YUYV interlaced to 4:2:0 YUV planar, plain C */
+void ccvt_yuyv_420p_c(int width, int height, const void *src, void *dsty, void *dstu, void *dstv);
+
 /* RGB/BGR to 4:2:0 YUV interlaced */
 
 /** RGB/BGR to 4:2:0 YUV planar     */
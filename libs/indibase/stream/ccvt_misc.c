@@ -78,7 +78,7 @@ void ccvt_yuyv_rgb32(int width, int height, const void *src, void *dst)
 }
 #endif
 
-void ccvt_yuyv_bgr32(int width, int height, const void *src, void *dst)
+void ccvt_yuyv_bgr32_c(int width, int height, const void *src, void *dst)
 {
     const unsigned char *s;
     PIXTYPE_bgr32 *d;
@@ -124,7 +124,7 @@ void ccvt_yuyv_bgr32(int width, int height, const void *src, void *dst)
     }
 }
 
-void ccvt_yuyv_bgr24(int width, int height, const void *src, void *dst)
+void ccvt_yuyv_bgr24_c(int width, int height, const void *src, void *dst)
 {
     const unsigned char *s;
     PIXTYPE_bgr24 *d;
@@ -170,7 +170,7 @@ void ccvt_yuyv_bgr24(int width, int height, const void *src, void *dst)
     }
 }
 
-void ccvt_yuyv_rgb24(int width, int height, const void *src, void *dst)
+void ccvt_yuyv_rgb24_c(int width, int height, const void *src, void *dst)
 {
     const unsigned char *s;
     PIXTYPE_rgb24 *d;
@@ -216,7 +216,7 @@ void ccvt_yuyv_rgb24(int width, int height, const void *src, void *dst)
     }
 }
 
-void ccvt_yuyv_420p(int width, int height, const void *src, void *dsty, void *dstu, void *dstv)
+void ccvt_yuyv_420p_c(int width, int height, const void *src, void *dsty, void *dstu, void *dstv)
 {
     int n, l, j;
     const unsigned char *s1, *s2;
@@ -0,0 +1,840 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+    Vector kernels of the ccvt conversions run on every frame of the webcams: SSE2 on x86, with AVX2
+    picked at run time, and NEON on ARM. They compute exactly what the plain C versions of ccvt_c2.c
+    and ccvt_misc.c compute, on 16 bit lanes, and large frames are split in rows over the global pool.
+    RGB24 and BGR24 to 4:2:0 planar have no plain C version, their scalar rows here are the reference.
+*/
+
+#include "ccvt.h"
+#include "indithreadpool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CCVT_SSSE3
+#define CCVT_AVX2
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+// Frames of fewer pixels are converted on the calling thread only
+constexpr size_t PARALLEL_PIXELS = 1 << 18;
+
+enum Layout
+{
+    RGB24,
+    BGR24,
+    RGB32,
+    BGR32
+};
+
+constexpr int pixelBytes(Layout layout)
+{
+    return (layout == RGB24 || layout == BGR24) ? 3 : 4;
+}
+
+constexpr bool redFirst(Layout layout)
+{
+    return layout == RGB24 || layout == RGB32;
+}
+
+inline uint8_t saturate(int c)
+{
+    return static_cast<uint8_t>(c < 0 ? 0 : (c > 255 ? 255 : c));
+}
+
+// Two pixels sharing their chroma, with the fixed point coefficients of ccvt
+template <Layout L>
+inline void scalarPair(int y1, int y2, int u, int v, uint8_t *dst)
+{
+    int const cb = ((u - 128) * 454) >> 8;
+    int const cr = ((v - 128) * 359) >> 8;
+    int const cg = ((v - 128) * 183 + (u - 128) * 88) >> 8;
+
+    for (int y : {y1, y2})
+    {
+        dst[0] = saturate(redFirst(L) ? y + cr : y + cb);
+        dst[1] = saturate(y - cg);
+        dst[2] = saturate(redFirst(L) ? y + cb : y + cr);
+        if (pixelBytes(L) == 4)
+            dst[3] = 0;
+        dst += pixelBytes(L);
+    }
+}
+
+template <Layout L>
+void rowI420Scalar(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int x, int width)
+{
+    for (; x < width; x += 2)
+        scalarPair<L>(y[x], y[x + 1], u[x / 2], v[x / 2], dst + x * pixelBytes(L));
+}
+
+template <Layout L>
+void rowYuyvScalar(const uint8_t *s, uint8_t *dst, int x, int width)
+{
+    for (; x < width; x += 2)
+        scalarPair<L>(s[2 * x], s[2 * x + 2], s[2 * x + 1], s[2 * x + 3], dst + x * pixelBytes(L));
+}
+
+void rowLumaScalar(const uint8_t *s, uint8_t *dy, int x, int width)
+{
+    for (; x < width; x++)
+        dy[x] = s[2 * x];
+}
+
+void rowChromaScalar(const uint8_t *s1, const uint8_t *s2, uint8_t *du, uint8_t *dv, int x, int width)
+{
+    for (; x < width; x += 2)
+    {
+        du[x / 2] = (s1[2 * x + 1] + s2[2 * x + 1]) / 2;
+        dv[x / 2] = (s1[2 * x + 3] + s2[2 * x + 3]) / 2;
+    }
+}
+
+void rowSplitScalar(const uint8_t *s, uint8_t *du, uint8_t *dv, int x, int pairs)
+{
+    for (; x < pairs; x++)
+    {
+        du[x] = s[2 * x];
+        dv[x] = s[2 * x + 1];
+    }
+}
+
+// Full range BT.601, as RGB2YUV of ccvt_misc.c, with 8 bit fixed point coefficients
+inline uint8_t rgbLuma(int r, int g, int b)
+{
+    return static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+// The chroma of the rounded mean of a 2x2 block
+inline void rgbChroma(int r, int g, int b, uint8_t &u, uint8_t &v)
+{
+    u = static_cast<uint8_t>(((-43 * r - 85 * g + 128 * b) >> 8) + 128);
+    v = static_cast<uint8_t>(((128 * r - 107 * g - 21 * b) >> 8) + 128);
+}
+
+// Two rows of RGB24 or BGR24 to their two luma rows and their chroma row
+template <Layout L>
+void rowRgb420Scalar(const uint8_t *s1, const uint8_t *s2, uint8_t *y1, uint8_t *y2, uint8_t *du, uint8_t *dv,
+                     int x, int width)
+{
+    int const ri = redFirst(L) ? 0 : 2, bi = 2 - ri;
+    for (; x < width; x += 2)
+    {
+        const uint8_t *a = s1 + 3 * x, *b = s2 + 3 * x;
+        y1[x]     = rgbLuma(a[ri], a[1], a[bi]);
+        y1[x + 1] = rgbLuma(a[3 + ri], a[4], a[3 + bi]);
+        y2[x]     = rgbLuma(b[ri], b[1], b[bi]);
+        y2[x + 1] = rgbLuma(b[3 + ri], b[4], b[3 + bi]);
+        rgbChroma((a[ri] + a[3 + ri] + b[ri] + b[3 + ri] + 2) >> 2, (a[1] + a[4] + b[1] + b[4] + 2) >> 2,
+                  (a[bi] + a[3 + bi] + b[bi] + b[3 + bi] + 2) >> 2, du[x / 2], dv[x / 2]);
+    }
+}
+
+#if defined(__SSE2__)
+
+// 16 pixels from their luma and the zero extended 16 bit chroma of their 8 pairs
+inline void yuvToRgb(__m128i y, __m128i u, __m128i v, __m128i &r, __m128i &g, __m128i &b)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const du = _mm_sub_epi16(u, _mm_set1_epi16(128));
+    __m128i const dv = _mm_sub_epi16(v, _mm_set1_epi16(128));
+
+    // (d * k) >> 8 is the high half of (d << 8) * k, which fits in 16 bits for d in [-128, 127]
+    __m128i const cb = _mm_mulhi_epi16(_mm_slli_epi16(du, 8), _mm_set1_epi16(454));
+    __m128i const cr = _mm_mulhi_epi16(_mm_slli_epi16(dv, 8), _mm_set1_epi16(359));
+
+    // The green term is summed on 32 bits before the shift
+    __m128i const k = _mm_set1_epi32((88 << 16) | 183);
+    __m128i const cgLo = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(dv, du), k), 8);
+    __m128i const cgHi = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(dv, du), k), 8);
+    __m128i const cg = _mm_packs_epi32(cgLo, cgHi);
+
+    __m128i const yLo = _mm_unpacklo_epi8(y, zero), yHi = _mm_unpackhi_epi8(y, zero);
+    r = _mm_packus_epi16(_mm_add_epi16(yLo, _mm_unpacklo_epi16(cr, cr)), _mm_add_epi16(yHi, _mm_unpackhi_epi16(cr, cr)));
+    g = _mm_packus_epi16(_mm_sub_epi16(yLo, _mm_unpacklo_epi16(cg, cg)), _mm_sub_epi16(yHi, _mm_unpackhi_epi16(cg, cg)));
+    b = _mm_packus_epi16(_mm_add_epi16(yLo, _mm_unpacklo_epi16(cb, cb)), _mm_add_epi16(yHi, _mm_unpackhi_epi16(cb, cb)));
+}
+
+// Drops the filler byte of 4 pixels of 32 bits, leaving 12 bytes
+inline __m128i pack24(__m128i p)
+{
+    __m128i const low = _mm_set_epi32(0, 0x00FFFFFF, 0, 0x00FFFFFF);
+    __m128i const high = _mm_set_epi32(0x00FFFFFF, 0, 0x00FFFFFF, 0);
+    __m128i const lowLane = _mm_set_epi32(0, 0, -1, -1);
+    __m128i const x = _mm_or_si128(_mm_and_si128(p, low), _mm_srli_epi64(_mm_and_si128(p, high), 8));
+    return _mm_or_si128(_mm_and_si128(x, lowLane), _mm_srli_si128(_mm_andnot_si128(lowLane, x), 2));
+}
+
+template <Layout L>
+inline void store(uint8_t *dst, __m128i r, __m128i g, __m128i b)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const first = redFirst(L) ? r : b, last = redFirst(L) ? b : r;
+    __m128i const fgLo = _mm_unpacklo_epi8(first, g), fgHi = _mm_unpackhi_epi8(first, g);
+    __m128i const lLo = _mm_unpacklo_epi8(last, zero), lHi = _mm_unpackhi_epi8(last, zero);
+    __m128i p0 = _mm_unpacklo_epi16(fgLo, lLo), p1 = _mm_unpackhi_epi16(fgLo, lLo);
+    __m128i p2 = _mm_unpacklo_epi16(fgHi, lHi), p3 = _mm_unpackhi_epi16(fgHi, lHi);
+
+    if (pixelBytes(L) == 4)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), p0);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), p1);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), p2);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 48), p3);
+        return;
+    }
+
+    p0 = pack24(p0);
+    p1 = pack24(p1);
+    p2 = pack24(p2);
+    p3 = pack24(p3);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 16), _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 32), _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+}
+
+inline __m128i load(const uint8_t *s)
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+}
+
+template <Layout L>
+void rowI420(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    __m128i const zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i r, g, b;
+        yuvToRgb(load(y + x),
+                 _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(u + x / 2)), zero),
+                 _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(v + x / 2)), zero), r, g, b);
+        store<L>(dst + x * pixelBytes(L), r, g, b);
+    }
+    rowI420Scalar<L>(y, u, v, dst, x, width);
+}
+
+template <Layout L>
+void rowYuyv(const uint8_t *s, uint8_t *dst, int width)
+{
+    __m128i const lowBytes = _mm_set1_epi16(0x00FF);
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i const a = load(s + 2 * x), b = load(s + 2 * x + 16);
+        __m128i const y = _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes));
+        // U and V of the 8 pairs, alternating
+        __m128i const c = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+        __m128i cr, cg, cb;
+        yuvToRgb(y, _mm_and_si128(c, lowBytes), _mm_srli_epi16(c, 8), cr, cg, cb);
+        store<L>(dst + x * pixelBytes(L), cr, cg, cb);
+    }
+    rowYuyvScalar<L>(s, dst, x, width);
+}
+
+void rowLuma(const uint8_t *s, uint8_t *dy, int width)
+{
+    __m128i const lowBytes = _mm_set1_epi16(0x00FF);
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dy + x),
+                         _mm_packus_epi16(_mm_and_si128(load(s + 2 * x), lowBytes), _mm_and_si128(load(s + 2 * x + 16), lowBytes)));
+    rowLumaScalar(s, dy, x, width);
+}
+
+void rowChroma(const uint8_t *s1, const uint8_t *s2, uint8_t *du, uint8_t *dv, int width)
+{
+    __m128i const lowBytes = _mm_set1_epi16(0x00FF);
+    __m128i const zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        // Truncated mean of the two rows, as (a + b) / 2
+        __m128i const a = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(load(s1 + 2 * x), 8), _mm_srli_epi16(load(s2 + 2 * x), 8)), 1);
+        __m128i const b = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(load(s1 + 2 * x + 16), 8),
+                                         _mm_srli_epi16(load(s2 + 2 * x + 16), 8)), 1);
+        __m128i const c = _mm_packus_epi16(a, b);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(du + x / 2), _mm_packus_epi16(_mm_and_si128(c, lowBytes), zero));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dv + x / 2), _mm_packus_epi16(_mm_srli_epi16(c, 8), zero));
+    }
+    rowChromaScalar(s1, s2, du, dv, x, width);
+}
+
+void rowSplit(const uint8_t *s, uint8_t *du, uint8_t *dv, int pairs)
+{
+    __m128i const lowBytes = _mm_set1_epi16(0x00FF);
+    int x = 0;
+    for (; x + 16 <= pairs; x += 16)
+    {
+        __m128i const a = load(s + 2 * x), b = load(s + 2 * x + 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(du + x), _mm_packus_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dv + x), _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+    rowSplitScalar(s, du, dv, x, pairs);
+}
+
+#ifdef CCVT_SSSE3
+
+// The shuffle taking channel c of 16 packed pixels from the k-th 16 bytes of them
+__m128i channelMask(int k, int c)
+{
+    alignas(16) int8_t mask[16];
+    for (int p = 0; p < 16; p++)
+    {
+        int const index = 3 * p + c;
+        mask[p] = (index / 16 == k) ? static_cast<int8_t>(index % 16) : static_cast<int8_t>(0x80);
+    }
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(mask));
+}
+
+struct ChannelMasks
+{
+    __m128i mask[3][3];
+    ChannelMasks()
+    {
+        for (int c = 0; c < 3; c++)
+            for (int k = 0; k < 3; k++)
+                mask[c][k] = channelMask(k, c);
+    }
+};
+
+// Channel c of 16 packed pixels
+__attribute__((target("ssse3")))
+inline __m128i channel(const uint8_t *s, const ChannelMasks &masks, int c)
+{
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(load(s), masks.mask[c][0]),
+                                     _mm_shuffle_epi8(load(s + 16), masks.mask[c][1])),
+                        _mm_shuffle_epi8(load(s + 32), masks.mask[c][2]));
+}
+
+// Luma of 8 pixels of 16 bits, the weighted sum stays below 65536
+inline __m128i luma16(__m128i r, __m128i g, __m128i b)
+{
+    __m128i const sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(77)), _mm_mullo_epi16(g, _mm_set1_epi16(150))),
+                                      _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(29)), _mm_set1_epi16(128)));
+    return _mm_srli_epi16(sum, 8);
+}
+
+inline __m128i luma(__m128i r, __m128i g, __m128i b)
+{
+    __m128i const zero = _mm_setzero_si128();
+    return _mm_packus_epi16(luma16(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero)),
+                            luma16(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero)));
+}
+
+// Rounded means of the 8 2x2 blocks of 16 pixels of two rows
+inline __m128i blockMean(__m128i a, __m128i b)
+{
+    __m128i const zero = _mm_setzero_si128(), ones = _mm_set1_epi16(1);
+    __m128i const lo = _mm_madd_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)), ones);
+    __m128i const hi = _mm_madd_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)), ones);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(lo, hi), _mm_set1_epi16(2)), 2);
+}
+
+// One chroma of 8 blocks, the products of 8 bit means by the coefficients fit in 16 bits
+inline __m128i chroma(__m128i r, __m128i g, __m128i b, int kr, int kg, int kb)
+{
+    __m128i const sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(kr)), _mm_mullo_epi16(g, _mm_set1_epi16(kg))),
+                                      _mm_mullo_epi16(b, _mm_set1_epi16(kb)));
+    __m128i const c = _mm_add_epi16(_mm_srai_epi16(sum, 8), _mm_set1_epi16(128));
+    return _mm_packus_epi16(c, _mm_setzero_si128());
+}
+
+template <Layout L>
+__attribute__((target("ssse3")))
+void rowRgb420Ssse3(const uint8_t *s1, const uint8_t *s2, uint8_t *y1, uint8_t *y2, uint8_t *du, uint8_t *dv, int width)
+{
+    static const ChannelMasks masks;
+    int const ri = redFirst(L) ? 0 : 2, bi = 2 - ri;
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m128i const r1 = channel(s1 + 3 * x, masks, ri), g1 = channel(s1 + 3 * x, masks, 1), b1 = channel(s1 + 3 * x, masks, bi);
+        __m128i const r2 = channel(s2 + 3 * x, masks, ri), g2 = channel(s2 + 3 * x, masks, 1), b2 = channel(s2 + 3 * x, masks, bi);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(y1 + x), luma(r1, g1, b1));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(y2 + x), luma(r2, g2, b2));
+
+        __m128i const r = blockMean(r1, r2), g = blockMean(g1, g2), b = blockMean(b1, b2);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(du + x / 2), chroma(r, g, b, -43, -85, 128));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dv + x / 2), chroma(r, g, b, 128, -107, -21));
+    }
+    rowRgb420Scalar<L>(s1, s2, y1, y2, du, dv, x, width);
+}
+
+bool hasSsse3()
+{
+    static bool const ssse3 = __builtin_cpu_supports("ssse3");
+    return ssse3;
+}
+
+#endif
+
+#ifdef CCVT_AVX2
+
+// 32 pixels, as yuvToRgb; the 128 bit lane order of unpack and pack keeps the pixels in order
+__attribute__((target("avx2")))
+inline void yuvToRgbAvx2(__m256i y, __m256i u, __m256i v, __m256i &r, __m256i &g, __m256i &b)
+{
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const du = _mm256_sub_epi16(u, _mm256_set1_epi16(128));
+    __m256i const dv = _mm256_sub_epi16(v, _mm256_set1_epi16(128));
+
+    __m256i const cb = _mm256_mulhi_epi16(_mm256_slli_epi16(du, 8), _mm256_set1_epi16(454));
+    __m256i const cr = _mm256_mulhi_epi16(_mm256_slli_epi16(dv, 8), _mm256_set1_epi16(359));
+
+    __m256i const k = _mm256_set1_epi32((88 << 16) | 183);
+    __m256i const cgLo = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(dv, du), k), 8);
+    __m256i const cgHi = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(dv, du), k), 8);
+    __m256i const cg = _mm256_packs_epi32(cgLo, cgHi);
+
+    __m256i const yLo = _mm256_unpacklo_epi8(y, zero), yHi = _mm256_unpackhi_epi8(y, zero);
+    r = _mm256_packus_epi16(_mm256_add_epi16(yLo, _mm256_unpacklo_epi16(cr, cr)), _mm256_add_epi16(yHi, _mm256_unpackhi_epi16(cr, cr)));
+    g = _mm256_packus_epi16(_mm256_sub_epi16(yLo, _mm256_unpacklo_epi16(cg, cg)), _mm256_sub_epi16(yHi, _mm256_unpackhi_epi16(cg, cg)));
+    b = _mm256_packus_epi16(_mm256_add_epi16(yLo, _mm256_unpacklo_epi16(cb, cb)), _mm256_add_epi16(yHi, _mm256_unpackhi_epi16(cb, cb)));
+}
+
+template <Layout L>
+__attribute__((target("avx2")))
+void storeAvx2(uint8_t *dst, __m256i r, __m256i g, __m256i b)
+{
+    store<L>(dst, _mm256_castsi256_si128(r), _mm256_castsi256_si128(g), _mm256_castsi256_si128(b));
+    store<L>(dst + 16 * pixelBytes(L), _mm256_extracti128_si256(r, 1), _mm256_extracti128_si256(g, 1), _mm256_extracti128_si256(b, 1));
+}
+
+template <Layout L>
+__attribute__((target("avx2")))
+void rowI420Avx2(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+        __m256i r, g, b;
+        yuvToRgbAvx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(y + x)),
+                     _mm256_cvtepu8_epi16(load(u + x / 2)), _mm256_cvtepu8_epi16(load(v + x / 2)), r, g, b);
+        storeAvx2<L>(dst + x * pixelBytes(L), r, g, b);
+    }
+    rowI420Scalar<L>(y, u, v, dst, x, width);
+}
+
+template <Layout L>
+__attribute__((target("avx2")))
+void rowYuyvAvx2(const uint8_t *s, uint8_t *dst, int width)
+{
+    __m256i const lowBytes = _mm256_set1_epi16(0x00FF);
+    int x = 0;
+    for (; x + 32 <= width; x += 32)
+    {
+        __m256i const a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 2 * x));
+        __m256i const b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 2 * x + 32));
+        // Packing works within 128 bit lanes, the quarters are put back in order
+        __m256i const y = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(a, lowBytes), _mm256_and_si256(b, lowBytes)), 0xD8);
+        __m256i const c = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(a, 8), _mm256_srli_epi16(b, 8)), 0xD8);
+        __m256i cr, cg, cb;
+        yuvToRgbAvx2(y, _mm256_and_si256(c, lowBytes), _mm256_srli_epi16(c, 8), cr, cg, cb);
+        storeAvx2<L>(dst + x * pixelBytes(L), cr, cg, cb);
+    }
+    rowYuyvScalar<L>(s, dst, x, width);
+}
+
+bool hasAvx2()
+{
+    static bool const avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+#elif defined(__ARM_NEON)
+
+// 16 pixels from their luma and the chroma of their 8 pairs
+inline void yuvToRgb(uint8x16_t y, uint8x8_t u, uint8x8_t v, uint8x16_t &r, uint8x16_t &g, uint8x16_t &b)
+{
+    int16x8_t const du = vreinterpretq_s16_u16(vsubl_u8(u, vdup_n_u8(128)));
+    int16x8_t const dv = vreinterpretq_s16_u16(vsubl_u8(v, vdup_n_u8(128)));
+
+    int16x8_t const cb = vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(du), 454), 8),
+                                      vshrn_n_s32(vmull_n_s16(vget_high_s16(du), 454), 8));
+    int16x8_t const cr = vcombine_s16(vshrn_n_s32(vmull_n_s16(vget_low_s16(dv), 359), 8),
+                                      vshrn_n_s32(vmull_n_s16(vget_high_s16(dv), 359), 8));
+    int16x8_t const cg = vcombine_s16(vshrn_n_s32(vmlal_n_s16(vmull_n_s16(vget_low_s16(dv), 183), vget_low_s16(du), 88), 8),
+                                      vshrn_n_s32(vmlal_n_s16(vmull_n_s16(vget_high_s16(dv), 183), vget_high_s16(du), 88), 8));
+
+    int16x8x2_t const cbs = vzipq_s16(cb, cb), crs = vzipq_s16(cr, cr), cgs = vzipq_s16(cg, cg);
+    int16x8_t const yLo = vreinterpretq_s16_u16(vmovl_u8(vget_low_u8(y)));
+    int16x8_t const yHi = vreinterpretq_s16_u16(vmovl_u8(vget_high_u8(y)));
+
+    r = vcombine_u8(vqmovun_s16(vaddq_s16(yLo, crs.val[0])), vqmovun_s16(vaddq_s16(yHi, crs.val[1])));
+    g = vcombine_u8(vqmovun_s16(vsubq_s16(yLo, cgs.val[0])), vqmovun_s16(vsubq_s16(yHi, cgs.val[1])));
+    b = vcombine_u8(vqmovun_s16(vaddq_s16(yLo, cbs.val[0])), vqmovun_s16(vaddq_s16(yHi, cbs.val[1])));
+}
+
+template <Layout L>
+inline void store(uint8_t *dst, uint8x16_t r, uint8x16_t g, uint8x16_t b)
+{
+    uint8x16_t const first = redFirst(L) ? r : b, last = redFirst(L) ? b : r;
+    if (pixelBytes(L) == 4)
+    {
+        uint8x16x4_t const pixels = {{ first, g, last, vdupq_n_u8(0) }};
+        vst4q_u8(dst, pixels);
+    }
+    else
+    {
+        uint8x16x3_t const pixels = {{ first, g, last }};
+        vst3q_u8(dst, pixels);
+    }
+}
+
+template <Layout L>
+void rowI420(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16_t r, g, b;
+        yuvToRgb(vld1q_u8(y + x), vld1_u8(u + x / 2), vld1_u8(v + x / 2), r, g, b);
+        store<L>(dst + x * pixelBytes(L), r, g, b);
+    }
+    rowI420Scalar<L>(y, u, v, dst, x, width);
+}
+
+template <Layout L>
+void rowYuyv(const uint8_t *s, uint8_t *dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        // Luma, and U and V of the 8 pairs alternating
+        uint8x16x2_t const yc = vld2q_u8(s + 2 * x);
+        uint8x8x2_t const uv = vuzp_u8(vget_low_u8(yc.val[1]), vget_high_u8(yc.val[1]));
+        uint8x16_t r, g, b;
+        yuvToRgb(yc.val[0], uv.val[0], uv.val[1], r, g, b);
+        store<L>(dst + x * pixelBytes(L), r, g, b);
+    }
+    rowYuyvScalar<L>(s, dst, x, width);
+}
+
+void rowLuma(const uint8_t *s, uint8_t *dy, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+        vst1q_u8(dy + x, vld2q_u8(s + 2 * x).val[0]);
+    rowLumaScalar(s, dy, x, width);
+}
+
+void rowChroma(const uint8_t *s1, const uint8_t *s2, uint8_t *du, uint8_t *dv, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        // Halving add truncates, as (a + b) / 2
+        uint8x16_t const c = vhaddq_u8(vld2q_u8(s1 + 2 * x).val[1], vld2q_u8(s2 + 2 * x).val[1]);
+        uint8x8x2_t const uv = vuzp_u8(vget_low_u8(c), vget_high_u8(c));
+        vst1_u8(du + x / 2, uv.val[0]);
+        vst1_u8(dv + x / 2, uv.val[1]);
+    }
+    rowChromaScalar(s1, s2, du, dv, x, width);
+}
+
+void rowSplit(const uint8_t *s, uint8_t *du, uint8_t *dv, int pairs)
+{
+    int x = 0;
+    for (; x + 16 <= pairs; x += 16)
+    {
+        uint8x16x2_t const uv = vld2q_u8(s + 2 * x);
+        vst1q_u8(du + x, uv.val[0]);
+        vst1q_u8(dv + x, uv.val[1]);
+    }
+    rowSplitScalar(s, du, dv, x, pairs);
+}
+
+inline uint8x8_t luma(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+    uint16x8_t const sum = vmlal_u8(vmlal_u8(vmull_u8(r, vdup_n_u8(77)), g, vdup_n_u8(150)), b, vdup_n_u8(29));
+    return vshrn_n_u16(vaddq_u16(sum, vdupq_n_u16(128)), 8);
+}
+
+inline uint8x16_t luma(uint8x16_t r, uint8x16_t g, uint8x16_t b)
+{
+    return vcombine_u8(luma(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b)),
+                       luma(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+}
+
+// Rounded means of the 8 2x2 blocks of 16 pixels of two rows
+inline int16x8_t blockMean(uint8x16_t a, uint8x16_t b)
+{
+    return vreinterpretq_s16_u16(vrshrq_n_u16(vaddq_u16(vpaddlq_u8(a), vpaddlq_u8(b)), 2));
+}
+
+inline uint8x8_t chroma(int16x8_t r, int16x8_t g, int16x8_t b, int16_t kr, int16_t kg, int16_t kb)
+{
+    int16x8_t const sum = vmlaq_n_s16(vmlaq_n_s16(vmulq_n_s16(r, kr), g, kg), b, kb);
+    return vqmovun_s16(vaddq_s16(vshrq_n_s16(sum, 8), vdupq_n_s16(128)));
+}
+
+template <Layout L>
+void rowRgb420(const uint8_t *s1, const uint8_t *s2, uint8_t *y1, uint8_t *y2, uint8_t *du, uint8_t *dv, int width)
+{
+    int const ri = redFirst(L) ? 0 : 2, bi = 2 - ri;
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16x3_t const a = vld3q_u8(s1 + 3 * x), b = vld3q_u8(s2 + 3 * x);
+        vst1q_u8(y1 + x, luma(a.val[ri], a.val[1], a.val[bi]));
+        vst1q_u8(y2 + x, luma(b.val[ri], b.val[1], b.val[bi]));
+
+        int16x8_t const r = blockMean(a.val[ri], b.val[ri]), g = blockMean(a.val[1], b.val[1]);
+        int16x8_t const bl = blockMean(a.val[bi], b.val[bi]);
+        vst1_u8(du + x / 2, chroma(r, g, bl, -43, -85, 128));
+        vst1_u8(dv + x / 2, chroma(r, g, bl, 128, -107, -21));
+    }
+    rowRgb420Scalar<L>(s1, s2, y1, y2, du, dv, x, width);
+}
+
+#else
+
+template <Layout L>
+void rowI420(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8_t *dst, int width)
+{
+    rowI420Scalar<L>(y, u, v, dst, 0, width);
+}
+
+template <Layout L>
+void rowYuyv(const uint8_t *s, uint8_t *dst, int width)
+{
+    rowYuyvScalar<L>(s, dst, 0, width);
+}
+
+void rowLuma(const uint8_t *s, uint8_t *dy, int width)
+{
+    rowLumaScalar(s, dy, 0, width);
+}
+
+void rowChroma(const uint8_t *s1, const uint8_t *s2, uint8_t *du, uint8_t *dv, int width)
+{
+    rowChromaScalar(s1, s2, du, dv, 0, width);
+}
+
+void rowSplit(const uint8_t *s, uint8_t *du, uint8_t *dv, int pairs)
+{
+    rowSplitScalar(s, du, dv, 0, pairs);
+}
+
+#endif
+
+#if !defined(__ARM_NEON) || defined(__SSE2__)
+template <Layout L>
+void rowRgb420(const uint8_t *s1, const uint8_t *s2, uint8_t *y1, uint8_t *y2, uint8_t *du, uint8_t *dv, int width)
+{
+    rowRgb420Scalar<L>(s1, s2, y1, y2, du, dv, 0, width);
+}
+#endif
+
+// Calls function(begin, end) over [0, rows), in bands on the global pool for large frames
+template <typename Function>
+void forRows(size_t rows, size_t pixels, const Function &function)
+{
+    if (pixels < PARALLEL_PIXELS || rows < 2)
+    {
+        function(0, rows);
+        return;
+    }
+
+    size_t const bands = std::min(rows, INDI::ThreadPool::global().size() * 4);
+    INDI::ThreadPool::global().parallelFor(0, bands, [&](size_t band)
+    {
+        function(band * rows / bands, (band + 1) * rows / bands);
+    });
+}
+
+template <Layout L>
+void convertI420(int width, int height, const void *src, void *dst)
+{
+    if ((width & 1) || (height & 1))
+        return;
+
+    size_t const w = width, h = height;
+    const uint8_t *y = static_cast<const uint8_t *>(src);
+    const uint8_t *u = y + w * h;
+    const uint8_t *v = u + w * h / 4;
+    uint8_t *d = static_cast<uint8_t *>(dst);
+
+    auto row = rowI420<L>;
+#ifdef CCVT_AVX2
+    if (hasAvx2())
+        row = rowI420Avx2<L>;
+#endif
+
+    // Rows go in pairs, sharing their chroma
+    forRows(h / 2, w * h, [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+        {
+            row(y + 2 * j * w, u + j * w / 2, v + j * w / 2, d + 2 * j * w * pixelBytes(L), width);
+            row(y + (2 * j + 1) * w, u + j * w / 2, v + j * w / 2, d + (2 * j + 1) * w * pixelBytes(L), width);
+        }
+    });
+}
+
+template <Layout L>
+void convertYuyv(int width, int height, const void *src, void *dst)
+{
+    // As in ccvt_misc.c, odd widths lose their last column and rows follow each other
+    size_t const w = width & ~1;
+    const uint8_t *s = static_cast<const uint8_t *>(src);
+    uint8_t *d = static_cast<uint8_t *>(dst);
+
+    auto row = rowYuyv<L>;
+#ifdef CCVT_AVX2
+    if (hasAvx2())
+        row = rowYuyvAvx2<L>;
+#endif
+
+    forRows(height, w * height, [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+            row(s + 2 * j * w, d + j * w * pixelBytes(L), w);
+    });
+}
+
+template <Layout L>
+void convertRgb420(int width, int height, const void *src, void *dsty, void *dstu, void *dstv)
+{
+    /* Disregard last column/line if width/height is odd */
+    size_t const w = width - width % 2, h = height - height % 2, stride = 3 * static_cast<size_t>(width);
+    const uint8_t *s = static_cast<const uint8_t *>(src);
+    uint8_t *dy = static_cast<uint8_t *>(dsty);
+    uint8_t *du = static_cast<uint8_t *>(dstu);
+    uint8_t *dv = static_cast<uint8_t *>(dstv);
+
+    auto row = rowRgb420<L>;
+#ifdef CCVT_SSSE3
+    if (hasSsse3())
+        row = rowRgb420Ssse3<L>;
+#endif
+
+    forRows(h / 2, w * h, [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+            row(s + 2 * j * stride, s + (2 * j + 1) * stride, dy + 2 * j * w, dy + (2 * j + 1) * w,
+                du + j * w / 2, dv + j * w / 2, w);
+    });
+}
+
+}
+
+void ccvt_rgb24_420p(int width, int height, const void *src, void *dsty, void *dstu, void *dstv)
+{
+    convertRgb420<RGB24>(width, height, src, dsty, dstu, dstv);
+}
+
+void ccvt_bgr24_420p(int width, int height, const void *src, void *dsty, void *dstu, void *dstv)
+{
+    convertRgb420<BGR24>(width, height, src, dsty, dstu, dstv);
+}
+
+void ccvt_420p_bgr32(int width, int height, const void *src, void *dst)
+{
+    convertI420<BGR32>(width, height, src, dst);
+}
+
+void ccvt_420p_bgr24(int width, int height, const void *src, void *dst)
+{
+    convertI420<BGR24>(width, height, src, dst);
+}
+
+void ccvt_420p_rgb32(int width, int height, const void *src, void *dst)
+{
+    convertI420<RGB32>(width, height, src, dst);
+}
+
+void ccvt_420p_rgb24(int width, int height, const void *src, void *dst)
+{
+    convertI420<RGB24>(width, height, src, dst);
+}
+
+void ccvt_yuyv_bgr32(int width, int height, const void *src, void *dst)
+{
+    convertYuyv<BGR32>(width, height, src, dst);
+}
+
+void ccvt_yuyv_bgr24(int width, int height, const void *src, void *dst)
+{
+    convertYuyv<BGR24>(width, height, src, dst);
+}
+
+void ccvt_yuyv_rgb24(int width, int height, const void *src, void *dst)
+{
+    convertYuyv<RGB24>(width, height, src, dst);
+}
+
+void ccvt_yuyv_420p(int width, int height, const void *src, void *dsty, void *dstu, void *dstv)
+{
+    /* Disregard last column/line if width/height is odd */
+    size_t const w = width - width % 2, h = height - height % 2;
+    const uint8_t *s = static_cast<const uint8_t *>(src);
+    uint8_t *dy = static_cast<uint8_t *>(dsty);
+    uint8_t *du = static_cast<uint8_t *>(dstu);
+    uint8_t *dv = static_cast<uint8_t *>(dstv);
+
+    forRows(h / 2, w * h, [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+        {
+            const uint8_t *s1 = s + 2 * j * 2 * w, *s2 = s1 + 2 * w;
+            rowLuma(s1, dy + 2 * j * w, w);
+            rowLuma(s2, dy + (2 * j + 1) * w, w);
+            rowChroma(s1, s2, du + j * w / 2, dv + j * w / 2, w);
+        }
+    });
+}
+
+void ccvt_nv12_420p(int width, int height, int stride, const void *src, void *dsty, void *dstu, void *dstv)
+{
+    size_t const w = width, h = height, pairs = (w + 1) / 2;
+    const uint8_t *s = static_cast<const uint8_t *>(src);
+    uint8_t *dy = static_cast<uint8_t *>(dsty);
+    uint8_t *du = static_cast<uint8_t *>(dstu);
+    uint8_t *dv = static_cast<uint8_t *>(dstv);
+    const uint8_t *uv = s + static_cast<size_t>(stride) * h;
+
+    forRows(h / 2, w * h, [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+        {
+            memcpy(dy + 2 * j * w, s + 2 * j * stride, w);
+            memcpy(dy + (2 * j + 1) * w, s + (2 * j + 1) * stride, w);
+            rowSplit(uv + j * stride, du + j * pairs, dv + j * pairs, pairs);
+        }
+    });
+
+    // The last row of an odd height has no chroma of its own
+    if (h & 1)
+        memcpy(dy + (h - 1) * w, s + (h - 1) * stride, w);
+}
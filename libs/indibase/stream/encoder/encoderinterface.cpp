@@ -50,6 +50,25 @@ bool EncoderInterface::setSize(uint16_t width, uint16_t height)
     return true;
 }
 
+bool EncoderInterface::supportsPixelDepth(uint8_t pixelDepth) const
+{
+    return pixelDepth <= 8;
+}
+
+bool EncoderInterface::setRateControl(uint32_t bitrate, uint32_t keyframeInterval, uint32_t maxDelay)
+{
+    INDI_UNUSED(bitrate);
+    INDI_UNUSED(keyframeInterval);
+    INDI_UNUSED(maxDelay);
+    return true;
+}
+
+bool EncoderInterface::setCompression(const char *codec)
+{
+    INDI_UNUSED(codec);
+    return true;
+}
+
 bool EncoderInterface::setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth)
 {
     this->pixelFormat = pixelFormat;
@@ -53,6 +53,27 @@ class EncoderInterface
 
         virtual bool setSize(uint16_t width, uint16_t height);
 
+        /**
+         * @brief supportsPixelDepth Tells if upload takes frames of pixelDepth bits as they are.
+         * The stream converts the frames of the depths an encoder does not support to 8 bits first.
+         */
+        virtual bool supportsPixelDepth(uint8_t pixelDepth) const;
+
+        /**
+         * @brief setRateControl Sets the targets of encoders that compress the stream over time, which the others ignore.
+         * @param bitrate Target bitrate in kbit/s.
+         * @param keyframeInterval Frames between two key frames, where clients can start decoding.
+         * @param maxDelay Frames the encoder may hold back to compress better, 0 for the lowest latency.
+         */
+        virtual bool setRateControl(uint32_t bitrate, uint32_t keyframeInterval, uint32_t maxDelay);
+
+        /**
+         * @brief setCompression Selects the codec compressed uploads of lossless encoders use, which the others ignore.
+         * @param codec Name of the codec, such as CODEC_ZLIB or CODEC_LZ4.
+         * @return False if the encoder does not know the codec.
+         */
+        virtual bool setCompression(const char *codec);
+
         virtual bool upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint32_t nbytes, bool isCompressed = false) = 0;
 
         const char *getName();
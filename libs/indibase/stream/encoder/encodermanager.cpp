@@ -22,6 +22,9 @@
 #include "encodermanager.h"
 #include "rawencoder.h"
 #include "mjpegencoder.h"
+#ifdef HAVE_LIBAVCODEC
+#include "h264encoder.h"
+#endif
 
 namespace INDI
 {
@@ -30,6 +33,10 @@ EncoderManager::EncoderManager()
 {
     encoder_list.push_back(new RawEncoder());
     encoder_list.push_back(new MJPEGEncoder());
+#ifdef HAVE_LIBAVCODEC
+    encoder_list.push_back(new H264Encoder(H264Encoder::CODEC_H264));
+    encoder_list.push_back(new H264Encoder(H264Encoder::CODEC_H265));
+#endif
     default_encoder = encoder_list.at(0);
 }
 
@@ -0,0 +1,379 @@
+/*
+    H.264/H.265 Encoder Interface
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "h264encoder.h"
+#include "defaultdevice.h"
+#include "indilogger.h"
+#include "indithreadpool.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavcodec/version.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/opt.h>
+}
+
+namespace
+{
+
+// Encoders tried in turn, hardware first
+const char *H264_ENCODERS[] = { "h264_v4l2m2m", "h264_rkmpp", "h264_nvenc", "h264_vaapi", "libx264", "libopenh264", nullptr };
+const char *H265_ENCODERS[] = { "hevc_v4l2m2m", "hevc_rkmpp", "hevc_nvenc", "hevc_vaapi", "libx265", nullptr };
+
+// Frames with more pixels are converted in parallel
+constexpr int PARALLEL_PIXELS = 1 << 20;
+
+bool supportsFormat(const AVCodec *avcodec, AVPixelFormat format)
+{
+    const AVPixelFormat *formats = nullptr;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    avcodec_get_supported_config(nullptr, avcodec, AV_CODEC_CONFIG_PIX_FORMAT, 0,
+                                 reinterpret_cast<const void **>(&formats), nullptr);
+#else
+    formats = avcodec->pix_fmts;
+#endif
+    if (formats == nullptr)
+        return format == AV_PIX_FMT_YUV420P;
+
+    for (; *formats != AV_PIX_FMT_NONE; formats++)
+        if (*formats == format)
+            return true;
+    return false;
+}
+
+bool hasSuffix(const char *name, const char *suffix)
+{
+    size_t const length = strlen(name), suffixLength = strlen(suffix);
+    return length >= suffixLength && strcmp(name + length - suffixLength, suffix) == 0;
+}
+
+}
+
+namespace INDI
+{
+
+H264Encoder::H264Encoder(Codec codec) : codec(codec)
+{
+    name = codec == CODEC_H264 ? "H264" : "H265";
+
+    // Video decoders expect luma between 16 and 235
+    for (int i = 0; i < 256; i++)
+        lumaLut[i] = static_cast<uint8_t>(16 + (i * 219 + 127) / 255);
+}
+
+H264Encoder::~H264Encoder()
+{
+    close();
+}
+
+const char *H264Encoder::getDeviceName()
+{
+    return currentDevice->getDeviceName();
+}
+
+bool H264Encoder::setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth)
+{
+    // The stream manager hands over 8 bit frames, JPEG frames would have to be decoded first
+    if (pixelFormat == INDI_JPG)
+        return false;
+
+    if (pixelFormat != this->pixelFormat)
+        reopen = true;
+    return EncoderInterface::setPixelFormat(pixelFormat, pixelDepth);
+}
+
+bool H264Encoder::setSize(uint16_t width, uint16_t height)
+{
+    if (width != rawWidth || height != rawHeight)
+        reopen = true;
+    return EncoderInterface::setSize(width, height);
+}
+
+bool H264Encoder::setRateControl(uint32_t bitrate, uint32_t keyframeInterval, uint32_t maxDelay)
+{
+    if (bitrate != this->bitrate || keyframeInterval != this->keyframeInterval || maxDelay != this->maxDelay)
+        reopen = true;
+    this->bitrate = std::max(bitrate, 1u);
+    this->keyframeInterval = std::max(keyframeInterval, 1u);
+    this->maxDelay = maxDelay;
+    return true;
+}
+
+bool H264Encoder::open()
+{
+    if (rawWidth < 16 || rawHeight < 16)
+    {
+        LOGF_ERROR("Frames of %dx%d are too small to stream as %s.", rawWidth, rawHeight, name);
+        return false;
+    }
+
+    for (const char **encoder = codec == CODEC_H264 ? H264_ENCODERS : H265_ENCODERS; *encoder; encoder++)
+    {
+        const AVCodec *avcodec = avcodec_find_encoder_by_name(*encoder);
+        if (avcodec && open(avcodec))
+        {
+            LOGF_INFO("Streaming %dx%d frames with the %s encoder at %u kbit/s.", context->width, context->height, *encoder, bitrate);
+            return true;
+        }
+        close();
+    }
+
+    LOGF_ERROR("No %s encoder of this system could be opened.", name);
+    return false;
+}
+
+bool H264Encoder::open(const AVCodec *avcodec)
+{
+    bool const vaapi = hasSuffix(avcodec->name, "_vaapi");
+    AVPixelFormat format = AV_PIX_FMT_NV12;
+    if (!vaapi)
+    {
+        if (supportsFormat(avcodec, AV_PIX_FMT_YUV420P))
+            format = AV_PIX_FMT_YUV420P;
+        else if (!supportsFormat(avcodec, AV_PIX_FMT_NV12))
+            return false;
+    }
+
+    context = avcodec_alloc_context3(avcodec);
+    if (context == nullptr)
+        return false;
+
+    // 4:2:0 chroma needs even dimensions
+    context->width = rawWidth & ~1;
+    context->height = rawHeight & ~1;
+    context->time_base = AVRational{1, 1000};
+    context->framerate = AVRational{30, 1};
+    context->pix_fmt = vaapi ? AV_PIX_FMT_VAAPI : format;
+    context->bit_rate = static_cast<int64_t>(bitrate) * 1000;
+    context->rc_max_rate = context->bit_rate;
+    // A short rate control buffer keeps frames small and the latency low on slow links
+    context->rc_buffer_size = static_cast<int>(maxDelay == 0 ? context->bit_rate / 2 : context->bit_rate);
+    context->gop_size = keyframeInterval;
+    context->max_b_frames = std::min<uint32_t>(maxDelay, 3);
+    if (maxDelay == 0)
+        context->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
+    // Options of the encoders that have them, the others ignore them
+    if (hasSuffix(avcodec->name, "x264") || hasSuffix(avcodec->name, "x265"))
+    {
+        av_opt_set(context->priv_data, "preset", "veryfast", 0);
+        if (maxDelay == 0)
+            av_opt_set(context->priv_data, "tune", "zerolatency", 0);
+    }
+    else if (hasSuffix(avcodec->name, "_nvenc"))
+    {
+        av_opt_set(context->priv_data, "preset", "p2", 0);
+        av_opt_set(context->priv_data, "tune", maxDelay == 0 ? "ull" : "ll", 0);
+        if (maxDelay == 0)
+            av_opt_set(context->priv_data, "zerolatency", "1", 0);
+    }
+    else if (hasSuffix(avcodec->name, "_v4l2m2m"))
+    {
+        // Parameter sets on every key frame, so that clients can join the stream
+        av_opt_set(context->priv_data, "repeat_sequence_header", "1", 0);
+    }
+
+    if (vaapi)
+    {
+        if (av_hwdevice_ctx_create(&hwDevice, AV_HWDEVICE_TYPE_VAAPI, nullptr, nullptr, 0) < 0)
+            return false;
+
+        AVBufferRef *hwFrames = av_hwframe_ctx_alloc(hwDevice);
+        if (hwFrames == nullptr)
+            return false;
+        auto framesContext = reinterpret_cast<AVHWFramesContext *>(hwFrames->data);
+        framesContext->format = AV_PIX_FMT_VAAPI;
+        framesContext->sw_format = format;
+        framesContext->width = context->width;
+        framesContext->height = context->height;
+        framesContext->initial_pool_size = 4;
+        if (av_hwframe_ctx_init(hwFrames) < 0)
+        {
+            av_buffer_unref(&hwFrames);
+            return false;
+        }
+        context->hw_frames_ctx = av_buffer_ref(hwFrames);
+        av_buffer_unref(&hwFrames);
+
+        hwFrame = av_frame_alloc();
+        if (hwFrame == nullptr)
+            return false;
+    }
+
+    if (avcodec_open2(context, avcodec, nullptr) < 0)
+        return false;
+
+    frame = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (frame == nullptr || packet == nullptr)
+        return false;
+
+    frame->format = format;
+    frame->width = context->width;
+    frame->height = context->height;
+    if (av_frame_get_buffer(frame, 0) < 0)
+        return false;
+
+    lastPts = -1;
+    start = std::chrono::steady_clock::now();
+    return true;
+}
+
+void H264Encoder::close()
+{
+    av_packet_free(&packet);
+    av_frame_free(&hwFrame);
+    av_frame_free(&frame);
+    avcodec_free_context(&context);
+    av_buffer_unref(&hwDevice);
+}
+
+void H264Encoder::convert(const uint8_t *buffer, AVFrame *frame)
+{
+    bool const rgb = pixelFormat == INDI_RGB;
+    bool const interleaved = frame->format == AV_PIX_FMT_NV12;
+    int const width = frame->width, height = frame->height;
+    size_t const stride = static_cast<size_t>(rawWidth) * (rgb ? 3 : 1);
+
+    // Two rows of luma and one of chroma at a time
+    auto rows = [&](size_t pair)
+    {
+        int const y = static_cast<int>(pair) * 2;
+        uint8_t *lumaRows[2] = { frame->data[0] + y * frame->linesize[0], frame->data[0] + (y + 1) * frame->linesize[0] };
+        uint8_t *u = frame->data[1] + pair * frame->linesize[1];
+        uint8_t *v = interleaved ? u + 1 : frame->data[2] + pair * frame->linesize[2];
+        int const chromaStep = interleaved ? 2 : 1;
+
+        if (!rgb)
+        {
+            for (int j = 0; j < 2; j++)
+            {
+                const uint8_t *src = buffer + (y + j) * stride;
+                for (int x = 0; x < width; x++)
+                    lumaRows[j][x] = lumaLut[src[x]];
+            }
+            for (int x = 0; x < width / 2; x++)
+                u[x * chromaStep] = v[x * chromaStep] = 128;
+            return;
+        }
+
+        // BT.601, limited range
+        for (int j = 0; j < 2; j++)
+        {
+            const uint8_t *src = buffer + (y + j) * stride;
+            for (int x = 0; x < width; x++, src += 3)
+                lumaRows[j][x] = static_cast<uint8_t>(((66 * src[0] + 129 * src[1] + 25 * src[2] + 128) >> 8) + 16);
+        }
+        const uint8_t *top = buffer + y * stride, *bottom = top + stride;
+        for (int x = 0; x < width / 2; x++, top += 6, bottom += 6)
+        {
+            int const r = (top[0] + top[3] + bottom[0] + bottom[3] + 2) >> 2;
+            int const g = (top[1] + top[4] + bottom[1] + bottom[4] + 2) >> 2;
+            int const b = (top[2] + top[5] + bottom[2] + bottom[5] + 2) >> 2;
+            u[x * chromaStep] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v[x * chromaStep] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    };
+
+    if (width * height < PARALLEL_PIXELS)
+        for (int pair = 0; pair < height / 2; pair++)
+            rows(pair);
+    else
+        ThreadPool::global().parallelFor(0, height / 2, rows, 16);
+}
+
+bool H264Encoder::upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint32_t nbytes, bool isCompressed)
+{
+    // We do not support compression
+    if (isCompressed)
+    {
+        LOGF_ERROR("Compression is not supported in %s stream.", name);
+        return false;
+    }
+
+    if (reopen)
+    {
+        reopen = false;
+        close();
+        failed = !open();
+        if (failed)
+            close();
+    }
+    if (failed)
+        return false;
+
+    if (nbytes < static_cast<uint32_t>(rawWidth) * rawHeight * ((pixelFormat == INDI_RGB) ? 3 : 1))
+    {
+        LOGF_DEBUG("Frame of %u bytes is smaller than %dx%d, skipping it.", nbytes, rawWidth, rawHeight);
+        return false;
+    }
+
+    if (av_frame_make_writable(frame) < 0)
+        return false;
+    convert(buffer, frame);
+
+    // Timestamps in milliseconds since the stream started, so that rate control follows the actual frame rate
+    int64_t pts = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    pts = std::max(pts, lastPts + 1);
+    lastPts = pts;
+    frame->pts = pts;
+
+    AVFrame *input = frame;
+    if (hwFrame)
+    {
+        av_frame_unref(hwFrame);
+        if (av_hwframe_get_buffer(context->hw_frames_ctx, hwFrame, 0) < 0 || av_hwframe_transfer_data(hwFrame, frame, 0) < 0)
+        {
+            LOGF_ERROR("Failed to upload the frame to the %s encoder.", name);
+            return false;
+        }
+        hwFrame->pts = pts;
+        input = hwFrame;
+    }
+
+    if (avcodec_send_frame(context, input) < 0)
+    {
+        LOGF_ERROR("The %s encoder rejected the frame, reopening it.", name);
+        reopen = true;
+        return false;
+    }
+
+    stream.clear();
+    while (avcodec_receive_packet(context, packet) == 0)
+    {
+        stream.insert(stream.end(), packet->data, packet->data + packet->size);
+        av_packet_unref(packet);
+    }
+
+    // Encoders that look ahead hold the first frames back
+    if (stream.empty())
+        return false;
+
+    bp->setBlob(stream.data());
+    bp->setBlobLen(stream.size());
+    bp->setSize(stream.size());
+    bp->setFormat(codec == CODEC_H264 ? ".stream_h264" : ".stream_h265");
+
+    return true;
+}
+
+}
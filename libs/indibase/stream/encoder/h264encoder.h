@@ -0,0 +1,97 @@
+/*
+    H.264/H.265 Encoder Interface
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#pragma once
+
+#include "encoderinterface.h"
+
+#include <chrono>
+
+struct AVBufferRef;
+struct AVCodec;
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+namespace INDI
+{
+
+/**
+ * @brief The H264Encoder class compresses the stream to H.264 or H.265 with libavcodec.
+ *
+ * The first encoder that opens is used, in this order: V4L2 M2M and Rockchip MPP (Raspberry Pi, Rockchip boards),
+ * NVENC, VAAPI, then the x264, OpenH264 or x265 software encoders. Mono and Bayer frames are sent as the luma of
+ * the picture, RGB frames are converted to YUV 4:2:0. Each upload carries the Annex B access units the encoder
+ * produced for the frame, as ".stream_h264" or ".stream_h265"; key frames repeat the parameter sets, so clients
+ * can join the stream at any key frame.
+ */
+class H264Encoder : public EncoderInterface
+{
+    public:
+        enum Codec
+        {
+            CODEC_H264,
+            CODEC_H265
+        };
+
+        explicit H264Encoder(Codec codec = CODEC_H264);
+        ~H264Encoder();
+
+        virtual bool setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth) override;
+        virtual bool setSize(uint16_t width, uint16_t height) override;
+        virtual bool setRateControl(uint32_t bitrate, uint32_t keyframeInterval, uint32_t maxDelay) override;
+
+        virtual bool upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint32_t nbytes, bool isCompressed = false) override;
+
+    private:
+        const char *getDeviceName();
+
+        // Opens the first encoder of the codec that works on this system, at the current size and rates
+        bool open();
+        bool open(const AVCodec *avcodec);
+        void close();
+
+        // Converts an 8 bit frame to the YUV 4:2:0 layout of frame, planar or with interleaved chroma
+        void convert(const uint8_t *buffer, AVFrame *frame);
+
+    private:
+        Codec codec;
+
+        AVCodecContext *context = nullptr;
+        AVFrame *frame = nullptr;
+        AVFrame *hwFrame = nullptr;
+        AVPacket *packet = nullptr;
+        AVBufferRef *hwDevice = nullptr;
+
+        // Encoder settings changed since it was opened, or it failed to open
+        bool reopen = true;
+        bool failed = false;
+
+        uint32_t bitrate = 2000;
+        uint32_t keyframeInterval = 60;
+        uint32_t maxDelay = 0;
+
+        int64_t lastPts = -1;
+        std::chrono::steady_clock::time_point start;
+
+        std::vector<uint8_t> stream;
+        uint8_t lumaLut[256];
+};
+
+}
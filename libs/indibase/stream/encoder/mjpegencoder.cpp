@@ -22,28 +22,73 @@
 #include "mjpegencoder.h"
 #include "stream/streammanager.h"
 #include "indiccd.h"
+#include "indithreadpool.h"
+#include "dsp.h"
+
+#include <algorithm>
 #include <cmath>
 #include <zlib.h>
 #include <jpeglib.h>
 #include <jerror.h>
 
-static void init_destination(j_compress_ptr cinfo)
+namespace
+{
+
+// Frames of fewer pixels are encoded in one strip
+constexpr size_t PARALLEL_PIXELS = 1 << 18;
+
+constexpr int QUALITY = 85;
+
+// Destination manager writing to a vector, grown as the image needs
+struct VectorDestination
+{
+    struct jpeg_destination_mgr pub;
+    std::vector<uint8_t> *buffer;
+};
+
+void init_destination(j_compress_ptr cinfo)
 {
-    INDI_UNUSED(cinfo);
-    /* No work necessary here */
+    auto dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    // Reuse the memory of the previous frame
+    dest->buffer->resize(std::max<size_t>(dest->buffer->capacity(), 1 << 16));
+    dest->pub.next_output_byte = dest->buffer->data();
+    dest->pub.free_in_buffer = dest->buffer->size();
 }
 
-static boolean empty_output_buffer(j_compress_ptr cinfo)
+boolean empty_output_buffer(j_compress_ptr cinfo)
 {
-    INDI_UNUSED(cinfo);
-    /* No work necessary here */
+    auto dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    // The whole buffer is written when libjpeg asks for more
+    size_t const used = dest->buffer->size();
+    dest->buffer->resize(used * 2);
+    dest->pub.next_output_byte = dest->buffer->data() + used;
+    dest->pub.free_in_buffer = dest->buffer->size() - used;
     return TRUE;
 }
 
-static void term_destination(j_compress_ptr cinfo)
+void term_destination(j_compress_ptr cinfo)
 {
-    INDI_UNUSED(cinfo);
-    /* no work necessary here */
+    auto dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    dest->buffer->resize(dest->buffer->size() - dest->pub.free_in_buffer);
+}
+
+// Returns the offset of the SOS marker of a JPEG image, and that of its SOF0 marker in sof, 0 if not found
+size_t findScan(const std::vector<uint8_t> &jpeg, size_t &sof)
+{
+    sof = 0;
+    size_t offset = 2;
+    while (offset + 4 <= jpeg.size() && jpeg[offset] == 0xFF)
+    {
+        uint8_t const marker = jpeg[offset + 1];
+        if (marker == 0xDA)
+            return sof ? offset : 0;
+        if (marker == 0xC0)
+            sof = offset;
+        offset += 2 + ((jpeg[offset + 2] << 8) | jpeg[offset + 3]);
+    }
+    return 0;
+}
+
 }
 
 namespace INDI
@@ -56,7 +101,6 @@ MJPEGEncoder::MJPEGEncoder()
 
 MJPEGEncoder::~MJPEGEncoder()
 {
-    delete [] jpegBuffer;
 }
 
 const char *MJPEGEncoder::getDeviceName()
@@ -64,6 +108,11 @@ const char *MJPEGEncoder::getDeviceName()
     return currentDevice->getDeviceName();
 }
 
+bool MJPEGEncoder::supportsPixelDepth(uint8_t pixelDepth) const
+{
+    return pixelDepth <= 16;
+}
+
 bool MJPEGEncoder::upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint32_t nbytes, bool isCompressed)
 {
     // We do not support compression
@@ -73,31 +122,118 @@ bool MJPEGEncoder::upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint3
         return false;
     }
 
-    INDI_UNUSED(nbytes);
-    int bufsize = rawWidth * rawHeight * ((pixelFormat == INDI_RGB) ? 3 : 1);
-    if (bufsize != jpegBufferSize)
+    // Red, green and blue mosaics are encoded in color
+    int const red = (pixelFormat >= INDI_BAYER_RGGB && pixelFormat <= INDI_BAYER_BGGR) ? pixelFormat - INDI_BAYER_RGGB : -1;
+    bool const deep = pixelDepth > 8;
+    size_t const pixels = static_cast<size_t>(rawWidth) * rawHeight;
+    size_t const frameSize = pixels * ((pixelFormat == INDI_RGB) ? 3 : 1) * (deep ? 2 : 1);
+    if (rawWidth == 0 || rawHeight == 0 || nbytes < frameSize)
+    {
+        LOGF_ERROR("Frame of %u bytes is smaller than %ux%u pixels.", nbytes, rawWidth, rawHeight);
+        return false;
+    }
+
+    if (red >= 0)
     {
-        delete [] jpegBuffer;
-        jpegBuffer = new uint8_t[bufsize];
-        jpegBufferSize = bufsize;
+        colorFrame.resize(pixels * 3 * (deep ? 2 : 1));
+        int const r = deep ?
+                      dsp_debayer_u16(reinterpret_cast<const uint16_t *>(buffer), reinterpret_cast<uint16_t *>(colorFrame.data()),
+                                      rawWidth, rawHeight, red, DSP_DEBAYER_BILINEAR, 0) :
+                      dsp_debayer_u8(buffer, colorFrame.data(), rawWidth, rawHeight, red, DSP_DEBAYER_BILINEAR, 0);
+        if (r < 0)
+        {
+            LOGF_ERROR("Cannot demosaic a frame of %ux%u pixels.", rawWidth, rawHeight);
+            return false;
+        }
+        buffer = colorFrame.data();
+    }
+    int const components = (pixelFormat == INDI_RGB || red >= 0) ? 3 : 1;
+
+    // Strips are made of whole MCU rows: 16 rows with the 4:2:0 chroma of color frames, 8 rows otherwise
+    size_t const mcuSize = (components == 3) ? 16 : 8;
+    size_t const mcusPerRow = (rawWidth + mcuSize - 1) / mcuSize;
+    size_t const mcuRows = (rawHeight + mcuSize - 1) / mcuSize;
+
+    size_t count = 1;
+    if (static_cast<size_t>(rawWidth) * rawHeight >= PARALLEL_PIXELS)
+        count = std::min(ThreadPool::global().size(), mcuRows);
+    // The restart interval, in MCUs, is a 16 bit value
+    size_t const stripMcuRows = std::min((mcuRows + count - 1) / count, 65535 / mcusPerRow);
+    size_t const stripHeight = stripMcuRows * mcuSize;
+    count = (mcuRows + stripMcuRows - 1) / stripMcuRows;
+
+    if (strips.size() < count)
+    {
+        strips.resize(count);
+        stripRows.resize(count);
+    }
+
+    ThreadPool::global().parallelFor(0, count, [&](size_t strip)
+    {
+        size_t const y = strip * stripHeight;
+        compressStrip(buffer, components, y, std::min(stripHeight, rawHeight - y), QUALITY, strips[strip], stripRows[strip]);
+    });
+
+    if (count == 1)
+        jpegFrame.swap(strips[0]);
+    else if (joinStrips(count, stripMcuRows * mcusPerRow) == false)
+    {
+        LOG_ERROR("Failed to join the JPEG strips of the frame.");
+        return false;
     }
 
-    // Scale image DOWN by this factor
-    // 640 is now selected arbitrary to test mpeg streaming performance
-    int scale = std::max(1, static_cast<int>(std::floor(rawWidth / SCALE_WIDTH)));
-    if (pixelFormat == INDI_RGB)
-        jpeg_compress_8u_rgb(buffer, rawWidth, rawHeight, rawWidth * 3, scale, jpegBuffer, &bufsize, 85);
-    else
-        jpeg_compress_8u_gray(buffer, rawWidth, rawHeight, rawWidth, scale, jpegBuffer, &bufsize, 85);
-
-    bp->setBlob(jpegBuffer);
-    bp->setBlobLen(bufsize);
-    bp->setSize(bufsize);
+    bp->setBlob(jpegFrame.data());
+    bp->setBlobLen(jpegFrame.size());
+    bp->setSize(jpegFrame.size());
     bp->setFormat(".stream_jpg");
 
     return true;
 }
 
+bool MJPEGEncoder::joinStrips(size_t count, uint16_t interval)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++)
+        total += strips[i].size();
+
+    jpegFrame.clear();
+    jpegFrame.reserve(total);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const std::vector<uint8_t> &strip = strips[i];
+        size_t sof = 0;
+        size_t const sos = findScan(strip, sof);
+        if (sos == 0 || strip.size() < sos + 4 || strip[strip.size() - 2] != 0xFF || strip[strip.size() - 1] != 0xD9)
+            return false;
+
+        if (i == 0)
+        {
+            // Markers of the first strip, with the height of the frame and the restart interval of the strips
+            jpegFrame.insert(jpegFrame.end(), strip.begin(), strip.begin() + sos);
+            jpegFrame[sof + 5] = rawHeight >> 8;
+            jpegFrame[sof + 6] = rawHeight & 0xFF;
+
+            const uint8_t dri[] = { 0xFF, 0xDD, 0x00, 0x04, static_cast<uint8_t>(interval >> 8), static_cast<uint8_t>(interval & 0xFF) };
+            jpegFrame.insert(jpegFrame.end(), dri, dri + sizeof(dri));
+            jpegFrame.insert(jpegFrame.end(), strip.begin() + sos, strip.end() - 2);
+        }
+        else
+        {
+            // Entropy coded data of the next strips, after a restart marker, RST0 to RST7 in turn
+            const uint8_t rst[] = { 0xFF, static_cast<uint8_t>(0xD0 + ((i - 1) & 7)) };
+            jpegFrame.insert(jpegFrame.end(), rst, rst + sizeof(rst));
+            size_t const data = sos + 2 + ((strip[sos + 2] << 8) | strip[sos + 3]);
+            jpegFrame.insert(jpegFrame.end(), strip.begin() + data, strip.end() - 2);
+        }
+    }
+
+    // EOI
+    jpegFrame.push_back(0xFF);
+    jpegFrame.push_back(0xD9);
+    return true;
+}
+
 /*
 FROM: https://svn.csail.mit.edu/rrg_pods/jpeg-utils/
 
@@ -119,88 +255,66 @@ Requirements:
   library that is ABI compatible with libjpeg62.
 */
 
-int MJPEGEncoder::jpeg_compress_8u_gray (const uint8_t * src, uint16_t width, uint16_t height, int stride, int scale,
-        uint8_t * dest,
-        int * destsize, int quality)
+void MJPEGEncoder::compressStrip(const uint8_t *src, int components, uint16_t y, uint16_t height, int quality,
+                                 std::vector<uint8_t> &dest, std::vector<uint8_t> &rows)
 {
     struct jpeg_compress_struct cinfo;
     struct jpeg_error_mgr jerr;
-    struct jpeg_destination_mgr jdest;
-    int out_size = *destsize;
+    VectorDestination jdest;
+
+    size_t const samples = static_cast<size_t>(rawWidth) * components;
+    bool const deep = pixelDepth > 8;
 
     cinfo.err = jpeg_std_error (&jerr);
     jpeg_create_compress (&cinfo);
-    jdest.next_output_byte = dest;
-    jdest.free_in_buffer = out_size;
-    jdest.init_destination = init_destination;
-    jdest.empty_output_buffer = empty_output_buffer;
-    jdest.term_destination = term_destination;
-    cinfo.dest = &jdest;
-
-    cinfo.image_width = width;
+    jdest.pub.init_destination = init_destination;
+    jdest.pub.empty_output_buffer = empty_output_buffer;
+    jdest.pub.term_destination = term_destination;
+    jdest.buffer = &dest;
+    cinfo.dest = &jdest.pub;
+
+    cinfo.image_width = rawWidth;
     cinfo.image_height = height;
-#if JPEG_LIB_VERSION >= 70
-    cinfo.scale_denom = scale;
-#else
-    INDI_UNUSED(scale);
-#endif
-    cinfo.input_components = 1;
-    cinfo.in_color_space = JCS_GRAYSCALE;
+    cinfo.input_components = components;
+    cinfo.in_color_space = (components == 3) ? JCS_RGB : JCS_GRAYSCALE;
     jpeg_set_defaults (&cinfo);
     jpeg_set_quality (&cinfo, quality, TRUE);
 
-    jpeg_start_compress (&cinfo, TRUE);
-    while (cinfo.next_scanline < height)
+    // 4:2:0 chroma, as the strips are cut on 16 rows
+    if (components == 3)
     {
-        JSAMPROW row = (JSAMPROW)(src + cinfo.next_scanline * stride);
-        jpeg_write_scanlines (&cinfo, &row, 1);
+        cinfo.comp_info[0].h_samp_factor = cinfo.comp_info[0].v_samp_factor = 2;
+        cinfo.comp_info[1].h_samp_factor = cinfo.comp_info[1].v_samp_factor = 1;
+        cinfo.comp_info[2].h_samp_factor = cinfo.comp_info[2].v_samp_factor = 1;
     }
 
-    jpeg_finish_compress (&cinfo);
-    *destsize = out_size - jdest.free_in_buffer;
-    jpeg_destroy_compress (&cinfo);
-    return 0;
-}
-
-int MJPEGEncoder::jpeg_compress_8u_rgb (const uint8_t * src, uint16_t width, uint16_t height, int stride, int scale,
-                                        uint8_t * dest, int * destsize, int quality)
-{
-    struct jpeg_compress_struct cinfo;
-    struct jpeg_error_mgr jerr;
-    struct jpeg_destination_mgr jdest;
-    int out_size = *destsize;
+    jpeg_start_compress (&cinfo, TRUE);
 
-    cinfo.err = jpeg_std_error (&jerr);
-    jpeg_create_compress (&cinfo);
-    jdest.next_output_byte = dest;
-    jdest.free_in_buffer = out_size;
-    jdest.init_destination = init_destination;
-    jdest.empty_output_buffer = empty_output_buffer;
-    jdest.term_destination = term_destination;
-    cinfo.dest = &jdest;
-
-    cinfo.image_width = width;
-    cinfo.image_height = height;
-#if JPEG_LIB_VERSION >= 70
-    cinfo.scale_denom = scale;
-#else
-    INDI_UNUSED(scale);
-#endif
-    cinfo.input_components = 3;
-    cinfo.in_color_space = JCS_RGB;
-    jpeg_set_defaults (&cinfo);
-    jpeg_set_quality (&cinfo, quality, TRUE);
+    // Rows go in an MCU row at a time, through the gamma table for deeper frames
+    int const batch = (components == 3) ? 16 : 8;
+    JSAMPROW rowPointers[16];
+    if (deep)
+        rows.resize(samples * batch);
 
-    jpeg_start_compress (&cinfo, TRUE);
     while (cinfo.next_scanline < height)
     {
-        JSAMPROW row = (JSAMPROW)(src + cinfo.next_scanline * stride);
-        jpeg_write_scanlines (&cinfo, &row, 1);
+        int const count = std::min<int>(batch, height - cinfo.next_scanline);
+        for (int i = 0; i < count; i++)
+        {
+            size_t const row = static_cast<size_t>(y) + cinfo.next_scanline + i;
+            if (deep)
+            {
+                gammaLut16.apply(reinterpret_cast<const uint16_t *>(src) + row * samples, samples, rows.data() + i * samples);
+                rowPointers[i] = rows.data() + i * samples;
+            }
+            else
+                rowPointers[i] = const_cast<JSAMPROW>(src + row * samples);
+        }
+        jpeg_write_scanlines (&cinfo, rowPointers, count);
     }
+
     jpeg_finish_compress (&cinfo);
-    *destsize = out_size - jdest.free_in_buffer;
     jpeg_destroy_compress (&cinfo);
-    return 0;
 }
 
 }
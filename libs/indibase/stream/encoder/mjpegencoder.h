@@ -22,6 +22,9 @@
 #pragma once
 
 #include "encoderinterface.h"
+#include "stream/gammalut16.h"
+
+#include <vector>
 
 namespace INDI
 {
@@ -29,7 +32,13 @@ namespace INDI
 /**
  * @brief The MJPEGEncoder class encodes frames in JPEG format before transmitting them to the client.
  *
- * The quality is now hard-coded at 70 when encoding the JPEG image. Further compression is not supported.
+ * The quality is now hard-coded at 85 when encoding the JPEG image. Further compression is not supported.
+ *
+ * Large frames are cut in strips of whole MCU rows that are encoded in parallel on the global ThreadPool,
+ * then joined with restart markers into one baseline JPEG image, in order. Frames of more than 8 bits are
+ * converted through a gamma lookup table as each strip reads them. Built against libjpeg-turbo, the color
+ * conversion, downsampling, DCT and Huffman coding run its SIMD code. RGGB, GRBG, GBRG and BGGR mosaics are
+ * demosaiced in full resolution first, bilinear, by dsp_debayer.
  */
 class MJPEGEncoder : public EncoderInterface
 {
@@ -37,19 +46,27 @@ class MJPEGEncoder : public EncoderInterface
         MJPEGEncoder();
         ~MJPEGEncoder();
 
+        virtual bool supportsPixelDepth(uint8_t pixelDepth) const override;
+
         virtual bool upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint32_t nbytes, bool isCompressed = false) override;
 
     private:
         const char *getDeviceName();
-        int jpeg_compress_8u_gray (const uint8_t * src, uint16_t width, uint16_t height, int stride, int scale, uint8_t * dest,
-                                   int * destsize, int quality);
-        int jpeg_compress_8u_rgb (const uint8_t * src, uint16_t width, uint16_t height, int stride, int scale, uint8_t * dest,
-                                  int * destsize, int quality);
-        uint8_t *jpegBuffer = nullptr;
-        uint16_t jpegBufferSize = 1;
 
-        static const int SCALE_WIDTH = 640;
+        // Encodes rows [y, y + height) of the frame of 1 or 3 components as a JPEG image of their own
+        void compressStrip(const uint8_t *src, int components, uint16_t y, uint16_t height, int quality,
+                           std::vector<uint8_t> &dest, std::vector<uint8_t> &rows);
+
+        // Joins the strips, encoded in interval MCUs long restart intervals, into jpegFrame
+        bool joinStrips(size_t count, uint16_t interval);
+
+    private:
+        GammaLut16 gammaLut16;
 
+        std::vector<uint8_t> jpegFrame;
+        std::vector<uint8_t> colorFrame;
+        std::vector<std::vector<uint8_t>> strips;
+        std::vector<std::vector<uint8_t>> stripRows;
 };
 
 }
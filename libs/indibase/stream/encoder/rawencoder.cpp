@@ -24,6 +24,12 @@
 #include "indiccd.h"
 
 #include <zlib.h>
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
 
 namespace INDI
 {
@@ -42,8 +48,114 @@ const char *RawEncoder::getDeviceName()
     return currentDevice->getDeviceName();
 }
 
+bool RawEncoder::setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth)
+{
+    if (pixelFormat != this->pixelFormat || pixelDepth != this->pixelDepth)
+        keyframe = true;
+    return EncoderInterface::setPixelFormat(pixelFormat, pixelDepth);
+}
+
+bool RawEncoder::setSize(uint16_t width, uint16_t height)
+{
+    if (width != rawWidth || height != rawHeight)
+        keyframe = true;
+    return EncoderInterface::setSize(width, height);
+}
+
+bool RawEncoder::setRateControl(uint32_t bitrate, uint32_t keyframeInterval, uint32_t maxDelay)
+{
+    INDI_UNUSED(bitrate);
+    INDI_UNUSED(maxDelay);
+    this->keyframeInterval = std::max(keyframeInterval, 1u);
+    return true;
+}
+
+bool RawEncoder::setCompression(const char *codec)
+{
+    if (!strcmp(codec, "CODEC_ZLIB"))
+        this->codec = CODEC_ZLIB;
+#ifdef HAVE_LZ4
+    else if (!strcmp(codec, "CODEC_LZ4"))
+        this->codec = CODEC_LZ4;
+    else if (!strcmp(codec, "CODEC_DELTA_LZ4"))
+        this->codec = CODEC_DELTA_LZ4;
+#endif
+    else
+        return false;
+
+    // Clients may have missed frames while the stream used another codec
+    keyframe = true;
+    return true;
+}
+
+#ifdef HAVE_LZ4
+bool RawEncoder::compressLZ4(const uint8_t *buffer, uint32_t nbytes)
+{
+    // Level 0 is the fast mode, streams favor speed over ratio
+    LZ4F_preferences_t preferences;
+    memset(&preferences, 0, sizeof(preferences));
+    preferences.frameInfo.contentSize = nbytes;
+
+    compressedFrame.resize(LZ4F_compressFrameBound(nbytes, &preferences));
+    size_t r = LZ4F_compressFrame(compressedFrame.data(), compressedFrame.size(), buffer, nbytes, &preferences);
+    if (LZ4F_isError(r))
+    {
+        LOGF_ERROR("internal error - compression failed: %s", LZ4F_getErrorName(r));
+        return false;
+    }
+
+    compressedFrame.resize(r);
+    return true;
+}
+#endif
+
 bool RawEncoder::upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint32_t nbytes, bool isCompressed)
 {
+#ifdef HAVE_LZ4
+    if (isCompressed && codec != CODEC_ZLIB)
+    {
+        const char *format = ".stream.lz4";
+
+        if (codec == CODEC_DELTA_LZ4)
+        {
+            if (!keyframe && previousFrame.size() == nbytes && framesSinceKeyframe + 1 < keyframeInterval)
+            {
+                // Static scenes XOR to mostly zeros, which LZ4 packs to a fraction of the frame
+                deltaFrame.resize(nbytes);
+                uint8_t *delta = deltaFrame.data(), *previous = previousFrame.data();
+                for (uint32_t i = 0; i < nbytes; i++)
+                {
+                    delta[i] = buffer[i] ^ previous[i];
+                    previous[i] = buffer[i];
+                }
+
+                if (!compressLZ4(deltaFrame.data(), nbytes))
+                    return false;
+
+                format = ".stream.dlz4";
+                framesSinceKeyframe++;
+            }
+            else
+            {
+                if (!compressLZ4(buffer, nbytes))
+                    return false;
+
+                previousFrame.assign(buffer, buffer + nbytes);
+                framesSinceKeyframe = 0;
+                keyframe = false;
+            }
+        }
+        else if (!compressLZ4(buffer, nbytes))
+            return false;
+
+        bp->setBlob(compressedFrame.data());
+        bp->setBlobLen(compressedFrame.size());
+        bp->setSize(nbytes);
+        bp->setFormat(format);
+        return true;
+    }
+#endif
+
     // Do we want to compress ?
     if (isCompressed)
     {
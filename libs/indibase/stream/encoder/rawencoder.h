@@ -29,7 +29,10 @@ namespace INDI
 /**
  * @brief The RawEncoder class sends the image as-is (lossless) to the client.
  *
- * It supports compression via zlib (.stream.z)
+ * It supports compression via zlib (.stream.z) and, when built with LZ4, via LZ4 frames (.stream.lz4). The delta
+ * codec sends the XOR of each frame with the previous one as an LZ4 frame (.stream.dlz4), clients XOR it back onto
+ * the last frame they decoded. Every keyframe interval, and whenever the frame size changes, a full .stream.lz4
+ * frame is sent instead so clients can start decoding.
  */
 class RawEncoder : public EncoderInterface
 {
@@ -37,12 +40,29 @@ class RawEncoder : public EncoderInterface
         RawEncoder();
         ~RawEncoder();
 
+        virtual bool setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth) override;
+        virtual bool setSize(uint16_t width, uint16_t height) override;
+        virtual bool setRateControl(uint32_t bitrate, uint32_t keyframeInterval, uint32_t maxDelay) override;
+        virtual bool setCompression(const char *codec) override;
+
         virtual bool upload(INDI::WidgetViewBlob *bp, const uint8_t *buffer, uint32_t nbytes, bool isCompressed = false) override;
 
     private:
         const char *getDeviceName();
+#ifdef HAVE_LZ4
+        bool compressLZ4(const uint8_t *buffer, uint32_t nbytes);
+#endif
         std::vector<uint8_t> compressedFrame;
 
+        enum { CODEC_ZLIB, CODEC_LZ4, CODEC_DELTA_LZ4 } codec = CODEC_ZLIB;
+
+        // Last frame sent, which the next delta frame is taken against
+        std::vector<uint8_t> previousFrame;
+        std::vector<uint8_t> deltaFrame;
+        uint32_t keyframeInterval = 60;
+        uint32_t framesSinceKeyframe = 0;
+        bool keyframe = true;
+
 };
 
 }
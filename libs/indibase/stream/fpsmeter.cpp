@@ -19,6 +19,9 @@
 */
 #include "fpsmeter.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace INDI
 {
 
@@ -88,4 +91,55 @@ void FPSMeter::reset()
     mTotalTime = 0;
 }
 
+void LatencyHistogram::add(uint64_t nanoseconds)
+{
+    uint64_t const us = nanoseconds / 1000;
+    int index = static_cast<int>(us);
+    if (us >= 4)
+    {
+        // Top two bits below the leading one pick the quarter of the power of two
+        int const exponent = 63 - __builtin_clzll(us);
+        index = 4 * (exponent - 1) + static_cast<int>((us >> (exponent - 2)) & 3);
+    }
+    mBuckets[std::min(index, BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyHistogram::Percentiles LatencyHistogram::take()
+{
+    std::array<uint32_t, BUCKETS> counts;
+    Percentiles result;
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        counts[i] = mBuckets[i].exchange(0, std::memory_order_relaxed);
+        result.count += counts[i];
+    }
+
+    if (result.count == 0)
+        return result;
+
+    // Middle of the bucket holding the rank, in milliseconds
+    auto percentile = [&](double p)
+    {
+        uint64_t const rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100 * result.count)));
+        uint64_t seen = 0;
+        int i = 0;
+        for (; i < BUCKETS - 1; i++)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+                break;
+        }
+        if (i < 4)
+            return (i + 0.5) / 1000;
+        int const exponent = i / 4 + 1;
+        double const width = std::ldexp(1.0, exponent - 2);
+        return ((4 + i % 4) * width + width / 2) / 1000;
+    };
+
+    result.p50 = percentile(50);
+    result.p95 = percentile(95);
+    result.p99 = percentile(99);
+    return result;
+}
+
 }
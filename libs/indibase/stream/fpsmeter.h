@@ -19,6 +19,8 @@
 */
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 
@@ -83,4 +85,35 @@ class FPSMeter
         uint64_t mTotalFrames = 0;
 
 };
+
+/**
+ * @brief The LatencyHistogram class counts durations in logarithmic buckets, 4 for each power of two
+ * microseconds, for their percentiles to be read within 20%. Durations are added from any thread.
+ */
+class LatencyHistogram
+{
+    public:
+        struct Percentiles
+        {
+            double p50 = 0, p95 = 0, p99 = 0; // milliseconds
+            uint64_t count = 0;
+        };
+
+    public:
+        /**
+         * @brief Count a duration
+         * @param nanoseconds duration to count
+         */
+        void add(uint64_t nanoseconds);
+
+        /**
+         * @brief Percentiles of the durations added since the last call, which are then cleared
+         * @return Percentiles, all 0 if no duration was added
+         */
+        Percentiles take();
+
+    private:
+        static constexpr int BUCKETS = 4 * 40;
+        std::array<std::atomic<uint32_t>, BUCKETS> mBuckets {};
+};
 }
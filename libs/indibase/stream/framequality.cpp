@@ -0,0 +1,106 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "framequality.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "simd.h"
+
+namespace INDI
+{
+
+template <typename T>
+static void bin(const T *pixels, uint32_t width, int channels, uint32_t factor, uint32_t binnedWidth,
+                uint32_t binnedHeight, std::vector<dsp_t> &binned)
+{
+    size_t const stride = static_cast<size_t>(width) * channels;
+    for (uint32_t y = 0; y < binnedHeight * factor; y++)
+    {
+        const T *row = pixels + y * stride;
+        dsp_t *out = binned.data() + static_cast<size_t>(y / factor) * binnedWidth;
+        for (uint32_t x = 0; x < binnedWidth; x++)
+        {
+            uint32_t sum = 0;
+            for (size_t i = x * factor * channels, end = i + factor * channels; i < end; i++)
+                sum += row[i];
+            out[x] += sum;
+        }
+    }
+}
+
+static double sum(dsp_vec_t v)
+{
+    double total = 0;
+    for (int i = 0; i < DSP_VEC_LANES; i++)
+        total += v[i];
+    return total;
+}
+
+double scoreFrameSharpness(const void *pixels, uint32_t width, uint32_t height, int bpp, int channels, bool mosaic,
+                           uint32_t maxSize)
+{
+    if (pixels == nullptr || (bpp != 8 && bpp != 16) || channels < 1 || maxSize == 0)
+        return 0;
+
+    uint32_t factor = std::max<uint32_t>(1, (std::max(width, height) + maxSize - 1) / maxSize);
+    if (mosaic)
+        factor = std::max<uint32_t>(2, factor + factor % 2);
+
+    uint32_t const binnedWidth = width / factor, binnedHeight = height / factor;
+    if (binnedWidth < 2 || binnedHeight < 2)
+        return 0;
+
+    std::vector<dsp_t> binned(static_cast<size_t>(binnedWidth) * binnedHeight, 0);
+    if (bpp == 8)
+        bin(static_cast<const uint8_t *>(pixels), width, channels, factor, binnedWidth, binnedHeight, binned);
+    else
+        bin(static_cast<const uint16_t *>(pixels), width, channels, factor, binnedWidth, binnedHeight, binned);
+
+    // Squared differences to the right and bottom neighbours, summed a row at a time to keep the precision
+    double energy = 0, total = 0;
+    for (uint32_t y = 0; y + 1 < binnedHeight; y++)
+    {
+        const dsp_t *row = binned.data() + static_cast<size_t>(y) * binnedWidth, *next = row + binnedWidth;
+        dsp_vec_t rowEnergy = {}, rowTotal = {};
+        uint32_t x = 0;
+        for (; x + DSP_VEC_LANES < binnedWidth; x += DSP_VEC_LANES)
+        {
+            dsp_vec_t const value = dsp_vec_load(row + x);
+            dsp_vec_t const dx = dsp_vec_load(row + x + 1) - value;
+            dsp_vec_t const dy = dsp_vec_load(next + x) - value;
+            rowEnergy += dx * dx + dy * dy;
+            rowTotal += value;
+        }
+        energy += sum(rowEnergy);
+        total += sum(rowTotal);
+
+        for (; x + 1 < binnedWidth; x++)
+        {
+            double const dx = row[x + 1] - row[x], dy = next[x] - row[x];
+            energy += dx * dx + dy * dy;
+            total += row[x];
+        }
+    }
+
+    double const count = static_cast<double>(binnedWidth - 1) * (binnedHeight - 1);
+    double const mean = total / count;
+    return mean > 0 ? energy / count / (mean * mean) : 0;
+}
+
+}
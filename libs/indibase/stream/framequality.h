@@ -0,0 +1,36 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <cstdint>
+
+namespace INDI
+{
+
+/**
+ * @brief Scores the sharpness of a frame of unsigned pixels of bpp bits, 8 or 16, with channels interleaved samples
+ * each, to pick the best frames of a planetary capture.
+ *
+ * The frame is binned down to at most maxSize pixels a side, which also averages out the noise that would pass for
+ * detail, and the score is the gradient energy of the binned frame divided by its squared mean, so that frames
+ * only differing in brightness score the same. Colour filter arrays are binned by even factors so that their
+ * pattern cancels out, when mosaic is set.
+ * @return The score, higher for sharper frames, 0 if the frame is too small or black.
+ */
+double scoreFrameSharpness(const void *pixels, uint32_t width, uint32_t height, int bpp, int channels = 1,
+                           bool mosaic = false, uint32_t maxSize = 512);
+
+}
@@ -22,6 +22,7 @@
 */
 #include "gammalut16.h"
 #include <cmath>
+#include <cstring>
 
 GammaLut16::GammaLut16(double gamma, double a, double b, double Ii)
 {
@@ -50,6 +51,31 @@ void GammaLut16::apply(const uint16_t *first, const uint16_t *last, uint8_t *des
 {
     const uint8_t *lookUpTable = mLookUpTable.data();
 
+    // Eight independent lookups stored at once, rather than a chain of byte stores
+    for (; last - first >= 8; first += 8, destination += 8)
+    {
+        uint64_t packed = 0;
+        for (int i = 0; i < 8; ++i)
+        {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            packed |= uint64_t(lookUpTable[first[i]]) << (56 - 8 * i);
+#else
+            packed |= uint64_t(lookUpTable[first[i]]) << (8 * i);
+#endif
+        }
+        memcpy(destination, &packed, sizeof(packed));
+    }
+
     while (first != last)
         *destination++ = lookUpTable[*first++];
 }
+
+void GammaLut16::apply(const uint16_t *source, size_t width, size_t height, size_t stride, uint8_t *destination) const
+{
+    for (size_t i = 0; i < height; ++i)
+    {
+        apply(source, source + width, destination);
+        source += stride;
+        destination += width;
+    }
+}
@@ -35,6 +35,10 @@ class GammaLut16
         void apply(const uint16_t *source, size_t count, uint8_t *destination) const;
         void apply(const uint16_t *first, const uint16_t *last, uint8_t *destination) const;
 
+        // Maps height rows of width values, stride values apart in source, to consecutive rows of destination:
+        // the subframe of a frame is cut and downscaled in the same pass
+        void apply(const uint16_t *source, size_t width, size_t height, size_t stride, uint8_t *destination) const;
+
     protected:
         std::vector<uint8_t> mLookUpTable;
 };
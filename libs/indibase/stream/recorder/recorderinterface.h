@@ -71,6 +71,11 @@ class RecorderInterface
             m_FPS = FPS;
             return true;
         }
+        // Set the number of frames the next recording should hold, 0 if unknown, so the file can be reserved
+        virtual void setExpectedFrames(uint32_t frames)
+        {
+            m_ExpectedFrames = frames;
+        }
         virtual bool open(const char *filename, char *errmsg)                          = 0;
         virtual bool close()                                                           = 0;
         // when frame is in known encoding format
@@ -79,10 +84,28 @@ class RecorderInterface
         // and no need to do any further subframing operations. Otherwise, subframing must be done.
         // This is to reduce process time and save memory for a dedicated subframe buffer
         virtual void setStreamEnabled(bool enable) = 0;
+        // Quality, 0 to 100, and speed, 0 for the best compression to 100 for the fastest, of recorders that
+        // encode the frames, taken by the next open()
+        virtual bool setEncoderSettings(uint8_t quality, uint8_t speed)
+        {
+            INDI_UNUSED(quality);
+            INDI_UNUSED(speed);
+            return false;
+        }
+        // Frames dropped because the recorder could not keep up, and frames written late, since open()
+        virtual uint32_t droppedFrames() const
+        {
+            return 0;
+        }
+        virtual uint32_t lateFrames() const
+        {
+            return 0;
+        }
 
     protected:
         const char *name;
         float m_FPS = 1;
+        uint32_t m_ExpectedFrames = 0;
 };
 
 }
@@ -28,18 +28,33 @@
 #include "serrecorder.h"
 #include "jpegutils.h"
 
+#include <algorithm>
 #include <ctime>
 #include <cerrno>
 #include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 
 #define ERRMSGSIZ 1024
 
+namespace
+{
+
+// Memory the queued frames may take, and the size of the writes to the file, a multiple of the disk blocks
+constexpr size_t RING_BYTES  = 512u << 20;
+constexpr size_t CHUNK_BYTES = 8u << 20;
+
+// Frames written more than this after they were queued are counted as late
+constexpr auto LATE_DELAY = std::chrono::seconds(1);
+
+}
+
 namespace INDI
 {
 
-SER_Recorder::SER_Recorder()
+SER_Recorder::SER_Recorder() : framePool(RING_BYTES)
 {
     name = "SER";
     strncpy(serh.FileID, "INDI-RECORDER", 14);
@@ -53,13 +68,13 @@ SER_Recorder::SER_Recorder()
     // always default to. LITTLE_ENDIAN appears to be ignored by them leading to garbled data.
     serh.LittleEndian = SER_BIG_ENDIAN;
     isRecordingActive = false;
-    f = nullptr;
 
     jpegBuffer = static_cast<uint8_t*>(malloc(1));
 }
 
 SER_Recorder::~SER_Recorder()
 {
+    close();
     free(jpegBuffer);
 }
 
@@ -70,49 +85,35 @@ bool SER_Recorder::is_little_endian()
     return black_magic == 0x01;
 }
 
-void SER_Recorder::write_int_le(uint32_t *i)
+void SER_Recorder::write_int_le(std::vector<uint8_t> &out, uint32_t i)
 {
-    if (is_little_endian())
-        fwrite((i), sizeof(uint32_t), 1, f);
-    else
-    {
-        unsigned char *c = (unsigned char *)i;
-        fwrite((c + 3), sizeof(char), 1, f);
-        fwrite((c + 2), sizeof(char), 1, f);
-        fwrite((c + 1), sizeof(char), 1, f);
-        fwrite((c), sizeof(char), 1, f);
-    }
+    out.push_back(i & 0xFF);
+    out.push_back((i >> 8) & 0xFF);
+    out.push_back((i >> 16) & 0xFF);
+    out.push_back((i >> 24) & 0xFF);
 }
 
-void SER_Recorder::write_long_int_le(uint64_t *i)
+void SER_Recorder::write_long_int_le(std::vector<uint8_t> &out, uint64_t i)
 {
-    if (is_little_endian())
-    {
-        fwrite(((uint32_t *)i), sizeof(int), 1, f);
-        fwrite(((uint32_t *)(i) + 1), sizeof(int), 1, f);
-    }
-    else
-    {
-        write_int_le((uint32_t *)(i) + 1);
-        write_int_le((uint32_t *)(i));
-    }
+    write_int_le(out, static_cast<uint32_t>(i));
+    write_int_le(out, static_cast<uint32_t>(i >> 32));
 }
 
-void SER_Recorder::write_header(ser_header *s)
+void SER_Recorder::write_header(ser_header *s, std::vector<uint8_t> &out)
 {
-    fwrite((s->FileID), sizeof(char), 14, f);
-    write_int_le(&(s->LuID));
-    write_int_le(&(s->ColorID));
-    write_int_le(&(s->LittleEndian));
-    write_int_le(&(s->ImageWidth));
-    write_int_le(&(s->ImageHeight));
-    write_int_le(&(s->PixelDepth));
-    write_int_le(&(s->FrameCount));
-    fwrite((s->Observer), sizeof(char), 40, f);
-    fwrite((s->Instrume), sizeof(char), 40, f);
-    fwrite((s->Telescope), sizeof(char), 40, f);
-    write_long_int_le(&(s->DateTime));
-    write_long_int_le(&(s->DateTime_UTC));
+    out.insert(out.end(), s->FileID, s->FileID + 14);
+    write_int_le(out, s->LuID);
+    write_int_le(out, s->ColorID);
+    write_int_le(out, s->LittleEndian);
+    write_int_le(out, s->ImageWidth);
+    write_int_le(out, s->ImageHeight);
+    write_int_le(out, s->PixelDepth);
+    write_int_le(out, s->FrameCount);
+    out.insert(out.end(), s->Observer, s->Observer + 40);
+    out.insert(out.end(), s->Instrume, s->Instrume + 40);
+    out.insert(out.end(), s->Telescope, s->Telescope + 40);
+    write_long_int_le(out, s->DateTime);
+    write_long_int_le(out, s->DateTime_UTC);
 }
 
 bool SER_Recorder::setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth)
@@ -175,46 +176,187 @@ bool SER_Recorder::open(const char *filename, char *errmsg)
     if (isRecordingActive)
         return false;
     serh.FrameCount = 0;
-    if ((f = fopen(filename, "w")) == nullptr)
+
+    int const flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    // Not every file system takes O_DIRECT, tmpfs for one
+    fd = ::open(filename, flags | O_DIRECT, 0644);
+    directIO = (fd >= 0);
+    if (fd < 0)
+#endif
+        fd = ::open(filename, flags, 0644);
+    if (fd < 0)
     {
         snprintf(errmsg, ERRMSGSIZ, "recorder open error %d, %s\n", errno, strerror(errno));
         return false;
     }
 
+    chunk = framePool.acquire(CHUNK_BYTES);
+    if (chunk.empty())
+    {
+        snprintf(errmsg, ERRMSGSIZ, "recorder open error, out of memory\n");
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+
     serh.DateTime     = getLocalTimeStamp();
     serh.DateTime_UTC = getUTCTimeStamp();
-    write_header(&serh);
     frame_size        = serh.ImageWidth * serh.ImageHeight * (serh.PixelDepth <= 8 ? 1 : 2) * number_of_planes;
-    isRecordingActive = true;
+
+    // The header goes first, it is written again with the frame count on close
+    std::vector<uint8_t> header;
+    write_header(&serh, header);
+    memcpy(chunk.data(), header.data(), header.size());
+    chunkUsed  = header.size();
+    fileOffset = 0;
+
+#ifdef __linux__
+    // Reserve the file of a recording of known length, so the file system does not allocate it as it grows
+    if (m_ExpectedFrames > 0 && m_PixelFormat != INDI_JPG)
+    {
+        off_t const size = header.size() + static_cast<off_t>(m_ExpectedFrames) * (frame_size + sizeof(uint64_t));
+        // Failing is harmless, the file then grows as it is written
+        fallocate(fd, 0, 0, size);
+    }
+#endif
+
+    // As many frames as fit in RING_BYTES, a power of two
+    size_t capacity = 4;
+    while (capacity < 1024 && capacity * 2 * frame_size <= RING_BYTES)
+        capacity *= 2;
+    frames.reset(new RingQueue<QueuedFrame>(capacity, RingQueue<QueuedFrame>::DropNewest));
 
     frameStamps.clear();
+    framesDropped = 0;
+    framesLate    = 0;
+    framesWritten = 0;
+    writeFailed   = false;
+
+    isRecordingActive = true;
+    writer = std::thread(&SER_Recorder::writeFrames, this);
 
     return true;
 }
 
 bool SER_Recorder::close()
 {
-    if (f)
+    bool rc = true;
+    if (fd >= 0)
     {
+        // Let the writer empty the ring, then stop it
+        frames->waitForEmpty();
+        frames->abort();
+        writer.join();
+
+        serh.FrameCount = framesWritten;
+
         // Write all timestamps
+        std::vector<uint8_t> trailer;
+        trailer.reserve(frameStamps.size() * sizeof(uint64_t));
         for (auto value : frameStamps)
-            write_long_int_le(&value);
-
+            write_long_int_le(trailer, value);
         frameStamps.clear();
+        rc = !writeFailed && append(trailer.data(), trailer.size());
 
-        fseek(f, 0L, SEEK_SET);
-        write_header(&serh);
-        fclose(f);
-        f = nullptr;
+        // The last chunk is not made of whole blocks, it goes through the page cache
+#ifdef O_DIRECT
+        if (directIO)
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+#endif
+        directIO = false;
+        rc = rc && writeChunk(chunk.data(), chunkUsed);
+
+        // Drop the reserved space past the end, and update the header
+        std::vector<uint8_t> header;
+        write_header(&serh, header);
+        if (ftruncate(fd, fileOffset) != 0 || pwrite(fd, header.data(), header.size(), 0) != static_cast<ssize_t>(header.size()))
+            rc = false;
+
+        ::close(fd);
+        fd = -1;
+        chunk.release();
+        frames.reset();
     }
 
     isRecordingActive = false;
+    return rc;
+}
+
+bool SER_Recorder::writeChunk(const uint8_t *data, size_t size)
+{
+    size_t done = 0;
+    while (done < size)
+    {
+        ssize_t const written = pwrite(fd, data + done, size - done, fileOffset + done);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+#ifdef O_DIRECT
+            // The file system takes O_DIRECT but not with these alignments
+            if (errno == EINVAL && directIO)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+                directIO = false;
+                continue;
+            }
+#endif
+            return false;
+        }
+        done += written;
+    }
+    fileOffset += size;
+    return true;
+}
+
+bool SER_Recorder::append(const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        size_t const count = std::min(size, chunk.size() - chunkUsed);
+        memcpy(chunk.data() + chunkUsed, data, count);
+        chunkUsed += count;
+        data += count;
+        size -= count;
+
+        if (chunkUsed == chunk.size())
+        {
+            if (!writeChunk(chunk.data(), chunkUsed))
+                return false;
+            chunkUsed = 0;
+        }
+    }
     return true;
 }
 
+void SER_Recorder::writeFrames()
+{
+    QueuedFrame queued;
+    while (frames->pop(queued))
+    {
+        // After a write error, frames are taken from the ring and dropped until the recording closes
+        if (writeFailed == false)
+        {
+            if (append(queued.data.data(), queued.data.size()))
+            {
+                frameStamps.push_back(queued.timestamp);
+                framesWritten++;
+            }
+            else
+                writeFailed = true;
+        }
+
+        if (std::chrono::steady_clock::now() - queued.queued > LATE_DELAY)
+            framesLate++;
+        queued.data.release();
+    }
+}
+
 bool SER_Recorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t timestamp)
 {
-    if (!isRecordingActive)
+    // Stop the recording once the writer failed
+    if (!isRecordingActive || writeFailed)
         return false;
 
 #if 0
@@ -253,10 +395,9 @@ bool SER_Recorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t ti
     }
 #endif
 
-    if(timestamp)
-        frameStamps.push_back(timestamp * m_sepaseconds_per_microsecond);
-    else
-        frameStamps.push_back(getUTCTimeStamp());
+    QueuedFrame queued;
+    queued.timestamp = timestamp ? unixTo64BitTS(timestamp) : getUTCTimeStamp();
+    queued.queued    = std::chrono::steady_clock::now();
 
     // Not technically pixel format, but let's use this for now.
     if (m_PixelFormat == INDI_JPG)
@@ -269,11 +410,21 @@ bool SER_Recorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t ti
         serh.ImageWidth = w;
         serh.ImageHeight = h;
         serh.ColorID = (naxis == 3) ? SER_RGB : SER_MONO;
-        fwrite(jpegBuffer, 1, memsize, f);
+        frame = jpegBuffer;
+        nbytes = memsize;
     }
-    else
-        fwrite(frame, 1, nbytes, f);
-    serh.FrameCount += 1;
+
+    // The frame is copied, the stream reuses its buffer once this returns
+    queued.data = framePool.acquire(nbytes);
+    if (queued.data.empty())
+    {
+        framesDropped++;
+        return true;
+    }
+    memcpy(queued.data.data(), frame, nbytes);
+
+    if (frames->push(std::move(queued)) == false)
+        framesDropped++;
     return true;
 }
 
@@ -327,6 +478,18 @@ uint64_t SER_Recorder::getUTCTimeStamp()
     return utcTS;
 }
 
+uint64_t SER_Recorder::unixTo64BitTS(uint64_t microseconds)
+{
+    static uint64_t const epoch = [this]()
+    {
+        uint64_t ts;
+        dateTo64BitTS(1970, 1, 1, 0, 0, 0, 0, &ts);
+        return ts;
+    }();
+
+    return epoch + microseconds * m_sepaseconds_per_microsecond;
+}
+
 uint64_t SER_Recorder::getLocalTimeStamp()
 {
     uint64_t localTS;
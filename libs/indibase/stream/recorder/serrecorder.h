@@ -22,9 +22,15 @@
 #pragma once
 
 #include "recorderinterface.h"
+#include "indibufferpool.h"
+#include "ringqueue.h"
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <stdio.h>
+#include <thread>
 
 typedef struct ser_header
 {
@@ -66,6 +72,11 @@ namespace INDI
 
 /**
  * @brief The SER_Recorder class implements recording of video streams in SER format.
+ *
+ * Frames are copied to a bounded ring and written by a thread of the recorder, so the stream thread never
+ * waits on the disk: when the disk falls behind for longer than the ring lasts, frames are dropped and
+ * counted. The file is written in large page aligned chunks, bypassing the page cache with O_DIRECT where
+ * the file system supports it, and a recording of known length reserves its whole file when it opens.
  */
 class SER_Recorder : public RecorderInterface
 {
@@ -87,24 +98,56 @@ class SER_Recorder : public RecorderInterface
         {
             isStreamingActive = enable;
         }
+        virtual uint32_t droppedFrames() const
+        {
+            return framesDropped;
+        }
+        virtual uint32_t lateFrames() const
+        {
+            return framesLate;
+        }
 
         // Public constants
         static const uint64_t C_SEPASECONDS_PER_SECOND = 10000000;
 
     protected:
+        struct QueuedFrame
+        {
+            BufferPool::Buffer data;
+            uint64_t timestamp {0};
+            std::chrono::steady_clock::time_point queued;
+        };
+
         uint64_t utcTo64BitTS();
         bool is_little_endian();
-        void write_int_le(uint32_t *i);
-        void write_long_int_le(uint64_t *i);
-        void write_header(ser_header *s);
+        void write_int_le(std::vector<uint8_t> &out, uint32_t i);
+        void write_long_int_le(std::vector<uint8_t> &out, uint64_t i);
+        void write_header(ser_header *s, std::vector<uint8_t> &out);
+
+        // Writer thread: writes the queued frames until the ring is aborted
+        void writeFrames();
+        // Appends to the file through the chunk buffer, writing it out each time it is full
+        bool append(const uint8_t *data, size_t size);
+        bool writeChunk(const uint8_t *data, size_t size);
+
         ser_header serh;
         bool isRecordingActive = false, isStreamingActive = false;
-        FILE *f;
+        int fd = -1;
+        bool directIO = false;
         uint32_t frame_size;
         uint32_t number_of_planes;
         uint16_t rawWidth = 0, rawHeight = 0;
         std::vector<uint64_t> frameStamps;
 
+        BufferPool framePool;
+        std::unique_ptr<RingQueue<QueuedFrame>> frames;
+        std::thread writer;
+        BufferPool::Buffer chunk;
+        size_t chunkUsed = 0;
+        uint64_t fileOffset = 0;
+        std::atomic<bool> writeFailed {false};
+        std::atomic<uint32_t> framesDropped {0}, framesLate {0}, framesWritten {0};
+
     private:
         // From pipp_timestamp.h
         // Copyright (C) 2015 Chris Garry
@@ -115,6 +158,8 @@ class SER_Recorder : public RecorderInterface
 
         uint64_t getUTCTimeStamp();
         uint64_t getLocalTimeStamp();
+        // Microseconds since the Unix epoch to 64bit timestamp
+        uint64_t unixTo64BitTS(uint64_t microseconds);
 
         // Calculate if a year is a leap yer
         ///
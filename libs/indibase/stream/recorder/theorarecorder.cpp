@@ -25,6 +25,7 @@
 
 #define _FILE_OFFSET_BITS 64
 
+#include <algorithm>
 #include <ctime>
 #include <cerrno>
 #include <cstring>
@@ -32,6 +33,22 @@
 
 #define ERRMSGSIZ 1024
 
+namespace
+{
+
+// Memory the queued frames may take
+constexpr size_t RING_BYTES = 256u << 20;
+
+// Frames encoded more than this after they were queued are counted as late
+constexpr auto LATE_DELAY = std::chrono::seconds(1);
+
+uint64_t steadyMicroseconds()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
 static int ilog(unsigned _v)
 {
     int ret;
@@ -42,25 +59,35 @@ static int ilog(unsigned _v)
 namespace INDI
 {
 
-TheoraRecorder::TheoraRecorder()
+TheoraRecorder::TheoraRecorder() : framePool(RING_BYTES)
 {
     name = "OGV";
     isRecordingActive = false;
 
-    ycbcr[0].data = nullptr;
-    ycbcr[1].data = nullptr;
-    ycbcr[2].data = nullptr;
+    for (auto &buffer : ycbcr)
+        for (auto &plane : buffer)
+            plane.data = nullptr;
 }
 
 TheoraRecorder::~TheoraRecorder()
 {
-    delete [] ycbcr[0].data;
-    delete [] ycbcr[1].data;
-    delete [] ycbcr[2].data;
+    if (isRecordingActive)
+        close();
+
+    for (auto &buffer : ycbcr)
+        for (auto &plane : buffer)
+            delete [] plane.data;
 
     th_encode_free(td);
 }
 
+bool TheoraRecorder::setEncoderSettings(uint8_t quality, uint8_t speed)
+{
+    m_Quality = std::min<uint8_t>(quality, 100);
+    m_Speed   = std::min<uint8_t>(speed, 100);
+    return true;
+}
+
 bool TheoraRecorder::setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth)
 {
     m_PixelFormat = pixelFormat;
@@ -86,48 +113,32 @@ bool TheoraRecorder::allocateBuffers()
     /* Must hold: yuv_h >= h */
     uint16_t yuv_h = (rawHeight + 15) & ~15;
 
+    /* The conversions write even sizes, their rows following each other */
+    picWidth  = rawWidth & ~1;
+    picHeight = rawHeight & ~1;
+
     /* Do we need to allocate a buffer */
-    if (!ycbcr[0].data || yuv_w != ycbcr[0].width || yuv_h != ycbcr[0].height)
+    if (!ycbcr[0][0].data || yuv_w != ycbcr[0][0].width || yuv_h != ycbcr[0][0].height || picWidth != ycbcr[0][0].stride)
     {
-        ycbcr[0].width = yuv_w;
-        ycbcr[0].height = yuv_h;
-        ycbcr[0].stride = yuv_w;
-#if 0
-        if (m_PixelFormat == INDI_MONO)
-        {
-            ycbcr[1].width = 0;
-            ycbcr[1].stride = 0;
-            ycbcr[1].height = 0;
-            ycbcr[2].width = 0;
-            ycbcr[2].stride = 0;
-            ycbcr[2].height = 0;
-        }
-        else
+        for (auto &buffer : ycbcr)
         {
-#endif
-            ycbcr[1].width = (chroma_format == TH_PF_444) ? yuv_w : (yuv_w >> 1);
-            ycbcr[1].stride = ycbcr[1].width;
-            ycbcr[1].height = (chroma_format == TH_PF_420) ? (yuv_h >> 1) : yuv_h;
-            ycbcr[2].width = ycbcr[1].width;
-            ycbcr[2].stride = ycbcr[1].stride;
-            ycbcr[2].height = ycbcr[1].height;
-#if 0
+            buffer[0].width = yuv_w;
+            buffer[0].height = yuv_h;
+            buffer[0].stride = picWidth;
+            buffer[1].width = (chroma_format == TH_PF_444) ? yuv_w : (yuv_w >> 1);
+            buffer[1].stride = (chroma_format == TH_PF_444) ? picWidth : (picWidth >> 1);
+            buffer[1].height = (chroma_format == TH_PF_420) ? (yuv_h >> 1) : yuv_h;
+            buffer[2].width = buffer[1].width;
+            buffer[2].stride = buffer[1].stride;
+            buffer[2].height = buffer[1].height;
+
+            /* Planes hold whole frames of frame_width, though the encoder reads the picture only */
+            for (auto &plane : buffer)
+            {
+                delete [] plane.data;
+                plane.data = new uint8_t[plane.stride * plane.height + (plane.width - plane.stride)];
+            }
         }
-#endif
-
-        delete [] ycbcr[0].data;
-        delete [] ycbcr[1].data;
-        delete [] ycbcr[2].data;
-
-        ycbcr[0].data = new uint8_t[ycbcr[0].stride * ycbcr[0].height];
-        ycbcr[1].data = new uint8_t[ycbcr[1].stride * ycbcr[1].height];
-        ycbcr[2].data = new uint8_t[ycbcr[2].stride * ycbcr[2].height];
-
-#if 0
-        ycbcr[0].data = new uint8_t[ycbcr[0].stride * ycbcr[0].height];
-        ycbcr[1].data = (m_PixelFormat == INDI_MONO) ? 0 : new uint8_t[ycbcr[1].stride * ycbcr[1].height];
-        ycbcr[2].data = (m_PixelFormat == INDI_MONO) ? 0 : new uint8_t[ycbcr[2].stride * ycbcr[2].height];
-#endif
     }
 
     return true;
@@ -138,6 +149,9 @@ bool TheoraRecorder::open(const char *filename, char *errmsg)
     if (isRecordingActive)
         return false;
 
+    // Quality 0 to 63, unless a bitrate is set
+    video_quality = (m_Quality * 63 + 50) / 100;
+
     if(soft_target)
     {
         if(video_rate <= 0)
@@ -181,11 +195,12 @@ bool TheoraRecorder::open(const char *filename, char *errmsg)
     th_info_init(&ti);
     ti.frame_width = ((rawWidth + 15) >> 4) << 4;
     ti.frame_height = ((rawHeight + 15) >> 4) << 4;
-    ti.pic_width = rawWidth;
-    ti.pic_height = rawHeight;
+    ti.pic_width = picWidth;
+    ti.pic_height = picHeight;
     ti.pic_x = 0;
     ti.pic_y = 0;
-    frac(m_FPS, video_fps_numerator, video_fps_denominator);
+    // The rate is not known yet before the first frames of a stream
+    frac(m_FPS > 0 ? m_FPS : 1, video_fps_numerator, video_fps_denominator);
     ti.fps_numerator = video_fps_numerator;
     ti.fps_denominator = video_fps_denominator;
     ti.aspect_numerator = video_aspect_numerator;
@@ -196,8 +211,25 @@ bool TheoraRecorder::open(const char *filename, char *errmsg)
     ti.quality = video_quality;
     ti.keyframe_granule_shift = ilog(keyframe_frequency - 1);
 
+    th_encode_free(td);
     td = th_encode_alloc(&ti);
     th_info_clear(&ti);
+    if (td == nullptr)
+    {
+        snprintf(errmsg, ERRMSGSIZ, "Could not create the Theora encoder for %dx%d frames.", picWidth, picHeight);
+        fclose(ogg_fp);
+        ogg_fp = nullptr;
+        ogg_stream_clear(&ogg_os);
+        return false;
+    }
+
+    // Speed levels go from 0, the slowest, to a maximum that keeps up with live video
+    int maxLevel = 0;
+    if (th_encode_ctl(td, TH_ENCCTL_GET_SPLEVEL_MAX, &maxLevel, sizeof(maxLevel)) == 0)
+    {
+        int level = (m_Speed * maxLevel + 50) / 100;
+        th_encode_ctl(td, TH_ENCCTL_SET_SPLEVEL, &level, sizeof(level));
+    }
     /* setting just the granule shift only allows power-of-two keyframe
        spacing.  Set the actual requested spacing. */
     int ret = th_encode_ctl(td, TH_ENCCTL_SET_KEYFRAME_FREQUENCY_FORCE, &keyframe_frequency, sizeof(keyframe_frequency - 1));
@@ -356,14 +388,39 @@ bool TheoraRecorder::open(const char *filename, char *errmsg)
         }
     }
 
+    // As many frames as fit in RING_BYTES, a power of two
+    size_t const frameBytes = std::max<size_t>(static_cast<size_t>(rawWidth) * rawHeight * 3, 1);
+    size_t capacity = 4;
+    while (capacity < 256 && capacity * 2 * frameBytes <= RING_BYTES)
+        capacity *= 2;
+    frames.reset(new RingQueue<QueuedFrame>(capacity, RingQueue<QueuedFrame>::DropNewest));
+
+    pending        = -1;
+    pendingIndex   = 0;
+    firstTimestamp = 0;
+    framesDropped  = 0;
+    framesLate     = 0;
+
     isRecordingActive = true;
+    encoder = std::thread(&TheoraRecorder::encodeFrames, this);
 
     return true;
 }
 
 bool TheoraRecorder::close()
 {
-    theora_write_frame(1);
+    if (!isRecordingActive)
+        return true;
+
+    // Let the encoder empty the ring, then stop it
+    frames->waitForEmpty();
+    frames->abort();
+    encoder.join();
+
+    // The last frame lasts a single frame
+    if (pending >= 0)
+        theora_write_frame(ycbcr[pending], 0, 1);
+    pending = -1;
 
     if(passno == 1)
     {
@@ -407,40 +464,111 @@ bool TheoraRecorder::close()
         fclose(ogg_fp);
     }
 
+    ogg_fp = nullptr;
+
     ogg_stream_clear(&ogg_os);
     if(twopass_file)
         fclose(twopass_file);
+    twopass_file = nullptr;
 
     isRecordingActive = false;
     return true;
 }
 
-bool TheoraRecorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t)
+bool TheoraRecorder::writeFrame(const uint8_t *frame, uint32_t nbytes, uint64_t timestamp)
 {
     if (!isRecordingActive)
         return false;
 
+    if (m_PixelFormat != INDI_MONO && m_PixelFormat != INDI_RGB && m_PixelFormat != INDI_JPG)
+        return false;
+
+    QueuedFrame queued;
+    queued.timestamp = timestamp ? timestamp : steadyMicroseconds();
+    queued.queued    = std::chrono::steady_clock::now();
+
+    // The frame is copied, the stream reuses its buffer once this returns
+    queued.data = framePool.acquire(nbytes);
+    if (queued.data.empty())
+    {
+        framesDropped++;
+        return true;
+    }
+    memcpy(queued.data.data(), frame, nbytes);
+
+    if (frames->push(std::move(queued)) == false)
+        framesDropped++;
+    return true;
+}
+
+void TheoraRecorder::encodeFrames()
+{
+    // Frames are numbered from the first one at the rate of the file
+    double const framesPerMicrosecond = static_cast<double>(video_fps_numerator) / video_fps_denominator / 1e6;
+    // Libtheora repeats a frame less than a keyframe interval
+    uint64_t const maxDuplicates = keyframe_frequency > 1 ? keyframe_frequency - 1 : 0;
+
+    QueuedFrame queued;
+    while (frames->pop(queued))
+    {
+        if (pending < 0)
+            firstTimestamp = queued.timestamp;
+
+        uint64_t const elapsed = queued.timestamp > firstTimestamp ? queued.timestamp - firstTimestamp : 0;
+        uint64_t const index = static_cast<uint64_t>(elapsed * framesPerMicrosecond + 0.5);
+
+        // The slot of this frame is taken, it is skipped rather than encoded
+        if (pending >= 0 && index <= pendingIndex)
+        {
+            queued.data.release();
+            continue;
+        }
+
+        int const next = (pending < 0) ? 0 : 1 - pending;
+        if (convertFrame(queued, ycbcr[next]))
+        {
+            // The pending frame lasts until this one
+            if (pending >= 0)
+                theora_write_frame(ycbcr[pending], std::min(index - pendingIndex - 1, maxDuplicates), 0);
+            pending      = next;
+            pendingIndex = index;
+        }
+
+        if (std::chrono::steady_clock::now() - queued.queued > LATE_DELAY)
+            framesLate++;
+        queued.data.release();
+    }
+}
+
+bool TheoraRecorder::convertFrame(const QueuedFrame &frame, th_ycbcr_buffer buffer)
+{
+    const uint8_t *data = frame.data.data();
+
     if (m_PixelFormat == INDI_MONO)
     {
-        memcpy(ycbcr[0].data, frame, ycbcr[0].stride * ycbcr[0].height);
+        if (frame.data.size() < static_cast<size_t>(rawWidth) * rawHeight)
+            return false;
+        for (uint16_t row = 0; row < picHeight; row++)
+            memcpy(buffer[0].data + row * buffer[0].stride, data + row * rawWidth, picWidth);
         // Cb and Cr values to 0x80 (128) for grayscale image
-        memset(ycbcr[1].data, 0x80, ycbcr[1].stride * ycbcr[1].height);
-        memset(ycbcr[2].data, 0x80, ycbcr[2].stride * ycbcr[2].height);
+        memset(buffer[1].data, 0x80, buffer[1].stride * buffer[1].height);
+        memset(buffer[2].data, 0x80, buffer[2].stride * buffer[2].height);
     }
     else if (m_PixelFormat == INDI_RGB)
     {
-        BGR2YUV(rawWidth, rawHeight, const_cast<uint8_t*>(frame), ycbcr[0].data, ycbcr[1].data, ycbcr[2].data, 0);
+        if (frame.data.size() < static_cast<size_t>(rawWidth) * rawHeight * 3)
+            return false;
+        ccvt_rgb24_420p(rawWidth, rawHeight, data, buffer[0].data, buffer[1].data, buffer[2].data);
     }
     else if (m_PixelFormat == INDI_JPG)
     {
-        decode_jpeg_raw((const_cast<uint8_t *>(frame)), nbytes, 0, 0, rawWidth, rawHeight, ycbcr[0].data, ycbcr[1].data,
-                        ycbcr[2].data );
+        if (decode_jpeg_raw(const_cast<uint8_t *>(data), frame.data.size(), 0, 0, picWidth, picHeight,
+                            buffer[0].data, buffer[1].data, buffer[2].data) < 0)
+            return false;
     }
     else
         return false;
 
-    theora_write_frame(0);
-
     return true;
 }
 
@@ -487,14 +615,18 @@ bool TheoraRecorder::writeFrameColor(uint8_t *frame)
 
 
 
-int TheoraRecorder::theora_write_frame(int last)
+int TheoraRecorder::theora_write_frame(th_ycbcr_buffer buffer, int duplicates, int last)
 {
     ogg_packet op;
     ogg_page og;
 
     int rc = -1;
 
-    if( (rc = th_encode_ycbcr_in(td, ycbcr)) )
+    /* the frame is followed by as many duplicates, cheap packets shown at its place */
+    if (duplicates > 0)
+        th_encode_ctl(td, TH_ENCCTL_SET_DUP_COUNT, &duplicates, sizeof(duplicates));
+
+    if( (rc = th_encode_ycbcr_in(td, buffer)) )
     {
         IDLog("error: could not encode frame %d", rc);
         return rc;
@@ -521,20 +653,24 @@ int TheoraRecorder::theora_write_frame(int last)
         fflush(twopass_file);
     }
 
-    if(!th_encode_packetout(td, last, &op))
+    /* one packet for the frame, and one for each of its duplicates */
+    while ((rc = th_encode_packetout(td, last, &op)) > 0)
     {
-        IDLog("error: could not read packets");
-        return 1;
+        if (passno != 1)
+        {
+            ogg_stream_packetin(&ogg_os, &op);
+            while(ogg_stream_pageout(&ogg_os, &og))
+            {
+                fwrite(og.header, og.header_len, 1, ogg_fp);
+                fwrite(og.body, og.body_len, 1, ogg_fp);
+            }
+        }
     }
 
-    if (passno != 1)
+    if (rc < 0)
     {
-        ogg_stream_packetin(&ogg_os, &op);
-        while(ogg_stream_pageout(&ogg_os, &og))
-        {
-            fwrite(og.header, og.header_len, 1, ogg_fp);
-            fwrite(og.body, og.body_len, 1, ogg_fp);
-        }
+        IDLog("error: could not read packets");
+        return 1;
     }
 
     return 0;
@@ -22,18 +22,28 @@
 #pragma once
 
 #include "recorderinterface.h"
+#include "indibufferpool.h"
+#include "ringqueue.h"
 
 #include <ogg/ogg.h>
 #include <theora/theoraenc.h>
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
 #include <stdio.h>
+#include <thread>
 
 namespace INDI
 {
 
 /**
  * @brief The TheoraRecorder class implemented recording of video streaming data in a libtheora OGV file.
+ *
+ * writeFrame() queues a copy of the frames, converted to YUV and encoded by a thread of its own. A full
+ * queue drops the new frames. The file plays at the frame rate set before open(): each frame is shown until
+ * the time of the next one, frames coming faster than this rate are skipped and gaps repeat the last frame.
  */
 class TheoraRecorder : public RecorderInterface
 {
@@ -54,8 +64,24 @@ class TheoraRecorder : public RecorderInterface
         {
             isStreamingActive = enable;
         }
+        virtual bool setEncoderSettings(uint8_t quality, uint8_t speed);
+        virtual uint32_t droppedFrames() const
+        {
+            return framesDropped;
+        }
+        virtual uint32_t lateFrames() const
+        {
+            return framesLate;
+        }
 
     protected:
+        struct QueuedFrame
+        {
+            BufferPool::Buffer data;
+            uint64_t timestamp {0};
+            std::chrono::steady_clock::time_point queued;
+        };
+
         bool isRecordingActive = false, isStreamingActive = false;
         uint32_t number_of_planes;
         uint16_t rawWidth = 0, rawHeight = 0;
@@ -65,11 +91,27 @@ class TheoraRecorder : public RecorderInterface
 
     private:
         bool allocateBuffers();
-        //int theora_write_frame(th_ycbcr_buffer ycbcr, int last);
-        int theora_write_frame(int last);
+        // Encoder thread: converts and encodes the queued frames until the ring is aborted
+        void encodeFrames();
+        bool convertFrame(const QueuedFrame &frame, th_ycbcr_buffer buffer);
+        int theora_write_frame(th_ycbcr_buffer buffer, int duplicates, int last);
         bool frac(double fps, uint32_t &num, uint32_t &den);
 
-        th_ycbcr_buffer ycbcr;
+        // The pending frame, encoded once the time of the next one tells how long it lasts, and the next one
+        th_ycbcr_buffer ycbcr[2];
+        int pending = -1;
+        uint64_t pendingIndex = 0;
+        uint64_t firstTimestamp = 0;
+        uint16_t picWidth = 0, picHeight = 0;
+
+        BufferPool framePool;
+        std::unique_ptr<RingQueue<QueuedFrame>> frames;
+        std::thread encoder;
+        std::atomic<uint32_t> framesDropped {0}, framesLate {0};
+
+        uint8_t m_Quality = 75;
+        uint8_t m_Speed = 100;
+
         ogg_uint32_t video_fps_numerator = 24;
         ogg_uint32_t video_fps_denominator = 1;
         ogg_uint32_t video_aspect_numerator = 0;
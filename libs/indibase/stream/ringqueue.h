@@ -0,0 +1,417 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+#endif
+
+/**
+ * \class RingQueue template
+ * \brief The RingQueue class is a bounded lock-free FIFO for one producer and one consumer thread.
+ *
+ * It replaces UniqueQueue where a camera thread hands frames to a processing thread: neither side takes a lock
+ * to push or pop, and a waiting side is only woken with a system call (a futex on Linux) when it actually sleeps.
+ * When the ring is full, push either drops the new item or the oldest queued one, as chosen with setOverflow().
+ * As with UniqueQueue, items are moved in and out, so T should be cheap to move and default constructible.
+ */
+template <typename T>
+class RingQueue
+{
+    public:
+        enum Overflow
+        {
+            DropNewest, /*!< A push to a full ring drops the pushed item */
+            DropOldest  /*!< A push to a full ring drops the oldest queued item, keeping the latest ones */
+        };
+
+    public:
+        /**
+         * @brief Creates a ring of at least capacity items, rounded up to a power of two
+         */
+        explicit RingQueue(size_t capacity = 1024, Overflow overflow = DropNewest);
+
+        /**
+         * @brief Move data to the ring, from the producer thread
+         * @param data the data will be moved using std::move
+         * @return returns false if an item, data or the oldest one, was dropped because the ring was full
+         */
+        bool push(T &&data);
+
+        /**
+         * @brief Pop data from the ring, from the consumer thread
+         * @param dest the data will be swapped and destroyed
+         * @return returns false if the ring was aborted
+         */
+        bool pop(T &dest);
+
+        /**
+         * @brief Pop data from the ring, from the consumer thread
+         * @param dest the data will be swapped and destroyed
+         * @param msecs timeout in milliseconds
+         * @return returns false if timeout or the ring was aborted
+         */
+        bool pop(T &dest, uint32_t msecs);
+
+        /**
+         * @brief Wait for an empty ring
+         */
+        void waitForEmpty() const;
+
+        /**
+         * @brief Wait for an empty ring
+         * @param msecs timeout in milliseconds
+         * @return returns false if timeout
+         */
+        bool waitForEmpty(uint32_t msecs) const;
+
+        /**
+         * @brief Drop the oldest queued item, from any thread
+         * @return returns false if the ring was empty
+         */
+        bool drop();
+
+        /**
+         * @brief Drop the queued items, from any thread
+         */
+        void clear();
+
+        /**
+         * @brief Clear the ring and make the pop methods, waiting or not, return false until reset() is called
+         */
+        void abort();
+
+        /**
+         * @brief Undo abort()
+         */
+        void reset();
+
+        /**
+         * @brief Set what a push to a full ring drops, from the producer thread
+         */
+        void setOverflow(Overflow overflow);
+
+        /**
+         * @brief Return the number of items in the ring
+         * @return count of elements
+         */
+        size_t size() const;
+
+        /**
+         * @brief Return the number of items dropped by push since the ring was created
+         */
+        size_t dropped() const;
+
+    protected:
+        // Eventcount of one side of the ring: waiters sleep on a sequence number the other side bumps
+        class Event
+        {
+            public:
+                uint32_t prepare() const
+                {
+                    sleepers.fetch_add(1, std::memory_order_seq_cst);
+                    return sequence.load(std::memory_order_seq_cst);
+                }
+
+                void cancel() const
+                {
+                    sleepers.fetch_sub(1, std::memory_order_relaxed);
+                }
+
+                // Sleeps until notify() is called after prepare() returned value, false on timeout
+                bool wait(uint32_t value, const std::chrono::steady_clock::time_point *deadline) const;
+
+                void notify()
+                {
+                    sequence.fetch_add(1, std::memory_order_seq_cst);
+                    if (sleepers.load(std::memory_order_seq_cst) > 0)
+                        wake();
+                }
+
+            private:
+                void wake();
+
+            private:
+                mutable std::atomic<uint32_t> sequence {0};
+                mutable std::atomic<int> sleepers {0};
+#ifndef __linux__
+                mutable std::mutex mutex;
+                mutable std::condition_variable condition;
+#endif
+        };
+
+        // Claims the oldest item, moves it to dest and frees its slot, false if the ring is empty
+        bool take(T &dest);
+
+        // Waits on event until ready() holds, false on timeout
+        template <typename Ready>
+        bool waitUntil(const Event &event, Ready ready, const std::chrono::steady_clock::time_point *deadline) const;
+
+    protected:
+        std::vector<T> slots;
+        size_t mask;
+        Overflow overflow;
+
+        // Items ever pushed, claimed to be popped, and popped: released <= claimed <= head
+        alignas(64) std::atomic<uint64_t> head {0};
+        alignas(64) std::atomic<uint64_t> claimed {0};
+        alignas(64) std::atomic<uint64_t> released {0};
+
+        std::atomic<bool> aborted {false};
+        std::atomic<size_t> drops {0};
+
+        Event pushed;
+        Event popped;
+};
+
+// implementation
+template <typename T>
+inline RingQueue<T>::RingQueue(size_t capacity, Overflow overflow) : overflow(overflow)
+{
+    size_t size = 2;
+    while (size < capacity)
+        size <<= 1;
+    slots.resize(size);
+    mask = size - 1;
+}
+
+template <typename T>
+inline bool RingQueue<T>::Event::wait(uint32_t value, const std::chrono::steady_clock::time_point *deadline) const
+{
+    bool timedOut = false;
+#ifdef __linux__
+    struct timespec timeout, *timeoutPtr = nullptr;
+    if (deadline)
+    {
+        auto const left = std::max(*deadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration::zero());
+        auto const nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+        timeout.tv_sec = nanoseconds / 1000000000;
+        timeout.tv_nsec = nanoseconds % 1000000000;
+        timeoutPtr = &timeout;
+    }
+    // Returns at once if the sequence moved since prepare()
+    if (syscall(SYS_futex, reinterpret_cast<uint32_t *>(&sequence), FUTEX_WAIT_PRIVATE, value, timeoutPtr, nullptr, 0) == -1 &&
+            errno == ETIMEDOUT)
+        timedOut = true;
+#else
+    std::unique_lock<std::mutex> lock(mutex);
+    auto const moved = [&]()
+    {
+        return sequence.load(std::memory_order_seq_cst) != value;
+    };
+    if (deadline)
+        timedOut = !condition.wait_until(lock, *deadline, moved);
+    else
+        condition.wait(lock, moved);
+#endif
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+    return !timedOut;
+}
+
+template <typename T>
+inline void RingQueue<T>::Event::wake()
+{
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&sequence), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+    std::lock_guard<std::mutex> lock(mutex);
+    condition.notify_all();
+#endif
+}
+
+template <typename T>
+template <typename Ready>
+inline bool RingQueue<T>::waitUntil(const Event &event, Ready ready, const std::chrono::steady_clock::time_point *deadline) const
+{
+    while (!ready())
+    {
+        uint32_t const value = event.prepare();
+        if (ready())
+        {
+            event.cancel();
+            return true;
+        }
+        if (!event.wait(value, deadline) && !ready())
+            return false;
+    }
+    return true;
+}
+
+template <typename T>
+inline bool RingQueue<T>::take(T &dest)
+{
+    uint64_t index = claimed.load(std::memory_order_relaxed);
+    do
+    {
+        if (index >= head.load(std::memory_order_acquire))
+            return false;
+    }
+    while (!claimed.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    std::swap(dest, slots[index & mask]);
+    slots[index & mask] = T();
+
+    // Slots are freed in order, so the producer never writes one that an earlier claim still reads
+    while (released.load(std::memory_order_acquire) != index)
+        std::this_thread::yield();
+    released.store(index + 1, std::memory_order_release);
+    popped.notify();
+    return true;
+}
+
+template <typename T>
+inline bool RingQueue<T>::push(T &&data)
+{
+    bool kept = true;
+    uint64_t const index = head.load(std::memory_order_relaxed);
+    if (index - released.load(std::memory_order_acquire) > mask)
+    {
+        if (overflow == DropNewest)
+        {
+            drops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // Drop the oldest item, unless the consumer is taking it right now and the slot is about to be free anyway
+        T oldest;
+        if (take(oldest))
+        {
+            drops.fetch_add(1, std::memory_order_relaxed);
+            kept = false;
+        }
+        while (index - released.load(std::memory_order_acquire) > mask)
+            std::this_thread::yield();
+    }
+
+    slots[index & mask] = std::move(data);
+    head.store(index + 1, std::memory_order_release);
+    pushed.notify();
+    return kept;
+}
+
+template <typename T>
+inline bool RingQueue<T>::pop(T &dest)
+{
+    for (;;)
+    {
+        if (aborted.load(std::memory_order_acquire))
+            return false;
+        if (take(dest))
+            return true;
+        waitUntil(pushed, [this]()
+        {
+            return aborted.load(std::memory_order_acquire) || claimed.load(std::memory_order_acquire) < head.load(std::memory_order_acquire);
+        }, nullptr);
+    }
+}
+
+template <typename T>
+inline bool RingQueue<T>::pop(T &dest, uint32_t msecs)
+{
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msecs);
+    for (;;)
+    {
+        if (aborted.load(std::memory_order_acquire))
+            return false;
+        if (take(dest))
+            return true;
+        bool const ready = waitUntil(pushed, [this]()
+        {
+            return aborted.load(std::memory_order_acquire) || claimed.load(std::memory_order_acquire) < head.load(std::memory_order_acquire);
+        }, &deadline);
+        if (!ready)
+            return false; // timeout
+    }
+}
+
+template <typename T>
+inline size_t RingQueue<T>::size() const
+{
+    return head.load(std::memory_order_acquire) - released.load(std::memory_order_acquire);
+}
+
+template <typename T>
+inline size_t RingQueue<T>::dropped() const
+{
+    return drops.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+inline void RingQueue<T>::setOverflow(Overflow overflow)
+{
+    this->overflow = overflow;
+}
+
+template <typename T>
+inline bool RingQueue<T>::drop()
+{
+    T item;
+    return take(item);
+}
+
+template <typename T>
+inline void RingQueue<T>::clear()
+{
+    T item;
+    while (take(item))
+        item = T();
+}
+
+template <typename T>
+inline void RingQueue<T>::waitForEmpty() const
+{
+    waitUntil(popped, [this]()
+    {
+        return size() == 0;
+    }, nullptr);
+}
+
+template <typename T>
+inline bool RingQueue<T>::waitForEmpty(uint32_t msecs) const
+{
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(msecs);
+    return waitUntil(popped, [this]()
+    {
+        return size() == 0;
+    }, &deadline);
+}
+
+template <typename T>
+inline void RingQueue<T>::abort()
+{
+    aborted.store(true, std::memory_order_release);
+    clear();
+    pushed.notify();
+    popped.notify();
+}
+
+template <typename T>
+inline void RingQueue<T>::reset()
+{
+    aborted.store(false, std::memory_order_release);
+}
@@ -24,17 +24,19 @@
 #include <config.h>
 #include "streammanager.h"
 #include "streammanager_p.h"
+#include "framequality.h"
 #include "indiccd.h"
 #include "indisensorinterface.h"
 #include "indilogger.h"
 #include "indiutility.h"
-#include "indisinglethreadpool.h"
 #include "indielapsedtimer.h"
+#include "inditrace.h"
 
 #include <cerrno>
 #include <sys/stat.h>
 
 #include <algorithm>
+#include <cmath>
 
 static const char * STREAM_TAB = "Streaming";
 
@@ -51,6 +53,16 @@ StreamManagerPrivate::StreamManagerPrivate(DefaultDevice *defaultDevice)
     FPSFast.setTimeWindow(100);
 #endif
 
+    statsTimer.callOnTimeout([this]()
+    {
+        publishStatistics();
+    });
+
+    stackTimer.callOnTimeout([this]()
+    {
+        publishStack();
+    });
+
     recorder = recorderManager.getDefaultRecorder();
 
     LOGF_DEBUG("Using default recorder (%s)", recorder->getName());
@@ -61,6 +73,24 @@ StreamManagerPrivate::StreamManagerPrivate(DefaultDevice *defaultDevice)
 
     LOGF_DEBUG("Using default encoder (%s)", encoder->getName());
 
+    // A recording keeps the frames it has, the live view and the DSP are better served by the latest ones
+    recordConsumer.reset(new Consumer(64, RingQueue<StreamFrame>::DropNewest, [this](const StreamFrame & frame)
+    {
+        recordFrame(frame);
+    }));
+    previewConsumer.reset(new Consumer(2, RingQueue<StreamFrame>::DropOldest, [this](const StreamFrame & frame)
+    {
+        previewFrame(frame);
+    }));
+    dspConsumer.reset(new Consumer(2, RingQueue<StreamFrame>::DropOldest, [this](const StreamFrame & frame)
+    {
+        processFrame(frame);
+    }));
+    stackConsumer.reset(new Consumer(2, RingQueue<StreamFrame>::DropOldest, [this](const StreamFrame & frame)
+    {
+        stackFrame(frame);
+    }));
+
     framesThread = std::thread(&StreamManagerPrivate::asyncStreamThread, this);
 }
 
@@ -72,6 +102,80 @@ StreamManagerPrivate::~StreamManagerPrivate()
         framesIncoming.abort();
         framesThread.join();
     }
+
+    stackConsumer.reset();
+    dspConsumer.reset();
+    previewConsumer.reset();
+    recordConsumer.reset();
+
+    if (timingLog)
+        fclose(timingLog);
+}
+
+StreamManagerPrivate::Consumer::Consumer(size_t capacity, RingQueue<StreamFrame>::Overflow overflow,
+        const std::function<void(const StreamFrame &)> &process)
+    : frames(capacity, overflow)
+    , process(process)
+{
+    thread = std::thread(&Consumer::run, this);
+}
+
+StreamManagerPrivate::Consumer::~Consumer()
+{
+    frames.abort();
+    thread.join();
+}
+
+bool StreamManagerPrivate::Consumer::push(const StreamFrame &frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++pending;
+    }
+
+    // Either policy drops exactly one frame when the ring is full
+    StreamFrame copy = frame;
+    if (frames.push(std::move(copy)))
+        return true;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    --pending;
+    idle.notify_all();
+    return false;
+}
+
+void StreamManagerPrivate::Consumer::waitForIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]()
+    {
+        return pending == 0;
+    });
+}
+
+void StreamManagerPrivate::Consumer::clear()
+{
+    while (frames.drop())
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        --pending;
+        idle.notify_all();
+    }
+}
+
+void StreamManagerPrivate::Consumer::run()
+{
+    StreamFrame frame;
+    while (frames.pop(frame))
+    {
+        process(frame);
+        // Give the buffer back to its pool as soon as every consumer is done with it
+        frame = StreamFrame();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        --pending;
+        idle.notify_all();
+    }
 }
 
 StreamManager::StreamManager(DefaultDevice *mainDevice)
@@ -116,6 +220,38 @@ bool StreamManagerPrivate::initProperties()
     FpsNP[FPS_AVERAGE].fill("AVG_FPS", "Average (1 sec.)", "%.2f", 0.0, 999.0, 0.0, 30);
     FpsNP.fill(getDeviceName(), "FPS", "FPS", STREAM_TAB, IP_RO, 60, IPS_IDLE);
 
+    /* Stream statistics */
+    StatsNP[STATS_DROPPED    ].fill("FRAMES_DROPPED", "Dropped frames",   "%.f",   0, 1e12, 0, 0);
+    StatsNP[STATS_QUEUED     ].fill("FRAMES_QUEUED",  "Queued frames",    "%.f",   0, 1e6,  0, 0);
+    StatsNP[STATS_ENCODE_TIME].fill("ENCODE_TIME",    "Encode time (ms)", "%.2f",  0, 1e6,  0, 0);
+    StatsNP[STATS_RECORD_TIME].fill("RECORD_TIME",    "Record time (ms)", "%.2f",  0, 1e6,  0, 0);
+    StatsNP[STATS_RECORD_DROPPED].fill("RECORD_DROPPED", "Dropped records", "%.f", 0, 1e12, 0, 0);
+    StatsNP[STATS_RECORD_LATE   ].fill("RECORD_LATE",    "Late records",    "%.f", 0, 1e12, 0, 0);
+    StatsNP[STATS_LATENCY       ].fill("FRAME_LATENCY",  "Latency (ms)",    "%.1f", 0, 1e6, 0, 0);
+    StatsNP.fill(getDeviceName(), "STREAM_STATS", "Statistics", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+    /* Stream timing */
+    const char *stageNames[TIMING_STAGES][2] =
+    {
+        {"CAPTURE", "Capture"}, {"COPY", "Copy"}, {"QUEUE", "Queue"}, {"SUBFRAME", "Subframe"},
+        {"ENCODE", "Encode"}, {"SEND", "Send"}, {"RECORD", "Record"}, {"LATENCY", "Latency"}
+    };
+    const char *percentileNames[3] = {"P50", "P95", "P99"};
+    for (int stage = 0; stage < TIMING_STAGES; stage++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            std::string const elementName = std::string(stageNames[stage][0]) + "_" + percentileNames[k];
+            std::string const elementLabel = std::string(stageNames[stage][1]) + " " + percentileNames[k] + " (ms)";
+            TimingNP[stage * 3 + k].fill(elementName, elementLabel, "%.2f", 0, 1e9, 0, 0);
+        }
+    }
+    TimingNP.fill(getDeviceName(), "STREAM_TIMING", "Timing", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+    TimingLogSP[TIMING_LOG_ON ].fill("TIMING_LOG_ON",  "On",  ISS_OFF);
+    TimingLogSP[TIMING_LOG_OFF].fill("TIMING_LOG_OFF", "Off", ISS_ON);
+    TimingLogSP.fill(getDeviceName(), "STREAM_TIMING_LOG", "Timing Log", STREAM_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
     /* Record Frames */
     /* File */
     std::string defaultDirectory = std::string(getenv("HOME")) + std::string("/indi__D_");
@@ -130,6 +266,11 @@ bool StreamManagerPrivate::initProperties()
     RecordOptionsNP.fill(getDeviceName(), "RECORD_OPTIONS",
                          "Record Options", STREAM_TAB, IP_RW, 60, IPS_IDLE);
 
+    /* Record Selection, all frames by default */
+    RecordSelectNP[RECORD_SELECT_BEST  ].fill("BEST_PERCENT", "Best Frames (%)", "%.0f", 1, 100,   1, 100);
+    RecordSelectNP[RECORD_SELECT_WINDOW].fill("WINDOW",       "Window (frames)", "%.0f", 2, 10000, 10, 100);
+    RecordSelectNP.fill(getDeviceName(), "RECORD_SELECT", "Record Selection", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
     /* Record Switch */
     RecordStreamSP[RECORD_ON   ].fill("RECORD_ON",          "Record On",         ISS_OFF);
     RecordStreamSP[RECORD_TIME ].fill("RECORD_DURATION_ON", "Record (Duration)", ISS_OFF);
@@ -151,11 +292,55 @@ bool StreamManagerPrivate::initProperties()
     // Encoder Selection
     EncoderSP[ENCODER_RAW  ].fill("RAW",   "RAW",   ISS_ON);
     EncoderSP[ENCODER_MJPEG].fill("MJPEG", "MJPEG", ISS_OFF);
+    EncoderSP[ENCODER_H264 ].fill("H264",  "H.264", ISS_OFF);
+    EncoderSP[ENCODER_H265 ].fill("H265",  "H.265", ISS_OFF);
     if(currentDevice->getDriverInterface() & INDI::DefaultDevice::SENSOR_INTERFACE)
         EncoderSP.fill(getDeviceName(), "SENSOR_STREAM_ENCODER", "Encoder", STREAM_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
     else
         EncoderSP.fill(getDeviceName(), "CCD_STREAM_ENCODER",    "Encoder", STREAM_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
 
+    // Without libavcodec, only the RAW and MJPEG encoders are available
+#ifndef HAVE_LIBAVCODEC
+    EncoderSP.resize(2);
+#endif
+
+    StreamDSPSP[STREAM_DSP_ON ].fill("STREAM_DSP_ON",  "On",  ISS_OFF);
+    StreamDSPSP[STREAM_DSP_OFF].fill("STREAM_DSP_OFF", "Off", ISS_ON);
+    StreamDSPSP.fill(getDeviceName(), "STREAM_DSP", "DSP Processing", STREAM_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    // Live Stacking
+    StackSP[STACK_MEAN      ].fill("STACK_MEAN",       "Mean",       ISS_OFF);
+    StackSP[STACK_SIGMA_CLIP].fill("STACK_SIGMA_CLIP", "Sigma Clip", ISS_OFF);
+    StackSP[STACK_OFF       ].fill("STACK_OFF",        "Off",        ISS_ON);
+    StackSP.fill(getDeviceName(), "STREAM_STACK", "Live Stack", STREAM_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
+    StackSettingsNP[STACK_PUBLISH_PERIOD].fill("PUBLISH_PERIOD", "Publish Period (s)", "%.1f", 0.2, 60, 0.5, 1);
+    StackSettingsNP[STACK_MIN_STARS     ].fill("MIN_STARS",      "Minimum Stars",      "%.0f",   3, 100,  1, 5);
+    StackSettingsNP[STACK_MAX_FWHM      ].fill("MAX_FWHM",       "Maximum FWHM (px)",  "%.1f",   0,  50, 0.5, 0);
+    StackSettingsNP[STACK_SIGMA         ].fill("SIGMA",          "Clip Sigma",         "%.1f",   1,  10, 0.5, 3);
+    StackSettingsNP.fill(getDeviceName(), "STREAM_STACK_SETTINGS", "Stack Settings", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+    StackStatsNP[STACK_STACKED ].fill("STACKED",  "Stacked",  "%.0f", 0, 1e9, 0, 0);
+    StackStatsNP[STACK_REJECTED].fill("REJECTED", "Rejected", "%.0f", 0, 1e9, 0, 0);
+    StackStatsNP.fill(getDeviceName(), "STREAM_STACK_STATS", "Stack Frames", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+    StackResetSP[0].fill("RESET", "Reset", ISS_OFF);
+    StackResetSP.fill(getDeviceName(), "STREAM_STACK_RESET", "Stack", STREAM_TAB, IP_RW, ISR_ATMOST1, 60, IPS_IDLE);
+
+    StackBP[0].fill("STACK", "Stack", ".fits");
+    StackBP.fill(getDeviceName(), "STREAM_STACK_IMAGE", "Stack Image", STREAM_TAB, IP_RO, 60, IPS_IDLE);
+
+    EncoderSettingsNP[ENCODER_BITRATE          ].fill("BITRATE",           "Bitrate (kbit/s)",   "%.0f", 100, 50000, 100, 2000);
+    EncoderSettingsNP[ENCODER_KEYFRAME_INTERVAL].fill("KEYFRAME_INTERVAL", "Keyframe Interval",  "%.0f",   1,   600,   1,   60);
+    EncoderSettingsNP[ENCODER_MAX_DELAY        ].fill("MAX_DELAY",         "Max Delay (frames)", "%.0f",   0,    16,   1,    0);
+    EncoderSettingsNP.fill(getDeviceName(), "STREAM_ENCODER_SETTINGS", "Encoder Settings", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
+    // Raw Codec, used when the camera compresses its frames
+    RawCodecSP[RAW_CODEC_ZLIB     ].fill("CODEC_ZLIB",      "Zlib",        ISS_ON);
+    RawCodecSP[RAW_CODEC_LZ4      ].fill("CODEC_LZ4",       "LZ4",         ISS_OFF);
+    RawCodecSP[RAW_CODEC_DELTA_LZ4].fill("CODEC_DELTA_LZ4", "Delta + LZ4", ISS_OFF);
+    RawCodecSP.fill(getDeviceName(), "STREAM_RAW_CODEC", "Raw Codec", STREAM_TAB, IP_RW, ISR_1OFMANY, 0, IPS_IDLE);
+
     // Recorder Selector
     RecorderSP[RECORDER_RAW].fill("SER", "SER", ISS_ON);
     RecorderSP[RECORDER_OGV].fill("OGV", "OGV", ISS_OFF);
@@ -169,10 +354,23 @@ bool StreamManagerPrivate::initProperties()
     RecorderSP.resize(1);
 #endif
 
+    RecorderSettingsNP[RECORDER_QUALITY].fill("QUALITY", "Quality", "%.0f", 0, 100, 5, 75);
+    RecorderSettingsNP[RECORDER_SPEED  ].fill("SPEED",   "Speed",   "%.0f", 0, 100, 5, 100);
+    RecorderSettingsNP.fill(getDeviceName(), "STREAM_RECORDER_SETTINGS", "Recorder Settings", STREAM_TAB, IP_RW, 60, IPS_IDLE);
+
     // Limits
     LimitsNP[LIMITS_BUFFER_MAX ].fill("LIMITS_BUFFER_MAX",  "Maximum Buffer Size (MB)", "%.0f", 1, 1024 * 64, 1, 512);
     LimitsNP[LIMITS_PREVIEW_FPS].fill("LIMITS_PREVIEW_FPS", "Maximum Preview FPS",      "%.0f", 1, 120,     1,  10);
+    LimitsNP[LIMITS_STATS_RATE ].fill("LIMITS_STATS_RATE",  "Statistics Rate (Hz)",     "%.1f", 0.1, 10,  0.5,  2);
+    LimitsNP[LIMITS_MAX_LATENCY].fill("LIMITS_MAX_LATENCY", "Maximum Latency (ms)",     "%.0f", 0, 10000, 50, 0);
     LimitsNP.fill(getDeviceName(), "LIMITS", "Limits", STREAM_TAB, IP_RW, 0, IPS_IDLE);
+
+    // Timestamp Offset
+    TimestampOffsetNP[0].fill("OFFSET", "Offset (ms)", "%.3f", -10000, 10000, 1, 0);
+    TimestampOffsetNP.fill(getDeviceName(), "STREAM_TIMESTAMP_OFFSET", "Timestamp", STREAM_TAB, IP_RW, 0, IPS_IDLE);
+
+    applyEncoderSettings();
+    applyRecorderSettings();
     return true;
 }
 
@@ -193,13 +391,37 @@ void StreamManagerPrivate::ISGetProperties(const char *dev)
         if (hasStreamingExposure)
             currentDevice->defineProperty(StreamExposureNP);
         currentDevice->defineProperty(FpsNP);
+        currentDevice->defineProperty(StatsNP);
+        currentDevice->defineProperty(TimingNP);
+        currentDevice->defineProperty(TimingLogSP);
         currentDevice->defineProperty(RecordStreamSP);
         currentDevice->defineProperty(RecordFileTP);
         currentDevice->defineProperty(RecordOptionsNP);
+        currentDevice->defineProperty(RecordSelectNP);
         currentDevice->defineProperty(StreamFrameNP);
         currentDevice->defineProperty(EncoderSP);
+#ifdef HAVE_LIBAVCODEC
+        currentDevice->defineProperty(EncoderSettingsNP);
+#endif
+#ifdef HAVE_LZ4
+        currentDevice->defineProperty(RawCodecSP);
+#endif
         currentDevice->defineProperty(RecorderSP);
+#ifdef HAVE_THEORA
+        currentDevice->defineProperty(RecorderSettingsNP);
+#endif
         currentDevice->defineProperty(LimitsNP);
+        currentDevice->defineProperty(TimestampOffsetNP);
+        if (hasDSP())
+            currentDevice->defineProperty(StreamDSPSP);
+        if (hasStacker())
+        {
+            currentDevice->defineProperty(StackSP);
+            currentDevice->defineProperty(StackSettingsNP);
+            currentDevice->defineProperty(StackStatsNP);
+            currentDevice->defineProperty(StackResetSP);
+            currentDevice->defineProperty(StackBP);
+        }
     }
 }
 
@@ -227,13 +449,40 @@ bool StreamManagerPrivate::updateProperties()
         if (hasStreamingExposure)
             currentDevice->defineProperty(StreamExposureNP);
         currentDevice->defineProperty(FpsNP);
+        currentDevice->defineProperty(StatsNP);
+        currentDevice->defineProperty(TimingNP);
+        currentDevice->defineProperty(TimingLogSP);
         currentDevice->defineProperty(RecordStreamSP);
         currentDevice->defineProperty(RecordFileTP);
         currentDevice->defineProperty(RecordOptionsNP);
+        currentDevice->defineProperty(RecordSelectNP);
         currentDevice->defineProperty(StreamFrameNP);
         currentDevice->defineProperty(EncoderSP);
+#ifdef HAVE_LIBAVCODEC
+        currentDevice->defineProperty(EncoderSettingsNP);
+#endif
+#ifdef HAVE_LZ4
+        currentDevice->defineProperty(RawCodecSP);
+#endif
         currentDevice->defineProperty(RecorderSP);
+#ifdef HAVE_THEORA
+        currentDevice->defineProperty(RecorderSettingsNP);
+#endif
         currentDevice->defineProperty(LimitsNP);
+        currentDevice->defineProperty(TimestampOffsetNP);
+        if (hasDSP())
+            currentDevice->defineProperty(StreamDSPSP);
+        if (hasStacker())
+        {
+            currentDevice->defineProperty(StackSP);
+            currentDevice->defineProperty(StackSettingsNP);
+            currentDevice->defineProperty(StackStatsNP);
+            currentDevice->defineProperty(StackResetSP);
+            currentDevice->defineProperty(StackBP);
+            applyStackSettings();
+        }
+
+        statsTimer.start(static_cast<int>(1000 / LimitsNP[LIMITS_STATS_RATE].getValue()));
     }
     else
     {
@@ -242,13 +491,41 @@ bool StreamManagerPrivate::updateProperties()
         if (hasStreamingExposure)
             currentDevice->deleteProperty(StreamExposureNP.getName());
         currentDevice->deleteProperty(FpsNP.getName());
+        currentDevice->deleteProperty(StatsNP.getName());
+        currentDevice->deleteProperty(TimingNP.getName());
+        currentDevice->deleteProperty(TimingLogSP.getName());
+        setTimingLog(false);
         currentDevice->deleteProperty(RecordFileTP.getName());
         currentDevice->deleteProperty(RecordStreamSP.getName());
         currentDevice->deleteProperty(RecordOptionsNP.getName());
+        currentDevice->deleteProperty(RecordSelectNP.getName());
         currentDevice->deleteProperty(StreamFrameNP.getName());
         currentDevice->deleteProperty(EncoderSP.getName());
+#ifdef HAVE_LIBAVCODEC
+        currentDevice->deleteProperty(EncoderSettingsNP.getName());
+#endif
+#ifdef HAVE_LZ4
+        currentDevice->deleteProperty(RawCodecSP.getName());
+#endif
         currentDevice->deleteProperty(RecorderSP.getName());
+#ifdef HAVE_THEORA
+        currentDevice->deleteProperty(RecorderSettingsNP.getName());
+#endif
         currentDevice->deleteProperty(LimitsNP.getName());
+        currentDevice->deleteProperty(TimestampOffsetNP.getName());
+        if (hasDSP())
+            currentDevice->deleteProperty(StreamDSPSP.getName());
+        if (hasStacker())
+        {
+            currentDevice->deleteProperty(StackSP.getName());
+            currentDevice->deleteProperty(StackSettingsNP.getName());
+            currentDevice->deleteProperty(StackStatsNP.getName());
+            currentDevice->deleteProperty(StackResetSP.getName());
+            currentDevice->deleteProperty(StackBP.getName());
+        }
+
+        statsTimer.stop();
+        stackTimer.stop();
     }
 
     return true;
@@ -266,13 +543,40 @@ bool StreamManager::updateProperties()
  * Therefore nbytes is expected to be SubW/BinX * SubH/BinY * Bytes_Per_Pixels * Number_Color_Components
  * Binned frame must be sent from the camera driver for this to work consistentaly for all drivers.*/
 void StreamManagerPrivate::newFrame(const uint8_t * buffer, uint32_t nbytes, uint64_t timestamp)
+{
+    if (acceptFrame(nbytes) == false)
+        return;
+
+    BufferPool::Buffer copyBuffer = framePool.acquire(nbytes);
+    if (copyBuffer.empty())
+    {
+        LOG_WARN("Out of memory for the frame buffer, skipping frame...");
+        framesDropped++;
+        return;
+    }
+    INDI::ElapsedTimer copyElapsed;
+    memcpy(copyBuffer.data(), buffer, nbytes); // copy the frame
+    stageTimes[TIMING_COPY].add(copyElapsed.nsecsElapsed());
+
+    queueFrame(std::move(copyBuffer), timestamp);
+}
+
+void StreamManagerPrivate::newFrame(BufferPool::Buffer &&frame, uint64_t timestamp)
+{
+    if (frame.empty() || acceptFrame(frame.size()) == false)
+        return;
+
+    queueFrame(std::move(frame), timestamp);
+}
+
+bool StreamManagerPrivate::acceptFrame(size_t nbytes)
 {
     // close the data stream on the same thread as the data stream
     // manually triggered to stop recording.
     if (isRecordingAboutToClose)
     {
         stopRecording();
-        return;
+        return false;
     }
 
     // Discard every N frame.
@@ -284,37 +588,68 @@ void StreamManagerPrivate::newFrame(const uint8_t * buffer, uint32_t nbytes, uin
         (frameCountDivider % static_cast<int>(StreamExposureNP[STREAM_DIVISOR].getValue())) == 0
     )
     {
-        return;
+        return false;
     }
 
+    // Published from the event loop by statsTimer
     if (FPSAverage.newFrame())
-    {
-        FpsNP[1].setValue(FPSAverage.framesPerSecond());
-    }
+        fpsAverage = FPSAverage.framesPerSecond();
 
     if (FPSFast.newFrame())
+        fpsInstant = FPSFast.framesPerSecond();
+
+    if (!isStreaming && !isRecording)
+        return false;
+
+    // In the latency mode, a live view is paced to the preview rate here, before the frame is copied,
+    // and the queue holds no more frames than the budget can show
+    double const maxLatency = LimitsNP[LIMITS_MAX_LATENCY].getValue();
+    framePaced = maxLatency > 0 && !isRecording;
+    if (framePaced)
     {
-        FpsNP[0].setValue(FPSFast.framesPerSecond());
-        if (fastFPSUpdate.try_lock()) // don't block stream thread / record thread
-            std::thread([&]()
-        {
-            FpsNP.apply();
-            fastFPSUpdate.unlock();
-        }).detach();
+        if (!FPSPacing.newFrame())
+            return false;
+
+        double const maxFrames = std::max(1.0, std::ceil(maxLatency / 1000 * LimitsNP[LIMITS_PREVIEW_FPS].getValue()));
+        while (framesIncoming.size() >= maxFrames && framesIncoming.drop())
+            framesDropped++;
+        return true;
     }
 
-    if (isStreaming || (isRecording && !isRecordingAboutToClose))
+    size_t allocatedSize = nbytes * framesIncoming.size() / 1024 / 1024; // allocated size in MB
+    if (allocatedSize > LimitsNP[LIMITS_BUFFER_MAX].getValue())
     {
-        size_t allocatedSize = nbytes * framesIncoming.size() / 1024 / 1024; // allocated size in MB
-        if (allocatedSize > LimitsNP[LIMITS_BUFFER_MAX].getValue())
+        // A live view is better served by the latest frames, a recording keeps the frames it has
+        if (isRecording)
         {
             LOG_WARN("Frame buffer is full, skipping frame...");
-            return;
+            framesDropped++;
+            return false;
         }
+        if (framesIncoming.drop())
+            framesDropped++;
+        LOG_DEBUG("Frame buffer is full, dropping oldest frame...");
+    }
 
-        std::vector<uint8_t> copyBuffer(buffer, buffer + nbytes); // copy the frame
+    return true;
+}
 
-        framesIncoming.push(TimeFrame{FPSFast.deltaTime(), timestamp, std::move(copyBuffer)}); // push it into the queue
+void StreamManagerPrivate::queueFrame(BufferPool::Buffer &&frame, uint64_t timestamp)
+{
+    INDI_TRACE_SCOPE("StreamManager::queueFrame");
+    // Frames the driver does not stamp are stamped as they arrive, on the system clock that the GPS drivers or
+    // a PPS disciplined NTP set, so that the streams of several cameras share the same time base
+    if (timestamp == 0)
+        timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+    timestamp += static_cast<int64_t>(TimestampOffsetNP[0].getValue() * 1000);
+
+    framesIncoming.setOverflow(isRecording ? RingQueue<TimeFrame>::DropNewest : RingQueue<TimeFrame>::DropOldest);
+    stageTimes[TIMING_CAPTURE].add(static_cast<uint64_t>(FPSFast.deltaTime() * 1e6));
+    if (framesIncoming.push(TimeFrame{FPSFast.deltaTime(), timestamp, std::move(frame), std::chrono::steady_clock::now(), framePaced}) == false) // push it into the queue
+    {
+        LOG_DEBUG("Frame queue is full, dropped a frame...");
+        framesDropped++;
     }
 
     if (isRecording && !isRecordingAboutToClose)
@@ -329,6 +664,7 @@ void StreamManagerPrivate::newFrame(const uint8_t * buffer, uint32_t nbytes, uin
         {
             LOG_INFO("Waiting for all buffered frames to be recorded");
             framesIncoming.waitForEmpty();
+            recordConsumer->waitForIdle();
             // duplicated message
 #if 0
             LOGF_INFO(
@@ -353,6 +689,18 @@ void StreamManager::newFrame(const uint8_t * buffer, uint32_t nbytes, uint64_t t
     d->newFrame(buffer, nbytes, timestamp);
 }
 
+BufferPool::Buffer StreamManager::acquireFrame(size_t nbytes)
+{
+    D_PTR(StreamManager);
+    return d->framePool.acquire(nbytes);
+}
+
+void StreamManager::newFrame(BufferPool::Buffer &&frame, uint64_t timestamp)
+{
+    D_PTR(StreamManager);
+    d->newFrame(std::move(frame), timestamp);
+}
+
 
 StreamManagerPrivate::FrameInfo StreamManagerPrivate::updateSourceFrameInfo()
 {
@@ -419,90 +767,307 @@ void StreamManagerPrivate::asyncStreamThread()
     TimeFrame sourceTimeFrame;
     sourceTimeFrame.time = 0;
 
-    std::vector<uint8_t> subframeBuffer;  // Subframe buffer for recording/streaming
-    std::vector<uint8_t> downscaleBuffer; // Downscale buffer for streaming
-
-    INDI::SingleThreadPool previewThreadPool;
-    INDI::ElapsedTimer previewElapsed;
-
     while(!framesThreadTerminate)
     {
         if (framesIncoming.pop(sourceTimeFrame) == false)
             continue;
 
-        FrameInfo srcFrameInfo = updateSourceFrameInfo();
+        stageTimes[TIMING_QUEUE].add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now() - sourceTimeFrame.queued).count());
+
+        // Decided once for the frame, the recorder is also told under its lock whether it still records
+        bool const recording = isRecording && !isRecordingAboutToClose;
+
+        // A frame that waited past the latency budget is stale, a newer one is better shown
+        if (sourceTimeFrame.paced && !recording &&
+                std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sourceTimeFrame.queued).count() >
+                LimitsNP[LIMITS_MAX_LATENCY].getValue())
+        {
+            framesDropped++;
+            continue;
+        }
 
-        std::vector<uint8_t> *sourceBuffer = &sourceTimeFrame.frame;
+        StreamFrame frame;
+        frame.source = updateSourceFrameInfo();
+        frame.subframe = dstFrameInfo;
+        frame.time = sourceTimeFrame.time;
+        frame.timestamp = sourceTimeFrame.timestamp;
+        frame.queued = sourceTimeFrame.queued;
+        frame.paced = sourceTimeFrame.paced;
+
+        // The frame, replaced by its subframe if it is cut here
+        BufferPool::Buffer sourceBuffer = std::move(sourceTimeFrame.frame);
 
         // Source buffer size may be equal or larger than frame info size
         // as some driver still retain full unbinned window size even when binning the output
         // frame
-        if (PixelFormat != INDI_JPG && sourceBuffer->size() < srcFrameInfo.totalSize())
+        if (PixelFormat != INDI_JPG && sourceBuffer.size() < frame.source.totalSize())
         {
-            LOGF_ERROR("Source buffer size %d is less than frame size %d, skipping frame...", sourceBuffer->size(),
-                       srcFrameInfo.totalSize());
+            LOGF_ERROR("Source buffer size %d is less than frame size %d, skipping frame...", sourceBuffer.size(),
+                       frame.source.totalSize());
             continue;
         }
 
-        // Check if we need to subframe
-        if (
-            PixelFormat != INDI_JPG &&
-            dstFrameInfo.pixels() != 0 &&
-            dstFrameInfo != srcFrameInfo
-        )
-        {
-            subframeBuffer.resize(dstFrameInfo.totalSize());
-            subframe(sourceBuffer->data(), srcFrameInfo, subframeBuffer.data(), dstFrameInfo);
+        bool const preview = isStreaming && (sourceTimeFrame.paced || FPSPreview.newFrame());
+        bool const process = isStreaming && PixelFormat != INDI_RGB && PixelFormat != INDI_JPG &&
+                             StreamDSPSP[STREAM_DSP_ON].getState() == ISS_ON && hasDSP();
+        bool const stack = isStreaming && PixelFormat == INDI_MONO && StackSP[STACK_OFF].getState() == ISS_OFF &&
+                           hasStacker();
+        if (!recording && !preview && !process && !stack)
+            continue;
 
-            sourceBuffer = &subframeBuffer;
+        // Check if we need to subframe. A preview that is downscaled gets its subframe in the same pass,
+        // the recorder, the DSP and the stacker need a copy at full depth.
+        bool const downscale = PixelFormat != INDI_JPG && PixelDepth > 8 && !encoder->supportsPixelDepth(PixelDepth);
+        frame.subframed = PixelFormat == INDI_JPG || frame.subframe.pixels() == 0 || !(frame.subframe != frame.source);
+        if (!frame.subframed && (recording || process || stack || !downscale))
+        {
+            BufferPool::Buffer subframeBuffer = framePool.acquire(frame.subframe.totalSize());
+            if (subframeBuffer.empty())
+                continue;
+            INDI::ElapsedTimer subframeElapsed;
+            subframe(sourceBuffer.data(), frame.source, subframeBuffer.data(), frame.subframe);
+            stageTimes[TIMING_SUBFRAME].add(subframeElapsed.nsecsElapsed());
+
+            sourceBuffer = std::move(subframeBuffer);
+            frame.subframed = true;
         }
 
-        // For recording, save immediately.
+        // The consumers share the frame, its buffer goes back to the pool once the last of them is done
+        frame.buffer = std::make_shared<const BufferPool::Buffer>(std::move(sourceBuffer));
+
+        if (recording && !recordConsumer->push(frame))
         {
-            std::lock_guard<std::mutex> lock(recordMutex);
-            if (
-                isRecording && !isRecordingAboutToClose &&
-                recordStream(sourceBuffer->data(), sourceBuffer->size(), sourceTimeFrame.time, sourceTimeFrame.timestamp) == false
-            )
-            {
-                LOG_ERROR("Recording failed.");
-                isRecordingAboutToClose = true;
-            }
+            LOG_WARN("Recorder is too slow, skipping frame...");
+            framesDropped++;
         }
 
-        // For streaming, downscale to 8bit if higher than 8bit to reduce bandwidth
         // You can reduce the number of frames by setting a frame limit.
-        if (isStreaming && FPSPreview.newFrame())
-        {
-            // Downscale to 8bit always for streaming to reduce bandwidth
-            if (PixelFormat != INDI_JPG && PixelDepth > 8)
-            {
-                // Allocale new buffer if size changes
-                downscaleBuffer.resize(dstFrameInfo.pixels());
+        if (preview && !previewConsumer->push(frame))
+            framesDropped++;
 
-                // Apply gamma
-                gammaLut16.apply(
-                    reinterpret_cast<const uint16_t*>(sourceBuffer->data()),
-                    downscaleBuffer.size(),
-                    downscaleBuffer.data()
-                );
+        if (process)
+            dspConsumer->push(frame);
 
-                sourceBuffer = &downscaleBuffer;
-            }
+        if (stack)
+            stackConsumer->push(frame);
+    }
+}
 
-            //uploadStream(sourceBuffer->data(), sourceBuffer->size());
-            previewThreadPool.start(std::bind([this, &previewElapsed](const std::atomic_bool & isAboutToQuit,
-                                              std::vector<uint8_t> frame)
-            {
-                INDI_UNUSED(isAboutToQuit);
-                previewElapsed.start();
-                uploadStream(frame.data(), frame.size());
-                StreamTimeNP[0].setValue(previewElapsed.nsecsElapsed() / 1000000000.0);
-                StreamTimeNP.apply();
+void StreamManagerPrivate::recordFrame(const StreamFrame &frame)
+{
+    INDI_TRACE_SCOPE("StreamManager::recordFrame");
+    // For recording, save immediately.
+    std::lock_guard<std::mutex> lock(recordMutex);
+    if (!isRecording || isRecordingAboutToClose)
+        return;
 
-            }, std::placeholders::_1, std::move(*sourceBuffer)));
-        }
+    double const best = RecordSelectNP[RECORD_SELECT_BEST].getValue();
+    if (best >= 100 || PixelFormat == INDI_JPG)
+    {
+        writeRecordFrame(frame);
+        return;
+    }
+
+    // The window is held in memory, it is cut short rather than going over the buffer limit
+    int const channels = PixelFormat == INDI_RGB || PixelFormat == INDI_BGR ? 3 : 1;
+    bool const mosaic = PixelFormat >= INDI_BAYER_RGGB && PixelFormat <= INDI_BAYER_MYYC;
+    double const score = scoreFrameSharpness(frame.buffer->data(), frame.subframe.w, frame.subframe.h,
+                         frame.subframe.bytesPerColor * 8, channels, mosaic);
+    recordWindow.emplace_back(score, frame);
+    recordWindowBytes += frame.buffer->size();
+    recordScored++;
+
+    if (recordWindow.size() >= RecordSelectNP[RECORD_SELECT_WINDOW].getValue() ||
+            recordWindowBytes / 1024 / 1024 >= LimitsNP[LIMITS_BUFFER_MAX].getValue())
+        writeRecordWindow();
+}
+
+void StreamManagerPrivate::writeRecordWindow()
+{
+    if (recordWindow.empty())
+        return;
+
+    // The best frames are written in their order, those tied with the last of them while they fit in the count
+    size_t const count = std::max<long>(1, std::lround(recordWindow.size() *
+                                        RecordSelectNP[RECORD_SELECT_BEST].getValue() / 100));
+    std::vector<double> scores;
+    for (const auto &scored : recordWindow)
+        scores.push_back(scored.first);
+    std::nth_element(scores.begin(), scores.begin() + count - 1, scores.end(), std::greater<double>());
+    double const threshold = scores[count - 1];
+    size_t ties = count - std::count_if(scores.begin(), scores.end(), [threshold](double score)
+    {
+        return score > threshold;
+    });
+
+    size_t written = 0;
+    for (const auto &scored : recordWindow)
+    {
+        if (scored.first < threshold || (scored.first == threshold && ties == 0))
+            continue;
+        if (scored.first == threshold)
+            ties--;
+        writeRecordFrame(scored.second);
+        written++;
+    }
+    recordSelected += written;
+
+    recordWindow.clear();
+    recordWindowBytes = 0;
+}
+
+void StreamManagerPrivate::writeRecordFrame(const StreamFrame &frame)
+{
+    INDI::ElapsedTimer recordElapsed;
+    if (recordStream(frame.buffer->data(), frame.buffer->size(), frame.time, frame.timestamp) == false)
+    {
+        LOG_ERROR("Recording failed.");
+        isRecordingAboutToClose = true;
+    }
+    uint64_t const recordTime = recordElapsed.nsecsElapsed();
+    recordNanoseconds += recordTime;
+    recordedFrames++;
+    stageTimes[TIMING_RECORD].add(recordTime);
+}
+
+void StreamManagerPrivate::previewFrame(const StreamFrame &frame)
+{
+    INDI_TRACE_SCOPE("StreamManager::previewFrame");
+    // The frame may have waited for the encoder
+    if (frame.paced && !isRecording &&
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.queued).count() >
+            LimitsNP[LIMITS_MAX_LATENCY].getValue())
+    {
+        framesDropped++;
+        return;
+    }
+
+    INDI::ElapsedTimer previewElapsed;
+    INDI::ElapsedTimer subframeElapsed;
+    const uint8_t *buffer = frame.buffer->data();
+    size_t nbytes = frame.buffer->size();
+
+    // For streaming, downscale to 8bit if higher than 8bit to reduce bandwidth,
+    // unless the encoder does it as it reads the frame
+    BufferPool::Buffer previewBuffer;
+    if (PixelFormat != INDI_JPG && PixelDepth > 8 && !encoder->supportsPixelDepth(PixelDepth))
+    {
+        // One byte for each 16 bit sample, three per pixel for RGB
+        previewBuffer = framePool.acquire(frame.subframe.totalSize() / 2);
+        if (previewBuffer.empty())
+            return;
+
+        // Apply gamma, cutting the subframe out of the source frame if not done yet
+        const uint16_t *samples = reinterpret_cast<const uint16_t*>(buffer);
+        if (frame.subframed)
+            gammaLut16.apply(samples, previewBuffer.size(), previewBuffer.data());
+        else
+            gammaLut16.apply(
+                samples + (frame.subframe.y * frame.source.lineSize() + frame.subframe.x * frame.source.bytesPerColor) / 2,
+                frame.subframe.lineSize() / 2,
+                frame.subframe.h,
+                frame.source.lineSize() / 2,
+                previewBuffer.data()
+            );
+    }
+    else if (!frame.subframed)
+    {
+        // The encoder changed since the frame was dispatched
+        previewBuffer = framePool.acquire(frame.subframe.totalSize());
+        if (previewBuffer.empty())
+            return;
+        subframe(buffer, frame.source, previewBuffer.data(), frame.subframe);
     }
+
+    if (!previewBuffer.empty())
+    {
+        stageTimes[TIMING_SUBFRAME].add(subframeElapsed.nsecsElapsed());
+        buffer = previewBuffer.data();
+        nbytes = previewBuffer.size();
+    }
+
+    uploadStream(buffer, nbytes, frame.timestamp);
+    uint64_t const elapsed = previewElapsed.nsecsElapsed();
+    auto const latency = std::chrono::steady_clock::now() - frame.queued;
+    streamDelay = elapsed / 1000000000.0;
+    streamLatency = std::chrono::duration<double, std::milli>(latency).count();
+    stageTimes[TIMING_LATENCY].add(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count());
+    encodeNanoseconds += elapsed;
+    encodedFrames++;
+}
+
+void StreamManagerPrivate::processFrame(const StreamFrame &frame)
+{
+    INDI_TRACE_SCOPE("StreamManager::processFrame");
+    if (!hasDSP())
+        return;
+
+    auto ccd = dynamic_cast<INDI::CCD*>(currentDevice);
+
+    // The plugins keep the sizes; they only read the frame, copying it to their own streams
+    dspSizes[0] = frame.subframe.w;
+    dspSizes[1] = frame.subframe.h;
+    ccd->DSP->processBLOB(const_cast<uint8_t *>(frame.buffer->data()), 2, dspSizes, frame.subframe.bytesPerColor * 8);
+}
+
+bool StreamManagerPrivate::hasDSP() const
+{
+    auto ccd = dynamic_cast<INDI::CCD*>(currentDevice);
+    return ccd != nullptr && (ccd->GetCCDCapability() & INDI::CCD::CCD_HAS_DSP) && ccd->DSP.get() != nullptr;
+}
+
+void StreamManagerPrivate::stackFrame(const StreamFrame &frame)
+{
+    INDI_TRACE_SCOPE("StreamManager::stackFrame");
+    stacker.add(frame.buffer->data(), frame.subframe.w, frame.subframe.h, frame.subframe.bytesPerColor * 8);
+}
+
+bool StreamManagerPrivate::hasStacker() const
+{
+    return currentDevice->getDriverInterface() & INDI::DefaultDevice::CCD_INTERFACE;
+}
+
+void StreamManagerPrivate::applyStackSettings()
+{
+    StreamStacker::Settings settings;
+    settings.mode     = StackSP[STACK_SIGMA_CLIP].getState() == ISS_ON ? StreamStacker::STACK_SIGMA_CLIP :
+                        StreamStacker::STACK_MEAN;
+    settings.minStars = static_cast<size_t>(StackSettingsNP[STACK_MIN_STARS].getValue());
+    settings.maxFWHM  = StackSettingsNP[STACK_MAX_FWHM].getValue();
+    settings.sigma    = StackSettingsNP[STACK_SIGMA].getValue();
+    stacker.setSettings(settings);
+
+    if (StackSP[STACK_OFF].getState() == ISS_ON || !currentDevice->isConnected())
+        stackTimer.stop();
+    else
+        stackTimer.start(static_cast<int>(StackSettingsNP[STACK_PUBLISH_PERIOD].getValue() * 1000));
+}
+
+void StreamManagerPrivate::publishStack()
+{
+    uint32_t const stacked = stacker.stacked(), rejected = stacker.rejected();
+    if (stacked != StackStatsNP[STACK_STACKED].getValue() || rejected != StackStatsNP[STACK_REJECTED].getValue())
+    {
+        StackStatsNP[STACK_STACKED].setValue(stacked);
+        StackStatsNP[STACK_REJECTED].setValue(rejected);
+        StackStatsNP.setState(IPS_OK);
+        StackStatsNP.apply();
+    }
+
+    // The stack is only sent again once it has new frames
+    if (stacked == stackPublished)
+        return;
+    stackPublished = stacked;
+    if (!stacker.render(stackImage))
+        return;
+
+    StackBP[0].setBlob(stackImage.data());
+    StackBP[0].setBlobLen(stackImage.size());
+    StackBP[0].setSize(stackImage.size());
+    StackBP[0].setFormat(".fits");
+    StackBP.setState(IPS_OK);
+    StackBP.apply();
 }
 
 void StreamManagerPrivate::setSize(uint16_t width, uint16_t height)
@@ -586,12 +1151,166 @@ bool StreamManager::setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelD
 }
 
 
+void StreamManager::setBufferPool(const BufferPool &pool)
+{
+    D_PTR(StreamManager);
+    d->framePool = pool;
+}
+
 void StreamManager::setSize(uint16_t width, uint16_t height)
 {
     D_PTR(StreamManager);
     d->setSize(width, height);
 }
 
+void StreamManagerPrivate::publishStatistics()
+{
+    bool const active = isStreaming || isRecording;
+
+    // One last update with the final counts once the stream and the recording stop
+    if (!active && !statsActive)
+        return;
+    statsActive = active;
+
+    FpsNP[FPS_INSTANT].setValue(active ? fpsInstant.load() : 0);
+    FpsNP[FPS_AVERAGE].setValue(active ? fpsAverage.load() : 0);
+    FpsNP.apply();
+
+    StreamTimeNP[0].setValue(streamDelay);
+    StreamTimeNP.apply();
+
+    // Mean times of the frames encoded and recorded since the last update
+    uint64_t const encoded = encodedFrames.exchange(0), encodeTime = encodeNanoseconds.exchange(0);
+    uint64_t const recorded = recordedFrames.exchange(0), recordTime = recordNanoseconds.exchange(0);
+
+    StatsNP[STATS_DROPPED].setValue(framesDropped);
+    StatsNP[STATS_QUEUED].setValue(framesIncoming.size());
+    if (encoded > 0)
+        StatsNP[STATS_ENCODE_TIME].setValue(encodeTime / 1e6 / encoded);
+    if (recorded > 0)
+        StatsNP[STATS_RECORD_TIME].setValue(recordTime / 1e6 / recorded);
+    StatsNP[STATS_RECORD_DROPPED].setValue(recorder->droppedFrames());
+    StatsNP[STATS_RECORD_LATE].setValue(recorder->lateFrames());
+    StatsNP[STATS_LATENCY].setValue(streamLatency);
+    StatsNP.setState(active ? IPS_BUSY : IPS_IDLE);
+    StatsNP.apply();
+
+    publishTiming();
+}
+
+void StreamManagerPrivate::publishTiming()
+{
+    LatencyHistogram::Percentiles stages[TIMING_STAGES];
+    uint64_t counted = 0;
+    for (int stage = 0; stage < TIMING_STAGES; stage++)
+    {
+        stages[stage] = stageTimes[stage].take();
+        counted += stages[stage].count;
+    }
+
+    // Stages without frames since the last update keep their percentiles
+    for (int stage = 0; stage < TIMING_STAGES; stage++)
+    {
+        if (stages[stage].count == 0)
+            continue;
+        TimingNP[stage * 3 + 0].setValue(stages[stage].p50);
+        TimingNP[stage * 3 + 1].setValue(stages[stage].p95);
+        TimingNP[stage * 3 + 2].setValue(stages[stage].p99);
+    }
+    TimingNP.setState((isStreaming || isRecording) ? IPS_BUSY : IPS_IDLE);
+    TimingNP.apply();
+
+    if (timingLog == nullptr || counted == 0)
+        return;
+
+    // One row for the update, empty cells for the stages without frames
+    std::time_t t = std::time(nullptr);
+    fprintf(timingLog, "%s", format_time(*std::gmtime(&t), "%Y-%m-%dT%H:%M:%S").c_str());
+    for (const auto &stage : stages)
+    {
+        if (stage.count == 0)
+            fprintf(timingLog, ",,,,0");
+        else
+            fprintf(timingLog, ",%.3f,%.3f,%.3f,%llu", stage.p50, stage.p95, stage.p99,
+                    static_cast<unsigned long long>(stage.count));
+    }
+    fprintf(timingLog, "\n");
+    fflush(timingLog);
+}
+
+bool StreamManagerPrivate::setTimingLog(bool enable)
+{
+    if (timingLog)
+    {
+        fclose(timingLog);
+        timingLog = nullptr;
+    }
+
+    if (!enable)
+        return true;
+
+    std::string directory = expand(RecordFileTP[0].getText(), std::map<std::string, std::string>());
+    if (mkpath(directory, 0755))
+    {
+        LOGF_WARN("Can not create timing log directory %s: %s", directory.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::string const fileName = directory + "/" + expand("stream_timing__T_.csv", std::map<std::string, std::string>());
+    timingLog = fopen(fileName.c_str(), "w");
+    if (timingLog == nullptr)
+    {
+        LOGF_WARN("Can not open timing log %s: %s", fileName.c_str(), strerror(errno));
+        return false;
+    }
+
+    fprintf(timingLog, "time");
+    for (int stage = 0; stage < TIMING_STAGES; stage++)
+    {
+        std::string name = TimingNP[stage * 3].getName();
+        name = name.substr(0, name.rfind('_'));
+        fprintf(timingLog, ",%s_p50,%s_p95,%s_p99,%s_count", name.c_str(), name.c_str(), name.c_str(), name.c_str());
+    }
+    fprintf(timingLog, "\n");
+
+    LOGF_INFO("Stream timing logged to %s", fileName.c_str());
+    return true;
+}
+
+void StreamManagerPrivate::applyEncoderSettings()
+{
+    for (EncoderInterface * oneEncoder : encoderManager.getEncoderList())
+        oneEncoder->setRateControl(EncoderSettingsNP[ENCODER_BITRATE].getValue(),
+                                   EncoderSettingsNP[ENCODER_KEYFRAME_INTERVAL].getValue(),
+                                   EncoderSettingsNP[ENCODER_MAX_DELAY].getValue());
+#ifdef HAVE_LZ4
+    for (EncoderInterface * oneEncoder : encoderManager.getEncoderList())
+        oneEncoder->setCompression(RawCodecSP.findOnSwitch()->getName());
+#endif
+}
+
+void StreamManagerPrivate::applyRecorderSettings()
+{
+    for (RecorderInterface * oneRecorder : recorderManager.getRecorderList())
+        oneRecorder->setEncoderSettings(RecorderSettingsNP[RECORDER_QUALITY].getValue(),
+                                        RecorderSettingsNP[RECORDER_SPEED].getValue());
+}
+
+void StreamManagerPrivate::resetStatistics()
+{
+    fpsInstant = 0;
+    fpsAverage = 0;
+    framesDropped = 0;
+    encodedFrames = encodeNanoseconds = 0;
+    recordedFrames = recordNanoseconds = 0;
+    streamLatency = 0;
+    StatsNP[STATS_ENCODE_TIME].setValue(0);
+    StatsNP[STATS_RECORD_TIME].setValue(0);
+
+    for (auto &stage : stageTimes)
+        stage.take();
+}
+
 bool StreamManagerPrivate::recordStream(const uint8_t * buffer, uint32_t nbytes, double deltams, uint64_t timestamp)
 {
     INDI_UNUSED(deltams);
@@ -647,7 +1366,18 @@ bool StreamManagerPrivate::startRecording()
         }
     }
 
-    recorder->setFPS(FpsNP[FPS_AVERAGE].getValue());
+    recorder->setFPS(fpsAverage);
+
+    // Recordings limited in frames or duration let the recorder reserve their file, for the frames selected
+    double const selected = RecordSelectNP[RECORD_SELECT_BEST].getValue() / 100;
+    if (RecordStreamSP[RECORD_FRAME].getState() == ISS_ON)
+        recorder->setExpectedFrames(std::ceil(RecordOptionsNP[1].getValue() * selected));
+    else if (RecordStreamSP[RECORD_TIME].getState() == ISS_ON)
+        recorder->setExpectedFrames(std::ceil(RecordOptionsNP[0].getValue() * fpsAverage * selected));
+    else
+        recorder->setExpectedFrames(0);
+
+    recordScored = recordSelected = 0;
 
     /* pattern substitution */
     recordfiledir.assign(RecordFileTP[0].getText());
@@ -677,6 +1407,7 @@ bool StreamManagerPrivate::startRecording()
         LOGF_WARN("Can not open record file: %s", errmsg);
         return false;
     }
+    recordFile = filename;
 
 #if 0
     /* start capture */
@@ -703,6 +1434,7 @@ bool StreamManagerPrivate::startRecording()
     {
         FPSAverage.reset();
         FPSFast.reset();
+        resetStatistics();
     }
 
     if(currentDevice->getDriverInterface() & INDI::DefaultDevice::CCD_INTERFACE)
@@ -748,12 +1480,23 @@ bool StreamManagerPrivate::stopRecording(bool force)
 
     }
 
+    // The best frames of the last window, however short, are part of the recording
+    if (!force)
+    {
+        std::lock_guard<std::mutex> lock(recordMutex);
+        writeRecordWindow();
+    }
+
     isRecording = false;
     isRecordingAboutToClose = false;
 
+    // Frames still queued for the recorder would end up in the next recording
+    recordConsumer->clear();
     {
         std::lock_guard<std::mutex> lock(recordMutex);
         recorder->close();
+        recordWindow.clear();
+        recordWindowBytes = 0;
     }
 
     if (force)
@@ -764,6 +1507,17 @@ bool StreamManagerPrivate::stopRecording(bool force)
         FPSRecorder.totalTime(),
         FPSRecorder.totalFrames()
     );
+    if (recordScored > 0)
+        LOGF_INFO("Recorded the sharpest %llu of %llu frames", static_cast<unsigned long long>(recordSelected),
+                  static_cast<unsigned long long>(recordScored));
+
+    if (currentDevice->getDriverInterface() & INDI::DefaultDevice::CCD_INTERFACE)
+    {
+        auto &blobServer = dynamic_cast<INDI::CCD*>(currentDevice)->m_BlobHttpServer;
+        if (blobServer.isRunning())
+            LOGF_INFO("Recording available at %s",
+                      blobServer.url(blobServer.publishFile(recordFile, recorder->getExtension())).c_str());
+    }
 
     return true;
 }
@@ -835,7 +1589,6 @@ bool StreamManagerPrivate::ISNewSwitch(const char * dev, const char * name, ISSt
         else
         {
             RecordStreamSP.setState(IPS_IDLE);
-            Format.clear();
             FpsNP[FPS_INSTANT].setValue(0);
             FpsNP[FPS_AVERAGE].setValue(0);
             if (isRecording)
@@ -874,6 +1627,66 @@ bool StreamManagerPrivate::ISNewSwitch(const char * dev, const char * name, ISSt
         return true;
     }
 
+    // Raw Codec
+    if (RawCodecSP.isNameMatch(name))
+    {
+        RawCodecSP.update(states, names, n);
+        RawCodecSP.setState(IPS_OK);
+        applyEncoderSettings();
+        RawCodecSP.apply();
+        return true;
+    }
+
+    // DSP processing of the stream
+    if (StreamDSPSP.isNameMatch(name))
+    {
+        StreamDSPSP.update(states, names, n);
+        StreamDSPSP.setState(IPS_OK);
+        StreamDSPSP.apply();
+        return true;
+    }
+
+    // Live Stacking, turning it on or changing the mode starts a new stack
+    if (StackSP.isNameMatch(name))
+    {
+        bool const wasOff = StackSP[STACK_OFF].getState() == ISS_ON;
+        StackSP.update(states, names, n);
+        if (wasOff)
+            stacker.reset();
+        applyStackSettings();
+        StackSP.setState(StackSP[STACK_OFF].getState() == ISS_ON ? IPS_IDLE : IPS_BUSY);
+        StackSP.apply();
+        return true;
+    }
+
+    if (StackResetSP.isNameMatch(name))
+    {
+        stacker.reset();
+        stackPublished = 0;
+        publishStack();
+        StackResetSP.reset();
+        StackResetSP.setState(IPS_OK);
+        StackResetSP.apply();
+        return true;
+    }
+
+    // Timing Log
+    if (TimingLogSP.isNameMatch(name))
+    {
+        TimingLogSP.update(states, names, n);
+        bool const enable = TimingLogSP[TIMING_LOG_ON].getState() == ISS_ON;
+        if (setTimingLog(enable))
+            TimingLogSP.setState(enable ? IPS_BUSY : IPS_IDLE);
+        else
+        {
+            TimingLogSP.reset();
+            TimingLogSP[TIMING_LOG_OFF].setState(ISS_ON);
+            TimingLogSP.setState(IPS_ALERT);
+        }
+        TimingLogSP.apply();
+        return true;
+    }
+
     // Recorder Selection
     if (RecorderSP.isNameMatch(name))
     {
@@ -945,6 +1758,26 @@ bool StreamManagerPrivate::ISNewNumber(const char * dev, const char * name, doub
     if (dev != nullptr && strcmp(getDeviceName(), dev))
         return false;
 
+    // Encoder Settings
+    if (EncoderSettingsNP.isNameMatch(name))
+    {
+        EncoderSettingsNP.update(values, names, n);
+        EncoderSettingsNP.setState(IPS_OK);
+        applyEncoderSettings();
+        EncoderSettingsNP.apply();
+        return true;
+    }
+
+    // Recorder Settings, taken by the next recording
+    if (RecorderSettingsNP.isNameMatch(name))
+    {
+        RecorderSettingsNP.update(values, names, n);
+        RecorderSettingsNP.setState(IPS_OK);
+        applyRecorderSettings();
+        RecorderSettingsNP.apply();
+        return true;
+    }
+
     if (StreamExposureNP.isNameMatch(name))
     {
         StreamExposureNP.update(values, names, n);
@@ -953,6 +1786,25 @@ bool StreamManagerPrivate::ISNewNumber(const char * dev, const char * name, doub
         return true;
     }
 
+    // Stack Settings, taken by the next frame
+    if (StackSettingsNP.isNameMatch(name))
+    {
+        StackSettingsNP.update(values, names, n);
+        applyStackSettings();
+        StackSettingsNP.setState(IPS_OK);
+        StackSettingsNP.apply();
+        return true;
+    }
+
+    /* Timestamp Offset */
+    if (TimestampOffsetNP.isNameMatch(name))
+    {
+        TimestampOffsetNP.update(values, names, n);
+        TimestampOffsetNP.setState(IPS_OK);
+        TimestampOffsetNP.apply();
+        return true;
+    }
+
     /* Limits */
     if (LimitsNP.isNameMatch(name))
     {
@@ -960,6 +1812,10 @@ bool StreamManagerPrivate::ISNewNumber(const char * dev, const char * name, doub
 
         FPSPreview.setTimeWindow(1000.0 / LimitsNP[LIMITS_PREVIEW_FPS].getValue());
         FPSPreview.reset();
+        FPSPacing.setTimeWindow(1000.0 / LimitsNP[LIMITS_PREVIEW_FPS].getValue());
+        FPSPacing.reset();
+
+        statsTimer.setInterval(static_cast<int>(1000 / LimitsNP[LIMITS_STATS_RATE].getValue()));
 
         LimitsNP.setState(IPS_OK);
         LimitsNP.apply();
@@ -981,6 +1837,21 @@ bool StreamManagerPrivate::ISNewNumber(const char * dev, const char * name, doub
         return true;
     }
 
+    /* Record Selection */
+    if (RecordSelectNP.isNameMatch(name))
+    {
+        if (isRecording)
+        {
+            LOG_WARN("Recording device is busy");
+            return true;
+        }
+
+        RecordSelectNP.update(values, names, n);
+        RecordSelectNP.setState(IPS_OK);
+        RecordSelectNP.apply();
+        return true;
+    }
+
     /* Stream Frame */
     if (StreamFrameNP.isNameMatch(name))
     {
@@ -1047,7 +1918,10 @@ bool StreamManagerPrivate::setStream(bool enable)
             FPSAverage.reset();
             FPSFast.reset();
             FPSPreview.reset();
+            resetStatistics();
             FPSPreview.setTimeWindow(1000.0 / LimitsNP[LIMITS_PREVIEW_FPS].getValue());
+            FPSPacing.reset();
+            FPSPacing.setTimeWindow(1000.0 / LimitsNP[LIMITS_PREVIEW_FPS].getValue());
             frameCountDivider = 0;
 
             if(currentDevice->getDriverInterface() & INDI::DefaultDevice::CCD_INTERFACE)
@@ -1075,7 +1949,6 @@ bool StreamManagerPrivate::setStream(bool enable)
                 }
             }
             isStreaming = true;
-            Format.clear();
             FpsNP[FPS_INSTANT].setValue(0);
             FpsNP[FPS_AVERAGE].setValue(0);
             StreamSP.reset();
@@ -1086,7 +1959,6 @@ bool StreamManagerPrivate::setStream(bool enable)
     else
     {
         StreamSP.setState(IPS_IDLE);
-        Format.clear();
         FpsNP[FPS_INSTANT].setValue(0);
         FpsNP[FPS_AVERAGE].setValue(0);
         if (isStreaming)
@@ -1118,7 +1990,6 @@ bool StreamManagerPrivate::setStream(bool enable)
             StreamSP.reset();
             StreamSP[1].setState(ISS_ON);
             isStreaming = false;
-            Format.clear();
             FpsNP[FPS_INSTANT].setValue(0);
             FpsNP[FPS_AVERAGE].setValue(0);
 
@@ -1140,10 +2011,25 @@ bool StreamManager::saveConfigItems(FILE * fp)
 {
     D_PTR(StreamManager);
     d->EncoderSP.save(fp);
+#ifdef HAVE_LIBAVCODEC
+    d->EncoderSettingsNP.save(fp);
+#endif
     d->RecordFileTP.save(fp);
     d->RecordOptionsNP.save(fp);
+    d->RecordSelectNP.save(fp);
+#ifdef HAVE_LZ4
+    d->RawCodecSP.save(fp);
+#endif
     d->RecorderSP.save(fp);
+#ifdef HAVE_THEORA
+    d->RecorderSettingsNP.save(fp);
+#endif
     d->LimitsNP.save(fp);
+    d->TimestampOffsetNP.save(fp);
+    if (d->hasDSP())
+        d->StreamDSPSP.save(fp);
+    if (d->hasStacker())
+        d->StackSettingsNP.save(fp);
     return true;
 }
 
@@ -1174,8 +2060,59 @@ void StreamManager::getStreamFrame(uint16_t * x, uint16_t * y, uint16_t * w, uin
     d->getStreamFrame(x, y, w, h);
 }
 
-bool StreamManagerPrivate::uploadStream(const uint8_t * buffer, uint32_t nbytes)
+bool StreamManager::setStreamFrame(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    D_PTR(StreamManager);
+    if (d->isRecording)
+        return false;
+
+    StreamManagerPrivate::FrameInfo srcFrameInfo;
+    if (d->currentDevice->getDriverInterface() & INDI::DefaultDevice::CCD_INTERFACE)
+        srcFrameInfo = StreamManagerPrivate::FrameInfo(dynamic_cast<const INDI::CCD*>(d->currentDevice)->PrimaryCCD);
+    else if (d->currentDevice->getDriverInterface() & INDI::DefaultDevice::SENSOR_INTERFACE)
+        srcFrameInfo = StreamManagerPrivate::FrameInfo(*dynamic_cast<const INDI::SensorInterface*>(d->currentDevice));
+
+    if (srcFrameInfo.w == 0 || srcFrameInfo.h == 0)
+        return false;
+
+    x = std::min<uint16_t>(x, srcFrameInfo.w - 1);
+    y = std::min<uint16_t>(y, srcFrameInfo.h - 1);
+    w = std::max<uint16_t>(1, std::min<uint16_t>(w, srcFrameInfo.w - x));
+    h = std::max<uint16_t>(1, std::min<uint16_t>(h, srcFrameInfo.h - y));
+
+    // A new size resets the origin, which is set again afterwards
+    d->setSize(w, h);
+    d->setStreamFrame(x, y, w, h);
+    d->StreamFrameNP[CCDChip::FRAME_X].setMax(srcFrameInfo.w - 1);
+    d->StreamFrameNP[CCDChip::FRAME_Y].setMax(srcFrameInfo.h - 1);
+    d->StreamFrameNP.updateMinMax();
+    d->dstFrameInfo.x = x;
+    d->dstFrameInfo.y = y;
+
+    d->StreamFrameNP.setState(IPS_OK);
+    d->StreamFrameNP.apply();
+    return true;
+}
+
+void StreamManagerPrivate::applyImage(uint64_t timestamp)
+{
+    std::time_t const seconds = timestamp / 1000000;
+    std::tm utc;
+    gmtime_r(&seconds, &utc);
+
+    char buffer[MAXINDITSTAMP];
+    snprintf(buffer, sizeof(buffer), "%s.%06u", format_time(utc, "%Y-%m-%dT%H:%M:%S").c_str(),
+             static_cast<unsigned>(timestamp % 1000000));
+    imageBP.setTimestamp(buffer);
+    imageBP.apply();
+
+    // Images of exposures are stamped when they are sent
+    imageBP.setTimestamp("");
+}
+
+bool StreamManagerPrivate::uploadStream(const uint8_t * buffer, uint32_t nbytes, uint64_t timestamp)
 {
+    INDI_TRACE_SCOPE("StreamManager::uploadStream");
     // Send as is, already encoded.
     if (PixelFormat == INDI_JPG)
     {
@@ -1184,22 +2121,18 @@ bool StreamManagerPrivate::uploadStream(const uint8_t * buffer, uint32_t nbytes)
         if (dynamic_cast<INDI::CCD*>(currentDevice)->HasWebSocket()
                 && dynamic_cast<INDI::CCD*>(currentDevice)->WebSocketSP[CCD::WEBSOCKET_ENABLED].getState() == ISS_ON)
         {
-            if (Format != ".streajpg")
-            {
-                Format = ".streajpg";
-                dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_text(Format);
-            }
-
-            dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_binary(buffer, nbytes);
+            dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_frame(".stream_jpg", buffer, nbytes);
             return true;
         }
 #endif
+        INDI::ElapsedTimer sendElapsed;
         imageBP[0].setBlob(const_cast<uint8_t *>(buffer));
         imageBP[0].setBlobLen(nbytes);
         imageBP[0].setSize(nbytes);
         imageBP[0].setFormat(".stream_jpg");
         imageBP.setState(IPS_OK);
-        imageBP.apply();
+        applyImage(timestamp);
+        stageTimes[TIMING_SEND].add(sendElapsed.nsecsElapsed());
         return true;
     }
 
@@ -1213,27 +2146,27 @@ bool StreamManagerPrivate::uploadStream(const uint8_t * buffer, uint32_t nbytes)
     }
 #endif
 
+    INDI::ElapsedTimer stageElapsed;
     if(currentDevice->getDriverInterface() & INDI::DefaultDevice::CCD_INTERFACE)
     {
         if (encoder->upload(&imageBP[0], buffer, nbytes, dynamic_cast<INDI::CCD*>(currentDevice)->PrimaryCCD.isCompressed()))
         {
+            stageTimes[TIMING_ENCODE].add(stageElapsed.restart());
 #ifdef HAVE_WEBSOCKET
             if (dynamic_cast<INDI::CCD*>(currentDevice)->HasWebSocket()
                     && dynamic_cast<INDI::CCD*>(currentDevice)->WebSocketSP[CCD::WEBSOCKET_ENABLED].getState() == ISS_ON)
             {
-                if (Format != ".stream")
-                {
-                    Format = ".stream";
-                    dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_text(Format);
-                }
-
-                dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_binary(buffer, nbytes);
+                // The frame as encoded for the clients of the property, with its format
+                dynamic_cast<INDI::CCD*>(currentDevice)->wsServer.send_frame(imageBP[0].getFormat(), imageBP[0].getBlob(),
+                        imageBP[0].getBlobLen());
+                stageTimes[TIMING_SEND].add(stageElapsed.nsecsElapsed());
                 return true;
             }
 #endif
             // Upload to client now
             imageBP.setState(IPS_OK);
-            imageBP.apply();
+            applyImage(timestamp);
+            stageTimes[TIMING_SEND].add(stageElapsed.nsecsElapsed());
             return true;
         }
     }
@@ -1242,9 +2175,11 @@ bool StreamManagerPrivate::uploadStream(const uint8_t * buffer, uint32_t nbytes)
         if (encoder->upload(&imageBP[0], buffer, nbytes,
                             false))//dynamic_cast<INDI::SensorInterface*>(currentDevice)->isCompressed()))
         {
+            stageTimes[TIMING_ENCODE].add(stageElapsed.restart());
             // Upload to client now
             imageBP.setState(IPS_OK);
-            imageBP.apply();
+            applyImage(timestamp);
+            stageTimes[TIMING_SEND].add(stageElapsed.nsecsElapsed());
             return true;
         }
     }
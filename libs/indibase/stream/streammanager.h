@@ -26,6 +26,7 @@
 #include "indidevapi.h"
 #include "indibasetypes.h"
 #include "indimacros.h"
+#include "indibufferpool.h"
 #include <memory>
 
 /**
@@ -53,8 +54,9 @@
 
    Currently, two encoders are supported:
 
-   1. RAW Encoder: Frame is sent as is (lossless). If compression is enabled, the frame is compressed with zlib. Uncompressed format is ".stream"
-   and compressed format is ".stream.z"
+   1. RAW Encoder: Frame is sent as is (lossless). If compression is enabled, the frame is compressed with the codec of STREAM_RAW_CODEC.
+   Uncompressed format is ".stream", compressed formats are ".stream.z" for zlib and ".stream.lz4" for LZ4. The delta codec sends
+   ".stream.dlz4" frames, the LZ4 compressed XOR of the frame with the previous one, between ".stream.lz4" keyframes.
    2. MJPEG Encoder: Frame is encoded to a JPEG image before being transmitted. Format is ".stream_jpg"
 
    \section Recorders
@@ -71,7 +73,16 @@
 
    1. SER recorder: Saves video streams along with timestamps in <a href=http://www.grischa-hahn.homepage.t-online.de/astro/ser/">SER format</a>.
    2. OGV recorder: Saves video streams in libtheora OGV files. INDI must be compiled with the optional OGG Theora support for this functionality to be
-   available. Frame rate is estimated from the average FPS.
+   available. Frame rate is estimated from the average FPS. Frames are encoded on a thread of their own, at the quality and speed
+   of STREAM_RECORDER_SETTINGS.
+
+   \section Timestamps
+
+   Each frame carries the UTC time it was captured at, as given by the driver to newFrame() or else the time it reaches the stream,
+   corrected by STREAM_TIMESTAMP_OFFSET. The time is that of the system clock, which the GPS drivers set through SYSTEM_TIME_UPDATE, or
+   NTP disciplined by a PPS signal, so that the frames of cameras on different drivers and hosts can be merged by their timestamps.
+   The SER recorder writes them in its trailer, and the frames sent to the clients have it as the timestamp of their BLOB vector, with
+   microseconds.
 
    \section Subframing
 
@@ -114,9 +125,30 @@ class StreamManager
     public:
         /**
          * @brief newFrame CCD drivers call this function when a new frame is received. It is then streamed, or recorded, or both according to the settings in the streamer.
+         * @param timestamp UTC time the frame was captured at, in microseconds since the Unix epoch, or 0 to stamp it as it reaches the stream.
          */
         void newFrame(const uint8_t *buffer, uint32_t nbytes, uint64_t timestamp = 0);
 
+        /**
+         * @brief acquireFrame Lends a buffer of nbytes from the pool of the stream, for the driver to read
+         * a frame straight into and hand over with newFrame(BufferPool::Buffer &&), saving the copy.
+         * @return An empty buffer when out of memory.
+         */
+        BufferPool::Buffer acquireFrame(size_t nbytes);
+
+        /**
+         * @brief newFrame Streams or records a frame filled in a buffer from acquireFrame(), without copying it.
+         * The buffer goes back to the pool once the recorder and the encoders are done with it, or right away
+         * if the frame is dropped.
+         */
+        void newFrame(BufferPool::Buffer &&frame, uint64_t timestamp = 0);
+
+        /**
+         * @brief setBufferPool Takes the copies of the frames from pool, shared with the device, rather than
+         * from a pool of the stream of its own. To be called before streaming starts.
+         */
+        void setBufferPool(const BufferPool &pool);
+
         bool close();
 
     public:
@@ -146,6 +178,13 @@ class StreamManager
         double getTargetExposure() const;
 
         void getStreamFrame(uint16_t *x, uint16_t *y, uint16_t *w, uint16_t *h) const;
+
+        /**
+         * @brief setStreamFrame Crops the streamed frames to w x h from x, y, in binned pixels of the frame of the
+         * device, as CCD_STREAM_FRAME does. Clamped to the frame of the device.
+         * @return False while recording.
+         */
+        bool setStreamFrame(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
         RecorderInterface *getRecorder() const;
 
         const char *getDeviceName() const;
@@ -27,13 +27,22 @@
 #include "recorder/recordermanager.h"
 #include "encoder/encodermanager.h"
 #include "fpsmeter.h"
-#include "uniquequeue.h"
+#include "ringqueue.h"
 #include "gammalut16.h"
+#include "streamstacker.h"
+#include "indibufferpool.h"
+#include "inditimer.h"
+#include "indielapsedtimer.h"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include <string>
 #include <map>
 #include <thread>
+#include <vector>
 
 #include "indiccdchip.h"
 #include "indisensorinterface.h"
@@ -98,6 +107,19 @@ class StreamManagerPrivate
                 return other.x != x || other.y != y || other.w != w || other.h != h;
             }
         };
+
+        // A frame handed to the consumers of the stream. They share its buffer and only read it.
+        struct StreamFrame
+        {
+            std::shared_ptr<const BufferPool::Buffer> buffer;
+            // Layout of the source frame and of its subframe; the buffer holds the subframe once it is cut
+            FrameInfo source, subframe;
+            bool subframed = false;
+            double time = 0;
+            uint64_t timestamp = 0;
+            std::chrono::steady_clock::time_point queued;
+            bool paced = false;
+        };
     public:
         StreamManagerPrivate(DefaultDevice *defaultDevice);
         virtual ~StreamManagerPrivate();
@@ -111,6 +133,12 @@ class StreamManagerPrivate
         bool ISNewNumber(const char * dev, const char * name, double values[], char * names[], int n);
 
         void newFrame(const uint8_t * buffer, uint32_t nbytes, uint64_t timestamp);
+        void newFrame(BufferPool::Buffer &&frame, uint64_t timestamp);
+
+        // Counts a new frame in the statistics, false if it is not to be streamed nor recorded
+        bool acceptFrame(size_t nbytes);
+        // Queues an accepted frame and ends the recording once it has all its frames
+        void queueFrame(BufferPool::Buffer &&frame, uint64_t timestamp);
 
         bool updateProperties();
         bool setStream(bool enable);
@@ -121,10 +149,35 @@ class StreamManagerPrivate
         bool setPixelFormat(INDI_PIXEL_FORMAT pixelFormat, uint8_t pixelDepth);
 
         /**
-         * @brief Thread processing frames and forwarding to recording and preview
+         * @brief Thread cutting the subframe of the frames and fanning them out to the recorder, the preview and the DSP
          */
         void asyncStreamThread();
 
+        // The work of the consumers of the stream, each on its own thread
+        void recordFrame(const StreamFrame &frame);
+        // With recordMutex held
+        void writeRecordFrame(const StreamFrame &frame);
+        void writeRecordWindow();
+        void previewFrame(const StreamFrame &frame);
+        void processFrame(const StreamFrame &frame);
+        void stackFrame(const StreamFrame &frame);
+
+        // The device is a camera with DSP plugins
+        bool hasDSP() const;
+
+        // The device is a camera, whose mono streams can be stacked
+        bool hasStacker() const;
+
+        /**
+         * @brief publishStack Sends the stack and its statistics to the clients when frames were added, called by stackTimer
+         */
+        void publishStack();
+
+        /**
+         * @brief applyStackSettings Passes StackSP and StackSettingsNP to the stacker and starts or stops stackTimer
+         */
+        void applyStackSettings();
+
         // helpers
         static std::string expand(const std::string &fname, const std::map<std::string, std::string> &patterns);
 
@@ -138,9 +191,46 @@ class StreamManagerPrivate
          * @brief uploadStream Upload frame to client using the selected encoder
          * @param buffer pointer to frame image buffer
          * @param nbytes size of frame in bytes
+         * @param timestamp UTC time the frame was captured at, in microseconds since the Unix epoch, sent as the timestamp of the BLOB
          * @return True if frame is encoded and sent to client, false otherwise.
          */
-        bool uploadStream(const uint8_t *buffer, uint32_t nbytes);
+        bool uploadStream(const uint8_t *buffer, uint32_t nbytes, uint64_t timestamp);
+
+        /**
+         * @brief applyImage Sends imageBP with the capture time of its frame as timestamp, in ISO 8601 UTC with microseconds
+         * @param timestamp Microseconds since the Unix epoch
+         */
+        void applyImage(uint64_t timestamp);
+
+        /**
+         * @brief publishStatistics Sends FPS, stream delay and the stream statistics to the clients, called by statsTimer
+         */
+        void publishStatistics();
+
+        /**
+         * @brief resetStatistics Clears the statistics when a stream or a recording starts
+         */
+        void resetStatistics();
+
+        /**
+         * @brief applyEncoderSettings Passes the bitrate, keyframe interval and delay of EncoderSettingsNP and the codec of RawCodecSP to the encoders
+         */
+        void applyEncoderSettings();
+
+        /**
+         * @brief applyRecorderSettings Passes the quality and speed of RecorderSettingsNP to the recorders
+         */
+        void applyRecorderSettings();
+
+        /**
+         * @brief publishTiming Publishes the stage percentiles of the frames since the last call, and logs them
+         */
+        void publishTiming();
+
+        /**
+         * @brief setTimingLog Opens a new CSV file of the stage percentiles, or closes it
+         */
+        bool setTimingLog(bool enable);
 
         /**
          * @brief recordStream Calls the backend recorder to record a single frame.
@@ -198,6 +288,10 @@ class StreamManagerPrivate
         /* Record Options */
         INDI::PropertyNumber RecordOptionsNP {2};
 
+        // Lucky imaging, only the sharpest frames of each window of the stream are recorded
+        INDI::PropertyNumber RecordSelectNP {2};
+        enum { RECORD_SELECT_BEST, RECORD_SELECT_WINDOW };
+
         // Stream Frame
         INDI::PropertyNumber StreamFrameNP {4};
 
@@ -205,16 +299,72 @@ class StreamManagerPrivate
         INDI::PropertyBlob imageBP{INDI::Property()};
 
         // Encoder Selector. It's static now but should this implemented as plugin interface?
-        INDI::PropertySwitch EncoderSP {2};
-        enum { ENCODER_RAW, ENCODER_MJPEG };
+        INDI::PropertySwitch EncoderSP {4};
+        enum { ENCODER_RAW, ENCODER_MJPEG, ENCODER_H264, ENCODER_H265 };
+
+        // Frames of the stream also go through the DSP plugins of the camera
+        INDI::PropertySwitch StreamDSPSP {2};
+        enum { STREAM_DSP_ON, STREAM_DSP_OFF };
+
+        // Live stacking of the mono frames of the stream, registered on their stars
+        INDI::PropertySwitch StackSP {3};
+        enum { STACK_MEAN, STACK_SIGMA_CLIP, STACK_OFF };
+
+        INDI::PropertyNumber StackSettingsNP {4};
+        enum { STACK_PUBLISH_PERIOD, STACK_MIN_STARS, STACK_MAX_FWHM, STACK_SIGMA };
+
+        INDI::PropertyNumber StackStatsNP {2};
+        enum { STACK_STACKED, STACK_REJECTED };
+
+        INDI::PropertySwitch StackResetSP {1};
+
+        INDI::PropertyBlob StackBP {1};
+
+        // Rate control of the video encoders
+        INDI::PropertyNumber EncoderSettingsNP {3};
+        enum { ENCODER_BITRATE, ENCODER_KEYFRAME_INTERVAL, ENCODER_MAX_DELAY };
+
+        // Codec of the compressed frames of the raw encoder, the delta codec sends the changes to the previous frame
+        INDI::PropertySwitch RawCodecSP {3};
+        enum { RAW_CODEC_ZLIB, RAW_CODEC_LZ4, RAW_CODEC_DELTA_LZ4 };
 
         // Recorder Selector. Static but should be implemented as a dynamic plugin interface
         INDI::PropertySwitch RecorderSP {2};
         enum { RECORDER_RAW, RECORDER_OGV };
 
-        // Limits. Maximum queue size for incoming frames. FPS Limit for preview
-        INDI::PropertyNumber LimitsNP {2};
-        enum { LIMITS_BUFFER_MAX, LIMITS_PREVIEW_FPS };
+        INDI::PropertyNumber RecorderSettingsNP {2};
+        enum { RECORDER_QUALITY, RECORDER_SPEED };
+
+        // Limits. Maximum queue size for incoming frames. FPS Limit for preview. Rate of the statistics.
+        // Latency budget of the live view, 0 to keep every frame the buffer holds
+        INDI::PropertyNumber LimitsNP {4};
+        enum { LIMITS_BUFFER_MAX, LIMITS_PREVIEW_FPS, LIMITS_STATS_RATE, LIMITS_MAX_LATENCY };
+
+        // Correction added to the capture timestamps, for the delay between the exposure and the frame reaching the driver
+        INDI::PropertyNumber TimestampOffsetNP {1};
+
+        /* Stream statistics */
+        INDI::PropertyNumber StatsNP {7};
+        enum { STATS_DROPPED, STATS_QUEUED, STATS_ENCODE_TIME, STATS_RECORD_TIME, STATS_RECORD_DROPPED, STATS_RECORD_LATE, STATS_LATENCY };
+
+        /* Percentiles of the time frames spend in each stage of the stream, p50, p95 and p99 of each */
+        enum
+        {
+            TIMING_CAPTURE,  // between frames of the camera
+            TIMING_COPY,     // copy of the frame given to newFrame
+            TIMING_QUEUE,    // wait for the stream thread
+            TIMING_SUBFRAME, // subframe, and downscale of the preview
+            TIMING_ENCODE,   // encoder of the preview
+            TIMING_SEND,     // preview sent to the clients
+            TIMING_RECORD,   // frame given to the recorder
+            TIMING_LATENCY,  // from newFrame to the clients
+            TIMING_STAGES
+        };
+        INDI::PropertyNumber TimingNP {TIMING_STAGES * 3};
+
+        /* Timing percentiles also written to a CSV file, in the record directory */
+        INDI::PropertySwitch TimingLogSP {2};
+        enum { TIMING_LOG_ON, TIMING_LOG_OFF };
 
         std::atomic<bool> isStreaming { false };
         std::atomic<bool> isRecording { false };
@@ -226,6 +376,7 @@ class StreamManagerPrivate
         RecorderInterface *recorder = nullptr;
         bool direct_record = false;
         std::string recordfiledir, recordfilename; /* in case we should move it */
+        std::string recordFile; /* of the last recording, to publish it once closed */
 
         // Encoders
         EncoderManager encoderManager;
@@ -235,31 +386,102 @@ class StreamManagerPrivate
         FPSMeter FPSAverage;
         FPSMeter FPSFast;
         FPSMeter FPSPreview;
+        FPSMeter FPSPacing;
         FPSMeter FPSRecorder;
 
         uint32_t frameCountDivider = 0;
+        // The frame accepted last was picked for the live view by the latency mode
+        bool framePaced = false;
 
         INDI_PIXEL_FORMAT PixelFormat = INDI_MONO;
         uint8_t PixelDepth = 8;
         uint16_t rawWidth = 0, rawHeight = 0;
-        std::string Format;
 
         // Processing for streaming
         typedef struct
         {
             double time;
             uint64_t timestamp;
-            std::vector<uint8_t> frame;
+            BufferPool::Buffer frame;
+            // When the frame was queued, and whether it was already picked for the live view by the latency mode
+            std::chrono::steady_clock::time_point queued;
+            bool paced;
         } TimeFrame;
 
+        // A stage the stream frames fan out to, with its own ring, its own drop policy and its own thread.
+        // A slow stage drops frames without holding the others back.
+        class Consumer
+        {
+            public:
+                Consumer(size_t capacity, RingQueue<StreamFrame>::Overflow overflow,
+                         const std::function<void(const StreamFrame &)> &process);
+                ~Consumer();
+
+                // Queues the frame, false if the ring was full and a frame, this one or the oldest, was dropped
+                bool push(const StreamFrame &frame);
+
+                // Waits until every frame queued so far is processed or dropped
+                void waitForIdle();
+
+                // Drops the queued frames
+                void clear();
+
+            private:
+                void run();
+
+            private:
+                RingQueue<StreamFrame> frames;
+                std::function<void(const StreamFrame &)> process;
+
+                // Frames queued and not yet processed or dropped
+                std::mutex mutex;
+                std::condition_variable idle;
+                size_t pending = 0;
+
+                std::thread thread;
+        };
+
+        // Buffers of the frames copied by newFrame and of the subframed and downscaled ones
+        BufferPool               framePool;
+
         std::thread              framesThread;   // async incoming frames processing
         std::atomic<bool>        framesThreadTerminate {false};
-        UniqueQueue<TimeFrame>   framesIncoming;
+        RingQueue<TimeFrame>     framesIncoming;
 
-        std::mutex               fastFPSUpdate;
         std::mutex               recordMutex;
 
+        // Frames of the window of the selection, with their sharpness, and the frames scored and recorded so far
+        std::vector<std::pair<double, StreamFrame>> recordWindow;
+        size_t                   recordWindowBytes {0};
+        uint64_t                 recordScored {0}, recordSelected {0};
+
+        // Statistics gathered by the camera and stream threads, published from the event loop by statsTimer
+        INDI::Timer              statsTimer;
+        std::atomic<double>      fpsInstant {0};
+        std::atomic<double>      fpsAverage {0};
+        std::atomic<double>      streamDelay {0};
+        std::atomic<double>      streamLatency {0};
+        std::atomic<uint64_t>    framesDropped {0};
+        std::atomic<uint64_t>    encodeNanoseconds {0}, encodedFrames {0};
+        std::atomic<uint64_t>    recordNanoseconds {0}, recordedFrames {0};
+        LatencyHistogram         stageTimes[TIMING_STAGES];
+        FILE                    *timingLog {nullptr};
+        bool                     statsActive {false};
+
         GammaLut16               gammaLut16;
+
+        // Consumers of the stream, fed by asyncStreamThread
+        std::unique_ptr<Consumer> recordConsumer;
+        std::unique_ptr<Consumer> previewConsumer;
+        std::unique_ptr<Consumer> dspConsumer;
+        int                      dspSizes[2] {0, 0};
+
+        // Live stack, fed by stackConsumer and published from the event loop by stackTimer
+        StreamStacker            stacker;
+        std::unique_ptr<Consumer> stackConsumer;
+        INDI::Timer              stackTimer;
+        uint32_t                 stackPublished {0};
+        std::vector<uint8_t>     stackImage;
 };
 
 }
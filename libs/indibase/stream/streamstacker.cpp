@@ -0,0 +1,314 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "streamstacker.h"
+
+#include "fitswriter.h"
+#include "indistaranalysis.h"
+#include "indithreadpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "simd.h"
+
+namespace INDI
+{
+
+// The brightest stars are enough to register a frame, the triangles of the index grow with their square
+static constexpr size_t REGISTER_STARS = 20;
+// Rows warped and accumulated by each task
+static constexpr size_t ROWS_PER_TASK = 16;
+
+StreamStacker::StreamStacker()
+{
+}
+
+StreamStacker::~StreamStacker()
+{
+    freeStarStream(m_Reference);
+}
+
+void StreamStacker::setSettings(const Settings &settings)
+{
+    const std::lock_guard<std::mutex> registerLock(m_RegisterLock);
+    bool const restart = settings.mode != m_Settings.mode;
+    m_Settings = settings;
+    if (restart)
+        clear();
+}
+
+void StreamStacker::reset()
+{
+    const std::lock_guard<std::mutex> registerLock(m_RegisterLock);
+    clear();
+}
+
+void StreamStacker::clear()
+{
+    freeStarStream(m_Reference);
+    m_Reference = nullptr;
+
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    m_Mean.clear();
+    m_M2.clear();
+    m_Count.clear();
+    m_Stacked = 0;
+    m_Rejected = 0;
+}
+
+void StreamStacker::freeStarStream(dsp_stream_p stream)
+{
+    if (stream == nullptr)
+        return;
+
+    while (stream->triangles_count > 0)
+        dsp_stream_del_triangle(stream, stream->triangles_count - 1);
+    for (int i = 0; i < stream->stars_count; i++)
+        free(stream->stars[i].center.location);
+    free(stream->align_info.center);
+    free(stream->align_info.factor);
+    free(stream->align_info.offset);
+    free(stream->align_info.radians);
+    dsp_stream_free(stream);
+}
+
+dsp_stream_p StreamStacker::starStream(const void *pixels, uint32_t width, uint32_t height, int bpp,
+                                       Result &result) const
+{
+    StarMetrics metrics;
+    std::vector<Star> stars;
+    if (!measureStars(pixels, width, height, bpp, metrics, stars) ||
+            stars.size() < std::max<size_t>(3, m_Settings.minStars))
+    {
+        result = FRAME_FEW_STARS;
+        return nullptr;
+    }
+
+    if (m_Settings.maxFWHM > 0 && metrics.fwhm > m_Settings.maxFWHM)
+    {
+        result = FRAME_BLURRED;
+        return nullptr;
+    }
+
+    // The index compares the brightness of the stars too, relative to the median one of the frame it does not
+    // change with the transparency or the exposure
+    stars.resize(std::min(stars.size(), REGISTER_STARS));
+    std::vector<double> fluxes;
+    for (const Star &star : stars)
+        fluxes.push_back(star.flux);
+    std::nth_element(fluxes.begin(), fluxes.begin() + fluxes.size() / 2, fluxes.end());
+    double const median = std::max(fluxes[fluxes.size() / 2], 1e-9);
+
+    dsp_stream_p stream = dsp_stream_new();
+    dsp_stream_add_dim(stream, static_cast<int>(width));
+    dsp_stream_add_dim(stream, static_cast<int>(height));
+    for (const Star &star : stars)
+    {
+        double location[2] = {star.x, star.y};
+        dsp_star point;
+        memset(&point, 0, sizeof(point));
+        point.center.dims = 2;
+        point.center.location = location;
+        point.diameter = point.peak = point.flux = star.flux / median;
+        dsp_stream_add_star(stream, point);
+    }
+
+    result = FRAME_STACKED;
+    return stream;
+}
+
+StreamStacker::Result StreamStacker::add(const void *pixels, uint32_t width, uint32_t height, int bpp)
+{
+    if (pixels == nullptr || width == 0 || height == 0 || (bpp != 8 && bpp != 16))
+        return FRAME_UNSUPPORTED;
+
+    const std::lock_guard<std::mutex> registerLock(m_RegisterLock);
+    if (width != m_Width || height != m_Height || bpp != m_BPP)
+    {
+        clear();
+        m_Width = width;
+        m_Height = height;
+        m_BPP = bpp;
+    }
+
+    Result result;
+    dsp_stream_p stars = starStream(pixels, width, height, bpp, result);
+    if (stars == nullptr)
+    {
+        m_Rejected++;
+        return result;
+    }
+
+    // Where the pixels of the reference are in the frame
+    Transform transform;
+    if (m_Reference == nullptr)
+        m_Reference = stars;
+    else
+    {
+        // The alignment allocates them again
+        free(stars->align_info.center);
+        free(stars->align_info.factor);
+        free(stars->align_info.offset);
+        free(stars->align_info.radians);
+        stars->align_info.center = stars->align_info.factor = stars->align_info.offset = stars->align_info.radians = nullptr;
+
+        int const err = dsp_align_get_offset(m_Reference, stars, 2, 90, 3);
+        if (err & DSP_ALIGN_NO_MATCH)
+        {
+            freeStarStream(stars);
+            m_Rejected++;
+            return FRAME_NOT_REGISTERED;
+        }
+
+        // From the reference about the center c1 of its triangle, to the frame about the center c2 of the same one
+        const dsp_align_info &info = stars->align_info;
+        double const angle  = -info.radians[0];
+        double const factor = info.factor[0];
+        double const c2[2] = {info.center[0], info.center[1]};
+        double const c1[2] = {c2[0] - info.offset[0], c2[1] - info.offset[1]};
+        transform.a[0] =  factor * std::cos(angle);
+        transform.a[1] = -factor * std::sin(angle);
+        transform.a[2] =  factor * std::sin(angle);
+        transform.a[3] =  factor * std::cos(angle);
+        transform.b[0] = c2[0] - transform.a[0] * c1[0] - transform.a[1] * c1[1];
+        transform.b[1] = c2[1] - transform.a[2] * c1[0] - transform.a[3] * c1[1];
+        freeStarStream(stars);
+    }
+
+    const std::lock_guard<std::mutex> lock(m_Lock);
+    size_t const pixelCount = static_cast<size_t>(width) * height;
+    if (m_Mean.size() != pixelCount)
+    {
+        m_Mean.assign(pixelCount, 0);
+        m_M2.assign(pixelCount, 0);
+        m_Count.assign(pixelCount, 0);
+    }
+
+    ThreadPool::global().parallelFor(0, (height + ROWS_PER_TASK - 1) / ROWS_PER_TASK, [&](size_t task)
+    {
+        std::vector<dsp_t> samples(width), weights(width);
+        uint32_t const last = std::min<uint32_t>(height, (task + 1) * ROWS_PER_TASK);
+        for (uint32_t y = task * ROWS_PER_TASK; y < last; y++)
+        {
+            warpRow(pixels, transform, y, samples.data(), weights.data());
+            accumulateRow(static_cast<size_t>(y) * width, samples.data(), weights.data());
+        }
+    });
+
+    m_Stacked++;
+    return FRAME_STACKED;
+}
+
+void StreamStacker::warpRow(const void *pixels, const Transform &transform, uint32_t y, dsp_t *samples,
+                            dsp_t *weights) const
+{
+    auto const pixel = [this, pixels](uint32_t x, uint32_t y) -> double
+    {
+        size_t const i = static_cast<size_t>(y) * m_Width + x;
+        return m_BPP == 8 ? static_cast<const uint8_t *>(pixels)[i] : static_cast<const uint16_t *>(pixels)[i];
+    };
+
+    // Bilinear samples, the points out of the frame are left out of the stack
+    for (uint32_t x = 0; x < m_Width; x++)
+    {
+        double const fx = transform.a[0] * x + transform.a[1] * y + transform.b[0];
+        double const fy = transform.a[2] * x + transform.a[3] * y + transform.b[1];
+        if (!(fx >= 0 && fy >= 0 && fx <= m_Width - 1 && fy <= m_Height - 1))
+        {
+            samples[x] = 0;
+            weights[x] = 0;
+            continue;
+        }
+
+        uint32_t const x0 = std::min<uint32_t>(fx, m_Width - 2 + (m_Width == 1));
+        uint32_t const y0 = std::min<uint32_t>(fy, m_Height - 2 + (m_Height == 1));
+        uint32_t const x1 = std::min(x0 + 1, m_Width - 1), y1 = std::min(y0 + 1, m_Height - 1);
+        double const dx = fx - x0, dy = fy - y0;
+        double const top    = pixel(x0, y0) + (pixel(x1, y0) - pixel(x0, y0)) * dx;
+        double const bottom = pixel(x0, y1) + (pixel(x1, y1) - pixel(x0, y1)) * dx;
+        samples[x] = top + (bottom - top) * dy;
+        weights[x] = 1;
+    }
+}
+
+void StreamStacker::accumulateRow(size_t offset, const dsp_t *samples, const dsp_t *weights)
+{
+    dsp_t *mean = m_Mean.data() + offset, *m2 = m_M2.data() + offset, *count = m_Count.data() + offset;
+    bool const clip = m_Settings.mode == STACK_SIGMA_CLIP;
+    dsp_t const k2 = m_Settings.sigma * m_Settings.sigma;
+    uint32_t x = 0;
+
+    // A sample is left out once 3 are stacked if it is further than sigma from their mean. The variance has a floor
+    // of 1, the pixels of identical samples would leave out all the next ones.
+    dsp_vec_t const one = dsp_vec_t {} + 1, three = dsp_vec_t {} + 3, zero = dsp_vec_t {};
+    for (; x + DSP_VEC_LANES <= m_Width; x += DSP_VEC_LANES)
+    {
+        dsp_vec_t const value = dsp_vec_load(samples + x);
+        dsp_vec_t weight = dsp_vec_load(weights + x);
+        dsp_vec_t n = dsp_vec_load(count + x), mu = dsp_vec_load(mean + x), s = dsp_vec_load(m2 + x);
+        dsp_vec_t const delta = value - mu;
+        if (clip)
+            weight = dsp_vec_select((n < three) | (delta * delta * n <= k2 * (s + n)), weight, zero);
+        n += weight;
+        mu += weight * delta / dsp_vec_max(n, one);
+        s += weight * delta * (value - mu);
+        dsp_vec_store(count + x, n);
+        dsp_vec_store(mean + x, mu);
+        dsp_vec_store(m2 + x, s);
+    }
+
+    for (; x < m_Width; x++)
+    {
+        dsp_t weight = weights[x];
+        dsp_t const delta = samples[x] - mean[x];
+        if (clip && count[x] >= 3 && delta * delta * count[x] > k2 * (m2[x] + count[x]))
+            weight = 0;
+        count[x] += weight;
+        mean[x] += weight * delta / std::max<dsp_t>(count[x], 1);
+        m2[x] += weight * delta * (samples[x] - mean[x]);
+    }
+}
+
+bool StreamStacker::render(std::vector<uint8_t> &fits) const
+{
+    std::vector<uint16_t> pixels;
+    uint32_t width, height, stacked;
+    {
+        const std::lock_guard<std::mutex> lock(m_Lock);
+        stacked = m_Stacked;
+        if (stacked == 0 || m_Mean.empty())
+            return false;
+
+        width = m_Width;
+        height = m_Height;
+        double const scale = m_BPP == 8 ? 257 : 1;
+        pixels.resize(m_Mean.size());
+        for (size_t i = 0; i < pixels.size(); i++)
+            pixels[i] = static_cast<uint16_t>(std::min(65535.0, std::max(0.0, std::round(m_Mean[i] * scale))));
+    }
+
+    long const naxes[2] = {static_cast<long>(width), static_cast<long>(height)};
+    std::string const header = makeFITSHeader(16, 2, naxes, {FITSRecord("NCOMBINE", static_cast<int64_t>(stacked), "Frames stacked")});
+
+    fits.resize(header.size() + getFITSDataSize(pixels.size(), 16));
+    memcpy(fits.data(), header.data(), header.size());
+    writeFITSData(fits.data() + header.size(), pixels.data(), pixels.size(), 16);
+    return true;
+}
+
+}
@@ -0,0 +1,138 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "dsp.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace INDI
+{
+
+/**
+ * @class StreamStacker
+ * @brief The StreamStacker class stacks the mono frames of a stream as they arrive, for live stacking and lucky
+ * imaging.
+ *
+ * The first good frame is the reference. The stars of the next ones are matched to its stars by the triangle index
+ * of dsp_align_get_offset(), and each frame is turned and shifted onto the reference before it is added. Frames with
+ * too few stars or too large a FWHM are rejected. The stack is a running mean, or a running mean which leaves out
+ * the pixels more than a given sigma away from it once a few frames are stacked.
+ *
+ * add() is called from the thread of the frames and render() from any other one.
+ */
+class StreamStacker
+{
+    public:
+        typedef enum
+        {
+            STACK_MEAN,
+            STACK_SIGMA_CLIP
+        } Mode;
+
+        typedef enum
+        {
+            FRAME_STACKED,
+            FRAME_FEW_STARS,
+            FRAME_BLURRED,
+            FRAME_NOT_REGISTERED,
+            FRAME_UNSUPPORTED
+        } Result;
+
+        struct Settings
+        {
+            Mode mode {STACK_MEAN};
+            /** @brief Frames with fewer stars are rejected, at least 3 are needed to register a frame. */
+            size_t minStars {5};
+            /** @brief Frames with a larger median FWHM, in pixels, are rejected. 0 to take them all. */
+            double maxFWHM {0};
+            /** @brief Pixels this many standard deviations away from the stack are left out of STACK_SIGMA_CLIP. */
+            double sigma {3};
+        };
+
+    public:
+        StreamStacker();
+        ~StreamStacker();
+
+        /** @brief Sets how frames are stacked, starting a new stack if the mode changed. */
+        void setSettings(const Settings &settings);
+
+        /** @brief Starts a new stack, the next good frame is the reference. */
+        void reset();
+
+        /**
+         * @brief Registers and adds a frame of unsigned pixels of bpp bits, 8 or 16. A frame of another size than the
+         * stack starts a new one.
+         */
+        Result add(const void *pixels, uint32_t width, uint32_t height, int bpp);
+
+        /** @return Frames in the stack. */
+        uint32_t stacked() const
+        {
+            return m_Stacked;
+        }
+
+        /** @return Frames rejected since the stack started. */
+        uint32_t rejected() const
+        {
+            return m_Rejected;
+        }
+
+        /**
+         * @brief Renders the stack as a FITS file of 16 bit pixels, the 8 bit frames scaled to 16 bits.
+         * @return False if nothing is stacked yet.
+         */
+        bool render(std::vector<uint8_t> &fits) const;
+
+    private:
+        // Maps the pixels of the reference to the frame, x' = a[0] x + a[1] y + b[0], y' = a[2] x + a[3] y + b[1]
+        struct Transform
+        {
+            double a[4] {1, 0, 0, 1};
+            double b[2] {0, 0};
+        };
+
+        // With m_RegisterLock held
+        void clear();
+        dsp_stream_p starStream(const void *pixels, uint32_t width, uint32_t height, int bpp, Result &result) const;
+        static void freeStarStream(dsp_stream_p stream);
+
+        // Bilinear samples of a row of the reference in the frame, the weight is 0 off the frame
+        void warpRow(const void *pixels, const Transform &transform, uint32_t y, dsp_t *samples, dsp_t *weights) const;
+        // With m_Lock held
+        void accumulateRow(size_t offset, const dsp_t *samples, const dsp_t *weights);
+
+    private:
+        Settings m_Settings;
+        uint32_t m_Width {0}, m_Height {0};
+        int m_BPP {0};
+        // Stars of the reference, the frames are registered against
+        dsp_stream_p m_Reference {nullptr};
+
+        // Running mean, sum of the squared deviations and count of the samples of each pixel
+        std::vector<dsp_t> m_Mean, m_M2, m_Count;
+
+        std::atomic<uint32_t> m_Stacked {0};
+        std::atomic<uint32_t> m_Rejected {0};
+        // m_RegisterLock serializes the frames and the changes of the settings, m_Lock guards the stack
+        std::mutex m_RegisterLock;
+        mutable std::mutex m_Lock;
+};
+
+}
@@ -0,0 +1,93 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "inditaskqueue.h"
+#include "inditaskqueue_p.h"
+
+namespace INDI
+{
+
+TaskQueuePrivate::TaskQueuePrivate()
+{
+    thread = std::thread(&TaskQueuePrivate::run, this);
+}
+
+TaskQueuePrivate::~TaskQueuePrivate()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        isAboutToQuit = true;
+        tasks.clear();
+        wakeup.notify_all();
+    }
+
+    if (thread.joinable())
+        thread.join();
+}
+
+void TaskQueuePrivate::run()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        wakeup.wait(guard, [this] { return !tasks.empty() || isAboutToQuit; });
+        if (isAboutToQuit)
+            break;
+
+        std::function<void()> task = std::move(tasks.front());
+        tasks.pop_front();
+        running = true;
+
+        guard.unlock();
+        task();
+        task = nullptr;
+        guard.lock();
+
+        running = false;
+        if (tasks.empty())
+            done.notify_all();
+    }
+}
+
+TaskQueue::TaskQueue()
+    : d_ptr(new TaskQueuePrivate)
+{ }
+
+TaskQueue::~TaskQueue()
+{ }
+
+void TaskQueue::post(const std::function<void()> &task)
+{
+    D_PTR(TaskQueue);
+    std::lock_guard<std::mutex> guard(d->lock);
+    d->tasks.push_back(task);
+    d->wakeup.notify_one();
+}
+
+void TaskQueue::waitForDone()
+{
+    D_PTR(TaskQueue);
+    std::unique_lock<std::mutex> guard(d->lock);
+    d->done.wait(guard, [d] { return d->tasks.empty() && !d->running; });
+}
+
+bool TaskQueue::isCurrent() const
+{
+    D_PTR(const TaskQueue);
+    return std::this_thread::get_id() == d->thread.get_id();
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "indimacros.h"
+#include <memory>
+#include <functional>
+
+namespace INDI
+{
+
+class TaskQueuePrivate;
+/**
+ * @class TaskQueue
+ * @brief The TaskQueue class runs tasks one at a time on a thread of its own, in the order they are queued.
+ *
+ * Unlike a ThreadPool of one worker, which runs the last task a worker queued first, the order of the tasks is
+ * always kept, so that what one producer does through the queue is done in the order of its requests.
+ */
+class TaskQueue
+{
+        DECLARE_PRIVATE(TaskQueue)
+    public:
+        TaskQueue();
+
+        /** @brief Drops the tasks not started yet and waits for the running one. */
+        ~TaskQueue();
+
+    public:
+        /** @brief Queues a task, run once the tasks queued before it ended. */
+        void post(const std::function<void()> &task);
+
+        /** @brief Waits until every task queued so far ended. Not to be called from a task of the queue. */
+        void waitForDone();
+
+        /** @brief Returns true if called from a task of the queue. */
+        bool isCurrent() const;
+
+    protected:
+        std::shared_ptr<TaskQueuePrivate> d_ptr;
+};
+
+}
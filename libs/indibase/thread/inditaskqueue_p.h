@@ -0,0 +1,47 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+
+namespace INDI
+{
+
+class TaskQueuePrivate
+{
+    public:
+        TaskQueuePrivate();
+        virtual ~TaskQueuePrivate();
+
+    public:
+        void run();
+
+    public:
+        std::deque<std::function<void()>> tasks;
+        bool running {false};   /* a task is running */
+        bool isAboutToQuit {false};
+
+        std::mutex lock;
+        std::condition_variable wakeup;
+        std::condition_variable done;
+        std::thread thread;
+};
+
+}
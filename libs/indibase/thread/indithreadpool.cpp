@@ -0,0 +1,231 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indithreadpool.h"
+#include "indithreadpool_p.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace INDI
+{
+
+// The pool and worker the current thread belongs to, if any
+static thread_local ThreadPoolPrivate *currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+ThreadPoolPrivate::ThreadPoolPrivate(size_t count)
+{
+    if (count == 0)
+        count = std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t i = 0; i < count; i++)
+        workers.emplace_back(new Worker);
+
+    for (size_t i = 0; i < count; i++)
+        workers[i]->thread = std::thread(&ThreadPoolPrivate::run, this, i);
+}
+
+ThreadPoolPrivate::~ThreadPoolPrivate()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        isAboutToQuit = true;
+        wakeup.notify_all();
+    }
+
+    for (auto &worker : workers)
+        if (worker->thread.joinable())
+            worker->thread.join();
+
+    // Tasks never started: their futures report a broken promise
+    for (auto &worker : workers)
+        worker->tasks.clear();
+}
+
+void ThreadPoolPrivate::push(std::function<void()> &&task)
+{
+    size_t target = currentPool == this ? currentWorker : nextWorker++ % workers.size();
+
+    pending++;
+    {
+        std::lock_guard<std::mutex> guard(workers[target]->lock);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+    queued++;
+
+    // A worker that saw no task increments idle first, then looks again
+    if (idle > 0)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        wakeup.notify_one();
+    }
+}
+
+bool ThreadPoolPrivate::take(size_t self, std::function<void()> &task)
+{
+    {
+        Worker &worker = *workers[self];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (!worker.tasks.empty())
+        {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+            queued--;
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < workers.size(); i++)
+    {
+        Worker &victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPoolPrivate::run(size_t self)
+{
+    currentPool = this;
+    currentWorker = self;
+
+    std::function<void()> task;
+    while (!isAboutToQuit)
+    {
+        if (!take(self, task))
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            idle++;
+            wakeup.wait(guard, [this] { return queued > 0 || isAboutToQuit; });
+            idle--;
+            continue;
+        }
+
+        task();
+        task = nullptr;
+
+        if (--pending == 0)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            done.notify_all();
+        }
+    }
+}
+
+ThreadPool::ThreadPool(size_t workers)
+    : d_ptr(new ThreadPoolPrivate(workers))
+{ }
+
+ThreadPool::~ThreadPool()
+{ }
+
+void ThreadPool::enqueue(std::function<void()> &&task)
+{
+    D_PTR(ThreadPool);
+    d->push(std::move(task));
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &function, size_t grain)
+{
+    if (end <= begin)
+        return;
+
+    struct Range
+    {
+        std::function<void(size_t)> function;
+        size_t begin, end, grain, chunks;
+        std::atomic<size_t> nextChunk {0};
+        std::atomic<size_t> chunksLeft {0};
+        std::mutex lock;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    auto range = std::make_shared<Range>();
+    range->function = function;
+    range->begin = begin;
+    range->end = end;
+    range->grain = std::max<size_t>(grain, 1);
+    range->chunks = (end - begin + range->grain - 1) / range->grain;
+    range->chunksLeft = range->chunks;
+
+    // Helpers that start after the last chunk was handed out have nothing to do
+    auto work = [range]
+    {
+        for (size_t chunk; (chunk = range->nextChunk++) < range->chunks; )
+        {
+            size_t from = range->begin + chunk * range->grain;
+            size_t to = std::min(range->end, from + range->grain);
+            try
+            {
+                for (size_t i = from; i < to; i++)
+                    range->function(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> guard(range->lock);
+                if (!range->error)
+                    range->error = std::current_exception();
+            }
+
+            if (--range->chunksLeft == 0)
+            {
+                std::lock_guard<std::mutex> guard(range->lock);
+                range->done.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(size(), range->chunks) - 1;
+    for (size_t i = 0; i < helpers; i++)
+        enqueue(work);
+
+    work();
+
+    std::unique_lock<std::mutex> guard(range->lock);
+    range->done.wait(guard, [&range] { return range->chunksLeft == 0; });
+    if (range->error)
+        std::rethrow_exception(range->error);
+}
+
+void ThreadPool::waitForDone()
+{
+    D_PTR(ThreadPool);
+    std::unique_lock<std::mutex> guard(d->lock);
+    d->done.wait(guard, [d] { return d->pending == 0; });
+}
+
+size_t ThreadPool::size() const
+{
+    D_PTR(const ThreadPool);
+    return d->workers.size();
+}
+
+ThreadPool &ThreadPool::global()
+{
+    static ThreadPool *pool = new ThreadPool(std::max(2u, std::thread::hardware_concurrency()));
+    return *pool;
+}
+
+}
@@ -0,0 +1,123 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include "indimacros.h"
+#include <memory>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <cstddef>
+
+namespace INDI
+{
+
+/**
+ * @class CancelToken
+ * @brief Shared flag to stop a group of ThreadPool tasks.
+ *
+ * Tasks submitted with a token that is cancelled before they start are dropped, their future reports
+ * std::future_errc::broken_promise. Running tasks can check isCancelled() and end early.
+ * Copies share the same flag.
+ */
+class CancelToken
+{
+    public:
+        CancelToken() : flag(std::make_shared<std::atomic_bool>(false)) { }
+
+    public:
+        void cancel()
+        {
+            *flag = true;
+        }
+
+        bool isCancelled() const
+        {
+            return *flag;
+        }
+
+    private:
+        std::shared_ptr<std::atomic_bool> flag;
+};
+
+class ThreadPoolPrivate;
+/**
+ * @class ThreadPool
+ * @brief The ThreadPool class runs tasks on a fixed set of worker threads.
+ *
+ * Unlike SingleThreadPool, tasks run in parallel and a new task never cancels a previous one.
+ * Each worker has its own queue: tasks submitted from a worker go to its queue, others are spread
+ * over the workers, and a worker out of tasks takes the oldest one from another queue.
+ *
+ * Drivers can share the pool returned by global() rather than starting threads of their own.
+ */
+class ThreadPool
+{
+        DECLARE_PRIVATE(ThreadPool)
+    public:
+        /** @brief Starts the workers, as many as the hardware runs threads if workers is 0. */
+        explicit ThreadPool(size_t workers = 0);
+
+        /** @brief Drops the tasks not started yet and waits for the running ones. */
+        ~ThreadPool();
+
+    public:
+        /** @brief Queues a task and returns the future of its result. */
+        template <typename Function>
+        auto submit(Function &&function) -> std::future<decltype(function())>
+        {
+            return submit(CancelToken(), std::forward<Function>(function));
+        }
+
+        /** @brief Queues a task that is dropped if token is cancelled before it starts. */
+        template <typename Function>
+        auto submit(const CancelToken &token, Function &&function) -> std::future<decltype(function())>
+        {
+            using Result = decltype(function());
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Function>(function));
+            std::future<Result> result = task->get_future();
+            enqueue([task, token]
+            {
+                if (!token.isCancelled())
+                    (*task)();
+            });
+            return result;
+        }
+
+        /** @brief Calls function(i) for each i in [begin, end), in parallel, and returns when all calls returned.
+         *  Indexes are handed out in chunks of grain. The calling thread takes part, so it can be a worker too.
+         *  An exception thrown by a call is thrown again, once all calls returned. */
+        void parallelFor(size_t begin, size_t end, const std::function<void(size_t)> &function, size_t grain = 1);
+
+        /** @brief Waits until every task submitted so far ended. Not to be called from a task of the pool. */
+        void waitForDone();
+
+    public:
+        /** @brief Returns the number of workers. */
+        size_t size() const;
+
+        /** @brief Returns the pool shared by all users of the process, at least 2 workers.
+         *  It is never destroyed: tasks still running at exit are ended with the process. */
+        static ThreadPool &global();
+
+    protected:
+        void enqueue(std::function<void()> &&task);
+
+    protected:
+        std::shared_ptr<ThreadPoolPrivate> d_ptr;
+};
+
+}
@@ -0,0 +1,62 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+
+namespace INDI
+{
+
+class ThreadPoolPrivate
+{
+    public:
+        explicit ThreadPoolPrivate(size_t workers);
+        virtual ~ThreadPoolPrivate();
+
+    public:
+        struct Worker
+        {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks; /* the worker pops at the back, others steal at the front */
+            std::thread thread;
+        };
+
+        void push(std::function<void()> &&task);
+        bool take(size_t self, std::function<void()> &task);
+        void run(size_t self);
+
+    public:
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::atomic<size_t> nextWorker {0};  /* round robin for tasks from other threads */
+
+        std::atomic<size_t> queued {0};      /* tasks in the queues */
+        std::atomic<size_t> pending {0};     /* tasks queued or running */
+        std::atomic<size_t> idle {0};        /* workers about to wait for a task */
+        std::atomic_bool isAboutToQuit {false};
+
+        std::mutex lock;
+        std::condition_variable wakeup;
+        std::condition_variable done;
+};
+
+}
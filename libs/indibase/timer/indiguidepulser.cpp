@@ -0,0 +1,187 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "indiguidepulser.h"
+#include "indiguidepulser_p.h"
+
+#include "eventloop.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <time.h>
+#endif
+
+namespace INDI
+{
+
+// The condition wakes up this early, the rest of the wait is slept on the clock
+static constexpr std::chrono::milliseconds SLEEP_MARGIN {2};
+
+static void sleepUntil(std::chrono::steady_clock::time_point deadline)
+{
+#ifdef __linux__
+    // The steady clock is the monotonic one, an absolute sleep is not lengthened by a preemption before it
+    auto const since = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    struct timespec ts;
+    ts.tv_sec  = since / 1000000000;
+    ts.tv_nsec = since % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+        ;
+#else
+    std::this_thread::sleep_until(deadline);
+#endif
+}
+
+GuidePulserPrivate::GuidePulserPrivate()
+{
+    thread = std::thread(&GuidePulserPrivate::run, this);
+}
+
+GuidePulserPrivate::~GuidePulserPrivate()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    changed.notify_one();
+    if (thread.joinable())
+        thread.join();
+}
+
+void GuidePulserPrivate::run()
+{
+#ifdef __linux__
+    // Real-time priority and no timer slack, if the limits of the user allow them
+    sched_param param;
+    param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+#endif
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!quit)
+    {
+        if (pulses.empty())
+        {
+            changed.wait(lock);
+            continue;
+        }
+
+        auto next = pulses.begin()->second.deadline;
+        for (const auto &pulse : pulses)
+            next = std::min(next, pulse.second.deadline);
+
+        auto const now = std::chrono::steady_clock::now();
+        if (next - now > SLEEP_MARGIN)
+        {
+            changed.wait_until(lock, next - SLEEP_MARGIN);
+            continue;
+        }
+
+        if (next > now)
+        {
+            lock.unlock();
+            sleepUntil(next);
+            lock.lock();
+            continue;
+        }
+
+        std::vector<std::pair<int, Pulse>> due;
+        for (auto it = pulses.begin(); it != pulses.end();)
+        {
+            if (it->second.deadline <= now)
+            {
+                ending.insert(it->first);
+                due.emplace_back(it->first, std::move(it->second));
+                it = pulses.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        lock.unlock();
+        for (auto &ended : due)
+        {
+            Pulse &pulse = ended.second;
+            pulse.stop();
+            double const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                              pulse.started).count();
+            if (pulse.done)
+            {
+                auto done = std::move(pulse.done);
+                postToEventLoop([done, ms]()
+                {
+                    done(ms);
+                });
+            }
+        }
+        lock.lock();
+
+        for (const auto &ended : due)
+            ending.erase(ended.first);
+        stopped.notify_all();
+    }
+}
+
+GuidePulser::GuidePulser()
+    : d_ptr(new GuidePulserPrivate)
+{ }
+
+GuidePulser::~GuidePulser()
+{ }
+
+int GuidePulser::start(uint32_t ms, const std::function<void()> &stop, const std::function<void(double)> &done)
+{
+    D_PTR(GuidePulser);
+    auto const now = std::chrono::steady_clock::now();
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        id = d->nextId++;
+        d->pulses[id] = GuidePulserPrivate::Pulse{now, now + std::chrono::milliseconds(ms), stop, done};
+    }
+    d->changed.notify_one();
+    return id;
+}
+
+bool GuidePulser::cancel(int id)
+{
+    D_PTR(GuidePulser);
+    std::unique_lock<std::mutex> lock(d->mutex);
+    if (d->pulses.erase(id) > 0)
+        return true;
+
+    // The caller may start the next pulse on the same lines once this returns
+    d->stopped.wait(lock, [d, id]()
+    {
+        return d->ending.count(id) == 0;
+    });
+    return false;
+}
+
+GuidePulser &GuidePulser::global()
+{
+    static GuidePulser *pulser = new GuidePulser();
+    return *pulser;
+}
+
+}
@@ -0,0 +1,74 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "indimacros.h"
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+namespace INDI
+{
+
+class GuidePulserPrivate;
+/**
+ * @class GuidePulser
+ * @brief The GuidePulser class ends guide pulses on time, from a thread of its own.
+ *
+ * A pulse ended by a timer of the event loop lasts as long as the event loop takes to get to the timer, which a
+ * large BLOB or a slow client can stretch by many times. The thread of the pulser sleeps on the monotonic clock
+ * until the end of the next pulse and runs at real-time priority when the system allows it, so that pulses end
+ * within a fraction of a millisecond whatever the event loop does.
+ *
+ * The driver starts the pulse and then calls start() with the function that ends it. That function is called from
+ * the thread of the pulser, it has to be safe against what the driver does on its own thread. The length of the
+ * pulse, from start() to the end of the stop function, is then handed to the done function on the event loop.
+ *
+ * Drivers share the pulser returned by global().
+ */
+class GuidePulser
+{
+        DECLARE_PRIVATE(GuidePulser)
+
+    public:
+        GuidePulser();
+        ~GuidePulser();
+
+    public:
+        /**
+         * @brief Ends a pulse started just before: calls stop in ms milliseconds from the thread of the pulser, then
+         * done from the event loop with the measured length of the pulse, in milliseconds.
+         * @return The id of the pulse, for cancel().
+         */
+        int start(uint32_t ms, const std::function<void()> &stop, const std::function<void(double)> &done);
+
+        /**
+         * @brief Drops a pulse, neither its stop nor its done functions are called. If its stop function is running,
+         * waits for it to return.
+         * @return False if the pulse already ended.
+         */
+        bool cancel(int id);
+
+    public:
+        /** @brief Returns the pulser shared by all the drivers of the process. */
+        static GuidePulser &global();
+
+    protected:
+        std::shared_ptr<GuidePulserPrivate> d_ptr;
+};
+
+}
@@ -0,0 +1,60 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace INDI
+{
+
+class GuidePulserPrivate
+{
+    public:
+        GuidePulserPrivate();
+        virtual ~GuidePulserPrivate();
+
+    public:
+        void run();
+
+    public:
+        struct Pulse
+        {
+            std::chrono::steady_clock::time_point started;
+            std::chrono::steady_clock::time_point deadline;
+            std::function<void()> stop;
+            std::function<void(double)> done;
+        };
+
+        // Pulses not ended yet, by id, and the ids of those whose stop is running
+        std::map<int, Pulse> pulses;
+        std::set<int> ending;
+        int nextId {0};
+        bool quit {false};
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::condition_variable stopped;
+        std::thread thread;
+};
+
+}
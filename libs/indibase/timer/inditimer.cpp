@@ -36,23 +36,24 @@ TimerPrivate::~TimerPrivate()
 
 void TimerPrivate::start()
 {
-    if (singleShot)
+    auto onSingleShot = [](void *arg)
     {
-        timerId = addTimer(interval, [](void *arg)
-        {
-            TimerPrivate *d = static_cast<TimerPrivate*>(arg);
-            d->timerId = -1;
-            d->p->timeout();
-        }, this);
-    }
-    else
+        TimerPrivate *d = static_cast<TimerPrivate*>(arg);
+        d->timerId = -1;
+        d->p->timeout();
+    };
+    auto onPeriodic = [](void *arg)
     {
-        timerId = addPeriodicTimer(interval, [](void *arg)
-        {
-            TimerPrivate *d = static_cast<TimerPrivate*>(arg);
-            d->p->timeout();
-        }, this);
-    }
+        TimerPrivate *d = static_cast<TimerPrivate*>(arg);
+        d->p->timeout();
+    };
+
+    if (precise)
+        timerId = singleShot ? addTimerNs(intervalUs * 1000, onSingleShot, this)
+                  : addPeriodicTimerUs(intervalUs, onPeriodic, this);
+    else
+        timerId = singleShot ? addTimer(interval, onSingleShot, this)
+                  : addPeriodicTimer(interval, onPeriodic, this);
 }
 
 void TimerPrivate::stop()
@@ -90,7 +91,7 @@ void Timer::start(int msec)
 {
     D_PTR(Timer);
     d->stop();
-    d->interval = msec;
+    setInterval(msec);
     d->start();
 }
 
@@ -104,6 +105,14 @@ void Timer::setInterval(int msec)
 {
     D_PTR(Timer);
     d->interval = msec;
+    d->intervalUs = int64_t(msec) * 1000;
+}
+
+void Timer::setIntervalUs(int64_t usec)
+{
+    D_PTR(Timer);
+    d->intervalUs = usec;
+    d->interval = int(usec / 1000);
 }
 
 void Timer::setSingleShot(bool singleShot)
@@ -124,6 +133,18 @@ bool Timer::isSingleShot() const
     return d->singleShot;
 }
 
+void Timer::setPrecise(bool precise)
+{
+    D_PTR(Timer);
+    d->precise = precise;
+}
+
+bool Timer::isPrecise() const
+{
+    D_PTR(const Timer);
+    return d->precise;
+}
+
 int Timer::remainingTime() const
 {
     D_PTR(const Timer);
@@ -136,6 +157,12 @@ int Timer::interval() const
     return d->interval;
 }
 
+int64_t Timer::intervalUs() const
+{
+    D_PTR(const Timer);
+    return d->intervalUs;
+}
+
 void Timer::timeout()
 {
     D_PTR(Timer);
@@ -21,6 +21,7 @@
 #include "indimacros.h"
 #include <memory>
 #include <functional>
+#include <cstdint>
 
 namespace INDI
 {
@@ -36,6 +37,9 @@ class TimerPrivate;
  *
  * You can set a timer to time out only once by calling setSingleShot(true).
  * You can also use the static Timer::singleShot() function to call a function after a specified interval.
+ *
+ * A precise timer, see setPrecise(true), keeps its interval to the microsecond, for guide pulses
+ * or fast polling. Every timer is scheduled against the previous deadline, so periods don't drift.
  */
 class Timer
 {
@@ -62,9 +66,15 @@ class Timer
         /** @brief Set the timeout interval in milliseconds. */
         void setInterval(int msec);
 
+        /** @brief Set the timeout interval in microseconds. Below the millisecond, only a precise timer honours it. */
+        void setIntervalUs(int64_t usec);
+
         /** @brief Set whether the timer is a single-shot timer. */
         void setSingleShot(bool singleShot);
 
+        /** @brief Set whether the timer keeps its interval to the microsecond rather than to the millisecond. */
+        void setPrecise(bool precise);
+
     public:
         /** @brief Returns true if the timer is running (pending); otherwise returns false. */
         bool isActive() const;
@@ -72,6 +82,9 @@ class Timer
         /** @brief Returns whether the timer is a single-shot timer. */
         bool isSingleShot() const;
 
+        /** @brief Returns whether the timer keeps its interval to the microsecond. */
+        bool isPrecise() const;
+
         /** @brief Returns the timer's remaining value in milliseconds left until the timeout.
          * If the timer not exists, the returned value will be -1.
          */
@@ -80,6 +93,9 @@ class Timer
         /** @brief Returns the timeout interval in milliseconds. */
         int interval() const;
 
+        /** @brief Returns the timeout interval in microseconds. */
+        int64_t intervalUs() const;
+
     public:
         /** @brief This static function calls a the given function after a given time interval. */
         static void singleShot(int msec, const std::function<void()> &callback);
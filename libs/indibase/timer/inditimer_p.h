@@ -19,6 +19,7 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
 #include <functional>
 
 namespace INDI
@@ -38,9 +39,11 @@ class TimerPrivate
     public:
         Timer *p;
         int interval {1000};
+        int64_t intervalUs {1000000};
 
         std::atomic<int> timerId {-1};
         bool singleShot {false};
+        bool precise {false};
         bool active {false};
 
         std::function<void()> callback;
@@ -41,6 +41,9 @@
 #include <stdio.h>
 #include <cerrno>
 #include <sys/mman.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <cstring>
 #include <ctime>
 #include <cmath>
@@ -148,6 +151,7 @@ V4L2_Base::V4L2_Base()
     fd        = -1;
     buffers   = nullptr;
     n_buffers = 0;
+    lent      = std::make_shared<lent_buffers>();
 
     callback = nullptr;
 
@@ -184,6 +188,9 @@ V4L2_Base::V4L2_Base()
 
 V4L2_Base::~V4L2_Base()
 {
+    stop_capture_thread();
+    if (captureThread.joinable())
+        captureThread.detach();
     delete v4l2_decode;
 }
 
@@ -315,17 +322,19 @@ int V4L2_Base::ioctl_set_format(struct v4l2_format new_fmt, char * errmsg)
     if (new_fmt.type)
     {
         /* Set format */
+        struct v4l2_format const requested = new_fmt;
+        to_device_format(new_fmt);
         if (-1 == XIOCTL(fd, VIDIOC_S_FMT, &new_fmt))
         {
             DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: failed VIDIOC_S_FMT with " DBG_STR_FMT, __FUNCTION__,
-                         DBG_FMT(new_fmt));
+                         DBG_FMT(requested));
             return errno_exit("VIDIOC_S_FMT", errmsg);
         }
     }
     else
     {
         /* Retrieve format */
-        new_fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        new_fmt.type = buftype;
         if (-1 == XIOCTL(fd, VIDIOC_G_FMT, &new_fmt))
         {
             DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: failed VIDIOC_G_FMT", __FUNCTION__);
@@ -333,6 +342,17 @@ int V4L2_Base::ioctl_set_format(struct v4l2_format new_fmt, char * errmsg)
         }
     }
 
+    /* Formats with a plane per component (NV12M, YUV420M) are not supported */
+    if (mplane && new_fmt.fmt.pix_mp.num_planes != 1)
+    {
+        snprintf(errmsg, ERRMSGSIZ, "%c%c%c%c has %d planes, only single plane formats are supported",
+                 new_fmt.fmt.pix_mp.pixelformat & 0xFF, (new_fmt.fmt.pix_mp.pixelformat >> 8) & 0xFF,
+                 (new_fmt.fmt.pix_mp.pixelformat >> 16) & 0xFF, (new_fmt.fmt.pix_mp.pixelformat >> 24) & 0xFF,
+                 new_fmt.fmt.pix_mp.num_planes);
+        return -1;
+    }
+    from_device_format(new_fmt);
+
     DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: current format " DBG_STR_FMT, __FUNCTION__,
                  DBG_FMT(new_fmt));
 
@@ -346,6 +366,70 @@ int V4L2_Base::ioctl_set_format(struct v4l2_format new_fmt, char * errmsg)
     return 0;
 }
 
+/* @internal Converts a single-planar format to the buffer type of the device */
+void V4L2_Base::to_device_format(struct v4l2_format &f) const
+{
+    if (!mplane || f.type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        return;
+
+    struct v4l2_pix_format const pix = f.fmt.pix;
+
+    CLEAR(f.fmt.pix_mp);
+    f.type                                  = buftype;
+    f.fmt.pix_mp.width                      = pix.width;
+    f.fmt.pix_mp.height                     = pix.height;
+    f.fmt.pix_mp.pixelformat                = pix.pixelformat;
+    f.fmt.pix_mp.field                      = pix.field;
+    f.fmt.pix_mp.colorspace                 = pix.colorspace;
+    f.fmt.pix_mp.num_planes                 = 1;
+    f.fmt.pix_mp.plane_fmt[0].bytesperline  = pix.bytesperline;
+    f.fmt.pix_mp.plane_fmt[0].sizeimage     = pix.sizeimage;
+    f.fmt.pix_mp.ycbcr_enc                  = pix.ycbcr_enc;
+    f.fmt.pix_mp.quantization               = pix.quantization;
+    f.fmt.pix_mp.xfer_func                  = pix.xfer_func;
+}
+
+/* @internal Converts a multi-planar format of the device to the single-planar format the decoders use */
+void V4L2_Base::from_device_format(struct v4l2_format &f) const
+{
+    if (f.type != V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE)
+        return;
+
+    struct v4l2_pix_format_mplane const pix_mp = f.fmt.pix_mp;
+
+    CLEAR(f.fmt.pix);
+    f.type                 = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    f.fmt.pix.width        = pix_mp.width;
+    f.fmt.pix.height       = pix_mp.height;
+    f.fmt.pix.pixelformat  = pix_mp.pixelformat;
+    f.fmt.pix.field        = pix_mp.field;
+    f.fmt.pix.colorspace   = pix_mp.colorspace;
+    f.fmt.pix.bytesperline = pix_mp.plane_fmt[0].bytesperline;
+    f.fmt.pix.sizeimage    = pix_mp.plane_fmt[0].sizeimage;
+    f.fmt.pix.priv         = V4L2_PIX_FMT_PRIV_MAGIC;
+    f.fmt.pix.ycbcr_enc    = pix_mp.ycbcr_enc;
+    f.fmt.pix.quantization = pix_mp.quantization;
+    f.fmt.pix.xfer_func    = pix_mp.xfer_func;
+}
+
+/* @internal Clears a buffer for the queue of the device, planes holds its plane on multi-planar devices */
+void V4L2_Base::setup_buffer(struct v4l2_buffer &b, struct v4l2_plane *planes, unsigned int memory,
+                             unsigned int index) const
+{
+    CLEAR(b);
+
+    b.type   = buftype;
+    b.memory = memory;
+    b.index  = index;
+
+    if (mplane)
+    {
+        memset(planes, 0, VIDEO_MAX_PLANES * sizeof(*planes));
+        b.m.planes = planes;
+        b.length   = VIDEO_MAX_PLANES;
+    }
+}
+
 int V4L2_Base::errno_exit(const char * s, char * errmsg)
 {
     fprintf(stderr, "%s error %d, %s\n", s, errno, strerror(errno));
@@ -493,10 +577,7 @@ int V4L2_Base::read_frame(char * errmsg)
 
         case IO_METHOD_MMAP:
             DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: using MMAP to recover frame buffer", __FUNCTION__);
-            CLEAR(buf);
-
-            buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            buf.memory = V4L2_MEMORY_MMAP;
+            setup_buffer(buf, bufplanes, V4L2_MEMORY_MMAP, 0);
 
             /* For debugging purposes */
             if (false)
@@ -546,6 +627,10 @@ int V4L2_Base::read_frame(char * errmsg)
             DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: buffer #%d dequeued from fd:%d\n", __FUNCTION__,
                          buf.index, fd);
 
+            /* The size of the frame is in its plane, the decoders look for it in the buffer */
+            if (mplane)
+                buf.bytesused = bufplanes[0].bytesused;
+
             if (buf.flags & V4L2_BUF_FLAG_ERROR)
             {
                 DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG,
@@ -629,6 +714,19 @@ int V4L2_Base::read_frame(char * errmsg)
             /* TODO: there is probably a better error handling than asserting the buffer index */
             assert(buf.index < n_buffers);
 
+            frameTimestamp = frame_timestamp();
+
+            /* A lent buffer is decoded only if the callback asks for the decoded frame, and requeued when released */
+            if (zeroCopy && lxstate == LX_ACTIVE && callback && lend_frame())
+            {
+                (*callback)(uptr);
+
+                /* The frame was not taken, give the buffer back to the device now */
+                lentDecode = false;
+                lentFrame.release();
+                break;
+            }
+
             if (dodecode)
             {
                 DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "%s: [%p] decoding %d-byte buffer %p cropset %c",
@@ -721,15 +819,22 @@ int V4L2_Base::stop_capturing(char * errmsg)
             // N.B. I used this as a hack to solve a problem with capturing a frame
             // long time ago. I recently tried taking this hack off, and it worked fine!
 
-            type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            type = buftype;
             if (selectCallBackID != -1)
             {
                 IERmCallback(selectCallBackID);
                 selectCallBackID = -1;
             }
             streamactive = false;
+            {
+                std::lock_guard<std::mutex> guard(lent->lock);
+                lent->queueing = false;
+            }
+            stop_capture_thread();
             if (-1 == XIOCTL(fd, VIDIOC_STREAMOFF, &type))
                 return errno_exit("VIDIOC_STREAMOFF", errmsg);
+            /* STREAMOFF dequeues all buffers, the lent ones must be back before they are queued again */
+            wait_lent_frames();
             break;
     }
     //uninit_device(errmsg);
@@ -745,6 +850,10 @@ int V4L2_Base::start_capturing(char * errmsg)
     if (!streamedonce)
         init_device(errmsg);
 
+    /* A thread stopped from its own callback is only joined now */
+    if (captureThread.joinable())
+        captureThread.join();
+
     switch (io)
     {
         case IO_METHOD_READ:
@@ -755,24 +864,34 @@ int V4L2_Base::start_capturing(char * errmsg)
             for (i = 0; i < n_buffers; ++i)
             {
                 struct v4l2_buffer buf;
+                struct v4l2_plane planes[VIDEO_MAX_PLANES];
 
-                CLEAR(buf);
-
-                buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-                buf.memory = V4L2_MEMORY_MMAP;
-                buf.index  = i;
+                setup_buffer(buf, planes, V4L2_MEMORY_MMAP, i);
                 //DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG,"v4l2_start_capturing: enqueuing buffer %d for fd=%d\n", buf.index, fd);
                 /*if (-1 == XIOCTL(fd, VIDIOC_QBUF, &buf))
                 return errno_exit ("StartCapturing IO_METHOD_MMAP: VIDIOC_QBUF", errmsg);*/
                 XIOCTL(fd, VIDIOC_QBUF, &buf);
             }
 
-            type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+            type = buftype;
             if (-1 == XIOCTL(fd, VIDIOC_STREAMON, &type))
                 return errno_exit("VIDIOC_STREAMON", errmsg);
 
-            selectCallBackID = IEAddCallback(fd, newFrame, this);
-            streamactive     = true;
+            {
+                std::lock_guard<std::mutex> guard(lent->lock);
+                lent->fd       = fd;
+                lent->type     = buftype;
+                lent->queueing = true;
+            }
+
+            streamactive = true;
+            if (captureThreaded)
+            {
+                captureStop   = false;
+                captureThread = std::thread(&V4L2_Base::capture_loop, this);
+            }
+            else
+                selectCallBackID = IEAddCallback(fd, newFrame, this);
 
             break;
 
@@ -812,6 +931,85 @@ void V4L2_Base::newFrame(int /*fd*/, void * p)
     ((V4L2_Base *)(p))->read_frame(errmsg);
 }
 
+/* @internal Reads the frames as the device fills its buffers, until stop_capture_thread()
+ *
+ * The device is opened non-blocking, the thread blocks in poll() rather than VIDIOC_DQBUF so that it
+ * wakes up regularly to check whether it should stop.
+ */
+void V4L2_Base::capture_loop()
+{
+    if (captureRealtime)
+    {
+        struct sched_param param;
+
+        CLEAR(param);
+
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        int const error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (error != 0)
+            DEBUGFDEVICE(deviceName, INDI::Logger::DBG_WARNING,
+                         "Capture thread runs with the normal priority, real-time priority needs CAP_SYS_NICE (%s)", strerror(error));
+    }
+
+    char errmsg[ERRMSGSIZ];
+    struct pollfd pfd;
+
+    pfd.fd     = fd;
+    pfd.events = POLLIN;
+
+    while (!captureStop)
+    {
+        int const ready = poll(&pfd, 1, 100);
+
+        if (-1 == ready)
+        {
+            if (EINTR == errno)
+                continue;
+            DEBUGFDEVICE(deviceName, INDI::Logger::DBG_ERROR, "Capture thread stopped, poll error %d (%s)", errno,
+                         strerror(errno));
+            break;
+        }
+
+        if (ready == 0 || captureStop)
+            continue;
+
+        if (read_frame(errmsg) == -1)
+        {
+            DEBUGFDEVICE(deviceName, INDI::Logger::DBG_ERROR, "Capture thread stopped: %s", errmsg);
+            break;
+        }
+    }
+}
+
+/* @internal Stops the capture thread, it is joined later when called from the thread itself */
+void V4L2_Base::stop_capture_thread()
+{
+    captureStop = true;
+    if (captureThread.joinable() && captureThread.get_id() != std::this_thread::get_id())
+        captureThread.join();
+}
+
+/* @internal Converts the timestamp of the dequeued buffer to UTC microseconds since the Unix epoch */
+uint64_t V4L2_Base::frame_timestamp() const
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 15, 0))
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) != V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        return 0;
+
+    struct timespec monotonic = { 0, 0 };
+    struct timespec realtime  = { 0, 0 };
+    clock_gettime(CLOCK_MONOTONIC, &monotonic);
+    clock_gettime(CLOCK_REALTIME, &realtime);
+
+    int64_t const age = (static_cast<int64_t>(monotonic.tv_sec) - buf.timestamp.tv_sec) * 1000000 +
+                        (monotonic.tv_nsec / 1000 - buf.timestamp.tv_usec);
+    int64_t const now = static_cast<int64_t>(realtime.tv_sec) * 1000000 + realtime.tv_nsec / 1000;
+    return static_cast<uint64_t>(now - age);
+#else
+    return 0;
+#endif
+}
+
 int V4L2_Base::uninit_device(char * errmsg)
 {
     switch (io)
@@ -821,6 +1019,14 @@ int V4L2_Base::uninit_device(char * errmsg)
             break;
 
         case IO_METHOD_MMAP:
+            stop_capture_thread();
+            for (int dmabuf : dmabufs)
+                if (dmabuf != -1)
+                    close(dmabuf);
+            dmabufs.clear();
+            /* Frames still held would read unmapped memory, their buffers are left mapped */
+            if (!wait_lent_frames())
+                break;
             for (unsigned int i = 0; i < n_buffers; ++i)
                 if (-1 == munmap(buffers[i].start, buffers[i].length))
                     return errno_exit("munmap", errmsg);
@@ -863,9 +1069,9 @@ int V4L2_Base::init_mmap(char * errmsg)
 
     CLEAR(req);
 
-    req.count = 4;
+    req.count = bufferCount;
     //req.count               = 1;
-    req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.type   = buftype;
     req.memory = V4L2_MEMORY_MMAP;
 
     if (-1 == XIOCTL(fd, VIDIOC_REQBUFS, &req))
@@ -901,22 +1107,38 @@ int V4L2_Base::init_mmap(char * errmsg)
     for (n_buffers = 0; n_buffers < req.count; n_buffers++)
     {
         struct v4l2_buffer buf;
+        struct v4l2_plane planes[VIDEO_MAX_PLANES];
 
-        CLEAR(buf);
-
-        buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index  = n_buffers;
+        setup_buffer(buf, planes, V4L2_MEMORY_MMAP, n_buffers);
 
         if (-1 == XIOCTL(fd, VIDIOC_QUERYBUF, &buf))
             return errno_exit("VIDIOC_QUERYBUF", errmsg);
 
-        buffers[n_buffers].length = buf.length;
-        buffers[n_buffers].start = mmap(nullptr /* start anywhere */, buf.length, PROT_READ | PROT_WRITE /* required */,
-                                        MAP_SHARED /* recommended */, fd, buf.m.offset);
+        size_t const length = mplane ? planes[0].length : buf.length;
+        off_t const offset  = mplane ? planes[0].m.mem_offset : buf.m.offset;
+
+        buffers[n_buffers].length = length;
+        buffers[n_buffers].start = mmap(nullptr /* start anywhere */, length, PROT_READ | PROT_WRITE /* required */,
+                                        MAP_SHARED /* recommended */, fd, offset);
 
         if (MAP_FAILED == buffers[n_buffers].start)
             return errno_exit("mmap", errmsg);
+
+        /* Export the buffer, so that a hardware encoder can read the frame without the CPU */
+        int dmabuf = -1;
+#ifdef VIDIOC_EXPBUF
+        struct v4l2_exportbuffer expbuf;
+
+        CLEAR(expbuf);
+
+        expbuf.type  = buftype;
+        expbuf.index = n_buffers;
+        expbuf.flags = O_RDONLY | O_CLOEXEC;
+
+        if (-1 != XIOCTL(fd, VIDIOC_EXPBUF, &expbuf))
+            dmabuf = expbuf.fd;
+#endif
+        dmabufs.push_back(dmabuf);
     }
 
     return 0;
@@ -1042,13 +1264,27 @@ int V4L2_Base::check_device(char * errmsg)
       has_ext_pix_format=true;
       DEBUGFDEVICE(deviceName, INDI::Logger::DBG_DEBUG,"  V4L2_CAP_EXT_PIX_FORMAT\n");
     }*/
-    if (!(cap.capabilities & V4L2_CAP_VIDEO_CAPTURE))
+    /* CSI cameras (libcamera, rkisp) may only have the multi-planar API, their NV12 and NV21 formats use one plane */
+    uint32_t const caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+    mplane  = !(caps & V4L2_CAP_VIDEO_CAPTURE) && (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE);
+    buftype = mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (mplane)
+        DEBUGDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "  V4L2_CAP_VIDEO_CAPTURE_MPLANE");
+
+    if (!(caps & (V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_VIDEO_CAPTURE_MPLANE)))
     {
         fprintf(stderr, "%.*s is no video capture device\n", (int)sizeof(dev_name), dev_name);
         snprintf(errmsg, ERRMSGSIZ, "%.*s is no video capture device", (int)sizeof(dev_name), dev_name);
         return -1;
     }
 
+    if (mplane && io != IO_METHOD_MMAP)
+    {
+        fprintf(stderr, "%.*s is multi-planar and only supports mmap i/o\n", (int)sizeof(dev_name), dev_name);
+        snprintf(errmsg, ERRMSGSIZ, "%.*s is multi-planar and only supports mmap i/o", (int)sizeof(dev_name), dev_name);
+        return -1;
+    }
+
     switch (io)
     {
         case IO_METHOD_READ:
@@ -1134,7 +1370,8 @@ int V4L2_Base::check_device(char * errmsg)
     // Enumerating capture format
     {
         struct v4l2_fmtdesc fmt_avail;
-        fmt_avail.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        CLEAR(fmt_avail);
+        fmt_avail.type = buftype;
         //LOG_INFO("Available Capture Image formats:");
         DEBUGDEVICE(deviceName, INDI::Logger::DBG_DEBUG, "Enumerating available Capture Image formats:");
         for (fmt_avail.index = 0; ioctl(fd, VIDIOC_ENUM_FMT, &fmt_avail) != -1; fmt_avail.index++)
@@ -1470,7 +1707,7 @@ void V4L2_Base::getcaptureformats(ISwitchVectorProperty * captureformatssp)
     memset(formats, 0, formatsLen);
 
     /* Ask device about each format */
-    fmt_avail.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    fmt_avail.type = buftype;
     for (fmt_avail.index = 0; (int)fmt_avail.index < enumeratedCaptureFormats; fmt_avail.index++)
     {
         /* Enumeration ends with EINVAL */
@@ -1842,7 +2079,7 @@ int V4L2_Base::stdsetframerate(struct v4l2_fract frate, char * errmsg)
     struct v4l2_streamparm sparm;
     //if (!cansetrate) {sprintf(errmsg, "Can not set rate"); return -1;}
     bzero(&sparm, sizeof(struct v4l2_streamparm));
-    sparm.type                      = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    sparm.type                      = buftype;
     sparm.parm.capture.timeperframe = frate;
     if (-1 == XIOCTL(fd, VIDIOC_S_PARM, &sparm))
     {
@@ -1878,7 +2115,7 @@ struct v4l2_fract V4L2_Base::stdgetframerate()
     struct v4l2_streamparm sparm;
     //if (!cansetrate) return frameRate;
     bzero(&sparm, sizeof(struct v4l2_streamparm));
-    sparm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    sparm.type = buftype;
     if (-1 == XIOCTL(fd, VIDIOC_G_PARM, &sparm))
     {
         perror("VIDIOC_G_PARM");
@@ -1942,34 +2179,156 @@ void V4L2_Base::setColorProcessing(bool quantization, bool colorconvert, bool li
 
 unsigned char * V4L2_Base::getY()
 {
+    decode_lent_frame();
     return decoder->getY();
 }
 
 unsigned char * V4L2_Base::getU()
 {
+    decode_lent_frame();
     return decoder->getU();
 }
 
 unsigned char * V4L2_Base::getV()
 {
+    decode_lent_frame();
     return decoder->getV();
 }
 
 unsigned char * V4L2_Base::getMJPEGBuffer(int &size)
 {
+    decode_lent_frame();
     return decoder->getMJPEGBuffer(size);
 }
 
 unsigned char * V4L2_Base::getRGBBuffer()
 {
+    decode_lent_frame();
     return decoder->getRGBBuffer();
 }
 
 float * V4L2_Base::getLinearY()
 {
+    decode_lent_frame();
     return decoder->getLinearY();
 }
 
+BufferPool::Buffer V4L2_Base::takeFrame(int *dmabuf)
+{
+    if (dmabuf)
+        *dmabuf = lentFrame.empty() ? -1 : getDmabuf(buf.index);
+
+    lentDecode = false;
+    return std::move(lentFrame);
+}
+
+int V4L2_Base::getDmabuf(unsigned int index) const
+{
+    return index < dmabufs.size() ? dmabufs[index] : -1;
+}
+
+/* @internal Lends the buffer just dequeued as lentFrame, instead of decoding and requeuing it
+ *
+ * Only the 8 bit mono and Bayer formats are lent, their frames are streamed as they are captured.
+ * NV12 and NV21 frames are lent as their luma plane when zeroCopyLuma is set, for mono streams.
+ * Two buffers are always kept for the device, the frames are decoded and copied while the others are lent.
+ */
+bool V4L2_Base::lend_frame()
+{
+    bool luma;
+
+    switch (fmt.fmt.pix.pixelformat)
+    {
+        case V4L2_PIX_FMT_GREY:
+        case V4L2_PIX_FMT_SBGGR8:
+        case V4L2_PIX_FMT_SGBRG8:
+        case V4L2_PIX_FMT_SGRBG8:
+        case V4L2_PIX_FMT_SRGGB8:
+            luma = false;
+            break;
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV21:
+            if (!zeroCopyLuma)
+                return false;
+            luma = true;
+            break;
+        default:
+            return false;
+    }
+
+    /* The luma plane of NV12 and NV21 is followed by the interleaved chroma at half the rows */
+    unsigned int const pixels = fmt.fmt.pix.width * fmt.fmt.pix.height;
+    if (io != IO_METHOD_MMAP || cropset || fmt.fmt.pix.bytesperline != fmt.fmt.pix.width ||
+            buf.bytesused != (luma ? pixels + pixels / 2 : pixels))
+        return false;
+
+    {
+        std::lock_guard<std::mutex> guard(lent->lock);
+        if (lent->count + 2 >= n_buffers)
+            return false;
+        lent->count++;
+    }
+
+    auto lent_buffers = lent;
+    unsigned int index = buf.index;
+    lentFrame = BufferPool::Buffer::wrap(static_cast<uint8_t *>(buffers[index].start), pixels, [lent_buffers, index]()
+    {
+        std::lock_guard<std::mutex> guard(lent_buffers->lock);
+        /* The buffers of a stream that stopped are queued again when it starts */
+        if (lent_buffers->queueing)
+        {
+            struct v4l2_buffer qbuf;
+            struct v4l2_plane qplane;
+
+            CLEAR(qbuf);
+            CLEAR(qplane);
+
+            qbuf.type   = lent_buffers->type;
+            qbuf.memory = V4L2_MEMORY_MMAP;
+            qbuf.index  = index;
+            if (V4L2_TYPE_IS_MULTIPLANAR(qbuf.type))
+            {
+                qbuf.m.planes = &qplane;
+                qbuf.length   = 1;
+            }
+
+            if (-1 == ioctl(lent_buffers->fd, VIDIOC_QBUF, &qbuf))
+                IDLog("V4L2: could not requeue buffer #%u (%s)\n", index, strerror(errno));
+        }
+        lent_buffers->count--;
+        lent_buffers->returned.notify_all();
+    });
+    lentDecode = dodecode;
+    return true;
+}
+
+void V4L2_Base::decode_lent_frame()
+{
+    if (!lentDecode)
+        return;
+
+    lentDecode = false;
+    decoder->decode(lentFrame.data(), &buf, m_Native);
+}
+
+/* @internal Waits for the stream to release the lent buffers, which are unmapped or queued next
+ *
+ * Returns false if some are still held after a few seconds.
+ */
+bool V4L2_Base::wait_lent_frames()
+{
+    lentDecode = false;
+    lentFrame.release();
+
+    std::unique_lock<std::mutex> guard(lent->lock);
+    if (lent->returned.wait_for(guard, std::chrono::seconds(5), [this] { return lent->count == 0; }))
+        return true;
+
+    DEBUGFDEVICE(deviceName, INDI::Logger::DBG_WARNING, "%s: %u frames are still held by the stream", __FUNCTION__,
+                 lent->count);
+    return false;
+}
+
 void V4L2_Base::registerCallback(WPF * fp, void * ud)
 {
     callback = fp;
@@ -1991,11 +2350,13 @@ void V4L2_Base::findMinMax()
     tryfmt.fmt.pix.pixelformat = fmt.fmt.pix.pixelformat;
     tryfmt.fmt.pix.field       = fmt.fmt.pix.field;
 
+    to_device_format(tryfmt);
     if (-1 == XIOCTL(fd, VIDIOC_TRY_FMT, &tryfmt))
     {
         errno_exit("VIDIOC_TRY_FMT 1", errmsg);
         return;
     }
+    from_device_format(tryfmt);
 
     xmin = tryfmt.fmt.pix.width;
     ymin = tryfmt.fmt.pix.height;
@@ -2003,11 +2364,13 @@ void V4L2_Base::findMinMax()
     tryfmt.fmt.pix.width  = 1600;
     tryfmt.fmt.pix.height = 1200;
 
+    to_device_format(tryfmt);
     if (-1 == XIOCTL(fd, VIDIOC_TRY_FMT, &tryfmt))
     {
         errno_exit("VIDIOC_TRY_FMT 2", errmsg);
         return;
     }
+    from_device_format(tryfmt);
 
     xmax = tryfmt.fmt.pix.width;
     ymax = tryfmt.fmt.pix.height;
@@ -35,8 +35,14 @@
 #include "stream/streammanager.h"
 
 #include <stdio.h>
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <dirent.h>
 #include <linux/videodev2.h>
@@ -103,8 +109,42 @@ class V4L2_Base
         unsigned char *getRGBBuffer();
         float *getLinearY();
 
+        /* Zero copy */
+        /** Lends the raw frames of the 8 bit mono and Bayer formats instead of decoding them, for takeFrame()
+         *  With luma, the frames of the NV12 and NV21 formats are lent too, as their luma plane */
+        void setZeroCopy(bool enabled, bool luma = false)
+        {
+            zeroCopy     = enabled;
+            zeroCopyLuma = luma;
+        }
+        /** Takes the frame the callback is called for, when it was lent. The device buffer is requeued when the
+         *  returned buffer is released. If dmabuf is set, it receives the DMABUF exported for the frame, or -1. */
+        BufferPool::Buffer takeFrame(int *dmabuf = nullptr);
+        /** Returns the DMABUF exported for the mapped buffer index, -1 if the device does not export its buffers */
+        int getDmabuf(unsigned int index) const;
+
         void registerCallback(WPF *fp, void *ud);
 
+        /* Capture thread */
+        /** Reads the frames on a thread of their own instead of the event loop, from the next start_capturing().
+         *  The callback is then called on that thread. With realtime, the thread runs with the SCHED_FIFO policy. */
+        void setCaptureThread(bool enabled, bool realtime = false)
+        {
+            captureThreaded = enabled;
+            captureRealtime = realtime;
+        }
+        /** Sets the number of buffers requested from the device, from the next time they are allocated */
+        void setBufferCount(unsigned int count)
+        {
+            bufferCount = count;
+        }
+        /** Returns the UTC time the device captured the last frame at, in microseconds since the Unix epoch,
+         *  or 0 if the device does not timestamp its frames */
+        uint64_t getTimestamp() const
+        {
+            return frameTimestamp;
+        }
+
         int start_capturing(char *errmsg);
         int stop_capturing(char *errmsg);
         static void newFrame(int fd, void *p);
@@ -156,6 +196,9 @@ class V4L2_Base
     protected:
         int xioctl(int fd, int request, void *arg, char const *const request_str);
         int ioctl_set_format(struct v4l2_format new_fmt, char *errmsg);
+        void to_device_format(struct v4l2_format &f) const;
+        void from_device_format(struct v4l2_format &f) const;
+        void setup_buffer(struct v4l2_buffer &b, struct v4l2_plane *planes, unsigned int memory, unsigned int index) const;
 
         int read_frame(char *errsg);
         int uninit_device(char *errmsg);
@@ -171,6 +214,14 @@ class V4L2_Base
 
         void findMinMax();
 
+        void capture_loop();
+        void stop_capture_thread();
+        uint64_t frame_timestamp() const;
+
+        bool lend_frame();
+        void decode_lent_frame();
+        bool wait_lent_frames();
+
         int enumeratedInputs;
         int enumeratedCaptureFormats;
 
@@ -185,6 +236,10 @@ class V4L2_Base
         struct v4l2_format fmt;
         struct v4l2_input input;
         struct v4l2_buffer buf;
+        /* Multi-planar devices, with their single plane formats: fmt and buf are kept single-planar */
+        bool mplane {false};
+        enum v4l2_buf_type buftype {V4L2_BUF_TYPE_VIDEO_CAPTURE};
+        struct v4l2_plane bufplanes[VIDEO_MAX_PLANES];
 
         bool cancrop;
         bool cropset;
@@ -210,6 +265,30 @@ class V4L2_Base
         struct buffer *buffers;
         unsigned int n_buffers;
         bool reallocate_buffers;
+        std::vector<int> dmabufs;
+
+        /* Buffers lent to the stream, shared with the frames that requeue them when they are released */
+        struct lent_buffers
+        {
+            std::mutex lock;
+            std::condition_variable returned;
+            int fd {-1};
+            enum v4l2_buf_type type {V4L2_BUF_TYPE_VIDEO_CAPTURE};
+            unsigned int count {0};
+            bool queueing {false};
+        };
+        std::shared_ptr<lent_buffers> lent;
+        BufferPool::Buffer lentFrame;
+        bool lentDecode {false};
+        bool zeroCopy {false};
+        bool zeroCopyLuma {false};
+
+        std::thread captureThread;
+        std::atomic<bool> captureStop {false};
+        bool captureThreaded {false};
+        bool captureRealtime {false};
+        unsigned int bufferCount {4};
+        uint64_t frameTimestamp {0};
         //int		dropFrame;
         //bool      dropFrameEnabled;
         //unsigned int      dropFrameCount;
@@ -80,6 +80,7 @@ V4L2_Builtin_Decoder::V4L2_Builtin_Decoder()
     colorBuffer    = nullptr;
     rgb24_buffer   = nullptr;
     linearBuffer   = nullptr;
+    linearLutColorspace = -1;
     //cropbuf = nullptr;
     for (i = 0; i < 32; i++)
     {
@@ -91,6 +92,13 @@ V4L2_Builtin_Decoder::V4L2_Builtin_Decoder()
     }
     initColorSpace();
     bpp = 8;
+    mjpegBackends = V4L2_MJPEG_Backend::create();
+    mjpegFailed.assign(mjpegBackends.size(), false);
+    mjpegBackend = nullptr;
+    mjpegWidth   = 0;
+    mjpegHeight  = 0;
+    mjpegChoice  = "Auto";
+    mjpegReopen  = true;
 }
 
 V4L2_Builtin_Decoder::~V4L2_Builtin_Decoder()
@@ -267,35 +275,10 @@ void V4L2_Builtin_Decoder::decode(unsigned char *frame, struct v4l2_buffer *buf,
             }
             else
             {
-                unsigned char *src   = frame;
-                unsigned char *dest  = YBuf;
-                unsigned char *destv = VBuf;
-                unsigned char *s = nullptr;
-
-                for (unsigned int i = 0; i < bufheight; i++)
-                {
-                    memcpy(dest, src, bufwidth);
-                    src += fmt.fmt.pix.bytesperline;
-                    dest += bufwidth;
-                }
-                dest = UBuf;
-                src  = frame + (fmt.fmt.pix.bytesperline * bufheight);
                 if (fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_NV21)
-                {
-                    dest  = VBuf;
-                    destv = UBuf;
-                }
-                for (unsigned int i = 0; i < bufheight / 2; i++)
-                {
-                    s = src;
-                    //IDLog("NV12: converting UV line %d at %p, offset %d, pUbuf %p offset %d,  pVbuf %p offset %d\n", i, s, s- (frame + (fmt.fmt.pix.bytesperline * bufheight)), dest, dest-UBuf, destv, destv-VBuf);
-                    for (unsigned int j = 0; j < bufwidth; j += 2)
-                    {
-                        *(dest++)  = *(s++);
-                        *(destv++) = *(s++);
-                    }
-                    src += fmt.fmt.pix.bytesperline;
-                }
+                    ccvt_nv12_420p(bufwidth, bufheight, fmt.fmt.pix.bytesperline, frame, YBuf, VBuf, UBuf);
+                else
+                    ccvt_nv12_420p(bufwidth, bufheight, fmt.fmt.pix.bytesperline, frame, YBuf, UBuf, VBuf);
             }
             break;
 
@@ -472,7 +455,7 @@ void V4L2_Builtin_Decoder::decode(unsigned char *frame, struct v4l2_buffer *buf,
             if (native)
                 memcpy(yuvBuffer, frame, buf->bytesused);
             else
-                mjpegtoyuv420p(yuvBuffer, frame, fmt.fmt.pix.width, fmt.fmt.pix.height, buf->bytesused);
+                decodeMJPEG(frame, buf->bytesused);
             m_Size = buf->bytesused;
             break;
         default:
@@ -487,6 +470,92 @@ void V4L2_Builtin_Decoder::decode(unsigned char *frame, struct v4l2_buffer *buf,
     }
 }
 
+void V4L2_Builtin_Decoder::decodeMJPEG(unsigned char *frame, unsigned int size)
+{
+    if (!openMJPEGBackend(fmt.fmt.pix.width, fmt.fmt.pix.height) || !mjpegBackend->decode(frame, size, yuvBuffer))
+    {
+        if (mjpegBackend)
+        {
+            // Auto selection goes on with the next backend, a backend chosen is opened again
+            IDLog("Decoder: %s failed to decode a MJPEG frame\n", mjpegBackend->getName());
+            std::lock_guard<std::mutex> lock(mjpegLock);
+            for (size_t i = 0; i < mjpegBackends.size(); i++)
+                if (mjpegBackends[i].get() == mjpegBackend)
+                    mjpegFailed[i] = true;
+            mjpegBackend = nullptr;
+            mjpegReopen  = true;
+        }
+        mjpegtoyuv420p(yuvBuffer, frame, fmt.fmt.pix.width, fmt.fmt.pix.height, size);
+    }
+}
+
+bool V4L2_Builtin_Decoder::openMJPEGBackend(unsigned int width, unsigned int height)
+{
+    std::lock_guard<std::mutex> lock(mjpegLock);
+
+    if (width != mjpegWidth || height != mjpegHeight)
+    {
+        mjpegFailed.assign(mjpegBackends.size(), false);
+        mjpegReopen = true;
+    }
+    if (!mjpegReopen)
+        return mjpegBackend != nullptr;
+
+    mjpegReopen  = false;
+    mjpegBackend = nullptr;
+    mjpegWidth   = width;
+    mjpegHeight  = height;
+
+    bool const automatic = (mjpegChoice == "Auto");
+    for (size_t i = 0; i < mjpegBackends.size(); i++)
+    {
+        if (automatic ? mjpegFailed[i] : mjpegChoice != mjpegBackends[i]->getName())
+            continue;
+
+        if (mjpegBackends[i]->open(width, height))
+        {
+            mjpegBackend = mjpegBackends[i].get();
+            IDLog("Decoder: decoding %ux%u MJPEG frames with %s\n", width, height, mjpegBackend->getName());
+            break;
+        }
+        mjpegFailed[i] = true;
+    }
+    return mjpegBackend != nullptr;
+}
+
+std::vector<const char *> V4L2_Builtin_Decoder::getMJPEGBackends()
+{
+    std::vector<const char *> names;
+    for (auto &backend : mjpegBackends)
+        names.push_back(backend->getName());
+    return names;
+}
+
+bool V4L2_Builtin_Decoder::setMJPEGBackend(const char *backend)
+{
+    std::lock_guard<std::mutex> lock(mjpegLock);
+
+    bool known = !strcmp(backend, "Auto");
+    for (auto &one : mjpegBackends)
+        known = known || !strcmp(backend, one->getName());
+    if (!known)
+        return false;
+
+    if (mjpegChoice != backend)
+    {
+        mjpegChoice = backend;
+        mjpegFailed.assign(mjpegBackends.size(), false);
+        mjpegReopen = true;
+    }
+    return true;
+}
+
+const char *V4L2_Builtin_Decoder::getMJPEGBackend()
+{
+    std::lock_guard<std::mutex> lock(mjpegLock);
+    return mjpegBackend ? mjpegBackend->getName() : nullptr;
+}
+
 bool V4L2_Builtin_Decoder::setcrop(struct v4l2_crop c)
 {
     crop = c;
@@ -640,10 +709,17 @@ void V4L2_Builtin_Decoder::makeLinearY()
     {
         linearBuffer = new float[(bufwidth * bufheight)];
     }
+    // Linearize the 256 levels once per colorspace, rather than calling pow for each pixel
+    if (linearLutColorspace != static_cast<int>(fmt.fmt.pix.colorspace))
+    {
+        for (i = 0; i < 256; i++)
+            linearLut[i] = i / 255.0;
+        linearize(linearLut, 256, &fmt);
+        linearLutColorspace = static_cast<int>(fmt.fmt.pix.colorspace);
+    }
     dest = linearBuffer;
     for (i = 0; i < bufwidth * bufheight; i++)
-        *dest++ = (*src++) / 255.0;
-    linearize(linearBuffer, bufwidth * bufheight, &fmt);
+        *dest++ = linearLut[*src++];
 }
 void V4L2_Builtin_Decoder::makeY()
 {
@@ -23,8 +23,12 @@
 #pragma once
 
 #include "v4l2_decode.h"
+#include "v4l2_mjpeg_backend.h"
 
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 
 class V4L2_Builtin_Decoder : public V4L2_Decoder
 {
@@ -57,6 +61,9 @@ class V4L2_Builtin_Decoder : public V4L2_Decoder
         virtual int getBpp();
         virtual void setQuantization(bool);
         virtual void setLinearization(bool);
+        virtual std::vector<const char *> getMJPEGBackends();
+        virtual bool setMJPEGBackend(const char *backend);
+        virtual const char *getMJPEGBackend();
 
     protected:
         void init_supported_formats();
@@ -65,6 +72,8 @@ class V4L2_Builtin_Decoder : public V4L2_Decoder
         void allocBuffers();
         void makeY();
         void makeLinearY();
+        void decodeMJPEG(unsigned char *frame, unsigned int size);
+        bool openMJPEGBackend(unsigned int width, unsigned int height);
 
         struct v4l2_crop crop;
         struct v4l2_format fmt;
@@ -81,6 +90,9 @@ class V4L2_Builtin_Decoder : public V4L2_Decoder
         unsigned char *colorBuffer;
         unsigned char *rgb24_buffer;
         float *linearBuffer;
+        // Linear values of the 256 luma levels, for the colorspace they were computed for
+        float linearLut[256];
+        int linearLutColorspace;
         //unsigned char *cropbuf;
         unsigned int bufwidth;
         unsigned int bufheight;
@@ -88,4 +100,14 @@ class V4L2_Builtin_Decoder : public V4L2_Decoder
         char lut6[64];
         unsigned char bpp;
         int m_Size;
+
+        std::vector<std::unique_ptr<V4L2_MJPEG_Backend>> mjpegBackends;
+        std::vector<bool> mjpegFailed; // backends auto selection no longer tries
+        V4L2_MJPEG_Backend *mjpegBackend;
+        unsigned int mjpegWidth;
+        unsigned int mjpegHeight;
+        // Selection of the driver thread, applied by the decoding thread on the next frame
+        std::mutex mjpegLock;
+        std::string mjpegChoice;
+        bool mjpegReopen;
 };
@@ -36,6 +36,21 @@ const char *V4L2_Decoder::getName()
     return name;
 }
 
+std::vector<const char *> V4L2_Decoder::getMJPEGBackends()
+{
+    return std::vector<const char *>();
+}
+
+bool V4L2_Decoder::setMJPEGBackend(const char *)
+{
+    return false;
+}
+
+const char *V4L2_Decoder::getMJPEGBackend()
+{
+    return nullptr;
+}
+
 V4L2_Decode::V4L2_Decode()
 {
     decoder_list.push_back(new V4L2_Builtin_Decoder());
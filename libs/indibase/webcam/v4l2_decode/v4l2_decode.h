@@ -56,6 +56,13 @@ class V4L2_Decoder
         virtual void setQuantization(bool)    = 0;
         virtual void setLinearization(bool)   = 0;
 
+        /* MJPEG decompression backends, for decoders decompressing MJPEG frames themselves */
+        virtual std::vector<const char *> getMJPEGBackends();
+        /* "Auto" selects the fastest backend that decodes the frames */
+        virtual bool setMJPEGBackend(const char *backend);
+        /* The backend decoding the frames, nullptr until one does */
+        virtual const char *getMJPEGBackend();
+
     protected:
         const char *name;
 };
@@ -0,0 +1,727 @@
+/*
+    V4L2 MJPEG Backends
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#include "v4l2_mjpeg_backend.h"
+
+#include "ccvt.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <linux/videodev2.h>
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+#ifdef HAVE_LIBAVCODEC
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+}
+#endif
+
+namespace
+{
+
+// Copies height rows of width bytes
+void copyPlane(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height)
+{
+    for (int row = 0; row < height; row++)
+        memcpy(dst + row * width, src + row * srcStride, width);
+}
+
+// Averages the pairs of rows of a 4:2:2 chroma plane into the height rows of a 4:2:0 one
+void halveRows(const uint8_t *src, int srcStride, uint8_t *dst, int width, int height)
+{
+    for (int row = 0; row < height; row++, src += 2 * srcStride, dst += width)
+        for (int x = 0; x < width; x++)
+            dst[x] = static_cast<uint8_t>((src[x] + src[x + srcStride] + 1) >> 1);
+}
+
+// Splits the interleaved chroma of a NV12 frame
+void splitChroma(const uint8_t *src, int srcStride, uint8_t *u, uint8_t *v, int width, int height)
+{
+    for (int row = 0; row < height; row++, src += srcStride)
+        for (int x = 0; x < width; x++)
+        {
+            *u++ = src[2 * x];
+            *v++ = src[2 * x + 1];
+        }
+}
+
+/* The bundled jpegutils, on libjpeg */
+class JpegUtilsBackend : public V4L2_MJPEG_Backend
+{
+    public:
+        const char *getName() const override
+        {
+            return "libjpeg";
+        }
+
+        bool open(int width, int height) override
+        {
+            this->width  = width;
+            this->height = height;
+            return true;
+        }
+
+        bool decode(const unsigned char *jpeg, size_t size, unsigned char *yuv) override
+        {
+            return mjpegtoyuv420p(yuv, const_cast<unsigned char *>(jpeg), width, height, size) >= 0;
+        }
+
+    private:
+        int width {0};
+        int height {0};
+};
+
+#ifdef HAVE_TURBOJPEG
+/* The TurboJPEG API of libjpeg-turbo, decoding to YUV planes with its SIMD code */
+class TurboJPEGBackend : public V4L2_MJPEG_Backend
+{
+    public:
+        ~TurboJPEGBackend()
+        {
+            if (handle)
+                tjDestroy(handle);
+        }
+
+        const char *getName() const override
+        {
+            return "TurboJPEG";
+        }
+
+        bool open(int width, int height) override
+        {
+            if (width % 2 || height % 2)
+                return false;
+
+            if (handle == nullptr)
+                handle = tjInitDecompress();
+            this->width  = width;
+            this->height = height;
+            return handle != nullptr;
+        }
+
+        bool decode(const unsigned char *jpeg, size_t size, unsigned char *yuv) override
+        {
+            int jpegWidth, jpegHeight, subsampling, colorspace;
+            if (tjDecompressHeader3(handle, const_cast<unsigned char *>(jpeg), size, &jpegWidth, &jpegHeight, &subsampling,
+                                    &colorspace) != 0 || jpegWidth != width || jpegHeight != height)
+                return false;
+
+            unsigned char *y = yuv;
+            unsigned char *u = y + width * height;
+            unsigned char *v = u + width * height / 4;
+            int strides[3] = { width, width / 2, width / 2 };
+
+            switch (subsampling)
+            {
+                case TJSAMP_420:
+                {
+                    unsigned char *planes[3] = { y, u, v };
+                    return decode(jpeg, size, planes, strides);
+                }
+
+                // Most webcams send 4:2:2
+                case TJSAMP_422:
+                {
+                    chroma.resize(width * height);
+                    unsigned char *planes[3] = { y, chroma.data(), chroma.data() + width / 2 * height };
+                    if (!decode(jpeg, size, planes, strides))
+                        return false;
+                    halveRows(planes[1], width / 2, u, width / 2, height / 2);
+                    halveRows(planes[2], width / 2, v, width / 2, height / 2);
+                    return true;
+                }
+
+                case TJSAMP_GRAY:
+                {
+                    unsigned char *planes[3] = { y, nullptr, nullptr };
+                    if (!decode(jpeg, size, planes, strides))
+                        return false;
+                    memset(u, 128, width * height / 2);
+                    return true;
+                }
+
+                default:
+                    return false;
+            }
+        }
+
+    private:
+        bool decode(const unsigned char *jpeg, size_t size, unsigned char **planes, int *strides)
+        {
+            return tjDecompressToYUVPlanes(handle, const_cast<unsigned char *>(jpeg), size, planes, width, strides, height,
+                                           TJFLAG_FASTDCT) == 0;
+        }
+
+    private:
+        tjhandle handle {nullptr};
+        int width {0};
+        int height {0};
+        std::vector<unsigned char> chroma;
+};
+#endif
+
+#ifdef HAVE_LIBAVCODEC
+/* The MJPEG decoder of libavcodec with the VAAPI hardware acceleration, and only with it */
+class VAAPIBackend : public V4L2_MJPEG_Backend
+{
+    public:
+        ~VAAPIBackend()
+        {
+            close();
+        }
+
+        const char *getName() const override
+        {
+            return "VAAPI";
+        }
+
+        bool open(int width, int height) override
+        {
+            close();
+
+            const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_MJPEG);
+            if (codec == nullptr || av_hwdevice_ctx_create(&device, AV_HWDEVICE_TYPE_VAAPI, nullptr, nullptr, 0) < 0)
+                return false;
+
+            context = avcodec_alloc_context3(codec);
+            if (context == nullptr)
+                return false;
+            context->hw_device_ctx = av_buffer_ref(device);
+            context->get_format    = hardwareFormat;
+            context->width         = width;
+            context->height        = height;
+
+            if (avcodec_open2(context, codec, nullptr) < 0)
+            {
+                close();
+                return false;
+            }
+
+            frame    = av_frame_alloc();
+            swFrame  = av_frame_alloc();
+            packet   = av_packet_alloc();
+            this->width  = width;
+            this->height = height;
+            return frame && swFrame && packet;
+        }
+
+        bool decode(const unsigned char *jpeg, size_t size, unsigned char *yuv) override
+        {
+            if (context == nullptr)
+                return false;
+
+            packet->data = const_cast<uint8_t *>(jpeg);
+            packet->size = static_cast<int>(size);
+            bool decoded = avcodec_send_packet(context, packet) >= 0 && avcodec_receive_frame(context, frame) >= 0;
+
+            const AVFrame *image = frame;
+            if (decoded && frame->format == AV_PIX_FMT_VAAPI)
+            {
+                decoded = av_hwframe_transfer_data(swFrame, frame, 0) >= 0;
+                image   = swFrame;
+            }
+
+            decoded = decoded && copy(image, yuv);
+            av_frame_unref(frame);
+            av_frame_unref(swFrame);
+            return decoded;
+        }
+
+    private:
+        // Fails the frames VAAPI does not decode, rather than decoding them in software
+        static AVPixelFormat hardwareFormat(AVCodecContext *, const AVPixelFormat *formats)
+        {
+            for (; *formats != AV_PIX_FMT_NONE; formats++)
+                if (*formats == AV_PIX_FMT_VAAPI)
+                    return *formats;
+            return AV_PIX_FMT_NONE;
+        }
+
+        bool copy(const AVFrame *image, unsigned char *yuv) const
+        {
+            if (image->width != width || image->height != height)
+                return false;
+
+            unsigned char *u = yuv + width * height;
+            unsigned char *v = u + width * height / 4;
+
+            copyPlane(image->data[0], image->linesize[0], yuv, width, height);
+            switch (image->format)
+            {
+                case AV_PIX_FMT_NV12:
+                    splitChroma(image->data[1], image->linesize[1], u, v, width / 2, height / 2);
+                    return true;
+                case AV_PIX_FMT_YUV420P:
+                case AV_PIX_FMT_YUVJ420P:
+                    copyPlane(image->data[1], image->linesize[1], u, width / 2, height / 2);
+                    copyPlane(image->data[2], image->linesize[2], v, width / 2, height / 2);
+                    return true;
+                case AV_PIX_FMT_YUV422P:
+                case AV_PIX_FMT_YUVJ422P:
+                    halveRows(image->data[1], image->linesize[1], u, width / 2, height / 2);
+                    halveRows(image->data[2], image->linesize[2], v, width / 2, height / 2);
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        void close()
+        {
+            av_packet_free(&packet);
+            av_frame_free(&swFrame);
+            av_frame_free(&frame);
+            avcodec_free_context(&context);
+            av_buffer_unref(&device);
+        }
+
+    private:
+        AVBufferRef *device {nullptr};
+        AVCodecContext *context {nullptr};
+        AVFrame *frame {nullptr};
+        AVFrame *swFrame {nullptr};
+        AVPacket *packet {nullptr};
+        int width {0};
+        int height {0};
+};
+#endif
+
+/* A stateful V4L2 memory to memory JPEG decoder, the first of /dev/video* that decodes to YUV 4:2:0 or NV12
+ *
+ * The frames are decoded one at a time, the compressed frame is queued and the decoded one waited for.
+ */
+class M2MBackend : public V4L2_MJPEG_Backend
+{
+        struct mapping
+        {
+            void *start;
+            size_t length;
+        };
+
+    public:
+        ~M2MBackend()
+        {
+            close();
+        }
+
+        const char *getName() const override
+        {
+            return "V4L2 M2M";
+        }
+
+        bool open(int width, int height) override
+        {
+            close();
+
+            if (width % 2 || height % 2)
+                return false;
+
+            for (int i = 0; i < 64; i++)
+            {
+                char path[32];
+                snprintf(path, sizeof(path), "/dev/video%d", i);
+                if (open(path, width, height))
+                    return true;
+                close();
+            }
+            return false;
+        }
+
+        bool decode(const unsigned char *jpeg, size_t size, unsigned char *yuv) override
+        {
+            if (fd == -1 || size > output.length)
+                return false;
+
+            memcpy(output.start, jpeg, size);
+            if (!queue(outputType, 0, size))
+                return fail();
+
+            // The decoded frame, or a change of the capture format to apply first
+            int index = -1;
+            bool error = false;
+            while (index == -1)
+            {
+                struct pollfd pfd = { fd, POLLIN | POLLPRI, 0 };
+                int const ready = poll(&pfd, 1, 1000);
+                if (ready == -1 && errno == EINTR)
+                    continue;
+                if (ready <= 0 || (pfd.revents & POLLERR))
+                    return fail();
+
+                if ((pfd.revents & POLLPRI) && !handleEvents())
+                    return fail();
+
+                if (pfd.revents & POLLIN)
+                    index = dequeue(captureType, error);
+            }
+
+            if (!error)
+                copy(static_cast<const uint8_t *>(capture[index].start), yuv);
+
+            if (!queue(captureType, index, 0))
+                return fail();
+
+            // The compressed frame was consumed before its decoded frame came out
+            bool unused;
+            for (int tries = 0; dequeue(outputType, unused) == -1; tries++)
+            {
+                if (tries == 100 || errno != EAGAIN)
+                    return fail();
+                usleep(1000);
+            }
+            return !error;
+        }
+
+    private:
+        bool open(const char *path, int width, int height)
+        {
+            fd = ::open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+            if (fd == -1)
+                return false;
+
+            struct v4l2_capability cap;
+            memset(&cap, 0, sizeof(cap));
+            if (xioctl(VIDIOC_QUERYCAP, &cap) == -1)
+                return false;
+
+            uint32_t const caps = (cap.capabilities & V4L2_CAP_DEVICE_CAPS) ? cap.device_caps : cap.capabilities;
+            if (!(caps & V4L2_CAP_STREAMING) || !(caps & (V4L2_CAP_VIDEO_M2M | V4L2_CAP_VIDEO_M2M_MPLANE)))
+                return false;
+
+            mplane      = caps & V4L2_CAP_VIDEO_M2M_MPLANE;
+            outputType  = mplane ? V4L2_BUF_TYPE_VIDEO_OUTPUT_MPLANE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+            captureType = mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE : V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+            uint32_t const jpegFormat = findFormat(outputType, V4L2_PIX_FMT_MJPEG, V4L2_PIX_FMT_JPEG);
+            captureFormat = findFormat(captureType, V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_NV12);
+            if (jpegFormat == 0 || captureFormat == 0)
+                return false;
+
+            this->width  = width;
+            this->height = height;
+
+            // Compressed frames are not expected to be larger than their luma
+            struct v4l2_format format;
+            if (!setFormat(outputType, jpegFormat, width * height, format))
+                return false;
+            output.length = 0;
+            if (!allocate(outputType, 1, &output))
+                return false;
+
+            // Decoders may report the source size once they parsed a frame
+            struct v4l2_event_subscription subscription;
+            memset(&subscription, 0, sizeof(subscription));
+            subscription.type = V4L2_EVENT_SOURCE_CHANGE;
+            xioctl(VIDIOC_SUBSCRIBE_EVENT, &subscription);
+
+            if (!setFormat(captureType, captureFormat, 0, format) || !startCapture())
+                return false;
+
+            int type = outputType;
+            if (xioctl(VIDIOC_STREAMON, &type) == -1)
+                return false;
+
+            fprintf(stderr, "V4L2 M2M: decoding %dx%d MJPEG frames with %s (%.32s)\n", width, height, path, cap.card);
+            return true;
+        }
+
+        void close()
+        {
+            if (fd == -1)
+                return;
+
+            int type = outputType;
+            xioctl(VIDIOC_STREAMOFF, &type);
+            stopCapture();
+            release(outputType, 1, &output);
+            ::close(fd);
+            fd = -1;
+        }
+
+        // Closes the device once it failed, later frames go to the next backend
+        bool fail()
+        {
+            fprintf(stderr, "V4L2 M2M: decoding failed (%s)\n", strerror(errno));
+            close();
+            return false;
+        }
+
+        int xioctl(unsigned long request, void *arg)
+        {
+            int r;
+            do
+                r = ioctl(fd, request, arg);
+            while (r == -1 && errno == EINTR);
+            return r;
+        }
+
+        uint32_t findFormat(uint32_t type, uint32_t preferred, uint32_t other)
+        {
+            uint32_t found = 0;
+            struct v4l2_fmtdesc desc;
+            memset(&desc, 0, sizeof(desc));
+            desc.type = type;
+            for (desc.index = 0; xioctl(VIDIOC_ENUM_FMT, &desc) == 0; desc.index++)
+            {
+                if (desc.pixelformat == preferred)
+                    return preferred;
+                if (desc.pixelformat == other)
+                    found = other;
+            }
+            return found;
+        }
+
+        bool setFormat(uint32_t type, uint32_t pixelformat, uint32_t sizeimage, struct v4l2_format &format)
+        {
+            memset(&format, 0, sizeof(format));
+            format.type = type;
+            if (mplane)
+            {
+                format.fmt.pix_mp.width                     = width;
+                format.fmt.pix_mp.height                    = height;
+                format.fmt.pix_mp.pixelformat               = pixelformat;
+                format.fmt.pix_mp.num_planes                = 1;
+                format.fmt.pix_mp.plane_fmt[0].sizeimage    = sizeimage;
+            }
+            else
+            {
+                format.fmt.pix.width       = width;
+                format.fmt.pix.height      = height;
+                format.fmt.pix.pixelformat = pixelformat;
+                format.fmt.pix.sizeimage   = sizeimage;
+            }
+            return xioctl(VIDIOC_S_FMT, &format) == 0;
+        }
+
+        // Reads back the capture layout, which the decoder may align beyond the frame size
+        bool getCaptureFormat()
+        {
+            struct v4l2_format format;
+            memset(&format, 0, sizeof(format));
+            format.type = captureType;
+            if (xioctl(VIDIOC_G_FMT, &format) == -1)
+                return false;
+
+            uint32_t pixelformat, frameWidth;
+            if (mplane)
+            {
+                if (format.fmt.pix_mp.num_planes != 1)
+                    return false;
+                pixelformat   = format.fmt.pix_mp.pixelformat;
+                frameWidth    = format.fmt.pix_mp.width;
+                alignedHeight = format.fmt.pix_mp.height;
+                stride        = format.fmt.pix_mp.plane_fmt[0].bytesperline;
+            }
+            else
+            {
+                pixelformat   = format.fmt.pix.pixelformat;
+                frameWidth    = format.fmt.pix.width;
+                alignedHeight = format.fmt.pix.height;
+                stride        = format.fmt.pix.bytesperline;
+            }
+
+            if (pixelformat != captureFormat && !setFormat(captureType, captureFormat, 0, format))
+                return false;
+            if (stride == 0)
+                stride = frameWidth;
+            return frameWidth >= static_cast<uint32_t>(width) && alignedHeight >= static_cast<uint32_t>(height) &&
+                   stride >= frameWidth;
+        }
+
+        bool allocate(uint32_t type, unsigned int count, mapping *mappings)
+        {
+            struct v4l2_requestbuffers request;
+            memset(&request, 0, sizeof(request));
+            request.count  = count;
+            request.type   = type;
+            request.memory = V4L2_MEMORY_MMAP;
+            if (xioctl(VIDIOC_REQBUFS, &request) == -1 || request.count < count)
+                return false;
+
+            for (unsigned int i = 0; i < count; i++)
+            {
+                struct v4l2_plane planes[VIDEO_MAX_PLANES];
+                struct v4l2_buffer buffer;
+                memset(&buffer, 0, sizeof(buffer));
+                buffer.type   = type;
+                buffer.memory = V4L2_MEMORY_MMAP;
+                buffer.index  = i;
+                if (mplane)
+                {
+                    buffer.m.planes = planes;
+                    buffer.length   = VIDEO_MAX_PLANES;
+                }
+                if (xioctl(VIDIOC_QUERYBUF, &buffer) == -1)
+                    return false;
+
+                size_t const length = mplane ? planes[0].length : buffer.length;
+                off_t const offset  = mplane ? planes[0].m.mem_offset : buffer.m.offset;
+                void *start = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+                if (start == MAP_FAILED)
+                    return false;
+                mappings[i] = { start, length };
+            }
+            return true;
+        }
+
+        void release(uint32_t type, unsigned int count, mapping *mappings)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                if (mappings[i].length > 0)
+                    munmap(mappings[i].start, mappings[i].length);
+            memset(mappings, 0, count * sizeof(*mappings));
+
+            struct v4l2_requestbuffers request;
+            memset(&request, 0, sizeof(request));
+            request.type   = type;
+            request.memory = V4L2_MEMORY_MMAP;
+            xioctl(VIDIOC_REQBUFS, &request);
+        }
+
+        bool queue(uint32_t type, unsigned int index, size_t bytesused)
+        {
+            struct v4l2_plane planes[VIDEO_MAX_PLANES];
+            struct v4l2_buffer buffer;
+            memset(&buffer, 0, sizeof(buffer));
+            memset(planes, 0, sizeof(planes));
+            buffer.type   = type;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            buffer.index  = index;
+            if (mplane)
+            {
+                planes[0].bytesused = bytesused;
+                buffer.m.planes     = planes;
+                buffer.length       = 1;
+            }
+            else
+                buffer.bytesused = bytesused;
+            return xioctl(VIDIOC_QBUF, &buffer) == 0;
+        }
+
+        // Returns the index of the dequeued buffer, or -1
+        int dequeue(uint32_t type, bool &error)
+        {
+            struct v4l2_plane planes[VIDEO_MAX_PLANES];
+            struct v4l2_buffer buffer;
+            memset(&buffer, 0, sizeof(buffer));
+            buffer.type   = type;
+            buffer.memory = V4L2_MEMORY_MMAP;
+            if (mplane)
+            {
+                buffer.m.planes = planes;
+                buffer.length   = VIDEO_MAX_PLANES;
+            }
+            if (xioctl(VIDIOC_DQBUF, &buffer) == -1)
+                return -1;
+            error = buffer.flags & V4L2_BUF_FLAG_ERROR;
+            return buffer.index;
+        }
+
+        bool startCapture()
+        {
+            if (!getCaptureFormat() || !allocate(captureType, CAPTURE_BUFFERS, capture))
+                return false;
+            for (unsigned int i = 0; i < CAPTURE_BUFFERS; i++)
+                if (!queue(captureType, i, 0))
+                    return false;
+
+            int type = captureType;
+            return xioctl(VIDIOC_STREAMON, &type) == 0;
+        }
+
+        void stopCapture()
+        {
+            int type = captureType;
+            xioctl(VIDIOC_STREAMOFF, &type);
+            release(captureType, CAPTURE_BUFFERS, capture);
+        }
+
+        bool handleEvents()
+        {
+            struct v4l2_event event;
+            memset(&event, 0, sizeof(event));
+            while (xioctl(VIDIOC_DQEVENT, &event) == 0)
+                if (event.type == V4L2_EVENT_SOURCE_CHANGE)
+                {
+                    stopCapture();
+                    if (!startCapture())
+                        return false;
+                }
+            return true;
+        }
+
+        void copy(const uint8_t *frame, unsigned char *yuv) const
+        {
+            unsigned char *u = yuv + width * height;
+            unsigned char *v = u + width * height / 4;
+            const uint8_t *chroma = frame + stride * alignedHeight;
+
+            copyPlane(frame, stride, yuv, width, height);
+            if (captureFormat == V4L2_PIX_FMT_NV12)
+                splitChroma(chroma, stride, u, v, width / 2, height / 2);
+            else
+            {
+                copyPlane(chroma, stride / 2, u, width / 2, height / 2);
+                copyPlane(chroma + stride / 2 * (alignedHeight / 2), stride / 2, v, width / 2, height / 2);
+            }
+        }
+
+    private:
+        static constexpr unsigned int CAPTURE_BUFFERS = 2;
+
+        int fd {-1};
+        bool mplane {false};
+        uint32_t outputType {V4L2_BUF_TYPE_VIDEO_OUTPUT};
+        uint32_t captureType {V4L2_BUF_TYPE_VIDEO_CAPTURE};
+        uint32_t captureFormat {0};
+        int width {0};
+        int height {0};
+        uint32_t stride {0};
+        uint32_t alignedHeight {0};
+        mapping output {nullptr, 0};
+        mapping capture[CAPTURE_BUFFERS] {};
+};
+
+}
+
+std::vector<std::unique_ptr<V4L2_MJPEG_Backend>> V4L2_MJPEG_Backend::create()
+{
+    std::vector<std::unique_ptr<V4L2_MJPEG_Backend>> backends;
+    backends.emplace_back(new M2MBackend());
+#ifdef HAVE_LIBAVCODEC
+    backends.emplace_back(new VAAPIBackend());
+#endif
+#ifdef HAVE_TURBOJPEG
+    backends.emplace_back(new TurboJPEGBackend());
+#endif
+    backends.emplace_back(new JpegUtilsBackend());
+    return backends;
+}
@@ -0,0 +1,47 @@
+/*
+    V4L2 MJPEG Backends
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The V4L2_MJPEG_Backend class decompresses the MJPEG frames of V4L2_Builtin_Decoder to planar YUV 4:2:0.
+ *
+ * create() returns the backends built in, fastest first: the V4L2 M2M JPEG decoders of the system (Raspberry Pi,
+ * i.MX, Exynos), VAAPI through libavcodec, libjpeg-turbo and last the bundled jpegutils, which decode any frame.
+ */
+class V4L2_MJPEG_Backend
+{
+    public:
+        virtual ~V4L2_MJPEG_Backend() = default;
+
+        virtual const char *getName() const = 0;
+
+        /** @brief Prepares to decode frames of width x height, returns false if the backend cannot on this system. */
+        virtual bool open(int width, int height) = 0;
+
+        /** @brief Decodes a frame of the opened size to yuv, the Y, U and V planes one after the other.
+         *  @return False if the frame could not be decoded, yuv is then undefined. */
+        virtual bool decode(const unsigned char *jpeg, size_t size, unsigned char *yuv) = 0;
+
+        static std::vector<std::unique_ptr<V4L2_MJPEG_Backend>> create();
+};
@@ -81,7 +81,7 @@ bool ClientSharedBlobs::parseAttachedBlobs(const INDI::LilXmlElement &root, Clie
         if (attached.toString() != "true")
             continue;
 
-        auto device = root.getAttribute("dev");
+        auto device = root.getAttribute("device");
         auto name   = root.getAttribute("name");
 
         blobContent.removeAttribute("attached");
@@ -145,8 +145,14 @@ void ClientSharedBlobs::clear()
 
 void TcpSocketSharedBlobs::readyRead()
 {
-    char buffer[MAXINDIBUF];
+    readAll([this](void *dst, size_t size)
+    {
+        return recvWithFds(dst, size);
+    });
+}
 
+ssize_t TcpSocketSharedBlobs::recvWithFds(void *dst, size_t size)
+{
     struct msghdr msgh;
     struct iovec iov;
 
@@ -162,8 +168,8 @@ void TcpSocketSharedBlobs::readyRead()
         char control[CMSG_SPACE(MAXFD_PER_MESSAGE * sizeof(int))];
     } control_un;
 
-    iov.iov_base = buffer;
-    iov.iov_len = MAXINDIBUF;
+    iov.iov_base = dst;
+    iov.iov_len = size;
 
     msgh.msg_name = NULL;
     msgh.msg_namelen = 0;
@@ -173,7 +179,7 @@ void TcpSocketSharedBlobs::readyRead()
     msgh.msg_control = control_un.control;
     msgh.msg_controllen = sizeof(control_un.control);
 
-    int n = recvmsg(reinterpret_cast<ptrdiff_t>(socketDescriptor()), &msgh, recvflag);
+    ssize_t n = recvmsg(reinterpret_cast<ptrdiff_t>(socketDescriptor()), &msgh, recvflag);
 
     if (n >= 0)
     {
@@ -205,13 +211,7 @@ void TcpSocketSharedBlobs::readyRead()
         }
     }
 
-    if (n <= 0)
-    {
-        setSocketError(TcpSocket::ConnectionRefusedError);
-        return;
-    }
-
-    emitData(buffer, n);
+    return n;
 }
 #endif
 // BaseClientPrivate
@@ -221,47 +221,14 @@ BaseClientPrivate::BaseClientPrivate(BaseClient *parent)
 {
     clientSocket.onData([this](const char *data, size_t size)
     {
-        char msg[MAXRBUF];
-        auto documents = xmlParser.parseChunk(data, size);
-
-        if (documents.size() == 0)
-        {
-            if (xmlParser.hasErrorMessage())
-            {
-                IDLog("Bad XML from %s/%d: %s\n%.*s\n", cServer.c_str(), cPort, xmlParser.errorMessage(), int(size), data);
-            }
+        if (receive(data, size) || sConnected == false)
             return;
-        }
-
-        for (const auto &doc : documents)
-        {
-            LilXmlElement root = doc.root();
-
-            if (verbose)
-                root.print(stderr, 0);
-
-#ifdef ENABLE_INDI_SHARED_MEMORY
-            ClientSharedBlobs::Blobs blobs;
-
-            if (!clientSocket.sharedBlobs.parseAttachedBlobs(root, blobs))
-            {
-                IDLog("Missing attachment from %s/%d\n", cServer.c_str(), cPort);
-                return;
-            }
-#endif
 
-            int err_code = dispatchCommand(root, msg);
-
-            if (err_code < 0)
-            {
-                // Silently ignore property duplication errors
-                if (err_code != INDI_PROPERTY_DUPLICATED)
-                {
-                    IDLog("Dispatch command error(%d): %s\n", err_code, msg);
-                    root.print(stderr, 0);
-                }
-            }
-        }
+        IDLog("Bad compressed stream from %s/%d\n", cServer.c_str(), cPort);
+        clientSocket.disconnectFromHost();
+        this->parent->serverDisconnected(-1);
+        clear();
+        watchDevice.unwatchDevices();
     });
 
     clientSocket.onErrorOccurred([this] (TcpSocket::SocketError)
@@ -278,6 +245,92 @@ BaseClientPrivate::BaseClientPrivate(BaseClient *parent)
 BaseClientPrivate::~BaseClientPrivate()
 { }
 
+bool BaseClientPrivate::receive(const char *data, size_t size)
+{
+    if (awaitingCompression)
+    {
+        // the server starts with its acknowledgement if it compresses, anything else is plain XML
+        received.insert(received.end(), data, data + size);
+
+        INDI::StreamCompression::Codec codec;
+        int ack = INDI::StreamCompression::parseAcknowledgement(received.data(), received.size(), codec);
+        if (ack == 0)
+            return true;
+
+        awaitingCompression = false;
+        std::vector<char> start;
+        start.swap(received);
+        if (ack < 0)
+        {
+            receiveXml(start.data(), start.size());
+            return true;
+        }
+
+        decompressor.reset(new INDI::StreamCompression::Decompressor(codec));
+        if (!decompressor->isValid())
+            return false;
+        return receive(start.data() + ack, start.size() - ack);
+    }
+
+    if (!decompressor)
+    {
+        receiveXml(data, size);
+        return true;
+    }
+
+    decompressed.clear();
+    if (!decompressor->read(data, size, decompressed))
+        return false;
+    if (!decompressed.empty())
+        receiveXml(decompressed.data(), decompressed.size());
+    return true;
+}
+
+void BaseClientPrivate::receiveXml(const char *data, size_t size)
+{
+    char msg[MAXRBUF];
+    auto documents = xmlParser.parseChunk(data, size);
+
+    if (documents.size() == 0)
+    {
+        if (xmlParser.hasErrorMessage())
+        {
+            IDLog("Bad XML from %s/%d: %s\n%.*s\n", cServer.c_str(), cPort, xmlParser.errorMessage(), int(size), data);
+        }
+        return;
+    }
+
+    for (const auto &doc : documents)
+    {
+        LilXmlElement root = doc.root();
+
+        if (verbose)
+            root.print(stderr, 0);
+
+#ifdef ENABLE_INDI_SHARED_MEMORY
+        ClientSharedBlobs::Blobs blobs;
+
+        if (!clientSocket.sharedBlobs.parseAttachedBlobs(root, blobs))
+        {
+            IDLog("Missing attachment from %s/%d\n", cServer.c_str(), cPort);
+            return;
+        }
+#endif
+
+        int err_code = dispatchCommand(root, msg);
+
+        if (err_code < 0)
+        {
+            // Silently ignore property duplication errors
+            if (err_code != INDI_PROPERTY_DUPLICATED)
+            {
+                IDLog("Dispatch command error(%d): %s\n", err_code, msg);
+                root.print(stderr, 0);
+            }
+        }
+    }
+}
+
 ssize_t BaseClientPrivate::sendData(const void *data, size_t size)
 {
     return clientSocket.write(static_cast<const char *>(data), size);
@@ -331,6 +384,13 @@ bool BaseClient::connectServer()
 
     d->clear();
 
+    // a new stream starts plain
+    d->decompressor.reset();
+    d->received.clear();
+    d->awaitingCompression = d->streamCompression;
+    if (d->streamCompression)
+        d->compressOffer = INDI::StreamCompression::codecs();
+
     d->sConnected = true;
 
     serverConnected();
@@ -357,6 +417,12 @@ bool BaseClient::disconnectServer(int exit_code)
     return ret;
 }
 
+void BaseClient::setStreamCompression(bool enable)
+{
+    D_PTR(BaseClient);
+    d->streamCompression = enable;
+}
+
 void BaseClient::enableDirectBlobAccess(const char * dev, const char * prop)
 {
 #ifdef ENABLE_INDI_SHARED_MEMORY
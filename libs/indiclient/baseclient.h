@@ -81,4 +81,15 @@ class INDI::BaseClient : public INDI::AbstractBaseClient
          *  @param prop property name, can be NULL to activate for all property of dev
          */
         void enableDirectBlobAccess(const char * dev = nullptr, const char * prop = nullptr);
+
+        /** @brief setStreamCompression Ask the server to compress what it sends, from the next connection on.
+         *
+         *  The client offers zstd, or deflate when built without zstd, with its first getProperties. An indiserver
+         *  accepting it compresses everything it then sends to this client, keeping one compression context for the
+         *  whole connection, and sends BLOBs of an already compressed format as they are. Older servers ignore the
+         *  offer. Worth it on slow links; local connections, which may share BLOBs without copying, stay as they are.
+         *
+         *  @param enable If true, offer compression when connecting.
+         */
+        void setStreamCompression(bool enable);
 };
@@ -2,9 +2,12 @@
 
 #include "abstractbaseclient_p.h"
 #include "indililxml.h"
+#include "indistreamcompression.h"
 
 #include <tcpsocket.h>
 
+#include <memory>
+
 namespace INDI
 {
 
@@ -43,6 +46,10 @@ class TcpSocketSharedBlobs : public TcpSocket
         void readyRead() override;
 
         ClientSharedBlobs sharedBlobs;
+
+    private:
+        /** @brief recvmsg with the file descriptors of shared BLOBs it carries */
+        ssize_t recvWithFds(void *dst, size_t size);
 };
 #endif
 
@@ -61,12 +68,26 @@ class BaseClientPrivate : public AbstractBaseClientPrivate
     public:
         ssize_t sendData(const void *data, size_t size) override;
 
+    public:
+        /** @brief Parse and dispatch XML received from the server */
+        void receiveXml(const char *data, size_t size);
+
+        /** @brief Handle data received from the server, compressed or not. False if the stream is corrupt */
+        bool receive(const char *data, size_t size);
+
 #ifdef ENABLE_INDI_SHARED_MEMORY
         TcpSocketSharedBlobs clientSocket;
 #else
         TcpSocket clientSocket;
 #endif
         LilXmlParser xmlParser;
+
+        /// see BaseClient::setStreamCompression
+        bool streamCompression {false};
+        bool awaitingCompression {false};   /* the answer of the server to the offer is not received yet */
+        std::vector<char> received;         /* start of the stream while awaiting it */
+        std::unique_ptr<INDI::StreamCompression::Decompressor> decompressor;
+        std::vector<char> decompressed;
 };
 
 }
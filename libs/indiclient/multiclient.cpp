@@ -0,0 +1,332 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "multiclient.h"
+#include "multiclient_p.h"
+
+#include <algorithm>
+#include <map>
+#include <thread>
+
+namespace INDI
+{
+
+// MultiClientServer
+
+MultiClientServer::MultiClientServer(MultiClientPrivate *parent, int index)
+    : parent(parent), index(index)
+{ }
+
+void MultiClientServer::newDevice(INDI::BaseDevice baseDevice)
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->newDevice(baseDevice);
+    });
+}
+
+void MultiClientServer::removeDevice(INDI::BaseDevice baseDevice)
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->removeDevice(baseDevice);
+    });
+}
+
+void MultiClientServer::newProperty(INDI::Property property)
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->newProperty(property);
+    });
+}
+
+void MultiClientServer::updateProperty(INDI::Property property)
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->updateProperty(property);
+    });
+}
+
+void MultiClientServer::removeProperty(INDI::Property property)
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->removeProperty(property);
+    });
+}
+
+void MultiClientServer::newMessage(INDI::BaseDevice baseDevice, int messageID)
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->newMessage(baseDevice, messageID);
+    });
+}
+
+void MultiClientServer::serverConnected()
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->serverConnected(index);
+    });
+}
+
+void MultiClientServer::serverDisconnected(int exit_code)
+{
+    parent->forward([&](MultiClient *client)
+    {
+        client->serverDisconnected(index, exit_code);
+    });
+}
+
+// MultiClientPrivate
+
+MultiClientPrivate::MultiClientPrivate(MultiClient *parent)
+    : parent(parent)
+{ }
+
+void MultiClientPrivate::forward(const std::function<void (MultiClient *)> &notification)
+{
+    std::lock_guard<std::recursive_mutex> lock(notificationLock);
+    if (forwarding)
+        notification(parent);
+}
+
+BaseClient *MultiClientPrivate::findServer(const char *deviceName) const
+{
+    for (const auto &server : servers)
+    {
+        if (server->getDevice(deviceName).isValid())
+            return server.get();
+    }
+    return nullptr;
+}
+
+// MultiClient
+
+MultiClient::MultiClient()
+    : d_ptr(new MultiClientPrivate(this))
+{ }
+
+MultiClient::~MultiClient()
+{
+    D_PTR(MultiClient);
+    {
+        // the derived client is already gone
+        std::lock_guard<std::recursive_mutex> lock(d->notificationLock);
+        d->forwarding = false;
+    }
+    disconnectServers();
+}
+
+int MultiClient::addServer(const char *hostname, unsigned int port)
+{
+    D_PTR(MultiClient);
+    int index = int(d->servers.size());
+    d->servers.emplace_back(new MultiClientServer(d, index));
+    d->servers.back()->setServer(hostname, port);
+    return index;
+}
+
+int MultiClient::getServerCount() const
+{
+    D_PTR(const MultiClient);
+    return int(d->servers.size());
+}
+
+BaseClient *MultiClient::getServer(int server) const
+{
+    D_PTR(const MultiClient);
+    if (server < 0 || server >= int(d->servers.size()))
+        return nullptr;
+    return d->servers[server].get();
+}
+
+int MultiClient::getServerOf(const char *deviceName) const
+{
+    D_PTR(const MultiClient);
+    for (size_t i = 0; i < d->servers.size(); ++i)
+    {
+        if (d->servers[i]->getDevice(deviceName).isValid())
+            return int(i);
+    }
+    return -1;
+}
+
+void MultiClient::setConnectionTimeout(uint32_t seconds, uint32_t microseconds)
+{
+    D_PTR(MultiClient);
+    for (auto &server : d->servers)
+        server->setConnectionTimeout(seconds, microseconds);
+}
+
+bool MultiClient::connectServers()
+{
+    D_PTR(MultiClient);
+
+    // every connection waits for its own timeout, wait for all of them at once
+    std::vector<std::thread> connections;
+    for (auto &server : d->servers)
+    {
+        if (server->isServerConnected())
+            continue;
+
+        BaseClient *client = server.get();
+        connections.emplace_back([client]
+        {
+            if (!client->connectServer())
+                IDLog("INDI::MultiClient: cannot connect to %s:%d\n", client->getHost(), client->getPort());
+        });
+    }
+
+    for (auto &connection : connections)
+        connection.join();
+
+    for (auto &server : d->servers)
+    {
+        if (!server->isServerConnected())
+            return false;
+    }
+    return true;
+}
+
+void MultiClient::disconnectServers()
+{
+    D_PTR(MultiClient);
+    for (auto &server : d->servers)
+    {
+        if (server->isServerConnected())
+            server->disconnectServer();
+    }
+}
+
+bool MultiClient::isServerConnected(int server) const
+{
+    auto client = getServer(server);
+    return client != nullptr && client->isServerConnected();
+}
+
+BaseDevice MultiClient::getDevice(const char *deviceName) const
+{
+    D_PTR(const MultiClient);
+    if (auto client = d->findServer(deviceName))
+        return client->getDevice(deviceName);
+    return BaseDevice();
+}
+
+std::vector<BaseDevice> MultiClient::getDevices() const
+{
+    D_PTR(const MultiClient);
+    std::vector<BaseDevice> devices;
+    for (const auto &server : d->servers)
+    {
+        for (const auto &device : server->getDevices())
+        {
+            if (d->findServer(device.getDeviceName()) == server.get())
+                devices.push_back(device);
+        }
+    }
+    return devices;
+}
+
+void MultiClient::setBLOBMode(BLOBHandling blobH, const char *dev, const char *prop)
+{
+    D_PTR(MultiClient);
+    if (auto client = d->findServer(dev))
+        client->setBLOBMode(blobH, dev, prop);
+    else
+        IDLog("INDI::MultiClient: no server has a device %s\n", dev);
+}
+
+void MultiClient::setBLOBMode(int server, BLOBHandling blobH, const char *dev, const char *prop)
+{
+    if (auto client = getServer(server))
+        client->setBLOBMode(blobH, dev, prop);
+}
+
+void MultiClient::sendNewProperty(INDI::Property pp)
+{
+    D_PTR(MultiClient);
+    if (auto client = d->findServer(pp.getDeviceName()))
+        client->sendNewProperty(pp);
+}
+
+bool MultiClient::sendNewProperties(const std::vector<INDI::Property> &properties, std::chrono::milliseconds timeout)
+{
+    D_PTR(MultiClient);
+
+    std::map<BaseClient *, std::vector<INDI::Property>> batches;
+    for (const auto &property : properties)
+    {
+        auto client = d->findServer(property.getDeviceName());
+        if (client == nullptr)
+            return false;
+        batches[client].push_back(property);
+    }
+
+    // send everything first, the waits then overlap
+    bool result = true;
+    for (auto &batch : batches)
+        result &= batch.first->sendNewProperties(batch.second);
+
+    if (!result || timeout.count() == 0)
+        return result;
+
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    for (auto &batch : batches)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        result &= batch.first->waitForProperties(batch.second, std::max(remaining, std::chrono::milliseconds(1)));
+    }
+    return result;
+}
+
+void MultiClient::sendNewText(const char *deviceName, const char *propertyName, const char *elementName,
+                              const char *text)
+{
+    D_PTR(MultiClient);
+    if (auto client = d->findServer(deviceName))
+        client->sendNewText(deviceName, propertyName, elementName, text);
+}
+
+void MultiClient::sendNewNumber(const char *deviceName, const char *propertyName, const char *elementName,
+                                double value)
+{
+    D_PTR(MultiClient);
+    if (auto client = d->findServer(deviceName))
+        client->sendNewNumber(deviceName, propertyName, elementName, value);
+}
+
+void MultiClient::sendNewSwitch(const char *deviceName, const char *propertyName, const char *elementName)
+{
+    D_PTR(MultiClient);
+    if (auto client = d->findServer(deviceName))
+        client->sendNewSwitch(deviceName, propertyName, elementName);
+}
+
+void MultiClient::serverConnected(int)
+{
+    serverConnected();
+}
+
+void MultiClient::serverDisconnected(int, int exit_code)
+{
+    serverDisconnected(exit_code);
+}
+
+}
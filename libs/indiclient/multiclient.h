@@ -0,0 +1,134 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+#include "baseclient.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+/** @class INDI::MultiClient
+ *  @brief Client of several INDI servers at once, e.g. one indiserver per pier of an observatory.
+ *
+ *  Every server added with addServer() gets its own connection, and connectServers() opens all of them in parallel.
+ *  The devices of all servers share a single namespace: getDevice() finds a device whatever its server, and the
+ *  commands sent to a device are routed to the server owning it.
+ *
+ *  The notifications of INDI::BaseMediator arrive from the threads of all connections, but they are serialized:
+ *  the client never receives two of them at the same time and does not need its own locking.
+ *
+ *  @note Device names are expected to be unique across the servers, if several servers have a device of the same name,
+ *  the first server added owns it.
+ */
+
+namespace INDI
+{
+class MultiClientPrivate;
+class MultiClient : public INDI::BaseMediator
+{
+        DECLARE_PRIVATE(MultiClient)
+
+    public:
+        MultiClient();
+        virtual ~MultiClient();
+
+    public:
+        /** @brief Add a server to connect to.
+         *  @param hostname INDI server host name or IP address.
+         *  @param port INDI server port.
+         *  @return Index of the server, for the functions that take one.
+         */
+        int addServer(const char *hostname, unsigned int port = 7624);
+
+        /** @returns Number of servers added. */
+        int getServerCount() const;
+
+        /** @returns The client connected to the server, to use any function of BaseClient on it, e.g. watchDevice(). */
+        BaseClient *getServer(int server) const;
+
+        /** @returns Index of the server owning the device, or -1 if no server has one of this name. */
+        int getServerOf(const char *deviceName) const;
+
+        /** @brief Set the connection timeout of all servers, by default it is 3 seconds. */
+        void setConnectionTimeout(uint32_t seconds, uint32_t microseconds);
+
+    public:
+        /** @brief Connect to all servers that are not connected yet, in parallel.
+         *  @return True if every server is connected.
+         */
+        bool connectServers();
+
+        /** @brief Disconnect from all servers. */
+        void disconnectServers();
+
+        /** @returns True if the connection to the server is up. */
+        bool isServerConnected(int server) const;
+
+    public:
+        /** @returns The device of this name on any server, an invalid device if there is none. */
+        INDI::BaseDevice getDevice(const char *deviceName) const;
+
+        /** @returns The devices of all servers. */
+        std::vector<INDI::BaseDevice> getDevices() const;
+
+    public:
+        /** @brief Set the BLOB handling policy of a device, on the server owning it.
+         *  @see AbstractBaseClient::setBLOBMode
+         */
+        void setBLOBMode(BLOBHandling blobH, const char *dev, const char *prop = nullptr);
+
+        /** @brief Set the BLOB handling policy of a device on a given server, e.g. before it is defined.
+         *  @see AbstractBaseClient::setBLOBMode
+         */
+        void setBLOBMode(int server, BLOBHandling blobH, const char *dev, const char *prop = nullptr);
+
+    public:
+        /** @brief Send new Property command to the server of its device */
+        void sendNewProperty(INDI::Property pp);
+
+        /** @brief Send several properties, with one write per server.
+         *  @see AbstractBaseClient::sendNewProperties
+         */
+        bool sendNewProperties(const std::vector<INDI::Property> &properties,
+                               std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+        /** @brief Send new Text command to the server of the device */
+        void sendNewText(const char *deviceName, const char *propertyName, const char *elementName, const char *text);
+        /** @brief Send new Number command to the server of the device */
+        void sendNewNumber(const char *deviceName, const char *propertyName, const char *elementName, double value);
+        /** @brief Send new Switch command to the server of the device */
+        void sendNewSwitch(const char *deviceName, const char *propertyName, const char *elementName);
+
+    public:
+        using BaseMediator::serverConnected;
+        using BaseMediator::serverDisconnected;
+
+        /** @brief Emmited when a server is connected. The default implementation calls serverConnected(). */
+        virtual void serverConnected(int server);
+
+        /** @brief Emmited when a server gets disconnected. The default implementation calls serverDisconnected(exit_code).
+         *  @param server Index of the server.
+         *  @param exit_code 0 if the client requested the disconnection, -1 if the connection to the server was lost.
+         */
+        virtual void serverDisconnected(int server, int exit_code);
+
+    protected:
+        std::unique_ptr<MultiClientPrivate> d_ptr;
+};
+}
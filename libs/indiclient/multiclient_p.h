@@ -0,0 +1,72 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+#include "multiclient.h"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace INDI
+{
+
+class MultiClientPrivate;
+
+/** @brief Connection to one server of a MultiClient, forwarding its notifications */
+class MultiClientServer : public BaseClient
+{
+    public:
+        MultiClientServer(MultiClientPrivate *parent, int index);
+
+    public:
+        void newDevice(INDI::BaseDevice baseDevice) override;
+        void removeDevice(INDI::BaseDevice baseDevice) override;
+        void newProperty(INDI::Property property) override;
+        void updateProperty(INDI::Property property) override;
+        void removeProperty(INDI::Property property) override;
+        void newMessage(INDI::BaseDevice baseDevice, int messageID) override;
+        void serverConnected() override;
+        void serverDisconnected(int exit_code) override;
+
+    protected:
+        MultiClientPrivate *parent;
+        int index;
+};
+
+class MultiClientPrivate
+{
+    public:
+        MultiClientPrivate(MultiClient *parent);
+
+    public:
+        /** @brief Call the notification of the client, unless another one is running or the client is going away */
+        void forward(const std::function<void (MultiClient *)> &notification);
+
+        /** @returns The connection owning the device, nullptr if none */
+        BaseClient *findServer(const char *deviceName) const;
+
+    public:
+        MultiClient *parent;
+        std::vector<std::unique_ptr<MultiClientServer>> servers;
+
+        std::recursive_mutex notificationLock;
+        bool forwarding {true};
+};
+
+}
@@ -23,6 +23,9 @@
 
 #include "abstractbaseclient.h"
 #include "abstractbaseclient_p.h"
+
+#include <QMetaObject>
+
 namespace INDI
 {
 
@@ -32,55 +35,97 @@ BaseClientQtPrivate::BaseClientQtPrivate(BaseClientQt *parent)
     : AbstractBaseClientPrivate(parent)
 { }
 
+BaseClientQtPrivate::~BaseClientQtPrivate()
+{
+    workerThread.quit();
+    workerThread.wait();
+}
+
 ssize_t BaseClientQtPrivate::sendData(const void *data, size_t size)
 {
-    return clientSocket.write(static_cast<const char *>(data), size);
+    if (QThread::currentThread() == clientSocket.thread())
+        return clientSocket.write(static_cast<const char *>(data), size);
+
+    // e.g. a reply sent from a notification on the worker thread, QTcpSocket only works on its own thread
+    QByteArray copy(static_cast<const char *>(data), int(size));
+    QMetaObject::invokeMethod(&clientSocket, [this, copy]()
+    {
+        clientSocket.write(copy);
+    }, Qt::QueuedConnection);
+    return size;
 }
 
 void BaseClientQtPrivate::listenINDI()
 {
-    char msg[MAXRBUF];
-
     if (sConnected == false)
         return;
 
     while (clientSocket.bytesAvailable() > 0)
     {
+        // implicitly shared, the worker gets the very same buffer
         const QByteArray data = clientSocket.readAll();
-        
-        auto documents = xmlParser.parseChunk(data.constData(), data.size());
 
-        if (documents.size() == 0)
+        if (!useWorkerThread)
         {
-            if (xmlParser.hasErrorMessage())
-            {
-                IDLog("Bad XML from %s/%d: %s\n%.*s\n", cServer.c_str(), cPort, xmlParser.errorMessage(), data.size(), data.constData());
-            }
-            break;
+            parseData(data);
+            continue;
         }
 
-        for (const auto &doc: documents)
+        QMetaObject::invokeMethod(&worker, [this, data]()
         {
-            LilXmlElement root = doc.root();
+            parseData(data);
+        }, Qt::QueuedConnection);
+    }
+}
+
+void BaseClientQtPrivate::parseData(const QByteArray &data)
+{
+    char msg[MAXRBUF];
+
+    // chunks still queued when disconnecting are dropped
+    if (sConnected == false)
+        return;
 
-            if (verbose)
-                    root.print(stderr, 0);
+    auto documents = xmlParser.parseChunk(data.constData(), data.size());
 
-            int err_code = dispatchCommand(root, msg);
+    if (documents.size() == 0)
+    {
+        if (xmlParser.hasErrorMessage())
+        {
+            IDLog("Bad XML from %s/%d: %s\n%.*s\n", cServer.c_str(), cPort, xmlParser.errorMessage(), data.size(), data.constData());
+        }
+        return;
+    }
 
-            if (err_code < 0)
+    for (const auto &doc: documents)
+    {
+        LilXmlElement root = doc.root();
+
+        if (verbose)
+                root.print(stderr, 0);
+
+        int err_code = dispatchCommand(root, msg);
+
+        if (err_code < 0)
+        {
+            // Silently ignore property duplication errors
+            if (err_code != INDI_PROPERTY_DUPLICATED)
             {
-                // Silently ignore property duplication errors
-                if (err_code != INDI_PROPERTY_DUPLICATED)
-                {
-                    IDLog("Dispatch command error(%d): %s\n", err_code, msg);
-                    root.print(stderr, 0);
-                }
+                IDLog("Dispatch command error(%d): %s\n", err_code, msg);
+                root.print(stderr, 0);
             }
         }
     }
 }
 
+void BaseClientQtPrivate::flushWorker()
+{
+    if (!workerThread.isRunning() || QThread::currentThread() == &workerThread)
+        return;
+
+    QMetaObject::invokeMethod(&worker, []() { }, Qt::BlockingQueuedConnection);
+}
+
 // BaseClientQt
 
 BaseClientQt::BaseClientQt(QObject *parent)
@@ -107,6 +152,7 @@ BaseClientQt::BaseClientQt(QObject *parent)
         IDLog("Socket Error: %s\n", d->clientSocket.errorString().toLatin1().constData());
         fprintf(stderr, "INDI server %s/%d disconnected.\n", d->cServer.c_str(), d->cPort);
         d->clientSocket.close();
+        d->flushWorker();
         // Let client handle server disconnection
         serverDisconnected(-1);
     });
@@ -115,9 +161,30 @@ BaseClientQt::BaseClientQt(QObject *parent)
 BaseClientQt::~BaseClientQt()
 {
     D_PTR(BaseClientQt);
+    d->sConnected = false;
+    d->flushWorker();
     d->clear();
 }
 
+void BaseClientQt::enableWorkerThread(bool enable)
+{
+    D_PTR(BaseClientQt);
+
+    if (d->sConnected)
+    {
+        IDLog("INDI::BaseClientQt::enableWorkerThread: must be called before connecting.\n");
+        return;
+    }
+
+    d->useWorkerThread = enable;
+    if (enable && !d->workerThread.isRunning())
+    {
+        d->workerThread.setObjectName("INDI client parser");
+        d->worker.moveToThread(&d->workerThread);
+        d->workerThread.start();
+    }
+}
+
 bool BaseClientQt::connectServer()
 {
     D_PTR(BaseClientQt);
@@ -151,6 +218,8 @@ bool BaseClientQt::disconnectServer(int exit_code)
 
     d->clientSocket.close();
 
+    d->flushWorker();
+
     d->clear();
 
     d->watchDevice.unwatchDevices();
@@ -65,7 +65,18 @@ class INDI::BaseClientQt : public QObject, public INDI::AbstractBaseClient
          *  @return True if disconnection is successful, false otherwise.
          */
         bool disconnectServer(int exit_code = 0) override;
-    
+
+        /** @brief Parse the XML and the BLOBs received from the server on a worker thread instead of the thread of the client.
+         *
+         *  The socket is still read on the thread of the client, which only moves the received chunks to the worker without
+         *  copying them. Large BLOBs then no longer freeze a GUI while they are parsed.
+         *
+         *  @param enable True to use the worker thread, to be called before connectServer.
+         *  @note The BaseMediator notifications then run on the worker thread. A GUI must forward them to its own thread,
+         *  e.g. with queued signals or with subscribeChanges and an executor.
+         */
+        void enableWorkerThread(bool enable = true);
+
     private:
         void enableDirectBlobAccess(const char * dev = nullptr, const char * prop = nullptr) = delete; // not implemented
 };
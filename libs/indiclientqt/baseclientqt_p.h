@@ -23,7 +23,9 @@
 #include "abstractbaseclient_p.h"
 #include "indililxml.h"
 
+#include <QByteArray>
 #include <QTcpSocket>
+#include <QThread>
 
 namespace INDI
 {
@@ -32,7 +34,7 @@ class BaseClientQtPrivate : public AbstractBaseClientPrivate
 {
     public:
         BaseClientQtPrivate(BaseClientQt *parent);
-        ~BaseClientQtPrivate() = default;
+        ~BaseClientQtPrivate();
 
     public:
         ssize_t sendData(const void *data, size_t size) override;
@@ -40,9 +42,19 @@ class BaseClientQtPrivate : public AbstractBaseClientPrivate
     public:
         void listenINDI();
 
+        /** @brief Parse and dispatch a chunk read from the server, on the worker thread if enabled */
+        void parseData(const QByteArray &data);
+
+        /** @brief Wait until the worker thread parsed all chunks posted to it */
+        void flushWorker();
+
     public:
         QTcpSocket clientSocket;
         LilXmlParser xmlParser;
 
+        /// parsing and dispatching out of the thread of the socket, see BaseClientQt::enableWorkerThread
+        bool useWorkerThread {false};
+        QThread workerThread;
+        QObject worker;
 };
 }
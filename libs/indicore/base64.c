@@ -39,6 +39,13 @@
 #include "base64.h"
 #include "base64_luts.h"
 #include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#define BASE64_THREADS
+#endif
 
 /* 
  * as byteswap.h is not available on macos, add macro here
@@ -56,6 +63,309 @@
 
 #define  IS_LITTLE_ENDIAN  (!IS_BIG_ENDIAN)
 
+/*
+ * SIMD paths. They only ever handle whole blocks of plain base64 digits and
+ * leave everything else (line breaks, padding, tails, odd chars) to the
+ * scalar code, so the output is the same bit for bit.
+ * SSSE3 and AVX2 are picked at run time, NEON is always there on aarch64.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define BASE64_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef BASE64_X86
+/* 0: scalar, 1: ssse3, 2: avx2 */
+static int simd_level = -1;
+
+static int simdLevel(void)
+{
+    if (simd_level < 0)
+    {
+        __builtin_cpu_init();
+        simd_level = __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("ssse3") ? 1 : 0;
+    }
+    return simd_level;
+}
+
+/* 16 sextets to their digits */
+__attribute__((target("ssse3")))
+static inline __m128i enc_translate_ssse3(__m128i idx)
+{
+    __m128i off = _mm_set1_epi8(65);
+    off = _mm_add_epi8(off, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(25)), _mm_set1_epi8(6)));
+    off = _mm_add_epi8(off, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(51)), _mm_set1_epi8(-75)));
+    off = _mm_add_epi8(off, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(61)), _mm_set1_epi8(-15)));
+    off = _mm_add_epi8(off, _mm_and_si128(_mm_cmpgt_epi8(idx, _mm_set1_epi8(62)), _mm_set1_epi8(3)));
+    return _mm_add_epi8(idx, off);
+}
+
+/* the 12 first bytes of in to 16 sextets */
+__attribute__((target("ssse3")))
+static inline __m128i enc_split_ssse3(__m128i in)
+{
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t0, t1);
+}
+
+/* encode 12 bytes at a time while 16 can be read. return bytes consumed */
+__attribute__((target("ssse3")))
+static int enc_ssse3(unsigned char *out, const unsigned char *in, int inlen)
+{
+    int done = 0;
+    for (; inlen - done >= 16; done += 12, out += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + done));
+        _mm_storeu_si128((__m128i *)out, enc_translate_ssse3(enc_split_ssse3(v)));
+    }
+    return done;
+}
+
+__attribute__((target("avx2")))
+static int enc_avx2(unsigned char *out, const unsigned char *in, int inlen)
+{
+    int done = 0;
+    const __m256i shuf = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                         10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    for (; inlen - done >= 28; done += 24, out += 32)
+    {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + done))),
+                                            _mm_loadu_si128((const __m128i *)(in + done + 12)), 1);
+        v = _mm256_shuffle_epi8(v, shuf);
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i idx = _mm256_or_si256(t0, t1);
+
+        __m256i off = _mm256_set1_epi8(65);
+        off = _mm256_add_epi8(off, _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(25)), _mm256_set1_epi8(6)));
+        off = _mm256_add_epi8(off, _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(51)), _mm256_set1_epi8(-75)));
+        off = _mm256_add_epi8(off, _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(61)), _mm256_set1_epi8(-15)));
+        off = _mm256_add_epi8(off, _mm256_and_si256(_mm256_cmpgt_epi8(idx, _mm256_set1_epi8(62)), _mm256_set1_epi8(3)));
+        _mm256_storeu_si256((__m256i *)out, _mm256_add_epi8(idx, off));
+    }
+    return done;
+}
+
+/* 16 digits to sextets. return 0 if any is not a plain base64 digit */
+__attribute__((target("ssse3")))
+static inline int dec_translate_ssse3(__m128i c, __m128i *values)
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i plus  = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+    __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+    __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+
+    if (_mm_movemask_epi8(valid) != 0xffff)
+        return 0;
+
+    __m128i shift = _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-65)), _mm_and_si128(lower, _mm_set1_epi8(-71)));
+    shift = _mm_or_si128(shift, _mm_and_si128(digit, _mm_set1_epi8(4)));
+    shift = _mm_or_si128(shift, _mm_and_si128(plus, _mm_set1_epi8(19)));
+    shift = _mm_or_si128(shift, _mm_and_si128(slash, _mm_set1_epi8(16)));
+    *values = _mm_add_epi8(c, shift);
+    return 1;
+}
+
+/* pack 16 sextets into 12 bytes at the start of the result */
+__attribute__((target("ssse3")))
+static inline __m128i dec_pack_ssse3(__m128i values)
+{
+    __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+/* decode 4 groups at a time out of at most groups, a line break being allowed
+ * before each like the scalar loop does. return groups decoded.
+ */
+__attribute__((target("ssse3")))
+static int dec_ssse3(char *out, const char **in, int groups)
+{
+    const char *p = *in;
+    int done = 0;
+    unsigned char tmp[16];
+
+    while (groups - done >= 4)
+    {
+        int nl = (p[0] == '\n');
+        __m128i values;
+        if (!dec_translate_ssse3(_mm_loadu_si128((const __m128i *)(p + nl)), &values))
+            break;
+        _mm_storeu_si128((__m128i *)tmp, dec_pack_ssse3(values));
+        memcpy(out, tmp, 12);
+        p += nl + 16;
+        out += 12;
+        done += 4;
+    }
+    *in = p;
+    return done;
+}
+
+__attribute__((target("avx2")))
+static int dec_avx2(char *out, const char **in, int groups)
+{
+    const char *p = *in;
+    int done = 0;
+    unsigned char tmp[32];
+
+    while (groups - done >= 8)
+    {
+        int nl = (p[0] == '\n');
+        __m256i c = _mm256_loadu_si256((const __m256i *)(p + nl));
+
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('A' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), c));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), c));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+        __m256i plus  = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('+'));
+        __m256i slash = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/'));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(_mm256_or_si256(digit, plus), slash));
+        if ((unsigned int)_mm256_movemask_epi8(valid) != 0xffffffffu)
+            break;
+
+        __m256i shift = _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-65)),
+                                        _mm256_and_si256(lower, _mm256_set1_epi8(-71)));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(digit, _mm256_set1_epi8(4)));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(plus, _mm256_set1_epi8(19)));
+        shift = _mm256_or_si256(shift, _mm256_and_si256(slash, _mm256_set1_epi8(16)));
+        __m256i values = _mm256_add_epi8(c, shift);
+
+        __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        merged = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *)tmp, merged);
+        memcpy(out, tmp, 24);
+        p += nl + 32;
+        out += 24;
+        done += 8;
+    }
+    *in = p;
+    return done;
+}
+
+static int encodeSimd(unsigned char *out, const unsigned char *in, int inlen)
+{
+    switch (simdLevel())
+    {
+        case 2:
+            return enc_avx2(out, in, inlen);
+        case 1:
+            return enc_ssse3(out, in, inlen);
+    }
+    return 0;
+}
+
+static int decodeSimd(char *out, const char **in, int groups)
+{
+    switch (simdLevel())
+    {
+        case 2:
+        {
+            int done = dec_avx2(out, in, groups);
+            return done + dec_ssse3(out + done * 3, in, groups - done);
+        }
+        case 1:
+            return dec_ssse3(out, in, groups);
+    }
+    return 0;
+}
+#endif /* BASE64_X86 */
+
+#ifdef BASE64_NEON
+/* 16 sextets to their digits */
+static inline uint8x16_t enc_translate_neon(uint8x16_t idx)
+{
+    uint8x16_t off = vdupq_n_u8(65);
+    off = vaddq_u8(off, vandq_u8(vcgtq_u8(idx, vdupq_n_u8(25)), vdupq_n_u8(6)));
+    off = vaddq_u8(off, vandq_u8(vcgtq_u8(idx, vdupq_n_u8(51)), vdupq_n_u8((uint8_t)-75)));
+    off = vaddq_u8(off, vandq_u8(vcgtq_u8(idx, vdupq_n_u8(61)), vdupq_n_u8((uint8_t)-15)));
+    off = vaddq_u8(off, vandq_u8(vcgtq_u8(idx, vdupq_n_u8(62)), vdupq_n_u8(3)));
+    return vaddq_u8(idx, off);
+}
+
+/* encode 48 bytes at a time. return bytes consumed */
+static int encodeSimd(unsigned char *out, const unsigned char *in, int inlen)
+{
+    int done = 0;
+    for (; inlen - done >= 48; done += 48, out += 64)
+    {
+        uint8x16x3_t v = vld3q_u8(in + done);
+        uint8x16x4_t r;
+        r.val[0] = enc_translate_neon(vshrq_n_u8(v.val[0], 2));
+        r.val[1] = enc_translate_neon(vandq_u8(vorrq_u8(vshlq_n_u8(v.val[0], 4), vshrq_n_u8(v.val[1], 4)), vdupq_n_u8(0x3f)));
+        r.val[2] = enc_translate_neon(vandq_u8(vorrq_u8(vshlq_n_u8(v.val[1], 2), vshrq_n_u8(v.val[2], 6)), vdupq_n_u8(0x3f)));
+        r.val[3] = enc_translate_neon(vandq_u8(v.val[2], vdupq_n_u8(0x3f)));
+        vst4q_u8(out, r);
+    }
+    return done;
+}
+
+/* 16 digits to sextets, accumulating in *invalid any that is not a plain digit */
+static inline uint8x16_t dec_translate_neon(uint8x16_t c, uint8x16_t *invalid)
+{
+    uint8x16_t upper = vandq_u8(vcgeq_u8(c, vdupq_n_u8('A')), vcleq_u8(c, vdupq_n_u8('Z')));
+    uint8x16_t lower = vandq_u8(vcgeq_u8(c, vdupq_n_u8('a')), vcleq_u8(c, vdupq_n_u8('z')));
+    uint8x16_t digit = vandq_u8(vcgeq_u8(c, vdupq_n_u8('0')), vcleq_u8(c, vdupq_n_u8('9')));
+    uint8x16_t plus  = vceqq_u8(c, vdupq_n_u8('+'));
+    uint8x16_t slash = vceqq_u8(c, vdupq_n_u8('/'));
+    uint8x16_t valid = vorrq_u8(vorrq_u8(upper, lower), vorrq_u8(vorrq_u8(digit, plus), slash));
+
+    *invalid = vorrq_u8(*invalid, vmvnq_u8(valid));
+
+    uint8x16_t shift = vorrq_u8(vandq_u8(upper, vdupq_n_u8((uint8_t)-65)), vandq_u8(lower, vdupq_n_u8((uint8_t)-71)));
+    shift = vorrq_u8(shift, vandq_u8(digit, vdupq_n_u8(4)));
+    shift = vorrq_u8(shift, vandq_u8(plus, vdupq_n_u8(19)));
+    shift = vorrq_u8(shift, vandq_u8(slash, vdupq_n_u8(16)));
+    return vaddq_u8(c, shift);
+}
+
+/* decode 16 groups at a time out of at most groups, a line break being allowed
+ * before each like the scalar loop does. return groups decoded.
+ */
+static int decodeSimd(char *out, const char **in, int groups)
+{
+    const char *p = *in;
+    int done = 0;
+
+    while (groups - done >= 16)
+    {
+        int nl = (p[0] == '\n');
+        uint8x16x4_t v = vld4q_u8((const uint8_t *)(p + nl));
+        uint8x16_t invalid = vdupq_n_u8(0);
+        uint8x16_t a = dec_translate_neon(v.val[0], &invalid);
+        uint8x16_t b = dec_translate_neon(v.val[1], &invalid);
+        uint8x16_t c = dec_translate_neon(v.val[2], &invalid);
+        uint8x16_t d = dec_translate_neon(v.val[3], &invalid);
+        if (vmaxvq_u8(invalid))
+            break;
+
+        uint8x16x3_t r;
+        r.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        r.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        r.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+        vst3q_u8((uint8_t *)out, r);
+        p += nl + 64;
+        out += 48;
+        done += 16;
+    }
+    *in = p;
+    return done;
+}
+#endif /* BASE64_NEON */
+
 /* convert inlen raw bytes at in to base64 string (NUL-terminated) at out. 
  * out size should be at least 4*inlen/3 + 4.
  * return length of out (sans trailing NUL).
@@ -74,12 +384,23 @@ int to64frombits_s(unsigned char *out, const unsigned char *in, int inlen, size_
 #pragma GCC diagnostic pop
 }
 
-int to64frombits(unsigned char *out, const unsigned char *in, int inlen)
+/* encode the whole 3 byte groups of in, without tail nor trailing NUL.
+ * return the position in out right after the last digit written.
+ */
+static unsigned char *encodeGroups(unsigned char *out, const unsigned char *in, int inlen)
 {
     uint16_t *b64lut = (uint16_t *)base64lut;
-    int dlen         = ((inlen + 2) / 3) * 4; /* 4/3, rounded up */
     uint16_t *wbuf   = (uint16_t *)out;
 
+#if defined(BASE64_X86) || defined(BASE64_NEON)
+    {
+        int done = encodeSimd(out, in, inlen);
+        wbuf += done / 3 * 2;
+        in += done;
+        inlen -= done;
+    }
+#endif
+
     for (; inlen > 2; inlen -= 3)
     {
         uint32_t n = in[0] << 16 | in[1] << 8 | in[2];
@@ -91,7 +412,17 @@ int to64frombits(unsigned char *out, const unsigned char *in, int inlen)
         in += 3;
     }
 
-    out = (unsigned char *)wbuf;
+    return (unsigned char *)wbuf;
+}
+
+int to64frombits(unsigned char *out, const unsigned char *in, int inlen)
+{
+    int dlen = ((inlen + 2) / 3) * 4; /* 4/3, rounded up */
+
+    out = encodeGroups(out, in, inlen);
+    in += inlen / 3 * 3;
+    inlen %= 3;
+
     if (inlen > 0)
     {
         unsigned char fragment;
@@ -119,18 +450,30 @@ int from64tobits(char *out, const char *in)
     return from64tobits_fast(out, in, cp - in);
 }
 
-int from64tobits_fast(char *out, const char *in, int inlen)
+/* decode the next groups quads of digits at *pin, each optionally preceded by a '\n'.
+ * *pin is moved past the last quad decoded.
+ * return the position in out right after the last byte written.
+ */
+static char *decodeGroups(char *out, const char **pin, int groups)
 {
-    int outlen = 0;
     uint8_t b1, b2, b3;
     uint16_t s1, s2;
     uint32_t n32;
     int j;
-    int n         = (inlen / 4) - 1;
-    uint16_t *inp = (uint16_t *)in;
+    const char *in = *pin;
+    uint16_t *inp;
 
-    for (j = 0; j < n; j++)
+    for (j = 0; j < groups; j++)
     {
+#if defined(BASE64_X86) || defined(BASE64_NEON)
+        {
+            int done = decodeSimd(out, &in, groups - j);
+            out += done * 3;
+            j += done;
+            if (j == groups)
+                break;
+        }
+#endif
         if (in[0] == '\n')
             in++;
         inp = (uint16_t *)in;
@@ -159,6 +502,19 @@ int from64tobits_fast(char *out, const char *in, int inlen)
         in += 4;
         out += 3;
     }
+    *pin = in;
+    return out;
+}
+
+int from64tobits_fast(char *out, const char *in, int inlen)
+{
+    int outlen = 0;
+    uint8_t b1, b2, b3;
+    uint16_t s1, s2;
+    uint32_t n32;
+    uint16_t *inp;
+
+    out = decodeGroups(out, &in, (inlen / 4) - 1);
     outlen = (inlen / 4 - 1) * 3;
     if (in[0] == '\n')
         in++;
@@ -266,6 +622,181 @@ int from64tobits_fast_with_bug(char *out, const char *in, int inlen)
 }
 
 
+/*
+ * Multi-threaded variants. Base64 splits cleanly on 3 bytes / 4 digits
+ * boundaries, so big buffers are cut into one slice per thread and every
+ * slice is converted in place with the single threaded code.
+ */
+#define B64_MT_SLICE   (1 << 20) /* smallest input worth a thread */
+#define B64_MT_THREADS 8
+
+#ifdef BASE64_THREADS
+typedef struct
+{
+    pthread_t thread;
+    const char *in;
+    int inlen;
+    char *out;
+    size_t outlen;
+    int groups;
+    int count;
+} B64Slice;
+
+static int b64Threads(int inlen)
+{
+    long cpus  = sysconf(_SC_NPROCESSORS_ONLN);
+    int count = inlen / B64_MT_SLICE;
+
+    if (count > B64_MT_THREADS)
+        count = B64_MT_THREADS;
+    if (cpus > 0 && count > cpus)
+        count = (int)cpus;
+    return count;
+}
+
+/* Run fn on every slice but the last one on its own thread, the last one
+ * on the calling thread. Falls back to the calling thread if a thread
+ * can not be started.
+ */
+static void b64Run(B64Slice *slices, int count, void *(*fn)(void *))
+{
+    int started[B64_MT_THREADS] = { 0 };
+
+    for (int i = 0; i < count - 1; i++)
+        started[i] = pthread_create(&slices[i].thread, NULL, fn, &slices[i]) == 0;
+
+    fn(&slices[count - 1]);
+
+    for (int i = 0; i < count - 1; i++)
+    {
+        if (started[i])
+            pthread_join(slices[i].thread, NULL);
+        else
+            fn(&slices[i]);
+    }
+}
+
+/* the last slice (groups < 0) takes the tail and the trailing NUL */
+static void *encodeSlice(void *arg)
+{
+    B64Slice *slice = (B64Slice *)arg;
+
+    if (slice->groups < 0)
+        slice->count = to64frombits_s((unsigned char *)slice->out, (const unsigned char *)slice->in, slice->inlen,
+                                      slice->outlen);
+    else
+        encodeGroups((unsigned char *)slice->out, (const unsigned char *)slice->in, slice->inlen);
+    return NULL;
+}
+
+static void *countLines(void *arg)
+{
+    B64Slice *slice = (B64Slice *)arg;
+    const char *p   = slice->in;
+    const char *end = slice->in + slice->inlen;
+
+    slice->count = 0;
+    while ((p = (const char *)memchr(p, '\n', end - p)) != NULL)
+    {
+        slice->count++;
+        p++;
+    }
+    return NULL;
+}
+
+/* the last slice (groups < 0) takes the padding */
+static void *decodeSlice(void *arg)
+{
+    B64Slice *slice = (B64Slice *)arg;
+    const char *in  = slice->in;
+
+    if (slice->groups < 0)
+        slice->count = from64tobits_fast(slice->out, in, slice->inlen);
+    else
+        decodeGroups(slice->out, &in, slice->groups);
+    return NULL;
+}
+#endif
+
+int to64frombits_mt(unsigned char *out, const unsigned char *in, int inlen, size_t outlen)
+{
+#ifdef BASE64_THREADS
+    B64Slice slices[B64_MT_THREADS];
+    int count = b64Threads(inlen);
+    int slice = inlen / 3 / (count > 0 ? count : 1) * 3;
+
+    if (count < 2 || (((size_t)inlen + 2) / 3) * 4 > outlen)
+        return to64frombits_s(out, in, inlen, outlen);
+
+    for (int i = 0; i < count; i++)
+    {
+        slices[i].in     = (const char *)in + i * slice;
+        slices[i].inlen  = slice;
+        slices[i].out    = (char *)out + i * slice / 3 * 4;
+        slices[i].groups = slice / 3;
+    }
+    slices[count - 1].inlen  = inlen - (count - 1) * slice;
+    slices[count - 1].outlen = outlen - (count - 1) * slice / 3 * 4;
+    slices[count - 1].groups = -1;
+    b64Run(slices, count, encodeSlice);
+
+    return (count - 1) * slice / 3 * 4 + slices[count - 1].count;
+#else
+    return to64frombits_s(out, in, inlen, outlen);
+#endif
+}
+
+int from64tobits_mt(char *out, const char *in, int inlen)
+{
+#ifdef BASE64_THREADS
+    B64Slice slices[B64_MT_THREADS];
+    int count = b64Threads(inlen);
+    int slice = inlen / (count > 0 ? count : 1);
+    int lines = 0;
+
+    if (count < 2)
+        return from64tobits_fast(out, in, inlen);
+
+    /* line breaks shift the digits, count them first to know where the quads start */
+    for (int i = 0; i < count - 1; i++)
+    {
+        slices[i].in    = in + i * slice;
+        slices[i].inlen = slice;
+    }
+    b64Run(slices, count - 1, countLines);
+
+    /* then move every cut forward to the start of a quad */
+    for (int i = 0; i < count; i++)
+    {
+        int cut = i * slice;
+        int nl, digits;
+
+        if (i > 0)
+            lines += slices[i - 1].count;
+        nl     = lines;
+        digits = cut - nl;
+        while (cut < inlen && (digits % 4 != 0 || in[cut] == '\n'))
+        {
+            if (in[cut++] == '\n')
+                nl++;
+            else
+                digits++;
+        }
+        slices[i].in  = in + cut;
+        slices[i].out = out + digits / 4 * 3;
+    }
+    for (int i = 0; i < count - 1; i++)
+        slices[i].groups = (int)(slices[i + 1].out - slices[i].out) / 3;
+    slices[count - 1].inlen  = inlen - (int)(slices[count - 1].in - in);
+    slices[count - 1].groups = -1;
+    b64Run(slices, count, decodeSlice);
+
+    return (int)(slices[count - 1].out - out) + slices[count - 1].count;
+#else
+    return from64tobits_fast(out, in, inlen);
+#endif
+}
+
 #ifdef BASE64_PROGRAM
 /* standalone program that converts to/from base64.
  * cc -o base64 -DBASE64_PROGRAM base64.c
@@ -59,6 +59,17 @@ extern int from64tobits(char *out, const char *in);
 extern int from64tobits_fast(char *out, const char *in, int inlen);
 extern int from64tobits_fast_with_bug(char *out, const char *in, int inlen);
 
+/** \brief Same as to64frombits_s, split across several threads for large buffers.
+    Below 2 MB of input, or on platforms without threads, this is to64frombits_s.
+ */
+extern int to64frombits_mt(unsigned char *out, const unsigned char *in, int inlen, size_t outlen);
+
+/** \brief Same as from64tobits_fast, split across several threads for large buffers.
+    The input may hold a line break before any group of 4 digits.
+    Below 2 MB of input, or on platforms without threads, this is from64tobits_fast.
+ */
+extern int from64tobits_mt(char *out, const char *in, int inlen);
+
 /*@}*/
 
 #ifdef __cplusplus
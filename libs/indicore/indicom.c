@@ -91,6 +91,7 @@
 
 #include "userio.h"
 #include "indiuserio.h"
+#include "inditrace.h"
 
 #if defined(_MSC_VER)
 #define snprintf _snprintf
@@ -107,6 +108,122 @@ static int tty_generic_udp_format = 0;
 static int tty_sequence_number = 1;
 static int tty_clear_trailing_lf = 0;
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <sys/stat.h>
+
+/* On the fds enabled with tty_set_readahead, sections are read ahead in chunks of what the fd has pending
+ * rather than one read() per byte. Bytes read past a section are kept for the next read of that fd, until
+ * something is written to it or tty_flush drops them. */
+#define TTY_READAHEAD_SIZE  512
+#define TTY_READAHEAD_SLOTS 16
+
+typedef struct
+{
+    int used;                         /* slot belongs to fd */
+    int fd;
+    int head, tail;                   /* bytes not returned yet are data[head, tail) */
+    dev_t dev;                        /* file fd referred to when enabled, to tell a reused fd */
+    ino_t ino;
+    uint8_t data[TTY_READAHEAD_SIZE];
+} TtyReadAhead;
+
+static TtyReadAhead tty_readahead[TTY_READAHEAD_SLOTS];
+static pthread_mutex_t tty_readahead_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* return the read ahead slot of fd, a new one if create and none is free, NULL otherwise */
+static TtyReadAhead *tty_readahead_find(int fd, int create)
+{
+    TtyReadAhead *ra = NULL, *unused = NULL;
+
+    pthread_mutex_lock(&tty_readahead_lock);
+    for (int i = 0; i < TTY_READAHEAD_SLOTS && !ra; i++)
+    {
+        if (tty_readahead[i].used && tty_readahead[i].fd == fd)
+            ra = &tty_readahead[i];
+        else if (!tty_readahead[i].used && !unused)
+            unused = &tty_readahead[i];
+    }
+    if (!ra && create && unused)
+    {
+        ra = unused;
+        ra->used = 1;
+        ra->fd = fd;
+        ra->head = ra->tail = 0;
+    }
+    pthread_mutex_unlock(&tty_readahead_lock);
+
+    return ra;
+}
+
+/* forget what was read ahead on fd, and its slot too if release */
+static void tty_readahead_drop(int fd, int release)
+{
+    pthread_mutex_lock(&tty_readahead_lock);
+    for (int i = 0; i < TTY_READAHEAD_SLOTS; i++)
+    {
+        if (tty_readahead[i].used && tty_readahead[i].fd == fd)
+        {
+            tty_readahead[i].head = tty_readahead[i].tail = 0;
+            tty_readahead[i].used = !release;
+        }
+    }
+    pthread_mutex_unlock(&tty_readahead_lock);
+}
+
+/* slot of fd for a new read, NULL if not enabled. A slot left by an fd closed without tty_disconnect
+ * is released once its number refers to another file */
+static TtyReadAhead *tty_readahead_get(int fd)
+{
+    TtyReadAhead *ra = tty_readahead_find(fd, 0);
+    struct stat st;
+
+    if (ra && (fstat(fd, &st) != 0 || st.st_dev != ra->dev || st.st_ino != ra->ino))
+    {
+        tty_readahead_drop(fd, 1);
+        return NULL;
+    }
+
+    return ra;
+}
+
+/* next byte of fd, read ahead in ra if any, waiting up to the timeout when none is pending */
+static int tty_read_byte(int fd, TtyReadAhead *ra, long timeout_seconds, long timeout_microseconds, uint8_t *c)
+{
+    int err, avail = 0, bytesRead;
+
+    if (ra && ra->head < ra->tail)
+    {
+        *c = ra->data[ra->head++];
+        return TTY_OK;
+    }
+
+    if ((err = tty_timeout_microseconds(fd, timeout_seconds, timeout_microseconds)))
+        return err;
+
+    if (!ra)
+    {
+        bytesRead = read(fd, c, 1);
+        return bytesRead <= 0 ? TTY_READ_ERROR : TTY_OK;
+    }
+
+    /* no more than what is pending, so that little is left over when a single response is waiting */
+    if (ioctl(fd, FIONREAD, &avail) != 0 || avail < 1)
+        avail = 1;
+    else if (avail > TTY_READAHEAD_SIZE)
+        avail = TTY_READAHEAD_SIZE;
+
+    bytesRead = read(fd, ra->data, avail);
+    if (bytesRead <= 0)
+        return TTY_READ_ERROR;
+
+    ra->head = 1;
+    ra->tail = bytesRead;
+    *c = ra->data[0];
+    return TTY_OK;
+}
+#endif
+
 #if defined(HAVE_LIBNOVA)
 int extractISOTime(const char *timestr, struct ln_date *iso_date)
 {
@@ -377,6 +494,55 @@ void tty_clr_trailing_read_lf(int enabled)
     tty_clear_trailing_lf = enabled;
 }
 
+int tty_set_readahead(int fd, int enabled)
+{
+#ifdef _WIN32
+    INDI_UNUSED(fd);
+    INDI_UNUSED(enabled);
+    return TTY_ERRNO;
+#else
+    TtyReadAhead *ra;
+    struct stat st;
+
+    if (fd == -1)
+        return TTY_ERRNO;
+
+    if (!enabled)
+    {
+        tty_readahead_drop(fd, 1);
+        return TTY_OK;
+    }
+
+    if (fstat(fd, &st) != 0)
+        return TTY_ERRNO;
+
+    /* a slot left by a previous file of this fd number starts over */
+    tty_readahead_drop(fd, 1);
+    ra = tty_readahead_find(fd, 1);
+    if (ra == NULL)
+        return TTY_ERRNO;
+    ra->dev = st.st_dev;
+    ra->ino = st.st_ino;
+    return TTY_OK;
+#endif
+}
+
+int tty_flush(int fd)
+{
+#ifdef _WIN32
+    INDI_UNUSED(fd);
+    return TTY_ERRNO;
+#else
+    if (fd == -1)
+        return TTY_ERRNO;
+
+    tty_readahead_drop(fd, 0);
+    if (isatty(fd) && tcflush(fd, TCIOFLUSH) != 0)
+        return TTY_ERRNO;
+    return TTY_OK;
+#endif
+}
+
 int tty_timeout(int fd, int timeout)
 {
     return tty_timeout_microseconds(fd, timeout, 0);
@@ -421,7 +587,7 @@ int tty_timeout_microseconds(int fd, long timeout_seconds, long timeout_microsec
     #endif
 }
 
-int tty_write(int fd, const char *buf, int nbytes, int *nbytes_written)
+static int tty_write_untraced(int fd, const char *buf, int nbytes, int *nbytes_written)
 {
 #ifdef _WIN32
     return TTY_ERRNO;
@@ -445,6 +611,9 @@ int tty_write(int fd, const char *buf, int nbytes, int *nbytes_written)
     int bytes_w     = 0;
     *nbytes_written = 0;
 
+    // Input left over from before the command is not an answer to it
+    tty_readahead_drop(fd, 0);
+
     if (tty_debug)
     {
         int i = 0;
@@ -471,6 +640,14 @@ int tty_write(int fd, const char *buf, int nbytes, int *nbytes_written)
 #endif
 }
 
+int tty_write(int fd, const char *buf, int nbytes, int *nbytes_written)
+{
+    INDI_TRACE_BEGIN("tty_write");
+    int rc = tty_write_untraced(fd, buf, nbytes, nbytes_written);
+    INDI_TRACE_END("tty_write");
+    return rc;
+}
+
 int tty_write_string(int fd, const char *buf, int *nbytes_written)
 {
     int nbytes;
@@ -484,7 +661,8 @@ int tty_read(int fd, char *buf, int nbytes, int timeout, int *nbytes_read)
     return tty_read_expanded(fd, buf, nbytes, timeout, 0, nbytes_read);
 }
 
-int tty_read_expanded(int fd, char *buf, int nbytes, long timeout_seconds, long timeout_microseconds, int *nbytes_read)
+static int tty_read_expanded_untraced(int fd, char *buf, int nbytes, long timeout_seconds, long timeout_microseconds,
+                                      int *nbytes_read)
 {
 #ifdef _WIN32
     return TTY_ERRNO;
@@ -512,6 +690,24 @@ int tty_read_expanded(int fd, char *buf, int nbytes, long timeout_seconds, long
         numBytesToRead = nbytes + 8;
         buffer = geminiBuffer;
     }
+    else
+    {
+        // Bytes a section read left over come first
+        TtyReadAhead *ra = tty_readahead_get(fd);
+
+        if (ra && ra->head < ra->tail && tty_clear_trailing_lf && ra->data[ra->head] == 0x0A)
+        {
+            if (tty_debug)
+                IDLog("%s: Cleared LF char left in buf\n", __FUNCTION__);
+            ra->head++;
+        }
+
+        while (ra && ra->head < ra->tail && numBytesToRead > 0)
+        {
+            buffer[(*nbytes_read)++] = ra->data[ra->head++];
+            numBytesToRead--;
+        }
+    }
 
     while (numBytesToRead > 0)
     {
@@ -551,7 +747,7 @@ int tty_read_expanded(int fd, char *buf, int nbytes, long timeout_seconds, long
         if (intSizedBuffer[0] != tty_sequence_number)
         {
             // Not the right reply just do the read again.
-            return tty_read_expanded(fd, buf, nbytes, timeout_seconds, timeout_microseconds, nbytes_read);
+            return tty_read_expanded_untraced(fd, buf, nbytes, timeout_seconds, timeout_microseconds, nbytes_read);
         }
 
         *nbytes_read -= 8;
@@ -563,12 +759,21 @@ int tty_read_expanded(int fd, char *buf, int nbytes, long timeout_seconds, long
 #endif
 }
 
+int tty_read_expanded(int fd, char *buf, int nbytes, long timeout_seconds, long timeout_microseconds, int *nbytes_read)
+{
+    INDI_TRACE_BEGIN("tty_read");
+    int rc = tty_read_expanded_untraced(fd, buf, nbytes, timeout_seconds, timeout_microseconds, nbytes_read);
+    INDI_TRACE_END("tty_read");
+    return rc;
+}
+
 int tty_read_section(int fd, char *buf, char stop_char, int timeout, int *nbytes_read)
 {
     return tty_read_section_expanded(fd, buf, stop_char, (long) timeout, (long) 0, nbytes_read);
 }
 
-int tty_read_section_expanded(int fd, char *buf, char stop_char, long timeout_seconds, long timeout_microseconds, int *nbytes_read)
+static int tty_read_section_expanded_untraced(int fd, char *buf, char stop_char, long timeout_seconds,
+        long timeout_microseconds, int *nbytes_read)
 {
 #ifdef _WIN32
     return TTY_ERRNO;
@@ -599,7 +804,7 @@ int tty_read_section_expanded(int fd, char *buf, char stop_char, long timeout_se
         if (intSizedBuffer[0] != tty_sequence_number)
         {
             // Not the right reply just do the read again.
-            return tty_read_section_expanded(fd, buf, stop_char, timeout_seconds, timeout_microseconds, nbytes_read);
+            return tty_read_section_expanded_untraced(fd, buf, stop_char, timeout_seconds, timeout_microseconds, nbytes_read);
         }
 
         for (int index = 8; index < bytesRead; index++)
@@ -631,16 +836,13 @@ int tty_read_section_expanded(int fd, char *buf, char stop_char, long timeout_se
     }
     else
     {
+        TtyReadAhead *ra = tty_readahead_get(fd);
+
         for (;;)
         {
-            if ((err = tty_timeout_microseconds(fd, timeout_seconds, timeout_microseconds)))
-                return err;
-
             read_char = (uint8_t*)(buf + *nbytes_read);
-            bytesRead = read(fd, read_char, 1);
-
-            if (bytesRead < 0)
-                return TTY_READ_ERROR;
+            if ((err = tty_read_byte(fd, ra, timeout_seconds, timeout_microseconds, read_char)))
+                return err;
 
             if (tty_debug)
                 IDLog("%s: buffer[%d]=%#X (%c)\n", __FUNCTION__, (*nbytes_read), *read_char, *read_char);
@@ -652,9 +854,8 @@ int tty_read_section_expanded(int fd, char *buf, char stop_char, long timeout_se
                     IDLog("%s: Cleared LF char left in buf\n", __FUNCTION__);
             }
 
-            if (*read_char == stop_char) {
+            if (*read_char == stop_char)
                 return TTY_OK;
-            }
         }
     }
 
@@ -663,7 +864,15 @@ int tty_read_section_expanded(int fd, char *buf, char stop_char, long timeout_se
 #endif
 }
 
-int tty_nread_section(int fd, char *buf, int nsize, char stop_char, int timeout, int *nbytes_read)
+int tty_read_section_expanded(int fd, char *buf, char stop_char, long timeout_seconds, long timeout_microseconds, int *nbytes_read)
+{
+    INDI_TRACE_BEGIN("tty_read_section");
+    int rc = tty_read_section_expanded_untraced(fd, buf, stop_char, timeout_seconds, timeout_microseconds, nbytes_read);
+    INDI_TRACE_END("tty_read_section");
+    return rc;
+}
+
+static int tty_nread_section_untraced(int fd, char *buf, int nsize, char stop_char, int timeout, int *nbytes_read)
 {
 #ifdef _WIN32
     return TTY_ERRNO;
@@ -676,7 +885,6 @@ int tty_nread_section(int fd, char *buf, int nsize, char stop_char, int timeout,
     if (tty_gemini_udp_format || tty_generic_udp_format)
         return tty_read_section(fd, buf, stop_char, timeout, nbytes_read);
 
-    int bytesRead = 0;
     int err       = TTY_OK;
     *nbytes_read  = 0;
     uint8_t *read_char = 0;
@@ -685,16 +893,13 @@ int tty_nread_section(int fd, char *buf, int nsize, char stop_char, int timeout,
     if (tty_debug)
         IDLog("%s: Request to read until stop char '%#02X' with %d timeout for fd %d\n", __FUNCTION__, stop_char, timeout, fd);
 
+    TtyReadAhead *ra = tty_readahead_get(fd);
+
     for (;;)
     {
-        if ((err = tty_timeout(fd, timeout)))
-            return err;
-
         read_char = (uint8_t*)(buf + *nbytes_read);
-        bytesRead = read(fd, read_char, 1);
-
-        if (bytesRead < 0)
-            return TTY_READ_ERROR;
+        if ((err = tty_read_byte(fd, ra, timeout, 0, read_char)))
+            return err;
 
         if (tty_debug)
             IDLog("%s: buffer[%d]=%#X (%c)\n", __FUNCTION__, (*nbytes_read), *read_char, *read_char);
@@ -706,15 +911,21 @@ int tty_nread_section(int fd, char *buf, int nsize, char stop_char, int timeout,
                 IDLog("%s: Cleared LF char left in buf\n", __FUNCTION__);
         }
 
-        if (*read_char == stop_char)
-            return TTY_OK;
-        else if (*nbytes_read >= nsize)
-            return TTY_OVERFLOW;
+        if (*read_char == stop_char || *nbytes_read >= nsize)
+            return *read_char == stop_char ? TTY_OK : TTY_OVERFLOW;
     }
 
 #endif
 }
 
+int tty_nread_section(int fd, char *buf, int nsize, char stop_char, int timeout, int *nbytes_read)
+{
+    INDI_TRACE_BEGIN("tty_read_section");
+    int rc = tty_nread_section_untraced(fd, buf, nsize, stop_char, timeout, nbytes_read);
+    INDI_TRACE_END("tty_read_section");
+    return rc;
+}
+
 #if defined(BSD) && !defined(__GNU__)
 // BSD - OSX version
 int tty_connect(const char *device, int bit_rate, int word_size, int parity, int stop_bits, int *fd)
@@ -929,6 +1140,7 @@ int tty_connect(const char *device, int bit_rate, int word_size, int parity, int
 #endif
 
     *fd = t_fd;
+    tty_readahead_drop(t_fd, 1);
     /* return success */
     return TTY_OK;
 
@@ -1137,6 +1349,7 @@ int tty_connect(const char *device, int bit_rate, int word_size, int parity, int
     }
 
     *fd = t_fd;
+    tty_readahead_drop(t_fd, 1);
     /* return success */
     return TTY_OK;
 #endif
@@ -1155,6 +1368,7 @@ int tty_disconnect(int fd)
 #else
     int err;
     tcflush(fd, TCIOFLUSH);
+    tty_readahead_drop(fd, 1);
     err = close(fd);
 
     if (err != 0)
@@ -201,6 +201,8 @@ int tty_read_expanded(int fd, char *buf, int nbytes, long timeout_seconds, long
  *  \param timeout number of seconds to wait for terminal before a timeout error is issued.
  *  \param nbytes_read the number of bytes read.
  *  \return On success, it returns TTY_OK, otherwise, a TTY_ERROR code.
+ *  \note When read-ahead is enabled on \e fd with tty_set_readahead, input is read in chunks and bytes
+ *  received after \e stop_char are returned by the next tty_read* call on \e fd.
  */
 int tty_read_section(int fd, char *buf, char stop_char, int timeout, int *nbytes_read);
 
@@ -282,6 +284,23 @@ void tty_set_gemini_udp_format(int enabled);
 void tty_set_generic_udp_format(int enabled);
 void tty_clr_trailing_read_lf(int enabled);
 
+/** \brief Enable or disable reading tty_read_section and tty_nread_section input in chunks on a file descriptor.
+ *  Read-ahead is off by default. Bytes read past a section are kept in user space until the next tty_read*
+ *  call on \e fd, tty_write, tty_flush or tty_disconnect, so they are invisible to tcflush, select, IEAddCallback
+ *  and read(). Drivers enabling it must call tty_flush instead of tcflush, and must not mix raw reads or
+ *  readiness callbacks on \e fd.
+ *  \param fd file descriptor, as returned by tty_connect.
+ *  \param enabled 1 to enable, 0 to disable and drop the bytes read ahead.
+ *  \return On success, it returns TTY_OK, otherwise, a TTY_ERROR code, e.g. when too many fds have it enabled.
+ */
+int tty_set_readahead(int fd, int enabled);
+
+/** \brief Drop the bytes read ahead on a file descriptor, and flush its pending input and output if it is a terminal.
+ *  \param fd file descriptor
+ *  \return On success, it returns TTY_OK, otherwise, a TTY_ERROR code.
+ */
+int tty_flush(int fd);
+
 int tty_timeout(int fd, int timeout);
 
 int tty_timeout_microseconds(int fd, long timeout_seconds, long timeout_microseconds);
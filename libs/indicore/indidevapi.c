@@ -8,12 +8,16 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
 #include <sys/stat.h>
 
 #ifdef _WIN32
 #include <direct.h>
 #include <Windows.h>
+#else
+#include <pthread.h>
+#define MEMBER_INDEX
 #endif
 
 #define MAXRBUF 2048
@@ -259,12 +263,160 @@ int IULoadConfigSwitch(const ISwitchVectorProperty *svp)
 
 /** \section IUFind */
 
+/* Vectors narrower than this are scanned, a hash does not pay off */
+#define MEMBER_INDEX_MIN 8
+
+#ifdef MEMBER_INDEX
+/* Name index of one member array. Every member type starts with its name,
+ * so members are addressed as bytes with their size as the stride. */
+typedef struct
+{
+    const char *members;
+    size_t size;
+    int slots;  /* power of 2, at most half full */
+    int *index; /* member index + 1, 0 is an empty slot */
+} MemberIndex;
+
+/* Indexed arrays, open addressing on the array address */
+static MemberIndex *memberIndexes = NULL;
+static int memberIndexSlots = 0;
+static int nMemberIndexes = 0;
+static pthread_rwlock_t member_index_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+static uint32_t member_name_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    return h;
+}
+
+static uint32_t member_array_hash(const void *members)
+{
+    uintptr_t p = (uintptr_t)members;
+    return (uint32_t)((p >> 4) ^ (p >> 20)) * 2654435761u;
+}
+
+/* slot of members in memberIndexes, or of the empty slot it would go in */
+static MemberIndex *member_index_slot(MemberIndex *table, int slots, const void *members)
+{
+    uint32_t s = member_array_hash(members) & (slots - 1);
+    while (table[s].members && table[s].members != members)
+        s = (s + 1) & (slots - 1);
+    return &table[s];
+}
+#endif
+
+void IUIndexMembers(const void *members, int count, size_t size)
+{
+#ifdef MEMBER_INDEX
+    if (members == NULL || count < MEMBER_INDEX_MIN)
+        return;
+
+    int slots = 16;
+    while (slots < 2 * count)
+        slots <<= 1;
+
+    int *index = (int *)calloc(slots, sizeof(int));
+    if (index == NULL)
+        return;
+
+    /* first of equal names wins, as with a scan */
+    for (int i = 0; i < count; i++)
+    {
+        const char *name = (const char *)members + i * size;
+        uint32_t s = member_name_hash(name) & (slots - 1);
+        while (index[s])
+            s = (s + 1) & (slots - 1);
+        index[s] = i + 1;
+    }
+
+    pthread_rwlock_wrlock(&member_index_lock);
+
+    if (2 * (nMemberIndexes + 1) > memberIndexSlots)
+    {
+        int newSlots = memberIndexSlots ? 2 * memberIndexSlots : 64;
+        MemberIndex *table = (MemberIndex *)calloc(newSlots, sizeof(MemberIndex));
+        if (table == NULL)
+        {
+            pthread_rwlock_unlock(&member_index_lock);
+            free(index);
+            return;
+        }
+        for (int i = 0; i < memberIndexSlots; i++)
+            if (memberIndexes[i].members)
+                *member_index_slot(table, newSlots, memberIndexes[i].members) = memberIndexes[i];
+        free(memberIndexes);
+        memberIndexes    = table;
+        memberIndexSlots = newSlots;
+    }
+
+    MemberIndex *mi = member_index_slot(memberIndexes, memberIndexSlots, members);
+    if (mi->members)
+        free(mi->index);
+    else
+        nMemberIndexes++;
+
+    mi->members = (const char *)members;
+    mi->size    = size;
+    mi->slots   = slots;
+    mi->index   = index;
+
+    pthread_rwlock_unlock(&member_index_lock);
+#else
+    (void)members;
+    (void)count;
+    (void)size;
+#endif
+}
+
+/* index of the member called name, else -1.
+ * Members may be renamed or the array reused after it was indexed, so a hit
+ * is always checked against the name and a miss falls back to the scan. */
+static int member_find(const void *members, int count, size_t size, const char *name)
+{
+#ifdef MEMBER_INDEX
+    if (count >= MEMBER_INDEX_MIN)
+    {
+        int found = -1;
+
+        pthread_rwlock_rdlock(&member_index_lock);
+        if (memberIndexSlots > 0)
+        {
+            const MemberIndex *mi = member_index_slot(memberIndexes, memberIndexSlots, members);
+            if (mi->members && mi->size == size)
+            {
+                uint32_t s = member_name_hash(name) & (mi->slots - 1);
+                for (; mi->index[s]; s = (s + 1) & (mi->slots - 1))
+                {
+                    int i = mi->index[s] - 1;
+                    if (i < count && strcmp(mi->members + i * size, name) == 0)
+                    {
+                        found = i;
+                        break;
+                    }
+                }
+            }
+        }
+        pthread_rwlock_unlock(&member_index_lock);
+
+        if (found >= 0)
+            return found;
+    }
+#endif
+
+    for (int i = 0; i < count; i++)
+        if (strcmp((const char *)members + i * size, name) == 0)
+            return i;
+    return -1;
+}
+
 /* find a member of an IText vector, else NULL */
 IText *IUFindText(const ITextVectorProperty *tvp, const char *name)
 {
-    for (int i = 0; i < tvp->ntp; i++)
-        if (strcmp(tvp->tp[i].name, name) == 0)
-            return (&tvp->tp[i]);
+    int i = member_find(tvp->tp, tvp->ntp, sizeof(IText), name);
+    if (i >= 0)
+        return (&tvp->tp[i]);
     fprintf(stderr, "No IText '%s' in %s.%s\n", name, tvp->device, tvp->name);
     return (NULL);
 }
@@ -272,9 +424,9 @@ IText *IUFindText(const ITextVectorProperty *tvp, const char *name)
 /* find a member of an INumber vector, else NULL */
 INumber *IUFindNumber(const INumberVectorProperty *nvp, const char *name)
 {
-    for (int i = 0; i < nvp->nnp; i++)
-        if (strcmp(nvp->np[i].name, name) == 0)
-            return (&nvp->np[i]);
+    int i = member_find(nvp->np, nvp->nnp, sizeof(INumber), name);
+    if (i >= 0)
+        return (&nvp->np[i]);
     fprintf(stderr, "No INumber '%s' in %s.%s\n", name, nvp->device, nvp->name);
     return (NULL);
 }
@@ -282,9 +434,9 @@ INumber *IUFindNumber(const INumberVectorProperty *nvp, const char *name)
 /* find a member of an ISwitch vector, else NULL */
 ISwitch *IUFindSwitch(const ISwitchVectorProperty *svp, const char *name)
 {
-    for (int i = 0; i < svp->nsp; i++)
-        if (strcmp(svp->sp[i].name, name) == 0)
-            return (&svp->sp[i]);
+    int i = member_find(svp->sp, svp->nsp, sizeof(ISwitch), name);
+    if (i >= 0)
+        return (&svp->sp[i]);
     fprintf(stderr, "No ISwitch '%s' in %s.%s\n", name, svp->device, svp->name);
     return (NULL);
 }
@@ -292,9 +444,9 @@ ISwitch *IUFindSwitch(const ISwitchVectorProperty *svp, const char *name)
 /* find a member of an ILight vector, else NULL */
 ILight *IUFindLight(const ILightVectorProperty *lvp, const char *name)
 {
-    for (int i = 0; i < lvp->nlp; i++)
-        if (strcmp(lvp->lp[i].name, name) == 0)
-            return (&lvp->lp[i]);
+    int i = member_find(lvp->lp, lvp->nlp, sizeof(ILight), name);
+    if (i >= 0)
+        return (&lvp->lp[i]);
     fprintf(stderr, "No ILight '%s' in %s.%s\n", name, lvp->device, lvp->name);
     return (NULL);
 }
@@ -302,9 +454,9 @@ ILight *IUFindLight(const ILightVectorProperty *lvp, const char *name)
 /* find a member of an IBLOB vector, else NULL */
 IBLOB *IUFindBLOB(const IBLOBVectorProperty *bvp, const char *name)
 {
-    for (int i = 0; i < bvp->nbp; i++)
-        if (strcmp(bvp->bp[i].name, name) == 0)
-            return (&bvp->bp[i]);
+    int i = member_find(bvp->bp, bvp->nbp, sizeof(IBLOB), name);
+    if (i >= 0)
+        return (&bvp->bp[i]);
     fprintf(stderr, "No IBLOB '%s' in %s.%s\n", name, bvp->device, bvp->name);
     return (NULL);
 }
@@ -178,6 +178,32 @@ extern void IDDefLightVA(const ILightVectorProperty *l, const char *msg, va_list
 extern void IDDefBLOB(const IBLOBVectorProperty *b, const char *msg, ...) ATTRIBUTE_FORMAT_PRINTF(2, 3);
 extern void IDDefBLOBVA(const IBLOBVectorProperty *b, const char *msg, va_list arg) ATTRIBUTE_FORMAT_PRINTF(2, 0);
 
+/** @brief Start a batch: the messages the calling thread sends until IDBatchEnd are written to the server at once,
+ *  instead of one write each, as when a driver defines all its properties. Messages with attached BLOB buffers are
+ *  still written on their own, in order. Batches nest, the outermost one writes the messages.
+ */
+extern void IDBatchBegin(void);
+
+/** @brief End a batch started with IDBatchBegin. */
+extern void IDBatchEnd(void);
+
+/** @brief Give priority to the messages the calling thread sends until IDPriorityEnd: they are written to the server
+ *  before those other threads queued and not written yet, as a guide frame before the next messages of a long upload.
+ *  Messages already being written are not interrupted. Calls nest.
+ */
+extern void IDPriorityBegin(void);
+
+/** @brief End the priority started with IDPriorityBegin. */
+extern void IDPriorityEnd(void);
+
+/** @brief Handler of a getProperties for a single property the driver did not define yet. */
+typedef void (IDGetPropertyHandler)(const char *dev, const char *name);
+
+/** @brief Set the handler called when a client asks for a property not defined yet, so that the driver may define
+ *  it then. NULL, the default, ignores such requests.
+ */
+extern void IDSetGetPropertyHandler(IDGetPropertyHandler *handler);
+
 /* @} */
 
 /**
@@ -200,6 +226,16 @@ extern void IDSetTextVA(const ITextVectorProperty *t, const char *msg, va_list a
 extern void IDSetNumber(const INumberVectorProperty *n, const char *msg, ...) ATTRIBUTE_FORMAT_PRINTF(2, 3);
 extern void IDSetNumberVA(const INumberVectorProperty *n, const char *msg, va_list arg) ATTRIBUTE_FORMAT_PRINTF(2, 0);
 
+/** @brief Opt-in filter for IDSetNumber on one property, for drivers updating it from fast polling loops.
+ *  Updates that change the state, or carry a message, are always sent.
+ *  @param dev device name.
+ *  @param name property name.
+ *  @param minPeriodMs send at most one update every minPeriodMs milliseconds, later ones are dropped until then. 0 disables.
+ *  @param skipIdentical if non zero, drop updates whose values are the same as the last one sent.
+ *  @note calling it again replaces the policy, with both parameters at 0 the property is sent as usual.
+ */
+extern void IDSetNumberPolicy(const char *dev, const char *name, int minPeriodMs, int skipIdentical);
+
 /** @brief Tell client to update an existing switch vector property.
  *  @param s pointer to the vector switch property.
  *  @param msg message in printf style to send to the client. May be NULL.
@@ -276,6 +312,25 @@ typedef enum
  */
 extern void IDSnoopDevice(const char *snooped_device, const char *snooped_property);
 
+/** @brief Function a Driver calls to snoop on another Device in latest-value mode.
+ *  The server keeps the latest value of the property, and only sends it when its state, a text or switch, or a number
+ *  by more than threshold changed since the last one it sent. IDSnoopRequest gets the latest value at once, so that a
+ *  driver that only needs it now and then, to stamp a frame for instance, does not follow every update.
+ *  Servers without the mode send every update, as with IDSnoopDevice.
+ *  @param snooped_device name of the device to snoop.
+ *  @param snooped_property name of the snooped property in the device.
+ *  @param threshold change of a number value below which updates are not sent.
+ */
+extern void IDSnoopDeviceLatest(const char *snooped_device, const char *snooped_property, double threshold);
+
+/** @brief Function a Driver calls to get the latest value of a property snooped with IDSnoopDeviceLatest. It arrives
+ *  via ISSnoopDevice, unless the server has none yet.
+ *  @param snooped_device name of the snooped device.
+ *  @param snooped_property name of the snooped property. If NULL, then all properties snooped on the device in
+ *  latest-value mode.
+ */
+extern void IDSnoopRequest(const char *snooped_device, const char *snooped_property);
+
 /** @brief Function a Driver calls to control whether they will receive BLOBs from snooped devices.
  *  @param snooped_device name of the device to snoop.
  *  @param snooped_property name of property to snoop. If NULL, then all BLOBs from the given device are snooped.
@@ -283,6 +338,13 @@ extern void IDSnoopDevice(const char *snooped_device, const char *snooped_proper
  */
 extern void IDSnoopBLOBs(const char *snooped_device, const char *snooped_property, BLOBHandling bh);
 
+/** @brief Function a driver host calls for each device it runs in this process, see indi_driver_host. Snooping on
+ *  these devices then goes from their IDDef*, IDSet* and IDDelete calls straight to ISSnoopDevice, never through
+ *  indiserver.
+ *  @param dev name of the device run by this process.
+ */
+extern void IDLocalDevice(const char *dev);
+
 /* @} */
 
 /**
@@ -486,6 +548,15 @@ extern ILight *IUFindLight(const ILightVectorProperty *lvp, const char *name);
  */
 extern IBLOB *IUFindBLOB(const IBLOBVectorProperty *bvp, const char *name);
 
+/** @brief Build a name index so IUFind* on these members no longer scans them.
+ *  @param members the member array of a vector property, e.g. nvp->np.
+ *  @param count number of members.
+ *  @param size size of one member, e.g. sizeof(INumber).
+ *  @note IDDef* call this for every vector they define, narrow vectors are left to the scan.
+ *  Renaming members is safe, lookups that miss the index fall back to a scan.
+ */
+extern void IUIndexMembers(const void *members, int count, size_t size);
+
 /** @brief Returns the first ON switch it finds in the vector switch property.
  *  @note This is only valid for ISR_1OFMANY mode. That is, when only one switch out of many is allowed to be ON. Do not use this function if you can have multiple ON switches in the same vector property.
  *  @param sp a pointer to a switch vector property.
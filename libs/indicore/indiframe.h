@@ -0,0 +1,48 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#pragma once
+
+/* Binary setNumberVector between a driver and the indiserver that started it on a unix socket.
+ *
+ * indiserver offers it by setting INDI_FRAME_ENV in the environment of the driver, which then may
+ * send frames in between its XML messages. Frames never go further than indiserver: it builds the
+ * XML element of each one for its clients, snooping drivers and cache.
+ *
+ * A frame starts with a NUL byte, which never appears in XML, then the payload length on 32 bits.
+ * All values are in host byte order, both ends run on the same machine.
+ *
+ * INDI_FRAME_DEFNUMBER payload: kind (8 bits), id (32 bits), member count (32 bits),
+ *                               then device, property and member names, each NUL terminated.
+ * INDI_FRAME_SETNUMBER payload: kind (8 bits), id (32 bits), state (8 bits), timeout (double),
+ *                               timestamp NUL terminated, then one double per member.
+ *
+ * A DEFNUMBER is sent before the first SETNUMBER of an id, and again with a new id when the members change.
+ */
+
+#define INDI_FRAME_ENV "INDIFRAMES"
+
+#define INDI_FRAME_MARK   0
+#define INDI_FRAME_HEADER 5
+
+/* Larger payloads are a protocol error */
+#define INDI_FRAME_MAXPAYLOAD (1024 * 1024)
+
+enum
+{
+    INDI_FRAME_DEFNUMBER = 1,
+    INDI_FRAME_SETNUMBER = 2
+};
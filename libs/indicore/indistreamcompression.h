@@ -0,0 +1,413 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+/* Compression of the stream from indiserver to a client, negotiated at connection.
+ *
+ * The client offers its codecs in the compress attribute of its first getProperties, as in compress='zstd deflate'.
+ * A server picking one of them answers <compressStream codec='zstd'/> followed by a newline, and compresses all it
+ * sends from there on. Servers that do not know the attribute ignore it, the stream then stays plain XML. What the
+ * client sends is never compressed.
+ *
+ * The compressed stream is a sequence of frames, a kind byte and the little endian 32 bits length of the content:
+ * kind 'Z' for the next part of the compressed stream, 'R' for bytes sent as they are, such as the payload of BLOBs
+ * that are already compressed. A single compression context runs for the whole connection, with the INDI vocabulary
+ * loaded as its dictionary, so that even the first messages find their tags and attributes.
+ *
+ * Users link zlib, and zstd when HAVE_ZSTD is defined.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace INDI
+{
+
+namespace StreamCompression
+{
+
+enum Codec
+{
+    CODEC_DEFLATE,
+    CODEC_ZSTD
+};
+
+static constexpr size_t FRAME_HEADER = 5;
+
+/* Common words of the protocol, the later ones the most frequent */
+static const char VOCABULARY[] =
+    "<getProperties version='1.7'/> <enableBLOB>Also</enableBLOB> <message device='' timestamp='' message=''/>"
+    "<delProperty device='' name=''/> <defBLOBVector device='' name='' label='' group='' perm='ro' state='Idle'>"
+    "<defBLOB name='' label=''/></defBLOBVector> <defLightVector device='' name='' label='' group='' state='Idle'>"
+    "<defLight name='' label=''>Idle</defLight></defLightVector> <setLightVector device='' name='' state='Ok'>"
+    "<oneLight name=''>Ok</oneLight></setLightVector> <defTextVector device='' name='' label='' group='' perm='rw'"
+    " state='Idle' timeout='60' timestamp=''><defText name='' label=''></defText></defTextVector>"
+    " <setTextVector device='' name='' state='Ok' timeout='60' timestamp=''><oneText name=''></oneText>"
+    "</setTextVector> <defSwitchVector device='' name='' label='' group='Main Control' perm='rw' rule='OneOfMany'"
+    " state='Idle' timeout='60' timestamp=''><defSwitch name='' label=''>Off</defSwitch><defSwitch name=''"
+    " label=''>On</defSwitch></defSwitchVector> <setSwitchVector device='' name='' state='Ok' timeout='60'"
+    " timestamp=''><oneSwitch name=''>Off</oneSwitch><oneSwitch name=''>On</oneSwitch></setSwitchVector>"
+    " <defNumberVector device='' name='' label='' group='Main Control' perm='rw' state='Idle' timeout='60'"
+    " timestamp=''><defNumber name='' label='' format='%g' min='0' max='0' step='0'>0</defNumber>"
+    "</defNumberVector> <setNumberVector device='' name='' state='Busy' timeout='60' timestamp='2024-01-01T00:00:00'>"
+    "<oneNumber name=''>0</oneNumber></setNumberVector> <setNumberVector device='' name='' state='Ok' timeout='60'"
+    " timestamp='2024-01-01T00:00:00'>\n    <oneNumber name=''>\n      0\n    </oneNumber>\n</setNumberVector>\n";
+
+inline const char *codecName(Codec codec)
+{
+    return codec == CODEC_ZSTD ? "zstd" : "deflate";
+}
+
+/* The codecs this build can handle, best first, to offer in getProperties */
+inline const char *codecs()
+{
+#ifdef HAVE_ZSTD
+    return "zstd deflate";
+#else
+    return "deflate";
+#endif
+}
+
+/* Pick the first codec of the space separated list offered that this build handles. False if none */
+inline bool findCodec(const char *offered, Codec &codec)
+{
+    std::string const list = offered ? offered : "";
+    size_t start = 0;
+    while (start < list.size())
+    {
+        size_t end = list.find(' ', start);
+        if (end == std::string::npos)
+            end = list.size();
+        std::string const name = list.substr(start, end - start);
+#ifdef HAVE_ZSTD
+        if (name == "zstd")
+        {
+            codec = CODEC_ZSTD;
+            return true;
+        }
+#endif
+        if (name == "deflate")
+        {
+            codec = CODEC_DEFLATE;
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+/* The answer of the server, sent plain before the compressed stream */
+inline std::string acknowledgement(Codec codec)
+{
+    return std::string("<compressStream codec='") + codecName(codec) + "'/>\n";
+}
+
+/* Look for the answer of the server at the start of what it sent.
+ * Return its length if found, 0 if more is needed to tell, -1 if the server sent something else.
+ */
+inline int parseAcknowledgement(const char *data, size_t size, Codec &codec)
+{
+    for (Codec candidate : { CODEC_ZSTD, CODEC_DEFLATE })
+    {
+        std::string const ack = acknowledgement(candidate);
+        size_t const n = std::min(size, ack.size());
+        if (memcmp(data, ack.data(), n))
+            continue;
+        if (n < ack.size())
+            return 0;
+        codec = candidate;
+        return static_cast<int>(ack.size());
+    }
+    return -1;
+}
+
+inline void putFrameHeader(char *p, char kind, uint32_t length)
+{
+    p[0] = kind;
+    for (int i = 0; i < 4; i++)
+        p[1 + i] = static_cast<char>(length >> (8 * i));
+}
+
+class Compressor
+{
+    public:
+        explicit Compressor(Codec codec) : codec(codec)
+        {
+            if (codec == CODEC_ZSTD)
+            {
+#ifdef HAVE_ZSTD
+                zstd = ZSTD_createCCtx();
+                valid = zstd != nullptr && !ZSTD_isError(ZSTD_CCtx_setParameter(zstd, ZSTD_c_compressionLevel, 3)) &&
+                        !ZSTD_isError(ZSTD_CCtx_loadDictionary(zstd, VOCABULARY, sizeof(VOCABULARY) - 1));
+#endif
+                return;
+            }
+
+            memset(&z, 0, sizeof(z));
+            valid = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+            if (valid)
+                valid = deflateSetDictionary(&z, reinterpret_cast<const Bytef *>(VOCABULARY), sizeof(VOCABULARY) - 1) == Z_OK;
+        }
+
+        ~Compressor()
+        {
+#ifdef HAVE_ZSTD
+            if (codec == CODEC_ZSTD)
+            {
+                ZSTD_freeCCtx(zstd);
+                return;
+            }
+#endif
+            if (codec == CODEC_DEFLATE)
+                deflateEnd(&z);
+        }
+
+        Compressor(const Compressor &) = delete;
+        Compressor &operator=(const Compressor &) = delete;
+
+        bool isValid() const
+        {
+            return valid;
+        }
+
+        /* Append data to the frames in out, compressed unless raw. False on error */
+        bool add(const void *data, size_t size, bool raw, std::vector<char> &out)
+        {
+            if (raw)
+            {
+                if (!flush(out))
+                    return false;
+                size_t const at = out.size();
+                out.resize(at + FRAME_HEADER + size);
+                putFrameHeader(out.data() + at, 'R', static_cast<uint32_t>(size));
+                memcpy(out.data() + at + FRAME_HEADER, data, size);
+                return true;
+            }
+
+            if (!open)
+            {
+                frameStart = out.size();
+                out.resize(frameStart + FRAME_HEADER);
+                open = true;
+            }
+            return compress(data, size, false, out);
+        }
+
+        /* Make all added so far decodable by the peer, closing the current compressed frame. False on error */
+        bool flush(std::vector<char> &out)
+        {
+            if (!open)
+                return true;
+            if (!compress(nullptr, 0, true, out))
+                return false;
+            putFrameHeader(out.data() + frameStart, 'Z', static_cast<uint32_t>(out.size() - frameStart - FRAME_HEADER));
+            open = false;
+            return true;
+        }
+
+    private:
+        bool compress(const void *data, size_t size, bool flushing, std::vector<char> &out)
+        {
+#ifdef HAVE_ZSTD
+            if (codec == CODEC_ZSTD)
+            {
+                ZSTD_inBuffer in = { data, size, 0 };
+                for (;;)
+                {
+                    size_t const at = out.size();
+                    out.resize(at + ZSTD_CStreamOutSize());
+                    ZSTD_outBuffer o = { out.data() + at, out.size() - at, 0 };
+                    size_t const left = ZSTD_compressStream2(zstd, &o, &in, flushing ? ZSTD_e_flush : ZSTD_e_continue);
+                    out.resize(at + o.pos);
+                    if (ZSTD_isError(left))
+                        return false;
+                    if (flushing ? left == 0 : in.pos == in.size)
+                        return true;
+                }
+            }
+#endif
+            z.next_in  = static_cast<Bytef *>(const_cast<void *>(data));
+            z.avail_in = static_cast<uInt>(size);
+            for (;;)
+            {
+                size_t const at = out.size();
+                size_t const room = deflateBound(&z, z.avail_in) + 64;
+                out.resize(at + room);
+                z.next_out  = reinterpret_cast<Bytef *>(out.data() + at);
+                z.avail_out = static_cast<uInt>(room);
+                int const ret = deflate(&z, flushing ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+                out.resize(at + room - z.avail_out);
+                if (ret == Z_STREAM_ERROR)
+                    return false;
+                // Done once deflate did not fill all the room it was given
+                if (z.avail_in == 0 && z.avail_out > 0)
+                    return true;
+            }
+        }
+
+    private:
+        Codec codec;
+        bool valid {false};
+        bool open {false};      /* a compressed frame is being added to */
+        size_t frameStart {0};  /* position of its header in out */
+        z_stream z;
+#ifdef HAVE_ZSTD
+        ZSTD_CCtx *zstd {nullptr};
+#endif
+};
+
+class Decompressor
+{
+    public:
+        explicit Decompressor(Codec codec) : codec(codec)
+        {
+            if (codec == CODEC_ZSTD)
+            {
+#ifdef HAVE_ZSTD
+                zstd = ZSTD_createDCtx();
+                valid = zstd != nullptr && !ZSTD_isError(ZSTD_DCtx_loadDictionary(zstd, VOCABULARY, sizeof(VOCABULARY) - 1));
+#endif
+                return;
+            }
+
+            memset(&z, 0, sizeof(z));
+            valid = inflateInit2(&z, -15) == Z_OK;
+            if (valid)
+                valid = inflateSetDictionary(&z, reinterpret_cast<const Bytef *>(VOCABULARY), sizeof(VOCABULARY) - 1) == Z_OK;
+        }
+
+        ~Decompressor()
+        {
+#ifdef HAVE_ZSTD
+            if (codec == CODEC_ZSTD)
+            {
+                ZSTD_freeDCtx(zstd);
+                return;
+            }
+#endif
+            if (codec == CODEC_DEFLATE)
+                inflateEnd(&z);
+        }
+
+        Decompressor(const Decompressor &) = delete;
+        Decompressor &operator=(const Decompressor &) = delete;
+
+        bool isValid() const
+        {
+            return valid;
+        }
+
+        /* Append what the next size bytes of the stream in data decode to, to out. False if the stream is corrupt */
+        bool read(const char *data, size_t size, std::vector<char> &out)
+        {
+            while (size > 0)
+            {
+                if (header.size() < FRAME_HEADER)
+                {
+                    size_t const n = std::min(size, FRAME_HEADER - header.size());
+                    header.append(data, n);
+                    data += n;
+                    size -= n;
+                    if (header.size() < FRAME_HEADER)
+                        return true;
+                    if (header[0] != 'Z' && header[0] != 'R')
+                        return false;
+                    left = 0;
+                    for (int i = 0; i < 4; i++)
+                        left |= static_cast<uint32_t>(static_cast<uint8_t>(header[1 + i])) << (8 * i);
+                }
+
+                size_t const n = std::min<size_t>(size, left);
+                if (header[0] == 'R')
+                    out.insert(out.end(), data, data + n);
+                else if (!decompress(data, n, out))
+                    return false;
+                data += n;
+                size -= n;
+                left -= n;
+                if (left == 0)
+                    header.clear();
+            }
+            return true;
+        }
+
+    private:
+        bool decompress(const char *data, size_t size, std::vector<char> &out)
+        {
+#ifdef HAVE_ZSTD
+            if (codec == CODEC_ZSTD)
+            {
+                ZSTD_inBuffer in = { data, size, 0 };
+                for (;;)
+                {
+                    size_t const at = out.size();
+                    out.resize(at + ZSTD_DStreamOutSize());
+                    ZSTD_outBuffer o = { out.data() + at, out.size() - at, 0 };
+                    size_t const ret = ZSTD_decompressStream(zstd, &o, &in);
+                    bool const full = o.pos == o.size;
+                    out.resize(at + o.pos);
+                    if (ZSTD_isError(ret))
+                        return false;
+                    // A full output may leave decoded bytes in the context, even with all the input read
+                    if (in.pos == in.size && !full)
+                        return true;
+                }
+            }
+#endif
+            z.next_in  = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+            z.avail_in = static_cast<uInt>(size);
+            for (;;)
+            {
+                size_t const at = out.size();
+                size_t const room = 4 * size + 1024;
+                out.resize(at + room);
+                z.next_out  = reinterpret_cast<Bytef *>(out.data() + at);
+                z.avail_out = static_cast<uInt>(room);
+                int const ret = inflate(&z, Z_SYNC_FLUSH);
+                out.resize(at + room - z.avail_out);
+                if (ret != Z_OK && ret != Z_BUF_ERROR)
+                    return false;
+                // Done once inflate read everything without filling all the room it was given
+                if (z.avail_in == 0 && z.avail_out > 0)
+                    return true;
+                if (ret == Z_BUF_ERROR && z.avail_out > 0)
+                    return false;
+            }
+        }
+
+    private:
+        Codec codec;
+        bool valid {false};
+        std::string header;     /* header of the current frame, while incomplete */
+        uint32_t left {0};      /* bytes of the current frame not read yet */
+        z_stream z;
+#ifdef HAVE_ZSTD
+        ZSTD_DCtx *zstd {nullptr};
+#endif
+};
+
+}
+
+}
@@ -0,0 +1,249 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "inditrace.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+struct TraceEvent
+{
+    uint64_t time;
+    const char *name;
+    char phase;
+};
+
+struct TraceChunk
+{
+    static const size_t capacity = 4096;
+
+    TraceEvent events[capacity];
+    std::atomic<TraceChunk *> next {nullptr};
+};
+
+/** Events of one thread: it is the only one writing, the dump reads what is published by count */
+struct TraceBuffer
+{
+    // at most 1M events per thread, the rest is counted as dropped
+    static const size_t maxChunks = 256;
+
+    explicit TraceBuffer(int tid) : tid(tid) { }
+
+    ~TraceBuffer()
+    {
+        for (TraceChunk *chunk = first.next.load(); chunk != nullptr;)
+        {
+            TraceChunk *next = chunk->next.load();
+            delete chunk;
+            chunk = next;
+        }
+    }
+
+    void push(uint64_t time, const char *name, char phase)
+    {
+        size_t index = count.load(std::memory_order_relaxed);
+        if (index == maxChunks * TraceChunk::capacity)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (index > 0 && index % TraceChunk::capacity == 0)
+        {
+            TraceChunk *chunk = new TraceChunk;
+            last->next.store(chunk, std::memory_order_release);
+            last = chunk;
+        }
+
+        last->events[index % TraceChunk::capacity] = {time, name, phase};
+        count.store(index + 1, std::memory_order_release);
+    }
+
+    int tid;
+    TraceChunk first;
+    TraceChunk *last {&first};
+    std::atomic<size_t> count {0};
+    std::atomic<uint64_t> dropped {0};
+};
+
+struct Tracer
+{
+    std::atomic<bool> enabled {false};
+    std::chrono::steady_clock::time_point origin {std::chrono::steady_clock::now()};
+
+    std::mutex lock;
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    std::string filename;
+    bool atExit {false};
+};
+
+// never destroyed, threads may still record while the process exits
+Tracer &tracer()
+{
+    static Tracer *instance = new Tracer;
+    return *instance;
+}
+
+TraceBuffer &threadBuffer()
+{
+    thread_local std::shared_ptr<TraceBuffer> buffer;
+    if (!buffer)
+    {
+        Tracer &t = tracer();
+        std::lock_guard<std::mutex> lock(t.lock);
+        buffer = std::make_shared<TraceBuffer>(int(t.buffers.size()) + 1);
+        t.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void record(const char *name, char phase)
+{
+    Tracer &t = tracer();
+    if (!t.enabled.load(std::memory_order_relaxed))
+        return;
+
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t.origin);
+    threadBuffer().push(uint64_t(time.count()), name, phase);
+}
+
+void writeString(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (; *text; ++text)
+    {
+        if (*text == '"' || *text == '\\')
+            fputc('\\', file);
+        if (static_cast<unsigned char>(*text) >= 0x20)
+            fputc(*text, file);
+    }
+    fputc('"', file);
+}
+
+void dumpAtExit()
+{
+    Tracer &t = tracer();
+    std::string filename;
+    {
+        std::lock_guard<std::mutex> lock(t.lock);
+        filename = t.filename;
+    }
+    if (!filename.empty())
+        IDTraceDump(filename.c_str());
+}
+
+// INDITRACE names the file, to trace drivers started by indiserver without changing them
+const bool startedFromEnvironment = []
+{
+    const char *filename = getenv("INDITRACE");
+    if (filename == nullptr || *filename == '\0')
+        return false;
+    IDTraceStart(filename);
+    return true;
+}();
+
+}
+
+extern "C" {
+
+void IDTraceStart(const char *filename)
+{
+    Tracer &t = tracer();
+    {
+        std::lock_guard<std::mutex> lock(t.lock);
+        t.filename = filename != nullptr ? filename : "";
+        if (!t.atExit && !t.filename.empty())
+            t.atExit = std::atexit(dumpAtExit) == 0;
+    }
+    t.enabled = true;
+}
+
+void IDTraceStop(void)
+{
+    tracer().enabled = false;
+}
+
+void IDTraceBegin(const char *name)
+{
+    record(name, 'B');
+}
+
+void IDTraceEnd(const char *name)
+{
+    record(name, 'E');
+}
+
+int IDTraceDump(const char *filename)
+{
+    FILE *file = fopen(filename, "w");
+    if (file == nullptr)
+        return -1;
+
+    Tracer &t = tracer();
+    std::vector<std::shared_ptr<TraceBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(t.lock);
+        buffers = t.buffers;
+    }
+
+    int pid = int(getpid());
+    bool first = true;
+    uint64_t dropped = 0;
+
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", file);
+    for (const auto &buffer : buffers)
+    {
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        const TraceChunk *chunk = &buffer->first;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (i > 0 && i % TraceChunk::capacity == 0)
+                chunk = chunk->next.load(std::memory_order_acquire);
+
+            const TraceEvent &event = chunk->events[i % TraceChunk::capacity];
+            fputs(first ? "\n{\"name\":" : ",\n{\"name\":", file);
+            writeString(file, event.name);
+            // microseconds, with the nanoseconds as decimals
+            fprintf(file, ",\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03u}",
+                    event.phase, pid, buffer->tid,
+                    static_cast<unsigned long long>(event.time / 1000), unsigned(event.time % 1000));
+            first = false;
+        }
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    fprintf(file, "\n],\"otherData\":{\"dropped\":\"%llu\"}}\n", static_cast<unsigned long long>(dropped));
+
+    return fclose(file) == 0 ? 0 : -1;
+}
+
+}
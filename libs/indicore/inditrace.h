@@ -0,0 +1,98 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+/** \file inditrace.h
+ *  \brief Recorder of timed scopes, to see where the time of a driver goes.
+
+    Each thread records the begin and end of its scopes, with a nanosecond clock, in a buffer of its own.
+    The recording is dumped as a Chrome trace JSON file, that chrome://tracing and ui.perfetto.dev open.
+
+    The INDI_TRACE_* macros compile to nothing unless the library is built with -DINDI_TRACE=ON,
+    which defines WITH_TRACE. Once compiled in, nothing is recorded until IDTraceStart() is called, or the
+    INDITRACE environment variable names the file to dump to when the process exits.
+    The scope names must be string literals, only their address is recorded.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** \brief Start recording, the events are written to the file when the process exits.
+ *  \param filename file to dump to, nullptr to only dump with IDTraceDump()
+ */
+extern void IDTraceStart(const char *filename);
+
+/** \brief Stop recording, what is recorded so far is kept. */
+extern void IDTraceStop(void);
+
+/** \brief Record the beginning of a scope on the calling thread. */
+extern void IDTraceBegin(const char *name);
+
+/** \brief Record the end of the last scope begun on the calling thread. */
+extern void IDTraceEnd(const char *name);
+
+/** \brief Write all events recorded so far to a Chrome trace JSON file.
+ *  \return 0 on success, -1 if the file cannot be written
+ */
+extern int IDTraceDump(const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef WITH_TRACE
+#define INDI_TRACE_BEGIN(name) IDTraceBegin(name)
+#define INDI_TRACE_END(name)   IDTraceEnd(name)
+#else
+#define INDI_TRACE_BEGIN(name) do { } while (0)
+#define INDI_TRACE_END(name)   do { } while (0)
+#endif
+
+#ifdef __cplusplus
+namespace INDI
+{
+/** \brief Records the begin and end of the enclosing scope */
+class TraceScope
+{
+    public:
+        explicit TraceScope(const char *name)
+            : name(name)
+        {
+            IDTraceBegin(name);
+        }
+        ~TraceScope()
+        {
+            IDTraceEnd(name);
+        }
+        TraceScope(const TraceScope &) = delete;
+        TraceScope &operator=(const TraceScope &) = delete;
+
+    private:
+        const char *name;
+};
+}
+
+#define INDI_TRACE_CONCAT_(a, b) a##b
+#define INDI_TRACE_CONCAT(a, b)  INDI_TRACE_CONCAT_(a, b)
+
+#ifdef WITH_TRACE
+#define INDI_TRACE_SCOPE(name) INDI::TraceScope INDI_TRACE_CONCAT(indiTraceScope, __LINE__)(name)
+#else
+#define INDI_TRACE_SCOPE(name) do { } while (0)
+#endif
+#endif
@@ -46,9 +46,9 @@ void IUUserIONumberContext(const userio *io, void *user, const INumberVectorProp
         INumber *np = &nvp->np[i];
         userio_prints    (io, user, "  <oneNumber name='");
         userio_xml_escape(io, user, np->name);
-        userio_prints    (io, user, "'>\n");
-        userio_printf    (io, user, "      %.20g\n", np->value); // safe
-        userio_prints    (io, user, "  </oneNumber>\n");
+        userio_prints    (io, user, "'>\n      ");
+        userio_printnumber(io, user, np->value);
+        userio_prints    (io, user, "\n  </oneNumber>\n");
     }
 }
 
@@ -98,14 +98,52 @@ void IUUserIOSwitchContext(const userio *io, void *user, const ISwitchVectorProp
         IUUserIOSwitchContextFull(io, user, svp);
 }
 
+/* Base64 encodes len bytes of blob straight into the sink as 72 column lines.
+ * Each line is encoded in place in a small stack buffer, so the memory used
+ * does not depend on the blob size and the first lines are written while the
+ * rest is still being encoded.
+ * Returns -1 if the sink stopped accepting data.
+ */
+#define BLOB_LINE_BYTES 54 /* 72 base64 digits */
+#define BLOB_CHUNK_LINES 64
+
+static int s_userio_base64_lines(const userio *io, void *user, const unsigned char *blob, size_t len)
+{
+    unsigned char chunk[BLOB_CHUNK_LINES * 73 + 1];
+
+    while (len > 0)
+    {
+        size_t used = 0;
+
+        for (int i = 0; i < BLOB_CHUNK_LINES && len > 0; i++)
+        {
+            size_t n = len > BLOB_LINE_BYTES ? BLOB_LINE_BYTES : len;
+
+            used += to64frombits_s(chunk + used, blob, (int)n, sizeof(chunk) - used);
+            chunk[used++] = '\n';
+            blob += n;
+            len  -= n;
+        }
+
+        for (size_t written = 0; written < used;)
+        {
+            ssize_t wr = userio_write(io, user, chunk + written, used - written);
+
+            if (wr <= 0)
+                return -1;
+
+            written += wr;
+        }
+    }
+
+    return 0;
+}
+
 void IUUserIOBLOBContextOne(
     const userio *io, void *user,
     const char *name, unsigned int size, unsigned int bloblen, const void *blob, const char *format
 )
 {
-    unsigned char *encblob;
-    int l;
-
     userio_prints    (io, user, "  <oneBLOB\n"
                                 "    name='");
     userio_xml_escape(io, user, name);
@@ -130,39 +168,13 @@ void IUUserIOBLOBContextOne(
 
             io->joinbuff(user, "    attached='true'>\n", (void*)blob, bloblen);
         } else {
-            size_t sz = 4 * bloblen / 3 + 4;
-            assert_mem(encblob = (unsigned char *)malloc(sz)); // #PS: TODO
-            l = to64frombits_s(encblob, blob, bloblen, sz);
-            if (l == 0) {
-                fprintf(stderr, "%s: Not enough memory for decoding.\n", __func__);
-                exit(1);
-            }
+            int l = ((bloblen + 2) / 3) * 4;
             userio_printf    (io, user, "    enclen='%d'\n", l); // safe
             userio_prints    (io, user, "    format='");
             userio_xml_escape(io, user, format);
             userio_prints    (io, user, "'>\n");
-            size_t written = 0;
-            // FIXME: this is not efficient. The CR/LF imply one more copy... Do we need them ?
-            while ((int)written < l)
-            {
-                size_t towrite = ((l - written) > 72) ? 72 : l - written;
-                size_t wr      = userio_write(io, user, encblob + written, towrite);
-
-                if (wr == 0)
-                {
-                    free(encblob);
-                    return;
-                }
-
-                written += wr;
-                if ((written % 72) == 0)
-                    userio_putc(io, user, '\n');
-            }
-
-            if ((written % 72) != 0)
-                userio_putc(io, user, '\n');
-
-            free(encblob);
+            if (s_userio_base64_lines(io, user, (const unsigned char *)blob, bloblen) < 0)
+                return;
         }
     }
 
@@ -308,6 +320,24 @@ void IUUserIOGetProperties(
     const userio *io, void *user,
     const char *dev, const char *name
 )
+{
+    IUUserIOGetPropertiesSince(io, user, dev, name, NULL);
+}
+
+void IUUserIOGetPropertiesSince(
+    const userio *io, void *user,
+    const char *dev, const char *name,
+    const char *generation
+)
+{
+    IUUserIOGetPropertiesCompress(io, user, dev, name, generation, NULL);
+}
+
+void IUUserIOGetPropertiesCompress(
+    const userio *io, void *user,
+    const char *dev, const char *name,
+    const char *generation, const char *compress
+)
 {
     userio_printf    (io, user, "<getProperties version='%g'", INDIV); // safe
     // special case for INDI::BaseClient::listenINDI INDI::BaseClientQt::connectServer
@@ -323,9 +353,45 @@ void IUUserIOGetProperties(
         userio_xml_escape(io, user, name);
         userio_prints    (io, user, "'");
     }
+    if (generation && generation[0])
+    {
+        userio_prints    (io, user, " generation='");
+        userio_xml_escape(io, user, generation);
+        userio_prints    (io, user, "'");
+    }
+    if (compress && compress[0])
+    {
+        userio_prints    (io, user, " compress='");
+        userio_xml_escape(io, user, compress);
+        userio_prints    (io, user, "'");
+    }
     userio_prints    (io, user, "/>\n");
 }
 
+void IUUserIOGetPropertiesSnoop(
+    const userio *io, void *user,
+    const char *dev, const char *name,
+    const char *mode, double threshold
+)
+{
+    locale_char_t *orig = indi_locale_C_numeric_push();
+    userio_printf    (io, user, "<getProperties version='%g'", INDIV); // safe
+    userio_prints    (io, user, " device='");
+    userio_xml_escape(io, user, dev);
+    userio_prints    (io, user, "'");
+    if (name && name[0])
+    {
+        userio_prints    (io, user, " name='");
+        userio_xml_escape(io, user, name);
+        userio_prints    (io, user, "'");
+    }
+    userio_printf    (io, user, " snoop='%s'", mode); // safe
+    if (threshold > 0)
+        userio_printf(io, user, " threshold='%.10g'", threshold);
+    userio_prints    (io, user, "/>\n");
+    indi_locale_C_numeric_pop(orig);
+}
+
 // temporary
 static const char *s_BLOBHandlingtoString(BLOBHandling bh)
 {
@@ -486,10 +552,15 @@ void IUUserIODefNumberVA(
                                     "    format='");
         userio_xml_escape(io, user, np->format);
         userio_prints    (io, user, "'\n");
-        userio_printf    (io, user, "    min='%.20g'\n", np->min); // safe
-        userio_printf    (io, user, "    max='%.20g'\n", np->max); // safe
-        userio_printf    (io, user, "    step='%.20g'>\n", np->step); // safe
-        userio_printf    (io, user, "      %.20g\n", np->value); // safe
+        userio_prints    (io, user, "    min='");
+        userio_printnumber(io, user, np->min);
+        userio_prints    (io, user, "'\n    max='");
+        userio_printnumber(io, user, np->max);
+        userio_prints    (io, user, "'\n    step='");
+        userio_printnumber(io, user, np->step);
+        userio_prints    (io, user, "'>\n      ");
+        userio_printnumber(io, user, np->value);
+        userio_prints    (io, user, "\n");
 
         userio_prints    (io, user, "  </defNumber>\n");
     }
@@ -738,7 +809,8 @@ void IUUserIOSetBLOBVA(
     userio_prints    (io, user, "'\n");
     userio_printf    (io, user, "  state='%s'\n", pstateStr(bvp->s)); // safe
     userio_printf    (io, user, "  timeout='%g'\n", bvp->timeout); // safe
-    userio_printf    (io, user, "  timestamp='%s'\n", indi_timestamp()); // safe
+    // A BLOB stamped by the driver, such as a stream frame with its capture time, keeps its timestamp
+    userio_printf    (io, user, "  timestamp='%s'\n", bvp->timestamp[0] ? bvp->timestamp : indi_timestamp()); // safe
     s_userio_xml_message_vprintf(io, user, fmt, ap);
     userio_prints    (io, user, ">\n");
 
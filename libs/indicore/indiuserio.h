@@ -83,6 +83,14 @@ void IUUserIOUpdateMinMax(const userio *io, void *user, const struct _INumberVec
 void IUUserIODeleteVA(const userio *io, void *user, const char *dev, const char *name, const char *fmt, va_list ap);
 
 void IUUserIOGetProperties(const userio *io, void *user, const char *dev, const char *name);
+/** @brief getProperties of what changed after generation, the last one stamped by the server */
+void IUUserIOGetPropertiesSince(const userio *io, void *user, const char *dev, const char *name, const char *generation);
+/** @brief getProperties with, in addition, the codecs offered to compress the stream from the server, space separated */
+void IUUserIOGetPropertiesCompress(const userio *io, void *user, const char *dev, const char *name,
+                                   const char *generation, const char *compress);
+/** @brief getProperties of a snooping driver, with the snoop mode ("latest" or "pull") and the threshold of "latest" */
+void IUUserIOGetPropertiesSnoop(const userio *io, void *user, const char *dev, const char *name, const char *mode,
+                                double threshold);
 
 void IDUserIOMessage(const userio *io, void *user, const char *dev, const char *fmt, ...);
 void IDUserIOMessageVA(const userio *io, void *user, const char *dev, const char *fmt, va_list ap);
@@ -39,92 +39,110 @@
 #include <libnova/aberration.h>
 #include <libnova/transform.h>
 #include <libnova/nutation.h>
+#include <libnova/sidereal_time.h>
 
 namespace INDI
 {
 
 //////////////////////////////////////////////////////////////////////////////////////////////
-// converts the Observed (JNow) position to a J2000 catalogue position by removing
-// aberration, nutation and precession using the libnova library
+// position in degrees to and from a unit vector
 //////////////////////////////////////////////////////////////////////////////////////////////
-void ObservedToJ2000(IEquatorialCoordinates * observed, double jd, IEquatorialCoordinates * J2000pos)
+static void toVector(double ra, double dec, double v[3])
 {
-    ln_equ_posn tempPos;
-    // RA Hours --> Degrees
-    struct ln_equ_posn libnova_observed = {observed->rightascension * 15.0, observed->declination};
-    // remove the aberration
-    ln_get_equ_aber(&libnova_observed, jd, &tempPos);
-    // this conversion has added the aberration, we want to subtract it
-    tempPos.ra = libnova_observed.ra - (tempPos.ra - libnova_observed.ra);
-    tempPos.dec = libnova_observed.dec * 2 - tempPos.dec;
-
-    // remove the nutation
-    ln_get_equ_nut(&tempPos, jd, true);
-
-    struct ln_equ_posn libnova_J2000Pos;
-    // precess from now to J2000
-    ln_get_equ_prec2(&tempPos, jd, JD2000, &libnova_J2000Pos);
-
-    J2000pos->rightascension = libnova_J2000Pos.ra / 15.0;
-    J2000pos->declination = libnova_J2000Pos.dec;
+    double sin_ra = sin(DEG_TO_RAD(ra)), cos_ra = cos(DEG_TO_RAD(ra));
+    double sin_dec = sin(DEG_TO_RAD(dec)), cos_dec = cos(DEG_TO_RAD(dec));
+    v[0] = cos_dec * cos_ra;
+    v[1] = cos_dec * sin_ra;
+    v[2] = sin_dec;
+}
 
+static void fromVector(const double v[3], double *ra, double *dec)
+{
+    *ra = range360(RAD_TO_DEG(atan2(v[1], v[0])));
+    *dec = RAD_TO_DEG(asin(v[2] > 1 ? 1 : (v[2] < -1 ? -1 : v[2])));
+}
 
+static void rotate(const double m[3][3], ln_equ_posn *posn)
+{
+    double v[3], w[3];
+    toVector(posn->ra, posn->dec, v);
+    for (int i = 0; i < 3; i++)
+        w[i] = m[i][0] * v[0] + m[i][1] * v[1] + m[i][2] * v[2];
+    fromVector(w, &posn->ra, &posn->dec);
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////////
-/// \brief *J2000toObserved converts catalogue to observed
-/// \param J2000pos catalogue position
-/// \param jd julian day for the observed epoch
-/// \param observed returns observed position
+// precession is a rotation, its matrix columns are the precessed x and y axes and their cross product
 //////////////////////////////////////////////////////////////////////////////////////////////
-void J2000toObserved(IEquatorialCoordinates *J2000pos, double jd, IEquatorialCoordinates *observed)
+static void precessionMatrix(double fromJD, double toJD, double m[3][3])
 {
-    ln_equ_posn tempPosn;
-    struct ln_equ_posn libnova_J2000Pos = {J2000pos->rightascension * 15.0, J2000pos->declination };
-
-    // apply precession from J2000 to jd
-    ln_get_equ_prec2(&libnova_J2000Pos, JD2000, jd, &tempPosn);
-
-    // apply nutation
-    ln_get_equ_nut(&tempPosn, jd, false);
+    ln_equ_posn x = {0, 0}, y = {90, 0}, px, py;
+    double vx[3], vy[3];
 
-    struct ln_equ_posn libnova_observed;
-    // apply aberration
-    ln_get_equ_aber(&tempPosn, jd, &libnova_observed);
+    ln_get_equ_prec2(&x, fromJD, toJD, &px);
+    ln_get_equ_prec2(&y, fromJD, toJD, &py);
+    toVector(px.ra, px.dec, vx);
+    toVector(py.ra, py.dec, vy);
 
-    observed->rightascension = libnova_observed.ra / 15.0;
-    observed->declination = libnova_observed.dec;
+    double vz[3] = { vx[1] * vy[2] - vx[2] * vy[1], vx[2] * vy[0] - vx[0] * vy[2], vx[0] * vy[1] - vx[1] * vy[0] };
+    for (int i = 0; i < 3; i++)
+    {
+        m[i][0] = vx[i];
+        m[i][1] = vy[i];
+        m[i][2] = vz[i];
+    }
 }
 
-//////////////////////////////////////////////////////////////////////////////////////////////
-/// apply or remove nutation
-//////////////////////////////////////////////////////////////////////////////////////////////
-void ln_get_equ_nut(ln_equ_posn *posn, double jd, bool reverse)
+// difference of two angles in degrees, in radians
+static double deltaRadians(double to, double from)
 {
-    // code lifted from libnova ln_get_equ_nut
-    // with the option to add or remove nutation
-    struct ln_nutation nut;
-    ln_get_nutation (jd, &nut);
+    double delta = to - from;
+    if (delta > 180)
+        delta -= 360;
+    else if (delta < -180)
+        delta += 360;
+    return DEG_TO_RAD(delta);
+}
 
-    double mean_ra, mean_dec, delta_ra, delta_dec;
+void ComputeEpochContext(double jd, IEpochContext *context)
+{
+    context->jd = jd;
 
-    mean_ra = DEG_TO_RAD(posn->ra);
-    mean_dec = DEG_TO_RAD(posn->dec);
+    precessionMatrix(JD2000, jd, context->precession);
+    precessionMatrix(jd, JD2000, context->unprecession);
 
-    // Equ 22.1
+    struct ln_nutation nut;
+    ln_get_nutation(jd, &nut);
+    context->nutationLongitude = nut.longitude;
+    context->nutationObliquity = nut.obliquity;
+    context->nutationEcliptic = DEG_TO_RAD(nut.ecliptic + nut.obliquity);
+
+    // Annual aberration is d(ra) = (Vy cos(ra) - Vx sin(ra)) / cos(dec) and
+    // d(dec) = Vz cos(dec) - (Vx cos(ra) + Vy sin(ra)) sin(dec), V being the earth velocity over c.
+    // On the equator at ra 0 it shifts ra by Vy and dec by Vz, at ra 90 it shifts ra by -Vx.
+    ln_equ_posn ra0 = {0, 0}, ra90 = {90, 0}, aber0, aber90;
+    ln_get_equ_aber(&ra0, jd, &aber0);
+    ln_get_equ_aber(&ra90, jd, &aber90);
+    context->aberration[0] = -deltaRadians(aber90.ra, ra90.ra);
+    context->aberration[1] = deltaRadians(aber0.ra, ra0.ra);
+    context->aberration[2] = deltaRadians(aber0.dec, ra0.dec);
+}
 
-    double nut_ecliptic = DEG_TO_RAD(nut.ecliptic + nut.obliquity);
-    double sin_ecliptic = sin(nut_ecliptic);
+static void applyNutation(const IEpochContext *context, double sin_ecliptic, double cos_ecliptic, ln_equ_posn *posn,
+                          bool reverse)
+{
+    double mean_ra = DEG_TO_RAD(posn->ra);
+    double mean_dec = DEG_TO_RAD(posn->dec);
 
+    // Equ 22.1
     double sin_ra = sin(mean_ra);
     double cos_ra = cos(mean_ra);
-
     double tan_dec = tan(mean_dec);
 
-    delta_ra = (cos (nut_ecliptic) + sin_ecliptic * sin_ra * tan_dec) * nut.longitude - cos_ra * tan_dec * nut.obliquity;
-    delta_dec = (sin_ecliptic * cos_ra) * nut.longitude + sin_ra * nut.obliquity;
+    double delta_ra = (cos_ecliptic + sin_ecliptic * sin_ra * tan_dec) * context->nutationLongitude -
+                      cos_ra * tan_dec * context->nutationObliquity;
+    double delta_dec = (sin_ecliptic * cos_ra) * context->nutationLongitude + sin_ra * context->nutationObliquity;
 
-    // the sign changed to remove nutation
     if (reverse)
     {
         delta_ra = -delta_ra;
@@ -134,6 +152,100 @@ void ln_get_equ_nut(ln_equ_posn *posn, double jd, bool reverse)
     posn->dec += delta_dec;
 }
 
+static void applyAberration(const IEpochContext *context, ln_equ_posn *posn, bool reverse)
+{
+    const double *v = context->aberration;
+    double ra = DEG_TO_RAD(posn->ra), dec = DEG_TO_RAD(posn->dec);
+    double sin_ra = sin(ra), cos_ra = cos(ra), sin_dec = sin(dec), cos_dec = cos(dec);
+
+    double delta_ra = (v[1] * cos_ra - v[0] * sin_ra) / cos_dec;
+    double delta_dec = v[2] * cos_dec - (v[0] * cos_ra + v[1] * sin_ra) * sin_dec;
+
+    double sign = reverse ? -1 : 1;
+    posn->ra += sign * RAD_TO_DEG(delta_ra);
+    posn->dec += sign * RAD_TO_DEG(delta_dec);
+}
+
+void J2000toObserved(const IEpochContext *context, const IEquatorialCoordinates *J2000pos, IEquatorialCoordinates *observed,
+                     size_t count)
+{
+    double sin_ecliptic = sin(context->nutationEcliptic), cos_ecliptic = cos(context->nutationEcliptic);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ln_equ_posn posn = {J2000pos[i].rightascension * 15.0, J2000pos[i].declination};
+        rotate(context->precession, &posn);
+        applyNutation(context, sin_ecliptic, cos_ecliptic, &posn, false);
+        applyAberration(context, &posn, false);
+        observed[i].rightascension = range24(posn.ra / 15.0);
+        observed[i].declination = posn.dec;
+    }
+}
+
+void ObservedToJ2000(const IEpochContext *context, const IEquatorialCoordinates *observed, IEquatorialCoordinates *J2000pos,
+                     size_t count)
+{
+    double sin_ecliptic = sin(context->nutationEcliptic), cos_ecliptic = cos(context->nutationEcliptic);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ln_equ_posn posn = {observed[i].rightascension * 15.0, observed[i].declination};
+        applyAberration(context, &posn, true);
+        applyNutation(context, sin_ecliptic, cos_ecliptic, &posn, true);
+        rotate(context->unprecession, &posn);
+        J2000pos[i].rightascension = posn.ra / 15.0;
+        J2000pos[i].declination = posn.dec;
+    }
+}
+
+// context of the last epoch converted by the calling thread
+static const IEpochContext *cachedContext(double jd)
+{
+    static thread_local IEpochContext context;
+    static thread_local bool valid = false;
+
+    if (!valid || fabs(jd - context.jd) > EPOCH_CONTEXT_REFRESH)
+    {
+        ComputeEpochContext(jd, &context);
+        valid = true;
+    }
+    return &context;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// converts the Observed (JNow) position to a J2000 catalogue position by removing
+// aberration, nutation and precession using the libnova library
+//////////////////////////////////////////////////////////////////////////////////////////////
+void ObservedToJ2000(IEquatorialCoordinates * observed, double jd, IEquatorialCoordinates * J2000pos)
+{
+    ObservedToJ2000(cachedContext(jd), observed, J2000pos, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// \brief *J2000toObserved converts catalogue to observed
+/// \param J2000pos catalogue position
+/// \param jd julian day for the observed epoch
+/// \param observed returns observed position
+//////////////////////////////////////////////////////////////////////////////////////////////
+void J2000toObserved(IEquatorialCoordinates *J2000pos, double jd, IEquatorialCoordinates *observed)
+{
+    J2000toObserved(cachedContext(jd), J2000pos, observed, 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+/// apply or remove nutation
+//////////////////////////////////////////////////////////////////////////////////////////////
+void ln_get_equ_nut(ln_equ_posn *posn, double jd, bool reverse)
+{
+    IEpochContext context;
+    struct ln_nutation nut;
+    ln_get_nutation (jd, &nut);
+    context.nutationLongitude = nut.longitude;
+    context.nutationObliquity = nut.obliquity;
+    context.nutationEcliptic = DEG_TO_RAD(nut.ecliptic + nut.obliquity);
+    applyNutation(&context, sin(context.nutationEcliptic), cos(context.nutationEcliptic), posn, reverse);
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////
 ///
 //////////////////////////////////////////////////////////////////////////////////////////////
@@ -168,5 +280,25 @@ void HorizontalToEquatorial(IHorizontalCoordinates *object, IGeographicCoordinat
 
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////////
+///
+//////////////////////////////////////////////////////////////////////////////////////////////
+void EquatorialToHorizontal(const IEquatorialCoordinates *objects, IGeographicCoordinates *observer, double JD,
+                            IHorizontalCoordinates *positions, size_t count)
+{
+    struct ln_lnlat_posn libnova_location = {observer->longitude > 180 ? observer->longitude - 360 : observer->longitude, observer->latitude};
+    // Sidereal time is the costly part, and the same for all objects
+    double sidereal = ln_get_mean_sidereal_time(JD);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        struct ln_equ_posn libnova_object = {objects[i].rightascension * 15.0, objects[i].declination};
+        struct ln_hrz_posn horizontalPos;
+        ln_get_hrz_from_equ_sidereal_time(&libnova_object, &libnova_location, sidereal, &horizontalPos);
+        positions[i].azimuth = range360(180 + horizontalPos.az);
+        positions[i].altitude = horizontalPos.alt;
+    }
+}
+
 
 }
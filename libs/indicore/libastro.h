@@ -30,6 +30,8 @@
 
 #include <libnova/utility.h>
 
+#include <stddef.h>
+
 namespace INDI
 {
 
@@ -115,6 +117,49 @@ void EquatorialToHorizontal(IEquatorialCoordinates *object, IGeographicCoordinat
 void HorizontalToEquatorial(IHorizontalCoordinates *object, IGeographicCoordinates *observer, double JD,
                             IEquatorialCoordinates *position);
 
+/**
+ * \brief Terms of the J2000 / observed conversions that only depend on the epoch.
+ *
+ * They cost more to compute than to apply, so conversions of many positions for one epoch share them.
+ * J2000toObserved and ObservedToJ2000 keep a context per thread, computed again once the epoch
+ * moved by more than EPOCH_CONTEXT_REFRESH days. Positions then drift by well under a milliarcsecond.
+ */
+typedef struct
+{
+    double jd;                      /*!< Julian day of the terms */
+    double precession[3][3];        /*!< Rotation of J2000 vectors to the epoch */
+    double unprecession[3][3];      /*!< Rotation of epoch vectors to J2000 */
+    double nutationLongitude;       /*!< Nutation in longitude, degrees */
+    double nutationObliquity;       /*!< Nutation in obliquity, degrees */
+    double nutationEcliptic;        /*!< True obliquity of the ecliptic, radians */
+    double aberration[3];           /*!< Earth velocity divided by the speed of light, equatorial axes */
+} IEpochContext;
+
+#define EPOCH_CONTEXT_REFRESH (5.0 / 86400.0)
+
+/**
+* \brief ComputeEpochContext computes the precession, nutation and aberration terms of the epoch jd
+*/
+void ComputeEpochContext(double jd, IEpochContext *context);
+
+/**
+* \brief J2000toObserved converts count J2000 catalogue positions to observed positions for the epoch of context
+*/
+void J2000toObserved(const IEpochContext *context, const IEquatorialCoordinates *J2000pos, IEquatorialCoordinates *observed,
+                     size_t count);
+
+/**
+* \brief ObservedToJ2000 converts count observed positions for the epoch of context to J2000 catalogue positions
+*/
+void ObservedToJ2000(const IEpochContext *context, const IEquatorialCoordinates *observed, IEquatorialCoordinates *J2000pos,
+                     size_t count);
+
+/**
+ * @brief EquatorialToHorizontal Calculate horizontal coordinates of count objects, sharing the sidereal time of JD.
+ */
+void EquatorialToHorizontal(const IEquatorialCoordinates *objects, IGeographicCoordinates *observer, double JD,
+                            IHorizontalCoordinates *positions, size_t count);
+
 /**
 * \brief ln_get_equ_nut applies or removes nutation in place for the epoch JD
 * \param posn position, nutation is applied or removed in place
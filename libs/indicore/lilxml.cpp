@@ -35,6 +35,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
 
 #if defined(_MSC_VER)
 #define snprintf _snprintf
@@ -45,6 +46,12 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110 - 1301  USA
 
 #include "lilxml.h"
 
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 /* used to efficiently manage growing malloced string space */
 typedef struct
 {
@@ -53,6 +60,7 @@ typedef struct
     int sm;  /* total malloced bytes */
 } String;
 #define MINMEM 64 /* starting string length */
+#define MINVIEW 1024 /* shortest pcdata worth referencing in place */
 
 static int oneXMLchar(LilXML *lp, int c, char ynot[]);
 static void initParser(LilXML *lp);
@@ -65,8 +73,19 @@ static void freeAtt(XMLAtt *a);
 static int isTokenChar(int start, int c);
 static void growString(String *sp, int c);
 static void appendString(String *sp, const char *str);
+static void appendStringN(String *sp, const char *str, int n);
+static int scanContent(const char *s, int n);
 static void freeString(String *sp);
 static void newString(String *sp);
+static String *ownPcdata(XMLEle *ep);
+static void freePcdata(XMLEle *ep);
+static void saxStart(LilXML *lp);
+static void saxText(LilXML *lp);
+static void saxEnd(LilXML *lp);
+static int isAtom(const char *s);
+static void internString(String *sp);
+static int knownSlot(const char *name);
+static void noteAtt(XMLEle *ep, XMLAtt *ap);
 static void *moremem(void *old, size_t n);
 static void appXMLEle(XMLEle *ep, XMLEle *newep);
 
@@ -89,6 +108,19 @@ typedef enum
     INCLOSETAG      /* reading closing tag */
 } State;            /* parsing states */
 
+/* a caller buffer given to parseXMLChunkShared(), counted by the elements
+ * whose pcdata point into it and by the parse call itself
+ */
+typedef struct
+{
+    char *buf;
+    void (*release)(char *buf, void *arg);
+    void *arg;
+    int refs;
+} SharedBuf;
+
+static void unrefSharedBuf(SharedBuf *sb);
+
 /* maintain state while parsing */
 struct LilXML_
 {
@@ -101,6 +133,21 @@ struct LilXML_
     int lastc;     /* last char (just used with skipping)*/
     int skipping;  /* in comment or declaration */
     int inblob;    /* in oneBLOB element */
+    const char *pcstart; /* where the first char of pcdata is in the chunk being parsed, if it is */
+    SharedBuf *shared; /* buffer being parsed if it may be referenced */
+    const XMLSaxHandler *sax; /* report events instead of building trees */
+    void *saxctx;             /* passed to sax callbacks */
+};
+
+/* attributes looked up on most every INDI element, see knownSlot() */
+enum
+{
+    KNOWN_DEVICE,
+    KNOWN_NAME,
+    KNOWN_STATE,
+    KNOWN_TIMESTAMP,
+    KNOWN_FORMAT,
+    NKNOWN
 };
 
 /* internal representation of a (possibly nested) XML element */
@@ -116,6 +163,8 @@ struct xml_ele_
     int eit;           /* used to iterate over el[] */
     String pcdata;     /* character data in this element */
     int pcdata_hasent; /* 1 if pcdata contains an entity char*/
+    SharedBuf *pcbuf;  /* if set, pcdata.s points into it and is not ours */
+    XMLAtt *known[NKNOWN]; /* first attribute of each well known name, or NULL */
 };
 
 /* internal representation of an attribute */
@@ -126,11 +175,26 @@ struct xml_att_
     XMLEle *ce;  /* containing element */
 };
 
+/* the INDI vocabulary. tags and attribute names found here point to their
+ * entry instead of a copy of their own, so they compare by address.
+ * N.B. keep sorted for bsearch.
+ */
+static const char atoms[][16] =
+{
+    "attached", "defBLOB", "defBLOBVector", "defLight", "defLightVector", "defNumber", "defNumberVector",
+    "defSwitch", "defSwitchVector", "defText", "defTextVector", "delProperty", "device", "enableBLOB", "enclen",
+    "format", "getProperties", "group", "label", "len", "max", "message", "min", "name", "newBLOBVector",
+    "newNumberVector", "newSwitchVector", "newTextVector", "oneBLOB", "oneLight", "oneNumber", "oneSwitch",
+    "oneText", "perm", "pingReply", "pingRequest", "rule", "setBLOBVector", "setLightVector", "setNumberVector",
+    "setSwitchVector", "setTextVector", "size", "state", "step", "timeout", "timestamp", "uid", "version",
+};
+#define NATOMS ((int)(sizeof(atoms) / sizeof(atoms[0])))
+
 /* characters that need escaping as "entities" in attr values and pcdata
  */
 static char entities[] = "&<>'\"";
 
-/* default memory managers, override with lilxmlMalloc() */
+/* default memory managers, override with indi_xmlMalloc() */
 static void *(*mymalloc)(size_t size)             = malloc;
 static void *(*myrealloc)(void *ptr, size_t size) = realloc;
 static void (*myfree)(void *ptr)                  = free;
@@ -138,14 +202,21 @@ static void (*myfree)(void *ptr)                  = free;
 /* install new version of malloc/realloc/free.
  * N.B. don't call after first use of any other lilxml function
  */
-void lilxmlMalloc(void *(*newmalloc)(size_t size), void *(*newrealloc)(void *ptr, size_t size),
-                  void (*newfree)(void *ptr))
+void indi_xmlMalloc(void *(*newmalloc)(size_t size), void *(*newrealloc)(void *ptr, size_t size),
+                    void (*newfree)(void *ptr))
 {
     mymalloc  = newmalloc;
     myrealloc = newrealloc;
     myfree    = newfree;
 }
 
+/* former name, kept for binary compatibility */
+void lilxmlMalloc(void *(*newmalloc)(size_t size), void *(*newrealloc)(void *ptr, size_t size),
+                  void (*newfree)(void *ptr))
+{
+    indi_xmlMalloc(newmalloc, newrealloc, newfree);
+}
+
 /* pass back a fresh handle for use with our other functions */
 LilXML *newLilXML()
 {
@@ -163,6 +234,12 @@ void delLilXML(LilXML *lp)
     (*myfree)(lp);
 }
 
+void setXMLSaxHandler(LilXML *lp, const XMLSaxHandler *handler, void *ctx)
+{
+    lp->sax    = handler;
+    lp->saxctx = ctx;
+}
+
 /* delete ep and all its children and remove from parent's list if known */
 void delXMLEle(XMLEle *ep)
 {
@@ -174,7 +251,7 @@ void delXMLEle(XMLEle *ep)
 
     /* delete all parts of ep */
     freeString(&ep->tag);
-    freeString(&ep->pcdata);
+    freePcdata(ep);
     if (ep->at)
     {
         for (i = 0; i < ep->nat; i++)
@@ -220,11 +297,14 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
     char *curr     = buf;
     int s;
     ynot[0] = '\0';
+    lp->pcstart = NULL;
 
     if (lp->inblob)
     {
 #ifdef WITH_ENCLEN
-        if (size < lp->ce->pcdata.sm - lp->ce->pcdata.sl)
+        /* only swallow the chunk whole if it can not hold the closing tag */
+        if (!lp->ce->pcbuf && size < lp->ce->pcdata.sm - lp->ce->pcdata.sl && lp->lastc != '<' &&
+                scanContent(buf, size) == size)
         {
             memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
             lp->ce->pcdata.sl += size;
@@ -249,10 +329,10 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
     }
     else
     {
-        if (lp->ce)
+        if (lp->ce && !lp->sax)
         {
             char *ctag = tagXMLEle(lp->ce);
-            if (ctag && !(strcmp(ctag, "oneBLOB")) && (lp->cs == INCON))
+            if (ctag && !(strcmp(ctag, "oneBLOB")) && (lp->cs == INCON) && !lp->ce->pcbuf)
             {
 #ifdef WITH_ENCLEN
                 XMLAtt *blenatt = findXMLAtt(lp->ce, "enclen");
@@ -267,7 +347,7 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
                     lp->ce->pcdata.s  = (char *)moremem(lp->ce->pcdata.s, blen);
                     lp->ce->pcdata.sm = blen; // always set sm
 
-                    if (size <= blen - lp->ce->pcdata.sl)
+                    if (size < blen - lp->ce->pcdata.sl && lp->lastc != '<' && scanContent(buf, size) == size)
                     {
                         memcpy((void *)(lp->ce->pcdata.s + lp->ce->pcdata.sl), (const void *)buf, size);
                         lp->ce->pcdata.sl += size;
@@ -295,6 +375,40 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
     }
     while (curr - buf < size)
     {
+        /* bulk copy plain content up to the next char that changes state */
+        if (lp->cs == INCON && !lp->skipping && lp->lastc != '<')
+        {
+            int n = scanContent(curr, size - int(curr - buf));
+            if (n > 0)
+            {
+                const char *nl = curr;
+                while ((nl = (const char *)memchr(nl, '\n', curr + n - nl)) != NULL)
+                {
+                    lp->ln++;
+                    nl++;
+                }
+                String *pcdata = &lp->ce->pcdata;
+                if (lp->shared && !lp->ce->pcbuf && pcdata->sl == 1 && lp->pcstart == curr - 1 && n >= MINVIEW &&
+                        curr + n < buf + size && curr[n] == '<')
+                {
+                    /* the whole content is in buf: reference it instead of copying.
+                     * its first char went to pcdata through LOOK4CON just before,
+                     * from the byte right before curr.
+                     */
+                    freeString(pcdata);
+                    pcdata->s  = curr - 1;
+                    pcdata->sl = n + 1;
+                    lp->ce->pcbuf = lp->shared;
+                    lp->shared->refs++;
+                }
+                else
+                    appendStringN(ownPcdata(lp->ce), curr, n);
+                lp->lastc = curr[n - 1];
+                curr += n;
+                continue;
+            }
+        }
+
         char newc = *curr;
         /* EOF? */
         if (newc == 0)
@@ -345,7 +459,10 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
         }
 
         /* process newc (at last!) */
+        State was = lp->cs;
         s = oneXMLchar(lp, newc, ynot);
+        if (was == LOOK4CON && lp->cs == INCON)
+            lp->pcstart = curr;
         if (s == 0)
         {
             lp->lastc = newc;
@@ -359,6 +476,14 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
             continue;
         }
 
+        /* events were reported as it went, the tree is of no more use */
+        if (lp->sax)
+        {
+            initParser(lp);
+            curr++;
+            continue;
+        }
+
         /* Ok! store ce in nodes and we start over.
          * N.B. up to caller to call delXMLEle with what we return.
          */
@@ -370,12 +495,32 @@ XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char ynot[])
         initParser(lp);
         curr++;
     }
+    /* stream out the content seen so far */
+    if (lp->cs == INCON)
+        saxText(lp);
     /*
      * N.B. up to caller to free nodes.
      */
     return nodes;
 }
 
+XMLEle **parseXMLChunkShared(LilXML *lp, char *buf, int size, char ynot[], void (*release)(char *buf, void *arg),
+                             void *arg)
+{
+    SharedBuf *sb = (SharedBuf *)moremem(NULL, sizeof * sb);
+    sb->buf     = buf;
+    sb->release = release;
+    sb->arg     = arg;
+    sb->refs    = 1;
+
+    lp->shared     = sb;
+    XMLEle **nodes = parseXMLChunk(lp, buf, size, ynot);
+    lp->shared     = NULL;
+
+    unrefSharedBuf(sb);
+    return nodes;
+}
+
 /* process one more character of an XML file.
  * when find closure with outer element return root of complete tree.
  * when find error return NULL with reason in ynot[].
@@ -446,6 +591,12 @@ XMLEle *readXMLEle(LilXML *lp, int newc, char ynot[])
         return (NULL);
     }
 
+    if (lp->sax)
+    {
+        initParser(lp);
+        return (NULL);
+    }
+
     /* Ok! return ce and we start over.
      * N.B. up to caller to call delXMLEle with what we return.
      */
@@ -524,6 +675,19 @@ XMLEle * cloneXMLEle(XMLEle * ep, int (*replace)(void * self, XMLEle * source, X
 XMLAtt *findXMLAtt(XMLEle *ep, const char *name)
 {
     int i;
+    int slot = knownSlot(name);
+
+    if (slot >= 0)
+        return (ep->known[slot]);
+
+    /* atom names are always interned, so the address is enough */
+    if (isAtom(name))
+    {
+        for (i = 0; i < ep->nat; i++)
+            if (ep->at[i]->name.s == name)
+                return (ep->at[i]);
+        return (NULL);
+    }
 
     for (i = 0; i < ep->nat; i++)
         if (!strcmp(ep->at[i]->name.s, name))
@@ -536,9 +700,19 @@ XMLAtt *findXMLAtt(XMLEle *ep, const char *name)
  */
 XMLEle *findXMLEle(XMLEle *ep, const char *tag)
 {
-    int tl = (int)strlen(tag);
+    int tl;
     int i;
 
+    if (isAtom(tag))
+    {
+        for (i = 0; i < ep->nel; i++)
+            if (ep->el[i]->tag.s == tag)
+                return (ep->el[i]);
+        return (NULL);
+    }
+
+    tl = (int)strlen(tag);
+
     for (i = 0; i < ep->nel; i++)
     {
         String *sp = &ep->el[i]->tag;
@@ -671,6 +845,7 @@ XMLEle *addXMLEle(XMLEle *parent, const char *tag)
 {
     XMLEle *ep = growEle(parent);
     appendString(&ep->tag, tag);
+    internString(&ep->tag);
     return (ep);
 }
 
@@ -690,6 +865,7 @@ XMLEle *setXMLEleTag(XMLEle *ep, const char * tag)
     freeString(&ep->tag);
     newString(&ep->tag);
     appendString(&ep->tag, tag);
+    internString(&ep->tag);
     return ep;
 }
 
@@ -697,7 +873,7 @@ XMLEle *setXMLEleTag(XMLEle *ep, const char * tag)
 /* set the pcdata of the given element */
 void editXMLEle(XMLEle *ep, const char *pcdata)
 {
-    freeString(&ep->pcdata);
+    freePcdata(ep);
     appendString(&ep->pcdata, pcdata);
     ep->pcdata_hasent = (strpbrk(pcdata, entities) != NULL);
 }
@@ -707,6 +883,8 @@ XMLAtt *addXMLAtt(XMLEle *ep, const char *name, const char *valu)
 {
     XMLAtt *ap = growAtt(ep);
     appendString(&ap->name, name);
+    internString(&ap->name);
+    noteAtt(ep, ap);
     appendString(&ap->valu, valu);
     return (ap);
 }
@@ -720,8 +898,17 @@ void rmXMLAtt(XMLEle *ep, const char *name)
     {
         if (strcmp(ep->at[i]->name.s, name) == 0)
         {
+            int slot = knownSlot(name);
+
             freeAtt(ep->at[i]);
             memmove(&ep->at[i], &ep->at[i + 1], (--ep->nat - i) * sizeof(XMLAtt *));
+            if (slot >= 0)
+            {
+                /* a duplicate further on takes over */
+                ep->known[slot] = NULL;
+                for (; i < ep->nat; i++)
+                    noteAtt(ep, ep->at[i]);
+            }
             return;
         }
     }
@@ -935,6 +1122,68 @@ size_t sprXMLCDataOffset(XMLEle * root, XMLEle * ep, int level)
     return bxo.cdataFound();
 }
 
+/* XML Output to a growing malloced buffer, noting cdata offsets on the way */
+class GrowXMLOutput: public XMLOutput
+{
+        char * buffer;
+        size_t offset;
+        size_t room;
+        XMLEle ** cdataWatch;
+        size_t * cdataOffset;
+        int ncdata;
+    protected:
+        virtual void cdataCb(XMLEle * ele)
+        {
+            for (int i = 0; i < ncdata; i++)
+                if (cdataWatch[i] == ele)
+                    cdataOffset[i] = offset;
+        }
+    public:
+        GrowXMLOutput(XMLEle ** cdata, size_t * offsets, int n)
+            : XMLOutput(), buffer(nullptr), offset(0), room(0), cdataWatch(cdata), cdataOffset(offsets), ncdata(n)
+        {
+            for (int i = 0; i < ncdata; i++)
+                cdataOffset[i] = (size_t) -1;
+        };
+        virtual ~GrowXMLOutput() {};
+        virtual void put(const char * str, size_t len)
+        {
+            /* keep room for the trailing \0 */
+            if (offset + len >= room)
+            {
+                room = (room ? room * 2 : 1024);
+                if (room <= offset + len)
+                    room = offset + len + 1;
+                buffer = (char *)realloc(buffer, room);
+            }
+            memcpy(buffer + offset, str, len);
+            offset += len;
+        }
+        char * finish()
+        {
+            if (!buffer)
+                put("", 0);
+            buffer[offset] = '\0';
+            return buffer;
+        }
+        size_t size()
+        {
+            return offset;
+        }
+};
+
+/* print ep into a malloced string in one walk.
+ * N.B. set level = 0 on first call
+ * return length of resulting string (sans trailing \0)
+ */
+size_t sprXMLEleAlloc(char **s, XMLEle *ep, int level, XMLEle **cdata, size_t *offsets, int ncdata)
+{
+    GrowXMLOutput gxo(cdata, offsets, ncdata);
+    gxo.putXML(ep, level);
+    *s = gxo.finish();
+    return gxo.size();
+}
+
 void XMLOutput::putEntityXML(const char * s)
 {
     const char *ep = NULL;
@@ -1090,9 +1339,16 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
 
         case INTAG: /* reading tag */
             if (isTokenChar(0, c))
+            {
                 growString(&lp->ce->tag, c);
-            else if (c == '>')
+                break;
+            }
+            internString(&lp->ce->tag);
+            if (c == '>')
+            {
+                saxStart(lp);
                 lp->cs = LOOK4CON;
+            }
             else if (c == '/')
                 lp->cs = SAWSLASH;
             else
@@ -1101,7 +1357,10 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
 
         case LOOK4ATTRN: /* looking for attr name, > or / */
             if (c == '>')
+            {
+                saxStart(lp);
                 lp->cs = LOOK4CON;
+            }
             else if (c == '/')
                 lp->cs = SAWSLASH;
             else if (isTokenChar(1, c))
@@ -1120,9 +1379,14 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
         case SAWSLASH: /* saw / in element opening */
             if (c == '>')
             {
+                saxStart(lp);
+                saxEnd(lp);
                 if (!lp->ce->pe)
                     return (1); /* root has no content */
+                XMLEle *done = lp->ce;
                 popXMLEle(lp);
+                if (lp->sax)
+                    delXMLEle(done);
                 lp->cs = LOOK4CON;
             }
             else
@@ -1136,7 +1400,11 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
             if (isTokenChar(0, c))
                 growString(&lp->ce->at[lp->ce->nat - 1]->name, c);
             else if (isspace(c) || c == '=')
+            {
+                internString(&lp->ce->at[lp->ce->nat - 1]->name);
+                noteAtt(lp->ce, lp->ce->at[lp->ce->nat - 1]);
                 lp->cs = LOOK4ATTRV;
+            }
             else
             {
                 sprintf(ynot, "Line %d: Bogus attr name char: %c", lp->ln, c);
@@ -1191,7 +1459,7 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
                 lp->cs = SAWLTINCON;
             else if (!isspace(c))
             {
-                growString(&lp->ce->pcdata, c);
+                growString(ownPcdata(lp->ce), c);
                 lp->cs = INCON;
             }
             break;
@@ -1208,11 +1476,15 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
                 /* chomp trailing whitespace */
                 while (lp->ce->pcdata.sl > 0 && isspace(lp->ce->pcdata.s[lp->ce->pcdata.sl - 1]))
                     lp->ce->pcdata.s[--(lp->ce->pcdata.sl)] = '\0';
+                /* a referenced pcdata ends on this very '<', already consumed */
+                if (lp->ce->pcbuf)
+                    lp->ce->pcdata.s[lp->ce->pcdata.sl] = '\0';
+                saxText(lp);
                 lp->cs = SAWLTINCON;
             }
             else
             {
-                growString(&lp->ce->pcdata, c);
+                growString(ownPcdata(lp->ce), c);
             }
             break;
 
@@ -1222,10 +1494,10 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
                 /* if find a recognized esc seq, add equiv char else raw seq */
                 growString(&lp->entity, c);
                 if (decodeEntity(lp->entity.s, &c))
-                    growString(&lp->ce->pcdata, c);
+                    growString(ownPcdata(lp->ce), c);
                 else
                 {
-                    appendString(&lp->ce->pcdata, lp->entity.s);
+                    appendString(ownPcdata(lp->ce), lp->entity.s);
                     //lp->ce->pcdata_hasent = 1;
                 }
                 // JM 2018-09-26: Even if decoded, we always set
@@ -1281,9 +1553,13 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
                     sprintf(ynot, "Line %d: closing tag %s does not match %s", lp->ln, lp->endtag.s, lp->ce->tag.s);
                     return (-1);
                 }
-                else if (lp->ce->pe)
+                saxEnd(lp);
+                if (lp->ce->pe)
                 {
+                    XMLEle *done = lp->ce;
                     popXMLEle(lp);
+                    if (lp->sax)
+                        delXMLEle(done);
                     lp->cs = LOOK4CON; /* back to content after nested elem */
                 }
                 else
@@ -1303,9 +1579,16 @@ static int oneXMLchar(LilXML *lp, int c, char ynot[])
 /* set up for a fresh start again */
 static void initParser(LilXML *lp)
 {
+    SharedBuf *shared         = lp->shared;
+    const XMLSaxHandler *sax  = lp->sax;
+    void *saxctx              = lp->saxctx;
+
     delXMLEle(lp->ce);
     freeString(&lp->endtag);
     memset(lp, 0, sizeof(*lp));
+    lp->shared = shared;
+    lp->sax    = sax;
+    lp->saxctx = saxctx;
     newString(&lp->endtag);
     lp->cs = LOOK4START;
     lp->ln = 1;
@@ -1435,6 +1718,227 @@ static void appendString(String *sp, const char *str)
     }
 }
 
+/* append n chars at str to the String storage at *sp */
+static void appendStringN(String *sp, const char *str, int n)
+{
+    int l = sp->sl + n + 1; /* need room for '\0' */
+
+    if (!sp->s)
+        newString(sp);
+    if (l > sp->sm)
+    {
+        int sm = sp->sm * 2;
+        sp->s  = (char *)moremem(sp->s, (sp->sm = sm > l ? sm : l));
+    }
+    memcpy(&sp->s[sp->sl], str, n);
+    sp->sl += n;
+    sp->s[sp->sl] = '\0';
+}
+
+/* return the offset of the first '<', '&' or '\0' in the n chars at s, or n
+ * if there is none. these are the only chars that leave INCON.
+ */
+static int scanContent(const char *s, int n)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256i lt32  = _mm256_set1_epi8('<');
+    const __m256i amp32 = _mm256_set1_epi8('&');
+    const __m256i nul32 = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt32), _mm256_cmpeq_epi8(v, amp32)),
+                                    _mm256_cmpeq_epi8(v, nul32));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(m);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i lt  = _mm_set1_epi8('<');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i nul = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, amp)), _mm_cmpeq_epi8(v, nul));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(m);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t lt  = vdupq_n_u8('<');
+    const uint8x16_t amp = vdupq_n_u8('&');
+    for (; i + 16 <= n; i += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t *)(s + i));
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, lt), vceqq_u8(v, amp)), vceqzq_u8(v));
+        if (vmaxvq_u8(m))
+            break; /* pinpoint it below */
+    }
+#endif
+
+    for (; i < n; i++)
+        if (s[i] == '<' || s[i] == '&' || s[i] == '\0')
+            break;
+    return i;
+}
+
+/* make the pcdata of ep a String of its own again, copying it out of the
+ * shared buffer it may point into. return it for growing.
+ */
+static String *ownPcdata(XMLEle *ep)
+{
+    if (ep->pcbuf)
+    {
+        String *sp = &ep->pcdata;
+        int sm     = sp->sl + MINMEM;
+        char *s    = (char *)moremem(NULL, sm);
+
+        memcpy(s, sp->s, sp->sl);
+        s[sp->sl] = '\0';
+        sp->s     = s;
+        sp->sm    = sm;
+        unrefSharedBuf(ep->pcbuf);
+        ep->pcbuf = NULL;
+    }
+    return &ep->pcdata;
+}
+
+/* discard the pcdata of ep, wherever it lives */
+static void freePcdata(XMLEle *ep)
+{
+    if (ep->pcbuf)
+    {
+        unrefSharedBuf(ep->pcbuf);
+        ep->pcbuf     = NULL;
+        ep->pcdata.s  = NULL;
+        ep->pcdata.sl = 0;
+        ep->pcdata.sm = 0;
+    }
+    else
+        freeString(&ep->pcdata);
+}
+
+/* report the start of ce and its attributes */
+static void saxStart(LilXML *lp)
+{
+    const XMLSaxHandler *h = lp->sax;
+
+    if (!h)
+        return;
+    if (h->startElement)
+        (*h->startElement)(lp->saxctx, lp->ce->tag.s);
+    if (h->attribute)
+        for (int i = 0; i < lp->ce->nat; i++)
+            (*h->attribute)(lp->saxctx, lp->ce->at[i]->name.s, lp->ce->at[i]->valu.s);
+}
+
+/* report the pcdata collected in ce since last time, then forget it */
+static void saxText(LilXML *lp)
+{
+    const XMLSaxHandler *h = lp->sax;
+    String *sp;
+
+    if (!h || !lp->ce || lp->ce->pcdata.sl == 0)
+        return;
+    sp = &lp->ce->pcdata;
+    if (h->text)
+        (*h->text)(lp->saxctx, sp->s, sp->sl);
+    if (lp->ce->pcbuf)
+    {
+        freePcdata(lp->ce);
+        newString(sp);
+    }
+    else
+    {
+        sp->sl    = 0;
+        sp->s[0] = '\0';
+    }
+}
+
+/* report the end of ce */
+static void saxEnd(LilXML *lp)
+{
+    const XMLSaxHandler *h = lp->sax;
+
+    if (h && h->endElement)
+        (*h->endElement)(lp->saxctx, lp->ce->tag.s);
+}
+
+/* return 1 if s is one of atoms[] itself, not just equal to it */
+static int isAtom(const char *s)
+{
+    uintptr_t p = (uintptr_t)s;
+    return (p >= (uintptr_t)atoms[0] && p < (uintptr_t)atoms[NATOMS]);
+}
+
+static int compareAtom(const void *key, const void *atom)
+{
+    return strcmp((const char *)key, (const char *)atom);
+}
+
+/* return the atom spelled name, else name itself */
+const char *internXMLName(const char *name)
+{
+    const char *atom = (const char *)bsearch(name, atoms, NATOMS, sizeof(atoms[0]), compareAtom);
+    return (atom ? atom : name);
+}
+
+/* return the index in XMLEle.known of attributes called name, else -1.
+ * costs at most one strcmp, whatever the number of attributes.
+ */
+static int knownSlot(const char *name)
+{
+    switch (name[0])
+    {
+        case 'd':
+            return (strcmp(name, "device") ? -1 : KNOWN_DEVICE);
+        case 'n':
+            return (strcmp(name, "name") ? -1 : KNOWN_NAME);
+        case 's':
+            return (strcmp(name, "state") ? -1 : KNOWN_STATE);
+        case 't':
+            return (strcmp(name, "timestamp") ? -1 : KNOWN_TIMESTAMP);
+        case 'f':
+            return (strcmp(name, "format") ? -1 : KNOWN_FORMAT);
+    }
+    return (-1);
+}
+
+/* remember ap in its known slot of ep, unless an earlier one holds it */
+static void noteAtt(XMLEle *ep, XMLAtt *ap)
+{
+    int slot = knownSlot(ap->name.s);
+
+    if (slot >= 0 && !ep->known[slot])
+        ep->known[slot] = ap;
+}
+
+/* make sp point to its atom if it has one, sm 0 telling it is not ours */
+static void internString(String *sp)
+{
+    const char *atom = internXMLName(sp->s);
+
+    if (atom == sp->s)
+        return;
+    freeString(sp);
+    sp->s  = (char *)atom;
+    sp->sl = (int)strlen(atom);
+}
+
+/* drop one reference to sb, handing the buffer back on the last one */
+static void unrefSharedBuf(SharedBuf *sb)
+{
+    if (--sb->refs > 0)
+        return;
+    if (sb->release)
+        (*sb->release)(sb->buf, sb->arg);
+    (*myfree)(sb);
+}
+
 /* init a String with a malloced string containing just \0 */
 static void newString(String *sp)
 {
@@ -1450,7 +1954,7 @@ static void newString(String *sp)
 /* free memory used by the given String */
 static void freeString(String *sp)
 {
-    if (sp->s)
+    if (sp->s && sp->sm)
         (*myfree)(sp->s);
     sp->s  = NULL;
     sp->sl = 0;
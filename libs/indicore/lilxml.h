@@ -107,6 +107,54 @@ extern void delXMLEle(XMLEle *e);
  */
 extern XMLEle **parseXMLChunk(LilXML *lp, char *buf, int size, char errmsg[]);
 
+/** \brief Process an XML chunk, handing its storage over to the parser.
+    Same as parseXMLChunk(), except that the pcdata of large elements lying whole within buf (typically oneBLOB
+    payloads) may point into buf instead of being copied, and bytes already consumed may be overwritten.
+    buf must stay valid and untouched by the caller until release(buf, arg) is called, which happens once no
+    element refers to it any more, possibly before this returns.
+    \param lp a pointer to a lilxml parser.
+    \param buf buffer to process.
+    \param size size of buf
+    \param errmsg a buffer to store error messages if an error in parsing is encountered.
+    \param release called with buf and arg when buf is no longer needed. May be NULL.
+    \param arg passed to release.
+    \return same as parseXMLChunk().
+ */
+extern XMLEle **parseXMLChunkShared(LilXML *lp, char *buf, int size, char errmsg[],
+                                    void (*release)(char *buf, void *arg), void *arg);
+
+/** \brief Return the interned copy of a name of the INDI vocabulary.
+    Tags and attribute names of that vocabulary all share one copy. Looking them up with findXMLAtt(),
+    findXMLAttValu() or findXMLEle() by the interned copy compares addresses instead of strings.
+    \param name a tag or attribute name.
+    \return the interned copy of name, or name itself if it is not part of the vocabulary.
+ */
+extern const char *internXMLName(const char *name);
+
+/** \brief Callbacks of the event based parsing, see setXMLSaxHandler(). Any of them may be NULL. */
+typedef struct
+{
+    /** an element starts, its attributes are reported right after */
+    void (*startElement)(void *ctx, const char *tag);
+    /** one attribute of the element just started, entities decoded */
+    void (*attribute)(void *ctx, const char *name, const char *value);
+    /** a piece of the content of the current element, entities decoded. not nul terminated */
+    void (*text)(void *ctx, const char *text, int len);
+    /** the current element ends */
+    void (*endElement)(void *ctx, const char *tag);
+} XMLSaxHandler;
+
+/** \brief Report parsing events instead of building element trees.
+    Once set, parseXMLChunk() and readXMLEle() call back handler as the input goes and never return elements.
+    Only the tags and attributes of the elements still open are kept, so large content is streamed out in text
+    pieces as it arrives, at most one per chunk between two markups. Leading content whitespace is skipped as usual,
+    trailing whitespace is only trimmed within the last piece.
+    \param lp a pointer to a lilxml parser.
+    \param handler the callbacks, which must outlive their use. NULL restores the normal behaviour.
+    \param ctx passed back to every callback.
+ */
+extern void setXMLSaxHandler(LilXML *lp, const XMLSaxHandler *handler, void *ctx);
+
 /** \brief Process an XML one char at a time.
   \param lp a pointer to a lilxml parser.
   \param c one character to process.
@@ -298,6 +346,19 @@ extern size_t sprlXMLEle(XMLEle *ep, int level);
 */
 extern size_t sprXMLCDataOffset(XMLEle * root, XMLEle * child, int level);
 
+/** \brief print ep into a new string in a single walk, noting where some cdata start on the way.
+*   Replaces a sprlXMLEle(), sprXMLEle() and sprXMLCDataOffset() sequence.
+*   N.B. set level = 0 on first call.
+*   \param s receives the nul terminated result, to be released with free().
+*   \param ep the element to print.
+*   \param level indent level.
+*   \param cdata elements of ep whose cdata offset is wanted, may be NULL if ncdata is 0.
+*   \param offsets receives the offset of the cdata of each of cdata, or (size_t)-1 if it is not printed.
+*   \param ncdata number of entries in cdata and offsets.
+*   \return return length of resulting string (sans trailing @\0@)
+*/
+extern size_t sprXMLEleAlloc(char **s, XMLEle *ep, int level, XMLEle **cdata, size_t *offsets, int ncdata);
+
 /* install alternatives to malloc/realloc/free */
 extern void indi_xmlMalloc(void *(*newmalloc)(size_t size), void *(*newrealloc)(void *ptr, size_t size),
                            void (*newfree)(void *ptr));
@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <stdio.h>
+#include <string.h>
 
 #if defined(__unix__) || defined(__unix) || (defined(__APPLE__) && defined(__MACH__))
 #include <unistd.h>
@@ -67,13 +68,69 @@ static size_t allocation(size_t storage)
 #ifdef ENABLE_INDI_SHARED_MEMORY
 static void sharedBufferAdd(shared_buffer * sb);
 static shared_buffer * sharedBufferRemove(void * mapstart);
+
+// Freed buffers that were never shared keep their memory for the next IDSharedBlobAlloc.
+// Shared ones can't be reused: the other side may still be reading them.
+#define POOL_MAX_BUFFERS 4
+#define POOL_MAX_BYTES (256 * BLOB_SIZE_UNIT)
+
+static shared_buffer * pool[POOL_MAX_BUFFERS];
+static int poolCount = 0;
+static size_t poolBytes = 0;
+
+/* Smallest pooled buffer that can hold size, else NULL */
+static shared_buffer * poolTake(size_t size)
+{
+    int best = -1;
+
+    pthread_mutex_lock(&shared_buffer_mutex);
+    for (int i = 0; i < poolCount; i++)
+    {
+        if (pool[i]->allocated >= size && (best == -1 || pool[i]->allocated < pool[best]->allocated))
+            best = i;
+    }
+
+    shared_buffer * sb = NULL;
+    if (best != -1)
+    {
+        sb = pool[best];
+        pool[best] = pool[--poolCount];
+        poolBytes -= sb->allocated;
+    }
+    pthread_mutex_unlock(&shared_buffer_mutex);
+    return sb;
+}
+
+/* Keep sb for reuse, 0 if the pool is full */
+static int poolGive(shared_buffer * sb)
+{
+    int kept = 0;
+
+    pthread_mutex_lock(&shared_buffer_mutex);
+    if (!sb->sealed && poolCount < POOL_MAX_BUFFERS && poolBytes + sb->allocated <= POOL_MAX_BYTES)
+    {
+        pool[poolCount++] = sb;
+        poolBytes += sb->allocated;
+        kept = 1;
+    }
+    pthread_mutex_unlock(&shared_buffer_mutex);
+    return kept;
+}
 #endif
 static shared_buffer * sharedBufferFind(void * mapstart);
 
 void * IDSharedBlobAlloc(size_t size)
 {
 #ifdef ENABLE_INDI_SHARED_MEMORY
-    shared_buffer * sb = (shared_buffer*)malloc(sizeof(shared_buffer));
+    shared_buffer * sb = poolTake(size);
+    if (sb != NULL)
+    {
+        sb->size = size;
+        sharedBufferAdd(sb);
+        return sb->mapstart;
+    }
+
+    sb = (shared_buffer*)malloc(sizeof(shared_buffer));
     if (sb == NULL) goto ERROR;
 
     sb->size = size;
@@ -147,6 +204,11 @@ void IDSharedBlobFree(void * ptr)
         return;
     }
 
+    if (poolGive(sb))
+    {
+        return;
+    }
+
     if (munmap(sb->mapstart, sb->allocated) == -1)
     {
         perror("shared buffer munmap");
@@ -262,6 +324,52 @@ static void seal(shared_buffer * sb)
 #endif
 }
 
+int IDSharedBlobCopyFd(const void * data, size_t size)
+{
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    int fd = shm_open_anon();
+    if (fd == -1)
+    {
+        return -1;
+    }
+
+    int ret = ftruncate(fd, allocation(size));
+    if (ret == -1) goto ERROR;
+
+#ifdef __linux__
+    // memfd takes plain writes, no need to map it
+    for (size_t done = 0; done < size;)
+    {
+        ssize_t wr = pwrite(fd, (const char *)data + done, size - done, done);
+        if (wr == -1)
+        {
+            if (errno == EINTR) continue;
+            goto ERROR;
+        }
+        done += wr;
+    }
+#else
+    void * map = mmap(0, allocation(size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) goto ERROR;
+    memcpy(map, data, size);
+    munmap(map, allocation(size));
+#endif
+    return fd;
+ERROR:
+    {
+        int e = errno;
+        close(fd);
+        errno = e;
+    }
+    return -1;
+#else
+    (void)data;
+    (void)size;
+    errno = ENOTSUP;
+    return -1;
+#endif
+}
+
 int IDSharedBlobGetFd(void * ptr)
 {
     shared_buffer * sb;
@@ -37,6 +37,12 @@ extern void * IDSharedBlobRealloc(void * ptr, size_t size);
  */
 extern int IDSharedBlobGetFd(void * ptr);
 
+/** \brief Copy bytes into a new shared memory, for sending a buffer that is not a shared blob.
+ *  The memory is not mapped in this process. The caller owns the returned filedescriptor.
+ *  \return the filedescriptor or -1 on error + errno
+ */
+extern int IDSharedBlobCopyFd(const void * data, size_t size);
+
 /** \brief Seal (make readonly) a buffer allocated using IDSharedBlobAlloc. This is automatic when IDNewBlob
  *  \param size_t size of the memory area to allocate
  */
@@ -45,6 +45,13 @@ ssize_t userio_putc(const struct userio *io, void *user, int ch);
 
 // extras
 ssize_t userio_prints(const struct userio *io, void *user, const char *str);
+
+// Room for any number userio_format_number writes, with its terminating null
+#define USERIO_NUMBER_SIZE 32
+
+// print in buff the shortest form of value that reads back as value, whatever the locale. Returns its length
+size_t userio_format_number(char *buff, double value);
+ssize_t userio_printnumber(const struct userio *io, void *user, double value);
 size_t userio_xml_escape(const struct userio *io, void *user, const char *src);
 void userio_xmlv1(const userio *io, void *user);
 
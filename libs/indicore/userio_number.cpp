@@ -0,0 +1,52 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "userio.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+
+// Doubles of smaller magnitude are integers exactly when they have no fraction
+static constexpr double EXACT_INTEGERS = 9007199254740992.0;
+
+size_t userio_format_number(char *buff, double value)
+{
+    char *const last = buff + USERIO_NUMBER_SIZE - 1;
+    std::to_chars_result r;
+
+    // Integers print as they did with %.20g, not in the exponent form to_chars picks when it is shorter
+    if (std::fabs(value) < EXACT_INTEGERS && value == std::trunc(value) && !(value == 0 && std::signbit(value)))
+        r = std::to_chars(buff, last, static_cast<long long>(value));
+    else
+    {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+        // The fewest digits that read back as value
+        r = std::to_chars(buff, last, value);
+#else
+        int const length = snprintf(buff, USERIO_NUMBER_SIZE, "%.17g", value);
+        return length < 0 ? 0 : static_cast<size_t>(length);
+#endif
+    }
+    *r.ptr = '\0';
+    return static_cast<size_t>(r.ptr - buff);
+}
+
+ssize_t userio_printnumber(const struct userio *io, void *user, double value)
+{
+    char buff[USERIO_NUMBER_SIZE];
+    return io->write(user, buff, userio_format_number(buff, value));
+}
@@ -20,6 +20,7 @@
 #include "basedevice_p.h"
 
 #include "base64.h"
+#include "blobcodec.h"
 #include "config.h"
 #include "indicom.h"
 #include "sharedblob.h"
@@ -40,11 +41,11 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
-#include <zlib.h>
 #include <sys/stat.h>
 #include <thread>
 #include <chrono>
 #include <algorithm>
+#include <condition_variable>
 
 #if defined(_MSC_VER)
 #define snprintf _snprintf
@@ -56,6 +57,114 @@
 namespace INDI
 {
 
+/* Runs the decoding jobs of a device in order, on a thread of its own.
+ * The thread keeps the decoder alive, so a device released by its last job does not wait for itself.
+*/
+class BlobDecoder : public std::enable_shared_from_this<BlobDecoder>
+{
+    public:
+        typedef std::function<void(std::vector<uint8_t> &scratch)> Job;
+
+        ~BlobDecoder()
+        {
+            if (thread.joinable())
+                thread.detach();
+        }
+
+        void post(Job job)
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                jobs.push_back(std::move(job));
+                if (!thread.joinable())
+                {
+                    auto self = shared_from_this();
+                    thread = std::thread([self] { self->run(); });
+                }
+            }
+            ready.notify_one();
+        }
+
+        // Pending jobs are dropped, the running one completes
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopped = true;
+                jobs.clear();
+            }
+            ready.notify_one();
+            idle.notify_all();
+            if (thread.joinable())
+            {
+                if (thread.get_id() == std::this_thread::get_id())
+                    thread.detach();
+                else
+                    thread.join();
+            }
+        }
+
+        // Returns once the jobs posted so far are delivered
+        void wait()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (thread.get_id() == std::this_thread::get_id())
+                return;
+            idle.wait(guard, [this] { return stopped || (jobs.empty() && !running); });
+        }
+
+        // Payload buffers of delivered frames, so the next ones do not page in fresh memory
+        std::string takeSpare()
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (spare.empty())
+                return std::string();
+            std::string result = std::move(spare.back());
+            spare.pop_back();
+            return result;
+        }
+
+        void giveSpare(std::string &&buffer)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (spare.size() < 4)
+                spare.push_back(std::move(buffer));
+        }
+
+    private:
+        void run()
+        {
+            // Compressed bytes, reused across frames
+            std::vector<uint8_t> scratch;
+            std::unique_lock<std::mutex> guard(lock);
+            while (true)
+            {
+                ready.wait(guard, [this] { return stopped || !jobs.empty(); });
+                if (stopped)
+                    return;
+                Job job = std::move(jobs.front());
+                jobs.pop_front();
+                running = true;
+                guard.unlock();
+                job(scratch);
+                job = nullptr;
+                guard.lock();
+                running = false;
+                if (jobs.empty())
+                    idle.notify_all();
+            }
+        }
+
+        std::thread thread;
+        std::mutex lock;
+        std::condition_variable ready;
+        std::condition_variable idle;
+        std::deque<Job> jobs;
+        std::vector<std::string> spare;
+        bool running {false};
+        bool stopped {false};
+};
+
 BaseDevicePrivate::BaseDevicePrivate()
 {
     static char indidev[] = "INDIDEV=";
@@ -69,7 +178,21 @@ BaseDevicePrivate::BaseDevicePrivate()
 
 BaseDevicePrivate::~BaseDevicePrivate()
 {
-    pAll.clear();
+    stopBLOBs();
+    clearProperties();
+}
+
+void BaseDevicePrivate::waitBLOBs()
+{
+    if (blobDecoder)
+        blobDecoder->wait();
+}
+
+void BaseDevicePrivate::stopBLOBs()
+{
+    if (blobDecoder)
+        blobDecoder->stop();
+    blobDecoder.reset();
 }
 
 BaseDevice::BaseDevice()
@@ -114,18 +237,22 @@ INDI::PropertyBlob BaseDevice::getBLOB(const char *name) const
 
 IPState BaseDevice::getPropertyState(const char *name) const
 {
-    for (const auto &oneProp : getProperties())
-        if (oneProp.isNameMatch(name))
-            return oneProp.getState();
+    D_PTR(const BaseDevice);
+    std::lock_guard<std::mutex> lock(d->m_Lock);
+
+    if (auto property = d->findProperty(name, INDI_UNKNOWN, false))
+        return property.getState();
 
     return IPS_IDLE;
 }
 
 IPerm BaseDevice::getPropertyPermission(const char *name) const
 {
-    for (const auto &oneProp : getProperties())
-        if (oneProp.isNameMatch(name))
-            return oneProp.getPermission();
+    D_PTR(const BaseDevice);
+    std::lock_guard<std::mutex> lock(d->m_Lock);
+
+    if (auto property = d->findProperty(name, INDI_UNKNOWN, false))
+        return property.getPermission();
 
     return IP_RO;
 }
@@ -141,19 +268,7 @@ INDI::Property BaseDevice::getProperty(const char *name, INDI_PROPERTY_TYPE type
     D_PTR(const BaseDevice);
     std::lock_guard<std::mutex> lock(d->m_Lock);
 
-    for (const auto &oneProp : getProperties())
-    {
-        if (type != oneProp.getType() && type != INDI_UNKNOWN)
-            continue;
-
-        if (!oneProp.getRegistered())
-            continue;
-
-        if (oneProp.isNameMatch(name))
-            return oneProp;
-    }
-
-    return INDI::Property();
+    return d->findProperty(name, type);
 }
 
 BaseDevice::Properties BaseDevice::getProperties()
@@ -207,6 +322,12 @@ int BaseDevice::removeProperty(const char *name, char *errmsg)
 
     if (result != 0)
         snprintf(errmsg, MAXRBUF, "Error: Property %s not found in device %s.", name, getDeviceName());
+    else
+    {
+        auto range = d->propertyIndex.equal_range(std::hash<std::string_view>()(name));
+        for (auto it = range.first; it != range.second;)
+            it = it->second.isNameMatch(name) ? d->propertyIndex.erase(it) : std::next(it);
+    }
 
     return result;
 }
@@ -372,7 +493,9 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
         case INDI_NUMBER:
         {
             INDI::PropertyNumber typedProperty {0};
-            for (const auto &element : root.getElementsByTagName("defNumber"))
+            const auto elements = root.getElementsByTagName("defNumber");
+            typedProperty.reserve(elements.size());
+            for (const auto &element : elements)
             {
                 INDI::WidgetViewNumber widget;
 
@@ -398,7 +521,9 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
         {
             INDI::PropertySwitch typedProperty {0};
             typedProperty.setRule(root.getAttribute("rule"));
-            for (const auto &element : root.getElementsByTagName("defSwitch"))
+            const auto elements = root.getElementsByTagName("defSwitch");
+            typedProperty.reserve(elements.size());
+            for (const auto &element : elements)
             {
                 INDI::WidgetViewSwitch widget;
 
@@ -419,7 +544,9 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
         case INDI_TEXT:
         {
             INDI::PropertyText typedProperty {0};
-            for (const auto &element : root.getElementsByTagName("defText"))
+            const auto elements = root.getElementsByTagName("defText");
+            typedProperty.reserve(elements.size());
+            for (const auto &element : elements)
             {
                 INDI::WidgetViewText widget;
 
@@ -440,7 +567,9 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
         case INDI_LIGHT:
         {
             INDI::PropertyLight typedProperty {0};
-            for (const auto &element : root.getElementsByTagName("defLight"))
+            const auto elements = root.getElementsByTagName("defLight");
+            typedProperty.reserve(elements.size());
+            for (const auto &element : elements)
             {
                 INDI::WidgetViewLight widget;
 
@@ -470,7 +599,9 @@ int BaseDevice::buildProp(const INDI::LilXmlElement &root, char *errmsg, bool is
 #endif
                 blob = nullptr;
             });
-            for (const auto &element : root.getElementsByTagName("defBLOB"))
+            const auto elements = root.getElementsByTagName("defBLOB");
+            typedProperty.reserve(elements.size());
+            for (const auto &element : elements)
             {
                 INDI::WidgetViewBlob widget;
 
@@ -551,6 +682,19 @@ void BaseDevice::detach()
 }
 
 // helper for BaseDevice::setValue
+/* True if a BLOB of root comes in shared memory, attaching it is cheap and done at once */
+static bool hasAttachedBLOBs(const INDI::LilXmlElement &root)
+{
+#ifdef ENABLE_INDI_SHARED_MEMORY
+    for (const auto &element : root.getElementsByTagName("oneBLOB"))
+        if (element.getAttribute("attached-data-id").isValid())
+            return true;
+#else
+    INDI_UNUSED(root);
+#endif
+    return false;
+}
+
 template <typename TypedProperty>
 static void for_property(
     //XMLEle *root,
@@ -623,7 +767,7 @@ int BaseDevice::setValue(const INDI::LilXmlElement &root, char *errmsg)
     // 1. set overall property state, if any
     {
         bool ok = false;
-        property.setState(root.getAttribute("state").toIPState(&ok));
+        IPState state = root.getAttribute("state").toIPState(&ok);
 
         if (!ok)
         {
@@ -631,6 +775,15 @@ int BaseDevice::setValue(const INDI::LilXmlElement &root, char *errmsg)
                      propertyName);
             return -1;
         }
+
+        // BLOBs may be decoded on the thread of the device, the whole update is delivered once they are ready.
+        // Attached BLOBs are delivered at once, after the frames queued before them.
+        if (rootTagType->first == INDI_BLOB && d->threadedBLOBs && !hasAttachedBLOBs(root))
+            return d->queueBLOB(PropertyBlob(property), state, root, errmsg);
+        if (rootTagType->first == INDI_BLOB)
+            d->waitBLOBs();
+
+        property.setState(state);
     }
 
     // 2. allow changing the timeout
@@ -643,6 +796,10 @@ int BaseDevice::setValue(const INDI::LilXmlElement &root, char *errmsg)
             property.setTimeout(timeoutValue);
     }
 
+    // 3. keep the time the values are valid at, the capture time of stream frames
+    if (auto timestamp = root.getAttribute("timestamp"))
+        property.setTimestamp(timestamp.toCString());
+
     // update specific values
     switch (rootTagType->first)
     {
@@ -743,6 +900,21 @@ static bool sSharedToBlob(const INDI::LilXmlElement &element, INDI::WidgetViewBl
 }
 #endif
 
+/* Uncompress a BLOB of codec extension into data, allocated for dataSize bytes, and set dataSize to the bytes written.
+ * Data is reallocated if the BLOB holds more than its size announced.
+ * Return 0 if okay, the error code of the codec otherwise
+*/
+static int uncompressBlob(const std::string &extension, void **data, size_t *dataSize, const void *blob, size_t blobLen)
+{
+    BlobDecompressor decompressor(extension);
+    decompressor.setOutput(*data, *dataSize);
+    int r = decompressor.write(blob, blobLen);
+    if (r == 0)
+        r = decompressor.finish();
+    *data = decompressor.take(dataSize);
+    return r;
+}
+
 /* Set BLOB vector. Process incoming data stream
  * Return 0 if okay, -1 if error
 */
@@ -777,25 +949,26 @@ int BaseDevicePrivate::setBLOB(INDI::PropertyBlob property, const LilXmlElement
             size_t base64_encoded_size = element.context().size();
             size_t base64_decoded_size = 3 * base64_encoded_size / 4;
             widget->setBlob(realloc(widget->getBlob(), base64_decoded_size));
-            int blobLen = from64tobits_fast(static_cast<char *>(widget->getBlob()), element.context(), base64_encoded_size);
+            int blobLen = from64tobits_mt(static_cast<char *>(widget->getBlob()), element.context(), base64_encoded_size);
             widget->setBlobLen(blobLen);
         }
 
-        if (format.endsWith(".z"))
+        std::string extension = BlobDecompressor::codecExtension(format.toString());
+
+        if (!extension.empty())
         {
-            widget->setFormat(format.toString().substr(0, format.lastIndexOf(".z")));
+            widget->setFormat(format.toString().substr(0, format.lastIndexOf(extension)));
 
-            uLongf dataSize = widget->getSize() * sizeof(uint8_t);
-            Bytef *dataBuffer = static_cast<Bytef *>(malloc(dataSize));
+            size_t dataSize = widget->getSize() * sizeof(uint8_t);
+            void *dataBuffer = malloc(dataSize);
 
             if (dataBuffer == nullptr)
             {
                 strncpy(errmsg, "Unable to allocate memory for data buffer", MAXRBUF);
                 return -1;
             }
-            int r = uncompress(dataBuffer, &dataSize, static_cast<unsigned char *>(widget->getBlob()),
-                               static_cast<uLong>(widget->getBlobLen()));
-            if (r != Z_OK)
+            int r = uncompressBlob(extension, &dataBuffer, &dataSize, widget->getBlob(), widget->getBlobLen());
+            if (r != 0)
             {
                 snprintf(errmsg, MAXRBUF, "INDI: %s.%s.%s compression error: %d",
                          property.getDeviceName(), property.getName(), widget->getName(), r);
@@ -822,6 +995,126 @@ int BaseDevicePrivate::setBLOB(INDI::PropertyBlob property, const LilXmlElement
     return 0;
 }
 
+int BaseDevicePrivate::queueBLOB(INDI::PropertyBlob property, IPState state, const LilXmlElement &root, char *errmsg)
+{
+    if (!blobDecoder)
+        blobDecoder = std::make_shared<BlobDecoder>();
+
+    BlobUpdate update;
+    update.property = property;
+    update.state    = state;
+
+    {
+        AutoCNumeric locale;
+        update.timeout = root.getAttribute("timeout").toDouble(&update.hasTimeout);
+    }
+
+    if (auto timestamp = root.getAttribute("timestamp"))
+        update.timestamp = timestamp.toString();
+
+    for (const auto &element : root.getElementsByTagName("oneBLOB"))
+    {
+        auto name   = element.getAttribute("name");
+        auto format = element.getAttribute("format");
+        auto size   = element.getAttribute("size");
+
+        if (!name || !format || !size)
+        {
+            snprintf(errmsg, MAXRBUF, "INDI: %s.%s.%s No valid members.",
+                     property.getDeviceName(), property.getName(), name.toCString()
+                    );
+            return -1;
+        }
+
+        if (size.toInt() == 0)
+            continue;
+
+        BlobUpdate::Element blob;
+        blob.name   = name.toString();
+        blob.format = format.toString();
+        blob.size   = size.toInt();
+        blob.data   = blobDecoder->takeSpare();
+        blob.data.assign(static_cast<const char *>(element.context().data()), element.context().size());
+        update.elements.push_back(std::move(blob));
+    }
+
+    // The job holds the device, it is delivered even if the client lets go of it meanwhile
+    std::shared_ptr<BaseDevicePrivate> device = self.d_ptr;
+    auto shared = std::make_shared<BlobUpdate>(std::move(update));
+    std::weak_ptr<BlobDecoder> decoder = blobDecoder;
+    blobDecoder->post([device, shared, decoder](std::vector<uint8_t> &scratch)
+    {
+        device->decodeBLOB(*shared, scratch);
+        if (auto owner = decoder.lock())
+            for (auto &element : shared->elements)
+                owner->giveSpare(std::move(element.data));
+    });
+
+    return 0;
+}
+
+void BaseDevicePrivate::decodeBLOB(BlobUpdate &update, std::vector<uint8_t> &scratch)
+{
+    INDI::PropertyBlob property = update.property;
+
+    property.setState(update.state);
+    if (update.hasTimeout)
+        property.setTimeout(update.timeout);
+    if (!update.timestamp.empty())
+        property.setTimestamp(update.timestamp.c_str());
+
+    for (auto &element : update.elements)
+    {
+        auto widget = property.findWidgetByName(element.name.c_str());
+        if (widget == nullptr)
+            continue;
+
+        widget->setSize(element.size);
+        std::string extension = BlobDecompressor::codecExtension(element.format);
+        size_t base64_encoded_size = element.data.size();
+        size_t base64_decoded_size = 3 * base64_encoded_size / 4;
+
+        if (extension.empty())
+        {
+            widget->setBlob(realloc(widget->getBlob(), base64_decoded_size));
+            int blobLen = from64tobits_mt(static_cast<char *>(widget->getBlob()), element.data.c_str(), base64_encoded_size);
+            widget->setBlobLen(blobLen);
+            widget->setFormat(element.format);
+            property.emitUpdate();
+            continue;
+        }
+
+        // Decompress straight into the BLOB of the widget, it keeps its size from frame to frame
+        if (scratch.size() < base64_decoded_size)
+            scratch.resize(base64_decoded_size);
+        int compressedLen = from64tobits_mt(reinterpret_cast<char *>(scratch.data()), element.data.c_str(),
+                                            base64_encoded_size);
+
+        size_t dataSize = element.size;
+        void *dataBuffer = realloc(widget->getBlob(), dataSize);
+        if (dataBuffer == nullptr)
+        {
+            IDLog("INDI: %s.%s.%s Unable to allocate memory for data buffer\n",
+                  property.getDeviceName(), property.getName(), widget->getName());
+            return;
+        }
+        int r = compressedLen < 0 ? -1 : uncompressBlob(extension, &dataBuffer, &dataSize, scratch.data(), compressedLen);
+        widget->setBlob(dataBuffer);
+        if (r != 0)
+        {
+            IDLog("INDI: %s.%s.%s compression error: %d\n",
+                  property.getDeviceName(), property.getName(), widget->getName(), r);
+            return;
+        }
+        widget->setSize(dataSize);
+        widget->setBlobLen(compressedLen);
+        widget->setFormat(element.format.substr(0, element.format.rfind(extension)));
+        property.emitUpdate();
+    }
+
+    mediateUpdateProperty(property);
+}
+
 void BaseDevice::setDeviceName(const char *dev)
 {
     D_PTR(BaseDevice);
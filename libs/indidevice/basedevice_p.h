@@ -27,6 +27,10 @@
 #include <string>
 #include <mutex>
 #include <map>
+#include <unordered_map>
+#include <string_view>
+#include <memory>
+#include <vector>
 #include <functional>
 
 #include "indipropertyblob.h"
@@ -36,15 +40,49 @@ namespace INDI
 {
 
 class BaseDevice;
+class BlobDecoder;
 class BaseDevicePrivate
 {
     public:
         BaseDevicePrivate();
         virtual ~BaseDevicePrivate();
 
+        /** @brief A setBLOBVector message, copied out of the XML to be decoded later */
+        struct BlobUpdate
+        {
+            struct Element
+            {
+                std::string name;
+                std::string format;
+                size_t size {0};
+                std::string data; // base64
+            };
+
+            INDI::Property property;
+            IPState state {IPS_IDLE};
+            bool hasTimeout {false};
+            double timeout {0};
+            std::string timestamp;
+            std::vector<Element> elements;
+        };
+
         /** @brief Parse and store BLOB in the respective vector */
         int setBLOB(INDI::PropertyBlob propertyBlob, const INDI::LilXmlElement &root, char *errmsg);
 
+        /** @brief Copy the BLOBs of root for the decoder thread of the device
+         *  @return 0 if queued, -1 with the reason in errmsg otherwise
+         */
+        int queueBLOB(INDI::PropertyBlob propertyBlob, IPState state, const INDI::LilXmlElement &root, char *errmsg);
+
+        /** @brief Decode a queued update into its property, on the decoder thread */
+        void decodeBLOB(BlobUpdate &update, std::vector<uint8_t> &scratch);
+
+        /** @brief Wait for the queued BLOB updates to be delivered */
+        void waitBLOBs();
+
+        /** @brief Drop the queued BLOB updates and wait for the one being delivered, if any */
+        void stopBLOBs();
+
         void emitWatchProperty(const INDI::Property &property, bool isNew)
         {
             auto it = watchPropertyMap.find(property.getName());
@@ -64,11 +102,39 @@ class BaseDevicePrivate
             {
                 std::unique_lock<std::mutex> lock(m_Lock);
                 pAll.push_back(property);
+                propertyIndex.emplace(std::hash<std::string_view>()(property.getName()), property);
             }
 
             emitWatchProperty(property, true);
         }
 
+        /** @brief The first property named name of type, or of any type if INDI_UNKNOWN. m_Lock must be held */
+        INDI::Property findProperty(std::string_view name, INDI_PROPERTY_TYPE type, bool registeredOnly = true) const
+        {
+            auto range = propertyIndex.equal_range(std::hash<std::string_view>()(name));
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                const INDI::Property &property = it->second;
+
+                if (type != property.getType() && type != INDI_UNKNOWN)
+                    continue;
+
+                if (registeredOnly && !property.getRegistered())
+                    continue;
+
+                if (name == property.getName())
+                    return property;
+            }
+            return INDI::Property();
+        }
+
+        /** @brief Forget every property. m_Lock must be held */
+        void clearProperties()
+        {
+            propertyIndex.clear();
+            pAll.clear();
+        }
+
     public: // mediator
         void mediateNewDevice(BaseDevice baseDevice)
         {
@@ -94,6 +160,8 @@ class BaseDevicePrivate
 
         void mediateNewProperty(Property property)
         {
+            if (propertyObserver)
+                propertyObserver(property);
             if (mediator)
             {
 #if INDI_VERSION_MAJOR < 2
@@ -106,6 +174,8 @@ class BaseDevicePrivate
         void mediateUpdateProperty(Property property)
         {
             emitWatchProperty(property, false);
+            if (propertyObserver)
+                propertyObserver(property);
             if (mediator)
             {
                 mediator->updateProperty(property);
@@ -150,6 +220,8 @@ class BaseDevicePrivate
 
         void mediateNewMessage(BaseDevice baseDevice, int messageID)
         {
+            if (messageObserver)
+                messageObserver(baseDevice, messageID);
             if (mediator)
             {
 #if INDI_VERSION_MAJOR < 2
@@ -179,13 +251,22 @@ class BaseDevicePrivate
         BaseDevice self {make_shared_weak(this)}; // backward compatible (for operators as pointer)
         std::string deviceName;
         BaseDevice::Properties pAll;
+        /// pAll by the hash of the names, looked up for every incoming message
+        std::unordered_multimap<size_t, INDI::Property> propertyIndex;
         std::map<std::string, WatchDetails> watchPropertyMap;
         LilXmlParser xmlParser;
 
         INDI::BaseMediator *mediator {nullptr};
+        /// client side observers of the changes, see AbstractBaseClient::subscribeChanges
+        std::function<void(const INDI::Property &)> propertyObserver;
+        std::function<void(const BaseDevice &, int)> messageObserver;
         std::deque<std::string> messageLog;
         mutable std::mutex m_Lock;
 
+        /// Decodes and decompresses BLOBs off the socket thread if threadedBLOBs is set, started with the first one
+        std::shared_ptr<BlobDecoder> blobDecoder;
+        bool threadedBLOBs {false};
+
         bool valid {true};
 };
 
@@ -0,0 +1,486 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "blobcodec.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_CFITSIO
+#include <fitsio.h>
+#endif
+
+namespace INDI
+{
+
+class BlobDecompressorPrivate
+{
+    public:
+        enum Codec { NONE, ZLIB, LZ4, ZSTD };
+
+        explicit BlobDecompressorPrivate(const std::string &extension);
+        ~BlobDecompressorPrivate();
+
+        // Makes room for at least one more byte of output
+        bool grow();
+
+        int writeZlib(const void *data, size_t size);
+#ifdef HAVE_LZ4
+        int writeLz4(const void *data, size_t size);
+#endif
+#ifdef HAVE_ZSTD
+        int writeZstd(const void *data, size_t size);
+#endif
+
+    public:
+        Codec codec {NONE};
+        uint8_t *buffer {nullptr};
+        size_t capacity {0};
+        size_t size {0};
+        bool finished {false};
+
+        z_stream zlib {};
+#ifdef HAVE_LZ4
+        LZ4F_dctx *lz4 {nullptr};
+#endif
+#ifdef HAVE_ZSTD
+        ZSTD_DStream *zstd {nullptr};
+#endif
+};
+
+BlobDecompressorPrivate::BlobDecompressorPrivate(const std::string &extension)
+{
+    if (extension == ".z")
+    {
+        if (inflateInit(&zlib) == Z_OK)
+            codec = ZLIB;
+    }
+#ifdef HAVE_LZ4
+    else if (extension == ".lz4")
+    {
+        if (!LZ4F_isError(LZ4F_createDecompressionContext(&lz4, LZ4F_VERSION)))
+            codec = LZ4;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    else if (extension == ".zst")
+    {
+        zstd = ZSTD_createDStream();
+        if (zstd != nullptr && !ZSTD_isError(ZSTD_initDStream(zstd)))
+            codec = ZSTD;
+    }
+#endif
+}
+
+BlobDecompressorPrivate::~BlobDecompressorPrivate()
+{
+    if (codec == ZLIB)
+        inflateEnd(&zlib);
+#ifdef HAVE_LZ4
+    if (lz4 != nullptr)
+        LZ4F_freeDecompressionContext(lz4);
+#endif
+#ifdef HAVE_ZSTD
+    if (zstd != nullptr)
+        ZSTD_freeDStream(zstd);
+#endif
+    free(buffer);
+}
+
+bool BlobDecompressorPrivate::grow()
+{
+    if (size < capacity)
+        return true;
+
+    size_t newCapacity = std::max<size_t>(capacity * 2, 64 * 1024);
+    auto newBuffer = static_cast<uint8_t *>(realloc(buffer, newCapacity));
+    if (newBuffer == nullptr)
+        return false;
+    buffer = newBuffer;
+    capacity = newCapacity;
+    return true;
+}
+
+int BlobDecompressorPrivate::writeZlib(const void *data, size_t size)
+{
+    zlib.next_in  = static_cast<Bytef *>(const_cast<void *>(data));
+    zlib.avail_in = static_cast<uInt>(size);
+
+    while (!finished)
+    {
+        if (!grow())
+            return Z_MEM_ERROR;
+
+        zlib.next_out  = buffer + this->size;
+        zlib.avail_out = static_cast<uInt>(std::min<size_t>(capacity - this->size, UINT32_MAX));
+        uInt available = zlib.avail_out;
+
+        int r = inflate(&zlib, Z_NO_FLUSH);
+        this->size += available - zlib.avail_out;
+
+        if (r == Z_STREAM_END)
+            finished = true;
+        else if (r == Z_BUF_ERROR && zlib.avail_in == 0)
+            break;
+        else if (r != Z_OK && r != Z_BUF_ERROR)
+            return r;
+        // All the input is in, and there was room left for more output
+        else if (zlib.avail_in == 0 && zlib.avail_out != 0)
+            break;
+    }
+    return 0;
+}
+
+#ifdef HAVE_LZ4
+int BlobDecompressorPrivate::writeLz4(const void *data, size_t size)
+{
+    size_t read = 0;
+    while (!finished)
+    {
+        if (!grow())
+            return -1;
+
+        size_t outLen = capacity - this->size;
+        size_t inLen  = size - read;
+        size_t r = LZ4F_decompress(lz4, buffer + this->size, &outLen, static_cast<const uint8_t *>(data) + read, &inLen, nullptr);
+        if (LZ4F_isError(r))
+            return -1;
+        this->size += outLen;
+        read       += inLen;
+
+        // 0 once the frame is complete
+        if (r == 0)
+            finished = true;
+        else if (read == size && this->size < capacity)
+            break;
+    }
+    return 0;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+int BlobDecompressorPrivate::writeZstd(const void *data, size_t size)
+{
+    ZSTD_inBuffer input = { data, size, 0 };
+    while (!finished)
+    {
+        if (!grow())
+            return -1;
+
+        ZSTD_outBuffer output = { buffer, capacity, this->size };
+        size_t r = ZSTD_decompressStream(zstd, &output, &input);
+        if (ZSTD_isError(r))
+            return -1;
+        this->size = output.pos;
+
+        // 0 once the frame is complete
+        if (r == 0)
+            finished = true;
+        else if (input.pos == input.size && output.pos < output.size)
+            break;
+    }
+    return 0;
+}
+#endif
+
+BlobDecompressor::BlobDecompressor(const std::string &extension)
+    : d_ptr(new BlobDecompressorPrivate(extension))
+{ }
+
+BlobDecompressor::~BlobDecompressor()
+{ }
+
+bool BlobDecompressor::isValid() const
+{
+    D_PTR(const BlobDecompressor);
+    return d->codec != BlobDecompressorPrivate::NONE;
+}
+
+void BlobDecompressor::setOutput(void *buffer, size_t capacity)
+{
+    D_PTR(BlobDecompressor);
+    if (buffer == d->buffer)
+    {
+        d->capacity = capacity;
+        return;
+    }
+    free(d->buffer);
+    d->buffer   = static_cast<uint8_t *>(buffer);
+    d->capacity = buffer != nullptr ? capacity : 0;
+    d->size     = 0;
+}
+
+int BlobDecompressor::write(const void *data, size_t size)
+{
+    D_PTR(BlobDecompressor);
+    switch (d->codec)
+    {
+        case BlobDecompressorPrivate::ZLIB:
+            return d->writeZlib(data, size);
+#ifdef HAVE_LZ4
+        case BlobDecompressorPrivate::LZ4:
+            return d->writeLz4(data, size);
+#endif
+#ifdef HAVE_ZSTD
+        case BlobDecompressorPrivate::ZSTD:
+            return d->writeZstd(data, size);
+#endif
+        default:
+            return -1;
+    }
+}
+
+int BlobDecompressor::finish()
+{
+    D_PTR(BlobDecompressor);
+    if (d->finished)
+        return 0;
+    return d->codec == BlobDecompressorPrivate::ZLIB ? Z_BUF_ERROR : -1;
+}
+
+void *BlobDecompressor::take(size_t *size)
+{
+    D_PTR(BlobDecompressor);
+    void *result = d->buffer;
+    *size = d->size;
+    d->buffer   = nullptr;
+    d->capacity = 0;
+    d->size     = 0;
+    return result;
+}
+
+std::string BlobDecompressor::codecExtension(const std::string &format)
+{
+    auto endsWith = [&format](const std::string &extension)
+    {
+        return format.size() >= extension.size() &&
+               format.compare(format.size() - extension.size(), extension.size(), extension) == 0;
+    };
+
+    if (endsWith(".z"))
+        return ".z";
+#ifdef HAVE_LZ4
+    if (endsWith(".lz4"))
+        return ".lz4";
+#endif
+#ifdef HAVE_ZSTD
+    if (endsWith(".zst"))
+        return ".zst";
+#endif
+    return std::string();
+}
+
+#ifdef HAVE_CFITSIO
+/* The type of the pixels of bitpix, read and written unscaled */
+static int fitsDataType(int bitpix)
+{
+    switch (bitpix)
+    {
+        case BYTE_IMG:
+            return TBYTE;
+        case SHORT_IMG:
+            return TSHORT;
+        case LONG_IMG:
+            return TINT;
+        case LONGLONG_IMG:
+            return TLONGLONG;
+        case FLOAT_IMG:
+            return TFLOAT;
+        case DOUBLE_IMG:
+            return TDOUBLE;
+        default:
+            return 0;
+    }
+}
+
+/* Reads elements [first, first + count) of the image of HDU hdu, each thread opening the file on its own. */
+static int readPixels(fitsfile *fptr, const void *blob, size_t blobLen, int hdu, int type,
+                      LONGLONG first, LONGLONG count, void *pixels)
+{
+    int status = 0, anynull = 0;
+    bool own = fptr == nullptr;
+    if (own)
+    {
+        void *buffer = const_cast<void *>(blob);
+        size_t bufferSize = blobLen;
+        fits_open_memfile(&fptr, "", READONLY, &buffer, &bufferSize, 0, nullptr, &status);
+        fits_movabs_hdu(fptr, hdu, nullptr, &status);
+        fits_set_bscale(fptr, 1.0, 0.0, &status);
+    }
+
+    fits_read_img(fptr, type, first, count, nullptr, pixels, &anynull, &status);
+
+    if (own && fptr != nullptr)
+    {
+        int closeStatus = 0;
+        fits_close_file(fptr, &closeStatus);
+    }
+    return status;
+}
+
+/* Writes the compressed image of HDU hdu of in, decompressed, to out */
+static int decompressImage(fitsfile *in, fitsfile *out, const void *blob, size_t blobLen, int hdu, int threads)
+{
+    int status = 0, bitpix = 0, naxis = 0;
+    long naxes[9] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+
+    fits_img_decompress_header(in, out, &status);
+    fits_get_img_param(in, 9, &bitpix, &naxis, naxes, &status);
+    if (status)
+        return status;
+
+    // Pixels are moved as they are stored, so that scaled images come out bit for bit
+    int type = fitsDataType(bitpix);
+    if (type == 0)
+        return BAD_BITPIX;
+    fits_set_bscale(in, 1.0, 0.0, &status);
+    // The scaling is read from the header once it is complete, not to be read again over the one set here
+    fits_set_hdustruc(out, &status);
+    fits_set_bscale(out, 1.0, 0.0, &status);
+
+    LONGLONG elements = 1;
+    for (int i = 0; i < naxis; i++)
+        elements *= naxes[i];
+    if (naxis == 0 || elements == 0 || status)
+        return status;
+
+    // Threads decompress bands of whole tiles, a tile shared by two threads would be decompressed twice
+    long tileRows = 1;
+    if (naxis > 1)
+    {
+        int keyStatus = 0;
+        if (fits_read_key(in, TLONG, "ZTILE2", &tileRows, nullptr, &keyStatus) || tileRows < 1)
+            tileRows = 1;
+    }
+    LONGLONG band  = static_cast<LONGLONG>(naxes[0]) * tileRows;
+    LONGLONG bands = (elements + band - 1) / band;
+
+    if (threads <= 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    if (!fits_is_reentrant())
+        threads = 1;
+    threads = static_cast<int>(std::min<LONGLONG>(threads, bands));
+
+    size_t pixelSize = std::abs(bitpix) / 8;
+    std::vector<uint8_t> pixels(static_cast<size_t>(elements) * pixelSize);
+
+    std::vector<int> results(threads, 0);
+    std::vector<std::thread> workers;
+    for (int i = threads - 1; i >= 0; i--)
+    {
+        LONGLONG first = std::min(elements, bands * i / threads * band);
+        LONGLONG last  = std::min(elements, bands * (i + 1) / threads * band);
+        uint8_t *target = pixels.data() + first * pixelSize;
+
+        // The calling thread takes the first band, with the file it opened already
+        if (i == 0)
+            results[0] = readPixels(in, blob, blobLen, hdu, type, first + 1, last - first, target);
+        else
+            workers.emplace_back([&results, i, blob, blobLen, hdu, type, first, last, target]
+            {
+                results[i] = readPixels(nullptr, blob, blobLen, hdu, type, first + 1, last - first, target);
+            });
+    }
+    for (auto &worker : workers)
+        worker.join();
+
+    for (int result : results)
+        if (result)
+            return result;
+
+    fits_write_img(out, type, 1, elements, pixels.data(), &status);
+    return status;
+}
+#endif
+
+int decompressFpack(const void *blob, size_t blobLen, void **data, size_t *dataSize, int threads)
+{
+#ifdef HAVE_CFITSIO
+    fitsfile *in = nullptr, *out = nullptr;
+    int status = 0;
+    void *inBuffer = const_cast<void *>(blob);
+    size_t inSize = blobLen;
+    size_t outSize = 2880;
+    void *outBuffer = malloc(outSize);
+
+    if (outBuffer == nullptr)
+        return MEMORY_ALLOCATION;
+
+    fits_open_memfile(&in, "", READONLY, &inBuffer, &inSize, 0, nullptr, &status);
+    fits_create_memfile(&out, &outBuffer, &outSize, 2880, realloc, &status);
+
+    // As fp_unpack_hdu: compressed images are decompressed, the other HDUs copied over
+    for (int hdu = 1; status == 0; hdu++)
+    {
+        int hduType = 0;
+        if (fits_movabs_hdu(in, hdu, &hduType, &status))
+            break;
+
+        int compressedTable = 0;
+        if (hduType == BINARY_TBL && fits_read_key(in, TLOGICAL, "ZTABLE", &compressedTable, nullptr, &status) == KEY_NO_EXIST)
+            status = 0;
+
+        if (hduType == IMAGE_HDU && fits_is_compressed_image(in, &status))
+            status = decompressImage(in, out, blob, blobLen, hdu, threads);
+        else if (compressedTable)
+            fits_uncompress_table(in, out, &status);
+        else
+            fits_copy_hdu(in, out, 0, &status);
+    }
+    if (status == END_OF_FILE)
+        status = 0;
+
+    int closeStatus = 0;
+    if (in != nullptr)
+        fits_close_file(in, &closeStatus);
+    if (out != nullptr)
+    {
+        closeStatus = 0;
+        fits_close_file(out, &closeStatus);
+        if (status == 0)
+            status = closeStatus;
+    }
+
+    if (status)
+    {
+        free(outBuffer);
+        return status;
+    }
+
+    *data = outBuffer;
+    *dataSize = outSize;
+    return 0;
+#else
+    (void)blob;
+    (void)blobLen;
+    (void)data;
+    (void)dataSize;
+    (void)threads;
+    return -1;
+#endif
+}
+
+}
@@ -0,0 +1,95 @@
+/*
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#pragma once
+
+#include "indimacros.h"
+#include <memory>
+#include <string>
+#include <cstddef>
+
+namespace INDI
+{
+
+class BlobDecompressorPrivate;
+/**
+ * @class BlobDecompressor
+ * @brief The BlobDecompressor class decompresses a BLOB as its compressed bytes come in.
+ *
+ * It knows the codecs the drivers compress with: zlib (.z), and LZ4 frames (.lz4) and Zstandard (.zst) when INDI is
+ * built with them. The output buffer grows as the data needs, the size announced with the BLOB is only a hint.
+ *
+ * The BLOBs of the devices are decompressed with it before they are handed to the client, other compressed data can
+ * go through it just the same.
+ */
+class BlobDecompressor
+{
+        DECLARE_PRIVATE(BlobDecompressor)
+
+    public:
+        /** @brief Decompresses data of the codec of extension, see codecExtension(). */
+        explicit BlobDecompressor(const std::string &extension);
+        ~BlobDecompressor();
+
+    public:
+        /** @brief False if the codec is unknown, or INDI is built without it. */
+        bool isValid() const;
+
+        /**
+         * @brief Decompresses into buffer, allocated with malloc for capacity bytes, the decompressor takes it over and
+         * reallocates it when it is too small. Without it, the decompressor allocates its own.
+         */
+        void setOutput(void *buffer, size_t capacity);
+
+        /**
+         * @brief Decompresses the next size bytes of the compressed data.
+         * @return 0 if okay, the error code of the codec otherwise.
+         */
+        int write(const void *data, size_t size);
+
+        /**
+         * @brief Checks the compressed data came to its end.
+         * @return 0 if okay, the error code of the codec if the data is truncated.
+         */
+        int finish();
+
+        /**
+         * @brief Hands the output buffer over to the caller, who frees it, and sets size to the bytes decompressed into it.
+         */
+        void *take(size_t *size);
+
+    public:
+        /** @brief The codec extension format ends with, as in ".fits.z", or an empty string if no codec knows it. */
+        static std::string codecExtension(const std::string &format);
+
+    protected:
+        std::unique_ptr<BlobDecompressorPrivate> d_ptr;
+};
+
+/**
+ * @brief Decompresses a FITS file compressed by fpack, as sent in BLOBs of format ".fits.fz", into a plain FITS file.
+ *
+ * The tiles of each compressed image are decompressed on up to threads threads, one per core if threads is 0.
+ * Decompressing with several threads needs a reentrant cfitsio, otherwise one thread does it all.
+ *
+ * @param blob The fpack data, of blobLen bytes.
+ * @param data Set to the FITS file, allocated with malloc, the caller frees it.
+ * @param dataSize Set to the size of the FITS file.
+ * @return 0 if okay, the cfitsio status otherwise, -1 if INDI is built without cfitsio.
+ */
+int decompressFpack(const void *blob, size_t blobLen, void **data, size_t *dataSize, int threads = 0);
+
+}
@@ -53,7 +53,8 @@ ParentDevice::~ParentDevice()
     if (--d->ref == 0)
     {
         // prevent circular reference
-        d->pAll.clear();
+        std::lock_guard<std::mutex> lock(d->m_Lock);
+        d->clearProperties();
     }
 }
 
@@ -19,6 +19,7 @@
 #include "indipropertybasic.h"
 #include "indipropertybasic_p.h"
 #include <cassert>
+#include <new>
 
 namespace INDI
 {
@@ -28,7 +29,7 @@ PropertyBasicPrivateTemplate<T>::PropertyBasicPrivateTemplate(size_t count)
 #ifdef INDI_PROPERTY_RAW_CAST
     : PropertyContainer<T>
 {
-    *new PropertyView<T>()
+    *new (this->storage) PropertyView<T>()
 }
 , PropertyPrivate(&this->typedProperty)
 , raw{false}
@@ -58,7 +59,7 @@ PropertyBasicPrivateTemplate<T>::~PropertyBasicPrivateTemplate()
 {
 #ifdef INDI_PROPERTY_RAW_CAST
     if (!raw)
-        delete &this->typedProperty;
+        this->typedProperty.~PropertyView<T>();
 #endif
 }
 
@@ -29,6 +29,15 @@
 namespace INDI
 {
 
+#ifdef INDI_PROPERTY_RAW_CAST
+// Room for the view of a property not cast from a raw one, so that it shares the allocation of the private
+template <typename T>
+struct PropertyStorage
+{
+        alignas(PropertyView<T>) unsigned char storage[sizeof(PropertyView<T>)];
+};
+#endif
+
 template <typename T>
 struct PropertyContainer
 {
@@ -39,7 +48,11 @@ struct PropertyContainer
 #endif
 };
 template <typename T>
-class PropertyBasicPrivateTemplate: public PropertyContainer<T>, public PropertyPrivate
+class PropertyBasicPrivateTemplate:
+#ifdef INDI_PROPERTY_RAW_CAST
+    private PropertyStorage<T>,
+#endif
+    public PropertyContainer<T>, public PropertyPrivate
 {
     public:
         using RawPropertyType = typename WidgetTraits<T>::PropertyType;
@@ -19,9 +19,100 @@
 #include "indipropertyblob.h"
 #include "indipropertyblob_p.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace INDI
 {
 
+namespace
+{
+
+const size_t ArrayHeaderSize = 16;
+const uint8_t ArrayVersion = 1;
+
+template <typename T> struct ArrayTypeOf;
+template <> struct ArrayTypeOf<uint8_t>  { static const PropertyBlob::ArrayType value = PropertyBlob::ArrayType::UInt8;   };
+template <> struct ArrayTypeOf<uint16_t> { static const PropertyBlob::ArrayType value = PropertyBlob::ArrayType::UInt16;  };
+template <> struct ArrayTypeOf<uint32_t> { static const PropertyBlob::ArrayType value = PropertyBlob::ArrayType::UInt32;  };
+template <> struct ArrayTypeOf<int32_t>  { static const PropertyBlob::ArrayType value = PropertyBlob::ArrayType::Int32;   };
+template <> struct ArrayTypeOf<float>    { static const PropertyBlob::ArrayType value = PropertyBlob::ArrayType::Float32; };
+template <> struct ArrayTypeOf<double>   { static const PropertyBlob::ArrayType value = PropertyBlob::ArrayType::Float64; };
+
+size_t elementSize(PropertyBlob::ArrayType type)
+{
+    switch (type)
+    {
+        case PropertyBlob::ArrayType::UInt8:   return 1;
+        case PropertyBlob::ArrayType::UInt16:  return 2;
+        case PropertyBlob::ArrayType::UInt32:
+        case PropertyBlob::ArrayType::Int32:
+        case PropertyBlob::ArrayType::Float32: return 4;
+        case PropertyBlob::ArrayType::Float64: return 8;
+        default:                               return 0;
+    }
+}
+
+// the format is little endian, elements are copied as they are on every platform INDI runs on
+void toLittleEndian(uint8_t *data, size_t size, size_t count)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (size_t i = 0; i < count; ++i, data += size)
+        std::reverse(data, data + size);
+#else
+    (void)data;
+    (void)size;
+    (void)count;
+#endif
+}
+
+void putUInt32(uint8_t *data, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        data[i] = uint8_t(value >> (8 * i));
+}
+
+uint32_t getUInt32(const uint8_t *data)
+{
+    return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+}
+
+// header checked, returns the element type and the number of elements
+PropertyBlob::ArrayType parseHeader(const WidgetView<IBLOB> &widget, size_t &count)
+{
+    auto data = static_cast<const uint8_t *>(widget.getBlob());
+    size_t size = widget.getBlobLen() > 0 ? size_t(widget.getBlobLen()) : 0;
+
+    if (data == nullptr || size < ArrayHeaderSize || memcmp(data, "INDA", 4) != 0 || data[4] != ArrayVersion)
+        return PropertyBlob::ArrayType::Invalid;
+
+    auto type = PropertyBlob::ArrayType(data[5]);
+    size_t elements = elementSize(type);
+    count = getUInt32(data + 8);
+
+    if (elements == 0 || count > (size - ArrayHeaderSize) / elements)
+        return PropertyBlob::ArrayType::Invalid;
+
+    return type;
+}
+
+template <typename S, typename T>
+void convert(const uint8_t *data, size_t count, std::vector<T> &values)
+{
+    values.resize(count);
+    for (size_t i = 0; i < count; ++i, data += sizeof(S))
+    {
+        uint8_t element[sizeof(S)];
+        memcpy(element, data, sizeof(S));
+        toLittleEndian(element, sizeof(S), 1);
+        S value;
+        memcpy(&value, element, sizeof(S));
+        values[i] = T(value);
+    }
+}
+
+}
+
 PropertyBlobPrivate::PropertyBlobPrivate(size_t count)
     : PropertyBasicPrivateTemplate<IBLOB>(count)
 { }
@@ -31,7 +122,11 @@ PropertyBlobPrivate::~PropertyBlobPrivate()
     for (auto &it: widgets)
     {
         auto blob = it.getBlob();
-        if (blob != nullptr && deleter != nullptr)
+        bool isArray = std::any_of(arrays.begin(), arrays.end(), [blob](const std::vector<uint8_t> &array)
+        {
+            return array.data() == blob;
+        });
+        if (blob != nullptr && deleter != nullptr && !isArray)
         {
             deleter(blob);
         }
@@ -39,7 +134,7 @@ PropertyBlobPrivate::~PropertyBlobPrivate()
 }
 
 PropertyBlob::PropertyBlob(size_t count)
-    : PropertyBasic<IBLOB>(*new PropertyBlobPrivate(count))
+    : PropertyBasic<IBLOB>(std::make_shared<PropertyBlobPrivate>(count))
 { }
 
 PropertyBlob::PropertyBlob(INDI::Property property)
@@ -55,6 +150,129 @@ void PropertyBlob::setBlobDeleter(const std::function<void(void *&)> &deleter)
     d->deleter = deleter;
 }
 
+template <typename T>
+static bool setArrayTemplate(PropertyBlobPrivate *d, size_t index, const T values[], size_t count)
+{
+    auto widget = index < size_t(d->typedProperty.count()) ? d->typedProperty.at(index) : nullptr;
+    if (widget == nullptr || count > UINT32_MAX || (ArrayHeaderSize + count * sizeof(T)) > INT32_MAX)
+        return false;
+
+    if (d->arrays.size() <= index)
+        d->arrays.resize(index + 1);
+
+    auto &array = d->arrays[index];
+    array.resize(ArrayHeaderSize + count * sizeof(T));
+
+    memset(array.data(), 0, ArrayHeaderSize);
+    memcpy(array.data(), "INDA", 4);
+    array[4] = ArrayVersion;
+    array[5] = uint8_t(ArrayTypeOf<T>::value);
+    putUInt32(array.data() + 8, uint32_t(count));
+
+    if (count > 0)
+    {
+        memcpy(array.data() + ArrayHeaderSize, values, count * sizeof(T));
+        toLittleEndian(array.data() + ArrayHeaderSize, sizeof(T), count);
+    }
+
+    widget->setBlob(array.data());
+    widget->setBlobLen(int(array.size()));
+    widget->setSize(int(array.size()));
+    widget->setFormat(".array");
+    return true;
+}
+
+bool PropertyBlob::setArray(size_t index, const uint8_t values[], size_t count)
+{
+    D_PTR(PropertyBlob);
+    return setArrayTemplate(d, index, values, count);
+}
+
+bool PropertyBlob::setArray(size_t index, const uint16_t values[], size_t count)
+{
+    D_PTR(PropertyBlob);
+    return setArrayTemplate(d, index, values, count);
+}
+
+bool PropertyBlob::setArray(size_t index, const uint32_t values[], size_t count)
+{
+    D_PTR(PropertyBlob);
+    return setArrayTemplate(d, index, values, count);
+}
+
+bool PropertyBlob::setArray(size_t index, const int32_t values[], size_t count)
+{
+    D_PTR(PropertyBlob);
+    return setArrayTemplate(d, index, values, count);
+}
+
+bool PropertyBlob::setArray(size_t index, const float values[], size_t count)
+{
+    D_PTR(PropertyBlob);
+    return setArrayTemplate(d, index, values, count);
+}
+
+bool PropertyBlob::setArray(size_t index, const double values[], size_t count)
+{
+    D_PTR(PropertyBlob);
+    return setArrayTemplate(d, index, values, count);
+}
+
+PropertyBlob::ArrayType PropertyBlob::getArrayType(size_t index) const
+{
+    D_PTR(const PropertyBlob);
+    auto widget = index < size_t(d->typedProperty.count()) ? d->typedProperty.at(index) : nullptr;
+    size_t count;
+    return widget != nullptr ? parseHeader(*widget, count) : ArrayType::Invalid;
+}
+
+template <typename T>
+static bool getArrayTemplate(const PropertyBlobPrivate *d, size_t index, std::vector<T> &values)
+{
+    auto widget = index < size_t(d->typedProperty.count()) ? d->typedProperty.at(index) : nullptr;
+    if (widget == nullptr)
+        return false;
+
+    size_t count = 0;
+    auto type = parseHeader(*widget, count);
+    auto data = static_cast<const uint8_t *>(widget->getBlob()) + ArrayHeaderSize;
+
+    switch (type)
+    {
+        case PropertyBlob::ArrayType::UInt8:   convert<uint8_t>(data, count, values);  return true;
+        case PropertyBlob::ArrayType::UInt16:  convert<uint16_t>(data, count, values); return true;
+        case PropertyBlob::ArrayType::UInt32:  convert<uint32_t>(data, count, values); return true;
+        case PropertyBlob::ArrayType::Int32:   convert<int32_t>(data, count, values);  return true;
+        case PropertyBlob::ArrayType::Float32: convert<float>(data, count, values);    return true;
+        case PropertyBlob::ArrayType::Float64: convert<double>(data, count, values);   return true;
+        default:                               return false;
+    }
+}
+
+bool PropertyBlob::getArray(size_t index, std::vector<uint32_t> &values) const
+{
+    D_PTR(const PropertyBlob);
+    return getArrayTemplate(d, index, values);
+}
+
+bool PropertyBlob::getArray(size_t index, std::vector<int32_t> &values) const
+{
+    D_PTR(const PropertyBlob);
+    return getArrayTemplate(d, index, values);
+}
+
+bool PropertyBlob::getArray(size_t index, std::vector<float> &values) const
+{
+    D_PTR(const PropertyBlob);
+    return getArrayTemplate(d, index, values);
+}
+
+bool PropertyBlob::getArray(size_t index, std::vector<double> &values) const
+{
+    D_PTR(const PropertyBlob);
+    return getArrayTemplate(d, index, values);
+}
+
 bool PropertyBlob::update(
     const int sizes[], const int blobsizes[], const char * const blobs[], const char * const formats[],
     const char * const names[], int n
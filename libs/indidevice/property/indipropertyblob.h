@@ -20,6 +20,9 @@
 
 #include "indipropertybasic.h"
 
+#include <cstdint>
+#include <vector>
+
 namespace INDI
 {
 
@@ -27,6 +30,26 @@ class PropertyBlobPrivate;
 class PropertyBlob: public INDI::PropertyBasic<IBLOB>
 {
         DECLARE_PRIVATE(PropertyBlob)
+    public:
+        /**
+         * @brief Element type of a numeric array BLOB
+         *
+         * A numeric array BLOB has the format ".array" and starts with a 16 bytes header:
+         * the magic "INDA", the version (1), the ArrayType, two reserved bytes and the number of elements
+         * as a little endian uint32, followed by 4 reserved bytes. The elements come next, little endian too.
+         * Drivers publish histograms or spectra this way instead of one oneNumber per sample.
+         */
+        enum class ArrayType : uint8_t
+        {
+            Invalid = 0,
+            UInt8,
+            UInt16,
+            UInt32,
+            Int32,
+            Float32,
+            Float64
+        };
+
     public:
         PropertyBlob(size_t count);
         PropertyBlob(INDI::Property property);
@@ -42,6 +65,38 @@ class PropertyBlob: public INDI::PropertyBasic<IBLOB>
          */
         void setBlobDeleter(const std::function<void(void *&)> &deleter);
 
+    public:
+        /**
+         * @brief Store a numeric array in a widget, with the header of the ".array" format.
+         * The property keeps the memory of the array until the next call for this widget, or its destruction.
+         *
+         * @param index index of the widget
+         * @param values elements of the array
+         * @param count number of elements
+         * @return false if there is no such widget
+         */
+        bool setArray(size_t index, const uint8_t values[], size_t count);
+        bool setArray(size_t index, const uint16_t values[], size_t count);
+        bool setArray(size_t index, const uint32_t values[], size_t count);
+        bool setArray(size_t index, const int32_t values[], size_t count);
+        bool setArray(size_t index, const float values[], size_t count);
+        bool setArray(size_t index, const double values[], size_t count);
+
+        /**
+         * @brief Element type of the numeric array held by a widget.
+         * @return ArrayType::Invalid if the widget has no array, e.g. it holds an image.
+         */
+        ArrayType getArrayType(size_t index) const;
+
+        /**
+         * @brief Read the numeric array held by a widget, converting its elements to the type of the vector.
+         * @return false if the widget does not hold a valid numeric array.
+         */
+        bool getArray(size_t index, std::vector<uint32_t> &values) const;
+        bool getArray(size_t index, std::vector<int32_t> &values) const;
+        bool getArray(size_t index, std::vector<float> &values) const;
+        bool getArray(size_t index, std::vector<double> &values) const;
+
     public:
         bool update(
             const int sizes[], const int blobsizes[], const char * const blobs[], const char * const formats[],
@@ -38,6 +38,9 @@ class PropertyBlobPrivate: public PropertyBasicPrivateTemplate<IBLOB>
     public:
         std::function<void(void *&)> deleter;
 
+        /** @brief Storage of the arrays set with setArray, by widget */
+        std::vector<std::vector<uint8_t>> arrays;
+
 };
 
 }
@@ -30,7 +30,7 @@ PropertyLightPrivate::~PropertyLightPrivate()
 { }
 
 PropertyLight::PropertyLight(size_t count)
-    : PropertyBasic<ILight>(*new PropertyLightPrivate(count))
+    : PropertyBasic<ILight>(std::make_shared<PropertyLightPrivate>(count))
 { }
 
 PropertyLight::PropertyLight(INDI::Property property)
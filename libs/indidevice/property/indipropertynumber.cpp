@@ -30,7 +30,7 @@ PropertyNumberPrivate::~PropertyNumberPrivate()
 { }
 
 PropertyNumber::PropertyNumber(size_t count)
-    : PropertyBasic<INumber>(*new PropertyNumberPrivate(count))
+    : PropertyBasic<INumber>(std::make_shared<PropertyNumberPrivate>(count))
 { }
 
 PropertyNumber::PropertyNumber(INDI::Property property)
@@ -62,4 +62,58 @@ void PropertyNumber::updateMinMax()
     d->typedProperty.updateMinMax();
 }
 
+PropertyNumber::Columns PropertyNumber::getColumns() const
+{
+    Columns columns;
+    columns.value.reserve(size());
+    columns.min.reserve(size());
+    columns.max.reserve(size());
+    columns.step.reserve(size());
+
+    for (const auto &widget : *this)
+    {
+        columns.value.push_back(widget.getValue());
+        columns.min.push_back(widget.getMin());
+        columns.max.push_back(widget.getMax());
+        columns.step.push_back(widget.getStep());
+    }
+    return columns;
+}
+
+bool PropertyNumber::setColumns(const Columns &columns)
+{
+    if (columns.value.size() != size() || columns.min.size() != size() ||
+            columns.max.size() != size() || columns.step.size() != size())
+        return false;
+
+    size_t i = 0;
+    for (auto &widget : *this)
+    {
+        widget.setMinMax(columns.min[i], columns.max[i]);
+        widget.setStep(columns.step[i]);
+        widget.setValue(columns.value[i]);
+        ++i;
+    }
+    emitUpdate();
+    return true;
+}
+
+void PropertyNumber::getValues(double values[]) const
+{
+    for (const auto &widget : *this)
+        *values++ = widget.getValue();
+}
+
+bool PropertyNumber::setValues(const double values[], size_t n)
+{
+    if (n > size())
+        return false;
+
+    auto widget = begin();
+    for (size_t i = 0; i < n; ++i, ++widget)
+        widget->setValue(values[i]);
+    emitUpdate();
+    return true;
+}
+
 }
@@ -20,6 +20,8 @@
 
 #include "indipropertybasic.h"
 
+#include <vector>
+
 namespace INDI
 {
 
@@ -43,6 +45,35 @@ class PropertyNumber: public INDI::PropertyBasic<INumber>
     public:
         void updateMinMax();
 
+    public:
+        /** @brief The numeric fields of all widgets, each in its own contiguous array.
+         *  The widgets themselves remain INumber structures shared with the C API, whose names, labels and formats
+         *  make each of them hundreds of bytes. Columns let large vectors (histograms, spectra, channels) be processed
+         *  without striding through them.
+         */
+        struct Columns
+        {
+            std::vector<double> value;
+            std::vector<double> min;
+            std::vector<double> max;
+            std::vector<double> step;
+        };
+
+        /** @brief Copy the numeric fields of the widgets into columns, in widget order. */
+        Columns getColumns() const;
+
+        /** @brief Set the numeric fields of the widgets from columns, in widget order.
+         *  @return false if a column does not have one entry per widget, in which case nothing is changed.
+         */
+        bool setColumns(const Columns &columns);
+
+        /** @brief Copy the values of the widgets, in widget order, into values which holds count() entries. */
+        void getValues(double values[]) const;
+
+        /** @brief Set the values of the first n widgets, in widget order, without looking up their names.
+         *  @return false if there are fewer than n widgets, in which case nothing is changed.
+         */
+        bool setValues(const double values[], size_t n);
 };
 
 }
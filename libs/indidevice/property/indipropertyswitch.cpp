@@ -30,7 +30,7 @@ PropertySwitchPrivate::~PropertySwitchPrivate()
 { }
 
 PropertySwitch::PropertySwitch(size_t count)
-    : PropertyBasic<ISwitch>(*new PropertySwitchPrivate(count))
+    : PropertyBasic<ISwitch>(std::make_shared<PropertySwitchPrivate>(count))
 { }
 
 PropertySwitch::PropertySwitch(INDI::Property property)
@@ -30,7 +30,7 @@ PropertyTextPrivate::~PropertyTextPrivate()
 { }
 
 PropertyText::PropertyText(size_t count)
-    : PropertyBasic<IText>(*new PropertyTextPrivate(count))
+    : PropertyBasic<IText>(std::make_shared<PropertyTextPrivate>(count))
 { }
 
 PropertyText::PropertyText(INDI::Property property)
@@ -1483,3 +1483,75 @@ inline PropertyView<IBLOB>::WidgetType *PropertyView<IBLOB>::widget() const
 }
 
 }
+
+#if defined(SWIG) && defined(SWIGPYTHON)
+%{
+#include "sharedblob.h"
+
+// Owns a BLOB taken from its widget, exports it through the buffer protocol and frees it with the last view of it
+struct IndiBlobBuffer
+{
+    PyObject_HEAD
+    void *blob;
+    Py_ssize_t size;
+};
+
+static void IndiBlobBuffer_dealloc(PyObject *self)
+{
+    IDSharedBlobFree(reinterpret_cast<IndiBlobBuffer *>(self)->blob);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static int IndiBlobBuffer_getbuffer(PyObject *self, Py_buffer *view, int flags)
+{
+    auto buffer = reinterpret_cast<IndiBlobBuffer *>(self);
+    return PyBuffer_FillInfo(view, self, buffer->blob, buffer->size, 0, flags);
+}
+
+static PyTypeObject *IndiBlobBuffer_type()
+{
+    static PyBufferProcs procs;
+    static PyTypeObject type = { PyVarObject_HEAD_INIT(nullptr, 0) };
+    if (type.tp_name == nullptr)
+    {
+        procs.bf_getbuffer = IndiBlobBuffer_getbuffer;
+        type.tp_name = "PyIndi.BlobBuffer";
+        type.tp_basicsize = sizeof(IndiBlobBuffer);
+        type.tp_flags = Py_TPFLAGS_DEFAULT;
+        type.tp_dealloc = IndiBlobBuffer_dealloc;
+        type.tp_as_buffer = &procs;
+        if (PyType_Ready(&type) < 0)
+        {
+            type.tp_name = nullptr;
+            return nullptr;
+        }
+    }
+    return &type;
+}
+%}
+
+%extend INDI::WidgetView<IBLOB>
+{
+    /**
+     * @brief Hands the BLOB of the widget over to a memoryview, without copying it, shared memory included:
+     * numpy.frombuffer then reads it in place. Call it while the BLOB is being notified, before it is replaced.
+     * The widget is left empty and receives its next BLOB in a buffer of its own. The memory is freed with the last
+     * view of it.
+     */
+    PyObject *takeBlobBuffer()
+    {
+        PyTypeObject *type = IndiBlobBuffer_type();
+        IndiBlobBuffer *buffer = type != nullptr ? PyObject_New(IndiBlobBuffer, type) : nullptr;
+        if (buffer == nullptr)
+            return nullptr;
+        buffer->blob = $self->getBlob();
+        buffer->size = buffer->blob != nullptr ? $self->getSize() : 0;
+        $self->setBlob(nullptr);
+        $self->setBlobLen(0);
+
+        PyObject *view = PyMemoryView_FromObject(reinterpret_cast<PyObject *>(buffer));
+        Py_DECREF(buffer);
+        return view;
+    }
+}
+#endif
@@ -0,0 +1,347 @@
+/*******************************************************************************
+ Planned and scheduled Modbus reads over nanoMODBUS
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include "modbusregisters.h"
+
+#include "eventloop.h"
+
+#include <algorithm>
+#include <future>
+#include <memory>
+
+namespace Modbus
+{
+
+void RegisterMap::add(RegisterType type, uint16_t address, uint16_t quantity, int maxAgeMs)
+{
+    m_Ranges.push_back({type, address, quantity, maxAgeMs});
+    for (uint32_t i = 0; i < quantity; i++)
+        m_Image[Key(type, address + i)];
+}
+
+bool RegisterMap::isDue(const Range &range, std::chrono::steady_clock::time_point now) const
+{
+    for (uint32_t i = 0; i < range.quantity; i++)
+    {
+        const Register &reg = m_Image.at(Key(range.type, range.address + i));
+        if (!reg.valid || range.maxAgeMs == READ_ALWAYS)
+            return true;
+        if (range.maxAgeMs > 0 && now - reg.readAt >= std::chrono::milliseconds(range.maxAgeMs))
+            return true;
+    }
+    return false;
+}
+
+std::vector<Block> RegisterMap::plan() const
+{
+    auto now = std::chrono::steady_clock::now();
+
+    std::vector<Block> due;
+    for (auto &range : m_Ranges)
+    {
+        if (range.quantity > 0 && isDue(range, now))
+            due.push_back({range.type, range.address, range.quantity});
+    }
+
+    std::sort(due.begin(), due.end(), [](const Block &a, const Block &b)
+    {
+        return a.type != b.type ? a.type < b.type : a.address < b.address;
+    });
+
+    // Merge the ranges that overlap or are close enough, then split what a request can't read at once
+    std::vector<Block> merged;
+    for (auto &block : due)
+    {
+        if (!merged.empty())
+        {
+            Block &last = merged.back();
+            uint32_t end = uint32_t(last.address) + last.quantity;
+            if (last.type == block.type && block.address <= end + m_MaxGap)
+            {
+                uint32_t blockEnd = uint32_t(block.address) + block.quantity;
+                last.quantity = uint16_t(std::max(end, blockEnd) - last.address);
+                continue;
+            }
+        }
+        merged.push_back(block);
+    }
+
+    std::vector<Block> blocks;
+    for (auto &block : merged)
+    {
+        uint16_t limit = maxQuantity(block.type);
+        for (uint32_t offset = 0; offset < block.quantity; offset += limit)
+        {
+            uint16_t quantity = uint16_t(std::min<uint32_t>(limit, block.quantity - offset));
+            blocks.push_back({block.type, uint16_t(block.address + offset), quantity});
+        }
+    }
+    return blocks;
+}
+
+void RegisterMap::store(RegisterType type, uint16_t address, const uint16_t *values, uint16_t quantity)
+{
+    auto now = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < quantity; i++)
+    {
+        // Registers of a gap between two ranges are not kept
+        auto it = m_Image.find(Key(type, address + i));
+        if (it == m_Image.end())
+            continue;
+        it->second.value = values[i];
+        it->second.valid = true;
+        it->second.readAt = now;
+    }
+}
+
+void RegisterMap::invalidate(RegisterType type, uint16_t address, uint16_t quantity)
+{
+    for (uint32_t i = 0; i < quantity; i++)
+    {
+        auto it = m_Image.find(Key(type, address + i));
+        if (it != m_Image.end())
+            it->second.valid = false;
+    }
+}
+
+bool RegisterMap::value(RegisterType type, uint16_t address, uint16_t &value) const
+{
+    auto it = m_Image.find(Key(type, address));
+    if (it == m_Image.end() || !it->second.valid)
+        return false;
+    value = it->second.value;
+    return true;
+}
+
+bool RegisterMap::isStale(RegisterType type, uint16_t address) const
+{
+    auto now = std::chrono::steady_clock::now();
+    for (auto &range : m_Ranges)
+    {
+        if (range.type == type && address >= range.address && address - range.address < range.quantity
+                && isDue({type, address, 1, range.maxAgeMs}, now))
+            return true;
+    }
+    return false;
+}
+
+uint16_t RegisterMap::maxQuantity(RegisterType type)
+{
+    // From the function codes of the protocol
+    return type == COILS || type == DISCRETE_INPUTS ? 2000 : 125;
+}
+
+Scheduler::~Scheduler()
+{
+    stop();
+}
+
+void Scheduler::start(nmbs_t *nmbs)
+{
+    stop();
+    m_Client = nmbs;
+    m_Thread = std::thread(&Scheduler::run, this);
+}
+
+void Scheduler::stop()
+{
+    std::map<Key, Pending> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Stopping = true;
+        dropped.swap(m_Pending);
+    }
+    m_Wake.notify_all();
+
+    if (m_Thread.joinable())
+        m_Thread.join();
+
+    m_Stopping = false;
+    m_Client = nullptr;
+
+    for (auto &one : dropped)
+        complete(one.second, NMBS_ERROR_TRANSPORT);
+}
+
+uint64_t Scheduler::enqueue(Pending pending, Priority priority)
+{
+    uint64_t id = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        if (m_Thread.joinable())
+        {
+            id = m_NextId++;
+            m_Pending.emplace(Key(-priority, id), std::move(pending));
+        }
+    }
+
+    // Not started, or stopped
+    if (id == 0)
+    {
+        complete(pending, NMBS_ERROR_TRANSPORT);
+        return 0;
+    }
+    m_Wake.notify_one();
+    return id;
+}
+
+uint64_t Scheduler::submit(Request request, Completion completion, Priority priority)
+{
+    Pending pending;
+    pending.request = std::move(request);
+    pending.completion = std::move(completion);
+    return enqueue(std::move(pending), priority);
+}
+
+nmbs_error Scheduler::execute(Request request, Priority priority)
+{
+    auto result = std::make_shared<std::promise<nmbs_error>>();
+    Pending pending;
+    pending.request = std::move(request);
+    pending.completion = [result](nmbs_error error)
+    {
+        result->set_value(error);
+    };
+    pending.posted = false;
+
+    std::future<nmbs_error> future = result->get_future();
+    enqueue(std::move(pending), priority);
+    return future.get();
+}
+
+void Scheduler::cancelPending(Priority priority)
+{
+    std::map<Key, Pending> dropped;
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        auto first = m_Pending.lower_bound(Key(-priority, 0));
+        dropped.insert(std::make_move_iterator(first), std::make_move_iterator(m_Pending.end()));
+        m_Pending.erase(first, m_Pending.end());
+    }
+
+    for (auto &one : dropped)
+        complete(one.second, NMBS_ERROR_TRANSPORT);
+}
+
+bool Scheduler::refresh(RegisterMap &map, Completion done, Priority priority)
+{
+    if (map.m_Refreshing)
+        return false;
+
+    std::vector<Block> blocks = map.plan();
+    if (blocks.empty())
+    {
+        if (done)
+            postToEventLoop([done]
+        {
+            done(NMBS_ERROR_NONE);
+        });
+        return true;
+    }
+
+    // Shared by the completions of the blocks, all of them on the event loop
+    struct Progress
+    {
+        size_t remaining;
+        nmbs_error error;
+    };
+    auto progress = std::make_shared<Progress>(Progress{blocks.size(), NMBS_ERROR_NONE});
+    map.m_Refreshing = true;
+
+    for (auto &block : blocks)
+    {
+        auto values = std::make_shared<std::vector<uint16_t>>(block.quantity);
+
+        Request request = [block, values](nmbs_t *nmbs)
+        {
+            nmbs_bitfield bits = {0};
+            nmbs_error error;
+            switch (block.type)
+            {
+                case COILS:
+                    error = nmbs_read_coils(nmbs, block.address, block.quantity, bits);
+                    break;
+                case DISCRETE_INPUTS:
+                    error = nmbs_read_discrete_inputs(nmbs, block.address, block.quantity, bits);
+                    break;
+                case HOLDING_REGISTERS:
+                    return nmbs_read_holding_registers(nmbs, block.address, block.quantity, values->data());
+                default:
+                    return nmbs_read_input_registers(nmbs, block.address, block.quantity, values->data());
+            }
+            for (uint16_t i = 0; i < block.quantity; i++)
+                (*values)[i] = nmbs_bitfield_read(bits, i);
+            return error;
+        };
+
+        Completion completion = [&map, block, values, progress, done](nmbs_error error)
+        {
+            if (error == NMBS_ERROR_NONE)
+                map.store(block.type, block.address, values->data(), block.quantity);
+            else if (progress->error == NMBS_ERROR_NONE)
+                progress->error = error;
+
+            if (--progress->remaining > 0)
+                return;
+            map.m_Refreshing = false;
+            if (done)
+                done(progress->error);
+        };
+
+        submit(std::move(request), std::move(completion), priority);
+    }
+    return true;
+}
+
+void Scheduler::run()
+{
+    for (;;)
+    {
+        Pending pending;
+        {
+            std::unique_lock<std::mutex> lock(m_Lock);
+            m_Wake.wait(lock, [this] { return m_Stopping || !m_Pending.empty(); });
+            if (m_Stopping)
+                return;
+
+            pending = std::move(m_Pending.begin()->second);
+            m_Pending.erase(m_Pending.begin());
+        }
+        complete(pending, pending.request(m_Client));
+    }
+}
+
+void Scheduler::complete(const Pending &pending, nmbs_error error)
+{
+    if (!pending.completion)
+        return;
+
+    if (!pending.posted)
+    {
+        pending.completion(error);
+        return;
+    }
+
+    Completion completion = pending.completion;
+    postToEventLoop([completion, error]
+    {
+        completion(error);
+    });
+}
+
+}
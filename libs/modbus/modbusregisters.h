@@ -0,0 +1,217 @@
+/*******************************************************************************
+ Planned and scheduled Modbus reads over nanoMODBUS
+
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#pragma once
+
+#include "nanomodbus.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Modbus
+{
+typedef enum
+{
+    COILS,
+    DISCRETE_INPUTS,
+    HOLDING_REGISTERS,
+    INPUT_REGISTERS
+} RegisterType;
+
+/** @brief Registers read by a single request. */
+struct Block
+{
+    RegisterType type;
+    uint16_t address;
+    uint16_t quantity;
+};
+
+/**
+ * @brief The RegisterMap class is a cached image of the registers a driver uses, with the policy of when each of them
+ * must be read again.
+ *
+ * plan() merges the reads of the registers that are due into as few requests as the protocol allows, so that reading
+ * registers spread across the map of a device does not cost a round trip each. Coils and discrete inputs are stored
+ * as 0 or 1.
+ *
+ * The map is not thread safe, it is meant to be used from the driver's event loop, which is where Scheduler stores
+ * the values it reads.
+ */
+class RegisterMap
+{
+    public:
+        /** @brief Max ages of add(). */
+        enum
+        {
+            READ_ALWAYS = 0,    /*!< Read at every refresh */
+            READ_ONCE   = -1    /*!< Read once, then only when invalidated */
+        };
+
+    public:
+        /**
+         * @brief Adds quantity registers from address, read again once older than maxAgeMs, or READ_ALWAYS or READ_ONCE.
+         */
+        void add(RegisterType type, uint16_t address, uint16_t quantity, int maxAgeMs = READ_ALWAYS);
+
+        /**
+         * @brief Sets how many registers outside the map a request may read to save another one. 0 by default, as
+         * some devices fail whole requests with addresses they don't have.
+         */
+        void setMaxGap(uint16_t registers)
+        {
+            m_MaxGap = registers;
+        }
+
+        /** @returns The requests reading the registers that are due, a single register at least in each of them. */
+        std::vector<Block> plan() const;
+
+        /** @brief Stores the values read by a request. */
+        void store(RegisterType type, uint16_t address, const uint16_t *values, uint16_t quantity);
+
+        /** @brief Marks registers to be read at the next refresh, after they were written for instance. */
+        void invalidate(RegisterType type, uint16_t address, uint16_t quantity);
+
+        /** @returns False if the register was never read or was invalidated. */
+        bool value(RegisterType type, uint16_t address, uint16_t &value) const;
+
+        /** @returns True if the register is due for a read. */
+        bool isStale(RegisterType type, uint16_t address) const;
+
+        /** @returns The most registers of type a single request can read. */
+        static uint16_t maxQuantity(RegisterType type);
+
+    protected:
+        typedef std::pair<RegisterType, uint16_t> Key;
+
+        struct Range
+        {
+            RegisterType type;
+            uint16_t address;
+            uint16_t quantity;
+            int maxAgeMs;
+        };
+
+        struct Register
+        {
+            uint16_t value {0};
+            bool valid {false};
+            std::chrono::steady_clock::time_point readAt;
+        };
+
+        bool isDue(const Range &range, std::chrono::steady_clock::time_point now) const;
+
+        std::vector<Range> m_Ranges;
+        std::map<Key, Register> m_Image;
+        uint16_t m_MaxGap {0};
+
+        // Set by Scheduler while the reads of a refresh are queued
+        bool m_Refreshing {false};
+
+        friend class Scheduler;
+};
+
+/**
+ * @brief The Scheduler class runs Modbus requests on a client from a thread of its own, so that a slow device or a long
+ * map does not hold the driver's main thread.
+ *
+ * Requests run one at a time, highest priority first and in submission order within a priority: a write submitted
+ * while the reads of a refresh are queued goes out next. Completions are called on the driver's event loop. The
+ * protocol has a single request in flight per client, so requests are never sent ahead of the previous reply.
+ *
+ * While the scheduler runs, all requests on the client should go through it.
+ */
+class Scheduler
+{
+    public:
+        typedef enum
+        {
+            PRIORITY_POLL,      /*!< Refreshes, run when nothing else is waiting */
+            PRIORITY_NORMAL,
+            PRIORITY_HIGH       /*!< Writes and aborts */
+        } Priority;
+
+        /** @brief Runs on the scheduler thread with the client. */
+        typedef std::function<nmbs_error(nmbs_t *nmbs)> Request;
+
+        /** @brief Called on the event loop with the error of the request, NMBS_ERROR_NONE on success. */
+        typedef std::function<void(nmbs_error error)> Completion;
+
+    public:
+        Scheduler() = default;
+        ~Scheduler();
+
+        /** @brief Starts running requests on nmbs, which the scheduler does not own. */
+        void start(nmbs_t *nmbs);
+
+        /** @brief Waits for the running request and fails those not started with NMBS_ERROR_TRANSPORT. */
+        void stop();
+
+        bool isRunning() const
+        {
+            return m_Thread.joinable();
+        }
+
+        /** @brief Queues a request and returns its id, or fails it with NMBS_ERROR_TRANSPORT if not running. */
+        uint64_t submit(Request request, Completion completion, Priority priority = PRIORITY_NORMAL);
+
+        /** @brief Queues a request ahead of the others and waits for its result, for the driver's blocking calls. */
+        nmbs_error execute(Request request, Priority priority = PRIORITY_HIGH);
+
+        /** @brief Fails all requests not started yet with a priority up to priority with NMBS_ERROR_TRANSPORT. */
+        void cancelPending(Priority priority = PRIORITY_HIGH);
+
+        /**
+         * @brief Queues the requests planned by map and stores what they read in it. done is called once, after the
+         * last of them, with the first error. map must outlive the refresh.
+         * @return False if the previous refresh of map is still running.
+         */
+        bool refresh(RegisterMap &map, Completion done, Priority priority = PRIORITY_POLL);
+
+    protected:
+        struct Pending
+        {
+            Request request;
+            Completion completion;
+            bool posted {true};     // Called on the event loop, or on the scheduler thread
+        };
+
+        void run();
+        static void complete(const Pending &pending, nmbs_error error);
+
+        // Highest priority first, then by id, which grows with each submit
+        typedef std::pair<int, uint64_t> Key;
+        uint64_t enqueue(Pending pending, Priority priority);
+
+        std::map<Key, Pending> m_Pending;
+
+        std::mutex m_Lock;
+        std::condition_variable m_Wake;
+        std::thread m_Thread;
+        std::atomic_bool m_Stopping {false};
+        uint64_t m_NextId {1};
+        nmbs_t *m_Client {nullptr};
+};
+}
@@ -113,6 +113,9 @@ bool TcpSocketPrivate::connectSocket(const std::string &hostName, unsigned short
         return false;
     }
 
+    // before the connection, the window is negotiated on it
+    tuneReceiveBuffer();
+
     // get socket address
     auto sockAddr = SocketAddress(hostName, port);
 
@@ -497,16 +500,55 @@ void TcpSocket::disconnected()
 
 void TcpSocket::readyRead()
 {
-    char data[65536];
-    ssize_t size = d_ptr->recvSocket(data, sizeof(data));
+    readAll([this](void *dst, size_t size)
+    {
+        return d_ptr->recvSocket(dst, size);
+    });
+}
+
+void TcpSocket::readAll(const std::function<ssize_t(void *dst, size_t size)> &recv)
+{
+    static const size_t minimumSize = 65536;
+    static const size_t maximumSize = 16 * 1024 * 1024;
+
+    std::vector<char> &buffer = d_ptr->readBuffer;
+    size_t size = 0;
 
-    if (size <= 0)
+    while (true)
+    {
+        // only read again what is there already, the socket may block
+        size_t pending = d_ptr->pendingSocket();
+        if (size > 0 && pending == 0)
+            break;
+
+        size_t wanted = std::min(size + std::max(pending, minimumSize), maximumSize);
+        if (buffer.size() < wanted)
+            buffer.resize(wanted);
+        if (size == buffer.size())
+            break;
+
+        ssize_t n = recv(buffer.data() + size, buffer.size() - size);
+        if (n <= 0)
+            break;
+        size += n;
+    }
+
+    if (size == 0)
     {
         setSocketError(TcpSocket::ConnectionRefusedError);
         return;
     }
 
-    emitData(data, size);
+    emitData(buffer.data(), size);
+
+    // give the memory of a large element back once only small messages are coming
+    if (buffer.size() > minimumSize && size < minimumSize && ++d_ptr->smallReads > 256)
+    {
+        std::vector<char>(minimumSize).swap(buffer);
+        d_ptr->smallReads = 0;
+    }
+    else if (size >= minimumSize)
+        d_ptr->smallReads = 0;
 }
 
 void TcpSocket::errorOccurred(SocketError error)
@@ -114,6 +114,11 @@ class TcpSocket
     protected:
         void setSocketError(SocketError socketError);
 
+        /** @brief Read all the socket has ready with recv and emit it as one chunk.
+         *  The buffer grows while the socket keeps more than it holds, so a large element is parsed in few chunks.
+         */
+        void readAll(const std::function<ssize_t(void *dst, size_t size)> &recv);
+
     protected:
         friend class TcpSocketPrivate;
         std::unique_ptr<TcpSocketPrivate> d_ptr;
@@ -30,6 +30,7 @@
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <vector>
 
 class SocketAddress
 {
@@ -86,6 +87,8 @@ class TcpSocketPrivate
         ssize_t recvSocket(void *dst, size_t size);
         ssize_t sendSocket(const void *src, size_t size);
         bool setNonblockSocket();
+        size_t pendingSocket() const;
+        void tuneReceiveBuffer();
 
     public: // low level helpers
         bool connectSocket(const std::string &hostName, unsigned short port);
@@ -119,6 +122,10 @@ class TcpSocketPrivate
         std::thread thread;
         std::atomic<bool> isAboutToClose{false};
 
+        // received data, grows to what the socket has ready while large elements come in
+        std::vector<char> readBuffer;
+        int smallReads{0};
+
         mutable std::mutex socketStateMutex;
         mutable std::condition_variable socketStateChanged;
 
@@ -19,6 +19,7 @@
 #include "tcpsocket_p.h"
 
 #include <sys/un.h>
+#include <sys/ioctl.h>
 
 bool TcpSocketPrivate::createSocket(int domain)
 {
@@ -47,6 +48,28 @@ ssize_t TcpSocketPrivate::recvSocket(void *dst, size_t size)
     return ::read(socketFd, dst, size);
 }
 
+size_t TcpSocketPrivate::pendingSocket() const
+{
+    int size = 0;
+    if (ioctl(socketFd, FIONREAD, &size) < 0 || size < 0)
+        return 0;
+    return size_t(size);
+}
+
+void TcpSocketPrivate::tuneReceiveBuffer()
+{
+#ifndef __linux__
+    // Linux grows the buffer of each connection by itself, setting a size would stop that
+    int size = 0;
+    socklen_t length = sizeof(size);
+    if (getsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &size, &length) == 0 && size < 4 * 1024 * 1024)
+    {
+        size = 4 * 1024 * 1024;
+        setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+#endif
+}
+
 ssize_t TcpSocketPrivate::sendSocket(const void *src, size_t size)
 {
     return ::write(socketFd, src, size);
@@ -53,6 +53,26 @@ ssize_t TcpSocketPrivate::recvSocket(void *dst, size_t size)
     return ::recv(socketFd, static_cast<char *>(dst), int(size), 0);
 }
 
+size_t TcpSocketPrivate::pendingSocket() const
+{
+    u_long size = 0;
+    if (ioctlsocket(socketFd, FIONREAD, &size) != NO_ERROR)
+        return 0;
+    return size_t(size);
+}
+
+void TcpSocketPrivate::tuneReceiveBuffer()
+{
+    int size = 0;
+    int length = sizeof(size);
+    if (getsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char *>(&size), &length) == 0 &&
+            size < 4 * 1024 * 1024)
+    {
+        size = 4 * 1024 * 1024;
+        setsockopt(socketFd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char *>(&size), sizeof(size));
+    }
+}
+
 ssize_t TcpSocketPrivate::sendSocket(const void *src, size_t size)
 {
     return ::send(socketFd, static_cast<const char *>(src), int(size), 0);
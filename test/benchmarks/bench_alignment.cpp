@@ -0,0 +1,101 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Transforms per second of the alignment subsystem, with a model of three sync points
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <iostream>
+
+#include "../alignment/alignment_scope.h"
+
+#include "perf_main.h"
+
+static void syncThreeStars(Scope &scope)
+{
+    scope.updateLocation(29.05, 48.15, 0);
+    scope.Handshake();
+
+    // Vega, Arcturus and Mizar
+    scope.Sync(18.6156972, 38.7856944);
+    scope.Sync(14.2612083, 19.1872694);
+    scope.Sync(13.3988500, 54.9254167);
+}
+
+static void BM_TelescopeEquatorialToSky(benchmark::State &state)
+{
+    Scope scope(MathPluginManagement::EQUATORIAL);
+    syncThreeStars(scope);
+
+    // Sweep the sky, the transform depends on the position
+    double ra = 0, dec = -80;
+    for (auto _ : state)
+    {
+        double skyRA, skyDec;
+        benchmark::DoNotOptimize(scope.TelescopeEquatorialToSky(ra, dec, skyRA, skyDec));
+        benchmark::DoNotOptimize(skyRA);
+        ra = ra >= 23.9 ? 0 : ra + 0.1;
+        dec = dec >= 80 ? -80 : dec + 0.7;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelescopeEquatorialToSky);
+
+static void BM_TelescopeAltAzToSky(benchmark::State &state)
+{
+    Scope scope(MathPluginManagement::ALTAZ);
+    syncThreeStars(scope);
+
+    double alt = 10, az = 0;
+    for (auto _ : state)
+    {
+        double skyRA, skyDec;
+        benchmark::DoNotOptimize(scope.TelescopeAltAzToSky(alt, az, skyRA, skyDec));
+        benchmark::DoNotOptimize(skyRA);
+        alt = alt >= 85 ? 10 : alt + 0.3;
+        az = az >= 359 ? 0 : az + 1.3;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TelescopeAltAzToSky);
+
+static void BM_SkyToTelescopeEquatorial(benchmark::State &state)
+{
+    Scope scope(MathPluginManagement::EQUATORIAL);
+    syncThreeStars(scope);
+
+    double ra = 0, dec = -80;
+    for (auto _ : state)
+    {
+        double mountRA, mountDec;
+        benchmark::DoNotOptimize(scope.SkyToTelescopeEquatorial(ra, dec, mountRA, mountDec));
+        benchmark::DoNotOptimize(mountRA);
+        ra = ra >= 23.9 ? 0 : ra + 0.1;
+        dec = dec >= 80 ? -80 : dec + 0.7;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SkyToTelescopeEquatorial);
+
+int main(int argc, char **argv)
+{
+    // The mount talks on stdout, so results go to stderr and the driver output is dropped
+    if (freopen("/dev/null", "w", stdout) == nullptr)
+        return 1;
+
+    return perfMain(argc, argv, std::cerr);
+}
@@ -0,0 +1,199 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Upload of a CCD frame with each encoding and codec, and frames per second through the stream recorder
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "indiccd.h"
+#include "indithreadpool.h"
+
+#include "perf_main.h"
+
+// A 4 Mpixels 16 bits frame of sky background and noise, compressible like a real one
+#define WIDTH  2048
+#define HEIGHT 2048
+#define FRAME_BYTES (WIDTH * HEIGHT * 2)
+
+// Small frames for the recorder, so that it is the pipeline that is measured and not the disk
+#define RECORD_WIDTH  640
+#define RECORD_HEIGHT 480
+#define RECORD_FRAMES 200
+
+class BenchCCD : public INDI::CCD
+{
+    public:
+        BenchCCD()
+        {
+            initProperties();
+
+            SetCCDParams(WIDTH, HEIGHT, 16, 3.76, 3.76);
+            PrimaryCCD.setFrameBufferSize(FRAME_BYTES);
+
+            // Same frame at every run
+            auto pixels = reinterpret_cast<uint16_t *>(PrimaryCCD.getFrameBuffer());
+            uint32_t seed = 1;
+            for (int i = 0; i < WIDTH * HEIGHT; i++)
+            {
+                seed = seed * 1664525 + 1013904223;
+                pixels[i] = 1000 + (seed >> 26);
+            }
+
+            UploadSP.reset();
+            UploadSP[UPLOAD_CLIENT].setState(ISS_ON);
+        }
+
+        const char *getDefaultName() override
+        {
+            return "Bench CCD";
+        }
+
+        bool initProperties() override
+        {
+            INDI::CCD::initProperties();
+            SetCCDCapability(CCD_HAS_STREAMING);
+            return true;
+        }
+
+        // Frames are pushed by the benchmark
+        bool StartStreaming() override
+        {
+            return true;
+        }
+        bool StopStreaming() override
+        {
+            return true;
+        }
+
+        /** @returns False if the codec is not built in */
+        bool setUpload(bool fits, const char *codec)
+        {
+            EncodeFormatSP.reset();
+            EncodeFormatSP[fits ? FORMAT_FITS : FORMAT_NATIVE].setState(ISS_ON);
+            PrimaryCCD.setImageExtension("fits");
+
+            // Compressed FITS are tile compressed with fpack, whatever the codec
+            PrimaryCCD.setCompressed(codec != nullptr);
+            if (codec == nullptr || fits)
+                return true;
+
+            auto widget = CompressionCodecSP.findWidgetByName(codec);
+            if (widget == nullptr)
+                return false;
+            CompressionCodecSP.reset();
+            widget->setState(ISS_ON);
+            return true;
+        }
+
+        void upload()
+        {
+            ExposureComplete(&PrimaryCCD);
+            INDI::ThreadPool::global().waitForDone();
+        }
+
+        bool setRecording(const std::string &directory)
+        {
+            Streamer->setPixelFormat(INDI_MONO, 8);
+            Streamer->setSize(RECORD_WIDTH, RECORD_HEIGHT);
+
+            char fileDir[] = "RECORD_FILE_DIR", fileName[] = "RECORD_FILE_NAME", name[] = "bench_record";
+            char *texts[] = { const_cast<char *>(directory.c_str()), name };
+            char *textNames[] = { fileDir, fileName };
+            Streamer->ISNewText(getDeviceName(), "RECORD_FILE", texts, textNames, 2);
+
+            char total[] = "RECORD_FRAME_TOTAL";
+            char *numberNames[] = { total };
+            double frames[] = { RECORD_FRAMES };
+            return Streamer->ISNewNumber(getDeviceName(), "RECORD_OPTIONS", frames, numberNames, 1);
+        }
+
+        /** @brief Record RECORD_FRAMES frames, the last one returns once all of them are written */
+        void record()
+        {
+            char frameOn[] = "RECORD_FRAME_ON";
+            char *names[] = { frameOn };
+            ISState states[] = { ISS_ON };
+            Streamer->ISNewSwitch(getDeviceName(), "RECORD_STREAM", states, names, 1);
+
+            for (int i = 0; i < RECORD_FRAMES; i++)
+            {
+                INDI::BufferPool::Buffer frame = Streamer->acquireFrame(RECORD_WIDTH * RECORD_HEIGHT);
+                memcpy(frame.data(), PrimaryCCD.getFrameBuffer(), frame.size());
+                Streamer->newFrame(std::move(frame));
+            }
+        }
+};
+
+static BenchCCD &device()
+{
+    static BenchCCD ccd;
+    return ccd;
+}
+
+static void BM_Upload(benchmark::State &state, bool fits, const char *codec)
+{
+    if (!device().setUpload(fits, codec))
+    {
+        state.SkipWithError("Codec not built in");
+        return;
+    }
+
+    for (auto _ : state)
+        device().upload();
+    state.SetBytesProcessed(state.iterations() * FRAME_BYTES);
+}
+BENCHMARK_CAPTURE(BM_Upload, fits, true, nullptr)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Upload, fpack, true, "fpack")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Upload, native, false, nullptr)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Upload, zlib, false, "CODEC_ZLIB")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Upload, lz4, false, "CODEC_LZ4")->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Upload, zstd, false, "CODEC_ZSTD")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Through the live preview, frames are paced to the preview rate: recording takes every frame
+static void BM_StreamRecord(benchmark::State &state)
+{
+    char directory[] = "/tmp/bench_ccd_XXXXXX";
+    if (mkdtemp(directory) == nullptr || !device().setRecording(directory))
+    {
+        state.SkipWithError("Cannot set the recording up");
+        return;
+    }
+
+    for (auto _ : state)
+        device().record();
+    state.counters["fps"] = benchmark::Counter(double(state.iterations()) * RECORD_FRAMES, benchmark::Counter::kIsRate);
+
+    unlink((std::string(directory) + "/bench_record.ser").c_str());
+    rmdir(directory);
+}
+BENCHMARK(BM_StreamRecord)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+int main(int argc, char **argv)
+{
+    // The driver talks on stdout, so results go to stderr and the driver output is dropped
+    if (freopen("/dev/null", "w", stdout) == nullptr)
+        return 1;
+
+    return perfMain(argc, argv, std::cerr);
+}
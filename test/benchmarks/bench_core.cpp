@@ -0,0 +1,250 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Throughput of the core pieces every message goes through
+
+#include <benchmark/benchmark.h>
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "base64.h"
+#include "indiapi.h"
+#include "indiuserio.h"
+#include "lilxml.h"
+#include "userio.h"
+
+#include "perf_main.h"
+
+// indiserver reads at most that much at once
+#define READ_CHUNK 49152
+
+static std::string numberMessage()
+{
+    return "<setNumberVector device='Telescope Simulator' name='EQUATORIAL_EOD_COORD' state='Ok' timeout='60' "
+           "timestamp='2024-01-01T00:00:00'>\n"
+           "    <oneNumber name='RA'>\n      5.5919722222222224\n    </oneNumber>\n"
+           "    <oneNumber name='DEC'>\n      -5.3911111111111110\n    </oneNumber>\n"
+           "</setNumberVector>\n";
+}
+
+static std::string switchMessage(int count)
+{
+    std::string xml = "<defSwitchVector device='Filter Wheel' name='FILTER_SLOTS' label='Filters' group='Main' "
+                      "state='Idle' perm='rw' rule='OneOfMany' timeout='0' timestamp='2024-01-01T00:00:00'>\n";
+    for (int i = 0; i < count; i++)
+        xml += "    <defSwitch name='SLOT_" + std::to_string(i) + "' label='Slot " + std::to_string(i) + "'>\nOff\n"
+               "    </defSwitch>\n";
+    return xml + "</defSwitchVector>\n";
+}
+
+static std::string blobMessage(size_t size)
+{
+    std::vector<unsigned char> raw(size);
+    for (size_t i = 0; i < size; i++)
+        raw[i] = (unsigned char)(i * 2654435761u >> 13);
+    std::string encoded(4 * size / 3 + 4, '\0');
+    encoded.resize(to64frombits_s((unsigned char *)&encoded[0], raw.data(), int(size), encoded.size()));
+
+    std::string xml = "<setBLOBVector device='CCD Simulator' name='CCD1' state='Ok' timeout='60' "
+                      "timestamp='2024-01-01T00:00:00'>\n    <oneBLOB name='CCD1' size='" + std::to_string(size) +
+                      "' enclen='" + std::to_string(encoded.size()) + "' format='.fits'>\n";
+    for (size_t pos = 0; pos < encoded.size(); pos += 72)
+        xml += encoded.substr(pos, 72) + "\n";
+    return xml + "    </oneBLOB>\n</setBLOBVector>\n";
+}
+
+// Feed xml the way it comes from a socket, and drop what gets parsed
+static void parseAll(LilXML *lp, std::string &xml)
+{
+    char err[1024];
+    for (size_t pos = 0; pos < xml.size(); pos += READ_CHUNK)
+    {
+        int len = int(std::min(xml.size() - pos, size_t(READ_CHUNK)));
+        XMLEle **nodes = parseXMLChunk(lp, &xml[pos], len, err);
+        if (!nodes)
+            abort();
+        for (XMLEle **it = nodes; *it; ++it)
+            delXMLEle(*it);
+        free(nodes);
+    }
+}
+
+static void parseBenchmark(benchmark::State &state, std::string xml)
+{
+    LilXML *lp = newLilXML();
+    for (auto _ : state)
+        parseAll(lp, xml);
+    delLilXML(lp);
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(xml.size()));
+}
+
+static void BM_ParseNumbers(benchmark::State &state)
+{
+    std::string xml;
+    for (int i = 0; i < 100; i++)
+        xml += numberMessage();
+    parseBenchmark(state, xml);
+}
+BENCHMARK(BM_ParseNumbers);
+
+static void BM_ParseSwitchVector(benchmark::State &state)
+{
+    parseBenchmark(state, switchMessage(int(state.range(0))));
+}
+BENCHMARK(BM_ParseSwitchVector)->Arg(8)->Arg(256);
+
+static void BM_ParseBlob(benchmark::State &state)
+{
+    parseBenchmark(state, blobMessage(size_t(state.range(0))));
+}
+BENCHMARK(BM_ParseBlob)->Arg(64 << 10)->Arg(4 << 20)->Arg(50 << 20)->Unit(benchmark::kMillisecond);
+
+static void BM_ParseMix(benchmark::State &state)
+{
+    // Mostly numbers, a few vectors, one frame
+    std::string xml;
+    for (int i = 0; i < 1000; i++)
+        xml += numberMessage();
+    for (int i = 0; i < 10; i++)
+        xml += switchMessage(32);
+    xml += blobMessage(1 << 20);
+    parseBenchmark(state, xml);
+}
+BENCHMARK(BM_ParseMix)->Unit(benchmark::kMillisecond);
+
+static void BM_Base64Encode(benchmark::State &state)
+{
+    size_t size = size_t(state.range(0));
+    std::vector<unsigned char> in(size, 0x5a), out(4 * size / 3 + 4);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(to64frombits_s(out.data(), in.data(), int(size), out.size()));
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(size));
+}
+BENCHMARK(BM_Base64Encode)->Arg(64)->Arg(64 << 10)->Arg(16 << 20);
+
+static void BM_Base64Decode(benchmark::State &state)
+{
+    size_t size = size_t(state.range(0));
+    std::vector<unsigned char> raw(size, 0x5a);
+    std::vector<char> encoded(4 * size / 3 + 4), out(size + 4);
+    int len = to64frombits_s((unsigned char *)encoded.data(), raw.data(), int(size), encoded.size());
+    for (auto _ : state)
+        benchmark::DoNotOptimize(from64tobits_fast(out.data(), encoded.data(), len));
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(len));
+}
+BENCHMARK(BM_Base64Decode)->Arg(64)->Arg(64 << 10)->Arg(16 << 20);
+
+static void BM_PrintXML(benchmark::State &state)
+{
+    char err[1024];
+    std::string xml = switchMessage(int(state.range(0)));
+    LilXML *lp = newLilXML();
+    XMLEle **nodes = parseXMLChunk(lp, &xml[0], int(xml.size()), err);
+    XMLEle *root = nodes[0];
+    free(nodes);
+    delLilXML(lp);
+
+    std::vector<char> out(sprlXMLEle(root, 0) + 1);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(sprXMLEle(out.data(), root, 0));
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(out.size()));
+    delXMLEle(root);
+}
+BENCHMARK(BM_PrintXML)->Arg(8)->Arg(256);
+
+// A userio that only counts what it is given
+static ssize_t countWrite(void *user, const void *, size_t count)
+{
+    *static_cast<size_t *>(user) += count;
+    return ssize_t(count);
+}
+
+static int countPrintf(void *user, const char *format, va_list arg)
+{
+    char buffer[512];
+    int len = vsnprintf(buffer, sizeof(buffer), format, arg);
+    *static_cast<size_t *>(user) += size_t(len);
+    return len;
+}
+
+static const userio countingIo = { countWrite, countPrintf, nullptr };
+
+static void BM_UserIONewNumber(benchmark::State &state)
+{
+    INumber np[2];
+    memset(np, 0, sizeof(np));
+    strcpy(np[0].name, "RA");
+    strcpy(np[1].name, "DEC");
+    np[0].value = 5.5919722;
+    np[1].value = -5.3911111;
+
+    INumberVectorProperty nvp;
+    memset(&nvp, 0, sizeof(nvp));
+    strcpy(nvp.device, "Telescope Simulator");
+    strcpy(nvp.name, "EQUATORIAL_EOD_COORD");
+    nvp.np = np;
+    nvp.nnp = 2;
+
+    size_t written = 0;
+    for (auto _ : state)
+        IUUserIONewNumber(&countingIo, &written, &nvp);
+    state.SetBytesProcessed(int64_t(written));
+}
+BENCHMARK(BM_UserIONewNumber);
+
+static void setBlob(size_t *written, const IBLOBVectorProperty *bvp, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    IUUserIOSetBLOBVA(&countingIo, written, bvp, fmt, ap);
+    va_end(ap);
+}
+
+static void BM_UserIOSetBLOB(benchmark::State &state)
+{
+    std::vector<char> frame(size_t(state.range(0)), 0x5a);
+
+    IBLOB bp;
+    memset(&bp, 0, sizeof(bp));
+    strcpy(bp.name, "CCD1");
+    strcpy(bp.format, ".fits");
+    bp.blob = frame.data();
+    bp.bloblen = int(frame.size());
+    bp.size = int(frame.size());
+
+    IBLOBVectorProperty bvp;
+    memset(&bvp, 0, sizeof(bvp));
+    strcpy(bvp.device, "CCD Simulator");
+    strcpy(bvp.name, "CCD1");
+    bvp.bp = &bp;
+    bvp.nbp = 1;
+
+    size_t written = 0;
+    for (auto _ : state)
+        setBlob(&written, &bvp, nullptr);
+    state.SetBytesProcessed(int64_t(written));
+}
+BENCHMARK(BM_UserIOSetBLOB)->Arg(64 << 10)->Arg(4 << 20)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv)
+{
+    return perfMain(argc, argv);
+}
@@ -0,0 +1,103 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Requests per second a driver can take in, from the XML element to its ISNew* entry point
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "indidevapi.h"
+#include "indibase.h"
+#include "indidriver.h"
+#include "lilxml.h"
+
+#include "perf_main.h"
+
+#define DEVICE "Bench Device"
+
+// Properties stay defined for the whole run, at most that many
+#define MAXPROPERTIES 512
+
+static INumber numbers[MAXPROPERTIES];
+static INumberVectorProperty vectors[MAXPROPERTIES];
+static int defined = 0;
+
+static void defineProperties(int count)
+{
+    for (; defined < count && defined < MAXPROPERTIES; defined++)
+    {
+        std::string name = "PROPERTY_" + std::to_string(defined);
+        IUFillNumber(&numbers[defined], "VALUE", "Value", "%g", -1e6, 1e6, 0, 0);
+        IUFillNumberVector(&vectors[defined], &numbers[defined], 1, DEVICE, name.c_str(), name.c_str(), "Main", IP_RW,
+                           60, IPS_IDLE);
+        IDDefNumber(&vectors[defined], nullptr);
+    }
+}
+
+static XMLEle *parseOne(const std::string &xml)
+{
+    char errmsg[MAXRBUF];
+    LilXML *lp = newLilXML();
+    XMLEle **nodes = parseXMLChunk(lp, const_cast<char *>(xml.data()), int(xml.size()), errmsg);
+    XMLEle *root = nodes ? nodes[0] : nullptr;
+    free(nodes);
+    delLilXML(lp);
+    return root;
+}
+
+static void dispatchBenchmark(benchmark::State &state, const std::string &xml)
+{
+    char msg[MAXRBUF];
+    XMLEle *root = parseOne(xml);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(dispatch(root, msg));
+
+    state.SetItemsProcessed(state.iterations());
+    delXMLEle(root);
+}
+
+// The property defined last, the worst case for a scan
+static void BM_DispatchNewNumber(benchmark::State &state)
+{
+    int count = int(state.range(0));
+    defineProperties(count);
+    dispatchBenchmark(state, "<newNumberVector device='" DEVICE "' name='PROPERTY_" + std::to_string(count - 1) +
+                      "'>\n  <oneNumber name='VALUE'>\n    42\n  </oneNumber>\n</newNumberVector>\n");
+}
+BENCHMARK(BM_DispatchNewNumber)->Arg(16)->Arg(256);
+
+// Messages from snooped devices, routed by tag only
+static void BM_DispatchSnooped(benchmark::State &state)
+{
+    defineProperties(256);
+    dispatchBenchmark(state, "<setNumberVector device='Other' name='EQUATORIAL_EOD_COORD' state='Ok'>\n"
+                      "  <oneNumber name='RA'>\n    5.59\n  </oneNumber>\n</setNumberVector>\n");
+}
+BENCHMARK(BM_DispatchSnooped);
+
+int main(int argc, char **argv)
+{
+    // The driver talks on stdout, so results go to stderr and the driver output is dropped
+    if (freopen("/dev/null", "w", stdout) == nullptr)
+        return 1;
+
+    return perfMain(argc, argv, std::cerr);
+}
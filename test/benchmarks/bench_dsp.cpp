@@ -0,0 +1,175 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Calibration of a frame with the vectorized dsp kernels, against the scalar loops they replace
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "dsp.h"
+
+#include "perf_main.h"
+
+// A 16 Mpixels frame, with its bias, dark and flat
+#define PIXELS (4096 * 4096)
+
+struct Frames
+{
+    std::vector<dsp_t> light, bias, dark, flat;
+
+    Frames() : light(PIXELS), bias(PIXELS), dark(PIXELS), flat(PIXELS)
+    {
+        for (int i = 0; i < PIXELS; i++)
+        {
+            unsigned int hash = i * 2654435761u;
+            light[i] = dsp_t(1000 + (hash >> 16));
+            bias[i]  = dsp_t(100 + (hash >> 28));
+            dark[i]  = dsp_t(hash >> 26);
+            flat[i]  = dsp_t(0.75 + (hash >> 24) / 1024.0);
+        }
+    }
+};
+
+static Frames &frames()
+{
+    static Frames f;
+    return f;
+}
+
+static dsp_stream_p lightStream()
+{
+    dsp_stream_p stream = dsp_stream_new();
+    dsp_stream_add_dim(stream, 4096);
+    dsp_stream_add_dim(stream, 4096);
+    dsp_stream_alloc_buffer(stream, stream->len);
+    return stream;
+}
+
+static void freeStream(dsp_stream_p stream)
+{
+    dsp_stream_free_buffer(stream);
+    dsp_stream_free(stream);
+}
+
+// The loops of dsp_buffer_sub, dsp_buffer_div and dsp_buffer_stretch before vectorization;
+// the macros of dsp.h take their scalar branch in C++
+static void calibrateScalar(dsp_stream_p stream, const Frames &f)
+{
+    for (int k = 0; k < stream->len; k++)
+        stream->buf[k] = stream->buf[k] - f.bias[k];
+    for (int k = 0; k < stream->len; k++)
+        stream->buf[k] = stream->buf[k] - f.dark[k];
+    for (int k = 0; k < stream->len; k++)
+        stream->buf[k] = stream->buf[k] / f.flat[k];
+    dsp_buffer_stretch(stream->buf, stream->len, 0, dsp_t_max);
+}
+
+static void calibrateVector(dsp_stream_p stream, Frames &f)
+{
+    dsp_buffer_calibrate(stream, f.bias.data(), f.dark.data(), f.flat.data(), 0, dsp_t_max);
+}
+
+static void BM_CalibrateScalar(benchmark::State &state)
+{
+    Frames &f = frames();
+    dsp_stream_p stream = lightStream();
+    for (auto _ : state)
+    {
+        memcpy(stream->buf, f.light.data(), sizeof(dsp_t) * PIXELS);
+        calibrateScalar(stream, f);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * PIXELS);
+    freeStream(stream);
+}
+BENCHMARK(BM_CalibrateScalar)->Unit(benchmark::kMillisecond);
+
+static void BM_CalibrateVector(benchmark::State &state)
+{
+    Frames &f = frames();
+    dsp_stream_p stream = lightStream();
+    for (auto _ : state)
+    {
+        memcpy(stream->buf, f.light.data(), sizeof(dsp_t) * PIXELS);
+        calibrateVector(stream, f);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * PIXELS);
+    freeStream(stream);
+}
+BENCHMARK(BM_CalibrateVector)->Unit(benchmark::kMillisecond);
+
+static void BM_StatsScalar(benchmark::State &state)
+{
+    dsp_t *buf = frames().light.data();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(dsp_stats_min(buf, PIXELS));
+        benchmark::DoNotOptimize(dsp_stats_max(buf, PIXELS));
+        benchmark::DoNotOptimize(dsp_stats_mean(buf, PIXELS));
+    }
+    state.SetItemsProcessed(state.iterations() * PIXELS);
+}
+BENCHMARK(BM_StatsScalar)->Unit(benchmark::kMillisecond);
+
+static void BM_StatsVector(benchmark::State &state)
+{
+    dsp_t *buf = frames().light.data();
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(dsp_simd_min(buf, PIXELS));
+        benchmark::DoNotOptimize(dsp_simd_max(buf, PIXELS));
+        benchmark::DoNotOptimize(dsp_simd_mean(buf, PIXELS));
+    }
+    state.SetItemsProcessed(state.iterations() * PIXELS);
+}
+BENCHMARK(BM_StatsVector)->Unit(benchmark::kMillisecond);
+
+// Both paths must give the same frame, or the numbers mean nothing: they match exactly with double samples,
+// to the rounding of the ratios with single precision ones
+static bool sameOutput()
+{
+    Frames &f = frames();
+    dsp_stream_p scalar = lightStream();
+    dsp_stream_p vector = lightStream();
+    memcpy(scalar->buf, f.light.data(), sizeof(dsp_t) * PIXELS);
+    memcpy(vector->buf, f.light.data(), sizeof(dsp_t) * PIXELS);
+    calibrateScalar(scalar, f);
+    calibrateVector(vector, f);
+    bool same = true;
+    for (int k = 0; k < PIXELS && same; k++)
+        same = std::fabs(scalar->buf[k] - vector->buf[k]) <= dsp_t_max * 1e-5;
+    same = same && dsp_stats_min(f.light.data(), PIXELS) == dsp_simd_min(f.light.data(), PIXELS) &&
+           dsp_stats_max(f.light.data(), PIXELS) == dsp_simd_max(f.light.data(), PIXELS);
+    freeStream(scalar);
+    freeStream(vector);
+    return same;
+}
+
+int main(int argc, char **argv)
+{
+    if (!sameOutput())
+    {
+        fprintf(stderr, "Vectorized calibration differs from the scalar one\n");
+        return 1;
+    }
+
+    return perfMain(argc, argv);
+}
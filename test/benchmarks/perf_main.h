@@ -0,0 +1,124 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+// Common main of the benchmarks, checking the results against a baseline.
+//
+// --baseline=<file> fails the run when a benchmark takes more than --baseline_tolerance (3 by default) times its
+// reference time. Each line of the file is the name of a benchmark and its real time per iteration in nanoseconds,
+// '#' starts a comment. Benchmarks missing from the file are not checked.
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class BaselineReporter : public benchmark::ConsoleReporter
+{
+    public:
+        void ReportRuns(const std::vector<Run> &runs) override
+        {
+            ConsoleReporter::ReportRuns(runs);
+            for (const auto &run : runs)
+            {
+                if (run.error_occurred || run.run_type != Run::RT_Iteration)
+                    continue;
+                times[run.benchmark_name()] = run.GetAdjustedRealTime() * 1e9 / benchmark::GetTimeUnitMultiplier(run.time_unit);
+            }
+        }
+
+        /** @returns The number of benchmarks slower than tolerance times their baseline, -1 if the file cannot be read */
+        int regressions(const std::string &fileName, double tolerance) const
+        {
+            std::ifstream file(fileName);
+            if (!file)
+                return -1;
+
+            int count = 0;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                std::istringstream fields(line.substr(0, line.find('#')));
+                std::string name;
+                double reference;
+                if (!(fields >> name >> reference))
+                    continue;
+
+                auto time = times.find(name);
+                if (time == times.end() || time->second <= reference * tolerance)
+                    continue;
+
+                fprintf(stderr, "Regression: %s takes %.0f ns, baseline is %.0f ns\n", name.c_str(), time->second, reference);
+                count++;
+            }
+            return count;
+        }
+
+    private:
+        std::map<std::string, double> times;
+};
+
+/**
+ * @brief Run the benchmarks selected on the command line.
+ * @param output Stream the results are printed to, drivers keep stdout for their messages.
+ * @return 0 if every benchmark ran within its baseline.
+ */
+inline int perfMain(int argc, char **argv, std::ostream &output = std::cout)
+{
+    std::string baseline;
+    double tolerance = 3;
+
+    // Our own flags go before benchmark sees the others
+    std::vector<char *> args;
+    for (int i = 0; i < argc; i++)
+    {
+        if (!strncmp(argv[i], "--baseline=", 11))
+            baseline = argv[i] + 11;
+        else if (!strncmp(argv[i], "--baseline_tolerance=", 21))
+            tolerance = atof(argv[i] + 21);
+        else
+            args.push_back(argv[i]);
+    }
+    argc = int(args.size());
+    args.push_back(nullptr);
+    argv = args.data();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+
+    BaselineReporter reporter;
+    reporter.SetOutputStream(&output);
+    reporter.SetErrorStream(&std::cerr);
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+    benchmark::Shutdown();
+
+    if (baseline.empty())
+        return 0;
+
+    int count = reporter.regressions(baseline, tolerance);
+    if (count < 0)
+        fprintf(stderr, "Cannot read the baseline %s\n", baseline.c_str());
+    return count == 0 ? 0 : 1;
+}
@@ -26,6 +26,9 @@
 
 #include "base64.h"
 
+#include <string>
+#include <vector>
+
 TEST(CORE_BASE64, Test_to64frombits)
 {
     const char   inp_msg[] = "FOOBARBAZ";
@@ -115,3 +118,92 @@ TEST(CORE_BASE64, Test_from64tobits_fast_with_bug_time)
     }
 }
 
+// Textbook encoder to check the vectorized one against
+static std::string referenceBase64(const std::vector<unsigned char> &in)
+{
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < in.size(); i += 3)
+    {
+        unsigned int n = in[i] << 16 | (i + 1 < in.size() ? in[i + 1] << 8 : 0) | (i + 2 < in.size() ? in[i + 2] : 0);
+        out += digits[n >> 18];
+        out += digits[(n >> 12) & 0x3f];
+        out += i + 1 < in.size() ? digits[(n >> 6) & 0x3f] : '=';
+        out += i + 2 < in.size() ? digits[n & 0x3f] : '=';
+    }
+    return out;
+}
+
+TEST(CORE_BASE64, Test_roundtrip_sizes)
+{
+    for (size_t size = 0; size < 600; size += (size < 200 ? 1 : 37))
+    {
+        std::vector<unsigned char> raw(size);
+        for (size_t i = 0; i < size; i++)
+            raw[i] = (unsigned char)(i * 2654435761u >> 11);
+
+        std::string expected = referenceBase64(raw);
+        std::vector<unsigned char> encoded(4 * size / 3 + 4);
+        int len = to64frombits_s(encoded.data(), raw.data(), int(size), encoded.size());
+        ASSERT_EQ(std::string(reinterpret_cast<char *>(encoded.data()), len), expected) << size;
+
+        if (size == 0)
+            continue;
+
+        // Plain, then wrapped at 72 columns as drivers send it
+        std::string wrapped;
+        for (size_t pos = 0; pos < expected.size(); pos += 72)
+            wrapped += (pos ? "\n" : "") + expected.substr(pos, 72);
+
+        for (const std::string &text : { expected, wrapped })
+        {
+            // The decoder may read and write past the data given line breaks. Leave room for it
+            std::string input = text + std::string(text.size(), 'A');
+            std::string reference = input;
+            std::vector<char> decoded(2 * size + 64), decodedReference(2 * size + 64);
+
+            int n = from64tobits_fast(decoded.data(), &input[0], int(text.size()));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            // The scalar loop, same as from64tobits_fast on little endian
+            int nReference = from64tobits_fast_with_bug(decodedReference.data(), &reference[0], int(text.size()));
+            ASSERT_EQ(n, nReference) << size;
+            ASSERT_EQ(decoded, decodedReference) << size;
+#endif
+            if (text.size() == expected.size())
+            {
+                ASSERT_EQ(size_t(n), size);
+                ASSERT_EQ(0, memcmp(decoded.data(), raw.data(), size)) << size;
+            }
+        }
+    }
+}
+
+TEST(CORE_BASE64, Test_multithreaded)
+{
+    // Large enough to be split when there are several cores
+    const size_t size = 5 * 1024 * 1024 + 1;
+    std::vector<unsigned char> raw(size);
+    for (size_t i = 0; i < size; i++)
+        raw[i] = (unsigned char)(i * 2654435761u >> 11);
+
+    std::vector<unsigned char> encoded(4 * size / 3 + 4), encodedReference(4 * size / 3 + 4);
+    int len = to64frombits_mt(encoded.data(), raw.data(), int(size), encoded.size());
+    int lenReference = to64frombits_s(encodedReference.data(), raw.data(), int(size), encodedReference.size());
+    ASSERT_EQ(len, lenReference);
+    ASSERT_EQ(encoded, encodedReference);
+
+    std::string text(reinterpret_cast<char *>(encoded.data()), len);
+    std::string wrapped;
+    for (size_t pos = 0; pos < text.size(); pos += 72)
+        wrapped += (pos ? "\n" : "") + text.substr(pos, 72);
+
+    std::vector<char> decoded(size + 64);
+    ASSERT_EQ(size_t(from64tobits_mt(decoded.data(), text.c_str(), int(text.size()))), size);
+    ASSERT_EQ(0, memcmp(decoded.data(), raw.data(), size));
+
+    // Only the first bytes are checked, the line breaks make the tail overshoot as in from64tobits_fast
+    std::string input = wrapped + std::string(wrapped.size() / 8, 'A');
+    std::vector<char> decodedWrapped(2 * size);
+    from64tobits_mt(decodedWrapped.data(), &input[0], int(wrapped.size()));
+    ASSERT_EQ(0, memcmp(decodedWrapped.data(), raw.data(), size));
+}
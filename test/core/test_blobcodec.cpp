@@ -0,0 +1,89 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <zlib.h>
+
+#include "blobcodec.h"
+
+static std::vector<uint8_t> frame(size_t size)
+{
+    // Compressible, but not so much that the stream is tiny
+    std::mt19937 generator(1);
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+        data[i] = static_cast<uint8_t>((i % 251) + (generator() % 4));
+    return data;
+}
+
+static std::vector<uint8_t> zlibCompress(const std::vector<uint8_t> &data)
+{
+    uLongf size = compressBound(data.size());
+    std::vector<uint8_t> compressed(size);
+    EXPECT_EQ(compress2(compressed.data(), &size, data.data(), data.size(), 9), Z_OK);
+    compressed.resize(size);
+    return compressed;
+}
+
+TEST(CORE_BLOBCODEC, CodecExtension)
+{
+    EXPECT_EQ(INDI::BlobDecompressor::codecExtension(".fits.z"), ".z");
+    EXPECT_EQ(INDI::BlobDecompressor::codecExtension(".fits"), "");
+    EXPECT_EQ(INDI::BlobDecompressor::codecExtension(".fits.fz"), "");
+    EXPECT_FALSE(INDI::BlobDecompressor(".fits").isValid());
+    EXPECT_TRUE(INDI::BlobDecompressor(".z").isValid());
+}
+
+TEST(CORE_BLOBCODEC, ZlibInPieces)
+{
+    auto data = frame(1 << 20);
+    auto compressed = zlibCompress(data);
+
+    // The announced size is too small, the output has to grow
+    INDI::BlobDecompressor decompressor(".z");
+    decompressor.setOutput(malloc(1000), 1000);
+    for (size_t offset = 0; offset < compressed.size(); offset += 997)
+        ASSERT_EQ(decompressor.write(compressed.data() + offset, std::min<size_t>(997, compressed.size() - offset)), 0);
+    EXPECT_EQ(decompressor.finish(), 0);
+
+    size_t size = 0;
+    void *output = decompressor.take(&size);
+    ASSERT_EQ(size, data.size());
+    EXPECT_EQ(memcmp(output, data.data(), size), 0);
+    free(output);
+}
+
+TEST(CORE_BLOBCODEC, ZlibErrors)
+{
+    auto data = frame(100000);
+    auto compressed = zlibCompress(data);
+
+    INDI::BlobDecompressor truncated(".z");
+    EXPECT_EQ(truncated.write(compressed.data(), compressed.size() / 2), 0);
+    EXPECT_NE(truncated.finish(), 0);
+
+    compressed[compressed.size() / 2] ^= 0xff;
+    compressed[compressed.size() / 2 + 1] ^= 0xff;
+    INDI::BlobDecompressor corrupted(".z");
+    EXPECT_NE(corrupted.write(compressed.data(), compressed.size()), 0);
+}
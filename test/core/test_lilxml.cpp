@@ -0,0 +1,252 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "lilxml.h"
+
+// Write down every event as one line, consecutive text pieces joined
+struct Events
+{
+    std::string log;
+    int textPieces = 0;
+    bool inText = false;
+
+    void add(const std::string &line)
+    {
+        log += line + "\n";
+        inText = false;
+    }
+};
+
+static void onStart(void *ctx, const char *tag)
+{
+    static_cast<Events *>(ctx)->add(std::string("start ") + tag);
+}
+
+static void onAttribute(void *ctx, const char *name, const char *value)
+{
+    static_cast<Events *>(ctx)->add(std::string("attr ") + name + "=" + value);
+}
+
+static void onText(void *ctx, const char *text, int len)
+{
+    Events *events = static_cast<Events *>(ctx);
+    if (events->inText)
+        events->log.pop_back();
+    else
+        events->log += "text ";
+    events->log += std::string(text, len) + "\n";
+    events->inText = true;
+    events->textPieces++;
+}
+
+static void onEnd(void *ctx, const char *tag)
+{
+    static_cast<Events *>(ctx)->add(std::string("end ") + tag);
+}
+
+static const XMLSaxHandler recorder = { onStart, onAttribute, onText, onEnd };
+
+static Events saxParse(const std::string &xml, size_t chunk)
+{
+    Events events;
+    char err[1024] = {0, };
+    LilXML *lp = newLilXML();
+    setXMLSaxHandler(lp, &recorder, &events);
+    for (size_t pos = 0; pos < xml.size(); pos += chunk)
+    {
+        std::string part = xml.substr(pos, chunk);
+        XMLEle **nodes = parseXMLChunk(lp, &part[0], int(part.size()), err);
+        EXPECT_NE(nodes, nullptr) << err;
+        if (nodes)
+        {
+            EXPECT_EQ(nodes[0], nullptr);
+            free(nodes);
+        }
+    }
+    delLilXML(lp);
+    return events;
+}
+
+TEST(CORE_LILXML, SaxEvents)
+{
+    const std::string xml =
+        "<setNumberVector device='dev' name='n' state=\"Ok\">\n"
+        "  <oneNumber name='a'>\n  1.5\n  </oneNumber>\n"
+        "  <oneNumber name='b'/>\n"
+        "</setNumberVector>"
+        "<message message='x &amp; y'/>";
+
+    const std::string expected =
+        "start setNumberVector\nattr device=dev\nattr name=n\nattr state=Ok\n"
+        "start oneNumber\nattr name=a\ntext 1.5\nend oneNumber\n"
+        "start oneNumber\nattr name=b\nend oneNumber\n"
+        "end setNumberVector\n"
+        "start message\nattr message=x & y\nend message\n";
+
+    ASSERT_EQ(saxParse(xml, xml.size()).log, expected);
+}
+
+TEST(CORE_LILXML, SaxStreamsText)
+{
+    std::string payload;
+    for (int i = 0; i < 2000; i++)
+        payload += char('A' + i % 26);
+
+    const std::string xml = "<oneBLOB name='b'>" + payload + "&lt;</oneBLOB>";
+
+    // Content comes in pieces as chunks arrive, but nothing is lost
+    Events events = saxParse(xml, 100);
+    ASSERT_EQ(events.log, "start oneBLOB\nattr name=b\ntext " + payload + "<\nend oneBLOB\n");
+    ASSERT_GT(events.textPieces, 1);
+}
+
+TEST(CORE_LILXML, SaxSameEventsWhateverTheChunking)
+{
+    const std::string xml = "<a x='1'><b>text</b><c y='2'><d/></c>tail</a>";
+    const std::string whole = saxParse(xml, xml.size()).log;
+    ASSERT_EQ(whole, "start a\nattr x=1\nstart b\ntext text\nend b\nstart c\nattr y=2\nstart d\nend d\nend c\n"
+              "text tail\nend a\n");
+    for (size_t chunk = 1; chunk < xml.size(); chunk++)
+        ASSERT_EQ(saxParse(xml, chunk).log, whole) << "chunk " << chunk;
+}
+
+TEST(CORE_LILXML, InternedNames)
+{
+    char err[1024] = {0, };
+    char xml[] = "<setNumberVector device='dev' name='n' custom='c'><oneNumber name='a'>1</oneNumber></setNumberVector>";
+    LilXML *lp = newLilXML();
+    XMLEle **nodes = parseXMLChunk(lp, xml, int(strlen(xml)), err);
+    ASSERT_NE(nodes, nullptr) << err;
+    XMLEle *root = nodes[0];
+    ASSERT_NE(root, nullptr);
+    free(nodes);
+    delLilXML(lp);
+
+    const char *device = internXMLName("device");
+    ASSERT_STREQ(device, "device");
+    ASSERT_EQ(internXMLName("device"), device);
+    ASSERT_EQ(tagXMLEle(root), internXMLName("setNumberVector"));
+    ASSERT_STREQ(findXMLAttValu(root, device), "dev");
+    ASSERT_STREQ(findXMLAttValu(root, "device"), "dev");
+    ASSERT_STREQ(findXMLAttValu(root, "custom"), "c");
+    ASSERT_STREQ(findXMLAttValu(root, internXMLName("state")), "");
+    ASSERT_NE(findXMLEle(root, internXMLName("oneNumber")), nullptr);
+
+    // Names not in the vocabulary are kept as they are
+    const char *custom = "custom";
+    ASSERT_EQ(internXMLName(custom), custom);
+
+    addXMLAtt(root, "state", "Ok");
+    ASSERT_STREQ(findXMLAttValu(root, internXMLName("state")), "Ok");
+    delXMLEle(root);
+}
+
+static XMLEle *parseOne(std::string xml)
+{
+    char err[1024] = {0, };
+    LilXML *lp = newLilXML();
+    XMLEle **nodes = parseXMLChunk(lp, &xml[0], int(xml.size()), err);
+    XMLEle *root = nodes ? nodes[0] : nullptr;
+    free(nodes);
+    delLilXML(lp);
+    return root;
+}
+
+TEST(CORE_LILXML, SinglePassPrint)
+{
+    XMLEle *root = parseOne("<setBLOBVector device='d' name='b'><oneBLOB name='x'>QUJD</oneBLOB><oneBLOB name='y'/>"
+                            "<oneBLOB name='z'>a&amp;b</oneBLOB></setBLOBVector>");
+    ASSERT_NE(root, nullptr);
+
+    std::string reference(sprlXMLEle(root, 0), '\0');
+    sprXMLEle(&reference[0], root, 0);
+
+    XMLEle *cdata[3];
+    for (int i = 0; i < 3; i++)
+        cdata[i] = nextXMLEle(root, i == 0);
+    size_t offsets[3];
+
+    char *printed = nullptr;
+    size_t len = sprXMLEleAlloc(&printed, root, 0, cdata, offsets, 3);
+    ASSERT_EQ(std::string(printed, len), reference);
+    ASSERT_EQ(printed[len], '\0');
+    for (int i = 0; i < 3; i++)
+        ASSERT_EQ(offsets[i], sprXMLCDataOffset(root, cdata[i], 0)) << i;
+    ASSERT_EQ(offsets[1], (size_t) -1);
+    free(printed);
+    delXMLEle(root);
+}
+
+TEST(CORE_LILXML, KnownAttributes)
+{
+    XMLEle *root = parseOne("<oneNumber format='%g' name='first' name='second' min='0'/>");
+    ASSERT_NE(root, nullptr);
+
+    ASSERT_STREQ(findXMLAttValu(root, "name"), "first");
+    ASSERT_STREQ(findXMLAttValu(root, internXMLName("format")), "%g");
+    ASSERT_STREQ(findXMLAttValu(root, "min"), "0");
+    ASSERT_EQ(findXMLAtt(root, "device"), nullptr);
+
+    rmXMLAtt(root, "name");
+    ASSERT_STREQ(findXMLAttValu(root, "name"), "second");
+    rmXMLAtt(root, "name");
+    ASSERT_EQ(findXMLAtt(root, "name"), nullptr);
+
+    addXMLAtt(root, "device", "dev");
+    ASSERT_STREQ(findXMLAttValu(root, "device"), "dev");
+    ASSERT_EQ(nXMLAtt(root), 3);
+    delXMLEle(root);
+}
+
+static void noRelease(char *, void *)
+{ }
+
+TEST(CORE_LILXML, SharedContentAfterComment)
+{
+    // The content resumes after a comment, its first char is not right before the rest in the buffer
+    for (const std::string &head : {std::string("<a>x<!-- c -->"), std::string("<a>&lt;"), std::string("<a>x <!---->")})
+    {
+        std::string xml = head + std::string(2000, 'B') + "</a>";
+        std::string copy = xml;
+        char err[1024] = {0, };
+
+        LilXML *lp = newLilXML();
+        XMLEle **nodes = parseXMLChunkShared(lp, &xml[0], int(xml.size()), err, noRelease, nullptr);
+        ASSERT_NE(nodes, nullptr) << err;
+        ASSERT_NE(nodes[0], nullptr) << err;
+
+        XMLEle *expected = parseOne(copy);
+        ASSERT_NE(expected, nullptr);
+        EXPECT_EQ(std::string(pcdataXMLEle(nodes[0]), pcdatalenXMLEle(nodes[0])),
+                  std::string(pcdataXMLEle(expected), pcdatalenXMLEle(expected)));
+        EXPECT_NE(pcdataXMLEle(nodes[0])[0], '>');
+
+        delXMLEle(expected);
+        delXMLEle(nodes[0]);
+        free(nodes);
+        delLilXML(lp);
+    }
+}
@@ -23,6 +23,8 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
 
 #include "basedevice.h"
 
@@ -513,3 +515,59 @@ TEST(CORE_PROPERTY_CLASS, Test_PropertyBlob)
     ASSERT_EQ(INDI::PropertyLight(INDI::Property(p)).isValid(), false);
     ASSERT_EQ(INDI::PropertyBlob(INDI::Property(p)).isValid(), true);
 }
+
+TEST(CORE_PROPERTY_CLASS, Test_PropertyBlobArray)
+{
+    INDI::PropertyBlob p{2};
+
+    const uint32_t histogram[] = {0, 1, 65536, 4000000000u};
+    const float spectrum[] = {0.5f, -1.25f, 3e9f};
+
+    ASSERT_TRUE(p.setArray(0, histogram, 4));
+    ASSERT_TRUE(p.setArray(1, spectrum, 3));
+    ASSERT_FALSE(p.setArray(2, spectrum, 3));
+
+    ASSERT_STREQ(p[0].getFormat(), ".array");
+    ASSERT_EQ(p[0].getBlobLen(), 16 + 4 * 4);
+    ASSERT_EQ(p.getArrayType(0), INDI::PropertyBlob::ArrayType::UInt32);
+    ASSERT_EQ(p.getArrayType(1), INDI::PropertyBlob::ArrayType::Float32);
+
+    std::vector<uint32_t> integers;
+    ASSERT_TRUE(p.getArray(0, integers));
+    ASSERT_EQ(integers, std::vector<uint32_t>(histogram, histogram + 4));
+
+    std::vector<double> reals;
+    ASSERT_TRUE(p.getArray(1, reals));
+    ASSERT_EQ(reals, std::vector<double>(spectrum, spectrum + 3));
+
+    // a truncated array is rejected
+    p[1].setBlobLen(16 + 4 * 2);
+    ASSERT_FALSE(p.getArray(1, reals));
+    ASSERT_EQ(p.getArrayType(1), INDI::PropertyBlob::ArrayType::Invalid);
+
+    // any other content is not an array
+    char image[] = "SIMPLE  =                    T";
+    p[1].setBlob(image);
+    p[1].setBlobLen(sizeof(image));
+    ASSERT_EQ(p.getArrayType(1), INDI::PropertyBlob::ArrayType::Invalid);
+}
+
+TEST(CORE_PROPERTY_CLASS, Test_IndexedMembers)
+{
+    INDI::PropertySwitch p{32};
+
+    for (int i = 0; i < 32; i++)
+        p[i].setName(("widget " + std::to_string(i)).c_str());
+
+    IUIndexMembers(&p[0], 32, sizeof(ISwitch));
+
+    for (int i = 0; i < 32; i++)
+        ASSERT_EQ(p.findWidgetByName(("widget " + std::to_string(i)).c_str()), &p[i]);
+    ASSERT_EQ(p.findWidgetByName("widget 32"), nullptr);
+
+    // renamed after indexing, still found
+    p[7].setName("widget renamed");
+    ASSERT_EQ(p.findWidgetByName("widget renamed"), &p[7]);
+    ASSERT_EQ(p.findWidgetByName("widget 7"), nullptr);
+    ASSERT_EQ(p.findWidgetByName("widget 8"), &p[8]);
+}
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "indistreamcompression.h"
+
+using namespace INDI::StreamCompression;
+
+static std::string messages(size_t size)
+{
+    // Numbers that vary, like telemetry, so that they do not compress to nothing
+    std::mt19937 generator(1);
+    std::string xml;
+    while (xml.size() < size)
+    {
+        xml += "<setNumberVector device='Telescope' name='EQUATORIAL_EOD_COORD' state='Ok'>\n";
+        xml += "    <oneNumber name='RA'>" + std::to_string(generator()) + "</oneNumber>\n";
+        xml += "</setNumberVector>\n";
+    }
+    return xml;
+}
+
+static void roundTrip(Codec codec, const std::vector<std::string> &writes)
+{
+    Compressor compressor(codec);
+    Decompressor decompressor(codec);
+    ASSERT_TRUE(compressor.isValid());
+    ASSERT_TRUE(decompressor.isValid());
+
+    for (const auto &write : writes)
+    {
+        // Each write is one flushed frame, that must decode whole on its own
+        std::vector<char> frames;
+        ASSERT_TRUE(compressor.add(write.data(), write.size(), false, frames));
+        ASSERT_TRUE(compressor.flush(frames));
+
+        std::vector<char> out;
+        ASSERT_TRUE(decompressor.read(frames.data(), frames.size(), out));
+        ASSERT_EQ(out.size(), write.size());
+        EXPECT_EQ(std::string(out.begin(), out.end()), write);
+    }
+}
+
+TEST(CORE_STREAMCOMPRESSION, DeflateLargeFrames)
+{
+    roundTrip(CODEC_DEFLATE, { messages(100), messages(200000), messages(1 << 20), messages(100) });
+}
+
+#ifdef HAVE_ZSTD
+TEST(CORE_STREAMCOMPRESSION, ZstdLargeFrames)
+{
+    // Larger than the output buffer of a single ZSTD_decompressStream call
+    roundTrip(CODEC_ZSTD, { messages(100), messages(ZSTD_DStreamOutSize() + 1000), messages(1 << 20), messages(100) });
+}
+#endif
+
+TEST(CORE_STREAMCOMPRESSION, RawFrames)
+{
+    Compressor compressor(CODEC_DEFLATE);
+    Decompressor decompressor(CODEC_DEFLATE);
+
+    std::string const before = messages(1000), blob(300000, 'A'), after = messages(1000);
+    std::vector<char> frames;
+    ASSERT_TRUE(compressor.add(before.data(), before.size(), false, frames));
+    ASSERT_TRUE(compressor.add(blob.data(), blob.size(), true, frames));
+    ASSERT_TRUE(compressor.add(after.data(), after.size(), false, frames));
+    ASSERT_TRUE(compressor.flush(frames));
+
+    // Fed in small pieces, frame headers get split
+    std::vector<char> out;
+    for (size_t i = 0; i < frames.size(); i += 7)
+        ASSERT_TRUE(decompressor.read(frames.data() + i, std::min<size_t>(7, frames.size() - i), out));
+    EXPECT_EQ(std::string(out.begin(), out.end()), before + blob + after);
+}
@@ -0,0 +1,62 @@
+/*******************************************************************************
+ This library is free software; you can redistribute it and/or
+ modify it under the terms of the GNU Library General Public
+ License version 2 as published by the Free Software Foundation.
+ .
+ This library is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ Library General Public License for more details.
+ .
+ You should have received a copy of the GNU Library General Public License
+ along with this library; see the file COPYING.LIB.  If not, write to
+ the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ Boston, MA 02110-1301, USA.
+*******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "userio.h"
+
+static std::string formatNumber(double value)
+{
+    char buff[USERIO_NUMBER_SIZE];
+    size_t length = userio_format_number(buff, value);
+    EXPECT_EQ(length, strlen(buff));
+    return buff;
+}
+
+TEST(CORE_USERIO, FormatIntegers)
+{
+    EXPECT_EQ(formatNumber(0), "0");
+    EXPECT_EQ(formatNumber(42), "42");
+    EXPECT_EQ(formatNumber(-7), "-7");
+    EXPECT_EQ(formatNumber(1000000), "1000000");
+    EXPECT_EQ(formatNumber(9007199254740991.0), "9007199254740991");
+}
+
+TEST(CORE_USERIO, FormatShortest)
+{
+    EXPECT_EQ(formatNumber(0.1), "0.1");
+    EXPECT_EQ(formatNumber(-12.25), "-12.25");
+    EXPECT_EQ(strtod(formatNumber(1e-7).c_str(), nullptr), 1e-7);
+    EXPECT_EQ(strtod(formatNumber(1e300).c_str(), nullptr), 1e300);
+}
+
+TEST(CORE_USERIO, FormatReadsBack)
+{
+    std::mt19937_64 generator(1);
+    std::uniform_real_distribution<double> hours(0, 24);
+    for (int i = 0; i < 10000; i++)
+    {
+        double const value = hours(generator);
+        EXPECT_EQ(strtod(formatNumber(value).c_str(), nullptr), value);
+        EXPECT_EQ(strtod(formatNumber(-value * 1e-9).c_str(), nullptr), -value * 1e-9);
+    }
+}
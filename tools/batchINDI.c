@@ -0,0 +1,861 @@
+/* connect once to an INDI server and answer get, set and wait queries read
+ *   from stdin, one per line, until end of input or quit.
+ * Definitions are fetched on demand, with getProperties restricted to the
+ *   device or the property asked for, and kept up to date from the set
+ *   messages, so most queries are answered without waiting for the server.
+ * Every answer ends with a line "OK" or "ERR reason", made for scripts
+ *   driving the tool as a coprocess.
+ * BLOBs are not handled, use getINDI for them.
+ * exit status: 0 end of input, 2 real trouble.
+ */
+
+#include "indiapi.h"
+#include "lilxml.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+/* definition and matching new message of each type we handle */
+typedef struct
+{
+    char *defType; /* defXXXVector name */
+    char *defOne;  /* defXXX name */
+    char *setType; /* setXXXVector name */
+    char *newType; /* newXXXVector name, NULL if read only */
+    char *oneType; /* oneXXX name */
+} INDIDef;
+static INDIDef defs[] = {
+    { "defTextVector", "defText", "setTextVector", "newTextVector", "oneText" },
+    { "defNumberVector", "defNumber", "setNumberVector", "newNumberVector", "oneNumber" },
+    { "defSwitchVector", "defSwitch", "setSwitchVector", "newSwitchVector", "oneSwitch" },
+    { "defLightVector", "defLight", "setLightVector", NULL, "oneLight" },
+};
+#define NDEFS (sizeof(defs) / sizeof(defs[0]))
+
+/* table of keyword to use in query vs name of INDI defXXX attribute */
+typedef struct
+{
+    char *keyword;
+    char *indiattr;
+} INDIkwattr;
+static INDIkwattr kwattr[] = {
+    { "_LABEL", "label" }, { "_GROUP", "group" }, { "_STATE", "state" },
+    { "_PERM", "perm" },   { "_TO", "timeout" },  { "_TS", "timestamp" },
+};
+#define NKWA (sizeof(kwattr) / sizeof(kwattr[0]))
+
+/* a known property, with its definition kept up to date */
+typedef struct
+{
+    char *d;     /* device */
+    char *p;     /* property */
+    INDIDef *dp; /* its type */
+    XMLEle *def; /* defXXXVector, values edited by setXXXVector */
+} Property;
+static Property *props;
+static int nprops;
+
+/* devices we asked all properties of, "*" for all devices */
+static char **fetched;
+static int nfetched;
+
+/* one device.property.element of a query */
+typedef struct
+{
+    char d[MAXINDIDEVICE];
+    char p[MAXINDINAME];
+    char e[MAXINDINAME];
+} Search;
+
+/* the query waiting for the server, if any */
+enum { Q_NONE, Q_GET, Q_SET, Q_WAIT };
+static struct
+{
+    int kind;
+    Search s[32];
+    int ns;
+    char ev[2048];          /* set: elements and values, wait: value */
+    struct timeval end;     /* give up */
+    struct timeval settle;  /* no definition since, wild cards are complete */
+    int wild;               /* waiting for a wild card fetch */
+} query;
+
+static void usage(void);
+static void openINDIServer(void);
+static void run(void);
+static void readServer(void);
+static void readCommands(void);
+static void runCommands(void);
+static void command(char *line);
+static void startQuery(int kind, char *args);
+static int crackSearch(char *spec, Search *sp, char *ev, int evsize);
+static void fetch(Search *sp);
+static int isFetched(const char *dev);
+static void checkQuery(void);
+static void answer(int timedout);
+static void printMatches(Search *sp, int *found);
+static int sendSet(void);
+static int waitDone(void);
+static void serverMessage(XMLEle *root);
+static void defineProperty(XMLEle *root, INDIDef *dp);
+static void updateProperty(XMLEle *root, INDIDef *dp);
+static void deleteProperty(XMLEle *root);
+static Property *findProperty(const char *dev, const char *name);
+static const char *elementValue(Property *pp, const char *name);
+static void later(struct timeval *tv, long ms);
+static int passed(const struct timeval *tv);
+
+static char *me;                      /* our name for usage() message */
+static char host_def[] = "localhost"; /* default host name */
+static char *host      = host_def;    /* working host name */
+#define INDIPORT 7624                 /* default port */
+static int port = INDIPORT;           /* working port number */
+#define TIMEOUT 2                     /* default timeout, secs */
+static int timeout = TIMEOUT;         /* working timeout, secs */
+#define SETTLE 200                    /* quiet time ending a wild card fetch, ms */
+static int verbose;                   /* report extra info */
+static LilXML *lillp;                 /* XML parser context */
+#define WILDCARD '*'                  /* match all in this category */
+static int svrfd = -1;                /* connection to the server */
+static FILE *svrwfp;                  /* FILE * to talk to server */
+static int eof;                       /* end of stdin seen */
+static char cmdline[4096];            /* commands read, not run yet */
+static size_t cmdlen;
+
+int main(int ac, char *av[])
+{
+    /* save our name */
+    me = av[0];
+
+    /* crack args */
+    while (--ac && **++av == '-')
+    {
+        char *s = *av;
+        while (*++s)
+        {
+            switch (*s)
+            {
+                case 'h':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-h requires host name\n");
+                        usage();
+                    }
+                    host = *++av;
+                    ac--;
+                    break;
+                case 'p':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-p requires tcp port number\n");
+                        usage();
+                    }
+                    port = atoi(*++av);
+                    ac--;
+                    break;
+                case 't':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-t requires timeout\n");
+                        usage();
+                    }
+                    timeout = atoi(*++av);
+                    ac--;
+                    break;
+                case 'v': /* verbose */
+                    verbose++;
+                    break;
+                default:
+                    fprintf(stderr, "Unknown flag: %c\n", *s);
+                    usage();
+            }
+        }
+    }
+
+    if (ac > 0)
+        usage();
+
+    openINDIServer();
+    if (verbose)
+        fprintf(stderr, "Connected to %s on port %d\n", host, port);
+
+    /* build a parser context for cracking XML responses */
+    lillp = newLilXML();
+
+    run();
+
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Purpose: answer many queries over one connection to an INDI server\n");
+    fprintf(stderr, "%s\n", GIT_TAG_STRING);
+    fprintf(stderr, "Usage: %s [options]\n", me);
+    fprintf(stderr, "Reads one command per line from stdin:\n");
+    fprintf(stderr, "  get device.property.element ...\n");
+    fprintf(stderr, "      print fully qualified name=value of each match, as getINDI does.\n");
+    fprintf(stderr, "      Any component may be \"*\", element may be one of:\n");
+    for (int i = 0; i < (int)NKWA; i++)
+        fprintf(stderr, "        %10s to report %s\n", kwattr[i].keyword, kwattr[i].indiattr);
+    fprintf(stderr, "  set device.property.e1[;e2...]=v1[;v2...]\n");
+    fprintf(stderr, "  set device.property.e1=v1[;e2=v2...]\n");
+    fprintf(stderr, "      send new values, as setINDI does.\n");
+    fprintf(stderr, "  wait device.property.element=value\n");
+    fprintf(stderr, "      wait until the element, or attribute keyword, has the value.\n");
+    fprintf(stderr, "      Mind that after a set, the state may still be the one before it.\n");
+    fprintf(stderr, "  quit\n");
+    fprintf(stderr, "Each answer ends with a line \"OK\", or \"ERR\" followed by the reason.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -h h  : alternate host, default is %s\n", host_def);
+    fprintf(stderr, "  -p p  : alternate port, default is %d\n", INDIPORT);
+    fprintf(stderr, "  -t t  : max time to wait for each query, default is %d secs\n", TIMEOUT);
+    fprintf(stderr, "  -v    : verbose (cumulative)\n");
+    fprintf(stderr, "Exit status:\n");
+    fprintf(stderr, "  0: end of input or quit\n");
+    fprintf(stderr, "  2: real trouble, try repeating with -v\n");
+
+    exit(2);
+}
+
+/* open a connection to the given host and port.
+ * set svrfd and svrwfp or die.
+ */
+static void openINDIServer(void)
+{
+    struct sockaddr_in serv_addr;
+    struct hostent *hp;
+
+    /* lookup host address */
+    hp = gethostbyname(host);
+    if (!hp)
+    {
+        herror("gethostbyname");
+        exit(2);
+    }
+
+    /* create a socket to the INDI server */
+    (void)memset((char *)&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family      = AF_INET;
+    serv_addr.sin_addr.s_addr = ((struct in_addr *)(hp->h_addr_list[0]))->s_addr;
+    serv_addr.sin_port        = htons(port);
+    if ((svrfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        perror("socket");
+        exit(2);
+    }
+
+    /* connect */
+    if (connect(svrfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    {
+        perror("connect");
+        exit(2);
+    }
+
+    /* reads go through select, only writes are buffered */
+    svrwfp = fdopen(svrfd, "w");
+}
+
+/* wait for the server and stdin, stdin only while no query is pending */
+static void run(void)
+{
+    while (!eof || query.kind != Q_NONE || memchr(cmdline, '\n', cmdlen))
+    {
+        fd_set rfds;
+        struct timeval tv = { 0, 20000 };
+        int maxfd = svrfd;
+
+        FD_ZERO(&rfds);
+        FD_SET(svrfd, &rfds);
+        if (!eof && query.kind == Q_NONE)
+            FD_SET(0, &rfds);
+
+        if (select(maxfd + 1, &rfds, NULL, NULL, query.kind != Q_NONE ? &tv : NULL) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("select");
+            exit(2);
+        }
+
+        if (FD_ISSET(svrfd, &rfds))
+            readServer();
+        if (query.kind != Q_NONE)
+        {
+            checkQuery();
+            runCommands();
+        }
+        if (FD_ISSET(0, &rfds))
+            readCommands();
+    }
+}
+
+/* parse whatever the server sent */
+static void readServer(void)
+{
+    char buf[32768], msg[1024];
+    ssize_t n = read(svrfd, buf, sizeof(buf));
+
+    if (n <= 0)
+    {
+        if (n < 0)
+            perror("read");
+        else
+            fprintf(stderr, "INDI server %s/%d disconnected\n", host, port);
+        exit(2);
+    }
+
+    for (ssize_t i = 0; i < n; i++)
+    {
+        XMLEle *root = readXMLEle(lillp, buf[i], msg);
+        if (root)
+        {
+            if (verbose > 1)
+                prXMLEle(stderr, root, 0);
+            serverMessage(root);
+        }
+        else if (msg[0])
+        {
+            fprintf(stderr, "Bad XML from %s/%d: %s\n", host, port, msg);
+            exit(2);
+        }
+    }
+}
+
+/* read what stdin has, then run the complete lines */
+static void readCommands(void)
+{
+    ssize_t n = read(0, cmdline + cmdlen, sizeof(cmdline) - 1 - cmdlen);
+
+    if (n <= 0)
+    {
+        /* a last line without new line */
+        if (cmdlen > 0 && cmdlen < sizeof(cmdline) - 1)
+            cmdline[cmdlen++] = '\n';
+        eof = 1;
+    }
+    else
+    {
+        cmdlen += n;
+    }
+
+    if (cmdlen == sizeof(cmdline) - 1 && memchr(cmdline, '\n', cmdlen) == NULL)
+    {
+        fprintf(stderr, "Command too long\n");
+        exit(2);
+    }
+
+    runCommands();
+}
+
+/* run the lines read so far, up to the first one that must wait for the server */
+static void runCommands(void)
+{
+    char *nl;
+
+    while (query.kind == Q_NONE && (nl = memchr(cmdline, '\n', cmdlen)) != NULL)
+    {
+        *nl = '\0';
+        command(cmdline);
+        cmdlen -= nl + 1 - cmdline;
+        memmove(cmdline, nl + 1, cmdlen);
+    }
+}
+
+/* crack one command line */
+static void command(char *line)
+{
+    char *verb = strtok(line, " \t\r");
+    char *args = strtok(NULL, "\r");
+
+    if (verb == NULL || verb[0] == '#')
+        return;
+
+    if (verbose)
+        fprintf(stderr, "command %s %s\n", verb, args ? args : "");
+
+    if (!strcmp(verb, "quit"))
+    {
+        fflush(stdout);
+        exit(0);
+    }
+    else if (!strcmp(verb, "get"))
+        startQuery(Q_GET, args);
+    else if (!strcmp(verb, "set"))
+        startQuery(Q_SET, args);
+    else if (!strcmp(verb, "wait"))
+        startQuery(Q_WAIT, args);
+    else
+    {
+        printf("ERR unknown command %s\n", verb);
+        fflush(stdout);
+    }
+}
+
+/* crack the arguments of a query, ask the server what is not known yet */
+static void startQuery(int kind, char *args)
+{
+    char *spec;
+
+    memset(&query, 0, sizeof(query));
+    query.kind = kind;
+
+    for (spec = strtok(args, " \t"); spec; spec = strtok(NULL, " \t"))
+    {
+        /* only get takes several specs */
+        if (query.ns == (kind == Q_GET ? (int)(sizeof(query.s) / sizeof(query.s[0])) : 1) ||
+                crackSearch(spec, &query.s[query.ns], kind == Q_GET ? NULL : query.ev, sizeof(query.ev)) < 0)
+        {
+            printf("ERR bad spec %s\n", spec);
+            fflush(stdout);
+            query.kind = Q_NONE;
+            return;
+        }
+        if (kind != Q_GET && (strchr(query.s[0].d, WILDCARD) || strchr(query.s[0].p, WILDCARD)))
+        {
+            printf("ERR no wild cards in %s\n", spec);
+            fflush(stdout);
+            query.kind = Q_NONE;
+            return;
+        }
+        fetch(&query.s[query.ns++]);
+    }
+
+    if (query.ns == 0)
+    {
+        printf("ERR missing spec\n");
+        fflush(stdout);
+        query.kind = Q_NONE;
+        return;
+    }
+
+    later(&query.end, timeout * 1000L);
+    if (query.wild)
+        later(&query.settle, SETTLE);
+    checkQuery();
+}
+
+/* crack d.p.e, or d.p.ev with ev the rest when given, return -1 if bad */
+static int crackSearch(char *spec, Search *sp, char *ev, int evsize)
+{
+    char *p = strchr(spec, '.');
+    char *e = p ? strchr(p + 1, '.') : NULL;
+
+    if (p == NULL || e == NULL || p == spec || e == p + 1 || e[1] == '\0')
+        return (-1);
+    if (p - spec >= (int)sizeof(sp->d) || e - p - 1 >= (int)sizeof(sp->p))
+        return (-1);
+
+    memcpy(sp->d, spec, p - spec);
+    sp->d[p - spec] = '\0';
+    memcpy(sp->p, p + 1, e - p - 1);
+    sp->p[e - p - 1] = '\0';
+
+    if (ev)
+    {
+        if (strlen(e + 1) >= (size_t)evsize || strchr(e + 1, '=') == NULL)
+            return (-1);
+        strcpy(ev, e + 1);
+        return (0);
+    }
+
+    if (strlen(e + 1) >= sizeof(sp->e) || strchr(e + 1, '.'))
+        return (-1);
+    strcpy(sp->e, e + 1);
+    return (0);
+}
+
+/* issue the narrowest getProperties that covers sp, unless already asked */
+static void fetch(Search *sp)
+{
+    int wilddev  = strchr(sp->d, WILDCARD) != NULL;
+    int wildprop = strchr(sp->p, WILDCARD) != NULL;
+
+    if (isFetched("*") || (!wilddev && isFetched(sp->d)))
+        return;
+    if (!wilddev && !wildprop && findProperty(sp->d, sp->p))
+        return;
+
+    if (wilddev)
+        fprintf(svrwfp, "<getProperties version='%g'/>\n", INDIV);
+    else if (wildprop)
+        fprintf(svrwfp, "<getProperties version='%g' device='%s'/>\n", INDIV, sp->d);
+    else
+        fprintf(svrwfp, "<getProperties version='%g' device='%s' name='%s'/>\n", INDIV, sp->d, sp->p);
+    fflush(svrwfp);
+
+    if (verbose)
+        fprintf(stderr, "Queried properties of %s.%s\n", wilddev ? "*" : sp->d, wildprop ? "*" : sp->p);
+
+    if (wilddev || wildprop)
+    {
+        fetched            = (char **)realloc(fetched, (nfetched + 1) * sizeof(char *));
+        fetched[nfetched++] = strdup(wilddev ? "*" : sp->d);
+        query.wild         = 1;
+    }
+}
+
+/* return 1 if all properties of the device were asked for */
+static int isFetched(const char *dev)
+{
+    for (int i = 0; i < nfetched; i++)
+        if (!strcmp(fetched[i], dev))
+            return (1);
+    return (0);
+}
+
+/* answer the pending query if it can be */
+static void checkQuery(void)
+{
+    int timedout = passed(&query.end);
+    int known    = !query.wild || passed(&query.settle);
+
+    for (int i = 0; known && i < query.ns; i++)
+        if (!strchr(query.s[i].d, WILDCARD) && !strchr(query.s[i].p, WILDCARD))
+            known = findProperty(query.s[i].d, query.s[i].p) != NULL;
+
+    if (query.kind == Q_WAIT && known && !waitDone())
+        known = 0;
+
+    if (known || timedout)
+        answer(!known);
+}
+
+/* print the answer of the pending query and forget it */
+static void answer(int timedout)
+{
+    int found = 1;
+
+    switch (query.kind)
+    {
+        case Q_GET:
+            for (int i = 0; i < query.ns; i++)
+                printMatches(&query.s[i], &found);
+            if (found)
+                printf("OK\n");
+            else
+                printf("ERR not all found\n");
+            break;
+
+        case Q_SET:
+            if (timedout)
+                printf("ERR no %s.%s\n", query.s[0].d, query.s[0].p);
+            else if (sendSet() == 0)
+                printf("OK\n");
+            break;
+
+        case Q_WAIT:
+            if (timedout)
+                printf("ERR timeout\n");
+            else
+                printf("OK\n");
+            break;
+    }
+
+    fflush(stdout);
+    query.kind = Q_NONE;
+}
+
+/* print the values matching sp, clear found if none */
+static void printMatches(Search *sp, int *found)
+{
+    int any = 0;
+
+    for (int i = 0; i < nprops; i++)
+    {
+        Property *pp = &props[i];
+        XMLEle *ep;
+
+        if ((sp->d[0] != WILDCARD && strcmp(sp->d, pp->d)) || (sp->p[0] != WILDCARD && strcmp(sp->p, pp->p)))
+            continue;
+
+        /* check for attr keyword */
+        int kw = -1;
+        for (int k = 0; k < (int)NKWA; k++)
+            if (!strcmp(sp->e, kwattr[k].keyword))
+                kw = k;
+        if (kw >= 0)
+        {
+            printf("%s.%s.%s=%s\n", pp->d, pp->p, kwattr[kw].keyword, findXMLAttValu(pp->def, kwattr[kw].indiattr));
+            any = 1;
+            continue;
+        }
+
+        for (ep = nextXMLEle(pp->def, 1); ep; ep = nextXMLEle(pp->def, 0))
+        {
+            const char *enam = findXMLAttValu(ep, "name");
+            if (strcmp(tagXMLEle(ep), pp->dp->defOne) || (sp->e[0] != WILDCARD && strcmp(sp->e, enam)))
+                continue;
+            printf("%s.%s.%s=%s\n", pp->d, pp->p, enam, pcdataXMLEle(ep));
+            any = 1;
+        }
+    }
+
+    if (!any)
+    {
+        fprintf(stderr, "No %s.%s.%s from %s:%d\n", sp->d, sp->p, sp->e, host, port);
+        *found = 0;
+    }
+}
+
+/* send the new values of the pending set, in either form:
+ *    e1[;e2...]=v1[;v2...]
+ *  or
+ *    e1=v1[;e2=v2...]
+ * return -1 after printing the error if they do not fit the definition.
+ */
+static int sendSet(void)
+{
+    Property *pp = findProperty(query.s[0].d, query.s[0].p);
+    char *names[64], *values[64];
+    int n = 0, nv = 0;
+    char *ev = query.ev, *eq = strchr(ev, '=');
+
+    if (pp->dp->newType == NULL || !strcmp(findXMLAttValu(pp->def, "perm"), "ro"))
+    {
+        printf("ERR %s.%s is read only\n", pp->d, pp->p);
+        return (-1);
+    }
+
+    if (strchr(eq + 1, '='))
+    {
+        /* e1=v1;e2=v2 */
+        for (char *tok = strtok(ev, ";"); tok && n < 64; tok = strtok(NULL, ";"))
+        {
+            char *v = strchr(tok, '=');
+            if (v == NULL)
+                break;
+            *v          = '\0';
+            names[n]    = tok;
+            values[n++] = v + 1;
+        }
+        nv = n;
+    }
+    else
+    {
+        /* e1;e2=v1;v2 */
+        *eq = '\0';
+        for (char *tok = strtok(ev, ";"); tok && n < 64; tok = strtok(NULL, ";"))
+            names[n++] = tok;
+        for (char *tok = strtok(eq + 1, ";"); tok && nv < 64; tok = strtok(NULL, ";"))
+            values[nv++] = tok;
+    }
+
+    if (n == 0 || n != nv)
+    {
+        printf("ERR %d elements for %d values\n", n, nv);
+        return (-1);
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (elementValue(pp, names[i]) == NULL)
+        {
+            printf("ERR %s.%s has no element %s\n", pp->d, pp->p, names[i]);
+            return (-1);
+        }
+    }
+
+    fprintf(svrwfp, "<%s device='%s' name='%s'>\n", pp->dp->newType, pp->d, pp->p);
+    for (int i = 0; i < n; i++)
+    {
+        if (verbose)
+            fprintf(stderr, "  %s.%s.%s <- %s\n", pp->d, pp->p, names[i], values[i]);
+        fprintf(svrwfp, "  <%s name='%s'>%s</%s>\n", pp->dp->oneType, names[i], values[i], pp->dp->oneType);
+    }
+    fprintf(svrwfp, "</%s>\n", pp->dp->newType);
+    fflush(svrwfp);
+    if (feof(svrwfp) || ferror(svrwfp))
+    {
+        fprintf(stderr, "Send error\n");
+        exit(2);
+    }
+
+    return (0);
+}
+
+/* return 1 if the element of the pending wait has its value */
+static int waitDone(void)
+{
+    Property *pp = findProperty(query.s[0].d, query.s[0].p);
+    char e[MAXINDINAME];
+    const char *want = strchr(query.ev, '=') + 1;
+    const char *have = NULL;
+    char *end;
+
+    snprintf(e, sizeof(e), "%.*s", (int)(strchr(query.ev, '=') - query.ev), query.ev);
+
+    for (int k = 0; k < (int)NKWA; k++)
+        if (!strcmp(e, kwattr[k].keyword))
+            have = findXMLAttValu(pp->def, kwattr[k].indiattr);
+    if (have == NULL)
+        have = elementValue(pp, e);
+    if (have == NULL)
+        return (0);
+
+    /* numbers are compared by value, the server may format them differently */
+    double hv = strtod(have, &end);
+    if (end != have && *end == '\0')
+    {
+        double wv = strtod(want, &end);
+        if (end != want && *end == '\0')
+            return (hv == wv);
+    }
+
+    /* texts and lights, ignoring the white space around */
+    while (*have == ' ' || *have == '\n' || *have == '\t')
+        have++;
+    size_t len = strlen(have);
+    while (len > 0 && (have[len - 1] == ' ' || have[len - 1] == '\n' || have[len - 1] == '\t'))
+        len--;
+    return (len == strlen(want) && !strncmp(have, want, len));
+}
+
+/* keep the definitions up to date with one message of the server */
+static void serverMessage(XMLEle *root)
+{
+    const char *tag = tagXMLEle(root);
+
+    for (int i = 0; i < (int)NDEFS; i++)
+    {
+        if (!strcmp(tag, defs[i].defType))
+        {
+            /* the root is kept as the definition */
+            defineProperty(root, &defs[i]);
+            if (query.wild)
+                later(&query.settle, SETTLE);
+            return;
+        }
+        if (!strcmp(tag, defs[i].setType))
+        {
+            updateProperty(root, &defs[i]);
+            break;
+        }
+    }
+
+    if (!strcmp(tag, "delProperty"))
+        deleteProperty(root);
+
+    delXMLEle(root);
+}
+
+static void defineProperty(XMLEle *root, INDIDef *dp)
+{
+    const char *dev  = findXMLAttValu(root, "device");
+    const char *name = findXMLAttValu(root, "name");
+    Property *pp     = findProperty(dev, name);
+
+    if (pp)
+    {
+        delXMLEle(pp->def);
+    }
+    else
+    {
+        props    = (Property *)realloc(props, (nprops + 1) * sizeof(Property));
+        pp       = &props[nprops++];
+        pp->d    = strdup(dev);
+        pp->p    = strdup(name);
+    }
+
+    pp->dp  = dp;
+    pp->def = root;
+}
+
+static void updateProperty(XMLEle *root, INDIDef *dp)
+{
+    Property *pp = findProperty(findXMLAttValu(root, "device"), findXMLAttValu(root, "name"));
+    XMLEle *ep;
+
+    if (pp == NULL || pp->dp != dp)
+        return;
+
+    /* state, timeout and timestamp */
+    for (XMLAtt *ap = nextXMLAtt(root, 1); ap; ap = nextXMLAtt(root, 0))
+    {
+        const char *anam = nameXMLAtt(ap);
+        if (!strcmp(anam, "device") || !strcmp(anam, "name") || !strcmp(anam, "message"))
+            continue;
+        XMLAtt *dap = findXMLAtt(pp->def, anam);
+        if (dap)
+            editXMLAtt(dap, valuXMLAtt(ap));
+        else
+            addXMLAtt(pp->def, anam, valuXMLAtt(ap));
+    }
+
+    for (ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
+    {
+        const char *enam = findXMLAttValu(ep, "name");
+        for (XMLEle *dep = nextXMLEle(pp->def, 1); dep; dep = nextXMLEle(pp->def, 0))
+        {
+            if (!strcmp(tagXMLEle(dep), dp->defOne) && !strcmp(findXMLAttValu(dep, "name"), enam))
+            {
+                editXMLEle(dep, pcdataXMLEle(ep));
+                break;
+            }
+        }
+    }
+}
+
+static void deleteProperty(XMLEle *root)
+{
+    const char *dev  = findXMLAttValu(root, "device");
+    const char *name = findXMLAttValu(root, "name");
+
+    for (int i = 0; i < nprops;)
+    {
+        if (strcmp(props[i].d, dev) || (name[0] && strcmp(props[i].p, name)))
+        {
+            i++;
+            continue;
+        }
+        free(props[i].d);
+        free(props[i].p);
+        delXMLEle(props[i].def);
+        props[i] = props[--nprops];
+    }
+}
+
+static Property *findProperty(const char *dev, const char *name)
+{
+    for (int i = 0; i < nprops; i++)
+        if (!strcmp(props[i].p, name) && !strcmp(props[i].d, dev))
+            return (&props[i]);
+    return (NULL);
+}
+
+/* return the value of an element of pp, NULL if it has none of this name */
+static const char *elementValue(Property *pp, const char *name)
+{
+    for (XMLEle *ep = nextXMLEle(pp->def, 1); ep; ep = nextXMLEle(pp->def, 0))
+        if (!strcmp(tagXMLEle(ep), pp->dp->defOne) && !strcmp(findXMLAttValu(ep, "name"), name))
+            return (pcdataXMLEle(ep));
+    return (NULL);
+}
+
+/* set tv to ms milliseconds from now */
+static void later(struct timeval *tv, long ms)
+{
+    struct timeval delta = { ms / 1000, (ms % 1000) * 1000 };
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    timeradd(&now, &delta, tv);
+}
+
+/* return 1 if tv is passed */
+static int passed(const struct timeval *tv)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (!timercmp(&now, tv, <));
+}
@@ -163,23 +163,29 @@ int evalExpr(double *vp, char *errbuf)
 }
 
 /* set the value for an operand with the given name to the given value.
- * return 0 if found else -1.
+ * return 0 if found and its value changed, or it was not set yet,
+ * 1 if found with the same value, else -1.
+ * an operand may appear more than once, all of them are set.
  */
 int setOperand(char *name, double valu)
 {
     int i;
+    int found = -1;
 
     for (i = 0; i < nvars; i++)
     {
         if (strcmp(name, vars[i].name) == 0)
         {
+            if (!vars[i].set || vars[i].v != valu)
+                found = 0;
+            else if (found < 0)
+                found = 1;
             vars[i].v   = valu;
             vars[i].set = 1;
-            return (0);
         }
     }
 
-    return (-1);
+    return (found);
 }
 
 /* return 0 if all operands are set, else -1 */
@@ -4,9 +4,9 @@
 /* Overall design:
  * compile expression, building operand table, if trouble exit 2
  * open INDI connection, if trouble exit 2
- * send getProperties as required to get operands flowing
+ * send getProperties for each operand property to get operands flowing
  * watch for messages until get initial values of each operand
- * evaluate expression, repeat if -w each time an op arrives until true
+ * evaluate expression, repeat if -w each time an op changes until true
  * exit val==0
  */
 
@@ -44,7 +44,9 @@ static void getProps(FILE *fp);
 static void initProps(FILE *fp);
 static int pstatestr(char *state);
 static time_t timestampINDI(char *ts);
-static int devcmp(char *op1, char *op2);
+static unsigned propHash(const char *dev, const char *name, size_t nlen);
+static void addOpProp(const char *op);
+static int isOpProp(const char *dev, const char *name);
 static int runEval(FILE *fp);
 static int setOp(XMLEle *root);
 static XMLEle *nxtEle(FILE *fp);
@@ -68,6 +70,10 @@ static int oflag;                     /* print operands as they change */
 static int wflag;                     /* wait for expression to be true */
 static int bflag;                     /* beep when true */
 
+/* hash set of the device.property of the operands, to skip other messages quickly */
+#define NOPPROPS 256                  /* power of 2, more than twice the operands */
+static char *opprops[NOPPROPS];
+
 int main(int ac, char *av[])
 {
     FILE *fp;
@@ -312,30 +318,40 @@ static FILE *openINDIServer()
     return (fdopen(sockfd, "r+"));
 }
 
-/* invite each device referenced in the expression to report its properties.
+/* invite each property referenced in the expression to report.
+ * only asking for the properties, not their whole devices, keeps the
+ * server from sending us everything else they define and update.
  */
 static void getProps(FILE *fp)
 {
     char **ops;
     int nops;
-    int i, j;
+    int i;
 
     /* get each operand used in the expression */
     nops = getAllOperands(&ops);
 
-    /* send getProperties for each unique device referenced */
+    /* send getProperties for each unique property referenced */
     for (i = 0; i < nops; i++)
     {
-        for (j = 0; j < i; j++)
-            if (devcmp(ops[i], ops[j]) == 0)
-                break;
-        if (j < i)
+        const char *dot = strchr(ops[i], '.');
+        const char *end = dot ? strchr(dot + 1, '.') : NULL;
+        int dlen, plen;
+
+        if (!end)
+            continue;
+        dlen = (int)(dot - ops[i]);
+        plen = (int)(end - dot - 1);
+        if (isOpProp(ops[i], NULL))
             continue;
+
+        addOpProp(ops[i]);
         if (verbose)
-            fprintf(stderr, "sending getProperties for %.*s\n", (int)(strchr(ops[i], '.') - ops[i]), ops[i]);
-        fprintf(fp, "<getProperties version='%g' device='%.*s'/>\n", INDIV, (int)(strchr(ops[i], '.') - ops[i]),
-                ops[i]);
+            fprintf(stderr, "sending getProperties for %.*s.%.*s\n", dlen, ops[i], plen, dot + 1);
+        fprintf(fp, "<getProperties version='%g' device='%.*s' name='%.*s'/>\n", INDIV, dlen, ops[i], plen, dot + 1);
     }
+
+    free(ops);
 }
 
 /* wait for defXXX or setXXX for each property in the expression.
@@ -347,15 +363,17 @@ static void initProps(FILE *fp)
     alarm(timeout);
     while (allOperandsSet() < 0)
     {
-        if (setOp(nxtEle(fp)) == 0)
+        XMLEle *root = nxtEle(fp);
+        if (setOp(root) == 0)
             alarm(timeout);
+        delXMLEle(root);
     }
     alarm(0);
 }
 
 /* pull apart the name and value from the given message, and set operand value.
  * ignore any other messages.
- * return 0 if found a recognized operand else -1
+ * return 0 if an operand changed, 1 if operands were seen with the same values, else -1
  */
 static int setOp(XMLEle *root)
 {
@@ -363,10 +381,15 @@ static int setOp(XMLEle *root)
     const char *d = findXMLAttValu(root, "device");
     const char *n = findXMLAttValu(root, "name");
     int nset      = 0;
+    int nseen     = 0;
     double v;
     char prop[1024];
     XMLEle *ep;
 
+    /* not about an operand property */
+    if (!d || !n || !isOpProp(d, n))
+        return (-1);
+
     /* check values */
     if (!strcmp(t, "defNumberVector") || !strcmp(t, "setNumberVector"))
     {
@@ -377,7 +400,10 @@ static int setOp(XMLEle *root)
             {
                 sprintf(prop, "%s.%s.%s", d, n, findXMLAttValu(ep, "name"));
                 v = atof(pcdataXMLEle(ep));
-                if (setOperand(prop, v) == 0)
+                int r = setOperand(prop, v);
+                if (r > 0)
+                    nseen++;
+                else if (r == 0)
                 {
                     nset++;
                     if (oflag)
@@ -396,7 +422,10 @@ static int setOp(XMLEle *root)
             {
                 sprintf(prop, "%s.%s.%s", d, n, findXMLAttValu(ep, "name"));
                 v = (double)!strncmp(pcdataXMLEle(ep), "On", 2);
-                if (setOperand(prop, v) == 0)
+                int r = setOperand(prop, v);
+                if (r > 0)
+                    nseen++;
+                else if (r == 0)
                 {
                     nset++;
                     if (oflag)
@@ -414,7 +443,10 @@ static int setOp(XMLEle *root)
             {
                 sprintf(prop, "%s.%s.%s", d, n, findXMLAttValu(ep, "name"));
                 v = (double)pstatestr(pcdataXMLEle(ep));
-                if (setOperand(prop, v) == 0)
+                int r = setOperand(prop, v);
+                if (r > 0)
+                    nseen++;
+                else if (r == 0)
                 {
                     nset++;
                     if (oflag)
@@ -430,7 +462,10 @@ static int setOp(XMLEle *root)
     {
         sprintf(prop, "%s.%s._STATE", d, n);
         v = (double)pstatestr(t);
-        if (setOperand(prop, v) == 0)
+        int r = setOperand(prop, v);
+        if (r > 0)
+            nseen++;
+        else if (r == 0)
         {
             nset++;
             if (oflag)
@@ -442,7 +477,10 @@ static int setOp(XMLEle *root)
     {
         sprintf(prop, "%s.%s._TS", d, n);
         v = (double)timestampINDI(t);
-        if (setOperand(prop, v) == 0)
+        int r = setOperand(prop, v);
+        if (r > 0)
+            nseen++;
+        else if (r == 0)
         {
             nset++;
             if (oflag)
@@ -450,8 +488,8 @@ static int setOp(XMLEle *root)
         }
     }
 
-    /* return whether any were set */
-    return (nset > 0 ? 0 : -1);
+    /* return whether any were changed */
+    return (nset > 0 ? 0 : nseen > 0 ? 1 : -1);
 }
 
 /* evaluate the expression after seeing any operand change.
@@ -477,9 +515,17 @@ static int runEval(FILE *fp)
             fprintf(stderr, "%g\n", v);
         if (!wflag || v != 0)
             break;
-        while (setOp(nxtEle(fp)) < 0)
-            continue;
-        alarm(timeout);
+        /* any operand seen keeps us waiting, only a change needs a new evaluation */
+        int changed;
+        do
+        {
+            XMLEle *root = nxtEle(fp);
+            changed = setOp(root);
+            delXMLEle(root);
+            if (changed >= 0)
+                alarm(timeout);
+        }
+        while (changed != 0);
     }
     alarm(0);
 
@@ -519,13 +565,62 @@ static time_t timestampINDI(char *ts)
         return ((time_t)-1);
 }
 
-/* return 0 if the device portion of the two given property specs match, else 1
+/* hash of device.name, using nlen characters of name */
+static unsigned propHash(const char *dev, const char *name, size_t nlen)
+{
+    unsigned h = 2166136261u;
+
+    for (; *dev; dev++)
+        h = (h ^ (unsigned char)*dev) * 16777619u;
+    h = (h ^ '.') * 16777619u;
+    for (; nlen > 0 && *name; name++, nlen--)
+        h = (h ^ (unsigned char)*name) * 16777619u;
+    return (h);
+}
+
+/* add the device.property of the operand op to opprops[] */
+static void addOpProp(const char *op)
+{
+    const char *dot = strchr(op, '.');
+    const char *end = strchr(dot + 1, '.');
+    char dev[MAXINDIDEVICE];
+    unsigned h;
+
+    snprintf(dev, sizeof(dev), "%.*s", (int)(dot - op), op);
+    h = propHash(dev, dot + 1, end - dot - 1);
+    while (opprops[h & (NOPPROPS - 1)])
+        h++;
+    opprops[h & (NOPPROPS - 1)] = strndup(op, end - op);
+}
+
+/* return 1 if dev.name is the property of an operand.
+ * name may be NULL when dev is an operand, to check its property.
  */
-static int devcmp(char *op1, char *op2)
+static int isOpProp(const char *dev, const char *name)
 {
-    int n1 = strchr(op1, '.') - op1;
-    int n2 = strchr(op2, '.') - op2;
-    return (n1 != n2 || strncmp(op1, op2, n1));
+    char key[MAXINDIDEVICE + MAXINDINAME + 1];
+    unsigned h;
+
+    if (name == NULL)
+    {
+        const char *dot = strchr(dev, '.');
+        const char *end = strchr(dot + 1, '.');
+        snprintf(key, sizeof(key), "%.*s", (int)(end - dev), dev);
+    }
+    else
+        snprintf(key, sizeof(key), "%s.%s", dev, name);
+
+    {
+        char *dot = strchr(key, '.');
+        *dot      = '\0';
+        h         = propHash(key, dot + 1, strlen(dot + 1));
+        *dot      = '.';
+    }
+
+    for (; opprops[h & (NOPPROPS - 1)]; h++)
+        if (!strcmp(opprops[h & (NOPPROPS - 1)], key))
+            return (1);
+    return (0);
 }
 
 /* monitor server and return the next complete XML message.
@@ -0,0 +1,530 @@
+/* replay the traffic captured by indiserver -t against a fresh indiserver.
+ * The server to test is started with the remaining arguments, plus one
+ *   chained driver connection back to us: all the captured driver messages
+ *   are sent on it, and each captured client gets its own tcp connection.
+ * A <message> probe is sent on the driver connection every few driver
+ *   messages. The delay until each client reads it gives the latency
+ *   percentiles reported at the end, with the cpu time used by the server.
+ * exit status: 0 replayed, 1 some clients missed the last probe, 2 real trouble.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#define INDIPORT   7624 /* default port of the server to test */
+#define DRIVERPORT 7626 /* default port for its driver connection */
+#define PROBEEVERY 50   /* driver messages between probes */
+#define DRAINWAIT  10   /* secs to wait for the last probe */
+#define PROBETAG   "indi_replay probe "
+
+/* one captured client */
+typedef struct
+{
+    unsigned long id; /* queue id in the capture */
+    int fd;           /* connection to the server to test */
+    int nsent;        /* messages replayed */
+    long lastProbe;   /* last probe read, probes arrive in order */
+    char tail[32];    /* end of the previous read, for probes split between reads */
+    int ntail;
+    double *lat; /* latency of each probe read, secs */
+    int nlat;
+} Client;
+
+static Client *clients;
+static int nclients;
+
+static double *probeSent; /* time each probe was sent */
+static long nprobes;
+
+static char *me;
+static int port     = INDIPORT;
+static int dvrport  = DRIVERPORT;
+static double speed = 1; /* 0 for as fast as possible */
+static int probeEvery = PROBEEVERY;
+static int verbose;
+static int dvrfd = -1;  /* driver connection from the server */
+static pid_t server = 0;
+
+static void usage(void);
+static double now(void);
+static int listenDriver(void);
+static void startServer(int ac, char *av[]);
+static int connectServer(void);
+static Client *findClient(unsigned long id);
+static void sendAll(int fd, const char *buf, size_t len);
+static void sendProbe(void);
+static void pump(int ms);
+static void scanProbes(Client *cp, const char *buf, int len);
+static double serverCpu(void);
+static int cmpDouble(const void *a, const void *b);
+static double percentile(const double *sorted, int n, double pc);
+static void report(double elapsed, double cpu);
+
+int main(int ac, char *av[])
+{
+    FILE *capture;
+    char header[128];
+    char *xml  = NULL;
+    size_t xmlsiz = 0;
+    double t0, cpu0, drain;
+    int ndvr = 0, i, missed;
+
+    /* save our name */
+    me = av[0];
+
+    /* crack args */
+    while (--ac && **++av == '-')
+    {
+        char *s = *av;
+        while (*++s)
+        {
+            switch (*s)
+            {
+                case 'p':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-p requires tcp port number\n");
+                        usage();
+                    }
+                    port = atoi(*++av);
+                    ac--;
+                    break;
+                case 'l':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-l requires tcp port number\n");
+                        usage();
+                    }
+                    dvrport = atoi(*++av);
+                    ac--;
+                    break;
+                case 's':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-s requires speed factor\n");
+                        usage();
+                    }
+                    speed = atof(*++av);
+                    if (speed < 0)
+                        speed = 0;
+                    ac--;
+                    break;
+                case 'n':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-n requires number of messages\n");
+                        usage();
+                    }
+                    probeEvery = atoi(*++av);
+                    if (probeEvery < 1)
+                        probeEvery = 1;
+                    ac--;
+                    break;
+                case 'v':
+                    verbose++;
+                    break;
+                default:
+                    fprintf(stderr, "Unknown flag: %c\n", *s);
+                    usage();
+            }
+        }
+    }
+
+    /* capture, then the server command line */
+    if (ac < 2)
+        usage();
+
+    capture = fopen(av[0], "r");
+    if (!capture)
+    {
+        fprintf(stderr, "%s: %s\n", av[0], strerror(errno));
+        exit(2);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    startServer(ac - 1, av + 1);
+
+    t0   = now();
+    cpu0 = serverCpu();
+
+    /* replay each captured message at its time */
+    while (fgets(header, sizeof(header), capture))
+    {
+        long long us;
+        char source;
+        unsigned long id;
+        size_t len;
+        double due;
+
+        if (sscanf(header, "%lld %c %lu %zu", &us, &source, &id, &len) != 4)
+        {
+            fprintf(stderr, "Bad capture header: %s", header);
+            exit(2);
+        }
+        if (len + 1 > xmlsiz)
+        {
+            xmlsiz = len + 1;
+            xml    = realloc(xml, xmlsiz);
+        }
+        if (fread(xml, 1, len + 1, capture) != len + 1)
+        {
+            fprintf(stderr, "Truncated capture\n");
+            break;
+        }
+
+        /* wait for its time, reading the server meanwhile */
+        due = speed > 0 ? t0 + us / 1e6 / speed : 0;
+        do
+            pump(due > now() ? (int)((due - now()) * 1000) + 1 : 0);
+        while (due > now());
+
+        if (source == 'd')
+        {
+            sendAll(dvrfd, xml, len);
+            if (++ndvr % probeEvery == 0)
+                sendProbe();
+        }
+        else
+        {
+            Client *cp = findClient(id);
+            sendAll(cp->fd, xml, len);
+            cp->nsent++;
+        }
+    }
+    fclose(capture);
+
+    /* last probe must reach everyone */
+    sendProbe();
+    for (drain = now(); now() - drain < DRAINWAIT;)
+    {
+        for (i = 0; i < nclients; i++)
+            if (clients[i].lastProbe < nprobes - 1)
+                break;
+        if (i == nclients)
+            break;
+        pump(100);
+    }
+
+    report(now() - t0, serverCpu() - cpu0);
+
+    missed = 0;
+    for (i = 0; i < nclients; i++)
+        if (clients[i].lastProbe < nprobes - 1)
+            missed++;
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+
+    return (missed ? 1 : 0);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: %s [options] capture indiserver [server options] [drivers]\n", me);
+    fprintf(stderr, "Purpose: replay a capture recorded by indiserver -t and report client latencies\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, " -p p  : port of the server to test, default %d. Must match its -p\n", INDIPORT);
+    fprintf(stderr, " -l p  : port the server connects to for the driver messages, default %d\n", DRIVERPORT);
+    fprintf(stderr, " -s f  : speed factor, 1 (default) for the captured timing, 0 for as fast as possible\n");
+    fprintf(stderr, " -n n  : driver messages between latency probes, default %d\n", PROBEEVERY);
+    fprintf(stderr, " -v    : verbose\n");
+
+    exit(2);
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* listen on dvrport for the chained connection of the server to test */
+static int listenDriver(void)
+{
+    struct sockaddr_in serv_socket;
+    int sfd, reuse = 1;
+
+    if ((sfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        perror("socket");
+        exit(2);
+    }
+    (void)memset(&serv_socket, 0, sizeof(serv_socket));
+    serv_socket.sin_family      = AF_INET;
+    serv_socket.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serv_socket.sin_port        = htons((unsigned short)dvrport);
+    setsockopt(sfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(sfd, (struct sockaddr *)&serv_socket, sizeof(serv_socket)) < 0 || listen(sfd, 1) < 0)
+    {
+        fprintf(stderr, "Driver port %d: %s\n", dvrport, strerror(errno));
+        exit(2);
+    }
+    return sfd;
+}
+
+/* start the server with av, plus a driver connection to us, and connect every captured client */
+static void startServer(int ac, char *av[])
+{
+    char chained[64];
+    char **sav;
+    struct pollfd pfd;
+    int lfd, i;
+
+    lfd = listenDriver();
+
+    snprintf(chained, sizeof(chained), "@127.0.0.1:%d", dvrport);
+    sav = calloc(ac + 2, sizeof(char *));
+    for (i = 0; i < ac; i++)
+        sav[i] = av[i];
+    sav[ac] = chained;
+
+    server = fork();
+    if (server < 0)
+    {
+        perror("fork");
+        exit(2);
+    }
+    if (server == 0)
+    {
+        close(lfd);
+        execvp(sav[0], sav);
+        fprintf(stderr, "%s: %s\n", sav[0], strerror(errno));
+        _exit(2);
+    }
+    free(sav);
+
+    pfd.fd     = lfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, DRAINWAIT * 1000) != 1 || (dvrfd = accept(lfd, NULL, NULL)) < 0)
+    {
+        fprintf(stderr, "Server did not connect on port %d\n", dvrport);
+        kill(server, SIGTERM);
+        exit(2);
+    }
+    close(lfd);
+
+    if (verbose)
+        fprintf(stderr, "Server %d connected\n", (int)server);
+}
+
+/* connect a new client, the server may still be starting */
+static int connectServer(void)
+{
+    struct sockaddr_in serv_addr;
+    int sockfd, tries;
+
+    (void)memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family      = AF_INET;
+    serv_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    serv_addr.sin_port        = htons(port);
+
+    for (tries = 0; tries < DRAINWAIT * 10; tries++)
+    {
+        if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+        {
+            perror("socket");
+            exit(2);
+        }
+        if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) == 0)
+            return sockfd;
+        close(sockfd);
+        usleep(100000);
+    }
+    fprintf(stderr, "Can not connect to server on port %d\n", port);
+    kill(server, SIGTERM);
+    exit(2);
+}
+
+/* the client replaying captured queue id, connected on first use */
+static Client *findClient(unsigned long id)
+{
+    Client *cp;
+    int i;
+
+    for (i = 0; i < nclients; i++)
+        if (clients[i].id == id)
+            return &clients[i];
+
+    clients = realloc(clients, (nclients + 1) * sizeof(Client));
+    cp      = &clients[nclients++];
+    memset(cp, 0, sizeof(*cp));
+    cp->id        = id;
+    cp->lastProbe = -1;
+    cp->fd        = connectServer();
+
+    if (verbose)
+        fprintf(stderr, "Client %lu connected\n", id);
+    return cp;
+}
+
+static void sendAll(int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t nw = write(fd, buf, len);
+        if (nw < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            fprintf(stderr, "Server write: %s\n", strerror(errno));
+            kill(server, SIGTERM);
+            exit(2);
+        }
+        buf += nw;
+        len -= nw;
+    }
+}
+
+/* a message without device reaches all the clients */
+static void sendProbe(void)
+{
+    char probe[128];
+    int len = snprintf(probe, sizeof(probe), "<message message='" PROBETAG "%ld'/>\n", nprobes);
+
+    probeSent = realloc(probeSent, (nprobes + 1) * sizeof(double));
+    probeSent[nprobes++] = now();
+    sendAll(dvrfd, probe, len);
+}
+
+/* read whatever the server sent for up to ms */
+static void pump(int ms)
+{
+    struct pollfd *pfds = calloc(nclients + 1, sizeof(struct pollfd));
+    char buf[32768];
+    int i, n;
+
+    pfds[0].fd     = dvrfd;
+    pfds[0].events = POLLIN;
+    for (i = 0; i < nclients; i++)
+    {
+        pfds[i + 1].fd     = clients[i].fd;
+        pfds[i + 1].events = POLLIN;
+    }
+
+    n = poll(pfds, nclients + 1, ms);
+    for (i = 0; n > 0 && i <= nclients; i++)
+    {
+        ssize_t nr;
+
+        if (!pfds[i].revents)
+            continue;
+        nr = read(pfds[i].fd, buf, sizeof(buf));
+        if (nr <= 0)
+        {
+            fprintf(stderr, "Server closed %s connection\n", i ? "a client" : "the driver");
+            kill(server, SIGTERM);
+            exit(2);
+        }
+        /* what goes to the driver is ignored, its replies are in the capture */
+        if (i > 0)
+            scanProbes(&clients[i - 1], buf, nr);
+    }
+    free(pfds);
+}
+
+/* record the latency of each new probe in buf */
+static void scanProbes(Client *cp, const char *buf, int len)
+{
+    char *scan = malloc(cp->ntail + len + 1);
+    char *p;
+    double t = now();
+    int total;
+
+    memcpy(scan, cp->tail, cp->ntail);
+    memcpy(scan + cp->ntail, buf, len);
+    scan[cp->ntail + len] = '\0';
+
+    for (p = scan; (p = strstr(p, PROBETAG)) != NULL;)
+    {
+        char *end;
+        long n;
+
+        p += sizeof(PROBETAG) - 1;
+        n = strtol(p, &end, 10);
+        /* complete number only, and not already counted from the tail */
+        if ((*end != '\'' && *end != '"') || n <= cp->lastProbe || n >= nprobes)
+            continue;
+        cp->lastProbe = n;
+        cp->lat       = realloc(cp->lat, (cp->nlat + 1) * sizeof(double));
+        cp->lat[cp->nlat++] = t - probeSent[n];
+    }
+
+    /* keep the end for the next read */
+    total     = cp->ntail + len;
+    cp->ntail = total < (int)sizeof(cp->tail) ? total : (int)sizeof(cp->tail);
+    memcpy(cp->tail, scan + total - cp->ntail, cp->ntail);
+    free(scan);
+}
+
+/* user + system time of the server so far, secs */
+static double serverCpu(void)
+{
+    char path[64], stat[1024], *p;
+    unsigned long utime, stime;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)server);
+    fp = fopen(path, "r");
+    if (!fp)
+        return 0;
+    if (!fgets(stat, sizeof(stat), fp))
+        stat[0] = '\0';
+    fclose(fp);
+
+    /* comm may hold spaces, fields restart after its closing parenthesis */
+    p = strrchr(stat, ')');
+    if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+        return 0;
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static int cmpDouble(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+    return da < db ? -1 : da > db;
+}
+
+static double percentile(const double *sorted, int n, double pc)
+{
+    return n ? sorted[(int)(pc * (n - 1) + 0.5)] : 0;
+}
+
+static void report(double elapsed, double cpu)
+{
+    double *all = NULL;
+    int nall = 0, i;
+
+    printf("%-8s %8s %8s %10s %10s %10s %10s\n", "client", "sent", "probes", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    for (i = 0; i < nclients; i++)
+    {
+        Client *cp = &clients[i];
+
+        qsort(cp->lat, cp->nlat, sizeof(double), cmpDouble);
+        printf("%-8lu %8d %8d %10.3f %10.3f %10.3f %10.3f\n", cp->id, cp->nsent, cp->nlat,
+               1e3 * percentile(cp->lat, cp->nlat, .5), 1e3 * percentile(cp->lat, cp->nlat, .9),
+               1e3 * percentile(cp->lat, cp->nlat, .99), 1e3 * percentile(cp->lat, cp->nlat, 1));
+
+        all = realloc(all, (nall + cp->nlat) * sizeof(double));
+        memcpy(all + nall, cp->lat, cp->nlat * sizeof(double));
+        nall += cp->nlat;
+    }
+
+    qsort(all, nall, sizeof(double), cmpDouble);
+    printf("%-8s %8s %8d %10.3f %10.3f %10.3f %10.3f\n", "all", "", nall, 1e3 * percentile(all, nall, .5),
+           1e3 * percentile(all, nall, .9), 1e3 * percentile(all, nall, .99), 1e3 * percentile(all, nall, 1));
+    printf("replayed in %.3f s, server cpu %.3f s (%.1f%%)\n", elapsed, cpu, elapsed > 0 ? 100 * cpu / elapsed : 0);
+    free(all);
+}
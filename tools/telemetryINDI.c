@@ -0,0 +1,940 @@
+/* record numbers of an INDI server in compressed columnar chunks, and query them.
+ * Record: connect to the server and append every value of the matching
+ *   device.property.element numbers to the file, from their defNumberVector
+ *   and setNumberVector messages. The samples of each element are buffered
+ *   and written a chunk at a time: the times as delta of delta varints, the
+ *   values xored to the previous one and split in byte planes, then deflated.
+ * Query (-q): print the samples of the matching elements within a time range
+ *   as csv. Each chunk header holds the range of its times, so chunks out of
+ *   the range are skipped without being inflated.
+ * exit status: 0 done, 1 nothing matched the query, 2 real trouble.
+ */
+
+#include "indiapi.h"
+#include "indicom.h"
+#include "lilxml.h"
+#include "zlib.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+/* the file is the magic then records, all integers little endian:
+ *   'S' u32 id, u16 len, name           the name of a series, device.property.element
+ *   'C' u32 id, u32 n, i64 first, i64 last, u32 zlen, deflated samples
+ * times are microseconds since the epoch.
+ */
+#define MAGIC      "INDITLM1"
+#define MAGICLEN   8
+#define CHUNKHDR   (1 + 4 + 4 + 8 + 8 + 4)
+#define INDIPORT   7624 /* default port */
+#define CHUNKLEN   4096 /* default samples per chunk */
+#define CHUNKAGE   60   /* default secs before a partial chunk is written */
+#define WILDCARD   '*'  /* match all in this category */
+
+/* one element recorded, or read back */
+typedef struct
+{
+    char *name;   /* device.property.element */
+    uint32_t id;  /* id in the file */
+    int64_t *t;   /* buffered times */
+    double *v;    /* buffered values */
+    int n;        /* buffered samples */
+    int64_t since; /* time the first buffered sample was received */
+    int wanted;   /* matches the query */
+    int named;    /* its name is in the file */
+} Series;
+
+static Series *series;
+static int nseries;
+static int *slots; /* open hash of series by name, -1 for free */
+static int nslots;
+
+typedef struct
+{
+    char *d; /* device to match */
+    char *p; /* property to match */
+    char *e; /* element to match */
+    char ok; /* something matched */
+} SearchDef;
+static SearchDef *srchs;
+static int nsrchs;
+
+static char *me;
+static char host_def[] = "localhost";
+static char *host      = host_def;
+static int port        = INDIPORT;
+static int chunklen    = CHUNKLEN;
+static int chunkage    = CHUNKAGE;
+static int devtime;      /* use the timestamps of the device instead of the receipt times */
+static int query;        /* query the file instead of recording */
+static int64_t qstart    = INT64_MIN;
+static int64_t qend      = INT64_MAX;
+static int verbose;
+static char *fn;         /* file to record to or query */
+static FILE *fp;
+static volatile sig_atomic_t stop;
+static unsigned long nsamples, nchunks, nbytes;
+
+static void usage(void);
+static void crackDPE(char *spec);
+static int matches(const char *name);
+static int isoTime(const char *s, int64_t *t);
+static int64_t parseTime(const char *s);
+static int64_t now(void);
+static Series *findSeries(const char *name, int create);
+static void openFile(void);
+static void record(void);
+static void addSample(const char *name, int64_t t, double v);
+static void flushSeries(Series *sp);
+static void flushOld(int64_t t);
+static void onStop(int dummy);
+static int queryFile(void);
+
+int main(int ac, char *av[])
+{
+    me = av[0];
+
+    /* crack args */
+    while (--ac && **++av == '-')
+    {
+        char *s = *av;
+        while (*++s)
+        {
+            switch (*s)
+            {
+                case 'a':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-a requires secs\n");
+                        usage();
+                    }
+                    chunkage = atoi(*++av);
+                    ac--;
+                    break;
+                case 'D':
+                    devtime++;
+                    break;
+                case 'e':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-e requires time\n");
+                        usage();
+                    }
+                    qend = parseTime(*++av);
+                    ac--;
+                    break;
+                case 'h':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-h requires host name\n");
+                        usage();
+                    }
+                    host = *++av;
+                    ac--;
+                    break;
+                case 'n':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-n requires samples\n");
+                        usage();
+                    }
+                    chunklen = atoi(*++av);
+                    if (chunklen < 1)
+                    {
+                        fprintf(stderr, "-n requires at least 1 sample\n");
+                        usage();
+                    }
+                    ac--;
+                    break;
+                case 'p':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-p requires tcp port number\n");
+                        usage();
+                    }
+                    port = atoi(*++av);
+                    ac--;
+                    break;
+                case 'q':
+                    query++;
+                    break;
+                case 's':
+                    if (ac < 2)
+                    {
+                        fprintf(stderr, "-s requires time\n");
+                        usage();
+                    }
+                    qstart = parseTime(*++av);
+                    ac--;
+                    break;
+                case 'v':
+                    verbose++;
+                    break;
+                default:
+                    fprintf(stderr, "Unknown flag: %c\n", *s);
+                    usage();
+            }
+        }
+    }
+
+    /* now the file then the searches */
+    if (ac < 1)
+        usage();
+    fn = *av++;
+    ac--;
+    if (ac == 0)
+        crackDPE("*.*.*");
+    while (ac--)
+        crackDPE(*av++);
+
+    if (query)
+        return queryFile();
+
+    openFile();
+    record();
+    return (0);
+}
+
+static void usage()
+{
+    fprintf(stderr, "Purpose: record numbers of an INDI server to a compressed columnar file, and query it\n");
+    fprintf(stderr, "%s\n", GIT_TAG_STRING);
+    fprintf(stderr, "Usage: %s [options] file [device.property.element ...]\n", me);
+    fprintf(stderr, "       %s -q [-s time] [-e time] file [device.property.element ...]\n", me);
+    fprintf(stderr, "  Any component may be \"*\" to match all (beware shell metacharacters).\n");
+    fprintf(stderr, "  Records or reports all numbers if none specified.\n");
+    fprintf(stderr, "  Recording appends to file, until interrupted.\n");
+    fprintf(stderr, "  Times are secs since the epoch, or UTC as YYYY-MM-DDTHH:MM:SS.\n");
+    fprintf(stderr, "Output format of -q: time,device.property.element,value one per line,\n");
+    fprintf(stderr, "  time in secs since the epoch, in time order for each element.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -a a  : secs before a partial chunk is written, default is %d\n", CHUNKAGE);
+    fprintf(stderr, "  -D    : record the timestamps of the devices, not the times of receipt\n");
+    fprintf(stderr, "  -e t  : query samples until time t\n");
+    fprintf(stderr, "  -h h  : alternate host, default is %s\n", host_def);
+    fprintf(stderr, "  -n n  : samples per chunk, default is %d\n", CHUNKLEN);
+    fprintf(stderr, "  -p p  : alternate port, default is %d\n", INDIPORT);
+    fprintf(stderr, "  -q    : query file instead of recording\n");
+    fprintf(stderr, "  -s t  : query samples from time t\n");
+    fprintf(stderr, "  -v    : verbose (cumulative)\n");
+    fprintf(stderr, "Exit status:\n");
+    fprintf(stderr, "  0: done\n");
+    fprintf(stderr, "  1: nothing matched the query\n");
+    fprintf(stderr, "  2: real trouble, try repeating with -v\n");
+
+    exit(2);
+}
+
+/* crack spec and add to srchs[], else exit */
+static void crackDPE(char *spec)
+{
+    char d[1024], p[1024], e[1024];
+
+    if (sscanf(spec, "%1023[^.].%1023[^.].%1023[^.]", d, p, e) != 3)
+    {
+        fprintf(stderr, "Unknown format for property spec: %s\n", spec);
+        usage();
+    }
+
+    srchs             = (SearchDef *)realloc(srchs, (nsrchs + 1) * sizeof(SearchDef));
+    srchs[nsrchs].d  = strdup(d);
+    srchs[nsrchs].p  = strdup(p);
+    srchs[nsrchs].e  = strdup(e);
+    srchs[nsrchs].ok = 0;
+    nsrchs++;
+}
+
+/* return whether device.property.element matches any srchs[] */
+static int matches(const char *name)
+{
+    char d[MAXINDIDEVICE], p[MAXINDINAME], e[MAXINDINAME];
+    int found = 0;
+
+    if (sscanf(name, "%63[^.].%63[^.].%63[^.]", d, p, e) != 3)
+        return (0);
+
+    for (int i = 0; i < nsrchs; i++)
+    {
+        SearchDef *sp = &srchs[i];
+        if ((sp->d[0] == WILDCARD || !strcmp(sp->d, d)) && (sp->p[0] == WILDCARD || !strcmp(sp->p, p)) &&
+                (sp->e[0] == WILDCARD || !strcmp(sp->e, e)))
+        {
+            sp->ok = 1;
+            found  = 1;
+        }
+    }
+    return (found);
+}
+
+/* crack the UTC time s into *t, microseconds since the epoch. return 0 if ok, else -1 */
+static int isoTime(const char *s, int64_t *t)
+{
+    struct tm tm;
+    double secs;
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(s, "%d-%d-%dT%d:%d:%lf", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &secs) != 6)
+        return (-1);
+
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    *t = (int64_t)timegm(&tm) * 1000000 + (int64_t)(secs * 1e6);
+    return (0);
+}
+
+/* return s, secs since the epoch or an UTC time, in microseconds, else exit */
+static int64_t parseTime(const char *s)
+{
+    double secs;
+    char *end;
+    int64_t t;
+
+    if (isoTime(s, &t) == 0)
+        return (t);
+
+    secs = strtod(s, &end);
+    if (end == s || *end)
+    {
+        fprintf(stderr, "Unknown format for time: %s\n", s);
+        usage();
+    }
+    return ((int64_t)(secs * 1e6));
+}
+
+/* return the time now, in microseconds since the epoch */
+static int64_t now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return ((int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+static uint32_t hashName(const char *name)
+{
+    uint32_t h = 2166136261u;
+
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+    return (h);
+}
+
+/* return the series of name, a new one if create and none yet, else NULL */
+static Series *findSeries(const char *name, int create)
+{
+    uint32_t h = hashName(name);
+    int i;
+
+    if (nslots)
+        for (i = h & (nslots - 1); slots[i] >= 0; i = (i + 1) & (nslots - 1))
+            if (!strcmp(series[slots[i]].name, name))
+                return (&series[slots[i]]);
+
+    if (!create)
+        return (NULL);
+
+    /* keep the table at most half full */
+    if (2 * (nseries + 1) > nslots)
+    {
+        nslots = nslots ? 2 * nslots : 64;
+        slots  = (int *)realloc(slots, nslots * sizeof(int));
+        memset(slots, -1, nslots * sizeof(int));
+        for (int s = 0; s < nseries; s++)
+        {
+            for (i = hashName(series[s].name) & (nslots - 1); slots[i] >= 0; i = (i + 1) & (nslots - 1))
+                ;
+            slots[i] = s;
+        }
+    }
+
+    series = (Series *)realloc(series, (nseries + 1) * sizeof(Series));
+    memset(&series[nseries], 0, sizeof(Series));
+    series[nseries].name   = strdup(name);
+    series[nseries].id     = nseries;
+    series[nseries].wanted = matches(name);
+
+    for (i = h & (nslots - 1); slots[i] >= 0; i = (i + 1) & (nslots - 1))
+        ;
+    slots[i] = nseries;
+
+    return (&series[nseries++]);
+}
+
+static void put16(unsigned char *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(unsigned char *p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = v >> (8 * i);
+}
+
+static void put64(unsigned char *p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = v >> (8 * i);
+}
+
+static uint32_t get32(const unsigned char *p)
+{
+    return (p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+}
+
+static uint64_t get64(const unsigned char *p)
+{
+    uint64_t v = 0;
+
+    for (int i = 0; i < 8; i++)
+        v |= (uint64_t)p[i] << (8 * i);
+    return (v);
+}
+
+/* read one record header at the current position into hdr.
+ * return its length, 0 at the end of the file, -1 if it is cut short.
+ */
+static int readHeader(unsigned char *hdr)
+{
+    int c = fgetc(fp);
+
+    if (c == EOF)
+        return (0);
+    hdr[0] = c;
+
+    if (c == 'S')
+    {
+        if (fread(hdr + 1, 6, 1, fp) != 1)
+            return (-1);
+        return (7);
+    }
+
+    if (c == 'C')
+    {
+        if (fread(hdr + 1, CHUNKHDR - 1, 1, fp) != 1)
+            return (-1);
+        return (CHUNKHDR);
+    }
+
+    fprintf(stderr, "%s: unknown record '%c' at %ld\n", fn, c, ftell(fp) - 1);
+    exit(2);
+}
+
+/* open fn to append, reading back the series already in it.
+ * a record cut short by a crash is dropped.
+ */
+static void openFile()
+{
+    unsigned char hdr[CHUNKHDR];
+    char magic[MAGICLEN];
+    struct stat st;
+    long good;
+    int len;
+
+    fp = fopen(fn, "a+b");
+    if (!fp)
+    {
+        fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+        exit(2);
+    }
+
+    fseek(fp, 0, SEEK_SET);
+    if (fread(magic, MAGICLEN, 1, fp) != 1)
+    {
+        /* new file, or not even the magic made it */
+        if (ftruncate(fileno(fp), 0) < 0 || fwrite(MAGIC, MAGICLEN, 1, fp) != 1 || fflush(fp))
+        {
+            fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+            exit(2);
+        }
+        return;
+    }
+
+    if (memcmp(magic, MAGIC, MAGICLEN))
+    {
+        fprintf(stderr, "%s: not a telemetry file\n", fn);
+        exit(2);
+    }
+
+    fstat(fileno(fp), &st);
+    good = MAGICLEN;
+    while ((len = readHeader(hdr)) > 0)
+    {
+        if (hdr[0] == 'S')
+        {
+            char name[3 * MAXINDINAME];
+            int nlen = hdr[5] | hdr[6] << 8;
+            if (nlen >= (int)sizeof(name) || fread(name, nlen, 1, fp) != 1)
+                break;
+            name[nlen] = '\0';
+            findSeries(name, 1)->named = 1;
+        }
+        else if (fseek(fp, get32(hdr + CHUNKHDR - 4), SEEK_CUR) < 0 || ftell(fp) > st.st_size)
+            break;
+        good = ftell(fp);
+    }
+
+    if (good != st.st_size)
+    {
+        fprintf(stderr, "%s: dropping the last record, cut short at %ld\n", fn, good);
+        if (ftruncate(fileno(fp), good) < 0)
+        {
+            fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+            exit(2);
+        }
+    }
+    fseek(fp, 0, SEEK_END);
+
+    if (verbose)
+        fprintf(stderr, "%s: appending to %d series\n", fn, nseries);
+}
+
+/* write bytes to fp, else exit */
+static void writeFile(const void *p, size_t n)
+{
+    if (fwrite(p, n, 1, fp) != 1)
+    {
+        fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+        exit(2);
+    }
+    nbytes += n;
+}
+
+/* open a connection to the given host and port, return its fd or die. */
+static int openINDIServer(void)
+{
+    struct sockaddr_in serv_addr;
+    struct hostent *hp;
+    int sockfd;
+
+    hp = gethostbyname(host);
+    if (!hp)
+    {
+        herror("gethostbyname");
+        exit(2);
+    }
+
+    (void)memset((char *)&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family      = AF_INET;
+    serv_addr.sin_addr.s_addr = ((struct in_addr *)(hp->h_addr_list[0]))->s_addr;
+    serv_addr.sin_port        = htons(port);
+    if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+    {
+        perror("socket");
+        exit(2);
+    }
+
+    if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0)
+    {
+        perror("connect");
+        exit(2);
+    }
+
+    return (sockfd);
+}
+
+/* add the samples of a defNumberVector or setNumberVector */
+static void numberVector(XMLEle *root, int64_t received)
+{
+    const char *dev = findXMLAttValu(root, "device");
+    const char *nam = findXMLAttValu(root, "name");
+    const char *one = tagXMLEle(root)[0] == 'd' ? "defNumber" : "oneNumber";
+    int64_t t       = received;
+    char name[3 * MAXINDINAME];
+
+    /* fall back to the time of receipt if the device sent none */
+    if (devtime && isoTime(findXMLAttValu(root, "timestamp"), &t) < 0)
+        t = received;
+
+    for (XMLEle *ep = nextXMLEle(root, 1); ep; ep = nextXMLEle(root, 0))
+    {
+        double v;
+        if (strcmp(tagXMLEle(ep), one))
+            continue;
+        snprintf(name, sizeof(name), "%s.%s.%s", dev, nam, findXMLAttValu(ep, "name"));
+        if (f_scansexa(pcdataXMLEle(ep), &v) < 0)
+        {
+            if (verbose)
+                fprintf(stderr, "%s: bad number '%s'\n", name, pcdataXMLEle(ep));
+            continue;
+        }
+        addSample(name, t, v);
+    }
+}
+
+/* record from the server until interrupted or it disconnects */
+static void record()
+{
+    struct sigaction sa;
+    char buf[32768];
+    char msg[1024];
+    LilXML *lillp = newLilXML();
+    int fd        = openINDIServer();
+    FILE *svrwfp  = fdopen(fd, "w");
+    int onedev    = nsrchs == 1 && srchs[0].d[0] != WILDCARD;
+
+    if (verbose)
+        fprintf(stderr, "Connected to %s on port %d\n", host, port);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onStop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (onedev)
+        fprintf(svrwfp, "<getProperties version='%g' device='%s'/>\n", INDIV, srchs[0].d);
+    else
+        fprintf(svrwfp, "<getProperties version='%g'/>\n", INDIV);
+    fflush(svrwfp);
+
+    while (!stop)
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int n             = poll(&pfd, 1, 1000);
+        int64_t t         = now();
+
+        if (n > 0)
+        {
+            n = read(fd, buf, sizeof(buf));
+            if (n <= 0)
+            {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0)
+                    perror("read");
+                else
+                    fprintf(stderr, "INDI server %s/%d disconnected\n", host, port);
+                break;
+            }
+
+            /* a whole read is parsed in one go, it shares one time of receipt */
+            XMLEle **nodes = parseXMLChunk(lillp, buf, n, msg);
+            if (!nodes)
+            {
+                fprintf(stderr, "Bad XML from %s/%d: %s\n", host, port, msg);
+                break;
+            }
+            for (XMLEle **np = nodes; *np; np++)
+            {
+                const char *tag = tagXMLEle(*np);
+                if (!strcmp(tag, "setNumberVector") || !strcmp(tag, "defNumberVector"))
+                    numberVector(*np, t);
+                delXMLEle(*np);
+            }
+            free(nodes);
+        }
+        else if (n < 0 && errno != EINTR)
+        {
+            perror("poll");
+            break;
+        }
+
+        flushOld(t);
+    }
+
+    for (int i = 0; i < nseries; i++)
+        flushSeries(&series[i]);
+    fclose(fp);
+    fclose(svrwfp);
+    delLilXML(lillp);
+
+    if (verbose)
+        fprintf(stderr, "Recorded %lu samples of %d series in %lu chunks, %lu bytes\n", nsamples, nseries, nchunks,
+                nbytes);
+}
+
+static void onStop(int dummy)
+{
+    (void)dummy;
+    stop = 1;
+}
+
+/* buffer one sample, writing the chunk of its series when full */
+static void addSample(const char *name, int64_t t, double v)
+{
+    Series *sp = findSeries(name, 1);
+    unsigned char hdr[7];
+
+    if (!sp->wanted)
+        return;
+
+    if (!sp->named)
+    {
+        size_t nlen = strlen(sp->name);
+        hdr[0]      = 'S';
+        put32(hdr + 1, sp->id);
+        put16(hdr + 5, nlen);
+        writeFile(hdr, sizeof(hdr));
+        writeFile(sp->name, nlen);
+        sp->named = 1;
+    }
+
+    if (!sp->t)
+    {
+        sp->t = (int64_t *)malloc(chunklen * sizeof(int64_t));
+        sp->v = (double *)malloc(chunklen * sizeof(double));
+    }
+
+    if (sp->n == 0)
+        sp->since = now();
+    sp->t[sp->n] = t;
+    sp->v[sp->n] = v;
+    nsamples++;
+
+    if (++sp->n == chunklen)
+        flushSeries(sp);
+}
+
+static size_t putVarint(unsigned char *p, uint64_t v)
+{
+    size_t n = 0;
+
+    while (v >= 0x80)
+    {
+        p[n++] = v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+    return (n);
+}
+
+/* write the buffered samples of sp as one chunk */
+static void flushSeries(Series *sp)
+{
+    unsigned char hdr[CHUNKHDR];
+    unsigned char *raw, *planes, *z;
+    size_t nraw = 0;
+    uLongf nz;
+    int64_t delta = 0;
+    uint64_t prev = 0;
+
+    if (sp->n == 0)
+        return;
+
+    /* times as zigzagged varints of the change of their deltas, then value xors a byte plane at a time */
+    raw = (unsigned char *)malloc((sp->n - 1) * 10 + sp->n * 8);
+    for (int i = 1; i < sp->n; i++)
+    {
+        int64_t d   = sp->t[i] - sp->t[i - 1];
+        int64_t dod = d - delta;
+        nraw += putVarint(raw + nraw, ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63));
+        delta = d;
+    }
+    planes = raw + nraw;
+    for (int i = 0; i < sp->n; i++)
+    {
+        uint64_t bits;
+        memcpy(&bits, &sp->v[i], sizeof(bits));
+        for (int b = 0; b < 8; b++)
+            planes[b * sp->n + i] = (bits ^ prev) >> (8 * b);
+        prev = bits;
+    }
+    nraw += sp->n * 8;
+
+    nz = compressBound(nraw);
+    z  = (unsigned char *)malloc(nz);
+    if (compress2(z, &nz, raw, nraw, Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        fprintf(stderr, "%s: compress error\n", sp->name);
+        exit(2);
+    }
+
+    hdr[0] = 'C';
+    put32(hdr + 1, sp->id);
+    put32(hdr + 5, sp->n);
+    put64(hdr + 9, sp->t[0]);
+    put64(hdr + 17, sp->t[sp->n - 1]);
+    put32(hdr + 25, nz);
+    writeFile(hdr, sizeof(hdr));
+    writeFile(z, nz);
+    fflush(fp);
+
+    if (verbose > 1)
+        fprintf(stderr, "%s: wrote %d samples in %lu bytes\n", sp->name, sp->n, (unsigned long)nz);
+
+    nchunks++;
+    sp->n = 0;
+    free(z);
+    free(raw);
+}
+
+/* write the partial chunks buffered for longer than chunkage */
+static void flushOld(int64_t t)
+{
+    static int64_t last;
+
+    if (t - last < 1000000)
+        return;
+    last = t;
+
+    for (int i = 0; i < nseries; i++)
+        if (series[i].n && t - series[i].since >= (int64_t)chunkage * 1000000)
+            flushSeries(&series[i]);
+}
+
+/* inflate the chunk of n samples in z into t[] and v[] */
+static int decodeChunk(const unsigned char *z, uLong nz, int n, int64_t first, int64_t *t, double *v)
+{
+    uLongf nraw = (n - 1) * 10 + n * 8;
+    unsigned char *raw = (unsigned char *)malloc(nraw);
+    const unsigned char *p, *planes;
+    int64_t delta = 0;
+    uint64_t prev = 0;
+
+    if (uncompress(raw, &nraw, z, nz) != Z_OK || nraw < (uLongf)n * 8)
+    {
+        free(raw);
+        return (-1);
+    }
+
+    p    = raw;
+    t[0] = first;
+    for (int i = 1; i < n; i++)
+    {
+        uint64_t u = 0;
+        for (int shift = 0; p < raw + nraw; shift += 7)
+        {
+            u |= (uint64_t)(*p & 0x7f) << shift;
+            if (!(*p++ & 0x80))
+                break;
+        }
+        delta += (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+        t[i] = t[i - 1] + delta;
+    }
+
+    planes = p;
+    if (planes + (size_t)n * 8 != raw + nraw)
+    {
+        free(raw);
+        return (-1);
+    }
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t bits = 0;
+        for (int b = 0; b < 8; b++)
+            bits |= (uint64_t)planes[b * n + i] << (8 * b);
+        prev ^= bits;
+        memcpy(&v[i], &prev, sizeof(prev));
+    }
+
+    free(raw);
+    return (0);
+}
+
+/* print the samples of fn matching srchs[] between qstart and qend */
+static int queryFile()
+{
+    unsigned char hdr[CHUNKHDR];
+    char magic[MAGICLEN];
+    unsigned long nskipped = 0;
+    uint32_t nids = 0;
+    int *byid     = NULL; /* index in series[] of each id, -1 if unnamed */
+    int found     = 0;
+    int len;
+
+    fp = fopen(fn, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "%s: %s\n", fn, strerror(errno));
+        return (2);
+    }
+    if (fread(magic, MAGICLEN, 1, fp) != 1 || memcmp(magic, MAGIC, MAGICLEN))
+    {
+        fprintf(stderr, "%s: not a telemetry file\n", fn);
+        return (2);
+    }
+
+    while ((len = readHeader(hdr)) > 0)
+    {
+        uint32_t id = get32(hdr + 1);
+
+        if (hdr[0] == 'S')
+        {
+            char name[3 * MAXINDINAME];
+            int nlen = hdr[5] | hdr[6] << 8;
+            if (nlen >= (int)sizeof(name) || fread(name, nlen, 1, fp) != 1)
+            {
+                len = -1;
+                break;
+            }
+            name[nlen] = '\0';
+            if (id >= nids)
+            {
+                byid = (int *)realloc(byid, (id + 1) * sizeof(int));
+                memset(byid + nids, -1, (id + 1 - nids) * sizeof(int));
+                nids = id + 1;
+            }
+            byid[id] = findSeries(name, 1) - series;
+        }
+        else
+        {
+            uint32_t n     = get32(hdr + 5);
+            int64_t first  = (int64_t)get64(hdr + 9);
+            int64_t last   = (int64_t)get64(hdr + 17);
+            uint32_t nz    = get32(hdr + 25);
+            Series *sp     = id < nids && byid[id] >= 0 ? &series[byid[id]] : NULL;
+            unsigned char *z;
+            int64_t *t;
+            double *v;
+
+            if (!sp || !sp->wanted || last < qstart || first > qend || n == 0)
+            {
+                nskipped++;
+                if (fseek(fp, nz, SEEK_CUR) < 0)
+                    break;
+                continue;
+            }
+
+            z = (unsigned char *)malloc(nz);
+            t = (int64_t *)malloc(n * sizeof(int64_t));
+            v = (double *)malloc(n * sizeof(double));
+            if (fread(z, nz, 1, fp) != 1)
+            {
+                len = -1;
+                free(z);
+                free(t);
+                free(v);
+                break;
+            }
+            if (decodeChunk(z, nz, n, first, t, v) < 0)
+            {
+                fprintf(stderr, "%s: bad chunk of %s at %ld\n", fn, sp->name, ftell(fp) - nz - CHUNKHDR);
+                exit(2);
+            }
+            for (uint32_t i = 0; i < n; i++)
+            {
+                if (t[i] < qstart || t[i] > qend)
+                    continue;
+                printf("%lld.%06lld,%s,%.17g\n", (long long)(t[i] / 1000000), (long long)(t[i] % 1000000),
+                       sp->name, v[i]);
+                found = 1;
+            }
+            free(z);
+            free(t);
+            free(v);
+        }
+    }
+
+    if (len < 0)
+        fprintf(stderr, "%s: last record cut short\n", fn);
+    if (verbose)
+        fprintf(stderr, "%s: %d series, %lu chunks skipped\n", fn, nseries, nskipped);
+
+    free(byid);
+    fclose(fp);
+    return (found ? 0 : 1);
+}